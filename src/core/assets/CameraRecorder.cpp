@@ -10,23 +10,150 @@
  */
 
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "core/assets/CameraRecorder.hpp"
 #include "core/assets/InputCamera.hpp"
+#include "core/system/MappedFile.hpp"
 #include <opencv2/imgcodecs.hpp>
 
 namespace sibr
 {
+	namespace
+	{
+		const char kPathMagic[8] = { 'S', 'I', 'B', 'R', 'P', 'A', 'T', 'H' };
+		const uint32_t kPathVersion = 1;
+
+		struct PathHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t frameCount;
+		};
+
+		/// One frame of a binary path, kept at 64 bytes.
+		struct FrameRecord
+		{
+			double timestamp; // seconds
+			float position[3];
+			float rotation[4]; // w, x, y, z
+			float fovy, aspect, znear, zfar;
+			float principalPoint[2];
+			uint32_t reserved;
+		};
+		static_assert(sizeof(PathHeader) == 16, "Binary camera path header should be packed.");
+		static_assert(sizeof(FrameRecord) == 64, "Binary camera path frames should be packed.");
+
+		/** Save a frame, keeping the float values for HDR formats. */
+		void saveFrame(const ImageRGBA32F & image, const std::string & fileName)
+		{
+			const std::string extension = boost::filesystem::extension(fileName);
+			if (extension == ".exr" || extension == ".hdr")
+				image.saveHDR(fileName, false);
+			else
+				image.save(fileName, false);
+		}
+
+		/** \return the file name of the i-th frame of a path. */
+		std::string frameFileName(const std::string & outPathDir, int i, const std::string & extension)
+		{
+			std::ostringstream ssZeroPad;
+			ssZeroPad << std::setw(8) << std::setfill('0') << i;
+			return outPathDir + "/" + ssZeroPad.str() + extension;
+		}
+
+		/** A frame being rendered: its render target, and the pixel buffer its asynchronous readback goes to. */
+		struct FrameInFlight
+		{
+			RenderTargetRGBA32F::Ptr target;
+			GLuint pbo = 0;
+			GLsync fence = 0;
+			std::string fileName;
+		};
+	}
+
+	/** Images saved by a pool of threads, the queue is bounded so that rendering can't outrun encoding indefinitely. */
+	class CameraRecorder::ImageWriter
+	{
+	public:
+		ImageWriter(int threads, size_t maxQueued) : _maxQueued(maxQueued)
+		{
+			for (int t = 0; t < threads; ++t)
+				_threads.emplace_back([this]() { work(); });
+		}
+
+		~ImageWriter()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_done = true;
+			}
+			_pushed.notify_all();
+			for (std::thread & thread : _threads)
+				thread.join();
+		}
+
+		void push(ImageRGBA32F::Ptr image, const std::string & fileName)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_popped.wait(lock, [this]() { return _queue.size() < _maxQueued; });
+			_queue.emplace_back(std::move(image), fileName);
+			lock.unlock();
+			_pushed.notify_one();
+		}
+
+	private:
+		void work()
+		{
+			while (true)
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_pushed.wait(lock, [this]() { return _done || !_queue.empty(); });
+				if (_queue.empty())
+					return;
+				auto job = std::move(_queue.front());
+				_queue.pop_front();
+				lock.unlock();
+				_popped.notify_one();
+				saveFrame(*job.first, job.second);
+			}
+		}
+
+		size_t _maxQueued;
+		bool _done = false;
+		std::deque<std::pair<ImageRGBA32F::Ptr, std::string>> _queue;
+		std::mutex _mutex;
+		std::condition_variable _pushed, _popped;
+		std::vector<std::thread> _threads;
+	};
+
 	void	CameraRecorder::use(Camera& cam)
 	{
+		const bool precomputed = !_frames.empty() && !_playNoInterp;
+		const size_t count = precomputed ? _frames.size() : _cameras.size();
+
 		if (_recording) {
 			_cameras.push_back(cam);
+			// Only a path recorded from scratch is timed.
+			if (_timestamps.size() + 1 == _cameras.size()) {
+				_timestamps.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - _recordStart).count());
+			}
 		} 
-		else if (_playing && _pos < _cameras.size() ) {
+		else if (_playing && _pos < count ) {
 			const float znear = cam.znear();
 			const float zfar = cam.zfar();
 
-			if( !_playNoInterp ) {
+			if (precomputed) {
+				cam = _frames[_pos];
+				_pos++;
+			}
+			else if( !_playNoInterp ) {
 				//std::cout << _playing << std::endl;
 				// If we reach the last frame of the interpolation b/w two cameras, skip to next camera.
 				if (_interp > (1.0f - _speed))
@@ -65,7 +192,7 @@ namespace sibr
 			if (_savingVideo) {
 				cam.setDebugVideo(true);
 			}
-			if (_pos >= _cameras.size())
+			if (_pos >= count)
 			{
 				stop();
 				SIBR_LOG << "[CameraRecorder] - Playback Finished" << std::endl;
@@ -89,6 +216,10 @@ namespace sibr
 	{
 		stop();
 		_recording = true;
+		_frames.clear();
+		// Resume the timeline after the last recorded camera.
+		const double resumeTime = _timestamps.empty() ? 0.0 : _timestamps.back() + 1.0 / double(_framerate);
+		_recordStart = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(resumeTime));
 		SIBR_LOG << "[CameraRecorder] - Recording" << std::endl;
 	}
 
@@ -121,10 +252,15 @@ namespace sibr
 	{
 		stop();
 		_cameras.clear();
+		_timestamps.clear();
+		_frames.clear();
 	}
 
 	bool	CameraRecorder::load(const std::string& filename)
 	{
+		if (boost::filesystem::extension(filename) == SIBR_CAMERARECORDER_BINARYEXTENSION)
+			return loadBinary(filename);
+
 		reset();
 
 		sibr::ByteStream stream;
@@ -160,6 +296,143 @@ namespace sibr
 		SIBR_LOG << "[CameraRecorder] - Saved " << num << " cameras to " << filename << std::endl;
 	}
 
+	bool	CameraRecorder::loadBinary(const std::string& filename)
+	{
+		reset();
+
+		MappedFile file;
+		if (!file.open(filename) || file.size() < sizeof(PathHeader)) {
+			SIBR_WRG << "[CameraRecorder] - Unable to open " << filename << std::endl;
+			return false;
+		}
+		PathHeader header;
+		std::memcpy(&header, file.data(), sizeof(PathHeader));
+		if (std::memcmp(header.magic, kPathMagic, sizeof(kPathMagic)) != 0 || header.version != kPathVersion) {
+			SIBR_WRG << "[CameraRecorder] - " << filename << " is not a binary camera path (version " << kPathVersion << ")." << std::endl;
+			return false;
+		}
+		if (file.size() < sizeof(PathHeader) + size_t(header.frameCount) * sizeof(FrameRecord)) {
+			SIBR_WRG << "[CameraRecorder] - " << filename << " is truncated." << std::endl;
+			return false;
+		}
+		file.prefetch();
+
+		const FrameRecord * records = reinterpret_cast<const FrameRecord*>(file.data() + sizeof(PathHeader));
+		const int frameCount = int(header.frameCount);
+		_cameras.resize(frameCount);
+		_timestamps.resize(frameCount);
+#pragma omp parallel for
+		for (int i = 0; i < frameCount; ++i) {
+			const FrameRecord & record = records[i];
+			Camera & cam = _cameras[i];
+			cam.position(Vector3f(record.position[0], record.position[1], record.position[2]));
+			cam.rotation(Quaternionf(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]));
+			cam.fovy(record.fovy);
+			cam.aspect(record.aspect);
+			cam.znear(record.znear);
+			cam.zfar(record.zfar);
+			cam.principalPoint(Vector2f(record.principalPoint[0], record.principalPoint[1]));
+			_timestamps[i] = record.timestamp;
+		}
+
+		resample(_framerate);
+		SIBR_LOG << "[CameraRecorder] - Loaded " << frameCount << " cameras from " << filename << ", " << _frames.size() << " frames at " << _framerate << "fps." << std::endl;
+		return true;
+	}
+
+	bool	CameraRecorder::saveBinary(const std::string& filename) const
+	{
+		PathHeader header;
+		std::memset(&header, 0, sizeof(PathHeader));
+		std::memcpy(header.magic, kPathMagic, sizeof(kPathMagic));
+		header.version = kPathVersion;
+		header.frameCount = uint32_t(_cameras.size());
+
+		const std::vector<double> times = cameraTimes();
+		std::vector<FrameRecord> records(_cameras.size());
+		std::memset(records.data(), 0, records.size() * sizeof(FrameRecord));
+		for (size_t i = 0; i < _cameras.size(); ++i) {
+			const Camera & cam = _cameras[i];
+			FrameRecord & record = records[i];
+			record.timestamp = times[i];
+			for (int c = 0; c < 3; ++c) {
+				record.position[c] = cam.position()[c];
+			}
+			const Quaternionf & q = cam.rotation();
+			record.rotation[0] = q.w();
+			record.rotation[1] = q.x();
+			record.rotation[2] = q.y();
+			record.rotation[3] = q.z();
+			record.fovy = cam.fovy();
+			record.aspect = cam.aspect();
+			record.znear = cam.znear();
+			record.zfar = cam.zfar();
+			record.principalPoint[0] = cam.principalPoint()[0];
+			record.principalPoint[1] = cam.principalPoint()[1];
+		}
+
+		std::ofstream outfile(filename, std::ios_base::binary);
+		if (!outfile.is_open()) {
+			SIBR_WRG << "[CameraRecorder] - Unable to write " << filename << std::endl;
+			return false;
+		}
+		outfile.write(reinterpret_cast<const char*>(&header), sizeof(PathHeader));
+		outfile.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(FrameRecord)));
+		if (!outfile.good()) {
+			SIBR_WRG << "[CameraRecorder] - Unable to write " << filename << std::endl;
+			return false;
+		}
+		SIBR_LOG << "[CameraRecorder] - Saved " << records.size() << " cameras to " << filename << std::endl;
+		return true;
+	}
+
+	std::vector<double> CameraRecorder::cameraTimes() const
+	{
+		if (_timestamps.size() == _cameras.size()) {
+			return _timestamps;
+		}
+		// Same spacing as the interpolation on the fly: 1/speed frames between two cameras.
+		const double step = 1.0 / (double(_framerate) * double(_speed > 0.0f ? _speed : 1.0f));
+		std::vector<double> times(_cameras.size());
+		for (size_t i = 0; i < times.size(); ++i) {
+			times[i] = double(i) * step;
+		}
+		return times;
+	}
+
+	void	CameraRecorder::resample(float fps)
+	{
+		_frames.clear();
+		if (_cameras.empty() || fps <= 0.0f) {
+			return;
+		}
+		const std::vector<double> times = cameraTimes();
+		const double duration = std::max(times.back() - times.front(), 0.0);
+		const int frameCount = int(std::floor(duration * double(fps))) + 1;
+		const int last = int(_cameras.size()) - 1;
+
+		_frames.resize(frameCount);
+#pragma omp parallel for
+		for (int f = 0; f < frameCount; ++f) {
+			const double t = times.front() + double(f) / double(fps);
+			const int next = int(std::upper_bound(times.begin(), times.end(), t) - times.begin());
+			const int a = std::min(std::max(next - 1, 0), last);
+			const int b = std::min(a + 1, last);
+			const double span = times[b] - times[a];
+			const float k = span > 0.0 ? float((t - times[a]) / span) : 0.0f;
+			_frames[f] = Camera::interpolate(_cameras[a], _cameras[b], k);
+		}
+	}
+
+	void	CameraRecorder::playbackFramerate(float fps)
+	{
+		_framerate = fps;
+		if (!_frames.empty()) {
+			stop();
+			resample(_framerate);
+		}
+	}
+
 	bool CameraRecorder::safeLoad(const std::string & filename, int w, int h)
 	{
 		Path path = Path(filename);
@@ -169,6 +442,8 @@ namespace sibr
 			return true;
 		} else if (path.extension().string() == ".path") {
 			return load(filename);
+		} else if (path.extension().string() == SIBR_CAMERARECORDER_BINARYEXTENSION) {
+			return loadBinary(filename);
 		} 
 		SIBR_WRG << "Unable to load camera path" << std::endl;
 		return false;
@@ -178,6 +453,7 @@ namespace sibr
 	{
 		const std::string bundlerFile = filePath;
 		SIBR_LOG << "Loading bundle path." << std::endl;
+		_frames.clear();
 
 		// check bundler file
 		std::ifstream bundle_file(bundlerFile);
@@ -215,6 +491,7 @@ namespace sibr
 	void CameraRecorder::loadColmap(const std::string &filePath, int w, int h)
 	{
 		SIBR_LOG << "Loading colmap path." << std::endl;
+		_frames.clear();
 		boost::filesystem::path colmapDir ( filePath );
 
 		SIBR_LOG << "DEBUG: colmap path dir " << colmapDir.parent_path().string() << std::endl;
@@ -229,6 +506,7 @@ namespace sibr
 	void CameraRecorder::loadLookat(const std::string &filePath, int w, int h)
 	{
 		SIBR_LOG << "Loading lookat path." << std::endl;
+		_frames.clear();
 		std::vector<InputCamera::Ptr> path = InputCamera::loadLookat(filePath, std::vector<Vector2u>{Vector2u(w, h)});
 		for (const InputCamera::Ptr cam : path)
 		{
@@ -425,18 +703,62 @@ namespace sibr
 		return true;
 	}
 
-	void CameraRecorder::recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix) {
+	void CameraRecorder::recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix, int framesInFlight) {
+		OfflineOptions options;
+		options.framesInFlight = framesInFlight;
+		recordOfflinePath(outPathDir, view, prefix, options);
+	}
+
+	void CameraRecorder::recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix, const OfflineOptions & options) {
+		OfflineView offlineView;
+		offlineView.view = view;
+		offlineView.prefix = prefix;
+		offlineView.frameSink = options.frameSink;
+		recordOfflinePath(outPathDir, std::vector<OfflineView>{ offlineView }, options);
+	}
+
+	void CameraRecorder::recordOfflinePath(const std::string& outPathDir, const std::vector<OfflineView> & views, const OfflineOptions & options) {
+		std::vector<std::string> outPathDirs;
+		for (const OfflineView & view : views) {
+			outPathDirs.push_back(offlineDirectory(outPathDir, view.prefix));
+			std::cout << "Rendering path with " << _cameras.size() << " cameras to " << outPathDirs.back() << std::endl;
+		}
+
+		if (options.framesInFlight > 1) {
+			renderPipelined(outPathDirs, views, options);
+			std::cout << "Done rendering path. " << std::endl;
+			return;
+		}
+
 		sibr::ImageRGBA32F::Ptr outImage;
 		outImage.reset(new ImageRGBA32F(_ow, _oh));
-		std::string outpathd = outPathDir;
-
 		sibr::RenderTargetRGBA32F::Ptr outFrame;
 		outFrame.reset(new RenderTargetRGBA32F(_ow, _oh));
 		std::string outFileName;
 
-		boost::filesystem::path dstFolder;
+		for (int i = 0; i < _cameras.size(); ++i) {
+			for (size_t v = 0; v < views.size(); ++v) {
+				outFrame->clear();
+				views[v].view->onRenderIBR(*outFrame, _cameras[i]);
+				if (views[v].frameSink)
+					views[v].frameSink(*outFrame);
+				if (options.saveImages) {
+					outFileName = frameFileName(outPathDirs[v], i, options.extension);
+					std::cout << outFileName << " " << std::endl;
+					outFrame->readBack(*outImage);
+					saveFrame(*outImage, outFileName);
+				}
+			}
+		}
+		std::cout << std::endl;
 
-		outpathd = outPathDir;
+		std::cout << "Done rendering path. " << std::endl;
+
+	}
+
+	std::string CameraRecorder::offlineDirectory(const std::string& outPathDir, const std::string& prefix) const {
+		std::string outpathd = outPathDir;
+		boost::filesystem::path dstFolder;
 
 		if (outPathDir == "pathOutput" && _savingPath != "") { // default to path parent, saved by loadPath
 			outpathd = _savingPath + "/" + "pathOutput";
@@ -452,23 +774,96 @@ namespace sibr
 
 		if (!directoryExists(outpathd) && !boost::filesystem::create_directories(dstFolder))
 			SIBR_ERR << "Error creating directory " << dstFolder << std::endl;
+		return outpathd;
+	}
 
-		std::cout << "Rendering path with " << _cameras.size() << " cameras to " << outpathd << std::endl;
+	void CameraRecorder::renderPipelined(const std::vector<std::string>& outPathDirs, const std::vector<OfflineView> & views, const OfflineOptions & options) {
+		// Frame i is rendered while the readback of the previous frames completes in pixel buffers,
+		// and the frames already read back are encoded by the writer threads.
+		// Each view has its own frames, the views render a camera in turn: the readbacks of one view
+		// overlap the rendering of the others.
+		const int framesInFlight = options.framesInFlight;
+		const int viewCount = int(views.size());
+		const int rowSize = 4 * _ow;
+		const size_t bytes = sizeof(float) * rowSize * _oh;
+		std::vector<FrameInFlight> frames(size_t(framesInFlight) * viewCount);
+		for (FrameInFlight & frame : frames) {
+			frame.target.reset(new RenderTargetRGBA32F(_ow, _oh));
+			if (!options.saveImages)
+				continue;
+			glGenBuffers(1, &frame.pbo);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		const int threads = options.saveImages ? std::max(1, int(std::thread::hardware_concurrency()) - 1) : 0;
+		ImageWriter writer(threads, size_t(2 * framesInFlight * viewCount));
+
+		// Wait for the readback of a frame, and hand the image to the writers.
+		const auto retire = [&](FrameInFlight & frame) {
+			glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+			glDeleteSync(frame.fence);
+			frame.fence = 0;
+
+			ImageRGBA32F::Ptr image(new ImageRGBA32F(_ow, _oh));
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pbo);
+			const float* pixels = static_cast<const float*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+			if (pixels) {
+				// GL rows are bottom to top.
+				float* dst = static_cast<float*>(image->data());
+				for (int y = 0; y < int(_oh); ++y)
+					std::memcpy(dst + size_t(y) * rowSize, pixels + size_t(_oh - 1 - y) * rowSize, sizeof(float) * rowSize);
+			}
+			else {
+				SIBR_WRG << "Unable to map the readback of " << frame.fileName << std::endl;
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			writer.push(image, frame.fileName);
+		};
 
 		for (int i = 0; i < _cameras.size(); ++i) {
-			outFrame->clear();
-			std::ostringstream ssZeroPad;
-			ssZeroPad << std::setw(8) << std::setfill('0') << i;
-			outFileName = outpathd + "/" +  ssZeroPad.str() + ".png";
-			std::cout << outFileName << " " << std::endl;
-			view->onRenderIBR(*outFrame, _cameras[i]);
-			outFrame->readBack(*outImage);
-			outImage->save(outFileName, false);
+			for (int v = 0; v < viewCount; ++v) {
+				FrameInFlight & frame = frames[(i % framesInFlight) * viewCount + v];
+				if (frame.fence)
+					retire(frame);
+
+				frame.target->clear();
+				views[v].view->onRenderIBR(*frame.target, _cameras[i]);
+				// The video encoder does its own asynchronous readback.
+				if (views[v].frameSink)
+					views[v].frameSink(*frame.target);
+				if (!options.saveImages)
+					continue;
+
+				frame.fileName = frameFileName(outPathDirs[v], i, options.extension);
+				std::cout << frame.fileName << " " << std::endl;
+
+				// Queue the readback without waiting for it.
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, frame.target->fbo());
+				glReadBuffer(GL_COLOR_ATTACHMENT0);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pbo);
+				glReadPixels(0, 0, _ow, _oh, GL_RGBA, GL_FLOAT, nullptr);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+				frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
 		}
-		std::cout << std::endl;
-
-		std::cout << "Done rendering path. " << std::endl;
 
+		// Oldest frames first.
+		for (int i = 0; i < framesInFlight; ++i) {
+			for (int v = 0; v < viewCount; ++v) {
+				FrameInFlight & frame = frames[((int(_cameras.size()) + i) % framesInFlight) * viewCount + v];
+				if (frame.fence)
+					retire(frame);
+			}
+		}
+		for (FrameInFlight & frame : frames) {
+			if (frame.pbo)
+				glDeleteBuffers(1, &frame.pbo);
+		}
+		std::cout << std::endl;
 	}
 
 	void CameraRecorder::saveImage(const std::string& outPathDir, const Camera& cam, int w, int h) {
@@ -507,7 +902,10 @@ namespace sibr
 		std::cout << outFileName << " " << std::endl;
 		_view->onRenderIBR(*outFrame, cam);
 		outFrame->readBack(*outImage);
-		outImage->save(outFileName, false);
+		// Don't stall the interface on the encoding.
+		if (!_writer)
+			_writer = std::make_shared<ImageWriter>(1, size_t(4));
+		_writer->push(outImage, outFileName);
 		std::cout << std::endl;
 		std::cout << "Done saving image. " << std::endl;
 	}
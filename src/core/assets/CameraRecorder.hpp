@@ -12,6 +12,9 @@
 
 #pragma once
 
+# include <chrono>
+# include <functional>
+# include <memory>
 # include <vector>
 # include "core/assets/Config.hpp"
 # include "core/graphics/Camera.hpp"
@@ -19,6 +22,8 @@
 
 
 # define SIBR_CAMERARECORDER_DEFAULTFILE "camera-record.bytes"
+# define SIBR_CAMERARECORDER_BINARYEXTENSION ".campath"
+# define SIBR_CAMERARECORDER_FRAMERATE 60.0f
 
 namespace sibr
 {
@@ -29,6 +34,21 @@ namespace sibr
 	{
 	public:
 
+		/** Offline path rendering options. */
+		struct OfflineOptions {
+			int framesInFlight = 3; ///< Frames rendered before the first one is read back, 1 to render and save each frame in turn.
+			std::string extension = ".png"; ///< Format of the saved frames, ".exr" and ".hdr" keep the float values.
+			bool saveImages = true; ///< Save each frame as an image.
+			std::function<void(const IRenderTarget &)> frameSink; ///< Called with each rendered frame on the GL thread, for instance to feed an FFVideoEncoder.
+		};
+
+		/** A view rendering the path along with others, see recordOfflinePath. */
+		struct OfflineView {
+			ViewBase::Ptr view; ///< The view.
+			std::string prefix; ///< Subdirectory of the output directory receiving its frames, if not empty.
+			std::function<void(const IRenderTarget &)> frameSink; ///< Called with each frame of the view, replaces OfflineOptions::frameSink.
+		};
+
 		/**
 		Default constructor.
 		*/
@@ -52,6 +72,7 @@ namespace sibr
 
 		/**
 		Start playing the recorded camera stream from the beginning, at a rate of one step for each "use" call.
+		If the path has been resampled, each step is one precomputed frame, else the cameras are interpolated on the fly.
 		*/
 		void	playback( void );
 		
@@ -96,6 +117,7 @@ namespace sibr
 		\param filename Optional path to the file to load from. By default will try to 
 				load SIBR_CAMERARECORDER_DEFAULTFILE from the current directory.
 		\return a boolean denoting the loading success/failure.
+		\note Files with the SIBR_CAMERARECORDER_BINARYEXTENSION extension are loaded with loadBinary.
 		*/
 		bool	load( const std::string& filename=SIBR_CAMERARECORDER_DEFAULTFILE );
 
@@ -106,6 +128,46 @@ namespace sibr
 		*/
 		void	save( const std::string& filename=SIBR_CAMERARECORDER_DEFAULTFILE );
 
+		/**
+		Load a timed camera stream saved with saveBinary. The file is memory mapped and the frames
+		are copied as is, then the path is resampled at the playback framerate.
+		\param filename path to the file
+		\return a boolean denoting the loading success/failure.
+		*/
+		bool	loadBinary(const std::string& filename);
+
+		/**
+		Save the current recording stream in a compact binary format: a timestamp and a packed camera per frame.
+		Cameras recorded with record() keep their capture time, the others are spaced by the current playback step.
+		\param filename path to the file to write to
+		\return a boolean denoting the saving success/failure.
+		*/
+		bool	saveBinary(const std::string& filename) const;
+
+		/**
+		Precompute the frames played back, by interpolating the recorded cameras at a fixed framerate.
+		Playback then reads one frame per "use" call, independently of the speed and of the interpolation state.
+		\param fps the number of frames per second of path time
+		\note Changing the recorded cameras again (record, cams, load...) discards the precomputed frames.
+		*/
+		void	resample(float fps);
+
+		/**
+		\return true if playback uses precomputed frames.
+		*/
+		bool	isResampled() const { return !_frames.empty(); }
+
+		/**
+		\return the framerate used when resampling a loaded binary path.
+		*/
+		float	playbackFramerate() const { return _framerate; }
+
+		/**
+		Set the framerate used when resampling a loaded binary path, resamples the current path if needed.
+		\param fps the number of frames per second
+		*/
+		void	playbackFramerate(float fps);
+
 		/** Load recorded path based on file extension.
 		 *\param filename the file to load
 		 *\param w resoltuion width
@@ -186,7 +248,7 @@ namespace sibr
 		/**
 		Updates the cameras from a vector, usefull to play already loaded path.
 		*/
-		void cams(std::vector<Camera>& cams) { _cameras = cams; }
+		void cams(std::vector<Camera>& cams) { _cameras = cams; _timestamps.clear(); _frames.clear(); }
 
 
 		/**
@@ -196,14 +258,45 @@ namespace sibr
 
 		/**
 		Play path for offline rendering using abstract View interface
+		\param outPathDir destination directory
+		\param view the view rendering each camera
+		\param prefix subdirectory of outPathDir, if not empty
+		\param framesInFlight frames rendered before the first one is read back; above 1, readbacks are
+		asynchronous and images are encoded by a pool of threads while the next frames render
+		*/
+		void recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix, int framesInFlight = 3);
+
+		/**
+		Play path for offline rendering using abstract View interface
+		\param outPathDir destination directory
+		\param view the view rendering each camera
+		\param prefix subdirectory of outPathDir, if not empty
+		\param options pipelining, output format and frame sink
+		*/
+		void recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix, const OfflineOptions & options);
+
+		/**
+		Play path for offline rendering in several views at once: each camera is rendered by all the views in turn,
+		so the views share the scene and the path is played once. The readbacks of all the views are pipelined
+		and their images encoded by the same pool of threads.
+		\param outPathDir destination directory
+		\param views the views rendering each camera, with their subdirectories
+		\param options pipelining and output format, the frame sink is given per view
 		*/
-		void recordOfflinePath(const std::string& outPathDir, ViewBase::Ptr view, const std::string& prefix);
+		void recordOfflinePath(const std::string& outPathDir, const std::vector<OfflineView> & views, const OfflineOptions & options);
 
 		/**
 		Save an image
 		*/
 		void setViewPath(ViewBase::Ptr view, const std::string& dataset_path) { _view = view; _dsPath = dataset_path;  };
 
+		/**
+		Render a camera with the saved view and save the image. The image is encoded on a background thread.
+		\param outPathDir destination directory, defaults to pathOutput in the dataset directory
+		\param cam the camera
+		\param w image width
+		\param h image height
+		*/
 		void saveImage(const std::string& outPathDir, const Camera& cam, int w, int h);
 
 		/**
@@ -212,10 +305,35 @@ namespace sibr
 		float & speed() { return _speed; }
 
 	private:
+
+		/** \return the time of each recorded camera, in seconds, synthesized from the playback step if the cameras were not timed. */
+		std::vector<double> cameraTimes() const;
+
+		/** Pool of threads saving images. */
+		class ImageWriter;
+
+		/** Create the destination directory of an offline rendering.
+		\param outPathDir destination directory, "pathOutput" for the directory of the loaded path
+		\param prefix subdirectory of outPathDir, if not empty
+		\return the directory
+		*/
+		std::string offlineDirectory(const std::string& outPathDir, const std::string& prefix) const;
+
+		/** Pipelined rendering of the path, see recordOfflinePath.
+		\param outPathDirs destination directory of each view
+		\param views the views
+		\param options the rendering options
+		*/
+		void renderPipelined(const std::vector<std::string>& outPathDirs, const std::vector<OfflineView> & views, const OfflineOptions & options);
+
 		std::string				_dsPath; // path to dataset
 		ViewBase::Ptr			_view; // view to save images
 		uint					_pos; ///< Current camera ID for replay.
 		std::vector<Camera>		_cameras; ///< List of recorded cameras.
+		std::vector<double>		_timestamps; ///< Time of each recorded camera in seconds, empty if the cameras are not timed.
+		std::vector<Camera>		_frames; ///< Precomputed playback frames, empty to interpolate on the fly.
+		float					_framerate = SIBR_CAMERARECORDER_FRAMERATE; ///< Framerate of the precomputed frames.
+		std::chrono::steady_clock::time_point _recordStart; ///< Time origin of the current recording.
 		bool					_recording; ///< Are we currently recording.
 		bool					_playing; ///< Are we currently playing.
 		bool					_saving; ///< Are we saving the path as images.
@@ -226,6 +344,7 @@ namespace sibr
 		float					_interp; ///< Current interpoaltion factor.
 		bool					_playNoInterp; ///< Just play the cameras, make sure focal is preserved
 		int						_ow, _oh; ///< offline output path resolution
+		std::shared_ptr<ImageWriter> _writer; ///< Saves the images of saveImage in the background.
 	};
 
 	///// DEFINITIONS /////
@@ -13,10 +13,14 @@
 #pragma once
 
 
+# include <atomic>
+# include <functional>
+# include <future>
 # include "core/graphics/Image.hpp"
 # include "core/assets/Config.hpp"
 # include "core/assets/IFileLoader.hpp"
 # include "core/assets/ActiveImageFile.hpp"
+# include "core/system/ThreadPool.hpp"
 
 namespace sibr
 {
@@ -36,6 +40,54 @@ namespace sibr
 			uint			height; ///< Image height.
 		};
 
+		/** Images loaded in the background by loadImagesAsync.
+		 Each image has a future, resolved once it is loaded; the images that were
+		 cancelled or are not active resolve to an empty image.
+		 */
+		template <class TImage>
+		class AsyncImages
+		{
+		public:
+			typedef std::shared_ptr<AsyncImages>	Ptr;
+
+			/** \return the number of images. */
+			size_t						size( void ) const { return _futures.size(); }
+
+			/** Future of an image.
+			 * \param i the image index
+			 * \return the future, resolved to an empty image if the image was cancelled or not active
+			 */
+			const std::shared_future<TImage>&	image( size_t i ) const { return _futures[i]; }
+
+			/** \return true if the image is resolved, without blocking.
+			 * \param i the image index
+			 */
+			bool						isReady( size_t i ) const { return _futures[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+			/** \return the number of resolved images. */
+			size_t						resolvedCount( void ) const { return _resolved; }
+
+			/** \return true if all images are resolved. */
+			bool						isDone( void ) const { return _resolved == _futures.size(); }
+
+			/** Block until all images are resolved. */
+			void						wait( void ) const { for (const auto & future : _futures) future.wait(); }
+
+			/** Skip the images whose loading has not started yet. */
+			void						cancel( void ) { _cancelled = true; }
+
+			/** \return true if the loading was cancelled. */
+			bool						isCancelled( void ) const { return _cancelled; }
+
+		private:
+			friend class ImageListFile;
+
+			std::vector<std::promise<TImage>>		_promises; ///< One per image, set by the loading tasks.
+			std::vector<std::shared_future<TImage>>	_futures; ///< One per image.
+			std::atomic<bool>						_cancelled = { false }; ///< Skip the remaining images.
+			std::atomic<size_t>						_resolved = { 0 }; ///< Number of resolved images.
+		};
+
 	public:
 
 		/** Load the list file from disk.
@@ -68,6 +120,19 @@ namespace sibr
 		*/
 		template <class TImage>
 		std::vector<TImage>			loadImages( const ActiveImageFile& ac) const;
+
+		/** Load images in the background, without blocking.
+			\param priorities optional priority of each image, higher loads first (for instance minus the distance to the current view)
+			\param onLoaded optional callback, called on a pool thread with the index and the image once it is loaded
+			\param ac optional active images filter, non-active images resolve to empty images
+			\param pool the threads to load on
+			\return the loading handle, giving a future per image
+			\note Loading goes on if the handle is released, use AsyncImages::cancel to stop it.
+		*/
+		template <class TImage>
+		typename AsyncImages<TImage>::Ptr	loadImagesAsync( const std::vector<float>& priorities = {},
+			const std::function<void(size_t, const TImage&)>& onLoaded = nullptr,
+			const ActiveImageFile* ac = nullptr, ThreadPool& pool = ThreadPool::shared() ) const;
 		
 
 	private:
@@ -117,4 +182,38 @@ namespace sibr
 		return out;
 	}
 
+	template <class TImage>
+	typename ImageListFile::AsyncImages<TImage>::Ptr	ImageListFile::loadImagesAsync( const std::vector<float>& priorities,
+		const std::function<void(size_t, const TImage&)>& onLoaded, const ActiveImageFile* ac, ThreadPool& pool ) const {
+		const auto images = std::make_shared<AsyncImages<TImage>>();
+		images->_promises.resize(_infos.size());
+		images->_futures.resize(_infos.size());
+		for (size_t i = 0; i < _infos.size(); ++i)
+			images->_futures[i] = images->_promises[i].get_future().share();
+
+		if (_infos.empty())
+			SIBR_WRG << "cannot load images (ImageListFile is empty. Did you use ImageListFile::load(...) before ?";
+
+		for (size_t i = 0; i < _infos.size(); ++i) {
+			if (ac && !ac->active()[i]) {
+				images->_promises[i].set_value(TImage());
+				++images->_resolved;
+				continue;
+			}
+			const std::string path = _basename + "/" + _infos[i].filename;
+			const float priority = i < priorities.size() ? priorities[i] : 0.0f;
+			pool.push([images, i, path, onLoaded]() {
+				TImage image;
+				const bool load = !images->_cancelled;
+				if (load)
+					image.load(path, false);
+				images->_promises[i].set_value(std::move(image));
+				if (load && onLoaded)
+					onLoaded(i, images->_futures[i].get());
+				++images->_resolved;
+			}, priority);
+		}
+		return images;
+	}
+
 } // namespace sibr
@@ -13,8 +13,12 @@
 #include "core/assets/ActiveImageFile.hpp"
 #include "core/assets/InputCamera.hpp"
 #include <boost/algorithm/string.hpp>
+#include <cstring>
 #include <map>
+#include "core/system/MappedFile.hpp"
 #include "core/system/String.hpp"
+#include "core/system/TextScanner.hpp"
+#include "core/system/Utils.hpp"
 #include "picojson/picojson.hpp"
 
 
@@ -31,6 +35,58 @@ typedef uint32_t point2D_t;
 
 namespace sibr
 {
+	namespace
+	{
+		/** Share cameras stored contiguously: one allocation for the whole dataset,
+		 each pointer keeps the block alive.
+		 */
+		std::vector<InputCamera::Ptr> shareCameras(std::vector<InputCamera> && cameras)
+		{
+			const auto block = std::make_shared<std::vector<InputCamera>>(std::move(cameras));
+			std::vector<InputCamera::Ptr> pointers(block->size());
+			for (size_t cid = 0; cid < block->size(); ++cid) {
+				pointers[cid] = InputCamera::Ptr(block, &(*block)[cid]);
+			}
+			return pointers;
+		}
+
+		/** Read little endian values from a memory mapped Colmap binary file. */
+		struct BinaryCursor
+		{
+			BinaryCursor(const char * begin, const char * end) : pos(begin), end(end) {}
+
+			/** \return true if at least size bytes are left. */
+			bool has(size_t size) const { return size_t(end - pos) >= size; }
+
+			template<typename T>
+			T read()
+			{
+				T value;
+				std::memcpy(&value, pos, sizeof(T));
+				pos += sizeof(T);
+				return LittleEndianToNative(value);
+			}
+
+			const char * pos;
+			const char * end;
+		};
+
+		/** \return the number of parameters of a Colmap camera model, -1 if unknown. */
+		int colmapModelParameterCount(int modelId)
+		{
+			// SIMPLE_PINHOLE, PINHOLE, SIMPLE_RADIAL, RADIAL, OPENCV, OPENCV_FISHEYE,
+			// FULL_OPENCV, FOV, SIMPLE_RADIAL_FISHEYE, RADIAL_FISHEYE, THIN_PRISM_FISHEYE
+			static const int counts[] = { 3, 4, 4, 5, 8, 8, 12, 5, 4, 5, 12 };
+			return (modelId >= 0 && modelId < int(sizeof(counts) / sizeof(counts[0]))) ? counts[modelId] : -1;
+		}
+
+		/** \return true if a Colmap camera model has a single focal length. */
+		bool colmapModelHasSingleFocal(int modelId)
+		{
+			return modelId == 0 || modelId == 2 || modelId == 3 || modelId == 8 || modelId == 9;
+		}
+	}
+
 	InputCamera::InputCamera(float f, float k1, float k2, int w, int h, int id) :
 		_focal(f), _k1(k1), _k2(k2), _w(w), _h(h), _id(id), _active(true), _name(""), _focalx(FOCAL_X_UNDEFINED)
 	{
@@ -311,142 +367,176 @@ namespace sibr
 
 	std::vector<InputCamera::Ptr> InputCamera::loadNVM(const std::string& nvmPath, float zNear, float zFar, std::vector<sibr::Vector2u> wh)
 	{
-		std::ifstream in(nvmPath);
-		std::vector<InputCamera::Ptr> cameras;
+		MappedFile in(nvmPath);
 
-		if (in.is_open())
+		if (!in.isOpen())
 		{
-			int rotation_parameter_num = 4;
-			bool format_r9t = false;
-			std::string token;
-			if (in.peek() == 'N')
+			SIBR_WRG << "Cannot open '" << nvmPath << std::endl;
+			return std::vector<InputCamera::Ptr>();
+		}
+
+		TextScanner nvmText(in.data(), in.data() + in.size());
+		int rotation_parameter_num = 4;
+		bool format_r9t = false;
+		std::string token;
+		nvmText.skipSpaces();
+		if (!nvmText.atEnd() && *nvmText.position() == 'N')
+		{
+			nvmText.token(token); //file header
+			if (strstr(token.c_str(), "R9T"))
 			{
-				in >> token; //file header
-				if (strstr(token.c_str(), "R9T"))
-				{
-					rotation_parameter_num = 9;    //rotation as 3x3 matrix
-					format_r9t = true;
-				}
+				rotation_parameter_num = 9;    //rotation as 3x3 matrix
+				format_r9t = true;
 			}
+		}
 
-			int ncam = 0, npoint = 0, nproj = 0;
-			// read # of cameras
-			in >> ncam;  if (ncam <= 1) return std::vector<InputCamera::Ptr>();
+		int ncam = 0, npoint = 0, nproj = 0;
+		// read # of cameras
+		nvmText.read(ncam);  if (ncam <= 1) return std::vector<InputCamera::Ptr>();
+
+		// One camera per line, parsed in parallel: reading the image resolutions dominates.
+		std::vector<TextScanner> cameraLines;
+		cameraLines.reserve(ncam);
+		TextScanner line;
+		while (int(cameraLines.size()) < ncam && nvmText.nextLine(line)) {
+			if (!line.isBlank()) {
+				cameraLines.push_back(line);
+			}
+		}
+		if (int(cameraLines.size()) < ncam) {
+			SIBR_WRG << "Truncated NVM file '" << nvmPath << "'." << std::endl;
+			return std::vector<InputCamera::Ptr>();
+		}
 
-			//read the camera parameters
+		//read the camera parameters
 
-			std::function<Eigen::Matrix3f(const double[9])> matrix = [](const double q[9])
-			{
+		std::function<Eigen::Matrix3f(const double[9])> matrix = [](const double q[9])
+		{
 
-				Eigen::Matrix3f m;
-				double qq = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
-				double qw, qx, qy, qz;
-				if (qq > 0)
-				{
-					qw = q[0] / qq;
-					qx = q[1] / qq;
-					qy = q[2] / qq;
-					qz = q[3] / qq;
-				}
-				else
-				{
-					qw = 1;
-					qx = qy = qz = 0;
-				}
-				m(0, 0) = float(qw * qw + qx * qx - qz * qz - qy * qy);
-				m(0, 1) = float(2 * qx * qy - 2 * qz * qw);
-				m(0, 2) = float(2 * qy * qw + 2 * qz * qx);
-				m(1, 0) = float(2 * qx * qy + 2 * qw * qz);
-				m(1, 1) = float(qy * qy + qw * qw - qz * qz - qx * qx);
-				m(1, 2) = float(2 * qz * qy - 2 * qx * qw);
-				m(2, 0) = float(2 * qx * qz - 2 * qy * qw);
-				m(2, 1) = float(2 * qy * qz + 2 * qw * qx);
-				m(2, 2) = float(qz * qz + qw * qw - qy * qy - qx * qx);
-
-				return m;
-			};
-
-			for (int i = 0; i < ncam; ++i)
+			Eigen::Matrix3f m;
+			double qq = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+			double qw, qx, qy, qz;
+			if (qq > 0)
+			{
+				qw = q[0] / qq;
+				qx = q[1] / qq;
+				qy = q[2] / qq;
+				qz = q[3] / qq;
+			}
+			else
 			{
-				double f, q[9], c[3], d[2];
-				in >> token >> f;
-				for (int j = 0; j < rotation_parameter_num; ++j) in >> q[j];
-				in >> c[0] >> c[1] >> c[2] >> d[0] >> d[1];
+				qw = 1;
+				qx = qy = qz = 0;
+			}
+			m(0, 0) = float(qw * qw + qx * qx - qz * qz - qy * qy);
+			m(0, 1) = float(2 * qx * qy - 2 * qz * qw);
+			m(0, 2) = float(2 * qy * qw + 2 * qz * qx);
+			m(1, 0) = float(2 * qx * qy + 2 * qw * qz);
+			m(1, 1) = float(qy * qy + qw * qw - qz * qz - qx * qx);
+			m(1, 2) = float(2 * qz * qy - 2 * qx * qw);
+			m(2, 0) = float(2 * qx * qz - 2 * qy * qw);
+			m(2, 1) = float(2 * qy * qz + 2 * qw * qx);
+			m(2, 2) = float(qz * qz + qw * qw - qy * qy - qx * qx);
+
+			return m;
+		};
 
-				std::string     image_path = sibr::parentDirectory(nvmPath) + "/" + token;
-				sibr::Vector2i	resolution = sibr::IImage::imageResolution(image_path);
+		if (format_r9t)
+		{
+			std::cout << " WARNING THIS PART OF THE CODE WAS NEVER TESTED. IT IS SUPPOSED NOT TO WORK PROPERLY" << std::endl;
+		}
 
-				if (resolution.x() < 0 || resolution.y() < 0)
-				{
-					std::cerr << "Could not get resolution for input image: " << image_path << std::endl;
-					return std::vector<InputCamera::Ptr>();
-				}
+		std::vector<InputCamera> cameras(ncam);
+		std::vector<std::string> missingResolutions(ncam);
+#pragma omp parallel for
+		for (int i = 0; i < ncam; ++i)
+		{
+			TextScanner values = cameraLines[i];
+			std::string name;
+			double f = 0.0, q[9] = { 0.0 }, c[3] = { 0.0 }, d[2] = { 0.0 };
+			values.token(name);
+			values.read(f);
+			for (int j = 0; j < rotation_parameter_num; ++j) values.read(q[j]);
+			values.read(c[0]); values.read(c[1]); values.read(c[2]); values.read(d[0]); values.read(d[1]);
 
-				int wIm = 1, hIm = 1;
-				if (ncam == wh.size()) {
-					wIm = wh[i].x();
-					hIm = wh[i].y();
-				}
-				else {
-					wIm = resolution.x();
-					hIm = resolution.y();
-				}
+			std::string     image_path = sibr::parentDirectory(nvmPath) + "/" + name;
+			sibr::Vector2i	resolution = sibr::IImage::imageResolution(image_path);
 
-				//camera_data[i].SetFocalLength(f);
-				cameras.emplace_back(new InputCamera((float)f, (float)d[0], (float)d[1], wIm, hIm, i));
+			if (resolution.x() < 0 || resolution.y() < 0)
+			{
+				missingResolutions[i] = image_path;
+				continue;
+			}
 
-				float fov = 2.0f * atan(0.5f * hIm / (float)f);
-				float aspect = float(wIm) / float(hIm);
-				cameras[i]->aspect(aspect);
-				cameras[i]->fovy(fov);
+			int wIm = 1, hIm = 1;
+			if (ncam == wh.size()) {
+				wIm = wh[i].x();
+				hIm = wh[i].y();
+			}
+			else {
+				wIm = resolution.x();
+				hIm = resolution.y();
+			}
 
-				//translation
-				Vector3f posCam((float)c[0], (float)c[1], (float)c[2]);
+			//camera_data[i].SetFocalLength(f);
+			InputCamera & camera = cameras[i];
+			camera = InputCamera((float)f, (float)d[0], (float)d[1], wIm, hIm, i);
 
-				if (format_r9t)
-				{
+			float fov = 2.0f * atan(0.5f * hIm / (float)f);
+			float aspect = float(wIm) / float(hIm);
+			camera.aspect(aspect);
+			camera.fovy(fov);
 
-					std::cout << " WARNING THIS PART OF THE CODE WAS NEVER TESTED. IT IS SUPPOSED NOT TO WORK PROPERLY" << std::endl;
-					Eigen::Matrix3f		matRotation;
-					matRotation <<
-						float(q[0]), float(q[1]), float(q[2]),
-						float(q[3]), float(q[4]), float(q[5]),
-						float(q[6]), float(q[7]), float(q[8])
-						;
-					matRotation.transposeInPlace();
+			//translation
+			Vector3f posCam((float)c[0], (float)c[1], (float)c[2]);
 
+			if (format_r9t)
+			{
+				Eigen::Matrix3f		matRotation;
+				matRotation <<
+					float(q[0]), float(q[1]), float(q[2]),
+					float(q[3]), float(q[4]), float(q[5]),
+					float(q[6]), float(q[7]), float(q[8])
+					;
+				matRotation.transposeInPlace();
 
-					cameras[i]->position(posCam);
-					cameras[i]->rotation(Quaternionf(matRotation));
 
-				}
-				else
-				{
+				camera.position(posCam);
+				camera.rotation(Quaternionf(matRotation));
 
-					Eigen::Matrix3f converter;
-					converter <<
-						1, 0, 0,
-						0, -1, 0,
-						0, 0, -1;
-					//older format for compability
-					Quaternionf quat((float)q[0], (float)q[1], (float)q[2], (float)q[3]);
-					Eigen::Matrix3f	matRotation = converter.transpose() * quat.toRotationMatrix();
-					matRotation.transposeInPlace();
+			}
+			else
+			{
 
-					cameras[i]->position(posCam);
-					cameras[i]->rotation(Quaternionf(matRotation));
+				Eigen::Matrix3f converter;
+				converter <<
+					1, 0, 0,
+					0, -1, 0,
+					0, 0, -1;
+				//older format for compability
+				Quaternionf quat((float)q[0], (float)q[1], (float)q[2], (float)q[3]);
+				Eigen::Matrix3f	matRotation = converter.transpose() * quat.toRotationMatrix();
+				matRotation.transposeInPlace();
+
+				camera.position(posCam);
+				camera.rotation(Quaternionf(matRotation));
 
-				}
-				//camera_data[i].SetNormalizedMeasurementDistortion(d[0]);
-				cameras[i]->name(token);
 			}
-			std::cout << ncam << " cameras; " << npoint << " 3D points; " << nproj << " projections\n";
+			//camera_data[i].SetNormalizedMeasurementDistortion(d[0]);
+			camera.name(name);
 		}
-		else {
-			SIBR_WRG << "Cannot open '" << nvmPath << std::endl;
+
+		for (const std::string & image_path : missingResolutions)
+		{
+			if (!image_path.empty())
+			{
+				std::cerr << "Could not get resolution for input image: " << image_path << std::endl;
+				return std::vector<InputCamera::Ptr>();
+			}
 		}
+		std::cout << ncam << " cameras; " << npoint << " 3D points; " << nproj << " projections\n";
 
-		return cameras;
+		return shareCameras(std::move(cameras));
 	}
 
 	std::vector<InputCamera::Ptr> InputCamera::loadLookat(const std::string& lookatPath, const std::vector<sibr::Vector2u>& wh, float znear, float zfar)
@@ -609,10 +699,9 @@ namespace sibr
 	void InputCamera::saveAsLookat(const std::vector<InputCamera::Ptr>& cams, const std::string& fileName) {
 
 		std::ofstream fileRender(fileName, std::ios::out | std::ios::trunc);
-		for (const auto& cam : cams) {
-
-			fileRender << cam->name() << cam->lookatString();
-		}
+		sibr::writeRecords(fileRender, cams.size(), [&cams](size_t c) {
+			return cams[c]->name() + cams[c]->lookatString();
+		});
 
 		fileRender.close();
 	}
@@ -639,21 +728,17 @@ namespace sibr
 		const std::string camerasListing2 = colmapSparsePath + "/cameras.txt2";
 		const std::string imagesListing2 = colmapSparsePath + "/images.txt2";
 
-		std::ifstream camerasFile(camerasListing);
-		std::ifstream imagesFile(imagesListing);
+		MappedFile camerasFile(camerasListing);
+		MappedFile imagesFile(imagesListing);
 		std::ofstream camerasFile2(camerasListing2);
 		std::ofstream imagesFile2(imagesListing2);
-		if (!camerasFile.is_open()) {
+		if (!camerasFile.isOpen()) {
 			SIBR_ERR << "Unable to load camera colmap file" << std::endl;
 		}
-		if (!imagesFile.is_open()) {
+		if (!imagesFile.isOpen()) {
 			SIBR_WRG << "Unable to load images colmap file" << std::endl;
 		}
 
-		std::vector<InputCamera::Ptr> cameras;
-
-		std::string line;
-
 		struct CameraParametersColmap {
 			size_t id;
 			size_t width;
@@ -668,12 +753,14 @@ namespace sibr
 
 		std::map<int, std::vector<std::string>> camidtokens;
 
-		while (safeGetline(camerasFile, line)) {
-			if (line.empty() || line[0] == '#') {
+		TextScanner camerasText(camerasFile.data(), camerasFile.data() + camerasFile.size());
+		TextScanner line;
+		while (camerasText.nextLine(line)) {
+			if (line.isBlank() || line.startsWith('#')) {
 				continue;
 			}
 
-			std::vector<std::string> tokens = sibr::split(line, ' ');
+			std::vector<std::string> tokens = sibr::split(line.str(), ' ');
 			if (tokens.size() < 8) {
 				SIBR_WRG << "Unknown line." << std::endl;
 				continue;
@@ -697,42 +784,52 @@ namespace sibr
 			camidtokens[params.id] = tokens;
 		}
 
+		// Each image is a pose line followed by an observations line, possibly empty.
+		std::vector<TextScanner> poses;
+		TextScanner imagesText(imagesFile.data(), imagesFile.data() + imagesFile.size());
+		while (imagesText.nextLine(line)) {
+			if (line.isBlank() || line.startsWith('#')) {
+				continue;
+			}
+			poses.push_back(line);
+			// Skip the observations.
+			imagesText.nextLine(line);
+		}
+
 		// Now load the individual images and their extrinsic parameters
 		sibr::Matrix3f converter;
 		converter << 1, 0, 0,
 			0, -1, 0,
 			0, 0, -1;
 
-		int camid = 0;
-		int valid = 0;
-		while (safeGetline(imagesFile, line)) {
-			if (line.empty() || line[0] == '#') {
+		enum Status { VALID = 0, UNKNOWN_LINE, MISSING_INTRINSICS };
+		std::vector<InputCamera> cameras(poses.size());
+		std::vector<int> status(poses.size(), VALID);
+		std::vector<size_t> intrinsicIds(poses.size(), 0);
+
+#pragma omp parallel for
+		for (int i = 0; i < int(poses.size()); ++i) {
+			TextScanner pose = poses[i];
+			int imageId = 0;
+			float qw = 0.0f, qx = 0.0f, qy = 0.0f, qz = 0.0f;
+			float tx = 0.0f, ty = 0.0f, tz = 0.0f;
+			size_t id = 0;
+			std::string imageName;
+			if (!(pose.read(imageId) && pose.read(qw) && pose.read(qx) && pose.read(qy) && pose.read(qz)
+				&& pose.read(tx) && pose.read(ty) && pose.read(tz) && pose.read(id) && pose.token(imageName))) {
+				status[i] = UNKNOWN_LINE;
 				continue;
 			}
-			std::vector<std::string> tokens = sibr::split(line, ' ');
-			if (tokens.size() < 10) {
-				SIBR_WRG << "Unknown line." << std::endl;
-				continue;
-			}
-
-			uint		cId = std::stoi(tokens[0]) - 1;
-			float       qw = std::stof(tokens[1]);
-			float       qx = std::stof(tokens[2]);
-			float       qy = std::stof(tokens[3]);
-			float       qz = std::stof(tokens[4]);
-			float       tx = std::stof(tokens[5]);
-			float       ty = std::stof(tokens[6]);
-			float       tz = std::stof(tokens[7]);
-			size_t      id = std::stol(tokens[8]);
+			intrinsicIds[i] = id;
 
-			std::string imageName = tokens[9];
-
-			if (cameraParameters.find(id) == cameraParameters.end())
-			{
-				SIBR_ERR << "Could not find intrinsics for image: "
-					<< tokens[9] << std::endl;
+			const auto camParamsIt = cameraParameters.find(id);
+			if (camParamsIt == cameraParameters.end()) {
+				status[i] = MISSING_INTRINSICS;
+				cameras[i].name(imageName);
+				continue;
 			}
-			const CameraParametersColmap& camParams = cameraParameters[id];
+			const CameraParametersColmap& camParams = camParamsIt->second;
+			const uint cId = uint(imageId - 1);
 
 			const sibr::Quaternionf quat(qw, qx, qy, qz);
 			const sibr::Matrix3f orientation = quat.toRotationMatrix().transpose() * converter;
@@ -740,43 +837,54 @@ namespace sibr
 
 			sibr::Vector3f position = -(orientation * converter * translation);
 
-			sibr::InputCamera::Ptr camera;
+			InputCamera & camera = cameras[i];
 			if (fovXfovYFlag) {
-				camera = std::make_shared<InputCamera>(InputCamera(camParams.fy, camParams.fx, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId)));
+				camera = InputCamera(camParams.fy, camParams.fx, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId));
 			}
 			else {
-				camera = std::make_shared<InputCamera>(InputCamera(camParams.fy, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId)));
+				camera = InputCamera(camParams.fy, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId));
 			}
 
-			camera->name(imageName);
-			camera->position(position);
-			camera->rotation(sibr::Quaternionf(orientation));
-			camera->znear(zNear);
-			camera->zfar(zFar);
+			camera.name(imageName);
+			camera.position(position);
+			camera.rotation(sibr::Quaternionf(orientation));
+			camera.znear(zNear);
+			camera.zfar(zFar);
+		}
+
+		std::vector<InputCamera> validCameras;
+		validCameras.reserve(cameras.size());
+		int valid = 0;
+		for (size_t i = 0; i < cameras.size(); ++i) {
+			if (status[i] == UNKNOWN_LINE) {
+				SIBR_WRG << "Unknown line." << std::endl;
+				continue;
+			}
+			if (status[i] == MISSING_INTRINSICS) {
+				SIBR_ERR << "Could not find intrinsics for image: "
+					<< cameras[i].name() << std::endl;
+			}
 
-			if (camera->position().x() < 0)
+			if (cameras[i].position().x() < 0)
 			{
+				const size_t id = intrinsicIds[i];
+				const std::vector<std::string> tokens = sibr::split(poses[i].str(), ' ');
 				camerasFile2 << ++valid;
-				for (int i = 1; i < camidtokens[id].size(); i++)
-					camerasFile2 << " " << camidtokens[id][i];
+				for (int t = 1; t < camidtokens[int(id)].size(); t++)
+					camerasFile2 << " " << camidtokens[int(id)][t];
 				camerasFile2 << "\n\n";
 
 				imagesFile2<< valid;
-				for (int i = 1; i < tokens.size() - 1; i++)
-					imagesFile2 << " " << tokens[i];
+				for (int t = 1; t < tokens.size() - 1; t++)
+					imagesFile2 << " " << tokens[t];
 				imagesFile2 << " " << valid << std::endl;
 				imagesFile2 << "\n\n";
 			}
 
-			cameras.push_back(camera);
-
-			++camid;
-			// Skip the observations.
-			safeGetline(imagesFile, line);
+			validCameras.push_back(std::move(cameras[i]));
 		}
 
-
-		return cameras;
+		return shareCameras(std::move(validCameras));
 	}
 
 	std::vector<InputCamera::Ptr> InputCamera::loadBundle(const std::string& bundlerPath, float zNear, float zFar, const std::string& listImagePath, bool path)
@@ -784,25 +892,26 @@ namespace sibr
 		SIBR_LOG << "Loading input cameras." << std::endl;
 
 		// check bundler file
-		std::ifstream bundle_file(bundlerPath);
-		if (!bundle_file.is_open()) {
+		MappedFile bundle_file(bundlerPath);
+		if (!bundle_file.isOpen()) {
 			SIBR_ERR << "Unable to load bundle file at path \"" << bundlerPath << "\"." << std::endl;
 			return {};
 		}
 
 		const std::string listImages = listImagePath.empty() ? (bundlerPath + "/../list_images.txt") : listImagePath;
-		std::ifstream list_images(listImages);
-		if (!list_images.is_open()) {
+		MappedFile list_images(listImages);
+		if (!list_images.isOpen()) {
 			SIBR_ERR << "Unable to load list_images file at path \"" << listImages << "\"." << std::endl;
 			return {};
 		}
 
 		// read number of images
-		std::string line;
-		getline(bundle_file, line);	// ignore first line - contains version
+		TextScanner bundleText(bundle_file.data(), bundle_file.data() + bundle_file.size());
+		std::vector<TextScanner> lines = bundleText.lines(); // first line contains the version
 		int numImages = 0;
-		bundle_file >> numImages;	// read first value (number of images)
-		getline(bundle_file, line);	// ignore the rest of the line
+		if (lines.size() > 1) {
+			lines[1].read(numImages);	// read first value (number of images)
+		}
 
 									// Read all filenames
 		struct ImgInfos
@@ -813,47 +922,47 @@ namespace sibr
 		};
 		std::vector<ImgInfos>	imgInfos;
 		{
+			TextScanner listText(list_images.data(), list_images.data() + list_images.size());
 			ImgInfos				infos;
-			while (true)
+			while (listText.token(infos.name))
 			{
-				list_images >> infos.name;
-				if (infos.name.empty()) break;
-				list_images >> infos.w >> infos.h;
+				listText.read(infos.w);
+				listText.read(infos.h);
 				infos.name.erase(infos.name.find_last_of("."), std::string::npos);
 				infos.id = atoi(infos.name.c_str());
 				imgInfos.push_back(infos);
-				infos.name.clear();
 			}
 		}
 
-		ImgInfos infoPrevImage;
 		bool shortListImages = false;
 		// check if list images has the same number of cameras as path, else assume we read the dataset list_images.txt
 		if (path && imgInfos.size() != numImages)
 			shortListImages = true;
 
+		// Each camera is described on 5 lines: focal and distortion, rotation rows, translation.
+		const int firstLine = 2;
+		const int linesPerCamera = 5;
+		numImages = std::max(0, std::min(numImages, (int(lines.size()) - firstLine) / linesPerCamera));
+		if (!shortListImages) {
+			numImages = std::min(numImages, int(imgInfos.size()));
+		}
 
-
-
-		std::vector<InputCamera::Ptr> cameras(numImages);
+		std::vector<InputCamera> cameras(numImages);
 		//  Parse bundle.out file for camera calibration parameters
-		for (int i = 0, infosId = 0; i < numImages; i++) {
+#pragma omp parallel for
+		for (int i = 0; i < numImages; i++) {
 
-			ImgInfos infos;
+			ImgInfos infos = { "", 0, 0, 0 };
 			std::string camName;
 
 			if (!shortListImages) {
-				infoPrevImage = infos = imgInfos[infosId];
+				infos = imgInfos[i];
 				camName = infos.name;
-				if (infosId > imgInfos.size())
-					break;
 			}
 			else {
 				// hack; use info of last available image, but (always) change name
-				if( i < imgInfos.size())
-					infoPrevImage = infos = imgInfos[infosId];
-				else 
-					infos = infoPrevImage;
+				if (!imgInfos.empty())
+					infos = imgInfos[std::min(size_t(i), imgInfos.size() - 1)];
 
 				std::stringstream ss;
 				ss << std::setw(10) << std::setfill('0') << i;
@@ -862,19 +971,19 @@ namespace sibr
 			}
 
 			Matrix4f m; // bundler params
+			for (int l = 0; l < linesPerCamera; ++l) {
+				TextScanner values = lines[firstLine + linesPerCamera * i + l];
+				for (int c = 0; c < 3; ++c) {
+					values.read(m(3 * l + c));
+				}
+			}
 
-			bundle_file >> m(0) >> m(1) >> m(2) >> m(3) >> m(4);
-			bundle_file >> m(5) >> m(6) >> m(7) >> m(8) >> m(9);
-			bundle_file >> m(10) >> m(11) >> m(12) >> m(13) >> m(14);
-
-			cameras[infosId] = InputCamera::Ptr(new InputCamera(infosId, infos.w, infos.h, m, true));
-			cameras[infosId]->name(camName);
-			cameras[infosId]->znear(zNear); cameras[infosId]->zfar(zFar);
-
-			++infosId;
+			cameras[i] = InputCamera(i, infos.w, infos.h, m, true);
+			cameras[i].name(camName);
+			cameras[i].znear(zNear); cameras[i].zfar(zFar);
 		}
 
-		return cameras;
+		return shareCameras(std::move(cameras));
 	}
 
 	std::vector<InputCamera::Ptr> InputCamera::loadBundleFRIBR(const std::string& bundlerPath, float zNear, float zFar, const std::string& listImagePath)
@@ -1104,6 +1213,107 @@ namespace sibr
 		return sibr::Vector3f(pos2dImg.x(), pos2dImg.y(), pos2dGL.z());
 	}
 
+	namespace {
+
+		/// Camera parameters used by the batched projection.
+		struct BatchProjection {
+			float m[16]; ///< Row-major viewproj.
+			float pos[3]; ///< Camera position.
+			float dir[3]; ///< Camera direction.
+			float halfW; ///< Half image width.
+			float halfH; ///< Half image height.
+		};
+
+		BatchProjection batchProjection(const InputCamera & cam) {
+			BatchProjection p;
+			const Matrix4f & vp = cam.viewproj();
+			for (int r = 0; r < 4; ++r) {
+				for (int c = 0; c < 4; ++c) {
+					p.m[4 * r + c] = vp(r, c);
+				}
+			}
+			const Vector3f pos = cam.position();
+			const Vector3f dir = cam.dir();
+			for (int i = 0; i < 3; ++i) {
+				p.pos[i] = pos[i];
+				p.dir[i] = dir[i];
+			}
+			p.halfW = 0.5f * float(cam.w());
+			p.halfH = 0.5f * float(cam.h());
+			return p;
+		}
+
+		// Same as Camera::project followed by the image space conversion and Camera::frustumTest.
+		void projectBatch(const BatchProjection & p, size_t begin, size_t end, const float * xs, const float * ys, const float * zs,
+			float * us, float * vs, float * depths, uint8_t * inFrustum)
+		{
+			const float m0 = p.m[0], m1 = p.m[1], m2 = p.m[2], m3 = p.m[3];
+			const float m4 = p.m[4], m5 = p.m[5], m6 = p.m[6], m7 = p.m[7];
+			const float m8 = p.m[8], m9 = p.m[9], m10 = p.m[10], m11 = p.m[11];
+			const float m12 = p.m[12], m13 = p.m[13], m14 = p.m[14], m15 = p.m[15];
+			const float px = p.pos[0], py = p.pos[1], pz = p.pos[2];
+			const float dx = p.dir[0], dy = p.dir[1], dz = p.dir[2];
+			const float halfW = p.halfW, halfH = p.halfH;
+			const float bound = 1.0f - 1e-5f;
+			for (size_t i = begin; i < end; ++i) {
+				const float x = xs[i], y = ys[i], z = zs[i];
+				const float invW = 1.0f / (m12 * x + m13 * y + m14 * z + m15);
+				const float nx = (m0 * x + m1 * y + m2 * z + m3) * invW;
+				const float ny = (m4 * x + m5 * y + m6 * z + m7) * invW;
+				us[i] = (nx + 1.0f) * halfW;
+				vs[i] = (1.0f - ny) * halfH;
+				if (depths) {
+					depths[i] = (m8 * x + m9 * y + m10 * z + m11) * invW;
+				}
+				if (inFrustum) {
+					const float front = dx * (x - px) + dy * (y - py) + dz * (z - pz);
+					inFrustum[i] = uint8_t((std::abs(nx) < bound) & (std::abs(ny) < bound) & (front > 0.0f));
+				}
+			}
+		}
+	}
+
+	void				InputCamera::projectImgSpaceInvertY(size_t count, const float * xs, const float * ys, const float * zs,
+		float * us, float * vs, float * depths, uint8_t * inFrustum) const
+	{
+		projectBatch(batchProjection(*this), 0, count, xs, ys, zs, us, vs, depths, inFrustum);
+	}
+
+	void				InputCamera::projectImgSpaceInvertY(const std::vector<const InputCamera *> & cameras, size_t count,
+		const float * xs, const float * ys, const float * zs,
+		float * us, float * vs, float * depths, uint8_t * inFrustum)
+	{
+		std::vector<BatchProjection> projections(cameras.size());
+		for (size_t c = 0; c < cameras.size(); ++c) {
+			projections[c] = batchProjection(*cameras[c]);
+		}
+		// A block of coordinates stays in the L1 cache while it is projected in all cameras.
+		const size_t blockSize = 1024;
+		const int blocks = int((count + blockSize - 1) / blockSize);
+#pragma omp parallel for schedule(static) if (blocks > 4)
+		for (int b = 0; b < blocks; ++b) {
+			const size_t begin = size_t(b) * blockSize;
+			const size_t end = std::min(begin + blockSize, count);
+			for (size_t c = 0; c < projections.size(); ++c) {
+				// The offsets keep the indices of the block, so that the kernel is the same as for one camera.
+				const size_t offset = c * count;
+				projectBatch(projections[c], begin, end, xs, ys, zs, us + offset, vs + offset,
+					depths ? depths + offset : nullptr, inFrustum ? inFrustum + offset : nullptr);
+			}
+		}
+	}
+
+	void				InputCamera::projectImgSpaceInvertY(const std::vector<InputCamera::Ptr> & cameras, size_t count,
+		const float * xs, const float * ys, const float * zs,
+		float * us, float * vs, float * depths, uint8_t * inFrustum)
+	{
+		std::vector<const InputCamera *> pointers(cameras.size());
+		for (size_t c = 0; c < cameras.size(); ++c) {
+			pointers[c] = cameras[c].get();
+		}
+		projectImgSpaceInvertY(pointers, count, xs, ys, zs, us, vs, depths, inFrustum);
+	}
+
 	bool				InputCamera::loadFromBinary(const std::string& filename)
 	{
 		ByteStream	bytes;
@@ -1259,10 +1469,9 @@ namespace sibr
 		outputBundleCam << "# Bundle file v0.3" << std::endl;
 		outputBundleCam << cams.size() << " " << 0 << std::endl;
 
-		for (int c = 0; c < cams.size(); c++) {
-			auto& camIm = cams[c];
-			outputBundleCam << camIm->toBundleString(negativeZ, oldFocal);
-		}
+		sibr::writeRecords(outputBundleCam, cams.size(), [&cams, negativeZ, oldFocal](size_t c) {
+			return cams[c]->toBundleString(negativeZ, oldFocal);
+		});
 
 		outputBundleCam.close();
 
@@ -1275,13 +1484,14 @@ namespace sibr
 
 			outList.open(listpath);
 			if (outList.good()) {
-				for (int i = 0; i < cams.size(); ++i) {
+				// The images are encoded while the list is written.
+				sibr::writeRecords(outList, cams.size(), [&cams, &imagesDir](size_t i) {
 					const sibr::InputCamera::Ptr cam = cams[i];
-					const std::string imageName = cam->name().empty() ? sibr::intToString<8>(i) + ".jpg" : cam->name();
-					outList << "visualize/" << imageName << " " << cam->w() << " " << cam->h() << std::endl;
+					const std::string imageName = cam->name().empty() ? sibr::intToString<8>(int(i)) + ".jpg" : cam->name();
 					cv::Mat3b dummy(cam->h(), cam->w());
 					cv::imwrite(imagesDir + imageName, dummy);
-				}
+					return "visualize/" + imageName + " " + std::to_string(cam->w()) + " " + std::to_string(cam->h()) + "\n";
+				}, 64);
 				outList.close();
 			}
 			else {
@@ -1300,7 +1510,7 @@ namespace sibr
 		}
 		// Get the padding count.
 		const int len = int(std::floor(std::log10(cams.size()))) + 1;
-		for (size_t cid = 0; cid < cams.size(); ++cid) {
+		sibr::writeRecords(file, cams.size(), [&cams, len](size_t cid) {
 			const auto& cam = cams[cid];
 			std::string id = std::to_string(cid);
 			const std::string pad = std::string(len - id.size(), '0');
@@ -1309,15 +1519,16 @@ namespace sibr
 			const sibr::Vector3f& up = cam.up();
 			const sibr::Vector3f tgt = cam.position() + cam.dir();
 
-
-			file << "Cam" << pad << id;
-			file << " -D origin=" << pos[0] << "," << pos[1] << "," << pos[2];
-			file << " -D target=" << tgt[0] << "," << tgt[1] << "," << tgt[2];
-			file << " -D up=" << up[0] << "," << up[1] << "," << up[2];
-			file << " -D fovy=" << cam.fovy();
-			file << " -D clip=" << cam.znear() << "," << cam.zfar();
-			file << "\n";
-		}
+			std::ostringstream line;
+			line << "Cam" << pad << id;
+			line << " -D origin=" << pos[0] << "," << pos[1] << "," << pos[2];
+			line << " -D target=" << tgt[0] << "," << tgt[1] << "," << tgt[2];
+			line << " -D up=" << up[0] << "," << up[1] << "," << up[2];
+			line << " -D fovy=" << cam.fovy();
+			line << " -D clip=" << cam.znear() << "," << cam.zfar();
+			line << "\n";
+			return line.str();
+		});
 
 		file.close();
 	}
@@ -1328,20 +1539,16 @@ namespace sibr
 		const std::string imagesListing = colmapSparsePath + "/images.bin";
 
 
-  		std::ifstream camerasFile(camerasListing, std::ios::binary);
-		std::ifstream imagesFile(imagesListing, std::ios::binary);
+		MappedFile camerasFile(camerasListing);
+		MappedFile imagesFile(imagesListing);
 
-		if (!camerasFile.is_open()) {
+		if (!camerasFile.isOpen()) {
 			SIBR_ERR << "Unable to load camera colmap file" << camerasListing << std::endl;
 		}
-		if (!imagesFile.is_open()) {
+		if (!imagesFile.isOpen()) {
 			SIBR_WRG << "Unable to load images colmap file" << imagesListing << std::endl;
 		}
 
-		std::vector<InputCamera::Ptr> cameras;
-
-		std::string line;
-
 		struct CameraParametersColmap {
 			size_t id;
 			size_t width;
@@ -1353,55 +1560,106 @@ namespace sibr
 		};
 
 		std::map<size_t, CameraParametersColmap> cameraParameters;
-  		const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&camerasFile);
+		BinaryCursor camerasData(camerasFile.data(), camerasFile.data() + camerasFile.size());
+		const size_t num_cameras = camerasData.has(sizeof(uint64_t)) ? camerasData.read<uint64_t>() : 0;
 
-  		for (size_t i = 0; i < num_cameras ; ++i) {
+		for (size_t i = 0; i < num_cameras ; ++i) {
+			if (!camerasData.has(sizeof(uint32_t) + sizeof(int) + 2 * sizeof(uint64_t))) {
+				SIBR_WRG << "Truncated colmap file " << camerasListing << std::endl;
+				break;
+			}
 
 			CameraParametersColmap params;
 
-			params.id = ReadBinaryLittleEndian<uint32_t>(&camerasFile);
-			int model_id = ReadBinaryLittleEndian<int>(&camerasFile);
-			params.width = ReadBinaryLittleEndian<uint64_t>(&camerasFile);
-			params.height = ReadBinaryLittleEndian<uint64_t>(&camerasFile);
-			std::vector<double> Params(4);
+			params.id = camerasData.read<uint32_t>();
+			int model_id = camerasData.read<int>();
+			params.width = camerasData.read<uint64_t>();
+			params.height = camerasData.read<uint64_t>();
 
-    			ReadBinaryLittleEndian<double>(&camerasFile, &Params);
+			const int num_params = colmapModelParameterCount(model_id);
+			if (num_params < 0 || !camerasData.has(num_params * sizeof(double))) {
+				SIBR_WRG << "Unsupported camera model " << model_id << " in " << camerasListing << std::endl;
+				break;
+			}
+			std::vector<double> Params(num_params);
+			for (double & param : Params) {
+				param = camerasData.read<double>();
+			}
+			// Models with a single focal length store f, cx, cy first, the others fx, fy, cx, cy.
+			const bool singleFocal = colmapModelHasSingleFocal(model_id);
 			params.fx = float(Params[0]);
-			params.fy = float(Params[1]);
-			params.dx = float(Params[2]);
-			params.dy = float(Params[3]);
+			params.fy = float(singleFocal ? Params[0] : Params[1]);
+			params.dx = float(singleFocal ? Params[1] : Params[2]);
+			params.dy = float(singleFocal ? Params[2] : Params[3]);
 			cameraParameters[params.id] = params;
 		}
 
+		// Locate the image records, their size depends on the name and the number of observations.
+		const size_t fixedImageSize = sizeof(image_t) + 7 * sizeof(double) + sizeof(camera_t);
+		BinaryCursor imagesData(imagesFile.data(), imagesFile.data() + imagesFile.size());
+		const size_t num_reg_images = imagesData.has(sizeof(uint64_t)) ? imagesData.read<uint64_t>() : 0;
+		std::vector<const char*> records;
+		records.reserve(num_reg_images);
+		for (size_t i = 0; i < num_reg_images; ++i) {
+			if (!imagesData.has(fixedImageSize)) {
+				break;
+			}
+			const char * record = imagesData.pos;
+			imagesData.pos += fixedImageSize;
+			const char * nameEnd = static_cast<const char*>(std::memchr(imagesData.pos, '\0', size_t(imagesData.end - imagesData.pos)));
+			if (!nameEnd) {
+				break;
+			}
+			imagesData.pos = nameEnd + 1;
+			if (!imagesData.has(sizeof(uint64_t))) {
+				break;
+			}
+			// ignore the 2d points: x, y, point3D id.
+			const uint64_t num_points2D = imagesData.read<uint64_t>();
+			const uint64_t pointsSize = num_points2D * (2 * sizeof(double) + sizeof(point3D_t));
+			if (!imagesData.has(size_t(pointsSize))) {
+				break;
+			}
+			imagesData.pos += pointsSize;
+			records.push_back(record);
+		}
+		if (records.size() != num_reg_images) {
+			SIBR_WRG << "Truncated colmap file " << imagesListing << ", " << records.size() << "/" << num_reg_images << " images read." << std::endl;
+		}
+
 		// Now load the individual images and their extrinsic parameters
 		sibr::Matrix3f converter;
 		converter << 1, 0, 0,
 			0, -1, 0,
 			0, 0, -1;
 
-  		const size_t num_reg_images = ReadBinaryLittleEndian<uint64_t>(&imagesFile);
-		for (size_t i = 0; i < num_reg_images; ++i) {
-
-			uint	    cId = ReadBinaryLittleEndian<image_t>(&imagesFile);
-			float       qw = float(ReadBinaryLittleEndian<double>(&imagesFile));
-			float       qx = float(ReadBinaryLittleEndian<double>(&imagesFile)) ;
-			float       qy = float(ReadBinaryLittleEndian<double>(&imagesFile)) ;
-			float       qz = float(ReadBinaryLittleEndian<double>(&imagesFile)) ;
-			float       tx = float(ReadBinaryLittleEndian<double>(&imagesFile));
-			float       ty = float(ReadBinaryLittleEndian<double>(&imagesFile));
-			float       tz = float(ReadBinaryLittleEndian<double>(&imagesFile));
-			size_t      id = ReadBinaryLittleEndian<camera_t>(&imagesFile) ;
-
-
-			if (cameraParameters.find(id) == cameraParameters.end())
+		const CameraParametersColmap defaultParams = { 0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f };
+		std::vector<InputCamera> cameras(records.size());
+#pragma omp parallel for
+		for (int i = 0; i < int(records.size()); ++i) {
+			BinaryCursor record(records[i], imagesData.end);
+
+			uint	    cId = record.read<image_t>();
+			float       qw = float(record.read<double>());
+			float       qx = float(record.read<double>());
+			float       qy = float(record.read<double>());
+			float       qz = float(record.read<double>());
+			float       tx = float(record.read<double>());
+			float       ty = float(record.read<double>());
+			float       tz = float(record.read<double>());
+			size_t      id = record.read<camera_t>();
+
+
+			auto camParamsIt = cameraParameters.find(id);
+			if (camParamsIt == cameraParameters.end())
 			{
 				/* code multi camera broken
 				SIBR_ERR << "Could not find intrinsics for image: "
 					<< id << std::endl;
 			*/
-				id = 1;
+				camParamsIt = cameraParameters.find(1);
 			}
-			const CameraParametersColmap& camParams = cameraParameters[id];
+			const CameraParametersColmap& camParams = camParamsIt != cameraParameters.end() ? camParamsIt->second : defaultParams;
 
 
 			const sibr::Quaternionf quat(qw, qx, qy, qz);
@@ -1410,104 +1668,86 @@ namespace sibr
 
 			sibr::Vector3f position = -(orientation * converter * translation);
 
-			sibr::InputCamera::Ptr camera;
+			InputCamera & camera = cameras[i];
 			if (fovXfovYFlag) {
-				camera = std::make_shared<InputCamera>(InputCamera(camParams.fy, camParams.fx, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId)));
+				camera = InputCamera(camParams.fy, camParams.fx, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId));
 			}
 			else {
-				camera = std::make_shared<InputCamera>(InputCamera(camParams.fy, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId)));
+				camera = InputCamera(camParams.fy, 0.0f, 0.0f, int(camParams.width), int(camParams.height), int(cId));
 			}
-			std::string image_name;
-			char name_char;
-			do {
-				imagesFile.read(&name_char, 1);
-				if (name_char != '\0') {
-					image_name += name_char;
-				}
-			} while (name_char != '\0');
 
-			camera->name(image_name);
-			camera->position(position);
-			camera->rotation(sibr::Quaternionf(orientation));
-			camera->znear(zNear);
-			camera->zfar(zFar);
-			cameras.push_back(camera);
-
-
-    		// ignore the 2d points
-    		const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(&imagesFile);
-
-    			for (size_t j = 0; j < num_points2D; ++j) {
-			      const double x = ReadBinaryLittleEndian<double>(&imagesFile);
-			      const double y = ReadBinaryLittleEndian<double>(&imagesFile);
-				  point3D_t id = ReadBinaryLittleEndian<point3D_t>(&imagesFile);
-    			}
+			camera.name(std::string(record.pos));
+			camera.position(position);
+			camera.rotation(sibr::Quaternionf(orientation));
+			camera.znear(zNear);
+			camera.zfar(zFar);
 		}
-		return cameras;
+		return shareCameras(std::move(cameras));
 	}
 
 	std::vector<InputCamera::Ptr> InputCamera::loadJSON(const std::string& jsonPath, const float zNear, const float zFar)
 	{
-		std::ifstream json_file(jsonPath, std::ios::in);
+		MappedFile json_file(jsonPath);
 
-		if (!json_file)
+		if (!json_file.isOpen())
 		{
 			std::cerr << "file loading failed: " << jsonPath << std::endl;
 			return std::vector<InputCamera::Ptr>();
 		}
 
-		std::vector<InputCamera::Ptr> cameras;
-
 		picojson::value v;
 		picojson::set_last_error(std::string());
-		std::string err = picojson::parse(v, json_file);
+		std::string err;
+		picojson::parse(v, json_file.data(), json_file.data() + json_file.size(), &err);
 		if (!err.empty()) {
 			picojson::set_last_error(err);
-			json_file.setstate(std::ios::failbit);
 		}
 
-		picojson::array& frames = v.get<picojson::array>();
+		const picojson::array& frames = v.get<picojson::array>();
 
-		for (size_t i = 0; i < frames.size(); ++i)
+		std::vector<InputCamera> cameras(frames.size());
+#pragma omp parallel for
+		for (int i = 0; i < int(frames.size()); ++i)
 		{
-			int id = frames[i].get("id").get<double>();
-			std::string imgname = frames[i].get("img_name").get<std::string>();
-			int width = frames[i].get("width").get<double>();
-			int height = frames[i].get("height").get<double>();
-			float fy = frames[i].get("fy").get<double>();
-			float fx = frames[i].get("fx").get<double>();
-
-			sibr::InputCamera::Ptr camera = std::make_shared<InputCamera>(InputCamera(fy, fx, 0.0f, 0.0f, width, height, id));
-
-			picojson::array& pos = frames[i].get("position").get<picojson::array>();
+			const picojson::value & frame = frames[i];
+			int id = frame.get("id").get<double>();
+			std::string imgname = frame.get("img_name").get<std::string>();
+			int width = frame.get("width").get<double>();
+			int height = frame.get("height").get<double>();
+			float fy = frame.get("fy").get<double>();
+			float fx = frame.get("fx").get<double>();
+
+			InputCamera & camera = cameras[i];
+			camera = InputCamera(fy, fx, 0.0f, 0.0f, width, height, id);
+
+			const picojson::array& pos = frame.get("position").get<picojson::array>();
 			sibr::Vector3f position(pos[0].get<double>(), pos[1].get<double>(), pos[2].get<double>());
 
 			//position.x() = 0;
 			//position.y() = 0;
 			//position.z() = 1;
 
-			picojson::array& rot = frames[i].get("rotation").get<picojson::array>();
+			const picojson::array& rot = frame.get("rotation").get<picojson::array>();
 			sibr::Matrix3f orientation;
-			for (int i = 0; i < 3; i++)
+			for (int r = 0; r < 3; r++)
 			{
-				picojson::array& row = rot[i].get<picojson::array>();
-				for (int j = 0; j < 3; j++)
+				const picojson::array& row = rot[r].get<picojson::array>();
+				for (int c = 0; c < 3; c++)
 				{
-					orientation(i, j) = row[j].get<double>();
+					orientation(r, c) = row[c].get<double>();
 				}
 			}
 			orientation.col(1) = -orientation.col(1);
 			orientation.col(2) = -orientation.col(2);
 			//orientation = sibr::Matrix3f::Identity();
 
-			camera->name(imgname);
-			camera->position(position);
-			camera->rotation(sibr::Quaternionf(orientation));
-			camera->znear(zNear);
-			camera->zfar(zFar);
-			cameras.push_back(camera);
+			camera.name(imgname);
+			camera.position(position);
+			camera.rotation(sibr::Quaternionf(orientation));
+			camera.znear(zNear);
+			camera.zfar(zFar);
 		}
-		return cameras;
+		return shareCameras(std::move(cameras));
 	}
 
 	std::vector<InputCamera::Ptr> InputCamera::loadTransform(const std::string& transformPath, int w, int h, std::string extension, const float zNear, const float zFar, const int offset, const int fovXfovYFlag)
@@ -178,6 +178,44 @@ namespace sibr
 		*/
 		Vector3f			projectImgSpaceInvertY( const Vector3f& point3d  ) const;
 
+		/** Project points using perspective projection, same results as projectImgSpaceInvertY and frustumTest
+		* for each point. The points are in structure of arrays layout; the matrix is read once and the loop has
+		* no branch, so that it can be vectorized.
+		* \param count number of points
+		* \param xs,ys,zs world space coordinates of the points
+		* \param us,vs destination pixel coordinates, in [0,w]x[0,h], y pointing down
+		* \param depths destination depths in [-1,1], or nullptr
+		* \param inFrustum destination frustum test result (1 inside, 0 outside), or nullptr
+		*/
+		void				projectImgSpaceInvertY( size_t count, const float * xs, const float * ys, const float * zs,
+			float * us, float * vs, float * depths = nullptr, uint8_t * inFrustum = nullptr ) const;
+
+		/** Project points in several cameras at once, see the single camera version. Points are processed in blocks
+		* projected in all the cameras before moving to the next block, so that they are only read from memory once.
+		* Blocks are spread over threads for large counts.
+		* \param cameras the cameras
+		* \param count number of points
+		* \param xs,ys,zs world space coordinates of the points
+		* \param us,vs destination pixel coordinates, count values per camera, camera after camera
+		* \param depths destination depths, same layout, or nullptr
+		* \param inFrustum destination frustum test results, same layout, or nullptr
+		*/
+		static void			projectImgSpaceInvertY( const std::vector<const InputCamera *> & cameras, size_t count,
+			const float * xs, const float * ys, const float * zs,
+			float * us, float * vs, float * depths = nullptr, uint8_t * inFrustum = nullptr );
+
+		/** Project points in several cameras at once, see the version above.
+		* \param cameras the cameras
+		* \param count number of points
+		* \param xs,ys,zs world space coordinates of the points
+		* \param us,vs destination pixel coordinates, count values per camera, camera after camera
+		* \param depths destination depths, same layout, or nullptr
+		* \param inFrustum destination frustum test results, same layout, or nullptr
+		*/
+		static void			projectImgSpaceInvertY( const std::vector<InputCamera::Ptr> & cameras, size_t count,
+			const float * xs, const float * ys, const float * zs,
+			float * us, float * vs, float * depths = nullptr, uint8_t * inFrustum = nullptr );
+
 		/** Load from internal binary representation.
 		 * \param filename file path
 		 * \return success boolean
@@ -281,11 +319,26 @@ namespace sibr
 		* \param fovXfovYFlag should we use two dimensional fov.
 		* \returns the loaded cameras
 		* \note the camera frame is internally transformed to be consistent with fribr and RC.
+		* \note The files are memory mapped and the images parsed in parallel. The cameras are stored
+		* contiguously, the returned pointers share this storage.
 		*/
 		static std::vector<InputCamera::Ptr> loadColmap(const std::string& colmapSparsePath, const float zNear = 0.01f, const float zFar = 1000.0f, const int fovXfovYFlag = 0);
 
+		/** Load cameras from a Colmap binary model, faster to parse than the txt version.
+		* \param colmapSparsePath path to the Colmap sparse directory, should contains cameras.bin and images.bin
+		* \param zNear default near-plane value to use
+		* \param zFar default far-plane value to use.
+		* \param fovXfovYFlag should we use two dimensional fov.
+		* \returns the loaded cameras
+		*/
 		static std::vector<InputCamera::Ptr> loadColmapBin(const std::string& colmapSparsePath, const float zNear = 0.01f, const float zFar = 1000.0f, const int fovXfovYFlag = 0);
 
+		/** Load cameras from a cameras.json file, as exported by the Gaussian splatting training.
+		* \param jsonPath path to the JSON file
+		* \param zNear default near-plane value to use
+		* \param zFar default far-plane value to use.
+		* \returns the loaded cameras
+		*/
 		static std::vector<InputCamera::Ptr> loadJSON(const std::string& jsonPath, const float zNear = 0.01f, const float zFar = 1000.0f);
 
 		/** Load cameras from a bundle file.
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <sstream>
 #include "core/assets/Resources.hpp"
+#include "core/system/ResourcePack.hpp"
 
 /// \todo TODO: If you care about security (did someone want to hack/use your app
 /// to hide a virus/retrieve informations from this compiled code), comment
@@ -89,6 +90,25 @@ namespace sibr
 	}
 
 	std::string Resources::getResourceFilePathName(std::string const & filename, bool & success)
+	{
+		{
+			std::lock_guard<std::mutex> guard(_resolvedLock);
+			const auto known = _resolved.find(filename);
+			if (known != _resolved.end()) {
+				success = true;
+				return known->second;
+			}
+		}
+		// Missing files are not cached, they may be created later on.
+		const std::string filePathName = findResourceFilePathName(filename, success);
+		if (success) {
+			std::lock_guard<std::mutex> guard(_resolvedLock);
+			_resolved[filename] = filePathName;
+		}
+		return filePathName;
+	}
+
+	std::string Resources::findResourceFilePathName(std::string const & filename, bool & success) const
 	{
 		// we assume the first element of _rscPaths if the current dir
 		// Weird bug -- GD: I have no idea why, but if I dont call this the paths dont work under linux
@@ -97,9 +117,16 @@ namespace sibr
 		std::ifstream rscFileTest(filename);
 		if (success = rscFileTest.good()) 
 			return filename;
+		const ResourcePack & pack = ResourcePack::global();
 		for(std::string rscPath : _rscPaths)
 		{
 			std::string filePathName  = sibr::getInstallDirectory() + "/" + rscPath + "/" + filename;
+			// loadFile reads it from the pack.
+			const char * packed = nullptr;
+			size_t packedSize = 0;
+			if (success = pack.findInstalled(filePathName, packed, packedSize)) {
+				return filePathName;
+			}
 			std::ifstream rscFile(filePathName);
 			if (success = rscFile.good()) {
 				return filePathName;
@@ -14,8 +14,10 @@
 
 #include "core/assets/Config.hpp"
 
+#include <mutex>
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 namespace sibr
 {
@@ -37,7 +39,8 @@ namespace sibr
 		virtual ~Resources();
 
 	public:
-		/** Look for the filename into plausible resource paths.
+		/** Look for the filename into plausible resource paths, and the resource pack (see ResourcePack).
+		 * The found paths are cached, each file is only searched for once.
 		 * \param filename file name
 		 * \param success was the file found in the registered locations
 		 * \return the full file path
@@ -51,7 +54,16 @@ namespace sibr
 		std::string getResourceFilePathName(std::string const & filename);
 
 	protected:
+		/** Search the resource paths for a file.
+		 * \param filename file name
+		 * \param success was the file found in the registered locations
+		 * \return the full file path
+		 */
+		std::string findResourceFilePathName(std::string const & filename, bool & success) const;
+
 		std::vector<std::string>    _rscPaths; ///< List of directories to check into.
+		std::unordered_map<std::string, std::string> _resolved; ///< Found files, by requested name.
+		std::mutex                  _resolvedLock; ///< Guards the found files.
 		static Resources *          _instance; ///< Singleton.
 	};
 
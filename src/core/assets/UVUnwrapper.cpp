@@ -11,10 +11,20 @@
 
 
 #include "UVUnwrapper.hpp"
+#include <core/system/Hash.hpp>
 #include <core/system/SimpleTimer.hpp>
+#include <core/system/LoadingProgress.hpp>
+#include <core/system/Utils.hpp>
 #include <core/graphics/Utils.hpp>
 #include "xatlas.h"
 
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
 int printCallback(const char * format, ...) {
 	va_list args;
 	va_start(args, format);
@@ -24,15 +34,113 @@ int printCallback(const char * format, ...) {
 	return res;
 }
 
-bool progressCallback(xatlas::ProgressCategory category, int progress, void *userData){
-	std::cout << "\r\t" << xatlas::StringForEnum(category) << "[" << std::flush;
-	for (int i = 0; i < 10; i++)
-		std::cout << (progress / ((i + 1) * 10) ? "*" : " ");
-	std::cout << "] " << progress << "%" << std::flush;
-	if(progress == 100) {
-		std::cout << std::endl;
+namespace {
+
+	/** Forward xatlas progress to a LoadingProgress, one per processing stage. */
+	struct ProgressState {
+		std::mutex mutex; ///< xatlas reports from its worker threads.
+		int category = -1; ///< Current stage.
+		int progress = 0; ///< Current stage progress, in percents.
+		std::unique_ptr<sibr::LoadingProgress> bar; ///< Current stage progress bar.
+	};
+
+	bool progressCallback(xatlas::ProgressCategory category, int progress, void *userData) {
+		ProgressState & state = *static_cast<ProgressState*>(userData);
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (int(category) != state.category || !state.bar) {
+			state.category = int(category);
+			state.progress = 0;
+			state.bar.reset(new sibr::LoadingProgress(100, std::string("[UVMapper] ") + xatlas::StringForEnum(category)));
+		}
+		if (progress > state.progress) {
+			state.bar->walk(size_t(progress - state.progress));
+			state.progress = progress;
+		}
+		return true;
+	}
+
+	/** Part of the mesh unwrapped independently. */
+	struct Cluster {
+		std::vector<uint> vertices; ///< Input index of each vertex.
+		std::vector<sibr::Vector3f> positions; ///< Vertex positions.
+		std::vector<sibr::Vector3f> normals; ///< Vertex normals, if any.
+		std::vector<sibr::Vector2f> texcoords; ///< Vertex UVs, if any.
+		std::vector<uint32_t> indices; ///< Triangle indices, in local vertices.
+	};
+
+	/** Split a mesh by recursive median cuts along the largest extent of the triangle centroids.
+	 * Spatial clusters keep chart boundaries short, each one is parametrized by its own xatlas task. */
+	std::vector<Cluster> splitClusters(const sibr::Mesh & mesh, size_t maxSize) {
+		const sibr::Mesh::Triangles & tris = mesh.triangles();
+		const sibr::Mesh::Vertices & verts = mesh.vertices();
+		const int triCount = int(tris.size());
+
+		std::vector<sibr::Vector3f> centroids(tris.size());
+#pragma omp parallel for
+		for (int t = 0; t < triCount; ++t) {
+			centroids[t] = (verts[tris[t][0]] + verts[tris[t][1]] + verts[tris[t][2]]) / 3.0f;
+		}
+
+		std::vector<uint> order(tris.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::vector<std::pair<size_t, size_t>> ranges;
+		std::vector<std::pair<size_t, size_t>> stack = { { 0, tris.size() } };
+		while (!stack.empty()) {
+			const std::pair<size_t, size_t> range = stack.back();
+			stack.pop_back();
+			if (range.second - range.first <= maxSize) {
+				ranges.push_back(range);
+				continue;
+			}
+			Eigen::AlignedBox3f box;
+			for (size_t i = range.first; i < range.second; ++i) {
+				box.extend(centroids[order[i]]);
+			}
+			int axis = 0;
+			box.sizes().maxCoeff(&axis);
+			const size_t mid = (range.first + range.second) / 2;
+			std::nth_element(order.begin() + range.first, order.begin() + mid, order.begin() + range.second, [&](uint a, uint b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+			stack.emplace_back(mid, range.second);
+			stack.emplace_back(range.first, mid);
+		}
+
+		std::vector<Cluster> clusters(ranges.size());
+#pragma omp parallel for schedule(dynamic)
+		for (int cid = 0; cid < int(ranges.size()); ++cid) {
+			Cluster & cluster = clusters[cid];
+			const size_t begin = ranges[cid].first;
+			const size_t end = ranges[cid].second;
+			cluster.indices.reserve(3 * (end - begin));
+			for (size_t i = begin; i < end; ++i) {
+				for (int k = 0; k < 3; ++k) {
+					cluster.indices.push_back(tris[order[i]][k]);
+				}
+			}
+			// Local vertices, in input order.
+			cluster.vertices.assign(cluster.indices.begin(), cluster.indices.end());
+			std::sort(cluster.vertices.begin(), cluster.vertices.end());
+			cluster.vertices.erase(std::unique(cluster.vertices.begin(), cluster.vertices.end()), cluster.vertices.end());
+			for (uint32_t & id : cluster.indices) {
+				id = uint32_t(std::lower_bound(cluster.vertices.begin(), cluster.vertices.end(), id) - cluster.vertices.begin());
+			}
+			cluster.positions.reserve(cluster.vertices.size());
+			for (const uint v : cluster.vertices) {
+				cluster.positions.push_back(verts[v]);
+				if (mesh.hasNormals()) {
+					cluster.normals.push_back(mesh.normals()[v]);
+				}
+				if (mesh.hasTexCoords()) {
+					cluster.texcoords.push_back(mesh.texCoords()[v]);
+				}
+			}
+		}
+		return clusters;
 	}
-	return true;
+
+	const char kCacheMagic[8] = { 'S', 'I', 'B', 'R', 'U', 'V', '0', '1' };
+
 }
 
 void setPixel(uint8_t *dest, int destWidth, int x, int y, const sibr::Vector3ub & color){
@@ -98,43 +206,126 @@ void rasterizeTriangle(uint8_t *dest, int destWidth, const int *t0, const int *t
 
 using namespace sibr;
 
-UVUnwrapper::UVUnwrapper(const sibr::Mesh& mesh, unsigned int res) : _mesh(mesh) {
-	_size = res;
-	// Create empty atlas.
+UVUnwrapper::UVUnwrapper(const sibr::Mesh& mesh, unsigned int res, Preset preset, unsigned int clusterSize) :
+	_mesh(mesh), _size(res), _preset(preset), _clusterSize(clusterSize), _atlas(nullptr) {
 	xatlas::SetPrint(printCallback, false);
-	_atlas = xatlas::Create();
-	xatlas::SetProgressCallback(_atlas, progressCallback, nullptr);
-
-	// Add the mesh to the atlas.
-	SIBR_LOG << "[UVMapper] Adding one mesh with " << mesh.vertices().size() << " vertices and " << mesh.triangles().size() << " triangles." << std::endl;
-	// For now consider everything as one mesh. Splitting in components *might* help.
-	xatlas::MeshDecl meshDecl;
-	meshDecl.vertexCount = uint32_t(mesh.vertices().size());
-	meshDecl.vertexPositionData = mesh.vertexArray();
-	meshDecl.vertexPositionStride = sizeof(sibr::Vector3f);
-	if (mesh.hasNormals()) {
-		meshDecl.vertexNormalData = mesh.normalArray();
-		meshDecl.vertexNormalStride = sizeof(sibr::Vector3f);
+}
+
+std::string UVUnwrapper::cachePath() const {
+	static const std::string directory = []() {
+		const std::string dir = getAppDataDirectory() + "/uv_cache";
+		makeDirectory(dir);
+		return dir;
+	}();
+
+	sibr::Hasher hasher;
+	hasher.update(_mesh.vertexArray(), _mesh.vertices().size() * sizeof(sibr::Vector3f));
+	hasher.update(_mesh.triangleArray(), _mesh.triangles().size() * sizeof(sibr::Vector3u));
+	if (_mesh.hasNormals()) {
+		hasher.update(_mesh.normalArray(), _mesh.normals().size() * sizeof(sibr::Vector3f));
 	}
-	// UV can be used as a hint.
-	if (mesh.hasTexCoords()) {
-		meshDecl.vertexUvData = mesh.texCoordArray();
-		meshDecl.vertexUvStride = sizeof(sibr::Vector2f);
+	if (_mesh.hasTexCoords()) {
+		hasher.update(_mesh.texCoordArray(), _mesh.texCoords().size() * sizeof(sibr::Vector2f));
 	}
-	meshDecl.indexCount = uint32_t(mesh.triangles().size() * 3);
-	meshDecl.indexData = mesh.triangleArray();
-	meshDecl.indexFormat = xatlas::IndexFormat::UInt32;
-	const xatlas::AddMeshError error = xatlas::AddMesh(_atlas, meshDecl, 1);
-	if (error != xatlas::AddMeshError::Success) {
-		xatlas::Destroy(_atlas);
-		SIBR_ERR << "\r[UVMapper] Error adding mesh: " << xatlas::StringForEnum(error) << std::endl;
+	const uint32_t params[] = { _size, uint32_t(_preset), _clusterSize, uint32_t(_mesh.vertices().size()), uint32_t(_mesh.triangles().size()) };
+	hasher.update(params, sizeof(params));
+
+	return directory + "/" + hasher.digest128().toString() + ".bin";
+}
+
+sibr::Mesh::Ptr UVUnwrapper::buildMesh(const std::vector<sibr::Vector2f> & texcoords, const std::vector<sibr::Vector3u> & triangles) const {
+	std::vector<sibr::Vector3f> positions(_mapping.size());
+	std::vector<sibr::Vector3f> normals(_mesh.hasNormals() ? _mapping.size() : 0);
+	std::vector<sibr::Vector3f> colors(_mesh.hasColors() ? _mapping.size() : 0);
+#pragma omp parallel for
+	for (int v = 0; v < int(_mapping.size()); ++v) {
+		const uint ref = _mapping[v];
+		positions[v] = _mesh.vertices()[ref];
+		if (_mesh.hasNormals()) {
+			normals[v] = _mesh.normals()[ref];
+		}
+		if (_mesh.hasColors()) {
+			colors[v] = _mesh.colors()[ref];
+		}
 	}
-	// Not necessary. Only called here so geometry totals are printed after the AddMesh progress indicator
-	xatlas::AddMeshJoin(_atlas);
+	Mesh::Ptr finalMesh(new Mesh(false));
+	finalMesh->vertices(positions);
+	finalMesh->normals(normals);
+	finalMesh->texCoords(texcoords);
+	finalMesh->colors(colors);
+	finalMesh->triangles(triangles);
+	return finalMesh;
 }
 
-	
 sibr::Mesh::Ptr UVUnwrapper::unwrap() {
+	_mapping.clear();
+	std::vector<sibr::Vector2f> texcoords;
+	std::vector<sibr::Vector3u> triangles;
+
+	// Reuse a previous result if possible.
+	const std::string cacheFile = _useCache ? cachePath() : "";
+	if (!cacheFile.empty()) {
+		std::ifstream file(cacheFile, std::ios::binary);
+		char magic[8] = { 0 };
+		uint32_t counts[2] = { 0, 0 };
+		if (file.read(magic, sizeof(magic)) && std::memcmp(magic, kCacheMagic, sizeof(magic)) == 0
+			&& file.read(reinterpret_cast<char*>(counts), sizeof(counts))) {
+			_mapping.resize(counts[0]);
+			texcoords.resize(counts[0]);
+			triangles.resize(counts[1]);
+			file.read(reinterpret_cast<char*>(_mapping.data()), _mapping.size() * sizeof(uint));
+			file.read(reinterpret_cast<char*>(texcoords.data()), texcoords.size() * sizeof(sibr::Vector2f));
+			file.read(reinterpret_cast<char*>(triangles.data()), triangles.size() * sizeof(sibr::Vector3u));
+			if (file) {
+				SIBR_LOG << "[UVMapper] Loaded cached atlas " << cacheFile << "." << std::endl;
+				return buildMesh(texcoords, triangles);
+			}
+			_mapping.clear();
+			SIBR_WRG << "[UVMapper] Invalid cached atlas " << cacheFile << ", regenerating." << std::endl;
+		}
+	}
+
+	// Create empty atlas.
+	if (_atlas) {
+		xatlas::Destroy(_atlas);
+	}
+	_atlas = xatlas::Create();
+	ProgressState progress;
+	xatlas::SetProgressCallback(_atlas, progressCallback, &progress);
+
+	// Split the mesh, each cluster is segmented and parametrized concurrently by xatlas, then all charts are packed together.
+	const std::vector<Cluster> clusters = splitClusters(_mesh, _clusterSize == 0 ? _mesh.triangles().size() : size_t(_clusterSize));
+	SIBR_LOG << "[UVMapper] Adding " << clusters.size() << " clusters for " << _mesh.vertices().size() << " vertices and " << _mesh.triangles().size() << " triangles." << std::endl;
+	for (const Cluster & cluster : clusters) {
+		xatlas::MeshDecl meshDecl;
+		meshDecl.vertexCount = uint32_t(cluster.positions.size());
+		meshDecl.vertexPositionData = cluster.positions.data();
+		meshDecl.vertexPositionStride = sizeof(sibr::Vector3f);
+		if (!cluster.normals.empty()) {
+			meshDecl.vertexNormalData = cluster.normals.data();
+			meshDecl.vertexNormalStride = sizeof(sibr::Vector3f);
+		}
+		// UV can be used as a hint.
+		if (!cluster.texcoords.empty()) {
+			meshDecl.vertexUvData = cluster.texcoords.data();
+			meshDecl.vertexUvStride = sizeof(sibr::Vector2f);
+		}
+		meshDecl.indexCount = uint32_t(cluster.indices.size());
+		meshDecl.indexData = cluster.indices.data();
+		meshDecl.indexFormat = xatlas::IndexFormat::UInt32;
+		const xatlas::AddMeshError error = xatlas::AddMesh(_atlas, meshDecl, uint32_t(clusters.size()));
+		if (error != xatlas::AddMeshError::Success) {
+			xatlas::Destroy(_atlas);
+			_atlas = nullptr;
+			SIBR_ERR << "\r[UVMapper] Error adding mesh: " << xatlas::StringForEnum(error) << std::endl;
+		}
+	}
+	xatlas::AddMeshJoin(_atlas);
+
+	_clusterVertices.resize(clusters.size());
+	for (size_t cid = 0; cid < clusters.size(); ++cid) {
+		_clusterVertices[cid] = clusters[cid].vertices;
+	}
 
 	// Generate atlas.
 	SIBR_LOG << "[UVMapper] Generating atlas.." << std::endl;
@@ -143,9 +334,18 @@ sibr::Mesh::Ptr UVUnwrapper::unwrap() {
 	xatlas::PackOptions packOptions = xatlas::PackOptions();
 	packOptions.bruteForce = false;
 	packOptions.resolution = uint32_t(_size);
+	if (_preset == Preset::FAST) {
+		chartOptions.maxIterations = 1;
+		packOptions.blockAlign = true;
+	}
+	else if (_preset == Preset::BEST) {
+		chartOptions.maxIterations = 4;
+		packOptions.bruteForce = true;
+	}
 	Timer timer;
 	timer.tic();
 	xatlas::Generate(_atlas, chartOptions, packOptions);
+	xatlas::SetProgressCallback(_atlas, nullptr, nullptr);
 
 	SIBR_LOG << "[UVMapper] Generation took: " << timer.deltaTimeFromLastTic<Timer::s>() << "s." << std::endl;
 	SIBR_LOG << "[UVMapper] Output resolution: " << _atlas->width << "x" << _atlas->height << std::endl;
@@ -165,29 +365,15 @@ sibr::Mesh::Ptr UVUnwrapper::unwrap() {
 	SIBR_LOG << "[UVMapper] Output geometry data: " << totalVertices << " vertices, " << totalFaces << " triangles." << std::endl;
 	// Write meshes.
 	uint32_t firstVertex = 0;
-	std::vector<sibr::Vector3f> positions;
-	std::vector<sibr::Vector3f> normals;
-	std::vector<sibr::Vector2f> texcoords;
-	std::vector<sibr::Vector3f> colors;
-	std::vector<sibr::Vector3u> triangles;
-	
-	// We could preallocate and paraellize if needed.
+	_mapping.reserve(totalVertices);
+	texcoords.reserve(totalVertices);
+	triangles.reserve(totalFaces);
 	for (uint32_t i = 0; i < _atlas->meshCount; i++) {
 		const xatlas::Mesh& xmesh = _atlas->meshes[i];
+		const std::vector<uint> & clusterVertices = _clusterVertices[i];
 		for (uint32_t v = 0; v < xmesh.vertexCount; v++) {
 			const xatlas::Vertex& vertex = xmesh.vertexArray[v];
-			const sibr::Vector3f& pos = _mesh.vertices()[vertex.xref];
-			positions.emplace_back(pos);
-			if (_mesh.hasNormals()) {
-				const sibr::Vector3f& n = _mesh.normals()[vertex.xref];
-				normals.emplace_back(n);
-			}
-			if (_mesh.hasColors()) {
-				const sibr::Vector3f& c = _mesh.colors()[vertex.xref];
-				colors.emplace_back(c);
-			}
-			
-			_mapping.emplace_back(vertex.xref);
+			_mapping.emplace_back(clusterVertices[vertex.xref]);
 			texcoords.emplace_back(vertex.uv[0] / float(_atlas->width), vertex.uv[1] / float(_atlas->height));
 		}
 		for (uint32_t f = 0; f < xmesh.indexCount; f += 3) {
@@ -198,12 +384,20 @@ sibr::Mesh::Ptr UVUnwrapper::unwrap() {
 		}
 		firstVertex += xmesh.vertexCount;
 	}
-	Mesh::Ptr finalMesh(new Mesh(false));
-	finalMesh->vertices(positions);
-	finalMesh->normals(normals);
-	finalMesh->texCoords(texcoords);
-	finalMesh->colors(colors);
-	finalMesh->triangles(triangles);
+	Mesh::Ptr finalMesh = buildMesh(texcoords, triangles);
+
+	if (!cacheFile.empty()) {
+		std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+		const uint32_t counts[2] = { uint32_t(_mapping.size()), uint32_t(triangles.size()) };
+		file.write(kCacheMagic, sizeof(kCacheMagic));
+		file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+		file.write(reinterpret_cast<const char*>(_mapping.data()), _mapping.size() * sizeof(uint));
+		file.write(reinterpret_cast<const char*>(texcoords.data()), texcoords.size() * sizeof(sibr::Vector2f));
+		file.write(reinterpret_cast<const char*>(triangles.data()), triangles.size() * sizeof(sibr::Vector3u));
+		if (!file) {
+			SIBR_WRG << "[UVMapper] Unable to write cached atlas " << cacheFile << "." << std::endl;
+		}
+	}
 
 	SIBR_LOG << "[UVMapper] Done." << std::endl;
 	return finalMesh;
@@ -271,6 +465,8 @@ std::vector<ImageRGB::Ptr> UVUnwrapper::atlasVisualization() const {
 }
 
 UVUnwrapper::~UVUnwrapper() {
-	xatlas::Destroy(_atlas);
+	if (_atlas) {
+		xatlas::Destroy(_atlas);
+	}
 }
 
@@ -28,17 +28,33 @@ namespace sibr
 	class SIBR_ASSETS_EXPORT UVUnwrapper {
 	public:
 
+		/** Trade-off between charts and packing quality and processing time. */
+		enum class Preset {
+			FAST, ///< Single charts growing pass, coarse packing.
+			BALANCED, ///< xatlas defaults.
+			BEST ///< Several charts growing passes, brute force packing.
+		};
+
 		/** Constructor.
 		 *\param mesh the mesh to unwrap, if UVs are already present they will be used as a guide
 		 *\param res the target texture width, will determine UV accuracy
+		 *\param preset the quality preset
+		 *\param clusterSize the mesh is split in spatial clusters of at most this number of triangles,
+		 * processed concurrently and packed together in the end (0 to keep a single cluster)
 		 */
-		UVUnwrapper(const sibr::Mesh& mesh, unsigned int res);
+		UVUnwrapper(const sibr::Mesh& mesh, unsigned int res, Preset preset = Preset::BALANCED, unsigned int clusterSize = 250000);
 
 		/** Unwrap the mesh, return a copy with UV coordinates. Note that some vertices might be duplicated if they are assigned different UVs in two faces.
 		 * \return the unwrapped mesh
 		 */
 		sibr::Mesh::Ptr unwrap();
 
+		/** If enabled, unwrapping results are stored in the application data directory,
+		 * keyed on the mesh content and the unwrapping parameters, and reused by later calls.
+		 * \return a reference to the toggle
+		 */
+		bool & useCache() { return _useCache; }
+
 		/** For each vertex of the unwrapped mesh, the mapping give the index of the corresponding vertex in the input mesh.
 		 * \return a reference to the mapping vector
 		 */
@@ -53,10 +69,24 @@ namespace sibr
 		~UVUnwrapper();
 		
 	private:
+
+		/** \return the path of the cache entry for the current mesh and parameters. */
+		std::string cachePath() const;
+
+		/** Build the output mesh from the current mapping.
+		 *\param texcoords the output vertices UVs
+		 *\param triangles the output triangles
+		 *\return the unwrapped mesh
+		 */
+		sibr::Mesh::Ptr buildMesh(const std::vector<sibr::Vector2f> & texcoords, const std::vector<sibr::Vector3u> & triangles) const;
 		
 		const sibr::Mesh& _mesh; ///< Unwrapped mesh.
 		unsigned int _size; ///< Width of the atlas, detemrine the accuracy of the estimated UVs.
+		Preset _preset; ///< Quality preset.
+		unsigned int _clusterSize; ///< Maximum number of triangles per cluster.
+		bool _useCache = false; ///< Reuse previous unwrapping results.
 		xatlas::Atlas* _atlas; ///< Atlas object.
+		std::vector<std::vector<uint>> _clusterVertices; ///< For each cluster, the input mesh index of each of its vertices.
 		std::vector<uint> _mapping; ///< Mapping from the new vertices to the old (some might be duplicated with different UV values).
 		
 	};
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/AsyncImageWriter.hpp"
+
+namespace sibr {
+
+	AsyncImageWriter::AsyncImageWriter(uint threadCount, size_t maxPending)
+	{
+		if (threadCount == 0) {
+			// Encoding is mostly compression, a few threads are enough to keep up with the GPU.
+			threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), 4u);
+		}
+		_maxPending = maxPending == 0 ? 2 * size_t(threadCount) : maxPending;
+		for (uint t = 0; t < threadCount; ++t) {
+			_workers.emplace_back(&AsyncImageWriter::workerLoop, this);
+		}
+	}
+
+	AsyncImageWriter::~AsyncImageWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_jobReady.notify_all();
+		for (std::thread & worker : _workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+	}
+
+	void AsyncImageWriter::save(ImageRGB && image, const std::string & path)
+	{
+		Job job;
+		job.image = std::move(image);
+		job.path = path;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobDone.wait(lock, [this] { return _jobs.size() < _maxPending; });
+			_jobs.push_back(std::move(job));
+		}
+		_jobReady.notify_one();
+	}
+
+	void AsyncImageWriter::wait()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_jobDone.wait(lock, [this] { return _jobs.empty() && _inFlight == 0; });
+	}
+
+	size_t AsyncImageWriter::pending() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _jobs.size() + _inFlight;
+	}
+
+	void AsyncImageWriter::workerLoop()
+	{
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_jobReady.wait(lock, [this] { return _stop || !_jobs.empty(); });
+				if (_jobs.empty()) {
+					// Stopped and nothing left to write.
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+				++_inFlight;
+			}
+			// Room was made in the queue.
+			_jobDone.notify_all();
+
+			// Several workers can create the same directory, ignore the error of the late ones.
+			const Path directory = Path(job.path).parent_path();
+			if (!directory.empty()) {
+				boost::system::error_code ec;
+				boost::filesystem::create_directories(directory, ec);
+			}
+			job.image.save(job.path, false);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				--_inFlight;
+			}
+			_jobDone.notify_all();
+		}
+	}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/Image.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Encodes and writes images to disk on a pool of worker threads, so that the caller
+	 * (usually the render thread) only pays for handing the image over.
+	 *
+	 *		AsyncImageWriter writer;
+	 *		writer.save(std::move(img), "./screenshots/view.png");
+	 *		// ...
+	 *		writer.wait();
+	 *
+	 * \note The number of images waiting to be written is bounded, save blocks when the workers are late.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT AsyncImageWriter {
+		SIBR_CLASS_PTR(AsyncImageWriter);
+		SIBR_DISALLOW_COPY(AsyncImageWriter);
+
+	public:
+
+		/** Constructor.
+		\param threadCount number of worker threads, 0 to use the hardware concurrency (up to 4)
+		\param maxPending images that can wait to be written, 0 for twice the thread count
+		*/
+		AsyncImageWriter(uint threadCount = 0, size_t maxPending = 0);
+
+		/// Destructor, writes all remaining images.
+		~AsyncImageWriter();
+
+		/** Queue an image for writing, the destination directory is created if needed.
+		\param image the image to write, moved into the queue
+		\param path the destination file, its extension gives the format
+		*/
+		void save(ImageRGB && image, const std::string & path);
+
+		/** Wait until all queued images have been written. */
+		void wait();
+
+		/** \return the number of images queued or being written. */
+		size_t pending() const;
+
+	private:
+
+		/// An image waiting to be written.
+		struct Job {
+			ImageRGB image; ///< Image content.
+			std::string path; ///< Destination file.
+		};
+
+		/// Pop and write images until stopped.
+		void workerLoop();
+
+		std::vector<std::thread> _workers; ///< Writing threads.
+		std::deque<Job> _jobs; ///< Images waiting for a worker.
+		size_t _maxPending; ///< Maximum number of queued images.
+		size_t _inFlight = 0; ///< Images being written.
+		bool _stop = false; ///< Ask the workers to exit once the queue is empty.
+		mutable std::mutex _mutex; ///< Protects the queue and counters.
+		std::condition_variable _jobReady; ///< Signaled when an image is queued or on stop.
+		std::condition_variable _jobDone; ///< Signaled when an image has been taken or written.
+	};
+
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "BindlessTextureSet.hpp"
+#include "GPUMemoryBudget.hpp"
+#include "core/system/FrameArena.hpp"
+#include <algorithm>
+
+namespace sibr {
+
+	bool BindlessTextureSet::isSupported(void)
+	{
+		return GLEW_ARB_bindless_texture != 0;
+	}
+
+	BindlessTextureSet::BindlessTextureSet(const std::vector<ImageRGB::Ptr> & images, size_t budget, uint flags) :
+		_images(images), _flags(flags), _budget(budget)
+	{
+		_entries.resize(_images.size());
+		_handles.assign(std::max(_images.size(), size_t(1)), 0);
+		glCreateBuffers(1, &_handlesBuffer);
+		glNamedBufferStorage(_handlesBuffer, GLsizeiptr(sizeof(GLuint64) * _handles.size()), _handles.data(), GL_DYNAMIC_STORAGE_BIT);
+		_handlesDirty = false;
+		CHECK_GL_ERROR;
+
+		_budgetId = GPUMemoryBudget::global().add("Bindless textures", GPUMemoryBudget::STREAMED, [this](size_t bytes) {
+			return trim(bytes);
+		});
+	}
+
+	BindlessTextureSet::~BindlessTextureSet(void)
+	{
+		GPUMemoryBudget::global().remove(_budgetId);
+		for (size_t id = 0; id < _entries.size(); ++id) {
+			if (_entries[id].texture) {
+				pageOut(id);
+			}
+		}
+		glDeleteBuffers(1, &_handlesBuffer);
+	}
+
+	void BindlessTextureSet::bind(GLuint binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, _handlesBuffer);
+	}
+
+	void BindlessTextureSet::update(const uint * wanted, size_t count)
+	{
+		++_frame;
+		for (size_t w = 0; w < count; ++w) {
+			_entries[wanted[w]].lastUse = _frame;
+		}
+
+		// Least recently wanted first.
+		FrameVector<size_t> evictable(&FrameArena::frame());
+		evictable.reserve(_entries.size());
+		for (size_t id = 0; id < _entries.size(); ++id) {
+			if (_entries[id].texture && _entries[id].lastUse != _frame) {
+				evictable.push_back(id);
+			}
+		}
+		std::sort(evictable.begin(), evictable.end(), [this](size_t a, size_t b) {
+			return _entries[a].lastUse < _entries[b].lastUse;
+		});
+
+		_missing = 0;
+		int uploads = 0;
+		size_t nextEvicted = 0;
+		for (size_t w = 0; w < count; ++w) {
+			const uint id = wanted[w];
+			if (_entries[id].texture) {
+				continue;
+			}
+			const size_t bytes = textureBytes(id);
+			while (_residentBytes + bytes > _budget && nextEvicted < evictable.size()) {
+				pageOut(evictable[nextEvicted++]);
+			}
+			if (_residentBytes + bytes > _budget || uploads >= _uploadsPerFrame) {
+				++_missing;
+				continue;
+			}
+			pageIn(id);
+			++uploads;
+		}
+
+		if (_handlesDirty) {
+			glNamedBufferSubData(_handlesBuffer, 0, GLsizeiptr(sizeof(GLuint64) * _handles.size()), _handles.data());
+			_handlesDirty = false;
+		}
+		CHECK_GL_ERROR;
+	}
+
+	size_t BindlessTextureSet::trim(size_t bytes)
+	{
+		std::vector<size_t> resident;
+		for (size_t id = 0; id < _entries.size(); ++id) {
+			if (_entries[id].texture) {
+				resident.push_back(id);
+			}
+		}
+		std::sort(resident.begin(), resident.end(), [this](size_t a, size_t b) {
+			return _entries[a].lastUse < _entries[b].lastUse;
+		});
+		const size_t before = _residentBytes;
+		for (size_t i = 0; i < resident.size() && before - _residentBytes < bytes; ++i) {
+			pageOut(resident[i]);
+		}
+		// The shaders must not see the deleted handles, and the budget keeps the textures from coming back.
+		if (_handlesDirty) {
+			glNamedBufferSubData(_handlesBuffer, 0, GLsizeiptr(sizeof(GLuint64) * _handles.size()), _handles.data());
+			_handlesDirty = false;
+		}
+		_budget = std::min(_budget, _residentBytes);
+		CHECK_GL_ERROR;
+		return before - _residentBytes;
+	}
+
+	size_t BindlessTextureSet::textureBytes(size_t id) const
+	{
+		const size_t base = size_t(_images[id]->w()) * size_t(_images[id]->h()) * 4; // RGB8 is padded to 4 bytes.
+		return (_flags & SIBR_GPU_AUTOGEN_MIPMAP) ? base + base / 3 : base;
+	}
+
+	void BindlessTextureSet::pageIn(size_t id)
+	{
+		const ImageRGB & image = *_images[id];
+		const GLsizei w = GLsizei(image.w());
+		const GLsizei h = GLsizei(image.h());
+		const bool mipmaps = (_flags & SIBR_GPU_AUTOGEN_MIPMAP) != 0;
+		GLsizei levels = 1;
+		if (mipmaps) {
+			while ((std::max(w, h) >> levels) > 0) {
+				++levels;
+			}
+		}
+
+		Entry & entry = _entries[id];
+		glCreateTextures(GL_TEXTURE_2D, 1, &entry.texture);
+		glTextureStorage2D(entry.texture, levels, GL_RGB8, w, h);
+		const bool linear = (_flags & SIBR_GPU_LINEAR_SAMPLING) != 0;
+		glTextureParameteri(entry.texture, GL_TEXTURE_MIN_FILTER, linear ? (mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR) : (mipmaps ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST));
+		glTextureParameteri(entry.texture, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+		glTextureParameteri(entry.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(entry.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (_flags & SIBR_FLIP_TEXTURE) {
+			ImageRGB flipped = image.clone();
+			flipped.flipH();
+			glTextureSubImage2D(entry.texture, 0, 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+		}
+		else {
+			glTextureSubImage2D(entry.texture, 0, 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+		}
+		if (mipmaps) {
+			glGenerateTextureMipmap(entry.texture);
+		}
+
+		// The texture state is frozen once a handle exists.
+		entry.handle = glGetTextureHandleARB(entry.texture);
+		glMakeTextureHandleResidentARB(entry.handle);
+		entry.bytes = textureBytes(id);
+		_residentBytes += entry.bytes;
+		_memory.set(_residentBytes);
+		_handles[id] = entry.handle;
+		_handlesDirty = true;
+	}
+
+	void BindlessTextureSet::pageOut(size_t id)
+	{
+		Entry & entry = _entries[id];
+		glMakeTextureHandleNonResidentARB(entry.handle);
+		glDeleteTextures(1, &entry.texture);
+		entry.texture = 0;
+		entry.handle = 0;
+		_residentBytes -= entry.bytes;
+		_memory.set(_residentBytes);
+		entry.bytes = 0;
+		_handles[id] = 0;
+		_handlesDirty = true;
+	}
+
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/Image.hpp>
+#include <core/graphics/MemoryTracker.hpp>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Set of RGB textures, one per input image at its native size, sampled through bindless
+	 * handles (ARB_bindless_texture). Unlike a texture array, images of different resolutions
+	 * are neither padded nor resampled.
+	 *
+	 * The handles are stored in a shader storage buffer indexed by image, as uvec2:
+	 *		layout(std430, binding = 8) readonly buffer BindlessImages { uvec2 imageHandles[]; };
+	 *		vec3 rgb = texture(sampler2D(imageHandles[i]), uv).rgb;
+	 * Textures are created on demand under a memory budget: update() receives the images
+	 * wanted for the next frames, most important first, and evicts the least recently wanted ones.
+	 * The handle of an image that is not resident is zero, shaders have to skip it.
+	 *
+	 * \note Textures are uploaded from the CPU images, which must stay alive.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT BindlessTextureSet
+	{
+		SIBR_CLASS_PTR(BindlessTextureSet);
+		SIBR_DISALLOW_COPY(BindlessTextureSet);
+
+	public:
+
+		/** \return true if the GPU supports bindless textures. */
+		static bool isSupported(void);
+
+		/** Create the handles buffer, no texture is resident yet.
+		\param images the images, they must outlive the set
+		\param budget the maximum memory used by the textures, in bytes
+		\param flags options (SIBR_GPU_LINEAR_SAMPLING, SIBR_GPU_AUTOGEN_MIPMAP, SIBR_FLIP_TEXTURE)
+		*/
+		BindlessTextureSet(const std::vector<ImageRGB::Ptr> & images, size_t budget, uint flags = 0);
+
+		/// Destructor.
+		~BindlessTextureSet(void);
+
+		/** Bind the handles buffer.
+		\param binding the shader storage binding
+		*/
+		void bind(GLuint binding) const;
+
+		/** Make textures resident, in order, while they fit in the budget and the per-frame upload count.
+		\param wanted the images to keep resident, most important first
+		\param count the number of wanted images
+		*/
+		void update(const uint * wanted, size_t count);
+
+		/** Make textures resident, in order, while they fit in the budget and the per-frame upload count.
+		\param wanted the images to keep resident, most important first
+		*/
+		void update(const std::vector<uint> & wanted) { update(wanted.data(), wanted.size()); }
+
+		/** \return the number of images. */
+		size_t size(void) const { return _entries.size(); }
+
+		/** \return true if the texture of an image is resident. */
+		bool isResident(size_t id) const { return _entries[id].texture != 0; }
+
+		/** \return the memory used by the resident textures, in bytes. */
+		size_t residentBytes(void) const { return _residentBytes; }
+
+		/** Release the least recently wanted textures and lower the budget to what is left, see GPUMemoryBudget.
+		\param bytes the memory to release
+		\return the memory released, in bytes
+		*/
+		size_t trim(size_t bytes);
+
+		/** \return the memory budget, in bytes. */
+		size_t & budget(void) { return _budget; }
+
+		/** \return the maximum number of textures uploaded per update. */
+		int & uploadsPerFrame(void) { return _uploadsPerFrame; }
+
+		/** \return the number of images wanted by the last update that are not resident. */
+		size_t missingImages(void) const { return _missing; }
+
+	private:
+
+		/// Texture of an image.
+		struct Entry {
+			GLuint texture = 0; ///< Texture, 0 if not resident.
+			GLuint64 handle = 0; ///< Resident bindless handle.
+			size_t bytes = 0; ///< Memory used by the texture, mip levels included.
+			uint64 lastUse = 0; ///< Last update that wanted the image.
+		};
+
+		/** Create and upload the texture of an image and make its handle resident. */
+		void pageIn(size_t id);
+
+		/** Release the texture of an image. */
+		void pageOut(size_t id);
+
+		/** \return the memory used by the texture of an image, in bytes. */
+		size_t textureBytes(size_t id) const;
+
+		const std::vector<ImageRGB::Ptr> & _images; ///< Source images.
+		uint _flags; ///< Options.
+		std::vector<Entry> _entries; ///< Texture of each image.
+		std::vector<GLuint64> _handles; ///< CPU copy of the handles buffer.
+		GLuint _handlesBuffer = 0; ///< Handles, one per image.
+		bool _handlesDirty = true; ///< The buffer has to be updated.
+		size_t _budget; ///< Memory budget.
+		size_t _residentBytes = 0; ///< Memory used.
+		TrackedMemory _memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Memory used, reported to the tracker.
+		size_t _missing = 0; ///< Wanted images not resident after the last update.
+		int _uploadsPerFrame = 4; ///< Upload count limit per update.
+		uint64_t _budgetId = 0; ///< Registration in the GPUMemoryBudget.
+		uint64 _frame = 0; ///< Update counter.
+	};
+
+}
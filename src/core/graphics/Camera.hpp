@@ -222,6 +222,9 @@ namespace sibr
 		*/
 		void principalPoint(const sibr::Vector2f & p);
 
+		/** \return the camera principal point, expressed in [0,1] */
+		const sibr::Vector2f & principalPoint(void) const;
+
 		/** Interpolate between two cameras.
 		\param from start camera
 		\param to end camera
@@ -391,6 +394,10 @@ namespace sibr
 		_p = p; _dirtyViewProj = true;
 	}
 
+	inline const sibr::Vector2f & Camera::principalPoint(void) const {
+		return _p;
+	}
+
 	inline void	Camera::orthoRight( float value ) {
 		_right = value; _dirtyViewProj = true;
 	}
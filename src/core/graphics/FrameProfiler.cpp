@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "FrameProfiler.hpp"
+#include "core/system/Utils.hpp"
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+
+namespace sibr {
+
+	namespace {
+
+		// Scopes kept per thread between two frames.
+		const size_t kThreadRingSize = 4096;
+
+		/// Escape a name for a JSON string.
+		std::string jsonEscape(const char * name)
+		{
+			std::string out;
+			for (const char * c = name; *c; ++c) {
+				if (*c == '"' || *c == '\\') {
+					out.push_back('\\');
+				}
+				out.push_back(*c);
+			}
+			return out;
+		}
+
+		/// Stable color for a scope name.
+		ImU32 scopeColor(const char * name)
+		{
+			const size_t hash = std::hash<std::string>()(name);
+			const int r = 90 + int(hash & 0x7F);
+			const int g = 90 + int((hash >> 8) & 0x7F);
+			const int b = 90 + int((hash >> 16) & 0x7F);
+			return IM_COL32(r, g, b, 255);
+		}
+	}
+
+	FrameProfiler & FrameProfiler::get()
+	{
+		static FrameProfiler profiler;
+		return profiler;
+	}
+
+	FrameProfiler::FrameProfiler() :
+		_origin(std::chrono::steady_clock::now())
+	{
+		_current.index = _frameIndex;
+		_current.start = now();
+	}
+
+	int64_t FrameProfiler::now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _origin).count();
+	}
+
+	FrameProfiler::ThreadBuffer & FrameProfiler::threadBuffer()
+	{
+		thread_local ThreadBuffer * buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> guard(_threadsLock);
+			_threads.emplace_back(new ThreadBuffer());
+			buffer = _threads.back().get();
+			buffer->ring.resize(kThreadRingSize);
+			buffer->track = uint(_threads.size() - 1);
+		}
+		return *buffer;
+	}
+
+	void FrameProfiler::beginCPU(const char * name)
+	{
+		ThreadBuffer & buffer = threadBuffer();
+		buffer.open.emplace_back(name, now());
+	}
+
+	void FrameProfiler::endCPU()
+	{
+		ThreadBuffer & buffer = threadBuffer();
+		if (buffer.open.empty()) {
+			return;
+		}
+		Event event;
+		event.name = buffer.open.back().first;
+		event.start = buffer.open.back().second;
+		event.end = now();
+		event.track = buffer.track;
+		buffer.open.pop_back();
+		event.depth = uint(buffer.open.size());
+
+		// Only contended while nextFrame gathers the scopes.
+		std::lock_guard<std::mutex> guard(buffer.lock);
+		buffer.ring[buffer.head] = event;
+		buffer.head = (buffer.head + 1) % buffer.ring.size();
+		buffer.count = std::min(buffer.count + 1, buffer.ring.size());
+	}
+
+	void FrameProfiler::beginGPU(const char * name)
+	{
+		GPUTimerPool::global().begin(name);
+	}
+
+	void FrameProfiler::endGPU()
+	{
+		GPUTimerPool::global().end();
+	}
+
+	FrameProfiler::Frame * FrameProfiler::frame(uint64_t index)
+	{
+		if (index == _current.index) {
+			return &_current;
+		}
+		for (auto it = _frames.rbegin(); it != _frames.rend(); ++it) {
+			if (it->index == index) {
+				return &(*it);
+			}
+		}
+		return nullptr;
+	}
+
+	void FrameProfiler::addGPU(const GPUTimerPool::Timing & timing)
+	{
+		// The pool frames are advanced with ours, so its frame numbers are ours.
+		if (Frame * dst = frame(timing.frame)) {
+			Event event;
+			event.name = timing.name;
+			event.start = int64_t(timing.start) + _gpuOffset;
+			event.end = int64_t(timing.end) + _gpuOffset;
+			event.track = gpuTrack;
+			event.depth = timing.depth;
+			dst->events.push_back(event);
+		}
+	}
+
+	void FrameProfiler::nextFrame()
+	{
+		// Gather the scopes completed on all threads, oldest first.
+		{
+			std::lock_guard<std::mutex> threadsGuard(_threadsLock);
+			for (const auto & buffer : _threads) {
+				std::lock_guard<std::mutex> guard(buffer->lock);
+				const size_t size = buffer->ring.size();
+				for (size_t i = 0; i < buffer->count; ++i) {
+					_current.events.push_back(buffer->ring[(buffer->head + size - buffer->count + i) % size]);
+				}
+				buffer->count = 0;
+			}
+		}
+
+		// Align the GL clock on ours, it can drift so this is done each frame.
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		_gpuOffset = now() - int64_t(gpuNow);
+
+		_current.end = now();
+		if (!_paused && _enabled) {
+			_frames.push_back(std::move(_current));
+			while (_frames.size() > std::max(_historySize, size_t(1))) {
+				_frames.pop_front();
+			}
+		}
+		_current = Frame();
+		_current.index = ++_frameIndex;
+		_current.start = now();
+
+		GPUTimerPool::global().nextFrame([this](const GPUTimerPool::Timing & timing) { addGPU(timing); });
+	}
+
+	void FrameProfiler::counter(const char * name, double value)
+	{
+		_current.counters.emplace_back(name, value);
+	}
+
+	const char * FrameProfiler::intern(const std::string & name)
+	{
+		std::lock_guard<std::mutex> guard(_threadsLock);
+		return _names.insert(name).first->c_str();
+	}
+
+	void FrameProfiler::enabled(bool enabled)
+	{
+		_enabled = enabled;
+	}
+
+	bool FrameProfiler::exportTrace(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			SIBR_WRG << "[FrameProfiler] Unable to write trace to " << path << "." << std::endl;
+			return false;
+		}
+		// Frames on tid 0, GPU on tid 1, threads after; times are in microseconds.
+		const auto tid = [](uint track) { return track == gpuTrack ? 1 : int(track) + 2; };
+		uint threads = 0;
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[" << std::endl;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Frames\"}}," << std::endl;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+		for (const Frame & frame : _frames) {
+			for (const auto & counter : frame.counters) {
+				file << "," << std::endl << "{\"name\":\"" << jsonEscape(counter.first) << "\",\"ph\":\"C\",\"pid\":0,\"ts\":"
+					<< double(frame.end) * 1e-3 << ",\"args\":{\"value\":" << counter.second << "}}";
+			}
+			file << "," << std::endl << "{\"name\":\"Frame " << frame.index << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+				<< double(frame.start) * 1e-3 << ",\"dur\":" << double(frame.end - frame.start) * 1e-3 << "}";
+			for (const Event & event : frame.events) {
+				if (event.track != gpuTrack) {
+					threads = std::max(threads, event.track + 1);
+				}
+				file << "," << std::endl << "{\"name\":\"" << jsonEscape(event.name) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid(event.track)
+					<< ",\"ts\":" << double(event.start) * 1e-3 << ",\"dur\":" << double(event.end - event.start) * 1e-3 << "}";
+			}
+		}
+		for (uint t = 0; t < threads; ++t) {
+			file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid(t)
+				<< ",\"args\":{\"name\":\"CPU " << t << "\"}}";
+		}
+		file << std::endl << "]}" << std::endl;
+		SIBR_LOG << "[FrameProfiler] Exported " << _frames.size() << " frames to " << path << "." << std::endl;
+		return true;
+	}
+
+	void FrameProfiler::onGUI(const std::string & windowName)
+	{
+		if (!ImGui::Begin(windowName.c_str())) {
+			ImGui::End();
+			return;
+		}
+		ImGui::Checkbox("Record", &_enabled);
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &_paused);
+		ImGui::SameLine();
+		if (ImGui::Button("Export trace...")) {
+			std::string path;
+			if (showFilePicker(path, FilePickerMode::Save, "", "json") && !path.empty()) {
+				exportTrace(path);
+			}
+		}
+
+		if (_frames.empty()) {
+			ImGui::Text("No frame recorded.");
+			ImGui::End();
+			return;
+		}
+
+		std::vector<float> times(_frames.size());
+		for (size_t i = 0; i < _frames.size(); ++i) {
+			times[i] = float(_frames[i].end - _frames[i].start) * 1e-6f;
+		}
+		ImGui::PlotHistogram("Frame (ms)", times.data(), int(times.size()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+		_selected = std::min(_selected, int(_frames.size()) - 1);
+		// -1 follows the last frame.
+		ImGui::SliderInt("Frame", &_selected, -1, int(_frames.size()) - 1);
+
+		const Frame & frame = _frames[_selected < 0 ? _frames.size() - 1 : size_t(_selected)];
+		ImGui::Text("Frame %llu: %.3f ms", (unsigned long long)frame.index, double(frame.end - frame.start) * 1e-6);
+		for (const auto & counter : frame.counters) {
+			ImGui::Text("%s: %.0f", counter.first, counter.second);
+		}
+
+		// One block of rows per track, the GPU first, scopes laid out against the CPU frame duration.
+		std::map<uint, uint> depths;
+		int64_t start = frame.start, end = frame.end;
+		for (const Event & event : frame.events) {
+			const uint key = event.track == gpuTrack ? 0 : event.track + 1;
+			depths[key] = std::max(depths[key], event.depth + 1);
+			start = std::min(start, event.start);
+			end = std::max(end, event.end);
+		}
+		std::map<uint, float> offsets;
+		const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+		float height = 0.0f;
+		for (const auto & track : depths) {
+			offsets[track.first] = height;
+			height += (float(track.second) + 1.0f) * rowHeight;
+		}
+
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		const float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+		const double scale = double(width) / double(std::max(end - start, int64_t(1)));
+		ImDrawList * drawList = ImGui::GetWindowDrawList();
+		ImGui::InvisibleButton("##flame", ImVec2(width, std::max(height, rowHeight)));
+		const bool hovered = ImGui::IsItemHovered();
+		const ImVec2 mouse = ImGui::GetIO().MousePos;
+
+		for (const auto & track : offsets) {
+			const std::string label = track.first == 0 ? "GPU" : "CPU " + std::to_string(track.first - 1);
+			drawList->AddText(ImVec2(origin.x, origin.y + track.second), IM_COL32(200, 200, 200, 255), label.c_str());
+		}
+		for (const Event & event : frame.events) {
+			const uint key = event.track == gpuTrack ? 0 : event.track + 1;
+			const float x0 = origin.x + float(double(event.start - start) * scale);
+			const float x1 = std::max(origin.x + float(double(event.end - start) * scale), x0 + 1.0f);
+			const float y0 = origin.y + offsets[key] + float(event.depth + 1) * rowHeight;
+			const float y1 = y0 + rowHeight - 1.0f;
+			drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), scopeColor(event.name));
+			if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f) {
+				drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+			}
+			if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1) {
+				ImGui::SetTooltip("%s: %.3f ms", event.name, double(event.end - event.start) * 1e-6);
+			}
+		}
+		ImGui::End();
+	}
+
+	ProfileScope::ProfileScope(const char * name, bool gpu)
+	{
+		FrameProfiler & profiler = FrameProfiler::get();
+		_cpu = profiler.enabled();
+		_gpu = gpu;
+		if (_cpu) {
+			profiler.beginCPU(name);
+		}
+		if (_gpu) {
+			profiler.beginGPU(name);
+		}
+	}
+
+	ProfileScope::~ProfileScope()
+	{
+		FrameProfiler & profiler = FrameProfiler::get();
+		if (_gpu) {
+			profiler.endGPU();
+		}
+		if (_cpu) {
+			profiler.endCPU();
+		}
+	}
+
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Config.hpp>
+#include <core/graphics/GPUTimerPool.hpp>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Frame profiler recording named nested scopes on the CPU, from any thread, and on the GPU, from the
+	 * GL thread. CPU scopes are timed with a steady clock and stored in a ring buffer per thread; GPU scopes
+	 * are timed by the GPUTimerPool, whose queries are resolved a few frames later to avoid stalls.
+	 * Completed scopes are grouped by frame, displayed as a flame graph in onGUI, and can be exported
+	 * in the Chrome trace event format, readable by chrome://tracing and Perfetto.
+	 *
+	 *		void MyRenderer::process(...) {
+	 *			SIBR_PROFILE_GPU("MyRenderer");
+	 *			{
+	 *				SIBR_PROFILE_CPU("Sort");
+	 *				...
+	 *			}
+	 *		}
+	 *
+	 * Frames are delimited by calls to nextFrame, done by Window::swapBuffer.
+	 * \note Scope names must outlive the profiler, use intern for names built at runtime.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT FrameProfiler {
+		SIBR_DISALLOW_COPY(FrameProfiler);
+
+	public:
+
+		/// A completed scope.
+		struct Event {
+			const char * name; ///< Scope name.
+			int64_t start; ///< Start time in nanoseconds since the profiler creation.
+			int64_t end; ///< End time in nanoseconds since the profiler creation.
+			uint track; ///< Thread track, or gpuTrack.
+			uint depth; ///< Nesting level in its track.
+		};
+
+		/// The scopes completed during a frame.
+		struct Frame {
+			uint64_t index = 0; ///< Frame number.
+			int64_t start = 0; ///< Frame start in nanoseconds.
+			int64_t end = 0; ///< Frame end in nanoseconds.
+			std::vector<Event> events; ///< Completed scopes.
+			std::vector<std::pair<const char*, double>> counters; ///< Values reported for the frame.
+		};
+
+		/// Track of the GPU scopes.
+		static const uint gpuTrack = uint(-1);
+
+		/** \return the profiler instance. */
+		static FrameProfiler & get();
+
+		/** Open a CPU scope on the calling thread.
+		\param name the scope name
+		*/
+		void beginCPU(const char * name);
+
+		/** Close the last CPU scope opened on the calling thread. */
+		void endCPU();
+
+		/** Open a GPU scope, must be called from the GL thread. GPU scopes are timed by GPUTimerPool::global()
+		even when the recording is disabled, so that their times stay available.
+		\param name the scope name
+		*/
+		void beginGPU(const char * name);
+
+		/** Close the last GPU scope. */
+		void endGPU();
+
+		/** Report a value for the current frame, displayed with the frame and exported as a counter track.
+		\param name the counter name, see intern
+		\param value the value
+		*/
+		void counter(const char * name, double value);
+
+		/** End the current frame: gather the scopes completed by all threads and the GPU timings available,
+		and advance the frame of the GPUTimerPool. */
+		void nextFrame();
+
+		/** Keep a copy of a name for the lifetime of the profiler.
+		\param name the name
+		\return a persistent pointer to the name
+		*/
+		const char * intern(const std::string & name);
+
+		/** Display the frame times and a flame graph of the last frame, and the export controls.
+		\param windowName the ImGui window name
+		*/
+		void onGUI(const std::string & windowName = "Profiler");
+
+		/** Write the recorded frames in the Chrome trace event JSON format.
+		\param path the destination file
+		\return true if the file was written
+		*/
+		bool exportTrace(const std::string & path) const;
+
+		/** \return the recorded frames, oldest first. */
+		const std::deque<Frame> & frames() const { return _frames; }
+
+		/** \return true if scopes are recorded. */
+		bool enabled() const { return _enabled; }
+
+		/** Toggle recording.
+		\param enabled the new state
+		*/
+		void enabled(bool enabled);
+
+		/** \return the maximum number of frames kept. */
+		size_t & historySize() { return _historySize; }
+
+	private:
+
+		/// Scopes recorded by a thread.
+		struct ThreadBuffer {
+			std::mutex lock; ///< Taken by the owner when pushing, and by nextFrame when gathering.
+			std::vector<Event> ring; ///< Completed scopes.
+			size_t head = 0; ///< Next slot to write.
+			size_t count = 0; ///< Number of scopes not gathered yet.
+			std::vector<std::pair<const char*, int64_t>> open; ///< Open scopes.
+			uint track = 0; ///< Track index.
+		};
+
+		/// Constructor.
+		FrameProfiler();
+
+		/** \return the time in nanoseconds since the profiler creation. */
+		int64_t now() const;
+
+		/** \return the buffer of the calling thread, registered on first use. */
+		ThreadBuffer & threadBuffer();
+
+		/** Add a resolved GPU scope to the frame it was issued in.
+		\param timing the scope
+		*/
+		void addGPU(const GPUTimerPool::Timing & timing);
+
+		/** Find a recorded frame.
+		\param index the frame number
+		\return the frame or nullptr if it is no longer in the history
+		*/
+		Frame * frame(uint64_t index);
+
+		const std::chrono::steady_clock::time_point _origin; ///< Time reference.
+		bool _enabled = true; ///< Recording status.
+		bool _paused = false; ///< Freeze the GUI on a frame.
+		size_t _historySize = 300; ///< Number of frames kept.
+		std::deque<Frame> _frames; ///< Recorded frames, oldest first.
+		Frame _current; ///< Frame being recorded.
+		uint64_t _frameIndex = 0; ///< Current frame number.
+		int _selected = -1; ///< Frame displayed in the GUI, -1 for the last.
+
+		std::mutex _threadsLock; ///< Guards the thread list and the names.
+		std::vector<std::unique_ptr<ThreadBuffer>> _threads; ///< Registered threads.
+		std::unordered_set<std::string> _names; ///< Interned names.
+
+		int64_t _gpuOffset = 0; ///< Offset from the GL timestamps to the profiler time.
+	};
+
+	/** Record a CPU scope, and optionally a GPU scope, for the lifetime of the object.
+	\sa SIBR_PROFILE_CPU, SIBR_PROFILE_GPU
+	\ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT ProfileScope {
+		SIBR_DISALLOW_COPY(ProfileScope);
+	public:
+
+		/** Constructor, opens the scope. The CPU scope is only recorded when the profiler is enabled,
+		the GPU one is always timed by the GPUTimerPool.
+		\param name the scope name, see FrameProfiler::intern
+		\param gpu also time the GPU commands issued in the scope
+		*/
+		ProfileScope(const char * name, bool gpu = false);
+
+		/// Destructor, closes the scope.
+		~ProfileScope();
+
+	private:
+		bool _cpu; ///< A CPU scope was opened.
+		bool _gpu; ///< A GPU scope was opened.
+	};
+
+}
+
+/// Profile the CPU time of the enclosing scope under a given name.
+# define SIBR_PROFILE_CPU(name) sibr::ProfileScope SIBR_CATMACRO(profileScope, __COUNTER__)(name, false);
+/// Profile the CPU and GPU time of the enclosing scope under a given name, from the GL thread.
+# define SIBR_PROFILE_GPU(name) sibr::ProfileScope SIBR_CATMACRO(profileScope, __COUNTER__)(name, true);
@@ -77,6 +77,43 @@ namespace sibr
 		_planes[RIGHT].buildFrom( normal, nc + X*nw );
 	}
 
+	Frustum::Frustum(const Matrix4f& viewproj)
+	{
+		// Gribb and Hartmann, each plane is a combination of the last row and another one.
+		const Vector4f w = viewproj.row(3);
+		const std::array<Vector4f, COUNT> planes = { {
+			w - Vector4f(viewproj.row(1)), w + Vector4f(viewproj.row(1)),
+			w + Vector4f(viewproj.row(0)), w - Vector4f(viewproj.row(0)),
+			w + Vector4f(viewproj.row(2)), w - Vector4f(viewproj.row(2))
+		} };
+		for (int i = 0; i < COUNT; ++i) {
+			const float norm = planes[i].head<3>().norm();
+			_planes[i].A = planes[i][0] / norm;
+			_planes[i].B = planes[i][1] / norm;
+			_planes[i].C = planes[i][2] / norm;
+			_planes[i].D = planes[i][3] / norm;
+		}
+	}
+
+	Frustum::TestResult	Frustum::testBox(const Eigen::AlignedBox<float, 3>& box) const
+	{
+		TestResult result = INSIDE;
+		const Vector3f& mini = box.min();
+		const Vector3f& maxi = box.max();
+		for (const Plane& plane : _planes) {
+			// The corners the furthest along and against the plane normal.
+			const Vector3f inner(plane.A >= 0.0f ? maxi.x() : mini.x(), plane.B >= 0.0f ? maxi.y() : mini.y(), plane.C >= 0.0f ? maxi.z() : mini.z());
+			const Vector3f outer(plane.A >= 0.0f ? mini.x() : maxi.x(), plane.B >= 0.0f ? mini.y() : maxi.y(), plane.C >= 0.0f ? mini.z() : maxi.z());
+			if (plane.A * inner.x() + plane.B * inner.y() + plane.C * inner.z() + plane.D < 0.0f) {
+				return OUTSIDE;
+			}
+			if (plane.A * outer.x() + plane.B * outer.y() + plane.C * outer.z() + plane.D < 0.0f) {
+				result = INTERSECT;
+			}
+		}
+		return result;
+	}
+
 	Frustum::TestResult	Frustum::testSphere(const Vector3f& p, float radius)
 	{
 		float distance;
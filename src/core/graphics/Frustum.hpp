@@ -15,6 +15,7 @@
 # include <array>
 # include "core/graphics/Config.hpp"
 # include "core/system/Vector.hpp"
+# include "core/system/Matrix.hpp"
 
 namespace sibr
 {
@@ -64,6 +65,12 @@ namespace sibr
 		*/
 		Frustum(const Camera& cam);
 
+		/** Extract the frustum planes from a projection matrix, which handles off-center and orthographic
+		projections too. Using a model-view-projection matrix gives the planes in model space.
+		\param viewproj the matrix
+		*/
+		Frustum(const Matrix4f& viewproj);
+
 		/** Test if a sphere intersects the frustum or is contained in it.
 		\param sphere sphere center
 		\param radius sphere radis
@@ -71,6 +78,13 @@ namespace sibr
 		*/
 		TestResult	testSphere(const Vector3f& sphere, float radius);
 
+		/** Test if an axis aligned box intersects the frustum or is contained in it.
+		\param box the box
+		\return if the box is inside, intersecting or outside the frustum
+		\note Conservative: a box near a corner of the frustum can be reported as intersecting.
+		*/
+		TestResult	testBox(const Eigen::AlignedBox<float, 3>& box) const;
+
 	private:
 
 		/// Location of each plane.
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "GLState.hpp"
+#include "FrameProfiler.hpp"
+
+namespace sibr {
+
+	namespace {
+
+		// Marks a value that has to be sent to GL.
+		const GLenum kUnknown = GLenum(-1);
+
+		/// Tracked state of the context current on a thread.
+		struct State {
+			int depthTest = -1; ///< -1 unknown, else enabled.
+			int cullFace = -1; ///< -1 unknown, else enabled.
+			GLenum cullMode = kUnknown;
+			GLenum depthFunc = kUnknown;
+			GLenum polygonMode = kUnknown;
+			GLuint program = kUnknown;
+			GLuint drawFramebuffer = kUnknown;
+			GLuint readFramebuffer = kUnknown;
+			GLState::Stats stats;
+		};
+
+		State & state()
+		{
+			thread_local State s;
+			return s;
+		}
+
+		/// Count a call, return true if it has to be sent.
+		template <typename T>
+		bool change(T & current, T value)
+		{
+			State & s = state();
+			if (current == value) {
+				++s.stats.elided;
+				return false;
+			}
+			current = value;
+			++s.stats.issued;
+			return true;
+		}
+
+#ifdef SIBR_GLSTATE_VALIDATE
+		void validate(GLenum pname, GLint expected)
+		{
+			GLint value = 0;
+			glGetIntegerv(pname, &value);
+			if (value != expected) {
+				SIBR_WRG << "[GLState] State 0x" << std::hex << pname << std::dec << " changed outside of the tracker: "
+					<< value << " instead of " << expected << "." << std::endl;
+			}
+		}
+#else
+		void validate(GLenum, GLint) {}
+#endif
+	}
+
+	void GLState::enable(GLenum cap)
+	{
+		set(cap, true);
+	}
+
+	void GLState::disable(GLenum cap)
+	{
+		set(cap, false);
+	}
+
+	void GLState::set(GLenum cap, bool enabled)
+	{
+		int * current = nullptr;
+		if (cap == GL_DEPTH_TEST) {
+			current = &state().depthTest;
+		}
+		else if (cap == GL_CULL_FACE) {
+			current = &state().cullFace;
+		}
+		if (current && !change(*current, int(enabled))) {
+			validate(cap, GLint(enabled));
+			return;
+		}
+		if (!current) {
+			++state().stats.issued;
+		}
+		if (enabled) {
+			glEnable(cap);
+		}
+		else {
+			glDisable(cap);
+		}
+	}
+
+	void GLState::cullFace(GLenum mode)
+	{
+		if (change(state().cullMode, mode)) {
+			glCullFace(mode);
+		}
+		else {
+			validate(GL_CULL_FACE_MODE, GLint(mode));
+		}
+	}
+
+	void GLState::depthFunc(GLenum func)
+	{
+		if (change(state().depthFunc, func)) {
+			glDepthFunc(func);
+		}
+		else {
+			validate(GL_DEPTH_FUNC, GLint(func));
+		}
+	}
+
+	void GLState::polygonMode(GLenum face, GLenum mode)
+	{
+		if (face != GL_FRONT_AND_BACK) {
+			// The two faces can now differ.
+			state().polygonMode = kUnknown;
+			++state().stats.issued;
+			glPolygonMode(face, mode);
+			return;
+		}
+		if (change(state().polygonMode, mode)) {
+			glPolygonMode(face, mode);
+		}
+	}
+
+	void GLState::useProgram(GLuint program)
+	{
+		if (change(state().program, program)) {
+			glUseProgram(program);
+		}
+		else {
+			validate(GL_CURRENT_PROGRAM, GLint(program));
+		}
+	}
+
+	void GLState::bindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		State & s = state();
+		if (target == GL_FRAMEBUFFER) {
+			if (s.drawFramebuffer == framebuffer && s.readFramebuffer == framebuffer) {
+				++s.stats.elided;
+				validate(GL_DRAW_FRAMEBUFFER_BINDING, GLint(framebuffer));
+				return;
+			}
+			s.drawFramebuffer = s.readFramebuffer = framebuffer;
+			++s.stats.issued;
+			glBindFramebuffer(target, framebuffer);
+		}
+		else if (change(target == GL_READ_FRAMEBUFFER ? s.readFramebuffer : s.drawFramebuffer, framebuffer)) {
+			glBindFramebuffer(target, framebuffer);
+		}
+		else {
+			validate(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, GLint(framebuffer));
+		}
+	}
+
+	void GLState::deleteFramebuffers(GLsizei n, const GLuint * framebuffers)
+	{
+		State & s = state();
+		for (GLsizei i = 0; i < n; ++i) {
+			if (s.drawFramebuffer == framebuffers[i]) {
+				s.drawFramebuffer = 0;
+			}
+			if (s.readFramebuffer == framebuffers[i]) {
+				s.readFramebuffer = 0;
+			}
+		}
+		glDeleteFramebuffers(n, framebuffers);
+	}
+
+	void GLState::deleteProgram(GLuint program)
+	{
+		// The handle can be reused by a new program once this one is no longer current.
+		if (state().program == program) {
+			state().program = kUnknown;
+		}
+		glDeleteProgram(program);
+	}
+
+	void GLState::invalidate()
+	{
+		const Stats stats = state().stats;
+		state() = State();
+		state().stats = stats;
+	}
+
+	const GLState::Stats & GLState::stats()
+	{
+		return state().stats;
+	}
+
+	void GLState::nextFrame()
+	{
+		FrameProfiler & profiler = FrameProfiler::get();
+		profiler.counter("GL state calls issued", double(state().stats.issued));
+		profiler.counter("GL state calls elided", double(state().stats.elided));
+		state() = State();
+	}
+
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+
+namespace sibr {
+
+	/**
+	 * Thin tracker of the OpenGL state changed the most often: depth test and face culling, cull face,
+	 * depth function, polygon mode, current program and framebuffer bindings.
+	 * Each function mirrors the GL call of the same name, and skips it if the value is already set.
+	 * The tracked state is kept per thread, as each thread uses its own context.
+	 *
+	 *		GLState::enable(GL_DEPTH_TEST);
+	 *		GLState::useProgram(program);
+	 *		GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	 *
+	 * \warning The tracked state has to be changed through these functions only: code changing it directly
+	 * (external libraries for instance) has to call invalidate afterwards. Define SIBR_GLSTATE_VALIDATE to
+	 * compare the tracked state with the GL one each time a call is skipped.
+	 * \note The state is invalidated on each frame, by Window::swapBuffer.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT GLState {
+
+	public:
+
+		/// Calls made through the tracker.
+		struct Stats {
+			uint64_t issued = 0; ///< Calls sent to GL.
+			uint64_t elided = 0; ///< Calls skipped because the state was already set.
+		};
+
+		/** Enable a capability, see glEnable. Only GL_DEPTH_TEST and GL_CULL_FACE are tracked.
+		\param cap the capability
+		*/
+		static void enable(GLenum cap);
+
+		/** Disable a capability, see glDisable.
+		\param cap the capability
+		*/
+		static void disable(GLenum cap);
+
+		/** Enable or disable a capability.
+		\param cap the capability
+		\param enabled the new state
+		*/
+		static void set(GLenum cap, bool enabled);
+
+		/** Select the culled faces, see glCullFace.
+		\param mode the faces to cull
+		*/
+		static void cullFace(GLenum mode);
+
+		/** Set the depth comparison, see glDepthFunc.
+		\param func the comparison function
+		*/
+		static void depthFunc(GLenum func);
+
+		/** Set the rasterization mode, see glPolygonMode.
+		\param face the faces affected, only GL_FRONT_AND_BACK is tracked
+		\param mode the rasterization mode
+		*/
+		static void polygonMode(GLenum face, GLenum mode);
+
+		/** Set the current program, see glUseProgram.
+		\param program the program handle
+		*/
+		static void useProgram(GLuint program);
+
+		/** Bind a framebuffer, see glBindFramebuffer.
+		\param target GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER
+		\param framebuffer the framebuffer handle
+		*/
+		static void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+		/** Delete framebuffers, see glDeleteFramebuffers. Bindings to them revert to the default framebuffer.
+		\param n the number of framebuffers
+		\param framebuffers the framebuffer handles
+		*/
+		static void deleteFramebuffers(GLsizei n, const GLuint * framebuffers);
+
+		/** Delete a program, see glDeleteProgram.
+		\param program the program handle
+		*/
+		static void deleteProgram(GLuint program);
+
+		/** Forget the tracked state, the next call of each kind is sent to GL. */
+		static void invalidate();
+
+		/** \return the calls made on the calling thread since the last frame. */
+		static const Stats & stats();
+
+		/** Report the frame counters to the FrameProfiler, reset them and invalidate the state. */
+		static void nextFrame();
+	};
+
+}
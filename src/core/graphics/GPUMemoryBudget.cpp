@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/GPUMemoryBudget.hpp"
+#include "core/graphics/MemoryTracker.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace sibr {
+
+	GPUMemoryBudget & GPUMemoryBudget::global()
+	{
+		static GPUMemoryBudget budget;
+		return budget;
+	}
+
+	GPUMemoryBudget::Id GPUMemoryBudget::add(const std::string & name, int priority, const Evict & evict)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		const Id id = _nextId++;
+		_entries[id] = { name, priority, evict };
+		return id;
+	}
+
+	void GPUMemoryBudget::remove(Id id)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_entries.erase(id);
+	}
+
+	void GPUMemoryBudget::query(const Query & query)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_query = query;
+	}
+
+	bool GPUMemoryBudget::available(size_t & available) const
+	{
+		size_t smallest = std::numeric_limits<size_t>::max();
+		bool known = false;
+		size_t total = 0, free = 0;
+		if (MemoryTracker::driverMemory(total, free)) {
+			smallest = std::min(smallest, free);
+			known = true;
+		}
+		Query query;
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			query = _query;
+		}
+		if (query && query(total, free)) {
+			smallest = std::min(smallest, free);
+			known = true;
+		}
+		if (_limit > 0) {
+			const size_t used = MemoryTracker::get().gpuBytes();
+			smallest = std::min(smallest, used < _limit ? _limit - used : size_t(0));
+			known = true;
+		}
+		available = known ? smallest : 0;
+		return known;
+	}
+
+	bool GPUMemoryBudget::reserve(size_t bytes)
+	{
+		size_t free = 0;
+		if (!available(free)) {
+			return true;
+		}
+		if (free >= bytes + _freeReserve) {
+			return true;
+		}
+		const size_t released = release(bytes + _freeReserve - free);
+		return free + released >= bytes;
+	}
+
+	void GPUMemoryBudget::nextFrame()
+	{
+		++_frame;
+		if (_checkInterval > 1 && _frame % _checkInterval != 0) {
+			return;
+		}
+		size_t free = 0;
+		if (available(free) && free < _freeReserve) {
+			release(_freeReserve - free);
+		}
+	}
+
+	size_t GPUMemoryBudget::release(size_t bytes)
+	{
+		// Components may allocate while releasing, and reserve memory for it.
+		if (_releasing || bytes == 0) {
+			return 0;
+		}
+		_releasing = true;
+
+		std::vector<std::pair<Id, Entry>> entries;
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			entries.assign(_entries.begin(), _entries.end());
+		}
+		std::stable_sort(entries.begin(), entries.end(), [](const std::pair<Id, Entry> & a, const std::pair<Id, Entry> & b) {
+			return a.second.priority < b.second.priority;
+		});
+
+		size_t released = 0;
+		for (const auto & entry : entries) {
+			if (released >= bytes) {
+				break;
+			}
+			// Skip the components removed by a previous release.
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				if (_entries.find(entry.first) == _entries.end()) {
+					continue;
+				}
+			}
+			const size_t freed = entry.second.evict(bytes - released);
+			if (freed > 0) {
+				SIBR_LOG << "Video memory is low, released " << (freed >> 20) << "MB from " << entry.second.name << "." << std::endl;
+			}
+			released += freed;
+		}
+		// Only warn when the pressure starts, it lasts while nothing more can be released.
+		if (released < bytes && !_starved) {
+			SIBR_WRG << "Video memory is low, " << ((bytes - released) >> 20) << "MB could not be released." << std::endl;
+		}
+		_starved = released < bytes;
+		_releasedBytes += released;
+		_releasing = false;
+		return released;
+	}
+
+}
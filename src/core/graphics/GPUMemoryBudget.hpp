@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#pragma once
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Config.hpp>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace sibr {
+
+	/**
+	 * Keeps some video memory free by asking the components that can live with less (pooled targets,
+	 * paged tiles and textures, cached selections...) to release some, lowest priority first.
+	 * The available memory is read from the driver (NVX or ATI memory info extensions, see
+	 * MemoryTracker::driverMemory), from an additional query such as cudaMemGetInfo, and compared to the
+	 * tracked usage when a limit is set.
+	 *
+	 *		_budgetId = GPUMemoryBudget::global().add("Sparse tiles", GPUMemoryBudget::STREAMED, [this](size_t bytes) {
+	 *			return trim(bytes);
+	 *		});
+	 *		...
+	 *		GPUMemoryBudget::global().remove(_budgetId);
+	 *
+	 * Large allocations can call reserve() first to make room for themselves. Window::swapBuffer calls
+	 * nextFrame() on the global budget, the callbacks are called on the main thread with the GL context.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT GPUMemoryBudget {
+		SIBR_DISALLOW_COPY(GPUMemoryBudget);
+
+	public:
+
+		/// Registration identifier.
+		typedef uint64_t Id;
+
+		/** Release memory, asked for at least a number of bytes.
+		 The argument is the memory still wanted, the return value the memory actually released. */
+		typedef std::function<size_t(size_t)> Evict;
+
+		/** Reports the memory of the device, returns false if unknown.
+		 The arguments are the total and the available memory, in bytes. */
+		typedef std::function<bool(size_t &, size_t &)> Query;
+
+		/// Usual priorities, components of lower priority are asked first.
+		enum Priority {
+			CACHE = 0, ///< Unused resources kept for reuse.
+			STREAMED = 100, ///< Resources paged in again on demand, at the cost of some quality while they load.
+			QUALITY = 200 ///< Resources whose release degrades the rendering until the pressure ends.
+		};
+
+		/// Constructor.
+		GPUMemoryBudget() = default;
+
+		/** \return the budget polled by the windows. */
+		static GPUMemoryBudget & global();
+
+		/** Register a component that can release memory.
+		\param name the component name, for the logs
+		\param priority the priority, see Priority
+		\param evict the release function
+		\return the registration identifier
+		*/
+		Id add(const std::string & name, int priority, const Evict & evict);
+
+		/** Unregister a component.
+		\param id the registration identifier
+		*/
+		void remove(Id id);
+
+		/** Set an additional source for the device memory, the smallest available memory is used.
+		\param query the query, empty to remove it
+		*/
+		void query(const Query & query);
+
+		/** Get the memory available for new allocations.
+		\param available will contain the available memory, in bytes
+		\return false if the driver, the query and the limit say nothing
+		*/
+		bool available(size_t & available) const;
+
+		/** Release memory until an allocation fits, keeping the free memory reserve.
+		\param bytes the size of the allocation
+		\return false if the memory is known and the allocation still doesn't fit
+		*/
+		bool reserve(size_t bytes);
+
+		/** Check the available memory every checkInterval() frames and release memory when it is below the reserve.
+		 Called by Window::swapBuffer for the global budget. */
+		void nextFrame();
+
+		/** \return the free memory kept for the driver and the allocations not registered here, in bytes. */
+		size_t & freeReserve() { return _freeReserve; }
+
+		/** \return the maximum GPU memory of the tracked resources, see MemoryTracker::gpuBytes, 0 for none. */
+		size_t & limit() { return _limit; }
+
+		/** \return the number of frames between two checks. */
+		uint & checkInterval() { return _checkInterval; }
+
+		/** \return the total memory released since the start, in bytes. */
+		size_t releasedBytes() const { return _releasedBytes; }
+
+	private:
+
+		/// A registered component.
+		struct Entry {
+			std::string name; ///< Component name.
+			int priority; ///< Release order.
+			Evict evict; ///< Release function.
+		};
+
+		/** Ask the components to release memory, lowest priority first.
+		\param bytes the memory wanted
+		\return the memory released
+		*/
+		size_t release(size_t bytes);
+
+		mutable std::mutex _lock; ///< Guards the registrations.
+		std::map<Id, Entry> _entries; ///< Registered components.
+		Id _nextId = 1; ///< Next registration identifier.
+		Query _query; ///< Additional memory source.
+		size_t _freeReserve = size_t(256) << 20; ///< Free memory kept.
+		size_t _limit = 0; ///< Maximum tracked GPU memory.
+		uint _checkInterval = 30; ///< Frames between checks.
+		uint64_t _frame = 0; ///< Current frame.
+		size_t _releasedBytes = 0; ///< Total released memory.
+		bool _releasing = false; ///< A release is in progress, components may allocate while releasing.
+		bool _starved = false; ///< The last release didn't free enough memory.
+	};
+
+}
@@ -39,6 +39,8 @@ namespace sibr {
 	 *
 	 * \note If you want to create a query inline (for a one shot measurement), set the buffer 
 	 * count to 1, and know that it will introduce a stall when querying the value.
+	 *
+	 * \sa GPUTimerPool to time named scopes without managing queries, as done by SIBR_PROFILE_GPU.
 	* \ingroup sibr_graphics
 	*/
 	class SIBR_GRAPHICS_EXPORT GPUQuery
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "GPUTimerPool.hpp"
+
+namespace sibr {
+
+	namespace {
+
+		// Queries created at once when the pool is empty.
+		const GLsizei kQueryBatch = 16;
+	}
+
+	GPUTimerPool & GPUTimerPool::global()
+	{
+		static GPUTimerPool pool;
+		return pool;
+	}
+
+	GLuint GPUTimerPool::query()
+	{
+		if (_freeQueries.empty()) {
+			GLuint ids[kQueryBatch];
+			glGenQueries(kQueryBatch, ids);
+			_freeQueries.insert(_freeQueries.end(), ids, ids + kQueryBatch);
+		}
+		const GLuint id = _freeQueries.back();
+		_freeQueries.pop_back();
+		return id;
+	}
+
+	void GPUTimerPool::begin(const char * name)
+	{
+		Scope scope;
+		scope.name = name;
+		scope.queries[0] = query();
+		scope.queries[1] = query();
+		scope.depth = uint(_open.size());
+		scope.frame = _frame;
+		scope.closed = false;
+		glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+		_scopes.push_back(scope);
+		_open.push_back(&_scopes.back());
+	}
+
+	void GPUTimerPool::end()
+	{
+		if (_open.empty()) {
+			return;
+		}
+		Scope * scope = _open.back();
+		_open.pop_back();
+		glQueryCounter(scope->queries[1], GL_TIMESTAMP);
+		scope->closed = true;
+	}
+
+	void GPUTimerPool::completeFrame()
+	{
+		if (_accumulated.empty()) {
+			return;
+		}
+		for (const auto & time : _accumulated) {
+			_times[time.first] = time.second;
+		}
+		_frameTime = _accumulatedFrame;
+		_accumulated.clear();
+		_accumulatedFrame = 0.0;
+	}
+
+	void GPUTimerPool::nextFrame(const Listener & listener)
+	{
+		++_frame;
+
+		// Scopes are resolved in issue order, the first one not available yet stops the loop.
+		while (!_scopes.empty() && _scopes.front().closed) {
+			const Scope & scope = _scopes.front();
+			GLint available = 0;
+			glGetQueryObjectiv(scope.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				break;
+			}
+			Timing timing;
+			timing.name = scope.name;
+			timing.frame = scope.frame;
+			timing.depth = scope.depth;
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &end);
+			timing.start = uint64_t(start);
+			timing.end = uint64_t(end);
+			_freeQueries.push_back(scope.queries[0]);
+			_freeQueries.push_back(scope.queries[1]);
+			_scopes.pop_front();
+
+			// All the scopes of the previous frames have been resolved before this one.
+			if (timing.frame != _resolving) {
+				completeFrame();
+				_resolving = timing.frame;
+			}
+			const double ms = double(timing.end - timing.start) * 1e-6;
+			_accumulated[timing.name] += ms;
+			if (timing.depth == 0) {
+				_accumulatedFrame += ms;
+			}
+			if (listener) {
+				listener(timing);
+			}
+		}
+		// Nothing left from the frame being resolved.
+		if (_scopes.empty() || _scopes.front().frame != _resolving) {
+			completeFrame();
+		}
+	}
+
+	double GPUTimerPool::time(const char * name) const
+	{
+		const auto time = _times.find(name);
+		return time == _times.end() ? 0.0 : time->second;
+	}
+
+}
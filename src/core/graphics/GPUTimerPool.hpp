@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Config.hpp>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Shared pool of timestamp queries timing named GPU scopes, so that measuring a pass doesn't need
+	 * its own buffered GPUQuery. Two queries are taken from the pool for each scope and given back once
+	 * resolved; scopes are resolved in issue order at the end of each frame, as soon as their results
+	 * are available, so reading them never stalls.
+	 * The time of the last complete frame is kept for each scope name and for the frame as a whole,
+	 * for instance the time of a subview is time(subview.profileName).
+	 *
+	 *		GPUTimerPool::global().begin("Blur");
+	 *		...
+	 *		GPUTimerPool::global().end();
+	 *		// Later, from the last resolved frame.
+	 *		const double blurMs = GPUTimerPool::global().time("Blur");
+	 *
+	 * SIBR_PROFILE_GPU scopes use the pool, and the FrameProfiler receives the resolved scopes.
+	 * \note Must be used from the GL thread. Names are compared by address, they must outlive the pool,
+	 * see FrameProfiler::intern.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT GPUTimerPool {
+		SIBR_DISALLOW_COPY(GPUTimerPool);
+
+	public:
+
+		/// A resolved scope.
+		struct Timing {
+			const char * name; ///< Scope name.
+			uint64_t frame; ///< Frame it was issued in.
+			uint64_t start; ///< Start GL timestamp in nanoseconds.
+			uint64_t end; ///< End GL timestamp in nanoseconds.
+			uint depth; ///< Nesting level.
+		};
+
+		/// Callback receiving the resolved scopes.
+		typedef std::function<void(const Timing &)> Listener;
+
+		/** \return the pool shared by the renderers, its frames are advanced by FrameProfiler::nextFrame. */
+		static GPUTimerPool & global();
+
+		/// Constructor.
+		GPUTimerPool() = default;
+
+		/** Open a scope, timing the GPU commands issued until the matching end.
+		\param name the scope name
+		*/
+		void begin(const char * name);
+
+		/** Close the last scope opened. */
+		void end();
+
+		/** End the current frame and resolve the scopes whose results are available, without waiting.
+		\param listener called on each resolved scope, in issue order
+		*/
+		void nextFrame(const Listener & listener = Listener());
+
+		/** GPU time of a named scope.
+		\param name the scope name
+		\return the time in milliseconds of the scopes with this name in the last complete frame they were issued in, 0 if none
+		*/
+		double time(const char * name) const;
+
+		/** \return the GPU time in milliseconds of the top level scopes of the last complete frame. */
+		double frameTime() const { return _frameTime; }
+
+		/** \return the current frame number. */
+		uint64_t frame() const { return _frame; }
+
+		/** \return the number of scopes waiting for their results. */
+		size_t pending() const { return _scopes.size(); }
+
+	private:
+
+		/// A scope waiting for its queries.
+		struct Scope {
+			const char * name; ///< Scope name.
+			GLuint queries[2]; ///< Start and end timestamps.
+			uint depth; ///< Nesting level.
+			uint64_t frame; ///< Frame it was issued in.
+			bool closed; ///< The end timestamp has been issued.
+		};
+
+		/** \return a free GL query. */
+		GLuint query();
+
+		/** Publish the times accumulated for the frame being resolved. */
+		void completeFrame();
+
+		std::deque<Scope> _scopes; ///< Scopes in issue order.
+		std::vector<Scope*> _open; ///< Open scopes, they stay in _scopes until closed.
+		std::vector<GLuint> _freeQueries; ///< Queries available for reuse.
+		uint64_t _frame = 0; ///< Current frame number.
+
+		uint64_t _resolving = 0; ///< Frame of the scopes resolved last.
+		std::unordered_map<const char *, double> _accumulated; ///< Times per name in the frame being resolved.
+		double _accumulatedFrame = 0.0; ///< Time of the top level scopes in the frame being resolved.
+		std::unordered_map<const char *, double> _times; ///< Times per name of the last complete frame they appeared in.
+		double _frameTime = 0.0; ///< Time of the top level scopes of the last complete frame.
+	};
+
+}
@@ -13,7 +13,9 @@
 
 #include "core/graphics/Window.hpp"
 #include "core/graphics/GUI.hpp"
+#include "core/graphics/GUITextureProxies.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/system/LoadingProgress.hpp"
 
 // We extend ImGui functionality so we need the internal definitions.
 #define IMGUI_DEFINE_MATH_OPERATORS
@@ -22,9 +24,10 @@
 namespace sibr
 {
 	
-	bool		showImGuiWindow(const std::string& windowTitle, const IRenderTarget& rt, ImGuiWindowFlags flags, Viewport & viewport,  bool invalidTexture,  bool updateLayout, int handle )
+	bool		showImGuiWindow(const std::string& windowTitle, const IRenderTarget& rt, ImGuiWindowFlags flags, Viewport & viewport,  bool invalidTexture,  bool updateLayout, int handle, bool * visible, bool updated )
 	{
 		bool isWindowFocused = false;
+		bool isImageVisible = false;
 		// If we are asked to, we need to update the viewport at launch.
 		if (updateLayout) {
 			ImGui::SetNextWindowPos(ImVec2(viewport.finalLeft(), viewport.finalTop()));
@@ -50,8 +53,11 @@ namespace sibr
 			
 			ImGui::SetCursorPos(ImVec2(offset.x(), ImGui::GetTitleBarHeight()+offset.y()));
 			ImGui::InvisibleButton((windowTitle + "--TEXTURE-INVISIBLE_BUTTON").c_str(), ImVec2(size.x(), size.y()));
+			// False if the image is clipped out of the window or the screen.
+			isImageVisible = ImGui::IsItemVisible();
 			if (!invalidTexture) {
-				::ImGui::GetWindowDrawList()->AddImage((void*)(intptr_t)(rt.handle(handle)),
+				const GLuint texture = GUITextureProxies::global().get(rt.handle(handle), Vector2i(rt.w(), rt.h()), size, updated);
+				::ImGui::GetWindowDrawList()->AddImage((void*)(intptr_t)(texture),
 					pos, ImVec2(pos.x + size.x(), pos.y + size.y()),
 					ImVec2(0, 1), ImVec2(1, 0));
 			}
@@ -68,6 +74,9 @@ namespace sibr
 		}
 		::ImGui::End();
 
+		if (visible) {
+			*visible = isImageVisible;
+		}
 		return isWindowFocused;
 	}
 
@@ -276,8 +285,15 @@ namespace sibr
 		GLuint texture,
 		const sibr::Vector2i & displaySize,
 		const sibr::Vector2f& uv0,
-		const sibr::Vector2f& uv1 
+		const sibr::Vector2f& uv1,
+		const sibr::Vector2i& textureSize,
+		bool updated
 	) {
+		if (textureSize.x() > 0 && textureSize.y() > 0) {
+			// Only the zoomed region is displayed at that size.
+			const sibr::Vector2f region = (uv1 - uv0).cwiseAbs().cwiseMax(sibr::Vector2f(1e-3f, 1e-3f));
+			texture = GUITextureProxies::global().get(texture, textureSize, displaySize.cast<float>().cwiseQuotient(region), updated);
+		}
 		ImGui::Image((void*)(intptr_t)(texture), ImVec2(float(displaySize[0]), float(displaySize[1])), ImVec2(uv0[0], uv0[1]), ImVec2(uv1[0], uv1[1]));
 	}
 
@@ -286,12 +302,14 @@ namespace sibr
 		const sibr::Vector2i & displaySize,
 		CallBackData & callbackDataOut,
 		const sibr::Vector2f & uv0,
-		const sibr::Vector2f & uv1
+		const sibr::Vector2f & uv1,
+		const sibr::Vector2i & textureSize,
+		bool updated
 	) {
 		CallBackData & data = callbackDataOut;
 
 		data.itemPos = toSIBR<float>(ImGui::GetCursorScreenPos());
-		DisplayImageGui(texture, displaySize, uv0, uv1);
+		DisplayImageGui(texture, displaySize, uv0, uv1, textureSize, updated);
 
 		data.itemSize = toSIBR<float>(ImGui::GetItemRectSize());
 		data.isHoovered = ImGui::IsItemHovered();
@@ -308,12 +326,34 @@ namespace sibr
 		}
 	}
 
-	void ImageWithZoom(GLuint texture, const sibr::Vector2i & displaySize, ZoomInterraction & zoom)
+	void ImageWithZoom(GLuint texture, const sibr::Vector2i & displaySize, ZoomInterraction & zoom, const sibr::Vector2i & textureSize, bool updated)
 	{
-		ImageWithCallback(texture, displaySize, zoom.callBackData, zoom.zoomData.topLeft(), zoom.zoomData.bottomRight());
+		ImageWithCallback(texture, displaySize, zoom.callBackData, zoom.zoomData.topLeft(), zoom.zoomData.bottomRight(), textureSize, updated);
 		zoom.updateZoom(displaySize.template cast<float>());
 	}
 
+	void showLoadingProgress(const std::string & windowName)
+	{
+		const std::vector<LoadingProgress::Snapshot> progresses = LoadingProgress::snapshots();
+		if (progresses.empty()) {
+			return;
+		}
+		ImGui::SetNextWindowBgAlpha(0.5f);
+		if (ImGui::Begin(windowName.c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing)) {
+			for (const LoadingProgress::Snapshot & progress : progresses) {
+				if (progress.depth > 0) {
+					ImGui::Indent(float(progress.depth) * ImGui::GetStyle().IndentSpacing);
+				}
+				ImGui::TextUnformatted(progress.status.empty() ? "Loading" : progress.status.c_str());
+				ImGui::ProgressBar(progress.progress, ImVec2(250.0f, 0.0f));
+				if (progress.depth > 0) {
+					ImGui::Unindent(float(progress.depth) * ImGui::GetStyle().IndentSpacing);
+				}
+			}
+		}
+		ImGui::End();
+	}
+
 } // namespace sibr
 
 
@@ -31,10 +31,12 @@ namespace sibr
 	\param invalidTexture ignore the RT
 	\param updateLayout force update the camera location on screen
 	\param handle the texture index to display from the input RT
+	\param visible if not null, will be set to false if the window is collapsed or its content is clipped out of the screen
+	\param updated the RT content changed since the last call, a window much smaller than the RT displays a reduced copy only refreshed then (see GUITextureProxies)
 	\return true if window is focused (useful for managing interactions).
 	\ingroup sibr_graphics
 	*/
-	SIBR_GRAPHICS_EXPORT bool		showImGuiWindow(const std::string& windowTitle, const IRenderTarget& rt, ImGuiWindowFlags flags, Viewport & viewport,  bool invalidTexture,  bool updateLayout, int handle = 0);
+	SIBR_GRAPHICS_EXPORT bool		showImGuiWindow(const std::string& windowTitle, const IRenderTarget& rt, ImGuiWindowFlags flags, Viewport & viewport,  bool invalidTexture,  bool updateLayout, int handle = 0, bool * visible = nullptr, bool updated = true);
 
 	/**
 	Helper that compute the location and extent to display an image in a given region without cropping or distorting it
@@ -99,12 +101,16 @@ namespace sibr {
 	\param displaySize the target size
 	\param uv0 bottom-left corner of the image to display
 	\param uv1 top-right corner of the image to display
+	\param textureSize the texture size, if known a reduced copy is displayed when the texture is much larger than the displayed region (see GUITextureProxies)
+	\param updated the texture content changed since the last call, the reduced copy is only refreshed then
 	*/
 	SIBR_GRAPHICS_EXPORT void DisplayImageGui(
 		GLuint texture,
 		const sibr::Vector2i & displaySize,
 		const sibr::Vector2f& uv0 = { 0, 0 },
-		const sibr::Vector2f& uv1 = { 1, 1 }
+		const sibr::Vector2f& uv1 = { 1, 1 },
+		const sibr::Vector2i& textureSize = { 0, 0 },
+		bool updated = true
 	);
 
 	/** Store user interaction information to be returned when displaying an image. */
@@ -122,13 +128,17 @@ namespace sibr {
 	\param callbackDataOut will contain interaction information for the current frame 
 	\param uv0 bottom-left corner of the image to display
 	\param uv1 top-right corner of the image to display
+	\param textureSize the texture size, see DisplayImageGui
+	\param updated the texture content changed since the last call, see DisplayImageGui
 	*/
 	SIBR_GRAPHICS_EXPORT void ImageWithCallback(
 		GLuint texture,
 		const sibr::Vector2i & displaySize,
 		CallBackData & callbackDataOut,
 		const sibr::Vector2f& uv0 = { 0, 0 },
-		const sibr::Vector2f& uv1 = { 1, 1 }
+		const sibr::Vector2f& uv1 = { 1, 1 },
+		const sibr::Vector2i& textureSize = { 0, 0 },
+		bool updated = true
 	);
 
 	/** Store additional user zoom information to be returned when displaying an image. */
@@ -172,11 +182,15 @@ namespace sibr {
 	\param texture the ID of the texture to display
 	\param displaySize the target size
 	\param zoom will contain zoom information for the current frame
+	\param textureSize the texture size, see DisplayImageGui
+	\param updated the texture content changed since the last call, see DisplayImageGui
 	*/
 	SIBR_GRAPHICS_EXPORT void ImageWithZoom(
 		GLuint texture,
 		const sibr::Vector2i & displaySize,
-		ZoomInterraction & zoom
+		ZoomInterraction & zoom,
+		const sibr::Vector2i& textureSize = { 0, 0 },
+		bool updated = true
 	);
 
 	/** Represent a segment defined by the user by clicking on screen.  */
@@ -196,6 +210,12 @@ namespace sibr {
 		std::vector<sibr::Vector2i> rasterizedLine; ///< List of pixel covered by the rasterized line.
 		bool first = false, valid = false; ///< Current interactions state.
 	};
+
+	/** Display the live LoadingProgress bars in a small overlay window, sub-tasks indented
+	 under their parent. Nothing is displayed when no task is running.
+	\param windowName the ImGui window name
+	*/
+	SIBR_GRAPHICS_EXPORT void showLoadingProgress(const std::string & windowName = "Loading");
 }
 
 /** Convert an ImGui vector to a sibr vector.
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "GUITextureProxies.hpp"
+#include "GPUMemoryBudget.hpp"
+#include "GLState.hpp"
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <vector>
+
+namespace sibr {
+
+	GUITextureProxies & GUITextureProxies::global()
+	{
+		static GUITextureProxies proxies;
+		// The proxies are rebuilt from the sources for the price of a copy.
+		static const GPUMemoryBudget::Id budgetId = GPUMemoryBudget::global().add("GUI texture proxies", GPUMemoryBudget::CACHE, [](size_t bytes) {
+			return proxies.trim(bytes);
+		});
+		(void)budgetId;
+		return proxies;
+	}
+
+	GLuint GUITextureProxies::get(GLuint texture, const Vector2i & textureSize, const Vector2f & displaySize, bool updated)
+	{
+		if (texture == 0 || textureSize.x() < 2 || textureSize.y() < 2) {
+			return texture;
+		}
+		const ImVec2 scale = ImGui::GetIO().DisplayFramebufferScale;
+		const Vector2f needed = displaySize.cwiseProduct(Vector2f(scale.x, scale.y)).cwiseMax(Vector2f(1.0f, 1.0f));
+
+		// Smallest level of the copy still larger than the display, level l being the source size over 2^(l+1).
+		int level = -1;
+		while (float(textureSize.x() >> (level + 2)) >= needed.x() && float(textureSize.y() >> (level + 2)) >= needed.y()) {
+			++level;
+		}
+		if (level < 0 && _proxies.find(texture) == _proxies.end()) {
+			return texture;
+		}
+
+		Proxy & proxy = _proxies[texture];
+		proxy.lastUsed = _frame;
+		if ((proxy.texture == 0 && !proxy.direct) || proxy.sourceSize != textureSize) {
+			release(proxy);
+			proxy.sourceSize = textureSize;
+			create(texture, proxy);
+		}
+		if (updated) {
+			proxy.filled = proxy.mipmapped = false;
+		}
+		if (proxy.direct || level < 0) {
+			return texture;
+		}
+		level = std::min(level, int(proxy.levels) - 1);
+
+		if (!proxy.filled) {
+			// Blits are restricted by the scissor test.
+			const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+			glDisable(GL_SCISSOR_TEST);
+			glNamedFramebufferTexture(_readFramebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+			const GLint w = std::max(textureSize.x() / 2, 1);
+			const GLint h = std::max(textureSize.y() / 2, 1);
+			glBlitNamedFramebuffer(_readFramebuffer, proxy.framebuffer, 0, 0, textureSize.x(), textureSize.y(), 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glNamedFramebufferTexture(_readFramebuffer, GL_COLOR_ATTACHMENT0, 0, 0);
+			if (scissor) {
+				glEnable(GL_SCISSOR_TEST);
+			}
+			proxy.filled = true;
+		}
+		// Smaller levels are only generated once displayed.
+		if (level > 0 && !proxy.mipmapped) {
+			glTextureParameteri(proxy.texture, GL_TEXTURE_BASE_LEVEL, 0);
+			glTextureParameteri(proxy.texture, GL_TEXTURE_MAX_LEVEL, GLint(proxy.levels) - 1);
+			glGenerateTextureMipmap(proxy.texture);
+			proxy.mipmapped = true;
+			proxy.level = -1;
+		}
+		if (proxy.level != level) {
+			glTextureParameteri(proxy.texture, GL_TEXTURE_BASE_LEVEL, level);
+			glTextureParameteri(proxy.texture, GL_TEXTURE_MAX_LEVEL, level);
+			proxy.level = level;
+		}
+		return proxy.texture;
+	}
+
+	void GUITextureProxies::create(GLuint source, Proxy & proxy)
+	{
+		// Blits can't convert integer or depth formats to normalized colors.
+		GLint redType = GL_NONE, depthType = GL_NONE;
+		glGetTextureLevelParameteriv(source, 0, GL_TEXTURE_RED_TYPE, &redType);
+		glGetTextureLevelParameteriv(source, 0, GL_TEXTURE_DEPTH_TYPE, &depthType);
+		proxy.direct = redType == GL_INT || redType == GL_UNSIGNED_INT || depthType != GL_NONE;
+		if (proxy.direct) {
+			return;
+		}
+		if (_readFramebuffer == 0) {
+			glCreateFramebuffers(1, &_readFramebuffer);
+		}
+
+		const uint w = uint(std::max(proxy.sourceSize.x() / 2, 1));
+		const uint h = uint(std::max(proxy.sourceSize.y() / 2, 1));
+		proxy.levels = 1;
+		while ((std::max(w, h) >> proxy.levels) > 0) {
+			++proxy.levels;
+		}
+		glCreateTextures(GL_TEXTURE_2D, 1, &proxy.texture);
+		glTextureStorage2D(proxy.texture, GLsizei(proxy.levels), GL_RGBA8, GLsizei(w), GLsizei(h));
+		glTextureParameteri(proxy.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(proxy.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(proxy.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(proxy.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glCreateFramebuffers(1, &proxy.framebuffer);
+		glNamedFramebufferTexture(proxy.framebuffer, GL_COLOR_ATTACHMENT0, proxy.texture, 0);
+		proxy.memory.set(MemoryTracker::textureBytes(w, h, 1, proxy.levels, 4.0));
+		proxy.level = -1;
+		proxy.filled = proxy.mipmapped = false;
+	}
+
+	void GUITextureProxies::release(Proxy & proxy)
+	{
+		if (proxy.framebuffer) {
+			GLState::deleteFramebuffers(1, &proxy.framebuffer);
+		}
+		if (proxy.texture) {
+			glDeleteTextures(1, &proxy.texture);
+		}
+		proxy.texture = proxy.framebuffer = 0;
+		proxy.levels = 0;
+		proxy.direct = false;
+		proxy.memory.set(0);
+	}
+
+	void GUITextureProxies::nextFrame()
+	{
+		++_frame;
+		for (auto it = _proxies.begin(); it != _proxies.end();) {
+			if (_frame - it->second.lastUsed > _maxIdleFrames) {
+				release(it->second);
+				it = _proxies.erase(it);
+				continue;
+			}
+			++it;
+		}
+	}
+
+	void GUITextureProxies::clear()
+	{
+		for (auto & proxy : _proxies) {
+			release(proxy.second);
+		}
+		_proxies.clear();
+	}
+
+	size_t GUITextureProxies::trim(size_t bytes)
+	{
+		std::vector<std::map<GLuint, Proxy>::iterator> order;
+		for (auto it = _proxies.begin(); it != _proxies.end(); ++it) {
+			// The draw list of the current frame may still reference it.
+			if (it->second.lastUsed != _frame) {
+				order.push_back(it);
+			}
+		}
+		std::sort(order.begin(), order.end(), [](const std::map<GLuint, Proxy>::iterator & a, const std::map<GLuint, Proxy>::iterator & b) {
+			return a->second.lastUsed < b->second.lastUsed;
+		});
+		size_t released = 0;
+		for (const auto & it : order) {
+			if (released >= bytes) {
+				break;
+			}
+			released += it->second.memory.bytes();
+			release(it->second);
+			_proxies.erase(it);
+		}
+		return released;
+	}
+
+	size_t GUITextureProxies::memory() const
+	{
+		size_t bytes = 0;
+		for (const auto & proxy : _proxies) {
+			bytes += proxy.second.memory.bytes();
+		}
+		return bytes;
+	}
+
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/MemoryTracker.hpp>
+#include <core/system/Vector.hpp>
+#include <map>
+
+namespace sibr {
+
+	/**
+	 * Reduced resolution copies of the textures displayed in ImGui panels smaller than them.
+	 * A proxy holds the mipmaps of a texture, starting at half its size; the displayed level is the
+	 * smallest one still larger than the panel, so each displayed pixel only samples a few texels.
+	 * The copy is made on the GPU, and only refreshed when the caller reports that the source changed:
+	 * resizing a panel only selects another level.
+	 *
+	 *		// Once per frame and displayed texture, in the ImGui window.
+	 *		const GLuint displayed = GUITextureProxies::global().get(rt.handle(), { rt.w(), rt.h() }, panelSize, rendered);
+	 *
+	 * Proxies unused for more than maxIdleFrames() frames are destroyed.
+	 * \note Integer and depth textures are displayed as they are.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT GUITextureProxies {
+		SIBR_DISALLOW_COPY(GUITextureProxies);
+
+	public:
+
+		/// Constructor.
+		GUITextureProxies() = default;
+
+		/** \return the proxies shared by all the GUI displays. */
+		static GUITextureProxies & global();
+
+		/** Get the texture to display instead of a source texture.
+		\param texture the source texture handle
+		\param textureSize the source texture size
+		\param displaySize the displayed size of the texture, in ImGui units
+		\param updated the source content changed since the last call
+		\return the proxy, or the source texture when it is not much larger than the display
+		*/
+		GLuint get(GLuint texture, const Vector2i & textureSize, const Vector2f & displaySize, bool updated);
+
+		/** Advance the frame counter and destroy the proxies unused for more than maxIdleFrames() frames.
+		 Called by Window::swapBuffer for the global proxies. */
+		void nextFrame();
+
+		/** Destroy all proxies. */
+		void clear();
+
+		/** Destroy proxies, least recently used first, see GPUMemoryBudget.
+		\param bytes the memory to release
+		\return the estimated memory released, in bytes
+		*/
+		size_t trim(size_t bytes);
+
+		/** \return the estimated GPU memory of the proxies, in bytes. */
+		size_t memory() const;
+
+		/** \return the number of frames an unused proxy is kept. */
+		uint & maxIdleFrames() { return _maxIdleFrames; }
+
+	private:
+
+		/// A reduced copy of a source texture.
+		struct Proxy {
+			Vector2i sourceSize = Vector2i(0, 0); ///< Size of the source when the proxy was created.
+			GLuint texture = 0; ///< Mipmapped copy, level 0 is half the source size.
+			GLuint framebuffer = 0; ///< Framebuffer of the copy level 0.
+			uint levels = 0; ///< Number of levels of the copy.
+			int level = -1; ///< Displayed level.
+			bool direct = false; ///< The source can't be copied, it is displayed as is.
+			bool filled = false; ///< The copy level 0 is up to date.
+			bool mipmapped = false; ///< The other levels are up to date.
+			uint64_t lastUsed = 0; ///< Frame when it was last displayed.
+			TrackedMemory memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Reported GPU memory.
+		};
+
+		/** Create the GL objects of a proxy.
+		\param source the source texture
+		\param proxy the proxy to initialize
+		*/
+		void create(GLuint source, Proxy & proxy);
+
+		/** Destroy the GL objects of a proxy.
+		\param proxy the proxy
+		*/
+		static void release(Proxy & proxy);
+
+		std::map<GLuint, Proxy> _proxies; ///< Proxies, by source texture.
+		GLuint _readFramebuffer = 0; ///< Framebuffer the sources are attached to for copies.
+		uint64_t _frame = 0; ///< Current frame.
+		uint _maxIdleFrames = 120; ///< Frames an unused proxy is kept.
+	};
+
+}
@@ -12,6 +12,7 @@
 
 
 #include "core/graphics/Image.hpp"
+#include <algorithm>
 #include <fstream>
 
 namespace sibr
@@ -36,8 +37,23 @@ namespace sibr
 			return ranges[cvDepth];
 		}
 
+		cv::Mat			imreadReduced(const std::string & filename, uint minWidth, uint minHeight, int flags)
+		{
+			uint scale = IImage::reducedDecodeScale(filename, minWidth, minHeight);
+			if (scale > 1 && (flags & cv::IMREAD_IGNORE_ORIENTATION) == 0) {
+				// The header gives the stored size, the orientation tag can swap it: check both ways.
+				scale = std::min(scale, IImage::reducedDecodeScale(filename, minHeight, minWidth));
+			}
+			static const int reduced[] = { 0, 0, cv::IMREAD_REDUCED_GRAYSCALE_2, 0, cv::IMREAD_REDUCED_GRAYSCALE_4, 0, 0, 0, cv::IMREAD_REDUCED_GRAYSCALE_8 };
+			return cv::imread(filename, scale > 1 ? (flags | reduced[scale]) : flags);
+		}
+
 		void			convertBGR2RGB(cv::Mat& img)
 		{
+			if (img.depth() == CV_8U && img.isContinuous()) {
+				pixels::swapRedBlue(img.ptr<uchar>(), img.ptr<uchar>(), img.total(), uint(img.channels()));
+				return;
+			}
 			switch (img.channels())
 			{
 			case 3:
@@ -53,6 +69,10 @@ namespace sibr
 
 		void			convertRGB2BGR(cv::Mat& img)
 		{
+			if (img.depth() == CV_8U && img.isContinuous()) {
+				pixels::swapRedBlue(img.ptr<uchar>(), img.ptr<uchar>(), img.total(), uint(img.channels()));
+				return;
+			}
 			switch (img.channels())
 			{
 			case 3:
@@ -395,4 +415,25 @@ namespace sibr
 		return sibr::Vector2i(width, height);
 	}
 
+	uint IImage::reducedDecodeScale(const std::string& file_path, uint minWidth, uint minHeight)
+	{
+		const std::string extension = sibr::to_lower(sibr::getExtension(file_path));
+		if (extension != "jpg" && extension != "jpeg") {
+			return 1;
+		}
+		const sibr::Vector2i size = imageResolution(file_path);
+		if (size.x() <= 0 || size.y() <= 0) {
+			return 1;
+		}
+		// The decoder rounds the scaled size up.
+		for (uint scale = 8; scale > 1; scale /= 2) {
+			const uint w = (uint(size.x()) + scale - 1) / scale;
+			const uint h = (uint(size.y()) + scale - 1) / scale;
+			if (w >= minWidth && h >= minHeight) {
+				return scale;
+			}
+		}
+		return 1;
+	}
+
 } // namespace sibr
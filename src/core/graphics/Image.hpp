@@ -13,8 +13,10 @@
 #pragma once
 
 # include "core/graphics/Config.hpp"
+# include "core/graphics/PixelKernels.hpp"
 # include "core/system/Vector.hpp"
 # include "core/system/ByteStream.hpp"
+# include "core/system/ByteStreamWriter.hpp"
 
 # pragma warning(push, 0)
 #  include <opencv2/core/core.hpp>
@@ -96,6 +98,17 @@ namespace sibr
 		\param dst the matrix to convert
 		*/
 		SIBR_GRAPHICS_EXPORT void			convertRGB2BGR(cv::Mat& dst);
+
+		/** Read an image file, letting the JPEG decoder downscale it in the DCT domain (to 1/2, 1/4 or 1/8 of its
+		size) when the smaller image is still at least minWidth x minHeight. Other formats are decoded at full size.
+		\param filename the image file
+		\param minWidth the minimal width of the decoded image
+		\param minHeight the minimal height of the decoded image
+		\param flags cv::IMREAD_COLOR or cv::IMREAD_GRAYSCALE, optionally with cv::IMREAD_IGNORE_ORIENTATION
+		\return the image, in BGR order as cv::imread, empty if it could not be read
+		\note The result is usually larger than the minimal size, callers still resize it.
+		*/
+		SIBR_GRAPHICS_EXPORT cv::Mat		imreadReduced(const std::string & filename, uint minWidth, uint minHeight, int flags = cv::IMREAD_COLOR);
 	}
 
 	typedef	Vector4f ColorRGBA;
@@ -216,6 +229,14 @@ namespace sibr
 		*/
 		static sibr::Vector2i			imageResolution(const std::string& file_path);
 
+		/** Get the largest downscaling the JPEG decoder can apply to an image file while keeping it at least as large as a given size.
+		\param file_path the input file path
+		\param minWidth the minimal width
+		\param minHeight the minimal height
+		\return 8, 4, 2, or 1 for files that are not JPEG, cannot be downscaled or whose header cannot be read
+		*/
+		static uint						reducedDecodeScale(const std::string& file_path, uint minWidth, uint minHeight);
+
 	};
 
 
@@ -290,6 +311,18 @@ namespace sibr
 		*/
 		bool		load(const std::string& filename, bool verbose = true, bool warning_if_not_found = true);
 
+		/** Load an image that will be displayed or processed at a lower resolution: JPEG files are downscaled
+		while decoding, when possible, instead of being fully decoded then resized. See opencv::imreadReduced.
+		\param filename the image file
+		\param minWidth the minimal width of the loaded image
+		\param minHeight the minimal height of the loaded image
+		\param verbose display information
+		\param warning_if_not_found display a warning if the file is missing
+		\return a success flag
+		\note The loaded image can be larger than the minimal size, and is never smaller than it unless the file is.
+		*/
+		bool		loadReduced(const std::string& filename, uint minWidth, uint minHeight, bool verbose = true, bool warning_if_not_found = true);
+
 		/**
 		\copydoc IImage::loadByteStream
 		*/
@@ -447,6 +480,9 @@ namespace sibr
 		/** \copydoc IImage::flipV */
 		void		flipV(void);
 
+		/** \return a copy of the image flipped around the horizontal axis, built in one pass. */
+		Image		flippedH(void) const;
+
 		/** \copydoc IImage::opencvType */
 		int				opencvType(void) const { return CV_MAKETYPE(opencv::imageType<T_Type>(), T_NumComp); }
 
@@ -782,13 +818,24 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp>
 	cv::Mat			Image<T_Type, T_NumComp>::toOpenCVBGR(void) const {
-		cv::Mat out = toOpenCV().clone();
-		opencv::convertRGB2BGR(out);
+		// Swap while copying, instead of cloning then converting.
+		cv::Mat out(_pixels.rows, _pixels.cols, _pixels.type());
+		if (_pixels.isContinuous()) {
+			pixels::swapRedBlue(_pixels.ptr<T_Type>(), out.ptr<T_Type>(), _pixels.total(), T_NumComp);
+		} else {
+			_pixels.copyTo(out);
+			opencv::convertRGB2BGR(out);
+		}
 		return out;
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
 	void			Image<T_Type, T_NumComp>::fromOpenCVBGR(const cv::Mat& imgSrc) {
+		if (imgSrc.type() == opencvType() && imgSrc.isContinuous()) {
+			_pixels = cv::Mat(imgSrc.rows, imgSrc.cols, opencvType());
+			pixels::swapRedBlue(imgSrc.ptr<T_Type>(), _pixels.ptr<T_Type>(), imgSrc.total(), T_NumComp);
+			return;
+		}
 		cv::Mat img = imgSrc.clone();
 		opencv::convertBGR2RGB(img);
 		fromOpenCV(img);
@@ -796,38 +843,40 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp>
 	void			Image<T_Type, T_NumComp>::fromOpenCV(const cv::Mat& imgSrc) {
-		cv::Mat img = imgSrc.clone();
-
-		if (img.depth() != opencv::imageType<T_Type>())
+		// Convert the depth then the channels, each step writing a new matrix: the source is only copied
+		// when it already has the right type.
+		const int depth = opencv::imageType<T_Type>();
+		const float scale = opencv::imageTypeRange<T_Type>() / opencv::imageTypeCVRange(imgSrc.depth());
+		cv::Mat img;
+		if (imgSrc.depth() == depth) {
+			img = imgSrc;
+		}
+		else if (imgSrc.isContinuous() && ((imgSrc.depth() == CV_8U && depth == CV_32F) || (imgSrc.depth() == CV_32F && depth == CV_8U)))
 		{
-			img.convertTo(img, opencv::imageType<T_Type>(),
-				opencv::imageTypeRange<T_Type>() / opencv::imageTypeCVRange(img.depth()));
+			img = cv::Mat(imgSrc.rows, imgSrc.cols, CV_MAKETYPE(depth, imgSrc.channels()));
+			const size_t count = imgSrc.total() * imgSrc.channels();
+			if (depth == CV_32F) {
+				pixels::convert(imgSrc.ptr<uchar>(), img.ptr<float>(), count, scale);
+			} else {
+				pixels::convert(imgSrc.ptr<float>(), img.ptr<uchar>(), count, scale);
+			}
+		}
+		else
+		{
+			imgSrc.convertTo(img, depth, scale);
 		}
 
-		cv::Vec<T_Type, T_NumComp> p;
 		if (img.channels() != T_NumComp)
 		{
-			_pixels = cv::Mat(img.rows, img.cols, opencvType());
-			for (int y = 0; y < img.rows; ++y)
-			{
-				for (int x = 0; x < img.cols; ++x)
-				{
-					const T_Type* ptr = img.ptr<T_Type>(y, x);
-					assert(ptr != nullptr);
-					uint i;
-					for (i = 0; i < (uint)img.channels() && i < T_NumComp; ++i)
-						p[i] = ptr[i];
-					for (; i < T_NumComp && i < 3; ++i)
-						p[i] = p[0];
-					for (; i < T_NumComp && i < 4; ++i)
-						p[i] = static_cast<T_Type>(opencv::imageTypeRange<T_Type>());
-
-					_pixels.at<cv::Vec<T_Type, T_NumComp>>(y, x) = p;
-				}
+			if (!img.isContinuous()) {
+				img = img.clone();
 			}
+			_pixels = cv::Mat(img.rows, img.cols, opencvType());
+			pixels::convertChannels(img.ptr<T_Type>(), uint(img.channels()), _pixels.ptr<T_Type>(), T_NumComp, img.total(),
+				static_cast<T_Type>(opencv::imageTypeRange<T_Type>()));
 		}
 		else
-			_pixels = img;
+			_pixels = img.data == imgSrc.data ? img.clone() : img;
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
@@ -866,6 +915,33 @@ namespace sibr
 		return true;
 	}
 
+	template<typename T_Type, unsigned int T_NumComp>
+	bool		Image<T_Type, T_NumComp>::loadReduced(const std::string& filename, uint minWidth, uint minHeight, bool verbose, bool warning_if_not_found) {
+		if (IImage::reducedDecodeScale(filename, minWidth, minHeight) == 1) {
+			return load(filename, verbose, warning_if_not_found);
+		}
+		if (verbose)
+			SIBR_LOG << "Loading image file '" << filename << "' downscaled." << std::endl;
+		else
+			std::cerr << ".";
+		// JPEG has no alpha and 8 bits only, as load the orientation tag is ignored.
+		cv::Mat img = opencv::imreadReduced(filename, minWidth, minHeight,
+			(T_NumComp == 1 ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR) | cv::IMREAD_IGNORE_ORIENTATION);
+		if (img.data == nullptr)
+		{
+			operator =(Image<T_Type, T_NumComp>()); // reset mat
+
+			if (warning_if_not_found) {
+				SIBR_WRG << "Image file not found '" << filename << "'." << std::endl;
+			}
+
+			return false;
+		}
+		opencv::convertBGR2RGB(img);
+		fromOpenCV(img);
+		return true;
+	}
+
 	template<typename T_Type, unsigned int T_NumComp>
 	bool		Image<T_Type, T_NumComp>::loadByteStream(const std::string& filename, bool verbose) {
 		if (verbose)
@@ -874,28 +950,24 @@ namespace sibr
 			std::cerr << ".";
 
 
-		cv::Vec<T_Type, T_NumComp> p;
-
+		// The file is mapped, rows are converted straight to the pixels.
 		sibr::ByteStream bs;
-		if (!bs.load(filename))
+		if (!bs.map(filename)) {
 			SIBR_WRG << "Image file not found '" << filename << "'." << std::endl;
+			return false;
+		}
 
-		int wIm;
-		int hIm;
+		int wIm = 0;
+		int hIm = 0;
 		bs >> wIm >> hIm;
+		if (!bs || size_t(std::max(wIm, 0)) * size_t(std::max(hIm, 0)) * T_NumComp * sizeof(T_Type) > bs.readableSize()) {
+			SIBR_WRG << "Image file is truncated '" << filename << "'." << std::endl;
+			return false;
+		}
 
 		_pixels = cv::Mat(hIm, wIm, opencvType());
 		for (int y = 0; y < hIm; ++y)
-		{
-			for (int x = 0; x < wIm; ++x)
-			{
-				uint i;
-				for (i = 0; i < T_NumComp; ++i)
-					bs >> p[i];
-
-				_pixels.at<cv::Vec<T_Type, T_NumComp>>(y, x) = p;
-			}
-		}
+			bs.read(_pixels.ptr<T_Type>(y), size_t(wIm) * T_NumComp);
 
 		return true;
 	}
@@ -1005,21 +1077,18 @@ namespace sibr
 		if (verbose)
 			SIBR_LOG << "Saving image file '" << filename << "'." << std::endl;
 
-		sibr::ByteStream bs;
-
 		int wIm = w();
 		int hIm = h();
 
 		if (wIm > 0 && hIm > 0) {
+			sibr::ByteStreamWriter bs;
+			if (!bs.open(filename))
+				return;
 			bs << wIm << hIm;
-			for (int j = 0; j < hIm; j++) {
-				for (int i = 0; i < wIm; i++) {
-					for (int k = 0; k < T_NumComp; k++) {
-						bs << _pixels.at<cv::Vec<T_Type, T_NumComp>>(j, i)[k];
-					}
-				}
-			}
-			bs.saveToFile(filename);
+			for (int j = 0; j < hIm; j++)
+				bs.write(_pixels.ptr<T_Type>(j), size_t(wIm) * T_NumComp);
+			if (!bs.close())
+				SIBR_WRG << "failed to write image file '" << filename << "'." << std::endl;
 		}
 		else
 			SIBR_WRG << "failed to save (image is empty)" << std::endl;
@@ -1180,6 +1249,18 @@ exit(1);
 		cv::flip(_pixels, _pixels, 1 /*!=1 means vertical*/);
 	}
 
+	template<typename T_Type, unsigned int T_NumComp>
+	Image<T_Type, T_NumComp>		Image<T_Type, T_NumComp>::flippedH(void) const {
+		Image<T_Type, T_NumComp> img;
+		if (_pixels.isContinuous()) {
+			img._pixels = cv::Mat(_pixels.rows, _pixels.cols, _pixels.type());
+			pixels::flipRows(_pixels.data, img._pixels.data, size_t(_pixels.rows), size_t(_pixels.cols) * sizeOfComp());
+		} else {
+			cv::flip(_pixels, img._pixels, 0);
+		}
+		return img;
+	}
+
 	template<typename T_Type, unsigned int T_NumComp>
 	void Image<T_Type, T_NumComp>::findMinMax(Pixel& minImage, Pixel& maxImage) {
 		for (uint c = 0; c < T_NumComp; ++c) {
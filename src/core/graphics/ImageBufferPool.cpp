@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/graphics/ImageBufferPool.hpp"
+#include <new>
+
+namespace sibr
+{
+	namespace
+	{
+		void * allocateBuffer(size_t capacity)
+		{
+			return ::operator new(capacity, std::align_val_t(ImageBufferPool::alignment));
+		}
+
+		void freeBuffer(void * buffer)
+		{
+			::operator delete(buffer, std::align_val_t(ImageBufferPool::alignment));
+		}
+	}
+
+	ImageBufferPool::ImageBufferPool(size_t maxRetainedBytes) :
+		_maxRetained(maxRetainedBytes)
+	{
+	}
+
+	ImageBufferPool::~ImageBufferPool(void)
+	{
+		trim(0);
+	}
+
+	ImageBufferPool & ImageBufferPool::shared(void)
+	{
+		// Leaked on purpose: pooled images destroyed with other statics can still give their buffer back.
+		static ImageBufferPool * pool = new ImageBufferPool();
+		return *pool;
+	}
+
+	size_t ImageBufferPool::sizeClass(size_t bytes)
+	{
+		const size_t minClass = 4096;
+		if (bytes <= minClass) {
+			return minClass;
+		}
+		size_t power = minClass;
+		while (power <= bytes / 2) {
+			power *= 2;
+		}
+		// Quarter steps between powers of two: at most 25% wasted.
+		const size_t step = power / 4;
+		return (bytes + step - 1) / step * step;
+	}
+
+	void * ImageBufferPool::acquire(size_t bytes, size_t & capacity)
+	{
+		capacity = sizeClass(bytes);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const auto bucket = _free.find(capacity);
+			if (bucket != _free.end() && !bucket->second.empty()) {
+				// Most recently released first, its pages are more likely to be resident.
+				void * buffer = bucket->second.back().buffer;
+				bucket->second.pop_back();
+				_retained -= capacity;
+				_memory.set(_retained);
+				return buffer;
+			}
+		}
+		return allocateBuffer(capacity);
+	}
+
+	void ImageBufferPool::release(void * buffer, size_t capacity)
+	{
+		if (buffer == nullptr) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (capacity <= _maxRetained) {
+				_free[capacity].push_back({ buffer, capacity, _stamp++ });
+				_retained += capacity;
+				trimLocked(_maxRetained);
+				_memory.set(_retained);
+				return;
+			}
+		}
+		freeBuffer(buffer);
+	}
+
+	void ImageBufferPool::trim(size_t maxRetainedBytes)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		trimLocked(maxRetainedBytes);
+		_memory.set(_retained);
+	}
+
+	void ImageBufferPool::setMaxRetainedBytes(size_t maxRetainedBytes)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_maxRetained = maxRetainedBytes;
+		trimLocked(_maxRetained);
+		_memory.set(_retained);
+	}
+
+	size_t ImageBufferPool::retainedBytes(void) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _retained;
+	}
+
+	void ImageBufferPool::trimLocked(size_t maxRetainedBytes)
+	{
+		while (_retained > maxRetainedBytes) {
+			// The oldest buffer of each class is at the front of its list.
+			auto oldest = _free.end();
+			for (auto bucket = _free.begin(); bucket != _free.end(); ++bucket) {
+				if (!bucket->second.empty() && (oldest == _free.end() || bucket->second.front().stamp < oldest->second.front().stamp)) {
+					oldest = bucket;
+				}
+			}
+			if (oldest == _free.end()) {
+				break;
+			}
+			const Retained retained = oldest->second.front();
+			oldest->second.erase(oldest->second.begin());
+			if (oldest->second.empty()) {
+				_free.erase(oldest);
+			}
+			_retained -= retained.capacity;
+			freeBuffer(retained.buffer);
+		}
+	}
+
+}
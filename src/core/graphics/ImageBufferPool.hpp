@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "core/graphics/Config.hpp"
+#include "core/graphics/Image.hpp"
+#include "core/graphics/ImageSpan.hpp"
+#include "core/graphics/MemoryTracker.hpp"
+
+namespace sibr
+{
+	/** Recycles the pixel buffers of transient images (decoding, resizing, read back...), to avoid
+	 reallocating similar large blocks for each image of a dataset.
+	 Buffers are rounded up to size classes (quarter steps between powers of two) so that images of
+	 close dimensions share them. Released buffers are kept up to a budget, the oldest
+	 being freed first, and are reported to the MemoryTracker as IMAGE.
+	 Thread safe. Use PooledImage rather than the raw buffers.
+	 \ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT ImageBufferPool
+	{
+		SIBR_DISALLOW_COPY(ImageBufferPool);
+
+	public:
+
+		/// Alignment of the buffers, in bytes.
+		static const size_t alignment = 64;
+
+		/** Constructor.
+		 *\param maxRetainedBytes the size of the released buffers kept for reuse
+		 */
+		explicit ImageBufferPool(size_t maxRetainedBytes = size_t(256) << 20);
+
+		/// Destructor, frees the retained buffers. Buffers still acquired should not be released afterwards.
+		~ImageBufferPool(void);
+
+		/** \return the process-wide pool. It is never destroyed, so buffers can be released at exit. */
+		static ImageBufferPool & shared(void);
+
+		/** Get a buffer, reusing a released one of the same size class if possible.
+		 *\param bytes the minimal size
+		 *\param capacity will contain the actual size of the buffer, to give back to release
+		 *\return the buffer, aligned on alignment bytes
+		 */
+		void *		acquire(size_t bytes, size_t & capacity);
+
+		/** Give a buffer back, it is kept for reuse if the budget allows it.
+		 *\param buffer the buffer, from acquire
+		 *\param capacity its capacity, as returned by acquire
+		 */
+		void		release(void * buffer, size_t capacity);
+
+		/** Free retained buffers.
+		 *\param maxRetainedBytes the size to keep retained, 0 to free everything
+		 */
+		void		trim(size_t maxRetainedBytes = 0);
+
+		/** Set the size of the released buffers kept for reuse, freeing the excess.
+		 *\param maxRetainedBytes the new budget
+		 */
+		void		setMaxRetainedBytes(size_t maxRetainedBytes);
+
+		/** \return the size of the retained buffers, in bytes. */
+		size_t		retainedBytes(void) const;
+
+		/** \return the capacity of the buffers used for a size.
+		 *\param bytes the size
+		 */
+		static size_t	sizeClass(size_t bytes);
+
+	private:
+
+		/** Free the oldest retained buffers until the budget is met. The lock should be held.
+		 *\param maxRetainedBytes the budget
+		 */
+		void		trimLocked(size_t maxRetainedBytes);
+
+		/// A retained buffer.
+		struct Retained {
+			void *		buffer; ///< The buffer.
+			size_t		capacity; ///< Its capacity.
+			size_t		stamp; ///< Release order.
+		};
+
+		mutable std::mutex				_mutex; ///< Protects the retained buffers.
+		std::map<size_t, std::vector<Retained>>	_free; ///< Retained buffers, per size class.
+		size_t							_retained = 0; ///< Size of the retained buffers.
+		size_t							_maxRetained; ///< Budget for the retained buffers.
+		size_t							_stamp = 0; ///< Release counter.
+		TrackedMemory					_memory = TrackedMemory(MemoryTracker::IMAGE); ///< Retained size report.
+	};
+
+	/** Image whose pixels live in a buffer of an ImageBufferPool, given back when the object is destroyed.
+	 For temporary images of similar sizes created in loops, such as resize or conversion destinations.
+	 The wrapped image can be passed to any function expecting an Image, as long as it does not outlive
+	 this object; functions reallocating it (resize, assignment) detach it from the pool buffer.
+
+	Code Example:
+
+		sibr::PooledImage<uchar, 3> scaled(w, h);
+		cv::resize(img.toOpenCV(), scaled.image().toOpenCVnonConst(), cv::Size(w, h));
+		texture.update(scaled.image());
+
+	 \ingroup sibr_graphics
+	*/
+	template<typename T_Type, unsigned int T_NumComp>
+	class PooledImage
+	{
+	public:
+
+		typedef Image<T_Type, T_NumComp>	ImageType;
+
+		/// Empty image, holding no buffer.
+		PooledImage(void) {}
+
+		/** Constructor, the pixels are not initialized.
+		 *\param width the width
+		 *\param height the height
+		 *\param pool the pool providing the buffer
+		 */
+		PooledImage(uint width, uint height, ImageBufferPool & pool = ImageBufferPool::shared()) :
+			_pool(&pool)
+		{
+			if (width == 0 || height == 0) {
+				return;
+			}
+			const size_t bytes = size_t(width) * height * T_NumComp * sizeof(T_Type);
+			_buffer = _pool->acquire(bytes, _capacity);
+			_image.toOpenCVnonConst() = cv::Mat(int(height), int(width), CV_MAKETYPE(opencv::imageType<T_Type>(), T_NumComp), _buffer);
+		}
+
+		/// Move constructor.
+		PooledImage(PooledImage && other) noexcept { *this = std::move(other); }
+
+		/// Move operator.
+		PooledImage & operator=(PooledImage && other) noexcept {
+			if (this != &other) {
+				reset();
+				std::swap(_pool, other._pool);
+				std::swap(_buffer, other._buffer);
+				std::swap(_capacity, other._capacity);
+				std::swap(_image, other._image);
+			}
+			return *this;
+		}
+
+		/// Destructor, gives the buffer back.
+		~PooledImage(void) { reset(); }
+
+		PooledImage(const PooledImage &) = delete;
+		PooledImage & operator=(const PooledImage &) = delete;
+
+		/** \return the image. */
+		ImageType &			image(void) { return _image; }
+
+		/** \return the image. */
+		const ImageType &	image(void) const { return _image; }
+
+		/** \return a span on the pixels. */
+		ImageSpan<T_Type, T_NumComp>	span(void) { return ImageSpan<T_Type, T_NumComp>(_image); }
+
+		/** \return a copy of the image owning its pixels, that can outlive this object. */
+		ImageType			clone(void) const { return _image.clone(); }
+
+		/// Release the image and give the buffer back.
+		void				reset(void) {
+			_image = ImageType();
+			if (_buffer) {
+				_pool->release(_buffer, _capacity);
+				_buffer = nullptr;
+				_capacity = 0;
+			}
+		}
+
+	private:
+
+		ImageBufferPool *	_pool = nullptr; ///< Provider of the buffer.
+		void *				_buffer = nullptr; ///< Pixels buffer.
+		size_t				_capacity = 0; ///< Buffer capacity.
+		ImageType			_image; ///< Image over the buffer.
+	};
+
+} // namespace sibr
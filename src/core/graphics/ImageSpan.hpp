@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+
+#include "core/graphics/Config.hpp"
+#include "core/graphics/Image.hpp"
+
+namespace sibr
+{
+	/** Non-owning view on the pixels of an image, or of a rectangle of it.
+	 Rows can be padded: consecutive rows are stride bytes apart. Views are cheap to copy and
+	 never allocate; the viewed buffer has to outlive them.
+	 Use a const component type (ImageSpan<const uchar, 3>) for read-only views.
+
+	Code Example:
+
+		sibr::ImageRGB img(640, 480);
+		sibr::ImageSpanRGB crop(img, 100, 50, 64, 64);
+		crop(0, 0) = sibr::ImageRGB::Pixel(255, 0, 0); // Modifies img(100, 50).
+		cv::GaussianBlur(crop.toOpenCV(), crop.toOpenCV(), cv::Size(5, 5), 0.0);
+
+	 \ingroup sibr_graphics
+	*/
+	template<typename T_Type, unsigned int T_NumComp>
+	class ImageSpan
+	{
+	public:
+
+		typedef typename std::remove_const<T_Type>::type					Type;
+		typedef Image<Type, T_NumComp>										ImageType;
+		typedef typename ImageType::Pixel									Pixel;
+		typedef typename std::conditional<std::is_const<T_Type>::value, const Pixel, Pixel>::type	PixelAccess;
+		typedef typename std::conditional<std::is_const<T_Type>::value, const uchar, uchar>::type	Byte;
+
+		/// Empty view.
+		ImageSpan(void) {}
+
+		/** View on an existing buffer.
+		 *\param data the first component of the top-left pixel
+		 *\param width the number of pixels per row
+		 *\param height the number of rows
+		 *\param stride the distance between rows in bytes, 0 for packed rows
+		 */
+		ImageSpan(T_Type* data, uint width, uint height, size_t stride = 0) :
+			_data(data), _w(width), _h(height), _stride(stride > 0 ? stride : size_t(width) * T_NumComp * sizeof(Type)) {}
+
+		/** View on a whole image.
+		 *\param img the image
+		 */
+		ImageSpan(ImageType& img) :
+			ImageSpan(img.toOpenCVnonConst()) {}
+
+		/** View on a rectangle of an image, clamped to the image.
+		 *\param img the image
+		 *\param x left column
+		 *\param y top row
+		 *\param width the rectangle width
+		 *\param height the rectangle height
+		 */
+		ImageSpan(ImageType& img, uint x, uint y, uint width, uint height) :
+			ImageSpan(ImageSpan(img).sub(x, y, width, height)) {}
+
+		/** Read-only view on a whole image, only for const component types.
+		 *\param img the image
+		 */
+		template<typename U = T_Type, typename = typename std::enable_if<std::is_const<U>::value>::type>
+		ImageSpan(const ImageType& img) :
+			ImageSpan(const_cast<cv::Mat&>(img.toOpenCV())) {}
+
+		/** Read-only view on a rectangle of an image, only for const component types.
+		 *\param img the image
+		 *\param x left column
+		 *\param y top row
+		 *\param width the rectangle width
+		 *\param height the rectangle height
+		 */
+		template<typename U = T_Type, typename = typename std::enable_if<std::is_const<U>::value>::type>
+		ImageSpan(const ImageType& img, uint x, uint y, uint width, uint height) :
+			ImageSpan(ImageSpan(img).sub(x, y, width, height)) {}
+
+		/** Read-only view from a mutable one.
+		 *\param other the mutable view
+		 */
+		template<typename U = T_Type, typename = typename std::enable_if<std::is_const<U>::value>::type>
+		ImageSpan(const ImageSpan<Type, T_NumComp>& other) :
+			_data(other.data()), _w(other.w()), _h(other.h()), _stride(other.stride()) {}
+
+		/** \return the width in pixels. */
+		uint		w(void) const { return _w; }
+
+		/** \return the height in pixels. */
+		uint		h(void) const { return _h; }
+
+		/** \return the size in pixels. */
+		sibr::Vector2u	size(void) const { return sibr::Vector2u(_w, _h); }
+
+		/** \return the distance between rows in bytes. */
+		size_t		stride(void) const { return _stride; }
+
+		/** \return the first component of the top-left pixel. */
+		T_Type*		data(void) const { return _data; }
+
+		/** \return true if the view has no pixel. */
+		bool		empty(void) const { return _data == nullptr || _w == 0 || _h == 0; }
+
+		/** \return true if the rows are packed, the view being one contiguous block. */
+		bool		isContinuous(void) const { return _stride == size_t(_w) * T_NumComp * sizeof(Type); }
+
+		/** Row access.
+		 *\param y the row
+		 *\return the first component of the row
+		 */
+		T_Type*		row(uint y) const {
+			return reinterpret_cast<T_Type*>(reinterpret_cast<Byte*>(_data) + size_t(y) * _stride);
+		}
+
+		/** Pixel access, without bounds check.
+		 *\param x column
+		 *\param y row
+		 *\return the pixel
+		 */
+		PixelAccess&	operator()(uint x, uint y) const {
+			return *reinterpret_cast<PixelAccess*>(row(y) + size_t(x) * T_NumComp);
+		}
+
+		/** Rectangle of this view, sharing its pixels. The rectangle is clamped to the view.
+		 *\param x left column
+		 *\param y top row
+		 *\param width the rectangle width
+		 *\param height the rectangle height
+		 *\return the sub view
+		 */
+		ImageSpan	sub(uint x, uint y, uint width, uint height) const {
+			x = std::min(x, _w);
+			y = std::min(y, _h);
+			width = std::min(width, _w - x);
+			height = std::min(height, _h - y);
+			return ImageSpan(_data ? row(y) + size_t(x) * T_NumComp : nullptr, width, height, _stride);
+		}
+
+		/** \return an OpenCV header on the viewed pixels, nothing is copied.
+		 *\note For read-only views, the header should not be written to.
+		 */
+		cv::Mat		toOpenCV(void) const {
+			if (empty()) {
+				return cv::Mat();
+			}
+			return cv::Mat(int(_h), int(_w), CV_MAKETYPE(opencv::imageType<Type>(), T_NumComp),
+				const_cast<Type*>(_data), _stride);
+		}
+
+		/** Copy the viewed pixels into an image, resized if needed.
+		 *\param dst the destination image
+		 */
+		void		copyTo(ImageType& dst) const {
+			if (dst.w() != _w || dst.h() != _h) {
+				dst = ImageType(_w, _h);
+			}
+			if (!empty()) {
+				toOpenCV().copyTo(dst.toOpenCVnonConst());
+			}
+		}
+
+		/** \return a new image holding a copy of the viewed pixels. */
+		ImageType	clone(void) const {
+			ImageType dst;
+			copyTo(dst);
+			return dst;
+		}
+
+	private:
+
+		/** View on the pixels of an OpenCV matrix of the matching type.
+		 *\param mat the matrix
+		 */
+		explicit ImageSpan(cv::Mat& mat) :
+			ImageSpan(mat.empty() ? nullptr : reinterpret_cast<T_Type*>(mat.data), uint(mat.cols), uint(mat.rows), mat.step[0]) {}
+
+		T_Type*		_data = nullptr; ///< Top-left pixel.
+		uint		_w = 0; ///< Width in pixels.
+		uint		_h = 0; ///< Height in pixels.
+		size_t		_stride = 0; ///< Distance between rows in bytes.
+	};
+
+	typedef ImageSpan<unsigned char, 3>			ImageSpanRGB;
+	typedef ImageSpan<unsigned char, 4>			ImageSpanRGBA;
+	typedef ImageSpan<unsigned char, 1>			ImageSpanL8;
+	typedef ImageSpan<float, 3>					ImageSpanRGB32F;
+	typedef ImageSpan<float, 4>					ImageSpanRGBA32F;
+	typedef ImageSpan<float, 1>					ImageSpanL32F;
+	typedef ImageSpan<const unsigned char, 3>	ConstImageSpanRGB;
+	typedef ImageSpan<const unsigned char, 4>	ConstImageSpanRGBA;
+	typedef ImageSpan<const unsigned char, 1>	ConstImageSpanL8;
+	typedef ImageSpan<const float, 3>			ConstImageSpanRGB32F;
+	typedef ImageSpan<const float, 4>			ConstImageSpanRGBA32F;
+	typedef ImageSpan<const float, 1>			ConstImageSpanL32F;
+
+} // namespace sibr
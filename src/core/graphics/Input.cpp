@@ -12,6 +12,7 @@
 
 
 #include "core/graphics/Input.hpp"
+#include "core/graphics/Window.hpp"
 
 namespace sibr
 {
@@ -27,7 +28,9 @@ namespace sibr
 	/*static*/ void		Input::poll( void )
 	{
 		sibr::Input::global().swapStates();
-		glfwPollEvents();
+		// Headless windows have no events.
+		if (Window::displayIsRunning())
+			glfwPollEvents();
 	}
 
 	Input Input::subInput(const sibr::Input & global, const sibr::Viewport & viewport, const bool mouseOutsideDisablesKeyboard)
@@ -10,6 +10,8 @@
  */
 
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <memory>
 #include <map>
@@ -23,9 +25,12 @@
 
 #include "core/system/ByteStream.hpp"
 #include "core/graphics/MaterialMesh.hpp"
+#include "core/graphics/GLState.hpp"
 #include "core/system/Transform3.hpp"
+#include "core/system/ThreadPool.hpp"
 #include "boost/filesystem.hpp"
 #include "core/system/XMLTree.h"
+#include "core/system/XMLReader.hpp"
 #include "core/system/Matrix.hpp"
 #include <set>
 #include <boost/variant/detail/substitute.hpp>
@@ -61,6 +66,7 @@ namespace sibr
 		auto convertVec = [](const aiVector3D& v) {
 			return Vector3f(v.x, v.y, v.z); };
 		_triangles.clear();
+		invalidateTopology();
 
 		uint offsetVertices = 0;
 		uint offsetFaces = 0;
@@ -345,12 +351,201 @@ namespace sibr
 		return "";
 	}
 
+	namespace {
+
+		/** Finds the meshes and textures referenced by a Mitsuba scene while it is streamed, with the
+		 same rules as the scene assembly in MaterialMesh::loadMtsXML, so that they can be loaded while
+		 the rest of the file is read.
+		 */
+		class MtsAssetsVisitor : public sibr::XMLReader::Visitor
+		{
+		public:
+
+			/// Called with a mesh file name, relative to the scene, and whether it is a unique shape or part of a group.
+			std::function<void(const std::string&, bool)> onMesh;
+			/// Called with a texture file name, and whether it is an opacity map.
+			std::function<void(const std::string&, bool)> onTexture;
+			/// Should the textures be listed.
+			bool withTextures = true;
+
+			void begin(const sibr::XMLReader::Element& element) override
+			{
+				const int parent = element.depth > 0 ? _roles[element.depth - 1] : NONE;
+				int role = OTHER;
+				if (element.depth == 0) {
+					role = (element.name == "scene" && !_sceneSeen) ? SCENE : OTHER;
+					_sceneSeen = _sceneSeen || role == SCENE;
+				}
+				else if (parent == SCENE && element.name == "shape") {
+					const std::string_view type = element.attribute("type");
+					if (type == "shapegroup") {
+						role = SHAPEGROUP;
+						_groupId = std::string(element.attribute("id"));
+						_groupFiles.clear();
+					}
+					else if (type == "instance") {
+						role = INSTANCE;
+					}
+					else if (type == "obj" || type == "ply") {
+						role = UNIQUE_SHAPE;
+					}
+					_firstChild = true;
+				}
+				else if (parent == UNIQUE_SHAPE && element.name == "string" && _firstChild) {
+					// The first string of the shape is its file.
+					_firstChild = false;
+					const std::string filename = sibr::XMLReader::decode(element.attribute("value"));
+					onMesh(filename, true);
+				}
+				else if (parent == INSTANCE && element.name == "ref" && _firstChild) {
+					_firstChild = false;
+					instantiate(sibr::XMLReader::decode(element.attribute("id")));
+				}
+				else if (parent == SHAPEGROUP && element.name == "shape") {
+					role = GROUP_SHAPE;
+					_groupFiles.emplace_back();
+				}
+				else if (parent == GROUP_SHAPE && element.name == "string" && element.attribute("name") == "filename" && _groupFiles.back().empty()) {
+					_groupFiles.back() = sibr::XMLReader::decode(element.attribute("value"));
+				}
+				else if (withTextures && element.name == "bsdf" && (parent == SCENE || parent == BSDF)) {
+					role = BSDF;
+				}
+				else if (parent == BSDF && element.name == "texture") {
+					const std::string_view name = element.attribute("name");
+					if (name == "opacity" || name == "diffuseReflectance" || name == "reflectance" || name == "specularReflectance") {
+						role = TEXTURE;
+						_opacity = name == "opacity";
+						_textureFiles.clear();
+						_nestedFiles.clear();
+						_nested = false;
+					}
+				}
+				else if (parent == TEXTURE && element.name == "texture" && !_nested) {
+					// Only the files of the first nested texture are used, if there is one.
+					role = NESTED_TEXTURE;
+					_nested = true;
+				}
+				else if ((parent == TEXTURE || parent == NESTED_TEXTURE) && element.name == "string") {
+					(parent == TEXTURE ? _textureFiles : _nestedFiles).push_back(sibr::XMLReader::decode(element.attribute("value")));
+				}
+				_roles.resize(size_t(element.depth) + 1);
+				_roles[element.depth] = role;
+			}
+
+			void end(std::string_view name, int depth) override
+			{
+				(void)name;
+				const int role = _roles[depth];
+				if (role == SHAPEGROUP) {
+					std::vector<std::string>& files = _groups[_groupId];
+					files.clear();
+					for (const std::string& file : _groupFiles) {
+						if (!file.empty()) {
+							files.push_back(file);
+						}
+					}
+					// Instances usually follow their group, but not always.
+					if (_pending.erase(_groupId) > 0) {
+						instantiate(_groupId);
+					}
+				}
+				else if (role == TEXTURE) {
+					for (const std::string& file : _nested ? _nestedFiles : _textureFiles) {
+						onTexture(file, _opacity);
+					}
+				}
+			}
+
+		private:
+
+			/// What an element is for the assets search.
+			enum Role { NONE, OTHER, SCENE, SHAPEGROUP, GROUP_SHAPE, INSTANCE, UNIQUE_SHAPE, BSDF, TEXTURE, NESTED_TEXTURE };
+
+			/** List the meshes of an instanced shape group.
+			 *\param id the group id
+			 */
+			void instantiate(const std::string& id)
+			{
+				const auto group = _groups.find(id);
+				if (group == _groups.end()) {
+					_pending.insert(id);
+					return;
+				}
+				for (const std::string& file : group->second) {
+					onMesh(file, false);
+				}
+			}
+
+			std::vector<int> _roles; ///< Role of the enclosing elements, by depth.
+			bool _sceneSeen = false; ///< Only the first scene is loaded.
+			bool _firstChild = false; ///< No reference was read in the current shape yet.
+			std::string _groupId; ///< Current shape group.
+			std::vector<std::string> _groupFiles; ///< Files of the shapes of the current group.
+			std::map<std::string, std::vector<std::string>> _groups; ///< Files of the groups read so far.
+			std::set<std::string> _pending; ///< Groups instanced before being defined.
+			bool _opacity = false; ///< Is the current texture an opacity map.
+			bool _nested = false; ///< Has the current texture a nested texture.
+			std::vector<std::string> _textureFiles; ///< Files of the current texture.
+			std::vector<std::string> _nestedFiles; ///< Files of its first nested texture.
+		};
+	}
+
 	bool	MaterialMesh::loadMtsXML(const std::string& xmlFile, bool loadTextures)
 	{
 		srand(static_cast <unsigned> (time(0)));
 		bool allLoaded = true;
 		std::string pathFolder = boost::filesystem::path(xmlFile).parent_path()
 			.string();
+		// Stream the file first: the meshes and textures are loaded in the background as soon as
+		// they are referenced, while the rest of the file and the DOM used to assemble the scene are parsed.
+		// Keys are the ones used when assembling the shapes.
+		struct MeshLoad {
+			bool unique;
+			std::shared_ptr<sibr::MaterialMesh> mesh;
+			std::future<bool> loaded;
+		};
+		std::map<std::string, MeshLoad> meshLoads;
+		std::map<std::string, std::future<sibr::ImageRGBA::Ptr>> diffuseLoads;
+		std::map<std::string, std::future<sibr::ImageRGB::Ptr>> opacityLoads;
+		{
+			sibr::ThreadPool& pool = sibr::ThreadPool::shared();
+			MtsAssetsVisitor assets;
+			assets.withTextures = loadTextures;
+			assets.onMesh = [&](const std::string& filename, bool unique) {
+				const std::string path = pathFolder + "/" + filename;
+				const std::string key = unique ? filename : path;
+				if (meshLoads.count(key) > 0) {
+					return;
+				}
+				MeshLoad& load = meshLoads[key];
+				load.unique = unique;
+				load.mesh = std::make_shared<sibr::MaterialMesh>();
+				const std::shared_ptr<sibr::MaterialMesh> mesh = load.mesh;
+				load.loaded = pool.submit([mesh, path]() { return mesh->load(path); });
+			};
+			assets.onTexture = [&](const std::string& filename, bool opacity) {
+				const std::string path = pathFolder + "/" + filename;
+				if (opacity && opacityLoads.count(filename) == 0) {
+					opacityLoads[filename] = pool.submit([path]() {
+						sibr::ImageRGB::Ptr texture(new sibr::ImageRGB());
+						return texture->load(path) ? texture : sibr::ImageRGB::Ptr();
+					});
+				}
+				else if (!opacity && diffuseLoads.count(filename) == 0) {
+					diffuseLoads[filename] = pool.submit([path]() {
+						sibr::ImageRGBA::Ptr texture(new sibr::ImageRGBA());
+						return texture->load(path) ? texture : sibr::ImageRGBA::Ptr();
+					});
+				}
+			};
+			sibr::XMLReader reader;
+			if (!reader.open(xmlFile) || !reader.parse(assets)) {
+				// The assets not found yet are loaded when the scene is assembled.
+				SIBR_WRG << reader.error() << std::endl;
+			}
+		}
+
 		sibr::XMLTree doc(xmlFile);
 		std::map<std::string, sibr::MaterialMesh> meshes;
 
@@ -396,6 +591,36 @@ namespace sibr
 				idToShapegroups[id] = shapeGroup;
 			}
 		}
+
+		std::map<std::string, sibr::ImageRGBA::Ptr> diffuseFiles;
+		std::map<std::string, sibr::ImageRGB::Ptr> opacityFiles;
+		{
+			std::map<std::string, bool> meshLoaded;
+			for (auto& load : meshLoads) {
+				meshLoaded[load.first] = load.second.loaded.get();
+				meshes[load.first] = std::move(*load.second.mesh);
+			}
+			for (auto& load : diffuseLoads) {
+				diffuseFiles[load.first] = load.second.get();
+			}
+			for (auto& load : opacityLoads) {
+				opacityFiles[load.first] = load.second.get();
+			}
+
+			for (const auto& load : meshLoads) {
+				if (!load.second.unique) {
+					continue;
+				}
+				if (!meshLoaded[load.first]) {
+					return false;
+				}
+				if (meshes[load.first].matIds().empty()) {
+					SIBR_WRG << "Material (" << load.first << ") not present ..." << std::endl;
+				}
+			}
+			SIBR_LOG << "Loaded " << meshLoads.size() << " meshes and " << diffuseLoads.size() + opacityLoads.size() << " textures." << std::endl;
+		}
+
 		// Second: Create all the actual shapes
 		for (rapidxml::xml_node<> *node = nodeScene->first_node("shape");
 			node; node = node->next_sibling("shape"))
@@ -622,9 +847,9 @@ namespace sibr
 							{
 								std::string textureName =
 									nodeString->first_attribute("value")->value();
-								sibr::ImageRGBA::Ptr texture(new sibr::ImageRGBA());
 								// If we skip loading the textures, still set them as empty images.
-								if (!loadTextures || texture->load(pathFolder + "/" + textureName)) {
+								const sibr::ImageRGBA::Ptr texture = loadTextures ? diffuseFiles[textureName] : sibr::ImageRGBA::Ptr(new sibr::ImageRGBA());
+								if (texture) {
 									/*std::cout << "Diffuse " << pathFolder + "/"
 										+ textureName << std::endl;*/
 									_diffuseMaps[nameMat] = texture;
@@ -778,8 +1003,8 @@ namespace sibr
 						{
 							std::string textureName = nodeString->
 								first_attribute("value")->value();
-							sibr::ImageRGB::Ptr texture(new sibr::ImageRGB());
-							if (!loadTextures || texture->load(pathFolder + "/" + textureName)) {
+							const sibr::ImageRGB::Ptr texture = loadTextures ? opacityFiles[textureName] : sibr::ImageRGB::Ptr(new sibr::ImageRGB());
+							if (texture) {
 								_opacityMaps[nameMat] = texture;
 								breakBool = true;
 								break;
@@ -992,6 +1217,7 @@ namespace sibr
 	{
 		if (!_gl.bufferGL) { SIBR_ERR << "Tried to forceBufferGL on a non OpenGL Mesh" << std::endl; return; }
 		_gl.dirtyBufferGL = false;
+		_gl.dirtyRanges.clear();
 		_gl.bufferGL->build(*this);
 	}
 
@@ -1012,106 +1238,120 @@ namespace sibr
 				(a + (b - c))) / 4.f;
 		};
 
+		// Each pass flags the large faces in parallel, then writes their center vertex and their
+		// three triangles at offsets given by prefix sums of the flags, in parallel too.
+		// The attributes grow in place, and are given back to the mesh once at the end.
+		const bool withColors = hasColors();
+		const bool withNormals = hasNormals();
+		const bool withTexCoords = hasTexCoords();
+		const bool withMeshIds = hasMeshIds();
+		sibr::Mesh::Colors newColors(colors());
+		sibr::Mesh::Normals newNormals(normals());
+		sibr::Mesh::UVs newTexCoords(texCoords());
+		sibr::Mesh::Vertices newVertices(vertices());
+		sibr::MaterialMesh::MeshIds newMeshIds(meshIds());
+		sibr::Mesh::Triangles newTriangles(triangles()), nextTriangles;
+		sibr::MaterialMesh::MatIds newMatIds(matIds()), nextMatIds;
+		std::vector<uint> vertexOffsets, triangleOffsets;
+		sibr::ThreadPool& pool = sibr::ThreadPool::shared();
+		const float limit = _averageArea * threshold;
+
 		bool mustChange = true;
 		while (mustChange) {
-			mustChange = false;
-			sibr::Mesh::Colors newColors(colors());
-			sibr::Mesh::Normals newNormals(normals());
-			sibr::Mesh::UVs newTexCoords(texCoords());
-			sibr::Mesh::Vertices newVertices(vertices());
-			sibr::MaterialMesh::MeshIds newMeshIds(meshIds());
-
-			sibr::Mesh::Triangles newTriangles;
-			sibr::MaterialMesh::MatIds newMatIds;
-			std::cout << triangles().size() << " triangles" << std::endl;
-			for (unsigned int i = 0; i < triangles().size(); i++) {
-				sibr::Vector3u t = triangles().at(i);
-
-				int tMatId;
-				if (i < matIds().size())
-					tMatId = matIds().at(i);
-
-				sibr::Vector3f a = vertices().at(t.x());
-				sibr::Vector3f b = vertices().at(t.y());
-				sibr::Vector3f c = vertices().at(t.z());
-
-				if (areaHeronsFormula(a, b, c) >= (_averageArea*threshold)) {
-					mustChange = true;
-
-					sibr::Vector3f aColor, bColor, cColor, aNormal, bNormal, cNormal;
-					sibr::Vector2f aTexCoords, bTexCoords, cTexCoords;
-
-					sibr::Vector3f newColor, newNormal;
-					sibr::Vector2f newTexCoord;
-					sibr::Vector3f newVertex;
-
-					if (hasColors()) {
-						newColor = (colors().at(t.x()) + colors().at(t.y())
-							+ colors().at(t.z())) / 3.f;
-					}
-
-					if (hasNormals()) {
-						newNormal = (normals().at(t.x()) + normals().at(t.y())
-							+ normals().at(t.z())) / 3.f;
-					}
-
-					if (hasTexCoords()) {
-						newTexCoord = (texCoords().at(t.x()) + texCoords().at(t.y())
-							+ texCoords().at(t.z())) / 3.f;
-					}
-
-
-					newVertex = (vertices().at(t.x()) + vertices().at(t.y())
-						+ vertices().at(t.z())) / 3.f;
-
-					newVertices.push_back(newVertex);
-
-					if (hasColors()) {
-						newColors.push_back(newColor);
-					}
-
-					if (hasNormals()) {
-						newNormals.push_back(newNormal);
-					}
-
-					if (hasTexCoords()) {
-						newTexCoords.push_back(newTexCoord);
-					}
+			const int nTriangles = int(newTriangles.size());
+			std::cout << nTriangles << " triangles" << std::endl;
+			vertexOffsets.resize(nTriangles + 1);
+			triangleOffsets.resize(nTriangles + 1);
+			pool.parallelFor(0, nTriangles, [&](int i) {
+				const sibr::Vector3u& t = newTriangles[i];
+				const bool split = areaHeronsFormula(newVertices[t.x()], newVertices[t.y()], newVertices[t.z()]) >= limit;
+				vertexOffsets[i] = split ? 1 : 0;
+				triangleOffsets[i] = split ? 3 : 1;
+			});
+			// Exclusive prefix sums, the last entries receive the totals.
+			uint vertexCount = 0, triangleCount = 0;
+			for (int i = 0; i < nTriangles; ++i) {
+				const uint v = vertexOffsets[i];
+				const uint t = triangleOffsets[i];
+				vertexOffsets[i] = vertexCount;
+				triangleOffsets[i] = triangleCount;
+				vertexCount += v;
+				triangleCount += t;
+			}
+			vertexOffsets[nTriangles] = vertexCount;
+			triangleOffsets[nTriangles] = triangleCount;
+			mustChange = vertexCount > 0;
+			if (!mustChange) {
+				break;
+			}
 
-					if (hasMeshIds()) {
-						// Pick the first referenced vertex as the provoking vertex.
-						newMeshIds.push_back(meshIds().at(t.x()));
+			const uint nOldVertices = uint(newVertices.size());
+			const int nMatIds = std::min(int(newMatIds.size()), nTriangles);
+			newVertices.resize(nOldVertices + vertexCount);
+			if (withColors) {
+				newColors.resize(newVertices.size());
+			}
+			if (withNormals) {
+				newNormals.resize(newVertices.size());
+			}
+			if (withTexCoords) {
+				newTexCoords.resize(newVertices.size());
+			}
+			if (withMeshIds) {
+				newMeshIds.resize(newVertices.size());
+			}
+			nextTriangles.resize(triangleCount);
+			nextMatIds.resize(triangleOffsets[nMatIds]);
+
+			pool.parallelFor(0, nTriangles, [&](int i) {
+				const sibr::Vector3u t = newTriangles[i];
+				sibr::Vector3u* out = &nextTriangles[triangleOffsets[i]];
+				if (vertexOffsets[i + 1] == vertexOffsets[i]) {
+					out[0] = t;
+					if (i < nMatIds) {
+						nextMatIds[triangleOffsets[i]] = newMatIds[i];
 					}
+					return;
+				}
 
-					int newIndexVertex = static_cast<int> (newVertices.size()) - 1;
-					newTriangles.push_back(sibr::Vector3u(t.x(),
-						t.y(),
-						newIndexVertex));
-					newTriangles.push_back(sibr::Vector3u(t.y(),
-						t.z(),
-						newIndexVertex));
-					newTriangles.push_back(sibr::Vector3u(t.z(),
-						t.x(),
-						newIndexVertex));
-					if (i < matIds().size()) {
-						for (unsigned int n = 0; n < 3; ++n)
-							newMatIds.push_back(tMatId);
-					}
+				const uint newIndexVertex = nOldVertices + vertexOffsets[i];
+				newVertices[newIndexVertex] = (newVertices[t.x()] + newVertices[t.y()]
+					+ newVertices[t.z()]) / 3.f;
+				if (withColors) {
+					newColors[newIndexVertex] = (newColors[t.x()] + newColors[t.y()]
+						+ newColors[t.z()]) / 3.f;
 				}
-				else {
-					newTriangles.push_back(t);
-					if (i < matIds().size())
-						newMatIds.push_back(tMatId);
+				if (withNormals) {
+					newNormals[newIndexVertex] = (newNormals[t.x()] + newNormals[t.y()]
+						+ newNormals[t.z()]) / 3.f;
 				}
-			}
-			vertices(newVertices);
-			colors(newColors);
-			normals(newNormals);
-			texCoords(newTexCoords);
-			triangles(newTriangles);
-			matIds(newMatIds);
-			meshIds(newMeshIds);
+				if (withTexCoords) {
+					newTexCoords[newIndexVertex] = (newTexCoords[t.x()] + newTexCoords[t.y()]
+						+ newTexCoords[t.z()]) / 3.f;
+				}
+				if (withMeshIds) {
+					// Pick the first referenced vertex as the provoking vertex.
+					newMeshIds[newIndexVertex] = newMeshIds[t.x()];
+				}
+
+				out[0] = sibr::Vector3u(t.x(), t.y(), newIndexVertex);
+				out[1] = sibr::Vector3u(t.y(), t.z(), newIndexVertex);
+				out[2] = sibr::Vector3u(t.z(), t.x(), newIndexVertex);
+				if (i < nMatIds) {
+					for (unsigned int n = 0; n < 3; ++n)
+						nextMatIds[triangleOffsets[i] + n] = newMatIds[i];
+				}
+			});
+			newTriangles.swap(nextTriangles);
+			newMatIds.swap(nextMatIds);
 		}
+		vertices(std::move(newVertices));
+		colors(std::move(newColors));
+		normals(std::move(newNormals));
+		texCoords(std::move(newTexCoords));
+		triangles(std::move(newTriangles));
+		matIds(newMatIds);
+		meshIds(newMeshIds);
 	}
 
 	void	MaterialMesh::subdivideMesh(float threshold) {
@@ -1356,6 +1596,70 @@ namespace sibr
 		_ambientOcclusion = ao;
 	}
 
+	void MaterialMesh::ambientOcclusionAsync(const MaterialMesh::AmbientOcclusion & ao)
+	{
+		// The task works on a CPU only copy, so that the mesh can be rendered meanwhile.
+		const auto copy = std::make_shared<MaterialMesh>(false);
+		copy->vertices(vertices());
+		copy->triangles(triangles());
+		if (hasNormals()) {
+			copy->normals(normals());
+		}
+		if (hasTexCoords()) {
+			copy->texCoords(texCoords());
+		}
+		if (hasColors()) {
+			copy->colors(colors());
+		}
+		copy->_matIds = _matIds;
+		copy->_matIdsVertices = _matIdsVertices;
+		copy->_matId2Name = _matId2Name;
+		copy->_meshIds = _meshIds;
+		copy->_maxMeshId = _maxMeshId;
+		copy->_aoFunction = _aoFunction;
+		copy->_ambientOcclusion = _ambientOcclusion;
+		copy->_aoInitialized = _aoInitialized;
+		copy->_averageSize = _averageSize;
+		copy->_averageArea = _averageArea;
+
+		_aoResult = sibr::ThreadPool::shared().submit([copy, ao]() {
+			copy->ambientOcclusion(ao);
+			return copy;
+		}).share();
+	}
+
+	bool MaterialMesh::updateAmbientOcclusion(void)
+	{
+		if (!_aoResult.valid() || _aoResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return false;
+		}
+		const std::shared_ptr<MaterialMesh> result = _aoResult.get();
+		_aoResult = std::shared_future<std::shared_ptr<MaterialMesh>>();
+
+		// Only the colors changed if the mesh was not subdivided.
+		if (result->vertices().size() != vertices().size() || result->triangles().size() != triangles().size()) {
+			vertices(result->vertices());
+			triangles(result->triangles());
+			if (result->hasNormals()) {
+				normals(result->normals());
+			}
+			if (result->hasTexCoords()) {
+				texCoords(result->texCoords());
+			}
+			_matIds = result->_matIds;
+			_matIdsVertices = result->_matIdsVertices;
+			_meshIds = result->_meshIds;
+		}
+		colors(result->colors());
+		_subMeshes = std::move(result->_subMeshes);
+		_batch.reset();
+		_ambientOcclusion = result->_ambientOcclusion;
+		_aoInitialized = result->_aoInitialized;
+		_averageSize = result->_averageSize;
+		_averageArea = result->_averageArea;
+		return true;
+	}
+
 
 	void	MaterialMesh::initAlbedoTextures(void) {
 
@@ -1493,6 +1797,174 @@ namespace sibr
 			invertDepthTest, true);
 	}
 
+	/** GPU buffers of the batched rendering. */
+	struct MaterialMesh::MaterialBatch
+	{
+		/// Layout of glMultiDrawElementsIndirect commands.
+		struct DrawCommand {
+			GLuint count;
+			GLuint instanceCount;
+			GLuint firstIndex;
+			GLuint baseVertex;
+			GLuint baseInstance;
+		};
+
+		/// Layout of the shader material, std430.
+		struct Material {
+			GLuint64 diffuse;
+			GLuint64 opacity;
+		};
+
+		~MaterialBatch(void)
+		{
+			for (const GLuint64 handle : handles) {
+				glMakeTextureHandleNonResidentARB(handle);
+			}
+			const GLuint buffers[] = { indexBuffer, commandBuffer, materialBuffer };
+			glDeleteBuffers(3, buffers);
+		}
+
+		GLuint indexBuffer = 0; ///< Triangles sorted by material.
+		GLuint commandBuffer = 0; ///< One draw command per material.
+		GLuint materialBuffer = 0; ///< Texture handles, one entry per draw command.
+		GLsizei drawCount = 0; ///< Number of draw commands.
+		std::vector<GLuint64> handles; ///< Handles made resident for the batch.
+	};
+
+	bool	MaterialMesh::batchingSupported(void)
+	{
+		return GLEW_ARB_bindless_texture && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_draw_parameters;
+	}
+
+	void	MaterialMesh::buildBatch(void) const
+	{
+		_batch = std::make_shared<MaterialBatch>();
+		const size_t materialCount = _matId2Name.size();
+
+		const auto residentHandle = [this](GLuint texture) -> GLuint64 {
+			if (texture == 0) {
+				return 0;
+			}
+			const GLuint64 handle = glGetTextureHandleARB(texture);
+			glMakeTextureHandleResidentARB(handle);
+			_batch->handles.push_back(handle);
+			return handle;
+		};
+		// The loader fills missing opacity maps with a white pixel, these materials need no alpha test.
+		const auto isOpaque = [this](size_t mat) {
+			const sibr::ImageRGB::Ptr opacity = opacityMap(_matId2Name[mat]);
+			return !opacity || (opacity->w() <= 1 && opacity->h() <= 1 && (*opacity)(0, 0) == sibr::ImageRGB::Pixel(255, 255, 255));
+		};
+
+		// Opaque materials first, so that alpha tested ones benefit from early depth rejection.
+		std::vector<size_t> order;
+		for (int pass = 0; pass < 2; ++pass) {
+			for (size_t mat = 0; mat < materialCount; ++mat) {
+				if (isOpaque(mat) == (pass == 0)) {
+					order.push_back(mat);
+				}
+			}
+		}
+
+		// Counting sort of the triangles by material.
+		std::vector<GLuint> firstTriangle(materialCount + 1, 0);
+		for (const int mat : _matIds) {
+			if (mat >= 0 && size_t(mat) < materialCount) {
+				++firstTriangle[mat];
+			}
+		}
+		std::vector<MaterialBatch::DrawCommand> commands;
+		std::vector<MaterialBatch::Material> materials;
+		std::vector<GLuint> cursor(materialCount, 0);
+		GLuint offset = 0;
+		for (const size_t mat : order) {
+			const GLuint count = firstTriangle[mat];
+			cursor[mat] = offset;
+			if (count == 0) {
+				continue;
+			}
+			commands.push_back({ 3 * count, 1, 3 * offset, 0, 0 });
+			materials.push_back({ residentHandle(_idTextures[mat]), isOpaque(mat) ? 0 : residentHandle(_idTexturesOpacity[mat]) });
+			offset += count;
+		}
+		std::vector<GLuint> indices(3 * size_t(offset));
+		for (size_t t = 0; t < _matIds.size(); ++t) {
+			const int mat = _matIds[t];
+			if (mat < 0 || size_t(mat) >= materialCount) {
+				continue;
+			}
+			const size_t dst = 3 * size_t(cursor[mat]++);
+			indices[dst + 0] = _triangles[t][0];
+			indices[dst + 1] = _triangles[t][1];
+			indices[dst + 2] = _triangles[t][2];
+		}
+
+		glCreateBuffers(1, &_batch->indexBuffer);
+		glNamedBufferStorage(_batch->indexBuffer, std::max<size_t>(sizeof(GLuint) * indices.size(), 1), indices.empty() ? nullptr : indices.data(), 0);
+		glCreateBuffers(1, &_batch->commandBuffer);
+		glNamedBufferStorage(_batch->commandBuffer, std::max<size_t>(sizeof(MaterialBatch::DrawCommand) * commands.size(), 1), commands.empty() ? nullptr : commands.data(), 0);
+		glCreateBuffers(1, &_batch->materialBuffer);
+		glNamedBufferStorage(_batch->materialBuffer, std::max<size_t>(sizeof(MaterialBatch::Material) * materials.size(), 1), materials.empty() ? nullptr : materials.data(), 0);
+		_batch->drawCount = GLsizei(commands.size());
+		CHECK_GL_ERROR;
+	}
+
+	void	MaterialMesh::renderAlbedoBatched(bool depthTest, bool backFaceCulling,
+		RenderMode mode, bool frontFaceCulling, bool invertDepthTest) const
+	{
+		if (!batchingSupported()) {
+			renderAlbedo(depthTest, backFaceCulling, mode, frontFaceCulling, invertDepthTest);
+			return;
+		}
+		if (!_albedoTexturesInitialized) {
+			SIBR_WRG << "[MaterialMesh] Textures have to be initialized before batched rendering." << std::endl;
+			return;
+		}
+		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
+		if (!hasMatIds()) {
+			return;
+		}
+		updateBufferGL();
+		if (!_batch) {
+			buildBatch();
+		}
+		if (_batch->drawCount == 0) {
+			return;
+		}
+
+		if (depthTest)
+			GLState::enable(GL_DEPTH_TEST);
+		else
+			GLState::disable(GL_DEPTH_TEST);
+
+		if (backFaceCulling) {
+			GLState::enable(GL_CULL_FACE);
+			GLState::cullFace(frontFaceCulling ? GL_FRONT : GL_BACK);
+		}
+		else
+			GLState::disable(GL_CULL_FACE);
+
+		if (invertDepthTest) {
+			GLState::depthFunc(GL_GEQUAL);
+		}
+		GLState::polygonMode(GL_FRONT_AND_BACK, mode == PointRenderMode ? GL_POINT : (mode == LineRenderMode ? GL_LINE : GL_FILL));
+
+		// The element buffer binding is part of the vertex array state, draws of the mesh buffer bind theirs again.
+		_gl.bufferGL->bind();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _batch->indexBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _batch->commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, _batch->materialBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, _batch->drawCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		_gl.bufferGL->unbind();
+
+		// Reset default state, as Mesh::render.
+		GLState::disable(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::depthFunc(GL_LESS);
+	}
+
 	void	MaterialMesh::render(bool depthTest, bool backFaceCulling,
 		RenderMode mode, bool frontFaceCulling, bool invertDepthTest,
 		bool tessellation, bool adjacency) const
@@ -1513,6 +1985,11 @@ namespace sibr
 			renderThreeSixty(depthTest, backFaceCulling, mode, frontFaceCulling,
 				invertDepthTest);
 		}
+		else if (_typeOfRender == RenderCategory::batchedMaterials)
+		{
+			renderAlbedoBatched(depthTest, backFaceCulling, mode, frontFaceCulling,
+				invertDepthTest);
+		}
 	}
 
 	void	MaterialMesh::merge(const MaterialMesh& other)
@@ -1629,6 +2106,7 @@ namespace sibr
 	void	MaterialMesh::createSubMeshes(void) {
 
 		_subMeshes.clear();
+		_batch.reset();
 
 		for (unsigned int i = 0; i < _matId2Name.size(); i++)
 		{
@@ -13,7 +13,9 @@
 #pragma once
 
 # include <vector>
+# include <future>
 # include <map>
+# include <memory>
 # include <sstream>
 
 # include "core/graphics/Config.hpp"
@@ -58,7 +60,8 @@ namespace sibr
 			classic,
 			diffuseMaterials,
 			threesixtyMaterials,
-			threesixtyDepth
+			threesixtyDepth,
+			batchedMaterials ///< Diffuse materials in a single indirect draw, see renderAlbedoBatched.
 		};
 
 		/** Ambient occlusion options. */
@@ -190,6 +193,51 @@ namespace sibr
 			//"	if (out_color.x < 0.01f && out_color.y < 0.01f && out_color.z < 0.01f) discard;		\n"
 			"}																	\n";
 
+		/** Vertex shader of renderAlbedoBatched, the material is the index of the draw. */
+		std::string vertexShaderAlbedoBatched =
+			"#version 450										\n"
+			"#extension GL_ARB_shader_draw_parameters : require	\n"
+			"layout(location = 0) in vec3 in_vertex;			\n"
+			"layout(location = 1) in vec3 in_colors;			\n"
+			"layout(location = 2) in vec2 in_uvCoords;			\n"
+			"layout (location = 2) out vec2 uvCoords;			\n"
+			"layout (location = 1) out vec3 colors;				\n"
+			"flat out int material;								\n"
+			"uniform mat4 MVP;									\n"
+			"void main(void) {									\n"
+			"	uvCoords = in_uvCoords;							\n"
+			"	colors = in_colors;								\n"
+			"	material = gl_DrawIDARB;						\n"
+			"	gl_Position = MVP*vec4(in_vertex,1);			\n"
+			"}													\n";
+
+		/** Fragment shader of renderAlbedoBatched, same shading as fragmentShaderAlbedo with the
+		 textures read from the bindless handles of the material buffer. */
+		std::string fragmentShaderAlbedoBatched =
+			"#version 450														\n"
+			"#extension GL_ARB_bindless_texture : require						\n"
+			"struct Material { uvec2 diffuse; uvec2 opacity; };					\n"
+			"layout(std430, binding = 9) readonly buffer Materials { Material materials[]; };	\n"
+			"uniform bool AoIsActive;											\n"
+			"uniform float IlluminanceCoefficient;								\n"
+			"layout (location = 2) in vec2 uvCoords;							\n"
+			"layout (location = 1) in vec3 colors;								\n"
+			"flat in int material;												\n"
+			"out vec4 out_color;												\n"
+			"void main(void) {													\n"
+			"	Material mat = materials[material];							\n"
+			"	vec2 uv = vec2(uvCoords.x,1.0-uvCoords.y);					\n"
+			"	if (mat.opacity != uvec2(0)) {									\n"
+			"		vec4 opacityColor = texture(sampler2D(mat.opacity), uv);	\n"
+			"		if (opacityColor.x < 0.1f && opacityColor.y < 0.1f && opacityColor.z < 0.1f ) discard;\n"
+			"	}																\n"
+			"	out_color = mat.diffuse != uvec2(0) ? texture(sampler2D(mat.diffuse), uv) : vec4(0,0,0,1);\n"
+			"	if (AoIsActive) {												\n"
+			"		float lighter_ao = min(colors.x * IlluminanceCoefficient, 1.f);\n"
+			"		out_color = out_color * vec4(vec3(lighter_ao),1);			\n"
+			"	}																\n"
+			"}																	\n";
+
 	public:
 
 		/** Constructor.
@@ -325,6 +373,22 @@ namespace sibr
 		*/
 		void ambientOcclusion(const AmbientOcclusion& ao);
 
+		/** Same as ambientOcclusion, but the AO values, and the subdivision if the threshold decreased, are computed
+		on a copy of the geometry by a background task. The mesh keeps its current geometry and colors, and can be
+		rendered, until updateAmbientOcclusion applies the result.
+		\param ao the new options
+		\note The AO function is called from a worker thread.
+		*/
+		void ambientOcclusionAsync(const AmbientOcclusion& ao);
+
+		/** Apply the result of ambientOcclusionAsync if it is ready, call it once per frame.
+		\return true if the mesh was updated
+		*/
+		bool updateAmbientOcclusion(void);
+
+		/** \return true if a background ambient occlusion computation has not been applied yet. */
+		bool ambientOcclusionPending(void) const { return _aoResult.valid(); }
+
 		/** \return the current ambient occlusion options. */
 		inline const AmbientOcclusion& ambientOcclusion(void);
 
@@ -459,6 +523,29 @@ namespace sibr
 			bool invertDepthTest
 		) const;
 
+		/** \return true if the GPU supports renderAlbedoBatched (bindless textures, indirect multi draws and draw parameters). */
+		static bool batchingSupported(void);
+
+		/** Render the geometry with albedo textures, all materials in a single indirect multi draw.
+		Triangles are sorted by material, opaque materials first, and the texture handles of each draw
+		are stored in a shader storage buffer at binding 9. Use with vertexShaderAlbedoBatched and
+		fragmentShaderAlbedoBatched; tag textures are not supported.
+		Falls back to renderAlbedo (and its shaders) if batchingSupported() is false.
+		\param depthTest should depth testing be performed
+		\param backFaceCulling should culling be performed
+		\param mode the primitives rendering mode
+		\param frontFaceCulling should the culling test be flipped
+		\param invertDepthTest should the depth test be flipped (GL_GREATER_THAN)
+		\note initAlbedoTextures has to be called first.
+		*/
+		void	renderAlbedoBatched(
+			bool depthTest = true,
+			bool backFaceCulling = true,
+			RenderMode mode = FillRenderMode,
+			bool frontFaceCulling = false,
+			bool invertDepthTest = false
+		) const;
+
 		/** Upload the material textures to the GPU. */
 		void	initAlbedoTextures(void);
 
@@ -470,6 +557,10 @@ namespace sibr
 
 	private:
 
+		struct MaterialBatch;
+
+		/** Sort the triangles by material and upload the index, draw and material buffers of renderAlbedoBatched. */
+		void	buildBatch(void) const;
 
 		MatIds		_matIds; ///< Per triangle material ID.
 		MatIds		_matIdsVertices; ///< Per vertex material ID.
@@ -494,6 +585,7 @@ namespace sibr
 		std::vector<GLuint> _idTextures; ///< Texture handles.
 		std::vector<sibr::Texture2DRGB::Ptr> _opacityTextures;///< Opacity textures.
 		std::vector<GLuint> _idTexturesOpacity;///< Opacity texture handles.
+		mutable std::shared_ptr<MaterialBatch> _batch; ///< Buffers of the batched rendering, released before the textures.
 
 		bool _hasTagsFile = false; ///< Is a tag file associated to the mesh.
 		sibr::Texture2DRGB::Ptr _tagTexture; ///< Tag texture.
@@ -514,6 +606,7 @@ namespace sibr
 		AmbientOcclusion _ambientOcclusion; ///< AO options.
 		std::function<sibr::Mesh::Colors(sibr::MaterialMesh&, const int)> _aoFunction; ///< AO generation function.
 		bool _aoInitialized = false; ///< Is AO data initialized.
+		std::shared_future<std::shared_ptr<MaterialMesh>> _aoResult; ///< Mesh copy updated by the background AO task.
 		float _averageSize = 0.0f; ///< Average maximum edge length.
 		float _averageArea = 0.0f; ///< Average triangle area.
 
@@ -525,6 +618,7 @@ namespace sibr
 
 	void	MaterialMesh::matIds(const MatIds& matIds) {
 		_matIds = matIds;
+		_batch.reset();
 	}
 	const MaterialMesh::MatIds& MaterialMesh::matIds(void) const {
 		return _matIds;
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include "MemoryTracker.hpp"
+#include "core/system/Utils.hpp"
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+// Memory info extensions, not always exposed by the GL loader.
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+# define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+# define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+# define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+namespace sibr {
+
+	namespace {
+
+		/// Subsystems of the enclosing MemoryScope, innermost last.
+		thread_local std::vector<const char*> currentScopes;
+
+		/// Escape a name for a JSON string.
+		std::string jsonEscape(const std::string & name)
+		{
+			std::string out;
+			for (const char c : name) {
+				if (c == '"' || c == '\\') {
+					out.push_back('\\');
+				}
+				out.push_back(c);
+			}
+			return out;
+		}
+
+		/// Size in megabytes, for display.
+		float toMB(size_t bytes)
+		{
+			return float(double(bytes) / (1024.0 * 1024.0));
+		}
+	}
+
+	MemoryTracker & MemoryTracker::get()
+	{
+		static MemoryTracker tracker;
+		return tracker;
+	}
+
+	const char * MemoryTracker::currentCategory()
+	{
+		return currentScopes.empty() ? "Other" : currentScopes.back();
+	}
+
+	const char * MemoryTracker::kindName(Kind kind)
+	{
+		static const char * names[KIND_COUNT] = { "Textures", "Render targets", "Buffers", "CUDA", "Images", "Meshes" };
+		return names[kind];
+	}
+
+	const std::string * MemoryTracker::intern(const char * category)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		// Map nodes are never erased, their keys stay valid.
+		return &_categories.emplace(category, Usages()).first->first;
+	}
+
+	void MemoryTracker::update(const std::string * category, Kind kind, size_t oldBytes, size_t newBytes)
+	{
+		if (oldBytes == newBytes) {
+			return;
+		}
+		std::lock_guard<std::mutex> guard(_lock);
+		const auto apply = [&](Usage & usage) {
+			usage.bytes = usage.bytes - oldBytes + newBytes;
+			usage.peak = std::max(usage.peak, usage.bytes);
+			if (oldBytes == 0) {
+				++usage.count;
+			}
+			else if (newBytes == 0) {
+				--usage.count;
+			}
+		};
+		apply(_categories[*category][kind]);
+		apply(_totals[kind]);
+	}
+
+	MemoryTracker::Usage MemoryTracker::total(Kind kind) const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		return _totals[kind];
+	}
+
+	size_t MemoryTracker::gpuBytes() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		size_t bytes = 0;
+		for (int k = 0; k < KIND_COUNT; ++k) {
+			bytes += isGPU(Kind(k)) ? _totals[k].bytes : 0;
+		}
+		return bytes;
+	}
+
+	size_t MemoryTracker::cpuBytes() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		size_t bytes = 0;
+		for (int k = 0; k < KIND_COUNT; ++k) {
+			bytes += isGPU(Kind(k)) ? 0 : _totals[k].bytes;
+		}
+		return bytes;
+	}
+
+	std::map<std::string, MemoryTracker::Usages> MemoryTracker::categories() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		return _categories;
+	}
+
+	bool MemoryTracker::driverMemory(size_t & total, size_t & available)
+	{
+		// Both extensions report kilobytes.
+		GLint values[4] = { 0, 0, 0, 0 };
+		if (GLEW_NVX_gpu_memory_info) {
+			glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &values[0]);
+			glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &values[1]);
+			total = size_t(values[0]) * 1024;
+			available = size_t(values[1]) * 1024;
+			return true;
+		}
+		if (GLEW_ATI_meminfo) {
+			glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, values);
+			total = 0;
+			available = size_t(values[0]) * 1024;
+			return true;
+		}
+		return false;
+	}
+
+	size_t MemoryTracker::textureBytes(uint w, uint h, uint depth, uint levels, double texelBytes)
+	{
+		double texels = 0.0;
+		for (uint l = 0; levels == 0 || l < levels; ++l) {
+			const uint lw = std::max(w >> l, 1u);
+			const uint lh = std::max(h >> l, 1u);
+			texels += double(lw) * double(lh);
+			if (lw == 1 && lh == 1) {
+				break;
+			}
+		}
+		return size_t(texels * double(depth) * texelBytes);
+	}
+
+	double MemoryTracker::texelBytes(GLenum internalFormat)
+	{
+		switch (internalFormat) {
+		case GL_R8: case GL_R8UI: case GL_R8I: case GL_STENCIL_INDEX8:
+			return 1.0;
+		case GL_RG8: case GL_RG8UI: case GL_R16: case GL_R16F: case GL_R16UI: case GL_DEPTH_COMPONENT16:
+			return 2.0;
+		case GL_RGB8: case GL_SRGB8: case GL_DEPTH_COMPONENT24:
+			return 3.0;
+		case GL_RGB16: case GL_RGB16F:
+			return 6.0;
+		case GL_RGBA16: case GL_RGBA16F: case GL_RG32F: case GL_RG32UI: case GL_RG32I:
+			return 8.0;
+		case GL_RGB32F: case GL_RGB32UI: case GL_RGB32I:
+			return 12.0;
+		case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+			return 16.0;
+		// Block compressed formats, 4x4 texels in 8 or 16 bytes.
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: case GL_COMPRESSED_RED_RGTC1:
+			return 0.5;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			return 1.0;
+		default:
+			return 4.0;
+		}
+	}
+
+	void MemoryTracker::onGUI(const std::string & windowName)
+	{
+		if (!ImGui::Begin(windowName.c_str())) {
+			ImGui::End();
+			return;
+		}
+		ImGui::Text("GPU: %.1f MB, CPU: %.1f MB", toMB(gpuBytes()), toMB(cpuBytes()));
+		size_t driverTotal = 0, driverAvailable = 0;
+		if (driverMemory(driverTotal, driverAvailable)) {
+			if (driverTotal > 0) {
+				ImGui::Text("Driver: %.1f MB available of %.1f MB", toMB(driverAvailable), toMB(driverTotal));
+			}
+			else {
+				ImGui::Text("Driver: %.1f MB available", toMB(driverAvailable));
+			}
+		}
+		ImGui::Checkbox("Peaks", &_showPeaks);
+		ImGui::SameLine();
+		if (ImGui::Button("Export JSON...")) {
+			std::string path;
+			if (showFilePicker(path, FilePickerMode::Save, "", "json") && !path.empty()) {
+				exportJSON(path);
+			}
+		}
+
+		// One row per subsystem, one column per kind, in megabytes.
+		const std::map<std::string, Usages> usages = categories();
+		Usages totals;
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			totals = _totals;
+		}
+		ImGui::Separator();
+		ImGui::Columns(KIND_COUNT + 1, "memory_usages");
+		ImGui::Text("Subsystem");
+		ImGui::NextColumn();
+		for (int k = 0; k < KIND_COUNT; ++k) {
+			ImGui::Text("%s", kindName(Kind(k)));
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+		const auto row = [this](const char * name, const Usages & values) {
+			ImGui::Text("%s", name);
+			ImGui::NextColumn();
+			for (const Usage & usage : values) {
+				if (usage.peak > 0) {
+					ImGui::Text("%.1f (%zu)", toMB(_showPeaks ? usage.peak : usage.bytes), usage.count);
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("%.3f MB, peak %.3f MB, %zu resources", toMB(usage.bytes), toMB(usage.peak), usage.count);
+					}
+				}
+				ImGui::NextColumn();
+			}
+		};
+		for (const auto & category : usages) {
+			row(category.first.c_str(), category.second);
+		}
+		ImGui::Separator();
+		row("Total", totals);
+		ImGui::Columns(1);
+		ImGui::End();
+	}
+
+	bool MemoryTracker::exportJSON(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			SIBR_WRG << "[MemoryTracker] Unable to write usage to " << path << "." << std::endl;
+			return false;
+		}
+		const auto writeUsages = [&file](const Usages & usages) {
+			file << "{";
+			for (int k = 0; k < KIND_COUNT; ++k) {
+				file << (k > 0 ? "," : "") << "\"" << kindName(Kind(k)) << "\":{\"bytes\":" << usages[k].bytes
+					<< ",\"peak\":" << usages[k].peak << ",\"count\":" << usages[k].count << "}";
+			}
+			file << "}";
+		};
+
+		const std::map<std::string, Usages> usages = categories();
+		file << "{\"gpuBytes\":" << gpuBytes() << ",\"cpuBytes\":" << cpuBytes();
+		size_t driverTotal = 0, driverAvailable = 0;
+		if (driverMemory(driverTotal, driverAvailable)) {
+			file << ",\"driver\":{\"total\":" << driverTotal << ",\"available\":" << driverAvailable << "}";
+		}
+		file << "," << std::endl << "\"total\":";
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			writeUsages(_totals);
+		}
+		file << "," << std::endl << "\"categories\":{";
+		bool first = true;
+		for (const auto & category : usages) {
+			file << (first ? "" : ",") << std::endl << "\"" << jsonEscape(category.first) << "\":";
+			writeUsages(category.second);
+			first = false;
+		}
+		file << std::endl << "}}" << std::endl;
+		return true;
+	}
+
+	TrackedMemory::TrackedMemory(const TrackedMemory & other) :
+		_kind(other._kind), _category(other._category)
+	{
+		set(other._bytes);
+	}
+
+	TrackedMemory::TrackedMemory(TrackedMemory && other) noexcept :
+		_kind(other._kind), _category(other._category), _bytes(other._bytes)
+	{
+		other._bytes = 0;
+	}
+
+	TrackedMemory & TrackedMemory::operator=(const TrackedMemory & other)
+	{
+		if (this != &other) {
+			set(0);
+			_kind = other._kind;
+			_category = other._category;
+			set(other._bytes);
+		}
+		return *this;
+	}
+
+	TrackedMemory & TrackedMemory::operator=(TrackedMemory && other) noexcept
+	{
+		if (this != &other) {
+			set(0);
+			_kind = other._kind;
+			_category = other._category;
+			_bytes = other._bytes;
+			other._bytes = 0;
+		}
+		return *this;
+	}
+
+	TrackedMemory::~TrackedMemory()
+	{
+		set(0);
+	}
+
+	void TrackedMemory::set(size_t bytes)
+	{
+		if (bytes == _bytes) {
+			return;
+		}
+		MemoryTracker & tracker = MemoryTracker::get();
+		if (!_category) {
+			_category = tracker.intern(MemoryTracker::currentCategory());
+		}
+		tracker.update(_category, _kind, _bytes, bytes);
+		_bytes = bytes;
+	}
+
+	MemoryScope::MemoryScope(const char * name)
+	{
+		currentScopes.push_back(name);
+	}
+
+	MemoryScope::~MemoryScope()
+	{
+		currentScopes.pop_back();
+	}
+
+}
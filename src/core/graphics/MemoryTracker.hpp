@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#pragma once
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Config.hpp>
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace sibr {
+
+	/**
+	 * Accounting of the memory used by the application, per subsystem and per kind of resource.
+	 * Resources report their size through a TrackedMemory member; the subsystem they are charged to is
+	 * the innermost MemoryScope active on the allocating thread when they are first sized, "Other" otherwise.
+	 * Sizes are estimated from the resource dimensions and formats, without querying the driver.
+	 *
+	 *		MyRenderer::MyRenderer(...) {
+	 *			SIBR_MEMORY_SCOPE("MyRenderer");
+	 *			_target.reset(new RenderTargetRGBA(w, h));
+	 *		}
+	 *
+	 * Budget driven features can query the totals, onGUI displays them and exportJSON dumps them.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT MemoryTracker {
+		SIBR_DISALLOW_COPY(MemoryTracker);
+
+	public:
+
+		/// Resource kinds.
+		enum Kind {
+			TEXTURE = 0, ///< GL textures.
+			RENDER_TARGET, ///< GL framebuffer attachments.
+			BUFFER, ///< GL buffers.
+			CUDA, ///< CUDA device allocations.
+			IMAGE, ///< CPU images.
+			MESH, ///< CPU meshes.
+			KIND_COUNT
+		};
+
+		/// Usage of a kind of resource by a subsystem.
+		struct Usage {
+			size_t bytes = 0; ///< Current size.
+			size_t peak = 0; ///< Largest size reached.
+			size_t count = 0; ///< Number of live resources.
+		};
+
+		/// Usage of a subsystem, per kind.
+		typedef std::array<Usage, KIND_COUNT> Usages;
+
+		/** \return the tracker instance. */
+		static MemoryTracker & get();
+
+		/** \return the subsystem allocations of the calling thread are charged to. */
+		static const char * currentCategory();
+
+		/** \return a display name for a kind.
+		\param kind the kind
+		*/
+		static const char * kindName(Kind kind);
+
+		/** \return true for the kinds living on the GPU.
+		\param kind the kind
+		*/
+		static bool isGPU(Kind kind) { return kind <= CUDA; }
+
+		/** Get the persistent name of a subsystem, registering it on first use.
+		\param category the subsystem name
+		\return a pointer valid for the lifetime of the tracker
+		*/
+		const std::string * intern(const char * category);
+
+		/** Report a change of size of a resource. Resources of size 0 are not counted.
+		\param category the subsystem, see intern
+		\param kind the resource kind
+		\param oldBytes the previous size
+		\param newBytes the new size
+		*/
+		void update(const std::string * category, Kind kind, size_t oldBytes, size_t newBytes);
+
+		/** \return the usage of all subsystems for a kind.
+		\param kind the kind
+		*/
+		Usage total(Kind kind) const;
+
+		/** \return the memory used on the GPU, in bytes. */
+		size_t gpuBytes() const;
+
+		/** \return the memory used on the CPU by the tracked resources, in bytes. */
+		size_t cpuBytes() const;
+
+		/** \return a copy of the usage of each subsystem. */
+		std::map<std::string, Usages> categories() const;
+
+		/** Query the dedicated video memory reported by the driver, when the NVX or ATI memory info extension is available.
+		\param total will contain the total memory, 0 if unknown
+		\param available will contain the available memory
+		\return true if the driver reported something
+		*/
+		static bool driverMemory(size_t & total, size_t & available);
+
+		/** Estimate the size of a texture.
+		\param w the width
+		\param h the height
+		\param depth the layer count
+		\param levels the mipmap level count, 0 for a full chain
+		\param texelBytes the size of a texel, can be fractional for block compressed formats
+		\return the size in bytes
+		*/
+		static size_t textureBytes(uint w, uint h, uint depth, uint levels, double texelBytes);
+
+		/** \return the size of a texel of a GL internal format, 4 for unknown formats.
+		\param internalFormat the format
+		*/
+		static double texelBytes(GLenum internalFormat);
+
+		/** Display the usage per subsystem, and the export controls.
+		\param windowName the ImGui window name
+		*/
+		void onGUI(const std::string & windowName = "Memory");
+
+		/** Write the usage per subsystem as JSON.
+		\param path the destination file
+		\return true if the file was written
+		*/
+		bool exportJSON(const std::string & path) const;
+
+	private:
+
+		/// Constructor.
+		MemoryTracker() {}
+
+		mutable std::mutex _lock; ///< Guards the usages.
+		std::map<std::string, Usages> _categories; ///< Usage per subsystem.
+		Usages _totals; ///< Usage of all subsystems.
+		bool _showPeaks = false; ///< Display the largest sizes instead of the current ones.
+	};
+
+	/** Size of a resource reported to the MemoryTracker, for the lifetime of the object.
+	Copies register a new resource of the same size and subsystem.
+	\ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT TrackedMemory {
+	public:
+
+		/** Constructor.
+		\param kind the resource kind
+		*/
+		explicit TrackedMemory(MemoryTracker::Kind kind) : _kind(kind) {}
+
+		/// Copy constructor.
+		TrackedMemory(const TrackedMemory & other);
+
+		/// Move constructor.
+		TrackedMemory(TrackedMemory && other) noexcept;
+
+		/// Copy operator.
+		TrackedMemory & operator=(const TrackedMemory & other);
+
+		/// Move operator.
+		TrackedMemory & operator=(TrackedMemory && other) noexcept;
+
+		/// Destructor, unregisters the resource.
+		~TrackedMemory();
+
+		/** Report the size of the resource. The first non-zero size charges it to the current subsystem.
+		\param bytes the size, 0 when released
+		*/
+		void set(size_t bytes);
+
+		/** \return the reported size. */
+		size_t bytes() const { return _bytes; }
+
+	private:
+		MemoryTracker::Kind _kind; ///< Resource kind.
+		const std::string * _category = nullptr; ///< Subsystem, set on first registration.
+		size_t _bytes = 0; ///< Reported size.
+	};
+
+	/** Charge the resources sized on the calling thread to a subsystem, for the lifetime of the object.
+	\sa SIBR_MEMORY_SCOPE
+	\ingroup sibr_graphics
+	*/
+	class SIBR_GRAPHICS_EXPORT MemoryScope {
+		SIBR_DISALLOW_COPY(MemoryScope);
+	public:
+
+		/** Constructor, opens the scope.
+		\param name the subsystem name, should outlive the scope
+		*/
+		MemoryScope(const char * name);
+
+		/// Destructor, closes the scope.
+		~MemoryScope();
+	};
+
+}
+
+/// Charge the resources sized in the enclosing scope to a subsystem.
+# define SIBR_MEMORY_SCOPE(name) sibr::MemoryScope SIBR_CATMACRO(memoryScope, __COUNTER__)(name);
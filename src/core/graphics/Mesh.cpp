@@ -10,10 +10,19 @@
  */
 
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <memory>
 #include <map>
+#include <numeric>
 #include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <omp.h>
 
 #include <assimp/Importer.hpp> // C++ importer interface
 #include <assimp/scene.h> // Output data structure
@@ -22,7 +31,9 @@
 #include <assimp/Exporter.hpp>
 
 #include "core/system/ByteStream.hpp"
+#include "core/system/MappedFile.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/graphics/GLState.hpp"
 
 #include "boost/filesystem.hpp"
 #include "core/system/XMLTree.h"
@@ -244,6 +255,99 @@ namespace sibr
 	}
 
 
+	namespace {
+
+		/** Write a value in big endian order, the PLY binary byte order we use.
+		\param dst the destination
+		\param value the value
+		\return the position after the value
+		*/
+		inline uint8* putBigEndian(uint8* dst, uint8 value)
+		{
+			*dst = value;
+			return dst + 1;
+		}
+
+		inline uint8* putBigEndian(uint8* dst, uint16 value)
+		{
+			value = ByteStream::htons(value);
+			std::memcpy(dst, &value, sizeof(value));
+			return dst + sizeof(value);
+		}
+
+		inline uint8* putBigEndian(uint8* dst, uint32 value)
+		{
+			value = ByteStream::htonl(value);
+			std::memcpy(dst, &value, sizeof(value));
+			return dst + sizeof(value);
+		}
+
+		inline uint8* putBigEndian(uint8* dst, float value)
+		{
+			uint32 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return putBigEndian(dst, bits);
+		}
+
+		/// Vertices or faces formatted per task by the ASCII writer.
+		const int64_t kPLYChunk = 1 << 16;
+
+		/** Append printf-formatted text to a string. */
+		template<typename... Args>
+		void appendFormatted(std::string& out, const char* format, Args... args)
+		{
+			char buffer[128];
+			const int length = std::snprintf(buffer, sizeof(buffer), format, args...);
+			out.append(buffer, size_t(std::max(length, 0)));
+		}
+	}
+
+	std::string	Mesh::plyHeader(const char* format, bool universal, const std::string& textureName) const
+	{
+		std::ostringstream	header;
+		header << "ply" << std::endl;
+		header << "format " << format << " 1.0" << std::endl;
+		header << "comment Created by SIBR project" << std::endl;
+		if (hasTexCoords())
+		{
+			header << "comment TextureFile " << textureName << std::endl;
+		}
+		header << "element vertex " << _vertices.size() << std::endl;
+		header << "property float x" << std::endl;
+		header << "property float y" << std::endl;
+		header << "property float z" << std::endl;
+		if (hasColors())
+		{
+			if (universal)
+			{
+				header << "property uchar red" << std::endl;
+				header << "property uchar green" << std::endl;
+				header << "property uchar blue" << std::endl;
+			}
+			else
+			{
+				header << "property ushort red" << std::endl;
+				header << "property ushort green" << std::endl;
+				header << "property ushort blue" << std::endl;
+			}
+		}
+		if (hasNormals())
+		{
+			header << "property float nx" << std::endl;
+			header << "property float ny" << std::endl;
+			header << "property float nz" << std::endl;
+		}
+		if (hasTexCoords())
+		{
+			header << "property float texture_u" << std::endl;
+			header << "property float texture_v" << std::endl;
+		}
+		header << "element face " << _triangles.size() << std::endl;
+		header << "property list uchar uint vertex_indices" << std::endl;
+		header << "end_header" << std::endl;
+		return header.str();
+	}
+
 	bool		Mesh::saveToBinaryPLY(const std::string& filename, bool universal, const std::string& textureName)  const
 	{
 		assert(_vertices.size());
@@ -260,99 +364,66 @@ namespace sibr
 
 		if (file)
 		{
-			file << "ply" << std::endl;
-			file << "format binary_big_endian 1.0" << std::endl;
-			file << "comment Created by SIBR project" << std::endl;
-			if (hasTexCoords())
-			{
-				file << "comment TextureFile " << textureName << std::endl;
-			}
-			file << "element vertex " << _vertices.size() << std::endl;
-			file << "property float x" << std::endl;
-			file << "property float y" << std::endl;
-			file << "property float z" << std::endl;
-			if (hasColors())
-			{
-				if (universal)
-				{
-					file << "property uchar red" << std::endl;
-					file << "property uchar green" << std::endl;
-					file << "property uchar blue" << std::endl;
-				}
-				else
-				{
-					file << "property ushort red" << std::endl;
-					file << "property ushort green" << std::endl;
-					file << "property ushort blue" << std::endl;
-				}
-
-			}
-			if (hasNormals())
-			{
-				file << "property float nx" << std::endl;
-				file << "property float ny" << std::endl;
-				file << "property float nz" << std::endl;
-			}
-			if (hasTexCoords())
-			{
-				file << "property float texture_u" << std::endl;
-				file << "property float texture_v" << std::endl;
-			}
-
-			file << "element face " << _triangles.size() << std::endl;
-			file << "property list uchar uint vertex_indices" << std::endl;
-			file << "end_header" << std::endl;
-
-			/// BINARY version /////
-			ByteStream	bytes;
-
-			for (uint i = 0; i < _vertices.size(); ++i)
+			const std::string header = plyHeader("binary_big_endian", universal, textureName);
+			const bool withColors = hasColors();
+			const bool withNormals = hasNormals();
+			const bool withUVs = hasTexCoords();
+
+			// Fixed size records, serialized in parallel straight to their place in the file.
+			const size_t vertexSize = 3 * sizeof(float) + (withColors ? 3 * (universal ? sizeof(uint8) : sizeof(uint16)) : 0)
+				+ (withNormals ? 3 * sizeof(float) : 0) + (withUVs ? 2 * sizeof(float) : 0);
+			const size_t faceSize = sizeof(uint8) + 3 * sizeof(uint32);
+			const size_t facesStart = header.size() + vertexSize * _vertices.size();
+			std::vector<uint8> bytes(facesStart + faceSize * _triangles.size());
+			std::memcpy(bytes.data(), header.data(), header.size());
+
+			const int64_t verticesCount = int64_t(_vertices.size());
+#pragma omp parallel for
+			for (int64_t i = 0; i < verticesCount; ++i)
 			{
+				uint8* dst = bytes.data() + header.size() + size_t(i) * vertexSize;
 				const Vector3f& v = _vertices[i];
+				for (int k = 0; k < 3; ++k)
+					dst = putBigEndian(dst, float(v[k]));
 
-				bytes << float(v[0]) << float(v[1]) << float(v[2]);
-
-				if (hasColors())
+				if (withColors)
 				{
+					// ! converting colors explicitly
 					const Vector3f& c = _colors[i];
-					if (universal)
-						bytes
-						<< uint8(c[0] * (UINT8_MAX - 1))
-						<< uint8(c[1] * (UINT8_MAX - 1))
-						<< uint8(c[2] * (UINT8_MAX - 1)); // ! converting colors explicitly
-					else
-						bytes
-						<< uint16(c[0] * (UINT16_MAX - 1))
-						<< uint16(c[1] * (UINT16_MAX - 1))
-						<< uint16(c[2] * (UINT16_MAX - 1)); // ! converting colors explicitly
-				}
-
-				if (hasNormals())
+					for (int k = 0; k < 3; ++k)
+						dst = universal ? putBigEndian(dst, uint8(c[k] * (UINT8_MAX - 1))) : putBigEndian(dst, uint16(c[k] * (UINT16_MAX - 1)));
+				}
+				if (withNormals)
 				{
 					const Vector3f& n = _normals[i];
-
-					bytes << float(n[0]) << float(n[1]) << float(n[2]);
+					for (int k = 0; k < 3; ++k)
+						dst = putBigEndian(dst, float(n[k]));
 				}
-
-				if (hasTexCoords())
+				if (withUVs)
 				{
 					const Vector2f& uv = _texcoords[i];
-
-					bytes << float(uv[0]) << float(uv[1]);
+					dst = putBigEndian(dst, float(uv[0]));
+					dst = putBigEndian(dst, float(uv[1]));
 				}
 			}
 
-			for (uint i = 0; i < _triangles.size(); ++i)
+			const int64_t trianglesCount = int64_t(_triangles.size());
+#pragma omp parallel for
+			for (int64_t i = 0; i < trianglesCount; ++i)
 			{
+				uint8* dst = bytes.data() + facesStart + size_t(i) * faceSize;
 				const Vector3u& tri = _triangles[i];
-
-				bytes << uint8(3);
+				dst = putBigEndian(dst, uint8(3));
 				for (uint j = 0; j < 3; ++j)
-					bytes << uint32(tri[j]);
+					dst = putBigEndian(dst, uint32(tri[j]));
 			}
 
-			file.write(reinterpret_cast<const char*>(bytes.buffer()), bytes.bufferSize());
+			file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
 			file.close();
+			if (!file) {
+				SIBR_LOG << "error: cannot write to file '" << filename << "'." << std::endl;
+				return false;
+			}
 			SIBR_LOG << "Saving '" << filename << "'... done" << std::endl;
 			return true;
 		}
@@ -375,112 +446,792 @@ namespace sibr
 
 		if (file)
 		{
-			file << "ply" << std::endl;
-			file << "format ascii 1.0" << std::endl;
-			file << "comment Created by SIBR project" << std::endl;
-			if (hasTexCoords())
-			{
-				file << "comment TextureFile " << textureName << std::endl;
-			}
-			file << "element vertex " << _vertices.size() << std::endl;
-			file << "property float x" << std::endl;
-			file << "property float y" << std::endl;
-			file << "property float z" << std::endl;
+			file << plyHeader("ascii", universal, textureName);
 
-			if (hasColors())
+			/////// ASCII version /////
+			// Chunks of lines are formatted in parallel, then written in order.
+			const bool withColors = hasColors();
+			const bool withNormals = hasNormals();
+			const bool withUVs = hasTexCoords();
+			const int64_t verticesCount = int64_t(_vertices.size());
+			const int64_t trianglesCount = int64_t(_triangles.size());
+			const int64_t vertexChunks = (verticesCount + kPLYChunk - 1) / kPLYChunk;
+			const int64_t faceChunks = (trianglesCount + kPLYChunk - 1) / kPLYChunk;
+			std::vector<std::string> chunks(size_t(vertexChunks + faceChunks));
+
+#pragma omp parallel for schedule(dynamic)
+			for (int64_t chunk = 0; chunk < vertexChunks + faceChunks; ++chunk)
 			{
-				if (universal)
+				std::string& out = chunks[chunk];
+				if (chunk < vertexChunks)
 				{
-					file << "property uchar red" << std::endl;
-					file << "property uchar green" << std::endl;
-					file << "property uchar blue" << std::endl;
+					const int64_t last = std::min(verticesCount, (chunk + 1) * kPLYChunk);
+					for (int64_t i = chunk * kPLYChunk; i < last; ++i)
+					{
+						const Vector3f& v = _vertices[i];
+						appendFormatted(out, "%g %g %g ", v[0], v[1], v[2]);
+
+						if (withColors)
+						{
+							const Vector3f& c = _colors[i];
+							const float scale = universal ? float(UINT8_MAX - 1) : float(UINT16_MAX - 1);
+							appendFormatted(out, "%d %d %d ", int(c[0] * scale), int(c[1] * scale), int(c[2] * scale));
+						}
+						if (withNormals)
+						{
+							const Vector3f& n = _normals[i];
+							appendFormatted(out, "%g %g %g ", n[0], n[1], n[2]);
+						}
+						if (withUVs)
+						{
+							const Vector2f& uv = _texcoords[i];
+							appendFormatted(out, "%g %g ", uv[0], uv[1]);
+						}
+						out.push_back('\n');
+					}
 				}
 				else
 				{
-					file << "property ushort red" << std::endl;
-					file << "property ushort green" << std::endl;
-					file << "property ushort blue" << std::endl;
+					const int64_t first = (chunk - vertexChunks) * kPLYChunk;
+					const int64_t last = std::min(trianglesCount, first + kPLYChunk);
+					for (int64_t i = first; i < last; ++i)
+					{
+						const Vector3u& tri = _triangles[i];
+						appendFormatted(out, "3 %u %u %u\n", tri[0], tri[1], tri[2]);
+					}
 				}
 			}
-
-			if (hasNormals())
+			for (const std::string& chunk : chunks)
 			{
-				file << "property float nx" << std::endl;
-				file << "property float ny" << std::endl;
-				file << "property float nz" << std::endl;
+				file.write(chunk.data(), std::streamsize(chunk.size()));
 			}
+			return bool(file);
+		}
 
-			if (hasTexCoords())
-			{
-				file << "property float texture_u" << std::endl;
-				file << "property float texture_v" << std::endl;
+		SIBR_LOG << "error: cannot write to file '" << filename << "'." << std::endl;
+		return false;
+
+	}
+
+	namespace {
+
+		/// Scalar types of the PLY format.
+		enum class PlyType { INVALID, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+		PlyType plyType(const std::string & name)
+		{
+			if (name == "char" || name == "int8") return PlyType::INT8;
+			if (name == "uchar" || name == "uint8") return PlyType::UINT8;
+			if (name == "short" || name == "int16") return PlyType::INT16;
+			if (name == "ushort" || name == "uint16") return PlyType::UINT16;
+			if (name == "int" || name == "int32") return PlyType::INT32;
+			if (name == "uint" || name == "uint32") return PlyType::UINT32;
+			if (name == "float" || name == "float32") return PlyType::FLOAT32;
+			if (name == "double" || name == "float64") return PlyType::FLOAT64;
+			return PlyType::INVALID;
+		}
+
+		size_t plySize(PlyType type)
+		{
+			switch (type) {
+			case PlyType::INT8: case PlyType::UINT8: return 1;
+			case PlyType::INT16: case PlyType::UINT16: return 2;
+			case PlyType::INT32: case PlyType::UINT32: case PlyType::FLOAT32: return 4;
+			case PlyType::FLOAT64: return 8;
+			default: return 0;
 			}
+		}
 
-			file << "element face " << _triangles.size() << std::endl;
-			file << "property list uchar uint vertex_indices" << std::endl;
-			file << "end_header" << std::endl;
+		template<typename T>
+		T readRaw(const char * data, bool swap)
+		{
+			char bytes[sizeof(T)];
+			std::memcpy(bytes, data, sizeof(T));
+			if (swap) {
+				std::reverse(bytes, bytes + sizeof(T));
+			}
+			T value;
+			std::memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
 
-			/////// ASCII version /////
+		double readPly(const char * data, PlyType type, bool swap)
+		{
+			switch (type) {
+			case PlyType::INT8: return double(readRaw<int8_t>(data, swap));
+			case PlyType::UINT8: return double(readRaw<uint8_t>(data, swap));
+			case PlyType::INT16: return double(readRaw<int16_t>(data, swap));
+			case PlyType::UINT16: return double(readRaw<uint16_t>(data, swap));
+			case PlyType::INT32: return double(readRaw<int32_t>(data, swap));
+			case PlyType::UINT32: return double(readRaw<uint32_t>(data, swap));
+			case PlyType::FLOAT32: return double(readRaw<float>(data, swap));
+			case PlyType::FLOAT64: return readRaw<double>(data, swap);
+			default: return 0.0;
+			}
+		}
 
-			for (uint i = 0; i < _vertices.size(); ++i)
+		/// Element declared in a PLY header.
+		struct PlyElement
+		{
+			/// Scalar or list property.
+			struct Property
 			{
-				const Vector3f& v = _vertices[i];
+				std::string name;
+				PlyType type = PlyType::INVALID; ///< Type of the value, or of the list items.
+				PlyType countType = PlyType::INVALID; ///< Type of the list size, INVALID for scalars.
+				size_t offset = 0; ///< Offset in the element, for elements without lists.
+			};
+
+			std::string name;
+			size_t count = 0;
+			std::vector<Property> properties;
+			size_t stride = 0; ///< Size of an element, 0 if it contains lists.
+
+			/** \return the index of a property, or -1. */
+			int find(std::initializer_list<const char*> names) const
+			{
+				for (size_t pid = 0; pid < properties.size(); ++pid) {
+					for (const char * name : names) {
+						if (properties[pid].name == name) {
+							return int(pid);
+						}
+					}
+				}
+				return -1;
+			}
+		};
 
-				file << v[0] << " " << v[1] << " " << v[2] << " ";
+		/** Normalize a color component stored as an integer. */
+		float plyColor(double value, PlyType type)
+		{
+			if (type == PlyType::UINT8) return float(value / 255.0);
+			if (type == PlyType::UINT16) return float(value / 65535.0);
+			return float(value);
+		}
 
-				if (hasColors())
-				{
-					const Vector3f& c = _colors[i];
+		const char * skipSpaces(const char * p, const char * end)
+		{
+			while (p < end && (*p == ' ' || *p == '\t')) {
+				++p;
+			}
+			return p;
+		}
 
-					if (universal)
-					{
-						file << int(c[0] * (UINT8_MAX - 1)) << " "
-							<< int(c[1] * (UINT8_MAX - 1)) << " "
-							<< int(c[2] * (UINT8_MAX - 1)) << " ";
+		/** Parse a signed integer, return nullptr if there is none. */
+		const char * parseInt(const char * p, const char * end, int64_t & value)
+		{
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negative = *p == '-';
+				++p;
+			}
+			if (p >= end || *p < '0' || *p > '9') {
+				return nullptr;
+			}
+			value = 0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				value = value * 10 + (*p - '0');
+				++p;
+			}
+			value = negative ? -value : value;
+			return p;
+		}
+
+		/** Parse a decimal float, return nullptr if there is none. Neither locale dependent nor correctly rounded in the last bit. */
+		const char * parseFloat(const char * p, const char * end, float & value)
+		{
+			static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			p = skipSpaces(p, end);
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negative = *p == '-';
+				++p;
+			}
+			double mantissa = 0.0;
+			int exponent = 0;
+			bool digits = false;
+			while (p < end && *p >= '0' && *p <= '9') {
+				mantissa = mantissa * 10.0 + double(*p - '0');
+				digits = true;
+				++p;
+			}
+			if (p < end && *p == '.') {
+				++p;
+				while (p < end && *p >= '0' && *p <= '9') {
+					mantissa = mantissa * 10.0 + double(*p - '0');
+					--exponent;
+					digits = true;
+					++p;
+				}
+			}
+			if (!digits) {
+				return nullptr;
+			}
+			if (p < end && (*p == 'e' || *p == 'E')) {
+				int64_t e = 0;
+				const char * next = parseInt(p + 1, end, e);
+				if (next) {
+					exponent += int(e);
+					p = next;
+				}
+			}
+			const int absExponent = std::abs(exponent);
+			const double scale = absExponent <= 22 ? powers[absExponent] : std::pow(10.0, double(absExponent));
+			const double result = exponent < 0 ? mantissa / scale : mantissa * scale;
+			value = float(negative ? -result : result);
+			return p;
+		}
+
+		/// Bias of the relative OBJ indices, larger than any element count.
+		const int64_t objRelative = int64_t(1) << 40;
+
+		/// Content of a range of lines of an OBJ file.
+		struct ObjChunk
+		{
+			std::vector<Vector3f> positions;
+			std::vector<Vector3f> colors; ///< Optional "v x y z r g b" colors, one per position when present.
+			std::vector<Vector2f> uvs;
+			std::vector<Vector3f> normals;
+			/// Triangle corners (position, uv, normal). Positive values are 1-based file indices, 0 means absent,
+			/// relative indices are stored as their position from the start of the chunk minus objRelative.
+			std::vector<std::array<int64_t, 3>> corners;
+			std::string mtllib;
+		};
+
+		/** Parse the lines of an OBJ file between begin and end, which must be line boundaries. */
+		void parseObjChunk(const char * begin, const char * end, ObjChunk & chunk)
+		{
+			std::vector<std::array<int64_t, 3>> face;
+			const char * p = begin;
+			while (p < end) {
+				const char * lineEnd = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+				lineEnd = lineEnd ? lineEnd : end;
+				p = skipSpaces(p, lineEnd);
+
+				if (lineEnd - p > 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+					Vector3f v(0.0f, 0.0f, 0.0f), c;
+					const char * q = p + 1;
+					for (int k = 0; k < 3 && q; ++k) {
+						q = parseFloat(q, lineEnd, v[k]);
 					}
-					else
-					{
-						file << int(c[0] * (UINT16_MAX - 1)) << " "
-							<< int(c[1] * (UINT16_MAX - 1)) << " "
-							<< int(c[2] * (UINT16_MAX - 1)) << " ";
+					chunk.positions.push_back(v);
+					for (int k = 0; k < 3 && q; ++k) {
+						q = parseFloat(q, lineEnd, c[k]);
+					}
+					if (q) {
+						chunk.colors.resize(chunk.positions.size(), Vector3f(1.0f, 1.0f, 1.0f));
+						chunk.colors.back() = c;
 					}
 				}
+				else if (lineEnd - p > 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+					Vector2f uv(0.0f, 0.0f);
+					const char * q = p + 2;
+					for (int k = 0; k < 2 && q; ++k) {
+						q = parseFloat(q, lineEnd, uv[k]);
+					}
+					chunk.uvs.push_back(uv);
+				}
+				else if (lineEnd - p > 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+					Vector3f n(0.0f, 0.0f, 0.0f);
+					const char * q = p + 2;
+					for (int k = 0; k < 3 && q; ++k) {
+						q = parseFloat(q, lineEnd, n[k]);
+					}
+					chunk.normals.push_back(n);
+				}
+				else if (lineEnd - p > 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+					// Corners are v, v/vt, v//vn or v/vt/vn.
+					face.clear();
+					const char * q = skipSpaces(p + 1, lineEnd);
+					while (q && q < lineEnd && *q != '\r') {
+						std::array<int64_t, 3> corner = { 0, 0, 0 };
+						const int64_t counts[3] = { int64_t(chunk.positions.size()), int64_t(chunk.uvs.size()), int64_t(chunk.normals.size()) };
+						for (int k = 0; k < 3 && q; ++k) {
+							if (k > 0) {
+								if (q >= lineEnd || *q != '/') {
+									break;
+								}
+								++q;
+								if (q < lineEnd && *q == '/') {
+									continue;
+								}
+							}
+							int64_t index = 0;
+							q = parseInt(q, lineEnd, index);
+							// Relative indices are resolved once the number of elements before the chunk is known.
+							corner[k] = index < 0 ? counts[k] + index - objRelative : index;
+						}
+						if (!q) {
+							break;
+						}
+						face.push_back(corner);
+						q = skipSpaces(q, lineEnd);
+					}
+					// Fan triangulation, as aiProcess_Triangulate.
+					for (size_t k = 2; k < face.size(); ++k) {
+						chunk.corners.push_back(face[0]);
+						chunk.corners.push_back(face[k - 1]);
+						chunk.corners.push_back(face[k]);
+					}
+				}
+				else if (lineEnd - p > 7 && std::strncmp(p, "mtllib", 6) == 0 && chunk.mtllib.empty()) {
+					const char * q = skipSpaces(p + 6, lineEnd);
+					const char * nameEnd = lineEnd;
+					while (nameEnd > q && (nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) {
+						--nameEnd;
+					}
+					chunk.mtllib = std::string(q, nameEnd);
+				}
+				p = lineEnd + 1;
+			}
+		}
 
-				if (hasNormals())
-				{
-					const Vector3f& n = _normals[i];
-
-					file << n[0] << " " << n[1] << " " << n[2] << " ";
+		/** \return the diffuse texture of the first material of a MTL file, or an empty string. */
+		std::string objTexture(const std::string & mtlPath)
+		{
+			std::ifstream file(mtlPath);
+			std::string line;
+			while (std::getline(file, line)) {
+				std::istringstream tokens(line);
+				std::string key, name;
+				tokens >> key;
+				if (key == "map_Kd" && std::getline(tokens >> std::ws, name)) {
+					while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) {
+						name.pop_back();
+					}
+					return name;
 				}
+			}
+			return "";
+		}
+	}
 
-				if (hasTexCoords())
-				{
-					const Vector2f& uv = _texcoords[i];
+	bool	Mesh::loadBinaryPLY(const std::string& filename)
+	{
+		MappedFile file;
+		if (!file.open(filename) || file.size() < 4 || std::strncmp(file.data(), "ply", 3) != 0) {
+			return false;
+		}
+		const char * const end = file.data() + file.size();
+		const char * const headerEnd = std::search(file.data(), end, "end_header", "end_header" + 10);
+		if (headerEnd == end) {
+			return false;
+		}
+		const char * body = static_cast<const char*>(std::memchr(headerEnd, '\n', size_t(end - headerEnd)));
+		if (!body) {
+			return false;
+		}
+		++body;
+
+		// Parse the header.
+		bool littleEndian = true;
+		bool binary = false;
+		std::string texture;
+		std::vector<PlyElement> elements;
+		std::istringstream header(std::string(file.data(), headerEnd));
+		std::string line;
+		while (std::getline(header, line)) {
+			std::istringstream tokens(line);
+			std::string key;
+			tokens >> key;
+			if (key == "format") {
+				std::string format;
+				tokens >> format;
+				binary = format == "binary_little_endian" || format == "binary_big_endian";
+				littleEndian = format == "binary_little_endian";
+			}
+			else if (key == "comment") {
+				std::string tag;
+				tokens >> tag;
+				if (tag == "TextureFile") {
+					tokens >> texture;
+				}
+			}
+			else if (key == "element") {
+				elements.emplace_back();
+				tokens >> elements.back().name >> elements.back().count;
+			}
+			else if (key == "property" && !elements.empty()) {
+				PlyElement::Property property;
+				std::string type;
+				tokens >> type;
+				if (type == "list") {
+					std::string countType;
+					tokens >> countType >> type;
+					property.countType = plyType(countType);
+					if (property.countType == PlyType::INVALID) {
+						return false;
+					}
+				}
+				property.type = plyType(type);
+				tokens >> property.name;
+				if (property.type == PlyType::INVALID) {
+					return false;
+				}
+				elements.back().properties.push_back(property);
+			}
+		}
+		// ASCII files are left to Assimp.
+		if (!binary) {
+			return false;
+		}
+		for (PlyElement & element : elements) {
+			size_t offset = 0;
+			for (PlyElement::Property & property : element.properties) {
+				if (property.countType != PlyType::INVALID) {
+					offset = 0;
+					break;
+				}
+				property.offset = offset;
+				offset += plySize(property.type);
+			}
+			element.stride = offset;
+		}
 
-					file << uv[0] << " " << uv[1] << " ";
+		const uint16_t one = 1;
+		const bool swap = littleEndian != (*reinterpret_cast<const uint8_t*>(&one) == 1);
+
+		Vertices vertices;
+		Normals normals;
+		Colors colors;
+		UVs texcoords;
+		Triangles triangles;
+		size_t discarded = 0;
+
+		for (const PlyElement & element : elements) {
+			if (element.name == "vertex") {
+				const int x = element.find({ "x" }), y = element.find({ "y" }), z = element.find({ "z" });
+				if (element.stride == 0 || x < 0 || y < 0 || z < 0 || size_t(end - body) / element.stride < element.count) {
+					return false;
+				}
+				const int nx = element.find({ "nx" }), ny = element.find({ "ny" }), nz = element.find({ "nz" });
+				const int r = element.find({ "red", "r" }), g = element.find({ "green", "g" }), b = element.find({ "blue", "b" });
+				const int u = element.find({ "texture_u", "u", "s" }), v = element.find({ "texture_v", "v", "t" });
+				const bool hasNormals = nx >= 0 && ny >= 0 && nz >= 0;
+				const bool hasColors = r >= 0 && g >= 0 && b >= 0;
+				const bool hasUVs = u >= 0 && v >= 0;
+				const auto & props = element.properties;
+
+				vertices.resize(element.count);
+				normals.resize(hasNormals ? element.count : 0);
+				colors.resize(hasColors ? element.count : 0);
+				texcoords.resize(hasUVs ? element.count : 0);
+				const auto read = [&](const char * vertex, int pid) {
+					return readPly(vertex + props[pid].offset, props[pid].type, swap);
+				};
+				const int64_t count = int64_t(element.count);
+#pragma omp parallel for
+				for (int64_t vid = 0; vid < count; ++vid) {
+					const char * vertex = body + size_t(vid) * element.stride;
+					vertices[vid] = Vector3f(float(read(vertex, x)), float(read(vertex, y)), float(read(vertex, z)));
+					if (hasNormals) {
+						normals[vid] = Vector3f(float(read(vertex, nx)), float(read(vertex, ny)), float(read(vertex, nz)));
+					}
+					if (hasColors) {
+						colors[vid] = Vector3f(plyColor(read(vertex, r), props[r].type), plyColor(read(vertex, g), props[g].type), plyColor(read(vertex, b), props[b].type));
+					}
+					if (hasUVs) {
+						texcoords[vid] = Vector2f(float(read(vertex, u)), float(read(vertex, v)));
+					}
+				}
+				body += element.count * element.stride;
+			}
+			else if (element.name == "face") {
+				const int indices = element.find({ "vertex_indices", "vertex_index" });
+				if (indices < 0 || element.properties[indices].countType == PlyType::INVALID) {
+					return false;
+				}
+				const PlyElement::Property & list = element.properties[indices];
+				const size_t countSize = plySize(list.countType);
+				const size_t indexSize = plySize(list.type);
+				const uint32_t numVertices = uint32_t(vertices.size());
+				const auto addTriangle = [&](const Vector3u & tri) {
+					// Degenerate faces and invalid ids are dropped, as with aiProcess_FindDegenerates.
+					if (tri[0] >= numVertices || tri[1] >= numVertices || tri[2] >= numVertices
+						|| tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+						++discarded;
+					}
+					else {
+						triangles.push_back(tri);
+					}
+				};
+
+				// Common case, only triangles: fixed size faces, read in parallel.
+				const size_t triangleStride = countSize + 3 * indexSize;
+				bool onlyTriangles = element.properties.size() == 1 && size_t(end - body) / triangleStride >= element.count;
+				const int64_t count = int64_t(element.count);
+				if (onlyTriangles) {
+					int mismatch = 0;
+#pragma omp parallel for reduction(+:mismatch)
+					for (int64_t fid = 0; fid < count; ++fid) {
+						mismatch += readPly(body + size_t(fid) * triangleStride, list.countType, swap) != 3.0 ? 1 : 0;
+					}
+					onlyTriangles = mismatch == 0;
+				}
+				if (onlyTriangles) {
+					Triangles faces(element.count);
+#pragma omp parallel for
+					for (int64_t fid = 0; fid < count; ++fid) {
+						const char * face = body + size_t(fid) * triangleStride + countSize;
+						faces[fid] = Vector3u(uint(readPly(face, list.type, swap)), uint(readPly(face + indexSize, list.type, swap)), uint(readPly(face + 2 * indexSize, list.type, swap)));
+					}
+					triangles.reserve(faces.size());
+					for (const Vector3u & tri : faces) {
+						addTriangle(tri);
+					}
+					body += element.count * triangleStride;
 				}
+				else {
+					std::vector<uint> polygon;
+					for (size_t fid = 0; fid < element.count; ++fid) {
+						for (size_t pid = 0; pid < element.properties.size(); ++pid) {
+							const PlyElement::Property & property = element.properties[pid];
+							size_t items = 1;
+							if (property.countType != PlyType::INVALID) {
+								if (body + plySize(property.countType) > end) {
+									return false;
+								}
+								items = size_t(readPly(body, property.countType, swap));
+								body += plySize(property.countType);
+							}
+							if (size_t(end - body) / plySize(property.type) < items) {
+								return false;
+							}
+							if (int(pid) == indices) {
+								polygon.resize(items);
+								for (size_t k = 0; k < items; ++k) {
+									polygon[k] = uint(readPly(body + k * indexSize, list.type, swap));
+								}
+								for (size_t k = 2; k < items; ++k) {
+									addTriangle(Vector3u(polygon[0], polygon[k - 1], polygon[k]));
+								}
+							}
+							body += items * plySize(property.type);
+						}
+					}
+				}
+			}
+			else if (element.stride > 0 && size_t(end - body) / element.stride >= element.count) {
+				// Unused element of fixed size.
+				body += element.count * element.stride;
+			}
+			else {
+				return false;
+			}
+		}
+		if (vertices.empty()) {
+			return false;
+		}
+		if (discarded > 0) {
+			SIBR_WRG << "Discarded " << discarded << " degenerate or invalid faces from '" << filename << "'." << std::endl;
+		}
+
+		_vertices.swap(vertices);
+		_normals.swap(normals);
+		_colors.swap(colors);
+		_texcoords.swap(texcoords);
+		_triangles.swap(triangles);
+		invalidateTopology();
+		_textureImageFileName = texture;
+		return true;
+	}
+
+	bool	Mesh::loadOBJ(const std::string& filename)
+	{
+		MappedFile file;
+		if (!file.open(filename) || file.size() == 0) {
+			return false;
+		}
+		const char * const begin = file.data();
+		const char * const end = begin + file.size();
+
+		// Split the file in chunks of whole lines.
+		const size_t numChunks = size_t(std::max(1, omp_get_max_threads())) * 4;
+		std::vector<const char*> bounds(numChunks + 1, end);
+		bounds[0] = begin;
+		for (size_t cid = 1; cid < numChunks; ++cid) {
+			const char * start = std::max(bounds[cid - 1], begin + file.size() * cid / numChunks);
+			const char * lineEnd = start < end ? static_cast<const char*>(std::memchr(start, '\n', size_t(end - start))) : nullptr;
+			bounds[cid] = lineEnd ? lineEnd + 1 : end;
+		}
 
-				file << std::endl;
+		std::vector<ObjChunk> chunks(numChunks);
+#pragma omp parallel for schedule(dynamic)
+		for (int cid = 0; cid < int(numChunks); ++cid) {
+			parseObjChunk(bounds[cid], bounds[cid + 1], chunks[cid]);
+		}
+
+		// Offsets of the elements of each chunk in the whole file.
+		std::vector<std::array<int64_t, 3>> offsets(numChunks);
+		std::array<int64_t, 3> totals = { 0, 0, 0 };
+		size_t numCorners = 0;
+		size_t numColored = 0;
+		std::string mtllib;
+		for (size_t cid = 0; cid < numChunks; ++cid) {
+			offsets[cid] = totals;
+			totals[0] += int64_t(chunks[cid].positions.size());
+			totals[1] += int64_t(chunks[cid].uvs.size());
+			totals[2] += int64_t(chunks[cid].normals.size());
+			numCorners += chunks[cid].corners.size();
+			numColored += chunks[cid].colors.size();
+			if (mtllib.empty()) {
+				mtllib = chunks[cid].mtllib;
 			}
+		}
+		if (totals[0] == 0) {
+			return false;
+		}
 
-			for (uint i = 0; i < _triangles.size(); ++i)
-			{
-				const Vector3u& tri = _triangles[i];
+		Vertices positions;
+		Colors positionColors;
+		UVs uvs;
+		Normals normalsIn;
+		positions.reserve(size_t(totals[0]));
+		uvs.reserve(size_t(totals[1]));
+		normalsIn.reserve(size_t(totals[2]));
+		// Colors are only kept if every position has one.
+		const bool hasColors = numColored == size_t(totals[0]);
+		std::vector<std::array<int64_t, 3>> corners(numCorners);
+		size_t cornerOffset = 0;
+		for (size_t cid = 0; cid < numChunks; ++cid) {
+			ObjChunk & chunk = chunks[cid];
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			normalsIn.insert(normalsIn.end(), chunk.normals.begin(), chunk.normals.end());
+			if (hasColors) {
+				positionColors.insert(positionColors.end(), chunk.colors.begin(), chunk.colors.end());
+			}
+			// Resolve the indices to 0-based global ones, -1 when absent or invalid.
+			const int64_t cornersCount = int64_t(chunk.corners.size());
+#pragma omp parallel for
+			for (int64_t k = 0; k < cornersCount; ++k) {
+				for (int a = 0; a < 3; ++a) {
+					const int64_t index = chunk.corners[k][a];
+					const int64_t global = index > 0 ? index - 1 : (index < 0 ? offsets[cid][a] + index + objRelative : -1);
+					corners[cornerOffset + size_t(k)][a] = global < totals[a] && global >= 0 ? global : -1;
+				}
+			}
+			cornerOffset += chunk.corners.size();
+			std::vector<std::array<int64_t, 3>>().swap(chunk.corners);
+		}
+		chunks.clear();
 
-				file << 3;
-				for (uint j = 0; j < 3; ++j)
-					file << " " << tri[j];
-				file << std::endl;
+		// Share the vertices whose position, uv and normal are identical, as aiProcess_JoinIdenticalVertices.
+		bool useUVs = !uvs.empty(), useNormals = !normalsIn.empty();
+		for (const auto & corner : corners) {
+			useUVs = useUVs && corner[1] >= 0;
+			useNormals = useNormals && corner[2] >= 0;
+		}
+		bool direct = true;
+		for (const auto & corner : corners) {
+			direct = direct && corner[0] >= 0 && (!useUVs || corner[1] == corner[0]) && (!useNormals || corner[2] == corner[0]);
+		}
+
+		Vertices vertices;
+		Normals normals;
+		Colors colors;
+		UVs texcoords;
+		Triangles triangles;
+		std::vector<uint> indices(corners.size());
+		if (direct) {
+			// Same indices for every attribute (or positions only): the OBJ arrays are used as they are.
+			vertices.swap(positions);
+			colors.swap(positionColors);
+			if (useUVs) {
+				uvs.resize(vertices.size(), Vector2f(0.0f, 0.0f));
+				texcoords.swap(uvs);
+			}
+			if (useNormals) {
+				normalsIn.resize(vertices.size(), Vector3f(0.0f, 0.0f, 0.0f));
+				normals.swap(normalsIn);
+			}
+			for (size_t k = 0; k < corners.size(); ++k) {
+				indices[k] = uint(corners[k][0]);
+			}
+		}
+		else {
+			struct CornerHash {
+				size_t operator()(const std::array<int64_t, 3> & c) const {
+					return std::hash<int64_t>()(c[0]) ^ (std::hash<int64_t>()(c[1]) * 31) ^ (std::hash<int64_t>()(c[2]) * 131);
+				}
+			};
+			std::unordered_map<std::array<int64_t, 3>, uint, CornerHash> shared;
+			shared.reserve(size_t(totals[0]));
+			for (size_t k = 0; k < corners.size(); ++k) {
+				std::array<int64_t, 3> key = { corners[k][0], useUVs ? corners[k][1] : -1, useNormals ? corners[k][2] : -1 };
+				if (key[0] < 0) {
+					indices[k] = uint(-1);
+					continue;
+				}
+				const auto inserted = shared.emplace(key, uint(vertices.size()));
+				if (inserted.second) {
+					vertices.push_back(positions[size_t(key[0])]);
+					if (hasColors) {
+						colors.push_back(positionColors[size_t(key[0])]);
+					}
+					if (useUVs) {
+						texcoords.push_back(uvs[size_t(key[1])]);
+					}
+					if (useNormals) {
+						normals.push_back(normalsIn[size_t(key[2])]);
+					}
+				}
+				indices[k] = inserted.first->second;
 			}
+		}
 
-			file.close();
-			SIBR_LOG << "'" << filename << "' saved." << std::endl;
-			return true;
+		size_t discarded = 0;
+		triangles.reserve(indices.size() / 3);
+		for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+			const Vector3u tri(indices[k], indices[k + 1], indices[k + 2]);
+			if (tri[0] >= vertices.size() || tri[1] >= vertices.size() || tri[2] >= vertices.size()
+				|| tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+				++discarded;
+			}
+			else {
+				triangles.push_back(tri);
+			}
+		}
+		if (discarded > 0) {
+			SIBR_WRG << "Discarded " << discarded << " degenerate or invalid faces from '" << filename << "'." << std::endl;
 		}
-		SIBR_LOG << "error: cannot write to file '" << filename << "'." << std::endl;
-		return false;
 
+		_vertices.swap(vertices);
+		_normals.swap(normals);
+		_colors.swap(colors);
+		_texcoords.swap(texcoords);
+		_triangles.swap(triangles);
+		invalidateTopology();
+		_textureImageFileName = mtllib.empty() ? "" : objTexture(parentDirectory(filename) + "/" + mtllib);
+		return true;
 	}
+
+	void	Mesh::colorsFromTexture(const std::string& dataset_path, size_t first, size_t count)
+	{
+		// TODO: make a clean function
+		std::string texFileName = dataset_path + "/capreal/" + _textureImageFileName;
+		if( !fileExists(texFileName))
+			texFileName = parentDirectory(parentDirectory(dataset_path)) + "/capreal/" + _textureImageFileName;
+		if( !fileExists(texFileName))
+			texFileName = parentDirectory(dataset_path) + "/capreal/" + _textureImageFileName;
+
+		if (fileExists(texFileName)) {
+			// Sample the texture
+			sibr::ImageRGB texImg;
+			texImg.load(texFileName);
+			std::cout << "Computing vertex colors ..";
+			_colors.resize(first + count);
+			for (size_t ci = first; ci < first + count; ++ci)
+			{
+				Vector2f uv = _texcoords[ci];
+				Vector3ub col = texImg((uv[0]*texImg.w()), uint((1-uv[1])*texImg.h()));
+				_colors[ci] = Vector3f(float(col[0]) / 255.0, float(col[1]) / 255.0, float(col[2]) / 255.0);
+			}
+			SIBR_WRG << "Done." << std::endl;
+		}
+	}
+
 	bool	Mesh::load(const std::string& filename, const std::string& dataset_path )
 	{
 		// Does the file exists?
@@ -488,6 +1239,25 @@ namespace sibr
 			SIBR_LOG << "Error: can't load mesh '" << filename << "." << std::endl;
 			return false;
 		}
+
+		// Binary PLY and OBJ files, the formats of the large proxies, are read directly. Assimp handles the others.
+		std::string extension = sibr::getExtension(filename);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if ((extension == "ply" && loadBinaryPLY(filename)) || (extension == "obj" && loadOBJ(filename))) {
+			if (hasTexCoords() && !hasColors()) {
+				colorsFromTexture(dataset_path, 0, _vertices.size());
+			}
+			SIBR_LOG << "Mesh contains: colors: " << hasColors()
+				<< ", normals: " << hasNormals()
+				<< ", texcoords: " << hasTexCoords() << std::endl;
+			_meshPath = filename;
+			SIBR_LOG << "Mesh '" << filename << " successfully loaded with "
+				<< " (" << _triangles.size() << ") faces and "
+				<< " (" << _vertices.size() << ") vertices detected." << std::endl;
+			_gl.dirtyBufferGL = true;
+			return true;
+		}
+
 		Assimp::Importer	importer;
 		//importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true); // cause Assimp to remove all degenerated faces as soon as they are detected
 		const aiScene* scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FindDegenerates);
@@ -520,6 +1290,7 @@ namespace sibr
 
 		auto convertVec = [](const aiVector3D& v) { return Vector3f(v.x, v.y, v.z); };
 		_triangles.clear();
+		invalidateTopology();
 
 		uint offsetVertices = 0;
 		uint offsetFaces = 0;
@@ -565,26 +1336,8 @@ namespace sibr
 				_texcoords.resize(offsetVertices + mesh->mNumVertices);
 				for (uint i = 0; i < mesh->mNumVertices; ++i)
 					_texcoords[offsetVertices + i] = convertVec(mesh->mTextureCoords[0][i]).xy();
-				// TODO: make a clean function
-				std::string texFileName = dataset_path + "/capreal/" + _textureImageFileName;
-				if( !fileExists(texFileName))
-					texFileName = parentDirectory(parentDirectory(dataset_path)) + "/capreal/" + _textureImageFileName;
-				if( !fileExists(texFileName))
-					texFileName = parentDirectory(dataset_path) + "/capreal/" + _textureImageFileName;
-
-				if (!mesh->HasVertexColors(0) && fileExists(texFileName)) {
-					// Sample the texture
-					sibr::ImageRGB texImg;
-					texImg.load(texFileName);
-					std::cout << "Computing vertex colors ..";
-					_colors.resize(offsetVertices + mesh->mNumVertices);
-					for (uint ci = 0; ci < mesh->mNumVertices; ++ci)
-					{
-						Vector2f uv = _texcoords[offsetVertices + ci];
-						Vector3ub col = texImg((uv[0]*texImg.w()), uint((1-uv[1])*texImg.h()));
-						_colors[offsetVertices + ci] = Vector3f(float(col[0]) / 255.0, float(col[1]) / 255.0, float(col[2]) / 255.0);
-					}
-					SIBR_WRG << "Done." << std::endl;
+				if (!mesh->HasVertexColors(0)) {
+					colorsFromTexture(dataset_path, offsetVertices, mesh->mNumVertices);
 				}
 			}
 			if (meshId == 0) {
@@ -648,6 +1401,7 @@ namespace sibr
 
 		ReadPoints3DBinary(fname, verts, cols, numverts);
 		_triangles.clear();
+		invalidateTopology();
 
 		uint matId = 0;
 
@@ -853,6 +1607,10 @@ namespace sibr
 	void	Mesh::vertices(const std::vector<float>& vertices)
 	{
 		_gl.dirtyBufferGL = true;
+		invalidateGeometry();
+		if (vertices.size() != 3 * _vertices.size()) {
+			invalidateTopology();
+		}
 		_vertices.clear();
 
 		// iterator for values
@@ -873,6 +1631,7 @@ namespace sibr
 	void	Mesh::triangles(const std::vector<uint>& triangles)
 	{
 		_gl.dirtyBufferGL = true;
+		invalidateTopology();
 		_triangles.clear();
 
 		// iterator for values
@@ -930,137 +1689,156 @@ namespace sibr
 		}
 	}
 
-	void	Mesh::generateNormals(void)
-	{
+	namespace {
 
-		// will store a list of normals (of all triangles around each vertex)
-		std::vector<std::vector<Vector3f>>	vertexNormals(_vertices.size());
+		/** Vertex to triangle corners adjacency, in compressed rows: the corners of the vertices of
+		 group g are corners[offsets[g]] to corners[offsets[g+1]-1], in triangle order. A corner is
+		 3 * triangle index + index of the vertex in the triangle.
+		 \sa MeshTopology
+		*/
+		struct CornerAdjacency
+		{
+			const std::vector<uint>& offsets; ///< Offsets of each group.
+			const std::vector<uint>& corners; ///< Corners of all groups.
+		};
 
-		auto normalizeNormal = [](const Vector3f& normal) -> Vector3f {
+		Vector3f normalizeNormal(const Vector3f& normal)
+		{
 			float len = normal.norm();
 			if (len > std::numeric_limits<float>::epsilon())
 				return normal / len;
 			//else // may happen on tiny sharp edge, in this case points up
 			return Vector3f(0.f, 1.f, 0.f);
-		};
+		}
 
-		int i = 0;
-		for (const Vector3u& tri : _triangles)
+		/** Stop on the first triangle referencing a missing vertex. */
+		void checkIndices(const Mesh::Triangles& triangles, size_t vertexCount)
 		{
-			i++;
-			if (tri[0] > _vertices.size() || tri[1] > _vertices.size() ||
-				tri[2] > _vertices.size()) {
-				SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
+			for (size_t i = 0; i < triangles.size(); ++i) {
+				const Vector3u& tri = triangles[i];
+				if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount) {
+					SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
+				}
 			}
-			else {
-				Vector3f u = _vertices[tri[0]] - _vertices[tri[2]];
-				Vector3f v = _vertices[tri[0]] - _vertices[tri[1]];
-				Vector3f normal = normalizeNormal(u.cross(v));
+		}
 
-				vertexNormals[tri[0]].push_back(normal);
-				vertexNormals[tri[1]].push_back(normal);
-				vertexNormals[tri[2]].push_back(normal);
+		/** Area weighted triangle normals. */
+		Mesh::Normals triangleNormals(const Mesh::Vertices& vertices, const Mesh::Triangles& triangles)
+		{
+			Mesh::Normals normals(triangles.size());
+			const int64_t count = int64_t(triangles.size());
+#pragma omp parallel for
+			for (int64_t i = 0; i < count; ++i) {
+				const Vector3u& tri = triangles[i];
+				Vector3f u = vertices[tri[1]] - vertices[tri[0]];
+				Vector3f v = vertices[tri[2]] - vertices[tri[0]];
+				normals[i] = u.cross(v);
 			}
+			return normals;
 		}
 
-		_normals.resize(vertexNormals.size());
-		for (uint i = 0; i < _normals.size(); ++i)
+		/** Smoothing iterations: each group gathers the normals of the other two corners of each of its corners.
+		\param triangles the mesh triangles
+		\param groups the group of each vertex
+		\param adjacency the corners of each group
+		\param normals the normal of each group, updated
+		\param numIter iteration count
+		\param rescale bring the normals in [0,1] between iterations, to avoid overflows
+		*/
+		void smoothNormals(const Mesh::Triangles& triangles, const std::vector<uint>& groups, const CornerAdjacency& adjacency,
+			Mesh::Normals& normals, int numIter, bool rescale)
 		{
-			Vector3f n = std::accumulate(vertexNormals[i].begin(), vertexNormals[i].end(), Vector3f(0.f, 0.f, 0.f));
-			n = (n / (float)vertexNormals.size());
-			n = normalizeNormal(n);
-			_normals[i] = -n;
-		}
+			Mesh::Normals next(normals.size());
+			const int64_t count = int64_t(normals.size());
+			for (int it = 0; it < numIter; it++) {
+				float maxLength = 0.0f;
+#pragma omp parallel for reduction(max:maxLength)
+				for (int64_t g = 0; g < count; ++g) {
+					Vector3f n(0.f, 0.f, 0.f);
+					for (uint c = adjacency.offsets[g]; c < adjacency.offsets[g + 1]; ++c) {
+						const uint corner = adjacency.corners[c];
+						const Vector3u& tri = triangles[corner / 3];
+						const uint k = corner % 3;
+						n += normals[groups[tri[(k + 2) % 3]]];
+						n += normals[groups[tri[(k + 1) % 3]]];
+					}
+					next[g] = n;
+					maxLength = std::max(maxLength, n.norm());
+				}
+				normals.swap(next);
 
-		_gl.dirtyBufferGL = true;
+				// To avoid float overflow after multiple iterations, we need to normalize.
+				// But we can't just normalize each normal separately because we want to
+				// preserve the relative triangle area weighting.
+				// So instead we just send everything in [0,1] each time apart from the last iteration.
+				if (rescale && maxLength > 0.0f && (it + 1 < numIter)) {
+#pragma omp parallel for
+					for (int64_t g = 0; g < count; ++g) {
+						normals[g] /= maxLength;
+					}
+				}
+			}
+		}
 	}
 
-	void	Mesh::generateSmoothNormals(int numIter)
+	const MeshTopology&	Mesh::topology(void) const
 	{
-		SIBR_LOG << "Generate vertex normals..." << std::endl;
-		// will store a list of normals (of all triangles around each vertex)
-		std::vector<std::vector<Vector3f>>	vertexNormals(_vertices.size());
-
-		auto normalizeNormal = [](const Vector3f& normal) -> Vector3f {
-			float len = normal.norm();
-			if (len > std::numeric_limits<float>::epsilon())
-				return normal / len;
-			//else // may happen on tiny sharp edge, in this case points up
-			return Vector3f(0.f, 1.f, 0.f);
-		};
-
+		// Also catch direct edits of the vertices and triangles that changed the counts.
+		if (!_topology || _topology->vertexCount() != _vertices.size() || _topology->faceCount() != _triangles.size()) {
+			checkIndices(_triangles, _vertices.size());
+			_topology.reset(new MeshTopology(_triangles, _vertices.size()));
+		}
+		return *_topology;
+	}
 
-		for (int i = 0; i < _triangles.size(); i++)
-		{
-			const Vector3u& tri = _triangles[i];
-			if (tri[0] > _vertices.size() || tri[1] > _vertices.size() ||
-				tri[2] > _vertices.size()) {
-				SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
-			}
-			else {
-				Vector3f u = _vertices[tri[1]] - _vertices[tri[0]];
-				Vector3f v = _vertices[tri[2]] - _vertices[tri[0]];
-				Vector3f normal = u.cross(v);
+	void	Mesh::generateNormals(void)
+	{
+		const MeshTopology& topo = topology();
+		const Normals faceNormals = triangleNormals(_vertices, _triangles);
+		const CornerAdjacency adjacency = { topo.vertexCornerOffsets(), topo.vertexCorners() };
 
-				vertexNormals[tri[0]].push_back(normal);
-				vertexNormals[tri[1]].push_back(normal);
-				vertexNormals[tri[2]].push_back(normal);
+		// Average of the unit normals of the triangles around each vertex, in the opposite winding.
+		_normals.resize(_vertices.size());
+		const int64_t count = int64_t(_vertices.size());
+#pragma omp parallel for
+		for (int64_t i = 0; i < count; ++i) {
+			Vector3f n(0.f, 0.f, 0.f);
+			for (uint c = adjacency.offsets[i]; c < adjacency.offsets[i + 1]; ++c) {
+				n += normalizeNormal(-faceNormals[adjacency.corners[c] / 3]);
 			}
+			_normals[i] = -normalizeNormal(n);
 		}
 
-		_normals.resize(vertexNormals.size());
-		//#pragma omp parallel for
-		for (int i = 0; i < _normals.size(); ++i)
-		{
-			Vector3f n = std::accumulate(vertexNormals[i].begin(), vertexNormals[i].end(), Vector3f(0.f, 0.f, 0.f));
-			if (numIter == 0)//no iteration
-				n = normalizeNormal(n);
+		_gl.dirtyBufferGL = true;
+	}
+
+	void	Mesh::generateSmoothNormals(int numIter)
+	{
+		SIBR_LOG << "Generate vertex normals..." << std::endl;
+		const MeshTopology& topo = topology();
+		const Normals faceNormals = triangleNormals(_vertices, _triangles);
+		std::vector<uint> identity(_vertices.size());
+		std::iota(identity.begin(), identity.end(), 0u);
+		const CornerAdjacency adjacency = { topo.vertexCornerOffsets(), topo.vertexCorners() };
+
+		// Area weighted sum of the normals of the triangles around each vertex.
+		_normals.resize(_vertices.size());
+		const int64_t count = int64_t(_vertices.size());
+#pragma omp parallel for
+		for (int64_t i = 0; i < count; ++i) {
+			Vector3f n(0.f, 0.f, 0.f);
+			for (uint c = adjacency.offsets[i]; c < adjacency.offsets[i + 1]; ++c) {
+				n += faceNormals[adjacency.corners[c] / 3];
+			}
 			_normals[i] = n;
 		}
 
 		//Here we computed normals based on surrounding triangles
+		smoothNormals(_triangles, identity, adjacency, _normals, numIter, true);
 
-		for (int it = 0; it < numIter; it++) {
-
-			std::vector<std::vector<Vector3f>>	vertexNormalsIter(_vertices.size());
-
-			for (int i = 0; i < _triangles.size(); i++)
-			{
-				const Vector3u& tri = _triangles[i];
-				if (tri[0] > _vertices.size() || tri[1] > _vertices.size() ||
-					tri[2] > _vertices.size()) {
-					SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
-				}
-				else {
-					for (int tId = 0; tId < 3; tId++) {
-						Vector3f normal = _normals[tri[tId]];
-						vertexNormalsIter[tri[(tId + 1) % 3]].push_back(normal);
-						vertexNormalsIter[tri[(tId + 2) % 3]].push_back(normal);
-					}
-				}
-			}
-
-			float maxLength = 0.0f;
-			for (int i = 0; i < _normals.size(); ++i)
-			{
-				Vector3f n = std::accumulate(vertexNormalsIter[i].begin(), vertexNormalsIter[i].end(), Vector3f(0.f, 0.f, 0.f));
-				if (it + 1 == numIter)//last iteration
-					n = normalizeNormal(n);
-				_normals[i] = n;
-				maxLength = std::max(maxLength, _normals[i].norm());
-			}
-
-			// To avoid float overflow after multiple iterations, we need to normalize.
-			// But we can't just normalize each normal separately because we want to
-			// preserve the relative triangle area weighting.
-			// So instead we just send everything in [0,1] each time apart from the last iteration.
-			if (maxLength > 0.0f && (it + 1 < numIter)) {
-				for (int i = 0; i < _normals.size(); ++i)
-				{
-					_normals[i] /= maxLength;
-				}
-			}
-
+#pragma omp parallel for
+		for (int64_t i = 0; i < count; ++i) {
+			_normals[i] = normalizeNormal(_normals[i]);
 		}
 
 		_gl.dirtyBufferGL = true;
@@ -1069,122 +1847,55 @@ namespace sibr
 	void	Mesh::generateSmoothNormalsDisconnected(int numIter)
 	{
 		SIBR_LOG << "Generate vertex normals..." << std::endl;
-		// will store a list of normals (of all triangles around each vertex)
-		std::vector<std::vector<Vector3f>>	vertexNormals(_vertices.size());
-
-		auto normalizeNormal = [](const Vector3f& normal) -> Vector3f {
-			float len = normal.norm();
-			if (len > std::numeric_limits<float>::epsilon())
-				return normal / len;
-			//else // may happen on tiny sharp edge, in this case points up
-			return Vector3f(0.f, 1.f, 0.f);
-		};
+		checkIndices(_triangles, _vertices.size());
 
-		std::vector<std::pair<sibr::Vector3f, int>> vertCopy;
-		for (int i = 0; i < _vertices.size(); ++i)
+		// Vertices duplicated because of texture coordinates are merged in groups,
+		// each group is identified by its first vertex in position order.
+		std::vector<std::pair<sibr::Vector3f, int>> vertCopy(_vertices.size());
+		for (int i = 0; i < int(_vertices.size()); ++i)
 		{
-			vertCopy.push_back(std::make_pair(_vertices[i], i));
+			vertCopy[i] = std::make_pair(_vertices[i], i);
 		}
-
 		std::sort(vertCopy.begin(), vertCopy.end());
 
-		for (int i = 0; i < 100; ++i)
-		{
-			std::cout << "\t " << vertCopy[i].first << std::endl;
-		}
-
-		std::vector<int> v2firstCopy(_vertices.size(), -1);
+		std::vector<uint> v2firstCopy(_vertices.size(), 0);
 		int dupCount = 0;
-		for (int i = 0; i < _vertices.size(); ++i)
+		for (size_t i = 0; i < vertCopy.size(); ++i)
 		{
-			if (i % 1000 == 0)
-				std::cout << "\t " << i << " of " << _vertices.size() << std::endl;
-
-			int ii = i - 1;
-			if ((vertCopy[ii].first - vertCopy[i].first).norm() > 0.000001f) {
-
-				v2firstCopy[vertCopy[i].second] = vertCopy[i].second;
-				continue;
+			if (i == 0 || (vertCopy[i - 1].first - vertCopy[i].first).norm() > 0.000001f) {
+				v2firstCopy[vertCopy[i].second] = uint(vertCopy[i].second);
 			}
 			else {
 				dupCount++;
-				v2firstCopy[vertCopy[i].second] = v2firstCopy[vertCopy[ii].second];
+				v2firstCopy[vertCopy[i].second] = v2firstCopy[vertCopy[i - 1].second];
 			}
-
 		}
-
 		std::cout << "Duplicates found :" << dupCount << std::endl;
 
-		for (int i = 0; i < _triangles.size(); i++)
-		{
-			const Vector3u& tri = _triangles[i];
-			if (tri[0] > _vertices.size() || tri[1] > _vertices.size() ||
-				tri[2] > _vertices.size()) {
-				SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
-			}
-			else {
-				Vector3f u = _vertices[tri[1]] - _vertices[tri[0]];
-				Vector3f v = _vertices[tri[2]] - _vertices[tri[0]];
-				Vector3f normal = u.cross(v);
+		const Normals faceNormals = triangleNormals(_vertices, _triangles);
+		std::vector<uint> groupOffsets, groupCorners;
+		MeshTopology::buildCorners(_triangles, v2firstCopy, _vertices.size(), groupOffsets, groupCorners);
+		const CornerAdjacency adjacency = { groupOffsets, groupCorners };
 
-				vertexNormals[tri[0]].push_back(normal);
-				vertexNormals[tri[1]].push_back(normal);
-				vertexNormals[tri[2]].push_back(normal);
+		// Sum of the normals of the triangles around each group (groups are indexed by their first vertex).
+		sibr::Mesh::Normals normalsCopy(_vertices.size());
+		const int64_t count = int64_t(_vertices.size());
+#pragma omp parallel for
+		for (int64_t i = 0; i < count; ++i) {
+			Vector3f n(0.f, 0.f, 0.f);
+			for (uint c = adjacency.offsets[i]; c < adjacency.offsets[i + 1]; ++c) {
+				n += faceNormals[adjacency.corners[c] / 3];
 			}
-		}
-
-		sibr::Mesh::Normals normalsCopy;
-		normalsCopy.resize(vertexNormals.size());
-		//#pragma omp parallel for
-		for (int i = 0; i < normalsCopy.size(); ++i)
-		{
-			normalsCopy[i] = sibr::Vector3f(0, 0, 0);
-		}
-		for (int i = 0; i < normalsCopy.size(); ++i)
-		{
-			Vector3f n = std::accumulate(vertexNormals[i].begin(), vertexNormals[i].end(), Vector3f(0.f, 0.f, 0.f));
-			normalsCopy[v2firstCopy[i]] += n;
+			normalsCopy[i] = n;
 		}
 
 		//Here we computed normals based on surrounding triangles
-
-		for (int it = 0; it < numIter; it++) {
-
-			std::vector<std::vector<Vector3f>>	vertexNormalsIter(_vertices.size());
-
-			for (int i = 0; i < _triangles.size(); i++)
-			{
-				const Vector3u& tri = _triangles[i];
-				if (tri[0] > _vertices.size() || tri[1] > _vertices.size() ||
-					tri[2] > _vertices.size()) {
-					SIBR_ERR << "Incorrect indices (" << i << ") " << tri[0] << ":" << tri[1] << ":" << tri[2] << std::endl;
-				}
-				else {
-					for (int tId = 0; tId < 3; tId++) {
-						Vector3f normal = normalsCopy[v2firstCopy[tri[tId]]];
-						vertexNormalsIter[tri[(tId + 1) % 3]].push_back(normal);
-						vertexNormalsIter[tri[(tId + 2) % 3]].push_back(normal);
-					}
-				}
-			}
-
-			//#pragma omp parallel for
-			for (int i = 0; i < normalsCopy.size(); ++i)
-			{
-				normalsCopy[i] = sibr::Vector3f(0, 0, 0);
-			}
-			for (int i = 0; i < normalsCopy.size(); ++i)
-			{
-				Vector3f n = std::accumulate(vertexNormalsIter[i].begin(), vertexNormalsIter[i].end(), Vector3f(0.f, 0.f, 0.f));
-				normalsCopy[v2firstCopy[i]] += n;
-			}
-
-		}
+		smoothNormals(_triangles, v2firstCopy, adjacency, normalsCopy, numIter, false);
 
 		_normals.resize(normalsCopy.size());
-		for (int i = 0; i < _normals.size(); ++i)
-		{
-			_normals[i] += normalizeNormal(normalsCopy[v2firstCopy[i]]);
+#pragma omp parallel for
+		for (int64_t i = 0; i < count; ++i) {
+			_normals[i] = normalizeNormal(normalsCopy[v2firstCopy[i]]);
 		}
 
 		_gl.dirtyBufferGL = true;
@@ -1196,34 +1907,34 @@ namespace sibr
 			return;
 		}
 
-		/// Build neighbors information.
 		/// \todo TODO: we could also detect vertices on the edges of the mesh to preserve their positions.
-		std::vector<std::set<unsigned>> neighbors(_vertices.size());
-		for (const sibr::Vector3u& tri : _triangles) {
-			neighbors[tri[0]].emplace(tri[1]);
-			neighbors[tri[0]].emplace(tri[2]);
-			neighbors[tri[1]].emplace(tri[0]);
-			neighbors[tri[1]].emplace(tri[2]);
-			neighbors[tri[2]].emplace(tri[1]);
-			neighbors[tri[2]].emplace(tri[0]);
-		}
+		const MeshTopology& topo = topology();
+		const std::vector<uint>& offsets = topo.vertexVertexOffsets();
+		const std::vector<uint>& neighbors = topo.vertexVertices();
 
 		/// Smooth by averaging.
-		const size_t verticesSize = _vertices.size();
+		const int64_t verticesSize = int64_t(_vertices.size());
+		std::vector<sibr::Vector3f> newVertices(_vertices.size());
 
 		for (int it = 0; it < numIter; ++it) {
-			std::vector<sibr::Vector3f> newVertices(verticesSize);
-
-			for (size_t vid = 0; vid < verticesSize; ++vid) {
-				newVertices[vid] = sibr::Vector3f(0.0f, 0.0f, 0.f);
-				for (const auto& ovid : neighbors[vid]) {
-					newVertices[vid] += _vertices[ovid];
+#pragma omp parallel for
+			for (int64_t vid = 0; vid < verticesSize; ++vid) {
+				// Isolated vertices stay in place.
+				if (offsets[vid] == offsets[vid + 1]) {
+					newVertices[vid] = _vertices[vid];
+					continue;
 				}
-				newVertices[vid] /= float(neighbors[vid].size());
+				sibr::Vector3f sum(0.0f, 0.0f, 0.f);
+				for (uint n = offsets[vid]; n < offsets[vid + 1]; ++n) {
+					sum += _vertices[neighbors[n]];
+				}
+				newVertices[vid] = sum / float(offsets[vid + 1] - offsets[vid]);
 			}
-
-			vertices(newVertices);
+			// Same vertex count, the topology is kept.
+			_vertices.swap(newVertices);
 		}
+		_gl.dirtyBufferGL = true;
+		invalidateGeometry();
 
 		if (updateNormals) {
 			generateNormals();
@@ -1236,84 +1947,79 @@ namespace sibr
 			return;
 		}
 
-		/// Build neighbors information.
 		/// \todo TODO: we could also detect vertices on the edges of the mesh to preserve their positions.
-		std::vector<std::set<unsigned>> neighbors(_vertices.size());
-		std::map<int, std::map<int, std::set<float>>> cotanW;
-		for (const sibr::Vector3u& tri : _triangles) {
-			neighbors[tri[0]].emplace(tri[1]);
-			neighbors[tri[0]].emplace(tri[2]);
-			neighbors[tri[1]].emplace(tri[0]);
-			neighbors[tri[1]].emplace(tri[2]);
-			neighbors[tri[2]].emplace(tri[1]);
-			neighbors[tri[2]].emplace(tri[0]);
-
-			std::vector<sibr::Vector3f> vs;
-			for (int i = 0; i < 3; i++)
-				vs.push_back(_vertices[tri[i]]);
-
-			for (int i = 0; i < 3; i++) {
-				float angle = acos((vs[i] - vs[(i + 2) % 3]).normalized().dot((vs[(i + 1) % 3] - vs[(i + 2) % 3]).normalized()));
-				cotanW[tri[i]][tri[(i + 1) % 3]].emplace(1.0f / (tan(angle) + 0.00001f));
-				cotanW[tri[(i + 1) % 3]][tri[i]].emplace(1.0f / (tan(angle) + 0.00001f));
+		const MeshTopology& topo = topology();
+		const std::vector<uint>& offsets = topo.vertexVertexOffsets();
+		const std::vector<uint>& neighbors = topo.vertexVertices();
+		const std::vector<uint>& cornerOffsets = topo.vertexCornerOffsets();
+		const std::vector<uint>& corners = topo.vertexCorners();
+		const int64_t verticesSize = int64_t(_vertices.size());
+
+		/// Cotangent weight of each neighbor, computed once on the initial positions:
+		/// half the sum of the cotangents of the angles facing the edge in its triangles.
+		std::vector<float> weights(neighbors.size(), 0.0f);
+#pragma omp parallel for
+		for (int64_t vid = 0; vid < verticesSize; ++vid) {
+			const auto first = neighbors.begin() + offsets[vid];
+			const auto last = neighbors.begin() + offsets[vid + 1];
+			for (uint c = cornerOffsets[vid]; c < cornerOffsets[vid + 1]; ++c) {
+				const sibr::Vector3u& tri = _triangles[corners[c] / 3];
+				const uint k = corners[c] % 3;
+				for (uint side = 1; side <= 2; ++side) {
+					const uint ovid = tri[(k + side) % 3];
+					const sibr::Vector3f& apex = _vertices[tri[(k + 3 - side) % 3]];
+					const float angle = acos((_vertices[vid] - apex).normalized().dot((_vertices[ovid] - apex).normalized()));
+					weights[std::lower_bound(first, last, ovid) - neighbors.begin()] += 0.5f / (tan(angle) + 0.00001f);
+				}
 			}
+		}
 
+		/// Color variance over each vertex neighborhood.
+		if (hasColors()) {
+			std::vector<sibr::Vector3f> newColors(_vertices.size());
+#pragma omp parallel for
+			for (int64_t vid = 0; vid < verticesSize; ++vid) {
+				const float count = float(offsets[vid + 1] - offsets[vid] + 1);
+				sibr::Vector3f meanColor = _colors[vid];
+				for (uint n = offsets[vid]; n < offsets[vid + 1]; ++n) {
+					meanColor += _colors[neighbors[n]];
+				}
+				meanColor /= count;
+				sibr::Vector3f varColor = (_colors[vid] - meanColor).cwiseAbs2();
+				for (uint n = offsets[vid]; n < offsets[vid + 1]; ++n) {
+					varColor += (_colors[neighbors[n]] - meanColor).cwiseAbs2();
+				}
+				newColors[vid] = varColor / count;
+			}
+			colors(newColors);
 		}
 
 		/// Smooth by averaging.
-		const size_t verticesSize = _vertices.size();
-
-		std::vector<sibr::Vector3f> newColors(verticesSize);
+		std::vector<sibr::Vector3f> newVertices(_vertices.size());
 		for (int it = 0; it < numIter; ++it) {
-			std::vector<sibr::Vector3f> newVertices(verticesSize);
 #pragma omp parallel for
-			for (int vid = 0; vid < verticesSize; ++vid) {
-				sibr::Vector3f v = _vertices[vid];
+			for (int64_t vid = 0; vid < verticesSize; ++vid) {
+				const sibr::Vector3f& v = _vertices[vid];
 				sibr::Vector3f dtV = sibr::Vector3f(0.0f, 0.0f, 0.f);
 				float totalW = 0;
-
-				std::vector<sibr::Vector3f> colorsLocal;
-				colorsLocal.push_back(_colors[vid]);
-				for (const auto& ovid : neighbors[vid]) {
-					float w = 0;
-					for (const auto& cot : cotanW[vid][ovid]) {
-						w += 0.5 * cot;
-					}
-					totalW += w;
-					dtV += w * _vertices[ovid];
-					colorsLocal.push_back(_colors[ovid]);
+				for (uint n = offsets[vid]; n < offsets[vid + 1]; ++n) {
+					totalW += weights[n];
+					dtV += weights[n] * _vertices[neighbors[n]];
 				}
 
-				sibr::Vector3f meanColor;
-				for (const auto& c : colorsLocal) {
-					meanColor += c;
-				}
-				meanColor /= colorsLocal.size();
-				sibr::Vector3f varColor;
-				for (const auto& c : colorsLocal) {
-					pow(c.x() - meanColor.x(), 2);
-					varColor += sibr::Vector3f(pow(c.x() - meanColor.x(), 2), pow(c.y() - meanColor.y(), 2), pow(c.z() - meanColor.z(), 2));
-				}
-				varColor /= colorsLocal.size();
-
-				newColors[vid] = varColor;
-
+				newVertices[vid] = v;
 				if (totalW > 0) {
 					dtV /= totalW;
 					dtV = dtV - v;
-					if (it % 2 == 0) {
-						newVertices[vid] = v + 0.25 * dtV;
-					}
-					else {
-						newVertices[vid] = v + 0.25 * dtV;
-					}
+					newVertices[vid] += 0.25f * dtV;
 				}
 			}
-
-			vertices(newVertices);
+			// Same vertex count, the topology is kept.
+			_vertices.swap(newVertices);
 		}
+		_gl.dirtyBufferGL = true;
+		invalidateGeometry();
 
-		colors(newColors);
 		if (updateNormals) {
 			generateNormals();
 		}
@@ -1321,91 +2027,216 @@ namespace sibr
 
 
 
-	Mesh Mesh::generateSubMesh(std::function<bool(int)> func) const
-	{
+	namespace {
 
-		sibr::Mesh::Vertices newVertices;
-		sibr::Mesh::Triangles newTriangles;
+		/** Move the kept elements of an attribute to their new place, in place. Kept elements never move
+		after their old position, so a single forward pass is enough.
+		\param data the attribute, one element per old vertex
+		\param remap the new index of each old vertex, or max uint if it is removed
+		\param count the number of kept vertices
+		*/
+		template<typename T>
+		void compactAttribute(std::vector<T>& data, const std::vector<uint>& remap, size_t count)
+		{
+			if (data.size() != remap.size()) {
+				data.clear();
+				return;
+			}
+			for (size_t v = 0; v < remap.size(); ++v) {
+				if (remap[v] != std::numeric_limits<uint>::max()) {
+					data[remap[v]] = data[v];
+				}
+			}
+			data.resize(count);
+			data.shrink_to_fit();
+		}
 
-		sibr::Mesh::Colors newColors;
-		sibr::Mesh::Normals newNormals;
-		sibr::Mesh::UVs newUVs;
+		/** Copy the kept elements of an attribute.
+		\param data the attribute, one element per old vertex
+		\param remap the new index of each old vertex, or max uint if it is removed
+		\param count the number of kept vertices
+		\return the new attribute, empty if data doesn't have one element per old vertex
+		*/
+		template<typename T>
+		std::vector<T> gatherAttribute(const std::vector<T>& data, const std::vector<uint>& remap, size_t count)
+		{
+			std::vector<T> result;
+			if (data.size() != remap.size()) {
+				return result;
+			}
+			result.resize(count);
+			for (size_t v = 0; v < remap.size(); ++v) {
+				if (remap[v] != std::numeric_limits<uint>::max()) {
+					result[remap[v]] = data[v];
+				}
+			}
+			return result;
+		}
+
+		/** Reserve room for an attribute, or drop it.
+		\param data the attribute
+		\param keep false to drop the attribute
+		\param count the number of elements to reserve
+		*/
+		template<typename T>
+		void reserveAttribute(std::vector<T>& data, bool keep, size_t count)
+		{
+			if (keep) {
+				data.reserve(count);
+			}
+			else {
+				data.clear();
+			}
+		}
 
-		std::map<int, int> mapIdVert;
+		/** Remap the triangles whose three vertices are kept.
+		\param triangles the old triangles
+		\param remap the new index of each old vertex, or max uint if it is removed
+		\param removed if not null, flags the vertices of the discarded triangles
+		\return the kept triangles
+		*/
+		Mesh::Triangles remapTriangles(const Mesh::Triangles& triangles, const std::vector<uint>& remap, std::vector<bool>* removed)
+		{
+			const uint unused = std::numeric_limits<uint>::max();
+			Mesh::Triangles result;
+			result.reserve(triangles.size());
+			for (const Vector3u& t : triangles) {
+				const Vector3u newT(remap[t[0]], remap[t[1]], remap[t[2]]);
+				if (newT[0] != unused && newT[1] != unused && newT[2] != unused) {
+					result.push_back(newT);
+				}
+				else if (removed) {
+					for (int c = 0; c < 3; ++c) {
+						(*removed)[t[c]] = true;
+					}
+				}
+			}
+			return result;
+		}
+	}
 
-		int cmptValidVert = 0;
-		int cmptVert = 0;
+	Mesh Mesh::generateSubMesh(std::function<bool(int)> func) const
+	{
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> remap(vertices().size(), unused);
+		uint keptCount = 0;
+		for (int v = 0; v < int(vertices().size()); ++v) {
+			if (func(v)) {
+				remap[v] = keptCount++;
+			}
+		}
 
-		sibr::Mesh::Colors oldColors;
+		Mesh newMesh;
+		newMesh.vertices(gatherAttribute(_vertices, remap, keptCount));
+		newMesh.triangles(remapTriangles(_triangles, remap, nullptr));
 		if (hasColors())
-			oldColors = colors();
-
-		sibr::Mesh::Normals oldNormals;
+			newMesh.colors(gatherAttribute(_colors, remap, keptCount));
 		if (hasNormals())
-			oldNormals = normals();
-
-		sibr::Mesh::UVs oldUVs;
+			newMesh.normals(gatherAttribute(_normals, remap, keptCount));
 		if (hasTexCoords())
-			oldUVs = texCoords();
-
-		for (int v = 0; v < vertices().size(); v++) {
+			newMesh.texCoords(gatherAttribute(_texcoords, remap, keptCount));
 
-			if (func(v)) {
+		return newMesh;
+	}
 
-				newVertices.push_back(vertices()[v]);
+	void	Mesh::forceBufferGLUpdate(bool adjacency) const
+	{
+		if (!_gl.bufferGL) { SIBR_ERR << "Tried to forceBufferGL on a non OpenGL Mesh" << std::endl; return; }
+		_gl.dirtyBufferGL = false;
+		_gl.dirtyRanges.clear();
+		_gl.bufferGL->build(*this, adjacency, _vertexFormat);
+	}
 
-				if (hasColors())
-					newColors.push_back(oldColors[cmptVert]);
-				if (hasNormals())
-					newNormals.push_back(oldNormals[cmptVert]);
-				if (hasTexCoords())
-					newUVs.push_back(oldUVs[cmptVert]);
+	namespace {
 
-				mapIdVert[cmptVert] = cmptValidVert;
-				cmptValidVert++;
+		/// Ranges kept before merging them, to bound the bookkeeping of scattered edits.
+		const size_t kMaxDirtyRanges = 4096;
 
+		/** Sort and merge overlapping ranges, then ranges closer than a growing gap until at most maxCount remain.
+		Merged ranges upload the union of their attributes. */
+		template<typename Range>
+		void mergeDirtyRanges(std::vector<Range>& ranges, size_t maxCount)
+		{
+			std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+			uint gap = 0;
+			while (true) {
+				size_t last = 0;
+				for (size_t r = 1; r < ranges.size(); ++r) {
+					if (ranges[r].begin <= ranges[last].end + gap) {
+						ranges[last].end = std::max(ranges[last].end, ranges[r].end);
+						ranges[last].attributes |= ranges[r].attributes;
+					}
+					else {
+						ranges[++last] = ranges[r];
+					}
+				}
+				ranges.resize(std::min(ranges.size(), last + 1));
+				if (ranges.size() <= maxCount) {
+					return;
+				}
+				gap = std::max(2 * gap, 64u);
 			}
-			else {
-				mapIdVert[cmptVert] = -1;
-			}
+		}
+	}
 
-			cmptVert++;
+	void	Mesh::markVerticesDirty(uint attributes, size_t begin, size_t end)
+	{
+		if (attributes & (1u << MeshBufferGL::VertexAttribLocation)) {
+			invalidateGeometry();
+		}
+		if (_gl.dirtyBufferGL || !_gl.bufferGL || begin >= end) {
+			return;
+		}
+		std::vector<BufferGL::DirtyRange>& ranges = _gl.dirtyRanges;
+		// Strokes usually edit neighboring vertices one after the other.
+		if (!ranges.empty() && ranges.back().attributes == attributes && begin <= ranges.back().end && end >= ranges.back().begin) {
+			ranges.back().begin = std::min(ranges.back().begin, uint(begin));
+			ranges.back().end = std::max(ranges.back().end, uint(end));
+			return;
+		}
+		ranges.push_back({ uint(begin), uint(end), attributes });
+		if (ranges.size() > kMaxDirtyRanges) {
+			mergeDirtyRanges(ranges, kMaxDirtyRanges / 2);
+		}
+	}
 
+	void	Mesh::updateBufferGL(bool adjacency) const
+	{
+		if (_gl.dirtyBufferGL) {
+			forceBufferGLUpdate(adjacency);
+			return;
 		}
-
-		for (sibr::Vector3u t : triangles()) {
-
-			if (mapIdVert[t.x()] != -1 &&
-				mapIdVert[t.y()] != -1 &&
-				mapIdVert[t.z()] != -1) {
-				sibr::Vector3u newt(mapIdVert[t.x()], mapIdVert[t.y()], mapIdVert[t.z()]);
-				newTriangles.push_back(newt);
+		if (_gl.dirtyRanges.empty()) {
+			return;
+		}
+		mergeDirtyRanges(_gl.dirtyRanges, kMaxDirtyRanges);
+		bool moved = false;
+		for (const BufferGL::DirtyRange& range : _gl.dirtyRanges) {
+			// The attributes or the count changed behind our back, rebuild everything.
+			if (!_gl.bufferGL->updateVertices(*this, range.attributes, range.begin, range.end)) {
+				forceBufferGLUpdate(adjacency);
+				return;
 			}
+			moved = moved || (range.attributes & (1u << MeshBufferGL::VertexAttribLocation)) != 0;
+		}
+		_gl.dirtyRanges.clear();
+		if (moved) {
+			_gl.bufferGL->buildClusters(*this);
 		}
-
-		Mesh newMesh;
-		newMesh.vertices(newVertices);
-		newMesh.triangles(newTriangles);
-		if (hasColors())
-			newMesh.colors(newColors);
-		if (hasNormals())
-			newMesh.normals(newNormals);
-		if (hasTexCoords())
-			newMesh.texCoords(newUVs);
-
-		return newMesh;
 	}
 
-	void	Mesh::forceBufferGLUpdate(bool adjacency) const
+	void	Mesh::vertexFormat(MeshBufferGL::VertexFormat format)
 	{
-		if (!_gl.bufferGL) { SIBR_ERR << "Tried to forceBufferGL on a non OpenGL Mesh" << std::endl; return; }
-		_gl.dirtyBufferGL = false;
-		_gl.bufferGL->build(*this, adjacency);
+		if (format != _vertexFormat) {
+			_vertexFormat = format;
+			_gl.dirtyBufferGL = true;
+		}
 	}
 
 	void	Mesh::freeBufferGLUpdate(void) const
 	{
 		_gl.dirtyBufferGL = false;
+		_gl.dirtyRanges.clear();
 		_gl.bufferGL->free();
 	}
 
@@ -1426,39 +2257,38 @@ namespace sibr
 		_renderingOptions.invertDepthTest = invertDepthTest;
 		_renderingOptions.tessellation = tessellation;
 
-		if (_gl.dirtyBufferGL)
-			forceBufferGLUpdate(adjacency);
+		updateBufferGL(adjacency);
 
 		if (depthTest)
-			glEnable(GL_DEPTH_TEST);
+			GLState::enable(GL_DEPTH_TEST);
 		else
-			glDisable(GL_DEPTH_TEST);
+			GLState::disable(GL_DEPTH_TEST);
 
 		if (backFaceCulling)
 		{
-			glEnable(GL_CULL_FACE);
+			GLState::enable(GL_CULL_FACE);
 			if (!frontFaceCulling)
-				glCullFace(GL_BACK);
+				GLState::cullFace(GL_BACK);
 			else
-				glCullFace(GL_FRONT);
+				GLState::cullFace(GL_FRONT);
 		}
 		else
-			glDisable(GL_CULL_FACE);
+			GLState::disable(GL_CULL_FACE);
 
 		if (invertDepthTest) {
-			glDepthFunc(GL_GEQUAL);
+			GLState::depthFunc(GL_GEQUAL);
 		}
 
 		switch (mode)
 		{
 		case sibr::Mesh::FillRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
 			break;
 		case sibr::Mesh::PointRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_POINT);
 			break;
 		case sibr::Mesh::LineRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			break;
 		default:
 			break;
@@ -1477,10 +2307,140 @@ namespace sibr
 		}
 
 		// Reset default state (Policy is 'restore default values')
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_DEPTH_TEST);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDepthFunc(GL_LESS);
+		GLState::disable(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::depthFunc(GL_LESS);
+	}
+
+	uint64	Mesh::revision(void) const
+	{
+		const uint64 uploaded = _gl.bufferGL ? _gl.bufferGL->revision() : 0;
+		// Pending changes are uploaded on the next render, which increases the buffer revision.
+		return (_gl.dirtyBufferGL || !_gl.dirtyRanges.empty()) ? uploaded + 1 : uploaded;
+	}
+
+	void	Mesh::renderCulled(const Matrix4f& viewproj,
+		bool depthTest,
+		bool backFaceCulling,
+		RenderMode mode,
+		bool frontFaceCulling,
+		bool invertDepthTest
+	) const {
+		renderCulled(std::vector<Matrix4f>(1, viewproj), depthTest, backFaceCulling, mode, frontFaceCulling, invertDepthTest);
+	}
+
+	void	Mesh::renderCulled(const std::vector<Matrix4f>& viewprojs,
+		bool depthTest,
+		bool backFaceCulling,
+		RenderMode mode,
+		bool frontFaceCulling,
+		bool invertDepthTest
+	) const {
+		if (_triangles.empty()) {
+			render(depthTest, backFaceCulling, mode, frontFaceCulling, invertDepthTest);
+			return;
+		}
+		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
+		updateBufferGL();
+
+		if (depthTest)
+			GLState::enable(GL_DEPTH_TEST);
+		else
+			GLState::disable(GL_DEPTH_TEST);
+
+		if (backFaceCulling)
+		{
+			GLState::enable(GL_CULL_FACE);
+			if (!frontFaceCulling)
+				GLState::cullFace(GL_BACK);
+			else
+				GLState::cullFace(GL_FRONT);
+		}
+		else
+			GLState::disable(GL_CULL_FACE);
+
+		if (invertDepthTest) {
+			GLState::depthFunc(GL_GEQUAL);
+		}
+
+		switch (mode)
+		{
+		case sibr::Mesh::FillRenderMode:
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			break;
+		case sibr::Mesh::PointRenderMode:
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_POINT);
+			break;
+		case sibr::Mesh::LineRenderMode:
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			break;
+		default:
+			break;
+		}
+
+		std::vector<Frustum> frusta;
+		frusta.reserve(viewprojs.size());
+		for (const Matrix4f& viewproj : viewprojs) {
+			frusta.emplace_back(viewproj);
+		}
+		_gl.bufferGL->drawCulled(frusta);
+
+		// Reset default state (Policy is 'restore default values')
+		GLState::disable(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::depthFunc(GL_LESS);
+	}
+
+	void	Mesh::renderInstanced(uint instanceCount,
+		bool depthTest,
+		bool backFaceCulling,
+		RenderMode mode,
+		bool frontFaceCulling,
+		bool invertDepthTest
+	) const {
+		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
+		if (instanceCount == 0) {
+			return;
+		}
+		updateBufferGL();
+
+		if (depthTest)
+			GLState::enable(GL_DEPTH_TEST);
+		else
+			GLState::disable(GL_DEPTH_TEST);
+
+		if (backFaceCulling)
+		{
+			GLState::enable(GL_CULL_FACE);
+			if (!frontFaceCulling)
+				GLState::cullFace(GL_BACK);
+			else
+				GLState::cullFace(GL_FRONT);
+		}
+		else
+			GLState::disable(GL_CULL_FACE);
+
+		if (invertDepthTest) {
+			GLState::depthFunc(GL_GEQUAL);
+		}
+
+		if (mode == LineRenderMode) {
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		}
+
+		if (_triangles.empty() || mode == PointRenderMode) {
+			_gl.bufferGL->draw_points_instanced(instanceCount);
+		} else {
+			_gl.bufferGL->drawInstanced(instanceCount);
+		}
+
+		// Reset default state (Policy is 'restore default values')
+		GLState::disable(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::depthFunc(GL_LESS);
 	}
 
 	void	Mesh::renderSubMesh(unsigned int begin, unsigned int end,
@@ -1491,39 +2451,38 @@ namespace sibr
 		bool invertDepthTest
 	) const {
 		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
-		if (_gl.dirtyBufferGL)
-			forceBufferGLUpdate();
+		updateBufferGL();
 
 		if (depthTest)
-			glEnable(GL_DEPTH_TEST);
+			GLState::enable(GL_DEPTH_TEST);
 		else
-			glDisable(GL_DEPTH_TEST);
+			GLState::disable(GL_DEPTH_TEST);
 
 		if (backFaceCulling)
 		{
-			glEnable(GL_CULL_FACE);
+			GLState::enable(GL_CULL_FACE);
 			if (!frontFaceCulling)
-				glCullFace(GL_BACK);
+				GLState::cullFace(GL_BACK);
 			else
-				glCullFace(GL_FRONT);
+				GLState::cullFace(GL_FRONT);
 		}
 		else
-			glDisable(GL_CULL_FACE);
+			GLState::disable(GL_CULL_FACE);
 
 		if (invertDepthTest) {
-			glDepthFunc(GL_GEQUAL);
+			GLState::depthFunc(GL_GEQUAL);
 		}
 
 		switch (mode)
 		{
 		case sibr::Mesh::FillRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
 			break;
 		case sibr::Mesh::PointRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_POINT);
 			break;
 		case sibr::Mesh::LineRenderMode:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			GLState::polygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			break;
 		default:
 			break;
@@ -1537,40 +2496,40 @@ namespace sibr
 		}
 
 		// Reset default state (Policy is 'restore default values')
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_DEPTH_TEST);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDepthFunc(GL_LESS);
+		GLState::disable(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::depthFunc(GL_LESS);
 	}
 
 
 	void	Mesh::render_points(void) const
 	{
-		forceBufferGLUpdate();
-		glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
+		updateBufferGL();
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_POINT);
 		_gl.bufferGL->draw_points();
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	}
 
 	void	Mesh::render_points(bool depthTest) const
 	{
 		if (depthTest) {
-			glEnable(GL_DEPTH_TEST);
+			GLState::enable(GL_DEPTH_TEST);
 		}
 		else {
-			glDisable(GL_DEPTH_TEST);
+			GLState::disable(GL_DEPTH_TEST);
 		}
 
 		render_points();
 
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 	}
 
 	void	Mesh::render_lines(void) const
 	{
 		if (!_gl.bufferGL) { SIBR_ERR << "Tried to render a non OpenGL Mesh" << std::endl; return; }
-		if (_gl.dirtyBufferGL)
-			forceBufferGLUpdate();
+		updateBufferGL();
 		_gl.bufferGL->draw_lines();
 	}
 
@@ -1586,79 +2545,32 @@ namespace sibr
 			}
 		}
 
-		int numValidNewVertices = 0;
-		for (bool b : willBeKept) {
-			if (b) {
-				++numValidNewVertices;
-			}
-		}
-
-		std::vector<int> oldToNewVertexId(numOldVertices, -1);
-
-		sibr::Mesh::Vertices newVertices(numValidNewVertices);
-		sibr::Mesh::Triangles newTriangles;
-
-		sibr::Mesh::Colors newColors;
-		sibr::Mesh::Normals newNormals;
-		sibr::Mesh::UVs newUVs;
-
-		if (hasColors()) {
-			newColors.resize(numValidNewVertices);
-		}
-		if (hasNormals()) {
-			newNormals.resize(numValidNewVertices);
-		}
-		if (hasTexCoords()) {
-			newUVs.resize(numValidNewVertices);
-		}
-
-		int new_vertex_id = 0;
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> oldToNewVertexId(numOldVertices, unused);
+		uint numValidNewVertices = 0;
 		for (int id = 0; id < numOldVertices; ++id) {
 			if (willBeKept[id]) {
-				newVertices[new_vertex_id] = vertices()[id];
-				oldToNewVertexId[id] = new_vertex_id;
-
-				if (hasColors()) {
-					newColors[new_vertex_id] = colors()[id];
-				}
-				if (hasNormals()) {
-					newNormals[new_vertex_id] = normals()[id];
-				}
-				if (hasTexCoords()) {
-					newUVs[new_vertex_id] = texCoords()[id];
-				}
-				++new_vertex_id;
+				oldToNewVertexId[id] = numValidNewVertices++;
 			}
 		}
 
 		std::vector<bool> isInRemovedTriangle(numOldVertices, false);
-		for (const auto& t : triangles()) {
-			sibr::Vector3i newVerticesId = t.cast<int>().unaryExpr([&oldToNewVertexId](int v_id) { return oldToNewVertexId[v_id];  });
-			if (newVerticesId.unaryViewExpr([](int v_id) { return v_id >= 0 ? 1 : 0; }).all()) {
-				newTriangles.push_back(newVerticesId.cast<unsigned>());
-			}
-			else {
-				for (int c = 0; c < 3; c++) {
-					isInRemovedTriangle[t[c]] = true;
-				}
-			}
-		}
 
 		bool oldMeshHasGraphics = (_gl.bufferGL.get() != nullptr);
 
 		Mesh::SubMesh subMesh;
 		subMesh.meshPtr = std::make_shared<sibr::Mesh>(oldMeshHasGraphics);
 		sibr::Mesh& mesh = *subMesh.meshPtr;
-		mesh.vertices(newVertices);
-		mesh.triangles(newTriangles);
+		mesh.vertices(gatherAttribute(_vertices, oldToNewVertexId, numValidNewVertices));
+		mesh.triangles(remapTriangles(_triangles, oldToNewVertexId, &isInRemovedTriangle));
 		if (hasColors()) {
-			mesh.colors(newColors);
+			mesh.colors(gatherAttribute(_colors, oldToNewVertexId, numValidNewVertices));
 		}
 		if (hasNormals()) {
-			mesh.normals(newNormals);
+			mesh.normals(gatherAttribute(_normals, oldToNewVertexId, numValidNewVertices));
 		}
 		if (hasTexCoords()) {
-			mesh.texCoords(newUVs);
+			mesh.texCoords(gatherAttribute(_texcoords, oldToNewVertexId, numValidNewVertices));
 		}
 
 		for (int id = 0; id < numOldVertices; ++id) {
@@ -1757,77 +2669,152 @@ namespace sibr
 		return _meshPath;
 	}
 
-	void					Mesh::getBoundingSphere(Vector3f& outCenter, float& outRadius, bool referencedOnly, bool usePCcenter) const
+	namespace {
+
+		/// Elements per block of the bounds reductions, large enough to amortize the scheduling.
+		const size_t kReductionBlock = size_t(1) << 16;
+
+		/** Reduce [0, count[ in parallel. Each thread accumulates the blocks it is given in a partial result,
+		 the partial results are then merged in thread order, so the result is the same from one run to the other.
+		\param count the number of elements
+		\param identity the neutral partial result
+		\param accumulate called as accumulate(partial, begin, end) on each block
+		\param merge called as merge(result, partial) on each partial result
+		\return the reduced value
+		*/
+		template<typename T, typename Accumulate, typename Merge>
+		T parallelReduce(size_t count, const T& identity, Accumulate accumulate, Merge merge)
+		{
+			const int64_t blocks = int64_t((count + kReductionBlock - 1) / kReductionBlock);
+			std::vector<T> partials(size_t(std::max(omp_get_max_threads(), 1)), identity);
+#pragma omp parallel for schedule(static) if (blocks > 1)
+			for (int64_t b = 0; b < blocks; ++b)
+			{
+				const size_t begin = size_t(b) * kReductionBlock;
+				accumulate(partials[size_t(omp_get_thread_num())], begin, std::min(begin + kReductionBlock, count));
+			}
+			T result = identity;
+			for (const T& partial : partials) {
+				merge(result, partial);
+			}
+			return result;
+		}
+
+		/// Partial sums of the area weighted center of triangles.
+		struct AreaCenter
+		{
+			double area = 0.0; ///< Total area.
+			Vector3d weighted = Vector3d(0, 0, 0); ///< Sum of the centers weighted by the areas.
+		};
+	}
+
+	Mesh::BoundsCache&		Mesh::bounds(void) const
 	{
-		// Get the center of mass
+		if (_bounds.edits != _geometryEdits) {
+			_bounds = BoundsCache();
+			_bounds.edits = _geometryEdits;
+		}
+		return _bounds;
+	}
 
-		double totalArea = 0, currentArea;
-		double xCenter = 0, yCenter = 0, zCenter = 0;
+	void					Mesh::getBoundingSphere(Vector3f& outCenter, float& outRadius, bool referencedOnly, bool usePCcenter) const
+	{
+		BoundsCache& cache = bounds();
+		const uint variant = (referencedOnly ? 1u : 0u) + (usePCcenter ? 2u : 0u);
+		if (cache.spheres & (1u << variant)) {
+			outCenter = cache.sphereCenters[variant];
+			outRadius = cache.sphereRadii[variant];
+			return;
+		}
 
 		const Triangles& tri = _triangles;
 		const Vertices& vert = _vertices;
 		if (usePCcenter) {
-			sibr::Vector3d outCenterDbl;
-			for (const Vector3f& v : vert)
-			{
-				outCenterDbl += v.cast<double>();
-			}
-
-			outCenter = (outCenterDbl / vert.size()).cast<float>();
+			outCenter = centroid();
 		}
 		else {
+			// Get the center of mass
 			if (tri.size() == 0) {
 				SIBR_WRG << "No triangles found for evaluation of sphere center, result will be NaN";
 			}
-			for (const Vector3u& t : tri)
-			{
-				float trix1 = vert[t[0]].x();
-				float triy1 = vert[t[0]].y();
-				float triz1 = vert[t[0]].z();
-
-				float trix2 = vert[t[1]].x();
-				float triy2 = vert[t[1]].y();
-				float triz2 = vert[t[1]].z();
-
-				float trix3 = vert[t[2]].x();
-				float triy3 = vert[t[2]].y();
-				float triz3 = vert[t[2]].z();
-
-				currentArea = ((vert[t[1]] - vert[t[0]]).cross(vert[t[2]] - vert[t[0]])).norm() / 2.0;
-				totalArea += currentArea;
-
-				xCenter += ((trix1 + trix2 + trix3) / 3) * currentArea;
-				yCenter += ((triy1 + triy2 + triy3) / 3) * currentArea;
-				zCenter += ((triz1 + triz2 + triz3) / 3) * currentArea;
-			}
-
-			outCenter = Vector3f(float(xCenter / totalArea), float(yCenter / totalArea), float(zCenter / totalArea));
+			const AreaCenter center = parallelReduce(tri.size(), AreaCenter(), [&](AreaCenter& partial, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					const Vector3f& v0 = vert[tri[i][0]];
+					const Vector3f& v1 = vert[tri[i][1]];
+					const Vector3f& v2 = vert[tri[i][2]];
+					const double currentArea = double(((v1 - v0).cross(v2 - v0)).norm()) / 2.0;
+					partial.area += currentArea;
+					partial.weighted += ((v0 + v1 + v2) / 3.0f).cast<double>() * currentArea;
+				}
+			}, [](AreaCenter& result, const AreaCenter& partial) {
+				result.area += partial.area;
+				result.weighted += partial.weighted;
+			});
+			outCenter = (center.weighted / center.area).cast<float>();
 		}
 
-
-		outRadius = 0.f;
+		// Largest squared distance, the square root is only taken once.
+		const Vector3f c = outCenter;
+		const auto maxOf = [](float& result, float partial) { result = std::max(result, partial); };
+		float squaredRadius = 0.f;
 		if (referencedOnly) {
-			for (const Vector3u& t : tri)
-			{
-				outRadius = std::max(outRadius, distance(vert[t[0]], outCenter));
-				outRadius = std::max(outRadius, distance(vert[t[1]], outCenter));
-				outRadius = std::max(outRadius, distance(vert[t[2]], outCenter));
-			}
+			squaredRadius = parallelReduce(tri.size(), 0.f, [&](float& partial, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					partial = std::max(partial, (vert[tri[i][0]] - c).squaredNorm());
+					partial = std::max(partial, (vert[tri[i][1]] - c).squaredNorm());
+					partial = std::max(partial, (vert[tri[i][2]] - c).squaredNorm());
+				}
+			}, maxOf);
 		}
 		else {
-			for (const Vector3f& v : vert)
-				outRadius = std::max(outRadius, distance(v, outCenter));
+			const float* points = vert.empty() ? nullptr : vert[0].data();
+			squaredRadius = parallelReduce(vert.size(), 0.f, [&, points](float& partial, size_t begin, size_t end) {
+				// Plain float loop over the packed coordinates, so that it is vectorized.
+				float m = partial;
+				for (size_t i = begin; i < end; ++i) {
+					const float dx = points[3 * i + 0] - c[0];
+					const float dy = points[3 * i + 1] - c[1];
+					const float dz = points[3 * i + 2] - c[2];
+					const float d = dx * dx + dy * dy + dz * dz;
+					m = d > m ? d : m;
+				}
+				partial = m;
+			}, maxOf);
 		}
+		outRadius = std::sqrt(squaredRadius);
+
+		cache.sphereCenters[variant] = outCenter;
+		cache.sphereRadii[variant] = outRadius;
+		cache.spheres |= 1u << variant;
 	}
 
 
 	Eigen::AlignedBox<float, 3> Mesh::getBoundingBox(void) const
 	{
-		Eigen::AlignedBox<float, 3> box;
-		for (const auto& vertex : _vertices) {
-			box.extend(vertex);
+		BoundsCache& cache = bounds();
+		if (cache.hasBox) {
+			return cache.box;
 		}
-		return box;
+		const float* points = _vertices.empty() ? nullptr : _vertices[0].data();
+		cache.box = parallelReduce(_vertices.size(), Eigen::AlignedBox<float, 3>(), [points](Eigen::AlignedBox<float, 3>& partial, size_t begin, size_t end) {
+			if (begin == end) {
+				return;
+			}
+			Vector3f lo = partial.isEmpty() ? Vector3f(points + 3 * begin) : Vector3f(partial.min());
+			Vector3f hi = partial.isEmpty() ? Vector3f(points + 3 * begin) : Vector3f(partial.max());
+			// One running min and max per coordinate, so that the loop is vectorized.
+			float lx = lo[0], ly = lo[1], lz = lo[2], hx = hi[0], hy = hi[1], hz = hi[2];
+			for (size_t i = begin; i < end; ++i) {
+				const float x = points[3 * i + 0], y = points[3 * i + 1], z = points[3 * i + 2];
+				lx = x < lx ? x : lx; ly = y < ly ? y : ly; lz = z < lz ? z : lz;
+				hx = x > hx ? x : hx; hy = y > hy ? y : hy; hz = z > hz ? z : hz;
+			}
+			partial = Eigen::AlignedBox<float, 3>(Vector3f(lx, ly, lz), Vector3f(hx, hy, hz));
+		}, [](Eigen::AlignedBox<float, 3>& result, const Eigen::AlignedBox<float, 3>& partial) {
+			result.extend(partial);
+		});
+		cache.hasBox = true;
+		return cache.box;
 	}
 
 	sibr::Mesh::Ptr sibr::Mesh::getEnvSphere(sibr::Vector3f center, float radius, sibr::Vector3f zenith, sibr::Vector3f north,
@@ -1887,14 +2874,29 @@ namespace sibr
 
 	sibr::Vector3f Mesh::centroid() const
 	{
-		sibr::Vector3d centroid(0, 0, 0);
-		for (auto& vertex : _vertices) {
-			centroid += vertex.cast<double>();
+		BoundsCache& cache = bounds();
+		if (cache.hasCentroid) {
+			return cache.centroid;
 		}
+		const float* points = _vertices.empty() ? nullptr : _vertices[0].data();
+		const Vector3d sum = parallelReduce(_vertices.size(), Vector3d(0, 0, 0), [points](Vector3d& partial, size_t begin, size_t end) {
+			double x = 0.0, y = 0.0, z = 0.0;
+			for (size_t i = begin; i < end; ++i) {
+				x += double(points[3 * i + 0]);
+				y += double(points[3 * i + 1]);
+				z += double(points[3 * i + 2]);
+			}
+			partial += Vector3d(x, y, z);
+		}, [](Vector3d& result, const Vector3d& partial) {
+			result += partial;
+		});
+		sibr::Vector3d centroid = sum;
 		if (_vertices.size() > 0) {
 			centroid /= static_cast<double>(_vertices.size());
 		}
-		return centroid.cast<float>();
+		cache.centroid = centroid.cast<float>();
+		cache.hasCentroid = true;
+		return cache.centroid;
 	}
 
 	std::stringstream Mesh::getOffStream(bool verbose) const
@@ -1945,6 +2947,7 @@ namespace sibr
 
 		_triangles.resize(0);
 		_triangles.reserve(3 * n_faces);
+		invalidateTopology();
 		int face_size;
 		for (int t = 0; t < n_faces; ++t) {
 			safeGetline(stream, line);
@@ -1977,6 +2980,46 @@ namespace sibr
 		}
 	}
 
+	// The views reinterpret the arrays as packed scalars.
+	static_assert(sizeof(Vector3f) == 3 * sizeof(float) && sizeof(Vector2f) == 2 * sizeof(float) && sizeof(Vector3u) == 3 * sizeof(uint),
+		"Mesh arrays must be tightly packed");
+
+	Mesh::BufferView Mesh::bufferView(void) const
+	{
+		BufferView view;
+		view.positions = _vertices.empty() ? nullptr : _vertices[0].data();
+		view.vertexCount = _vertices.size();
+		view.indices = _triangles.empty() ? nullptr : _triangles[0].data();
+		view.triangleCount = _triangles.size();
+		view.normals = hasNormals() ? _normals[0].data() : nullptr;
+		view.colors = hasColors() ? _colors[0].data() : nullptr;
+		view.texCoords = hasTexCoords() ? _texcoords[0].data() : nullptr;
+		return view;
+	}
+
+	void Mesh::fromBufferView(const BufferView & view, bool computeNormals)
+	{
+		const size_t n = view.vertexCount;
+		const Vector3f * normals = reinterpret_cast<const Vector3f*>(view.normals);
+		const Vector3f * colors = reinterpret_cast<const Vector3f*>(view.colors);
+		const Vector2f * texCoords = reinterpret_cast<const Vector2f*>(view.texCoords);
+
+		// One copy per array, the setters flag the GPU buffers for update.
+		vertices(Vertices(view.points().begin(), view.points().end()));
+		triangles(Triangles(view.faces().begin(), view.faces().end()));
+		if (normals) {
+			this->normals(Normals(normals, normals + n));
+		}
+		else if (computeNormals) {
+			generateNormals();
+		}
+		else {
+			this->normals(Normals());
+		}
+		this->colors(colors ? Colors(colors, colors + n) : Colors());
+		this->texCoords(texCoords ? UVs(texCoords, texCoords + n) : UVs());
+	}
+
 	sibr::Mesh::Ptr Mesh::getTestCube(bool withGraphics)
 	{
 		std::vector<sibr::Vector3f> vertices = {
@@ -2044,171 +3087,574 @@ namespace sibr
 		return sphereMesh;
 	}
 
-	sibr::Mesh::Ptr Mesh::subDivide(float limitSize, size_t maxRecursion) const
-	{
-		struct Less {
-			bool operator()(const sibr::Vector3f& a, const sibr::Vector3f& b) const {
-				return a < b;
+	namespace {
+
+		/// Elements per block of the subdivision passes.
+		const size_t kSubdivisionBlock = size_t(1) << 16;
+		/// Number of independent tables the edges are deduplicated in.
+		const size_t kEdgeShards = 256;
+
+		/** Replace counts by their exclusive prefix sum, in parallel by blocks.
+		\param values the counts, will contain the offsets
+		\return the sum of the counts
+		*/
+		uint exclusiveScan(std::vector<uint>& values)
+		{
+			const int64_t blocks = int64_t((values.size() + kSubdivisionBlock - 1) / kSubdivisionBlock);
+			std::vector<uint> sums(size_t(blocks) + 1, 0);
+#pragma omp parallel for schedule(static)
+			for (int64_t b = 0; b < blocks; ++b) {
+				const size_t end = std::min((size_t(b) + 1) * kSubdivisionBlock, values.size());
+				uint sum = 0;
+				for (size_t i = size_t(b) * kSubdivisionBlock; i < end; ++i) {
+					sum += values[i];
+				}
+				sums[size_t(b) + 1] = sum;
+			}
+			for (size_t b = 1; b < sums.size(); ++b) {
+				sums[b] += sums[b - 1];
+			}
+#pragma omp parallel for schedule(static)
+			for (int64_t b = 0; b < blocks; ++b) {
+				const size_t end = std::min((size_t(b) + 1) * kSubdivisionBlock, values.size());
+				uint sum = sums[size_t(b)];
+				for (size_t i = size_t(b) * kSubdivisionBlock; i < end; ++i) {
+					const uint count = values[i];
+					values[i] = sum;
+					sum += count;
+				}
+			}
+			return sums.back();
+		}
+
+		/** \return a hash of a point, equal for equal coordinates. \param p the point */
+		uint64 hashPoint(const Vector3f& p)
+		{
+			uint64 h = 0x9E3779B97F4A7C15ull;
+			for (int c = 0; c < 3; ++c) {
+				// Adding zero maps -0 to +0, they compare equal.
+				const float v = p[c] + 0.0f;
+				uint32 bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				h = (h ^ bits) * 0xFF51AFD7ED558CCDull;
+				h ^= h >> 32;
+			}
+			return h;
+		}
+	}
+
+	sibr::Mesh::Ptr Mesh::subDivide(float limitSize, size_t maxRecursion) const
+	{
+		// Edges are identified by their midpoint rather than by their vertex indices, so that
+		// vertices duplicated along seams share their subdivided edges: the index based
+		// topology() can't be used here. Half edge 3 * t + k goes from corner k to corner k + 1
+		// of triangle t, the edge is represented by its first half edge in triangle order.
+		// Each level is a few parallel passes over the half edges: hashing, grouping by shard,
+		// deduplication in one table per shard, then output offsets by prefix sums, so that
+		// the split triangles are written without synchronization. The work buffers are reused
+		// from one level to the next.
+		Vertices verts = vertices();
+		Normals norms = normals();
+		Triangles tris = triangles();
+		Triangles nextTris;
+		const bool withNormals = hasNormals();
+
+		std::vector<uint64> hashes;
+		std::vector<float> lengths;
+		std::vector<uint> shardCounts, sorted, slots, reps, midpoints, triOffsets;
+		std::vector<uint8> degenerate;
+
+		for (size_t level = 0; ; ++level) {
+			const size_t nTris = tris.size();
+			const size_t nHalfEdges = 3 * nTris;
+			const int64_t nBlocks = int64_t((nHalfEdges + kSubdivisionBlock - 1) / kSubdivisionBlock);
+			const auto midPoint = [&](size_t h) {
+				const Vector3u& t = tris[h / 3];
+				return Vector3f(0.5f * (verts[t[h % 3]] + verts[t[(h % 3 + 1) % 3]]));
+			};
+
+			// Hash the midpoints, skip degenerate faces.
+			hashes.resize(nHalfEdges);
+			lengths.resize(nHalfEdges);
+			degenerate.resize(nTris);
+#pragma omp parallel for schedule(static)
+			for (int64_t t = 0; t < int64_t(nTris); ++t) {
+				const Vector3u& tri = tris[t];
+				degenerate[t] = tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0];
+				for (size_t k = 0; k < 3; ++k) {
+					const size_t h = 3 * size_t(t) + k;
+					hashes[h] = hashPoint(midPoint(h));
+					lengths[h] = (verts[tri[k]] - verts[tri[(k + 1) % 3]]).norm();
+				}
+			}
+
+			// Group the half edges by shard, in triangle order in each shard.
+			shardCounts.assign(size_t(nBlocks) * kEdgeShards, 0);
+#pragma omp parallel for schedule(static)
+			for (int64_t b = 0; b < nBlocks; ++b) {
+				const size_t end = std::min((size_t(b) + 1) * kSubdivisionBlock, nHalfEdges);
+				uint* counts = &shardCounts[size_t(b) * kEdgeShards];
+				for (size_t h = size_t(b) * kSubdivisionBlock; h < end; ++h) {
+					if (!degenerate[h / 3]) {
+						++counts[hashes[h] >> 56];
+					}
+				}
+			}
+			std::vector<uint> shardStarts(kEdgeShards + 1, 0);
+			uint grouped = 0;
+			for (size_t s = 0; s < kEdgeShards; ++s) {
+				shardStarts[s] = grouped;
+				for (size_t b = 0; b < size_t(nBlocks); ++b) {
+					const uint count = shardCounts[b * kEdgeShards + s];
+					shardCounts[b * kEdgeShards + s] = grouped;
+					grouped += count;
+				}
+			}
+			shardStarts[kEdgeShards] = grouped;
+			sorted.resize(grouped);
+#pragma omp parallel for schedule(static)
+			for (int64_t b = 0; b < nBlocks; ++b) {
+				const size_t end = std::min((size_t(b) + 1) * kSubdivisionBlock, nHalfEdges);
+				uint* cursors = &shardCounts[size_t(b) * kEdgeShards];
+				for (size_t h = size_t(b) * kSubdivisionBlock; h < end; ++h) {
+					if (!degenerate[h / 3]) {
+						sorted[cursors[hashes[h] >> 56]++] = uint(h);
+					}
+				}
+			}
+
+			// Deduplicate each shard in its own open addressing table, half full.
+			slots.assign(2 * size_t(grouped), uint(-1));
+			reps.resize(nHalfEdges);
+#pragma omp parallel for schedule(dynamic)
+			for (int64_t s = 0; s < int64_t(kEdgeShards); ++s) {
+				const size_t begin = shardStarts[s], end = shardStarts[s + 1];
+				uint* table = slots.data() + 2 * begin;
+				const size_t tableSize = 2 * (end - begin);
+				for (size_t i = begin; i < end; ++i) {
+					const uint h = sorted[i];
+					const Vector3f p = midPoint(h);
+					size_t slot = size_t(hashes[h] % tableSize);
+					while (table[slot] != uint(-1) && midPoint(table[slot]) != p) {
+						slot = slot + 1 == tableSize ? 0 : slot + 1;
+					}
+					if (table[slot] == uint(-1)) {
+						table[slot] = h;
+					}
+					reps[h] = table[slot];
+				}
+			}
+
+			// Number the midpoints of the long edges, and the triangles each face is split in.
+			midpoints.resize(nHalfEdges);
+			triOffsets.resize(nTris);
+#pragma omp parallel for schedule(static)
+			for (int64_t t = 0; t < int64_t(nTris); ++t) {
+				uint split = 0;
+				for (size_t k = 0; k < 3; ++k) {
+					const size_t h = 3 * size_t(t) + k;
+					const bool divided = !degenerate[t] && lengths[reps[h]] > limitSize;
+					midpoints[h] = divided && reps[h] == h ? 1 : 0;
+					split += divided ? 1 : 0;
+				}
+				triOffsets[t] = degenerate[t] ? 0 : 1 + split;
+			}
+			const uint nDivided = exclusiveScan(midpoints);
+			const uint nNewTris = exclusiveScan(triOffsets);
+
+			const size_t nOldVertices = verts.size();
+			verts.resize(nOldVertices + nDivided);
+			if (withNormals) {
+				norms.resize(nOldVertices + nDivided);
+			}
+#pragma omp parallel for schedule(static)
+			for (int64_t h = 0; h < int64_t(nHalfEdges); ++h) {
+				if (degenerate[h / 3] || reps[h] != uint(h) || !(lengths[h] > limitSize)) {
+					continue;
+				}
+				const Vector3u& t = tris[h / 3];
+				const uint v0 = t[h % 3], v1 = t[(h % 3 + 1) % 3];
+				verts[nOldVertices + midpoints[h]] = 0.5f * (verts[v0] + verts[v1]);
+				if (withNormals) {
+					norms[nOldVertices + midpoints[h]] = (0.5f * (norms[v0] + norms[v1])).normalized();
+				}
+			}
+
+			nextTris.resize(nNewTris);
+#pragma omp parallel for schedule(static)
+			for (int64_t ti = 0; ti < int64_t(nTris); ++ti) {
+				if (degenerate[ti]) {
+					continue;
+				}
+				const Vector3u& t = tris[ti];
+				Vector3u* out = &nextTris[triOffsets[ti]];
+				std::array<int, 3> ks = { { -1, -1, -1 } };
+				std::array<int, 3> non_ks = { { -1, -1, -1 } };
+				sibr::Vector3i corners_ids, midpoints_ids;
+				for (int k = 0; k < 3; ++k) {
+					const size_t h = 3 * size_t(ti) + k;
+					const uint r = reps[h];
+					const Vector3u& rt = tris[r / 3];
+					// Corners come from the edges, duplicated seam vertices are merged.
+					corners_ids[k] = int(t[k] != rt[r % 3] ? rt[(r % 3 + 1) % 3] : rt[r % 3]);
+					if (lengths[r] > limitSize) {
+						midpoints_ids[k] = int(nOldVertices + midpoints[r]);
+						if (ks[0] < 0) {
+							ks[0] = k;
+						}
+						else if (ks[1] < 0) {
+							ks[1] = k;
+						}
+						else {
+							ks[2] = k;
+						}
+					}
+					else {
+						midpoints_ids[k] = -1;
+						if (non_ks[0] < 0) {
+							non_ks[0] = k;
+						}
+					}
+				}
+
+				if (ks[2] >= 0) {
+					out[0] = sibr::Vector3u(corners_ids[0], midpoints_ids[0], midpoints_ids[2]);
+					out[1] = sibr::Vector3u(corners_ids[1], midpoints_ids[1], midpoints_ids[0]);
+					out[2] = sibr::Vector3u(corners_ids[2], midpoints_ids[2], midpoints_ids[1]);
+					out[3] = midpoints_ids.cast<unsigned>();
+				}
+				else if (ks[1] >= 0) {
+					const int candidate_edge_1_v_id_1 = corners_ids[non_ks[0]];
+					const int candidate_edge_1_v_id_2 = midpoints_ids[(non_ks[0] + 1) % 3];
+					const int candidate_edge_2_v_id_1 = corners_ids[(non_ks[0] + 1) % 3];
+					const int candidate_edge_2_v_id_2 = midpoints_ids[(non_ks[0] + 2) % 3];
+					const float candidate_edge_1_norm = (verts[candidate_edge_1_v_id_1] - verts[candidate_edge_1_v_id_2]).norm();
+					const float candidate_edge_2_norm = (verts[candidate_edge_2_v_id_1] - verts[candidate_edge_2_v_id_2]).norm();
+					if (candidate_edge_1_norm < candidate_edge_2_norm) {
+						out[0] = sibr::Vector3u(candidate_edge_1_v_id_1, corners_ids[(non_ks[0] + 1) % 3], candidate_edge_1_v_id_2);
+						out[1] = sibr::Vector3u(candidate_edge_1_v_id_2, midpoints_ids[(non_ks[0] + 2) % 3], candidate_edge_1_v_id_1);
+					}
+					else {
+						out[0] = sibr::Vector3u(candidate_edge_2_v_id_1, candidate_edge_2_v_id_2, corners_ids[non_ks[0]]);
+						out[1] = sibr::Vector3u(candidate_edge_2_v_id_1, midpoints_ids[(non_ks[0] + 1) % 3], candidate_edge_2_v_id_2);
+					}
+					out[2] = sibr::Vector3u(midpoints_ids[(non_ks[0] + 1) % 3], corners_ids[(non_ks[0] + 2) % 3], midpoints_ids[(non_ks[0] + 2) % 3]);
+				}
+				else if (ks[0] >= 0) {
+					out[0] = sibr::Vector3u(midpoints_ids[ks[0]], corners_ids[(ks[0] + 1) % 3], corners_ids[(ks[0] + 2) % 3]);
+					out[1] = sibr::Vector3u(midpoints_ids[ks[0]], corners_ids[(ks[0] + 2) % 3], corners_ids[ks[0]]);
+				}
+				else {
+					out[0] = corners_ids.cast<unsigned>();
+				}
+			}
+			tris.swap(nextTris);
+			std::cout << "." << std::flush;
+
+			if (nDivided == 0 || level >= maxRecursion) {
+				break;
+			}
+		}
+
+		auto subMeshPtr = std::make_shared<sibr::Mesh>();
+		subMeshPtr->vertices(std::move(verts));
+		if (withNormals) {
+			subMeshPtr->normals(std::move(norms));
+		}
+		subMeshPtr->triangles(std::move(tris));
+		return subMeshPtr;
+	}
+
+	namespace {
+
+		/** Symmetric 4x4 matrix summing squared distances to planes. */
+		struct Quadric
+		{
+			double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+			/** Add the plane n.p + d = 0, n being normalized. */
+			void addPlane(const Vector3d& n, double d, double weight)
+			{
+				a2 += weight * n.x() * n.x(); ab += weight * n.x() * n.y(); ac += weight * n.x() * n.z(); ad += weight * n.x() * d;
+				b2 += weight * n.y() * n.y(); bc += weight * n.y() * n.z(); bd += weight * n.y() * d;
+				c2 += weight * n.z() * n.z(); cd += weight * n.z() * d;
+				d2 += weight * d * d;
+			}
+
+			Quadric& operator+=(const Quadric& o)
+			{
+				a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2; bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+				return *this;
+			}
+
+			/** \return the sum of the squared distances of p to the planes. */
+			double error(const Vector3d& p) const
+			{
+				const double x = p.x(), y = p.y(), z = p.z();
+				return std::max(0.0, a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+					+ b2 * y * y + 2 * bc * y * z + 2 * bd * y + c2 * z * z + 2 * cd * z + d2);
+			}
+
+			/** Find the position minimizing the error.
+			\param p will contain the position
+			\return false if the system is singular
+			*/
+			bool optimum(Vector3d& p) const
+			{
+				Matrix3d m;
+				m << a2, ab, ac, ab, b2, bc, ac, bc, c2;
+				const double det = m.determinant();
+				if (std::abs(det) < 1e-12 * std::max(1.0, m.cwiseAbs().maxCoeff())) {
+					return false;
+				}
+				p = m.inverse() * Vector3d(-ad, -bd, -cd);
+				return true;
 			}
 		};
 
-		struct Edge {
-			sibr::Vector3f midPoint;
-			sibr::Vector3f midNormal;
-			std::vector<int> triangles_ids;
-			float length;
-			int v_ids[2];
-		};
+		/** Collapse of edge (u,v) at a position. Stamps invalidate the candidates of updated vertices. */
+		struct Collapse
+		{
+			double cost;
+			uint u, v;
+			uint stampU, stampV;
+			Vector3d position;
 
-		struct Triangle {
-			Triangle() : edges_ids(std::vector<int>(3, -1)), edges_flipped(std::vector<bool>(3, false)) {}
-			std::vector<int> edges_ids;
-			std::vector<bool> edges_flipped;
+			bool operator<(const Collapse& other) const { return cost > other.cost; }
 		};
+	}
 
-		auto subMeshPtr = std::make_shared<sibr::Mesh>();
-
-		std::map<sibr::Vector3f, int, Less> mapEdges;
-		std::vector<Edge> edges;
-		std::vector<Triangle> tris(triangles().size());
+	sibr::Mesh::Ptr Mesh::simplify(size_t targetTriangles, float * error) const
+	{
+		const MeshTopology& topo = topology();
+		const std::vector<uint>& cornerOffsets = topo.vertexCornerOffsets();
+		const std::vector<uint>& corners = topo.vertexCorners();
+		const size_t verticesCount = _vertices.size();
+
+		std::vector<Vector3d> positions(verticesCount);
+		for (size_t v = 0; v < verticesCount; ++v) {
+			positions[v] = _vertices[v].cast<double>();
+		}
 
-		int t_id = 0;
-		int e_id = 0;
-		for (const auto& t : triangles()) {
-			bool degenerate = false;
+		// Planes of the triangles, and planes orthogonal to the border edges.
+		Triangles faces = _triangles;
+		std::vector<Quadric> quadrics(verticesCount);
+		std::vector<bool> aliveFaces(faces.size(), true);
+		size_t aliveCount = faces.size();
+		for (size_t f = 0; f < faces.size(); ++f) {
+			const Vector3u& tri = faces[f];
+			Vector3d n = (positions[tri[1]] - positions[tri[0]]).cross(positions[tri[2]] - positions[tri[0]]);
+			if (n.norm() <= 0.0 || tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+				aliveFaces[f] = false;
+				--aliveCount;
+				continue;
+			}
+			n.normalize();
 			for (int k = 0; k < 3; ++k) {
-				int v0 = t[k];
-				int v1 = t[(k + 1) % 3];
-				// Skip degenerate faces.
-				if (v0 == v1) {
-					degenerate = true;
-					break;
+				quadrics[tri[k]].addPlane(n, -n.dot(positions[tri[0]]), 1.0);
+			}
+			for (int k = 0; k < 3; ++k) {
+				const uint a = tri[k];
+				const uint b = tri[(k + 1) % 3];
+				uint shared = 0;
+				for (uint c = cornerOffsets[a]; c < cornerOffsets[a + 1]; ++c) {
+					const Vector3u& other = faces[corners[c] / 3];
+					shared += (other[0] == b || other[1] == b || other[2] == b) ? 1 : 0;
 				}
-				const sibr::Vector3f midPoint = 0.5f * (vertices()[v0] + vertices()[v1]);
-				sibr::Vector3f midNormal(0.0f, 0.0f, 0.0f);
-				if (hasNormals()) {
-					midNormal = (0.5f * (normals()[v0] + normals()[v1])).normalized();
+				if (shared == 1) {
+					const Vector3d edge = positions[b] - positions[a];
+					const Vector3d side = edge.cross(n).normalized();
+					const double weight = 10.0;
+					quadrics[a].addPlane(side, -side.dot(positions[a]), weight);
+					quadrics[b].addPlane(side, -side.dot(positions[a]), weight);
 				}
+			}
+		}
 
-				const float length = (vertices()[v0] - vertices()[v1]).norm();
-				if (mapEdges.count(midPoint) == 0) {
-					mapEdges[midPoint] = e_id;
-					const Edge edge = { midPoint, midNormal, {t_id}, length, {v0,v1} };
-					tris[t_id].edges_ids[k] = e_id;
-					edges.push_back(edge);
-					++e_id;
+		std::vector<std::vector<uint>> vertexFaces(verticesCount);
+		for (size_t v = 0; v < verticesCount; ++v) {
+			for (uint c = cornerOffsets[v]; c < cornerOffsets[v + 1]; ++c) {
+				if (aliveFaces[corners[c] / 3]) {
+					vertexFaces[v].push_back(corners[c] / 3);
 				}
-				else {
-					const int edge_id = mapEdges[midPoint];
-					edges[edge_id].triangles_ids.push_back(t_id);
-					tris[t_id].edges_ids[k] = edge_id;
-					if (v0 != edges[edge_id].v_ids[0]) {
-						tris[t_id].edges_flipped[k] = true;
-					}
-				}
-			}
-			if (degenerate) {
-				continue;
 			}
-			++t_id;
 		}
+		std::vector<bool> aliveVertices(verticesCount, true);
+		std::vector<uint> stamps(verticesCount, 0);
+
+		const auto candidate = [&](uint u, uint v) {
+			Quadric q = quadrics[u];
+			q += quadrics[v];
+			Collapse collapse = { 0.0, u, v, stamps[u], stamps[v], Vector3d() };
+			if (!q.optimum(collapse.position)) {
+				const Vector3d mid = 0.5 * (positions[u] + positions[v]);
+				const double eu = q.error(positions[u]), ev = q.error(positions[v]), em = q.error(mid);
+				collapse.position = eu <= ev && eu <= em ? positions[u] : (ev <= em ? positions[v] : mid);
+			}
+			collapse.cost = q.error(collapse.position);
+			return collapse;
+		};
 
-		const int nOldVertices = (int)vertices().size();
-		sibr::Mesh::Vertices newVertices = vertices();
-		sibr::Mesh::Normals newNormals = normals();
+		std::priority_queue<Collapse> heap;
+		const std::vector<uint>& neighborOffsets = topo.vertexVertexOffsets();
+		const std::vector<uint>& neighbors = topo.vertexVertices();
+		for (uint u = 0; u < uint(verticesCount); ++u) {
+			for (uint n = neighborOffsets[u]; n < neighborOffsets[u + 1]; ++n) {
+				if (neighbors[n] > u) {
+					heap.push(candidate(u, neighbors[n]));
+				}
+			}
+		}
 
-		std::vector<int> edge_to_divided_edges(edges.size(), -1);
+		const auto ringOf = [&](uint v, std::vector<uint>& ring) {
+			ring.clear();
+			for (const uint f : vertexFaces[v]) {
+				for (int k = 0; k < 3; ++k) {
+					if (faces[f][k] != v) {
+						ring.push_back(faces[f][k]);
+					}
+				}
+			}
+			std::sort(ring.begin(), ring.end());
+			ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+		};
 
-		sibr::Mesh::Triangles newTriangles;
+		std::vector<uint> ringU, ringV, common;
+		double maxCost = 0.0;
+		while (aliveCount > targetTriangles && !heap.empty()) {
+			const Collapse collapse = heap.top();
+			heap.pop();
+			const uint u = collapse.u;
+			const uint v = collapse.v;
+			if (!aliveVertices[u] || !aliveVertices[v] || stamps[u] != collapse.stampU || stamps[v] != collapse.stampV) {
+				continue;
+			}
 
-		bool dbg = false;
-		int num_divided_edges = 0;
-		for (const Triangle& t : tris) {
-			// Ignore undef triangles.
-			if (t.edges_ids[0] == -1 && t.edges_ids[1] == -1 && t.edges_ids[2] == -1) {
+			// Link condition: the common neighbors are exactly the apexes of the shared triangles.
+			ringOf(u, ringU);
+			ringOf(v, ringV);
+			common.clear();
+			std::set_intersection(ringU.begin(), ringU.end(), ringV.begin(), ringV.end(), std::back_inserter(common));
+			uint sharedFaces = 0;
+			for (const uint f : vertexFaces[u]) {
+				const Vector3u& tri = faces[f];
+				sharedFaces += (tri[0] == v || tri[1] == v || tri[2] == v) ? 1 : 0;
+			}
+			if (sharedFaces == 0 || common.size() != sharedFaces) {
 				continue;
 			}
-			std::vector<int> ks(3, -1);
-			std::vector<int> non_ks(3, -1);
-			for (int k = 0; k < 3; ++k) {
-				const int e_id = t.edges_ids[k];
-				if (edges[e_id].length > limitSize) {
-					if (ks[0] < 0) {
-						ks[0] = k;
-					}
-					else if (ks[1] < 0) {
-						ks[1] = k;
+
+			// Reject collapses flipping or squashing the remaining triangles.
+			bool valid = true;
+			for (int side = 0; side < 2 && valid; ++side) {
+				const uint moved = side == 0 ? u : v;
+				const uint other = side == 0 ? v : u;
+				for (const uint f : vertexFaces[moved]) {
+					const Vector3u& tri = faces[f];
+					if (tri[0] == other || tri[1] == other || tri[2] == other) {
+						continue;
 					}
-					else {
-						ks[2] = k;
+					std::array<Vector3d, 3> p = { { positions[tri[0]], positions[tri[1]], positions[tri[2]] } };
+					const Vector3d before = (p[1] - p[0]).cross(p[2] - p[0]);
+					for (int k = 0; k < 3; ++k) {
+						if (tri[k] == moved) {
+							p[k] = collapse.position;
+						}
 					}
-
-					if (edge_to_divided_edges[e_id] < 0) {
-						edge_to_divided_edges[e_id] = num_divided_edges;
-						newVertices.push_back(edges[e_id].midPoint);
-						newNormals.push_back(edges[e_id].midNormal);
-						++num_divided_edges;
-
+					const Vector3d after = (p[1] - p[0]).cross(p[2] - p[0]);
+					if (after.dot(before) < 0.2 * after.norm() * before.norm() || after.norm() <= 0.0) {
+						valid = false;
+						break;
 					}
+				}
+			}
+			if (!valid) {
+				continue;
+			}
 
+			// Merge v into u.
+			positions[u] = collapse.position;
+			quadrics[u] += quadrics[v];
+			for (const uint f : vertexFaces[v]) {
+				Vector3u& tri = faces[f];
+				if (tri[0] == u || tri[1] == u || tri[2] == u) {
+					aliveFaces[f] = false;
+					--aliveCount;
+					continue;
 				}
-				else {
-					if (non_ks[0] < 0) {
-						non_ks[0] = k;
+				for (int k = 0; k < 3; ++k) {
+					if (tri[k] == v) {
+						tri[k] = u;
 					}
 				}
+				vertexFaces[u].push_back(f);
 			}
+			vertexFaces[v].clear();
+			aliveVertices[v] = false;
+			for (const uint w : ringU) {
+				std::vector<uint>& wFaces = vertexFaces[w];
+				wFaces.erase(std::remove_if(wFaces.begin(), wFaces.end(), [&](uint f) { return !aliveFaces[f]; }), wFaces.end());
+			}
+			vertexFaces[u].erase(std::remove_if(vertexFaces[u].begin(), vertexFaces[u].end(), [&](uint f) { return !aliveFaces[f]; }), vertexFaces[u].end());
+			++stamps[u];
+			maxCost = std::max(maxCost, collapse.cost);
 
-			const sibr::Vector3i corners_ids = sibr::Vector3i(0, 1, 2).unaryViewExpr([&](int i) {
-				return edges[t.edges_ids[i]].v_ids[t.edges_flipped[i] ? 1 : 0];
-				});
-			const sibr::Vector3i midpoints_ids = sibr::Vector3i(0, 1, 2).unaryViewExpr([&](int i) {
-				return  edge_to_divided_edges[t.edges_ids[i]] >= 0 ? nOldVertices + edge_to_divided_edges[t.edges_ids[i]] : -1;
-				});
+			ringOf(u, ringU);
+			for (const uint w : ringU) {
+				heap.push(candidate(std::min(u, w), std::max(u, w)));
+			}
+		}
 
-			if (ks[2] >= 0) {
-				newTriangles.push_back(sibr::Vector3u(corners_ids[0], midpoints_ids[0], midpoints_ids[2]));
-				newTriangles.push_back(sibr::Vector3u(corners_ids[1], midpoints_ids[1], midpoints_ids[0]));
-				newTriangles.push_back(sibr::Vector3u(corners_ids[2], midpoints_ids[2], midpoints_ids[1]));
-				newTriangles.push_back(midpoints_ids.cast<unsigned>());
+		// Compact the remaining vertices and faces.
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> remap(verticesCount, unused);
+		Vertices newVertices;
+		Normals newNormals;
+		Colors newColors;
+		UVs newUVs;
+		Triangles newTriangles;
+		newTriangles.reserve(aliveCount);
+		for (size_t f = 0; f < faces.size(); ++f) {
+			if (!aliveFaces[f]) {
+				continue;
 			}
-			else if (ks[1] >= 0) {
-				const int candidate_edge_1_v_id_1 = corners_ids[non_ks[0]];
-				const int candidate_edge_1_v_id_2 = midpoints_ids[(non_ks[0] + 1) % 3];
-				const int candidate_edge_2_v_id_1 = corners_ids[(non_ks[0] + 1) % 3];
-				const int candidate_edge_2_v_id_2 = midpoints_ids[(non_ks[0] + 2) % 3];
-				const float candidate_edge_1_norm = (newVertices[candidate_edge_1_v_id_1] - newVertices[candidate_edge_1_v_id_2]).norm();
-				const float candidate_edge_2_norm = (newVertices[candidate_edge_2_v_id_1] - newVertices[candidate_edge_2_v_id_2]).norm();
-				if (candidate_edge_1_norm < candidate_edge_2_norm) {
-					newTriangles.push_back(sibr::Vector3u(candidate_edge_1_v_id_1, corners_ids[(non_ks[0] + 1) % 3], candidate_edge_1_v_id_2));
-					newTriangles.push_back(sibr::Vector3u(candidate_edge_1_v_id_2, midpoints_ids[(non_ks[0] + 2) % 3], candidate_edge_1_v_id_1));
-				}
-				else {
-					newTriangles.push_back(sibr::Vector3u(candidate_edge_2_v_id_1, candidate_edge_2_v_id_2, corners_ids[non_ks[0]]));
-					newTriangles.push_back(sibr::Vector3u(candidate_edge_2_v_id_1, midpoints_ids[(non_ks[0] + 1) % 3], candidate_edge_2_v_id_2));
+			Vector3u tri;
+			for (int k = 0; k < 3; ++k) {
+				const uint v = faces[f][k];
+				if (remap[v] == unused) {
+					remap[v] = uint(newVertices.size());
+					newVertices.push_back(positions[v].cast<float>());
+					if (hasNormals()) {
+						newNormals.push_back(_normals[v]);
+					}
+					if (hasColors()) {
+						newColors.push_back(_colors[v]);
+					}
+					if (hasTexCoords()) {
+						newUVs.push_back(_texcoords[v]);
+					}
 				}
-				newTriangles.push_back(sibr::Vector3u(midpoints_ids[(non_ks[0] + 1) % 3], corners_ids[(non_ks[0] + 2) % 3], midpoints_ids[(non_ks[0] + 2) % 3]));
-			}
-			else if (ks[0] >= 0) {
-				newTriangles.push_back(sibr::Vector3u(midpoints_ids[ks[0]], corners_ids[(ks[0] + 1) % 3], corners_ids[(ks[0] + 2) % 3]));
-				newTriangles.push_back(sibr::Vector3u(midpoints_ids[ks[0]], corners_ids[(ks[0] + 2) % 3], corners_ids[ks[0]]));
-			}
-			else {
-				newTriangles.push_back(corners_ids.cast<unsigned>());
+				tri[k] = remap[v];
 			}
+			newTriangles.push_back(tri);
 		}
-		std::cout << "." << std::flush;
 
-		subMeshPtr->vertices(newVertices);
+		auto simplified = std::make_shared<sibr::Mesh>(_gl.bufferGL != nullptr);
+		simplified->vertices(newVertices);
+		simplified->triangles(newTriangles);
 		if (hasNormals()) {
-			subMeshPtr->normals(newNormals);
+			simplified->normals(newNormals);
+		}
+		if (hasColors()) {
+			simplified->colors(newColors);
 		}
-		subMeshPtr->triangles(newTriangles);
-		if (num_divided_edges > 0 && maxRecursion > 0) {
-			return subMeshPtr->subDivide(limitSize, maxRecursion - 1);
+		if (hasTexCoords()) {
+			simplified->texCoords(newUVs);
 		}
-
-		return subMeshPtr;
+		if (error) {
+			*error = float(std::sqrt(maxCost));
+		}
+		return simplified;
 	}
 
 	float Mesh::meanEdgeSize() const
@@ -2224,6 +3670,35 @@ namespace sibr
 		return (float)(sumSizes / (3 * triangles().size()));
 	}
 
+	bool Mesh::updateAttributes(const Mesh & other)
+	{
+		if (other._vertices.size() != _vertices.size() || other.hasNormals() != hasNormals()
+			|| other.hasColors() != hasColors() || other.hasTexCoords() != hasTexCoords() || other._triangles != _triangles) {
+			return false;
+		}
+		// Copy the runs of changed vertices, each run is uploaded as a range.
+		const auto update = [this](auto & dst, const auto & src, uint location) {
+			size_t v = 0;
+			while (v < dst.size()) {
+				if (dst[v] == src[v]) {
+					++v;
+					continue;
+				}
+				const size_t begin = v;
+				while (v < dst.size() && dst[v] != src[v]) {
+					dst[v] = src[v];
+					++v;
+				}
+				markVerticesDirty(1u << location, begin, v);
+			}
+		};
+		update(_vertices, other._vertices, MeshBufferGL::VertexAttribLocation);
+		update(_normals, other._normals, MeshBufferGL::NormalAttribLocation);
+		update(_colors, other._colors, MeshBufferGL::ColorAttribLocation);
+		update(_texcoords, other._texcoords, MeshBufferGL::TexCoordAttribLocation);
+		return true;
+	}
+
 	Mesh::Ptr Mesh::clone() const
 	{
 		auto outMesh = std::make_shared<sibr::Mesh>(_gl.bufferGL != nullptr);
@@ -2247,44 +3722,102 @@ namespace sibr
 
 	void		Mesh::merge(const Mesh& other)
 	{
-		bool withGraphics = (_gl.bufferGL != nullptr);
-
 		if (_vertices.empty())
 		{
+			const bool withGraphics = (_gl.bufferGL != nullptr);
 			this->operator = (other);
+			restoreGraphics(withGraphics);
 		}
 		else
 		{
-			Vertices	vertices;
-			Normals		normals;
-			Colors		colors;
-			UVs			texcoords;
-
-			const uint offset = static_cast<uint>(_vertices.size());
-			Vector3u	triOffset(offset, offset, offset);
-			Triangles	triangles = other.triangles();
-
-			for (Vector3u& t : triangles)
-				t += triOffset;
-
+			appendMeshes({ &other });
+		}
+	}
 
-			if (hasNormals())
-				_normals.insert(_normals.end(), other.normals().begin(), other.normals().end());
+	void		Mesh::merge(Mesh&& other)
+	{
+		if (_vertices.empty())
+		{
+			// Steal the buffers of the other mesh.
+			const bool withGraphics = (_gl.bufferGL != nullptr);
+			this->operator = (std::move(other));
+			restoreGraphics(withGraphics);
+		}
+		else
+		{
+			appendMeshes({ &other });
+		}
+	}
 
-			if (hasColors())
-				_colors.insert(_colors.end(), other.colors().begin(), other.colors().end());
+	void		Mesh::merge(const std::vector<Mesh::Ptr>& others)
+	{
+		std::vector<const Mesh*> parts;
+		parts.reserve(others.size());
+		for (const Mesh::Ptr& other : others) {
+			if (other && !other->vertices().empty()) {
+				parts.push_back(other.get());
+			}
+		}
+		if (parts.empty()) {
+			return;
+		}
+		if (_vertices.empty()) {
+			merge(*parts.front());
+			parts.erase(parts.begin());
+		}
+		appendMeshes(parts);
+	}
 
-			if (hasTexCoords())
-				_texcoords.insert(_texcoords.end(), other.texCoords().begin(), other.texCoords().end());
+	void		Mesh::restoreGraphics(bool withGraphics)
+	{
+		if (withGraphics && !_gl.bufferGL) {
+			_gl.bufferGL.reset(new MeshBufferGL);
+		}
+		_gl.dirtyBufferGL = true;
+		_gl.dirtyRanges.clear();
+	}
 
+	void		Mesh::appendMeshes(const std::vector<const Mesh*>& parts)
+	{
+		// Attributes are kept if all meshes have them.
+		size_t verticesCount = _vertices.size();
+		size_t trianglesCount = _triangles.size();
+		bool keepNormals = hasNormals();
+		bool keepColors = hasColors();
+		bool keepUVs = hasTexCoords();
+		for (const Mesh* part : parts) {
+			verticesCount += part->vertices().size();
+			trianglesCount += part->triangles().size();
+			keepNormals = keepNormals && part->hasNormals();
+			keepColors = keepColors && part->hasColors();
+			keepUVs = keepUVs && part->hasTexCoords();
+		}
+		if (verticesCount > size_t(std::numeric_limits<uint>::max())) {
+			SIBR_ERR << "Merged mesh has too many vertices for 32 bits indices." << std::endl;
+		}
 
-			_vertices.insert(_vertices.end(), other.vertices().begin(), other.vertices().end());
-			_triangles.insert(_triangles.end(), triangles.begin(), triangles.end());
+		_vertices.reserve(verticesCount);
+		_triangles.reserve(trianglesCount);
+		reserveAttribute(_normals, keepNormals, verticesCount);
+		reserveAttribute(_colors, keepColors, verticesCount);
+		reserveAttribute(_texcoords, keepUVs, verticesCount);
 
+		for (const Mesh* part : parts) {
+			const uint offset = static_cast<uint>(_vertices.size());
+			const Vector3u triOffset(offset, offset, offset);
+			for (const Vector3u& t : part->triangles()) {
+				_triangles.push_back(t + triOffset);
+			}
+			_vertices.insert(_vertices.end(), part->vertices().begin(), part->vertices().end());
+			if (keepNormals)
+				_normals.insert(_normals.end(), part->normals().begin(), part->normals().end());
+			if (keepColors)
+				_colors.insert(_colors.end(), part->colors().begin(), part->colors().end());
+			if (keepUVs)
+				_texcoords.insert(_texcoords.end(), part->texCoords().begin(), part->texCoords().end());
 		}
-
-		if (withGraphics)
-			_gl.bufferGL.reset(new MeshBufferGL);
+		invalidateTopology();
+		restoreGraphics(_gl.bufferGL != nullptr);
 	}
 
 	void sibr::Mesh::makeWhole(void)
@@ -2302,88 +3835,49 @@ namespace sibr
 
 	void		Mesh::eraseTriangles(const std::vector<uint>& faceIDList)
 	{
-		uint indexMax = 0;
-		for (uint i = 0; i < triangles().size(); ++i)
-			indexMax = std::max(indexMax, triangles()[i].maxCoeff());
-
 		std::vector<bool>	faceToErase(triangles().size(), false);
 		for (uint faceID : faceIDList)
-			faceToErase[faceID] = true;
-
-
-		Mesh::Triangles		newTris;
-		Mesh::Vertices		newVerts;
-		std::vector<int>	indexRemap(indexMax + 1, -1);
-
-		newTris.reserve(triangles().size());
-		newVerts.reserve(vertices().size());
-
-		for (uint i = 0; i < triangles().size(); ++i)
+			if (faceID < faceToErase.size())
+				faceToErase[faceID] = true;
+
+		// Compact the triangles in place, flagging the vertices still in use.
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> remap(_vertices.size(), unused);
+		size_t keptTriangles = 0;
+		for (size_t i = 0; i < _triangles.size(); ++i)
 		{
 			if (faceToErase[i])
 				continue;
-
-			Vector3u t = triangles()[i];
-			Vector3u newT;
 			for (uint j = 0; j < 3; ++j)
-			{
-				if (indexRemap[t[j]] == -1)
-				{
-					indexRemap[t[j]] = (int)newVerts.size();
-					newVerts.push_back(vertices().at(t[j]));
-				}
-				newT[j] = (uint)indexRemap[t[j]];
-
-			}
-
-			newTris.push_back(newT);
-		}
-
-		if (hasColors())
-		{
-			Mesh::Colors	newColors(newVerts.size());
-			for (uint i = 0; i < indexRemap.size(); ++i)
-				if (indexRemap[i] != -1)
-					newColors[indexRemap[i]] = colors().at(i);
-			colors(newColors);
-		}
-
-		if (hasNormals())
-		{
-			Mesh::Normals	newNormals(newVerts.size());
-			for (uint i = 0; i < indexRemap.size(); ++i)
-				if (indexRemap[i] != -1)
-					newNormals[indexRemap[i]] = normals().at(i);
-			normals(newNormals);
+				remap[_triangles[i][j]] = 0;
+			_triangles[keptTriangles++] = _triangles[i];
 		}
-
-
-		if (hasTexCoords())
-		{
-			Mesh::UVs	newUVs(newVerts.size());
-			for (uint i = 0; i < indexRemap.size(); ++i)
-				if (indexRemap[i] != -1)
-					newUVs[indexRemap[i]] = texCoords().at(i);
-			texCoords(newUVs);
-		}
-
-		triangles(newTris);
-		vertices(newVerts);
+		_triangles.resize(keptTriangles);
+
+		// Remaining vertices keep their relative order.
+		uint keptVertices = 0;
+		for (uint& id : remap)
+			if (id != unused)
+				id = keptVertices++;
+		for (Vector3u& t : _triangles)
+			t = Vector3u(remap[t[0]], remap[t[1]], remap[t[2]]);
+
+		compactAttribute(_vertices, remap, keptVertices);
+		compactAttribute(_colors, remap, keptVertices);
+		compactAttribute(_normals, remap, keptVertices);
+		compactAttribute(_texcoords, remap, keptVertices);
+
+		invalidateTopology();
+		_gl.dirtyBufferGL = true;
 	}
 
 	std::vector<std::vector<int> > Mesh::removeDisconnectedComponents()
 	{
 		std::vector<std::vector<int> > allComponents;
 
-		std::vector<std::vector<int>> v_triangles(vertices().size());
-		int t_id = 0;
-		for (const auto& t : triangles()) {
-			for (int k = 0; k < 3; ++k) {
-				v_triangles[t[k]].push_back(t_id);
-			}
-			++t_id;
-		}
-
+		const MeshTopology& topo = topology();
+		const std::vector<uint>& offsets = topo.vertexVertexOffsets();
+		const std::vector<uint>& neighbors = topo.vertexVertices();
 
 		std::vector<bool> wasVisited(vertices().size(), false);
 		int v_id = 0;
@@ -2401,13 +3895,11 @@ namespace sibr
 					next_ids.pop();
 					component.push_back(next_id);
 
-					for (int t : v_triangles[next_id]) {
-						for (int k = 0; k < 3; ++k) {
-							int other_v_id = triangles()[t][k];
-							if (!wasVisited[other_v_id]) {
-								next_ids.push(other_v_id);
-								wasVisited[other_v_id] = true;
-							}
+					for (uint n = offsets[next_id]; n < offsets[next_id + 1]; ++n) {
+						const int other_v_id = int(neighbors[n]);
+						if (!wasVisited[other_v_id]) {
+							next_ids.push(other_v_id);
+							wasVisited[other_v_id] = true;
 						}
 					}
 				}
@@ -2420,4 +3912,328 @@ namespace sibr
 		return allComponents;
 	}
 
+	namespace {
+
+		/** Score of a vertex in Forsyth's vertex cache optimization: recently used vertices come first,
+		 then vertices with few remaining triangles, so that they are not left behind.
+		\param cachePos the position of the vertex in the LRU cache, -1 if it isn't in it
+		\param remaining the number of triangles of the vertex not emitted yet
+		\param cacheSize the LRU cache size
+		\return the vertex score
+		*/
+		float forsythScore(int cachePos, uint remaining, uint cacheSize)
+		{
+			if (remaining == 0) {
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cachePos >= 0) {
+				if (cachePos < 3) {
+					// The vertices of the last triangle get a fixed score, to avoid favoring a particular one.
+					score = 0.75f;
+				}
+				else {
+					score = std::pow(1.0f - float(cachePos - 3) / float(cacheSize - 3), 1.5f);
+				}
+			}
+			return score + 2.0f / std::sqrt(float(remaining));
+		}
+
+		/** Reorder a per vertex attribute.
+		\param data the attribute, left untouched if it doesn't have one value per vertex
+		\param remap the new index of each vertex
+		*/
+		template<typename T>
+		void remapAttribute(std::vector<T>& data, const std::vector<uint>& remap)
+		{
+			if (data.size() != remap.size()) {
+				return;
+			}
+			std::vector<T> remapped(data.size());
+			for (size_t i = 0; i < data.size(); ++i) {
+				remapped[remap[i]] = data[i];
+			}
+			data.swap(remapped);
+		}
+	}
+
+	void Mesh::optimizeVertexCache(uint cacheSize)
+	{
+		if (_triangles.empty()) {
+			return;
+		}
+		cacheSize = std::max(cacheSize, 4u);
+
+		const MeshTopology& topo = topology();
+		const std::vector<uint>& offsets = topo.vertexCornerOffsets();
+		const std::vector<uint>& corners = topo.vertexCorners();
+		const int64_t verticesCount = int64_t(_vertices.size());
+		const int64_t trianglesCount = int64_t(_triangles.size());
+
+		std::vector<uint> remaining(_vertices.size());
+		std::vector<int> cachePos(_vertices.size(), -1);
+		std::vector<float> vertexScores(_vertices.size());
+#pragma omp parallel for
+		for (int64_t v = 0; v < verticesCount; ++v) {
+			remaining[v] = offsets[v + 1] - offsets[v];
+			vertexScores[v] = forsythScore(-1, remaining[v], cacheSize);
+		}
+		std::vector<float> triangleScores(_triangles.size());
+#pragma omp parallel for
+		for (int64_t t = 0; t < trianglesCount; ++t) {
+			const Vector3u& tri = _triangles[t];
+			triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+		}
+
+		std::vector<bool> emitted(_triangles.size(), false);
+		std::vector<uint> cache, newCache;
+		cache.reserve(cacheSize + 3);
+		newCache.reserve(cacheSize + 3);
+		Triangles reordered;
+		reordered.reserve(_triangles.size());
+
+		int64_t best = -1;
+		int64_t cursor = 0;
+		while (int64_t(reordered.size()) < trianglesCount) {
+			// Nothing left around the cache, restart from the next triangle in the original order.
+			if (best < 0) {
+				while (emitted[cursor]) {
+					++cursor;
+				}
+				best = cursor;
+			}
+			const Vector3u tri = _triangles[best];
+			emitted[best] = true;
+			reordered.push_back(tri);
+
+			// Move the triangle vertices at the front of the cache, evicted ones end up after cacheSize.
+			newCache.clear();
+			for (int k = 0; k < 3; ++k) {
+				--remaining[tri[k]];
+				if (std::find(newCache.begin(), newCache.end(), tri[k]) == newCache.end()) {
+					newCache.push_back(tri[k]);
+				}
+			}
+			for (const uint v : cache) {
+				if (v != tri[0] && v != tri[1] && v != tri[2]) {
+					newCache.push_back(v);
+				}
+			}
+			for (size_t i = 0; i < newCache.size(); ++i) {
+				const uint v = newCache[i];
+				cachePos[v] = i < cacheSize ? int(i) : -1;
+				vertexScores[v] = forsythScore(cachePos[v], remaining[v], cacheSize);
+			}
+
+			// Only the triangles around these vertices changed, pick the best of them.
+			best = -1;
+			float bestScore = -1.0f;
+			for (const uint v : newCache) {
+				for (uint c = offsets[v]; c < offsets[v + 1]; ++c) {
+					const uint t = corners[c] / 3;
+					if (emitted[t]) {
+						continue;
+					}
+					const Vector3u& other = _triangles[t];
+					triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+					if (triangleScores[t] > bestScore) {
+						bestScore = triangleScores[t];
+						best = t;
+					}
+				}
+			}
+			if (newCache.size() > cacheSize) {
+				newCache.resize(cacheSize);
+			}
+			cache.swap(newCache);
+		}
+
+		// Same triangles in another order, the topology is rebuilt on demand.
+		_triangles.swap(reordered);
+		invalidateTopology();
+		_gl.dirtyBufferGL = true;
+	}
+
+	void Mesh::optimizeVertexFetch(void)
+	{
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> remap(_vertices.size(), unused);
+		uint next = 0;
+		for (const Vector3u& tri : _triangles) {
+			for (int k = 0; k < 3; ++k) {
+				if (remap[tri[k]] == unused) {
+					remap[tri[k]] = next++;
+				}
+			}
+		}
+		for (uint& id : remap) {
+			if (id == unused) {
+				id = next++;
+			}
+		}
+
+		remapAttribute(_normals, remap);
+		remapAttribute(_colors, remap);
+		remapAttribute(_texcoords, remap);
+		remapAttribute(_vertices, remap);
+		for (Vector3u& tri : _triangles) {
+			tri = Vector3u(remap[tri[0]], remap[tri[1]], remap[tri[2]]);
+		}
+		invalidateTopology();
+		_gl.dirtyBufferGL = true;
+	}
+
+	void Mesh::sortTrianglesSpatially(void)
+	{
+		if (_triangles.empty()) {
+			return;
+		}
+		Eigen::AlignedBox<float, 3> box;
+		for (const Vector3u& tri : _triangles) {
+			for (int k = 0; k < 3; ++k) {
+				box.extend(_vertices[tri[k]]);
+			}
+		}
+		const Vector3f scale = (box.sizes().array().max(std::numeric_limits<float>::epsilon()).inverse() * 1023.0f).matrix();
+
+		// 30 bits Morton codes of the centroids, ties are broken by the original order.
+		const auto spread = [](uint x) {
+			x = (x | (x << 16)) & 0x030000FF;
+			x = (x | (x << 8)) & 0x0300F00F;
+			x = (x | (x << 4)) & 0x030C30C3;
+			x = (x | (x << 2)) & 0x09249249;
+			return x;
+		};
+		std::vector<std::pair<uint, uint>> codes(_triangles.size());
+		const int64_t trianglesCount = int64_t(_triangles.size());
+#pragma omp parallel for
+		for (int64_t t = 0; t < trianglesCount; ++t) {
+			const Vector3u& tri = _triangles[t];
+			const Vector3f centroid = (_vertices[tri[0]] + _vertices[tri[1]] + _vertices[tri[2]]) / 3.0f;
+			const Vector3f cell = (centroid - box.min()).cwiseProduct(scale);
+			const uint x = uint(sibr::clamp(cell.x(), 0.0f, 1023.0f));
+			const uint y = uint(sibr::clamp(cell.y(), 0.0f, 1023.0f));
+			const uint z = uint(sibr::clamp(cell.z(), 0.0f, 1023.0f));
+			codes[t] = std::make_pair((spread(x) << 2) | (spread(y) << 1) | spread(z), uint(t));
+		}
+		std::sort(codes.begin(), codes.end());
+
+		Triangles sorted(_triangles.size());
+		for (size_t t = 0; t < codes.size(); ++t) {
+			sorted[t] = _triangles[codes[t].second];
+		}
+		_triangles.swap(sorted);
+		invalidateTopology();
+		_gl.dirtyBufferGL = true;
+	}
+
+	void Mesh::optimizeForRendering(void)
+	{
+		const float before = vertexCacheMissRatio();
+		sortTrianglesSpatially();
+		optimizeVertexCache();
+		optimizeVertexFetch();
+		SIBR_LOG << "Optimized mesh for rendering, vertex shader runs per triangle: " << before << " -> " << vertexCacheMissRatio() << std::endl;
+	}
+
+	float Mesh::vertexCacheMissRatio(uint cacheSize) const
+	{
+		if (_triangles.empty()) {
+			return 0.0f;
+		}
+		// A vertex is in the FIFO if less than cacheSize vertices were inserted after it.
+		std::vector<size_t> insertion(_vertices.size(), 0);
+		size_t misses = 0;
+		for (const Vector3u& tri : _triangles) {
+			for (int k = 0; k < 3; ++k) {
+				size_t& stamp = insertion[tri[k]];
+				if (stamp == 0 || misses + 1 - stamp > cacheSize) {
+					++misses;
+					stamp = misses;
+				}
+			}
+		}
+		return float(misses) / float(_triangles.size());
+	}
+
+	Mesh::Meshlets Mesh::buildMeshlets(uint maxVertices, uint maxTriangles) const
+	{
+		maxVertices = sibr::clamp(maxVertices, 3u, 256u);
+		maxTriangles = std::max(maxTriangles, 1u);
+
+		Meshlets result;
+		const uint unused = std::numeric_limits<uint>::max();
+		std::vector<uint> local(_vertices.size(), unused);
+		const auto start = [&result]() {
+			const Meshlet meshlet = { uint(result.vertices.size()), 0, uint(result.triangles.size()), 0,
+				Vector3f(0.0f, 0.0f, 0.0f), 0.0f, Vector3f(0.0f, 0.0f, 1.0f), 1.0f };
+			return meshlet;
+		};
+		Meshlet current = start();
+
+		const auto finish = [&]() {
+			const uint* ids = result.vertices.data() + current.vertexOffset;
+			Eigen::AlignedBox<float, 3> box;
+			for (uint i = 0; i < current.vertexCount; ++i) {
+				box.extend(_vertices[ids[i]]);
+				local[ids[i]] = unused;
+			}
+			current.center = box.center();
+			current.radius = 0.0f;
+			for (uint i = 0; i < current.vertexCount; ++i) {
+				current.radius = std::max(current.radius, (_vertices[ids[i]] - current.center).norm());
+			}
+
+			// Normal cone of the non degenerate triangles.
+			const uint8_t* tris = result.triangles.data() + current.triangleOffset;
+			std::vector<Vector3f> normals;
+			normals.reserve(current.triangleCount);
+			Vector3f axis(0.0f, 0.0f, 0.0f);
+			for (uint t = 0; t < current.triangleCount; ++t) {
+				const Vector3f& v0 = _vertices[ids[tris[3 * t]]];
+				const Vector3f normal = (_vertices[ids[tris[3 * t + 1]]] - v0).cross(_vertices[ids[tris[3 * t + 2]]] - v0);
+				const float len = normal.norm();
+				if (len > std::numeric_limits<float>::epsilon()) {
+					normals.push_back(normal / len);
+					axis += normals.back();
+				}
+			}
+			if (axis.norm() > std::numeric_limits<float>::epsilon()) {
+				current.coneAxis = axis.normalized();
+				float minDot = 1.0f;
+				for (const Vector3f& n : normals) {
+					minDot = std::min(minDot, n.dot(current.coneAxis));
+				}
+				// Wide cones are never culled.
+				if (minDot > 0.1f) {
+					current.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+				}
+			}
+			result.meshlets.push_back(current);
+			current = start();
+		};
+
+		for (const Vector3u& tri : _triangles) {
+			uint added = 0;
+			for (int k = 0; k < 3; ++k) {
+				added += (local[tri[k]] == unused && (k == 0 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1])) ? 1 : 0;
+			}
+			if (current.vertexCount + added > maxVertices || current.triangleCount + 1 > maxTriangles) {
+				finish();
+			}
+			for (int k = 0; k < 3; ++k) {
+				if (local[tri[k]] == unused) {
+					local[tri[k]] = current.vertexCount++;
+					result.vertices.push_back(tri[k]);
+				}
+				result.triangles.push_back(uint8_t(local[tri[k]]));
+			}
+			++current.triangleCount;
+		}
+		if (current.triangleCount > 0) {
+			finish();
+		}
+		return result;
+	}
+
 } // namespace sibr
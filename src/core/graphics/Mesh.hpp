@@ -19,6 +19,7 @@
 # include "core/graphics/Config.hpp"
 # include "core/system/Vector.hpp"
 # include "core/graphics/MeshBufferGL.hpp"
+# include "core/graphics/MeshTopology.hpp"
 # include "core/graphics/Image.hpp"
 
 // Be sure to use STL objects from client's dll version by exporting this declaration (see warning C4251)
@@ -62,6 +63,41 @@ namespace sibr
 			bool adjacency = false;
 		};
 
+		/** Contiguous elements of a mesh array, iterable by CGAL or OpenMesh style containers
+		(polygon soups, add_vertex/add_face loops) without copying them. */
+		template<typename T>
+		struct Range {
+			const T * first = nullptr; ///< First element.
+			size_t count = 0; ///< Number of elements.
+
+			const T * begin() const { return first; }
+			const T * end() const { return first + count; }
+			size_t size() const { return count; }
+			bool empty() const { return count == 0; }
+			const T & operator[](size_t i) const { return first[i]; }
+		};
+
+		/** Binary view over the arrays of a mesh, to hand it to external processing without serialization.
+		Positions, normals and colors are packed float triplets, texture coordinates float pairs and triangles
+		uint triplets. Absent attributes are nullptr. The view does not own the data: a view of a mesh is
+		valid until the mesh arrays are modified.
+		*/
+		struct BufferView {
+			const float * positions = nullptr; ///< Vertex positions.
+			size_t vertexCount = 0; ///< Number of vertices.
+			const uint * indices = nullptr; ///< Triangle vertex indices.
+			size_t triangleCount = 0; ///< Number of triangles.
+			const float * normals = nullptr; ///< Optional vertex normals.
+			const float * colors = nullptr; ///< Optional vertex colors.
+			const float * texCoords = nullptr; ///< Optional vertex texture coordinates.
+
+			/** \return the positions as a range of points. */
+			Range<Vector3f> points() const { return { reinterpret_cast<const Vector3f*>(positions), vertexCount }; }
+
+			/** \return the triangles as a range of index triplets. */
+			Range<Vector3u> faces() const { return { reinterpret_cast<const Vector3u*>(indices), triangleCount }; }
+		};
+
 
 	public:
 
@@ -75,6 +111,11 @@ namespace sibr
 		*/
 		inline void	vertices(const Vertices& vertices);
 
+		/** Set vertices, taking the storage of the given vector.
+		\param vertices the new vertices
+		*/
+		inline void	vertices(Vertices&& vertices);
+
 		/** Set vertices from a vector of floats (linear).
 		\param vertices the new vertices
 		*/
@@ -86,13 +127,34 @@ namespace sibr
 		/** Update a specific vertex position
 		\param vertex_id the vertex location in the list
 		\param v the new value
-		\note If the mesh is used by the GPU, data will be udpated.
+		\note If the mesh is used by the GPU, only the modified vertices will be uploaded.
 		*/
 		inline void replaceVertice(int vertex_id, const sibr::Vector3f & v) ;
 
+		/** Update a specific vertex color
+		\param vertex_id the vertex location in the list
+		\param c the new value
+		\note If the mesh is used by the GPU, only the modified vertices will be uploaded.
+		*/
+		inline void replaceColor(int vertex_id, const sibr::Vector3f & c);
+
+		/** Update a specific vertex normal
+		\param vertex_id the vertex location in the list
+		\param n the new value
+		\note If the mesh is used by the GPU, only the modified vertices will be uploaded.
+		*/
+		inline void replaceNormal(int vertex_id, const sibr::Vector3f & n);
+
 		/** \return a deep copy of the mesh. */
 		Mesh::Ptr clone() const;
 
+		/** Copy the vertex attributes of a mesh with the same triangles, for instance the same file reloaded
+		 after its vertices were edited: only the vertices that changed are uploaded to the GPU.
+		\param other the new mesh
+		\return false if the triangles or the available attributes differ, the mesh is then left untouched
+		*/
+		bool updateAttributes(const Mesh & other);
+
 		/** \return vertices in an array using the following format:
 		 {0x, 0y, 0z, 1x, 1y, 1z, 2x, 2y, 2z, ...}.
 		 Useful for rendering and converting to another mesh
@@ -105,6 +167,11 @@ namespace sibr
 		 \param triangles the list of indices to use
 		 */
 		inline void	triangles(const Triangles& triangles);
+
+		/** Set triangles, taking the storage of the given vector.
+		 \param triangles the list of indices to use
+		 */
+		inline void	triangles(Triangles&& triangles);
 		
 		/** Set triangles. Using a flat vector of uints.
 		\param triangles the new indices
@@ -126,6 +193,11 @@ namespace sibr
 		*/
 		inline void	colors( const Colors& colors );
 
+		/** Set vertex colors, taking the storage of the given vector.
+		\param colors the new vertex colors
+		*/
+		inline void	colors( Colors&& colors );
+
 		/** \return a reference to the vertex color list. */
 		inline const Colors& colors( void ) const;
 
@@ -143,6 +215,11 @@ namespace sibr
 		*/
 		inline void	texCoords( const UVs& texcoords );
 
+		/** Set vertex texture coordinates, taking the storage of the given vector.
+		\param texcoords the new vertex texture coordinates
+		*/
+		inline void	texCoords( UVs&& texcoords );
+
 		/** Set texture coordinates using a flat vector of floats.
 		\param texcoords the new vertex texture coordinates
 		*/
@@ -163,11 +240,21 @@ namespace sibr
 		/** \return texture image file name */
 		std::string getTextureImageFileName()	const { return _textureImageFileName; }
 
+		/** Set the texture image file name.
+		\param filename the file name, relative to the mesh directory
+		*/
+		void setTextureImageFileName(const std::string & filename) { _textureImageFileName = filename; }
+
 		/** Set vertex normals.
 		\param normals the new vertex normals
 		*/
 		inline void	normals(const Normals& normals);
 
+		/** Set vertex normals, taking the storage of the given vector.
+		\param normals the new vertex normals
+		*/
+		inline void	normals(Normals&& normals);
+
 		/** Set normals using a flat vector of floats.
 		\param normals the new vertex normals
 		*/
@@ -210,6 +297,13 @@ namespace sibr
 		 */
 		void	generateSmoothNormalsDisconnected(int numIter);
 
+		/** Connectivity of the mesh, built on first use and shared by the topology based algorithms.
+		It is kept until the triangles or the number of vertices change.
+		\return the topology
+		\warning Not thread safe the first time it is called after a change.
+		*/
+		const MeshTopology&	topology(void) const;
+
 		/** Perform laplacian smoothing on the mesh vertices.
 		\param numIter smoothing iteration count
 		\param updateNormals should the normals be recomputed after smoothing
@@ -287,6 +381,18 @@ namespace sibr
 		*/
 		void fromOffStream(std::stringstream& stream, bool generateNormals = true);
 
+		/** \return a zero-copy view over the arrays of the mesh, valid until they are modified.
+		 \sa BufferView
+		*/
+		BufferView bufferView(void) const;
+
+		/** Copy the arrays of a binary view, without parsing. Attributes absent from the view are cleared.
+		The arrays of another mesh can be taken without copy with the rvalue setters instead.
+		\param view the arrays to copy, they can come from CGAL, OpenMesh or another library
+		\param generateNormals should the normals be generated when the view has none
+		*/
+		void fromBufferView(const BufferView & view, bool generateNormals = true);
+
 		/** Render the geometry using OpenGL.
 		\param depthTest should depth testing be performed
 		\param backFaceCulling should culling be performed
@@ -306,6 +412,61 @@ namespace sibr
 			bool adjacency = false
 		) const;
 
+		/** Render the geometry using OpenGL, skipping the clusters of triangles outside of a view frustum.
+		Clusters are runs of consecutive triangles, they are the tightest after optimizeForRendering.
+		Point clouds and small meshes are rendered whole.
+		\param viewproj the projection matrix used for rendering, including the model transformation if any
+		\param depthTest should depth testing be performed
+		\param backFaceCulling should culling be performed
+		\param mode the primitives rendering mode
+		\param frontFaceCulling should the culling test be flipped
+		\param invertDepthTest should the depth test be flipped (GL_GREATER_THAN)
+		*/
+		void	renderCulled(
+			const Matrix4f& viewproj,
+			bool depthTest = true,
+			bool backFaceCulling = true,
+			RenderMode mode = FillRenderMode,
+			bool frontFaceCulling = false,
+			bool invertDepthTest = false
+		) const;
+
+		/** Render the geometry using OpenGL, skipping the clusters of triangles outside of all of several
+		view frustums, for layered rendering of several views in one pass.
+		\param viewprojs the projection matrices of the views, including the model transformation if any
+		\param depthTest should depth testing be performed
+		\param backFaceCulling should culling be performed
+		\param mode the primitives rendering mode
+		\param frontFaceCulling should the culling test be flipped
+		\param invertDepthTest should the depth test be flipped (GL_GREATER_THAN)
+		*/
+		void	renderCulled(
+			const std::vector<Matrix4f>& viewprojs,
+			bool depthTest = true,
+			bool backFaceCulling = true,
+			RenderMode mode = FillRenderMode,
+			bool frontFaceCulling = false,
+			bool invertDepthTest = false
+		) const;
+
+		/** Render several instances of the geometry in a single draw call using OpenGL.
+		The shader is responsible for placing each instance, using gl_InstanceID.
+		Point clouds and the PointRenderMode draw the vertices as points.
+		\param instanceCount the number of instances
+		\param depthTest should depth testing be performed
+		\param backFaceCulling should culling be performed
+		\param mode the primitives rendering mode
+		\param frontFaceCulling should the culling test be flipped
+		\param invertDepthTest should the depth test be flipped (GL_GREATER_THAN)
+		*/
+		void	renderInstanced(uint instanceCount,
+			bool depthTest = true,
+			bool backFaceCulling = true,
+			RenderMode mode = FillRenderMode,
+			bool frontFaceCulling = false,
+			bool invertDepthTest = false
+		) const;
+
 		/** Render a part of the geometry (taken either from the index buffer or directly in the vertex buffer) using OpenGL.
 		\param begin first item to render index
 		\param end last item to render index
@@ -331,6 +492,14 @@ namespace sibr
 		/** Delete GPU mesh data. */
 		void	freeBufferGLUpdate(void) const;
 
+		/** Set the layout of the vertex data on the GPU, the buffers are rebuilt on the next draw.
+		\param format the new layout
+		*/
+		void	vertexFormat(MeshBufferGL::VertexFormat format);
+
+		/** \return the layout of the vertex data on the GPU. */
+		MeshBufferGL::VertexFormat	vertexFormat(void) const { return _vertexFormat; }
+
 		/** Render the mesh vertices as points.
 		\param depthTest should depth testing be performed
 		*/
@@ -352,7 +521,20 @@ namespace sibr
 		*/
 		void		merge( const Mesh& other );
 
-		/** Erase some of the triangles.
+		/** Merge another mesh into this one, taking its buffers if this mesh is empty.
+		\param other the mesh to merge, left in an unspecified state
+		\sa makeWhole
+		*/
+		void		merge( Mesh&& other );
+
+		/** Merge several meshes into this one at once, allocating the attributes a single time.
+		Attributes are kept only if all the meshes have them.
+		\param others the meshes to merge, null pointers are skipped
+		*/
+		void		merge( const std::vector<Mesh::Ptr>& others );
+
+		/** Erase some of the triangles, in place. Vertices not used anymore are removed,
+		the others keep their relative order.
 		\param faceIDList a list of triangle IDs to erase
 		*/
 		void		eraseTriangles(const std::vector<uint>& faceIDList);
@@ -382,10 +564,15 @@ namespace sibr
 		/** \return the path the mesh was loaded from. */
 		inline const std::string getMeshFilePath( void ) const;
 
-		/** \return the mesh bouding box. */
+		/** \return the mesh bouding box, computed in parallel and cached until the vertices change. */
 		Eigen::AlignedBox<float,3>	getBoundingBox( void ) const;
 
-		/** \return the mesh centroid. */
+		/** \return a counter that changes when the geometry uploaded to the GPU changes, pending updates
+		included, so that renderers can cache results computed from the mesh.
+		*/
+		uint64	revision( void ) const;
+
+		/** \return the mesh centroid, computed in parallel and cached until the vertices change. */
 		sibr::Vector3f centroid() const;
 
 		/** Estimated the mesh bounding sphere.
@@ -393,6 +580,7 @@ namespace sibr
 		\param outRadius will contain the sphere radius
 		\param referencedOnly if true, only consider vertices that are part of at least one face
 		\param usePCcenter if true, only consider vertices for center computation. Intended to be true when using the function on point clouds.
+		\note Each variant is computed in parallel and cached until the geometry changes.
 		*/
 		void getBoundingSphere(Vector3f& outCenter, float& outRadius, bool referencedOnly=false, bool usePCcenter=false) const;
 
@@ -400,10 +588,20 @@ namespace sibr
 		\param limitSize the maximum edge length allowed
 		\param maxRecursion maximum subdivision iteration count
 		\return the subdivided mesh
+		\note Each level is split in parallel, the result doesn't depend on the thread count.
 		\bug SR: Can be stuck in a loop in some cases.
 		*/
 		sibr::Mesh::Ptr subDivide(float limitSize, size_t maxRecursion = std::numeric_limits<size_t>::max()) const;
 
+		/** Simplify the mesh by collapsing edges in the order of their quadric error (Garland and Heckbert).
+		 Borders, including texture seams where vertices are duplicated, are preserved with additional
+		 planes, and collapses that would flip a triangle or change the topology are skipped.
+		\param targetTriangles the number of triangles to reach, fewer collapses happen if the mesh can't be reduced further
+		\param error if not null, will contain an upper bound of the distance between the two surfaces
+		\return the simplified mesh, on the GPU if this one is
+		*/
+		sibr::Mesh::Ptr simplify(size_t targetTriangles, float * error = nullptr) const;
+
 		/** \return the mean edge size computed over all triangles. */
 		float meanEdgeSize() const;
 
@@ -412,6 +610,61 @@ namespace sibr
 		*/
 		std::vector<std::vector<int> > removeDisconnectedComponents();
 
+		/** Cluster of neighboring triangles, referencing a small set of vertices. */
+		struct Meshlet {
+			uint vertexOffset; ///< First vertex in Meshlets::vertices.
+			uint vertexCount; ///< Number of vertices.
+			uint triangleOffset; ///< First local index in Meshlets::triangles.
+			uint triangleCount; ///< Number of triangles.
+			Vector3f center; ///< Bounding sphere center.
+			float radius; ///< Bounding sphere radius.
+			Vector3f coneAxis; ///< Average direction of the triangle normals.
+			float coneCutoff; ///< The cluster faces away from eye if dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius, 1 if it can't be culled.
+		};
+
+		/** Meshlets of a mesh, with their vertices and triangles in shared arrays. */
+		struct Meshlets {
+			std::vector<Meshlet> meshlets; ///< The clusters.
+			std::vector<uint> vertices; ///< Mesh vertex indices of each cluster.
+			std::vector<uint8_t> triangles; ///< Triangles of each cluster, three indices in the cluster vertices per triangle.
+		};
+
+		/** Reorder the triangles to improve the hit rate of the GPU post-transform vertex cache
+		 (Forsyth, Linear-Speed Vertex Cache Optimisation). Meshes exported by COLMAP or RealityCapture
+		 come in an order that is bad for all the passes that draw the proxy.
+		\param cacheSize the size of the simulated LRU cache
+		*/
+		void optimizeVertexCache(uint cacheSize = 32);
+
+		/** Renumber the vertices in the order in which the triangles use them, so that vertex fetches
+		 are mostly linear. Unreferenced vertices are kept, at the end.
+		*/
+		void optimizeVertexFetch(void);
+
+		/** Sort the triangles along a Morton curve through their centroids, so that runs of consecutive
+		 triangles are spatially compact.
+		*/
+		void sortTrianglesSpatially(void);
+
+		/** Reorder the triangles then the vertices for rendering, see sortTrianglesSpatially, optimizeVertexCache
+		 and optimizeVertexFetch. The vertex cache step restarts in the spatial order, which keeps the culling
+		 clusters of renderCulled compact.
+		*/
+		void optimizeForRendering(void);
+
+		/** Simulate a FIFO post-transform vertex cache.
+		\param cacheSize the cache size
+		\return the average number of vertex shader invocations per triangle, between 0.5 and 3 (lower is better)
+		*/
+		float vertexCacheMissRatio(uint cacheSize = 32) const;
+
+		/** Split the triangles in clusters, following the current triangle order (best called after optimizeVertexCache).
+		\param maxVertices the maximum vertex count of a cluster, at most 256
+		\param maxTriangles the maximum triangle count of a cluster
+		\return the clusters, with their bounding spheres and normal cones
+		*/
+		Meshlets buildMeshlets(uint maxVertices = 64, uint maxTriangles = 124) const;
+
 		/** Generate a simple cube with normals.
 		\param withGraphics should the mesh be on the GPU
 		\return a cube mesh
@@ -461,12 +714,41 @@ namespace sibr
 			BufferGL& operator =(const BufferGL& other) {
 				bufferGL.reset(other.bufferGL? new MeshBufferGL() : nullptr);
 				dirtyBufferGL = (other.bufferGL!=nullptr);
+				dirtyRanges.clear();
 				return *this;
 			}
 
-			bool			dirtyBufferGL; ///< Should GL data be updated.
+			/** Vertices [begin, end[ whose attributes changed since the last upload. */
+			struct DirtyRange
+			{
+				uint begin; ///< First vertex.
+				uint end; ///< Vertex after the last one.
+				uint attributes; ///< Changed attributes, as a mask of (1 << MeshBufferGL::AttribLocation).
+			};
+
+			bool			dirtyBufferGL; ///< Should GL data be rebuilt.
+			std::vector<DirtyRange>	dirtyRanges; ///< Vertices to upload again, when the buffers don't have to be rebuilt.
 			std::unique_ptr<MeshBufferGL>	bufferGL; ///< Internal OpenGL data.
 		};
+
+		/** Drop the cached topology and bounds, to call after editing the triangles directly. */
+		void	invalidateTopology(void) { _topology.reset(); ++_geometryEdits; }
+
+		/** Drop the cached bounds, to call after editing the vertices directly. */
+		void	invalidateGeometry(void) { ++_geometryEdits; }
+
+		/** Record vertices to upload again, without rebuilding the GPU buffers.
+		\param attributes the changed attributes, as a mask of (1 << MeshBufferGL::AttribLocation)
+		\param begin the first changed vertex
+		\param end the vertex after the last changed one
+		*/
+		void	markVerticesDirty(uint attributes, size_t begin, size_t end);
+
+		/** Rebuild the GPU buffers if needed, or upload the changed vertices only.
+		\param adjacency should we give adjacent triangles info in buffer
+		*/
+		void	updateBufferGL(bool adjacency = false) const;
+
 		public: mutable BufferGL	_gl; ///< Internal OpenGL data.
 
 		// Seb: It would be better if MeshBufferGL (and GL stuffs) were outside this class.
@@ -480,15 +762,88 @@ namespace sibr
 		UVs			_texcoords; ///< Vertex UVs.
 
 	private:
+
+		/** Load a binary PLY file straight from a mapping, without Assimp.
+		\param filename the file path
+		\return false if the file is not a binary PLY the loader handles, the mesh is then left untouched
+		*/
+		bool	loadBinaryPLY(const std::string& filename);
+
+		/** Load an OBJ file straight from a mapping, without Assimp, parsing chunks of lines in parallel.
+		\param filename the file path
+		\return false if the file can't be parsed, the mesh is then left untouched
+		*/
+		bool	loadOBJ(const std::string& filename);
+
+		/** Compute the colors of a range of vertices by sampling the RealityCapture texture of the dataset, if it exists.
+		\param dataset_path the dataset path
+		\param first the first vertex of the range
+		\param count the number of vertices
+		*/
+		void	colorsFromTexture(const std::string& dataset_path, size_t first, size_t count);
+
+		/** Build the header of a PLY file for the attributes of the mesh.
+		\param format the PLY format name
+		\param universal use uchar colors instead of ushort ones
+		\param textureName name of a texture to reference in the file
+		\return the header, up to and including the end_header line
+		*/
+		std::string	plyHeader(const char* format, bool universal, const std::string& textureName) const;
+
+		/** Append meshes after the current vertices and triangles, reserving the storage once.
+		\param parts the meshes to append
+		*/
+		void	appendMeshes(const std::vector<const Mesh*>& parts);
+
+		/** Mark the GPU data for a full rebuild after the mesh content was replaced.
+		\param withGraphics should the mesh have GPU buffers
+		*/
+		void	restoreGraphics(bool withGraphics);
+
 		std::string _meshPath; ///< Source path, can be used to reload the mesh with/without graphics option in constructor
 		std::string _textureImageFileName; // filename of texture image
 		mutable RenderingOptions _renderingOptions; // Keeps last rendering options
+		MeshBufferGL::VertexFormat _vertexFormat = MeshBufferGL::VertexFormat::SEPARATE; ///< Layout of the GPU vertex data.
+		mutable MeshTopology::Ptr _topology; ///< Cached connectivity, shared between copies until one of them changes.
+
+		/// Bounding volumes, valid while no vertex or triangle was edited since they were computed.
+		struct BoundsCache
+		{
+			uint64 edits = 0; ///< Value of _geometryEdits when the results were computed.
+			bool hasBox = false; ///< Is the box computed.
+			bool hasCentroid = false; ///< Is the centroid computed.
+			uint spheres = 0; ///< Computed spheres, as a mask of (1 << variant).
+			Eigen::AlignedBox<float, 3> box; ///< Bounding box.
+			Vector3f centroid; ///< Vertices average.
+			Vector3f sphereCenters[4]; ///< Sphere centers, by variant (referencedOnly + 2 * usePCcenter).
+			float sphereRadii[4]; ///< Sphere radii, by variant.
+		};
+
+		/** \return the cache, emptied if the geometry changed since it was filled. */
+		BoundsCache&	bounds(void) const;
+
+		uint64	_geometryEdits = 0; ///< Incremented on each vertex position or triangle edit.
+		mutable BoundsCache _bounds; ///< Cached bounding volumes.
 	};
 
 	///// DEFINITION /////
 
 	void	Mesh::vertices( const Vertices& vertices ) {
-		_vertices = vertices; _gl.dirtyBufferGL = true;
+		if (vertices.size() != _vertices.size()) {
+			_topology.reset();
+			_gl.dirtyBufferGL = true;
+		}
+		_vertices = vertices;
+		markVerticesDirty(1u << MeshBufferGL::VertexAttribLocation, 0, _vertices.size());
+	}
+
+	void	Mesh::vertices( Vertices&& vertices ) {
+		if (vertices.size() != _vertices.size()) {
+			_topology.reset();
+			_gl.dirtyBufferGL = true;
+		}
+		_vertices = std::move(vertices);
+		markVerticesDirty(1u << MeshBufferGL::VertexAttribLocation, 0, _vertices.size());
 	}
 
 	const Mesh::Vertices& Mesh::vertices( void ) const {
@@ -499,12 +854,32 @@ namespace sibr
 	{
 		if (vertex_id >= 0 && vertex_id < (int)(vertices().size())) {
 			_vertices[vertex_id] = v;
-			_gl.dirtyBufferGL = true;
+			markVerticesDirty(1u << MeshBufferGL::VertexAttribLocation, vertex_id, vertex_id + 1);
+		}
+	}
+
+	inline void Mesh::replaceColor(int vertex_id, const sibr::Vector3f & c)
+	{
+		if (vertex_id >= 0 && vertex_id < (int)(_colors.size())) {
+			_colors[vertex_id] = c;
+			markVerticesDirty(1u << MeshBufferGL::ColorAttribLocation, vertex_id, vertex_id + 1);
+		}
+	}
+
+	inline void Mesh::replaceNormal(int vertex_id, const sibr::Vector3f & n)
+	{
+		if (vertex_id >= 0 && vertex_id < (int)(_normals.size())) {
+			_normals[vertex_id] = n;
+			markVerticesDirty(1u << MeshBufferGL::NormalAttribLocation, vertex_id, vertex_id + 1);
 		}
 	}
 
 	void	Mesh::triangles( const Triangles& triangles ) {
-		_triangles = triangles; _gl.dirtyBufferGL = true;
+		_triangles = triangles; _gl.dirtyBufferGL = true; invalidateTopology();
+	}
+
+	void	Mesh::triangles( Triangles&& triangles ) {
+		_triangles = std::move(triangles); _gl.dirtyBufferGL = true; invalidateTopology();
 	}
 
 	const Mesh::Triangles& Mesh::triangles( void ) const {
@@ -512,7 +887,14 @@ namespace sibr
 	}
 
 	void	Mesh::colors( const Colors& colors ) {
-		_colors = colors; _gl.dirtyBufferGL = true;
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || colors.size() != _colors.size();
+		_colors = colors;
+		markVerticesDirty(1u << MeshBufferGL::ColorAttribLocation, 0, _colors.size());
+	}
+	void	Mesh::colors( Colors&& colors ) {
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || colors.size() != _colors.size();
+		_colors = std::move(colors);
+		markVerticesDirty(1u << MeshBufferGL::ColorAttribLocation, 0, _colors.size());
 	}
 	const Mesh::Colors& Mesh::colors( void ) const {
 		return _colors;
@@ -522,7 +904,14 @@ namespace sibr
 	}
 
 	void	Mesh::normals( const Normals& normals ) {
-		_normals = normals; _gl.dirtyBufferGL = true;
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || normals.size() != _normals.size();
+		_normals = normals;
+		markVerticesDirty(1u << MeshBufferGL::NormalAttribLocation, 0, _normals.size());
+	}
+	void	Mesh::normals( Normals&& normals ) {
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || normals.size() != _normals.size();
+		_normals = std::move(normals);
+		markVerticesDirty(1u << MeshBufferGL::NormalAttribLocation, 0, _normals.size());
 	}
 	const Mesh::Normals& Mesh::normals( void ) const {
 		return _normals;
@@ -545,7 +934,15 @@ namespace sibr
 	}
 
 	void	Mesh::texCoords( const UVs& texcoords ) {
-		_texcoords = texcoords; _gl.dirtyBufferGL = true;
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || texcoords.size() != _texcoords.size();
+		_texcoords = texcoords;
+		markVerticesDirty(1u << MeshBufferGL::TexCoordAttribLocation, 0, _texcoords.size());
+	}
+
+	void	Mesh::texCoords( UVs&& texcoords ) {
+		_gl.dirtyBufferGL = _gl.dirtyBufferGL || texcoords.size() != _texcoords.size();
+		_texcoords = std::move(texcoords);
+		markVerticesDirty(1u << MeshBufferGL::TexCoordAttribLocation, 0, _texcoords.size());
 	}
 
 	const Mesh::UVs& Mesh::texCoords( void ) const {
@@ -14,6 +14,7 @@
 #include "core/graphics/Mesh.hpp"
 #include "core/graphics/MeshBufferGL.hpp"
 
+#include <cstring>
 #include <unordered_map>
 
 namespace sibr
@@ -64,6 +65,42 @@ namespace sibr
 	{
 		return (uint)(sizeof(T)*v.size());
 	}
+
+	/** Convert a float to a half float, rounding to nearest. */
+	static inline uint16 	packHalf( float value )
+	{
+		uint32 bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint16 sign = uint16((bits >> 16) & 0x8000);
+		const int exponent = int((bits >> 23) & 0xFF) - 127 + 15;
+		uint32 mantissa = bits & 0x7FFFFF;
+		if (exponent >= 31) {
+			// Overflow, infinity and NaN.
+			return uint16(sign | 0x7C00 | ((bits & 0x7FFFFFFF) > 0x7F800000 ? 0x200 : 0));
+		}
+		if (exponent <= 0) {
+			// Subnormal halves, or zero.
+			if (exponent < -10) {
+				return sign;
+			}
+			mantissa |= 0x800000;
+			const int shift = 14 - exponent;
+			return uint16(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+		}
+		// The rounding carry can propagate to the exponent, which is the expected result.
+		return uint16((sign | (uint32(exponent) << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+	}
+
+	/** Pack a unit vector as signed normalized GL_INT_2_10_10_10_REV. */
+	static inline uint32 	packNormal( const Vector3f& n )
+	{
+		uint32 packed = 0;
+		for (int c = 0; c < 3; ++c) {
+			const int value = int(std::round(sibr::clamp(n[c], -1.0f, 1.0f) * 511.0f));
+			packed |= (uint32(value) & 0x3FF) << (10 * c);
+		}
+		return packed;
+	}
 	//===========================================================================
 
 	MeshBufferGL::MeshBufferGL( void )
@@ -82,8 +119,17 @@ namespace sibr
 		_bufferIds			(std::move(other._bufferIds)),
 		_indexCount			(std::move(other._indexCount)),
 		_adjacentIndexCount	(std::move(other._adjacentIndexCount)),
-		_vertexCount		(std::move(other._vertexCount))
+		_vertexCount		(std::move(other._vertexCount)),
+		_vertexBytes		(other._vertexBytes),
+		_format				(other._format),
+		_attributes			(other._attributes),
+		_offsets			(other._offsets),
+		_stride				(other._stride),
+		_clusters			(std::move(other._clusters)),
+		_memory				(std::move(other._memory)),
+		_revision			(other._revision)
 	{
+		std::swap(_indirectBufferId, other._indirectBufferId);
 	}
 
 	MeshBufferGL& MeshBufferGL::operator =( MeshBufferGL&& other )
@@ -93,12 +139,22 @@ namespace sibr
 		_indexCount			= std::move(other._indexCount);
 		_adjacentIndexCount	= std::move(other._adjacentIndexCount);
 		_vertexCount		= std::move(other._vertexCount);
+		_vertexBytes		= other._vertexBytes;
+		_format				= other._format;
+		_attributes			= other._attributes;
+		_offsets			= other._offsets;
+		_stride				= other._stride;
+		_clusters			= std::move(other._clusters);
+		_memory				= std::move(other._memory);
+		_revision			= other._revision;
+		std::swap(_indirectBufferId, other._indirectBufferId);
 
 		return *this;
 	}
 
 	void MeshBufferGL::fetchIndices( const Mesh& mesh, bool adjacency )
 	{
+		++_revision;
 		// Create buffer for indices (called elements in opengl)
 		std::vector<GLuint> indices;
 
@@ -164,7 +220,7 @@ namespace sibr
 		}
 	}
 
-	void 	MeshBufferGL::build( const Mesh& mesh, bool adjacency )
+	void 	MeshBufferGL::build( const Mesh& mesh, bool adjacency, VertexFormat format )
 	{
 		if (!_vaoId)
 		{
@@ -177,12 +233,21 @@ namespace sibr
 		CHECK_GL_ERROR;
 
 		fetchIndices(mesh, false);
+		buildClusters(mesh);
 		
 		if(adjacency)
 			fetchIndices(mesh, true);
 
 		uint numVertices = (uint)mesh.vertices().size();
 		_vertexCount = numVertices;
+		_format = format;
+
+		if (format != VertexFormat::SEPARATE) {
+			buildInterleaved(mesh, format == VertexFormat::COMPACT);
+		_memory.set(_vertexBytes + sizeof(GLuint) * (size_t(_indexCount) + size_t(_adjacentIndexCount)));
+			glBindVertexArray(0);
+			return;
+		}
 		//SIBR_DEBUG(mesh.triangles().size());
 		std::vector<GLfloat> vertices = prepareVertexData<GLfloat>(
 			mesh.vertices(), numVertices);
@@ -214,22 +279,187 @@ namespace sibr
 
 		glBindBuffer(GL_ARRAY_BUFFER, _bufferIds[BUFVERTEX]);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(uint8)*vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+		_vertexBytes = vertexData.size();
+		CHECK_GL_ERROR;
+
+		_offsets = { { 0, getVectorDataSize(vertices), getVectorDataSize(vertices) + getVectorDataSize(colors),
+			size_t(getVectorDataSize(vertices)) + getVectorDataSize(colors) + getVectorDataSize(texcoords) } };
+		_stride = 0;
+		_attributes = (1u << VertexAttribLocation) | (colors.empty() ? 0u : 1u << ColorAttribLocation)
+			| (texcoords.empty() ? 0u : 1u << TexCoordAttribLocation) | (normals.empty() ? 0u : 1u << NormalAttribLocation);
+
+		// Empty attributes are skipped, shaders then read the default generic value.
+		const auto setAttribute = [](GLuint location, GLint size, size_t offset, bool present) {
+			if (present) {
+				glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, 0, (uint8_t*)(0) + offset);
+				glEnableVertexAttribArray(location);
+			}
+			else {
+				glDisableVertexAttribArray(location);
+			}
+		};
+		setAttribute(VertexAttribLocation, 3, 0, true);
+		setAttribute(ColorAttribLocation, 3, getVectorDataSize(vertices), !colors.empty());
+		setAttribute(TexCoordAttribLocation, 2, getVectorDataSize(vertices) + getVectorDataSize(colors), !texcoords.empty());
+		setAttribute(NormalAttribLocation, 3, getVectorDataSize(vertices) + getVectorDataSize(colors) + getVectorDataSize(texcoords), !normals.empty());
+		_memory.set(_vertexBytes + sizeof(GLuint) * (size_t(_indexCount) + size_t(_adjacentIndexCount)));
+
+		glBindVertexArray(0);
+	}
+
+	void 	MeshBufferGL::buildInterleaved( const Mesh& mesh, bool compact )
+	{
+		const bool hasColors = mesh.hasColors();
+		const bool hasUVs = mesh.hasTexCoords();
+		const bool hasNormals = mesh.hasNormals();
+
+		// Offsets of the attributes in a vertex.
+		const size_t colorOffset = sizeof(Vector3f);
+		const size_t uvOffset = colorOffset + (hasColors ? (compact ? 4 : sizeof(Vector3f)) : 0);
+		const size_t normalOffset = uvOffset + (hasUVs ? (compact ? 2 * sizeof(uint16) : sizeof(Vector2f)) : 0);
+		const size_t stride = normalOffset + (hasNormals ? (compact ? sizeof(uint32) : sizeof(Vector3f)) : 0);
+		_offsets = { { 0, colorOffset, uvOffset, normalOffset } };
+		_stride = stride;
+		_attributes = (1u << VertexAttribLocation) | (hasColors ? 1u << ColorAttribLocation : 0u)
+			| (hasUVs ? 1u << TexCoordAttribLocation : 0u) | (hasNormals ? 1u << NormalAttribLocation : 0u);
+
+		std::vector<uint8> vertexData(stride * _vertexCount);
+		encodeInterleaved(mesh, 0, _vertexCount, vertexData.data());
+
+		glBindBuffer(GL_ARRAY_BUFFER, _bufferIds[BUFVERTEX]);
+		glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+		_vertexBytes = vertexData.size();
 		CHECK_GL_ERROR;
 
-		glVertexAttribPointer(VertexAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (uint8_t*)(0));
+		const GLsizei glStride = GLsizei(stride);
+		glVertexAttribPointer(VertexAttribLocation, 3, GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0));
 		glEnableVertexAttribArray(VertexAttribLocation);
-		glVertexAttribPointer(ColorAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (uint8_t*)(0) + getVectorDataSize(vertices));
-		glEnableVertexAttribArray(ColorAttribLocation);
-		glVertexAttribPointer(TexCoordAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, (uint8_t*)(0) + getVectorDataSize(vertices) + getVectorDataSize(colors));
-		glEnableVertexAttribArray(TexCoordAttribLocation);
-		glVertexAttribPointer(NormalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (uint8_t*)(0) + getVectorDataSize(vertices) + getVectorDataSize(colors) + getVectorDataSize(texcoords));
-		glEnableVertexAttribArray(NormalAttribLocation);
+		if (hasColors) {
+			if (compact) {
+				glVertexAttribPointer(ColorAttribLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, glStride, (uint8_t*)(0) + colorOffset);
+			}
+			else {
+				glVertexAttribPointer(ColorAttribLocation, 3, GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0) + colorOffset);
+			}
+			glEnableVertexAttribArray(ColorAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(ColorAttribLocation);
+		}
+		if (hasUVs) {
+			glVertexAttribPointer(TexCoordAttribLocation, 2, compact ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0) + uvOffset);
+			glEnableVertexAttribArray(TexCoordAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(TexCoordAttribLocation);
+		}
+		if (hasNormals) {
+			if (compact) {
+				glVertexAttribPointer(NormalAttribLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, glStride, (uint8_t*)(0) + normalOffset);
+			}
+			else {
+				glVertexAttribPointer(NormalAttribLocation, 3, GL_FLOAT, GL_FALSE, glStride, (uint8_t*)(0) + normalOffset);
+			}
+			glEnableVertexAttribArray(NormalAttribLocation);
+		}
+		else {
+			glDisableVertexAttribArray(NormalAttribLocation);
+		}
+		CHECK_GL_ERROR;
+	}
 
-		/// \todo TODO:
-		/// We could ignore attrib that are empty (where mesh.colors().empty() == true, don't do anything with this).
-		/// This could improve a bit performances.
+	void 	MeshBufferGL::encodeInterleaved( const Mesh& mesh, uint begin, uint end, uint8* dst ) const
+	{
+		const bool compact = _format == VertexFormat::COMPACT;
+		const bool hasColors = (_attributes & (1u << ColorAttribLocation)) != 0;
+		const bool hasUVs = (_attributes & (1u << TexCoordAttribLocation)) != 0;
+		const bool hasNormals = (_attributes & (1u << NormalAttribLocation)) != 0;
+		const size_t colorOffset = _offsets[ColorAttribLocation];
+		const size_t uvOffset = _offsets[TexCoordAttribLocation];
+		const size_t normalOffset = _offsets[NormalAttribLocation];
+
+		const int64_t first = int64_t(begin);
+		const int64_t last = int64_t(end);
+#pragma omp parallel for
+		for (int64_t vid = first; vid < last; ++vid) {
+			uint8 * vertex = dst + size_t(vid - first) * _stride;
+			std::memcpy(vertex, mesh.vertices()[vid].data(), sizeof(Vector3f));
+			if (hasColors) {
+				const Vector3f & c = mesh.colors()[vid];
+				if (compact) {
+					for (int k = 0; k < 3; ++k) {
+						vertex[colorOffset + k] = uint8(std::round(sibr::clamp(c[k], 0.0f, 1.0f) * 255.0f));
+					}
+					vertex[colorOffset + 3] = 255;
+				}
+				else {
+					std::memcpy(vertex + colorOffset, c.data(), sizeof(Vector3f));
+				}
+			}
+			if (hasUVs) {
+				const Vector2f & uv = mesh.texCoords()[vid];
+				if (compact) {
+					const uint16 halves[2] = { packHalf(uv[0]), packHalf(uv[1]) };
+					std::memcpy(vertex + uvOffset, halves, sizeof(halves));
+				}
+				else {
+					std::memcpy(vertex + uvOffset, uv.data(), sizeof(Vector2f));
+				}
+			}
+			if (hasNormals) {
+				if (compact) {
+					const uint32 packed = packNormal(mesh.normals()[vid]);
+					std::memcpy(vertex + normalOffset, &packed, sizeof(packed));
+				}
+				else {
+					std::memcpy(vertex + normalOffset, mesh.normals()[vid].data(), sizeof(Vector3f));
+				}
+			}
+		}
+	}
 
-		glBindVertexArray(0);
+	bool 	MeshBufferGL::updateVertices( const Mesh& mesh, uint attributes, uint begin, uint end )
+	{
+		if (!_vaoId || mesh.vertices().size() != _vertexCount) {
+			return false;
+		}
+		// The attributes present in the buffer have to match the mesh ones.
+		const bool interleaved = _format != VertexFormat::SEPARATE;
+		const uint present = (1u << VertexAttribLocation)
+			| ((interleaved ? mesh.hasColors() : !mesh.colors().empty()) ? 1u << ColorAttribLocation : 0u)
+			| ((interleaved ? mesh.hasTexCoords() : !mesh.texCoords().empty()) ? 1u << TexCoordAttribLocation : 0u)
+			| ((interleaved ? mesh.hasNormals() : !mesh.normals().empty()) ? 1u << NormalAttribLocation : 0u);
+		if (present != _attributes) {
+			return false;
+		}
+		end = std::min(end, _vertexCount);
+		if (begin >= end || (attributes & _attributes) == 0) {
+			return true;
+		}
+		++_revision;
+
+		glBindBuffer(GL_ARRAY_BUFFER, _bufferIds[BUFVERTEX]);
+		if (interleaved) {
+			// Whole vertices are rewritten, whatever the attributes that changed.
+			std::vector<uint8> vertexData(_stride * (end - begin));
+			encodeInterleaved(mesh, begin, end, vertexData.data());
+			glBufferSubData(GL_ARRAY_BUFFER, GLintptr(_stride * begin), GLsizeiptr(vertexData.size()), vertexData.data());
+		}
+		else {
+			const auto upload = [&](AttribLocation location, const void* data, size_t elementSize) {
+				if (attributes & _attributes & (1u << location)) {
+					glBufferSubData(GL_ARRAY_BUFFER, GLintptr(_offsets[location] + elementSize * begin),
+						GLsizeiptr(elementSize * (end - begin)), static_cast<const uint8*>(data) + elementSize * begin);
+				}
+			};
+			upload(VertexAttribLocation, mesh.vertices().data(), sizeof(Vector3f));
+			upload(ColorAttribLocation, mesh.colors().data(), sizeof(Vector3f));
+			upload(TexCoordAttribLocation, mesh.texCoords().data(), sizeof(Vector2f));
+			upload(NormalAttribLocation, mesh.normals().data(), sizeof(Vector3f));
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERROR;
+		return true;
 	}
 
 	void	MeshBufferGL::free(void)
@@ -245,6 +475,14 @@ namespace sibr
 			glDeleteVertexArrays(1, &_vaoId);
 			_vaoId = 0;
 		}
+
+		if (_indirectBufferId)
+		{
+			glDeleteBuffers(1, &_indirectBufferId);
+			_indirectBufferId = 0;
+		}
+		_clusters.clear();
+		_memory.set(0);
 	}
 
 	void  MeshBufferGL::draw(bool adjacency) const
@@ -284,6 +522,102 @@ namespace sibr
 		glBindVertexArray(0);
 	}
 
+	void MeshBufferGL::buildClusters(const Mesh& mesh)
+	{
+		_clusters.clear();
+		const Mesh::Triangles& triangles = mesh.triangles();
+		const uint count = uint((triangles.size() + clusterTriangles - 1) / clusterTriangles);
+		if (count < minClusters) {
+			return;
+		}
+		_clusters.resize(count);
+#pragma omp parallel for
+		for (int c = 0; c < int(count); ++c) {
+			const uint first = uint(c) * clusterTriangles;
+			const uint last = std::min(first + clusterTriangles, uint(triangles.size()));
+			Cluster& cluster = _clusters[c];
+			cluster.firstIndex = 3 * first;
+			cluster.indexCount = 3 * (last - first);
+			cluster.box.setEmpty();
+			for (uint t = first; t < last; ++t) {
+				for (int k = 0; k < 3; ++k) {
+					cluster.box.extend(mesh.vertices()[triangles[t][k]]);
+				}
+			}
+		}
+	}
+
+	void MeshBufferGL::drawCulled(const Frustum& frustum) const
+	{
+		drawCulled(&frustum, 1);
+	}
+
+	void MeshBufferGL::drawCulled(const std::vector<Frustum>& frusta) const
+	{
+		drawCulled(frusta.data(), frusta.size());
+	}
+
+	void MeshBufferGL::drawCulled(const Frustum* frusta, size_t frustumCount) const
+	{
+		if (_clusters.empty()) {
+			_culledTriangleCount = _indexCount / 3;
+			draw();
+			return;
+		}
+
+		// Merge the consecutive visible clusters in a single range.
+		_commands.clear();
+		for (const Cluster& cluster : _clusters) {
+			bool visible = false;
+			for (size_t f = 0; f < frustumCount && !visible; ++f) {
+				visible = frusta[f].testBox(cluster.box) != Frustum::OUTSIDE;
+			}
+			if (!visible) {
+				continue;
+			}
+			if (!_commands.empty() && _commands.back().firstIndex + _commands.back().count == cluster.firstIndex) {
+				_commands.back().count += cluster.indexCount;
+			}
+			else {
+				_commands.push_back({ cluster.indexCount, 1, cluster.firstIndex, 0, 0 });
+			}
+		}
+
+		_culledTriangleCount = 0;
+		for (const DrawCommand& command : _commands) {
+			_culledTriangleCount += command.count / 3;
+		}
+		if (_commands.empty()) {
+			return;
+		}
+		if (_commands.size() == 1) {
+			draw(_commands[0].firstIndex, _commands[0].firstIndex + _commands[0].count);
+			return;
+		}
+
+		glBindVertexArray(_vaoId);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _bufferIds[BUFINDEX]);
+		if (GLEW_ARB_multi_draw_indirect) {
+			if (!_indirectBufferId) {
+				glGenBuffers(1, &_indirectBufferId);
+			}
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBufferId);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * _commands.size(), _commands.data(), GL_STREAM_DRAW);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(_commands.size()), 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+		else {
+			std::vector<GLsizei> counts(_commands.size());
+			std::vector<const void*> offsets(_commands.size());
+			for (size_t i = 0; i < _commands.size(); ++i) {
+				counts[i] = GLsizei(_commands[i].count);
+				offsets[i] = (const void*)(sizeof(GLuint) * _commands[i].firstIndex);
+			}
+			glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), GLsizei(_commands.size()));
+		}
+		glBindVertexArray(0);
+	}
+
 	void  MeshBufferGL::drawTessellated(void) const
 	{
 		glBindVertexArray(_vaoId);
@@ -315,6 +649,21 @@ namespace sibr
 		glBindVertexArray(0);
 	}
 
+	void MeshBufferGL::drawInstanced(uint instanceCount) const
+	{
+		glBindVertexArray(_vaoId);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _bufferIds[BUFINDEX]);
+		glDrawElementsInstanced(GL_TRIANGLES, _indexCount, GL_UNSIGNED_INT, (void*)0, GLsizei(instanceCount));
+		glBindVertexArray(0);
+	}
+
+	void MeshBufferGL::draw_points_instanced(uint instanceCount) const
+	{
+		glBindVertexArray(_vaoId);
+		glDrawArraysInstanced(GL_POINTS, 0, _vertexCount, GLsizei(instanceCount));
+		glBindVertexArray(0);
+	}
+
 	void MeshBufferGL::bind(void) const
 	{
 		glBindVertexArray(_vaoId);
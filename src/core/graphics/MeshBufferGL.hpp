@@ -15,6 +15,8 @@
 # include <array>
 # include <vector>
 # include "core/graphics/Config.hpp"
+# include "core/graphics/Frustum.hpp"
+# include "core/graphics/MemoryTracker.hpp"
 
 
 namespace sibr
@@ -51,6 +53,17 @@ namespace sibr
 			AttribLocationCount
 		};
 		
+		/** Layout and precision of the vertex attributes in the buffer. The shaders
+		 * see the same float attributes at the same locations in all cases, attributes missing
+		 * from the mesh are skipped and read as the default generic value (0,0,0,1).
+		 */
+		enum class VertexFormat
+		{
+			SEPARATE,		///< One float array per attribute, one after the other.
+			INTERLEAVED,	///< Float attributes, interleaved per vertex.
+			COMPACT			///< Interleaved, with unorm8 colors, half float UVs and GL_INT_2_10_10_10_REV normals.
+		};
+
 		/** Predefined buffer location. */
 		enum
 		{
@@ -96,9 +109,32 @@ namespace sibr
 		/** Build from a mesh so you can then draw() it to render it.
 		* \param mesh the mesh to upload
 		* \param adjacency tells whether the indices should contain adjacents vertices
+		* \param format the layout of the vertex data
 		* \note This function can't fail (errors stop the program with a message).
 		*/
-		void	build( const Mesh& mesh, bool adjacency = false );
+		void	build( const Mesh& mesh, bool adjacency = false, VertexFormat format = VertexFormat::SEPARATE );
+
+		/** Upload a range of vertex attributes in place, the buffer keeping its size and layout.
+		* \param mesh the mesh, with the vertex count and attributes it had when built
+		* \param attributes the attributes to update, as a mask of (1 << AttribLocation)
+		* \param begin the first vertex
+		* \param end the vertex after the last one
+		* \return false if the vertex count or the attributes changed, the buffer then has to be built again
+		* \note Interleaved layouts rewrite whole vertices. Culling bounds are not updated, see buildClusters.
+		*/
+		bool	updateVertices( const Mesh& mesh, uint attributes, uint begin, uint end );
+
+		/** Split the triangles in clusters of consecutive triangles, for culling. Called by build,
+		* and again after vertices moved.
+		* \param mesh the uploaded mesh
+		*/
+		void	buildClusters( const Mesh& mesh );
+
+		/** \return the size of the vertex buffer in bytes. */
+		size_t	vertexBytes(void) const { return _vertexBytes; }
+
+		/** \return a counter increased each time the buffer content changes, to detect updates. */
+		uint64	revision(void) const { return _revision; }
 
 		/** Delete the GPU buffer, freeing memory. */
 		void	free(void);
@@ -115,6 +151,31 @@ namespace sibr
 		*/
 		void	draw(unsigned int begin, unsigned int end, bool adjacency = false) const;
 
+		/** This bind and draw the clusters of triangles that are not outside a frustum, in a single
+			multi draw call. Meshes too small to be split in clusters are drawn whole.
+			\param frustum the culling frustum, in model space
+		*/
+		void	drawCulled(const Frustum& frustum) const;
+
+		/** This bind and draw the clusters of triangles that are not outside all of several frustums, in a
+			single multi draw call, for layered rendering. Meshes too small to be split in clusters are drawn whole.
+			\param frusta the culling frustums, in model space
+		*/
+		void	drawCulled(const std::vector<Frustum>& frusta) const;
+
+		/** \return the number of triangles submitted by the last drawCulled call. */
+		uint	culledTriangleCount(void) const { return _culledTriangleCount; }
+
+		/** This bind and draw several instances of the elements stored in the buffer, in a single call.
+			\param instanceCount the number of instances
+		*/
+		void	drawInstanced(uint instanceCount) const;
+
+		/** This bind and draw several instances of the vertex points stored in the buffer, in a single call.
+			\param instanceCount the number of instances
+		*/
+		void	draw_points_instanced(uint instanceCount) const;
+
 		/** This bind and draw elements stored in the buffer with tessellation shader enabled. */
 		void  drawTessellated(void) const;
 		
@@ -145,13 +206,68 @@ namespace sibr
 		/** Copy operator (disabled). */
 		MeshBufferGL& operator =(const MeshBufferGL&) = delete;
 
+		/// Number of consecutive triangles grouped in a culling cluster.
+		static const uint clusterTriangles = 1024;
+
+		/// Meshes with fewer clusters are always drawn whole.
+		static const uint minClusters = 8;
+
 	private:
-		
+
+		/** Run of consecutive triangles in the index buffer, with its bounding box. */
+		struct Cluster
+		{
+			uint firstIndex; ///< First index in the index buffer.
+			uint indexCount; ///< Number of indices.
+			Eigen::AlignedBox<float, 3> box; ///< Bounds of the triangles.
+		};
+
+		/** Indirect draw parameters, with the layout expected by glMultiDrawElementsIndirect. */
+		struct DrawCommand
+		{
+			GLuint count;
+			GLuint instanceCount;
+			GLuint firstIndex;
+			GLint  baseVertex;
+			GLuint baseInstance;
+		};
+
+		/** Fill the vertex buffer with interleaved attributes and set up the vertex array.
+		* \param mesh the mesh to upload
+		* \param compact use the packed formats instead of floats
+		*/
+		void	buildInterleaved( const Mesh& mesh, bool compact );
+
+		/** Encode vertices with the current interleaved layout.
+		* \param mesh the mesh to upload
+		* \param begin the first vertex
+		* \param end the vertex after the last one
+		* \param dst the destination, of (end - begin) * stride bytes
+		*/
+		void	encodeInterleaved( const Mesh& mesh, uint begin, uint end, uint8* dst ) const;
+
+		/** Draw the clusters that are not outside all of the frustums.
+		* \param frusta the culling frustums, in model space
+		* \param frustumCount the number of frustums
+		*/
+		void	drawCulled( const Frustum* frusta, size_t frustumCount ) const;
+
 		GLuint 							_vaoId; ///< Vertex array object ID.
 		std::array<GLuint, BUFCOUNT>	_bufferIds; ///< Buffers IDs.
 		uint 							_indexCount; ///< Number of elements in the index buffer.
 		uint							_adjacentIndexCount; ///< Number of elements in the triangles_adjacency index buffer.
 		uint							_vertexCount; ///< Number of elements in the vertex buffer.
+		size_t							_vertexBytes = 0; ///< Size of the vertex buffer.
+		VertexFormat					_format = VertexFormat::SEPARATE; ///< Layout of the vertex buffer.
+		uint							_attributes = 0; ///< Attributes in the vertex buffer, as a mask of (1 << AttribLocation).
+		std::array<size_t, AttribLocationCount> _offsets = { { 0, 0, 0, 0 } }; ///< Start of each attribute in the buffer, or in a vertex when interleaved.
+		size_t							_stride = 0; ///< Size of an interleaved vertex.
+		std::vector<Cluster>			_clusters; ///< Culling clusters, empty for small meshes.
+		mutable std::vector<DrawCommand> _commands; ///< Visible ranges of the last culled draw.
+		mutable GLuint					_indirectBufferId = 0; ///< Buffer of the indirect draw commands.
+		mutable uint					_culledTriangleCount = 0; ///< Triangles submitted by the last culled draw.
+		uint64							_revision = 0; ///< Number of content updates.
+		TrackedMemory					_memory = TrackedMemory(MemoryTracker::BUFFER); ///< Size of the vertex and index buffers.
 
 		bool initVertexBuffer = false,
 			 initIndexBuffer = false,
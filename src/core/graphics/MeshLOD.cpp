@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <cstring>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "core/graphics/MeshLOD.hpp"
+#include "core/system/Hash.hpp"
+
+namespace sibr
+{
+	namespace {
+
+		const char kMagic[8] = { 'S', 'I', 'B', 'R', 'L', 'O', 'D', '\0' };
+
+		const uint32_t kVersion = 2;
+
+		// Levels stop once they get this small, or when simplification stalls.
+		const size_t kMinTriangles = 64;
+
+		struct LODHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t levelCount;
+			uint32_t maxLevels;
+			float ratio;
+			Hash128 source; // fileFingerprint of the source mesh, zero if unknown.
+			uint64_t baseVertices;
+			uint64_t baseTriangles;
+		};
+
+		struct LevelRecord
+		{
+			float error;
+			uint32_t attributes; // bit 0: normals, 1: colors, 2: uvs
+			uint64_t vertices;
+			uint64_t triangles;
+		};
+
+		template<typename T>
+		void writeArray(std::ofstream & file, const std::vector<T> & data)
+		{
+			file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size() * sizeof(T)));
+		}
+
+		template<typename T>
+		bool readArray(std::ifstream & file, std::vector<T> & data, size_t count)
+		{
+			data.resize(count);
+			file.read(reinterpret_cast<char*>(data.data()), std::streamsize(count * sizeof(T)));
+			return bool(file);
+		}
+	}
+
+	MeshLOD::MeshLOD(const Mesh::Ptr & base, uint levels, float ratio) :
+		_maxLevels(levels), _ratio(ratio)
+	{
+		_levels.push_back(base);
+		_errors.push_back(0.0f);
+		const Eigen::AlignedBox<float, 3> box = base->getBoundingBox();
+		_center = box.center();
+		_radius = 0.5f * box.diagonal().norm();
+
+		const float clampedRatio = sibr::clamp(ratio, 0.01f, 0.9f);
+		while (_levels.size() < levels) {
+			const size_t current = _levels.back()->triangles().size();
+			const size_t target = size_t(float(current) * clampedRatio);
+			if (target < kMinTriangles) {
+				break;
+			}
+			float error = 0.0f;
+			Mesh::Ptr next = _levels.back()->simplify(target, &error);
+			// Borders and flips can prevent any further reduction.
+			if (float(next->triangles().size()) > 0.9f * float(current)) {
+				break;
+			}
+			_levels.push_back(next);
+			// Each level is simplified from the previous one, errors add up.
+			_errors.push_back(_errors.back() + error);
+		}
+		for (size_t l = 1; l < _levels.size(); ++l) {
+			SIBR_LOG << "[MeshLOD] Level " << l << ": " << _levels[l]->triangles().size() << " triangles, error " << _errors[l] << "." << std::endl;
+		}
+	}
+
+	MeshLOD::Ptr MeshLOD::createCached(const Mesh::Ptr & base, const std::string & cachePath, const std::string & sourcePath,
+		uint levels, float ratio)
+	{
+		MeshLOD::Ptr lods(new MeshLOD());
+		if (lods->load(cachePath, base, sourcePath) && lods->_maxLevels == levels && lods->_ratio == ratio) {
+			SIBR_LOG << "[MeshLOD] Loaded " << lods->levelCount() << " levels from " << cachePath << "." << std::endl;
+			return lods;
+		}
+		lods.reset(new MeshLOD(base, levels, ratio));
+		if (!lods->save(cachePath, sourcePath)) {
+			SIBR_WRG << "[MeshLOD] Unable to write the cache file " << cachePath << "." << std::endl;
+		}
+		return lods;
+	}
+
+	bool MeshLOD::save(const std::string & path, const std::string & sourcePath) const
+	{
+		LODHeader header;
+		std::memcpy(header.magic, kMagic, sizeof(kMagic));
+		header.version = kVersion;
+		header.levelCount = uint32_t(_levels.size() - 1);
+		header.maxLevels = _maxLevels;
+		header.ratio = _ratio;
+		if (sourcePath.empty() || !fileFingerprint(sourcePath, header.source)) {
+			header.source = Hash128();
+		}
+		header.baseVertices = _levels[0]->vertices().size();
+		header.baseTriangles = _levels[0]->triangles().size();
+
+		const boost::filesystem::path parent = boost::filesystem::path(path).parent_path();
+		boost::system::error_code ec;
+		if (!parent.empty()) {
+			boost::filesystem::create_directories(parent, ec);
+		}
+		std::ofstream file(path, std::ios_base::binary);
+		if (!file) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(LODHeader));
+		for (size_t l = 1; l < _levels.size(); ++l) {
+			const Mesh & mesh = *_levels[l];
+			LevelRecord record;
+			record.error = _errors[l];
+			record.attributes = (mesh.hasNormals() ? 1 : 0) | (mesh.hasColors() ? 2 : 0) | (mesh.hasTexCoords() ? 4 : 0);
+			record.vertices = mesh.vertices().size();
+			record.triangles = mesh.triangles().size();
+			file.write(reinterpret_cast<const char*>(&record), sizeof(LevelRecord));
+			writeArray(file, mesh.vertices());
+			writeArray(file, mesh.triangles());
+			if (mesh.hasNormals()) {
+				writeArray(file, mesh.normals());
+			}
+			if (mesh.hasColors()) {
+				writeArray(file, mesh.colors());
+			}
+			if (mesh.hasTexCoords()) {
+				writeArray(file, mesh.texCoords());
+			}
+		}
+		return bool(file);
+	}
+
+	bool MeshLOD::load(const std::string & path, const Mesh::Ptr & base, const std::string & sourcePath)
+	{
+		std::ifstream file(path, std::ios_base::binary);
+		if (!file) {
+			return false;
+		}
+		LODHeader header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(LODHeader));
+		if (!file || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+			return false;
+		}
+		if (header.baseVertices != base->vertices().size() || header.baseTriangles != base->triangles().size()) {
+			return false;
+		}
+		Hash128 source;
+		if (header.source != Hash128() && !sourcePath.empty() && fileFingerprint(sourcePath, source)
+			&& source != header.source) {
+			SIBR_LOG << "[MeshLOD] Cache " << path << " is outdated." << std::endl;
+			return false;
+		}
+
+		_maxLevels = header.maxLevels;
+		_ratio = header.ratio;
+		_levels.assign(1, base);
+		_errors.assign(1, 0.0f);
+		const Eigen::AlignedBox<float, 3> box = base->getBoundingBox();
+		_center = box.center();
+		_radius = 0.5f * box.diagonal().norm();
+		for (uint32_t l = 0; l < header.levelCount; ++l) {
+			LevelRecord record;
+			file.read(reinterpret_cast<char*>(&record), sizeof(LevelRecord));
+			Mesh::Vertices vertices;
+			Mesh::Triangles triangles;
+			if (!file || !readArray(file, vertices, record.vertices) || !readArray(file, triangles, record.triangles)) {
+				return false;
+			}
+			Mesh::Ptr mesh(new Mesh(base->_gl.bufferGL != nullptr));
+			mesh->vertices(vertices);
+			mesh->triangles(triangles);
+			if (record.attributes & 1) {
+				Mesh::Normals normals;
+				if (!readArray(file, normals, record.vertices)) {
+					return false;
+				}
+				mesh->normals(normals);
+			}
+			if (record.attributes & 2) {
+				Mesh::Colors colors;
+				if (!readArray(file, colors, record.vertices)) {
+					return false;
+				}
+				mesh->colors(colors);
+			}
+			if (record.attributes & 4) {
+				Mesh::UVs uvs;
+				if (!readArray(file, uvs, record.vertices)) {
+					return false;
+				}
+				mesh->texCoords(uvs);
+			}
+			_levels.push_back(mesh);
+			_errors.push_back(record.error);
+		}
+		return true;
+	}
+
+	size_t MeshLOD::select(const Camera & eye, float viewportHeight, float pixelError) const
+	{
+		// Size of a world unit in pixels, at the closest point of the bounding sphere.
+		float pixelsPerUnit;
+		if (eye.ortho()) {
+			pixelsPerUnit = viewportHeight / (2.0f * eye.orthoTop());
+		}
+		else {
+			const float distance = std::max((eye.position() - _center).norm() - _radius, eye.znear());
+			pixelsPerUnit = viewportHeight / (2.0f * std::tan(0.5f * eye.fovy()) * distance);
+		}
+		size_t selected = 0;
+		for (size_t l = 1; l < _levels.size(); ++l) {
+			if (_errors[l] * pixelsPerUnit > pixelError) {
+				break;
+			}
+			selected = l;
+		}
+		return selected;
+	}
+
+} // namespace sibr
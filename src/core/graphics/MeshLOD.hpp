@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <string>
+# include <vector>
+# include "core/graphics/Config.hpp"
+# include "core/graphics/Mesh.hpp"
+# include "core/graphics/Camera.hpp"
+
+namespace sibr
+{
+	/** Chain of simplified versions of a mesh, level 0 being the mesh itself.
+	 * Each level has about ratio times the triangles of the previous one, and stores a bound
+	 * on its distance to the full resolution mesh, used to pick the coarsest level whose
+	 * error stays below a given number of pixels on screen.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT MeshLOD
+	{
+		SIBR_CLASS_PTR(MeshLOD);
+
+	public:
+
+		/** Build the chain by simplifying each level into the next one.
+		\param base the full resolution mesh
+		\param levels the maximum number of levels, including the base mesh
+		\param ratio the fraction of triangles kept from one level to the next
+		*/
+		MeshLOD(const Mesh::Ptr & base, uint levels = 4, float ratio = 0.25f);
+
+		/** Load the chain from a cache file if it is valid for the source mesh, build and save it otherwise.
+		\param base the full resolution mesh
+		\param cachePath the cache file
+		\param sourcePath the file the base mesh was loaded from, the cache is rebuilt when it changes
+		\param levels the maximum number of levels, including the base mesh
+		\param ratio the fraction of triangles kept from one level to the next
+		\return the chain
+		*/
+		static MeshLOD::Ptr createCached(const Mesh::Ptr & base, const std::string & cachePath, const std::string & sourcePath,
+			uint levels = 4, float ratio = 0.25f);
+
+		/** Save the simplified levels (the base mesh is not stored).
+		\param path the destination file
+		\param sourcePath the file the base mesh was loaded from, its fingerprint is stored to detect changes
+		\return false if the file couldn't be written
+		*/
+		bool save(const std::string & path, const std::string & sourcePath) const;
+
+		/** \return the number of levels, at least one. */
+		size_t levelCount(void) const { return _levels.size(); }
+
+		/** \return the mesh of a level, 0 being the base one */
+		const Mesh & level(size_t id) const { return *_levels[id]; }
+
+		/** \return a pointer to the mesh of a level, 0 being the base one */
+		const Mesh::Ptr & levelPtr(size_t id) const { return _levels[id]; }
+
+		/** \return the bound on the distance between a level and the base mesh, in world units */
+		float error(size_t id) const { return _errors[id]; }
+
+		/** Select the coarsest level appearing close enough to the base mesh.
+		\param eye the viewpoint
+		\param viewportHeight the height of the rendered image, in pixels
+		\param pixelError the maximum projected error, in pixels
+		\return the level index
+		*/
+		size_t select(const Camera & eye, float viewportHeight, float pixelError = 1.0f) const;
+
+	private:
+
+		/** Empty chain, filled by load. */
+		MeshLOD(void) = default;
+
+		/** Load the simplified levels.
+		\param path the cache file
+		\param base the full resolution mesh, its counts have to match the cached ones
+		\param sourcePath the file the base mesh was loaded from
+		\return false if the file is missing, outdated or invalid
+		*/
+		bool load(const std::string & path, const Mesh::Ptr & base, const std::string & sourcePath);
+
+		std::vector<Mesh::Ptr> _levels; ///< Meshes, from the finest to the coarsest.
+		std::vector<float> _errors; ///< Error of each level.
+		Vector3f _center; ///< Bounding sphere center of the base mesh.
+		float _radius = 0.0f; ///< Bounding sphere radius of the base mesh.
+		uint _maxLevels = 1; ///< Level count requested at creation.
+		float _ratio = 1.0f; ///< Triangle ratio requested at creation.
+	};
+
+} // namespace sibr
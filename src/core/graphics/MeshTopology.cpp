@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include "core/graphics/MeshTopology.hpp"
+
+namespace sibr
+{
+	namespace {
+
+		/** Fill compressed rows in two passes, each row being listed in parallel, sorted and deduplicated.
+		\param count the number of rows
+		\param list called with (row, scratch) and filling scratch with the items of the row, in any order
+		\param offsets will contain the count+1 offsets
+		\param items will contain the items
+		*/
+		template<typename ListFunc>
+		void buildSortedRows(size_t count, const ListFunc& list, std::vector<uint>& offsets, std::vector<uint>& items)
+		{
+			offsets.assign(count + 1, 0);
+			const int64_t rows = int64_t(count);
+#pragma omp parallel
+			{
+				std::vector<uint> scratch;
+#pragma omp for
+				for (int64_t i = 0; i < rows; ++i) {
+					scratch.clear();
+					list(uint(i), scratch);
+					std::sort(scratch.begin(), scratch.end());
+					offsets[i + 1] = uint(std::unique(scratch.begin(), scratch.end()) - scratch.begin());
+				}
+			}
+			for (size_t i = 0; i < count; ++i) {
+				offsets[i + 1] += offsets[i];
+			}
+			items.resize(offsets[count]);
+#pragma omp parallel
+			{
+				std::vector<uint> scratch;
+#pragma omp for
+				for (int64_t i = 0; i < rows; ++i) {
+					scratch.clear();
+					list(uint(i), scratch);
+					std::sort(scratch.begin(), scratch.end());
+					std::unique(scratch.begin(), scratch.end());
+					std::copy_n(scratch.begin(), offsets[i + 1] - offsets[i], items.begin() + offsets[i]);
+				}
+			}
+		}
+	}
+
+	MeshTopology::MeshTopology(const Triangles& triangles, size_t vertexCount) :
+		_vertexCount(vertexCount), _faceCount(triangles.size())
+	{
+		std::vector<uint> identity(vertexCount);
+		std::iota(identity.begin(), identity.end(), 0u);
+		buildCorners(triangles, identity, vertexCount, _vcOffsets, _vc);
+
+		// The two other vertices of each corner.
+		buildSortedRows(vertexCount, [&](uint v, std::vector<uint>& scratch) {
+			for (uint c = _vcOffsets[v]; c < _vcOffsets[v + 1]; ++c) {
+				const Vector3u& tri = triangles[_vc[c] / 3];
+				const uint k = _vc[c] % 3;
+				scratch.push_back(tri[(k + 1) % 3]);
+				scratch.push_back(tri[(k + 2) % 3]);
+			}
+		}, _vvOffsets, _vv);
+
+		// The faces around the first vertex of each edge that also contain the second one.
+		buildSortedRows(_faceCount, [&](uint f, std::vector<uint>& scratch) {
+			const Vector3u& tri = triangles[f];
+			for (int k = 0; k < 3; ++k) {
+				const uint a = tri[k];
+				const uint b = tri[(k + 1) % 3];
+				for (uint c = _vcOffsets[a]; c < _vcOffsets[a + 1]; ++c) {
+					const uint g = _vc[c] / 3;
+					const Vector3u& other = triangles[g];
+					if (g != f && (other[0] == b || other[1] == b || other[2] == b)) {
+						scratch.push_back(g);
+					}
+				}
+			}
+		}, _ffOffsets, _ff);
+	}
+
+	void MeshTopology::buildCorners(const Triangles& triangles, const std::vector<uint>& groups, size_t groupCount,
+		std::vector<uint>& offsets, std::vector<uint>& corners)
+	{
+		offsets.assign(groupCount + 1, 0);
+		for (const Vector3u& tri : triangles) {
+			for (int k = 0; k < 3; ++k) {
+				++offsets[groups[tri[k]] + 1];
+			}
+		}
+		for (size_t g = 0; g < groupCount; ++g) {
+			offsets[g + 1] += offsets[g];
+		}
+		corners.resize(triangles.size() * 3);
+		// Sequential fill, to keep the face order in each row.
+		std::vector<uint> cursors(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < triangles.size(); ++t) {
+			for (int k = 0; k < 3; ++k) {
+				corners[cursors[groups[triangles[t][k]]]++] = uint(3 * t + k);
+			}
+		}
+	}
+
+} // namespace sibr
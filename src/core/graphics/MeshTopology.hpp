@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <vector>
+# include "core/graphics/Config.hpp"
+# include "core/system/Vector.hpp"
+
+namespace sibr
+{
+	/** Connectivity of a triangle mesh, stored as compressed rows: the items related to
+	 * element i are items[offsets[i]] to items[offsets[i+1]-1]. A few flat arrays replace
+	 * the per-vertex lists, so traversals don't allocate and can run in parallel.
+	 *
+	 * Faces around a vertex are given as corners: 3 * face index + position of the vertex
+	 * in the face, which gives both the face and the two other vertices of the face.
+	 * \note The topology only depends on the triangles and the vertex count.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT MeshTopology
+	{
+		SIBR_CLASS_PTR(MeshTopology);
+
+	public:
+
+		typedef std::vector<Vector3u>	Triangles;
+
+		/** Build the topology.
+		\param triangles the faces, each index must be lower than vertexCount
+		\param vertexCount the number of vertices
+		*/
+		MeshTopology(const Triangles& triangles, size_t vertexCount);
+
+		/** \return the number of vertices. */
+		size_t vertexCount(void) const { return _vertexCount; }
+
+		/** \return the number of faces. */
+		size_t faceCount(void) const { return _faceCount; }
+
+		/** \return the offsets of each vertex in vertexVertices(), vertexCount()+1 values. */
+		const std::vector<uint>& vertexVertexOffsets(void) const { return _vvOffsets; }
+
+		/** \return the neighbors of all vertices, sorted and without duplicates for each vertex. */
+		const std::vector<uint>& vertexVertices(void) const { return _vv; }
+
+		/** \return the offsets of each vertex in vertexCorners(), vertexCount()+1 values. */
+		const std::vector<uint>& vertexCornerOffsets(void) const { return _vcOffsets; }
+
+		/** \return the corners of all vertices, in face order for each vertex. */
+		const std::vector<uint>& vertexCorners(void) const { return _vc; }
+
+		/** \return the offsets of each face in faceFaces(), faceCount()+1 values. */
+		const std::vector<uint>& faceFaceOffsets(void) const { return _ffOffsets; }
+
+		/** \return the faces sharing an edge with each face, sorted and without duplicates for each face. */
+		const std::vector<uint>& faceFaces(void) const { return _ff; }
+
+		/** \return the number of neighbors of a vertex. */
+		uint valence(uint v) const { return _vvOffsets[v + 1] - _vvOffsets[v]; }
+
+		/** Build vertex to corners rows for groups of vertices, in face order.
+		Used with one group per vertex by the topology itself, or to merge duplicated vertices.
+		\param triangles the faces
+		\param groups the group of each vertex
+		\param groupCount the number of groups
+		\param offsets will contain the groupCount+1 offsets
+		\param corners will contain the corners of each group
+		*/
+		static void buildCorners(const Triangles& triangles, const std::vector<uint>& groups, size_t groupCount,
+			std::vector<uint>& offsets, std::vector<uint>& corners);
+
+	private:
+
+		size_t _vertexCount; ///< Vertex count.
+		size_t _faceCount; ///< Face count.
+		std::vector<uint> _vvOffsets; ///< Vertex to vertices offsets.
+		std::vector<uint> _vv; ///< Vertex to vertices.
+		std::vector<uint> _vcOffsets; ///< Vertex to corners offsets.
+		std::vector<uint> _vc; ///< Vertex to corners.
+		std::vector<uint> _ffOffsets; ///< Face to faces offsets.
+		std::vector<uint> _ff; ///< Face to faces.
+	};
+
+} // namespace sibr
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include "PixelKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#	define SIBR_PIXELS_X86
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define SIBR_PIXELS_NEON
+#	include <arm_neon.h>
+#endif
+
+// MSVC accepts any intrinsic, GCC and Clang need the instruction set enabled per function.
+#if defined(SIBR_PIXELS_X86) && !defined(_MSC_VER)
+#	define SIBR_TARGET(isa) __attribute__((target(isa)))
+#else
+#	define SIBR_TARGET(isa)
+#endif
+
+namespace sibr {
+
+	namespace pixels {
+
+		namespace {
+
+			typedef unsigned char uchar;
+
+			/// Kernels of an instruction set, the tails shorter than a vector go through the scalar versions.
+			struct Kernels {
+				const char * name;
+				void (*swap3)(const uchar * src, uchar * dst, size_t count);
+				void (*swap4)(const uchar * src, uchar * dst, size_t count);
+				void (*rgbToRgba)(const uchar * src, uchar * dst, size_t count, uchar alpha);
+				void (*rgbaToRgb)(const uchar * src, uchar * dst, size_t count);
+				void (*u8ToF32)(const uchar * src, float * dst, size_t count, float scale);
+				void (*f32ToU8)(const float * src, uchar * dst, size_t count, float scale);
+			};
+
+			///// Scalar /////
+
+			void swap3Scalar(const uchar * src, uchar * dst, size_t count) {
+				swapRedBlue<uchar>(src, dst, count, 3);
+			}
+
+			void swap4Scalar(const uchar * src, uchar * dst, size_t count) {
+				swapRedBlue<uchar>(src, dst, count, 4);
+			}
+
+			void rgbToRgbaScalar(const uchar * src, uchar * dst, size_t count, uchar alpha) {
+				convertChannels<uchar>(src, 3, dst, 4, count, alpha);
+			}
+
+			void rgbaToRgbScalar(const uchar * src, uchar * dst, size_t count) {
+				convertChannels<uchar>(src, 4, dst, 3, count, 0);
+			}
+
+			void u8ToF32Scalar(const uchar * src, float * dst, size_t count, float scale) {
+				for (size_t i = 0; i < count; ++i) {
+					dst[i] = float(src[i]) * scale;
+				}
+			}
+
+			void f32ToU8Scalar(const float * src, uchar * dst, size_t count, float scale) {
+				for (size_t i = 0; i < count; ++i) {
+					// nearbyint rounds half to even, as cv::saturate_cast.
+					const float v = std::nearbyint(src[i] * scale);
+					dst[i] = uchar(std::min(255.0f, std::max(0.0f, v)));
+				}
+			}
+
+#ifdef SIBR_PIXELS_X86
+
+			///// SSSE3 /////
+
+			SIBR_TARGET("ssse3") void swap3SSSE3(const uchar * src, uchar * dst, size_t count) {
+				// 16 bytes are loaded and stored for 4 pixels, the last 4 bytes are kept as is:
+				// in place they are still unprocessed, otherwise the next store overwrites them.
+				const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+				size_t p = 0;
+				for (; 3 * p + 16 <= 3 * count; p += 4) {
+					const __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * p));
+					_mm_storeu_si128((__m128i *)(dst + 3 * p), _mm_shuffle_epi8(v, mask));
+				}
+				swap3Scalar(src + 3 * p, dst + 3 * p, count - p);
+			}
+
+			SIBR_TARGET("ssse3") void swap4SSSE3(const uchar * src, uchar * dst, size_t count) {
+				const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+				size_t p = 0;
+				for (; p + 4 <= count; p += 4) {
+					const __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * p));
+					_mm_storeu_si128((__m128i *)(dst + 4 * p), _mm_shuffle_epi8(v, mask));
+				}
+				swap4Scalar(src + 4 * p, dst + 4 * p, count - p);
+			}
+
+			SIBR_TARGET("ssse3") void rgbToRgbaSSSE3(const uchar * src, uchar * dst, size_t count, uchar alpha) {
+				const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				const __m128i alphas = _mm_set1_epi32(int(uint32_t(alpha) << 24));
+				size_t p = 0;
+				for (; 3 * p + 16 <= 3 * count; p += 4) {
+					const __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * p));
+					_mm_storeu_si128((__m128i *)(dst + 4 * p), _mm_or_si128(_mm_shuffle_epi8(v, mask), alphas));
+				}
+				rgbToRgbaScalar(src + 3 * p, dst + 4 * p, count - p, alpha);
+			}
+
+			SIBR_TARGET("ssse3") void rgbaToRgbSSSE3(const uchar * src, uchar * dst, size_t count) {
+				// 12 useful bytes are stored as 16, the extra ones are overwritten by the next store.
+				const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+				size_t p = 0;
+				for (; 3 * p + 16 <= 3 * count; p += 4) {
+					const __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * p));
+					_mm_storeu_si128((__m128i *)(dst + 3 * p), _mm_shuffle_epi8(v, mask));
+				}
+				rgbaToRgbScalar(src + 4 * p, dst + 3 * p, count - p);
+			}
+
+			SIBR_TARGET("ssse3") void u8ToF32SSSE3(const uchar * src, float * dst, size_t count, float scale) {
+				const __m128i zero = _mm_setzero_si128();
+				const __m128 scales = _mm_set1_ps(scale);
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16) {
+					const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+					const __m128i lo = _mm_unpacklo_epi8(v, zero);
+					const __m128i hi = _mm_unpackhi_epi8(v, zero);
+					_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scales));
+					_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scales));
+					_mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scales));
+					_mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scales));
+				}
+				u8ToF32Scalar(src + i, dst + i, count - i, scale);
+			}
+
+			SIBR_TARGET("ssse3") void f32ToU8SSSE3(const float * src, uchar * dst, size_t count, float scale) {
+				// cvtps rounds half to even with the default rounding mode, the packs saturate.
+				const __m128 scales = _mm_set1_ps(scale);
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16) {
+					const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scales));
+					const __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scales));
+					const __m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 8), scales));
+					const __m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 12), scales));
+					_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+				}
+				f32ToU8Scalar(src + i, dst + i, count - i, scale);
+			}
+
+			///// AVX2 /////
+
+			SIBR_TARGET("avx2") void swap4AVX2(const uchar * src, uchar * dst, size_t count) {
+				const __m256i mask = _mm256_setr_epi8(
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+				size_t p = 0;
+				for (; p + 8 <= count; p += 8) {
+					const __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * p));
+					_mm256_storeu_si256((__m256i *)(dst + 4 * p), _mm256_shuffle_epi8(v, mask));
+				}
+				swap4SSSE3(src + 4 * p, dst + 4 * p, count - p);
+			}
+
+			SIBR_TARGET("avx2") void rgbToRgbaAVX2(const uchar * src, uchar * dst, size_t count, uchar alpha) {
+				// Each lane expands 4 pixels, loaded 12 bytes apart.
+				const __m256i mask = _mm256_setr_epi8(
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+				const __m256i alphas = _mm256_set1_epi32(int(uint32_t(alpha) << 24));
+				size_t p = 0;
+				for (; 3 * p + 28 <= 3 * count; p += 8) {
+					const __m128i lo = _mm_loadu_si128((const __m128i *)(src + 3 * p));
+					const __m128i hi = _mm_loadu_si128((const __m128i *)(src + 3 * p + 12));
+					const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+					_mm256_storeu_si256((__m256i *)(dst + 4 * p), _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alphas));
+				}
+				rgbToRgbaSSSE3(src + 3 * p, dst + 4 * p, count - p, alpha);
+			}
+
+			SIBR_TARGET("avx2") void u8ToF32AVX2(const uchar * src, float * dst, size_t count, float scale) {
+				const __m256 scales = _mm256_set1_ps(scale);
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16) {
+					const __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+					const __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 8)));
+					_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(a), scales));
+					_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), scales));
+				}
+				u8ToF32SSSE3(src + i, dst + i, count - i, scale);
+			}
+
+			SIBR_TARGET("avx2") void f32ToU8AVX2(const float * src, uchar * dst, size_t count, float scale) {
+				const __m256 scales = _mm256_set1_ps(scale);
+				// The packs work per lane, the 32 bits groups are put back in order at the end.
+				const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+				size_t i = 0;
+				for (; i + 32 <= count; i += 32) {
+					const __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i), scales));
+					const __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scales));
+					const __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 16), scales));
+					const __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 24), scales));
+					const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+					_mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+				}
+				f32ToU8SSSE3(src + i, dst + i, count - i, scale);
+			}
+
+			/// \return true if the CPU and the OS support the instruction set.
+			bool supports(bool avx2) {
+#ifdef _MSC_VER
+				int info[4];
+				__cpuid(info, 1);
+				const bool ssse3 = (info[2] & (1 << 9)) != 0;
+				if (!avx2) {
+					return ssse3;
+				}
+				// The OS has to save the YMM registers.
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+				if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+					return false;
+				}
+				__cpuidex(info, 7, 0);
+				return (info[1] & (1 << 5)) != 0;
+#else
+				__builtin_cpu_init();
+				return avx2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("ssse3");
+#endif
+			}
+
+#endif
+
+#ifdef SIBR_PIXELS_NEON
+
+			///// NEON /////
+
+			void swap3NEON(const uchar * src, uchar * dst, size_t count) {
+				size_t p = 0;
+				for (; p + 16 <= count; p += 16) {
+					uint8x16x3_t v = vld3q_u8(src + 3 * p);
+					const uint8x16_t r = v.val[0];
+					v.val[0] = v.val[2];
+					v.val[2] = r;
+					vst3q_u8(dst + 3 * p, v);
+				}
+				swap3Scalar(src + 3 * p, dst + 3 * p, count - p);
+			}
+
+			void swap4NEON(const uchar * src, uchar * dst, size_t count) {
+				size_t p = 0;
+				for (; p + 16 <= count; p += 16) {
+					uint8x16x4_t v = vld4q_u8(src + 4 * p);
+					const uint8x16_t r = v.val[0];
+					v.val[0] = v.val[2];
+					v.val[2] = r;
+					vst4q_u8(dst + 4 * p, v);
+				}
+				swap4Scalar(src + 4 * p, dst + 4 * p, count - p);
+			}
+
+			void rgbToRgbaNEON(const uchar * src, uchar * dst, size_t count, uchar alpha) {
+				size_t p = 0;
+				for (; p + 16 <= count; p += 16) {
+					const uint8x16x3_t v = vld3q_u8(src + 3 * p);
+					uint8x16x4_t o;
+					o.val[0] = v.val[0];
+					o.val[1] = v.val[1];
+					o.val[2] = v.val[2];
+					o.val[3] = vdupq_n_u8(alpha);
+					vst4q_u8(dst + 4 * p, o);
+				}
+				rgbToRgbaScalar(src + 3 * p, dst + 4 * p, count - p, alpha);
+			}
+
+			void rgbaToRgbNEON(const uchar * src, uchar * dst, size_t count) {
+				size_t p = 0;
+				for (; p + 16 <= count; p += 16) {
+					const uint8x16x4_t v = vld4q_u8(src + 4 * p);
+					uint8x16x3_t o;
+					o.val[0] = v.val[0];
+					o.val[1] = v.val[1];
+					o.val[2] = v.val[2];
+					vst3q_u8(dst + 3 * p, o);
+				}
+				rgbaToRgbScalar(src + 4 * p, dst + 3 * p, count - p);
+			}
+
+			void u8ToF32NEON(const uchar * src, float * dst, size_t count, float scale) {
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8) {
+					const uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+					vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+					vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+				}
+				u8ToF32Scalar(src + i, dst + i, count - i, scale);
+			}
+
+			void f32ToU8NEON(const float * src, uchar * dst, size_t count, float scale) {
+				size_t i = 0;
+#ifdef __aarch64__
+				// vcvtnq rounds half to even, the narrowings saturate.
+				for (; i + 8 <= count; i += 8) {
+					const int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), scale));
+					const int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), scale));
+					vst1_u8(dst + i, vqmovn_u16(vcombine_u16(vqmovun_s32(a), vqmovun_s32(b))));
+				}
+#endif
+				f32ToU8Scalar(src + i, dst + i, count - i, scale);
+			}
+
+#endif
+
+			/// \return the kernels of the best supported instruction set, detected once.
+			const Kernels & kernels() {
+				static const Kernels selected = []() {
+					Kernels k = { "scalar", swap3Scalar, swap4Scalar, rgbToRgbaScalar, rgbaToRgbScalar, u8ToF32Scalar, f32ToU8Scalar };
+#if defined(SIBR_PIXELS_X86)
+					if (supports(false)) {
+						k = { "SSSE3", swap3SSSE3, swap4SSSE3, rgbToRgbaSSSE3, rgbaToRgbSSSE3, u8ToF32SSSE3, f32ToU8SSSE3 };
+						if (supports(true)) {
+							// 3 channels pixels do not fit the AVX2 lanes, their SSSE3 kernels are kept.
+							k.name = "AVX2";
+							k.swap4 = swap4AVX2;
+							k.rgbToRgba = rgbToRgbaAVX2;
+							k.u8ToF32 = u8ToF32AVX2;
+							k.f32ToU8 = f32ToU8AVX2;
+						}
+					}
+#elif defined(SIBR_PIXELS_NEON)
+					k = { "NEON", swap3NEON, swap4NEON, rgbToRgbaNEON, rgbaToRgbNEON, u8ToF32NEON, f32ToU8NEON };
+#endif
+					return k;
+				}();
+				return selected;
+			}
+
+		}
+
+		const char * instructionSet() {
+			return kernels().name;
+		}
+
+		void swapRedBlue(const unsigned char * src, unsigned char * dst, size_t count, unsigned int channels) {
+			if (channels == 3) {
+				kernels().swap3(src, dst, count);
+			} else if (channels == 4) {
+				kernels().swap4(src, dst, count);
+			} else if (src != dst) {
+				std::memcpy(dst, src, count * channels);
+			}
+		}
+
+		void convertChannels(const unsigned char * src, unsigned int srcChannels, unsigned char * dst, unsigned int dstChannels, size_t count, unsigned char alpha) {
+			if (srcChannels == 3 && dstChannels == 4) {
+				kernels().rgbToRgba(src, dst, count, alpha);
+			} else if (srcChannels == 4 && dstChannels == 3) {
+				kernels().rgbaToRgb(src, dst, count);
+			} else if (srcChannels == dstChannels) {
+				std::memcpy(dst, src, count * srcChannels);
+			} else {
+				convertChannels<unsigned char>(src, srcChannels, dst, dstChannels, count, alpha);
+			}
+		}
+
+		void convert(const unsigned char * src, float * dst, size_t count, float scale) {
+			kernels().u8ToF32(src, dst, count, scale);
+		}
+
+		void convert(const float * src, unsigned char * dst, size_t count, float scale) {
+			kernels().f32ToU8(src, dst, count, scale);
+		}
+
+		void flipRows(const void * src, void * dst, size_t rows, size_t rowBytes) {
+			const unsigned char * in = static_cast<const unsigned char *>(src);
+			unsigned char * out = static_cast<unsigned char *>(dst);
+			if (in != out) {
+				for (size_t y = 0; y < rows; ++y) {
+					std::memcpy(out + (rows - 1 - y) * rowBytes, in + y * rowBytes, rowBytes);
+				}
+				return;
+			}
+			std::vector<unsigned char> tmp(rowBytes);
+			for (size_t y = 0; y < rows / 2; ++y) {
+				unsigned char * top = out + y * rowBytes;
+				unsigned char * bottom = out + (rows - 1 - y) * rowBytes;
+				std::memcpy(tmp.data(), top, rowBytes);
+				std::memcpy(top, bottom, rowBytes);
+				std::memcpy(bottom, tmp.data(), rowBytes);
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <cstddef>
+
+namespace sibr {
+
+	/**
+	 * Vectorized kernels for the pixel conversions done on every image load, texture upload and capture:
+	 * red/blue swaps, channel count changes, 8 bits/float conversions and row flips.
+	 * The instruction set (AVX2, SSSE3, NEON or plain C++) is picked at runtime, on first use.
+	 * Buffers hold count pixels with interleaved channels; unless stated otherwise, the source and destination
+	 * can be the same buffer but should not partially overlap.
+	 * \ingroup sibr_graphics
+	 */
+	namespace pixels {
+
+		/** \return the name of the instruction set used by the kernels. */
+		SIBR_GRAPHICS_EXPORT const char * instructionSet();
+
+		/** Swap the first and third channels (RGB <-> BGR).
+		\param src source pixels
+		\param dst destination pixels
+		\param count number of pixels
+		\param channels 3 or 4, other counts are copied unchanged
+		*/
+		SIBR_GRAPHICS_EXPORT void swapRedBlue(const unsigned char * src, unsigned char * dst, size_t count, unsigned int channels);
+
+		/** \copydoc swapRedBlue */
+		template<typename T>
+		void swapRedBlue(const T * src, T * dst, size_t count, unsigned int channels);
+
+		/** Change the number of channels, following sibr::Image conventions:
+		 * extra channels are dropped, missing color channels replicate the first one and a missing fourth
+		 * channel receives alpha.
+		\param src source pixels
+		\param srcChannels source channels count
+		\param dst destination pixels, should not be the source
+		\param dstChannels destination channels count
+		\param count number of pixels
+		\param alpha value of the missing fourth channel
+		*/
+		SIBR_GRAPHICS_EXPORT void convertChannels(const unsigned char * src, unsigned int srcChannels, unsigned char * dst, unsigned int dstChannels, size_t count, unsigned char alpha = 255);
+
+		/** \copydoc convertChannels */
+		template<typename T>
+		void convertChannels(const T * src, unsigned int srcChannels, T * dst, unsigned int dstChannels, size_t count, T alpha);
+
+		/** Convert 8 bits values to float, dst = src * scale.
+		\param src source values
+		\param dst destination values
+		\param count number of values
+		\param scale the scaling factor
+		*/
+		SIBR_GRAPHICS_EXPORT void convert(const unsigned char * src, float * dst, size_t count, float scale);
+
+		/** Convert float values to 8 bits, dst = saturate(round(src * scale)), as cv::Mat::convertTo.
+		\param src source values
+		\param dst destination values
+		\param count number of values
+		\param scale the scaling factor
+		*/
+		SIBR_GRAPHICS_EXPORT void convert(const float * src, unsigned char * dst, size_t count, float scale);
+
+		/** Copy rows in reverse order (vertical flip), the source and destination can be the same buffer.
+		\param src source rows
+		\param dst destination rows
+		\param rows number of rows
+		\param rowBytes size of a row in bytes
+		*/
+		SIBR_GRAPHICS_EXPORT void flipRows(const void * src, void * dst, size_t rows, size_t rowBytes);
+
+		///// DEFINITIONS /////
+
+		template<typename T>
+		void swapRedBlue(const T * src, T * dst, size_t count, unsigned int channels) {
+			for (size_t p = 0; p < count; ++p, src += channels, dst += channels) {
+				const T r = src[0];
+				for (unsigned int c = 0; c < channels; ++c) {
+					dst[c] = src[c];
+				}
+				if (channels == 3 || channels == 4) {
+					dst[0] = src[2];
+					dst[2] = r;
+				}
+			}
+		}
+
+		template<typename T>
+		void convertChannels(const T * src, unsigned int srcChannels, T * dst, unsigned int dstChannels, size_t count, T alpha) {
+			for (size_t p = 0; p < count; ++p, src += srcChannels, dst += dstChannels) {
+				unsigned int c = 0;
+				for (; c < srcChannels && c < dstChannels; ++c) {
+					dst[c] = src[c];
+				}
+				for (; c < dstChannels && c < 3; ++c) {
+					dst[c] = src[0];
+				}
+				for (; c < dstChannels; ++c) {
+					dst[c] = alpha;
+				}
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "PixelReadback.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+
+namespace sibr {
+
+	PixelReadback::PixelReadback(uint slots) :
+		_slots(std::max(slots, 1u))
+	{
+		for (Slot & s : _slots) {
+			glGenBuffers(1, &s.buffer);
+		}
+		CHECK_GL_ERROR;
+	}
+
+	PixelReadback::~PixelReadback()
+	{
+		for (Slot & s : _slots) {
+			if (s.fence) {
+				glDeleteSync(s.fence);
+			}
+			glDeleteBuffers(1, &s.buffer);
+		}
+	}
+
+	PixelReadback::Ticket PixelReadback::read(GLuint fbo, uint target, uint w, uint h, GLenum format, GLenum type, size_t pixelSize)
+	{
+		return read(fbo, target, 0, 0, w, h, format, type, pixelSize);
+	}
+
+	PixelReadback::Ticket PixelReadback::read(GLuint fbo, uint target, int x, int y, uint w, uint h, GLenum format, GLenum type, size_t pixelSize)
+	{
+		Slot & s = _slots[(_next - 1) % _slots.size()];
+		// The slot still holds an older read, it is dropped once its transfer is done.
+		wait(s, true);
+
+		const size_t bytes = size_t(w) * h * pixelSize;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+		if (bytes > s.capacity) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ);
+			s.capacity = bytes;
+		}
+
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		if (format != GL_DEPTH_COMPONENT && format != GL_STENCIL_INDEX && format != GL_DEPTH_STENCIL) {
+			glReadBuffer(GL_COLOR_ATTACHMENT0 + target);
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		// Into the buffer, the pointer is an offset in it.
+		glReadPixels(GLint(x), GLint(y), GLsizei(w), GLsizei(h), format, type, nullptr);
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		s.ticket = _next++;
+		s.w = w;
+		s.h = h;
+		s.pixelSize = pixelSize;
+		CHECK_GL_ERROR;
+		return s.ticket;
+	}
+
+	bool PixelReadback::isReady(Ticket ticket)
+	{
+		Slot * s = slot(ticket);
+		return s && wait(*s, false);
+	}
+
+	bool PixelReadback::isPending(Ticket ticket) const
+	{
+		return ticket != 0 && _slots[(ticket - 1) % _slots.size()].ticket == ticket;
+	}
+
+	void PixelReadback::finish()
+	{
+		for (Slot & s : _slots) {
+			wait(s, true);
+		}
+	}
+
+	PixelReadback::Slot * PixelReadback::slot(Ticket ticket)
+	{
+		return isPending(ticket) ? &_slots[(ticket - 1) % _slots.size()] : nullptr;
+	}
+
+	bool PixelReadback::copy(Ticket ticket, bool block, void * dst, size_t dstSize)
+	{
+		Slot * s = slot(ticket);
+		if (!s || !wait(*s, block)) {
+			return false;
+		}
+		const size_t rowSize = size_t(s->w) * s->pixelSize;
+		const size_t bytes = rowSize * s->h;
+		if (dstSize < bytes) {
+			SIBR_ERR << "[PixelReadback] Destination too small for the pixels read back." << std::endl;
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s->buffer);
+		const char * src = static_cast<const char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(bytes), GL_MAP_READ_BIT));
+		const bool mapped = src != nullptr;
+		if (mapped) {
+			// GL rows are bottom to top.
+			pixels::flipRows(src, dst, s->h, rowSize);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			SIBR_WRG << "[PixelReadback] Unable to map the pixels of read " << ticket << "." << std::endl;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		s->ticket = 0;
+		CHECK_GL_ERROR;
+		return mapped;
+	}
+
+	bool PixelReadback::wait(Slot & s, bool block)
+	{
+		if (!s.fence) {
+			return true;
+		}
+		const GLuint64 timeout = block ? GLuint64(-1) : 0;
+		const GLenum status = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			return false;
+		}
+		glDeleteSync(s.fence);
+		s.fence = 0;
+		return true;
+	}
+
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/Image.hpp>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Reads framebuffer content back to the CPU without stalling the pipeline.
+	 * Each read is issued into one of a ring of pixel pack buffers, followed by a fence; the pixels
+	 * can be fetched once the fence has signaled, usually one or more frames later.
+	 *
+	 *		PixelReadback readback;
+	 *		PixelReadback::Ticket ticket = rt.readBackAsync(readback);
+	 *		// Later, on a following frame:
+	 *		ImageRGB img;
+	 *		if (readback.fetch(ticket, img, false)) { ... }
+	 *
+	 * \note When all slots are in flight, a new read waits for the oldest one, whose pixels are kept
+	 *  until fetched or until the slot is needed again.
+	 * \sa RenderTarget::readBackAsync
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT PixelReadback {
+		SIBR_CLASS_PTR(PixelReadback);
+		SIBR_DISALLOW_COPY(PixelReadback);
+
+	public:
+
+		/// Identifies a read, tickets increase with each call to read, 0 is never a valid ticket.
+		typedef uint64_t Ticket;
+
+		/** Constructor.
+		\param slots number of reads that can be in flight at once
+		*/
+		PixelReadback(uint slots = 3);
+
+		/// Destructor.
+		~PixelReadback();
+
+		/** Issue the read of a framebuffer color attachment.
+		\param fbo the framebuffer handle
+		\param target the color attachment to read
+		\param w the width to read
+		\param h the height to read
+		\param format the pixel GL format
+		\param type the component GL type
+		\param pixelSize the size of a pixel in bytes
+		\return the ticket of the read
+		*/
+		Ticket read(GLuint fbo, uint target, uint w, uint h, GLenum format, GLenum type, size_t pixelSize);
+
+		/** Issue the read of a region of a framebuffer attachment.
+		\param fbo the framebuffer handle
+		\param target the color attachment to read, ignored for depth and stencil formats
+		\param x the left of the region
+		\param y the bottom of the region, in GL coordinates
+		\param w the width to read
+		\param h the height to read
+		\param format the pixel GL format, GL_DEPTH_COMPONENT to read the depth attachment
+		\param type the component GL type
+		\param pixelSize the size of a pixel in bytes
+		\return the ticket of the read
+		*/
+		Ticket read(GLuint fbo, uint target, int x, int y, uint w, uint h, GLenum format, GLenum type, size_t pixelSize);
+
+		/** Check if a read is done, without blocking.
+		\param ticket the read ticket
+		\return true if the pixels can be fetched without waiting
+		*/
+		bool isReady(Ticket ticket);
+
+		/** Check if a read can still be fetched.
+		\param ticket the read ticket
+		\return false if the ticket is unknown, already fetched, or its slot has been reused
+		*/
+		bool isPending(Ticket ticket) const;
+
+		/** Copy the pixels of a read to an image, flipped to the image orientation.
+		 The image type has to match the pixel layout of the render target read.
+		\param ticket the read ticket
+		\param img will contain the pixels
+		\param block wait for the read if it is not done yet
+		\return true if the image was filled, false if the read is not ready or no longer pending
+		*/
+		template <typename T_Type, uint T_NumComp>
+		bool fetch(Ticket ticket, sibr::Image<T_Type, T_NumComp> & img, bool block = true);
+
+		/** Wait for all reads in flight. */
+		void finish();
+
+		/** \return the ticket of the last read, 0 if none. */
+		Ticket last() const { return _next - 1; }
+
+		/** \return the number of reads that can be in flight at once. */
+		size_t slots() const { return _slots.size(); }
+
+	private:
+
+		/// A pixel pack buffer and the read it holds.
+		struct Slot {
+			GLuint buffer = 0; ///< Pixel pack buffer.
+			size_t capacity = 0; ///< Allocated size of the buffer.
+			GLsync fence = 0; ///< Signaled when the read is done.
+			Ticket ticket = 0; ///< Read stored in the slot, 0 if none.
+			uint w = 0; ///< Read width.
+			uint h = 0; ///< Read height.
+			size_t pixelSize = 0; ///< Size of a pixel in bytes.
+		};
+
+		/** Get the slot holding a read.
+		\param ticket the read ticket
+		\return the slot or nullptr if the read is no longer pending
+		*/
+		Slot * slot(Ticket ticket);
+
+		/** Map the pixels of a read and release its slot.
+		\param ticket the read ticket
+		\param block wait for the read if it is not done yet
+		\param dst destination pixels, rows from top to bottom
+		\param dstSize size of the destination
+		\return true if the pixels were copied
+		*/
+		bool copy(Ticket ticket, bool block, void * dst, size_t dstSize);
+
+		/** Wait for a fence and delete it.
+		\param s the slot to wait on
+		\param block wait even if the fence has not signaled yet
+		\return true if the fence has signaled
+		*/
+		static bool wait(Slot & s, bool block);
+
+		std::vector<Slot> _slots; ///< Buffer ring.
+		Ticket _next = 1; ///< Next ticket.
+	};
+
+	template <typename T_Type, uint T_NumComp>
+	bool PixelReadback::fetch(Ticket ticket, sibr::Image<T_Type, T_NumComp> & img, bool block) {
+		const Slot * s = slot(ticket);
+		if (!s || (!block && !isReady(ticket))) {
+			return false;
+		}
+		if (s->pixelSize != sizeof(T_Type) * T_NumComp) {
+			SIBR_ERR << "[PixelReadback] Image type does not match the pixels read back." << std::endl;
+		}
+		if (img.w() != s->w || img.h() != s->h) {
+			img = sibr::Image<T_Type, T_NumComp>(s->w, s->h);
+		}
+		return copy(ticket, block, img.data(), size_t(s->w) * s->h * s->pixelSize);
+	}
+
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include "core/graphics/PointOctree.hpp"
+#include "core/graphics/Frustum.hpp"
+
+namespace sibr
+{
+	namespace {
+
+		static_assert(sizeof(Vector3f) == 12, "Points are uploaded as vec3 followed by the packed color.");
+
+		// Nodes are not split further past this depth, for clouds with many duplicated points.
+		const int kMaxDepth = 21;
+
+		/** Pack a color in [0,1] as RGBA8, red in the lowest byte. */
+		uint32 packColor(const Vector3f & color)
+		{
+			const Vector3f c = (color.cwiseMax(0.0f).cwiseMin(1.0f) * 255.0f).array().round().matrix();
+			return uint32(c[0]) | (uint32(c[1]) << 8) | (uint32(c[2]) << 16) | (uint32(255) << 24);
+		}
+	}
+
+	PointOctree::PointOctree(const Mesh & mesh, uint leafSize, uint grid) :
+		_leafSize(std::max(leafSize, 1u)), _grid(std::max(grid, 1u))
+	{
+		const std::vector<Vector3f> & positions = mesh.vertices();
+		_pointCount = positions.size();
+		if (_pointCount == 0) {
+			return;
+		}
+
+		// Cubic root cell, so that octants stay cubes.
+		Eigen::AlignedBox<float, 3> bounds;
+		for (const Vector3f & p : positions) {
+			bounds.extend(p);
+		}
+		const float half = 0.5f * std::max(bounds.sizes().maxCoeff(), 1e-6f);
+		const Eigen::AlignedBox<float, 3> cell(bounds.center() - Vector3f(half, half, half), bounds.center() + Vector3f(half, half, half));
+
+		_order.resize(_pointCount);
+		std::iota(_order.begin(), _order.end(), 0u);
+		_scratch.resize(_pointCount);
+		_stamps.assign(size_t(_grid) * _grid * _grid, 0u);
+		_nodes.emplace_back();
+		build(0, 0, _pointCount, cell, positions, 0);
+
+		const std::vector<Vector3f> & colors = mesh.colors();
+		const bool hasColors = colors.size() == _pointCount;
+		_packed.resize(_pointCount);
+		for (size_t i = 0; i < _pointCount; ++i) {
+			const uint id = _order[i];
+			_packed[i].position = positions[id];
+			_packed[i].color = hasColors ? packColor(colors[id]) : 0xFFFFFFFFu;
+		}
+		// The build state is not needed anymore.
+		std::vector<uint>().swap(_order);
+		std::vector<uint>().swap(_scratch);
+		std::vector<uint>().swap(_stamps);
+	}
+
+	PointOctree::~PointOctree(void)
+	{
+		if (_vao) {
+			glDeleteVertexArrays(1, &_vao);
+		}
+		if (_buffer) {
+			glDeleteBuffers(1, &_buffer);
+		}
+	}
+
+	void PointOctree::build(size_t node, size_t begin, size_t end, const Eigen::AlignedBox<float, 3> & cell, const std::vector<Vector3f> & positions, int depth)
+	{
+		// The node vector grows during the recursion, nodes are accessed by index.
+		Eigen::AlignedBox<float, 3> box;
+		for (size_t i = begin; i < end; ++i) {
+			box.extend(positions[_order[i]]);
+		}
+		_nodes[node].box = box;
+		_nodes[node].first = uint(begin);
+
+		if (end - begin <= _leafSize || depth >= kMaxDepth) {
+			_nodes[node].count = uint(end - begin);
+			return;
+		}
+
+		// Keep the first point falling in each grid cell, moved to the front of the range.
+		const float cellSize = cell.sizes()[0] / float(_grid);
+		const uint stamp = uint(node) + 1;
+		const int maxCell = int(_grid) - 1;
+		size_t kept = begin;
+		for (size_t i = begin; i < end; ++i) {
+			const Vector3f local = (positions[_order[i]] - cell.min()) / cellSize;
+			const size_t x = size_t(std::min(std::max(int(local[0]), 0), maxCell));
+			const size_t y = size_t(std::min(std::max(int(local[1]), 0), maxCell));
+			const size_t z = size_t(std::min(std::max(int(local[2]), 0), maxCell));
+			uint & cellStamp = _stamps[(z * _grid + y) * _grid + x];
+			if (cellStamp != stamp) {
+				cellStamp = stamp;
+				std::swap(_order[kept++], _order[i]);
+			}
+		}
+		_nodes[node].count = uint(kept - begin);
+		_nodes[node].spacing = cellSize;
+
+		// Counting sort of the remaining points by octant.
+		const Vector3f center = cell.center();
+		const auto octant = [&](uint id) {
+			const Vector3f & p = positions[id];
+			return (p[0] >= center[0] ? 1 : 0) | (p[1] >= center[1] ? 2 : 0) | (p[2] >= center[2] ? 4 : 0);
+		};
+		size_t offsets[9] = { 0 };
+		for (size_t i = kept; i < end; ++i) {
+			++offsets[octant(_order[i]) + 1];
+		}
+		offsets[0] = kept;
+		for (int o = 1; o < 9; ++o) {
+			offsets[o] += offsets[o - 1];
+		}
+		size_t cursors[8];
+		std::copy(offsets, offsets + 8, cursors);
+		for (size_t i = kept; i < end; ++i) {
+			_scratch[cursors[octant(_order[i])]++] = _order[i];
+		}
+		std::copy(_scratch.begin() + kept, _scratch.begin() + end, _order.begin() + kept);
+
+		const Vector3f half = 0.5f * cell.sizes();
+		for (int o = 0; o < 8; ++o) {
+			if (offsets[o + 1] == offsets[o]) {
+				continue;
+			}
+			const Vector3f min = cell.min() + Vector3f((o & 1) ? half[0] : 0.0f, (o & 2) ? half[1] : 0.0f, (o & 4) ? half[2] : 0.0f);
+			const int child = int(_nodes.size());
+			_nodes.emplace_back();
+			_nodes[node].children[o] = child;
+			build(size_t(child), offsets[o], offsets[o + 1], Eigen::AlignedBox<float, 3>(min, min + half), positions, depth + 1);
+		}
+	}
+
+	size_t PointOctree::select(const Camera & eye, float viewportHeight, float pixelSpacing, size_t pointBudget, std::vector<Range> & ranges) const
+	{
+		ranges.clear();
+		if (_nodes.empty()) {
+			return 0;
+		}
+		const Frustum frustum(eye.viewproj());
+		// Size of a world unit in pixels, at the closest point of a node.
+		const float focal = eye.ortho() ? viewportHeight / (2.0f * eye.orthoTop()) : viewportHeight / (2.0f * std::tan(0.5f * eye.fovy()));
+		const auto pixelsPerUnit = [&](const Node & node) {
+			return eye.ortho() ? focal : focal / std::max(node.box.exteriorDistance(eye.position()), eye.znear());
+		};
+
+		// Nodes whose parent points appear the sparsest are refined first, so that the budget is spent evenly.
+		std::priority_queue<std::pair<float, int>> queue;
+		if (frustum.testBox(_nodes[0].box) != Frustum::OUTSIDE) {
+			queue.push({ std::numeric_limits<float>::max(), 0 });
+		}
+		size_t selected = 0;
+		while (!queue.empty()) {
+			const Node & node = _nodes[queue.top().second];
+			queue.pop();
+			ranges.push_back({ node.first, node.count });
+			selected += node.count;
+			if (pointBudget > 0 && selected >= pointBudget) {
+				break;
+			}
+			if (node.spacing * pixelsPerUnit(node) <= pixelSpacing) {
+				continue;
+			}
+			for (const int child : node.children) {
+				if (child >= 0 && frustum.testBox(_nodes[child].box) != Frustum::OUTSIDE) {
+					queue.push({ node.spacing * pixelsPerUnit(_nodes[child]), child });
+				}
+			}
+		}
+
+		// Nodes are stored depth first: a node and its first child are often contiguous.
+		std::sort(ranges.begin(), ranges.end(), [](const Range & a, const Range & b) { return a.first < b.first; });
+		size_t merged = 0;
+		for (size_t r = 1; r < ranges.size(); ++r) {
+			if (ranges[merged].first + ranges[merged].count == ranges[r].first) {
+				ranges[merged].count += ranges[r].count;
+			}
+			else {
+				ranges[++merged] = ranges[r];
+			}
+		}
+		ranges.resize(ranges.empty() ? 0 : merged + 1);
+		return selected;
+	}
+
+	GLuint PointOctree::buffer(void) const
+	{
+		if (!_buffer) {
+			upload();
+		}
+		return _buffer;
+	}
+
+	GLuint PointOctree::vertexArray(void) const
+	{
+		if (!_vao) {
+			upload();
+		}
+		return _vao;
+	}
+
+	void PointOctree::upload(void) const
+	{
+		const size_t bytes = sizeof(Point) * _packed.size();
+		glCreateBuffers(1, &_buffer);
+		glNamedBufferStorage(_buffer, std::max(bytes, sizeof(Point)), _packed.empty() ? nullptr : _packed.data(), 0);
+
+		glCreateVertexArrays(1, &_vao);
+		glVertexArrayVertexBuffer(_vao, 0, _buffer, 0, GLsizei(sizeof(Point)));
+		glEnableVertexArrayAttrib(_vao, 0);
+		glVertexArrayAttribFormat(_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(_vao, 0, 0);
+		glEnableVertexArrayAttrib(_vao, 1);
+		glVertexArrayAttribFormat(_vao, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, GLuint(sizeof(Vector3f)));
+		glVertexArrayAttribBinding(_vao, 1, 0);
+		CHECK_GL_ERROR;
+
+		_memory.set(bytes);
+		std::vector<Point>().swap(_packed);
+	}
+
+} // namespace sibr
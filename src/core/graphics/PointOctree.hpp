@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#pragma once
+
+# include <vector>
+# include "core/graphics/Config.hpp"
+# include "core/graphics/Mesh.hpp"
+# include "core/graphics/Camera.hpp"
+# include "core/graphics/MemoryTracker.hpp"
+
+namespace sibr
+{
+	/** Point cloud reorganized in an octree for level-of-detail rendering.
+	 * Each inner node keeps a subsample of its points, about one per cell of a regular grid over its
+	 * bounds, and passes the others to its children; every point belongs to exactly one node. Rendering
+	 * a node and all its ancestors thus gives the cloud at the density of that node.
+	 * The points are stored on the GPU in node order, so that the points of a node, and of a subtree,
+	 * are contiguous: each point is a vec4, the position and the RGBA8 color stored in the w bits.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT PointOctree
+	{
+		SIBR_CLASS_PTR(PointOctree);
+		SIBR_DISALLOW_COPY(PointOctree);
+
+	public:
+
+		/// A node of the hierarchy.
+		struct Node {
+			Eigen::AlignedBox<float, 3> box; ///< Bounds of the points of the subtree.
+			float spacing = 0.0f; ///< Distance between the points of the node, in world units; 0 for leaves.
+			uint first = 0; ///< First point of the node.
+			uint count = 0; ///< Number of points of the node.
+			int children[8] = { -1, -1, -1, -1, -1, -1, -1, -1 }; ///< Child nodes, -1 when empty.
+		};
+
+		/// A range of contiguous points.
+		struct Range {
+			uint first; ///< First point.
+			uint count; ///< Number of points.
+		};
+
+		/** Build the hierarchy, on the CPU. The GPU buffer is created on first use, from the GL thread.
+		\param mesh the points, and their colors if any
+		\param leafSize the maximum number of points of a leaf
+		\param grid the subsampling grid resolution of the inner nodes
+		*/
+		PointOctree(const Mesh & mesh, uint leafSize = 16384, uint grid = 64);
+
+		/// Destructor.
+		~PointOctree(void);
+
+		/** Select the nodes to render for a viewpoint, coarse to fine: the children of a node are visited while its
+		 * points appear further apart than pixelSpacing, and nodes outside of the view frustum are skipped.
+		\param eye the viewpoint
+		\param viewportHeight the height of the rendered image, in pixels
+		\param pixelSpacing the target distance between points on screen, in pixels
+		\param pointBudget stop refining once this many points are selected, 0 for no limit
+		\param ranges will contain the selected points, sorted and merged
+		\return the number of selected points
+		*/
+		size_t select(const Camera & eye, float viewportHeight, float pixelSpacing, size_t pointBudget, std::vector<Range> & ranges) const;
+
+		/** \return the GPU point buffer, created and uploaded on first call. */
+		GLuint buffer(void) const;
+
+		/** \return a vertex array reading the point buffer, position at location 0 and normalized color at location 1. */
+		GLuint vertexArray(void) const;
+
+		/** \return the nodes, the root first. */
+		const std::vector<Node> & nodes(void) const { return _nodes; }
+
+		/** \return the number of points. */
+		size_t pointCount(void) const { return _pointCount; }
+
+	private:
+
+		/// A point as stored on the GPU.
+		struct Point {
+			Vector3f position; ///< Position.
+			uint32 color; ///< RGBA8 color, red in the lowest byte.
+		};
+
+		/** Build the subtree of a node.
+		\param node the node index
+		\param begin the first point of the subtree in _order
+		\param end the end of the points of the subtree in _order
+		\param cell the cubic cell of the node, split in octants for the children
+		\param positions the input positions
+		\param depth the node depth
+		*/
+		void build(size_t node, size_t begin, size_t end, const Eigen::AlignedBox<float, 3> & cell, const std::vector<Vector3f> & positions, int depth);
+
+		/** Create the GPU buffer from the packed points, then release them. */
+		void upload(void) const;
+
+		std::vector<Node> _nodes; ///< Nodes, in depth first order.
+		std::vector<uint> _order; ///< Input point of each stored point, during the build.
+		std::vector<uint> _scratch; ///< Temporary storage of the build.
+		std::vector<uint> _stamps; ///< Last node that picked each grid cell, during the build.
+		mutable std::vector<Point> _packed; ///< Points waiting for the upload.
+		mutable GLuint _buffer = 0; ///< Point buffer.
+		mutable GLuint _vao = 0; ///< Vertex array over the point buffer.
+		mutable TrackedMemory _memory = TrackedMemory(MemoryTracker::BUFFER); ///< Size of the point buffer.
+		size_t _pointCount = 0; ///< Number of points.
+		uint _leafSize; ///< Maximum number of points of a leaf.
+		uint _grid; ///< Subsampling grid resolution.
+	};
+
+} // namespace sibr
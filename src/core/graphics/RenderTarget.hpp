@@ -18,6 +18,10 @@
 # include "core/graphics/Types.hpp"
 # include "core/system/Vector.hpp"
 # include "core/graphics/RenderUtility.hpp"
+# include "core/graphics/PixelReadback.hpp"
+# include "core/graphics/GLState.hpp"
+# include "core/graphics/MemoryTracker.hpp"
+# include "core/graphics/ImageBufferPool.hpp"
 
 
 # define SIBR_MAX_SHADER_ATTACHMENTS (1<<3)
@@ -102,6 +106,7 @@ namespace sibr
 		bool   m_stencil = false; ///< Has a stencil buffer.
 		uint   m_W = 0; ///< Width.
 		uint   m_H = 0; ///< Height.
+		TrackedMemory m_Memory = TrackedMemory(MemoryTracker::RENDER_TARGET); ///< Size of the attachments.
 
 	public:
 
@@ -169,6 +174,15 @@ namespace sibr
 		template <typename TType, uint NNumComp>
 		void readBack(sibr::Image<TType, NNumComp>& image, uint target = 0) const;
 
+		/** Issue the readback of a color attachment without waiting for the GPU.
+		 The pixels are fetched later from the readback ring, in an image of the target pixel type.
+		\param readback the readback ring to read into
+		\param target the color attachment index to read
+		eturn the ticket to fetch the image with
+		\sa PixelReadback::fetch
+		*/
+		PixelReadback::Ticket readBackAsync(PixelReadback & readback, uint target = 0) const;
+
 		/** Readback the content of a color attachment into a cv::Mat on the CPU.
 		\param image will contain the texture content
 		\param target the color attachment index to read
@@ -403,7 +417,7 @@ namespace sibr
 				//glBindRenderbuffer(GL_RENDERBUFFER, m_stencil_rb);
 				//glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, w, h);
 				CHECK_GL_ERROR;
-				glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 				for (uint n = 0; n < m_numtargets; n++) {
 					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + n, GL_TEXTURE_2D, m_textures[n], 0);
 				}
@@ -415,7 +429,7 @@ namespace sibr
 				//CHECK_GL_ERROR;
 				//glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_stencil_rb);
 			} else {
-				glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_textures[0], 0);
 				glDrawBuffer(GL_NONE);
 				glReadBuffer(GL_NONE);
@@ -442,7 +456,7 @@ namespace sibr
 			);
 			glBindRenderbuffer(GL_RENDERBUFFER, m_depth_rb);
 			glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa_samples, GL_DEPTH_COMPONENT32, w, h);
-			glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 			glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[0], 0);
 			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth_rb);
 		}
@@ -466,15 +480,21 @@ namespace sibr
 				glGenerateMipmap(GL_TEXTURE_2D);
 			}
 		}
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 		CHECK_GL_ERROR;
+
+		// Color attachments and the 32 bits depth renderbuffer, per sample.
+		const size_t samples = m_msaa ? (((flags >> 7) & 0xF) << 2) : 1;
+		const size_t colorBytes = MemoryTracker::textureBytes(w, h, m_numtargets, m_autoMIPMAP ? 0 : 1, double(sizeof(T_Type) * T_NumComp));
+		const size_t depthBytes = is_depth ? 0 : size_t(w) * size_t(h) * 4;
+		m_Memory.set(samples * (colorBytes + depthBytes));
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
 	RenderTarget<T_Type, T_NumComp>::~RenderTarget(void) {
 		for (uint i = 0; i < m_numtargets; i++)
 			glDeleteTextures(1, &m_textures[i]);
-		glDeleteFramebuffers(1, &m_fbo);
+		GLState::deleteFramebuffers(1, &m_fbo);
 		glDeleteRenderbuffers(1, &m_depth_rb);
 		CHECK_GL_ERROR;
 	}
@@ -497,7 +517,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp>
 	void RenderTarget<T_Type, T_NumComp>::bind(void) {
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 		bool is_depth = (GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::isdepth != 0);
 		if (!is_depth) {
 			if (m_numtargets > 0) {
@@ -520,7 +540,7 @@ namespace sibr
 				glGenerateMipmap(GL_TEXTURE_2D);
 			}
 		}
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
@@ -567,34 +587,61 @@ namespace sibr
 		if (target >= m_numtargets)
 			SIBR_ERR << "Reading back texture out of bounds" << std::endl;
 
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 		bool is_depth = (GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::isdepth != 0);
 		if (!is_depth) {
 			if (m_numtargets > 0) {
-				sibr::Image<T_Type, T_NumComp> buffer(m_W, m_H);
-
 				GLenum drawbuffers = GL_COLOR_ATTACHMENT0 + target;
 				glDrawBuffers(1, &drawbuffers);
 				glReadBuffer(drawbuffers);
 
-				glReadPixels(0, 0, m_W, m_H,
-					GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::format,
-					GLType<typename PixelFormat::Type>::type,
-					buffer.data()
-				);
-
-				sibr::Image<T_IType, N_INumComp>	out;
-				img.fromOpenCV(buffer.toOpenCV());
+				// Matching formats are read straight into the image, otherwise through a buffer converted once.
+				const bool sameFormat = opencv::imageType<T_IType>() == opencv::imageType<T_Type>() && N_INumComp == T_NumComp;
+				if (sameFormat) {
+					if (img.w() != m_W || img.h() != m_H || !img.toOpenCV().isContinuous()) {
+						img = sibr::Image<T_IType, N_INumComp>(m_W, m_H);
+					}
+					glReadPixels(0, 0, m_W, m_H,
+						GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::format,
+						GLType<typename PixelFormat::Type>::type,
+						img.data()
+					);
+					pixels::flipRows(img.data(), img.data(), m_H, size_t(m_W) * img.sizeOfComp());
+				} else {
+					// The conversion buffer is recycled between read backs.
+					PooledImage<T_Type, T_NumComp> pooled(m_W, m_H);
+					sibr::Image<T_Type, T_NumComp> & buffer = pooled.image();
+					glReadPixels(0, 0, m_W, m_H,
+						GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::format,
+						GLType<typename PixelFormat::Type>::type,
+						buffer.data()
+					);
+					pixels::flipRows(buffer.data(), buffer.data(), m_H, size_t(m_W) * buffer.sizeOfComp());
+					img.fromOpenCV(buffer.toOpenCV());
+				}
 			}
 		} else
 			SIBR_ERR << "RenderTarget::readBack: This function should be specialized "
 			"for handling depth buffer." << std::endl;
-		img.flipH();
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	}
 
 
+	template<typename T_Type, unsigned int T_NumComp>
+	PixelReadback::Ticket RenderTarget<T_Type, T_NumComp>::readBackAsync(PixelReadback & readback, uint target) const {
+		if (target >= m_numtargets)
+			SIBR_ERR << "Reading back texture out of bounds" << std::endl;
+		if (GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::isdepth != 0)
+			SIBR_ERR << "RenderTarget::readBackAsync: depth buffers are not supported." << std::endl;
+
+		return readback.read(m_fbo, target, m_W, m_H,
+			GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::format,
+			GLType<typename PixelFormat::Type>::type,
+			sizeof(typename PixelFormat::Type) * PixelFormat::NumComp
+		);
+	}
+
 	template<typename T_Type, unsigned int T_NumComp>
 	template <typename T_IType, uint N_INumComp>
 	void RenderTarget<T_Type, T_NumComp>::readBackToCVmat(cv::Mat& img, uint target) const {
@@ -606,7 +653,7 @@ namespace sibr
 
 		cv::Mat tmp(m_H, m_W, Infos::cv_type());
 
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 		bool is_depth = (Infos::isdepth != 0);
 		if (!is_depth) {
 			if (m_numtargets > 0) {
@@ -625,13 +672,13 @@ namespace sibr
 				"for handling depth buffer." << std::endl; \
 		}
 		img = Infos::flip(tmp);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	template <typename TType, uint NNumComp>
 	template <typename T_IType, uint N_INumComp>
 	void RenderTarget<TType, NNumComp>::readBackDepth(sibr::Image<T_IType, N_INumComp>& image) const {
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
 		glReadBuffer(GL_COLOR_ATTACHMENT0);
 
@@ -648,7 +695,7 @@ namespace sibr
 				out.color(x, y, sibr::ColorRGBA(1, 1, 1, 1.f) * buffer(x, y)[0]);
 		image = std::move(out);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
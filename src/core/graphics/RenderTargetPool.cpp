@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "RenderTargetPool.hpp"
+#include "GPUMemoryBudget.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace sibr {
+
+	RenderTargetPool & RenderTargetPool::global()
+	{
+		static RenderTargetPool pool;
+		// Released targets are the first thing to drop under memory pressure.
+		static const GPUMemoryBudget::Id budgetId = GPUMemoryBudget::global().add("Render target pool", GPUMemoryBudget::CACHE, [](size_t bytes) {
+			return pool.trim(bytes);
+		});
+		(void)budgetId;
+		return pool;
+	}
+
+	IRenderTarget::Ptr RenderTargetPool::reuse(const Key & key)
+	{
+		const auto range = _targets.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it) {
+			// Only the pool holds it.
+			if (it->second.target.use_count() == 1) {
+				it->second.lastUsed = _frame;
+				return it->second.target;
+			}
+		}
+		return nullptr;
+	}
+
+	void RenderTargetPool::add(const Key & key, const IRenderTarget::Ptr & target, size_t bytes)
+	{
+		Entry entry;
+		entry.target = target;
+		entry.bytes = bytes;
+		entry.lastUsed = _frame;
+		_targets.emplace(key, entry);
+	}
+
+	void RenderTargetPool::nextFrame()
+	{
+		++_frame;
+		for (auto it = _targets.begin(); it != _targets.end();) {
+			Entry & entry = it->second;
+			if (entry.target.use_count() > 1) {
+				entry.lastUsed = _frame;
+			}
+			else if (_frame - entry.lastUsed > _maxIdleFrames) {
+				it = _targets.erase(it);
+				continue;
+			}
+			++it;
+		}
+	}
+
+	void RenderTargetPool::clear()
+	{
+		for (auto it = _targets.begin(); it != _targets.end();) {
+			if (it->second.target.use_count() == 1) {
+				it = _targets.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	size_t RenderTargetPool::trim(size_t bytes)
+	{
+		std::vector<std::multimap<Key, Entry>::iterator> released;
+		for (auto it = _targets.begin(); it != _targets.end(); ++it) {
+			if (it->second.target.use_count() == 1) {
+				released.push_back(it);
+			}
+		}
+		std::sort(released.begin(), released.end(), [](const std::multimap<Key, Entry>::iterator & a, const std::multimap<Key, Entry>::iterator & b) {
+			return a->second.lastUsed < b->second.lastUsed;
+		});
+		size_t freed = 0;
+		for (const auto & it : released) {
+			if (freed >= bytes) {
+				break;
+			}
+			freed += it->second.bytes;
+			_targets.erase(it);
+		}
+		return freed;
+	}
+
+	size_t RenderTargetPool::memory() const
+	{
+		size_t bytes = 0;
+		for (const auto & target : _targets) {
+			bytes += target.second.bytes;
+		}
+		return bytes;
+	}
+
+	size_t RenderTargetPool::freeMemory() const
+	{
+		size_t bytes = 0;
+		for (const auto & target : _targets) {
+			if (target.second.target.use_count() == 1) {
+				bytes += target.second.bytes;
+			}
+		}
+		return bytes;
+	}
+
+	size_t RenderTargetPool::estimate(uint w, uint h, uint flags, uint num, size_t pixelSize, bool depth)
+	{
+		// Same sample count as the RenderTarget allocation.
+		const size_t samples = (flags & SIBR_GPU_MULSTISAMPLE) ? std::max(size_t(((flags >> 7) & 0xF) << 2), size_t(1)) : size_t(1);
+		size_t bytes = size_t(w) * h * pixelSize * num;
+		if (flags & SIBR_GPU_AUTOGEN_MIPMAP) {
+			bytes += bytes / 3;
+		}
+		if (depth) {
+			bytes += size_t(w) * h * 4;
+		}
+		return bytes * samples;
+	}
+
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/RenderTarget.hpp>
+#include <map>
+#include <tuple>
+#include <typeindex>
+
+namespace sibr {
+
+	/**
+	 * Shared pool of render targets, keyed by pixel type, size, flags (including the MSAA sample count)
+	 * and number of color attachments.
+	 * A target acquired from the pool is in use as long as a pointer to it is held outside of the pool;
+	 * once all of them are released, the next request with the same key gets it back instead of
+	 * allocating a new framebuffer. Targets unused for more than maxIdleFrames() frames are destroyed.
+	 *
+	 *		// On resize, the previous target returns to the pool.
+	 *		_depthRT = RenderTargetPool::global().acquire<float, 4>(w, h);
+	 *
+	 * \note The content of an acquired target is undefined.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT RenderTargetPool {
+		SIBR_DISALLOW_COPY(RenderTargetPool);
+
+	public:
+
+		/// Constructor.
+		RenderTargetPool() = default;
+
+		/** \return the pool shared by all renderers. */
+		static RenderTargetPool & global();
+
+		/** Get a render target, reusing a released one if possible.
+		\param w the target width
+		\param h the target height
+		\param flags options, see RenderTarget
+		\param num the number of color attachments
+		\return the target
+		*/
+		template <typename T_Type, uint T_NumComp>
+		typename RenderTarget<T_Type, T_NumComp>::Ptr acquire(uint w, uint h, uint flags = 0, uint num = 1);
+
+		/** Advance the frame counter and destroy targets released for more than maxIdleFrames() frames.
+		 Called by Window::swapBuffer for the global pool. */
+		void nextFrame();
+
+		/** Destroy all released targets. */
+		void clear();
+
+		/** Destroy released targets, least recently used first, see GPUMemoryBudget.
+		\param bytes the memory to release
+		\return the estimated memory released, in bytes
+		*/
+		size_t trim(size_t bytes);
+
+		/** \return the estimated GPU memory of all targets in the pool, in bytes. */
+		size_t memory() const;
+
+		/** \return the estimated GPU memory of the released targets, in bytes. */
+		size_t freeMemory() const;
+
+		/** \return the number of targets in the pool. */
+		size_t size() const { return _targets.size(); }
+
+		/** \return the number of frames a released target is kept. */
+		uint & maxIdleFrames() { return _maxIdleFrames; }
+
+	private:
+
+		/// Pixel type, width, height, flags and number of attachments.
+		typedef std::tuple<std::type_index, uint, uint, uint, uint> Key;
+
+		/// A target and its use.
+		struct Entry {
+			IRenderTarget::Ptr target; ///< The target.
+			size_t bytes; ///< Estimated GPU memory.
+			uint64_t lastUsed; ///< Frame when it was last acquired or seen in use.
+		};
+
+		/** Find a released target.
+		\param key the target key
+		\return the target or nullptr if none is free
+		*/
+		IRenderTarget::Ptr reuse(const Key & key);
+
+		/** Register a new target.
+		\param key the target key
+		\param target the target
+		\param bytes its estimated GPU memory
+		*/
+		void add(const Key & key, const IRenderTarget::Ptr & target, size_t bytes);
+
+		/** Estimate the memory used by a target.
+		\param w the target width
+		\param h the target height
+		\param flags options
+		\param num the number of color attachments
+		\param pixelSize the size of a pixel in bytes
+		\param depth does the target have a depth attachment
+		\return the size in bytes
+		*/
+		static size_t estimate(uint w, uint h, uint flags, uint num, size_t pixelSize, bool depth);
+
+		std::multimap<Key, Entry> _targets; ///< All targets.
+		uint64_t _frame = 0; ///< Current frame.
+		uint _maxIdleFrames = 120; ///< Frames a released target is kept.
+	};
+
+	template <typename T_Type, uint T_NumComp>
+	typename RenderTarget<T_Type, T_NumComp>::Ptr RenderTargetPool::acquire(uint w, uint h, uint flags, uint num) {
+		typedef RenderTarget<T_Type, T_NumComp> Target;
+		const Key key(std::type_index(typeid(Target)), w, h, flags, num);
+		if (IRenderTarget::Ptr target = reuse(key)) {
+			return std::static_pointer_cast<Target>(target);
+		}
+		typename Target::Ptr target(new Target(w, h, flags, num));
+		const bool depth = GLFormat<T_Type, T_NumComp>::isdepth == 0;
+		add(key, target, estimate(w, h, flags, num, sizeof(T_Type) * T_NumComp, depth));
+		return target;
+	}
+
+}
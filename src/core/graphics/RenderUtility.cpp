@@ -13,6 +13,7 @@
 
 #include "core/graphics/Shader.hpp"
 #include "core/graphics/RenderUtility.hpp"
+#include "core/graphics/StreamingBuffer.hpp"
 #include "core/graphics/Window.hpp"
 
 #define SIBR_WRITESHADER(src) "#version 420 core\n" #src
@@ -66,34 +67,28 @@ namespace sibr
 
 	/*static*/ void		RenderUtility::renderScreenQuad( bool reverse, GLfloat tex_coor[] )
 	{
-		static GLfloat vert[] = { -1,-1,0,  1,-1,0,  1,1,0,  -1,1,0 };
-		static GLfloat tcoord[8];
-		static GLuint indexVBO, VAO, vertTexVBO;
+		static const GLfloat vert[] = { -1,-1,0,  1,-1,0,  1,1,0,  -1,1,0 };
+		static const GLuint  ind[] = { 0,1,2,  0,2,3 };
+		static GLuint indexVBO, VAO;
 
 		static bool firstTime = true;
-		
+
+		GLfloat tcoord[8];
 		if(reverse)
 		{
-			GLfloat tmp[] = { 0,1,  0,0,  1,0,  1,1 };
-			if( tex_coor )
-				std::memcpy(tmp, tex_coor, sizeof tmp );
-
-			std::memcpy(tcoord, tmp, sizeof tcoord);
-			if( !firstTime )  // re-transfer to GPUs
-				sendVertsTexToGPU(vertTexVBO, vert, tcoord, sizeof(vert), sizeof(tcoord));
+			const GLfloat tmp[] = { 0,1,  0,0,  1,0,  1,1 };
+			std::memcpy(tcoord, tex_coor ? tex_coor : tmp, sizeof tcoord);
 		}
 		else
 		{
-			GLfloat tmp[] = { 0,0,  1,0,  1,1,  0,1 };
-			if( tex_coor )
-				std::memcpy(tmp, tex_coor, sizeof tmp );	
-
-			std::memcpy(tcoord, tmp, sizeof tcoord);
-			if( !firstTime )  // re-transfer to GPU
-				sendVertsTexToGPU(vertTexVBO, vert, tcoord, sizeof(vert), sizeof(tcoord));
+			const GLfloat tmp[] = { 0,0,  1,0,  1,1,  0,1 };
+			std::memcpy(tcoord, tex_coor ? tex_coor : tmp, sizeof tcoord);
 		}
 
-		static GLuint  ind[] = { 0,1,2,  0,2,3 };
+		// The coordinates can change with each call: stream them, a buffer still read by previous draws can't be updated without a stall.
+		const StreamingBuffer::Allocation vertices = StreamingBuffer::global().allocate(sizeof(vert) + sizeof(tcoord), StreamingBuffer::VERTEX);
+		std::memcpy(vertices.data, vert, sizeof(vert));
+		std::memcpy(static_cast<char*>(vertices.data) + sizeof(vert), tcoord, sizeof(tcoord));
 
 		if( firstTime ) {
 			firstTime = false;
@@ -104,20 +99,17 @@ namespace sibr
 			glGenBuffers(1, &indexVBO);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ind), ind, GL_STATIC_DRAW);
-
-			glGenBuffers(1, &vertTexVBO);
-			sendVertsTexToGPU(vertTexVBO, vert, tcoord, sizeof(vert), sizeof(tcoord));
 		}
 
 		glBindVertexArray(VAO);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, vertTexVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, vertices.buffer);
 
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)sizeof(vert)	);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)vertices.offset);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(vertices.offset + sizeof(vert)));
 
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
 
@@ -163,13 +155,13 @@ namespace sibr
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, FindexVBO);
 		
 		const GLboolean cullingWasEnabled = glIsEnabled(GL_CULL_FACE);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLState::enable(GL_CULL_FACE);
+		GLState::cullFace(GL_BACK);
 
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
 
 		if (!cullingWasEnabled) {
-			glDisable(GL_CULL_FACE);
+			GLState::disable(GL_CULL_FACE);
 		}
 
 		glBindVertexArray(0);
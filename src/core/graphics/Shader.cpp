@@ -13,7 +13,16 @@
 
 # include "core/graphics/Shader.hpp"
 # include "core/system/Matrix.hpp"
+# include "core/graphics/FrameProfiler.hpp"
+#include "core/system/Hash.hpp"
 #include "core/system/String.hpp"
+#include "core/system/Utils.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 
 
 # ifndef SIBR_MAXIMIZE_INLINE
@@ -22,6 +31,74 @@
 
 namespace sibr
 {
+	namespace {
+
+		const char kBinaryMagic[8] = { 'S', 'I', 'B', 'R', 'S', 'H', 'D', '\0' };
+
+		#ifndef GL_COMPLETION_STATUS_KHR
+		#define GL_COMPLETION_STATUS_KHR 0x91B1
+		#endif
+
+		/** \return true if the driver exposes GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile. */
+		bool parallelCompileSupported()
+		{
+			static const bool supported = []() {
+				GLint count = 0;
+				glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+				for (GLint i = 0; i < count; ++i) {
+					const GLubyte * ext = glGetStringi(GL_EXTENSIONS, GLuint(i));
+					if (ext && (std::strcmp(reinterpret_cast<const char*>(ext), "GL_KHR_parallel_shader_compile") == 0
+						|| std::strcmp(reinterpret_cast<const char*>(ext), "GL_ARB_parallel_shader_compile") == 0)) {
+						return true;
+					}
+				}
+				return false;
+			}();
+			return supported;
+		}
+
+		struct BinaryHeader
+		{
+			char magic[8];
+			uint32_t format;
+			uint32_t length;
+		};
+
+		std::string glString(GLenum name)
+		{
+			const GLubyte * str = glGetString(name);
+			return str ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+		}
+
+		/** \return the cache file of a program, empty if binaries are not supported. */
+		std::string binaryCachePath(const std::vector<const std::string*> & sources)
+		{
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			if (formats <= 0) {
+				return "";
+			}
+			static const std::string directory = []() {
+				const std::string dir = getAppDataDirectory() + "/shader_cache";
+				makeDirectory(dir);
+				return dir;
+			}();
+
+			// Binaries are only valid for the driver that produced them.
+			// Strings are hashed with their size, so that moving code from one stage to the next changes the key.
+			Hasher hasher;
+			hasher.update(glString(GL_VENDOR));
+			hasher.update(glString(GL_RENDERER));
+			hasher.update(glString(GL_VERSION));
+			for (const std::string * source : sources) {
+				hasher.update(*source);
+			}
+			return directory + "/" + hasher.digest128().toString() + ".bin";
+		}
+	}
+
+	bool GLShader::s_BinaryCache = true;
+
 	GLuint GLShader::compileShader(const char* shader_code, GLuint type)
 	{
 		std::string shader_type;
@@ -58,7 +135,8 @@ namespace sibr
 		m_Shader(0),
 		m_Name(""),
 		m_Strict(false),
-		m_Active(false)
+		m_Active(false),
+		m_Pending(false)
 	{}
 
 	GLShader::~GLShader(void) {
@@ -108,13 +186,28 @@ namespace sibr
 		std::string tcs_code,
 		std::string tes_code)
 	{
+		SIBR_PROFILE_CPU("Shader compile");
 		terminate();
 
 		m_Name = name;
+
+		// The defines are already part of the code strings.
+		const std::string cachePath = s_BinaryCache ?
+			binaryCachePath({ &vp_code, &fp_code, &gp_code, &tcs_code, &tes_code }) : std::string();
+		if (!cachePath.empty() && loadBinary(cachePath)) {
+			GLState::useProgram(0);
+			CHECK_GL_ERROR;
+			return true;
+		}
+
 		m_Shader = glCreateProgram();
 
 		CHECK_GL_ERROR;
 
+		if (!cachePath.empty()) {
+			glProgramParameteri(m_Shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
 		GLint vp = 0, fp = 0, gp = 0, tcs = 0, tes = 0;
 
 		if (!vp_code.empty()) {
@@ -171,6 +264,9 @@ namespace sibr
 			if (exitOnError)
 				SIBR_ERR << "GLSL program failed to link" << std::endl;
 		}
+		else if (!cachePath.empty()) {
+			saveBinary(cachePath);
+		}
 
 		if (vp) glDeleteShader(vp);
 		if (fp) glDeleteShader(fp);
@@ -178,13 +274,126 @@ namespace sibr
 		if (tcs) glDeleteShader(tcs);
 		if (tes) glDeleteShader(tes);
 
-		glUseProgram(0);
+		GLState::useProgram(0);
 
 		CHECK_GL_ERROR;
 		return true;
 	}
 
 
+	bool GLShader::initDeferred(std::string name,
+		std::string vp_code,
+		std::string fp_code,
+		std::string gp_code,
+		std::string tcs_code,
+		std::string tes_code)
+	{
+		SIBR_PROFILE_CPU("Shader compile");
+		terminate();
+
+		m_Name = name;
+		m_CachePath = s_BinaryCache ?
+			binaryCachePath({ &vp_code, &fp_code, &gp_code, &tcs_code, &tes_code }) : std::string();
+		if (!m_CachePath.empty() && loadBinary(m_CachePath)) {
+			m_CachePath.clear();
+			GLState::useProgram(0);
+			CHECK_GL_ERROR;
+			return true;
+		}
+
+		m_Shader = glCreateProgram();
+		if (!m_CachePath.empty()) {
+			glProgramParameteri(m_Shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		// No status query here, the driver can compile in the background until finish() or isLinked() is called.
+		const std::string * codes[] = { &vp_code, &fp_code, &gp_code, &tcs_code, &tes_code };
+		const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
+		for (int s = 0; s < 5; ++s) {
+			if (codes[s]->empty()) {
+				continue;
+			}
+			const char * code = codes[s]->c_str();
+			const GLuint id = glCreateShader(types[s]);
+			glShaderSource(id, 1, &code, NULL);
+			glCompileShader(id);
+			glAttachShader(m_Shader, id);
+			m_Stages.push_back(id);
+		}
+		glLinkProgram(m_Shader);
+		m_Pending = true;
+
+		CHECK_GL_ERROR;
+		return true;
+	}
+
+	bool GLShader::isLinked(void)
+	{
+		if (!m_Pending) {
+			return m_Shader != 0;
+		}
+		// Without the extension, querying the status would stall: finish right away.
+		if (parallelCompileSupported()) {
+			GLint done = 0;
+			glGetProgramiv(m_Shader, GL_COMPLETION_STATUS_KHR, &done);
+			if (!done) {
+				return false;
+			}
+		}
+		return finish(false);
+	}
+
+	bool GLShader::finish(bool exitOnError)
+	{
+		if (!m_Pending) {
+			return m_Shader != 0;
+		}
+		SIBR_PROFILE_CPU("Shader compile");
+		m_Pending = false;
+
+		GLint linked = 0;
+		glGetProgramiv(m_Shader, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			for (const GLuint id : m_Stages) {
+				GLint compiled = 0;
+				glGetShaderiv(id, GL_COMPILE_STATUS, &compiled);
+				if (compiled) {
+					continue;
+				}
+				GLint maxLength = 0;
+				glGetShaderiv(id, GL_INFO_LOG_LENGTH, &maxLength);
+				std::vector<char> infoLog(maxLength + 1, '\0');
+				glGetShaderInfoLog(id, maxLength, NULL, infoLog.data());
+				SIBR_WRG << "GLSL shader compilation failed for program " << m_Name << std::endl << infoLog.data() << std::endl;
+			}
+			GLint maxLength = 0;
+			glGetProgramiv(m_Shader, GL_INFO_LOG_LENGTH, &maxLength);
+			std::vector<char> infoLog(maxLength + 1, '\0');
+			glGetProgramInfoLog(m_Shader, maxLength, NULL, infoLog.data());
+			SIBR_WRG << "GLSL program failed to link " << m_Name << std::endl
+				<< "Shader linking log:" << std::endl
+				<< infoLog.data() << std::endl;
+		}
+		else if (!m_CachePath.empty()) {
+			saveBinary(m_CachePath);
+		}
+		m_CachePath.clear();
+
+		for (const GLuint id : m_Stages) {
+			glDeleteShader(id);
+		}
+		m_Stages.clear();
+
+		if (!linked) {
+			GLState::deleteProgram(m_Shader);
+			m_Shader = 0;
+			if (exitOnError)
+				SIBR_ERR << "GLSL program failed to link" << std::endl;
+		}
+		(void)glGetError();
+		return linked != 0;
+	}
+
 	bool GLShader::reload(
 		std::string vp_code,
 		std::string fp_code,
@@ -221,11 +430,95 @@ namespace sibr
 	
 	}
 
+	void GLShader::enableBinaryCache(bool enable)
+	{
+		s_BinaryCache = enable;
+	}
+
+	bool GLShader::loadBinary(const std::string & path)
+	{
+		std::ifstream file(path, std::ios_base::binary);
+		if (!file) {
+			return false;
+		}
+		BinaryHeader header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(BinaryHeader));
+		if (!file || std::memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0 || header.length == 0) {
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		file.read(binary.data(), std::streamsize(binary.size()));
+		if (!file) {
+			return false;
+		}
+		file.close();
+
+		m_Shader = glCreateProgram();
+		glProgramBinary(m_Shader, GLenum(header.format), binary.data(), GLsizei(binary.size()));
+		GLint linked = 0;
+		glGetProgramiv(m_Shader, GL_LINK_STATUS, &linked);
+		// Drivers reject binaries after an update, the program is then compiled again and the file replaced.
+		(void)glGetError();
+		if (!linked) {
+			GLState::deleteProgram(m_Shader);
+			m_Shader = 0;
+			std::remove(path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	void GLShader::saveBinary(const std::string & path) const
+	{
+		GLint length = 0;
+		glGetProgramiv(m_Shader, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(m_Shader, length, &written, &format, binary.data());
+		if (written <= 0) {
+			return;
+		}
+		BinaryHeader header;
+		std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+		header.format = uint32_t(format);
+		header.length = uint32_t(written);
+
+		// Write to a temporary file first, so that concurrent instances never read a partial binary.
+		const std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios_base::binary);
+			if (!file) {
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+			file.write(binary.data(), std::streamsize(written));
+			if (!file) {
+				file.close();
+				std::remove(tmpPath.c_str());
+				return;
+			}
+		}
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::remove(tmpPath.c_str());
+		}
+	}
+
 	void GLShader::terminate( void )
 	{
+		for (const GLuint id : m_Stages) {
+			glDeleteShader(id);
+		}
+		m_Stages.clear();
+		m_CachePath.clear();
+		m_Pending = false;
 		if (m_Shader) {
-			glUseProgram(0);
-			glDeleteProgram(m_Shader);
+			GLState::useProgram(0);
+			GLState::deleteProgram(m_Shader);
 			m_Shader = 0;
 			CHECK_GL_ERROR;
 		}
@@ -252,6 +545,8 @@ namespace sibr
 	{
 		m_Shader = &shader;
 		m_Name   = name;
+		// Uniform locations require the program to be linked.
+		m_Shader->finish();
 		m_Handle = glGetUniformLocation(m_Shader->shader(),name.c_str());
 		m_Strict = m_Shader->isStrict();
 		if (m_Handle == -1) {
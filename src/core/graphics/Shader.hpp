@@ -15,6 +15,7 @@
 # include <vector>
 # include <string>
 # include "core/graphics/Config.hpp"
+# include "core/graphics/GLState.hpp"
 # include "core/system/Matrix.hpp"
 
 #define SIBR_SHADER(version, shader)  std::string("#version " #version "\n" #shader)
@@ -77,6 +78,35 @@ namespace sibr
 			std::string tcs_code = std::string(),
 			std::string tes_code = std::string());
 
+		/** Submit a GPU program for compilation without waiting for it.
+		Submitting all programs before using any of them lets drivers supporting
+		GL_KHR_parallel_shader_compile build them concurrently. Poll isLinked() to know when
+		the program can be used without stalling; begin() and uniform initialization wait for it.
+		\param name the name of the shader (for logging)
+		\param vp_code vertex shader code string
+		\param fp_code fragment shader code string
+		\param gp_code geometry shader code string
+		\param tcs_code tesselation control shader code string
+		\param tes_code tesselation evaluation shader code string
+		\return a success flag, errors are only reported once the program is finished
+		*/
+		bool initDeferred(std::string name,
+			std::string vp_code, std::string fp_code,
+			std::string gp_code = std::string(),
+			std::string tcs_code = std::string(),
+			std::string tes_code = std::string());
+
+		/** Check if a deferred program is done, without blocking when the driver supports it.
+		\return true if the program is linked and can be used
+		*/
+		bool isLinked(void);
+
+		/** Wait for a deferred program and report its errors, does nothing for other programs.
+		\param exitOnError should the application exit on a shader compilation error
+		\return true if the program is linked
+		*/
+		bool finish(bool exitOnError = true);
+
 		/** Recompile a GPU program with updated shaders.
 		\param vp_code vertex shader code string
 		\param fp_code fragment shader code string
@@ -94,6 +124,13 @@ namespace sibr
 		*/
 		void getBinary(std::vector<char> & binary);
 
+		/** Toggle the cache of linked programs, enabled by default.
+		Binaries are stored in the user application directory, keyed on the shader code and the GPU driver,
+		and reused by init instead of compiling the same code again.
+		\param enable the new state
+		*/
+		static void		enableBinaryCache(bool enable);
+
 		/** Bind (activate) the sahder for rendering. */
 		SIBR_OPT_INLINE		void	begin( void );
 
@@ -138,6 +175,17 @@ namespace sibr
 		*/
 		GLuint	compileShader( const char* shader_code, GLuint type );
 
+		/** Create the program from a cached binary.
+		\param path the cache file
+		\return false if the file is missing or was rejected by the driver, in which case it is removed
+		*/
+		bool	loadBinary( const std::string & path );
+
+		/** Store the binary of the linked program.
+		\param path the cache file
+		*/
+		void	saveBinary( const std::string & path ) const;
+
 		/** Check if the shader is properly setup, or raise an error. */
 		SIBR_OPT_INLINE		void	authorize( void ) const;
 
@@ -145,6 +193,11 @@ namespace sibr
 		std::string m_Name; ///< Shader name.
 		bool        m_Strict; ///< Should uniforms be validated.
 		bool        m_Active; ///< Is the shader currently bound.
+		bool        m_Pending; ///< Is a deferred compilation in flight.
+		std::vector<GLuint> m_Stages; ///< Stages of the deferred compilation.
+		std::string m_CachePath; ///< Binary cache file of the deferred compilation.
+
+		static bool s_BinaryCache; ///< Are linked programs cached on disk.
 	};
 
 	// ------------------------------------------------------------------------
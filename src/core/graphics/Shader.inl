@@ -12,15 +12,18 @@ namespace sibr
 	void GLShader::begin( void )
 	{
 		CHECK_GL_ERROR;
+		if (m_Pending) {
+			finish();
+		}
 		authorize();
-		glUseProgram(m_Shader);
+		GLState::useProgram(m_Shader);
 		m_Active = true;
 		CHECK_GL_ERROR;
 	}
 
 	void GLShader::end( void )
 	{
-		glUseProgram(0);
+		GLState::useProgram(0);
 		m_Active = false;
 		CHECK_GL_ERROR;
 	}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "SparseTextureArray.hpp"
+#include "GPUMemoryBudget.hpp"
+#include <algorithm>
+
+namespace sibr {
+
+	bool SparseTextureArray::isSupported(void)
+	{
+		if (!GLEW_ARB_sparse_texture) {
+			return false;
+		}
+		GLint pageSizes = 0;
+		glGetInternalformativ(GL_TEXTURE_2D_ARRAY, GL_RGBA8, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &pageSizes);
+		return pageSizes > 0;
+	}
+
+	SparseTextureArray::SparseTextureArray(const std::vector<ImageRGB::Ptr> & images, size_t budget, uint flags) :
+		_images(images), _flags(flags), _budget(budget)
+	{
+		_layers = int(images.size());
+		Vector2i size(1, 1);
+		for (const auto & img : images) {
+			size = size.cwiseMax(Vector2i(int(img->w()), int(img->h())));
+		}
+		_size = size;
+		int numLevels = 1;
+		while (numLevels < maxLevels && (size.maxCoeff() >> numLevels) > 0) {
+			++numLevels;
+		}
+
+		// Tiles span a whole number of pages, page sizes are powers of two.
+		GLint pageX = 0, pageY = 0;
+		glGetInternalformativ(GL_TEXTURE_2D_ARRAY, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageX);
+		glGetInternalformativ(GL_TEXTURE_2D_ARRAY, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageY);
+		_tileSize = std::max(256, std::max(pageX, pageY));
+
+		// RGB8 has no sparse page size, the images are expanded to RGBA8 on upload.
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &_handle);
+		glTextureParameteri(_handle, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+		glTextureParameteri(_handle, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, 0);
+		const bool linear = (flags & SIBR_GPU_LINEAR_SAMPLING) != 0;
+		glTextureParameteri(_handle, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(_handle, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+		glTextureParameteri(_handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(_handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureStorage3D(_handle, numLevels, GL_RGBA8, size.x(), size.y(), std::max(_layers, 1));
+
+		GLint sparseLevels = 0;
+		glGetTextureParameteriv(_handle, GL_NUM_SPARSE_LEVELS_ARB, &sparseLevels);
+		_tailLevel = std::min(int(sparseLevels), numLevels);
+
+		for (int l = 0; l < _tailLevel; ++l) {
+			Level level;
+			level.size = Vector2i(std::max(size.x() >> l, 1), std::max(size.y() >> l, 1));
+			level.tiles = (level.size + Vector2i(_tileSize - 1, _tileSize - 1)) / _tileSize;
+			level.offset = _tilesPerLayer;
+			_tilesPerLayer += level.tiles.prod();
+			_levels.push_back(level);
+		}
+		_tiles.resize(size_t(_layers) * _tilesPerLayer);
+
+		// The mip tail is committed as a whole and never evicted.
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+		if (_tailLevel < numLevels) {
+			const Vector2i tailSize(std::max(size.x() >> _tailLevel, 1), std::max(size.y() >> _tailLevel, 1));
+			for (int layer = 0; layer < _layers; ++layer) {
+				glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, _tailLevel, 0, 0, layer, tailSize.x(), tailSize.y(), 1, GL_TRUE);
+				for (int l = _tailLevel; l < numLevels; ++l) {
+					const Vector2i levelSize(std::max(size.x() >> l, 1), std::max(size.y() >> l, 1));
+					upload(layer, l, Vector2i(0, 0), levelSize);
+				}
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		// Feedback, read back through a persistent mapping.
+		const GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const GLsizeiptr feedbackBytes = GLsizeiptr(sizeof(uint) * std::max(_tiles.size(), size_t(1)));
+		glCreateBuffers(1, &_feedbackBuffer);
+		glNamedBufferStorage(_feedbackBuffer, feedbackBytes, nullptr, mapFlags);
+		glClearNamedBufferData(_feedbackBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		_feedback = static_cast<const uint*>(glMapNamedBufferRange(_feedbackBuffer, 0, feedbackBytes, mapFlags));
+
+		// Only the tail is resident at first.
+		const int cells = _levels.empty() ? 1 : _levels[0].tiles.prod();
+		_residency.assign(size_t(std::max(_layers, 1)) * cells, uint(_tailLevel));
+		glCreateBuffers(1, &_residencyBuffer);
+		glNamedBufferStorage(_residencyBuffer, sizeof(uint) * _residency.size(), _residency.data(), GL_DYNAMIC_STORAGE_BIT);
+		_dirtyLayers.assign(_layers, false);
+
+		SIBR_LOG << "[SparseTextureArray] " << _layers << " layers of " << size.x() << "x" << size.y() << ", " << _tailLevel
+			<< " sparse levels in tiles of " << _tileSize << " texels, budget of " << (_budget >> 20) << "MB." << std::endl;
+		CHECK_GL_ERROR;
+
+		_budgetId = GPUMemoryBudget::global().add("Sparse texture tiles", GPUMemoryBudget::STREAMED, [this](size_t bytes) {
+			return trim(bytes);
+		});
+	}
+
+	SparseTextureArray::~SparseTextureArray(void)
+	{
+		GPUMemoryBudget::global().remove(_budgetId);
+		if (_fence) {
+			glDeleteSync(_fence);
+		}
+		if (_feedbackBuffer) {
+			glUnmapNamedBuffer(_feedbackBuffer);
+			glDeleteBuffers(1, &_feedbackBuffer);
+		}
+		glDeleteBuffers(1, &_residencyBuffer);
+		glDeleteTextures(1, &_handle);
+	}
+
+	size_t SparseTextureArray::tileIndex(int layer, int level, int x, int y) const
+	{
+		const Level & l = _levels[level];
+		return size_t(layer) * _tilesPerLayer + l.offset + y * l.tiles.x() + x;
+	}
+
+	void SparseTextureArray::bind(GLuint program, GLuint feedbackBinding, GLuint residencyBinding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, feedbackBinding, _feedbackBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, residencyBinding, _residencyBuffer);
+
+		float scales[2 * maxLevels] = { 0.0f };
+		int tiles[3 * maxLevels] = { 0 };
+		for (size_t l = 0; l < _levels.size(); ++l) {
+			scales[2 * l + 0] = float(_levels[l].size.x()) / float(_tileSize);
+			scales[2 * l + 1] = float(_levels[l].size.y()) / float(_tileSize);
+			tiles[3 * l + 0] = _levels[l].tiles.x();
+			tiles[3 * l + 1] = _levels[l].tiles.y();
+			tiles[3 * l + 2] = _levels[l].offset;
+		}
+		glProgramUniform1ui(program, glGetUniformLocation(program, "vtFrame"), uint(_frame));
+		glProgramUniform1i(program, glGetUniformLocation(program, "vtTailLevel"), _tailLevel);
+		glProgramUniform1i(program, glGetUniformLocation(program, "vtTilesPerLayer"), _tilesPerLayer);
+		glProgramUniform2fv(program, glGetUniformLocation(program, "vtLevelScales"), maxLevels, scales);
+		glProgramUniform3iv(program, glGetUniformLocation(program, "vtLevelTiles"), maxLevels, tiles);
+	}
+
+	void SparseTextureArray::update(void)
+	{
+		// The feedback of a frame is read once the GPU is done with it, without waiting.
+		if (_fence && glClientWaitSync(_fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			glDeleteSync(_fence);
+			_fence = 0;
+			collect();
+			_collectedFrame = _fenceFrame;
+		}
+
+		glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		if (!_fence) {
+			_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			_fenceFrame = _frame;
+		}
+		++_frame;
+		uploadResidency();
+	}
+
+	size_t SparseTextureArray::trim(size_t bytes)
+	{
+		const size_t before = _residentBytes;
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+		while (before - _residentBytes < bytes && !_lru.empty()) {
+			pageOut(_lru.begin()->second);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		// The shaders clamp their LOD to the tiles left, and the budget keeps them from coming back.
+		uploadResidency();
+		_budget = std::min(_budget, _residentBytes);
+		CHECK_GL_ERROR;
+		return before - _residentBytes;
+	}
+
+	void SparseTextureArray::uploadResidency(void)
+	{
+		const int cells = _levels.empty() ? 1 : _levels[0].tiles.prod();
+		for (int layer = 0; layer < _layers; ++layer) {
+			if (_dirtyLayers[layer]) {
+				const size_t offset = size_t(layer) * cells;
+				glNamedBufferSubData(_residencyBuffer, sizeof(uint) * offset, sizeof(uint) * cells, &_residency[offset]);
+				_dirtyLayers[layer] = false;
+			}
+		}
+	}
+
+	void SparseTextureArray::collect(void)
+	{
+		struct Request {
+			int layer, level, x, y;
+		};
+		std::vector<Request> requests;
+		std::vector<bool> requested(_tiles.size(), false);
+
+		const uint collected = uint(_collectedFrame);
+		for (int layer = 0; layer < _layers; ++layer) {
+			for (int l = 0; l < _tailLevel; ++l) {
+				const Level & level = _levels[l];
+				for (int y = 0; y < level.tiles.y(); ++y) {
+					for (int x = 0; x < level.tiles.x(); ++x) {
+						const uint stamp = _feedback[tileIndex(layer, l, x, y)];
+						if (stamp <= collected) {
+							continue;
+						}
+						// Coarser tiles are needed for trilinear filtering and as a fallback, and
+						// touching them with their children keeps them from being evicted first.
+						int px = x, py = y;
+						for (int pl = l; pl < _tailLevel; ++pl, px /= 2, py /= 2) {
+							px = std::min(px, _levels[pl].tiles.x() - 1);
+							py = std::min(py, _levels[pl].tiles.y() - 1);
+							const size_t index = tileIndex(layer, pl, px, py);
+							Tile & tile = _tiles[index];
+							if (tile.resident && tile.lastUse < stamp) {
+								_lru.erase({ tile.lastUse, index });
+								_lru.insert({ uint64(stamp), index });
+							}
+							tile.lastUse = std::max(tile.lastUse, uint64(stamp));
+							if (!tile.resident && !requested[index]) {
+								requested[index] = true;
+								requests.push_back({ layer, pl, px, py });
+							}
+						}
+					}
+				}
+			}
+		}
+		_missing = requests.size();
+
+		// Coarse levels first, they are small and unlock the trilinear fallback of the finer ones.
+		std::stable_sort(requests.begin(), requests.end(), [](const Request & a, const Request & b) {
+			return a.level > b.level;
+		});
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		const int uploads = std::min(int(requests.size()), _uploadsPerFrame);
+		for (int r = 0; r < uploads; ++r) {
+			const Request & request = requests[r];
+			const Level & level = _levels[request.level];
+			const Vector2i extent = (level.size - Vector2i(request.x, request.y) * _tileSize).cwiseMin(Vector2i(_tileSize, _tileSize));
+			const size_t bytes = size_t(4) * extent.prod();
+
+			// Evict the least recently used tiles, never those sampled by the collected frame.
+			while (_residentBytes + bytes > _budget && !_lru.empty() && _lru.begin()->first <= collected) {
+				pageOut(_lru.begin()->second);
+			}
+			if (_residentBytes + bytes > _budget) {
+				break;
+			}
+			pageIn(request.layer, request.level, request.x, request.y);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		CHECK_GL_ERROR;
+	}
+
+	void SparseTextureArray::pageIn(int layer, int level, int x, int y)
+	{
+		const Level & l = _levels[level];
+		const Vector2i origin = Vector2i(x, y) * _tileSize;
+		const Vector2i extent = (l.size - origin).cwiseMin(Vector2i(_tileSize, _tileSize));
+		glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, level, origin.x(), origin.y(), layer, extent.x(), extent.y(), 1, GL_TRUE);
+		upload(layer, level, origin, extent);
+
+		const size_t index = tileIndex(layer, level, x, y);
+		Tile & tile = _tiles[index];
+		tile.resident = true;
+		_lru.insert({ tile.lastUse, index });
+		_residentBytes += size_t(4) * extent.prod();
+		_memory.set(_residentBytes);
+		updateResidency(layer, level, x, y);
+	}
+
+	void SparseTextureArray::pageOut(size_t index)
+	{
+		const int layer = int(index / _tilesPerLayer);
+		const int local = int(index % _tilesPerLayer);
+		int level = 0;
+		while (level + 1 < _tailLevel && _levels[level + 1].offset <= local) {
+			++level;
+		}
+		const Level & l = _levels[level];
+		const int x = (local - l.offset) % l.tiles.x();
+		const int y = (local - l.offset) / l.tiles.x();
+		const Vector2i origin = Vector2i(x, y) * _tileSize;
+		const Vector2i extent = (l.size - origin).cwiseMin(Vector2i(_tileSize, _tileSize));
+		glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, level, origin.x(), origin.y(), layer, extent.x(), extent.y(), 1, GL_FALSE);
+
+		Tile & tile = _tiles[index];
+		tile.resident = false;
+		_lru.erase({ tile.lastUse, index });
+		_residentBytes -= size_t(4) * extent.prod();
+		_memory.set(_residentBytes);
+		updateResidency(layer, level, x, y);
+	}
+
+	void SparseTextureArray::upload(int layer, int level, const Vector2i & origin, const Vector2i & size)
+	{
+		const ImageRGB & img = *_images[layer];
+		const Vector2i dstSize(std::max(_size.x() >> level, 1), std::max(_size.y() >> level, 1));
+		const bool flip = (_flags & SIBR_FLIP_TEXTURE) != 0;
+
+		// Region of the source image covered by the texels, the source can be of any size.
+		const int top = flip ? dstSize.y() - origin.y() - size.y() : origin.y();
+		const double sx = double(img.w()) / dstSize.x();
+		const double sy = double(img.h()) / dstSize.y();
+		const int x0 = int(std::floor(origin.x() * sx));
+		const int y0 = int(std::floor(top * sy));
+		const int x1 = std::min(int(img.w()), std::max(x0 + 1, int(std::ceil((origin.x() + size.x()) * sx))));
+		const int y1 = std::min(int(img.h()), std::max(y0 + 1, int(std::ceil((top + size.y()) * sy))));
+
+		cv::Mat region;
+		cv::resize(img.toOpenCV()(cv::Rect(x0, y0, x1 - x0, y1 - y0)), region, cv::Size(size.x(), size.y()), 0, 0, cv::INTER_AREA);
+		if (flip) {
+			cv::flip(region, region, 0);
+		}
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, origin.x(), origin.y(), layer, size.x(), size.y(), 1, GL_RGB, GL_UNSIGNED_BYTE, region.data);
+	}
+
+	void SparseTextureArray::updateResidency(int layer, int level, int x, int y)
+	{
+		const Vector2i & cells = _levels[0].tiles;
+		const int x0 = x << level, y0 = y << level;
+		const int x1 = std::min(cells.x(), (x + 1) << level), y1 = std::min(cells.y(), (y + 1) << level);
+		for (int cy = y0; cy < y1; ++cy) {
+			for (int cx = x0; cx < x1; ++cx) {
+				// Finest level above which every level is resident.
+				int finest = _tailLevel;
+				while (finest > 0) {
+					const Level & l = _levels[finest - 1];
+					const int tx = std::min(cx >> (finest - 1), l.tiles.x() - 1);
+					const int ty = std::min(cy >> (finest - 1), l.tiles.y() - 1);
+					if (!_tiles[tileIndex(layer, finest - 1, tx, ty)].resident) {
+						break;
+					}
+					--finest;
+				}
+				_residency[size_t(layer) * cells.prod() + cy * cells.x() + cx] = uint(finest);
+			}
+		}
+		_dirtyLayers[layer] = true;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/Image.hpp>
+#include <core/graphics/MemoryTracker.hpp>
+#include <set>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Full resolution RGB texture array whose tiles are paged in on demand, under a memory budget.
+	 * The array is a sparse texture (ARB_sparse_texture) with a complete mip chain; each level is
+	 * split in tiles of tileSize texels, the mip tail is always resident.
+	 *
+	 * Shaders sampling the array report the tiles they need in a feedback buffer, by writing the
+	 * current frame index in the entry of each tile (see ulr_v3.frag for an example). update() reads
+	 * the feedback of the last completed frame, evicts the least recently used tiles and uploads the
+	 * requested ones, coarser levels first. A residency buffer gives, for each level 0 tile, the finest
+	 * level that can be sampled there; shaders clamp their LOD to it.
+	 *
+	 * In a pass using the array:
+	 *		textures.bind(program, feedbackBinding, residencyBinding);
+	 *		// ... draw, sampling textures.handle().
+	 *		textures.update();
+	 *
+	 * \note Tiles are extracted and downscaled on the fly from the CPU images, which must stay alive.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT SparseTextureArray
+	{
+		SIBR_CLASS_PTR(SparseTextureArray);
+		SIBR_DISALLOW_COPY(SparseTextureArray);
+
+	public:
+
+		/// Maximum number of mip levels.
+		static const int maxLevels = 16;
+
+		/** \return true if the GPU supports sparse RGBA8 texture arrays. */
+		static bool isSupported(void);
+
+		/** Create the array and upload the mip tail of each image.
+		\param images the images, one per layer, they must outlive the array
+		\param budget the maximum memory used by the paged tiles, in bytes
+		\param flags options (SIBR_GPU_LINEAR_SAMPLING, SIBR_FLIP_TEXTURE)
+		*/
+		SparseTextureArray(const std::vector<ImageRGB::Ptr> & images, size_t budget, uint flags = 0);
+
+		/// Destructor.
+		~SparseTextureArray(void);
+
+		/** \return the texture handle, a GL_TEXTURE_2D_ARRAY. */
+		GLuint handle(void) const { return _handle; }
+
+		/** Bind the feedback and residency buffers and set the uniforms describing the tiles.
+		\param program the program sampling the array
+		\param feedbackBinding the shader storage binding of the feedback buffer
+		\param residencyBinding the shader storage binding of the residency buffer
+		*/
+		void bind(GLuint program, GLuint feedbackBinding, GLuint residencyBinding) const;
+
+		/** Page tiles in and out based on the feedback, to call once per frame after the passes using the array. */
+		void update(void);
+
+		/** \return the memory used by the paged tiles, in bytes. */
+		size_t residentBytes(void) const { return _residentBytes; }
+
+		/** Page out the least recently used tiles and lower the budget to what is left, see GPUMemoryBudget.
+		\param bytes the memory to release
+		\return the memory released, in bytes
+		*/
+		size_t trim(size_t bytes);
+
+		/** \return the memory budget of the paged tiles, in bytes. */
+		size_t & budget(void) { return _budget; }
+
+		/** \return the maximum number of tiles uploaded per frame. */
+		int & uploadsPerFrame(void) { return _uploadsPerFrame; }
+
+		/** \return the number of tiles requested by the last collected frame that are not resident. */
+		size_t missingTiles(void) const { return _missing; }
+
+	private:
+
+		/// A tile of a level of a layer.
+		struct Tile {
+			uint64 lastUse = 0; ///< Last frame the tile was sampled.
+			bool resident = false; ///< Is the tile committed and uploaded.
+		};
+
+		/// Tile grid of a mip level.
+		struct Level {
+			Vector2i size; ///< Level size in texels.
+			Vector2i tiles; ///< Number of tiles.
+			int offset = 0; ///< Index of the first tile of the level in a layer.
+		};
+
+		/** \return the index of a tile in _tiles. */
+		size_t tileIndex(int layer, int level, int x, int y) const;
+
+		/** Read the feedback written since the last collection. */
+		void collect(void);
+
+		/** Commit and upload a tile.
+		\param layer the layer
+		\param level the mip level
+		\param x the tile column
+		\param y the tile row
+		*/
+		void pageIn(int layer, int level, int x, int y);
+
+		/** Release the memory of a tile. */
+		void pageOut(size_t index);
+
+		/** Upload a region of a level of a layer, extracted from the CPU image.
+		\param layer the layer
+		\param level the mip level
+		\param origin the first texel
+		\param size the region size
+		*/
+		void upload(int layer, int level, const Vector2i & origin, const Vector2i & size);
+
+		/** Upload the residency of the flagged layers. */
+		void uploadResidency(void);
+
+		/** Recompute the residency of the level 0 tiles covered by a tile and flag its layer. */
+		void updateResidency(int layer, int level, int x, int y);
+
+		const std::vector<ImageRGB::Ptr> & _images; ///< Source images.
+		uint _flags; ///< Options.
+		GLuint _handle = 0; ///< Sparse texture.
+		int _layers = 0; ///< Number of layers.
+		Vector2i _size; ///< Size of the level 0, the largest image size.
+		int _tileSize = 0; ///< Tile size in texels, a multiple of the page size.
+		int _tailLevel = 0; ///< First level of the always resident mip tail.
+		std::vector<Level> _levels; ///< Tile grids of the sparse levels.
+		int _tilesPerLayer = 0; ///< Number of tiles in a layer, all sparse levels.
+
+		std::vector<Tile> _tiles; ///< State of every tile.
+		std::set<std::pair<uint64, size_t>> _lru; ///< Resident tiles by last use.
+		size_t _budget; ///< Memory budget, in bytes.
+		size_t _residentBytes = 0; ///< Memory of the resident tiles.
+		TrackedMemory _memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Memory of the resident tiles, reported to the tracker.
+		int _uploadsPerFrame = 32; ///< Maximum tile uploads per update.
+		size_t _missing = 0; ///< Non resident tiles requested by the last collected frame.
+		uint64_t _budgetId = 0; ///< Registration in the GPUMemoryBudget.
+
+		GLuint _feedbackBuffer = 0; ///< Frame index of the last use of each tile, written by shaders.
+		const uint * _feedback = nullptr; ///< Persistent mapping of the feedback buffer.
+		GLuint _residencyBuffer = 0; ///< Finest resident level for each level 0 tile.
+		std::vector<uint> _residency; ///< CPU copy of the residency buffer.
+		std::vector<bool> _dirtyLayers; ///< Layers whose residency changed.
+		GLsync _fence = 0; ///< Signaled when the frame _fenceFrame is done.
+		uint64 _fenceFrame = 0; ///< Frame guarded by the fence.
+		uint64 _collectedFrame = 0; ///< Last frame whose feedback was read.
+		uint64 _frame = 1; ///< Index of the frame being rendered, written in the feedback.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "StreamingBuffer.hpp"
+#include "FrameProfiler.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace sibr {
+
+	StreamingBuffer::StreamingBuffer(size_t frameCapacity, uint frames) :
+		_frameCapacity(frameCapacity), _frames(std::max(frames, 1u)), _fences(_frames, GLsync(0))
+	{
+	}
+
+	StreamingBuffer::~StreamingBuffer()
+	{
+		for (GLsync & fence : _fences) {
+			if (fence) {
+				glDeleteSync(fence);
+			}
+		}
+		for (Retired & retired : _retired) {
+			glDeleteSync(retired.fence);
+			glDeleteBuffers(1, &retired.buffer);
+		}
+		if (_buffer) {
+			glUnmapNamedBuffer(_buffer);
+			glDeleteBuffers(1, &_buffer);
+		}
+	}
+
+	StreamingBuffer & StreamingBuffer::global()
+	{
+		static StreamingBuffer buffer;
+		return buffer;
+	}
+
+	void StreamingBuffer::create(size_t frameCapacity)
+	{
+		if (_buffer) {
+			// Allocations of this frame may still be read from it.
+			glUnmapNamedBuffer(_buffer);
+			_retired.push_back({ _buffer, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+		}
+		for (GLsync & fence : _fences) {
+			if (fence) {
+				glDeleteSync(fence);
+				fence = 0;
+			}
+		}
+		GLint uniformAlignment = 256, storageAlignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+		_alignments[UNIFORM] = size_t(std::max(uniformAlignment, 1));
+		_alignments[STORAGE] = size_t(std::max(storageAlignment, 1));
+
+		_frameCapacity = frameCapacity;
+		const GLsizeiptr bytes = GLsizeiptr(_frameCapacity * _frames);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &_buffer);
+		glNamedBufferStorage(_buffer, bytes, nullptr, flags);
+		_mapped = static_cast<char*>(glMapNamedBufferRange(_buffer, 0, bytes, flags));
+		if (!_mapped) {
+			SIBR_ERR << "[StreamingBuffer] Unable to map a ring of " << bytes << " bytes." << std::endl;
+		}
+		_memory.set(size_t(bytes));
+		_head = 0;
+		CHECK_GL_ERROR;
+	}
+
+	StreamingBuffer::Allocation StreamingBuffer::allocate(size_t bytes, Usage usage)
+	{
+		const size_t alignment = _alignments[usage];
+		size_t offset = (_head + alignment - 1) / alignment * alignment;
+		if (!_buffer || offset + bytes > _frameCapacity) {
+			// Grow so that the next frames fit, the rest of this frame starts in the new ring.
+			size_t capacity = _buffer ? 2 * _frameCapacity : _frameCapacity;
+			while (capacity < bytes) {
+				capacity *= 2;
+			}
+			if (_buffer) {
+				SIBR_WRG << "[StreamingBuffer] A frame needs more than " << _frameCapacity << " bytes, growing to " << capacity << "." << std::endl;
+			}
+			create(capacity);
+			offset = 0;
+		}
+		_head = offset + bytes;
+
+		Allocation allocation;
+		allocation.buffer = _buffer;
+		allocation.offset = size_t(_frame) * _frameCapacity + offset;
+		allocation.size = bytes;
+		allocation.data = _mapped + allocation.offset;
+		return allocation;
+	}
+
+	StreamingBuffer::Allocation StreamingBuffer::upload(const void * data, size_t bytes, Usage usage)
+	{
+		const Allocation allocation = allocate(bytes, usage);
+		std::memcpy(allocation.data, data, bytes);
+		return allocation;
+	}
+
+	void StreamingBuffer::bindRange(GLenum target, GLuint index, const Allocation & allocation)
+	{
+		glBindBufferRange(target, index, allocation.buffer, GLintptr(allocation.offset), GLsizeiptr(std::max(allocation.size, size_t(1))));
+	}
+
+	void StreamingBuffer::nextFrame()
+	{
+		if (!_buffer) {
+			return;
+		}
+		_fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_frame = (_frame + 1) % _frames;
+		_head = 0;
+		if (_fences[_frame]) {
+			// Only stalls when the GPU is more than the ring length behind.
+			SIBR_PROFILE_CPU("Streaming buffer wait");
+			glClientWaitSync(_fences[_frame], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+			glDeleteSync(_fences[_frame]);
+			_fences[_frame] = 0;
+		}
+		_retired.erase(std::remove_if(_retired.begin(), _retired.end(), [](Retired & retired) {
+			if (glClientWaitSync(retired.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				return false;
+			}
+			glDeleteSync(retired.fence);
+			glDeleteBuffers(1, &retired.buffer);
+			return true;
+		}), _retired.end());
+	}
+
+}
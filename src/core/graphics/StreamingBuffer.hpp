@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <core/graphics/MemoryTracker.hpp>
+#include <vector>
+
+namespace sibr {
+
+	/**
+	 * Ring of persistently mapped, coherent memory for the data written each frame: uniform blocks,
+	 * storage buffer contents, dynamic vertices, or staging for copies into static buffers.
+	 * The ring is split in one region per frame in flight; allocations are taken linearly in the
+	 * region of the current frame and stay valid until the end of the frame. A fence is placed when
+	 * the frame ends, and a region is only reused once the GPU is done with it, so writing never
+	 * waits on the driver as glBufferSubData on a buffer in use can.
+	 *
+	 *		const StreamingBuffer::Allocation block = StreamingBuffer::global().upload(&params, sizeof(params), StreamingBuffer::UNIFORM);
+	 *		StreamingBuffer::bindRange(GL_UNIFORM_BUFFER, 0, block);
+	 *
+	 * When a frame needs more than a region, a larger ring is created, the previous one is kept
+	 * until the GPU has read it.
+	 * \note The data of an allocation must be written before the commands reading it are issued.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT StreamingBuffer {
+		SIBR_CLASS_PTR(StreamingBuffer);
+		SIBR_DISALLOW_COPY(StreamingBuffer);
+
+	public:
+
+		/// How an allocation is read, for its alignment.
+		enum Usage {
+			UNIFORM, ///< Bound as a uniform block range.
+			STORAGE, ///< Bound as a shader storage range.
+			VERTEX ///< Vertex or index data, or copy source.
+		};
+
+		/// A range of the ring, valid until the end of the frame.
+		struct Allocation {
+			GLuint buffer = 0; ///< Buffer holding the range.
+			size_t offset = 0; ///< Start of the range in the buffer.
+			size_t size = 0; ///< Size of the range in bytes.
+			void * data = nullptr; ///< Mapped pointer to the range.
+		};
+
+		/** Constructor, the ring is created on the first allocation.
+		\param frameCapacity initial size of each frame region, in bytes
+		\param frames number of frames in flight
+		*/
+		StreamingBuffer(size_t frameCapacity = size_t(4) << 20, uint frames = 3);
+
+		/// Destructor.
+		~StreamingBuffer();
+
+		/** \return the ring shared by the renderers, its frames are advanced by Window::swapBuffer. */
+		static StreamingBuffer & global();
+
+		/** Allocate a range for the current frame.
+		\param bytes the size of the range
+		\param usage how the range will be read
+		\return the range, to be written through its data pointer
+		*/
+		Allocation allocate(size_t bytes, Usage usage = STORAGE);
+
+		/** Allocate a range for the current frame and copy data in it.
+		\param data the data to copy
+		\param bytes the size of the data
+		\param usage how the range will be read
+		\return the range
+		*/
+		Allocation upload(const void * data, size_t bytes, Usage usage = STORAGE);
+
+		/** Bind a range to an indexed target.
+		\param target GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+		\param index the binding point
+		\param allocation the range
+		*/
+		static void bindRange(GLenum target, GLuint index, const Allocation & allocation);
+
+		/** End the current frame: fence its region and move to the next one, waiting for the GPU if it still reads it.
+		Called by Window::swapBuffer for the global ring. */
+		void nextFrame();
+
+		/** \return the bytes allocated in the current frame. */
+		size_t used() const { return _head; }
+
+		/** \return the size of each frame region, in bytes. */
+		size_t frameCapacity() const { return _frameCapacity; }
+
+	private:
+
+		/// A previous ring, kept until the GPU is done with it.
+		struct Retired {
+			GLuint buffer; ///< The buffer.
+			GLsync fence; ///< Signaled after the last commands reading it.
+		};
+
+		/** Create the ring.
+		\param frameCapacity the size of each frame region
+		*/
+		void create(size_t frameCapacity);
+
+		GLuint _buffer = 0; ///< Ring buffer, _frames regions.
+		char * _mapped = nullptr; ///< Persistent mapping of the ring.
+		size_t _frameCapacity; ///< Size of a region.
+		uint _frames; ///< Number of regions.
+		uint _frame = 0; ///< Region of the current frame.
+		size_t _head = 0; ///< Next free offset in the current region.
+		std::vector<GLsync> _fences; ///< Signaled when the GPU is done with each region.
+		std::vector<Retired> _retired; ///< Previous rings still in use.
+		size_t _alignments[3] = { 256, 256, 16 }; ///< Offset alignment of each usage.
+		TrackedMemory _memory = TrackedMemory(MemoryTracker::BUFFER); ///< Reported GPU memory.
+	};
+
+}
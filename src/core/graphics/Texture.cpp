@@ -20,7 +20,7 @@ namespace sibr
 	{
 		GLuint sourceFrameBuffer = 0;
 		glGenFramebuffers(1, &sourceFrameBuffer);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFrameBuffer);
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, sourceFrameBuffer);
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src.handle(), 0);
 
 		SIBR_ASSERT(glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
@@ -35,7 +35,7 @@ namespace sibr
 			0, (flip ? dst.h() : 0), dst.w(), (flip ? 0 : dst.h()),
 			mask, filter);
 
-		glDeleteFramebuffers(1, &sourceFrameBuffer);
+		GLState::deleteFramebuffers(1, &sourceFrameBuffer);
 #endif
 	}
 
@@ -48,12 +48,12 @@ namespace sibr
 	{
 		// To blit only to a specific color attachment, it should be the only draw buffer registered.
 		// So we override the drawbuffer from dst temporarily.
-		glBindFramebuffer(GL_FRAMEBUFFER, dst.fbo());
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, dst.fbo());
 		glDrawBuffer(GL_COLOR_ATTACHMENT0 + location);
 		
 		GLuint sourceFrameBuffer = 0;
 		glGenFramebuffers(1, &sourceFrameBuffer);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFrameBuffer);
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, sourceFrameBuffer);
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src.handle(), 0);
 
 		SIBR_ASSERT(glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
@@ -67,7 +67,7 @@ namespace sibr
 			0, (flip ? dst.h() : 0), dst.w(), (flip ? 0 : dst.h()),
 			GL_COLOR_BUFFER_BIT, filter);
 
-		glDeleteFramebuffers(1, &sourceFrameBuffer);
+		GLState::deleteFramebuffers(1, &sourceFrameBuffer);
 #endif
 
 		// Restore the drawbuffers.
@@ -80,7 +80,7 @@ namespace sibr
 	{
 		GLuint dstFrameBuffer = 0;
 		glGenFramebuffers(1, &dstFrameBuffer);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFrameBuffer);
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFrameBuffer);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst.handle(), 0);
 
 		SIBR_ASSERT(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
@@ -93,7 +93,7 @@ namespace sibr
 			0, 0, src.w(), src.h(),
 			0, 0, dst.w(), dst.h(),
 			mask, filter);
-		glDeleteFramebuffers(1, &dstFrameBuffer);
+		GLState::deleteFramebuffers(1, &dstFrameBuffer);
 #endif
 	}
 
@@ -101,9 +101,9 @@ namespace sibr
 	{
 		GLuint fbo[2];
 		glGenFramebuffers(2, fbo);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]);
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]);
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src.handle(), 0);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[0]);
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[0]);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst.handle(), 0);
 
 		SIBR_ASSERT(glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
@@ -117,8 +117,154 @@ namespace sibr
 			0, 0, src.w(), src.h(),
 			0, 0, dst.w(), dst.h(),
 			mask, filter);
-		glDeleteFramebuffers(2, fbo);
+		GLState::deleteFramebuffers(2, fbo);
 #endif
 	}
 
+	namespace {
+
+		const char * mipVertexSrc = R"(#version 420
+void main() {
+	// Fullscreen triangle.
+	const vec2 corners[3] = vec2[](vec2(-1.0, -1.0), vec2(3.0, -1.0), vec2(-1.0, 3.0));
+	gl_Position = vec4(corners[gl_VertexID], 0.0, 1.0);
+}
+)";
+
+		const char * mipFragmentSrc = R"(#version 420
+layout(binding = 0) uniform sampler2D src;
+uniform int filterMode;
+out vec4 color;
+
+float lanczos2(float x) {
+	if (abs(x) < 1e-5) {
+		return 1.0;
+	}
+	if (abs(x) >= 2.0) {
+		return 0.0;
+	}
+	const float px = 3.14159265 * x;
+	return 2.0 * sin(px) * sin(0.5 * px) / (px * px);
+}
+
+void main() {
+	const ivec2 dst = ivec2(gl_FragCoord.xy);
+	const ivec2 maxCoords = textureSize(src, 0) - 1;
+	if (filterMode == 0) {
+		vec4 sum = vec4(0.0);
+		for (int y = 0; y < 2; ++y) {
+			for (int x = 0; x < 2; ++x) {
+				sum += texelFetch(src, min(2 * dst + ivec2(x, y), maxCoords), 0);
+			}
+		}
+		color = 0.25 * sum;
+		return;
+	}
+	// Source texels 2*dst-3 to 2*dst+4, at (i - 1.5) / 2 to (i + 1.5) / 2 destination texels from the center.
+	float weights[8];
+	float total = 0.0;
+	for (int i = 0; i < 8; ++i) {
+		weights[i] = lanczos2((float(i) - 3.5) * 0.5);
+		total += weights[i];
+	}
+	vec4 sum = vec4(0.0);
+	for (int y = 0; y < 8; ++y) {
+		for (int x = 0; x < 8; ++x) {
+			const ivec2 coords = clamp(2 * dst + ivec2(x - 3, y - 3), ivec2(0), maxCoords);
+			sum += weights[x] * weights[y] * texelFetch(src, coords, 0);
+		}
+	}
+	color = max(sum / (total * total), vec4(0.0));
+}
+)";
+
+		GLuint compileMipProgram() {
+			GLuint program = glCreateProgram();
+			const char * sources[2] = { mipVertexSrc, mipFragmentSrc };
+			const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+			for (int s = 0; s < 2; ++s) {
+				const GLuint shader = glCreateShader(types[s]);
+				glShaderSource(shader, 1, &sources[s], nullptr);
+				glCompileShader(shader);
+				GLint compiled = 0;
+				glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+				if (!compiled) {
+					char log[4096];
+					glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+					SIBR_WRG << "Unable to compile the mipmap shader: " << log << std::endl;
+				}
+				glAttachShader(program, shader);
+				glDeleteShader(shader);
+			}
+			glLinkProgram(program);
+			return program;
+		}
+	}
+
+	void generateLayerMipmaps(GLuint texture, uint internalFormat, uint w, uint h, uint levels,
+		const std::vector<int>& layers, MipFilter filter)
+	{
+		if (levels <= 1 || layers.empty()) {
+			return;
+		}
+		// Shared by all textures, it lives as long as the context.
+		static const GLuint program = compileMipProgram();
+		static const GLint filterLocation = glGetUniformLocation(program, "filterMode");
+
+		GLint previousFramebuffer = 0, previousProgram = 0, previousVAO = 0, previousTexture = 0, previousActive = 0;
+		GLint previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActive);
+		glActiveTexture(GL_TEXTURE0);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+		const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		const GLboolean blend = glIsEnabled(GL_BLEND);
+		const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+		const GLboolean cull = glIsEnabled(GL_CULL_FACE);
+		GLState::disable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_SCISSOR_TEST);
+		GLState::disable(GL_CULL_FACE);
+
+		GLuint framebuffer = 0, vao = 0;
+		glCreateFramebuffers(1, &framebuffer);
+		glCreateVertexArrays(1, &vao);
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glBindVertexArray(vao);
+		GLState::useProgram(program);
+		glUniform1i(filterLocation, filter == MIP_LANCZOS ? 1 : 0);
+
+		for (const int layer : layers) {
+			for (uint lid = 1; lid < levels; ++lid) {
+				// The view only exposes the source level, so writing the next one is not a feedback loop.
+				GLuint view = 0;
+				glGenTextures(1, &view);
+				glTextureView(view, GL_TEXTURE_2D, texture, internalFormat, lid - 1, 1, GLuint(layer), 1);
+				glBindTexture(GL_TEXTURE_2D, view);
+				glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, texture, GLint(lid), layer);
+				glViewport(0, 0, GLsizei(std::max(w >> lid, 1u)), GLsizei(std::max(h >> lid, 1u)));
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				glDeleteTextures(1, &view);
+			}
+		}
+
+		glDeleteVertexArrays(1, &vao);
+		GLState::deleteFramebuffers(1, &framebuffer);
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+		GLState::useProgram(GLuint(previousProgram));
+		glBindVertexArray(GLuint(previousVAO));
+		glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+		glActiveTexture(GLenum(previousActive));
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		if (depthTest) GLState::enable(GL_DEPTH_TEST);
+		if (blend) glEnable(GL_BLEND);
+		if (scissor) glEnable(GL_SCISSOR_TEST);
+		if (cull) GLState::enable(GL_CULL_FACE);
+		CHECK_GL_ERROR;
+	}
+
 } // namespace sibr
@@ -13,12 +13,16 @@
 #pragma once
 
 #include <type_traits>
+#include <fstream>
 
 # include "core/graphics/Config.hpp"
 # include "core/system/Vector.hpp"
 # include "core/graphics/Image.hpp"
 # include "core/graphics/Types.hpp"
 # include "core/graphics/RenderTarget.hpp"
+# include "core/graphics/TextureUploader.hpp"
+# include "core/graphics/FrameProfiler.hpp"
+# include "core/graphics/MemoryTracker.hpp"
 
 namespace sibr
 {
@@ -110,6 +114,12 @@ namespace sibr
 		uint    m_H = 0; ///< Texture height.
 		uint    m_Flags = 0; ///< Options.
 		bool	m_autoMIPMAP = false; ///< Should the mipmaps be generated automatically.
+		TrackedMemory m_Memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Size of the texture.
+
+		/** Report the texture size to the MemoryTracker.
+		\param levels the mipmap level count, 0 for a full chain
+		*/
+		void trackMemory(uint levels);
 
 		/** Create 2D texture from a generic image (sibr::image or cv::Mat).
 		\param array the image
@@ -141,6 +151,29 @@ namespace sibr
 
 	};
 
+	/** Downsampling filter used to build mip levels on the GPU.
+	* \ingroup sibr_graphics
+	*/
+	enum MipFilter : uint {
+		MIP_BOX, ///< Average of 2x2 texels, as glGenerateMipmap.
+		MIP_LANCZOS ///< Separable Lanczos-2 over 8x8 texels, sharper with less aliasing.
+	};
+
+	/** Rebuild the mip levels of some layers of a 2D texture array from their level 0, on the GPU.
+	Each level is rendered from the previous one through a texture view restricted to it, so other layers
+	are not touched.
+	\param texture the texture array, with immutable storage
+	\param internalFormat its internal format, it has to be color-renderable and not integer
+	\param w the width of the level 0
+	\param h the height of the level 0
+	\param levels the number of levels of the texture
+	\param layers the layers to update
+	\param filter the downsampling filter
+	\ingroup sibr_graphics
+	*/
+	SIBR_GRAPHICS_EXPORT void generateLayerMipmaps(GLuint texture, uint internalFormat, uint w, uint h, uint levels,
+		const std::vector<int>& layers, MipFilter filter = MIP_BOX);
+
 
 	/** Interface for a generic GPU 2D array texture.
 	* \sa Texture2DArray
@@ -289,6 +322,71 @@ namespace sibr
 		template<typename ImageType>
 		void createCompressedFromImages(const std::vector<ImageType>& images, uint w, uint h, uint compression, uint flags = 0);
 
+		/** Create the texture from a set of images with custom mipmaps and send it to GPU while compressing them.
+		\param images list of lists of images, one for each mip level, each containing an image for each layer
+		\param w the target width
+		\param h the target height
+		\param compression the GL_COMPRESSED format. It must be choosen accordingly to the texture internal format.
+		\param flags options
+		*/
+		template<typename ImageType>
+		void createCompressedFromImages(const std::vector<std::vector<ImageType>>& images, uint w, uint h, uint compression, uint flags = 0);
+
+		/** Save the compressed data of all levels and layers, to reload them without encoding.
+		\param path the destination file
+		\return false if the texture is not compressed or the file can't be written
+		*/
+		bool saveCompressed(const std::string& path) const;
+
+		/** Create the texture from compressed data saved by saveCompressed.
+		\param path the source file
+		\param w the expected width
+		\param h the expected height
+		\param d the expected layer count
+		\param flags options
+		\return false if the file is missing or doesn't match the expected size, the texture is then left untouched
+		*/
+		bool loadCompressed(const std::string& path, uint w, uint h, uint d, uint flags = 0);
+
+		/** Save all levels and layers as stored on the GPU, compressed or not, to reload them without rebuilding the mips.
+		\param path the destination file
+		\return false if the file can't be written
+		*/
+		bool saveLevels(const std::string& path) const;
+
+		/** Create the texture from the levels saved by saveLevels.
+		\param path the source file
+		\param w the expected width
+		\param h the expected height
+		\param d the expected layer count
+		\param flags options, automatic mipmaps are ignored since the levels are loaded
+		\return false if the file is missing or doesn't match the expected size, the texture is then left untouched
+		*/
+		bool loadLevels(const std::string& path, uint w, uint h, uint d, uint flags = 0);
+
+		/** Rebuild the mip levels of specific layers on the GPU, leaving the others untouched.
+		\param slices the layers to update
+		\param filter the downsampling filter
+		\note The texture must not be compressed.
+		*/
+		void generateMipmaps(const std::vector<int>& slices, MipFilter filter = MIP_BOX);
+
+		/** Read back the data of all levels and layers, as stored on the GPU (compressed or not).
+		\param levels will contain the data of each level, all layers packed
+		\return the GL internal format of the texture
+		*/
+		uint readLevels(std::vector<std::vector<char>>& levels) const;
+
+		/** Create the texture from the data of each level, as returned by readLevels.
+		\param w the width of the level 0
+		\param h the height of the level 0
+		\param d the layer count
+		\param format the GL internal format, compressed or not
+		\param levels the data and size of each level
+		\param flags options
+		*/
+		void createFromLevels(uint w, uint h, uint d, uint format, const std::vector<std::pair<const char*, size_t>>& levels, uint flags = 0);
+
 		/** Create the texture from a set of images with custom mipmaps and send it to GPU.
 		\param images list of lists of images, one for each mip level, each containing an image for each layer
 		\param flags options
@@ -328,6 +426,16 @@ namespace sibr
 		template<typename ImageType>
 		void updateSlices(const std::vector<ImageType>& images, const std::vector<int>& slices);
 
+		/** Update the content of specific layers of the texture through a staging ring, without waiting for the GPU.
+		\param images the new content to use
+		\param slices the indices of the slices to update
+		\param uploader the staging ring
+		\return the ticket of the last layer upload, to poll for completion
+		\note Images are resized to the current texture size. Automatic mipmaps of the updated layers are rebuilt once they are submitted.
+		*/
+		template<typename ImageType>
+		TextureUploader::Ticket updateSlicesAsync(const std::vector<ImageType>& images, const std::vector<int>& slices, TextureUploader& uploader);
+
 		/// Destructor.
 		~Texture2DArray(void);
 
@@ -412,6 +520,7 @@ namespace sibr
 		uint    m_Flags = 0; ///< Options.
 		uint	m_Depth = 0; ///< Layers count.
 		uint	m_numLODs = 1; ///< Mipmap level count.
+		TrackedMemory m_Memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Size of the texture array.
 	};
 
 
@@ -474,10 +583,11 @@ namespace sibr
 		\param zpos positive Z face
 		\param zneg negative Z face
 		\param flags options
+		\param compression an optional GL_COMPRESSED format, the faces are then encoded by the driver
 		*/
 		TextureCubeMap(const PixelImage& xpos, const PixelImage& xneg,
 			const PixelImage& ypos, const PixelImage& yneg,
-			const PixelImage& zpos, const PixelImage& zneg, uint flags = 0);
+			const PixelImage& zpos, const PixelImage& zneg, uint flags = 0, uint compression = 0);
 
 		/** Create the texture from 6 images.
 		\param xpos positive X face
@@ -487,10 +597,12 @@ namespace sibr
 		\param zpos positive Z face
 		\param zneg negative Z face
 		\param flags options
+		\param compression an optional GL_COMPRESSED format, the faces are then encoded by the driver
+		\note With SIBR_GPU_AUTOGEN_MIPMAP and a compression, the mipmaps are generated on the GPU before encoding.
 		*/
 		void createFromImages(const PixelImage& xpos, const PixelImage& xneg,
 			const PixelImage& ypos, const PixelImage& yneg,
-			const PixelImage& zpos, const PixelImage& zneg, uint flags = 0);
+			const PixelImage& zpos, const PixelImage& zneg, uint flags = 0, uint compression = 0);
 
 		/// Destructor.
 		~TextureCubeMap(void);
@@ -525,6 +637,8 @@ namespace sibr
 		uint    m_W = 0; ///< Texture width.
 		uint    m_H = 0; ///< Texture height.
 		uint    m_Flags = 0; ///< Options.
+		uint    m_Compression = 0; ///< Compressed internal format, 0 for none.
+		TrackedMemory m_Memory = TrackedMemory(MemoryTracker::TEXTURE); ///< Size of the cubemap.
 
 	};
 
@@ -688,6 +802,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	GLuint Texture2D<T_Type, T_NumComp>::create2D(const ImageType& img, uint flags) {
+		SIBR_PROFILE_CPU("Texture upload");
 		GLuint id = 0;
 		CHECK_GL_ERROR;
 		glGenTextures(1, &id);
@@ -729,6 +844,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp>
 	/*static*/ GLuint Texture2D<T_Type, T_NumComp>::create2D(const std::vector<PixelImage>& miparray, uint flags) {
+		SIBR_PROFILE_CPU("Texture upload");
 		GLuint id = 0;
 		CHECK_GL_ERROR;
 		glGenTextures(1, &id);
@@ -802,8 +918,7 @@ namespace sibr
 			flippedMipArray.resize(miparray.size());
 #pragma omp parallel for
 			for (uint l = 0; l < miparray.size(); l++) {
-				flippedMipArray[l] = miparray[l].clone();
-				flippedMipArray[l].flipH();
+				flippedMipArray[l] = miparray[l].flippedH();
 			}
 		}
 		const std::vector<PixelImage>& sendedMipArray = flip ? flippedMipArray : miparray;
@@ -839,6 +954,7 @@ namespace sibr
 		m_H = TexFormat::height(img);
 		m_Handle = create2D(img, m_Flags);
 		m_autoMIPMAP = ((flags & SIBR_GPU_AUTOGEN_MIPMAP) != 0);
+		trackMemory(m_autoMIPMAP ? 0 : 1);
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
@@ -848,6 +964,7 @@ namespace sibr
 		m_H = miparray[0].h();
 		m_Handle = create2D(miparray, m_Flags);
 		m_autoMIPMAP = false;
+		trackMemory(uint(miparray.size()));
 	}
 
 	template<typename T_Type, unsigned int T_NumComp>
@@ -896,6 +1013,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	void Texture2D<T_Type, T_NumComp>::update(const ImageType& img) {
+		SIBR_PROFILE_CPU("Texture upload");
 		using FormatInfos = GLTexFormat<ImageType, T_Type, T_NumComp>;
 		if (FormatInfos::width(img) == w() && FormatInfos::height(img) == h())
 		{
@@ -922,6 +1040,7 @@ namespace sibr
 			m_W = FormatInfos::width(img);
 			m_H = FormatInfos::height(img);
 			send2D(m_Handle, img, m_Flags);
+			trackMemory(m_autoMIPMAP ? 0 : 1);
 		}
 	}
 
@@ -933,6 +1052,12 @@ namespace sibr
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		m_autoMIPMAP = true;
 		glGenerateMipmap(GL_TEXTURE_2D);
+		trackMemory(maxLOD >= 0 ? uint(maxLOD) + 1 : 0);
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	void Texture2D<T_Type, T_NumComp>::trackMemory(uint levels) {
+		m_Memory.set(MemoryTracker::textureBytes(m_W, m_H, 1, levels, double(sizeof(T_Type) * T_NumComp)));
 	}
 
 
@@ -1030,6 +1155,8 @@ namespace sibr
 			m_H,
 			m_Depth
 		);
+		m_Memory.set(MemoryTracker::textureBytes(m_W, m_H, m_Depth, m_numLODs,
+			compression ? MemoryTracker::texelBytes(compression) : double(sizeof(T_Type) * T_NumComp)));
 
 		CHECK_GL_ERROR;
 	}
@@ -1185,6 +1312,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	void Texture2DArray<T_Type, T_NumComp>::createFromImages(const std::vector<ImageType>& images, uint w, uint h, uint flags) {
+		SIBR_PROFILE_CPU("Texture upload");
 		m_W = w;
 		m_H = h;
 		m_Depth = (uint)images.size();
@@ -1214,6 +1342,242 @@ namespace sibr
 		sendArray(images);
 	}
 
+	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
+	void Texture2DArray<T_Type, T_NumComp>::createCompressedFromImages(const std::vector<std::vector<ImageType>>& images, uint w, uint h, uint compression, uint flags) {
+		m_W = w;
+		m_H = h;
+		m_Depth = uint(images[0].size());
+		m_Flags = flags & ~SIBR_GPU_AUTOGEN_MIPMAP;
+		m_numLODs = uint(images.size());
+		createArray(compression);
+		// The driver encodes each level on upload.
+		sendMipArray(images);
+	}
+
+	/// Header of the files written by Texture2DArray::saveCompressed.
+	struct CompressedArrayHeader {
+		uint magic = 0x58544353; ///< "SCTX".
+		uint version = 1; ///< File version.
+		uint format = 0; ///< GL compressed internal format.
+		uint w = 0; ///< Width of the level 0.
+		uint h = 0; ///< Height of the level 0.
+		uint depth = 0; ///< Layer count.
+		uint levels = 0; ///< Level count.
+	};
+
+	template<typename T_Type, unsigned int T_NumComp>
+	bool Texture2DArray<T_Type, T_NumComp>::saveCompressed(const std::string& path) const {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
+		GLint compressed = 0, format = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		if (!compressed) {
+			SIBR_WRG << "Texture array is not compressed, nothing saved to " << path << "." << std::endl;
+			return false;
+		}
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			SIBR_WRG << "Unable to write the compressed texture array " << path << "." << std::endl;
+			return false;
+		}
+
+		CompressedArrayHeader header;
+		header.format = uint(format);
+		header.w = m_W;
+		header.h = m_H;
+		header.depth = m_Depth;
+		header.levels = m_numLODs;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		std::vector<char> data;
+		for (uint lid = 0; lid < m_numLODs; ++lid) {
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, lid, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			data.resize(size);
+			glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, lid, data.data());
+			const uint64 bytes = uint64(size);
+			file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+			file.write(data.data(), size);
+		}
+		CHECK_GL_ERROR;
+		return bool(file);
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	bool Texture2DArray<T_Type, T_NumComp>::loadCompressed(const std::string& path, uint w, uint h, uint d, uint flags) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		CompressedArrayHeader header, expected;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || header.magic != expected.magic || header.version != expected.version
+			|| header.w != w || header.h != h || header.depth != d || header.levels == 0) {
+			SIBR_WRG << "Compressed texture array " << path << " doesn't match the images, ignoring it." << std::endl;
+			return false;
+		}
+
+		// Read all levels first, a truncated file leaves the texture untouched.
+		std::vector<std::vector<char>> levels(header.levels);
+		for (auto & level : levels) {
+			uint64 bytes = 0;
+			file.read(reinterpret_cast<char*>(&bytes), sizeof(bytes));
+			level.resize(size_t(bytes));
+			file.read(level.data(), bytes);
+			if (!file) {
+				SIBR_WRG << "Compressed texture array " << path << " is truncated, ignoring it." << std::endl;
+				return false;
+			}
+		}
+
+		m_W = w;
+		m_H = h;
+		m_Depth = d;
+		m_Flags = flags & ~SIBR_GPU_AUTOGEN_MIPMAP;
+		m_numLODs = header.levels;
+		createArray(header.format);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (uint lid = 0; lid < m_numLODs; ++lid) {
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, lid,
+				0, 0, 0,
+				std::max(m_W >> lid, 1u),
+				std::max(m_H >> lid, 1u),
+				m_Depth,
+				header.format,
+				GLsizei(levels[lid].size()),
+				levels[lid].data()
+			);
+		}
+		CHECK_GL_ERROR;
+		return true;
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	uint Texture2DArray<T_Type, T_NumComp>::readLevels(std::vector<std::vector<char>>& levels) const {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_Handle);
+		GLint compressed = 0, format = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		levels.resize(m_numLODs);
+		for (uint lid = 0; lid < m_numLODs; ++lid) {
+			if (compressed) {
+				GLint size = 0;
+				glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, lid, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+				levels[lid].resize(size);
+				glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, lid, levels[lid].data());
+			}
+			else {
+				const size_t texels = size_t(std::max(m_W >> lid, 1u)) * size_t(std::max(m_H >> lid, 1u)) * m_Depth;
+				levels[lid].resize(texels * T_NumComp * sizeof(T_Type));
+				glGetTexImage(GL_TEXTURE_2D_ARRAY, lid,
+					GLFormat<T_Type, T_NumComp>::format,
+					GLType<T_Type>::type,
+					levels[lid].data()
+				);
+			}
+		}
+		CHECK_GL_ERROR;
+		return uint(format);
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	void Texture2DArray<T_Type, T_NumComp>::createFromLevels(uint w, uint h, uint d, uint format, const std::vector<std::pair<const char*, size_t>>& levels, uint flags) {
+		m_W = w;
+		m_H = h;
+		m_Depth = d;
+		m_Flags = flags & ~SIBR_GPU_AUTOGEN_MIPMAP;
+		m_numLODs = uint(levels.size());
+		createArray(format);
+
+		// Any format other than the default one of the texture type is a compressed one.
+		const bool compressed = format != GLFormat<T_Type, T_NumComp>::internal_format;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (uint lid = 0; lid < m_numLODs; ++lid) {
+			const uint lw = std::max(m_W >> lid, 1u);
+			const uint lh = std::max(m_H >> lid, 1u);
+			if (compressed) {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, lid, 0, 0, 0, lw, lh, m_Depth,
+					format, GLsizei(levels[lid].second), levels[lid].first);
+			}
+			else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, lid, 0, 0, 0, lw, lh, m_Depth,
+					GLFormat<T_Type, T_NumComp>::format,
+					GLType<T_Type>::type,
+					levels[lid].first
+				);
+			}
+		}
+		CHECK_GL_ERROR;
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	bool Texture2DArray<T_Type, T_NumComp>::saveLevels(const std::string& path) const {
+		std::vector<std::vector<char>> levels;
+		CompressedArrayHeader header;
+		header.magic = 0x4c564c53; // "SLVL", the levels may be uncompressed.
+		header.format = readLevels(levels);
+		header.w = m_W;
+		header.h = m_H;
+		header.depth = m_Depth;
+		header.levels = uint(levels.size());
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			SIBR_WRG << "Unable to write the texture array levels " << path << "." << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto & level : levels) {
+			const uint64 bytes = uint64(level.size());
+			file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+			file.write(level.data(), std::streamsize(level.size()));
+		}
+		return bool(file);
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	bool Texture2DArray<T_Type, T_NumComp>::loadLevels(const std::string& path, uint w, uint h, uint d, uint flags) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		CompressedArrayHeader header, expected;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || header.magic != 0x4c564c53 || header.version != expected.version
+			|| header.w != w || header.h != h || header.depth != d || header.levels == 0) {
+			SIBR_WRG << "Texture array levels " << path << " don't match the images, ignoring them." << std::endl;
+			return false;
+		}
+
+		// Read all levels first, a truncated file leaves the texture untouched.
+		std::vector<std::vector<char>> levels(header.levels);
+		std::vector<std::pair<const char*, size_t>> levelPtrs(header.levels);
+		for (uint lid = 0; lid < header.levels; ++lid) {
+			uint64 bytes = 0;
+			file.read(reinterpret_cast<char*>(&bytes), sizeof(bytes));
+			levels[lid].resize(size_t(bytes));
+			file.read(levels[lid].data(), bytes);
+			if (!file) {
+				SIBR_WRG << "Texture array levels " << path << " are truncated, ignoring them." << std::endl;
+				return false;
+			}
+			levelPtrs[lid] = { levels[lid].data(), levels[lid].size() };
+		}
+		createFromLevels(w, h, d, header.format, levelPtrs, flags);
+		return true;
+	}
+
+	template<typename T_Type, unsigned int T_NumComp>
+	void Texture2DArray<T_Type, T_NumComp>::generateMipmaps(const std::vector<int>& slices, MipFilter filter) {
+		if (m_numLODs <= 1 || slices.empty()) {
+			return;
+		}
+		generateLayerMipmaps(m_Handle, GLFormat<T_Type, T_NumComp>::internal_format, m_W, m_H, m_numLODs, slices, filter);
+	}
+
 	template<typename T_Type, unsigned int T_NumComp> template<typename ImageType>
 	void Texture2DArray<T_Type, T_NumComp>::createFromImages(const std::vector<std::vector<ImageType>>& images, uint flags) {
 		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
@@ -1256,6 +1620,7 @@ namespace sibr
 
 	template<typename T_Type, unsigned int T_NumComp>  template<typename ImageType>
 	void Texture2DArray<T_Type, T_NumComp>::updateSlices(const std::vector<ImageType>& images, const std::vector<int>& slices) {
+		SIBR_PROFILE_CPU("Texture upload");
 		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
 
 		int numSlices = (int)slices.size();
@@ -1292,9 +1657,36 @@ namespace sibr
 				ImgTypeInfo::data(*imagesPtrToSend[slices[i]])
 			);
 		}
+		// Only the updated layers need new mips.
+		if (m_Flags & SIBR_GPU_AUTOGEN_MIPMAP) {
+			generateMipmaps(slices);
+		}
 		CHECK_GL_ERROR;
 	}
 
+	template<typename T_Type, unsigned int T_NumComp>  template<typename ImageType>
+	TextureUploader::Ticket Texture2DArray<T_Type, T_NumComp>::updateSlicesAsync(const std::vector<ImageType>& images, const std::vector<int>& slices, TextureUploader& uploader) {
+		using ImgTypeInfo = GLTexFormat<ImageType, T_Type, T_NumComp>;
+
+		if (slices.empty()) {
+			return uploader.last();
+		}
+		std::vector<ImageType> tmp;
+		std::vector<const ImageType*> imagesPtrToSend = applyFlipAndResize(images, tmp, m_W, m_H, slices);
+
+		const size_t layerBytes = size_t(m_W) * size_t(m_H) * T_NumComp * sizeof(T_Type);
+		TextureUploader::Ticket ticket = uploader.last();
+		for (const int slice : slices) {
+			ticket = uploader.upload(m_Handle, 0, slice, m_W, m_H,
+				ImgTypeInfo::format, ImgTypeInfo::type, ImgTypeInfo::data(*imagesPtrToSend[slice]), layerBytes);
+		}
+		if (m_Flags & SIBR_GPU_AUTOGEN_MIPMAP) {
+			generateMipmaps(slices);
+		}
+		CHECK_GL_ERROR;
+		return ticket;
+	}
+
 	template<typename T_Type, unsigned int T_NumComp>
 	void Texture2DArray<T_Type, T_NumComp>::createFromRTs(const std::vector<typename PixelRT::Ptr>& RTs, uint flags) {
 		m_W = 0;
@@ -1367,9 +1759,9 @@ namespace sibr
 	template<typename T_Type, unsigned int T_NumComp>
 	TextureCubeMap<T_Type, T_NumComp>::TextureCubeMap(const PixelImage& xpos, const PixelImage& xneg,
 		const PixelImage& ypos, const PixelImage& yneg,
-		const PixelImage& zpos, const PixelImage& zneg, uint flags) {
+		const PixelImage& zpos, const PixelImage& zneg, uint flags, uint compression) {
 		m_Flags = flags;
-		createFromImages(xpos, xneg, ypos, yneg, zpos, zneg, flags);
+		createFromImages(xpos, xneg, ypos, yneg, zpos, zneg, flags, compression);
 	}
 
 
@@ -1431,28 +1823,22 @@ namespace sibr
 
 		// ...
 		if (m_Flags & SIBR_FLIP_TEXTURE) {
-			flippedXpos = xpos.clone();
-			flippedXpos.flipH();
+			flippedXpos = xpos.flippedH();
 			sendedXpos = &flippedXpos;
 
-			flippedYpos = ypos.clone();
-			flippedYpos.flipH();
+			flippedYpos = ypos.flippedH();
 			sendedYpos = &flippedYpos;
 
-			flippedZpos = zpos.clone();
-			flippedZpos.flipH();
+			flippedZpos = zpos.flippedH();
 			sendedZpos = &flippedZpos;
 
-			flippedXneg = xneg.clone();
-			flippedXneg.flipH();
+			flippedXneg = xneg.flippedH();
 			sendedXneg = &flippedXneg;
 
-			flippedYneg = yneg.clone();
-			flippedYneg.flipH();
+			flippedYneg = yneg.flippedH();
 			sendedYneg = &flippedYneg;
 
-			flippedZneg = zneg.clone();
-			flippedZneg.flipH();
+			flippedZneg = zneg.flippedH();
 			sendedZneg = &flippedZneg;
 		}
 
@@ -1469,33 +1855,68 @@ namespace sibr
 			: GLFormat<typename PixelFormat::Type, PixelFormat::NumComp>::format;
 		const auto ttype = GLType<typename PixelFormat::Type>::type;
 
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, tinternal_format, xpos.w(), xpos.h(), 0, tformat, ttype, xpos.data());
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, tinternal_format, xneg.w(), xneg.h(), 0, tformat, ttype, xneg.data());
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, tinternal_format, ypos.w(), ypos.h(), 0, tformat, ttype, ypos.data());
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, tinternal_format, yneg.w(), yneg.h(), 0, tformat, ttype, yneg.data());
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, tinternal_format, zpos.w(), zpos.h(), 0, tformat, ttype, zpos.data());
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, tinternal_format, zneg.w(), zneg.h(), 0, tformat, ttype, zneg.data());
-
+		const PixelImage* faces[6] = { sendedXpos, sendedXneg, sendedYpos, sendedYneg, sendedZpos, sendedZneg };
+		const bool autoMIPMAP = ((m_Flags & SIBR_GPU_AUTOGEN_MIPMAP) != 0);
+		const uint levels = autoMIPMAP ? uint(std::floor(std::log2(float(std::max(m_W, m_H))))) + 1 : 1;
+		if (autoMIPMAP && (m_Flags & SIBR_GPU_LINEAR_SAMPLING)) {
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
 
-		bool autoMIPMAP = ((m_Flags & SIBR_GPU_AUTOGEN_MIPMAP) != 0);
-		if (autoMIPMAP) {
-			glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		if (m_Compression == 0) {
+			for (int f = 0; f < 6; ++f) {
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, tinternal_format, faces[f]->w(), faces[f]->h(), 0, tformat, ttype, faces[f]->data());
+			}
+			if (autoMIPMAP) {
+				glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+			}
+			m_Memory.set(MemoryTracker::textureBytes(m_W, m_H, 6, levels, double(sizeof(T_Type) * T_NumComp)));
+			return;
 		}
 
+		// The mipmaps are generated on the GPU in an uncompressed copy, then each level goes through
+		// a pixel buffer to be encoded by the driver, without a round trip to the client memory.
+		GLuint staging = 0;
+		glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &staging);
+		glTextureStorage2D(staging, levels, tinternal_format, m_W, m_H);
+		for (int f = 0; f < 6; ++f) {
+			glTextureSubImage3D(staging, 0, 0, 0, f, m_W, m_H, 1, tformat, ttype, faces[f]->data());
+		}
+		if (levels > 1) {
+			glGenerateTextureMipmap(staging);
+		}
 
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, m_Compression, m_W, m_H);
+		GLuint pixels = 0;
+		glCreateBuffers(1, &pixels);
+		glNamedBufferData(pixels, GLsizeiptr(m_W) * m_H * 6 * sizeof(T_Type) * T_NumComp, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixels);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixels);
+		for (uint l = 0; l < levels; ++l) {
+			const GLsizei lw = GLsizei(std::max(1u, m_W >> l));
+			const GLsizei lh = GLsizei(std::max(1u, m_H >> l));
+			glGetTextureImage(staging, l, tformat, ttype, GLsizei(lw * lh * 6 * sizeof(T_Type) * T_NumComp), nullptr);
+			glTextureSubImage3D(m_Handle, l, 0, 0, 0, lw, lh, 6, tformat, ttype, nullptr);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pixels);
+		glDeleteTextures(1, &staging);
+		m_Memory.set(MemoryTracker::textureBytes(m_W, m_H, 6, levels, MemoryTracker::texelBytes(GLenum(m_Compression))));
+		CHECK_GL_ERROR;
 	}
 
 
 	template<typename T_Type, unsigned int T_NumComp>
 	void TextureCubeMap<T_Type, T_NumComp>::createFromImages(const PixelImage& xpos, const PixelImage& xneg,
 		const PixelImage& ypos, const PixelImage& yneg,
-		const PixelImage& zpos, const PixelImage& zneg, uint flags) {
+		const PixelImage& zpos, const PixelImage& zneg, uint flags, uint compression) {
 		const int numMipMap = 1;
 		sibr::Vector2u maxSize(0, 0);
 		/// \todo TODO: check if the six images have the same size.
 		m_W = xpos.w();
 		m_H = xpos.h();
 		m_Flags = flags;
+		m_Compression = compression;
 		createCubeMap();
 		sendCubeMap(xpos, xneg, ypos, yneg, zpos, zneg);
 	}
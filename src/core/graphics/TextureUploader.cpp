@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "TextureUploader.hpp"
+#include "FrameProfiler.hpp"
+#include <cstring>
+
+namespace sibr {
+
+	namespace {
+
+		// Region offsets stay aligned for any component type.
+		const size_t kAlignment = 16;
+	}
+
+	TextureUploader::TextureUploader(size_t capacity) :
+		_capacity(capacity)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &_buffer);
+		glNamedBufferStorage(_buffer, GLsizeiptr(_capacity), nullptr, flags);
+		_mapped = static_cast<char*>(glMapNamedBufferRange(_buffer, 0, GLsizeiptr(_capacity), flags));
+		if (!_mapped) {
+			SIBR_WRG << "[TextureUploader] Unable to map the staging buffer, uploads will be synchronous." << std::endl;
+			_capacity = 0;
+		}
+		CHECK_GL_ERROR;
+	}
+
+	TextureUploader::~TextureUploader()
+	{
+		finish();
+		if (_buffer) {
+			if (_mapped) {
+				glUnmapNamedBuffer(_buffer);
+			}
+			glDeleteBuffers(1, &_buffer);
+		}
+	}
+
+	TextureUploader::Ticket TextureUploader::upload(GLuint texture, int level, int layer, uint w, uint h, GLenum format, GLenum type, const void * data, size_t bytes)
+	{
+		SIBR_PROFILE_CPU("Texture upload");
+		const bool staged = bytes <= _capacity;
+		size_t offset = 0;
+		if (staged) {
+			offset = reserve(bytes);
+			std::memcpy(_mapped + offset, data, bytes);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		// From the buffer, the pointer is an offset in it.
+		const void * pixels = staged ? reinterpret_cast<const void*>(offset) : data;
+		if (layer < 0) {
+			glTextureSubImage2D(texture, level, 0, 0, GLsizei(w), GLsizei(h), format, type, pixels);
+		}
+		else {
+			glTextureSubImage3D(texture, level, 0, 0, layer, GLsizei(w), GLsizei(h), 1, format, type, pixels);
+		}
+		if (staged) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		// Direct uploads get an empty region, to keep tickets completing in order.
+		Region region;
+		region.offset = offset;
+		region.size = staged ? bytes : 0;
+		region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region.ticket = _next++;
+		_inFlight.push_back(region);
+		CHECK_GL_ERROR;
+		return region.ticket;
+	}
+
+	bool TextureUploader::isComplete(Ticket ticket)
+	{
+		retire(false);
+		return ticket <= _completed;
+	}
+
+	void TextureUploader::wait(Ticket ticket)
+	{
+		while (ticket > _completed && !_inFlight.empty()) {
+			retire(true);
+		}
+	}
+
+	void TextureUploader::finish()
+	{
+		while (!_inFlight.empty()) {
+			retire(true);
+		}
+	}
+
+	void TextureUploader::retire(bool block)
+	{
+		while (!_inFlight.empty()) {
+			const Region & region = _inFlight.front();
+			GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			while (block && status == GL_TIMEOUT_EXPIRED) {
+				status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+			}
+			if (status == GL_TIMEOUT_EXPIRED) {
+				return;
+			}
+			// Only the first region is waited for, the next ones are released if already done.
+			block = false;
+			glDeleteSync(region.fence);
+			_completed = region.ticket;
+			_inFlight.pop_front();
+		}
+	}
+
+	size_t TextureUploader::reserve(size_t bytes)
+	{
+		for (;;) {
+			if (_inFlight.empty()) {
+				_head = 0;
+			}
+			const size_t offset = (_head + bytes <= _capacity) ? _head : 0;
+			bool overlaps = false;
+			for (const Region & region : _inFlight) {
+				if (region.size > 0 && offset < region.offset + region.size && region.offset < offset + bytes) {
+					overlaps = true;
+					break;
+				}
+			}
+			if (!overlaps) {
+				_head = (offset + bytes + kAlignment - 1) / kAlignment * kAlignment;
+				return offset;
+			}
+			retire(true);
+		}
+	}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <core/graphics/Config.hpp>
+#include <deque>
+
+namespace sibr {
+
+	/**
+	 * Stages texture updates in a persistently mapped pixel unpack buffer, used as a ring.
+	 * Each upload copies the pixels in the next free region of the ring and issues the texture
+	 * update from it, so the call returns without waiting for the GPU. A fence is placed after each
+	 * upload; the region is reused once it has signaled, and the returned ticket can be polled to
+	 * know when the texture content is complete.
+	 *
+	 *		TextureUploader uploader;
+	 *		TextureUploader::Ticket last = 0;
+	 *		for (uint i = 0; i < layers; ++i) {
+	 *			last = uploader.upload(texture, 0, i, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels[i], w * h * 3);
+	 *		}
+	 *		// Later, on each frame:
+	 *		if (uploader.isComplete(last)) { ... }
+	 *
+	 * \note Uploads larger than the ring are sent directly from client memory.
+	 * \ingroup sibr_graphics
+	 */
+	class SIBR_GRAPHICS_EXPORT TextureUploader {
+		SIBR_CLASS_PTR(TextureUploader);
+		SIBR_DISALLOW_COPY(TextureUploader);
+
+	public:
+
+		/// Identifies an upload, tickets increase with each call to upload.
+		typedef uint64_t Ticket;
+
+		/** Constructor.
+		\param capacity size of the staging ring in bytes
+		*/
+		TextureUploader(size_t capacity = size_t(64) << 20);
+
+		/// Destructor, waits for the uploads in flight.
+		~TextureUploader();
+
+		/** Copy pixels to the ring and update a texture from them.
+		\param texture the texture handle
+		\param level the mip level to update
+		\param layer the layer to update for array textures, -1 for 2D textures
+		\param w the width of the region
+		\param h the height of the region
+		\param format the pixel GL format
+		\param type the component GL type
+		\param data the pixels, tightly packed, can be released once the call returns
+		\param bytes the size of the pixels
+		\return the ticket of the upload
+		*/
+		Ticket upload(GLuint texture, int level, int layer, uint w, uint h, GLenum format, GLenum type, const void * data, size_t bytes);
+
+		/** Check if an upload is done, without blocking.
+		\param ticket the upload ticket
+		\return true if the texture has been updated
+		*/
+		bool isComplete(Ticket ticket);
+
+		/** Wait for an upload.
+		\param ticket the upload ticket
+		*/
+		void wait(Ticket ticket);
+
+		/** Wait for all uploads in flight. */
+		void finish();
+
+		/** \return the ticket of the last upload, 0 if none. */
+		Ticket last() const { return _next - 1; }
+
+		/** \return the ring size in bytes. */
+		size_t capacity() const { return _capacity; }
+
+	private:
+
+		/// Region of the ring used by an upload.
+		struct Region {
+			size_t offset; ///< Start in the ring.
+			size_t size; ///< Size in bytes.
+			GLsync fence; ///< Signaled when the texture no longer reads the region.
+			Ticket ticket; ///< Upload ticket.
+		};
+
+		/** Release the oldest regions whose fence has signaled.
+		\param block wait for the oldest region even if it is still in use
+		*/
+		void retire(bool block);
+
+		/** Find room in the ring, waiting for older uploads if needed.
+		\param bytes the size to reserve
+		\return the offset of the region
+		*/
+		size_t reserve(size_t bytes);
+
+		GLuint _buffer = 0; ///< Staging buffer.
+		char * _mapped = nullptr; ///< Persistent mapping of the staging buffer.
+		size_t _capacity = 0; ///< Staging buffer size.
+		size_t _head = 0; ///< Next offset to allocate from.
+		std::deque<Region> _inFlight; ///< Regions in use, oldest first.
+		Ticket _next = 1; ///< Next ticket.
+		Ticket _completed = 0; ///< Uploads up to this ticket are done.
+	};
+
+}
@@ -421,9 +421,7 @@ namespace sibr{
 
 		/** \copydoc GLTexFormat::flip */
 		static ImageType flip(const ImageType& img) {
-			ImageType temp = img.clone();
-			temp.flipH();
-			return temp;
+			return img.flippedH();
 		}
 
 		/** \copydoc GLTexFormat::resize */
@@ -460,9 +458,7 @@ namespace sibr{
 
 		/** \copydoc GLTexFormat::flip */
 		static ImageType flip(const ImageType& img) {
-			ImageType temp = ImageType::fromImg(*img);
-			temp->flipH();
-			return temp;
+			return ImageType(std::make_shared<typename ImageType::ImageType>(img->flippedH()));
 		}
 
 		/** \copydoc GLTexFormat::resize */
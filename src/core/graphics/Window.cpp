@@ -14,12 +14,26 @@
 #include "core/graphics/Input.hpp"
 #include "core/graphics/Window.hpp"
 #include "core/graphics/RenderUtility.hpp"
+#include "core/graphics/RenderTargetPool.hpp"
+#include "core/graphics/GUITextureProxies.hpp"
+#include "core/graphics/StreamingBuffer.hpp"
+#include "core/graphics/GPUMemoryBudget.hpp"
+#include "core/graphics/FrameProfiler.hpp"
+#include "core/graphics/GLState.hpp"
+#include "core/system/FileWatcher.hpp"
+#include "core/system/MainThreadQueue.hpp"
 
 #include "imgui/imgui.cpp" // needed for loading ini settings
 #include "imgui/imgui.h"
 #include "imgui_impl_glfw_gl3.h"
 
 #include <regex>
+#include <thread>
+
+#ifdef GLEW_EGL
+# include <EGL/egl.h>
+# include <EGL/eglext.h>
+#endif
 
 namespace sibr
 {
@@ -127,32 +141,78 @@ namespace sibr
 	///////////////////////////////////////////////////////////////////////////
 
 	static int windowCounter = 0;
+	static int displayCounter = 0; ///< Windows using GLFW.
+	static int headlessCounter = 0; ///< Headless windows, sharing the EGL device displays.
 
 	/*static*/ bool			Window::contextIsRunning( void )
 	{
 		return windowCounter > 0;
 	}
 
-	Window::AutoInitializer::AutoInitializer( const WindowArgs & args ) : _useGUI(!args.no_gui && !args.offscreen)
+	/*static*/ bool			Window::displayIsRunning( void )
+	{
+		return displayCounter > 0;
+	}
+
+	/*static*/ bool			Window::supportsHeadless( void )
+	{
+#ifdef GLEW_EGL
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/*static*/ const void *	Window::currentContext( void )
+	{
+		if (displayCounter > 0 && glfwGetCurrentContext()) {
+			return glfwGetCurrentContext();
+		}
+#ifdef GLEW_EGL
+		if (headlessCounter > 0 && eglGetCurrentContext() != EGL_NO_CONTEXT) {
+			return eglGetCurrentContext();
+		}
+#endif
+		return nullptr;
+	}
+
+	Window::AutoInitializer::AutoInitializer( const WindowArgs & args ) : _useGUI(!args.no_gui && !args.offscreen && !args.headless), _useDisplay(false)
 	{
-		if (windowCounter == 0)
+		// Headless windows never touch the window system, it might not even be available.
+		if (!args.headless || !Window::supportsHeadless()) {
+			const bool firstInit = displayCounter == 0;
+			initDisplay();
+			if (firstInit && !args.offscreen && !args.headless)
+				sibr::Input::global().key().clearStates();
+		}
+		++windowCounter;
+	}
+
+	void Window::AutoInitializer::initDisplay( void )
+	{
+		if (_useDisplay) {
+			return;
+		}
+		if (displayCounter == 0)
 		{
 			SIBR_LOG << "Initialization of GLFW" << std::endl;
 			glfwSetErrorCallback(glfwErrorCallback);
 
 			if (!glfwInit())
 				SIBR_ERR << "cannot init glfw" << std::endl;
-			if (!args.offscreen)
-				sibr::Input::global().key().clearStates();
-
 		}
-		++windowCounter;
+		++displayCounter;
+		_useDisplay = true;
 	}
 
 	Window::AutoInitializer::~AutoInitializer( void )
 	{
 		--windowCounter;
-		if (windowCounter == 0)
+		if (!_useDisplay) {
+			return;
+		}
+		--displayCounter;
+		if (displayCounter == 0)
 		{
 			if(_useGUI) {
 				ImGui_ImplGlfwGL3_Shutdown();	/// \todo TODO: not sure if safe with multi-context
@@ -165,12 +225,12 @@ namespace sibr
 	}
 
 	Window::Window(uint w, uint h, const std::string& title, const WindowArgs & args, const std::string& defaultSettingsFilename) 
-		: _hiddenInit(args), _useGUI(!args.no_gui && !args.offscreen), _shouldClose(false) 
+		: _hiddenInit(args), _useGUI(!args.no_gui && !args.offscreen && !args.headless), _shouldClose(false) 
 	{
 		
 		setup(w, h, title, args, defaultSettingsFilename);
 
-		if (!(args.fullscreen)) {
+		if (!(args.fullscreen) && !_headless) {
 			glfwSetWindowPos(_glfwWin.get(), 200, 200);
 		}
 	}
@@ -181,10 +241,10 @@ namespace sibr
 	}
 
 	Window::Window(const std::string& title, const sibr::Vector2i & margins, const WindowArgs & args, const std::string& defaultSettingsFilename)
-		: _hiddenInit(args), _useGUI(!args.no_gui && !args.offscreen), _shouldClose(false)
+		: _hiddenInit(args), _useGUI(!args.no_gui && !args.offscreen && !args.headless), _shouldClose(false)
 	{
 		sibr::Vector2i winSize;
-		if (args.offscreen) {
+		if (args.offscreen || args.headless) {
 			winSize = sibr::Vector2i(args.win_width, args.win_height);
 		}
 		else {
@@ -194,12 +254,55 @@ namespace sibr
 		// Here autoInitializer is already initialized, thus glfwInit() has been called
 		setup(winSize.x() - 2*margins.x(), winSize.y() - 2*margins.y(), title, args, defaultSettingsFilename);
 
-		if (!(args.fullscreen)) {
+		if (!(args.fullscreen) && !_headless) {
 			glfwSetWindowPos(_glfwWin.get(), margins.x(), margins.y());
 		}
 
 	}
 
+	Window::~Window()
+	{
+		for (GLsync fence : _frameFences) {
+			glDeleteSync(fence);
+		}
+		if (!_headless) {
+			return;
+		}
+#ifdef GLEW_EGL
+		makeContextCurrent();
+		GLState::deleteFramebuffers(1, &_headlessFbo);
+		const GLuint renderbuffers[] = { _headlessColor, _headlessDepth };
+		glDeleteRenderbuffers(2, renderbuffers);
+		eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(_eglDisplay, _eglContext);
+		GLState::invalidate();
+		// The display of a device is shared by all contexts created on it.
+		if (--headlessCounter == 0) {
+			eglTerminate(_eglDisplay);
+		}
+#endif
+	}
+
+	void Window::makeContextCurrent(void) {
+		if (_headless) {
+#ifdef GLEW_EGL
+			eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, _eglContext);
+#endif
+			return;
+		}
+		glfwMakeContextCurrent(_glfwWin.get());
+	}
+
+	void Window::makeContextNull(void) {
+		if (_headless) {
+#ifdef GLEW_EGL
+			eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+			return;
+		}
+		glfwMakeContextCurrent(0);
+	}
+
 	void Window::swapBuffer(void) {
 		if (_useGUI) {
 			glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "ImGui interface");
@@ -207,7 +310,63 @@ namespace sibr
 			ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
 			glPopDebugGroup();
 		}
-		glfwSwapBuffers(_glfwWin.get());
+		{
+			// GL work produced by background tasks, bounded so that a burst of uploads spreads over several frames.
+			SIBR_PROFILE_CPU("Main thread tasks");
+			MainThreadQueue::shared().run(2.0);
+		}
+		{
+			// Reload the assets modified on disk.
+			SIBR_PROFILE_CPU("File watcher");
+			FileWatcher::shared().poll();
+		}
+		if (_framePeriod.count() > 0) {
+			SIBR_PROFILE_CPU("Frame pacing");
+			const auto now = std::chrono::steady_clock::now();
+			if (now > _nextFrame + _framePeriod) {
+				// Too late (stall, window moved...): restart from now instead of rushing the next frames.
+				_nextFrame = now;
+			}
+			else {
+				// The OS sleep is coarse: stop a bit early and spin until the deadline to limit jitter.
+				const auto coarse = _nextFrame - std::chrono::milliseconds(2);
+				if (now < coarse) {
+					std::this_thread::sleep_until(coarse);
+				}
+				while (std::chrono::steady_clock::now() < _nextFrame) {
+					std::this_thread::yield();
+				}
+			}
+			_nextFrame += _framePeriod;
+		}
+		if (_headless) {
+			// Nothing to present, only submit the frame.
+			glFlush();
+		} else {
+			glfwSwapBuffers(_glfwWin.get());
+		}
+		if (_maxFramesInFlight > 0) {
+			SIBR_PROFILE_CPU("Frames in flight");
+			_frameFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+			while (_frameFences.size() > _maxFramesInFlight) {
+				// Bounded wait, a lost fence should not freeze the application.
+				glClientWaitSync(_frameFences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+				glDeleteSync(_frameFences.front());
+				_frameFences.pop_front();
+			}
+		}
+		else {
+			for (GLsync fence : _frameFences) {
+				glDeleteSync(fence);
+			}
+			_frameFences.clear();
+		}
+		RenderTargetPool::global().nextFrame();
+		GUITextureProxies::global().nextFrame();
+		StreamingBuffer::global().nextFrame();
+		GPUMemoryBudget::global().nextFrame();
+		GLState::nextFrame();
+		FrameProfiler::get().nextFrame();
 		// Keep the call below in all cases to avoid accumulating all interfaces in one frame.
 		if (_useGUI)
 			ImGui_ImplGlfwGL3_NewFrame();
@@ -259,43 +418,57 @@ namespace sibr
 		// IMPORTANT NOTE: if you got compatibility problem with old opengl function,
 		// try to load compat 3.2 instead of core 4.2
 
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+		if (args.headless) {
+			if (!supportsHeadless()) {
+				SIBR_WRG << "Headless mode requires EGL support, using a hidden window instead (a display is still needed)." << std::endl;
+			}
+			else if (!setupHeadlessContext(args)) {
+				SIBR_WRG << "Headless context creation failed, using a hidden window instead (a display is still needed)." << std::endl;
+				_hiddenInit.initDisplay();
+			}
+			else {
+				_headless = true;
+			}
+		}
+		const bool offscreen = args.offscreen || args.headless;
+
+		if (!_headless) {
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
 
 #ifdef GLEW_EGL
-		glfwWindowHint(GLFW_CONTEXT_CREATION_API, (args.offscreen) ?
-													GLFW_EGL_CONTEXT_API :
-													GLFW_NATIVE_CONTEXT_API);
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, (offscreen) ?
+														GLFW_EGL_CONTEXT_API :
+														GLFW_NATIVE_CONTEXT_API);
 #else
-		if(args.offscreen) SIBR_WRG << "Offscreen enabled without EGL implementation. Using native context (Offscreen might run into issues if no real display is available)." << std::endl;
+			if(offscreen) SIBR_WRG << "Offscreen enabled without EGL implementation. Using native context (Offscreen might run into issues if no real display is available)." << std::endl;
 #endif
 
-		glfwWindowHint(GLFW_RED_BITS, 8);
-		glfwWindowHint(GLFW_GREEN_BITS, 8);
-		glfwWindowHint(GLFW_BLUE_BITS, 8);
-		glfwWindowHint(GLFW_ALPHA_BITS, 8);
-		glfwWindowHint(GLFW_DEPTH_BITS, 24);
-		glfwWindowHint(GLFW_STENCIL_BITS, 8);
-
-		if (args.offscreen) {
-			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-		}
+			glfwWindowHint(GLFW_RED_BITS, 8);
+			glfwWindowHint(GLFW_GREEN_BITS, 8);
+			glfwWindowHint(GLFW_BLUE_BITS, 8);
+			glfwWindowHint(GLFW_ALPHA_BITS, 8);
+			glfwWindowHint(GLFW_DEPTH_BITS, 24);
+			glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
-		_glfwWin = GLFWwindowptr(
-			glfwCreateWindow(
-				width, height, title.c_str(),
-				(args.fullscreen && !args.offscreen) ? glfwGetPrimaryMonitor() : NULL
-				, NULL ), 
-			glfwDestroyWindow
-		);
+			if (offscreen) {
+				glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			}
 
-		if (_glfwWin == nullptr)
-			SIBR_ERR << "failed to create a glfw window (is your graphics driver updated ?)" << std::endl;
+			_glfwWin = GLFWwindowptr(
+				glfwCreateWindow(
+					width, height, title.c_str(),
+					(args.fullscreen && !offscreen) ? glfwGetPrimaryMonitor() : NULL
+					, NULL ), 
+				glfwDestroyWindow
+			);
 
-		makeContextCurrent();
+			if (_glfwWin == nullptr)
+				SIBR_ERR << "failed to create a glfw window (is your graphics driver updated ?)" << std::endl;
 
-		
+			makeContextCurrent();
+		}
 
 		//SR, TT fix for image size non divisible by 4
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -312,7 +485,7 @@ namespace sibr
 		GLenum err = glewInit();
 #ifdef GLEW_EGL
 //		if (err != GLEW_OK && (!args.offscreen || err != GLEW_ERROR_NO_GLX_DISPLAY)) // Small hack for glew, this error occurs but does not concern offscreen
-		if (err != GLEW_OK && (!args.offscreen )) // Small hack for glew, this error occurs but does not concern offscreen
+		if (err != GLEW_OK && (!offscreen )) // Small hack for glew, this error occurs but does not concern offscreen
 #else
 		if (err != GLEW_OK)
 #endif
@@ -320,17 +493,24 @@ namespace sibr
 		(void)glGetError(); // I notice that glew might do wrong things during its init()
 							// some drivers complain about it. So I reset OpenGL's errors to discard this.
 
-		glfwSetWindowUserPointer(_glfwWin.get(), this);
 		/// \todo TODO: fix, width and height might be erroneous. SR
 		viewport(Viewport(0.f, 0.f, (float)width, (float)height));	/// \todo TODO: bind both
 
 		_useVSync = args.vsync;
-		glfwSwapInterval(args.vsync);
-		glfwSetKeyCallback(_glfwWin.get(), glfwKeyboardCallback);
-		glfwSetScrollCallback(_glfwWin.get(), glfwMouseScrollCallback);
-		glfwSetMouseButtonCallback(_glfwWin.get(), glfwMouseButtonCallback);
-		glfwSetCursorPosCallback(_glfwWin.get(), glfwCursorPosCallback);
-		glfwSetWindowSizeCallback(_glfwWin.get(), glfwResizeCallback);
+		_maxFramesInFlight = uint(std::max(int(args.frames_in_flight), 0));
+		if (_headless) {
+			// The window buffer, bound as the default framebuffer.
+			resizeHeadlessFramebuffer(width, height);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, _headlessFbo);
+		} else {
+			glfwSetWindowUserPointer(_glfwWin.get(), this);
+			glfwSwapInterval(args.vsync);
+			glfwSetKeyCallback(_glfwWin.get(), glfwKeyboardCallback);
+			glfwSetScrollCallback(_glfwWin.get(), glfwMouseScrollCallback);
+			glfwSetMouseButtonCallback(_glfwWin.get(), glfwMouseButtonCallback);
+			glfwSetCursorPosCallback(_glfwWin.get(), glfwCursorPosCallback);
+			glfwSetWindowSizeCallback(_glfwWin.get(), glfwResizeCallback);
+		}
 
 		// SR: we don't use it by default because you won't get callstack/file/line info.
 		if(args.gl_debug) {
@@ -360,7 +540,7 @@ namespace sibr
 			loadSettings();
 		}
 
-		if(!args.offscreen) {
+		if(!offscreen) {
 			_oldPosition = position();
 			_oldSize = size();
 
@@ -389,6 +569,92 @@ namespace sibr
 		*/
 	}
 
+	bool Window::setupHeadlessContext(const WindowArgs & args) {
+#ifdef GLEW_EGL
+		const auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+		const auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (!queryDevices || !getPlatformDisplay) {
+			SIBR_WRG << "EGL device enumeration is not supported by the driver." << std::endl;
+			return false;
+		}
+
+		EGLint deviceCount = 0;
+		if (!queryDevices(0, nullptr, &deviceCount) || deviceCount == 0) {
+			SIBR_WRG << "No EGL device found." << std::endl;
+			return false;
+		}
+		std::vector<EGLDeviceEXT> devices(deviceCount);
+		queryDevices(deviceCount, devices.data(), &deviceCount);
+		const int deviceId = args.headless_device;
+		if (deviceId < 0 || deviceId >= deviceCount) {
+			SIBR_WRG << "EGL device " << deviceId << " does not exist (" << deviceCount << " available)." << std::endl;
+			return false;
+		}
+
+		EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[deviceId], nullptr);
+		EGLint eglMajor = 0, eglMinor = 0;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+			SIBR_WRG << "Cannot initialize EGL device " << deviceId << "." << std::endl;
+			return false;
+		}
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+			EGL_CONTEXT_MINOR_VERSION_KHR, 5,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+			EGL_CONTEXT_FLAGS_KHR, args.gl_debug ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		EGLContext context = EGL_NO_CONTEXT;
+		if (eglChooseConfig(display, configAttribs, &config, 1, &configCount) && configCount > 0 && eglBindAPI(EGL_OPENGL_API)) {
+			context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+		}
+		// No surface at all (EGL_KHR_surfaceless_context): the window buffer is a framebuffer object.
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+			const EGLint error = eglGetError();
+			if (context != EGL_NO_CONTEXT) {
+				eglDestroyContext(display, context);
+			}
+			if (headlessCounter == 0) {
+				eglTerminate(display);
+			}
+			SIBR_WRG << "Cannot create an OpenGL 4.5 context on EGL device " << deviceId << " (EGL error 0x" << std::hex << error << std::dec << ")." << std::endl;
+			return false;
+		}
+
+		++headlessCounter;
+		_eglDisplay = display;
+		_eglContext = context;
+		SIBR_LOG << "Headless rendering on EGL device " << deviceId << " of " << deviceCount << " (EGL " << eglMajor << "." << eglMinor << ")." << std::endl;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void Window::resizeHeadlessFramebuffer(int width, int height) {
+		if (_headlessFbo == 0) {
+			glCreateFramebuffers(1, &_headlessFbo);
+			glCreateRenderbuffers(1, &_headlessColor);
+			glCreateRenderbuffers(1, &_headlessDepth);
+		}
+		_size = Vector2i(std::max(width, 1), std::max(height, 1));
+		glNamedRenderbufferStorage(_headlessColor, GL_RGBA8, _size[0], _size[1]);
+		glNamedRenderbufferStorage(_headlessDepth, GL_DEPTH24_STENCIL8, _size[0], _size[1]);
+		glNamedFramebufferRenderbuffer(_headlessFbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _headlessColor);
+		glNamedFramebufferRenderbuffer(_headlessFbo, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _headlessDepth);
+		if (glCheckNamedFramebufferStatus(_headlessFbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			SIBR_ERR << "Headless window buffer is incomplete." << std::endl;
+		}
+	}
+
 	Vector2i		Window::desktopSize( void )
 	{
 		const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
@@ -397,6 +663,9 @@ namespace sibr
 
 	Vector2i		Window::size( void ) const
 	{
+		if (_headless) {
+			return _size;
+		}
 		Vector2i s;
 		glfwGetWindowSize(_glfwWin.get(), &s[0], &s[1]);
 		return s;
@@ -404,10 +673,16 @@ namespace sibr
 
 	void Window::position(const unsigned int x, const unsigned int y)
 	{
+		if (_headless) {
+			return;
+		}
 		glfwSetWindowPos(_glfwWin.get(), x, y);
 	}
 
 	Vector2i Window::position() const {
+		if (_headless) {
+			return Vector2i(0, 0);
+		}
 		Vector2i s;
 		glfwGetWindowPos(_glfwWin.get(), &s[0], &s[1]);
 		return s;
@@ -415,23 +690,24 @@ namespace sibr
 
 	bool			Window::isOpened( void ) const
 	{
-		return (!_shouldClose && !glfwWindowShouldClose(_glfwWin.get()));
+		return (!_shouldClose && (_headless || !glfwWindowShouldClose(_glfwWin.get())));
 	}
 
 	void			Window::close( void )
 	{
 		_shouldClose = true;
-		glfwSetWindowShouldClose(_glfwWin.get(), GL_TRUE);
+		if (!_headless)
+			glfwSetWindowShouldClose(_glfwWin.get(), GL_TRUE);
 	}
 
 	bool Window::isFullscreen(void) const
 	{
-		return glfwGetWindowMonitor(_glfwWin.get()) != NULL;
+		return !_headless && glfwGetWindowMonitor(_glfwWin.get()) != NULL;
 	}
 
 	void Window::setFullscreen(const bool fullscreen) {
 		const bool currentState = isFullscreen();
-		if((fullscreen && currentState) || (!fullscreen && !currentState)) {
+		if(_headless || (fullscreen && currentState) || (!fullscreen && !currentState)) {
 			// Do nothing.
 			return;
 		}
@@ -451,6 +727,11 @@ namespace sibr
 
 	void			Window::size( int w, int h )
 	{
+		if (_headless) {
+			resizeHeadlessFramebuffer(w, h);
+			viewport(Viewport(0.f, 0.f, (float)(_size[0]), (float)(_size[1])));
+			return;
+		}
 		glfwSetWindowSize(_glfwWin.get(), w, h);
 		Vector2i s = size();
 
@@ -466,7 +747,9 @@ namespace sibr
 
 	void Window::setFrameRate(int fps)
 	{
-		if (fps == 60) {
+		if (_headless) {
+			return;
+		} else if (fps == 60) {
 			glfwSwapInterval(1);
 		} else if (fps == 30) {
 			glfwSwapInterval(2);
@@ -487,11 +770,26 @@ namespace sibr
 
 	void Window::setVsynced(const bool vsync) {
 		_useVSync = vsync;
-		glfwSwapInterval(_useVSync ? 1 : 0);
+		if (!_headless)
+			glfwSwapInterval(_useVSync ? 1 : 0);
+	}
+
+	float Window::targetFramerate(void) const
+	{
+		return _framePeriod.count() > 0 ? float(1e9 / double(_framePeriod.count())) : 0.0f;
+	}
+
+	void Window::targetFramerate(float hz)
+	{
+		_framePeriod = hz > 0.0f ? std::chrono::nanoseconds(int64_t(1e9 / double(hz))) : std::chrono::nanoseconds(0);
+		_nextFrame = std::chrono::steady_clock::now();
 	}
 
 	void				Window::enableCursor( bool enable )
 	{
+		if (_headless) {
+			return;
+		}
 		glfwSetInputMode(_glfwWin.get(), GLFW_CURSOR, enable? GLFW_CURSOR_NORMAL : GLFW_CURSOR_HIDDEN);
 	}
 
@@ -17,11 +17,16 @@
 #include "core/graphics/Viewport.hpp"
 #include "core/graphics/Texture.hpp"
 #include <core/system/CommandLineArgs.hpp>
+#include <chrono>
+#include <deque>
 
 namespace sibr
 {
 
 	/** System window backed by an internal framebuffer.
+	* In headless mode (see WindowArgs::headless), no window system is used: the context is created on an
+	* EGL device and the window buffer is a framebuffer object of the window size, so that batch renders
+	* can run on nodes without a display. Input and GUI are then unavailable.
 	* \ingroup sibr_graphics
 	*/
 	class SIBR_GRAPHICS_EXPORT Window : public IRenderTarget
@@ -57,13 +62,18 @@ namespace sibr
 		 **/
 		Window(const std::string & title, const sibr::Vector2i & margins, const WindowArgs & args = {}, const std::string& defaultSettingsFilename = "");
 
-		/** \return a pointer to the underlying GLFW window */
+		/** Destructor. */
+		~Window();
+
+		/** \return a pointer to the underlying GLFW window, nullptr in headless mode */
 		GLFWwindow *		GLFW(void);
 
 		/** Activate the associated graphics context. */
 		void				makeContextCurrent(void);
-		/** \return the context currently in use (represented by a GLFW window) */
+		/** \return the context currently in use (represented by a GLFW window), nullptr in headless mode */
 		GLFWwindow *		getContextCurrent(void);
+		/** \return an opaque handle of the context current on this thread, GLFW or headless, nullptr if none. */
+		static const void *	currentContext(void);
 		/** Deactivate the associated graphics context. */
 		void				makeContextNull(void);
 
@@ -102,6 +112,15 @@ namespace sibr
 		/** \return true if an openGL context is active. */
 		static bool			contextIsRunning(void);
 
+		/** \return true if the window system is initialized, false if there are only headless windows. */
+		static bool			displayIsRunning(void);
+
+		/** \return true if headless windows can be created (EGL support). */
+		static bool			supportsHeadless(void);
+
+		/** \return true if the window renders without a display. */
+		bool				isHeadless(void) const;
+
 		/** Set the framerate.
 		 *\param fps one of 60, 30, 15 
 		 */
@@ -136,6 +155,25 @@ namespace sibr
 		 */
 		void				setVsynced(const bool vsync);
 
+		/** \return the paced framerate, 0 if frames are not paced. */
+		float				targetFramerate(void) const;
+
+		/** Pace frames: swapBuffer waits until the next frame deadline before presenting.
+		 *\param hz the target framerate, 0 to disable pacing
+		 *\note Pacing is independent of V-sync; with V-sync on, use a divisor of the display rate.
+		 */
+		void				targetFramerate(float hz);
+
+		/** \return the number of frames the GPU can lag behind, 0 if left to the driver. */
+		uint				maxFramesInFlight(void) const { return _maxFramesInFlight; }
+
+		/** Limit the number of frames queued on the GPU: swapBuffer waits until older frames are done.
+		 * The input of the next frame is then sampled once the GPU caught up, which reduces the latency
+		 * between inputs and display on heavy views, at the cost of less CPU/GPU overlap.
+		 *\param frames the number of frames, 1 for the lowest latency, 0 to let the driver decide
+		 */
+		void				maxFramesInFlight(uint frames) { _maxFramesInFlight = frames; }
+
 		/** \return the window viewport */
 		const Viewport&		viewport(void) const;
 
@@ -151,7 +189,7 @@ namespace sibr
 		/** Get the backbuffer texture ID. unsuported. */
 		GLuint				handle(uint t = 0) const;
 
-		/** \return the window buffer ID (0) */
+		/** \return the window buffer ID (0, or the internal framebuffer in headless mode) */
 		GLuint				fbo(void) const;
 
 		/** Bind the window buffer. */
@@ -186,6 +224,18 @@ namespace sibr
 		 */
 		void setup(int width, int height, const std::string & title, const WindowArgs & args, const std::string& defaultSettingsFilename = "");
 
+		/** Create the EGL context of a headless window and make it current.
+		 *\param args window setup arguments
+		 *\return false if no EGL device could be used
+		 */
+		bool setupHeadlessContext(const WindowArgs & args);
+
+		/** Allocate the internal framebuffer of a headless window.
+		 *\param width buffer width
+		 *\param height buffer height
+		 */
+		void resizeHeadlessFramebuffer(int width, int height);
+
 		/// Window pointer for callbacks.
 		typedef std::unique_ptr<GLFWwindow, std::function<void(GLFWwindow*)>> GLFWwindowptr;
 
@@ -194,15 +244,29 @@ namespace sibr
 		{
 			AutoInitializer(const WindowArgs & args = {});
 			~AutoInitializer(void);
+
+			/** Initialize the window system if it was skipped, when a headless window falls back to a hidden one. */
+			void initDisplay(void);
 			
 			const bool			_useGUI; ///< Should ImGui windows be displayed.
+			bool				_useDisplay; ///< Is the window system used by this window.
 		};
 
 		bool				_shouldClose; ///< Is the window marked as closed.
 		GLFWwindowptr		_glfwWin; ///< Undelrying GLF window.
 		Vector2i			_size; ///< Window size.
 		const bool			_useGUI; ///< Should ImGui windows be displayed.
+		bool				_headless = false; ///< Is the window rendering without a display.
+		void *				_eglDisplay = nullptr; ///< EGL display of the headless context.
+		void *				_eglContext = nullptr; ///< EGL headless context.
+		GLuint				_headlessFbo = 0; ///< Window buffer in headless mode.
+		GLuint				_headlessColor = 0; ///< Color renderbuffer of the headless window buffer.
+		GLuint				_headlessDepth = 0; ///< Depth-stencil renderbuffer of the headless window buffer.
 		bool				_useVSync; ///< is the window using vsync.
+		std::chrono::nanoseconds _framePeriod{ 0 }; ///< Paced frame duration, 0 if disabled.
+		std::chrono::steady_clock::time_point _nextFrame; ///< Deadline of the next paced frame.
+		uint				_maxFramesInFlight = 0; ///< Frames queued on the GPU, 0 if left to the driver.
+		std::deque<GLsync>	_frameFences; ///< End of the frames in flight.
 		Vector2i			_oldPosition; ///< Backup for handling fullscreen/windowed mode restoration.
 		Vector2i			_oldSize; ///< Backup for handling fullscreen/windowed mode restoration.
 		Viewport			_viewport; ///< Current viewport.
@@ -214,16 +278,8 @@ namespace sibr
 	};
 
 	///// INLINES /////
-	inline void		Window::makeContextCurrent(void) {
-		glfwMakeContextCurrent(_glfwWin.get());
-	}
-
-	inline void		Window::makeContextNull(void) {
-		glfwMakeContextCurrent(0);
-	}
-
 	inline GLFWwindow *		Window::getContextCurrent(void) {
-		return glfwGetCurrentContext();
+		return displayIsRunning() ? glfwGetCurrentContext() : nullptr;
 	}
 
 	inline GLuint	Window::texture(uint /*t*/) const {
@@ -235,11 +291,11 @@ namespace sibr
 		return 0;
 	}
 	inline GLuint	Window::fbo(void) const {
-		return 0;
+		return _headlessFbo;
 	}
 
 	inline void		Window::bind(void) {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, _headlessFbo);
 
 		
 	}
@@ -260,6 +316,10 @@ namespace sibr
 		return (uint)size().y();
 	}
 
+	inline bool		Window::isHeadless(void) const {
+		return _headless;
+	}
+
 	inline float	Window::scaling() const
 	{
 		return _scaling;
@@ -12,8 +12,158 @@
 
 #include "CropScaleImageUtility.hpp"
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <core/system/String.hpp>
+#include <core/system/ThreadPool.hpp>
+
 namespace sibr {
 
+	namespace {
+
+		/** Raw content of a file waiting for a worker. */
+		struct PendingImage {
+			size_t					task; ///< Task index.
+			std::vector<uchar>		bytes; ///< File content.
+		};
+
+		bool readFile(const std::string & path, std::vector<uchar> & bytes)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file.good()) {
+				return false;
+			}
+			const std::streamsize size = file.tellg();
+			file.seekg(0, std::ios::beg);
+			bytes.resize(size_t(std::max<std::streamsize>(size, 0)));
+			return size > 0 && bool(file.read(reinterpret_cast<char*>(bytes.data()), size));
+		}
+
+		bool writeFile(const std::string & path, const std::vector<uchar> & bytes)
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			return bool(file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size())));
+		}
+
+		/** Image size from the header if possible, by decoding it else. */
+		sibr::Vector2i fileResolution(const std::string & path)
+		{
+			const sibr::Vector2i resolution = sibr::IImage::imageResolution(path);
+			if (resolution.x() > 0 && resolution.y() > 0) {
+				return resolution;
+			}
+			const cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+			return sibr::Vector2i(img.cols, img.rows);
+		}
+
+		std::string outputPath(const std::string & path, const CropScaleImageUtility::BatchSettings & settings)
+		{
+			if (settings.format.empty()) {
+				return path;
+			}
+			return boost::filesystem::path(path).replace_extension(settings.format).string();
+		}
+
+		/** Expected size of an output, (0,0) if it depends on the input. */
+		sibr::Vector2i expectedResolution(const CropScaleImageUtility::Task & task, const CropScaleImageUtility::Output & output)
+		{
+			return output.resolution != sibr::Vector2i(0, 0) ? output.resolution : task.cropResolution;
+		}
+
+		CropScaleImageUtility::Image makeInfos(const std::string & path, const sibr::Vector2i & resolution)
+		{
+			CropScaleImageUtility::Image infos;
+			infos.filename = boost::filesystem::path(path).filename().string();
+			infos.width = unsigned(std::max(resolution.x(), 0));
+			infos.height = unsigned(std::max(resolution.y(), 0));
+			return infos;
+		}
+
+		bool isUpToDate(const CropScaleImageUtility::Task & task, const CropScaleImageUtility::BatchSettings & settings, std::vector<CropScaleImageUtility::Image> & infos)
+		{
+			boost::system::error_code ec;
+			const std::time_t inputTime = boost::filesystem::last_write_time(task.input, ec);
+			if (ec) {
+				return false;
+			}
+			for (size_t oid = 0; oid < task.outputs.size(); ++oid) {
+				const std::string path = outputPath(task.outputs[oid].path, settings);
+				const std::time_t outputTime = boost::filesystem::last_write_time(path, ec);
+				if (ec || outputTime < inputTime) {
+					return false;
+				}
+				// Catch outputs left by a run with other parameters.
+				const sibr::Vector2i resolution = fileResolution(path);
+				const sibr::Vector2i expected = expectedResolution(task, task.outputs[oid]);
+				if (expected != sibr::Vector2i(0, 0) && resolution != expected) {
+					return false;
+				}
+				infos[oid] = makeInfos(path, resolution);
+			}
+			return true;
+		}
+
+		void processImage(const CropScaleImageUtility::Task & task, const std::vector<uchar> & bytes,
+			const CropScaleImageUtility::BatchSettings & settings, std::vector<CropScaleImageUtility::Image> & infos)
+		{
+			cv::Mat cropped;
+			for (size_t oid = 0; oid < task.outputs.size(); ++oid) {
+				const CropScaleImageUtility::Output & output = task.outputs[oid];
+				const std::string path = outputPath(output.path, settings);
+
+				// Plain copy, no need to decode.
+				const bool passthrough = task.cropResolution == sibr::Vector2i(0, 0) && output.resolution == sibr::Vector2i(0, 0)
+					&& sibr::to_lower(sibr::getExtension(path)) == sibr::to_lower(sibr::getExtension(task.input));
+				if (passthrough) {
+					if (!writeFile(path, bytes)) {
+						SIBR_WRG << "[CropScaleImageUtility] Unable to write " << path << std::endl;
+						continue;
+					}
+					infos[oid] = makeInfos(path, cropped.empty() ? fileResolution(task.input) : sibr::Vector2i(cropped.cols, cropped.rows));
+					continue;
+				}
+
+				if (cropped.empty()) {
+					const cv::Mat img = cv::imdecode(bytes, cv::IMREAD_COLOR);
+					if (img.empty()) {
+						SIBR_WRG << "[CropScaleImageUtility] Unable to decode " << task.input << std::endl;
+						return;
+					}
+					cropped = img;
+					if (task.cropResolution != sibr::Vector2i(0, 0)) {
+						const int w = std::min(task.cropResolution[0], img.cols);
+						const int h = std::min(task.cropResolution[1], img.rows);
+						if (w != task.cropResolution[0] || h != task.cropResolution[1]) {
+							SIBR_WRG << "[CropScaleImageUtility] " << task.input << " is smaller than the crop region." << std::endl;
+						}
+						cropped = img(cv::Rect((img.cols - w) / 2, (img.rows - h) / 2, w, h));
+					}
+				}
+
+				cv::Mat result = cropped;
+				if (output.resolution != sibr::Vector2i(0, 0) && output.resolution != sibr::Vector2i(cropped.cols, cropped.rows)) {
+					cv::resize(cropped, result, cv::Size(output.resolution[0], output.resolution[1]), 0, 0, settings.interpolation);
+				}
+
+				const std::vector<int> params = {
+					cv::IMWRITE_JPEG_QUALITY, settings.quality,
+					cv::IMWRITE_WEBP_QUALITY, std::max(settings.quality, 1),
+					cv::IMWRITE_PNG_COMPRESSION, settings.pngCompression
+				};
+				if (!cv::imwrite(path, result, params)) {
+					SIBR_WRG << "[CropScaleImageUtility] Unable to write " << path << std::endl;
+					continue;
+				}
+				infos[oid] = makeInfos(path, sibr::Vector2i(result.cols, result.rows));
+			}
+		}
+	}
+
 	std::vector<std::string> CropScaleImageUtility::getPathToImgs(const std::string & inputFileName)
 	{
 		std::ifstream inputFile(inputFileName);
@@ -94,4 +244,58 @@ namespace sibr {
 
 		outputFile.close();
 	}
-}
\ No newline at end of file
+
+	std::vector<std::vector<CropScaleImageUtility::Image>> CropScaleImageUtility::processBatch(const std::vector<Task> & tasks, const BatchSettings & settings)
+	{
+		std::vector<std::vector<Image>> infos(tasks.size());
+		for (size_t tid = 0; tid < tasks.size(); ++tid) {
+			infos[tid].resize(tasks[tid].outputs.size(), makeInfos("", sibr::Vector2i(0, 0)));
+		}
+
+		// A fixed thread count gets its own pool, otherwise the shared one is used.
+		std::unique_ptr<ThreadPool> ownPool(settings.threads > 0 ? new ThreadPool(settings.threads) : nullptr);
+		ThreadPool & pool = ownPool ? *ownPool : ThreadPool::shared();
+		const size_t maxQueued = std::max(settings.maxQueued, 1u);
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		size_t inFlight = 0;
+
+		// Reads stay on the calling thread, sequential accesses are the friendliest to the disk.
+		size_t skipped = 0;
+		for (size_t tid = 0; tid < tasks.size(); ++tid) {
+			if (settings.skipUpToDate && isUpToDate(tasks[tid], settings, infos[tid])) {
+				++skipped;
+				continue;
+			}
+			PendingImage job;
+			job.task = tid;
+			if (!readFile(tasks[tid].input, job.bytes)) {
+				SIBR_WRG << "[CropScaleImageUtility] Unable to read " << tasks[tid].input << std::endl;
+				continue;
+			}
+			{
+				// Bound the read images held in memory.
+				std::unique_lock<std::mutex> lock(mutex);
+				finished.wait(lock, [&]() { return inFlight < maxQueued; });
+				++inFlight;
+			}
+			const auto pending = std::make_shared<PendingImage>(std::move(job));
+			pool.push([&, pending]() {
+				processImage(tasks[pending->task], pending->bytes, settings, infos[pending->task]);
+				std::lock_guard<std::mutex> lock(mutex);
+				--inFlight;
+				finished.notify_all();
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]() { return inFlight == 0; });
+		lock.unlock();
+
+		if (skipped > 0) {
+			SIBR_LOG << "[CropScaleImageUtility] " << skipped << " up to date images skipped." << std::endl;
+		}
+		return infos;
+	}
+}
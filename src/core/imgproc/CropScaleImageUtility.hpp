@@ -38,6 +38,40 @@ namespace sibr {
 			unsigned	height; ///< Image height.
 		};
 
+		/** Batch processing output. */
+		struct Output {
+			std::string		path; ///< Destination path, its extension gives the format.
+			sibr::Vector2i	resolution = sibr::Vector2i(0, 0); ///< Rescaled size, (0,0) keeps the cropped size.
+		};
+
+		/** Batch processing job: a centered crop of an image, written at one or more resolutions. */
+		struct Task {
+			std::string			input; ///< Source image path.
+			sibr::Vector2i		cropResolution = sibr::Vector2i(0, 0); ///< Centered crop size, (0,0) keeps the full image.
+			std::vector<Output>	outputs; ///< Images to write, all generated from the same crop.
+		};
+
+		/** Batch processing options. */
+		struct BatchSettings {
+			std::string	format; ///< Output extension override (".jpg", ".png"...), empty to keep the outputs ones.
+			int			quality = 95; ///< JPEG and WebP quality, in [0,100].
+			int			pngCompression = 3; ///< PNG compression level, in [0,9].
+			int			interpolation = cv::INTER_LINEAR; ///< OpenCV rescaling filter.
+			bool		skipUpToDate = true; ///< Skip tasks whose outputs are newer than their input and have the expected size.
+			unsigned	threads = 0; ///< Number of decoding/encoding workers, 0 to use all cores.
+			unsigned	maxQueued = 16; ///< Maximum number of read images waiting for a worker.
+		};
+
+		/**
+		 * Crop and rescale a set of images. The calling thread reads the files into a bounded queue
+		 * while a pool of workers decodes, crops, rescales and encodes them.
+		 * Outputs without crop nor rescale and in the input format are copied without being decoded.
+		 * \param tasks the images to process
+		 * \param settings the batch options
+		 * \return for each task, the infos of each output (empty size if the input couldn't be processed)
+		 */
+		std::vector<std::vector<Image>> processBatch(const std::vector<Task> & tasks, const BatchSettings & settings = BatchSettings());
+
 		/** Load a list_images.txt file and extract the image paths.
 		 * \param inputFileName path to the listing
 		 * \return a list of image paths
@@ -12,6 +12,8 @@
 
 #include "DistordCropUtility.hpp"
 
+#include <omp.h>
+
 namespace sibr {
 	
 
@@ -121,43 +123,33 @@ namespace sibr {
 	}
 
 
+	sibr::Vector2i DistordCropUtility::readResolution(const Path & imagePath)
+	{
+		const sibr::Vector2i resolution = sibr::IImage::imageResolution(imagePath.string());
+		if (resolution.x() > 0 && resolution.y() > 0) {
+			return resolution;
+		}
+		// Unsupported header (progressive jpeg for instance), decode the image.
+		sibr::ImageRGB img;
+		img.load(imagePath.string(), false);
+		return img.size().cast<int>();
+	}
+
 	sibr::Vector2i DistordCropUtility::calculateAvgResolution(const std::vector<Path>& imagePaths, std::vector<sibr::Vector2i> & resolutions, const int batch_size)
 	{
-		const int nrBatches = static_cast<int>(ceil((float)(imagePaths.size()) / batch_size));
 		resolutions.resize(imagePaths.size());
-		std::vector<std::pair<std::pair<long, long>, unsigned>> sumAndNrItems(nrBatches);
-
-		for (int batchId = 0; batchId < nrBatches; batchId++) {
-
-			const int nrItems = (batchId != nrBatches - 1) ? batch_size : ((nrBatches * batch_size != int(imagePaths.size())) ? (int(imagePaths.size()) - (batch_size * batchId)) : batch_size);
-			long sumOfWidths = 0;
-			long sumOfHeights = 0;
-
-			std::vector<sibr::ImageRGB> chunkOfInputImages(nrItems);
-
-#pragma omp parallel for
-			for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-				unsigned globalImgIndex = (batchId * batch_size) + localImgIndex;
-				chunkOfInputImages.at(localImgIndex).load(imagePaths.at(globalImgIndex).string(), false);
+		const int chunk = std::max(1, batch_size);
 
-#pragma omp critical
-				{
-					sumOfWidths += long(chunkOfInputImages[localImgIndex].w());
-					sumOfHeights += long(chunkOfInputImages[localImgIndex].h());
-					resolutions[localImgIndex].x() = chunkOfInputImages[localImgIndex].w();
-					resolutions[localImgIndex].y() = chunkOfInputImages[localImgIndex].h();
-				}
-			}
-			std::pair<long, long> sums(sumOfWidths, sumOfHeights);
-			std::pair<std::pair<long, long>, unsigned> batch(sums, nrItems);
-			sumAndNrItems[batchId] = batch;
+#pragma omp parallel for schedule(dynamic, chunk)
+		for (int imgId = 0; imgId < int(imagePaths.size()); imgId++) {
+			resolutions[imgId] = readResolution(imagePaths[imgId]);
 		}
 
 		long sumOfWidth = 0;
 		long sumOfHeight = 0;
-		for (unsigned i = 0; i < sumAndNrItems.size(); i++) {
-			sumOfWidth += sumAndNrItems[i].first.first;
-			sumOfHeight += sumAndNrItems[i].first.second;
+		for (const sibr::Vector2i & res : resolutions) {
+			sumOfWidth += long(res.x());
+			sumOfHeight += long(res.y());
 		}
 
 		const long globalAvgWidth = sumOfWidth / long(imagePaths.size());
@@ -190,11 +182,13 @@ namespace sibr {
 
 		// discard images with different resolution
 		std::vector<uint> preExcludedCams;
+		std::vector<bool> isPreExcluded(imagePaths.size(), false);
 		for (unsigned i = 0; i < resolutions.size(); i++) {
 			bool shrinkHorizontally = ((resolutions[i].x() < avgWidth) && ((avgWidth - resolutions[i].x()) > avgWidth * resolutionThreshold)) ? true : false;
 			bool shrinkVertically = ((resolutions[i].y() < avgHeight) && ((avgHeight - resolutions[i].y()) > avgHeight * resolutionThreshold)) ? true : false;
 			if (shrinkHorizontally || shrinkVertically) {
 				preExcludedCams.push_back(i);
+				isPreExcluded[i] = true;
 				std::cout << "[distordCrop] excluding input image " << i << " resolution=" << resolutions[i].x() << "x" << resolutions[i].y() << "\n";
 			}
 		}
@@ -204,27 +198,18 @@ namespace sibr {
 		// compute bounding boxes for all non-discarded images
 		std::vector<Bounds> allBounds(imagePaths.size());
 
-		const int nrBatches = static_cast<int>(ceil((float)(imagePaths.size()) / batch_size));
-
-		// processs batches sequentially (we don't want to run out of memory)
-		for (int batchId = 0; batchId < nrBatches; batchId++) {
-
-			const int nrItems = (batchId != nrBatches - 1) ? batch_size : ((nrBatches * batch_size != int(imagePaths.size())) ? (int(imagePaths.size()) - (batch_size * batchId)) : batch_size);
-
-			std::vector<sibr::ImageRGB> chunkOfInputImages(nrItems);
-
-			// load images in parallel (OpenMP 2.0 doesn't allow unsigned int as index. must be signed integral type)
-#pragma omp parallel for
-			for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-				const uint globalImgIndex = uint((batchId * batch_size) + localImgIndex);
-				// if cam was discarded, do nothing
-				if (std::find(preExcludedCams.begin(), preExcludedCams.end(), globalImgIndex) == preExcludedCams.end()) {
-					// only now load the img
-					chunkOfInputImages.at(localImgIndex).load(imagePaths.at(globalImgIndex).string(), false);
-					allBounds.at(globalImgIndex) = getBounds(chunkOfInputImages.at(localImgIndex), backgroundColor, threshold_black_color, thinest_bounding_box_size, toleranceFactor);
-
-				}
+		// stream the images: each thread decodes one image, keeps its bounds and releases it before the next one,
+		// so memory only depends on the number of threads (OpenMP 2.0 doesn't allow unsigned int as index. must be signed integral type)
+		const int chunk = std::max(1, batch_size / std::max(1, omp_get_max_threads()));
+#pragma omp parallel for schedule(dynamic, chunk)
+		for (int imgId = 0; imgId < int(imagePaths.size()); imgId++) {
+			// if cam was discarded, do nothing
+			if (isPreExcluded[imgId]) {
+				continue;
 			}
+			sibr::ImageRGB img;
+			img.load(imagePaths[imgId].string(), false);
+			allBounds[imgId] = getBounds(img, backgroundColor, threshold_black_color, thinest_bounding_box_size, toleranceFactor);
 		}
 
 		Bounds finalBounds(resolutions.at(0));
@@ -239,7 +224,7 @@ namespace sibr {
 		int minHeight = -1;
 
 		for (auto & bounds : allBounds) {
-			bool wasPreExcluded = std::find(preExcludedCams.begin(), preExcludedCams.end(), im_id) != preExcludedCams.end();
+			const bool wasPreExcluded = isPreExcluded[im_id];
 
 			if (!wasPreExcluded && bounds.xRatio > threshold_ratio_bounding_box_size && bounds.yRatio > threshold_ratio_bounding_box_size) {
 				// get global x and y ratios
@@ -275,15 +260,13 @@ namespace sibr {
 
 	sibr::Vector2i DistordCropUtility::findMinImageSize(const Path & root, const std::vector<Path>& imagePaths)
 	{
-		std::vector<sibr::ImageRGB> inputImgs(imagePaths.size());
 		std::vector<sibr::Vector2i> imSizes(imagePaths.size());
 
-		std::cout << "[distordCrop] loading input images : " << std::flush;
+		std::cout << "[distordCrop] reading input image sizes : " << std::flush;
 
-#pragma omp parallel for
-		for (int id = 0; id < (int)inputImgs.size(); ++id) {
-			inputImgs.at(id).load(imagePaths.at(id).string(), false);
-			imSizes[id] = inputImgs[id].size().cast<int>();
+#pragma omp parallel for schedule(dynamic)
+		for (int id = 0; id < (int)imSizes.size(); ++id) {
+			imSizes[id] = readResolution(imagePaths[id]);
 		}
 
 		sibr::Vector2i minSize = imSizes[0];
@@ -128,10 +128,17 @@ namespace sibr {
 		Bounds getBounds(const sibr::ImageRGB & img, Vector3i backgroundColor, int threshold_black_color, int thinest_bounding_box_size, float toleranceFactor);
 
 		/**
-		 * Estimate the average resolution of a set of images quickly using multithread to speed up the required loading.
+		 * Get the resolution of an image file, from its header when the format allows it.
+		 * \param imagePath path to the image
+		 * \return the image resolution
+		 */
+		sibr::Vector2i readResolution(const Path & imagePath);
+
+		/**
+		 * Estimate the average resolution of a set of images quickly, only reading the image headers when possible.
 		 * \param imagePaths list of paths to the images
 		 * \param resolutions will contain each image resolution
-		 * \param batch_size number of images loaded per thread internally
+		 * \param batch_size number of images handed to a thread at once
 		 * \return the average resolution
 		 */
 		sibr::Vector2i calculateAvgResolution(const std::vector< Path > & imagePaths, std::vector<sibr::Vector2i> & resolutions, const int batch_size = 150);
@@ -143,7 +150,7 @@ namespace sibr {
 		 * \param resolutions will contain the image resolutions
 		 * \param avgWidth average image width, if 0 will be recomputed (slow for large datasets)
 		 * \param avgHeight average image height, if 0 will be recomputed (slow for large datasets)
-		 * \param batch_size batch size for multithreaded image loading
+		 * \param batch_size number of images handed to a thread at once, each thread only keeps one decoded image in memory
 		 * \param resolutionThreshold ratio of the minimum allowed dimensions over the average image dimensions
 		 * \param threshold_ratio_bounding_box_size maximum change in aspect ratio
 		 * \param backgroundColor the reference background color
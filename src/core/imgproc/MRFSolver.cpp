@@ -11,6 +11,7 @@
 
 
 #include "MRFSolver.h"
+#include <algorithm>
 
 
 namespace sibr {
@@ -77,7 +78,6 @@ namespace sibr {
 		SIBR_LOG << "[MRFSolver] Running mincut... " << std::endl;
 
 		double infty = (double)1e20;
-		double min_unary, temp_unary;
 		int num_nodes = (int)_neighborMap->size();
 		SIBR_LOG << "[MRFSolver] Number of nodes = " << num_nodes;
 		_labels.resize(num_nodes);
@@ -89,14 +89,13 @@ namespace sibr {
 		SIBR_LOG << ", number of links = " << numLinks / 2 << std::endl;
 		
 		SIBR_LOG << "[MRFSolver] Initialization : minimizing unaries..." << std::flush;
+#pragma omp parallel for
 		for (int p = 0; p < num_nodes; p++) {
 
-			int label_id;
-			min_unary = infty;
-			int num_cand = 0;
+			int label_id = 0;
+			double min_unary = infty;
 			for (int lp_id = 0; lp_id < (int)_labList.size(); lp_id++) {
-				temp_unary = unaryTotal(p, lp_id);
-				if (temp_unary < (1 << 10)) { ++num_cand; }
+				const double temp_unary = unaryTotal(p, lp_id);
 				if (temp_unary < min_unary) {
 					min_unary = temp_unary;
 					label_id = lp_id;
@@ -108,18 +107,22 @@ namespace sibr {
 
 		SIBR_LOG << "[MRFSolver] Energies: U: " << computeEnergyU() << ", W: " << computeEnergyW() << std::endl;
 
+		buildGraphTopology();
+
 		// Alpha-expansion algorithm
 		SIBR_LOG << "[MRFSolver] Alpha-expansion [label,flow]..." << std::endl;
+		double totalFlow = 0.0;
 		for (int it = 0; it < _numIterations; it++) {
 			SIBR_LOG << "[MRFSolver] Iteration " << (it+1)  << "/" << (_numIterations) << ": " << std::endl;
 			
 			for (int label_id = 0; label_id < (int)_labList.size(); label_id++) {
 				int label = _labList.at(label_id);
 				
-				buildGraphAlphaExp(label_id);
-				// Solve mincut
-				_energy = _graph->maxflow();
-
+				const double offset = buildGraphAlphaExp(label_id);
+				// Solve mincut, the graph accumulates the flow of all previous cuts.
+				const double flow = _graph->maxflow();
+				_energy = offset + (flow - totalFlow);
+				totalFlow = flow;
 
 				int num_change = 0;
 				//assign new labels
@@ -130,68 +133,110 @@ namespace sibr {
 					}
 				}
 				SIBR_LOG << "[MRFSolver]\t\tLabel " << label << ": modifications = " <<  num_change << ", energy = " << _energy << " ]" << std::endl;
-
-				delete _graph;
 			}
 		}
 		SIBR_LOG << "[MRFSolver] Done." << std::endl;
 	}
 
-	void MRFSolver::buildGraphAlphaExp(int label_iteration_id)
+	void MRFSolver::buildGraphTopology(void)
 	{
-		double infty = 1 << 25;
+		if (_graph) {
+			return;
+		}
 		int num_nodes = (int)_neighborMap->size();
-		int n_nodes_estimation = num_nodes;
-		int n_edges_estimation = num_nodes * 4;
-
-		_graph = new GraphType(n_nodes_estimation, n_edges_estimation);
 
-		//add nodes associated to pixels
-		int node_id = 0;
+		// Flat edge list, each pair of neighbors is kept once.
+		_edgeNodes.clear();
 		for (int p = 0; p < num_nodes; p++) {
-			_graph->add_node();
-
-			if (_labels[p] == label_iteration_id) {
-				_graph->add_tweights(node_id, unaryTotal(p, label_iteration_id), infty);
-			} else {
-				_graph->add_tweights(node_id, unaryTotal(p, label_iteration_id), unaryTotal(p, _labels[p]));
+			const std::vector<int> & neighors = (*_neighborMap)[p];
+			for (int q : neighors) {
+				if (p == q) { std::cerr << "!"; continue; }
+				if (q < p) { continue; }
+				_edgeNodes.push_back(p);
+				_edgeNodes.push_back(q);
 			}
-			++node_id;
 		}
-		
-		//add nodes associated to connexions between pixels
-		for (int p = 0; p < num_nodes; p++) {
-
-			std::vector<int> & neighors = (*_neighborMap)[p];
-			for (int q_id = 0; q_id < (int)neighors.size(); q_id++) {
+		const int num_edges = int(_edgeNodes.size() / 2);
 
-				int q = neighors[q_id];
-
-				if (p == q) { std::cerr << "!"; }
-				if (q < p) { continue; }
+		_graph = new GraphType(num_nodes, num_edges);
+		_graph->add_node(num_nodes);
+		for (int e = 0; e < num_edges; e++) {
+			_graph->add_edge(_edgeNodes[2 * e], _edgeNodes[2 * e + 1], 0, 0);
+		}
+		_nodeCaps.resize(num_nodes);
+		_edgeCaps.resize(2 * num_edges);
+		_edgeTerms.resize(2 * num_edges);
+	}
 
-				if (_labels[p] != _labels[q]) {
-					//extra node associated to edge {p,q}
-					_graph->add_node();
+	double MRFSolver::buildGraphAlphaExp(int label_iteration_id)
+	{
+		double infty = 1 << 25;
+		const int num_nodes = (int)_neighborMap->size();
+		const int num_edges = int(_edgeNodes.size() / 2);
+		const int alpha = label_iteration_id;
+
+		// Each node pays its current unary when staying in the source set, and the expanded one in the sink set.
+		// Nodes already labeled alpha have to stay in the sink set.
+		double offset = 0.0;
+#pragma omp parallel for reduction(+:offset)
+		for (int p = 0; p < num_nodes; p++) {
+			const double costAlpha = unaryTotal(p, alpha);
+			const double costKeep = _labels[p] == alpha ? infty : unaryTotal(p, _labels[p]);
+			_nodeCaps[p] = costAlpha - costKeep;
+			offset += costKeep;
+		}
 
-					_graph->add_tweights(node_id, 0, pairwiseTotal(q, p, _labels[q], _labels[p]));
+		// Pairwise terms on a fixed topology (Kolmogorov & Zabih construction): with A, B, C, D the costs
+		// for (keep, keep), (keep, alpha), (alpha, keep), (alpha, alpha), the energy is
+		// A + (C - A) x_p + (D - C) x_q + (B + C - A - D) (1 - x_p) x_q.
+		// B + C - A - D is non negative for metric costs, otherwise it is truncated.
+#pragma omp parallel for reduction(+:offset)
+		for (int e = 0; e < num_edges; e++) {
+			const int p = _edgeNodes[2 * e];
+			const int q = _edgeNodes[2 * e + 1];
+			const double A = pairwiseTotal(q, p, _labels[q], _labels[p]);
+			const double B = pairwiseTotal(q, p, alpha, _labels[p]);
+			const double C = pairwiseTotal(q, p, _labels[q], alpha);
+			const double D = pairwiseTotal(q, p, alpha, alpha);
+			_edgeTerms[2 * e] = C - A;
+			_edgeTerms[2 * e + 1] = D - C;
+			_edgeCaps[2 * e] = std::max(B + C - A - D, 0.0);
+			_edgeCaps[2 * e + 1] = 0.0;
+			offset += A;
+		}
 
-					double pairwise_q_a = pairwiseTotal(q, p, _labels[q], label_iteration_id);
-					_graph->add_edge(q, node_id, pairwise_q_a, pairwise_q_a);
+		// Gather the edge induced terms, cheap enough to stay serial.
+		for (int e = 0; e < num_edges; e++) {
+			_nodeCaps[_edgeNodes[2 * e]] += _edgeTerms[2 * e];
+			_nodeCaps[_edgeNodes[2 * e + 1]] += _edgeTerms[2 * e + 1];
+		}
+		// A negative terminal capacity t links the node to the sink, the cut then misses t.
+		double sinkTerms = 0.0;
+#pragma omp parallel for reduction(+:sinkTerms)
+		for (int p = 0; p < num_nodes; p++) {
+			sinkTerms += std::min(_nodeCaps[p], 0.0);
+		}
+		offset += sinkTerms;
 
-					double pairwise_p_a = pairwiseTotal(q, p, label_iteration_id, _labels[p]);
-					_graph->add_edge(p, node_id, pairwise_p_a, pairwise_p_a);
+		uploadCapacities();
+		return offset;
+	}
 
-					++node_id;
-				}
-				else
-				{
-					double pairwise_p_q = pairwiseTotal(q, p, _labels[q], label_iteration_id);
-					_graph->add_edge(q, p, pairwise_p_q, pairwise_p_q);
-				}
-			}
+	void MRFSolver::uploadCapacities(void)
+	{
+		const int num_nodes = int(_nodeCaps.size());
+		const int num_edges = int(_edgeCaps.size() / 2);
+		// Setting the residual capacities resets the previous cut.
+		GraphType::arc_id arcs = _graph->get_first_arc();
+#pragma omp parallel for
+		for (int p = 0; p < num_nodes; p++) {
+			_graph->set_trcap(p, _nodeCaps[p]);
+		}
+#pragma omp parallel for
+		for (int e = 0; e < num_edges; e++) {
+			_graph->set_rcap(arcs + 2 * e, _edgeCaps[2 * e]);
+			_graph->set_rcap(arcs + 2 * e + 1, _edgeCaps[2 * e + 1]);
 		}
-
 	}
 
 	void MRFSolver::solveBinaryLabels(void)
@@ -204,6 +249,7 @@ namespace sibr {
 			SIBR_WRG << "[MRFSolver] solveBinaryLabels, found " << numLabels << " labels, only the first two will be used." << std::endl;
 		}
 
+		buildGraphTopology();
 		buildGraphBinaryLabels();
 
 		_graph->maxflow();
@@ -222,36 +268,26 @@ namespace sibr {
 				_labels[p] = 1;
 			}
 		}
-
-		delete _graph;
 	}
 
 	void MRFSolver::buildGraphBinaryLabels(void)
 	{
-		int num_nodes = (int)_neighborMap->size();
-		int n_nodes_estimation = num_nodes;
-		int n_edges_estimation = num_nodes * 4;
-
-		_graph = new GraphType(n_nodes_estimation, n_edges_estimation);
+		const int num_nodes = (int)_neighborMap->size();
+		const int num_edges = int(_edgeNodes.size() / 2);
 
+#pragma omp parallel for
 		for (int p = 0; p < num_nodes; p++) {
-			_graph->add_node();
-			_graph->add_tweights(p, unaryTotal(p, 0), unaryTotal(p, 1));
+			_nodeCaps[p] = unaryTotal(p, 0) - unaryTotal(p, 1);
 		}
 
-		for (int p = 0; p < num_nodes; p++) {
-			std::vector<int> & neighors = (*_neighborMap)[p];
-			for (int q_id = 0; q_id < (int)neighors.size(); q_id++) {
-
-				int q = neighors[q_id];
-
-				if (q < p) { continue; }
-
-				double weight = pairwiseTotal(q, p, 0, 1);
-
-				_graph->add_edge(q, p, weight, weight);
-			}
+#pragma omp parallel for
+		for (int e = 0; e < num_edges; e++) {
+			const double weight = pairwiseTotal(_edgeNodes[2 * e + 1], _edgeNodes[2 * e], 0, 1);
+			_edgeCaps[2 * e] = weight;
+			_edgeCaps[2 * e + 1] = weight;
 		}
+
+		uploadCapacities();
 	}
 
 	double MRFSolver::unaryTotal(int p, int lp_id)
@@ -333,6 +369,7 @@ namespace sibr {
 
 	MRFSolver::~MRFSolver(void)
 	{
+		delete _graph;
 	}
 
 }
\ No newline at end of file
@@ -49,6 +49,7 @@ namespace sibr {
 		 *\param pairwiseLabelsOnly optional pairwise cost that only depends on the labels: f(lab0, lab1), else provide nullptr
 		 *\param pairwiseFull pairwise (per pair of nodes) cost function evaluator, receiving the nodes linear indices and their labels: f(ind0, ind1, lab0, lab1)
 		 *\note the "*LabelsOnly" functions are optional and are precomputed and cached for optimized resolution.
+		 *\note the cost functions are evaluated concurrently from several threads.
 		 */
 		MRFSolver(std::vector<int> labels, std::vector<std::vector<int> >* neighborMap, int numIterations,
 			UnaryLabelOnlyFuncPtr unaryLabelOnly,
@@ -84,14 +85,23 @@ namespace sibr {
 
 	private:
 
-		/** Build graph for the general case.
-		 *\param label_iteration_id
+		/** Allocate the graph and the flat edge list once, the topology is then shared by all cuts:
+		 * one node per variable and one edge per pair of neighbors.
 		 **/
-		void buildGraphAlphaExp(int label_iteration_id);
+		void buildGraphTopology(void);
 
-		/** Build graph for the binary labeling case. */
+		/** Update the graph capacities for the expansion of a label.
+		 *\param label_iteration_id the label to expand
+		 *\return the energy offset not represented by the cut
+		 **/
+		double buildGraphAlphaExp(int label_iteration_id);
+
+		/** Update the graph capacities for the binary labeling case. */
 		void buildGraphBinaryLabels(void);
 
+		/** Write the node and edge capacities to the graph. */
+		void uploadCapacities(void);
+
 		/** Compute the unary cost of a node.
 		 *\param p the node linear index
 		 *\param lp_id the node label to consider
@@ -120,7 +130,11 @@ namespace sibr {
 
 		typedef Graph<double, double, double> GraphType;
 		double _energy; ///< Total energy.
-		GraphType* _graph; ///< Graph.
+		GraphType* _graph = nullptr; ///< Graph, allocated once and reused by all cuts.
+		std::vector<int> _edgeNodes; ///< Flat list of undirected edges, two node indices per edge.
+		std::vector<double> _nodeCaps; ///< Terminal capacity of each node (source minus sink).
+		std::vector<double> _edgeCaps; ///< Capacity of each edge, forward and backward.
+		std::vector<double> _edgeTerms; ///< Unary terms induced by each edge on its two nodes.
 		bool ignoreIsolatedNode; ///< Ignore nodes with no connections.
 	};
 
@@ -12,10 +12,265 @@
 
 #include "MeshTexturing.hpp"
 #include "PoissonReconstruction.hpp"
+#include <core/raycaster/VisibilityQuery.hpp>
 #include <core/system/LoadingProgress.hpp>
+#include <core/graphics/RenderTarget.hpp>
+#include <core/graphics/Shader.hpp>
+#include <cstring>
 
 namespace sibr {
 
+	namespace {
+
+		/// Side of the texture tiles processed at once on the GPU.
+		const int kTileSize = 2048;
+		/// Relative tolerance of the GPU depth test.
+		const float kRelativeEpsilon = 0.01f;
+
+		/// Rasterize the mesh in UV space, outputting world space positions and normals.
+		const char * kSurfaceVertexSource = R"(#version 420
+			layout(location = 0) in vec3 in_vertex;
+			layout(location = 2) in vec2 in_uv;
+			layout(location = 3) in vec3 in_normal;
+			// UV to tile NDC scale (xy) and offset (zw).
+			uniform vec4 uvToTile;
+			out vec3 position;
+			out vec3 normal;
+			void main() {
+				position = in_vertex;
+				normal = in_normal;
+				gl_Position = vec4(in_uv * uvToTile.xy + uvToTile.zw, 0.0, 1.0);
+			}
+		)";
+
+		const char * kSurfaceFragmentSource = R"(#version 420
+			in vec3 position;
+			in vec3 normal;
+			layout(location = 0) out vec4 out_position;
+			layout(location = 1) out vec4 out_normal;
+			void main() {
+				out_position = vec4(position, 1.0);
+				out_normal = vec4(normal, 0.0);
+			}
+		)";
+
+		/// Blend the camera samples of each texel of a tile, same weighting as MeshTexturing::reproject.
+		const char * kBlendSource = R"(#version 430
+			layout(local_size_x = 8, local_size_y = 8) in;
+
+			struct CameraInfos {
+				mat4 viewProj;
+				mat4 invViewProj;
+				vec4 position;
+			};
+			layout(std430, binding = 0) readonly buffer Cameras { CameraInfos cameras[]; };
+			layout(std430, binding = 1) writeonly buffer Colors { vec4 colors[]; };
+
+			// Surface of the tile, with a one texel border.
+			layout(binding = 0) uniform sampler2D positions;
+			layout(binding = 1) uniform sampler2D normals;
+			layout(binding = 2) uniform sampler2DArray images;
+			layout(binding = 3) uniform sampler2DArray depths;
+
+			layout(location = 0) uniform ivec2 tileSize;
+			layout(location = 1) uniform int camerasCount;
+			layout(location = 2) uniform float sampleRatio;
+			layout(location = 3) uniform float relativeEpsilon;
+			layout(location = 4) uniform int bestCamera;
+
+			const int kBins = 32;
+
+			// Same neighborhood order as MeshTexturing::sampleNeighborhood.
+			bool fetchSurface(ivec2 texel, out vec3 position, out vec3 normal) {
+				const ivec2 offsets[9] = ivec2[9](ivec2(0, 0), ivec2(0, -1), ivec2(0, 1), ivec2(-1, 0), ivec2(-1, -1),
+					ivec2(-1, 1), ivec2(1, 0), ivec2(1, -1), ivec2(1, 1));
+				for (int i = 0; i < 9; ++i) {
+					ivec2 coords = texel + 1 + offsets[i];
+					vec4 p = texelFetch(positions, coords, 0);
+					if (p.w > 0.0) {
+						position = p.xyz;
+						normal = normalize(texelFetch(normals, coords, 0).xyz);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// Weight of the sample of a camera, negative if the camera does not see the point.
+			float cameraWeight(int cid, vec3 position, vec3 normal, out vec2 uv) {
+				uv = vec2(0.0);
+				vec4 clip = cameras[cid].viewProj * vec4(position, 1.0);
+				if (clip.w <= 0.0) {
+					return -1.0;
+				}
+				vec3 ndc = clip.xyz / clip.w;
+				if (any(greaterThan(abs(ndc), vec3(1.0)))) {
+					return -1.0;
+				}
+				uv = 0.5 * ndc.xy + 0.5;
+				ivec2 size = textureSize(depths, 0).xy;
+				float depth = texelFetch(depths, ivec3(min(ivec2(uv * vec2(size)), size - 1), cid), 0).r;
+				// Compare distances to the camera, for a relative tolerance.
+				vec4 surface = cameras[cid].invViewProj * vec4(ndc.xy, 2.0 * depth - 1.0, 1.0);
+				vec3 eye = cameras[cid].position.xyz;
+				if (distance(position, eye) > (1.0 + relativeEpsilon) * distance(surface.xyz / surface.w, eye)) {
+					return -1.0;
+				}
+				return max(dot(normalize(eye - position), normal), 0.0);
+			}
+
+			void main() {
+				ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(texel, tileSize))) {
+					return;
+				}
+				int id = texel.y * tileSize.x + texel.x;
+				vec3 position, normal;
+				if (!fetchSurface(texel, position, normal)) {
+					colors[id] = vec4(0.0);
+					return;
+				}
+				vec2 uv;
+				// Only keep the camera with the largest weight, its index is output with the color.
+				if (bestCamera != 0) {
+					int best = -1;
+					float bestWeight = -1.0;
+					vec2 bestUV = vec2(0.0);
+					for (int cid = 0; cid < camerasCount; ++cid) {
+						float weight = cameraWeight(cid, position, normal, uv);
+						if (weight > bestWeight) {
+							best = cid;
+							bestWeight = weight;
+							bestUV = uv;
+						}
+					}
+					colors[id] = best >= 0 ? vec4(255.0 * texture(images, vec3(bestUV, float(best))).rgb, float(best + 1)) : vec4(0.0);
+					return;
+				}
+				// Keep the best samples using an histogram of the weights.
+				float minWeight = 0.0;
+				if (sampleRatio < 1.0) {
+					uint bins[kBins];
+					for (int b = 0; b < kBins; ++b) {
+						bins[b] = 0u;
+					}
+					uint visible = 0u;
+					for (int cid = 0; cid < camerasCount; ++cid) {
+						float weight = cameraWeight(cid, position, normal, uv);
+						if (weight >= 0.0) {
+							++bins[min(int(weight * float(kBins)), kBins - 1)];
+							++visible;
+						}
+					}
+					uint kept = uint(ceil(sampleRatio * float(visible)));
+					uint count = 0u;
+					int bin = kBins - 1;
+					for (; bin > 0; --bin) {
+						count += bins[bin];
+						if (count >= kept) {
+							break;
+						}
+					}
+					minWeight = float(bin) / float(kBins);
+				}
+				vec3 color = vec3(0.0);
+				float totalWeight = 0.0;
+				for (int cid = 0; cid < camerasCount; ++cid) {
+					float weight = cameraWeight(cid, position, normal, uv);
+					if (weight < minWeight) {
+						continue;
+					}
+					weight *= weight;
+					totalWeight += weight;
+					color += weight * texture(images, vec3(uv, float(cid))).rgb;
+				}
+				colors[id] = totalWeight > 0.0 ? vec4(255.0 * color / totalWeight, 1.0) : vec4(0.0);
+			}
+		)";
+
+		/// Border of the tiles leveled at once, shared with the neighbor tiles.
+		const int kSeamBorder = 64;
+
+		/// One Jacobi iteration of the seam leveling correction.
+		const char * kLevelSource = R"(#version 430
+			layout(local_size_x = 8, local_size_y = 8) in;
+
+			// Color and camera label plus one, zero if the texel is not covered.
+			layout(std430, binding = 0) readonly buffer Colors { vec4 colors[]; };
+			layout(std430, binding = 1) readonly buffer Previous { vec4 previous[]; };
+			layout(std430, binding = 2) writeonly buffer Next { vec4 next[]; };
+
+			layout(location = 0) uniform ivec2 size;
+			// Pull toward no correction, so that the solution is unique.
+			layout(location = 1) uniform float anchor;
+
+			void main() {
+				ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(texel, size))) {
+					return;
+				}
+				int id = texel.y * size.x + texel.x;
+				vec4 color = colors[id];
+				if (color.w == 0.0) {
+					next[id] = vec4(0.0);
+					return;
+				}
+				const ivec2 offsets[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+				vec3 sum = vec3(0.0);
+				float count = anchor;
+				for (int i = 0; i < 4; ++i) {
+					ivec2 neighbor = texel + offsets[i];
+					if (any(lessThan(neighbor, ivec2(0))) || any(greaterThanEqual(neighbor, size))) {
+						continue;
+					}
+					int nid = neighbor.y * size.x + neighbor.x;
+					vec4 other = colors[nid];
+					if (other.w == 0.0) {
+						continue;
+					}
+					// Same correction as the neighbor in a region, the corrected colors should match across a seam.
+					vec3 target = previous[nid].rgb;
+					if (other.w != color.w) {
+						target += other.rgb - color.rgb;
+					}
+					sum += target;
+					count += 1.0;
+				}
+				next[id] = vec4(sum / count, 0.0);
+			}
+		)";
+
+		/// Compile a compute program, reporting errors.
+		GLuint compileCompute(const char * source)
+		{
+			GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				SIBR_WRG << "[Texturing] Compilation failed: " << log << std::endl;
+				glDeleteShader(shader);
+				return 0;
+			}
+			GLuint program = glCreateProgram();
+			glAttachShader(program, shader);
+			glLinkProgram(program);
+			glDeleteShader(shader);
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				SIBR_WRG << "[Texturing] Link failed: " << log << std::endl;
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+	}
+
 	MeshTexturing::MeshTexturing(unsigned int sideSize) :
 		_accum(sideSize, sideSize, Vector3f(0.0f, 0.0f, 0.0f)),
 		_mask(sideSize, sideSize, 0)
@@ -55,6 +310,9 @@ namespace sibr {
 		// Our version of Embree being compiled with backface culling, we have to 'duplicate and flip' the mesh.
 		Mesh::Ptr doubleMesh = _mesh->clone();
 		doubleMesh->merge(_mesh->invertedFacesMesh());
+		// Static scenes queried for every texel: spend more time on the build.
+		_worldRaycaster.buildSettings(RTC_BUILD_QUALITY_HIGH, RTC_SCENE_FLAG_NONE);
+		_uvsRaycaster.buildSettings(RTC_BUILD_QUALITY_HIGH, RTC_SCENE_FLAG_NONE);
 		_worldRaycaster.addMesh(*doubleMesh);
 		_uvsRaycaster.addMesh(uvMesh);
 
@@ -94,82 +352,295 @@ namespace sibr {
 		sibr::LoadingProgress			progress(h, "[Texturing] Gathering color samples from cameras" );
 		SIBR_LOG << "[Texturing] Gathering color samples from " << cameras.size() << " cameras ..." << std::endl;
 
+		VisibilityQuery visibility(_worldRaycaster, cameras);
+
+		// Rows are processed by bands: the visibility of all the points of a band is queried at once.
+		const int bandRows = 64;
+		for (int band = 0; band < h; band += bandRows) {
+			const int rows = std::min(bandRows, h - band);
+
+			// Gather the surface points of each row.
+			std::vector<std::vector<sibr::Vector3f>> rowVertices(rows), rowNormals(rows);
+			std::vector<std::vector<int>> rowPixels(rows);
 #pragma omp parallel for
-		for (int py = 0; py < h; ++py) {
-			for (int px = 0; px < w; ++px) {
-				// Check if we fall inside a triangle in the UV map.
-				RayHit hit;
-				const bool hasHit = sampleNeighborhood(px, py, hit);
-
-				// We really have no triangle in the neighborhood to use, skip.
-				if (!hasHit) {
-					continue;
-				}
+			for (int r = 0; r < rows; ++r) {
+				const int py = band + r;
+				for (int px = 0; px < w; ++px) {
+					// Check if we fall inside a triangle in the UV map.
+					RayHit hit;
+					const bool hasHit = sampleNeighborhood(px, py, hit);
+
+					// We really have no triangle in the neighborhood to use, skip.
+					if (!hasHit) {
+						continue;
+					}
 
-				// Need the smooth position and normal in the initial mesh.
-				sibr::Vector3f vertex, normal;
-				interpolate(hit, vertex, normal);
+					// Need the smooth position and normal in the initial mesh.
+					rowVertices[r].emplace_back();
+					rowNormals[r].emplace_back();
+					interpolate(hit, rowVertices[r].back(), rowNormals[r].back());
+					rowPixels[r].push_back(px);
+				}
+			}
 
-				sibr::Vector3f avgColor(0.0f, 0.0f, 0.0f);
-				float totalWeight = 0.0f;
+			// Find the cameras seeing each point.
+			std::vector<size_t> offsets(rows + 1, 0);
+			std::vector<sibr::Vector3f> vertices;
+			for (int r = 0; r < rows; ++r) {
+				offsets[r + 1] = offsets[r] + rowPixels[r].size();
+				vertices.insert(vertices.end(), rowVertices[r].begin(), rowVertices[r].end());
+			}
+			const VisibilitySet visible = visibility.query(vertices);
 
+#pragma omp parallel for
+			for (int r = 0; r < rows; ++r) {
+				const int py = band + r;
 				std::vector<SampleInfos> samples;
-
-				for (int cid = 0; cid < cameras.size(); ++cid) {
-					const auto & cam = cameras[cid];
-					if (!cam->frustumTest(vertex)) {
+				for (size_t pid = 0; pid < rowPixels[r].size(); ++pid) {
+					const int px = rowPixels[r][pid];
+					const sibr::Vector3f & vertex = rowVertices[r][pid];
+					const sibr::Vector3f & normal = rowNormals[r][pid];
+					samples.clear();
+					for (const uint cid : visible.cameras(offsets[r] + pid)) {
+						const auto & cam = cameras[cid];
+						const sibr::Vector3f occDir = (vertex - cam->position()).normalized();
+
+						// Reproject, read color.
+						const sibr::Vector2f pos = cam->projectImgSpaceInvertY(vertex).xy();
+						const sibr::Vector3f col = images[cid]->bilinear(pos).cast<float>().xyz();
+						// Angle-based weight for now.
+						const float angleWeight = std::max(-occDir.dot(normal), 0.0f);
+						const float weight = angleWeight;
+						samples.emplace_back();
+						samples.back().color = col;
+						samples.back().weight = weight;
+					}
+					if (samples.empty()) {
 						continue;
 					}
 
-					// Check for occlusions.
-					sibr::Vector3f occDir = (vertex - cam->position());
-					const float dist = occDir.norm();
-					if (dist > 0.0f) {
-						occDir /= dist;
+					std::sort(samples.begin(), samples.end(), [](const SampleInfos & a, const SampleInfos & b)
+					{
+						return a.weight > b.weight;
+					});
+
+					// Re-weight and accumulate the samples.
+					// The code is written this way to support 'best sampleRatio of all samples' approaches.
+					sibr::Vector3f avgColor(0.0f, 0.0f, 0.0f);
+					float totalWeight = 0.0f;
+					for(int i = 0; i < sampleRatio * samples.size(); ++i) {
+						float w = samples[i].weight;
+						w = w * w;
+						totalWeight += w;
+						avgColor += w * samples[i].color;
 					}
-					const RayHit hitOcc = _worldRaycaster.intersect(Ray(cam->position(), occDir));
-					if (hitOcc.hitSomething() && (hitOcc.dist() + 0.0001f) < dist) {
-						continue;
+
+					if (totalWeight > 0.0f) {
+						_accum(px, py) = avgColor / totalWeight;
+						_mask(px, py)[0] = 255;
 					}
+				}
+			}
+			progress.walk(rows);
+		}
+	}
 
-					// Reproject, read color.
-					const sibr::Vector2f pos = cam->projectImgSpaceInvertY(vertex).xy();
-					const sibr::Vector3f col = images[cid]->bilinear(pos).cast<float>().xyz();
-					// Angle-based weight for now.
-					const float angleWeight = std::max(-occDir.dot(normal), 0.0f);
-					const float weight = angleWeight;
-					//avgColor += weight * col;
-					//totalWeight += weight;
-					samples.emplace_back();
-					samples.back().color = col;
-					samples.back().weight = weight;
+	void MeshTexturing::reprojectGPU(const std::vector<InputCamera::Ptr> & cameras, const ITexture2DArray & images, const ITexture2DArray & depths, const float sampleRatio, bool bestCamera) {
+		// We need a mesh for reprojection.
+		if (!_mesh) {
+			SIBR_WRG << "[Texturing] No mesh available." << std::endl;
+			return;
+		}
+		if (!GLEW_VERSION_4_3) {
+			SIBR_WRG << "[Texturing] GPU reprojection needs OpenGL 4.3." << std::endl;
+			return;
+		}
+		if (images.depth() < cameras.size() || depths.depth() < cameras.size()) {
+			SIBR_WRG << "[Texturing] Expected one image and one depth map per camera." << std::endl;
+			return;
+		}
+		const GLuint program = compileCompute(kBlendSource);
+		if (!program) {
+			return;
+		}
+
+		const int w = _accum.w();
+		const int h = _accum.h();
+		const int tilesX = (w + kTileSize - 1) / kTileSize;
+		const int tilesY = (h + kTileSize - 1) / kTileSize;
+		if (bestCamera) {
+			_labels = sibr::ImageInt1(w, h, 0);
+		}
+
+		sibr::LoadingProgress progress(tilesX * tilesY, "[Texturing] Blending color samples on the GPU");
+		SIBR_LOG << "[Texturing] Blending color samples from " << cameras.size() << " cameras on the GPU..." << std::endl;
+
+		// Matrices and position of each camera (std430 layout).
+		std::vector<float> cameraInfos(36 * cameras.size(), 0.0f);
+		for (size_t cid = 0; cid < cameras.size(); ++cid) {
+			const sibr::Matrix4f viewProj = cameras[cid]->viewproj();
+			const sibr::Matrix4f invViewProj = viewProj.inverse();
+			std::memcpy(&cameraInfos[36 * cid], viewProj.data(), 16 * sizeof(float));
+			std::memcpy(&cameraInfos[36 * cid + 16], invViewProj.data(), 16 * sizeof(float));
+			std::memcpy(&cameraInfos[36 * cid + 32], cameras[cid]->position().data(), 3 * sizeof(float));
+		}
+		std::vector<sibr::Vector4f> colors(size_t(kTileSize) * size_t(kTileSize));
+		GLuint buffers[2];
+		glCreateBuffers(2, buffers);
+		glNamedBufferData(buffers[0], cameraInfos.size() * sizeof(float), cameraInfos.data(), GL_STATIC_DRAW);
+		glNamedBufferData(buffers[1], colors.size() * sizeof(sibr::Vector4f), nullptr, GL_STREAM_READ);
+
+		GLShader surfaceShader;
+		surfaceShader.init("TexturingSurface", kSurfaceVertexSource, kSurfaceFragmentSource);
+		GLParameter uvToTile;
+		uvToTile.init(surfaceShader, "uvToTile");
+		// Positions and normals, with a border for neighborhood lookups.
+		RenderTargetRGBA32F surface(kTileSize + 2, kTileSize + 2, 0, 2);
+
+		for (int ty = 0; ty < tilesY; ++ty) {
+			for (int tx = 0; tx < tilesX; ++tx) {
+				const int x0 = tx * kTileSize;
+				const int y0 = ty * kTileSize;
+				const int tw = std::min(kTileSize, w - x0);
+				const int th = std::min(kTileSize, h - y0);
+
+				// Texel (x0-1, y0-1) is at the corner of the viewport, texel centers match the CPU ray positions.
+				surface.clear(sibr::Vector4f(0.0f, 0.0f, 0.0f, 0.0f));
+				surface.bind();
+				glViewport(0, 0, tw + 2, th + 2);
+				surfaceShader.begin();
+				uvToTile.set(sibr::Vector4f(2.0f * float(w) / float(tw + 2), 2.0f * float(h) / float(th + 2),
+					2.0f * float(1 - x0) / float(tw + 2) - 1.0f, 2.0f * float(1 - y0) / float(th + 2) - 1.0f));
+				_mesh->render(false, false);
+				surfaceShader.end();
+				surface.unbind();
+
+				GLState::useProgram(program);
+				glUniform2i(0, tw, th);
+				glUniform1i(1, int(cameras.size()));
+				glUniform1f(2, sampleRatio);
+				glUniform1f(3, kRelativeEpsilon);
+				glUniform1i(4, bestCamera ? 1 : 0);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1]);
+				glBindTextureUnit(0, surface.handle(0));
+				glBindTextureUnit(1, surface.handle(1));
+				glBindTextureUnit(2, images.handle());
+				glBindTextureUnit(3, depths.handle());
+				glDispatchCompute(GLuint((tw + 7) / 8), GLuint((th + 7) / 8), 1);
+				glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+				GLState::useProgram(0);
+
+				// Reading back waits for the dispatch.
+				glGetNamedBufferSubData(buffers[1], 0, size_t(tw) * size_t(th) * sizeof(sibr::Vector4f), colors.data());
+#pragma omp parallel for
+				for (int y = 0; y < th; ++y) {
+					for (int x = 0; x < tw; ++x) {
+						const sibr::Vector4f & color = colors[size_t(y) * size_t(tw) + size_t(x)];
+						if (color[3] > 0.0f) {
+							_accum(x0 + x, y0 + y) = color.xyz();
+							_mask(x0 + x, y0 + y)[0] = 255;
+							if (bestCamera) {
+								_labels(x0 + x, y0 + y)[0] = int(color[3]);
+							}
+						}
+					}
 				}
-				if (samples.empty()) {
-					continue;
+				progress.walk();
+			}
+		}
+
+		for (int unit = 0; unit < 4; ++unit) {
+			glBindTextureUnit(unit, 0);
+		}
+		glDeleteBuffers(2, buffers);
+		GLState::deleteProgram(program);
+		CHECK_GL_ERROR;
+	}
+
+	void MeshTexturing::levelSeamsGPU(int iterations) {
+		const int w = _accum.w();
+		const int h = _accum.h();
+		if (_labels.w() != uint(w) || _labels.h() != uint(h)) {
+			SIBR_WRG << "[Texturing] No camera labels, run reprojectGPU with bestCamera first." << std::endl;
+			return;
+		}
+		const GLuint program = compileCompute(kLevelSource);
+		if (!program) {
+			return;
+		}
+
+		const int tilesX = (w + kTileSize - 1) / kTileSize;
+		const int tilesY = (h + kTileSize - 1) / kTileSize;
+		sibr::LoadingProgress progress(tilesX * tilesY, "[Texturing] Leveling seams on the GPU");
+		SIBR_LOG << "[Texturing] Leveling seams, " << iterations << " iterations per tile..." << std::endl;
+
+		// The corrections are ping-ponged between two buffers, each tile is solved with its border.
+		const int side = kTileSize + 2 * kSeamBorder;
+		const size_t maxTexels = size_t(side) * size_t(side);
+		std::vector<sibr::Vector4f> texels(maxTexels);
+		GLuint buffers[3];
+		glCreateBuffers(3, buffers);
+		glNamedBufferData(buffers[0], maxTexels * sizeof(sibr::Vector4f), nullptr, GL_STREAM_DRAW);
+		glNamedBufferData(buffers[1], maxTexels * sizeof(sibr::Vector4f), nullptr, GL_DYNAMIC_COPY);
+		glNamedBufferData(buffers[2], maxTexels * sizeof(sibr::Vector4f), nullptr, GL_DYNAMIC_COPY);
+
+		for (int ty = 0; ty < tilesY; ++ty) {
+			for (int tx = 0; tx < tilesX; ++tx) {
+				const int x0 = tx * kTileSize;
+				const int y0 = ty * kTileSize;
+				const int bx0 = std::max(0, x0 - kSeamBorder);
+				const int by0 = std::max(0, y0 - kSeamBorder);
+				const int bw = std::min(w, x0 + kTileSize + kSeamBorder) - bx0;
+				const int bh = std::min(h, y0 + kTileSize + kSeamBorder) - by0;
+				const size_t count = size_t(bw) * size_t(bh);
+
+#pragma omp parallel for
+				for (int y = 0; y < bh; ++y) {
+					for (int x = 0; x < bw; ++x) {
+						const int label = _labels(bx0 + x, by0 + y)[0];
+						const sibr::Vector3f & color = _accum(bx0 + x, by0 + y);
+						texels[size_t(y) * size_t(bw) + size_t(x)] = sibr::Vector4f(color[0], color[1], color[2], float(label));
+					}
 				}
-				
-				std::sort(samples.begin(), samples.end(), [](const SampleInfos & a, const SampleInfos & b)
-				{
-					return a.weight > b.weight;
-				});
-
-				// Re-weight and accumulate the samples.
-				// The code is written this way to support 'best sampleRatio of all samples' approaches.
-				for(int i = 0; i < sampleRatio * samples.size(); ++i) {
-					float w = samples[i].weight;
-					w = w * w;
-					totalWeight += w;
-					avgColor += w * samples[i].color;
+				glNamedBufferSubData(buffers[0], 0, count * sizeof(sibr::Vector4f), texels.data());
+				const float zero = 0.0f;
+				glClearNamedBufferSubData(buffers[1], GL_R32F, 0, count * sizeof(sibr::Vector4f), GL_RED, GL_FLOAT, &zero);
+
+				GLState::useProgram(program);
+				glUniform2i(0, bw, bh);
+				glUniform1f(1, 1e-3f);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[0]);
+				for (int it = 0; it < iterations; ++it) {
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers[1 + (it % 2)]);
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, buffers[1 + ((it + 1) % 2)]);
+					glDispatchCompute(GLuint((bw + 7) / 8), GLuint((bh + 7) / 8), 1);
+					glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 				}
+				glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+				GLState::useProgram(0);
 
-				if (totalWeight > 0.0f) {
-					_accum(px, py) = avgColor / totalWeight;
-					_mask(px, py)[0] = 255;
+				// Only the tile itself is kept, its border is solved with the neighbor tiles.
+				glGetNamedBufferSubData(buffers[1 + (iterations % 2)], 0, count * sizeof(sibr::Vector4f), texels.data());
+				const int tw = std::min(kTileSize, w - x0);
+				const int th = std::min(kTileSize, h - y0);
+#pragma omp parallel for
+				for (int y = 0; y < th; ++y) {
+					for (int x = 0; x < tw; ++x) {
+						if (_labels(x0 + x, y0 + y)[0] == 0) {
+							continue;
+						}
+						const sibr::Vector4f & correction = texels[size_t(y0 + y - by0) * size_t(bw) + size_t(x0 + x - bx0)];
+						_accum(x0 + x, y0 + y) = (_accum(x0 + x, y0 + y) + correction.xyz()).cwiseMax(0.0f).cwiseMin(255.0f);
+					}
 				}
+				progress.walk();
 			}
-			if( (py % 1000) == 0 )
-				progress.walk(1000);
 		}
+
+		glDeleteBuffers(3, buffers);
+		GLState::deleteProgram(program);
+		CHECK_GL_ERROR;
 	}
 
 	sibr::ImageRGB::Ptr MeshTexturing::getTexture(uint options) const {
@@ -15,6 +15,7 @@
 #include "Config.hpp"
 #include <core/graphics/Image.hpp>
 #include <core/graphics/Mesh.hpp>
+#include <core/graphics/Texture.hpp>
 #include <core/assets/InputCamera.hpp>
 #include "core/raycaster/Raycaster.hpp"
 
@@ -56,6 +57,26 @@ namespace sibr {
 		*/
 		void reproject(const std::vector<InputCamera::Ptr> & cameras, const std::vector<sibr::ImageRGB::Ptr> & images, const float sampleRatio = 1.0);
 
+		/** Reproject a set of images into the texture map on the GPU, using the associated cameras.
+		* The mesh is rasterized in UV space by tiles, and the visibility of each texel is tested against the cameras depth maps.
+		* \param cameras the cameras poses
+		* \param images the images to reproject, one layer per camera, flipped (as built by RenderTargetTextures)
+		* \param depths the depth maps of the mesh from each camera, one layer per camera (as built by RenderTargetTextures)
+		* \param sampleRatio fraction of the best samples to blend, selected per 1/32th of weight
+		* \param bestCamera take each texel from the camera seeing it best instead of blending, and keep the camera labels for levelSeamsGPU
+		* \note Needs an OpenGL 4.3 context, current on the calling thread. The CPU reproject is the reference implementation.
+		*/
+		void reprojectGPU(const std::vector<InputCamera::Ptr> & cameras, const ITexture2DArray & images, const ITexture2DArray & depths, const float sampleRatio = 1.0, bool bestCamera = false);
+
+		/** Remove the color discontinuities between texels taken from different cameras, after reprojectGPU with bestCamera.
+		* An additive correction is solved on the GPU with Jacobi iterations: smooth inside each camera region, and
+		* closing the color difference across each seam, a Poisson blending of the regions. The texture is processed
+		* by tiles with an overlapping border, so that atlases larger than the GPU memory can be leveled.
+		* \param iterations number of Jacobi iterations per tile
+		* \note Seams are found between neighbor texels of the texture map, not between charts adjacent on the mesh.
+		*/
+		void levelSeamsGPU(int iterations = 1000);
+
 		/** Get the final result. 
 		* \param options the options to apply to the generated texture map.
 		*/
@@ -147,6 +168,7 @@ namespace sibr {
 
 		sibr::ImageRGB32F _accum; ///< Color accumulator.
 		sibr::ImageL8 _mask; ///< Mask indicating which regions of the texture map have been covered.
+		sibr::ImageInt1 _labels; ///< Camera of each texel plus one, zero if not covered, filled by reprojectGPU with bestCamera.
 
 		sibr::Mesh::Ptr _mesh; ///< The original world-space mesh.
 		sibr::Raycaster _worldRaycaster; ///< The world-space mesh raycaster.
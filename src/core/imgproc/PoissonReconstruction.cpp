@@ -13,10 +13,161 @@
 #include "PoissonReconstruction.hpp"
 #include <queue>   
 #include <Eigen/Sparse>
+#include <limits>
+#include <unordered_map>
 
 
 namespace sibr {
 
+namespace {
+
+	typedef Eigen::SparseMatrix<double, Eigen::RowMajor> SparseMatrixRM;
+
+	/// Above this number of unknowns, the AUTO solver is iterative.
+	const int kDirectMaxPixels = 1 << 18;
+	/// Coarse levels are added until there are less unknowns than this.
+	const int kCoarsestPixels = 4096;
+	/// Jacobi sweeps before and after each coarse correction.
+	const int kSmoothingSteps = 2;
+	/// Jacobi damping, optimal for the 5-points Laplacian.
+	const double kJacobiWeight = 0.8;
+
+	/** Multigrid V-cycle over the pixel grid, used as a conjugate gradient preconditioner.
+	 * Each coarse unknown aggregates the unknowns of a 2x2 block of the finer level, the coarse operators are Galerkin products.
+	 * Smoothing is a damped Jacobi, parallel and symmetric, so that the cycle stays a valid CG preconditioner.
+	 */
+	class MultigridPreconditioner {
+	public:
+
+		/** Build the levels hierarchy.
+		 * \param A the finest operator
+		 * \param pixels the pixel of each unknown
+		 */
+		MultigridPreconditioner(const SparseMatrixRM & A, const std::vector<sibr::Vector2i> & pixels) {
+			_levels.emplace_back();
+			_levels.back().A = A;
+			std::vector<sibr::Vector2i> coords = pixels;
+			while (_levels.back().A.rows() > kCoarsestPixels) {
+				Level & fine = _levels.back();
+				const int fineCount = int(fine.A.rows());
+				// Group the unknowns by 2x2 blocks.
+				std::unordered_map<int64_t, int> aggregates;
+				std::vector<sibr::Vector2i> coarseCoords;
+				std::vector< Eigen::Triplet<double> > prolongation;
+				prolongation.reserve(fineCount);
+				for (int i = 0; i < fineCount; ++i) {
+					const sibr::Vector2i coarse(coords[i].x() / 2, coords[i].y() / 2);
+					const int64_t key = (int64_t(coarse.y()) << 32) | int64_t(uint32_t(coarse.x()));
+					const auto it = aggregates.emplace(key, int(coarseCoords.size()));
+					if (it.second) {
+						coarseCoords.push_back(coarse);
+					}
+					prolongation.emplace_back(i, it.first->second, 1.0);
+				}
+				const int coarseCount = int(coarseCoords.size());
+				// Stop when the coarsening stalls.
+				if (coarseCount > fineCount * 9 / 10) {
+					break;
+				}
+				fine.P.resize(fineCount, coarseCount);
+				fine.P.setFromTriplets(prolongation.begin(), prolongation.end());
+				fine.R = fine.P.transpose();
+				SparseMatrixRM coarseA = SparseMatrixRM(fine.R * fine.A) * fine.P;
+				_levels.emplace_back();
+				_levels.back().A = std::move(coarseA);
+				coords = std::move(coarseCoords);
+			}
+			for (Level & level : _levels) {
+				level.invDiag = level.A.diagonal().cwiseInverse();
+			}
+			_coarseSolver.compute(Eigen::SparseMatrix<double>(_levels.back().A));
+		}
+
+		/** Apply the preconditioner.
+		 * \param r the residuals, one column per right-hand side
+		 * \param z will contain the preconditioned residuals
+		 */
+		void apply(const Eigen::MatrixXd & r, Eigen::MatrixXd & z) const {
+			vcycle(0, r, z);
+		}
+
+	private:
+
+		/// Operators of a level.
+		struct Level {
+			SparseMatrixRM A; ///< Operator.
+			SparseMatrixRM P; ///< Prolongation from the next coarser level.
+			SparseMatrixRM R; ///< Restriction to the next coarser level.
+			Eigen::VectorXd invDiag; ///< Inverse of the operator diagonal.
+		};
+
+		/// Solve approximately A x = b at a given level, from x = 0.
+		void vcycle(size_t l, const Eigen::MatrixXd & b, Eigen::MatrixXd & x) const {
+			if (l + 1 == _levels.size()) {
+				x = _coarseSolver.solve(b);
+				return;
+			}
+			const Level & level = _levels[l];
+			x = kJacobiWeight * (b.array().colwise() * level.invDiag.array()).matrix();
+			for (int s = 1; s < kSmoothingSteps; ++s) {
+				x += kJacobiWeight * ((b - level.A * x).array().colwise() * level.invDiag.array()).matrix();
+			}
+			Eigen::MatrixXd coarseB = level.R * (b - level.A * x);
+			Eigen::MatrixXd coarseX;
+			vcycle(l + 1, coarseB, coarseX);
+			x += level.P * coarseX;
+			for (int s = 0; s < kSmoothingSteps; ++s) {
+				x += kJacobiWeight * ((b - level.A * x).array().colwise() * level.invDiag.array()).matrix();
+			}
+		}
+
+		std::vector<Level> _levels; ///< From the finest to the coarsest.
+		Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > _coarseSolver; ///< Direct solver for the coarsest level.
+	};
+
+	/** Preconditioned conjugate gradient, for several right-hand sides sharing the same operator.
+	 * \param A the symmetric positive definite operator
+	 * \param preconditioner the preconditioner
+	 * \param b the right-hand sides, one per column
+	 * \param x the initial guess, will contain the solutions
+	 * \param tolerance the relative residual to reach for each column
+	 * \param maxIterations the iterations budget
+	 */
+	void solveCG(const SparseMatrixRM & A, const MultigridPreconditioner & preconditioner, const Eigen::MatrixXd & b, Eigen::MatrixXd & x,
+		double tolerance, int maxIterations)
+	{
+		const Eigen::Index cols = b.cols();
+		const Eigen::RowVectorXd bNorms = b.colwise().norm().cwiseMax(std::numeric_limits<double>::min());
+		Eigen::MatrixXd r = b - A * x;
+		Eigen::MatrixXd z, q;
+		preconditioner.apply(r, z);
+		Eigen::MatrixXd p = z;
+		Eigen::RowVectorXd rz = r.cwiseProduct(z).colwise().sum();
+		double residual = (r.colwise().norm().array() / bNorms.array()).maxCoeff();
+		int it = 0;
+		for (; it < maxIterations && residual > tolerance; ++it) {
+			q = A * p;
+			const Eigen::RowVectorXd pq = p.cwiseProduct(q).colwise().sum();
+			for (Eigen::Index k = 0; k < cols; ++k) {
+				// Converged columns are left as is.
+				const double alpha = pq[k] > 0.0 ? rz[k] / pq[k] : 0.0;
+				x.col(k) += alpha * p.col(k);
+				r.col(k) -= alpha * q.col(k);
+			}
+			residual = (r.colwise().norm().array() / bNorms.array()).maxCoeff();
+			preconditioner.apply(r, z);
+			const Eigen::RowVectorXd rzNext = r.cwiseProduct(z).colwise().sum();
+			for (Eigen::Index k = 0; k < cols; ++k) {
+				const double beta = rz[k] > 0.0 ? rzNext[k] / rz[k] : 0.0;
+				p.col(k) = z.col(k) + beta * p.col(k);
+			}
+			rz = rzNext;
+		}
+		SIBR_LOG << "[Poisson] Conjugate gradient: " << it << " iterations, relative residual " << residual << "." << std::endl;
+	}
+
+}
+
 
 
 PoissonReconstruction::PoissonReconstruction(
@@ -33,22 +184,29 @@ PoissonReconstruction::PoissonReconstruction(
 	
 }
 
+void PoissonReconstruction::solverSettings(Solver solver, double tolerance, int maxIterations)
+{
+	_solver = solver;
+	_tolerance = tolerance;
+	_maxIterations = maxIterations;
+}
+
 void PoissonReconstruction::solve(void)
 {
 	parseMask();
 
-	//solve Ai X=bi , Ai = A : coefs , bi : b_terms , i for each RGB
-	std::vector< Eigen::Triplet<double> >  coefs;
-	std::vector<Eigen::VectorXd> b_terms;
+	//solve A X=B, one column of B per RGB channel.
+	// Each pixel has at most 5 coefficients, the unused slots are null diagonal terms.
+	const int pixelsCount = (int)_pixels.size();
+	std::vector< Eigen::Triplet<double> >  coefs(5 * _pixels.size());
+	Eigen::MatrixXd b_terms(pixelsCount, 3);
 
-	for (int k = 0; k < 3; ++k) {
-		b_terms.push_back(Eigen::VectorXd::Zero(_pixels.size()));
-	}
-
-	for ( int p=0; p<(int)_pixels.size(); p++ ) { 
+#pragma omp parallel for
+	for ( int p=0; p<pixelsCount; p++ ) { 
 		sibr::Vector2i pos(_pixels[p]);
 		std::vector< sibr::Vector2i >  nPos ( getNeighbors(pos, _img_target.cols, _img_target.rows ));
 		int num_neighbors = 0;
+		int slot = 5 * p;
 		cv::Vec3f new_term(0, 0, 0);
 
 		for( int n_id = 0; n_id<nPos.size(); n_id++){ 
@@ -60,7 +218,7 @@ void PoissonReconstruction::solve(void)
 
 			if( isInMask(npos) ) { //pair inside mask
 				if(nId < 0 ) { std::cerr << "#"; }
-				coefs.push_back(Eigen::Triplet<double>(p,nId,-1));
+				coefs[slot++] = Eigen::Triplet<double>(p,nId,-1);
 									
 				// Four possibilities:
 				if(npos.x() > pos.x()){ // right pixel
@@ -79,44 +237,63 @@ void PoissonReconstruction::solve(void)
 			}
 		}
 
-		coefs.push_back(Eigen::Triplet<double>(p,p,(double)num_neighbors)); 
+		coefs[slot++] = Eigen::Triplet<double>(p,p,(double)num_neighbors);
+		while (slot < 5 * (p + 1)) {
+			coefs[slot++] = Eigen::Triplet<double>(p, p, 0.0);
+		}
 
 		for (int k = 0; k < 3; ++k) {
-			b_terms[k](p) = new_term(k);
+			b_terms(p, k) = new_term(k);
 		}
 			
 	}
 
-	Eigen::SparseMatrix<double> A((int)_pixels.size(),(int)_pixels.size());
+	SparseMatrixRM A(pixelsCount, pixelsCount);
 	A.setFromTriplets(coefs.begin(),coefs.end());
-	
-	std::vector<Eigen::VectorXd> solutions;
-	Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > eigenSolver;
+	coefs.clear();
+	coefs.shrink_to_fit();
+
+	Eigen::MatrixXd solutions(pixelsCount, 3);
+	const bool iterative = _solver == Solver::ITERATIVE || (_solver == Solver::AUTO && pixelsCount > kDirectMaxPixels);
+	if (iterative) {
+		// Warm start from the target image.
+#pragma omp parallel for
+		for (int p = 0; p < pixelsCount; p++) {
+			const cv::Vec3f & color = _img_target.at<cv::Vec3f>(_pixels[p].y(), _pixels[p].x());
+			for (int k = 0; k < 3; ++k) {
+				solutions(p, k) = color(k);
+			}
+		}
+		MultigridPreconditioner preconditioner(A, _pixels);
+		solveCG(A, preconditioner, b_terms, solutions, _tolerance, _maxIterations);
+	} else {
+		Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > eigenSolver;
 
-	eigenSolver.compute(A);
+		eigenSolver.compute(Eigen::SparseMatrix<double>(A));
 
-	if(eigenSolver.info()!=Eigen::Success) {
-		std::cerr << "decomp = failure" <<std::endl;
-		return;
-	} 
+		if(eigenSolver.info()!=Eigen::Success) {
+			std::cerr << "decomp = failure" <<std::endl;
+			return;
+		} 
 
-	for (int k = 0; k < 3; ++k) {
-		solutions.push_back(eigenSolver.solve(b_terms[k]));
+		solutions = eigenSolver.solve(b_terms);
 		if (eigenSolver.info() != Eigen::Success) {
 			std::cerr << "decomp = failure" << std::endl;
 		}
-
-		float error = (float)(A*solutions[k] - b_terms[k]).squaredNorm();
-		if (error > 1) {
-			std::cerr << "distance to solution: " << error << std::endl;
+		for (int k = 0; k < 3; ++k) {
+			float error = (float)(A*solutions.col(k) - b_terms.col(k)).squaredNorm();
+			if (error > 1) {
+				std::cerr << "distance to solution: " << error << std::endl;
+			}
 		}
 	}
 
-	for (int p = 0; p<(int)_pixels.size(); p++) {
+#pragma omp parallel for
+	for (int p = 0; p<pixelsCount; p++) {
 		sibr::Vector2i pos(_pixels[p]);
 		cv::Vec3f color;
 		for (int k = 0; k < 3; ++k) {
-			color(k) = std::min(1.0f, std::max((float)solutions[k][p], 0.0f));
+			color(k) = std::min(1.0f, std::max((float)solutions(p, k), 0.0f));
 		}
 		_img_target.at<cv::Vec3f>(pos.y(), pos.x()) = color;
 	}
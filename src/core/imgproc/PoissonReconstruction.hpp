@@ -26,6 +26,13 @@ namespace sibr {
 	{
 	public:
 
+		/** Solver used for the linear system. */
+		enum class Solver {
+			AUTO, ///< Direct for small problems, iterative otherwise.
+			DIRECT, ///< Sparse Cholesky factorization, exact but memory hungry.
+			ITERATIVE ///< Multigrid-preconditioned conjugate gradient, warm-started from the target image.
+		};
+
 		/** Initialize reconstructor for a given problem. Gradients and target are expected to be RGB32F, mask is L32F.
 		  In the mask, pixels with value = 0 are to be inpainted, value > 0.5 are pixels to be used as source/constraint,  value < -0.5 are pixels to be left unchanged and unused.
 		  To compute the gradients from an image, prefer using PoissonReconstruction::computeGradients (weird results have been observed when using cv::Sobel and similar).
@@ -44,6 +51,13 @@ namespace sibr {
 		/** Solve the reconstruction problem. */
 		void solve(void);
 
+		/** Set the linear solver settings.
+		\param solver the solver to use
+		\param tolerance relative residual to reach with the iterative solver
+		\param maxIterations maximum number of iterations of the iterative solver
+		*/
+		void solverSettings(Solver solver, double tolerance = 1e-5, int maxIterations = 500);
+
 		/** \return the result of the reconstruction */
 		cv::Mat result() const { return _img_target; }
 
@@ -73,6 +87,10 @@ namespace sibr {
 		std::vector<int > _pixelsId; ///< Pixel IDs list.
 		std::vector<std::vector<int> > _neighborMap; ///< Each pixel valid neighbors.
 
+		Solver _solver = Solver::AUTO; ///< Linear solver.
+		double _tolerance = 1e-5; ///< Iterative solver relative residual.
+		int _maxIterations = 500; ///< Iterative solver iterations budget.
+
 		/** Parse the mask and the additional label condition into a list of pixels to modified and boundaries conditions. */
 		void parseMask(void);
 
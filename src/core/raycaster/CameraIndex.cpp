@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <algorithm>
+#include "core/raycaster/CameraIndex.hpp"
+
+namespace sibr
+{
+
+	CameraIndex::Query::Query(const CameraIndex & index, const Vector3f & position) :
+		_index(index), _position(position) {
+	}
+
+	bool CameraIndex::Query::next(uint & cameraId, float & distance) {
+		if (_current == _results.size()) {
+			// Everything was fetched already, or the tree is empty.
+			if (!_index._tree || _results.size() == _index._cameras.size()) {
+				return false;
+			}
+			// Double the batch, the tree returns the previous neighbours first.
+			const size_t count = std::min(std::max(size_t(16), 2 * _results.size()), _index._cameras.size());
+			_index._tree->getClosest(_position, count, _results);
+			if (_current >= _results.size()) {
+				return false;
+			}
+		}
+		cameraId = uint(_results[_current].first);
+		distance = std::sqrt(_results[_current].second);
+		++_current;
+		return true;
+	}
+
+	CameraIndex::CameraIndex(const std::vector<InputCamera::Ptr> & cameras) : _cameras(cameras) {
+		if (_cameras.empty()) {
+			return;
+		}
+		std::vector<Tree::Vector3X> positions;
+		positions.reserve(_cameras.size());
+		for (const auto & cam : _cameras) {
+			positions.emplace_back(cam->position());
+		}
+		_tree.reset(new Tree(positions));
+	}
+
+	std::vector<uint> CameraIndex::closest(const Vector3f & position, size_t count) const {
+		std::vector<uint> out;
+		Query neighbours = query(position);
+		uint id;
+		float dist;
+		while (out.size() < count && neighbours.next(id, dist)) {
+			if (_cameras[id]->isActive()) {
+				out.push_back(id);
+			}
+		}
+		return out;
+	}
+
+	std::vector<uint> CameraIndex::selectAngleDistance(const Camera & eye, size_t count) const {
+		// Kept cameras, by decreasing score.
+		std::vector<std::pair<float, uint>> best;
+		if (count == 0) {
+			return {};
+		}
+		Query neighbours = query(eye.position());
+		uint id;
+		float dist;
+		while (neighbours.next(id, dist)) {
+			// The score of this camera and all the next ones is at most 1/dist.
+			if (best.size() == count && dist * best.back().first >= 1.0f) {
+				break;
+			}
+			const InputCamera & cam = *_cameras[id];
+			const float angle = sibr::dot(cam.dir(), eye.dir());
+			// Reject back facing cameras.
+			if (angle <= 0.001f || !cam.isActive()) {
+				continue;
+			}
+			const std::pair<float, uint> scored(angle / dist, id);
+			const auto pos = std::upper_bound(best.begin(), best.end(), scored,
+				[](const std::pair<float, uint> & a, const std::pair<float, uint> & b) { return a.first > b.first; });
+			if (best.size() < count) {
+				best.insert(pos, scored);
+			} else if (pos != best.end()) {
+				best.insert(pos, scored);
+				best.pop_back();
+			}
+		}
+		std::vector<uint> out;
+		out.reserve(best.size());
+		for (const auto & b : best) {
+			out.push_back(b.second);
+		}
+		return out;
+	}
+
+} // namespace sibr
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <memory>
+# include <core/assets/InputCamera.hpp>
+# include "core/raycaster/Config.hpp"
+# include "core/raycaster/KdTree.hpp"
+
+namespace sibr
+{
+
+	/** Spatial index over the positions of a list of input cameras, to select the cameras
+	 close to a viewpoint without scoring all of them.
+	 The activity of the cameras is checked at query time, the positions are fixed at creation.
+	 \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT CameraIndex
+	{
+		SIBR_CLASS_PTR(CameraIndex);
+
+	public:
+
+		typedef KdTree<float> Tree;
+
+		/** Incremental nearest neighbours query, returning the cameras by increasing distance to a point.
+		 Neighbours are fetched from the tree in batches of growing size.
+		*/
+		class SIBR_RAYCASTER_EXPORT Query
+		{
+		public:
+
+			/** Constructor.
+			\param index the camera index
+			\param position the reference point
+			*/
+			Query(const CameraIndex & index, const Vector3f & position);
+
+			/** Get the next closest camera, active or not.
+			\param cameraId will contain the camera index in the list
+			\param distance will contain the camera distance to the reference point
+			\return false once all cameras have been returned
+			*/
+			bool next(uint & cameraId, float & distance);
+
+		private:
+			const CameraIndex & _index; ///< Queried index.
+			Tree::Vector3X _position; ///< Reference point.
+			Tree::Results _results; ///< Fetched neighbours and squared distances.
+			size_t _current = 0; ///< Next fetched neighbour to return.
+		};
+
+		/** Constructor.
+		\param cameras the cameras to index
+		*/
+		CameraIndex(const std::vector<InputCamera::Ptr> & cameras);
+
+		/** \return an incremental query around a point.
+		\param position the reference point
+		*/
+		Query query(const Vector3f & position) const { return Query(*this, position); }
+
+		/** Find the active cameras closest to a point.
+		\param position the reference point
+		\param count the maximum number of cameras to return
+		\return the camera indices by increasing distance
+		*/
+		std::vector<uint> closest(const Vector3f & position, size_t count) const;
+
+		/** Find the active, front facing cameras with the highest ratio of view direction cosine over distance to a viewpoint.
+		 Since the cosine is at most 1, cameras further than the inverse of the worst kept score can't enter the selection and the search stops there.
+		\param eye the viewpoint
+		\param count the maximum number of cameras to return
+		\return the camera indices by decreasing score
+		*/
+		std::vector<uint> selectAngleDistance(const Camera & eye, size_t count) const;
+
+		/** \return the number of indexed cameras. */
+		size_t size() const { return _cameras.size(); }
+
+	private:
+
+		std::vector<InputCamera::Ptr> _cameras; ///< Indexed cameras.
+		std::unique_ptr<Tree> _tree; ///< Tree over the camera positions, null if there are none.
+	};
+
+} // namespace sibr
@@ -13,6 +13,8 @@
 #include <boost/filesystem/path.hpp>
 #include <core/system/Vector.hpp>
 #include "core/raycaster/CameraRaycaster.hpp"
+#include <omp.h>
+#include <algorithm>
 
 
 namespace sibr
@@ -45,7 +47,7 @@ namespace sibr
 		upLeftOffset += cam.position();
 	}
 
-	void CameraRaycaster::computeClippingPlanes(const sibr::Mesh & mesh, std::vector<InputCamera::Ptr>& cams, std::vector<sibr::Vector2f> & nearsFars)
+	void CameraRaycaster::computeClippingPlanes(const sibr::Mesh & mesh, std::vector<InputCamera::Ptr>& cams, std::vector<sibr::Vector2f> & nearsFars, uint step)
 	{
 		
 		nearsFars.clear();
@@ -55,40 +57,94 @@ namespace sibr
 		raycaster.addMesh(*localMesh);
 		SIBR_LOG << " [CameraRaycaster] computeAutoClippingPlanes() : " << std::flush;
 
-		int deltaPix = 15;
+		const int deltaPix = int(std::max(1u, step));
+		// Rays cast per stream query: bounds the memory when every pixel of every camera is traced,
+		// while keeping the batches large enough for the stream (and GPU) queries.
+		const size_t maxBatchRays = size_t(1) << 22;
 
-		nearsFars.resize(cams.size());
-
-		#pragma omp parallel for
+		// The sampled rows of all cameras, cast in batches of consecutive rows.
+		std::vector<std::pair<int, int>> rows;
 		for (int cam_id = 0; cam_id < (int)cams.size(); ++cam_id) {
-			sibr::InputCamera & cam = *cams[cam_id];
-
-			sibr::Vector3f dx, dy, upLeftOffset;
-			sibr::CameraRaycaster::computePixelDerivatives(cam, dx, dy, upLeftOffset);
-			sibr::Vector3f camZaxis = cam.dir().normalized();
-			float maxD = -1.0f, minD = -1.0f;
+			for (int i = 0; i < (int)cams[cam_id]->h(); i += deltaPix) {
+				rows.emplace_back(cam_id, i);
+			}
+		}
 
-			for (int i = 0; i < (int)cam.h(); i += deltaPix) {
+		std::vector<float> minDs(cams.size(), -1.0f), maxDs(cams.size(), -1.0f);
+		sibr::Raycaster::RayBatch rays;
+		std::vector<float> dists;
+		std::vector<size_t> offsets;
+		std::vector<sibr::Vector2f> rowRanges;
+		size_t firstRow = 0;
+		while (firstRow < rows.size()) {
+			// Gather the rows of the batch.
+			offsets.assign(1, 0);
+			size_t lastRow = firstRow;
+			while (lastRow < rows.size()) {
+				const size_t cols = (cams[rows[lastRow].first]->w() + deltaPix - 1) / deltaPix;
+				if (lastRow > firstRow && offsets.back() + cols > maxBatchRays) {
+					break;
+				}
+				offsets.push_back(offsets.back() + cols);
+				++lastRow;
+			}
+			const int batchRows = int(lastRow - firstRow);
+			rays.resize(offsets.back());
+
+			#pragma omp parallel for
+			for (int r = 0; r < batchRows; ++r) {
+				const sibr::InputCamera & cam = *cams[rows[firstRow + r].first];
+				const int i = rows[firstRow + r].second;
+				sibr::Vector3f dx, dy, upLeftOffset;
+				sibr::CameraRaycaster::computePixelDerivatives(cam, dx, dy, upLeftOffset);
+				size_t id = offsets[r];
 				for (int j = 0; j < (int)cam.w(); j += deltaPix) {
 					sibr::Vector3f worldPos = ((float)j + 0.5f)*dx + ((float)i + 0.5f)*dy + upLeftOffset;
-					sibr::Vector3f dir = (worldPos - cam.position()).normalized();
-
-					sibr::RayHit hit = raycaster.intersect(sibr::Ray(cam.position(), dir));
-
-					if (!hit.hitSomething()) { continue; }
-
-					float dist = hit.dist();
-
-					float clipDist = dist * std::abs(dir.dot(camZaxis));
+					rays.set(id++, cam.position(), (worldPos - cam.position()).normalized());
+				}
+			}
+			dists.resize(rays.size());
+			sibr::Raycaster::HitStream hits;
+			hits.dist = dists.data();
+			raycaster.intersectStream(rays.stream(), hits, 0.0f, true);
+
+			// Reduce each row, then merge the rows in the camera ranges.
+			rowRanges.assign(batchRows, sibr::Vector2f(-1.0f, -1.0f));
+			#pragma omp parallel for
+			for (int r = 0; r < batchRows; ++r) {
+				const sibr::Vector3f camZaxis = cams[rows[firstRow + r].first]->dir().normalized();
+				float maxD = -1.0f, minD = -1.0f;
+				for (size_t id = offsets[r]; id < offsets[r + 1]; ++id) {
+					if (dists[id] == sibr::RayHit::InfinityDist) { continue; }
+
+					const sibr::Vector3f dir(rays.dirX[id], rays.dirY[id], rays.dirZ[id]);
+					float clipDist = dists[id] * std::abs(dir.dot(camZaxis));
 
 					maxD = (maxD<0 || clipDist > maxD ? clipDist : maxD);
 					minD = (minD<0 || clipDist < minD ? clipDist : minD);
 				}
+				rowRanges[r] = sibr::Vector2f(minD, maxD);
 			}
+			for (int r = 0; r < batchRows; ++r) {
+				const int cam_id = rows[firstRow + r].first;
+				const sibr::Vector2f & range = rowRanges[r];
+				if (range[0] < 0) { continue; }
+				minDs[cam_id] = (minDs[cam_id] < 0 || range[0] < minDs[cam_id] ? range[0] : minDs[cam_id]);
+				maxDs[cam_id] = (maxDs[cam_id] < 0 || range[1] > maxDs[cam_id] ? range[1] : maxDs[cam_id]);
+			}
+			firstRow = lastRow;
+		}
 
+		nearsFars.resize(cams.size());
 
-			float znear = 0.5f*minD;
-			float zfar = 2.0f*maxD;
+		for (int cam_id = 0; cam_id < (int)cams.size(); ++cam_id) {
+			sibr::InputCamera & cam = *cams[cam_id];
+			const float minD = minDs[cam_id];
+			const float maxD = maxDs[cam_id];
+
+			// The margins account for the geometry between the sampled pixels, a full grid only needs a small one.
+			float znear = (deltaPix == 1 ? 0.95f : 0.5f)*minD;
+			float zfar = (deltaPix == 1 ? 1.05f : 2.0f)*maxD;
 
 			while (zfar / znear < 100.0f) {
 				zfar *= 1.1f;
@@ -99,8 +155,6 @@ namespace sibr
 			cam.zfar(zfar);
 
 			nearsFars[cam_id] = sibr::Vector2f(znear, zfar);
-
-			std::cout << cam_id << " " << std::flush;
 		}
 		std::cout << " done." << std::endl;
 
@@ -142,19 +196,81 @@ namespace sibr
 		//sibr::LoadingProgress	progress(cam.w()*cam.h(), optLogMsg);
 		(void)optLogMsg;
 
-		// For each pixel of the camera's image
-		for (uint py = 0; py < cam.h(); ++py)
+		// Initialize before the workers query the raycaster.
+		if (!_raycaster.init()) {
+			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
+		}
+
+		// Without clones, the processors are used on the caller thread only.
+		bool parallel = true;
+		for (uint i = 0; i < nbProcessors && parallel; ++i) {
+			parallel = bool(processors[i]->clone());
+		}
+
+		const int tilesX = int((cam.w() + tileSize - 1) / tileSize);
+		const int tilesY = int((cam.h() + tileSize - 1) / tileSize);
+		const int64_t tilesCount = int64_t(tilesX) * int64_t(tilesY);
+		std::vector<std::vector<ICameraRaycasterProcessor::Ptr>> workers;
+		if (parallel) {
+			workers.resize(omp_get_max_threads());
+		}
+
+#pragma omp parallel if(parallel)
 		{
-			for (uint px = 0; px < cam.w(); ++px)
-			{ 
-				//progress.walk();
-				sibr::Vector3f worldPos = (float)px*dx + (float)py*dy + upLeftOffset;
-				// Cast a ray
-				sibr::Vector3f dir =  worldPos - cam.position();
-				RayHit hit = _raycaster.intersect(Ray( cam.position(), dir));
-
-				for (uint i = 0; i < nbProcessors; ++i)
-					processors[i]->onCast(px, py, hit);
+			// Processors used by this thread.
+			std::vector<ICameraRaycasterProcessor*> local(processors, processors + nbProcessors);
+			if (parallel) {
+				std::vector<ICameraRaycasterProcessor::Ptr> & clones = workers[omp_get_thread_num()];
+				for (uint i = 0; i < nbProcessors; ++i) {
+					clones.push_back(processors[i]->clone());
+					local[i] = clones.back().get();
+				}
+			}
+
+			Raycaster::RayBatch rays;
+			std::vector<float> dists(tileSize * tileSize);
+			std::vector<RayHit::Primitive> prims(tileSize * tileSize);
+			std::vector<RayHit::BCCoord> coords(tileSize * tileSize);
+			std::vector<sibr::Vector3f> normals(tileSize * tileSize);
+			Raycaster::HitStream hits;
+			hits.dist = dists.data();
+			hits.prim = prims.data();
+			hits.coord = coords.data();
+			hits.normal = normals.data();
+
+#pragma omp for schedule(dynamic)
+			for (int64_t tile = 0; tile < tilesCount; ++tile) {
+				const uint x0 = uint(tile % tilesX) * tileSize;
+				const uint y0 = uint(tile / tilesX) * tileSize;
+				const uint x1 = std::min(x0 + tileSize, cam.w());
+				const uint y1 = std::min(y0 + tileSize, cam.h());
+
+				// Cast the tile rays as one coherent packet.
+				rays.clear();
+				for (uint py = y0; py < y1; ++py) {
+					for (uint px = x0; px < x1; ++px) {
+						const sibr::Vector3f worldPos = (float)px*dx + (float)py*dy + upLeftOffset;
+						rays.add(cam.position(), (worldPos - cam.position()).normalized());
+					}
+				}
+				_raycaster.intersectStream(rays.stream(), hits, 0.0f, true);
+
+				size_t r = 0;
+				for (uint py = y0; py < y1; ++py) {
+					for (uint px = x0; px < x1; ++px, ++r) {
+						const Ray ray(cam.position(), sibr::Vector3f(rays.dirX[r], rays.dirY[r], rays.dirZ[r]));
+						const RayHit hit(ray, dists[r], coords[r], normals[r], prims[r]);
+						for (uint i = 0; i < nbProcessors; ++i)
+							local[i]->onCast(px, py, hit);
+					}
+				}
+			}
+		}
+
+		// Reduction, in a fixed order.
+		for (auto & clones : workers) {
+			for (uint i = 0; i < uint(clones.size()); ++i) {
+				processors[i]->merge(*clones[i]);
 			}
 		}
 
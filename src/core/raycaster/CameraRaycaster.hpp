@@ -28,6 +28,7 @@ namespace sibr
 	*/
 	class SIBR_RAYCASTER_EXPORT ICameraRaycasterProcessor
 	{
+		SIBR_CLASS_PTR(ICameraRaycasterProcessor);
 	public:
 
 		/// Destructor.
@@ -40,6 +41,18 @@ namespace sibr
 		*/
 		virtual void	onCast( uint px, uint py, const RayHit& hit ) = 0;
 
+		/** Create a processor for a worker thread of CameraRaycaster::castForEachPixel, with the same
+		 settings and an empty state. Implement it along with merge to process the pixels in parallel.
+		\return the new processor, or nullptr (the default) if the pixels have to be processed on one thread
+		*/
+		virtual Ptr		clone( void ) const { return nullptr; }
+
+		/** Combine the results of a worker processor created by clone, once all pixels have been cast.
+		 Each pixel was processed by exactly one worker.
+		\param worker the worker processor
+		*/
+		virtual void	merge( ICameraRaycasterProcessor& worker ) { }
+
 	};
 
 	/**  Used for casting each pixel of an image into a raycaster scene.
@@ -61,6 +74,9 @@ namespace sibr
 		void	addMesh( const sibr::Mesh& mesh );
 
 		/** For each image pixel, send a ray and compute data using the provided processors.
+		 Pixels are cast by tiles of tileSize x tileSize. If all the processors support clone, the tiles
+		 are distributed over threads, each with its own processors merged back at the end; the order
+		 in which pixels are processed is then unspecified.
 		\param cam the source camera
 		\param processors a list of processors to call for each cast ray
 		\param nbProcessors the number of processors in the list
@@ -90,17 +106,22 @@ namespace sibr
 		static sibr::Vector3f computeRayDir( const sibr::InputCamera& cam, const sibr::Vector2f & pixel );
 
 		/** Estimate the clipping planes for a set of cameras so that the mesh is entirely visible in each camera.
+		The rays of the sampled pixels of all cameras are cast in large stream batches, on the GPU if it is the
+		default raycaster backend.
 		\param mesh the mesh to visualize
 		\param cams the list of cameras
-		\param nearsFars will contain the near and far plane of each camera
+		\param nearsFars will contain the near and far plane of each camera, negative if the mesh is not visible
+		\param step one pixel out of step is cast in each direction, 1 to get exact planes from every pixel
 		*/
-		static void computeClippingPlanes(const sibr::Mesh & mesh, std::vector<InputCamera::Ptr>& cams, std::vector<sibr::Vector2f> & nearsFars);
+		static void computeClippingPlanes(const sibr::Mesh & mesh, std::vector<InputCamera::Ptr>& cams, std::vector<sibr::Vector2f> & nearsFars, uint step = 15);
 
 		/// \return the internal raycaster
 		Raycaster&			raycaster( void )			{ return _raycaster; }
 		/// \return the internal raycaster
 		const Raycaster&	raycaster( void ) const 	{ return _raycaster; }
 
+		static const uint tileSize = 8; ///< Side of the pixel tiles cast together.
+
 	private:
 
 		Raycaster									_raycaster; ///< Internal raycaster.
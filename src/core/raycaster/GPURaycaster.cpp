@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/raycaster/GPURaycaster.hpp"
+#include "core/graphics/GLState.hpp"
+#include "core/graphics/Window.hpp"
+#include "core/graphics/FrameProfiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace sibr
+{
+	namespace {
+
+		const int kBins = 16; // SAH bins per axis.
+		const uint32_t kMaxLeafSize = 8; // Triangles above which a leaf is always split.
+		const uint32_t kMaxDepth = 60; // Below the traversal stack size.
+		const size_t kChunkRays = size_t(1) << 20; // Rays uploaded at once.
+		const GLuint kGroupSize = 64;
+
+		/// BVH node, as read by the shader: inner nodes have no triangle and their two children at first, first+1.
+		struct Node {
+			float bmin[3];
+			uint32_t first;
+			float bmax[3];
+			uint32_t count;
+		};
+		static_assert(sizeof(Node) == 32, "Node must match the std430 layout.");
+
+		/// Triangle, as read by the shader.
+		struct Triangle {
+			float v0[3];
+			uint32_t prim;
+			float v1[3];
+			uint32_t geom;
+			float v2[3];
+			uint32_t pad;
+		};
+		static_assert(sizeof(Triangle) == 48, "Triangle must match the std430 layout.");
+
+		/// Closest hit, as written by the shader.
+		struct Hit {
+			float dist, u, v;
+			uint32_t prim;
+			float normal[3];
+			uint32_t geom;
+		};
+		static_assert(sizeof(Hit) == 32, "Hit must match the std430 layout.");
+
+		/// Axis aligned box.
+		struct Box {
+			sibr::Vector3f lo = sibr::Vector3f::Constant(std::numeric_limits<float>::max());
+			sibr::Vector3f hi = sibr::Vector3f::Constant(-std::numeric_limits<float>::max());
+
+			void grow(const sibr::Vector3f & p) { lo = lo.cwiseMin(p); hi = hi.cwiseMax(p); }
+			void grow(const Box & b) { lo = lo.cwiseMin(b.lo); hi = hi.cwiseMax(b.hi); }
+			float area() const {
+				if (lo[0] > hi[0]) {
+					return 0.0f;
+				}
+				const sibr::Vector3f d = hi - lo;
+				return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+			}
+		};
+
+		/** Build a BVH with binned SAH splits.
+		\param vertices three vertices per triangle
+		\param nodes will contain the nodes, the root first
+		\param order will contain the triangle of each leaf slot
+		*/
+		void buildBVH(const std::vector<sibr::Vector3f> & vertices, std::vector<Node> & nodes, std::vector<uint32_t> & order)
+		{
+			const uint32_t count = uint32_t(vertices.size() / 3);
+			std::vector<Box> boxes(count);
+			std::vector<sibr::Vector3f> centers(count);
+#pragma omp parallel for
+			for (int64_t t = 0; t < int64_t(count); ++t) {
+				for (int k = 0; k < 3; ++k) {
+					boxes[t].grow(vertices[3 * t + k]);
+				}
+				centers[t] = 0.5f * (boxes[t].lo + boxes[t].hi);
+			}
+
+			order.resize(count);
+			std::iota(order.begin(), order.end(), 0u);
+			nodes.clear();
+			nodes.reserve(std::max(1u, 2 * count));
+			nodes.emplace_back();
+
+			struct Task { uint32_t node, begin, end, depth; };
+			std::vector<Task> tasks = { { 0, 0, count, 0 } };
+			while (!tasks.empty()) {
+				const Task task = tasks.back();
+				tasks.pop_back();
+				const uint32_t size = task.end - task.begin;
+
+				Box bounds, centroids;
+				for (uint32_t i = task.begin; i < task.end; ++i) {
+					bounds.grow(boxes[order[i]]);
+					centroids.grow(centers[order[i]]);
+				}
+				Node & node = nodes[task.node];
+				for (int k = 0; k < 3; ++k) {
+					node.bmin[k] = bounds.lo[k];
+					node.bmax[k] = bounds.hi[k];
+				}
+				node.first = task.begin;
+				node.count = size;
+				if (size <= 2 || task.depth >= kMaxDepth) {
+					continue;
+				}
+
+				// Find the cheapest split among the bin boundaries of each axis.
+				float bestCost = std::numeric_limits<float>::max();
+				int bestAxis = -1, bestBin = 0;
+				for (int axis = 0; axis < 3; ++axis) {
+					const float extent = centroids.hi[axis] - centroids.lo[axis];
+					if (extent <= 0.0f) {
+						continue;
+					}
+					Box bins[kBins];
+					uint32_t binCounts[kBins] = { 0 };
+					const float scale = float(kBins) / extent;
+					for (uint32_t i = task.begin; i < task.end; ++i) {
+						const int b = std::min(kBins - 1, int((centers[order[i]][axis] - centroids.lo[axis]) * scale));
+						bins[b].grow(boxes[order[i]]);
+						++binCounts[b];
+					}
+					float rightCosts[kBins];
+					Box right;
+					uint32_t rightCount = 0;
+					for (int b = kBins - 1; b > 0; --b) {
+						right.grow(bins[b]);
+						rightCount += binCounts[b];
+						rightCosts[b] = right.area() * float(rightCount);
+					}
+					Box left;
+					uint32_t leftCount = 0;
+					for (int b = 1; b < kBins; ++b) {
+						left.grow(bins[b - 1]);
+						leftCount += binCounts[b - 1];
+						const float cost = left.area() * float(leftCount) + rightCosts[b];
+						if (cost < bestCost) {
+							bestCost = cost;
+							bestAxis = axis;
+							bestBin = b;
+						}
+					}
+				}
+
+				uint32_t mid = task.begin + size / 2;
+				if (bestAxis >= 0) {
+					if (bestCost >= bounds.area() * float(size) && size <= kMaxLeafSize) {
+						continue;
+					}
+					const float lo = centroids.lo[bestAxis];
+					const float scale = float(kBins) / (centroids.hi[bestAxis] - lo);
+					const auto split = std::partition(order.begin() + task.begin, order.begin() + task.end, [&](uint32_t t) {
+						return std::min(kBins - 1, int((centers[t][bestAxis] - lo) * scale)) < bestBin;
+					});
+					mid = uint32_t(split - order.begin());
+					if (mid == task.begin || mid == task.end) {
+						mid = task.begin + size / 2;
+					}
+				}
+				else if (size <= kMaxLeafSize) {
+					// All centroids are equal.
+					continue;
+				}
+
+				const uint32_t left = uint32_t(nodes.size());
+				nodes.emplace_back();
+				nodes.emplace_back();
+				nodes[task.node].first = left;
+				nodes[task.node].count = 0;
+				tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+				tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+			}
+		}
+
+		const char * kTraceShader = R"(
+			#version 430
+
+			layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+			struct Node {
+				vec3 bmin;
+				uint first; // First child or triangle.
+				vec3 bmax;
+				uint size; // Triangle count, 0 for inner nodes.
+			};
+			struct Triangle {
+				vec3 v0;
+				uint prim;
+				vec3 v1;
+				uint geom;
+				vec3 v2;
+				uint pad;
+			};
+			struct Hit {
+				float dist, u, v;
+				uint prim;
+				vec3 normal;
+				uint geom;
+			};
+			layout(std430, binding = 0) readonly buffer Nodes {
+				Node nodes[];
+			};
+			layout(std430, binding = 1) readonly buffer Triangles {
+				Triangle tris[];
+			};
+			// Two entries per ray, origin + tnear, direction + tfar.
+			layout(std430, binding = 2) readonly buffer Rays {
+				vec4 rays[];
+			};
+			// One hit or one flag per ray.
+			layout(std430, binding = 3) writeonly buffer Hits {
+				Hit hits[];
+			};
+			layout(std430, binding = 3) writeonly buffer Occluded {
+				uint occluded[];
+			};
+
+			layout(location = 0) uniform uint count;
+			layout(location = 1) uniform bool anyHit;
+			layout(location = 2) uniform bool cullBackfaces;
+			layout(location = 3) uniform float missDist;
+
+			const uint kStackSize = 64u;
+			const uint kInvalid = 0xFFFFFFFFu;
+
+			// Entry distance in a box, or a negative value if it is missed.
+			float entry(Node node, vec3 org, vec3 invDir, float tnear, float tfar) {
+				vec3 t0 = (node.bmin - org) * invDir;
+				vec3 t1 = (node.bmax - org) * invDir;
+				vec3 tmin = min(t0, t1);
+				vec3 tmax = max(t0, t1);
+				float enter = max(max(tmin.x, tmin.y), max(tmin.z, tnear));
+				float exit = min(min(tmax.x, tmax.y), min(tmax.z, tfar));
+				return enter <= exit ? enter : -1.0;
+			}
+
+			void main() {
+				uint id = gl_GlobalInvocationID.x;
+				if (id >= count) {
+					return;
+				}
+				vec3 org = rays[2u * id].xyz;
+				float tnear = rays[2u * id].w;
+				vec3 dir = rays[2u * id + 1u].xyz;
+				float best = rays[2u * id + 1u].w;
+				vec3 safeDir = vec3(abs(dir.x) > 1e-20 ? dir.x : 1e-20, abs(dir.y) > 1e-20 ? dir.y : 1e-20, abs(dir.z) > 1e-20 ? dir.z : 1e-20);
+				vec3 invDir = 1.0 / safeDir;
+
+				uint hitTri = kInvalid;
+				vec2 hitUV = vec2(0.0);
+				uint stack[kStackSize];
+				uint top = 0u;
+				if (entry(nodes[0], org, invDir, tnear, best) >= 0.0) {
+					stack[top++] = 0u;
+				}
+				while (top > 0u) {
+					Node node = nodes[stack[--top]];
+					uint first = node.first;
+					uint size = node.size;
+					if (size == 0u) {
+						// Visit the nearest child first.
+						float d0 = entry(nodes[first], org, invDir, tnear, best);
+						float d1 = entry(nodes[first + 1u], org, invDir, tnear, best);
+						if (d0 >= 0.0 && d1 >= 0.0) {
+							stack[top++] = d0 <= d1 ? first + 1u : first;
+							stack[top++] = d0 <= d1 ? first : first + 1u;
+						}
+						else if (d0 >= 0.0) {
+							stack[top++] = first;
+						}
+						else if (d1 >= 0.0) {
+							stack[top++] = first + 1u;
+						}
+						continue;
+					}
+					for (uint t = first; t < first + size; ++t) {
+						vec3 v0 = tris[t].v0;
+						vec3 e1 = tris[t].v1 - v0;
+						vec3 e2 = tris[t].v2 - v0;
+						vec3 p = cross(dir, e2);
+						float det = dot(e1, p);
+						// det is positive when the ray faces the front of the triangle.
+						if (cullBackfaces ? det <= 0.0 : det == 0.0) {
+							continue;
+						}
+						float invDet = 1.0 / det;
+						vec3 s = org - v0;
+						float u = dot(s, p) * invDet;
+						if (u < 0.0 || u > 1.0) {
+							continue;
+						}
+						vec3 q = cross(s, e1);
+						float v = dot(dir, q) * invDet;
+						if (v < 0.0 || u + v > 1.0) {
+							continue;
+						}
+						float dist = dot(e2, q) * invDet;
+						if (dist < tnear || dist > best) {
+							continue;
+						}
+						best = dist;
+						hitTri = t;
+						hitUV = vec2(u, v);
+						if (anyHit) {
+							top = 0u;
+							break;
+						}
+					}
+				}
+
+				if (anyHit) {
+					occluded[id] = hitTri == kInvalid ? 0u : 1u;
+					return;
+				}
+				if (hitTri == kInvalid) {
+					hits[id] = Hit(missDist, 0.0, 0.0, kInvalid, vec3(0.0), kInvalid);
+					return;
+				}
+				Triangle tri = tris[hitTri];
+				// Same orientation as Raycaster::intersect.
+				vec3 normal = -cross(tri.v1 - tri.v0, tri.v2 - tri.v0);
+				hits[id] = Hit(best, hitUV.x, hitUV.y, tri.prim, normal, tri.geom);
+			}
+		)";
+
+		/// Compile a compute program, reporting errors.
+		GLuint compileCompute(const char * source)
+		{
+			GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				SIBR_WRG << "[GPURaycaster] Compilation failed: " << log << std::endl;
+				glDeleteShader(shader);
+				return 0;
+			}
+			GLuint program = glCreateProgram();
+			glAttachShader(program, shader);
+			glLinkProgram(program);
+			glDeleteShader(shader);
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				SIBR_WRG << "[GPURaycaster] Link failed: " << log << std::endl;
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+	}
+
+	GPURaycaster::GPURaycaster()
+	{
+	}
+
+	GPURaycaster::~GPURaycaster()
+	{
+		// The context may already be gone at exit.
+		if (_context && Window::currentContext() == _context) {
+			const GLuint buffers[] = { _nodes, _tris, _rays, _hits };
+			glDeleteBuffers(4, buffers);
+			GLState::deleteProgram(_program);
+		}
+	}
+
+	bool GPURaycaster::usable()
+	{
+		const void * current = Window::currentContext();
+		if (!current || (_context && current != _context)) {
+			return false;
+		}
+		return setup();
+	}
+
+	bool GPURaycaster::setup()
+	{
+		if (_program || _failed) {
+			return !_failed;
+		}
+		if (!GLEW_VERSION_4_3) {
+			SIBR_WRG << "[GPURaycaster] OpenGL 4.3 is required, using the CPU." << std::endl;
+			_failed = true;
+			return false;
+		}
+		_program = compileCompute(kTraceShader);
+		if (!_program) {
+			_failed = true;
+			return false;
+		}
+		_context = Window::currentContext();
+		GLuint buffers[4];
+		glGenBuffers(4, buffers);
+		_nodes = buffers[0];
+		_tris = buffers[1];
+		_rays = buffers[2];
+		_hits = buffers[3];
+		return true;
+	}
+
+	void GPURaycaster::build(const std::vector<sibr::Vector3f> & vertices, const std::vector<RayHit::Primitive> & prims, bool cullBackfaces)
+	{
+		if (!usable()) {
+			return;
+		}
+		SIBR_PROFILE_CPU("GPURaycaster build");
+		std::vector<Node> nodes;
+		std::vector<uint32_t> order;
+		_triangles = prims.size();
+		_cullBackfaces = cullBackfaces;
+		buildBVH(vertices, nodes, order);
+
+		std::vector<Triangle> tris(std::max(size_t(1), _triangles));
+#pragma omp parallel for
+		for (int64_t i = 0; i < int64_t(order.size()); ++i) {
+			const uint32_t t = order[i];
+			Triangle & tri = tris[i];
+			for (int k = 0; k < 3; ++k) {
+				tri.v0[k] = vertices[3 * t][k];
+				tri.v1[k] = vertices[3 * t + 1][k];
+				tri.v2[k] = vertices[3 * t + 2][k];
+			}
+			tri.prim = prims[t].triID;
+			tri.geom = prims[t].geomID;
+			tri.pad = 0;
+		}
+		if (_triangles == 0) {
+			// An empty box, never entered.
+			nodes.resize(1);
+			std::fill_n(nodes[0].bmin, 3, 1.0f);
+			std::fill_n(nodes[0].bmax, 3, -1.0f);
+			nodes[0].first = nodes[0].count = 0;
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _nodes);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.size() * sizeof(Node), nodes.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tris);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, tris.size() * sizeof(Triangle), tris.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		SIBR_LOG << "[GPURaycaster] Uploaded " << _triangles << " triangles, " << nodes.size() << " nodes." << std::endl;
+	}
+
+	void GPURaycaster::intersectStream(const Raycaster::RayStream & rays, const Raycaster::HitStream & hits, float minDist)
+	{
+		trace(rays, minDist, false, &hits, nullptr);
+	}
+
+	void GPURaycaster::occludedStream(const Raycaster::RayStream & rays, uint8_t * occluded, float minDist)
+	{
+		trace(rays, minDist, true, nullptr, occluded);
+	}
+
+	void GPURaycaster::trace(const Raycaster::RayStream & rays, float minDist, bool anyHit, const Raycaster::HitStream * hits, uint8_t * occluded)
+	{
+		if (rays.count == 0 || !usable()) {
+			return;
+		}
+		SIBR_PROFILE_CPU("GPURaycaster trace");
+		const size_t chunk = std::min(rays.count, kChunkRays);
+		std::vector<sibr::Vector4f> packed(2 * chunk);
+		std::vector<Hit> results(anyHit ? 0 : chunk);
+		std::vector<uint32_t> flags(anyHit ? chunk : 0);
+
+		// Storage for the largest chunk, the ray buffer is updated in place.
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _rays);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, packed.size() * sizeof(sibr::Vector4f), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _hits);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, anyHit ? flags.size() * sizeof(uint32_t) : results.size() * sizeof(Hit), nullptr, GL_STREAM_READ);
+
+		GLState::useProgram(_program);
+		glUniform1i(1, anyHit ? 1 : 0);
+		glUniform1i(2, _cullBackfaces ? 1 : 0);
+		glUniform1f(3, RayHit::InfinityDist);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _nodes);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _tris);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _rays);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _hits);
+
+		for (size_t begin = 0; begin < rays.count; begin += chunk) {
+			const size_t count = std::min(chunk, rays.count - begin);
+#pragma omp parallel for
+			for (int64_t r = 0; r < int64_t(count); ++r) {
+				const size_t i = begin + size_t(r);
+				packed[2 * r] = sibr::Vector4f(rays.orgX[i], rays.orgY[i], rays.orgZ[i], rays.tnear ? rays.tnear[i] : minDist);
+				packed[2 * r + 1] = sibr::Vector4f(rays.dirX[i], rays.dirY[i], rays.dirZ[i], rays.tfar ? rays.tfar[i] : RayHit::InfinityDist);
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _rays);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, 2 * count * sizeof(sibr::Vector4f), packed.data());
+
+			glUniform1ui(0, GLuint(count));
+			glDispatchCompute(GLuint((count + kGroupSize - 1) / kGroupSize), 1, 1);
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+			// Reading back waits for the dispatch.
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _hits);
+			if (anyHit) {
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(uint32_t), flags.data());
+				for (size_t r = 0; r < count; ++r) {
+					occluded[begin + r] = flags[r] ? 1 : 0;
+				}
+				continue;
+			}
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(Hit), results.data());
+#pragma omp parallel for
+			for (int64_t r = 0; r < int64_t(count); ++r) {
+				const size_t i = begin + size_t(r);
+				const Hit & hit = results[r];
+				if (hits->dist) {
+					hits->dist[i] = hit.dist;
+				}
+				if (hits->prim) {
+					hits->prim[i] = RayHit::Primitive{ hit.prim, hit.geom, Raycaster::InvalidGeomId };
+				}
+				if (hits->coord) {
+					hits->coord[i] = RayHit::BCCoord{ hit.u, hit.v };
+				}
+				if (hits->normal) {
+					hits->normal[i] = sibr::Vector3f(hit.normal[0], hit.normal[1], hit.normal[2]);
+				}
+			}
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		GLState::useProgram(0);
+	}
+
+} // namespace sibr
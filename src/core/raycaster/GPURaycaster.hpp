@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <vector>
+# include "core/raycaster/Config.hpp"
+# include "core/raycaster/Raycaster.hpp"
+
+namespace sibr
+{
+
+	/** GPU backend of the Raycaster stream queries. The triangles are sorted in a BVH built on the CPU
+	 (binned SAH), uploaded to shader storage buffers and traversed by a compute shader, one ray per
+	 invocation. Results follow the conventions of the Embree stream queries (distances, barycentric
+	 coordinates, negated geometric normals, invalid ids on misses).
+	 \note All calls must be made from the thread owning the OpenGL context the backend was first used with.
+	 \sa Raycaster::backend
+	 \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT GPURaycaster
+	{
+		SIBR_DISALLOW_COPY(GPURaycaster);
+
+	public:
+		SIBR_CLASS_PTR(GPURaycaster);
+
+		/// Constructor, no GL call is made before the first use.
+		GPURaycaster();
+
+		/// Destructor.
+		~GPURaycaster();
+
+		/** \return true if the backend can run on the calling thread: an OpenGL 4.3 context is current
+		 (the one used the first time), and the traversal program compiled.
+		*/
+		bool usable();
+
+		/** Build the BVH of a triangle soup and upload it.
+		\param vertices three vertices per triangle
+		\param prims the primitive reported for each triangle
+		\param cullBackfaces ignore the triangles whose geometric normal faces the ray, as the Embree device does
+		*/
+		void build(const std::vector<sibr::Vector3f> & vertices, const std::vector<RayHit::Primitive> & prims, bool cullBackfaces);
+
+		/** Cast a batch of rays, see Raycaster::intersectStream.
+		\param rays the rays to cast
+		\param hits the result buffers
+		\param minDist the minimal distance, if the stream has no tnear
+		*/
+		void intersectStream(const Raycaster::RayStream & rays, const Raycaster::HitStream & hits, float minDist);
+
+		/** Cast a batch of rays, only reporting if intersections occured, see Raycaster::occludedStream.
+		\param rays the rays to cast
+		\param occluded will contain 1 for each occluded ray, 0 otherwise
+		\param minDist the minimal distance, if the stream has no tnear
+		*/
+		void occludedStream(const Raycaster::RayStream & rays, uint8_t * occluded, float minDist);
+
+		/** \return the number of triangles uploaded. */
+		size_t trianglesCount() const { return _triangles; }
+
+	private:
+
+		/** Cast rays by chunks, reading back the results of each chunk.
+		\param rays the rays to cast
+		\param minDist the minimal distance, if the stream has no tnear
+		\param anyHit stop at the first hit
+		\param hits the closest hit results, if !anyHit
+		\param occluded the occlusion results, if anyHit
+		*/
+		void trace(const Raycaster::RayStream & rays, float minDist, bool anyHit, const Raycaster::HitStream * hits, uint8_t * occluded);
+
+		/** Compile the traversal program on first use.
+		\return true if it is available
+		*/
+		bool setup();
+
+		const void * _context = nullptr; ///< Context owning the GL objects.
+		bool _failed = false; ///< The program could not be compiled.
+		GLuint _program = 0; ///< Traversal program.
+		GLuint _nodes = 0; ///< BVH nodes buffer.
+		GLuint _tris = 0; ///< Sorted triangles buffer.
+		GLuint _rays = 0; ///< Rays chunk buffer.
+		GLuint _hits = 0; ///< Results chunk buffer.
+		size_t _triangles = 0; ///< Number of triangles.
+		bool _cullBackfaces = false; ///< Backface culling.
+	};
+
+} // namespace sibr
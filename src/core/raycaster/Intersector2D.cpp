@@ -11,12 +11,200 @@
 
 
 #include "Intersector2D.h"
-#include <core/graphics/Shader.hpp>
-#include <core/graphics/RenderTarget.hpp>
-#include <core/graphics/Mesh.hpp>
+#include <core/system/ThreadPool.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define SIBR_INTERSECT_SSE
+#	include <emmintrin.h>
+#endif
 
 namespace sibr {
 
+	namespace {
+
+		/// Clip coordinates of a point, the frustum is -w <= x, y, z <= w.
+		typedef Eigen::Matrix<float, 4, 1, Eigen::DontAlign> Clip;
+
+		/// Signed distances to the six frustum planes, non-negative inside.
+		float planeDistance(const Clip & p, int plane)
+		{
+			const float coord = p[plane / 2];
+			return plane % 2 == 0 ? p.w() + coord : p.w() - coord;
+		}
+
+		/// Exact test: clip the triangle against each plane, it intersects the frustum if something remains.
+		bool triangleInFrustum(const Clip & a, const Clip & b, const Clip & c)
+		{
+			// Each plane adds at most one vertex to the convex polygon.
+			Clip polygon[9] = { a, b, c };
+			Clip clipped[9];
+			int n = 3;
+			for (int plane = 0; plane < 6 && n > 0; ++plane) {
+				int m = 0;
+				for (int i = 0; i < n; ++i) {
+					const Clip & cur = polygon[i];
+					const Clip & next = polygon[(i + 1) % n];
+					const float dc = planeDistance(cur, plane);
+					const float dn = planeDistance(next, plane);
+					if (dc >= 0.0f) {
+						clipped[m++] = cur;
+					}
+					if ((dc >= 0.0f) != (dn >= 0.0f)) {
+						clipped[m++] = cur + (next - cur) * (dc / (dc - dn));
+					}
+				}
+				std::copy(clipped, clipped + m, polygon);
+				n = m;
+			}
+			return n > 0;
+		}
+
+		/// The four triangles cover the convex hull of the corners whatever their order.
+		bool quadInFrustum(const Clip corners[4])
+		{
+			return triangleInFrustum(corners[0], corners[1], corners[2])
+				|| triangleInFrustum(corners[0], corners[2], corners[3])
+				|| triangleInFrustum(corners[1], corners[2], corners[3])
+				|| triangleInFrustum(corners[0], corners[1], corners[3]);
+		}
+
+		/// Classify against the planes: -1 all corners outside of a plane, 1 a corner inside, 0 unknown.
+		int classifyQuad(const Clip corners[4])
+		{
+			int outside = 0x3F;
+			for (int k = 0; k < 4; ++k) {
+				int out = 0;
+				for (int plane = 0; plane < 6; ++plane) {
+					out |= planeDistance(corners[k], plane) < 0.0f ? 1 << plane : 0;
+				}
+				if (out == 0) {
+					return 1;
+				}
+				outside &= out;
+			}
+			return outside != 0 ? -1 : 0;
+		}
+
+		/// Set the bits of the quads intersecting the frustum of a camera in a row.
+		void quadsInFrustum(const QuadArrays & quads, const sibr::Matrix4f & viewproj, size_t row, BitMatrix & result)
+		{
+			const auto clipCorners = [&](size_t q, Clip corners[4]) {
+				for (int k = 0; k < 4; ++k) {
+					corners[k] = viewproj * Clip(quads.x[k][q], quads.y[k][q], quads.z[k][q], 1.0f);
+				}
+			};
+			const size_t n = quads.size();
+			size_t q = 0;
+#ifdef SIBR_INTERSECT_SSE
+			__m128 m[16];
+			for (int i = 0; i < 16; ++i) {
+				m[i] = _mm_set1_ps(viewproj(i / 4, i % 4));
+			}
+			const __m128 zero = _mm_setzero_ps();
+			for (; q + 4 <= n; q += 4) {
+				__m128 anyInside = zero;
+				__m128 outside[6];
+				for (int p = 0; p < 6; ++p) {
+					outside[p] = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				}
+				for (int k = 0; k < 4; ++k) {
+					const __m128 x = _mm_loadu_ps(&quads.x[k][q]);
+					const __m128 y = _mm_loadu_ps(&quads.y[k][q]);
+					const __m128 z = _mm_loadu_ps(&quads.z[k][q]);
+					__m128 c[4];
+					for (int r = 0; r < 4; ++r) {
+						c[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4 * r], x), _mm_mul_ps(m[4 * r + 1], y)),
+							_mm_add_ps(_mm_mul_ps(m[4 * r + 2], z), m[4 * r + 3]));
+					}
+					__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for (int p = 0; p < 6; ++p) {
+						const __m128 d = p % 2 == 0 ? _mm_add_ps(c[3], c[p / 2]) : _mm_sub_ps(c[3], c[p / 2]);
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+						outside[p] = _mm_and_ps(outside[p], _mm_cmplt_ps(d, zero));
+					}
+					anyInside = _mm_or_ps(anyInside, inside);
+				}
+				__m128 rejected = outside[0];
+				for (int p = 1; p < 6; ++p) {
+					rejected = _mm_or_ps(rejected, outside[p]);
+				}
+				const int accept = _mm_movemask_ps(anyInside);
+				const int reject = _mm_movemask_ps(rejected);
+				for (int lane = 0; lane < 4; ++lane) {
+					if (accept & (1 << lane)) {
+						result.set(row, q + lane);
+					}
+					else if (!(reject & (1 << lane))) {
+						Clip corners[4];
+						clipCorners(q + lane, corners);
+						if (quadInFrustum(corners)) {
+							result.set(row, q + lane);
+						}
+					}
+				}
+			}
+#endif
+			for (; q < n; ++q) {
+				Clip corners[4];
+				clipCorners(q, corners);
+				const int side = classifyQuad(corners);
+				if (side > 0 || (side == 0 && quadInFrustum(corners))) {
+					result.set(row, q);
+				}
+			}
+		}
+
+	}
+
+	QuadArrays::QuadArrays(const std::vector<quad> & quads)
+	{
+		for (int k = 0; k < 4; ++k) {
+			x[k].reserve(quads.size());
+			y[k].reserve(quads.size());
+			z[k].reserve(quads.size());
+		}
+		for (const quad & q : quads) {
+			push_back(q);
+		}
+	}
+
+	void QuadArrays::push_back(const quad & q)
+	{
+		const sibr::Vector3f * corners[4] = { &q.q1, &q.q2, &q.q3, &q.q4 };
+		for (int k = 0; k < 4; ++k) {
+			x[k].push_back(corners[k]->x());
+			y[k].push_back(corners[k]->y());
+			z[k].push_back(corners[k]->z());
+		}
+	}
+
+	BitMatrix::BitMatrix(size_t rows, size_t cols) :
+		_rows(rows), _cols(cols), _stride((cols + 63) / 64), _words(rows * ((cols + 63) / 64), 0)
+	{
+	}
+
+	size_t BitMatrix::count(size_t r) const
+	{
+		size_t total = 0;
+		for (size_t w = 0; w < _stride; ++w) {
+			for (uint64_t bits = row(r)[w]; bits != 0; bits &= bits - 1) {
+				++total;
+			}
+		}
+		return total;
+	}
+
+	std::vector<std::vector<bool>> BitMatrix::toVectors(void) const
+	{
+		std::vector<std::vector<bool>> result(_rows, std::vector<bool>(_cols, false));
+		for (size_t r = 0; r < _rows; ++r) {
+			for (size_t c = 0; c < _cols; ++c) {
+				result[r][c] = (*this)(r, c);
+			}
+		}
+		return result;
+	}
+
 
 	float Intersector2D::sign(sibr::Vector2f p1, sibr::Vector2f p2, sibr::Vector2f p3)
 	{
@@ -114,106 +302,17 @@ namespace sibr {
 
 	std::vector<std::vector<bool>> Intersector2D::frustrumQuadsIntersect(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams)
 	{
-		std::clock_t previous;
-		double duration;
-		previous = std::clock();
-
-		std::vector<std::vector<bool>> result(cams.size(), std::vector<bool>(quads.size(), false));
-
-		sibr::GLShader				shader;
-		sibr::GLParameter			shader_proj;
-
-
-		std::string vertexShader =
-			"#version 420\n"
-			"uniform mat4 MVP;\n"
-			"layout(location = 0) in vec3 in_vertex;\n"
-			"void main(void) {\n"
-			"	gl_Position = MVP * vec4(in_vertex, 1.0);\n"
-			"}\n";
-
-
-		std::string fragmentShader =
-			"#version 420\n"
-			"out float out_color;\n"
-			"void main(void) {\n"
-			"		out_color = 1.0;\n"
-			"}\n";
-
-		shader.init("quadShader", vertexShader, fragmentShader);
-		shader_proj.init(shader, "MVP");
-
-		std::shared_ptr<sibr::RenderTargetLum> rtLum;
-
-		for (int c = 0; c < cams.size(); c++) {
-			const sibr::InputCamera & cam = *cams[c];
-
-			float ratio = (float)cam.h() / (float)cam.w();
-			int w = std::min(400, (int)cam.w());
-			int h = int(w*ratio);
-
-			rtLum.reset(new sibr::RenderTargetLum(w, h));
-
-			for (int q = 0; q < quads.size(); q++) {
-
-				quad & quad = quads[q];
-
-				sibr::ImageL8 imLum;
-
-				std::shared_ptr<sibr::Mesh> quadMesh = std::shared_ptr<sibr::Mesh>(new sibr::Mesh(true));
-
-				std::vector<sibr::Vector3f> vertexBuffer;
-				vertexBuffer.push_back(quad.q1);
-				vertexBuffer.push_back(quad.q2);
-				vertexBuffer.push_back(quad.q3);
-				vertexBuffer.push_back(quad.q4);
-
-				int indices[12] = { 0, 1, 2, 0, 2, 3, 1, 2, 3, 0, 1, 3 }; //triangle added, can be optimized if quad ensured with good order
-				std::vector<uint> indicesBuffer(&indices[0], &indices[0] + 12);
-
-				quadMesh->vertices(vertexBuffer);
-				quadMesh->triangles(indicesBuffer);
-
-				glViewport(0, 0, w, h);
-				rtLum->bind();
-				glClearColor(0.0, 0.0, 0.0, 0.0);
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-				shader.begin();
-				shader_proj.set(cam.viewproj());
-
-				quadMesh->render(false, false, sibr::Mesh::RenderMode::FillRenderMode);
-
-				shader.end();
-
-				rtLum->readBack(imLum);
-
-				bool nonBlack = false;
-				bool breakLoop = false;
-				for (int j = 0; j < (int)(rtLum->h()); j++) {
-					for (int i = 0; i < (int)(rtLum->w()); i++) {
-						if (imLum(i, j).x() != 0) {
-							nonBlack = true;
-							breakLoop = true;
-							break;
-						}
-					}
-					if (breakLoop)
-						break;
-				}
-
-				//std::cout << "result " << q << " : " << nonBlack << std::endl;
-				if (nonBlack)
-					result[c][q] = true;
-
-			}
-		}
-
-		duration = (std::clock() - previous) / (double)CLOCKS_PER_SEC;
-		std::cout << "render : " << duration << std::endl;
-		previous = std::clock();
+		return frustrumQuadsIntersect(QuadArrays(quads), cams).toVectors();
+	}
 
+	BitMatrix Intersector2D::frustrumQuadsIntersect(const QuadArrays & quads, const std::vector<InputCamera::Ptr> & cams)
+	{
+		// Rows start on their own words, each camera sets its row.
+		BitMatrix result(cams.size(), quads.size());
+		sibr::ThreadPool::shared().parallelFor(0, int(cams.size()), [&](int c) {
+			quadsInFrustum(quads, cams[c]->viewproj(), size_t(c), result);
+		});
 		return result;
 	}
 
-}
+}
\ No newline at end of file
@@ -14,6 +14,7 @@
 
 #include "core/raycaster/Config.hpp"
 #include <vector>
+#include <cstdint>
 #include <core/system/Vector.hpp>
 #include <core/assets/InputCamera.hpp>
 
@@ -58,6 +59,93 @@ struct  quad {
 
 namespace sibr {
 
+	/** Quads stored as a structure of arrays, one array per corner coordinate, for batched tests.
+	\ingroup sibr_raycaster
+	*/
+	struct SIBR_RAYCASTER_EXPORT QuadArrays {
+
+		std::vector<float> x[4]; ///< X coordinate of each corner.
+		std::vector<float> y[4]; ///< Y coordinate of each corner.
+		std::vector<float> z[4]; ///< Z coordinate of each corner.
+
+		/// Constructor.
+		QuadArrays(void) = default;
+
+		/** Constructor from quads.
+		\param quads the quads to copy
+		*/
+		QuadArrays(const std::vector<quad> & quads);
+
+		/** Append a quad.
+		\param q the quad
+		*/
+		void push_back(const quad & q);
+
+		/** \return the number of quads. */
+		size_t size(void) const { return x[0].size(); }
+
+		/** \return a corner of a quad.
+		\param i the quad index
+		\param k the corner index, in 0..3
+		*/
+		sibr::Vector3f corner(size_t i, int k) const { return sibr::Vector3f(x[k][i], y[k][i], z[k][i]); }
+	};
+
+	/** Boolean matrix packed in 64-bit words, each row starting on a new word.
+	\ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT BitMatrix {
+
+	public:
+
+		/** Constructor, all bits cleared.
+		\param rows the number of rows
+		\param cols the number of columns
+		*/
+		BitMatrix(size_t rows = 0, size_t cols = 0);
+
+		/** \return the value of an element.
+		\param r the row
+		\param c the column
+		*/
+		bool operator()(size_t r, size_t c) const { return (_words[r * _stride + c / 64] >> (c % 64)) & 1u; }
+
+		/** Set an element. Different rows can be set concurrently.
+		\param r the row
+		\param c the column
+		*/
+		void set(size_t r, size_t c) { _words[r * _stride + c / 64] |= uint64_t(1) << (c % 64); }
+
+		/** \return the words of a row, 64 columns each.
+		\param r the row
+		*/
+		const uint64_t * row(size_t r) const { return _words.data() + r * _stride; }
+
+		/** \return the number of set elements in a row.
+		\param r the row
+		*/
+		size_t count(size_t r) const;
+
+		/** \return the number of rows. */
+		size_t rows(void) const { return _rows; }
+
+		/** \return the number of columns. */
+		size_t cols(void) const { return _cols; }
+
+		/** \return the number of words per row. */
+		size_t stride(void) const { return _stride; }
+
+		/** \return the matrix as nested vectors of booleans. */
+		std::vector<std::vector<bool>> toVectors(void) const;
+
+	private:
+
+		size_t _rows = 0; ///< Number of rows.
+		size_t _cols = 0; ///< Number of columns.
+		size_t _stride = 0; ///< Words per row.
+		std::vector<uint64_t> _words; ///< Packed bits.
+	};
+
 
 	/** This class provides utilities to compute point/line/triangle/quad intersections.
 	\ingroup sibr_raycaster
@@ -131,13 +219,23 @@ namespace sibr {
 
 		/**
 		Perform multiple quads/camera frusta intersections at once.
-		\warning Requires an existing and current OpenGL context.
 		\param quads an array of quads to test against each camera frustum.
 		\param cams an array of cameras against which frusta the intersections tests should be performed.
 		\return a double-array of booleans denoting, for each camera, for each quad, if the quad intersects the frustum volume.
+		\sa the QuadArrays version, that avoids the conversions.
 		*/
 		static std::vector<std::vector<bool>> frustrumQuadsIntersect(std::vector<quad> & quads, const std::vector<InputCamera::Ptr> & cams);
 
+		/**
+		Perform multiple quads/camera frusta intersections at once, cameras in parallel. A quad intersects a frustum
+		if the convex hull of its corners does. Quads are classified four at a time against the clip planes, the
+		few that are neither fully outside a plane nor have a corner inside are clipped exactly.
+		\param quads the quads to test against each camera frustum.
+		\param cams the cameras against which frusta the intersections tests should be performed.
+		\return a matrix with a row per camera and a column per quad, set if the quad intersects the frustum volume.
+		*/
+		static BitMatrix frustrumQuadsIntersect(const QuadArrays & quads, const std::vector<InputCamera::Ptr> & cams);
+
 	};
 
 }
\ No newline at end of file
@@ -14,6 +14,11 @@
 
 #include "Config.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+
 #include "core/system/Vector.hpp"
 #include "nanoflann/nanoflann.hpp"
 
@@ -24,31 +29,55 @@ namespace sibr {
 	 * \brief Represent a 3D hierachical query structure baked by a nanoflann KdTree.
 	 * \note With the default L2 distance, all distances and radii are expected to be 
 	 * the squared values (this is a nanoflann constraint). For other metrics, use the distance directly.
+	 * \note For large point clouds, the points can be split in spatial slabs, each with its own tree,
+	 * so that the trees are built in parallel. Queries then have to visit all trees, use it when the build time matters.
 	 * \ingroup sibr_raycaster
 	 */
 	template <typename num_t = double, class Distance = nanoflann::metric_L2>
 	class  KdTree
 	{
 		SIBR_CLASS_PTR(KdTree);
+		SIBR_DISALLOW_COPY(KdTree);
 	
 	public:
 
 		typedef	Eigen::Matrix<num_t, 3, 1, Eigen::DontAlign> Vector3X;
 		typedef KdTree<num_t, Distance> self_t;
-		typedef typename Distance::template traits<num_t, self_t>::distance_t metric_t;
-		typedef nanoflann::KDTreeSingleIndexAdaptor< metric_t, self_t, 3, size_t>  index_t;
+
+		/// Adapter exposing a contiguous range of the stored points to nanoflann.
+		struct Subset {
+			const std::vector<Vector3X> * points; ///< All stored points.
+			size_t offset; ///< First point of the range.
+			size_t count; ///< Number of points in the range.
+
+			/// Interface expected by nanoflann for an adapter.
+			const Subset & derived() const { return *this; }
+			/// Interface expected by nanoflann for an adapter.
+			Subset & derived() { return *this; }
+			/// Interface: Must return the number of data points
+			inline size_t kdtree_get_point_count() const { return count; }
+			/// Interface: Returns the dim'th component of the idx'th point in the class:
+			inline num_t kdtree_get_pt(const size_t idx, const size_t dim) const { return (*points)[offset + idx][dim]; }
+			/// Interface: Optional bounding-box computation: \return false to default to a standard bbox computation loop.
+			template <class BBOX>
+			bool kdtree_get_bbox(BBOX & /*bb*/) const { return false; }
+		};
+
+		typedef typename Distance::template traits<num_t, Subset>::distance_t metric_t;
+		typedef nanoflann::KDTreeSingleIndexAdaptor< metric_t, Subset, 3, size_t>  index_t;
 		typedef std::vector<std::pair<size_t, num_t>> Results;
 
+		/// Index returned for missing neighbours in batched queries.
+		static const size_t kInvalidId = size_t(-1);
+
 		/**
 		 * Constructor.
 		 * The KdTree will do a copy of the positions vector.
 		 * \param positions a list of 3D points
 		 * \param leafMaxSize maximum number of points per leaf
+		 * \param subtreesCount number of trees to build in parallel, each over a slab of the points
 		 */
-		KdTree(const std::vector<Vector3X> & positions, size_t leafMaxSize = 10);
-
-		/** Destructor. */
-		~KdTree();
+		KdTree(const std::vector<Vector3X> & positions, size_t leafMaxSize = 10, size_t subtreesCount = 1);
 
 		/** Get the closest point stored in the KdTree for the specified distance
 		* \param pos the reference point
@@ -64,6 +93,14 @@ namespace sibr {
 		*/
 		void getClosest(const Vector3X & pos, size_t count, Results & idDistSqs) const;
 
+		/** Get the closest points of many reference points, in parallel.
+		* \param positions the reference points
+		* \param count the number of neighbours to query per reference point
+		* \param ids will contain count indices per reference point, closest first, kInvalidId if the tree has less than count points
+		* \param distanceSqs will contain the matching squared distances, the max num_t value for missing neighbours
+		*/
+		void getClosest(const std::vector<Vector3X> & positions, size_t count, std::vector<size_t> & ids, std::vector<num_t> & distanceSqs) const;
+
 		/** Get all points in a sphere of a given radius around a reference point.
 		 *\param pos the reference point
 		 *\param maxDistanceSq the squared sphere radius
@@ -72,57 +109,150 @@ namespace sibr {
 		 */
 		void getNeighbors(const Vector3X & pos, double maxDistanceSq, bool sorted, Results & idDistSqs) const;
 
-		/// Interface expected by nanoflann for an adapter.
-		const self_t & derived() const {
-			return *this;
-		}
-
-		/// Interface expected by nanoflann for an adapter.
-		self_t & derived() {
-			return *this;
-		}
+		/** Get all points in a sphere of a given radius around many reference points, in parallel.
+		 *\param positions the reference points
+		 *\param maxDistanceSq the squared sphere radius
+		 *\param sorted should the points be sorted in ascending distance order
+		 *\param offsets will contain positions.size()+1 offsets, the neighbours of point i are in [offsets[i], offsets[i+1])
+		 *\param ids will contain the indices of the neighbours of all reference points
+		 *\param distanceSqs will contain the matching squared distances
+		 */
+		void getNeighbors(const std::vector<Vector3X> & positions, double maxDistanceSq, bool sorted,
+			std::vector<size_t> & offsets, std::vector<size_t> & ids, std::vector<num_t> & distanceSqs) const;
 
-		/// Interface: Must return the number of data points
+		/// \return the number of points stored in the tree.
 		inline size_t kdtree_get_point_count() const {
 			return _points.size();
 		}
 
-		/// Interface: Returns the dim'th component of the idx'th point in the class:
-		inline num_t kdtree_get_pt(const size_t idx, const size_t dim) const {
-			return _points[idx][dim];
-		}
+	private:
 
-		/// Interface: Optional bounding-box computation: \return false to default to a standard bbox computation loop.
-		template <class BBOX>
-		bool kdtree_get_bbox(BBOX & /*bb*/) const {
-			return false;
+		/// Scratch storage reused across queries by a thread.
+		struct QueryBuffer {
+			std::vector<size_t> ids; ///< Per-tree neighbour indices.
+			std::vector<num_t> distanceSqs; ///< Per-tree neighbour distances.
+			std::vector<std::pair<num_t, size_t>> candidates; ///< Neighbours from all trees.
+			Results results; ///< Per-tree radius results.
+		};
+
+		/// \return the input index of the id-th point of a tree.
+		size_t globalId(size_t tree, size_t id) const {
+			const size_t local = _subsets[tree].offset + id;
+			return _ids.empty() ? local : _ids[local];
 		}
 
-	private:
+		/// Find the count closest points, closest first. \return the number of points found.
+		size_t knn(const Vector3X & pos, size_t count, size_t * ids, num_t * distanceSqs, QueryBuffer & buffer) const;
 
-		const std::vector<Vector3X> _points;
-		index_t * _index;
+		/// Find the points in a sphere.
+		void radius(const Vector3X & pos, double maxDistanceSq, bool sorted, Results & idDistSqs, QueryBuffer & buffer) const;
+
+		std::vector<Vector3X> _points; ///< Points, ordered by tree.
+		std::vector<size_t> _ids; ///< Input index of each point, empty when there is a single tree.
+		std::vector<Subset> _subsets; ///< Range of points of each tree.
+		std::vector<std::unique_ptr<index_t>> _indices; ///< Trees.
 	};
 
 	template <typename num_t, class Distance>
-	KdTree<num_t, Distance>::KdTree(const std::vector<Vector3X>& positions, size_t leafMaxSize) : _points(positions) {
+	const size_t KdTree<num_t, Distance>::kInvalidId;
+
+	template <typename num_t, class Distance>
+	KdTree<num_t, Distance>::KdTree(const std::vector<Vector3X>& positions, size_t leafMaxSize, size_t subtreesCount) : _points(positions) {
 		if(positions.empty()) {
 			SIBR_ERR << "[KdTree] Trying to build a Kd-Tree from an empty list of points." << std::endl;
 		}
-		_index = new index_t(3, *this, nanoflann::KDTreeSingleIndexAdaptorParams(leafMaxSize));
-		_index->buildIndex();
+		const size_t pointsCount = positions.size();
+		// Keep at least a few leaves per tree.
+		const size_t treesCount = std::max(size_t(1), std::min(subtreesCount, pointsCount / std::max(size_t(1), 16 * leafMaxSize)));
+
+		std::vector<size_t> bounds(treesCount + 1);
+		for (size_t t = 0; t <= treesCount; ++t) {
+			bounds[t] = t * pointsCount / treesCount;
+		}
+
+		if (treesCount > 1) {
+			// Split the points in slabs along the largest extent of their bounding box.
+			Eigen::AlignedBox<num_t, 3> box;
+			for (const Vector3X & p : positions) {
+				box.extend(p);
+			}
+			int axis = 0;
+			box.sizes().maxCoeff(&axis);
+			_ids.resize(pointsCount);
+			std::iota(_ids.begin(), _ids.end(), size_t(0));
+			const auto compare = [&positions, axis](size_t a, size_t b) { return positions[a][axis] < positions[b][axis]; };
+			for (size_t t = 1; t < treesCount; ++t) {
+				std::nth_element(_ids.begin() + bounds[t - 1], _ids.begin() + bounds[t], _ids.end(), compare);
+			}
+			for (size_t i = 0; i < pointsCount; ++i) {
+				_points[i] = positions[_ids[i]];
+			}
+		}
+
+		// The trees keep a reference to their subset, fill them all before building.
+		_subsets.resize(treesCount);
+		_indices.resize(treesCount);
+		for (size_t t = 0; t < treesCount; ++t) {
+			_subsets[t] = { &_points, bounds[t], bounds[t + 1] - bounds[t] };
+		}
+
+		const int64_t trees = int64_t(treesCount);
+#pragma omp parallel for if(trees > 1) schedule(dynamic, 1)
+		for (int64_t t = 0; t < trees; ++t) {
+			_indices[t].reset(new index_t(3, _subsets[t], nanoflann::KDTreeSingleIndexAdaptorParams(leafMaxSize)));
+			_indices[t]->buildIndex();
+		}
 	}
 
-	template<typename num_t, class Distance>
-	KdTree<num_t, Distance>::~KdTree()
-	{
-		delete _index;
+	template <typename num_t, class Distance>
+	size_t KdTree<num_t, Distance>::knn(const Vector3X & pos, size_t count, size_t * ids, num_t * distanceSqs, QueryBuffer & buffer) const {
+		if (_indices.size() == 1) {
+			const size_t foundCount = _indices[0]->knnSearch(&pos[0], count, ids, distanceSqs);
+			return foundCount;
+		}
+		buffer.ids.resize(count);
+		buffer.distanceSqs.resize(count);
+		buffer.candidates.clear();
+		for (size_t t = 0; t < _indices.size(); ++t) {
+			const size_t foundCount = _indices[t]->knnSearch(&pos[0], count, &buffer.ids[0], &buffer.distanceSqs[0]);
+			for (size_t i = 0; i < foundCount; ++i) {
+				buffer.candidates.emplace_back(buffer.distanceSqs[i], globalId(t, buffer.ids[i]));
+			}
+		}
+		const size_t foundCount = std::min(count, buffer.candidates.size());
+		std::partial_sort(buffer.candidates.begin(), buffer.candidates.begin() + foundCount, buffer.candidates.end());
+		for (size_t i = 0; i < foundCount; ++i) {
+			distanceSqs[i] = buffer.candidates[i].first;
+			ids[i] = buffer.candidates[i].second;
+		}
+		return foundCount;
+	}
+
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::radius(const Vector3X & pos, double maxDistanceSq, bool sorted, Results & idDistSqs, QueryBuffer & buffer) const {
+		if (_indices.size() == 1) {
+			_indices[0]->radiusSearch(&pos[0], float(maxDistanceSq), idDistSqs, nanoflann::SearchParams(32, 0.0f, sorted));
+			return;
+		}
+		idDistSqs.clear();
+		for (size_t t = 0; t < _indices.size(); ++t) {
+			_indices[t]->radiusSearch(&pos[0], float(maxDistanceSq), buffer.results, nanoflann::SearchParams(32, 0.0f, false));
+			for (const auto & result : buffer.results) {
+				idDistSqs.emplace_back(globalId(t, result.first), result.second);
+			}
+		}
+		if (sorted) {
+			std::sort(idDistSqs.begin(), idDistSqs.end(), [](const std::pair<size_t, num_t> & a, const std::pair<size_t, num_t> & b) {
+				return a.second < b.second;
+			});
+		}
 	}
 
 	template <typename num_t, class Distance>
 	inline size_t KdTree<num_t, Distance>::getClosest(const Vector3X& pos, num_t & distanceSq) const {
 		size_t index = 0;
-		_index->knnSearch(&pos[0], 1, &index, &distanceSq);
+		QueryBuffer buffer;
+		knn(pos, 1, &index, &distanceSq, buffer);
 		return index;
 	}
 
@@ -130,18 +260,77 @@ namespace sibr {
 	inline void KdTree<num_t, Distance>::getClosest(const Vector3X & pos, size_t count, Results & idDistSqs) const {
 		std::vector<size_t> outIds(count);
 		std::vector<num_t> outDists(count);
-		const size_t foundCount = _index->knnSearch(&pos[0], count, &outIds[0], &outDists[0]);
+		QueryBuffer buffer;
+		const size_t foundCount = knn(pos, count, &outIds[0], &outDists[0], buffer);
 		idDistSqs.resize(foundCount);
 		for(size_t i = 0; i < foundCount; ++i) {
 			idDistSqs[i] = std::make_pair(outIds[i], outDists[i]);
 		}
 	}
 
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::getClosest(const std::vector<Vector3X> & positions, size_t count, std::vector<size_t> & ids, std::vector<num_t> & distanceSqs) const {
+		const int64_t positionsCount = int64_t(positions.size());
+		ids.assign(positions.size() * count, kInvalidId);
+		distanceSqs.assign(positions.size() * count, std::numeric_limits<num_t>::max());
+		if (count == 0) {
+			return;
+		}
+#pragma omp parallel
+		{
+			QueryBuffer buffer;
+#pragma omp for schedule(dynamic, 256)
+			for (int64_t pid = 0; pid < positionsCount; ++pid) {
+				knn(positions[pid], count, &ids[pid * count], &distanceSqs[pid * count], buffer);
+			}
+		}
+	}
+
 	template <typename num_t, class Distance>
 	inline void KdTree<num_t, Distance>::getNeighbors(const Vector3X & pos, double maxDistanceSq, bool sorted, Results & idDistSqs) const {
-		_index->radiusSearch(&pos[0], float(maxDistanceSq), idDistSqs, nanoflann::SearchParams(32, 0.0f, sorted));
+		QueryBuffer buffer;
+		radius(pos, maxDistanceSq, sorted, idDistSqs, buffer);
 	}
 
+	template <typename num_t, class Distance>
+	void KdTree<num_t, Distance>::getNeighbors(const std::vector<Vector3X> & positions, double maxDistanceSq, bool sorted,
+		std::vector<size_t> & offsets, std::vector<size_t> & ids, std::vector<num_t> & distanceSqs) const {
+		// Each block of reference points is queried by a single thread into its own arrays, then all are concatenated.
+		const size_t blockSize = 1024;
+		const size_t positionsCount = positions.size();
+		const int64_t blocksCount = int64_t((positionsCount + blockSize - 1) / blockSize);
+		std::vector<Results> blocks(blocksCount);
+		offsets.assign(positionsCount + 1, 0);
 
-} /*namespace sibr*/ 
+#pragma omp parallel
+		{
+			QueryBuffer buffer;
+			Results results;
+#pragma omp for schedule(dynamic, 1)
+			for (int64_t bid = 0; bid < blocksCount; ++bid) {
+				const size_t end = std::min(positionsCount, size_t(bid + 1) * blockSize);
+				for (size_t pid = size_t(bid) * blockSize; pid < end; ++pid) {
+					radius(positions[pid], maxDistanceSq, sorted, results, buffer);
+					offsets[pid + 1] = results.size();
+					blocks[bid].insert(blocks[bid].end(), results.begin(), results.end());
+				}
+			}
+		}
 
+		for (size_t pid = 0; pid < positionsCount; ++pid) {
+			offsets[pid + 1] += offsets[pid];
+		}
+		ids.resize(offsets.back());
+		distanceSqs.resize(offsets.back());
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int64_t bid = 0; bid < blocksCount; ++bid) {
+			const size_t start = offsets[size_t(bid) * blockSize];
+			for (size_t i = 0; i < blocks[bid].size(); ++i) {
+				ids[start + i] = blocks[bid][i].first;
+				distanceSqs[start + i] = blocks[bid][i].second;
+			}
+		}
+	}
+
+
+} /*namespace sibr*/ 
@@ -15,9 +15,56 @@
 
 typedef Eigen::Array<bool, Eigen::Dynamic, 1> ArrayXb;
 
-PlaneEstimator::PlaneEstimator() {}
+namespace {
+
+	/// Number of points used to estimate the score of a hypothesis before evaluating it on all points.
+	const int kPreemptiveSamples = 1024;
+	/// Hypotheses with an estimated score below this fraction of the best score are rejected.
+	const float kPreemptiveRatio = 0.75f;
+	/// Number of hypotheses generated between two termination tests.
+	const int kRoundSize = 64;
+	/// Probability of having drawn at least one outlier-free sample when terminating early.
+	const double kConfidence = 0.999;
+	/// Default normal validity threshold.
+	const float kNormalDot = 0.98f;
+
+	/** Score a plane against points stored by columns (see PlaneEstimator::votePlane).
+	\param points the points, one per row
+	\param normals the associated normals
+	\param count the number of points to consider, from the first row
+	\param plane the plane parameters
+	\param delta validity threshold
+	\param normalDot normal validity threshold
+	\return number of points that fit and overall weighted score
+	*/
+	std::pair<int, float> scorePlane(const Eigen::MatrixXf & points, const Eigen::MatrixXf & normals, int count, const sibr::Vector4f & plane, float delta, float normalDot)
+	{
+		const float * xs = points.col(0).data();
+		const float * ys = points.col(1).data();
+		const float * zs = points.col(2).data();
+		const float * nxs = normals.col(0).data();
+		const float * nys = normals.col(1).data();
+		const float * nzs = normals.col(2).data();
+		const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+		const float bias = 0.1f * delta;
+		int votes = 0;
+		float score = 0.0f;
+		// Branchless so that the compiler can vectorize it.
+		for (int i = 0; i < count; ++i) {
+			const float dist = std::abs(a * xs[i] + b * ys[i] + c * zs[i] - d);
+			const float dot = std::abs(a * nxs[i] + b * nys[i] + c * nzs[i]);
+			const int inlier = int(dist < delta) & (int(dot > normalDot) | int(dot == 0.0f));
+			votes += inlier;
+			score += float(inlier) / (dist + bias);
+		}
+		return std::make_pair(votes, score);
+	}
+
+}
+
+PlaneEstimator::PlaneEstimator() : _generator(std::random_device()()) {}
 
-PlaneEstimator::PlaneEstimator(const std::vector<sibr::Vector3f> & vertices, bool excludeBB)
+PlaneEstimator::PlaneEstimator(const std::vector<sibr::Vector3f> & vertices, bool excludeBB) : _generator(std::random_device()())
 {
 
 	Eigen::AlignedBox<float, 3> boxScaled;
@@ -33,7 +80,7 @@ PlaneEstimator::PlaneEstimator(const std::vector<sibr::Vector3f> & vertices, boo
 	}
 	int bboxReject = 0;
 	if (vertices.size() > 200000) {
-		std::cout << "Found more than 200000 points reducing point cloud size ..." << std::endl;
+		SIBR_LOG << "Found more than 200000 points reducing point cloud size ..." << std::endl;
 
 		std::random_device rd;
 		std::mt19937 mt(rd());
@@ -51,15 +98,16 @@ PlaneEstimator::PlaneEstimator(const std::vector<sibr::Vector3f> & vertices, boo
 		}
 
 		if (excludeBB)
-			std::cout << bboxReject << " points where rejected becaused considered on the bounding box" << std::endl;
+			SIBR_LOG << bboxReject << " points where rejected becaused considered on the bounding box" << std::endl;
 	}
 	else {
 		_Points = vertices;
 	}
-	std::cout << "Point Cloud size: " << _Points.size() << std::endl;
+	SIBR_LOG << "Point Cloud size: " << _Points.size() << std::endl;
 	_numPoints3D = (int)_Points.size();
 	_remainPoints3D.resize(_Points.size(), 3);
 	_remainNormals3D.resize(_Points.size(), 3);
+	_remainCount = _numPoints3D;
 
 	for (int i = 0; i < _Points.size(); i++) {
 		_remainPoints3D.row(i) = _Points[i];
@@ -75,12 +123,12 @@ void PlaneEstimator::computePlanes(const int numPlane, const  float delta, const
 
 	_planeComputed = true; // we know that the planes were computed
 
-	std::cout << "Original number of points " << _remainPoints3D.rows() << std::endl;
+	SIBR_LOG << "Original number of points " << _remainCount << std::endl;
 	for (int i = 0; i < numPlane; i++) {
 
-		if (_remainPoints3D.rows() < _numPoints3D * 5 / 100)
+		if (_remainCount < _numPoints3D * 5 / 100)
 		{
-			std::cout << "Not enough points remaining, stop searching. " << i << " planes found." << std::endl;
+			SIBR_LOG << "Not enough points remaining, stop searching. " << i << " planes found." << std::endl;
 			break;
 		}
 
@@ -94,22 +142,21 @@ void PlaneEstimator::computePlanes(const int numPlane, const  float delta, const
 		sibr::Vector4f plane = estimatePlane(delta, numTry, mask, vote, covMean);
 
 		if (vote < _numPoints3D * 2 / 100 && i >= 12) {
-			std::cout << "Not enough points in candidate plane, stop searching. " << i << " planes found." << std::endl;
+			SIBR_LOG << "Not enough points in candidate plane, stop searching. " << i << " planes found." << std::endl;
 			break;
 		}
 		//
 
-		Eigen::MatrixXf remainPoints3DTemp(_remainPoints3D.rows() - vote, 3);
-		Eigen::MatrixXf remainNormals3DTemp(_remainNormals3D.rows() - vote, 3);
-		//std::vector<sibr::Vector3i> remainImPosTemp;
-
+		// Compact the remaining points in place.
 		int notSel = 0;
 		std::vector<sibr::Vector3f> pointsPlane;
-		for (int rIt = 0; rIt < _remainPoints3D.rows(); rIt++) {
-			if (mask.row(rIt)(0) == 0) { // not selected
-				remainPoints3DTemp.row(notSel) = _remainPoints3D.row(rIt);
-				remainNormals3DTemp.row(notSel) = _remainNormals3D.row(rIt);
-				//remainImPosTemp.push_back(_remainImPos[rIt]);
+		pointsPlane.reserve(vote);
+		for (int rIt = 0; rIt < _remainCount; rIt++) {
+			if (mask(rIt, 0) == 0) { // not selected
+				if (notSel != rIt) {
+					_remainPoints3D.row(notSel) = _remainPoints3D.row(rIt);
+					_remainNormals3D.row(notSel) = _remainNormals3D.row(rIt);
+				}
 				notSel++;
 			}
 
@@ -118,11 +165,7 @@ void PlaneEstimator::computePlanes(const int numPlane, const  float delta, const
 			}
 		}
 
-		std::cout << "vote :" << vote << " notSel " << notSel << " supposed total " << _remainPoints3D.rows() << std::endl;
-		_remainPoints3D = remainPoints3DTemp;
-		_remainNormals3D = remainNormals3DTemp;
-		//_remainImPos=remainImPosTemp;
-		std::cout << "Remaining number of points " << _remainPoints3D.rows() << std::endl;
+		_remainCount = notSel;
 
 		sibr::Vector3f center = plane.w()*plane.xyz();
 
@@ -142,32 +185,74 @@ void PlaneEstimator::computePlanes(const int numPlane, const  float delta, const
 
 sibr::Vector4f PlaneEstimator::estimatePlane(const float delta, const int numTry, Eigen::MatrixXi & bestMask, int & bestVote, std::pair<Eigen::MatrixXf, sibr::Vector3f> & bestCovMean) {
 
-	sibr::Vector4f bestPlane;
+	sibr::Vector4f bestPlane(0.0f, 0.0f, 0.0f, 0.0f);
+	bestVote = 0;
+
+	// Random subset of the points for preemptive scoring.
+	const int samplesCount = std::min(_remainCount, kPreemptiveSamples);
+	Eigen::MatrixXf samples(samplesCount, 3), samplesNormals(samplesCount, 3);
+	std::uniform_int_distribution<int> samplesDis(0, _remainCount - 1);
+	for (int s = 0; s < samplesCount; ++s) {
+		const int r = samplesCount == _remainCount ? s : samplesDis(_generator);
+		samples.row(s) = _remainPoints3D.row(r);
+		samplesNormals.row(s) = _remainNormals3D.row(r);
+	}
+	const float samplesScale = float(_remainCount) / float(std::max(samplesCount, 1));
 
 	float bestWVote = 0;
-#pragma omp parallel for
-	for (int i = 0; i < numTry; i++) {
-
-		Eigen::MatrixXi mask;
-		sibr::Vector4f plane = plane3Pts();
-		if (plane.xyz().norm() > 0) {
-			std::pair<int, float> votePair = votePlane(plane, delta, mask);
+	int tried = 0;
+	int maxTries = numTry;
+	std::vector<sibr::Vector4f> hypotheses;
+	while (tried < maxTries) {
+		// Sampling is sequential to share the generator.
+		hypotheses.resize(std::min(kRoundSize, maxTries - tried));
+		for (sibr::Vector4f & plane : hypotheses) {
+			plane = plane3Pts();
+		}
+		tried += int(hypotheses.size());
+		const float rejectScore = kPreemptiveRatio * bestWVote;
+
+		const int hypothesesCount = int(hypotheses.size());
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < hypothesesCount; i++) {
+			const sibr::Vector4f & plane = hypotheses[i];
+			if (!(plane.xyz().norm() > 0)) {
+				continue;
+			}
+			// Reject hypotheses that are unlikely to beat the current best one.
+			if (samplesScale * scorePlane(samples, samplesNormals, samplesCount, plane, delta, kNormalDot).second < rejectScore) {
+				continue;
+			}
+			const std::pair<int, float> votePair = scorePlane(_remainPoints3D, _remainNormals3D, _remainCount, plane, delta, kNormalDot);
 
 #pragma omp critical
 			{
-				//std::cout << i << " ";
 				if (votePair.second > bestWVote) {
 					bestWVote = votePair.second;
 					bestVote = votePair.first;
 					bestPlane = plane;
-					bestMask = std::move(mask); // move to avoid copy
 				}
 			}
 		}
 
+		// Number of tries needed to draw three inliers of the best plane with the required confidence.
+		const double allInliers = std::pow(double(bestVote) / double(_remainCount), 3.0);
+		if (allInliers >= 1.0) {
+			break;
+		}
+		if (allInliers > 0.0) {
+			const double requiredTries = std::ceil(std::log(1.0 - kConfidence) / std::log(1.0 - allInliers));
+			maxTries = int(std::min(double(numTry), requiredTries));
+		}
+	}
+	// Only the selected plane needs a mask.
+	if (bestWVote > 0.0f) {
+		bestVote = votePlane(bestPlane, delta, bestMask, kNormalDot).first;
+	} else {
+		bestMask = Eigen::MatrixXi::Zero(_remainCount, 1);
+		bestVote = 0;
 	}
 
-	std::cout << "Best vote " << bestVote << " Best plane " << bestPlane << std::endl;
 	/*
 	std::cout << "Plane refinement ..." << std::endl;
 
@@ -208,13 +293,10 @@ sibr::Vector4f PlaneEstimator::estimatePlane(const float delta, const int numTry
 
 	bestVote = votePlane(bestPlane, 10.0*delta, bestMask, 0.8f).first;*/
 
-	std::cout << " new normal" << " " << bestPlane.xyz() << std::endl;
 	// normal coherency
 	//Eigen::ArrayXf dotWithOriNormal=(_remainNormals3D * bestPlane.xyz()).array().cwiseAbs();
 	//bestMaskNormals = (bestMask.array().cast<float>()*dotWithOriNormal);
 
-	std::cout << "Vote refined " << bestVote << " Plane refined " << bestPlane << /*" Normals coherency " << bestMaskNormals.sum()/bestVote  <<*/ std::endl;
-
 	return bestPlane;
 
 }
@@ -222,13 +304,11 @@ sibr::Vector4f PlaneEstimator::estimatePlane(const float delta, const int numTry
 
 sibr::Vector4f PlaneEstimator::plane3Pts() {
 
-	std::random_device rd;  //Will be used to obtain a seed for the random number engine
-	std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-	std::uniform_int_distribution<> dis(0, int(_remainPoints3D.rows() - 1));
+	std::uniform_int_distribution<> dis(0, _remainCount - 1);
 
-	sibr::Vector3f pointA = _remainPoints3D.row(dis(gen));
-	sibr::Vector3f pointB = _remainPoints3D.row(dis(gen));
-	sibr::Vector3f pointC = _remainPoints3D.row(dis(gen));
+	sibr::Vector3f pointA = _remainPoints3D.row(dis(_generator));
+	sibr::Vector3f pointB = _remainPoints3D.row(dis(_generator));
+	sibr::Vector3f pointC = _remainPoints3D.row(dis(_generator));
 
 	sibr::Vector3f normal = (pointB - pointA).cross(pointC - pointA);
 	normal.normalize();
@@ -246,9 +326,9 @@ std::pair<int, float> PlaneEstimator::votePlane(const sibr::Vector4f plane, cons
 
 	//std::cout << "size " << _points3D.size() << " " << normal.size() << " d " << d << std::endl;
 
-	Eigen::ArrayXf distances = (_remainPoints3D * normal).array();
+	Eigen::ArrayXf distances = (_remainPoints3D.topRows(_remainCount) * normal).array();
 
-	Eigen::ArrayXf dotWithOriNormal = (_remainNormals3D * normal).array();
+	Eigen::ArrayXf dotWithOriNormal = (_remainNormals3D.topRows(_remainCount) * normal).array();
 
 	/*for(int i=0; i< 10; i++){
 	std::cout << distances.row(i) << " ";
@@ -20,6 +20,7 @@
 #include <core/system/Array2d.hpp>
 #include <core/graphics/Mesh.hpp>
 #include <core/graphics/Window.hpp>
+#include <random>
 
 
 /**
@@ -40,6 +41,8 @@ public:
 	PlaneEstimator(const std::vector<sibr::Vector3f> & vertices, bool excludeBB=false);
 
 	/** Compute one or more planes fitting the data using RANSAC. Points that are well fitted by a plan will bre moved from the set.
+	Hypotheses are evaluated in parallel, first on a random subset of the points to reject the poor ones early,
+	and the search for a plane stops as soon as enough hypotheses have been tried given the best inlier ratio found.
 	\param numPlane number of planes to fit
 	\param delta fit validity threshold
 	\param numTry number of attempts to perform for each plane
@@ -48,7 +51,7 @@ public:
 	
 	/** Estimate the best plane in the remaining points set using RANSAC.
 	\param delta fit validity threshold
-	\param numTry number of attempts to perform for each plane
+	\param numTry maximum number of attempts to perform for each plane
 	\param bestMask for each point, will be set to 1 if the plane explains the point well
 	\param vote will contain the number of points that fit
 	\param bestCovMean unused
@@ -110,8 +113,10 @@ public:
 
 protected:
 
-	Eigen::MatrixXf _remainPoints3D; ///< Points to consider.
-	Eigen::MatrixXf _remainNormals3D; ///< Associated normals to consider.
+	Eigen::MatrixXf _remainPoints3D; ///< Points to consider, in the first _remainCount rows.
+	Eigen::MatrixXf _remainNormals3D; ///< Associated normals to consider, in the first _remainCount rows.
+	int _remainCount = 0; ///< Number of points to consider.
+	std::mt19937 _generator; ///< Generator for hypotheses sampling.
 	std::vector<sibr::Vector3u> _Triangles; ///< Triangle list.
 	bool _planeComputed; ///< Has the plane been computed.
 };
@@ -12,12 +12,149 @@
 
 
 #include "Raycaster.hpp"
+#include "GPURaycaster.hpp"
+#include "core/graphics/Window.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 namespace sibr
 {
+	namespace {
+
+		/// Number of rays passed to Embree at once by the stream functions.
+		const size_t kStreamChunk = 256;
+
+		/// Number of rays of a GPU query checked against Embree by validateGPU.
+		const size_t kValidatedRays = 4096;
+
+		/// Fill an Embree ray from a stream.
+		void setupStreamRay(RTCRay & ray, const Raycaster::RayStream & rays, size_t i, float minDist)
+		{
+			ray.org_x = rays.orgX[i];
+			ray.org_y = rays.orgY[i];
+			ray.org_z = rays.orgZ[i];
+			ray.dir_x = rays.dirX[i];
+			ray.dir_y = rays.dirY[i];
+			ray.dir_z = rays.dirZ[i];
+			ray.tnear = rays.tnear ? rays.tnear[i] : minDist;
+			ray.tfar = rays.tfar ? rays.tfar[i] : RayHit::InfinityDist;
+			ray.time = 0.0f;
+			ray.mask = unsigned(-1);
+			ray.id = unsigned(i);
+			ray.flags = 0;
+		}
+
+		/// Hash a buffer, eight bytes at a time (FNV-1a on words).
+		uint64_t hashBytes(const void * data, size_t size, uint64_t hash)
+		{
+			const uint64_t prime = 1099511628211ull;
+			const char * bytes = static_cast<const char *>(data);
+			size_t i = 0;
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+				uint64_t word;
+				std::memcpy(&word, bytes + i, sizeof(uint64_t));
+				hash = (hash ^ word) * prime;
+			}
+			for (; i < size; ++i) {
+				hash = (hash ^ uint64_t(uint8_t(bytes[i]))) * prime;
+			}
+			return hash;
+		}
+
+		/// Content hash, vertex count, triangle count and build quality.
+		typedef std::tuple<uint64_t, size_t, size_t, int> SharedKey;
+
+		/// Raycasters shared by Raycaster::shared.
+		struct SharedRaycasters
+		{
+			std::mutex lock; ///< Guards the entries.
+			std::map<SharedKey, std::weak_ptr<Raycaster>> entries; ///< Alive raycasters.
+		};
+
+		SharedRaycasters & sharedRaycasters()
+		{
+			static SharedRaycasters shared;
+			return shared;
+		}
+
+		/// Setup a context for a stream query.
+		void setupStreamContext(RTCIntersectContext & context, bool coherent)
+		{
+			rtcInitIntersectContext(&context);
+			context.flags = coherent ? RTC_INTERSECT_CONTEXT_FLAG_COHERENT : RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+		}
+
+		/// Number of hits interpolated by each task of Raycaster::interpolate.
+		const size_t kInterpolationBlock = 4096;
+
+		/// Interpolate packed attributes at hits.
+		/// \param packed the attributes of the mesh
+		/// \param count the number of hits
+		/// \param prims the primitives hit
+		/// \param coords the barycentric coordinates of the hits
+		/// \param out the buffers, written from index offset
+		/// \param offset index in out of the first hit
+		/// \param geometry the mesh the attributes come from, or Raycaster::InvalidGeomId
+		void interpolateHits(const Raycaster::TriangleAttributes & packed, size_t count, const RayHit::Primitive * prims, const RayHit::BCCoord * coords,
+			const Raycaster::AttributeStream & out, size_t offset, Raycaster::geomId geometry)
+		{
+			typedef Raycaster::TriangleAttributes Packed;
+			const bool hasNormals = packed.has(Packed::NORMAL), hasColors = packed.has(Packed::COLOR), hasUVs = packed.has(Packed::UV);
+			sibr::Vector3f * normals = hasNormals ? out.normal : nullptr;
+			sibr::Vector3f * colors = hasColors ? out.color : nullptr;
+			sibr::Vector2f * uvs = hasUVs ? out.uv : nullptr;
+			const size_t triangles = packed.triangles();
+
+			for (size_t i = 0; i < count; ++i) {
+				const RayHit::Primitive & prim = prims[i];
+				const size_t o = offset + i;
+				if (prim.geomID == Raycaster::InvalidGeomId || (geometry != Raycaster::InvalidGeomId && prim.geomID != geometry) || prim.triID >= triangles) {
+					if (normals) { normals[o].setZero(); }
+					if (colors) { colors[o].setZero(); }
+					if (uvs) { uvs[o].setZero(); }
+					continue;
+				}
+				// Same weights as smoothNormal, smoothColor and smoothUV.
+				const float u = coords[i].u;
+				const float v = coords[i].v;
+				float w = 1.f - u - v;
+				w = (w >= 0.0f ? (w <= 1.0f ? w : 1.0f) : 0.0f);
+
+				const float * record = packed.data.data() + size_t(prim.triID) * packed.stride;
+				if (hasNormals) {
+					if (normals) {
+						normals[o] = sibr::Vector3f(
+							w * record[0] + u * record[3] + v * record[6],
+							w * record[1] + u * record[4] + v * record[7],
+							w * record[2] + u * record[5] + v * record[8]).normalized();
+					}
+					record += 9;
+				}
+				if (hasColors) {
+					if (colors) {
+						colors[o] = sibr::Vector3f(
+							w * record[0] + u * record[3] + v * record[6],
+							w * record[1] + u * record[4] + v * record[7],
+							w * record[2] + u * record[5] + v * record[8]);
+					}
+					record += 9;
+				}
+				if (uvs) {
+					uvs[o] = sibr::Vector2f(
+						w * record[0] + u * record[2] + v * record[4],
+						w * record[1] + u * record[3] + v * record[5]);
+				}
+			}
+		}
+	}
+
 	/*static*/ SIBR_RAYCASTER_EXPORT const Raycaster::geomId		Raycaster::InvalidGeomId = RTC_INVALID_GEOMETRY_ID;
 	/*static*/ bool													Raycaster::g_initRegisterFlag = false;
 	/*static*/ Raycaster::RTCDevicePtr								Raycaster::g_device = nullptr;
+	/*static*/ Raycaster::Backend									Raycaster::g_defaultBackend = Raycaster::Backend::CPU;
 
 	/*static*/ void Raycaster::rtcErrorCallback(void* userPtr, RTCError code, const char* msg)
 	{
@@ -80,6 +217,12 @@ namespace sibr
 		if (_scene == nullptr)
 			SIBR_LOG << "Cannot create an embree scene" << std::endl;
 		else {
+			if (sceneType != RTC_SCENE_FLAG_NONE) {
+				_sceneFlags = sceneType;
+			}
+			rtcSetSceneFlags(*_scene.get(), _sceneFlags);
+			rtcSetSceneBuildQuality(*_scene.get(), _sceneQuality);
+			_dirty = false;
 			//SIBR_LOG << "Embree device and scene created" << std::endl;
 			//SIBR_LOG << "Warning Backface culling state : "<< rtcGetDeviceProperty(*g_device, RTC_DEVICE_PROPERTY_BACKFACE_CULLING_ENABLED) << std::endl;
 			return true; // Success
@@ -87,6 +230,97 @@ namespace sibr
 		return false; // Fail
 	}
 
+	void	Raycaster::buildSettings(RTCBuildQuality quality, RTCSceneFlags flags)
+	{
+		_sceneQuality = quality;
+		_sceneFlags = flags;
+		if (_scene) {
+			rtcSetSceneFlags(*_scene.get(), _sceneFlags);
+			rtcSetSceneBuildQuality(*_scene.get(), _sceneQuality);
+			sceneChanged();
+		}
+	}
+
+	void	Raycaster::beginEdit()
+	{
+		++_editDepth;
+	}
+
+	void	Raycaster::endEdit()
+	{
+		assert(_editDepth > 0);
+		if (--_editDepth == 0 && _dirty) {
+			commit();
+		}
+	}
+
+	void	Raycaster::commit()
+	{
+		if (_scene && _dirty) {
+			rtcCommitScene(*_scene.get());
+		}
+		_dirty = false;
+	}
+
+	void	Raycaster::sceneChanged()
+	{
+		_dirty = true;
+		_gpuDirty = true;
+		if (_editDepth == 0) {
+			commit();
+		}
+	}
+
+	void	Raycaster::disableGeom(geomId id)
+	{
+		rtcDisableGeometry(rtcGetGeometry(*_scene.get(), id));
+		_geometries[id].enabled = false;
+		sceneChanged();
+	}
+
+	void	Raycaster::enableGeom(geomId id)
+	{
+		rtcEnableGeometry(rtcGetGeometry(*_scene.get(), id));
+		_geometries[id].enabled = true;
+		sceneChanged();
+	}
+
+	void	Raycaster::deleteGeom(geomId id)
+	{
+		// Also release the creation reference, kept by addGenericMesh.
+		RTCGeometry geom = rtcGetGeometry(*_scene.get(), id);
+		rtcDetachGeometry(*_scene.get(), id);
+		rtcReleaseGeometry(geom);
+		_geometries.erase(id);
+		sceneChanged();
+	}
+
+	Raycaster::Ptr	Raycaster::shared(const sibr::Mesh& mesh, RTCBuildQuality quality)
+	{
+		const sibr::Mesh::Vertices & vertices = mesh.vertices();
+		const sibr::Mesh::Triangles & triangles = mesh.triangles();
+		uint64_t hash = 14695981039346656037ull;
+		hash = hashBytes(vertices.data(), vertices.size() * sizeof(sibr::Vector3f), hash);
+		hash = hashBytes(triangles.data(), triangles.size() * sizeof(sibr::Vector3u), hash);
+		const SharedKey key(hash, vertices.size(), triangles.size(), int(quality));
+
+		// Concurrent requests for the same mesh wait for a single build.
+		SharedRaycasters & shared = sharedRaycasters();
+		std::lock_guard<std::mutex> guard(shared.lock);
+		for (auto it = shared.entries.begin(); it != shared.entries.end();) {
+			it = it->second.expired() ? shared.entries.erase(it) : std::next(it);
+		}
+		auto found = shared.entries.find(key);
+		if (found != shared.entries.end()) {
+			return found->second.lock();
+		}
+		Ptr raycaster = std::make_shared<Raycaster>();
+		raycaster->init();
+		raycaster->addGenericMesh(mesh, quality);
+		shared.entries[key] = raycaster;
+		return raycaster;
+	}
+
 	Raycaster::geomId	Raycaster::addMesh(const sibr::Mesh& mesh)
 	{
 		return addGenericMesh(mesh, RTC_BUILD_QUALITY_HIGH);
@@ -143,9 +377,10 @@ namespace sibr
 		}
 
 		rtcCommitGeometry(geom_0);
+		_geometries[id] = GeometryInfo{ triangles.size(), true };
 
-		// Commit all changes on the scene
-		rtcCommitScene(*_scene.get());
+		// Commit all changes on the scene, unless more are coming.
+		sceneChanged();
 
 		return id;
 	}
@@ -185,7 +420,7 @@ namespace sibr
 		// Update mesh
 		rtcCommitGeometry(rtcGetGeometry(*_scene.get(), mesh_id));
 		// Commit changes to scene
-		rtcCommitScene(*_scene.get());
+		sceneChanged();
 	}
 
 	bool	Raycaster::hitSomething(const Ray& inray, float minDist)
@@ -208,6 +443,8 @@ namespace sibr
 			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
 		else
 		{
+			if (_dirty)
+				commit();
 			RTCIntersectContext context;
 			rtcInitIntersectContext(&context);
 			rtcOccluded1(*_scene.get(), &context, &ray);
@@ -237,6 +474,8 @@ namespace sibr
 			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
 		else
 		{
+			if (_dirty)
+				commit();
 			RTCIntersectContext context;
 			rtcInitIntersectContext(&context);
 			rtcOccluded8(valid8, *_scene.get(), &context, &ray);
@@ -272,6 +511,8 @@ namespace sibr
 			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
 		else
 		{
+			if (_dirty)
+				commit();
 			RTCIntersectContext context;
 			rtcInitIntersectContext(&context);
 			rtcIntersect1(*_scene.get(), &context, &rh);
@@ -319,6 +560,8 @@ namespace sibr
 			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
 		else
 		{
+			if (_dirty)
+				commit();
 			RTCIntersectContext context;
 			rtcInitIntersectContext(&context);
 			rtcIntersect8(valid8.data(), *_scene.get(), &context, &rh);
@@ -348,9 +591,255 @@ namespace sibr
 		return res;
 	}
 
+	void	Raycaster::defaultBackend(Backend backend)
+	{
+		g_defaultBackend = backend;
+	}
+
+	Raycaster::Backend	Raycaster::defaultBackend()
+	{
+		return g_defaultBackend;
+	}
+
+	bool	Raycaster::usesGPU()
+	{
+		// Threads without a GL context never touch the GPU state, they can query concurrently.
+		if (_backend != Backend::GPU || Window::currentContext() == nullptr || init() == false) {
+			return false;
+		}
+		if (!_gpu) {
+			_gpu = std::make_shared<GPURaycaster>();
+		}
+		if (!_gpu->usable()) {
+			return false;
+		}
+		updateGPU();
+		return true;
+	}
+
+	void	Raycaster::updateGPU()
+	{
+		if (!_gpuDirty) {
+			return;
+		}
+		// Read the triangles back from the Embree buffers, they include the xformRtcMeshOnly changes.
+		std::vector<sibr::Vector3f> vertices;
+		std::vector<RayHit::Primitive> prims;
+		for (const auto & geometry : _geometries) {
+			if (!geometry.second.enabled) {
+				continue;
+			}
+			RTCGeometry geom = rtcGetGeometry(*_scene.get(), geometry.first);
+			const float * vert = (const float*)rtcGetGeometryBufferData(geom, RTC_BUFFER_TYPE_VERTEX, 0);
+			const uint * tri = (const uint*)rtcGetGeometryBufferData(geom, RTC_BUFFER_TYPE_INDEX, 0);
+			for (uint t = 0; t < uint(geometry.second.triangles); ++t) {
+				for (uint k = 0; k < 3; ++k) {
+					const float * v = vert + 4 * tri[3 * t + k];
+					vertices.emplace_back(v[0], v[1], v[2]);
+				}
+				prims.push_back(RayHit::Primitive{ t, geometry.first, InvalidGeomId });
+			}
+		}
+		const bool cull = rtcGetDeviceProperty(*g_device.get(), RTC_DEVICE_PROPERTY_BACKFACE_CULLING_ENABLED) != 0;
+		_gpu->build(vertices, prims, cull);
+		_gpuDirty = false;
+	}
+
+	void	Raycaster::validateGPU(const RayStream & rays, const float * dists, float minDist)
+	{
+		const size_t step = std::max(size_t(1), rays.count / kValidatedRays);
+		RayBatch batch;
+		std::vector<float> tnear, gpuDists;
+		for (size_t i = 0; i < rays.count; i += step) {
+			batch.add(sibr::Vector3f(rays.orgX[i], rays.orgY[i], rays.orgZ[i]), sibr::Vector3f(rays.dirX[i], rays.dirY[i], rays.dirZ[i]),
+				rays.tfar ? rays.tfar[i] : RayHit::InfinityDist);
+			tnear.push_back(rays.tnear ? rays.tnear[i] : minDist);
+			gpuDists.push_back(dists[i]);
+		}
+		RayStream stream = batch.stream();
+		stream.tnear = tnear.data();
+		std::vector<float> cpuDists(batch.size());
+		HitStream hits;
+		hits.dist = cpuDists.data();
+		intersectStreamCPU(stream, hits, minDist, false);
+
+		size_t mismatches = 0;
+		for (size_t r = 0; r < batch.size(); ++r) {
+			const bool cpuHit = cpuDists[r] != RayHit::InfinityDist;
+			const bool gpuHit = gpuDists[r] != RayHit::InfinityDist;
+			if (cpuHit != gpuHit || (cpuHit && std::abs(cpuDists[r] - gpuDists[r]) > 1e-3f * std::max(1.0f, cpuDists[r]))) {
+				++mismatches;
+			}
+		}
+		if (mismatches > 0) {
+			SIBR_WRG << "[Raycaster] GPU and CPU disagree on " << mismatches << " of " << batch.size() << " validated rays." << std::endl;
+		}
+	}
+
+	void	Raycaster::intersectStream(const RayStream & rays, const HitStream & hits, float minDist, bool coherent)
+	{
+		assert(minDist >= 0.f);
+		if (rays.count == 0) {
+			return;
+		}
+		if (!usesGPU()) {
+			intersectStreamCPU(rays, hits, minDist, coherent);
+			return;
+		}
+#ifdef SIBR_RAYCASTER_VALIDATE_GPU
+		// The validation needs the distances.
+		std::vector<float> dists;
+		HitStream checked = hits;
+		if (!checked.dist) {
+			dists.resize(rays.count);
+			checked.dist = dists.data();
+		}
+		_gpu->intersectStream(rays, checked, minDist);
+		validateGPU(rays, checked.dist, minDist);
+#else
+		_gpu->intersectStream(rays, hits, minDist);
+#endif
+	}
+
+	void	Raycaster::intersectStream(const RayStream & rays, const HitStream & hits, const TriangleAttributes & packed, const AttributeStream & attributes,
+		float minDist, bool coherent, geomId geometry)
+	{
+		assert(minDist >= 0.f);
+		if (rays.count == 0) {
+			return;
+		}
+		if (!usesGPU()) {
+			intersectStreamCPU(rays, hits, minDist, coherent, &packed, &attributes, geometry);
+			return;
+		}
+		// The GPU returns all hits at once, they are interpolated afterwards.
+		std::vector<RayHit::Primitive> prims;
+		std::vector<RayHit::BCCoord> coords;
+		HitStream results = hits;
+		if (!results.prim) {
+			prims.resize(rays.count);
+			results.prim = prims.data();
+		}
+		if (!results.coord) {
+			coords.resize(rays.count);
+			results.coord = coords.data();
+		}
+		intersectStream(rays, results, minDist, coherent);
+		interpolate(packed, rays.count, results.prim, results.coord, attributes, geometry);
+	}
+
+	void	Raycaster::intersectStreamCPU(const RayStream & rays, const HitStream & hits, float minDist, bool coherent,
+		const TriangleAttributes * packed, const AttributeStream * attributes, geomId geometry)
+	{
+		if (init() == false) {
+			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
+			return;
+		}
+		if (_dirty) {
+			commit();
+		}
+
+		RTCScene scene = *_scene.get();
+		const int64_t chunks = int64_t((rays.count + kStreamChunk - 1) / kStreamChunk);
+#pragma omp parallel for schedule(dynamic) if(chunks > 1)
+		for (int64_t c = 0; c < chunks; ++c) {
+			const size_t begin = size_t(c) * kStreamChunk;
+			const size_t count = std::min(kStreamChunk, rays.count - begin);
+
+			RTCRayHit rh[kStreamChunk];
+			for (size_t r = 0; r < count; ++r) {
+				setupStreamRay(rh[r].ray, rays, begin + r, minDist);
+				rh[r].hit.geomID = RTC_INVALID_GEOMETRY_ID;
+				rh[r].hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+			}
+
+			RTCIntersectContext context;
+			setupStreamContext(context, coherent);
+			rtcIntersect1M(scene, &context, rh, unsigned(count), sizeof(RTCRayHit));
+
+			for (size_t r = 0; r < count; ++r) {
+				const size_t i = begin + r;
+				const RTCHit & hit = rh[r].hit;
+				if (hits.dist) {
+					hits.dist[i] = hit.geomID == RTC_INVALID_GEOMETRY_ID ? RayHit::InfinityDist : rh[r].ray.tfar;
+				}
+				if (hits.prim) {
+					hits.prim[i] = RayHit::Primitive{ hit.primID, hit.geomID, hit.instID[0] };
+				}
+				if (hits.coord) {
+					hits.coord[i] = RayHit::BCCoord{ hit.u, hit.v };
+				}
+				if (hits.normal) {
+					// Same orientation as intersect.
+					hits.normal[i] = sibr::Vector3f(-hit.Ng_x, -hit.Ng_y, -hit.Ng_z);
+				}
+			}
+
+			if (packed) {
+				RayHit::Primitive prims[kStreamChunk];
+				RayHit::BCCoord coords[kStreamChunk];
+				for (size_t r = 0; r < count; ++r) {
+					const RTCHit & hit = rh[r].hit;
+					prims[r] = RayHit::Primitive{ hit.primID, hit.geomID, hit.instID[0] };
+					coords[r] = RayHit::BCCoord{ hit.u, hit.v };
+				}
+				interpolateHits(*packed, count, prims, coords, *attributes, begin, geometry);
+			}
+		}
+	}
+
+	void	Raycaster::occludedStream(const RayStream & rays, uint8_t * occluded, float minDist, bool coherent)
+	{
+		assert(minDist >= 0.f);
+		if (rays.count == 0) {
+			return;
+		}
+		if (usesGPU()) {
+			_gpu->occludedStream(rays, occluded, minDist);
+			return;
+		}
+		occludedStreamCPU(rays, occluded, minDist, coherent);
+	}
+
+	void	Raycaster::occludedStreamCPU(const RayStream & rays, uint8_t * occluded, float minDist, bool coherent)
+	{
+		if (init() == false) {
+			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
+			return;
+		}
+		if (_dirty) {
+			commit();
+		}
+
+		RTCScene scene = *_scene.get();
+		const int64_t chunks = int64_t((rays.count + kStreamChunk - 1) / kStreamChunk);
+#pragma omp parallel for schedule(dynamic) if(chunks > 1)
+		for (int64_t c = 0; c < chunks; ++c) {
+			const size_t begin = size_t(c) * kStreamChunk;
+			const size_t count = std::min(kStreamChunk, rays.count - begin);
+
+			RTCRay ray[kStreamChunk];
+			for (size_t r = 0; r < count; ++r) {
+				setupStreamRay(ray[r], rays, begin + r, minDist);
+			}
+
+			RTCIntersectContext context;
+			setupStreamContext(context, coherent);
+			rtcOccluded1M(scene, &context, ray, unsigned(count), sizeof(RTCRay));
+
+			// Embree sets tfar to -inf for occluded rays.
+			for (size_t r = 0; r < count; ++r) {
+				occluded[begin + r] = ray[r].tfar < 0.0f ? 1 : 0;
+			}
+		}
+	}
+
 	void Raycaster::clearGeometry()
 	{
 		_scene.reset();
+		_dirty = false;
+		_geometries.clear();
+		_gpuDirty = true;
 	}
 
 	sibr::Vector3f Raycaster::smoothNormal(const sibr::Mesh& mesh, const RayHit& hit)
@@ -401,4 +890,53 @@ namespace sibr
 		return wcoord * uvs[tri[0]] + ucoord * uvs[tri[1]] + vcoord * uvs[tri[2]];
 	}
 
+	Raycaster::TriangleAttributes Raycaster::packAttributes(const sibr::Mesh & mesh, uint attributes)
+	{
+		TriangleAttributes packed;
+		packed.attributes =
+			((attributes & TriangleAttributes::NORMAL) && mesh.hasNormals() ? uint(TriangleAttributes::NORMAL) : 0u) |
+			((attributes & TriangleAttributes::COLOR) && mesh.hasColors() ? uint(TriangleAttributes::COLOR) : 0u) |
+			((attributes & TriangleAttributes::UV) && mesh.hasTexCoords() ? uint(TriangleAttributes::UV) : 0u);
+		packed.stride = (packed.has(TriangleAttributes::NORMAL) ? 9 : 0) + (packed.has(TriangleAttributes::COLOR) ? 9 : 0) + (packed.has(TriangleAttributes::UV) ? 6 : 0);
+		if (packed.stride == 0) {
+			return packed;
+		}
+
+		const sibr::Mesh::Triangles & triangles = mesh.triangles();
+		packed.data.resize(triangles.size() * packed.stride);
+#pragma omp parallel for
+		for (int64_t t = 0; t < int64_t(triangles.size()); ++t) {
+			const sibr::Vector3u & tri = triangles[t];
+			float * record = packed.data.data() + size_t(t) * packed.stride;
+			if (packed.has(TriangleAttributes::NORMAL)) {
+				for (int k = 0; k < 3; ++k, record += 3) {
+					std::memcpy(record, mesh.normals()[tri[k]].data(), 3 * sizeof(float));
+				}
+			}
+			if (packed.has(TriangleAttributes::COLOR)) {
+				for (int k = 0; k < 3; ++k, record += 3) {
+					std::memcpy(record, mesh.colors()[tri[k]].data(), 3 * sizeof(float));
+				}
+			}
+			if (packed.has(TriangleAttributes::UV)) {
+				for (int k = 0; k < 3; ++k, record += 2) {
+					std::memcpy(record, mesh.texCoords()[tri[k]].data(), 2 * sizeof(float));
+				}
+			}
+		}
+		return packed;
+	}
+
+	void Raycaster::interpolate(const TriangleAttributes & packed, size_t count, const RayHit::Primitive * prims, const RayHit::BCCoord * coords,
+		const AttributeStream & attributes, geomId geometry)
+	{
+		const int64_t blocks = int64_t((count + kInterpolationBlock - 1) / kInterpolationBlock);
+#pragma omp parallel for schedule(static) if(blocks > 1)
+		for (int64_t b = 0; b < blocks; ++b) {
+			const size_t begin = size_t(b) * kInterpolationBlock;
+			const size_t n = std::min(kInterpolationBlock, count - begin);
+			interpolateHits(packed, n, prims + begin, coords + begin, attributes, begin, geometry);
+		}
+	}
+
 } // namespace sibr
@@ -19,6 +19,7 @@
 #  include <pmmintrin.h>	// functions for setting the control register
 # pragma warning(pop)
 
+# include <map>
 # include <core/graphics/Mesh.hpp>
 # include <core/system/Matrix.hpp>
 # include "core/raycaster/Config.hpp"
@@ -26,6 +27,8 @@
 
 namespace sibr
 {
+	class GPURaycaster;
+
 	///
 	/// This class can be used to cast rays against a scene containing triangular
 	/// meshes. You can check for intersections with the geometry and get
@@ -49,6 +52,115 @@ namespace sibr
 		/// Stores a number representing an invalid geom id.
 		static const geomId InvalidGeomId; 
 
+		/// Device running the stream queries.
+		enum class Backend { CPU, GPU };
+
+		/// A batch of rays in structure-of-arrays layout: ray i is made of the i-th element of each array.
+		/// Directions do not have to be normalized, distances are then expressed in multiples of their length.
+		struct RayStream
+		{
+			size_t count = 0;				///< Number of rays.
+			const float * orgX = nullptr;	///< Origins x coordinates.
+			const float * orgY = nullptr;	///< Origins y coordinates.
+			const float * orgZ = nullptr;	///< Origins z coordinates.
+			const float * dirX = nullptr;	///< Directions x coordinates.
+			const float * dirY = nullptr;	///< Directions y coordinates.
+			const float * dirZ = nullptr;	///< Directions z coordinates.
+			const float * tnear = nullptr;	///< Per-ray minimal distance (optional, minDist is used instead).
+			const float * tfar = nullptr;	///< Per-ray maximal distance (optional, unbounded by default).
+		};
+
+		/// Storage of rays to cast as a RayStream.
+		struct RayBatch
+		{
+			std::vector<float> orgX, orgY, orgZ, dirX, dirY, dirZ, tfar; ///< Rays components.
+
+			/// Append a ray.
+			/// \param orig the ray origin
+			/// \param dir the ray direction
+			/// \param far the maximal distance
+			void add(const sibr::Vector3f & orig, const sibr::Vector3f & dir, float far = RayHit::InfinityDist) {
+				orgX.push_back(orig[0]); orgY.push_back(orig[1]); orgZ.push_back(orig[2]);
+				dirX.push_back(dir[0]); dirY.push_back(dir[1]); dirZ.push_back(dir[2]);
+				tfar.push_back(far);
+			}
+
+			/// Resize the batch, the new rays are then set with set.
+			/// \param count the number of rays
+			void resize(size_t count) {
+				orgX.resize(count); orgY.resize(count); orgZ.resize(count);
+				dirX.resize(count); dirY.resize(count); dirZ.resize(count);
+				tfar.resize(count, RayHit::InfinityDist);
+			}
+
+			/// Set a ray, the batch can be filled from several threads.
+			/// \param i the ray index
+			/// \param orig the ray origin
+			/// \param dir the ray direction
+			/// \param far the maximal distance
+			void set(size_t i, const sibr::Vector3f & orig, const sibr::Vector3f & dir, float far = RayHit::InfinityDist) {
+				orgX[i] = orig[0]; orgY[i] = orig[1]; orgZ[i] = orig[2];
+				dirX[i] = dir[0]; dirY[i] = dir[1]; dirZ[i] = dir[2];
+				tfar[i] = far;
+			}
+
+			/// Remove all rays, keeping the storage.
+			void clear() {
+				orgX.clear(); orgY.clear(); orgZ.clear(); dirX.clear(); dirY.clear(); dirZ.clear(); tfar.clear();
+			}
+
+			/// \return the number of rays
+			size_t size() const { return tfar.size(); }
+
+			/// \return a stream referencing the rays, valid until the next modification
+			RayStream stream() const {
+				RayStream s;
+				s.count = size();
+				s.orgX = orgX.data(); s.orgY = orgY.data(); s.orgZ = orgZ.data();
+				s.dirX = dirX.data(); s.dirY = dirY.data(); s.dirZ = dirZ.data();
+				s.tfar = tfar.data();
+				return s;
+			}
+		};
+
+		/// Buffers receiving the results of a RayStream, with one element per ray. Null buffers are not written.
+		struct HitStream
+		{
+			float * dist = nullptr;					///< Hit distance, or RayHit::InfinityDist if nothing was hit.
+			RayHit::Primitive * prim = nullptr;		///< Primitive hit.
+			RayHit::BCCoord * coord = nullptr;		///< Barycentric coordinates of the hit.
+			sibr::Vector3f * normal = nullptr;		///< Geometric normal, as returned by intersect.
+		};
+
+		/// Vertex attributes of a mesh packed by triangle, see packAttributes: the three corners of each
+		/// triangle are stored next to each other, so interpolating a hit reads one contiguous record
+		/// instead of the triangle indices then three scattered vertices per attribute.
+		struct TriangleAttributes
+		{
+			/// Attributes that can be packed.
+			enum Attribute { NORMAL = 1, COLOR = 2, UV = 4 };
+
+			uint attributes = 0;		///< Packed attributes, as a mask of Attribute.
+			uint stride = 0;			///< Number of floats per triangle.
+			std::vector<float> data;	///< For each triangle, the corner normals, then colors, then UVs, for the packed attributes.
+
+			/// \param attribute the attribute
+			/// \return true if the attribute is packed
+			bool has(Attribute attribute) const { return (attributes & attribute) != 0; }
+
+			/// \return the number of triangles
+			size_t triangles() const { return stride > 0 ? data.size() / stride : 0; }
+		};
+
+		/// Buffers receiving the attributes interpolated at hits, one element per hit. Null buffers, and the
+		/// ones of attributes that are not packed, are not written. Misses receive zeros.
+		struct AttributeStream
+		{
+			sibr::Vector3f * normal = nullptr;	///< Normalized smooth normal, as returned by smoothNormal.
+			sibr::Vector3f * color = nullptr;	///< Color, as returned by smoothColor.
+			sibr::Vector2f * uv = nullptr;		///< Texture coordinates, as returned by smoothUV.
+		};
+
 		/// Destructor.
 		~Raycaster( void );
 
@@ -61,6 +173,58 @@ namespace sibr
 		/// \return a success flag
 		bool	init(RTCSceneFlags sceneType = RTC_SCENE_FLAG_NONE );
 
+		/// Set how the acceleration structure of the scene is built, applied at the next commit.
+		/// Scenes edited interactively should use a low quality and RTC_SCENE_FLAG_DYNAMIC, to rebuild fast;
+		/// scenes used for long batch queries (baking, preprocessing) a high quality and no flag.
+		/// \param quality the scene build quality
+		/// \param flags the scene flags, see Embree doc.
+		void	buildSettings(RTCBuildQuality quality, RTCSceneFlags flags);
+
+		/// Start a batch of geometry edits: the scene is not committed until the matching endEdit.
+		/// Edits can be nested, the scene is committed when the outermost one ends.
+		/// \note Queries issued during an edit commit the pending changes first.
+		/// \sa ScopedEdit
+		void	beginEdit();
+
+		/// End a batch of geometry edits, committing the scene once if it changed.
+		void	endEdit();
+
+		/// Commit the pending geometry changes now, if any.
+		void	commit();
+
+		/// \return true if geometry changes are waiting for a commit.
+		bool	hasPendingChanges() const { return _dirty; }
+
+		/// Run the stream queries (intersectStream, occludedStream) on the GPU: the triangles are uploaded
+		/// in a BVH traversed by a compute shader, see GPURaycaster. This needs an OpenGL 4.3 context current
+		/// on the calling thread; queries issued from other threads, or when the GPU cannot be used, run on
+		/// the CPU. Single ray queries always run on the CPU.
+		/// \param backend the backend to use
+		void	backend(Backend backend) { _backend = backend; }
+
+		/// \return the backend used for the stream queries.
+		Backend	backend() const { return _backend; }
+
+		/// Set the backend of the raycasters created afterwards, CPU by default.
+		/// \param backend the backend to use
+		static void		defaultBackend(Backend backend);
+
+		/// \return the backend of new raycasters.
+		static Backend	defaultBackend();
+
+		/// \return true if the stream queries issued from the calling thread run on the GPU.
+		/// \note The scene is uploaded to the GPU if it changed.
+		bool	usesGPU();
+
+		/// Get a raycaster containing a mesh, shared by all the callers asking for the same mesh content in
+		/// the process: the acceleration structure of a given mesh is built once, as long as one of its
+		/// raycasters is alive. The mesh is identified by a hash of its vertices and triangles.
+		/// \param mesh the mesh
+		/// \param quality the build quality of the mesh
+		/// \return the raycaster
+		/// \warning The raycaster is shared, its geometry must not be edited.
+		static Ptr shared(const sibr::Mesh& mesh, RTCBuildQuality quality = RTC_BUILD_QUALITY_HIGH);
+
 		/// Add a triangle mesh to the raycast scene, taht you won't modify frequently
 		/// Return the id  of the geometry added so you can track your mesh (and compare
 		/// its id to the one stored in RayHits).
@@ -117,19 +281,44 @@ namespace sibr
 		/// \return a list of boolean denoting if intersections happened
 		std::array<bool, 8>	hitSomething8(const std::array<Ray, 8>& inray, float minDist = 0.f);
 
+		/// Launch a batch of rays, reporting intersections infos in caller-provided buffers.
+		/// The rays are split in chunks dispatched to Embree's stream interface, in parallel.
+		/// \param rays the rays to cast
+		/// \param hits the result buffers, each holding at least rays.count elements
+		/// \param minDist Any intersection closer than minDist from the ray origin will be ignored, if the stream has no tnear.
+		/// \param coherent hint that neighbouring rays are similar (camera rays for instance)
+		void	intersectStream(const RayStream& rays, const HitStream& hits, float minDist = 0.f, bool coherent = false);
+
+		/// Launch a batch of rays and interpolate the attributes of a mesh at the hits. On the CPU, each chunk
+		/// of rays is interpolated right after being cast, while its hits are still in cache.
+		/// \param rays the rays to cast
+		/// \param hits the result buffers, each holding at least rays.count elements, can all be null
+		/// \param packed the attributes of the mesh, see packAttributes
+		/// \param attributes the interpolated attributes buffers, each holding at least rays.count elements
+		/// \param minDist Any intersection closer than minDist from the ray origin will be ignored, if the stream has no tnear.
+		/// \param coherent hint that neighbouring rays are similar (camera rays for instance)
+		/// \param geometry the id of the mesh the attributes come from, hits on other meshes are treated as misses; InvalidGeomId to accept all hits
+		void	intersectStream(const RayStream& rays, const HitStream& hits, const TriangleAttributes& packed, const AttributeStream& attributes,
+			float minDist = 0.f, bool coherent = false, geomId geometry = InvalidGeomId);
+
+		/// Launch a batch of rays, only reporting if intersections occured. This is the fastest query for visibility tests.
+		/// \param rays the rays to cast
+		/// \param occluded will contain 1 for each ray that hit something before its tfar, 0 otherwise
+		/// \param minDist Any intersection closer than minDist from the ray origin will be ignored, if the stream has no tnear.
+		/// \param coherent hint that neighbouring rays are similar
+		void	occludedStream(const RayStream& rays, uint8_t* occluded, float minDist = 0.f, bool coherent = false);
+
 		/// Disable geometry to avoid raycasting against it (eg background when only intersecting a foreground object).
 		/// \param id the mesh to disable
-		/// \todo Untested.
-		void	disableGeom(geomId id) { rtcDisableGeometry(rtcGetGeometry((*_scene.get()),id)); rtcCommitGeometry(rtcGetGeometry(*_scene.get(),id)); rtcCommitScene(*_scene.get()); }
+		void	disableGeom(geomId id);
 
 		/// Enable geometry to start raycasting it again.
 		/// \param id the geometry to enable 
-		/// \todo Untested.
-		void	enableGeom(geomId id) { rtcEnableGeometry(rtcGetGeometry((*_scene.get()),id)); rtcCommitGeometry(rtcGetGeometry(*_scene.get(),id)); rtcCommitScene(*_scene.get());}
+		void	enableGeom(geomId id);
 
 		/// Delete geometry
 		/// \param id the geometry to delete
-		void	deleteGeom(geomId id) { rtcReleaseGeometry(rtcGetGeometry((*_scene.get()),id)); rtcCommitGeometry(rtcGetGeometry(*_scene.get(),id)); rtcCommitScene(*_scene.get());} 
+		void	deleteGeom(geomId id);
 
 		/// Clears internal scene..
 		void clearGeometry();
@@ -152,11 +341,74 @@ namespace sibr
 		/// \‚eturn the interpolated texture coordinates
 		static sibr::Vector2f smoothUV(const sibr::Mesh & mesh, const RayHit & hit);
 
+		/// Pack the vertex attributes of a mesh by triangle, for the batched interpolations.
+		/// \param mesh sibr::Mesh used by raycaster
+		/// \param attributes the attributes to pack, as a mask of TriangleAttributes::Attribute; the ones the mesh doesn't have are skipped
+		/// \return the packed attributes
+		static TriangleAttributes packAttributes(const sibr::Mesh & mesh,
+			uint attributes = TriangleAttributes::NORMAL | TriangleAttributes::COLOR | TriangleAttributes::UV);
+
+		/// Interpolate packed attributes at a batch of hits, in parallel. Gives the same results as smoothNormal,
+		/// smoothColor and smoothUV.
+		/// \param packed the attributes of the mesh, see packAttributes
+		/// \param count the number of hits
+		/// \param prims the primitives hit, as returned in HitStream::prim
+		/// \param coords the barycentric coordinates of the hits, as returned in HitStream::coord
+		/// \param attributes the interpolated attributes buffers, each holding at least count elements
+		/// \param geometry the id of the mesh the attributes come from, hits on other meshes are treated as misses; InvalidGeomId to accept all hits
+		static void interpolate(const TriangleAttributes & packed, size_t count, const RayHit::Primitive * prims, const RayHit::BCCoord * coords,
+			const AttributeStream & attributes, geomId geometry = InvalidGeomId);
+
 		/// \return true if the raycaster is initialized. 
 		bool isInit() { return g_device && _scene; }
 
+		/// Batch the geometry edits done during its lifetime, see beginEdit.
+		///
+		///		{
+		///			Raycaster::ScopedEdit edit(raycaster);
+		///			for (auto id : ids) raycaster.disableGeom(id);
+		///		} // Committed once here.
+		///
+		class ScopedEdit
+		{
+		public:
+			/// Constructor, starts an edit.
+			/// \param raycaster the raycaster to edit
+			ScopedEdit(Raycaster & raycaster) : _raycaster(raycaster) { _raycaster.beginEdit(); }
+			/// Destructor, ends the edit.
+			~ScopedEdit() { _raycaster.endEdit(); }
+		private:
+			Raycaster & _raycaster; ///< Edited raycaster.
+		};
+
 	private: 
 
+		/// Geometry attached to the scene.
+		struct GeometryInfo
+		{
+			size_t	triangles;	///< Number of triangles.
+			bool	enabled;	///< Is it raycasted.
+		};
+
+		/// Record a change of the scene, committed now unless an edit is in progress.
+		void	sceneChanged();
+
+		/// Upload the enabled triangles to the GPU backend if the scene changed.
+		void	updateGPU();
+
+		/// Compare the results of GPU queries with Embree on a subset of the rays, and report differences.
+		/// \param rays the rays cast
+		/// \param dists the distances found by the GPU
+		/// \param minDist the minimal distance
+		void	validateGPU(const RayStream& rays, const float* dists, float minDist);
+
+		/// Embree implementation of intersectStream, interpolating attributes after each chunk if packed is not null.
+		void	intersectStreamCPU(const RayStream& rays, const HitStream& hits, float minDist, bool coherent,
+			const TriangleAttributes* packed = nullptr, const AttributeStream* attributes = nullptr, geomId geometry = InvalidGeomId);
+
+		/// Embree implementation of occludedStream.
+		void	occludedStreamCPU(const RayStream& rays, uint8_t* occluded, float minDist, bool coherent);
+
 		/// Will be called by embree whenever an error occurs
 		/// \param userPtr the user data pointer
 		/// \param code the error code
@@ -165,6 +417,7 @@ namespace sibr
 
 		
 		static bool g_initRegisterFlag; ///< Used to initialize flag of registers used by SSE
+		static Backend g_defaultBackend; ///< Backend of new raycasters.
 		static RTCDevicePtr	g_device;	///< embree device (context for a raycaster)
 
 		/// \return the internal scene pointer
@@ -172,6 +425,14 @@ namespace sibr
 
 		RTCScenePtr		_scene;		///< scene storing raycastable meshes
 		RTCDevicePtr	_devicePtr;	///< embree device (context for a raycaster)
+		RTCBuildQuality	_sceneQuality = RTC_BUILD_QUALITY_MEDIUM;	///< Scene acceleration structure quality.
+		RTCSceneFlags	_sceneFlags = RTC_SCENE_FLAG_NONE;	///< Scene flags.
+		int				_editDepth = 0;	///< Number of nested edits in progress.
+		bool			_dirty = false;	///< Has the scene changed since the last commit.
+		Backend			_backend = defaultBackend();	///< Backend of the stream queries.
+		std::shared_ptr<GPURaycaster>	_gpu;	///< GPU backend, created on first use.
+		bool			_gpuDirty = true;	///< Has the scene changed since the last GPU upload.
+		std::map<geomId, GeometryInfo>	_geometries;	///< Attached geometries.
 	};
 
 	///// DEFINITION /////
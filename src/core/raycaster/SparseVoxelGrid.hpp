@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <algorithm>
+# include <array>
+# include <cstdint>
+# include <memory>
+# include <unordered_map>
+# include <core/raycaster/VoxelGrid.hpp>
+
+namespace sibr
+{
+	/**
+	\addtogroup sibr_raycaster
+	@{
+	*/
+
+	/** Voxel grid storing only the cells written to, for high resolution grids that are mostly empty.
+	Cells are allocated by bricks of BrickSize^3 voxels, indexed in a hash map; the other cells read as a
+	background value. Cell ids, coordinates and all the VoxelGridBase queries (getCell, getNeighbors,
+	rayMarch...) are the same as for a dense VoxelGrid of the same dimensions.
+
+	A cell becomes occupied when accessed through a non-const accessor, and stays so until erased:
+	detect_non_empty_cells and forEachOccupied only visit occupied cells.
+	\warning Non-const accesses can allocate a brick, they must not be done concurrently.
+	*/
+	template<typename CellType = BasicVoxelType, int BrickSize = 8> class SparseVoxelGrid : public VoxelGridBase {
+
+		SIBR_CLASS_PTR(SparseVoxelGrid);
+	public:
+		using VoxelType = CellType;
+
+		/** Constructor.
+		\param boundingBox bounding box delimiting the voxellized region
+		\param numPerDim number of voxels along each dimension
+		\param background value of the cells never written
+		\param forceCube if true, the largest dimension will be split in numPerDim voxels and the other such that the voxels are cubes in world space
+		*/
+		SparseVoxelGrid(const Box & boundingBox, int numPerDim, const CellType & background = CellType(), bool forceCube = true)
+			: SparseVoxelGrid(boundingBox, sibr::Vector3i(numPerDim, numPerDim, numPerDim), background, forceCube)
+		{
+		}
+
+		/** Constructor.
+		\param boundingBox bounding box delimiting the voxellized region
+		\param numsPerDim number of voxels along each dimension
+		\param background value of the cells never written
+		\param forceCube if true, the largest dimension will be split in numPerDim voxels and the other such that the voxels are cubes in world space
+		*/
+		SparseVoxelGrid(const Box & boundingBox, const sibr::Vector3i & numsPerDim, const CellType & background = CellType(), bool forceCube = true)
+			: VoxelGridBase(boundingBox, numsPerDim, forceCube), _background(background) {
+			_bricksDims = (getDims().array() + BrickSize - 1) / BrickSize;
+		}
+
+		/** Get voxel at a given linear index, marking it occupied.
+		\param cell_id the linear index
+		\return a reference to the voxel
+		*/
+		CellType & operator[](size_t cell_id) {
+			return at(getCell(cell_id));
+		}
+
+		/** Get voxel at a given linear index.
+		\param cell_id the linear index
+		\return a reference to the voxel, or the background
+		*/
+		const CellType & operator[](size_t cell_id) const {
+			return at(getCell(cell_id));
+		}
+
+		/** Get voxel at given integer 3D coordinates, marking it occupied.
+		\param x x integer coordinate
+		\param y y integer coordinate
+		\param z z integer coordinate
+		\return a reference to the voxel
+		*/
+		CellType & operator()(int x, int y, int z) {
+			return at(sibr::Vector3i(x, y, z));
+		}
+
+		/** Get voxel at given integer 3D coordinates.
+		\param x x integer coordinate
+		\param y y integer coordinate
+		\param z z integer coordinate
+		\return a reference to the voxel, or the background
+		*/
+		const CellType & operator()(int x, int y, int z) const {
+			return at(sibr::Vector3i(x, y, z));
+		}
+
+		/** Get voxel at given integer 3D coordinates, marking it occupied.
+		\param v integer coordinates
+		\return a reference to the voxel
+		*/
+		CellType & operator[](const sibr::Vector3i & v) {
+			return at(v);
+		}
+
+		/** Get voxel at given integer 3D coordinates.
+		\param v integer coordinates
+		\return a reference to the voxel, or the background
+		*/
+		const CellType & operator[](const sibr::Vector3i & v) const {
+			return at(v);
+		}
+
+		/** Check if a voxel has been written to.
+		\param cell_id the linear index
+		\return true if the voxel is occupied
+		*/
+		bool isOccupied(size_t cell_id) const;
+
+		/** Reset a voxel to the background, freeing its brick when it was the last occupied one.
+		\param cell_id the linear index
+		*/
+		void erase(size_t cell_id);
+
+		/** Remove all voxels. */
+		void clear() { _bricks.clear(); _occupied = 0; }
+
+		/** Call a function on each occupied voxel, brick by brick.
+		\param func will receive the linear index and a reference to the voxel
+		*/
+		template<typename FuncType>
+		void forEachOccupied(const FuncType & func);
+
+		/** Call a function on each occupied voxel, brick by brick.
+		\param func will receive the linear index and a const reference to the voxel
+		*/
+		template<typename FuncType>
+		void forEachOccupied(const FuncType & func) const;
+
+		/** Generate a mesh from all occupied voxels satisfying a condition.
+		\param filled should the mesh be wireframe (false) or faceted (true)
+		\param func the predicate to evaluate, will receive as unique argument a voxel (CellType).
+		\return the generated mesh
+		*/
+		template<typename FuncType>
+		sibr::Mesh::Ptr getAllCellMeshWithCond(bool filled, const FuncType & func) const {
+			return getAllCellMeshWithIds(filled, detect_non_empty_cells(func));
+		}
+
+		/** List the occupied voxels that statisfy a condition (for instance fullness).
+		\param func the predicate to evaluate, will receive as unique argument a voxel (CellType).
+		\return a list of linear indices of all occupied voxels such that func(voxel) is true, in increasing order.
+		\note Unoccupied voxels are not tested, even if func(background) is true.
+		*/
+		template<typename FuncType>
+		std::vector<std::size_t> detect_non_empty_cells(const FuncType & func) const;
+
+		/** Intersect a ray with the voxel grid, listing the occupied intersected voxels.
+		\param ray the ray to cast
+		\return linear IDs of the intersected voxels, from the nearest
+		*/
+		std::vector<size_t> rayMarchOccupied(const Ray & ray) const;
+
+		/** \return the number of occupied voxels. */
+		size_t occupiedCount() const { return _occupied; }
+
+		/** \return the number of allocated bricks. */
+		size_t bricksCount() const { return _bricks.size(); }
+
+		/** \return the approximate memory used by the voxels, in bytes. */
+		size_t memorySize() const { return _bricks.size() * (sizeof(Brick) + sizeof(size_t) + 2 * sizeof(void*)); }
+
+		/** \return the value of the voxels never written. */
+		const CellType & background() const { return _background; }
+
+	private:
+
+		static const int kBrickCells = BrickSize * BrickSize * BrickSize;
+		static const int kMaskWords = (kBrickCells + 63) / 64;
+
+		/// Block of voxels and their occupancy.
+		struct Brick {
+			std::array<CellType, kBrickCells> cells; ///< Voxels.
+			std::array<uint64_t, kMaskWords> mask; ///< Occupancy bits.
+			int count = 0; ///< Occupied voxels.
+		};
+
+		/// \return the brick linear index of a voxel.
+		size_t brickId(const sibr::Vector3i & cell) const {
+			const sibr::Vector3i b = cell / BrickSize;
+			return size_t(b[0]) + size_t(_bricksDims[0]) * (size_t(b[1]) + size_t(_bricksDims[1]) * size_t(b[2]));
+		}
+
+		/// \return the index of a voxel in its brick.
+		static int localId(const sibr::Vector3i & cell) {
+			return (cell[0] % BrickSize) + BrickSize * ((cell[1] % BrickSize) + BrickSize * (cell[2] % BrickSize));
+		}
+
+		/// \return the first cell of a brick.
+		sibr::Vector3i brickOrigin(size_t id) const {
+			const size_t x = id % size_t(_bricksDims[0]);
+			id /= size_t(_bricksDims[0]);
+			const size_t y = id % size_t(_bricksDims[1]);
+			return BrickSize * sibr::Vector3i(int(x), int(y), int(id / size_t(_bricksDims[1])));
+		}
+
+		/// Get a voxel, allocating its brick and marking it occupied.
+		CellType & at(const sibr::Vector3i & cell);
+
+		/// Get a voxel, or the background.
+		const CellType & at(const sibr::Vector3i & cell) const;
+
+		/// Visit the occupied voxels of a brick.
+		template<typename BrickType, typename FuncType>
+		void visitBrick(size_t id, BrickType & brick, const FuncType & func) const;
+
+		CellType _background; ///< Value of the voxels never written.
+		sibr::Vector3i _bricksDims; ///< Number of bricks along each axis.
+		std::unordered_map<size_t, std::unique_ptr<Brick>> _bricks; ///< Allocated bricks.
+		size_t _occupied = 0; ///< Number of occupied voxels.
+	};
+
+	/** }@ */
+
+	template<typename CellType, int BrickSize>
+	CellType & SparseVoxelGrid<CellType, BrickSize>::at(const sibr::Vector3i & cell)
+	{
+		if (outOfBounds(cell)) {
+			SIBR_ERR << cell << " " << dims;
+		}
+		std::unique_ptr<Brick> & brick = _bricks[brickId(cell)];
+		if (!brick) {
+			brick.reset(new Brick());
+			brick->cells.fill(_background);
+			brick->mask.fill(0);
+		}
+		const int local = localId(cell);
+		uint64_t & word = brick->mask[local / 64];
+		const uint64_t bit = uint64_t(1) << (local % 64);
+		if (!(word & bit)) {
+			word |= bit;
+			++brick->count;
+			++_occupied;
+		}
+		return brick->cells[local];
+	}
+
+	template<typename CellType, int BrickSize>
+	const CellType & SparseVoxelGrid<CellType, BrickSize>::at(const sibr::Vector3i & cell) const
+	{
+		if (outOfBounds(cell)) {
+			SIBR_ERR << cell << " " << dims;
+		}
+		const auto brick = _bricks.find(brickId(cell));
+		return brick == _bricks.end() ? _background : brick->second->cells[localId(cell)];
+	}
+
+	template<typename CellType, int BrickSize>
+	bool SparseVoxelGrid<CellType, BrickSize>::isOccupied(size_t cell_id) const
+	{
+		const sibr::Vector3i cell = getCell(cell_id);
+		const auto brick = _bricks.find(brickId(cell));
+		if (brick == _bricks.end()) {
+			return false;
+		}
+		const int local = localId(cell);
+		return (brick->second->mask[local / 64] >> (local % 64)) & 1;
+	}
+
+	template<typename CellType, int BrickSize>
+	void SparseVoxelGrid<CellType, BrickSize>::erase(size_t cell_id)
+	{
+		const sibr::Vector3i cell = getCell(cell_id);
+		const auto brick = _bricks.find(brickId(cell));
+		if (brick == _bricks.end()) {
+			return;
+		}
+		const int local = localId(cell);
+		uint64_t & word = brick->second->mask[local / 64];
+		const uint64_t bit = uint64_t(1) << (local % 64);
+		if (!(word & bit)) {
+			return;
+		}
+		word &= ~bit;
+		brick->second->cells[local] = _background;
+		--_occupied;
+		if (--brick->second->count == 0) {
+			_bricks.erase(brick);
+		}
+	}
+
+	template<typename CellType, int BrickSize> template<typename BrickType, typename FuncType>
+	void SparseVoxelGrid<CellType, BrickSize>::visitBrick(size_t id, BrickType & brick, const FuncType & func) const
+	{
+		const sibr::Vector3i origin = brickOrigin(id);
+		for (int w = 0; w < kMaskWords; ++w) {
+			for (uint64_t word = brick.mask[w]; word != 0; word &= word - 1) {
+				int bit = 0;
+				while (!((word >> bit) & 1)) {
+					++bit;
+				}
+				const int local = 64 * w + bit;
+				const sibr::Vector3i cell = origin + sibr::Vector3i(local % BrickSize, (local / BrickSize) % BrickSize, local / (BrickSize * BrickSize));
+				func(getCellId(cell), brick.cells[local]);
+			}
+		}
+	}
+
+	template<typename CellType, int BrickSize> template<typename FuncType>
+	void SparseVoxelGrid<CellType, BrickSize>::forEachOccupied(const FuncType & func)
+	{
+		for (auto & brick : _bricks) {
+			visitBrick(brick.first, *brick.second, func);
+		}
+	}
+
+	template<typename CellType, int BrickSize> template<typename FuncType>
+	void SparseVoxelGrid<CellType, BrickSize>::forEachOccupied(const FuncType & func) const
+	{
+		for (const auto & brick : _bricks) {
+			visitBrick(brick.first, static_cast<const Brick &>(*brick.second), func);
+		}
+	}
+
+	template<typename CellType, int BrickSize> template<typename FuncType>
+	std::vector<std::size_t> SparseVoxelGrid<CellType, BrickSize>::detect_non_empty_cells(const FuncType & func) const
+	{
+		std::vector<std::size_t> out_ids;
+		forEachOccupied([&](size_t id, const CellType & cell) {
+			if (func(cell)) {
+				out_ids.push_back(id);
+			}
+		});
+		// Same order as the dense grid.
+		std::sort(out_ids.begin(), out_ids.end());
+		return out_ids;
+	}
+
+	template<typename CellType, int BrickSize>
+	std::vector<size_t> SparseVoxelGrid<CellType, BrickSize>::rayMarchOccupied(const Ray & ray) const
+	{
+		std::vector<size_t> cells;
+		rayMarch(ray, [this, &cells](size_t id) {
+			if (isOccupied(id)) {
+				cells.push_back(id);
+			}
+			return true;
+		});
+		return cells;
+	}
+
+} // namespace sibr
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/raycaster/VisibilityQuery.hpp"
+#include <algorithm>
+
+namespace sibr
+{
+	namespace {
+
+		/// Number of points whose rays are cast together.
+		const size_t kTilePoints = 64;
+
+		/// Same on the GPU, bounding the memory of a batch.
+		const size_t kGPUTilePoints = size_t(1) << 16;
+
+		/// \return the number of bits set.
+		size_t popCount(uint64_t word)
+		{
+			size_t count = 0;
+			for (; word != 0; word &= word - 1) {
+				++count;
+			}
+			return count;
+		}
+	}
+
+	VisibilitySet::VisibilitySet(size_t points, size_t cameras)
+		: _points(points), _cameras(cameras), _stride((cameras + 63) / 64), _words(points * _stride, 0)
+	{
+	}
+
+	size_t VisibilitySet::count(size_t point) const
+	{
+		size_t count = 0;
+		for (size_t w = 0; w < _stride; ++w) {
+			count += popCount(_words[point * _stride + w]);
+		}
+		return count;
+	}
+
+	std::vector<uint> VisibilitySet::cameras(size_t point) const
+	{
+		std::vector<uint> ids;
+		for (size_t w = 0; w < _stride; ++w) {
+			for (uint64_t word = _words[point * _stride + w]; word != 0; word &= word - 1) {
+				uint bit = 0;
+				while (((word >> bit) & 1ull) == 0) {
+					++bit;
+				}
+				ids.push_back(uint(w * 64) + bit);
+			}
+		}
+		return ids;
+	}
+
+	VisibilityQuery::VisibilityQuery(Raycaster & raycaster, const std::vector<InputCamera::Ptr> & cameras)
+		: _raycaster(raycaster)
+	{
+		_cameras.reserve(cameras.size());
+		for (const auto & cam : cameras) {
+			_cameras.emplace_back(*cam);
+		}
+	}
+
+	VisibilityQuery::VisibilityQuery(Raycaster & raycaster, const std::vector<RaycastingCamera> & cameras)
+		: _raycaster(raycaster), _cameras(cameras)
+	{
+	}
+
+	VisibilitySet VisibilityQuery::query(const std::vector<sibr::Vector3f> & points) const
+	{
+		VisibilitySet result(points.size(), _cameras.size());
+		if (points.empty() || _cameras.empty()) {
+			return result;
+		}
+		// The workers only read the scene.
+		if (!_raycaster.init()) {
+			SIBR_ERR << "cannot initialize embree, failed cast rays." << std::endl;
+		}
+		_raycaster.commit();
+
+		// The GPU backend is fed from this thread, with large batches.
+		const bool gpu = _raycaster.usesGPU();
+		const size_t tilePoints = gpu ? kGPUTilePoints : kTilePoints;
+		const int64_t tiles = int64_t((points.size() + tilePoints - 1) / tilePoints);
+#pragma omp parallel if(!gpu)
+		{
+			Raycaster::RayBatch rays;
+			std::vector<std::pair<uint, uint>> pairs; // (point, camera) of each ray.
+			std::vector<uint8_t> occluded;
+
+#pragma omp for schedule(dynamic)
+			for (int64_t tile = 0; tile < tiles; ++tile) {
+				const size_t begin = size_t(tile) * tilePoints;
+				const size_t end = std::min(begin + tilePoints, points.size());
+				rays.clear();
+				pairs.clear();
+
+				// Camera-major order: consecutive rays share their origin.
+				for (uint c = 0; c < uint(_cameras.size()); ++c) {
+					const RaycastingCamera & cam = _cameras[c];
+					for (size_t p = begin; p < end; ++p) {
+						if (!cam.isInsideFrustum(points[p], _frustumEpsilon)) {
+							continue;
+						}
+						sibr::Vector3f dir = points[p] - cam.position();
+						const float dist = dir.norm();
+						if (dist <= 0.0f) {
+							result.set(p, c);
+							continue;
+						}
+						rays.add(cam.position(), dir / dist, dist * (1.0f - _relativeEpsilon) - _epsilon);
+						pairs.emplace_back(uint(p), c);
+					}
+				}
+
+				occluded.resize(rays.size());
+				_raycaster.occludedStream(rays.stream(), occluded.data(), 0.0f, true);
+				for (size_t r = 0; r < pairs.size(); ++r) {
+					if (!occluded[r]) {
+						result.set(pairs[r].first, pairs[r].second);
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+} // namespace sibr
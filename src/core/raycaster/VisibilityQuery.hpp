@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <vector>
+# include <cstdint>
+# include <core/assets/InputCamera.hpp>
+# include "core/raycaster/Config.hpp"
+# include "core/raycaster/Raycaster.hpp"
+# include "core/raycaster/CameraRaycaster.hpp"
+
+namespace sibr
+{
+
+	/** Visibility of a set of points in a set of cameras, stored as one bit per (point, camera) pair.
+	 \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT VisibilitySet
+	{
+	public:
+
+		/** Constructor, no point is visible.
+		\param points the number of points
+		\param cameras the number of cameras
+		*/
+		VisibilitySet(size_t points = 0, size_t cameras = 0);
+
+		/** \return true if the point is visible in the camera.
+		\param point the point index
+		\param camera the camera index
+		*/
+		bool visible(size_t point, size_t camera) const {
+			return ((_words[point * _stride + camera / 64] >> (camera % 64)) & 1ull) != 0;
+		}
+
+		/** Flag the point as visible in the camera.
+		\param point the point index
+		\param camera the camera index
+		\note Points are stored on separate words, different points can be set from different threads.
+		*/
+		void set(size_t point, size_t camera) {
+			_words[point * _stride + camera / 64] |= 1ull << (camera % 64);
+		}
+
+		/** \return the number of cameras the point is visible in.
+		\param point the point index
+		*/
+		size_t count(size_t point) const;
+
+		/** \return the indices of the cameras the point is visible in, in increasing order.
+		\param point the point index
+		*/
+		std::vector<uint> cameras(size_t point) const;
+
+		/** \return the number of points. */
+		size_t pointsCount() const { return _points; }
+
+		/** \return the number of cameras. */
+		size_t camerasCount() const { return _cameras; }
+
+	private:
+		size_t _points; ///< Number of points.
+		size_t _cameras; ///< Number of cameras.
+		size_t _stride; ///< Words per point.
+		std::vector<uint64_t> _words; ///< Visibility bits, point-major.
+	};
+
+	/** Answer "which of these cameras see this point unoccluded?" for many points at once.
+	 Each point is frustum-tested against each camera; for the cameras containing it, a ray is cast from
+	 the camera center towards the point. Points are processed by tiles, whose occlusion rays are sent
+	 as one coherent batch per camera, and tiles are distributed over threads. When the raycaster runs
+ on the GPU (see Raycaster::backend), much larger tiles are sent in turn instead.
+
+		VisibilityQuery visibility(raycaster, cameras);
+		const VisibilitySet visible = visibility.query(points);
+		for (uint cid : visible.cameras(pid)) { ... }
+
+	 \ingroup sibr_raycaster
+	*/
+	class SIBR_RAYCASTER_EXPORT VisibilityQuery
+	{
+	public:
+
+		/** Constructor.
+		\param raycaster the scene occluding the points, must outlive the query
+		\param cameras the cameras
+		*/
+		VisibilityQuery(Raycaster & raycaster, const std::vector<InputCamera::Ptr> & cameras);
+
+		/** Constructor.
+		\param raycaster the scene occluding the points, must outlive the query
+		\param cameras the cameras
+		*/
+		VisibilityQuery(Raycaster & raycaster, const std::vector<RaycastingCamera> & cameras);
+
+		/** Compute the visibility of points in all the cameras.
+		\param points the points
+		\return the visibility of each point in each camera
+		*/
+		VisibilitySet query(const std::vector<sibr::Vector3f> & points) const;
+
+		/** \return the distance before the point below which occluders are ignored. */
+		float & epsilon() { return _epsilon; }
+
+		/** \return the same tolerance, as a fraction of the distance between the camera and the point. */
+		float & relativeEpsilon() { return _relativeEpsilon; }
+
+		/** \return the tolerance of the frustum test, see RaycastingCamera::isInsideFrustum. */
+		float & frustumEpsilon() { return _frustumEpsilon; }
+
+		/** \return the cameras. */
+		const std::vector<RaycastingCamera> & cameras() const { return _cameras; }
+
+	private:
+		Raycaster & _raycaster; ///< Occluding scene.
+		std::vector<RaycastingCamera> _cameras; ///< Cameras with their frustum planes.
+		float _epsilon = 0.0001f; ///< Absolute occlusion tolerance.
+		float _relativeEpsilon = 0.0f; ///< Relative occlusion tolerance.
+		float _frustumEpsilon = 0.0001f; ///< Frustum test tolerance.
+	};
+
+} // namespace sibr
@@ -100,7 +100,7 @@ namespace sibr {
 
 	size_t VoxelGridBase::getNumCells() const
 	{
-		return (size_t)dims.prod();
+		return size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]);
 	}
 
 	const sibr::Vector3i & VoxelGridBase::getDims() const
@@ -115,12 +115,11 @@ namespace sibr {
 		}
 
 		sibr::Vector3i cell;
-	
-		std::div_t div;
+
+		// Large grids can have more cells than an int can index.
 		for (int i = 0; i < 2; ++i) {
-			div = std::div((int)cellId, dims[i]);
-			cell[i] = div.rem;
-			cellId = div.quot;
+			cell[i] = int(cellId % size_t(dims[i]));
+			cellId /= size_t(dims[i]);
 		}
 		cell[2] = (int)cellId;
 
@@ -170,6 +169,16 @@ namespace sibr {
 	}
 
 	std::vector<size_t> VoxelGridBase::rayMarch(const Ray & ray) const
+	{
+		std::vector<size_t> visitedCellsIds;
+		rayMarch(ray, [&visitedCellsIds](size_t cellId) {
+			visitedCellsIds.push_back(cellId);
+			return true;
+		});
+		return visitedCellsIds;
+	}
+
+	bool VoxelGridBase::initMarch(const Ray & ray, MarchState & state) const
 	{
 		sibr::Vector3f start = ray.orig();
 
@@ -178,38 +187,27 @@ namespace sibr {
 			if (intersectionWithBox(ray, intersection)) {
 				start = intersection;
 			} else {
-				return {};
+				return false;
 			}
 		}
 		
 		start = start.cwiseMax(box.min()).cwiseMin(box.max() - 0.01f*getCellSize());
 
-		sibr::Vector3i currentVoxel = getCell(start);
+		state.voxel = getCell(start);
+		state.cellId = getCellId(state.voxel);
 	
-		sibr::Vector3i steps = ray.dir().unaryExpr([](float f) { return f >= 0 ? 1 : -1; }).cast<int>();
+		state.steps = ray.dir().unaryExpr([](float f) { return f >= 0 ? 1 : -1; }).cast<int>();
 
-		const sibr::Vector3f deltas = getCellSize().cwiseQuotient(ray.dir().cwiseAbs());
+		state.deltas = getCellSize().cwiseQuotient(ray.dir().cwiseAbs());
 		const sibr::Vector3f frac = (start - box.min()).cwiseQuotient(getCellSize()).unaryExpr([](float f) { return f - std::floor(f); });
-		sibr::Vector3i finalVoxels; 
-		sibr::Vector3f ts;
+		const size_t strides[3] = { 1, size_t(dims[0]), size_t(dims[0]) * size_t(dims[1]) };
 		for (int c = 0; c < 3; c++) {
-			ts[c] = deltas[c] * (ray.dir()[c] >= 0 ? 1.0f - frac[c] : frac[c]);
-			finalVoxels[c] = (ray.dir()[c] >= 0 ? dims[c] : -1);
+			state.ts[c] = state.deltas[c] * (ray.dir()[c] >= 0 ? 1.0f - frac[c] : frac[c]);
+			state.finalVoxels[c] = (ray.dir()[c] >= 0 ? dims[c] : -1);
+			// Unsigned wrap-around gives the decrement.
+			state.idSteps[c] = state.steps[c] > 0 ? strides[c] : size_t(0) - strides[c];
 		}
-
-		std::vector<size_t> visitedCellsIds;
-		while (true) {
-			visitedCellsIds.push_back(getCellId(currentVoxel));
-		
-			int c = getMinIndex(ts);
-			currentVoxel[c] += steps[c];
-			if (currentVoxel[c] == finalVoxels[c]) {
-				break;
-			}
-			ts[c] += deltas[c];
-		}
-
-		return visitedCellsIds;
+		return true;
 	}
 
 	sibr::Mesh::Ptr VoxelGridBase::getCellMesh(const sibr::Vector3i & cell) const
@@ -232,6 +230,39 @@ namespace sibr {
 		return getAllCellMeshInternal(true);
 	}
 
+	sibr::Mesh::Ptr VoxelGridBase::getAllCellMeshWithIds(bool filled, std::vector<std::size_t> cell_ids) const
+	{
+		int numNonZero = (int)cell_ids.size();
+
+		auto out = std::make_shared<sibr::Mesh>();
+
+		sibr::Mesh::Ptr baseMesh = filled ? baseCellMeshFilled : baseCellMesh;
+
+		const int numT = (int)baseMesh->triangles().size();
+		const int numTtotal = numNonZero * numT;
+		const int numV = (int)baseMesh->vertices().size();
+		const int numVtotal = numNonZero * numV;
+		const sibr::Vector3u offsetT = sibr::Vector3u(numV, numV, numV);
+
+		sibr::Mesh::Vertices vs(numVtotal);
+		sibr::Mesh::Triangles ts(numTtotal);
+		for (int i = 0; i < numNonZero; ++i) {
+			const auto cell = getCell(cell_ids[i]);
+			const sibr::Vector3f offsetV = cell.cast<float>().array() * getCellSize().array();
+
+			for (int v = 0; v < numV; ++v) {
+				vs[i * numV + v] = baseMesh->vertices()[v] + offsetV;
+			}
+			for (int t = 0; t < numT; ++t) {
+				ts[i * numT + t] = baseMesh->triangles()[t] + i * offsetT;
+			}
+		}
+
+		out->vertices(vs);
+		out->triangles(ts);
+		return out;
+	}
+
 	Eigen::AlignedBox3f VoxelGridBase::getCellBox(size_t cellId) const
 	{
 		sibr::Vector3i cell = getCell(cellId);
@@ -368,7 +399,7 @@ namespace sibr {
 		if (outOfBounds(v)) {
 			SIBR_ERR << v << " " << dims;
 		}
-		return v[0] + dims[0] * (v[1] + dims[1] * v[2]); //v[2] + dims[2] * (v[1] + dims[1] * v[0]);
+		return size_t(v[0]) + size_t(dims[0]) * (size_t(v[1]) + size_t(dims[1]) * size_t(v[2])); //v[2] + dims[2] * (v[1] + dims[1] * v[0]);
 	}
 
 	size_t VoxelGridBase::getCellId(const sibr::Vector3f & world_pos) const
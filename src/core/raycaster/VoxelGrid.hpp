@@ -122,6 +122,23 @@ namespace sibr
 		*/
 		std::vector<size_t> rayMarch(const Ray & ray) const;
 
+		/** Intersect a ray with the voxel grid, visiting the intersected voxels from the nearest, without allocating.
+		\param ray the ray to cast
+		\param visitor will receive the linear ID of each voxel, and return false to stop the traversal
+		\return false if the traversal was stopped by the visitor
+		*/
+		template<typename VisitorType>
+		bool rayMarch(const Ray & ray, const VisitorType & visitor) const;
+
+		/** Intersect rays with the voxel grid in parallel, visiting the intersected voxels of each ray from the nearest.
+		The visitor is called concurrently from multiple threads: to accumulate per-voxel values (votes, carving counters),
+		use atomic counters or \#pragma omp atomic.
+		\param rays the rays to cast
+		\param visitor will receive the ray index and the linear ID of each voxel, and return false to stop the ray traversal
+		*/
+		template<typename VisitorType>
+		void rayMarch(const std::vector<Ray> & rays, const VisitorType & visitor) const;
+
 		/** Generate a wireframe mesh representing a voxel.
 		\param cell the voxel integer coordinates
 		\return the generated wireframe cube mesh
@@ -144,6 +161,13 @@ namespace sibr
 		*/
 		sibr::Mesh::Ptr getAllCellMeshFilled() const;
 
+		/** Get cell meshes from their ids.
+		\param filled should the mesh be wireframe (false) or faceted (true)
+		\param cell_ids ids of cell meshes.
+		\return the generated mesh
+		*/
+		sibr::Mesh::Ptr getAllCellMeshWithIds(bool filled, std::vector<std::size_t> cell_ids) const;
+
 		/** Get a voxel bounding box.
 		\param cellId the voxel linear index
 		\return the bounding box.
@@ -208,6 +232,24 @@ namespace sibr
 
 	protected:
 
+		/** Traversal state of a ray through the grid. */
+		struct MarchState {
+			sibr::Vector3i voxel; ///< Current voxel coordinates.
+			size_t cellId; ///< Current voxel linear ID.
+			sibr::Vector3f ts; ///< Ray parameter of the next boundary along each axis.
+			sibr::Vector3f deltas; ///< Ray parameter covered by a voxel along each axis.
+			sibr::Vector3i steps; ///< Voxel step along each axis.
+			sibr::Vector3i finalVoxels; ///< Coordinate past the grid along each axis.
+			size_t idSteps[3]; ///< Linear ID increment along each axis (modulo 2^64 for negative steps).
+		};
+
+		/** Setup the traversal of a ray.
+		\param ray the ray to cast
+		\param state will contain the initial traversal state
+		\return false if the ray misses the grid
+		*/
+		bool initMarch(const Ray & ray, MarchState & state) const;
+
 		/** Helper to generate a voxel mesh.
 		\param cell the coordinates of the voxel to generate
 		\param filled should the mesh be wireframe (false) or faceted (true)
@@ -324,13 +366,6 @@ namespace sibr
 		template<typename FuncType>
 		sibr::Mesh::Ptr getAllCellMeshWithCond(bool filled, const FuncType & func) const;
 
-		/** Get cell meshes from their ids.
-		\param filled should the mesh be wireframe (false) or faceted (true)
-		\param cell_ids ids of cell meshes.
-		\return the generated mesh
-		*/
-		sibr::Mesh::Ptr getAllCellMeshWithIds(bool filled, std::vector<std::size_t> cell_ids) const;
-
 		/** List the voxels that statisfy a condition (for instance fullness)
 		\param func the predicate to evaluate, will receive as unique argument a voxel (CellType).
 		\return a list of linear indices of all voxels such that func(voxel) is true.
@@ -350,6 +385,40 @@ namespace sibr
 
 
 
+	template<typename VisitorType>
+	bool VoxelGridBase::rayMarch(const Ray & ray, const VisitorType & visitor) const
+	{
+		MarchState state;
+		if (!initMarch(ray, state)) {
+			return true;
+		}
+		// Neighbor linear IDs are obtained by increments instead of recomputing them from the coordinates.
+		while (true) {
+			if (!visitor(state.cellId)) {
+				return false;
+			}
+			const int c = getMinIndex(state.ts);
+			state.voxel[c] += state.steps[c];
+			if (state.voxel[c] == state.finalVoxels[c]) {
+				return true;
+			}
+			state.cellId += state.idSteps[c];
+			state.ts[c] += state.deltas[c];
+		}
+	}
+
+	template<typename VisitorType>
+	void VoxelGridBase::rayMarch(const std::vector<Ray> & rays, const VisitorType & visitor) const
+	{
+		const int64_t raysCount = int64_t(rays.size());
+		// Ray lengths vary a lot, balance the load dynamically.
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int64_t rid = 0; rid < raysCount; ++rid) {
+			const size_t id = size_t(rid);
+			rayMarch(rays[id], [&visitor, id](size_t cellId) { return visitor(id, cellId); });
+		}
+	}
+
 	template<typename CellType> template<typename FuncType>
 	inline std::vector<std::size_t> VoxelGrid<CellType>::detect_non_empty_cells(const FuncType & func) const {
 		std::vector<std::size_t> out_ids;
@@ -370,39 +439,5 @@ namespace sibr
 
 	/** }@ */
 
-	template<typename CellType>
-	inline sibr::Mesh::Ptr VoxelGrid<CellType>::getAllCellMeshWithIds(bool filled, std::vector<std::size_t> cell_ids) const
-	{
-		int numNonZero = (int)cell_ids.size();
-
-		auto out = std::make_shared<sibr::Mesh>();
-
-		sibr::Mesh::Ptr baseMesh = filled ? baseCellMeshFilled : baseCellMesh;
-
-		const int numT = (int)baseMesh->triangles().size();
-		const int numTtotal = numNonZero * numT;
-		const int numV = (int)baseMesh->vertices().size();
-		const int numVtotal = numNonZero * numV;
-		const sibr::Vector3u offsetT = sibr::Vector3u(numV, numV, numV);
-
-		sibr::Mesh::Vertices vs(numVtotal);
-		sibr::Mesh::Triangles ts(numTtotal);
-		for (int i = 0; i < numNonZero; ++i) {
-			const auto cell = getCell(cell_ids[i]);
-			const sibr::Vector3f offsetV = cell.cast<float>().array() * getCellSize().array();
-
-			for (int v = 0; v < numV; ++v) {
-				vs[i * numV + v] = baseMesh->vertices()[v] + offsetV;
-			}
-			for (int t = 0; t < numT; ++t) {
-				ts[i * numT + t] = baseMesh->triangles()[t] + i * offsetT;
-			}
-		}
-
-		out->vertices(vs);
-		out->triangles(ts);
-		return out;
-	}
-
 } // namespace sibr
 
@@ -10,27 +10,164 @@
  */
 
 
-
 #include <core/renderer/BlurRenderer.hpp>
+#include <core/graphics/GLState.hpp>
+#include <core/graphics/RenderTargetPool.hpp>
+
+#include <cmath>
 
 namespace sibr { 
+
+	namespace {
+
+		/** Taps on each side of the fragment kernel, must match gaussian_blur.frag. */
+		const int kMaxTaps = 17;
+		/** Largest kernel radius, in texels, also the apron of the compute tiles. */
+		const int kMaxRadius = 2 * (kMaxTaps - 1);
+		/** Threads per compute group, each one outputs a texel of a line. */
+		const int kTileSize = 256;
+		/** Above this standard deviation, AUTO blurs on a coarser level. */
+		const float kPyramidSigma = 8.0f;
+		/** Above this standard deviation, AUTO prefers the compute passes when available. */
+		const float kComputeSigma = 3.0f;
+
+		const char * kComputeSource = R"(#version 430
+			#define TILE_SIZE 256
+			#define MAX_RADIUS 32
+			layout(local_size_x = TILE_SIZE) in;
+
+			layout(binding = 0) uniform sampler2D image;
+			layout(binding = 0, rgba8) uniform writeonly image2D result;
+			layout(location = 0) uniform ivec2 direction;
+			layout(location = 1) uniform int radius;
+			layout(location = 2) uniform float weights[MAX_RADIUS + 1];
+
+			shared vec4 tile[TILE_SIZE + 2 * MAX_RADIUS];
+
+			void main(){
+				// Each group filters a segment of a line (or column), with its apron in shared memory.
+				const ivec2 size = textureSize(image, 0);
+				const int len = direction.x != 0 ? size.x : size.y;
+				const int lane = int(gl_LocalInvocationID.x);
+				const int start = int(gl_WorkGroupID.x) * TILE_SIZE;
+				const int line = int(gl_WorkGroupID.y);
+				for (int i = lane; i < TILE_SIZE + 2 * radius; i += TILE_SIZE) {
+					const int p = clamp(start + i - radius, 0, len - 1);
+					tile[i] = texelFetch(image, direction.x != 0 ? ivec2(p, line) : ivec2(line, p), 0);
+				}
+				barrier();
+
+				const int along = start + lane;
+				if (along >= len) {
+					return;
+				}
+				vec4 color = tile[lane + radius] * weights[0];
+				for (int i = 1; i <= radius; ++i) {
+					color += (tile[lane + radius - i] + tile[lane + radius + i]) * weights[i];
+				}
+				imageStore(result, direction.x != 0 ? ivec2(along, line) : ivec2(line, along), color);
+			}
+		)";
+
+		GLuint compileCompute(const char * source)
+		{
+			GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				SIBR_WRG << "[BlurRenderer] Compilation failed: " << log << std::endl;
+				glDeleteShader(shader);
+				return 0;
+			}
+			GLuint program = glCreateProgram();
+			glAttachShader(program, shader);
+			glLinkProgram(program);
+			glDeleteShader(shader);
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				SIBR_WRG << "[BlurRenderer] Link failed: " << log << std::endl;
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+
+		/** Normalized weights of one side of a discrete gaussian, the center included. */
+		std::vector<float> gaussianWeights(float sigma)
+		{
+			const int radius = sigma > 0.0f ? std::min(kMaxRadius, int(std::ceil(3.0f * sigma))) : 0;
+			std::vector<float> weights(radius + 1, 1.0f);
+			float sum = 1.0f;
+			for (int i = 1; i <= radius; ++i) {
+				weights[i] = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+				sum += 2.0f * weights[i];
+			}
+			for (float & w : weights) {
+				w /= sum;
+			}
+			return weights;
+		}
+
+		/** Merge pairs of taps into a single bilinear fetch placed between them. */
+		void linearTaps(const std::vector<float> & discrete, std::vector<float> & weights, std::vector<float> & offsets)
+		{
+			weights.assign(1, discrete[0]);
+			offsets.assign(1, 0.0f);
+			for (size_t i = 1; i < discrete.size(); i += 2) {
+				const float a = discrete[i];
+				const float b = i + 1 < discrete.size() ? discrete[i + 1] : 0.0f;
+				weights.push_back(a + b);
+				offsets.push_back((float(i) * a + float(i + 1) * b) / (a + b));
+			}
+		}
+
+	}
+
 	BlurRenderer::BlurRenderer( void )
 	{
 		_shader.init("BlurShader",
 			sibr::loadFile(sibr::getShadersDirectory("core") + "/texture.vert"),
 			sibr::loadFile(sibr::getShadersDirectory("core") + "/blur.frag"));
 		_paramImgSize.init(_shader, "in_image_size");
+
+		_gaussianShader.init("GaussianBlurShader",
+			sibr::loadFile(sibr::getShadersDirectory("core") + "/texture.vert"),
+			sibr::loadFile(sibr::getShadersDirectory("core") + "/gaussian_blur.frag"));
+		_gaussianDirection.init(_gaussianShader, "direction");
+		_gaussianCount.init(_gaussianShader, "count");
+		_gaussianWeights.init(_gaussianShader, "weights");
+		_gaussianOffsets.init(_gaussianShader, "offsets");
+
+		glGenSamplers(1, &_linearSampler);
+		glSamplerParameteri(_linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glSamplerParameteri(_linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(_linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(_linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	BlurRenderer::~BlurRenderer( void )
+	{
+		glDeleteSamplers(1, &_linearSampler);
+		if (_computeProgram) {
+			GLState::deleteProgram(_computeProgram);
+		}
 	}
 
 	void	BlurRenderer::process( uint textureID, const Vector2f& textureSize, IRenderTarget& dst )
 	{
 		dst.bind();
 
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		glDisable(GL_BLEND);
 
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, textureID );
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		_shader.begin();
 		_paramImgSize.set(textureSize);
 		RenderUtility::renderScreenQuad();
@@ -39,4 +176,139 @@ namespace sibr {
 		dst.unbind();
 	}
 
+	void	BlurRenderer::gaussian( uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst, GaussianMode mode )
+	{
+		if (mode == GaussianMode::AUTO) {
+			if (sigma > kPyramidSigma) {
+				mode = GaussianMode::PYRAMID;
+			} else if (sigma > kComputeSigma && GLEW_VERSION_4_3) {
+				mode = GaussianMode::COMPUTE;
+			} else {
+				mode = GaussianMode::SEPARABLE;
+			}
+		}
+
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Gaussian blur");
+		GLState::disable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		switch (mode) {
+		case GaussianMode::COMPUTE:
+			compute(textureID, textureSize, sigma, dst);
+			break;
+		case GaussianMode::PYRAMID:
+			pyramid(textureID, textureSize, sigma, dst);
+			break;
+		default:
+			separable(textureID, textureSize, sigma, dst);
+			break;
+		}
+		glPopDebugGroup();
+	}
+
+	void	BlurRenderer::gaussianPass(uint textureID, const Vector2i& textureSize, const Vector2f& direction, float sigma, IRenderTarget& dst)
+	{
+		std::vector<float> weights, offsets;
+		linearTaps(gaussianWeights(sigma), weights, offsets);
+
+		dst.bind();
+		glViewport(0, 0, dst.w(), dst.h());
+		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, textureID);
+		glBindSampler(0, _linearSampler);
+		_gaussianShader.begin();
+		_gaussianDirection.set(Vector2f(direction.cwiseQuotient(textureSize.cast<float>())));
+		_gaussianCount.set(int(weights.size()));
+		_gaussianWeights.setArray(weights.data(), int(weights.size()));
+		_gaussianOffsets.setArray(offsets.data(), int(offsets.size()));
+		RenderUtility::renderScreenQuad();
+		_gaussianShader.end();
+		glBindSampler(0, 0);
+		dst.unbind();
+	}
+
+	void	BlurRenderer::separable(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst)
+	{
+		RenderTargetRGBA::Ptr tmp = RenderTargetPool::global().acquire<unsigned char, 4>(textureSize[0], textureSize[1], SIBR_CLAMP_UVS);
+		gaussianPass(textureID, textureSize, Vector2f(1.0f, 0.0f), sigma, *tmp);
+		gaussianPass(tmp->handle(), textureSize, Vector2f(0.0f, 1.0f), sigma, dst);
+	}
+
+	void	BlurRenderer::compute(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst)
+	{
+		if (!_computeProgram && !_computeFailed && GLEW_VERSION_4_3) {
+			_computeProgram = compileCompute(kComputeSource);
+			_computeFailed = _computeProgram == 0;
+		}
+		if (!_computeProgram) {
+			separable(textureID, textureSize, sigma, dst);
+			return;
+		}
+
+		const std::vector<float> weights = gaussianWeights(sigma);
+		const int w = textureSize[0];
+		const int h = textureSize[1];
+		RenderTargetRGBA::Ptr tmp = RenderTargetPool::global().acquire<unsigned char, 4>(w, h, SIBR_CLAMP_UVS);
+		RenderTargetRGBA::Ptr out = RenderTargetPool::global().acquire<unsigned char, 4>(w, h, SIBR_CLAMP_UVS);
+
+		GLState::useProgram(_computeProgram);
+		glUniform1i(1, int(weights.size()) - 1);
+		glUniform1fv(2, GLsizei(weights.size()), weights.data());
+		glActiveTexture(GL_TEXTURE0);
+
+		// Horizontal pass, one group per segment of a line.
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glBindImageTexture(0, tmp->handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glUniform2i(0, 1, 0);
+		glDispatchCompute((w + kTileSize - 1) / kTileSize, h, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		// Vertical pass, one group per segment of a column.
+		glBindTexture(GL_TEXTURE_2D, tmp->handle());
+		glBindImageTexture(0, out->handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glUniform2i(0, 0, 1);
+		glDispatchCompute((h + kTileSize - 1) / kTileSize, w, 1);
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+		glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		GLState::useProgram(0);
+		blit(*out, dst);
+	}
+
+	void	BlurRenderer::pyramid(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst)
+	{
+		// Pick the level where the remaining blur is a few texels wide, keeping it large enough to be meaningful.
+		int levels = std::max(1, int(std::floor(std::log2(sigma / (0.5f * kPyramidSigma)))));
+		while (levels > 1 && std::min(textureSize[0], textureSize[1]) >> levels < 8) {
+			--levels;
+		}
+
+		// Each 2x2 box downsampling and the final bilinear upsampling already blur the image,
+		// only the remaining variance is applied at the coarse level.
+		float variance = sigma * sigma;
+		for (int l = 1; l <= levels; ++l) {
+			const float scale = float(1 << (l - 1));
+			variance -= 0.25f * scale * scale;
+		}
+		const float coarseScale = float(1 << levels);
+		variance -= coarseScale * coarseScale / 6.0f;
+		const float coarseSigma = std::sqrt(std::max(variance, 0.0f)) / coarseScale;
+
+		std::vector<RenderTargetRGBA::Ptr> steps(levels + 1);
+		for (int l = 1; l <= levels; ++l) {
+			steps[l] = RenderTargetPool::global().acquire<unsigned char, 4>(
+				std::max(1, textureSize[0] >> l), std::max(1, textureSize[1] >> l), SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING);
+		}
+		// The first level reads the input texture, bilinear sampling at half resolution is a 2x2 box.
+		gaussianPass(textureID, textureSize, Vector2f(0.0f, 0.0f), 0.0f, *steps[1]);
+		for (int l = 2; l <= levels; ++l) {
+			blit(*steps[l - 1], *steps[l]);
+		}
+
+		const RenderTargetRGBA::Ptr & coarse = steps[levels];
+		const Vector2i coarseSize(int(coarse->w()), int(coarse->h()));
+		RenderTargetRGBA::Ptr tmp = RenderTargetPool::global().acquire<unsigned char, 4>(coarseSize[0], coarseSize[1], SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING);
+		gaussianPass(coarse->handle(), coarseSize, Vector2f(1.0f, 0.0f), coarseSigma, *tmp);
+		gaussianPass(tmp->handle(), coarseSize, Vector2f(0.0f, 1.0f), coarseSigma, *coarse);
+		blit(*coarse, dst);
+	}
+
 } /*namespace sibr*/ 
@@ -29,9 +29,20 @@ namespace sibr {
 
 	public:
 
+		/** Gaussian blur implementation. */
+		enum class GaussianMode {
+			SEPARABLE, ///< Two fragment passes, taps reduced by bilinear sampling.
+			COMPUTE, ///< Two compute passes on shared memory tiles (OpenGL 4.3).
+			PYRAMID, ///< Downsample, blur at a coarser level and upsample, approximate but independent of the radius.
+			AUTO ///< Pick one depending on the radius and the hardware.
+		};
+
 		/// Constructor.
 		BlurRenderer( void );
 
+		/// Destructor.
+		~BlurRenderer( void );
+
 		/** Process the texture.
 		\param textureID the texture to blur
 		\param textureSize the texture dimensions
@@ -42,11 +53,67 @@ namespace sibr {
 			/*input*/	const Vector2f& textureSize,
 			/*output*/	IRenderTarget& dst );
 
+		/** Gaussian blur of the texture.
+		\param textureID the texture to blur
+		\param textureSize the texture dimensions
+		\param sigma the standard deviation, in texels
+		\param dst the destination rendertarget
+		\param mode the implementation to use
+		*/
+		void	gaussian(
+			/*input*/	uint textureID,
+			/*input*/	const Vector2i& textureSize,
+			/*input*/	float sigma,
+			/*output*/	IRenderTarget& dst,
+			/*input*/	GaussianMode mode = GaussianMode::AUTO );
+
 	private:
 
+		/** Separable blur with fragment passes.
+		\param textureID the texture to blur
+		\param textureSize the texture dimensions
+		\param sigma the standard deviation, in texels
+		\param dst the destination rendertarget
+		*/
+		void	separable(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst);
+
+		/** Separable blur with compute passes, falls back to the fragment passes if unsupported.
+		\param textureID the texture to blur
+		\param textureSize the texture dimensions
+		\param sigma the standard deviation, in texels
+		\param dst the destination rendertarget
+		*/
+		void	compute(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst);
+
+		/** Blur on a coarser level of a pyramid.
+		\param textureID the texture to blur
+		\param textureSize the texture dimensions
+		\param sigma the standard deviation, in texels
+		\param dst the destination rendertarget
+		*/
+		void	pyramid(uint textureID, const Vector2i& textureSize, float sigma, IRenderTarget& dst);
+
+		/** One fragment pass of the separable blur.
+		\param textureID the texture to read
+		\param textureSize the texture dimensions
+		\param direction the blur axis
+		\param sigma the standard deviation, in texels
+		\param dst the destination rendertarget
+		*/
+		void	gaussianPass(uint textureID, const Vector2i& textureSize, const Vector2f& direction, float sigma, IRenderTarget& dst);
+
 		GLShader			_shader; ///< Blur shader.
 		GLParameter			_paramImgSize; ///< Texture size uniform.
 
+		GLShader			_gaussianShader; ///< Separable gaussian shader.
+		GLParameter			_gaussianDirection; ///< Texel step along the blur axis.
+		GLParameter			_gaussianCount; ///< Number of taps on each side.
+		GLParameter			_gaussianWeights; ///< Taps weights.
+		GLParameter			_gaussianOffsets; ///< Taps offsets.
+		GLuint				_linearSampler = 0; ///< Bilinear sampler, the input textures might not be filtered.
+		GLuint				_computeProgram = 0; ///< Compute blur program, created on first use.
+		bool				_computeFailed = false; ///< The compute program is not available.
+
 	};
 
 } /*namespace sibr*/ 
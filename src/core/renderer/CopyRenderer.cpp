@@ -21,19 +21,82 @@ namespace sibr {
 			sibr::loadFile(fragFile));
 
 		_flip.init(_shader, "flip");
+		_defaultShader = vertFile == sibr::getShadersDirectory("core") + "/noproj.vert"
+			&& fragFile == sibr::getShadersDirectory("core") + "/copy.frag";
+	}
+
+	CopyRenderer::~CopyRenderer()
+	{
+		if (_readFramebuffer) {
+			GLState::deleteFramebuffers(1, &_readFramebuffer);
+		}
+	}
+
+	bool	CopyRenderer::fastCopy(uint textureID, GLuint dstFramebuffer, int x, int y, int w, int h, GLuint dstTexture)
+	{
+		// Custom shaders can do anything, and blending needs the draw.
+		if (!_defaultShader || !(GLEW_ARB_direct_state_access || GLEW_VERSION_4_5) || glIsEnabled(GL_BLEND)) {
+			return false;
+		}
+		GLint srcW = 0, srcH = 0, srcFormat = 0, srcType = 0;
+		glGetTextureLevelParameteriv(textureID, 0, GL_TEXTURE_WIDTH, &srcW);
+		glGetTextureLevelParameteriv(textureID, 0, GL_TEXTURE_HEIGHT, &srcH);
+		glGetTextureLevelParameteriv(textureID, 0, GL_TEXTURE_INTERNAL_FORMAT, &srcFormat);
+		glGetTextureLevelParameteriv(textureID, 0, GL_TEXTURE_RED_TYPE, &srcType);
+		// Resampling is left to the shader filtering, integer textures can't be sampled by copy.frag
+		// and depth textures have no color to blit.
+		if (srcW != w || srcH != h || srcType == GL_INT || srcType == GL_UNSIGNED_INT || srcType == GL_NONE) {
+			return false;
+		}
+
+		if (dstTexture && !_flip.get() && !glIsEnabled(GL_SCISSOR_TEST) && (GLEW_ARB_copy_image || GLEW_VERSION_4_3)) {
+			GLint dstFormat = 0;
+			glGetTextureLevelParameteriv(dstTexture, 0, GL_TEXTURE_INTERNAL_FORMAT, &dstFormat);
+			if (dstFormat == srcFormat) {
+				glCopyImageSubData(textureID, GL_TEXTURE_2D, 0, 0, 0, 0, dstTexture, GL_TEXTURE_2D, 0, x, y, 0, w, h, 1);
+				return true;
+			}
+		}
+
+		// Blit, converting the format and flipping if needed. Only the first color attachment is written, as with the quad.
+		if (!_readFramebuffer) {
+			glCreateFramebuffers(1, &_readFramebuffer);
+			glNamedFramebufferReadBuffer(_readFramebuffer, GL_COLOR_ATTACHMENT0);
+		}
+		glNamedFramebufferTexture(_readFramebuffer, GL_COLOR_ATTACHMENT0, textureID, 0);
+		if (dstFramebuffer != 0) {
+			// Reset by the next bind of the rendertarget.
+			glNamedFramebufferDrawBuffer(dstFramebuffer, GL_COLOR_ATTACHMENT0);
+		}
+		const int y0 = _flip.get() ? y + h : y;
+		const int y1 = _flip.get() ? y : y + h;
+		glBlitNamedFramebuffer(_readFramebuffer, dstFramebuffer, 0, 0, w, h, x, y0, x + w, y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glNamedFramebufferTexture(_readFramebuffer, GL_COLOR_ATTACHMENT0, 0, 0);
+		return true;
 	}
 
 	void	CopyRenderer::process( uint textureID, IRenderTarget& dst, bool disableTest )
 	{
 		if (disableTest)
-			glDisable(GL_DEPTH_TEST);
+			GLState::disable(GL_DEPTH_TEST);
 		else
-			glEnable(GL_DEPTH_TEST);
+			GLState::enable(GL_DEPTH_TEST);
+
+		dst.clear();
+
+		// Without depth test the alpha is not written to depth, a plain copy of the viewport is enough.
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		const bool inside = viewport[0] >= 0 && viewport[1] >= 0
+			&& viewport[0] + viewport[2] <= int(dst.w()) && viewport[1] + viewport[3] <= int(dst.h());
+		if (disableTest && inside && fastCopy(textureID, dst.fbo(), viewport[0], viewport[1], viewport[2], viewport[3], dst.handle(0))) {
+			dst.unbind();
+			return;
+		}
 
 		_shader.begin();
 		_flip.send();
 
-		dst.clear();
 		dst.bind();
 
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, textureID );
@@ -45,7 +108,15 @@ namespace sibr {
 
 	void	CopyRenderer::copyToWindow(uint textureID, Window& dst)
 	{
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		GLint framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		if (framebuffer == 0 && fastCopy(textureID, 0, viewport[0], viewport[1], viewport[2], viewport[3], 0)) {
+			return;
+		}
 
 		_shader.begin();
 
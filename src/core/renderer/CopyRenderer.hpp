@@ -21,6 +21,8 @@
 namespace sibr { 
 
 	/** Copy the content of an input texture to another rendertarget or to the window.
+	With the default shader, same-size color copies without depth output or blending are done with a
+	framebuffer blit or an image copy instead of a screen quad.
 	If you need a basic copy, prefer using blit.
 	\sa sibr::blit
 	\ingroup sibr_renderer
@@ -41,6 +43,9 @@ namespace sibr {
 			const std::string& fragFile = sibr::getShadersDirectory("core") + "/copy.frag"
 		);
 
+		/// Destructor.
+		~CopyRenderer();
+
 		/** Copy input texture to the output texture, copy also the input alpha into depth.
 		\param textureID the texture to copy
 		\param dst the destination
@@ -59,9 +64,23 @@ namespace sibr {
 		bool & flip() { return _flip.get(); }
 
 	private:
-		
+
+		/** Copy a texture without drawing, if the copy is equivalent to the default shader one.
+		\param textureID the texture to copy
+		\param dstFramebuffer the destination framebuffer
+		\param x the destination left
+		\param y the destination bottom
+		\param w the destination width
+		\param h the destination height
+		\param dstTexture the destination texture, for a direct image copy, or 0
+		eturn true if the copy was done
+		*/
+		bool	fastCopy(uint textureID, GLuint dstFramebuffer, int x, int y, int w, int h, GLuint dstTexture);
+
 		GLShader			_shader; ///< Copy shader.
 		GLuniform<bool>		_flip = false; ///< Flip the texture when copying.
+		bool				_defaultShader; ///< Is the default copy shader used.
+		GLuint				_readFramebuffer = 0; ///< Framebuffer wrapping the source texture for blits.
 	};
 
 } /*namespace sibr*/ 
@@ -12,12 +12,21 @@
 
 # include <core/renderer/DepthRenderer.hpp>
 # include "core/graphics/RenderUtility.hpp"
+# include "core/graphics/FrameProfiler.hpp"
+# include "core/graphics/GLState.hpp"
+# include <algorithm>
+# include <cstring>
 
 
 namespace sibr
 {
 
-	DepthRenderer::~DepthRenderer() {};
+	DepthRenderer::~DepthRenderer() {
+		if (_layeredFramebuffer) {
+			GLState::deleteFramebuffers(1, &_layeredFramebuffer);
+			glDeleteTextures(1, &_layeredDepth);
+		}
+	};
 
 	DepthRenderer::DepthRenderer(int w,int h) 
 	{
@@ -32,6 +41,7 @@ namespace sibr
 
 	void DepthRenderer::render( const sibr::InputCamera& cam, const Mesh& mesh, bool backFaceCulling, bool frontFaceCulling)
 	{
+		SIBR_PROFILE_GPU("DepthRenderer");
 
 		//sibr::Vector1f cc(1.0);
 		//_depth_RT->clear(cc);
@@ -44,10 +54,113 @@ namespace sibr
 		_depthShader.begin();
 		_depthShader_MVP.set(cam.viewproj());
 
-		mesh.render(true, backFaceCulling, sibr::Mesh::FillRenderMode, frontFaceCulling);
+		mesh.renderCulled(cam.viewproj(), true, backFaceCulling, sibr::Mesh::FillRenderMode, frontFaceCulling);
 
 		_depthShader.end();
 
 	}
 
+	void DepthRenderer::renderLayers(const std::vector<sibr::InputCamera::Ptr> & cams, const Mesh & mesh, sibr::Texture2DArrayLum32F & dst,
+		uint firstLayer, bool backFaceCulling, bool frontFaceCulling, const MeshLOD * lod, float pixelError)
+	{
+		SIBR_PROFILE_GPU("DepthRenderer layers");
+
+		const uint w = _depth_RT->w();
+		const uint h = _depth_RT->h();
+		if (dst.w() != w || dst.h() != h || dst.depth() < firstLayer + cams.size()) {
+			SIBR_WRG << "[DepthRenderer] The destination array should have the renderer size and a layer per camera." << std::endl;
+			return;
+		}
+
+		// The finest level needed by the cameras of a pass.
+		const auto meshFor = [&](size_t begin, size_t end) -> const Mesh & {
+			if (!lod) {
+				return mesh;
+			}
+			size_t level = lod->levelCount() - 1;
+			for (size_t c = begin; c < end; ++c) {
+				level = std::min(level, lod->select(*cams[c], float(h), pixelError));
+			}
+			return lod->level(level);
+		};
+
+		if (!GLEW_ARB_texture_view) {
+			for (size_t c = 0; c < cams.size(); ++c) {
+				render(*cams[c], meshFor(c, c + 1), backFaceCulling, frontFaceCulling);
+				glCopyImageSubData(_depth_RT->handle(), GL_TEXTURE_2D, 0, 0, 0, 0,
+					dst.handle(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(firstLayer + c), w, h, 1);
+			}
+			CHECK_GL_ERROR;
+			return;
+		}
+
+		if (!_layeredFramebuffer) {
+			_layeredShader.init("DepthLayeredShader",
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("depthRenderer_layered.vp")),
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("depthRenderer_layered.fp")),
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("depthRenderer_layered.gp")));
+			_layeredShader_viewprojs.init(_layeredShader, "viewprojs");
+			_layeredShader_layerCount.init(_layeredShader, "layerCount");
+			_layeredShader_reversedZ.init(_layeredShader, "reversedZ");
+
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &_layeredDepth);
+			glTextureStorage3D(_layeredDepth, 1, GL_DEPTH_COMPONENT32F, w, h, maxLayers);
+			glCreateFramebuffers(1, &_layeredFramebuffer);
+			glNamedFramebufferTexture(_layeredFramebuffer, GL_DEPTH_ATTACHMENT, _layeredDepth, 0);
+			glNamedFramebufferDrawBuffer(_layeredFramebuffer, GL_COLOR_ATTACHMENT0);
+		}
+
+		// Reversed-Z: the clip depth of the camera projections is remapped from [-w,w] to [w,0], and the
+		// window depth kept in [0,1], so that the float precision is spent on the far range.
+		const bool reversedZ = GLEW_ARB_clip_control || GLEW_VERSION_4_5;
+		Matrix4f reverse = Matrix4f::Identity();
+		reverse(2, 2) = -0.5f;
+		reverse(2, 3) = 0.5f;
+		if (reversedZ) {
+			glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+			glClearDepth(0.0);
+		}
+
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, _layeredFramebuffer);
+		glViewport(0, 0, w, h);
+		glClearColor(1.0, 1.0, 1.0, 1.0);
+		std::vector<float> matrices(16 * maxLayers);
+		std::vector<Matrix4f> viewprojs;
+		for (size_t first = 0; first < cams.size(); first += maxLayers) {
+			const size_t count = std::min(size_t(maxLayers), cams.size() - first);
+			// The layers of the pass are attached through a texture view.
+			GLuint layers = 0;
+			glGenTextures(1, &layers);
+			glTextureView(layers, GL_TEXTURE_2D_ARRAY, dst.handle(), GL_R32F, 0, 1, GLuint(firstLayer + first), GLuint(count));
+			glNamedFramebufferTexture(_layeredFramebuffer, GL_COLOR_ATTACHMENT0, layers, 0);
+			glDepthMask(GL_TRUE);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			viewprojs.clear();
+			for (size_t i = 0; i < count; ++i) {
+				const Matrix4f & viewproj = cams[first + i]->viewproj();
+				const Matrix4f layerViewproj = reversedZ ? Matrix4f(reverse * viewproj) : viewproj;
+				std::memcpy(&matrices[16 * i], layerViewproj.data(), 16 * sizeof(float));
+				viewprojs.push_back(viewproj);
+			}
+
+			_layeredShader.begin();
+			_layeredShader_viewprojs.setMatrixArray(matrices.data(), int(count));
+			_layeredShader_layerCount.set(int(count));
+			_layeredShader_reversedZ.set(reversedZ);
+			meshFor(first, first + count).renderCulled(viewprojs, true, backFaceCulling, sibr::Mesh::FillRenderMode, frontFaceCulling, reversedZ);
+			_layeredShader.end();
+
+			glNamedFramebufferTexture(_layeredFramebuffer, GL_COLOR_ATTACHMENT0, 0, 0);
+			glDeleteTextures(1, &layers);
+		}
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		if (reversedZ) {
+			glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+			glClearDepth(1.0);
+		}
+		CHECK_GL_ERROR;
+	}
+
 } // namespace
\ No newline at end of file
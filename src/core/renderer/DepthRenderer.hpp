@@ -20,6 +20,7 @@
 # include "core/assets/Resources.hpp"
 # include "core/graphics/Shader.hpp"
 # include "core/graphics/Mesh.hpp"
+# include "core/graphics/MeshLOD.hpp"
 
 
 namespace sibr
@@ -52,6 +53,25 @@ namespace sibr
 		*/
 		void render( const sibr::InputCamera &cam, const Mesh& mesh, bool backFaceCulling=false, bool frontFaceCulling=false);
 
+		/// Number of cameras rendered in a single pass by renderLayers, MAX_LAYERS in depthRenderer_layered.gp.
+		static const uint maxLayers = 32;
+
+		/** Render a mesh depth for several cameras in the layers of an array texture, maxLayers cameras per pass.
+		Each triangle is sent to the layers of the cameras whose frustum it intersects, and clusters of the mesh
+		outside of all the frustums of a pass are skipped. Depth is tested in a 32F buffer, with reversed-Z when
+		clip control is supported. The stored values are the same normalized device depths as render.
+		\param cams the viewpoints
+		\param mesh the mesh to render
+		\param dst the destination, of the renderer size, with at least firstLayer + cams.size() layers
+		\param firstLayer the layer of the first camera
+		\param backFaceCulling should perform backface culling
+		\param frontFaceCulling flip culling test orientation
+		\param lod optional simplified versions of the mesh, levels are selected for the closest camera of each pass
+		\param pixelError the screen space error allowed when selecting a level, in pixels
+		*/
+		void renderLayers(const std::vector<sibr::InputCamera::Ptr> & cams, const Mesh& mesh, sibr::Texture2DArrayLum32F & dst,
+			uint firstLayer = 0, bool backFaceCulling = false, bool frontFaceCulling = false, const MeshLOD * lod = nullptr, float pixelError = 1.0f);
+
 		std::shared_ptr<sibr::RenderTargetLum32F> _depth_RT; ///< The result depth rendertarget.
 
 	private:
@@ -59,6 +79,13 @@ namespace sibr
 		sibr::GLShader				_depthShader; ///< Depth shader.
 		sibr::GLParameter			_depthShader_MVP; ///< Shader MVP.
 
+		sibr::GLShader				_layeredShader; ///< Layered depth shader.
+		sibr::GLParameter			_layeredShader_viewprojs; ///< Per layer view projections.
+		sibr::GLParameter			_layeredShader_layerCount; ///< Number of layers of the pass.
+		sibr::GLParameter			_layeredShader_reversedZ; ///< Is the window depth reversed.
+		GLuint						_layeredDepth = 0; ///< Layered depth buffer, maxLayers layers.
+		GLuint						_layeredFramebuffer = 0; ///< Framebuffer of the layered passes.
+
 	};
 
 } // namespace
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+# include "GBufferRenderer.hpp"
+
+#include <core/assets/Resources.hpp>
+
+namespace sibr
+{
+	GBufferRenderer::GBufferRenderer(int w, int h)
+	{
+		_shader.init("GBufferRenderer",
+			sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("gbufferRenderer.vert")),
+			sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("gbufferRenderer.frag")));
+
+		_MVP.init(_shader, "MVP");
+		_hasNormals.init(_shader, "hasNormals");
+		_hasColors.init(_shader, "hasColors");
+		_hasTexCoords.init(_shader, "hasTexCoords");
+		setWH(w, h);
+	}
+
+	void GBufferRenderer::setWH(int w, int h)
+	{
+		_RT.reset(new sibr::RenderTargetRGBA32F(w, h, 0, 4));
+	}
+
+	void GBufferRenderer::render(const sibr::Camera& cam, const Mesh& mesh, bool backFaceCulling, bool frontFaceCulling)
+	{
+		glViewport(0, 0, _RT->w(), _RT->h());
+		_RT->bind();
+		// Background: far depth, no normal, black color.
+		const float clearPosition[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const float clearOther[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearBufferfv(GL_COLOR, GLint(Channel::POSITION), clearPosition);
+		glClearBufferfv(GL_COLOR, GLint(Channel::NORMAL), clearOther);
+		glClearBufferfv(GL_COLOR, GLint(Channel::COLOR), clearOther);
+		glClearBufferfv(GL_COLOR, GLint(Channel::UV), clearOther);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		_shader.begin();
+		_MVP.set(cam.viewproj());
+		_hasNormals.set(mesh.hasNormals());
+		_hasColors.set(mesh.hasColors());
+		_hasTexCoords.set(mesh.hasTexCoords());
+
+		mesh.render(true, backFaceCulling, sibr::Mesh::FillRenderMode, frontFaceCulling);
+
+		_shader.end();
+		_RT->unbind();
+	}
+
+	GLuint GBufferRenderer::texture(Channel channel) const
+	{
+		return channel == Channel::DEPTH ? _RT->texture(uint(Channel::POSITION)) : _RT->texture(uint(channel));
+	}
+
+	void GBufferRenderer::readBack(Channel channel, sibr::ImageRGB32F & image) const
+	{
+		const uint target = channel == Channel::DEPTH ? uint(Channel::POSITION) : uint(channel);
+		sibr::ImageRGBA32F buffer;
+		_RT->readBack(buffer, target);
+
+		image = sibr::ImageRGB32F(buffer.w(), buffer.h());
+		for (uint y = 0; y < buffer.h(); ++y) {
+			for (uint x = 0; x < buffer.w(); ++x) {
+				const auto & value = buffer(x, y);
+				image(x, y) = channel == Channel::DEPTH ? sibr::Vector3f(value[3], value[3], value[3]) : sibr::Vector3f(value[0], value[1], value[2]);
+			}
+		}
+	}
+
+} // namespace
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <core/graphics/Shader.hpp>
+# include <core/graphics/Mesh.hpp>
+# include <core/graphics/Texture.hpp>
+# include <core/graphics/Camera.hpp>
+
+# include <core/renderer/Config.hpp>
+
+
+namespace sibr
+{
+	/** Render the depth, world space normals and positions, vertex colors and texture coordinates of a mesh
+	in a single geometry pass, to several color attachments of the same render target.
+	Replaces separate DepthRenderer, NormalRenderer, PositionRenderer and ColoredMeshRenderer passes when
+	several debug channels are needed at once.
+	\ingroup sibr_renderer
+	*/
+	class SIBR_EXP_RENDERER_EXPORT GBufferRenderer
+	{
+		SIBR_CLASS_PTR(GBufferRenderer);
+
+	public:
+
+		/// Channels rendered in the G-buffer.
+		enum class Channel : uint {
+			POSITION = 0, ///< World space position, in xyz.
+			NORMAL = 1, ///< World space normal, in xyz. Face normals are used if the mesh has no normals.
+			COLOR = 2, ///< Vertex color, in rgb. White if the mesh has no colors.
+			UV = 3, ///< Texture coordinates, in xy. Zero if the mesh has no texture coordinates.
+			DEPTH = 4, ///< Normalized device depth, as rendered by DepthRenderer, stored in the w of the position target.
+		};
+
+		/** Constructor with a target size.
+		\param w the target width
+		\param h the target height
+		*/
+		GBufferRenderer(int w, int h);
+
+		/** Render all the channels of the mesh.
+		\param cam the viewpoint to use
+		\param mesh the mesh to render
+		\param backFaceCulling should backface culling be performed
+		\param frontFaceCulling flip the culling test orientation
+		*/
+		void render(const sibr::Camera &cam, const Mesh& mesh, bool backFaceCulling = false, bool frontFaceCulling = false);
+
+		/** Resize the internal rendertarget.
+		\param w the new width
+		\param h the new height
+		*/
+		void setWH(int w, int h);
+
+		/** \return the texture containing a channel, DEPTH is in the w component of the POSITION texture.
+		\param channel the channel
+		*/
+		GLuint texture(Channel channel) const;
+
+		/** Read a channel back from the GPU.
+		\param channel the channel
+		\param image will contain the channel, depth is expanded to the three components
+		*/
+		void readBack(Channel channel, sibr::ImageRGB32F & image) const;
+
+		/** \return the result rendertarget, with one attachment per channel except DEPTH. */
+		const sibr::RenderTargetRGBA32F::Ptr & getRT() const { return _RT; }
+
+	private:
+
+		sibr::GLShader							_shader; ///< The G-buffer shader.
+		sibr::GLuniform<sibr::Matrix4f>			_MVP; ///< MVP uniform.
+		sibr::GLuniform<bool>					_hasNormals; ///< Does the mesh have normals.
+		sibr::GLuniform<bool>					_hasColors; ///< Does the mesh have colors.
+		sibr::GLuniform<bool>					_hasTexCoords; ///< Does the mesh have texture coordinates.
+		sibr::RenderTargetRGBA32F::Ptr			_RT; ///< Destination render target.
+
+	};
+
+} // namespace
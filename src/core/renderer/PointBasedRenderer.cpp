@@ -12,8 +12,115 @@
 
 
 #include <core/renderer/PointBasedRenderer.hpp>
+#include <core/graphics/GLState.hpp>
+#include <core/graphics/RenderUtility.hpp>
+
+#include <algorithm>
 
 namespace sibr { 
+
+	namespace {
+
+		/** Points processed by a compute group. */
+		const uint kBatchSize = 4096;
+		/** Maximum number of groups of a dispatch. */
+		const size_t kMaxGroups = 65535;
+
+		const char * kRasterizeSource = R"(#version 450
+			#extension GL_ARB_gpu_shader_int64 : require
+			#extension GL_NV_shader_atomic_int64 : require
+			#define GROUP_SIZE 256
+			layout(local_size_x = GROUP_SIZE) in;
+
+			layout(std430, binding = 0) readonly buffer Points { uvec4 points[]; };
+			layout(std430, binding = 1) readonly buffer Batches { uvec2 batches[]; };
+			layout(std430, binding = 2) buffer Frame { uint64_t frame[]; };
+			layout(location = 0) uniform mat4 mvp;
+			layout(location = 1) uniform ivec2 size;
+			layout(location = 2) uniform ivec2 footprint;
+			layout(location = 3) uniform uint batchOffset;
+
+			void main(){
+				const uvec2 batch = batches[batchOffset + gl_WorkGroupID.x];
+				for (uint i = gl_LocalInvocationID.x; i < batch.y; i += GROUP_SIZE) {
+					const uvec4 point = points[batch.x + i];
+					const vec4 clip = mvp * vec4(uintBitsToFloat(point.xyz), 1.0);
+					if (clip.w <= 0.0) {
+						continue;
+					}
+					const vec3 ndc = clip.xyz / clip.w;
+					if (any(greaterThan(abs(ndc), vec3(1.0)))) {
+						continue;
+					}
+					// Positive floats are ordered as their bits: the closest point has the smallest key.
+					const uint64_t key = (uint64_t(floatBitsToUint(ndc.z * 0.5 + 0.5)) << 32) | uint64_t(point.w);
+					const ivec2 pixel = ivec2((ndc.xy * 0.5 + 0.5) * vec2(size));
+					for (int y = pixel.y + footprint.x; y <= pixel.y + footprint.y; ++y) {
+						for (int x = pixel.x + footprint.x; x <= pixel.x + footprint.y; ++x) {
+							if (x >= 0 && y >= 0 && x < size.x && y < size.y) {
+								atomicMin(frame[y * size.x + x], key);
+							}
+						}
+					}
+				}
+			}
+		)";
+
+		const char * kResolveVertexSource = R"(#version 450
+			layout(location = 0) in vec3 in_vertex;
+			void main(){
+				gl_Position = vec4(in_vertex, 1.0);
+			}
+		)";
+
+		const char * kResolveFragmentSource = R"(#version 450
+			#extension GL_ARB_gpu_shader_int64 : require
+			layout(std430, binding = 2) readonly buffer Frame { uint64_t frame[]; };
+			uniform int width;
+			layout(location = 0) out vec4 out_color;
+
+			void main(){
+				const ivec2 pixel = ivec2(gl_FragCoord.xy);
+				const uint64_t key = frame[pixel.y * width + pixel.x];
+				if (key == 0xFFFFFFFFFFFFFFFFul) {
+					discard;
+				}
+				out_color = unpackUnorm4x8(uint(key));
+				gl_FragDepth = uintBitsToFloat(uint(key >> 32));
+			}
+		)";
+
+		GLuint compileCompute(const char * source)
+		{
+			GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				SIBR_WRG << "[PointBasedRenderer] Compilation failed: " << log << std::endl;
+				glDeleteShader(shader);
+				return 0;
+			}
+			GLuint program = glCreateProgram();
+			glAttachShader(program, shader);
+			glLinkProgram(program);
+			glDeleteShader(shader);
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				SIBR_WRG << "[PointBasedRenderer] Link failed: " << log << std::endl;
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+
+	}
+
 	PointBasedRenderer::PointBasedRenderer()
 	{	
 		_shader.init("PointBased",
@@ -24,9 +131,38 @@ namespace sibr {
 		_paramRadius.init(_shader,"radius");
 	}
 
+	PointBasedRenderer::~PointBasedRenderer()
+	{
+		if (_computeProgram) {
+			GLState::deleteProgram(_computeProgram);
+		}
+		if (_frameBuffer) {
+			glDeleteBuffers(1, &_frameBuffer);
+		}
+		if (_batchBuffer) {
+			glDeleteBuffers(1, &_batchBuffer);
+		}
+	}
+
+	bool PointBasedRenderer::computeSupported()
+	{
+		if (!_computeProgram && !_computeFailed) {
+			_computeFailed = true;
+			if (GLEW_VERSION_4_5 && GLEW_ARB_gpu_shader_int64 && GLEW_NV_shader_atomic_int64) {
+				_computeProgram = compileCompute(kRasterizeSource);
+			}
+			if (_computeProgram) {
+				_resolveShader.init("PointResolve", kResolveVertexSource, kResolveFragmentSource);
+				_resolveWidth.init(_resolveShader, "width");
+				_computeFailed = false;
+			}
+		}
+		return _computeProgram != 0;
+	}
+
 	void	PointBasedRenderer::process(const Mesh& mesh, const Camera& eye, IRenderTarget& dst, bool backfaceCull)
 	{
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST);
 		glEnable(GL_PROGRAM_POINT_SIZE);
 		dst.bind();
 		_shader.begin();
@@ -39,12 +175,12 @@ namespace sibr {
 		_shader.end();
 		dst.unbind();
 		glDisable(GL_PROGRAM_POINT_SIZE);
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 	}
 
 	void	PointBasedRenderer::process(const Mesh& mesh, const Camera& eye, const sibr::Matrix4f& model, IRenderTarget& dst, bool backfaceCull)
 	{
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST);
 		glEnable(GL_PROGRAM_POINT_SIZE);
 		dst.bind();
 		_shader.begin();
@@ -56,7 +192,102 @@ namespace sibr {
 		_shader.end();
 		dst.unbind();
 		glDisable(GL_PROGRAM_POINT_SIZE);
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
+	}
+
+	void	PointBasedRenderer::process(const PointOctree & cloud, const Camera & eye, IRenderTarget & dst, float pixelSpacing, size_t pointBudget)
+	{
+		_drawnPoints = cloud.select(eye, float(dst.h()), pixelSpacing, pointBudget, _ranges);
+		if (_ranges.empty()) {
+			return;
+		}
+		if (_useCompute && computeSupported()) {
+			rasterize(cloud, eye.viewproj(), dst);
+			return;
+		}
+
+		// Fallback, the selected ranges drawn as GL points.
+		std::vector<GLint> firsts(_ranges.size());
+		std::vector<GLsizei> counts(_ranges.size());
+		for (size_t r = 0; r < _ranges.size(); ++r) {
+			firsts[r] = GLint(_ranges[r].first);
+			counts[r] = GLsizei(_ranges[r].count);
+		}
+		GLState::enable(GL_DEPTH_TEST);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		dst.bind();
+		_shader.begin();
+		_paramMVP.set(eye.viewproj());
+		_paramAlpha.set(float(1.0));
+		_paramRadius.set(_pointSize);
+		glBindVertexArray(cloud.vertexArray());
+		glMultiDrawArrays(GL_POINTS, firsts.data(), counts.data(), GLsizei(_ranges.size()));
+		glBindVertexArray(0);
+		_shader.end();
+		dst.unbind();
+		glDisable(GL_PROGRAM_POINT_SIZE);
+		GLState::disable(GL_DEPTH_TEST);
+	}
+
+	void	PointBasedRenderer::rasterize(const PointOctree & cloud, const Matrix4f & mvp, IRenderTarget & dst)
+	{
+		const int w = int(dst.w());
+		const int h = int(dst.h());
+		const size_t pixels = size_t(w) * size_t(h);
+		if (pixels > _frameBufferSize) {
+			if (_frameBuffer) {
+				glDeleteBuffers(1, &_frameBuffer);
+			}
+			glCreateBuffers(1, &_frameBuffer);
+			glNamedBufferStorage(_frameBuffer, pixels * sizeof(uint64), nullptr, 0);
+			_frameBufferSize = pixels;
+		}
+		// All bits set, farther than any point.
+		const GLuint empty = 0xFFFFFFFFu;
+		glClearNamedBufferSubData(_frameBuffer, GL_R32UI, 0, pixels * sizeof(uint64), GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+
+		// Split the ranges in fixed size batches, one per compute group.
+		_batches.clear();
+		for (const PointOctree::Range & range : _ranges) {
+			for (uint offset = 0; offset < range.count; offset += kBatchSize) {
+				_batches.push_back(range.first + offset);
+				_batches.push_back(std::min(kBatchSize, range.count - offset));
+			}
+		}
+		if (!_batchBuffer) {
+			glCreateBuffers(1, &_batchBuffer);
+		}
+		glNamedBufferData(_batchBuffer, _batches.size() * sizeof(uint), _batches.data(), GL_STREAM_DRAW);
+
+		GLState::useProgram(_computeProgram);
+		glUniformMatrix4fv(0, 1, GL_FALSE, mvp.data());
+		glUniform2i(1, w, h);
+		glUniform2i(2, -(_pointSize - 1) / 2, _pointSize / 2);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloud.buffer());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _batchBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _frameBuffer);
+		const size_t groups = _batches.size() / 2;
+		for (size_t start = 0; start < groups; start += kMaxGroups) {
+			glUniform1ui(3, GLuint(start));
+			glDispatchCompute(GLuint(std::min(kMaxGroups, groups - start)), 1, 1);
+		}
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		GLState::useProgram(0);
+
+		// Write the closest point of each pixel, with its depth.
+		GLState::enable(GL_DEPTH_TEST);
+		dst.bind();
+		glViewport(0, 0, w, h);
+		_resolveShader.begin();
+		_resolveWidth.set(w);
+		RenderUtility::renderScreenQuad();
+		_resolveShader.end();
+		dst.unbind();
+		GLState::disable(GL_DEPTH_TEST);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+		CHECK_GL_ERROR;
 	}
 
 } /*namespace sibr*/
@@ -16,6 +16,7 @@
 # include <core/graphics/Mesh.hpp>
 # include <core/graphics/Texture.hpp>
 # include <core/graphics/Camera.hpp>
+# include <core/graphics/PointOctree.hpp>
 
 # include <core/renderer/Config.hpp>
 
@@ -35,6 +36,9 @@ namespace sibr {
 		*/
 		PointBasedRenderer();
 
+		/// Destructor.
+		~PointBasedRenderer();
+
 		/** Render the textured mesh.
 		\param mesh the mesh to render (should have UV attribute)
 		\param eye the viewpoint to use
@@ -52,13 +56,56 @@ namespace sibr {
 		*/
 		void process(const Mesh & mesh, const Camera & eye, const sibr::Matrix4f & model, IRenderTarget & dst, bool backfaceCull = true);
 
+		/** Render a large point cloud, using its hierarchy for culling and level of detail.
+		 * The points are rasterized by a compute shader keeping the closest one per pixel with 64 bits atomics,
+		 * depth and color packed together (NV_shader_atomic_int64); they are drawn as GL points otherwise.
+		\param cloud the points
+		\param eye the viewpoint to use
+		\param dst destination rendertarget, its depth buffer is tested and written
+		\param pixelSpacing target distance between points on screen, in pixels
+		\param pointBudget maximum number of points drawn, 0 for no limit
+		*/
+		void process(const PointOctree & cloud, const Camera & eye, IRenderTarget & dst, float pixelSpacing = 2.0f, size_t pointBudget = 0);
+
+		/** eturn the number of points drawn by the last octree rendering. */
+		size_t drawnPoints() const { return _drawnPoints; }
+
+		/** eturn size of the points of the octree rendering, in pixels */
+		int & pointSize() { return _pointSize; }
+
+		/** eturn should the compute rasterizer be used when supported */
+		bool & useCompute() { return _useCompute; }
+
+		/** eturn true if the compute rasterizer is available. */
+		bool computeSupported();
+
 	protected:
 
+		/** Rasterize the selected points with the compute shader.
+		\param cloud the points
+		\param mvp the view projection matrix
+		\param dst destination rendertarget
+		*/
+		void rasterize(const PointOctree & cloud, const Matrix4f & mvp, IRenderTarget & dst);
+
 		GLShader			_shader; ///< The point based shader.
 		GLuniform<Matrix4f> 	_paramMVP; ///< MVP uniform.
 		GLuniform<float> 	_paramAlpha; ///< Alpha uniform.
 		GLuniform<int>		_paramRadius; ///< Radius uniform.
 		GLuniform<Vector3f>	_paramUserColor;
+
+		GLuint				_computeProgram = 0; ///< Compute rasterizer, created on first use.
+		bool				_computeFailed = false; ///< The compute rasterizer is not available.
+		bool				_useCompute = true; ///< Use the compute rasterizer when available.
+		GLShader			_resolveShader; ///< Copy of the packed points to the render target.
+		GLuniform<int>		_resolveWidth; ///< Width of the packed frame.
+		GLuint				_frameBuffer = 0; ///< Packed depth and color, one 64 bits value per pixel.
+		size_t				_frameBufferSize = 0; ///< Number of pixels of the packed frame.
+		GLuint				_batchBuffer = 0; ///< Point ranges processed by each compute group.
+		std::vector<PointOctree::Range> _ranges; ///< Points selected for the current frame.
+		std::vector<uint>	_batches; ///< First point and count of each compute group.
+		size_t				_drawnPoints = 0; ///< Points drawn by the last octree rendering.
+		int					_pointSize = 2; ///< Size of the points of the octree rendering, in pixels.
 	};
 
 } /*namespace sibr*/ 
@@ -20,6 +20,8 @@
 
 #include <core/assets/Resources.hpp>
 #include <core/graphics/RenderUtility.hpp>
+#include <core/graphics/RenderTargetPool.hpp>
+#include <core/graphics/FrameProfiler.hpp>
 
 #include <core/renderer/PoissonRenderer.hpp>
 
@@ -34,6 +36,29 @@ using namespace sibr;
 /** Ratio of successive levels of poisson multi-grid */
 #define MULTIGRID_SCALE 2
 
+namespace {
+
+	/** Jacobi relaxation filter kernel taken from Real-Time Gradient-Domain Painting, SIGGRAPH '08
+	* http://graphics.cs.cmu.edu/projects/gradient-paint/
+	* \param k the multigrid level
+	* \param i the iteration at this level
+	* \return the shader weights (center, edge, corner, inverse normalization)
+	*/
+	sibr::Vector4f jacobiWeights(int k, uint i)
+	{
+		double h   =  pow( (float)MULTIGRID_SCALE, k);
+		double hsq =  h*h;
+		double xh0 = -2.1532 + 1.5070/h + 0.5882/hsq;
+		double xh1 =  0.1138 + 0.9529/h + 1.5065/hsq;
+		double xh  =  ((i%2 == 0) ? xh0 : xh1);
+		double m   =  (-8*hsq - 4)/(3.0*hsq);
+		double e   =  (hsq + 2)/(3.0*hsq);
+		double c   =  (hsq - 1)/(3.0*hsq);
+		return sibr::Vector4f((float)xh, (float)e, (float)c, (float)(1.0/(m-xh)));
+	}
+
+}
+
 namespace sibr { 
 	// -----------------------------------------------------------------------
 
@@ -45,30 +70,58 @@ namespace sibr {
 		_restrictShader.init("Restrict",vp, sibr::loadFile(sibr::getShadersDirectory("core") + "/poisson_restrict.frag"));
 		_interpShader  .init("Interp",  vp, sibr::loadFile(sibr::getShadersDirectory("core") + "/poisson_interp.frag"));
 		_divergShader  .init("Diverg",  vp, sibr::loadFile(sibr::getShadersDirectory("core") + "/poisson_diverg.frag"));
+		_residualShader.init("Residual",vp, sibr::loadFile(sibr::getShadersDirectory("core") + "/poisson_residual.frag"));
 
 		// GLParameters
 		_jacobi_weights.init(_jacobiShader,   "weights");
 		_jacobi_scale.init(_jacobiShader, "scale");
 		_restrict_scale.init(_restrictShader, "scale");
 		_interp_scale  .init(_interpShader,   "scale");
+		_residual_threshold.init(_residualShader, "threshold");
 
 		_poisson_div_RT.resize(POISSON_LEVELS);
 		for (uint i=0; i<_poisson_div_RT.size(); i++) {
 			uint ww = std::max(1u, uint(w/pow( (float)MULTIGRID_SCALE, (int)i)));
 			uint hh = std::max(1u, uint(h/pow( (float)MULTIGRID_SCALE, (int)i)));
-			_poisson_div_RT[i].reset(new sibr::RenderTargetRGBA(ww,hh, SIBR_CLAMP_UVS));
+			_poisson_div_RT[i] = RenderTargetPool::global().acquire<unsigned char, 4>(ww, hh, SIBR_CLAMP_UVS);
 		}
-		_poisson_RT.reset(new sibr::RenderTargetRGBA(w,h, SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING));
-		_poisson_tmp_RT.reset(new sibr::RenderTargetRGBA(w,h, SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING));
+		// Recreating the renderer for a new size gives the previous pyramid back to the pool.
+		_poisson_RT = RenderTargetPool::global().acquire<unsigned char, 4>(w, h, SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING);
+		_poisson_tmp_RT = RenderTargetPool::global().acquire<unsigned char, 4>(w, h, SIBR_CLAMP_UVS | SIBR_GPU_LINEAR_SAMPLING);
 		_enableFix = true;
 
 	}
 
+	PoissonRenderer::~PoissonRenderer()
+	{
+		if (!_queries.empty()) {
+			glDeleteQueries(GLsizei(_queries.size()), _queries.data());
+		}
+	}
+
 	// -----------------------------------------------------------------------
 
-	uint PoissonRenderer::render( uint texture )
+	uint PoissonRenderer::render( uint texture, uint initial )
 	{
 		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Poisson filling");
+		if (initial != 0) {
+			// Warm start: the previous solution with the new constraints replaces the multigrid schedule.
+			_interpShader.begin();
+			_poisson_RT->clear();
+			_poisson_RT->bind();
+			glViewport(0, 0, _poisson_RT->w(), _poisson_RT->h());
+			glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, initial);
+			glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, texture);
+			_interp_scale.set(1.0f);
+			RenderUtility::renderScreenQuad();
+			_poisson_RT->unbind();
+			_interpShader.end();
+
+			converge(texture);
+			glPopDebugGroup();
+			return _poisson_RT->texture();
+		}
+
 		// divergence of gradient map and dirichlet constraints
 		_divergShader.begin();
 		_poisson_div_RT[0]->clear();
@@ -96,15 +149,6 @@ namespace sibr {
 		bool isFirst = _enableFix;
 		for (int k=(int)_poisson_div_RT.size()-1; k>=0; k--) {
 			for (uint i=0; i<POISSON_ITERATIONS; i++) {
-				double h   =  pow( (float)MULTIGRID_SCALE, (int)k);            // Jacobi relaxation filter kernel taken from
-				double hsq =  h*h;                               // Real-Time Gradient-Domain Painting, SIGGRAPH '08
-				double xh0 = -2.1532 + 1.5070/h + 0.5882/hsq;    // http://graphics.cs.cmu.edu/projects/gradient-paint/
-				double xh1 =  0.1138 + 0.9529/h + 1.5065/hsq;
-				double xh  =  ((i%2 == 0) ? xh0 : xh1);
-				double m   =  (-8*hsq - 4)/(3.0*hsq);
-				double e   =  (hsq + 2)/(3.0*hsq);
-				double c   =  (hsq - 1)/(3.0*hsq);
-
 				std::swap(_poisson_tmp_RT, _poisson_RT);
 
 				_jacobiShader.begin();
@@ -112,7 +156,7 @@ namespace sibr {
 				_poisson_RT->bind();
 				glViewport(0,0, _poisson_div_RT[k]->w(), _poisson_div_RT[k]->h());
 				glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _poisson_tmp_RT->texture());
-				_jacobi_weights.set((float)xh, (float)e, (float)c, (float)(1.0/(m-xh)));
+				_jacobi_weights.set(jacobiWeights(k, i));
 				_jacobi_scale.set( isFirst ? (float(_poisson_tmp_RT->w()) / _poisson_div_RT[k]->w()) : 1.0f);
 				RenderUtility::renderScreenQuad();
 				_poisson_RT->unbind();
@@ -147,21 +191,90 @@ namespace sibr {
 				_interpShader.end();
 			}
 		}
+		converge(texture);
 		glPopDebugGroup();
 		return _poisson_RT->texture();
 	}
 
-	void	PoissonRenderer::process( const RenderTargetRGBA::Ptr& src, RenderTargetRGBA::Ptr& dst )
+	void PoissonRenderer::residual( uint texture, uint query )
+	{
+		_poisson_tmp_RT->clear();
+		_poisson_tmp_RT->bind();
+		glViewport(0, 0, _poisson_tmp_RT->w(), _poisson_tmp_RT->h());
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		_residualShader.begin();
+		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _poisson_RT->texture());
+		glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, texture);
+		_residual_threshold.set(_tolerance / 255.0f);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+		RenderUtility::renderScreenQuad();
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		_residualShader.end();
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		_poisson_tmp_RT->unbind();
+	}
+
+	void PoissonRenderer::converge( uint texture )
+	{
+		if (_maxIterations == 0) {
+			return;
+		}
+		if (_queries.size() != _maxIterations) {
+			if (!_queries.empty()) {
+				glDeleteQueries(GLsizei(_queries.size()), _queries.data());
+			}
+			_queries.resize(_maxIterations);
+			glGenQueries(GLsizei(_queries.size()), _queries.data());
+		}
+
+		residual(texture, _queries[0]);
+		for (uint i = 0; i < _maxIterations; ++i) {
+			// Everything below is skipped by the GPU once the previous residual pass had no sample left.
+			// Both passes are always run or skipped together, so the solution ends up in _poisson_RT.
+			glBeginConditionalRender(_queries[i], GL_QUERY_WAIT);
+
+			_jacobiShader.begin();
+			_poisson_tmp_RT->clear();
+			_poisson_tmp_RT->bind();
+			glViewport(0, 0, _poisson_tmp_RT->w(), _poisson_tmp_RT->h());
+			glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _poisson_RT->texture());
+			_jacobi_weights.set(jacobiWeights(0, i));
+			_jacobi_scale.set(1.0f);
+			RenderUtility::renderScreenQuad();
+			_poisson_tmp_RT->unbind();
+			_jacobiShader.end();
+
+			// Restore the Dirichlet constraints.
+			_interpShader.begin();
+			_poisson_RT->clear();
+			_poisson_RT->bind();
+			glViewport(0, 0, _poisson_RT->w(), _poisson_RT->h());
+			glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _poisson_tmp_RT->texture());
+			glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, texture);
+			_interp_scale.set(1.0f);
+			RenderUtility::renderScreenQuad();
+			_poisson_RT->unbind();
+			_interpShader.end();
+
+			if (i + 1 < _maxIterations) {
+				residual(texture, _queries[i + 1]);
+			}
+			glEndConditionalRender();
+		}
+	}
+
+	void	PoissonRenderer::process( const RenderTargetRGBA::Ptr& src, RenderTargetRGBA::Ptr& dst, bool warmStart )
 	{
 		SIBR_ASSERT(src != nullptr);
 		/// \todo TODO SR: support IRenderTarget instead of just RGBA
-		render(src->texture());
-		std::swap(dst, _poisson_RT);
+		process(src->texture(), dst, warmStart);
 	}
 
-	void	PoissonRenderer::process( uint texID, RenderTargetRGBA::Ptr& dst )
+	void	PoissonRenderer::process( uint texID, RenderTargetRGBA::Ptr& dst, bool warmStart )
 	{
-		render(texID);
+		SIBR_PROFILE_GPU("PoissonRenderer");
+		const bool canWarmStart = warmStart && dst && int(dst->w()) == _size[0] && int(dst->h()) == _size[1];
+		render(texID, canWarmStart ? dst->texture() : 0);
 		std::swap(dst, _poisson_RT);
 	}
 
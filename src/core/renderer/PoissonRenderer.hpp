@@ -46,21 +46,30 @@ namespace sibr {
 		*/
 		PoissonRenderer ( uint w, uint h );
 
+		/// Destructor.
+		~PoissonRenderer();
+
 		/** Perform poisson filling.
 		\param src source rendertarget, black pixels will be filled
 		\param dst destination rendertarget
+		\param warmStart if true and dst has the renderer size, its content (usually the previous frame result)
+		is used as the initial solution instead of running the full multigrid schedule
 		*/
 		void	process(
 			/*input*/	const RenderTargetRGBA::Ptr& src,
-			/*ouput*/	RenderTargetRGBA::Ptr& dst );
+			/*ouput*/	RenderTargetRGBA::Ptr& dst,
+			/*input*/	bool warmStart = false );
 
 		/** Perform poisson filling.
 		\param texID source texture handle, black pixels will be filled
 		\param dst destination rendertarget
+		\param warmStart if true and dst has the renderer size, its content (usually the previous frame result)
+		is used as the initial solution instead of running the full multigrid schedule
 		*/
 		void	process(
 			/*input*/	uint texID,
-			/*ouput*/	RenderTargetRGBA::Ptr& dst );
+			/*ouput*/	RenderTargetRGBA::Ptr& dst,
+			/*input*/	bool warmStart = false );
 
 		/**
 		* \return the size used for in/out textures (defined in ctor)
@@ -72,13 +81,36 @@ namespace sibr {
 		\return a reference to the bugfix toggle. */
 		bool & enableFix() { return _enableFix; }
 
+		/** Residual below which the solution is considered converged, in 8-bit color units.
+		\return a reference to the tolerance. */
+		float & tolerance() { return _tolerance; }
+
+		/** Maximum number of full resolution iterations run after the multigrid schedule
+		(or the warm start) while the residual is above the tolerance. 0 disables the convergence test.
+		\return a reference to the iterations count. */
+		uint & maxIterations() { return _maxIterations; }
+
 	private:
 		/**
 		* Render the full Poisson synthesis on the holes in texture 'tex'.
 		* \param tex OpenGL texture handle of input texture
+		* \param initial OpenGL texture handle of an initial full resolution solution, or 0 to run the multigrid schedule
 		* \returns OpenGL texture handle of texture containing Poisson synthesis solution
 		*/
-		uint render( uint tex );
+		uint render( uint tex, uint initial );
+
+		/** Run full resolution Jacobi iterations until the residual is below the tolerance.
+		* The test stays on the GPU: each residual pass feeds an occlusion query that
+		* conditionally renders the next iteration, the CPU never waits for a result.
+		* \param tex OpenGL texture handle of input texture, used as Dirichlet constraints
+		*/
+		void converge( uint tex );
+
+		/** Count the unconverged hole pixels of \p _poisson_RT in a query.
+		* \param tex OpenGL texture handle of input texture
+		* \param query the query to fill
+		*/
+		void residual( uint tex, uint query );
 
 		/** Size defined in the ctor */
 		Vector2i		_size;
@@ -97,6 +129,9 @@ namespace sibr {
 		/** Shader to compute divergence (second derivative) field of input texture */
 		sibr::GLShader	_divergShader;
 
+		/** Shader to discard the hole pixels with a residual below the tolerance */
+		sibr::GLShader	_residualShader;
+
 		/** Render target to store Poisson synthesis result */
 		RenderTargetRGBA::Ptr  _poisson_RT;
 
@@ -111,6 +146,16 @@ namespace sibr {
 		sibr::GLParameter _jacobi_weights, _jacobi_scale, _restrict_scale;
 		/** Interpolation scale. */
 		sibr::GLParameter _interp_scale;
+		/** Residual threshold. */
+		sibr::GLParameter _residual_threshold;
+
+		/** Occlusion queries of the convergence iterations, one per iteration. */
+		std::vector<uint> _queries;
+
+		/** Convergence tolerance, in 8-bit units. */
+		float _tolerance = 1.0f;
+		/** Maximum number of convergence iterations. */
+		uint _maxIterations = 8;
 
 		/** Enable the "weird large regions of color" bugfix. */
 		bool _enableFix = true;
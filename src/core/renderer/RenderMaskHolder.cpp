@@ -31,36 +31,55 @@ namespace sibr {
 
 	void 	RenderMaskHolder::uploadMaskGPU(sibr::ImageL8& img, int i, std::vector<RenderTargetLum::Ptr> & masks, bool invert) 
 	{
-		sibr::GLShader textureShader;
-		textureShader.init("Texture",
-			sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("texture.vp")), 
-			invert ? sibr::loadFile(sibr::getShadersDirectory("core") + "/texture-invert.frag") : sibr::loadFile(sibr::getShadersDirectory("core") + "/texture.frag"));
+		// The image rows are flipped by the shader instead of on the CPU.
+		const sibr::Texture2DLum rawInputImage(img);
+		masks.push_back(buildMask(rawInputImage.handle(), img.w(), img.h(), invert, -1.0f, true));
+	}
 
-		std::shared_ptr<sibr::RenderTargetLum> maskRTPtr;
-		maskRTPtr.reset(new sibr::RenderTargetLum(img.w(), img.h()));
+	RenderMaskHolder::MaskPtr	RenderMaskHolder::buildMask(GLuint texture, int w, int h, bool invert, float threshold, bool flip)
+	{
+		// Compiled once for all the masks.
+		if (!_maskShader.isReady()) {
+			_maskShader.init("Mask",
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("texture.vp")),
+				sibr::loadFile(sibr::getShadersDirectory("core") + "/mask.frag"));
+			_maskInvert.init(_maskShader, "invert");
+			_maskFlip.init(_maskShader, "flip");
+			_maskThreshold.init(_maskShader, "threshold");
+		}
 
-		img.flipH();
-		std::shared_ptr<sibr::Texture2DLum> rawInputImage(new sibr::Texture2DLum(img));
-		img.flipH();
+		MaskPtr maskRTPtr(new sibr::RenderTargetLum(w, h));
 
-		glViewport(0,0, img.w(), img.h());
-		maskRTPtr->clear();
+		// The quad covers the whole target, no clear needed.
+		glViewport(0, 0, w, h);
 		maskRTPtr->bind();
 
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, rawInputImage->handle());
+		glBindTexture(GL_TEXTURE_2D, texture);
 
-		glDisable(GL_DEPTH_TEST);            
-		textureShader.begin();
+		GLState::disable(GL_DEPTH_TEST);
+		_maskShader.begin();
+		_maskInvert.set(invert);
+		_maskFlip.set(flip);
+		_maskThreshold.set(threshold);
 		sibr::RenderUtility::renderScreenQuad();
-		textureShader.end();
+		_maskShader.end();
 
 		maskRTPtr->unbind();
-/*
-	maskRTPtr->readBack(img);
-	sibr::show(img);
-*/
-		masks.push_back(maskRTPtr);
+		return maskRTPtr;
+	}
+
+	void	RenderMaskHolder::saveMasks(const std::string& maskDir, const std::string& preFileName, const std::string& postFileName) const
+	{
+		sibr::makeDirectory(maskDir);
+		for (int i = 0; i < int(_masks.size()); ++i) {
+			if (_masks[i] == _emptyMask) {
+				continue;
+			}
+			sibr::ImageL8 mask;
+			_masks[i]->readBack(mask);
+			mask.save(maskDir + "/" + preFileName + sibr::imageIdToString(i) + postFileName, false);
+		}
 	}
 
 
@@ -86,10 +105,12 @@ namespace sibr {
 					if( ibrScene->cameras()->inputCameras()[i]->isActive() ) 
 						SIBR_ERR << "[RenderMaskHolder] couldnt find " << filename << std::endl;
 					else { /// push back empty mask so array is consistent
-						/// \todo TODO GD -- this is wasteful, should fine better way
-						std::shared_ptr<sibr::RenderTargetLum> maskRTPtr;
-						maskRTPtr.reset(new sibr::RenderTargetLum(w, h));
-						_masks.push_back(maskRTPtr);
+						// A single texel mask, shared by all the inactive cameras: sampling it gives the same value anywhere.
+						if (!_emptyMask) {
+							_emptyMask.reset(new sibr::RenderTargetLum(1, 1));
+							_emptyMask->clear();
+						}
+						_masks.push_back(_emptyMask);
 					}
 				}
 		}
@@ -104,6 +125,37 @@ namespace sibr {
 		_masks = masks;
 	}
 
+	void	RenderMaskHolderArray::setMasks(const std::vector<RenderTargetLum::Ptr>& masks)
+	{
+		if (masks.empty()) {
+			_masks.reset();
+			return;
+		}
+		const uint w = masks[0]->w();
+		const uint h = masks[0]->h();
+		_masks = MaskArrayPtr(new MaskArray(w, h, uint(masks.size())));
+
+		// Copied or resized layer by layer on the GPU.
+		GLuint framebuffer = 0;
+		for (uint i = 0; i < uint(masks.size()); ++i) {
+			const RenderTargetLum & mask = *masks[i];
+			if (mask.w() == w && mask.h() == h) {
+				glCopyImageSubData(mask.handle(), GL_TEXTURE_2D, 0, 0, 0, 0, _masks->handle(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(i), w, h, 1);
+				continue;
+			}
+			if (!framebuffer) {
+				glCreateFramebuffers(1, &framebuffer);
+				glNamedFramebufferDrawBuffer(framebuffer, GL_COLOR_ATTACHMENT0);
+			}
+			glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, _masks->handle(), 0, GLint(i));
+			glBlitNamedFramebuffer(mask.fbo(), framebuffer, 0, 0, mask.w(), mask.h(), 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+		if (framebuffer) {
+			GLState::deleteFramebuffers(1, &framebuffer);
+		}
+		CHECK_GL_ERROR;
+	}
+
 	const RenderMaskHolderArray::MaskArrayPtr & RenderMaskHolderArray::getMasks(void) const {
 		return _masks;
 	}
@@ -129,12 +181,11 @@ namespace sibr {
 					SIBR_ERR << "[RenderMaskHolderArray] couldnt find or read " << filename << std::endl;
 				}
 
-				cv::Mat channels[3];
-				cv::split(mask, channels);
+				// Only the first channel is kept.
+				cv::extractChannel(mask, masks[i], 0);
 				if (w > 0 && h > 0) {
-					cv::resize(channels[0], channels[0], cv::Size(w, h));
+					cv::resize(masks[i], masks[i], cv::Size(w, h));
 				}
-				masks[i] = channels[0];
 			}
 
 			_masks = MaskArrayPtr(new MaskArray(masks, SIBR_FLIP_TEXTURE));
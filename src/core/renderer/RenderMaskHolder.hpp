@@ -22,7 +22,8 @@
 namespace sibr { 
 
 	/** Store a set of masks associated to a set of images (dataset input images for instance), on the GPU.
-	This version uses a list of R8 rendertargets.
+	This version uses a list of R8 rendertargets. Masks are built, inverted and thresholded on the GPU,
+	and only read back when saved.
 	\note Might want to use textures instead of RTs here.
 	\ingroup sibr_renderer
 	*/
@@ -63,9 +64,32 @@ namespace sibr {
 		**/
 	    void 							uploadMaskGPU(sibr::ImageL8& img, int i, std::vector<RenderTargetLum::Ptr> & masks, bool invert) ;
 
+		/** Build a mask from a texture already on the GPU, for instance a segmentation rendering.
+		\param texture the source texture, its first channel is used
+		\param w the mask width
+		\param h the mask height
+		\param invert should the mask be inverted
+		\param threshold binarize the mask, values above it become 1, and the others 0; negative to keep the values
+		\param flip flip the source vertically, for textures uploaded from images
+		\return the new mask
+		*/
+		MaskPtr							buildMask(GLuint texture, int w, int h, bool invert = false, float threshold = -1.0f, bool flip = false);
+
+		/** Save the masks to images on disk, the only place where masks are read back from the GPU.
+		\param maskDir the masks directory
+		\param preFileName mask filename prefix
+		\param postFileName mask filename suffix and extension
+		*/
+		void							saveMasks(const std::string& maskDir, const std::string& preFileName, const std::string& postFileName) const;
+
 	private:
 
 		std::vector<MaskPtr>	_masks; ///< List of masks on the GPU.
+		MaskPtr					_emptyMask; ///< Mask shared by the inactive cameras without mask file.
+		GLShader				_maskShader; ///< Mask building shader.
+		GLuniform<bool>			_maskInvert = false; ///< Invert uniform.
+		GLuniform<bool>			_maskFlip = false; ///< Flip uniform.
+		GLuniform<float>		_maskThreshold = -1.0f; ///< Threshold uniform.
 
 	};
 
@@ -85,6 +109,11 @@ namespace sibr {
 		*/
 		void							setMasks(const MaskArrayPtr& masks);
 
+		/** Update the masks from rendertargets, copied on the GPU.
+		\param masks the masks, resized to the first one if they differ
+		*/
+		void							setMasks(const std::vector<RenderTargetLum::Ptr>& masks);
+
 		/** \return the masks texture array. */
 		const MaskArrayPtr &				getMasks(void) const;
 
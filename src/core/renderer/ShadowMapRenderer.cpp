@@ -12,6 +12,10 @@
 
 # include "ShadowMapRenderer.hpp"
 # include "core/graphics/RenderUtility.hpp"
+# include <algorithm>
+# include <cmath>
+# include <cstring>
+# include <limits>
 
 float SUN_APP_DIAM = 0.5358f;
 
@@ -34,7 +38,13 @@ namespace sibr
 		_bias_control.init(_shadowMapShader, "biasControl");
 		_sun_app_radius.init(_shadowMapShader, "sun_app_radius");
 
-		sibr::Vector3f toLight = -depthMapCam.dir();
+		setLight(depthMapCam);
+	}
+
+	void ShadowMapRenderer::setLight(const sibr::InputCamera& depthMapCam)
+	{
+		_lightCam = depthMapCam;
+		const sibr::Vector3f toLight = -depthMapCam.dir();
 		_shadowMapShader.begin();
 		_depthMap_MVP.set(depthMapCam.viewproj());
 		_depthMap_MVPinv.set(depthMapCam.invViewproj());
@@ -42,6 +52,145 @@ namespace sibr
 		_lightDir.set(toLight);
 		_sun_app_radius.set(SUN_APP_DIAM/2.0f);
 		_shadowMapShader.end();
+
+		if (_cascadeCount > 0) {
+			_cascadedShader.begin();
+			_cascaded_lightDir.set(toLight);
+			_cascadedShader.end();
+		}
+		invalidate();
+	}
+
+	void ShadowMapRenderer::cascades(uint count, uint resolution, float maxDistance)
+	{
+		count = std::min(count, maxCascades);
+		_cascadeDistance = maxDistance;
+		invalidate();
+		if (count == 0) {
+			_cascadeCount = 0;
+			_cascadeMaps.reset();
+			_cascadeRenderer.reset();
+			return;
+		}
+
+		if (count != _cascadeCount) {
+			_cascadedShader.terminate();
+			_cascadedShader.init("ShadowMapCascadedShader",
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("shadowMapRenderer.vp")),
+				sibr::loadFile(sibr::Resources::Instance()->getResourceFilePathName("shadowMapRenderer.fp"), { GLShader::Define("CASCADES", count) }));
+			_cascaded_MVP.init(_cascadedShader, "MVP");
+			_cascaded_lightDir.init(_cascadedShader, "lightDir");
+			_cascaded_bias.init(_cascadedShader, "biasControl");
+			_cascaded_sunRadius.init(_cascadedShader, "sun_app_radius");
+			_cascaded_cameraPos.init(_cascadedShader, "cameraPos");
+			_cascaded_cameraDir.init(_cascadedShader, "cameraDir");
+			_cascaded_depthMapMVP.init(_cascadedShader, "cascadeMVP");
+			_cascaded_depthMapMVPinv.init(_cascadedShader, "cascadeMVPinv");
+			_cascaded_depthMapRadius.init(_cascadedShader, "cascadeRadius");
+			_cascaded_far.init(_cascadedShader, "cascadeFar");
+
+			_cascadedShader.begin();
+			_cascaded_lightDir.set(sibr::Vector3f(-_lightCam.dir()));
+			_cascaded_sunRadius.set(SUN_APP_DIAM / 2.0f);
+			_cascadedShader.end();
+		}
+		if (!_cascadeMaps || _cascadeMaps->w() != resolution || _cascadeMaps->depth() != count) {
+			_cascadeRenderer.reset(new sibr::DepthRenderer(int(resolution), int(resolution)));
+			_cascadeMaps.reset(new sibr::Texture2DArrayLum32F(resolution, resolution, count));
+		}
+		_cascadeCount = count;
+	}
+
+	void ShadowMapRenderer::renderCascades(const sibr::InputCamera& cam, const Mesh& mesh)
+	{
+		const uint resolution = _cascadeMaps->w();
+		const float zNear = cam.znear();
+		const float zFar = _cascadeDistance > 0.0f ? std::min(_cascadeDistance, cam.zfar()) : cam.zfar();
+		const sibr::Vector3f lightDir = _lightCam.dir().normalized();
+		const sibr::Vector3f lightUp = _lightCam.up().normalized();
+		const sibr::Vector3f lightRight = _lightCam.right().normalized();
+
+		// Extent of the shadow casters along the light direction, all of them should be in the light frustums.
+		const Eigen::AlignedBox3f box = mesh.getBoundingBox();
+		float boxNear = std::numeric_limits<float>::max();
+		float boxFar = -std::numeric_limits<float>::max();
+		for (int corner = 0; corner < 8; ++corner) {
+			const float d = box.corner(Eigen::AlignedBox3f::CornerType(corner)).dot(lightDir);
+			boxNear = std::min(boxNear, d);
+			boxFar = std::max(boxFar, d);
+		}
+		const float margin = 0.01f * (boxFar - boxNear) + 1e-4f;
+
+		// Half extents of the camera frustum at unit distance.
+		const float tanTop = cam.ortho() ? 0.0f : std::tan(0.5f * cam.fovy());
+		const float tanRight = tanTop * cam.aspect();
+		const float orthoTop = cam.ortho() ? cam.orthoTop() : 0.0f;
+		const float orthoRight = cam.ortho() ? cam.orthoRight() : 0.0f;
+
+		std::vector<sibr::InputCamera::Ptr> cascadeCams;
+		std::vector<float> matrices(16 * _cascadeCount);
+		std::vector<float> invMatrices(16 * _cascadeCount);
+		std::vector<float> radii(_cascadeCount);
+		std::vector<float> fars(_cascadeCount);
+		float sliceNear = zNear;
+		for (uint c = 0; c < _cascadeCount; ++c) {
+			// Practical split scheme: blend of the logarithmic and uniform splits.
+			const float t = float(c + 1) / float(_cascadeCount);
+			const float lambda = 0.75f;
+			const float sliceFar = lambda * zNear * std::pow(zFar / zNear, t) + (1.0f - lambda) * (zNear + (zFar - zNear) * t);
+
+			// Bounding sphere of the slice: its radius does not depend on the camera orientation,
+			// which keeps the depth map texel size constant when the camera rotates.
+			std::vector<sibr::Vector3f> corners;
+			for (const float d : { sliceNear, sliceFar }) {
+				const float halfW = orthoRight + d * tanRight;
+				const float halfH = orthoTop + d * tanTop;
+				for (const float sx : { -1.0f, 1.0f }) {
+					for (const float sy : { -1.0f, 1.0f }) {
+						corners.push_back(cam.position() + d * cam.dir() + sx * halfW * cam.right() + sy * halfH * cam.up());
+					}
+				}
+			}
+			sibr::Vector3f center(0.0f, 0.0f, 0.0f);
+			for (const sibr::Vector3f & corner : corners) {
+				center += corner;
+			}
+			center /= float(corners.size());
+			float radius = 0.0f;
+			for (const sibr::Vector3f & corner : corners) {
+				radius = std::max(radius, (corner - center).norm());
+			}
+
+			// Snap the center to the depth map texels, so that shadow edges do not shimmer when the camera moves.
+			const float texel = 2.0f * radius / float(resolution);
+			const float x = std::floor(center.dot(lightRight) / texel) * texel;
+			const float y = std::floor(center.dot(lightUp) / texel) * texel;
+			const sibr::Vector3f eye = x * lightRight + y * lightUp + (boxNear - margin) * lightDir;
+
+			sibr::Camera lightCam;
+			lightCam.setLookAt(eye, eye + lightDir, lightUp);
+			lightCam.znear(0.0f);
+			lightCam.zfar(boxFar - boxNear + 2.0f * margin);
+			lightCam.setOrthoCam(radius, radius);
+			cascadeCams.emplace_back(new sibr::InputCamera(lightCam, int(resolution), int(resolution)));
+
+			std::memcpy(&matrices[16 * c], cascadeCams.back()->viewproj().data(), 16 * sizeof(float));
+			std::memcpy(&invMatrices[16 * c], cascadeCams.back()->invViewproj().data(), 16 * sizeof(float));
+			radii[c] = radius;
+			fars[c] = sliceFar;
+			sliceNear = sliceFar;
+		}
+
+		_cascadeRenderer->renderLayers(cascadeCams, mesh, *_cascadeMaps);
+
+		_cascadedShader.begin();
+		_cascaded_depthMapMVP.setMatrixArray(matrices.data(), int(_cascadeCount));
+		_cascaded_depthMapMVPinv.setMatrixArray(invMatrices.data(), int(_cascadeCount));
+		_cascaded_depthMapRadius.setArray(radii.data(), int(_cascadeCount));
+		_cascaded_far.setArray(fars.data(), int(_cascadeCount));
+		_cascaded_cameraPos.set(cam.position());
+		_cascaded_cameraDir.set(cam.dir());
+		_cascadedShader.end();
 	}
 
 	void ShadowMapRenderer::render(int w, int h, const sibr::InputCamera& cam, const Mesh& mesh, float bias ) 
@@ -50,24 +199,54 @@ namespace sibr
 		//sibr::Vector1f cc(1.0);
 		//_depth_RT->clear(cc);
 
-		_shadowMap_RT.reset(new sibr::RenderTargetLum(w, h));
-		
+		// Nothing changed since the last call, the shadows are still valid.
+		const uint64 revision = mesh.revision();
+		_updated = !(_cacheValid && _shadowMap_RT && int(_shadowMap_RT->w()) == w && int(_shadowMap_RT->h()) == h
+			&& &mesh == _cachedMesh && revision == _cachedRevision && bias == _cachedBias && cam.viewproj() == _cachedViewproj);
+		if (!_updated) {
+			return;
+		}
+
+		if (!_shadowMap_RT || int(_shadowMap_RT->w()) != w || int(_shadowMap_RT->h()) != h) {
+			_shadowMap_RT.reset(new sibr::RenderTargetLum(w, h));
+		}
+		// The cascades depend on the viewpoint, they are rendered before binding the result.
+		if (_cascadeCount > 0) {
+			renderCascades(cam, mesh);
+		}
+
 		glViewport(0, 0, _shadowMap_RT->w(), _shadowMap_RT->h());
 		_shadowMap_RT->bind();
 		glClearColor(1.0, 1.0, 1.0, 1.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		_shadowMapShader.begin();
-		_shadowMapShader_MVP.set(cam.viewproj());
-		_bias_control.set(bias);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, _depthMap_RT->texture());
-
-		mesh.render(true, false, sibr::Mesh::FillRenderMode);
-
-		_shadowMapShader.end();
-
+		if (_cascadeCount > 0) {
+			_cascadedShader.begin();
+			_cascaded_MVP.set(cam.viewproj());
+			_cascaded_bias.set(bias);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, _cascadeMaps->handle());
+			mesh.render(true, false, sibr::Mesh::FillRenderMode);
+			_cascadedShader.end();
+		}
+		else {
+			_shadowMapShader.begin();
+			_shadowMapShader_MVP.set(cam.viewproj());
+			_bias_control.set(bias);
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, _depthMap_RT->texture());
+
+			mesh.render(true, false, sibr::Mesh::FillRenderMode);
+
+			_shadowMapShader.end();
+		}
+
+		_cacheValid = true;
+		_cachedMesh = &mesh;
+		_cachedRevision = revision;
+		_cachedBias = bias;
+		_cachedViewproj = cam.viewproj();
 	}
 
 } // namespace
\ No newline at end of file
@@ -21,12 +21,17 @@
 # include "core/assets/Resources.hpp"
 # include "core/graphics/Shader.hpp"
 # include "core/graphics/Mesh.hpp"
+# include "core/renderer/DepthRenderer.hpp"
 
 
 namespace sibr
 {
 
 	/** Render high quality soft shadows, designed to mimick the sun shadowing.
+	The result is cached: render does nothing while the light, the camera, the target size, the bias and
+	the mesh revision are the same as in the previous call.
+	In cascaded mode, the light depth is rendered by the renderer itself, in a few maps each covering a slice
+	of the camera frustum, instead of the single depth map given at construction.
 	\note Soft shadowing require a lot of texture fetches that can impact performances.
 	\ingroup sibr_renderer
 	*/
@@ -54,6 +59,35 @@ namespace sibr
 		*/
 		void render(int w, int h,const sibr::InputCamera &cam, const Mesh& mesh, float bias= 0.0005f);
 
+		/** Change the light viewpoint. In single map mode, the depth map has to be updated by the caller too.
+		\param depthMapCam the light viewpoint, its direction and its orthographic extent are used
+		*/
+		void setLight(const sibr::InputCamera& depthMapCam);
+
+		/** Force the next render call to update the shadows, after the depth map content changed. */
+		void invalidate(void) { _cacheValid = false; }
+
+		/** \return true if the last render call updated the shadows, false if the cached result was kept. */
+		bool updated(void) const { return _updated; }
+
+		/// Maximum number of cascades, see cascades().
+		static const uint maxCascades = 4;
+
+		/** Enable the cascaded mode, for large scenes. The camera frustum, up to maxDistance, is split in slices
+		of increasing length, each one shadowed by a light depth map fitted to it and rendered with the triangles
+		intersecting its volume only.
+		\param count the number of cascades, up to maxCascades, 0 to use the depth map given at construction
+		\param resolution the size of each cascade depth map
+		\param maxDistance the distance covered from the camera, 0 to use the camera far plane
+		*/
+		void cascades(uint count, uint resolution = 2048, float maxDistance = 0.0f);
+
+		/** \return the number of cascades, 0 in single map mode. */
+		uint cascadeCount(void) const { return _cascadeCount; }
+
+		/** \return the cascade depth maps, one layer per cascade, null in single map mode. */
+		const sibr::Texture2DArrayLum32F::Ptr & cascadeMaps(void) const { return _cascadeMaps; }
+
 		std::shared_ptr<sibr::RenderTargetLum> _shadowMap_RT; ///< Result containing the soft shadows.
 
 		std::shared_ptr<sibr::RenderTargetLum32F> _depthMap_RT; ///< Depth map rendered from the light viewpoint.
@@ -71,6 +105,39 @@ namespace sibr
 		sibr::GLParameter			_sun_app_radius; ///< Sun radius (for soft shadows).
 		std::shared_ptr<sibr::Texture2DLum32F> _textureDepthMap; ///< Shadow map target (unused).
 
+		/** Fit the cascade light cameras to the slices of a camera frustum and render their depth maps.
+		\param cam the viewpoint
+		\param mesh the shadow casters
+		*/
+		void renderCascades(const sibr::InputCamera& cam, const Mesh& mesh);
+
+		sibr::InputCamera			_lightCam; ///< Light viewpoint.
+
+		// Cache of the last result.
+		bool						_cacheValid = false; ///< Is the cached result valid.
+		bool						_updated = false; ///< Did the last call update the result.
+		sibr::Matrix4f				_cachedViewproj; ///< Camera of the cached result.
+		const Mesh *				_cachedMesh = nullptr; ///< Mesh of the cached result.
+		uint64						_cachedRevision = 0; ///< Mesh revision of the cached result.
+		float						_cachedBias = 0.0f; ///< Bias of the cached result.
+
+		// Cascaded mode.
+		uint						_cascadeCount = 0; ///< Number of cascades, 0 in single map mode.
+		float						_cascadeDistance = 0.0f; ///< Distance covered by the cascades, 0 for the camera far plane.
+		sibr::DepthRenderer::Ptr	_cascadeRenderer; ///< Renders the cascade depth maps.
+		sibr::Texture2DArrayLum32F::Ptr _cascadeMaps; ///< Cascade depth maps.
+		sibr::GLShader				_cascadedShader; ///< Shadow rendering with cascades.
+		sibr::GLParameter			_cascaded_MVP; ///< Final MVP uniform.
+		sibr::GLParameter			_cascaded_lightDir; ///< Light direction uniform.
+		sibr::GLParameter			_cascaded_bias; ///< Bias uniform.
+		sibr::GLParameter			_cascaded_sunRadius; ///< Sun radius uniform.
+		sibr::GLParameter			_cascaded_cameraPos; ///< Camera position uniform.
+		sibr::GLParameter			_cascaded_cameraDir; ///< Camera direction uniform.
+		sibr::GLParameter			_cascaded_depthMapMVP; ///< Per cascade light MVP uniform array.
+		sibr::GLParameter			_cascaded_depthMapMVPinv; ///< Per cascade light inverse MVP uniform array.
+		sibr::GLParameter			_cascaded_depthMapRadius; ///< Per cascade depth map radius uniform array.
+		sibr::GLParameter			_cascaded_far; ///< Per cascade far distance uniform array.
+
 	};
 
 } // namespace
@@ -33,7 +33,7 @@ namespace sibr {
 		_shader.begin();
 		_paramMVP.set(eye.viewproj());
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, textureID);
-		mesh.render(true, backfaceCull);
+		mesh.renderCulled(eye.viewproj(), true, backfaceCull);
 		_shader.end();
 		dst.unbind();
 
@@ -43,9 +43,10 @@ namespace sibr {
 	{
 		dst.bind();
 		_shader.begin();
-		_paramMVP.set(sibr::Matrix4f(eye.viewproj() * model));
+		const sibr::Matrix4f mvp = eye.viewproj() * model;
+		_paramMVP.set(mvp);
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, textureID);
-		mesh.render(true, backfaceCull);
+		mesh.renderCulled(mvp, true, backfaceCull);
 		_shader.end();
 		dst.unbind();
 
@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+// Window depth is reversed (1 at the near plane) and in [0,1] when reversedZ is set.
+uniform bool reversedZ;
+
+out float out_depth;
+
+void main(void) {
+	// Same output as depthRenderer.fp: the depth in normalized device coordinates of the camera projection.
+	out_depth = reversedZ ? 1.0 - 2.0*gl_FragCoord.z : 2.0*gl_FragCoord.z-1.0;
+}
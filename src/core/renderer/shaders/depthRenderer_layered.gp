@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+// Must match DepthRenderer::maxLayers.
+#define MAX_LAYERS 32
+
+layout(triangles, invocations = MAX_LAYERS) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform mat4 viewprojs[MAX_LAYERS];
+uniform int layerCount;
+
+void main(void) {
+	if (gl_InvocationID >= layerCount) {
+		return;
+	}
+	vec4 p[3];
+	for (int i = 0; i < 3; ++i) {
+		p[i] = viewprojs[gl_InvocationID] * gl_in[i].gl_Position;
+	}
+	// Skip the triangle for this camera if it is entirely outside one of the side planes, or past one end of the depth range.
+	for (int c = 0; c < 2; ++c) {
+		if ((p[0][c] > p[0].w && p[1][c] > p[1].w && p[2][c] > p[2].w)
+			|| (p[0][c] < -p[0].w && p[1][c] < -p[1].w && p[2][c] < -p[2].w)) {
+			return;
+		}
+	}
+	if (p[0].z > p[0].w && p[1].z > p[1].w && p[2].z > p[2].w) {
+		return;
+	}
+	for (int i = 0; i < 3; ++i) {
+		gl_Position = p[i];
+		gl_Layer = gl_InvocationID;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 420
+
+#define MAX_TAPS 17
+
+layout(location = 0) out vec4 out_color;
+
+layout(binding = 0) uniform sampler2D image;
+uniform vec2  direction;
+uniform int   count;
+uniform float weights[MAX_TAPS];
+uniform float offsets[MAX_TAPS];
+
+in vec2 tex_coord;
+
+void main(void) {
+	// One side of the kernel, each tap falls between two texels and
+	// the bilinear filtering sums both of them with the right weights.
+	vec4 color = texture(image, tex_coord) * weights[0];
+	for (int i = 1; i < count; ++i) {
+		vec2 offset = offsets[i] * direction;
+		color += (texture(image, tex_coord + offset) + texture(image, tex_coord - offset)) * weights[i];
+	}
+	out_color = color;
+}
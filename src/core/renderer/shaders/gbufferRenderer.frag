@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 420
+
+uniform bool hasNormals;
+uniform bool hasColors;
+uniform bool hasTexCoords;
+
+in vec3 position;
+in vec3 normal;
+in vec3 color;
+in vec2 uv;
+
+layout(location = 0) out vec4 out_position;
+layout(location = 1) out vec4 out_normal;
+layout(location = 2) out vec4 out_color;
+layout(location = 3) out vec4 out_uv;
+
+void main(void) {
+	// Same depth convention as DepthRenderer.
+	out_position = vec4(position, 2.0*gl_FragCoord.z-1.0);
+	// Without vertex normals, use the face normal from the position derivatives.
+	vec3 n = hasNormals ? normal : cross(dFdx(position), dFdy(position));
+	out_normal = vec4(normalize(n), 1.0);
+	out_color = vec4(hasColors ? color : vec3(1.0), 1.0);
+	out_uv = vec4(hasTexCoords ? uv : vec2(0.0), 0.0, 1.0);
+}
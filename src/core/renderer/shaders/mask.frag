@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 420
+
+layout(binding = 0) uniform sampler2D tex;
+layout(location= 0) out vec4 out_color;
+
+uniform bool invert = false;
+uniform bool flip = false;
+uniform float threshold = -1.0; // Negative to keep the source values.
+
+in vec2 tex_coord;
+
+void main(void) {
+    float value = texture(tex, flip ? vec2(tex_coord.x, 1.0 - tex_coord.y) : tex_coord).r;
+    if (threshold >= 0.0) {
+        value = value > threshold ? 1.0 : 0.0;
+    }
+    value = invert ? 1.0 - value : value;
+    out_color = vec4(value, value, value, 1.0);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 420
+
+uniform float threshold;
+
+layout(binding = 0) uniform sampler2D curr_tex;
+layout(binding = 1) uniform sampler2D constraint;
+layout(location= 0) out vec4 out_color;
+
+void main(void) {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+
+    //  Dirichlet pixels are fixed, only holes contribute to the residual
+    vec4 cons = texelFetch(constraint, coord, 0);
+    if (any(greaterThan(cons.rgb, vec3(0.01))))
+        discard;
+
+    //  residual of the Laplace equation, using the 5-point stencil
+    vec3 lapl = 4.0 * texelFetch(curr_tex, coord, 0).rgb -
+                (texelFetch(curr_tex, coord+ivec2( 0, 1), 0).rgb +
+                 texelFetch(curr_tex, coord+ivec2( 0,-1), 0).rgb +
+                 texelFetch(curr_tex, coord+ivec2( 1, 0), 0).rgb +
+                 texelFetch(curr_tex, coord+ivec2(-1, 0), 0).rgb);
+    vec3 res = abs(lapl);
+
+    //  only unconverged pixels reach the occlusion query
+    if (max(res.r, max(res.g, res.b)) <= threshold)
+        discard;
+    out_color = vec4(res, 1.0);
+}
@@ -80,21 +80,58 @@ vec2(-0.545396, 0.538133),
 vec2(-0.178564, -0.596057)
 );
 
+// Number of cascaded light depth maps, 0 for a single depth map. Set by ShadowMapRenderer.
+#define CASCADES 0
+
 uniform vec3 lightDir;
 uniform float sun_app_radius;
+uniform float biasControl;
+
+#if CASCADES > 0
+uniform mat4 cascadeMVP[CASCADES];
+uniform mat4 cascadeMVPinv[CASCADES];
+uniform float cascadeRadius[CASCADES];
+uniform float cascadeFar[CASCADES];
+uniform vec3 cameraPos;
+uniform vec3 cameraDir;
+
+layout(binding=0) uniform sampler2DArray depthMaps;
+
+int cascade = 0;
+#define DEPTH_MAP(uv) texture(depthMaps, vec3(uv, cascade)).x
+#else
 uniform mat4 depthMapMVPinv;
 uniform float depthMapRadius;
-uniform float biasControl;
 
 layout(binding=0) uniform sampler2D depthMap;
 
 in vec4 depthMapProj;
+#define DEPTH_MAP(uv) texture(depthMap, uv).x
+#endif
+
 in vec3 VtoF_normal;
 in vec3 VtoF_pos;
 
 out float out_val;
 
 void main(void) {
+
+#if CASCADES > 0
+	// The first cascade containing the fragment, along the view direction.
+	float viewDepth = dot(VtoF_pos - cameraPos, cameraDir);
+	cascade = CASCADES - 1;
+	for (int c = CASCADES - 1; c >= 0; --c) {
+		if (viewDepth <= cascadeFar[c]) {
+			cascade = c;
+		}
+	}
+	vec4 depthMapProj = cascadeMVP[cascade] * vec4(VtoF_pos, 1.0);
+	mat4 depthMapMVPinv = cascadeMVPinv[cascade];
+	float depthMapRadius = cascadeRadius[cascade];
+	int textureWidth = textureSize(depthMaps, 0).x;
+#else
+	int textureWidth = textureSize(depthMap,0).x;
+#endif
 	
 	vec2 texc = (depthMapProj.xy + 1.0) / 2.0;
 
@@ -104,8 +141,6 @@ void main(void) {
 	float bias = biasControl*tan(acos(cosTheta));
 	bias = clamp(bias, 0.0, 5*biasControl);
 
-	int textureWidth = textureSize(depthMap,0).x;
-
 	// Compute the size of the shadow transition
 
 	// The 2 account for the fact that we are treating the radius.
@@ -124,7 +159,7 @@ void main(void) {
 
 			float pixDist = length(r_blocker*poissonDisk[k]/textureWidth);
 			if(pixDist<=r_blocker){
-				float depthMapVal = texture(depthMap, texc + r_blocker*rotation_poisson*poissonDisk[k]/textureWidth).x;
+				float depthMapVal = DEPTH_MAP(texc + r_blocker*rotation_poisson*poissonDisk[k]/textureWidth);
 
 				float bias_with_dist = bias*(pixDist+1.0);
 
@@ -169,7 +204,7 @@ void main(void) {
 
 			for(int k = 0; k <64 ; k++){
 
-				float depthMapVal = texture(depthMap, texc + r*rotation_poisson*poissonDisk[k]/textureWidth).x;
+				float depthMapVal = DEPTH_MAP(texc + r*rotation_poisson*poissonDisk[k]/textureWidth);
 				float pixDist = length(r*poissonDisk[k]/textureWidth);
 				float bias_with_dist = bias*(pixDist+1.0);
 
@@ -18,6 +18,11 @@
 #include "core/scene/ParseData.hpp"
 #include "core/scene/ProxyMesh.hpp"
 #include "core/scene/InputImages.hpp"
+#include "core/scene/SceneBundle.hpp"
+#include "core/graphics/MemoryTracker.hpp"
+#include "core/system/MainThreadQueue.hpp"
+#include "core/system/FileWatcher.hpp"
+#include <thread>
 
 namespace sibr
 {
@@ -30,6 +35,34 @@ namespace sibr
 		_renderTargets.reset(new RenderTargetTextures());
 	}
 
+	BasicIBRScene::~BasicIBRScene()
+	{
+		// The background tasks and the watches reference the scene.
+		watchAssets(false);
+		_cancelled = true;
+		waitUntilReady();
+	}
+
+	bool BasicIBRScene::isReady(void) const
+	{
+		for (const std::shared_future<void> * task : { &_imagesReady, &_meshReady, &_renderTargetsReady }) {
+			if (task->valid() && task->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void BasicIBRScene::waitUntilReady(void)
+	{
+		// The background tasks wait for their GL work, posted to the main thread.
+		while (!isReady()) {
+			if (MainThreadQueue::shared().run() == 0) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
 	BasicIBRScene::BasicIBRScene(const BasicIBRAppArgs & myArgs, bool noRTs, bool noMesh)
 	{
 
@@ -38,6 +71,9 @@ namespace sibr
 		_data.reset(new ParseData());
 		_currentOpts.renderTargets = !noRTs;
 		_currentOpts.mesh = !noMesh;
+		_currentOpts.sharedCache = myArgs.shared_cache;
+		_currentOpts.watch = myArgs.watch;
+		_currentOpts.textureMemoryFraction = myArgs.texture_budget;
 
 		_data->getParsedData(myArgs);
 		std::cout << "Number of input Images to read: " << _data->imgInfos().size() << std::endl;
@@ -54,6 +90,11 @@ namespace sibr
 	{
 		BasicIBRScene();
 		_currentOpts = myOpts;
+		_currentOpts.sharedCache = _currentOpts.sharedCache || myArgs.shared_cache;
+		_currentOpts.watch = _currentOpts.watch || myArgs.watch;
+		if (_currentOpts.textureMemoryFraction <= 0.0f) {
+			_currentOpts.textureMemoryFraction = myArgs.texture_budget;
+		}
 
 		// parse metadata file
 		_data.reset(new ParseData());
@@ -78,8 +119,57 @@ namespace sibr
 	}
 
 
+	bool BasicIBRScene::createFromBundle(const std::string & path, uint textureFlags)
+	{
+		SceneBundle bundle;
+		if (!bundle.open(path)) {
+			return false;
+		}
+		std::vector<InputCamera::Ptr> cams = bundle.cameras();
+
+		// Keep the dataset description consistent for the components loaded on the side.
+		_data.reset(new ParseData());
+		std::string basePath = bundle.basePath();
+		_data->basePathName(basePath);
+		std::vector<sibr::ImageListFile::Infos> infos(cams.size());
+		std::vector<bool> active(cams.size());
+		for (size_t cid = 0; cid < cams.size(); ++cid) {
+			infos[cid] = { cams[cid]->name(), uint(cams[cid]->id()), uint(cams[cid]->w()), uint(cams[cid]->h()) };
+			active[cid] = cams[cid]->isActive();
+		}
+		_data->imgInfos(infos);
+		_data->activeImages(active);
+		_data->numCameras(int(cams.size()));
+		_data->cameras(cams);
+
+		_cams.reset(new CalibratedCameras());
+		_cams->setupCamerasFromExisting(cams);
+		// The images only live on the GPU.
+		_imgs.reset(new InputImages());
+		_imgs->loadFromExisting(std::vector<sibr::ImageRGB>(cams.size()));
+		_proxies.reset(new ProxyMesh());
+		_proxies->replaceProxyPtr(bundle.mesh());
+		_renderTargets.reset(new RenderTargetTextures());
+		_renderTargets->setTextureArrays(bundle.createRGBArray(textureFlags), bundle.createDepthArray(SIBR_GPU_LINEAR_SAMPLING));
+
+		SIBR_LOG << "Loaded scene bundle " << path << " (" << cams.size() << " cameras)." << std::endl;
+		return true;
+	}
+
+	bool BasicIBRScene::saveBundle(const std::string & path) const
+	{
+		const Texture2DArrayRGB::Ptr & rgbs = _renderTargets->getInputRGBTextureArrayPtr();
+		const Texture2DArrayLum32F::Ptr & depths = _renderTargets->getInputDepthMapArrayPtr();
+		if (!rgbs || !depths || !_proxies->hasProxy()) {
+			SIBR_WRG << "The scene has no RGB and depth arrays or no proxy, no bundle written to " << path << "." << std::endl;
+			return false;
+		}
+		return SceneBundle::write(path, _cams->inputCameras(), _proxies->proxy(), *rgbs, *depths, _data->basePathName(), _data->meshPath());
+	}
+
 	void BasicIBRScene::createRenderTargets()
 	{
+		SIBR_MEMORY_SCOPE("Scene");
 		_renderTargets->initializeDefaultRenderTargets(_cams, _imgs, _proxies);
 	}
 
@@ -94,8 +184,10 @@ namespace sibr
 
 	void BasicIBRScene::createFromData(const uint width)
 	{
+		SIBR_MEMORY_SCOPE("Scene");
 		_cams.reset(new CalibratedCameras());
 		_imgs.reset(new InputImages());
+		_imgs->useSharedCache(_currentOpts.sharedCache);
 		_proxies.reset(new ProxyMesh());
 
 		// setup calibrated cameras
@@ -106,68 +198,282 @@ namespace sibr
 			std::cout << "Number of Cameras set up: " << _cams->inputCameras().size() << std::endl;
 		}
 
+		if (_currentOpts.background) {
+			createInBackground(width);
+			if (_currentOpts.watch) {
+				watchAssets(true);
+			}
+			return;
+		}
+
 		// load input images
 
 		uint mwidth = width;
-		if (_currentOpts.images) {
-			_imgs->loadFromData(_data);
-			std::cout << "Number of Images loaded: " << _imgs->inputImages().size() << std::endl;
-
-			if (width == 0) {// default
-				if (_imgs->inputImages()[0]->w() > 1920) {
-					SIBR_LOG << "Limiting width to 1920 for performance; use --texture-width to override" << std::endl;
-					mwidth = 1920;
+		if (_currentOpts.images && _currentOpts.streamImages && !_cams->inputCameras().empty()) {
+			// The cameras give the image size, the texture array is filled while decoding.
+			if (width == 0 && _currentOpts.textureMemoryFraction <= 0.0f && _cams->inputCameras()[0]->w() > 1920) {
+				SIBR_LOG << "Limiting width to 1920 for performance; use --texture-width to override" << std::endl;
+				mwidth = 1920;
+			}
+			createRenderTargetTextures(mwidth);
+			InputImages::Ptr imgs(new InputImages());
+			imgs->useSharedCache(_currentOpts.sharedCache);
+			_imgs = imgs;
+			_renderTargets->initStreamedRGBTextureArray(_cams, imgs, _data, _currentOpts.streamFlags, _currentOpts.keepImages);
+			std::cout << "Number of Images streamed: " << _imgs->inputImages().size() << std::endl;
+		}
+		else {
+			if (_currentOpts.images) {
+				_imgs->loadFromData(_data);
+				std::cout << "Number of Images loaded: " << _imgs->inputImages().size() << std::endl;
+
+				if (width == 0 && _currentOpts.textureMemoryFraction <= 0.0f) {// default, the budget picks the size otherwise
+					if (_imgs->inputImages()[0]->w() > 1920) {
+						SIBR_LOG << "Limiting width to 1920 for performance; use --texture-width to override" << std::endl;
+						mwidth = 1920;
+					}
 				}
 			}
+			createRenderTargetTextures(mwidth);
 		}
-		_renderTargets.reset(new RenderTargetTextures(mwidth));
 
 		if (_currentOpts.mesh) {
-			// load proxy
-			_proxies->loadFromData(_data);
+			MeshData mesh;
+			loadMeshData(mesh);
+			installMeshData(mesh);
+		}
+
+		if (_currentOpts.renderTargets) {
+			createRenderTargets();
+		}
+
+		if (_currentOpts.watch) {
+			watchAssets(true);
+		}
+	}
+	
+	void BasicIBRScene::createInBackground(const uint width)
+	{
+		uint mwidth = width;
+		if (width == 0 && _currentOpts.textureMemoryFraction <= 0.0f && !_cams->inputCameras().empty() && _cams->inputCameras()[0]->w() > 1920) {
+			SIBR_LOG << "Limiting width to 1920 for performance; use --texture-width to override" << std::endl;
+			mwidth = 1920;
+		}
+		createRenderTargetTextures(mwidth);
+		SIBR_LOG << "Loading the scene in the background (" << _cams->inputCameras().size() << " cameras)." << std::endl;
+
+		// Loaders get their own threads: they wait for decoding tasks of the shared pool and for the main thread.
+		if (_currentOpts.images && !_cams->inputCameras().empty()) {
+			_imagesReady = std::async(std::launch::async, [this]() {
+				SIBR_MEMORY_SCOPE("Scene");
+				// Filled on this thread, then handed to the scene images, that views may already reference.
+				const InputImages::Ptr loaded(new InputImages());
+				loaded->useSharedCache(_currentOpts.sharedCache);
+				if (_currentOpts.streamImages) {
+					_renderTargets->initStreamedRGBTextureArrayInBackground(_cams, loaded, _data, _currentOpts.streamFlags, _currentOpts.keepImages, _cancelled);
+				}
+				else {
+					loaded->loadFromData(_data);
+				}
+				MainThreadQueue::shared().submit([this, loaded]() {
+					_imgs->loadFromExisting(loaded->inputImages());
+					std::cout << "Number of Images loaded: " << _imgs->inputImages().size() << std::endl;
+				}).wait();
+			}).share();
+		}
 
+		if (_currentOpts.mesh) {
+			// Views can reference the proxy mesh right away, it is empty until loaded.
+			_proxies->replaceProxyPtr(Mesh::Ptr(new Mesh()));
+			_meshReady = std::async(std::launch::async, [this]() {
+				SIBR_MEMORY_SCOPE("Scene");
+				const std::shared_ptr<MeshData> mesh = std::make_shared<MeshData>();
+				loadMeshData(*mesh);
+				MainThreadQueue::shared().submit([this, mesh]() { installMeshData(*mesh); }).wait();
+			}).share();
+		}
 
-			std::vector<InputCamera::Ptr> inCams = _cams->inputCameras();
-			float eps = 0.1f;
-			if (inCams.size() > 0 && (abs(inCams[0]->znear() - 0.1) < eps || abs(inCams[0]->zfar() - 1000.0) < eps || abs(inCams[0]->zfar() - 100.0) < eps) && _proxies->proxy().triangles().size() > 0) {
-				std::vector<sibr::Vector2f>    nearsFars;
-				CameraRaycaster::computeClippingPlanes(_proxies->proxy(), inCams, nearsFars);
-				_cams->updateNearsFars(nearsFars);
-			}
+		if (_currentOpts.renderTargets) {
+			const std::shared_future<void> images = _imagesReady;
+			const std::shared_future<void> mesh = _meshReady;
+			_renderTargetsReady = std::async(std::launch::async, [this, images, mesh]() {
+				if (images.valid()) {
+					images.wait();
+				}
+				if (mesh.valid()) {
+					mesh.wait();
+				}
+				if (!_cancelled) {
+					MainThreadQueue::shared().submit([this]() { createRenderTargets(); }).wait();
+				}
+			}).share();
+		}
+	}
+
+	void BasicIBRScene::createRenderTargetTextures(const uint width)
+	{
+		_renderTargets.reset(new RenderTargetTextures(width));
+		if (_currentOpts.textureMemoryFraction > 0.0f && !_cams->inputCameras().empty()) {
+			const bool mipmaps = (_currentOpts.streamFlags & SIBR_GPU_AUTOGEN_MIPMAP) != 0;
+			_renderTargets->setMemoryBudget(RTTextureSize::videoMemoryBudget(_currentOpts.textureMemoryFraction), uint(_cams->inputCameras().size()), mipmaps);
+		}
+	}
 
-			//// Load the texture.
-			sibr::ImageRGB inputTextureImg;
+	void BasicIBRScene::loadMeshData(MeshData & mesh) const
+	{
+		mesh.proxies.reset(new ProxyMesh());
+		mesh.proxies->useSharedCache(_currentOpts.sharedCache);
+		mesh.proxies->loadFromData(_data);
+		if (_currentOpts.optimizeProxy && mesh.proxies->hasProxy()) {
+			mesh.proxies->proxyPtr()->optimizeForRendering();
+		}
+		const Mesh & proxy = mesh.proxies->proxy();
+
+		std::vector<InputCamera::Ptr> inCams = _cams->inputCameras();
+		float eps = 0.1f;
+		if (inCams.size() > 0 && (abs(inCams[0]->znear() - 0.1) < eps || abs(inCams[0]->zfar() - 1000.0) < eps || abs(inCams[0]->zfar() - 100.0) < eps) && proxy.triangles().size() > 0) {
+			CameraRaycaster::computeClippingPlanes(proxy, inCams, mesh.nearsFars);
+		}
 
-			std::string texturePath, textureImageFileName;
+		//// Load the texture.
+		std::string texturePath, textureImageFileName;
 
-			// Assumes that the texture is stored next to the mesh in the same directory
-			// This information comes from Assimp and the mtl file if available
-			if ((textureImageFileName = _proxies->proxy().getTextureImageFileName()) != "") {
-				texturePath = sibr::parentDirectory(_data->meshPath()) + "/" + textureImageFileName;
-				// check if full path given 
-				if (!sibr::fileExists(texturePath) && sibr::fileExists(textureImageFileName)) 
-					texturePath = textureImageFileName;
+		// Assumes that the texture is stored next to the mesh in the same directory
+		// This information comes from Assimp and the mtl file if available
+		if ((textureImageFileName = proxy.getTextureImageFileName()) != "") {
+			texturePath = sibr::parentDirectory(_data->meshPath()) + "/" + textureImageFileName;
+			// check if full path given 
+			if (!sibr::fileExists(texturePath) && sibr::fileExists(textureImageFileName)) 
+				texturePath = textureImageFileName;
+		}
+		else {
+			texturePath = sibr::parentDirectory(_data->meshPath()) + "/mesh_u1_v1.png";
+			if (sibr::fileExists(texturePath)) {
+				texturePath = sibr::parentDirectory(_data->meshPath()) + "/textured_u1_v1.png";
+				if (!sibr::fileExists(texturePath)) 
+					texturePath = sibr::parentDirectory(_data->meshPath()) + "/texture.png";
 			}
-			else {
-				texturePath = sibr::parentDirectory(_data->meshPath()) + "/mesh_u1_v1.png";
-				if (sibr::fileExists(texturePath)) {
-					texturePath = sibr::parentDirectory(_data->meshPath()) + "/textured_u1_v1.png";
-					if (!sibr::fileExists(texturePath)) 
-						texturePath = sibr::parentDirectory(_data->meshPath()) + "/texture.png";
+		}
+
+		if (_currentOpts.texture && sibr::fileExists(texturePath)) {
+			mesh.texture.load(texturePath);
+			mesh.texturePath = texturePath;
+		}
+	}
+
+	void BasicIBRScene::installMeshData(MeshData & mesh)
+	{
+		_proxies->replaceProxyPtr(mesh.proxies->proxyPtr());
+		if (!mesh.nearsFars.empty()) {
+			_cams->updateNearsFars(mesh.nearsFars);
+		}
+		if (mesh.texture.w() > 0) {
+			_inputMeshTexture.reset(new sibr::Texture2DRGB(mesh.texture, SIBR_GPU_LINEAR_SAMPLING));
+			_meshTexturePath = mesh.texturePath;
+		}
+		// Loaded in the background after the watches were set, the texture path is only known now.
+		if (!_watches.empty()) {
+			watchAssets(true);
+		}
+	}
+
+	void BasicIBRScene::watchAssets(bool enable)
+	{
+		FileWatcher & watcher = FileWatcher::shared();
+		for (const FileWatcher::Id id : _watches) {
+			watcher.unwatch(id);
+		}
+		_watches.clear();
+		_currentOpts.watch = enable;
+		if (!enable || !_data) {
+			return;
+		}
+
+		if (_currentOpts.mesh && !_data->meshPath().empty()) {
+			_watches.push_back(watcher.watch(_data->meshPath(), [this](const std::string &) { reloadMesh(); }));
+		}
+		if (!_meshTexturePath.empty()) {
+			_watches.push_back(watcher.watch(_meshTexturePath, [this](const std::string & path) { reloadMeshTexture(path); }));
+		}
+		if (_currentOpts.images) {
+			const std::vector<sibr::ImageListFile::Infos> & infos = _data->imgInfos();
+			for (size_t i = 0; i < infos.size(); ++i) {
+				if (i < _data->activeImages().size() && !_data->activeImages()[i]) {
+					continue;
 				}
+				_watches.push_back(watcher.watch(_data->imgPath() + "/" + infos[i].filename, [this, i](const std::string & path) {
+					reloadInputImage(uint(i), path);
+				}));
 			}
+		}
+		SIBR_LOG << "Watching " << _watches.size() << " scene files for modifications." << std::endl;
+	}
 
+	void BasicIBRScene::reloadMesh(void)
+	{
+		// The proxy loaded in the background would replace the reloaded one.
+		if (_meshReady.valid() && _meshReady.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+		SIBR_MEMORY_SCOPE("Scene");
+		ProxyMesh loaded;
+		loaded.useSharedCache(_currentOpts.sharedCache);
+		loaded.loadFromData(_data);
+		if (!loaded.hasProxy() || loaded.proxy().vertices().empty()) {
+			SIBR_WRG << "Unable to reload the proxy " << _data->meshPath() << ", keeping the previous one." << std::endl;
+			return;
+		}
+		if (_currentOpts.optimizeProxy) {
+			loaded.proxyPtr()->optimizeForRendering();
+		}
 
-			if (_currentOpts.texture && sibr::fileExists(texturePath)) {
-				inputTextureImg.load(texturePath);
-				_inputMeshTexture.reset(new sibr::Texture2DRGB(inputTextureImg, SIBR_GPU_LINEAR_SAMPLING));
-			}
+		const Mesh::Ptr current = _proxies->proxyPtr();
+		if (!current || !current->updateAttributes(loaded.proxy())) {
+			// New topology: the views referencing the previous proxy keep it until they query the scene again.
+			SIBR_LOG << "The proxy topology changed, replacing it." << std::endl;
+			_proxies->replaceProxyPtr(loaded.proxyPtr());
+		}
+
+		// The input depth maps are rendered from the proxy.
+		if (_renderTargets && _renderTargets->getInputDepthMapArrayPtr()) {
+			_renderTargets->initDepthTextureArrays(_cams, _proxies, true);
+		}
+	}
 
+	void BasicIBRScene::reloadMeshTexture(const std::string & path)
+	{
+		sibr::ImageRGB image;
+		if (!image.load(path, false)) {
+			SIBR_WRG << "Unable to reload the texture " << path << std::endl;
+			return;
+		}
+		if (_inputMeshTexture && _inputMeshTexture->w() == image.w() && _inputMeshTexture->h() == image.h()) {
+			_inputMeshTexture->update(image);
 		}
+		else {
+			_inputMeshTexture.reset(new sibr::Texture2DRGB(image, SIBR_GPU_LINEAR_SAMPLING));
+		}
+	}
 
-		if (_currentOpts.renderTargets) {
-			createRenderTargets();
+	void BasicIBRScene::reloadInputImage(uint i, const std::string & path)
+	{
+		// Not loaded yet, the background loading will read the new file.
+		if (!isReady() || i >= _cams->inputCameras().size()) {
+			return;
+		}
+		sibr::ImageRGB image;
+		if (!image.load(path, false)) {
+			SIBR_WRG << "Unable to reload the image " << path << std::endl;
+			return;
+		}
+		const std::vector<ImageRGB::Ptr> & images = _imgs->inputImages();
+		if (i < images.size() && images[i] && images[i]->w() > 0) {
+			// Keep the size of the loaded images, they may have been reduced.
+			*images[i] = images[i]->w() == image.w() && images[i]->h() == image.h() ? image.clone() : image.resized(images[i]->w(), images[i]->h(), cv::INTER_AREA);
+		}
+		if (!_renderTargets || !_renderTargets->updateInputRGBLayer(i, image)) {
+			SIBR_WRG << "The input textures of the scene can't be updated in place, restart to use the new " << path << std::endl;
 		}
 	}
-	
+
 }
@@ -13,12 +13,21 @@
 #pragma once
 
 #include <core/scene/IIBRScene.hpp>
+#include <core/scene/ProxyMesh.hpp>
+#include <atomic>
+#include <future>
 
 namespace sibr {
 
 	/**
 	* Class used to define a basic IBR Scene 
 	* containing multiple components required to define a scene.
+	*
+	* With SceneOptions::background, the constructors return once the cameras are set up: the images,
+	* the proxy and the render targets are loaded by background threads and installed on the main thread
+	* (through the MainThreadQueue run by sibr::Window) as soon as each is ready, the streamed RGB array
+	* being filled layer by layer. Until then the components are empty; views should check
+	* isReady() or the component futures before using them.
 	* 
 	* \ingroup sibr_scene
 	*/
@@ -55,8 +64,47 @@ namespace sibr {
 		BasicIBRScene(const BasicIBRAppArgs& myArgs, SceneOptions myOpts = SceneOptions());
 
 
-		/** Destructor. */
-		~BasicIBRScene() {};
+		/** Destructor, waits for the components loaded in the background. */
+		~BasicIBRScene();
+
+		/**
+		* \brief Whether all the components loaded in the background are installed.
+		* \return true if nothing is loading
+		*/
+		bool isReady(void) const;
+
+		/**
+		* \brief Block until the components loaded in the background are installed, running the main thread tasks meanwhile.
+		* Should be called from the main thread.
+		*/
+		void waitUntilReady(void);
+
+		/**
+		* \brief Future on the background loading of the images (or their streaming to the RGB array).
+		* \return the future, invalid if the images are not loaded in the background
+		*/
+		const std::shared_future<void> & imagesReady(void) const { return _imagesReady; }
+
+		/**
+		* \brief Future on the background loading of the proxy, its texture and the cameras clipping planes.
+		* \return the future, invalid if the proxy is not loaded in the background
+		*/
+		const std::shared_future<void> & meshReady(void) const { return _meshReady; }
+
+		/**
+		* \brief Future on the background creation of the render targets, once the images and the proxy are ready.
+		* \return the future, invalid if the render targets are not created in the background
+		*/
+		const std::shared_future<void> & renderTargetsReady(void) const { return _renderTargetsReady; }
+
+		/**
+		* \brief Reload the proxy, its texture and the input images when their files are modified, without restarting.
+		* The proxy vertices are updated in place when the topology is unchanged, and the input images are written to
+		* their layer of the RGB texture array (uncompressed arrays only). For the other render targets, restart.
+		* Files are checked by FileWatcher::shared, polled by the window.
+		* \param enable start or stop watching
+		*/
+		void watchAssets(bool enable);
 
 		/**
 		* \brief Creates a BasicIBRScene given custom data argument.
@@ -66,6 +114,22 @@ namespace sibr {
 		* \param myOpts to specify whether to initialize specific parts of the scene (RTs, geometry,...)
 		*/
 		void createFromCustomData(const IParseData::Ptr & data, const uint width = 0, SceneOptions myOpts = SceneOptions()) override;
+
+		/**
+		* \brief Creates the scene from a bundle written by saveBundle, skipping the dataset parsing,
+		* the image decoding and the depth maps rendering. The input images are left empty.
+		* \param path the bundle file.
+		* \param textureFlags the sampling options of the RGB array, the depth array is linearly sampled.
+		* \return false if the bundle is missing, outdated or invalid, the scene is then left untouched.
+		*/
+		bool createFromBundle(const std::string & path, uint textureFlags = 0);
+
+		/**
+		* \brief Bakes the cameras, the proxy and the RGB and depth texture arrays of the scene in a bundle.
+		* \param path the bundle file.
+		* \return false if the scene has no regular (non sparse) arrays or if the file can't be written.
+		*/
+		bool saveBundle(const std::string & path) const;
 		
 		/**
 		 * \brief Function to create a scene directly using the dataset path specified in command-line.
@@ -138,6 +202,22 @@ namespace sibr {
 		RenderTargetTextures::Ptr	_renderTargets;
 		SceneOptions				_currentOpts;
 
+		std::shared_future<void>	_imagesReady; ///< Background images loading.
+		std::shared_future<void>	_meshReady; ///< Background proxy loading.
+		std::shared_future<void>	_renderTargetsReady; ///< Background render targets creation.
+		std::atomic<bool>			_cancelled = { false }; ///< Set when the scene is destroyed while loading.
+
+		/** CPU side of the proxy loading, that can run on any thread. */
+		struct MeshData {
+			ProxyMesh::Ptr				proxies; ///< The loaded proxy.
+			std::vector<sibr::Vector2f>	nearsFars; ///< Clipping planes of the cameras, empty if they don't need updating.
+			sibr::ImageRGB				texture; ///< Proxy texture, empty if none.
+			std::string					texturePath; ///< Proxy texture file, empty if none.
+		};
+
+		std::vector<uint64_t>		_watches; ///< Watched assets, see watchAssets.
+		std::string					_meshTexturePath; ///< Proxy texture file, empty if none.
+
 		/**
 		* \brief Creates a BasicIBRScene from the internal stored data component in the scene.
 		* The data could be populated either from dataset path or customized by the user externally.
@@ -145,6 +225,46 @@ namespace sibr {
 		*/
 		void createFromData(const uint width = 0);
 
+		/**
+		* \brief Start the background loading of the images, the proxy and the render targets, see SceneOptions::background.
+		* \param width the constrained width for GPU texture data.
+		*/
+		void createInBackground(const uint width);
+
+		/**
+		* \brief Create the render targets textures, limited to the budget of SceneOptions::textureMemoryFraction if any.
+		* \param width the constrained width for GPU texture data, 0 for the native size.
+		*/
+		void createRenderTargetTextures(const uint width);
+
+		/**
+		* \brief Load the proxy, its texture image and compute the cameras clipping planes, without GL calls.
+		* \param mesh will contain the loaded data
+		*/
+		void loadMeshData(MeshData & mesh) const;
+
+		/**
+		* \brief Install a loaded proxy in the scene, on the main thread.
+		* \param mesh the loaded data
+		*/
+		void installMeshData(MeshData & mesh);
+
+		/** \brief Reload the proxy after a modification of its file, see watchAssets. */
+		void reloadMesh(void);
+
+		/**
+		* \brief Reload the proxy texture after a modification of its file, see watchAssets.
+		* \param path the texture file
+		*/
+		void reloadMeshTexture(const std::string & path);
+
+		/**
+		* \brief Reload an input image after a modification of its file, see watchAssets.
+		* \param i the image index
+		* \param path the image file
+		*/
+		void reloadInputImage(uint i, const std::string & path);
+
 		
 	};
 
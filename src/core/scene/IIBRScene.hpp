@@ -53,6 +53,14 @@ namespace sibr {
 			bool		images = true; ///< Load images?
 			bool		cameras = true; ///< Load cameras?
 			bool        texture = true; ///< Load texture ?
+			bool		streamImages = false; ///< Decode the images straight into the RGB texture array, see RenderTargetTextures::initStreamedRGBTextureArray.
+			bool		keepImages = true; ///< Keep the CPU images once streamed to the GPU?
+			int			streamFlags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE; ///< Options of the streamed RGB texture array.
+			bool		optimizeProxy = false; ///< Reorder the proxy triangles and vertices for the GPU caches, see Mesh::optimizeForRendering.
+			bool		background = false; ///< Only set up the cameras before returning, load the other components in the background, see BasicIBRScene::isReady.
+			float		textureMemoryFraction = 0.0f; ///< If positive, the input textures are sized for their arrays to fit in this fraction of the available video memory, see RTTextureSize::setMemoryBudget.
+			bool		sharedCache = false; ///< Share the decoded images and the proxy with the other processes opening the dataset, see SharedSceneCache.
+			bool		watch = false; ///< Reload the proxy, its texture and the input images when their files change, see BasicIBRScene::watchAssets.
 
 			SceneOptions() {}
 		};
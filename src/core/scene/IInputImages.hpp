@@ -30,6 +30,7 @@ namespace sibr
 		virtual void										loadFromData(const IParseData::Ptr & data) = 0;
 		virtual void										loadFromExisting(const std::vector<sibr::ImageRGB::Ptr> & imgs) = 0;
 		virtual void										loadFromExisting(const std::vector<sibr::ImageRGB> & imgs) = 0;
+		virtual void										loadFromExisting(std::vector<sibr::ImageRGB> && imgs) = 0;
 		virtual void										loadFromPath(const IParseData::Ptr & data, const std::string & prefix, const std::string & postfix) = 0;
 
 		// Alpha blend and modify input images -- for fences
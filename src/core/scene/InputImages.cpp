@@ -11,35 +11,126 @@
 
 
 #include "InputImages.hpp"
+#include "core/scene/SharedSceneCache.hpp"
+#include "core/system/LoadingProgress.hpp"
+#include "core/system/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
 
 
 namespace sibr
 {
 	void InputImages::loadFromData(const IParseData::Ptr & data)
+	{
+		loadFromData(data, ImageReadyCallback());
+	}
+
+	void InputImages::loadFromData(const IParseData::Ptr & data, const ImageReadyCallback & onReady, uint maxPending, const sibr::Vector2u & minSize)
 	{
 		//InputImages out;
-		_inputImages.resize(data->imgInfos().size());
+		const uint count = uint(data->imgInfos().size());
+		_inputImages.resize(count);
+
+		if (count == 0) {
+			SIBR_WRG << "cannot load images (ImageListFile is empty. Did you use ImageListFile::load(...) before ?";
+			std::cout << std::endl;
+			return;
+		}
+
+		// Already decoded by another viewer.
+		if (_sharedCache && SharedSceneCache::attachImages(*data, minSize, _inputImages)) {
+			if (onReady) {
+				for (uint i = 0; i < count; ++i) {
+					onReady(i, _inputImages[i]);
+				}
+			}
+			trackMemory();
+			return;
+		}
+		std::unique_ptr<SharedSceneCache::ImageWriter> cacheWriter;
+		if (_sharedCache) {
+			cacheWriter.reset(new SharedSceneCache::ImageWriter(*data, minSize));
+		}
+
+		maxPending = std::max(maxPending, 1u);
+		ThreadPool & pool = ThreadPool::shared();
+		const uint threadCount = std::min({ pool.threadCount(), count, maxPending });
+
+		// Workers reserve a slot before decoding, the calling thread releases it once the image is handed over.
+		std::atomic<uint> next(0);
+		std::mutex mutex;
+		std::condition_variable slotFreed, imageReady;
+		std::queue<uint> ready;
+		uint pending = 0;
 
-		if (data->imgInfos().empty() == false)
-		{
-//			#pragma omp parallel for
-			for (int i = 0; i < data->imgInfos().size(); ++i) {
+		const auto decode = [&]() {
+			for (uint i = next++; i < count; i = next++) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					slotFreed.wait(lock, [&] { return pending < maxPending; });
+					++pending;
+				}
+				ImageRGB::Ptr image;
 				if (data->activeImages()[i]) {
-					_inputImages[i] = std::make_shared<ImageRGB>();
-					_inputImages[i]->load(data->imgPath() + "/" + data->imgInfos().at(i).filename, false);
+					image = std::make_shared<ImageRGB>();
+					const std::string path = data->imgPath() + "/" + data->imgInfos().at(i).filename;
+					const bool loaded = minSize.x() > 0 && minSize.y() > 0 ? image->loadReduced(path, minSize.x(), minSize.y(), false) : image->load(path, false);
+					if (!loaded) {
+						SIBR_WRG << "could not load input image : " << path << std::endl;
+					}
 				}
 				else {
-					_inputImages[i] = std::make_shared<ImageRGB>(16,16, 0);
+					image = std::make_shared<ImageRGB>(16, 16, 0);
 				}
+				// Before the hand over, the consumer can release the pixels.
+				if (cacheWriter) {
+					cacheWriter->add(i, *image);
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				_inputImages[i] = image;
+				ready.push(i);
+				imageReady.notify_one();
+			}
+		};
+
+		std::vector<std::future<void>> workers;
+		for (uint t = 0; t < threadCount; ++t) {
+			workers.push_back(pool.submit(decode));
+		}
+
+		sibr::LoadingProgress progress(count, "[InputImages] Loading " + std::to_string(count) + " images");
+		for (uint done = 0; done < count; ++done) {
+			uint i;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				imageReady.wait(lock, [&] { return !ready.empty(); });
+				i = ready.front();
+				ready.pop();
+			}
+			if (onReady) {
+				onReady(i, _inputImages[i]);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--pending;
 			}
-									
+			slotFreed.notify_one();
+			progress.walk();
 		}
-		else
-			SIBR_WRG << "cannot load images (ImageListFile is empty. Did you use ImageListFile::load(...) before ?";
 
+		// The decoding tasks reference the local state until they return.
+		for (auto & worker : workers) {
+			worker.wait();
+		}
 		std::cout << std::endl;
-		
-		return;
+		if (cacheWriter) {
+			cacheWriter->finish();
+		}
+		trackMemory();
 	}
 
 	void InputImages::loadFromExisting(const std::vector<sibr::ImageRGB> & imgs)
@@ -48,6 +139,17 @@ namespace sibr
 		for (size_t i = 0; i < imgs.size(); ++i) {
 			_inputImages[i].reset(new ImageRGB(imgs[i].clone()));
 		}
+		trackMemory();
+	}
+
+	void InputImages::loadFromExisting(std::vector<sibr::ImageRGB> && imgs)
+	{
+		_inputImages.resize(imgs.size());
+		for (size_t i = 0; i < imgs.size(); ++i) {
+			_inputImages[i].reset(new ImageRGB(std::move(imgs[i])));
+		}
+		imgs.clear();
+		trackMemory();
 	}
 
 	/// \todo UN-TESTED code!!!!
@@ -64,6 +166,16 @@ namespace sibr
 				}
 			}
 		}
+		trackMemory();
+	}
+
+	void InputImages::trackMemory(void)
+	{
+		size_t bytes = 0;
+		for (const auto & image : _inputImages) {
+			bytes += image ? size_t(image->w()) * size_t(image->h()) * sizeof(ImageRGB::Pixel) : 0;
+		}
+		_memory.set(bytes);
 	}
 
 
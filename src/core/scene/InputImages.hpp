@@ -14,6 +14,8 @@
 
 #include "core/scene/IInputImages.hpp"
 #include "core/scene/Config.hpp"
+#include "core/graphics/MemoryTracker.hpp"
+#include <functional>
 
 namespace sibr
 {
@@ -27,12 +29,32 @@ namespace sibr
 
 		typedef std::shared_ptr<InputImages>				Ptr;
 
+		/// Called on the loading thread with the index of each decoded image, in completion order.
+		typedef std::function<void(uint, const sibr::ImageRGB::Ptr &)>	ImageReadyCallback;
+
 		InputImages(){};
 		void												loadFromData(const IParseData::Ptr & data) override;
+
+		/** Decode the input images in parallel, handing each one over as soon as it is ready.
+		\param data the dataset description
+		\param onReady called on the calling thread for each decoded image (can be empty), so GPU uploads can start while decoding continues
+		\param maxPending maximum number of images being decoded or waiting for onReady, bounds the memory held by slow consumers
+		\param minSize if not null, the images are only needed at this size and JPEG files are downscaled while decoding, see Image::loadReduced
+		*/
+		void												loadFromData(const IParseData::Ptr & data, const ImageReadyCallback & onReady, uint maxPending = 32, const sibr::Vector2u & minSize = sibr::Vector2u(0, 0));
 		virtual void										loadFromExisting(const std::vector<sibr::ImageRGB::Ptr> & imgs) override;
 		void												loadFromExisting(const std::vector<sibr::ImageRGB> & imgs) override;
+		/** Take the pixels of existing images, without copying them.
+		\param imgs the images, left empty
+		*/
+		void												loadFromExisting(std::vector<sibr::ImageRGB> && imgs) override;
 		void												loadFromPath(const IParseData::Ptr & data, const std::string & prefix, const std::string & postfix) override;
 
+		/** Map the images from the SharedSceneCache when another process already decoded them, and add them to it otherwise.
+		\param enabled use the cache in the next loadFromData
+		*/
+		void												useSharedCache(bool enabled) { _sharedCache = enabled; }
+
 		// Alpha blend and modify input images -- for fences
 		void												alphaBlendInputImages(const std::vector<sibr::ImageRGB>& back, std::vector<sibr::ImageRGB>& alphas) override;
 
@@ -43,13 +65,19 @@ namespace sibr
 
 	protected:
 
+		/** Report the size of the loaded images to the MemoryTracker. */
+		void												trackMemory(void);
+
 		std::vector<sibr::ImageRGB::Ptr>							_inputImages;
+		TrackedMemory												_memory = TrackedMemory(MemoryTracker::IMAGE); ///< Size of the images.
+		bool														_sharedCache = false; ///< Use the SharedSceneCache.
 
 	};
 
 	inline void InputImages::loadFromExisting(const std::vector<sibr::ImageRGB::Ptr>& imgs)
 	{
 		_inputImages = imgs;
+		trackMemory();
 	}
 
 	inline const std::vector<sibr::ImageRGB::Ptr>& InputImages::inputImages(void) const {
@@ -23,6 +23,7 @@
 #include <map>
 #include "core/system/String.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/scene/TileIndex.hpp"
 #include "core/system/Utils.hpp"
 #include <algorithm>
 #include <filesystem>
@@ -381,15 +382,25 @@ namespace sibr {
 
 	void ParseData::getParsedChunkedData(const std::string& dataset_path)
 	{
-		_basePathName = sibr::parentDirectory(sibr::parentDirectory(dataset_path));;
-
-		auto test = sibr::getFileName(dataset_path);
-		std::replace(test.begin(), test.end(), '_', ' ');
-		std::stringstream ss(test);
-		int x, y;
-		ss >> x >> y;
-		x = 0;
-		y = 0;
+		_basePathName = sibr::parentDirectory(sibr::parentDirectory(dataset_path));
+		_datasetType = Type::CHUNKED;
+
+		// Tile coordinates and extent, from the index of the dataset when there is one.
+		TileIndex index;
+		index.load(_basePathName);
+		const int tileId = index.find(dataset_path);
+		int x = 0, y = 0;
+		if (tileId >= 0) {
+			x = index.tiles()[tileId].x;
+			y = index.tiles()[tileId].y;
+		}
+		else if (!TileIndex::parseTileName(sibr::getFileName(dataset_path), x, y)) {
+			SIBR_WRG << "Chunk directory " << dataset_path << " is not named after its tile coordinates (x_y), using tile 0 0." << std::endl;
+		}
+		Vector2f tileMin, tileMax;
+		index.cellBounds(x, y, tileMin, tileMax);
+		tileMin -= Vector2f(index.margin(), index.margin());
+		tileMax += Vector2f(index.margin(), index.margin());
 
 		_imgPath = _basePathName + "/cameras/";
 
@@ -403,7 +414,9 @@ namespace sibr {
 			auto quat = cam->transform().rotation();
 			auto mat = sibr::matFromQuat(quat);
 
-			if (mat(2, 2) > 0.9 || cam->position().x() < (x) * 100.9 || cam->position().x() > (x+1) * 100.9 || cam->position().y() < y * 100.9 || cam->position().y() > (y + 1) * 100.9)
+			// Skip the cameras out of the tile, and the ones looking straight down.
+			const Vector3f & position = cam->position();
+			if (mat(2, 2) > 0.9 || position.x() < tileMin.x() || position.x() > tileMax.x() || position.y() < tileMin.y() || position.y() > tileMax.y())
 				continue;
 
 			cam->name(camdirs[i] + ".png");
@@ -412,7 +425,9 @@ namespace sibr {
 
 		populateFromCamInfos();
 
-		colmapSave(_basePathName + "/sparse/images.txt", _camInfos, 1.0f);
+		// Per tile, the tiles can be parsed concurrently.
+		sibr::makeDirectory(dataset_path + "/sparse");
+		colmapSave(dataset_path + "/sparse/images.txt", _camInfos, 1.0f);
 
 		_meshPath = dataset_path + "/mesh.ply";
 	}
@@ -422,7 +437,14 @@ namespace sibr {
 	{
 		_basePathName = dataset_path + "/colmap/stereo";
 
-		_camInfos = sibr::InputCamera::loadColmap(_basePathName + "/sparse", 0.01f, 1000.0f, fovXfovY_flag);
+		// The binary model is much faster to parse, use it when Colmap exported both.
+		const std::string sparsePath = _basePathName + "/sparse";
+		if (sibr::fileExists(sparsePath + "/cameras.bin") && sibr::fileExists(sparsePath + "/images.bin")) {
+			_camInfos = sibr::InputCamera::loadColmapBin(sparsePath, 0.01f, 1000.0f, fovXfovY_flag);
+		}
+		else {
+			_camInfos = sibr::InputCamera::loadColmap(sparsePath, 0.01f, 1000.0f, fovXfovY_flag);
+		}
 
 		if (_camInfos.empty()) {
 			SIBR_ERR << "Colmap camera calibration file does not exist at /" + _basePathName + "/sparse/." << std::endl;
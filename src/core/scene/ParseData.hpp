@@ -84,6 +84,11 @@ namespace sibr{
 
 		void getParsedNeurofluidData(const std::string& dataset_path);
 
+		/**
+		* \brief Function to parse data from a tile of a tiled dataset, see TileIndex.
+		* \param dataset_path the tile directory: the cameras above it are read from the dataset root, two levels up
+		*
+		*/
 		void getParsedChunkedData(const std::string& dataset_path);
 
 		/**
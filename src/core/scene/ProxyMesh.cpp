@@ -11,12 +11,21 @@
 
 
 #include "ProxyMesh.hpp"
+#include "core/scene/SharedSceneCache.hpp"
 
 
 namespace sibr {
 
 	void ProxyMesh::loadFromData(const IParseData::Ptr & data)
 	{
+		if (_sharedCache) {
+			const Mesh::Ptr cached = SharedSceneCache::attachMesh(data->meshPath());
+			if (cached) {
+				_proxy = cached;
+				trackMemory();
+				return;
+			}
+		}
 		_proxy.reset(new Mesh());
 		// GD HACK
 		if (boost::filesystem::extension(data->meshPath()) == ".bin") {
@@ -32,6 +41,10 @@ namespace sibr {
 		if (!_proxy->hasNormals()) {
 			_proxy->generateNormals();
 		}
+		if (_sharedCache && hasProxy()) {
+			SharedSceneCache::storeMesh(data->meshPath(), *_proxy);
+		}
+		trackMemory();
 	}
 
 	void ProxyMesh::replaceProxy(Mesh::Ptr newProxy)
@@ -48,12 +61,24 @@ namespace sibr {
 		{
 			_proxy->generateNormals();
 		}
-
+		trackMemory();
 	}
 
 	void ProxyMesh::replaceProxyPtr(Mesh::Ptr newProxy)
 	{
 		_proxy = newProxy;
+		trackMemory();
+	}
+
+	void ProxyMesh::trackMemory(void)
+	{
+		if (!_proxy) {
+			_memory.set(0);
+			return;
+		}
+		_memory.set(_proxy->vertices().size() * sizeof(Vector3f) + _proxy->normals().size() * sizeof(Vector3f)
+			+ _proxy->colors().size() * sizeof(Vector3f) + _proxy->texCoords().size() * sizeof(Vector2f)
+			+ _proxy->triangles().size() * sizeof(Vector3u));
 	}
 
 
@@ -13,6 +13,7 @@
 #pragma once
 
 #include "core/scene/IProxyMesh.hpp"
+#include "core/graphics/MemoryTracker.hpp"
 
 namespace sibr {
 	/**
@@ -32,9 +33,19 @@ namespace sibr {
 		const Mesh&											proxy(void) const;
 		const Mesh::Ptr										proxyPtr(void) const;
 
+		/** Read the proxy buffers from the SharedSceneCache when another process already parsed the mesh, and add them to it otherwise.
+		\param enabled use the cache in the next loadFromData
+		*/
+		void												useSharedCache(bool enabled) { _sharedCache = enabled; }
+
 	protected:
 
+		/** Report the size of the proxy attributes to the MemoryTracker. */
+		void												trackMemory(void);
+
 		Mesh::Ptr											_proxy;
+		TrackedMemory										_memory = TrackedMemory(MemoryTracker::MESH); ///< Size of the proxy.
+		bool												_sharedCache = false; ///< Use the SharedSceneCache.
 
 	};
 
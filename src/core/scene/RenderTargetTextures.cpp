@@ -11,9 +11,51 @@
 
 
 #include "RenderTargetTextures.hpp"
+#include "core/system/String.hpp"
+#include "core/system/Utils.hpp"
+#include "core/graphics/ImageBufferPool.hpp"
+#include "core/graphics/MemoryTracker.hpp"
+#include "core/graphics/GPUMemoryBudget.hpp"
+#include "core/graphics/PixelKernels.hpp"
+#include "core/system/MainThreadQueue.hpp"
+#include <cmath>
+#include <cstring>
+#include <deque>
 
 namespace sibr {
 
+	namespace {
+
+		/** Resize and flip an input image as an RGB array layer.
+		\param img the input image
+		\param w the layer width
+		\param h the layer height
+		\param flip flip the rows
+		\param layer destination used when the layer differs from the image
+		\return the layer, either img or the destination image
+		*/
+		const ImageRGB & prepareLayer(const ImageRGB & img, uint w, uint h, bool flip, PooledImage<uchar, 3> & layer)
+		{
+			const bool resize = img.w() != w || img.h() != h;
+			if (!resize && !flip) {
+				return img;
+			}
+			// Resized or flipped layers are built in a recycled buffer.
+			layer = PooledImage<uchar, 3>(w, h);
+			if (resize) {
+				cv::Mat & dst = layer.image().toOpenCVnonConst();
+				cv::resize(img.toOpenCV(), dst, dst.size(), 0, 0, cv::INTER_LINEAR);
+				if (flip) {
+					layer.image().flipH();
+				}
+			} else {
+				pixels::flipRows(img.data(), layer.image().data(), h, size_t(w) * 3);
+			}
+			return layer.image();
+		}
+
+	}
+
 	void RTTextureSize::initSize(uint w, uint h, bool force_aspect_ratio)
 	{
 		
@@ -41,6 +83,26 @@ namespace sibr {
 			else _width = w, _height = h;
 		}
 
+		// Shrink the layers until the arrays fit, keeping the aspect ratio.
+		const size_t needed = arraysBytes(_width, _height, _budgetLayers, _budgetMipmaps);
+		if (_memoryBudget > 0 && _budgetLayers > 0 && needed > _memoryBudget) {
+			const uint requestedW = _width, requestedH = _height;
+			const double scale = std::sqrt(double(_memoryBudget) / double(needed));
+			uint fitW = std::max(uint(requestedW * scale), 1u);
+			uint fitH = std::max(uint(requestedH * scale), 1u);
+			while (arraysBytes(fitW, fitH, _budgetLayers, _budgetMipmaps) > _memoryBudget && fitW > 1 && fitH > 1) {
+				fitW = std::max(uint(fitW * 0.99), 1u);
+				fitH = std::max(uint(fitH * 0.99), 1u);
+			}
+			_width = fitW;
+			_height = fitH;
+			SIBR_LOG << "Input textures reduced from " << requestedW << "x" << requestedH << " to " << _width << "x" << _height
+				<< ": " << _budgetLayers << " layers need " << (needed >> 20) << " MB, the budget is " << (_memoryBudget >> 20) << " MB." << std::endl;
+		}
+		else if (_memoryBudget > 0) {
+			SIBR_LOG << "Input textures at " << _width << "x" << _height << " fit the budget: " << (needed >> 20) << " of " << (_memoryBudget >> 20) << " MB." << std::endl;
+		}
+
 		SIBR_LOG << "Rendering resolution: (" << _width << "," << _height << ")" << std::endl;
 		_isInit = true;
 	}
@@ -50,6 +112,32 @@ namespace sibr {
 		return _isInit;
 	}
 
+	void RTTextureSize::setMemoryBudget(size_t bytes, uint layers, bool mipmaps)
+	{
+		if (_isInit) {
+			SIBR_WRG << "The texture size is already set, the memory budget is ignored." << std::endl;
+		}
+		_memoryBudget = bytes;
+		_budgetLayers = layers;
+		_budgetMipmaps = mipmaps;
+	}
+
+	size_t RTTextureSize::videoMemoryBudget(float fraction, size_t fallbackBytes)
+	{
+		size_t total = 0, available = 0;
+		if (!MemoryTracker::driverMemory(total, available) || available == 0) {
+			SIBR_WRG << "The driver doesn't report the available video memory, assuming " << (fallbackBytes >> 20) << " MB." << std::endl;
+			available = fallbackBytes;
+		}
+		return size_t(double(available) * double(std::min(std::max(fraction, 0.0f), 1.0f)));
+	}
+
+	size_t RTTextureSize::arraysBytes(uint w, uint h, uint layers, bool mipmaps)
+	{
+		return MemoryTracker::textureBytes(w, h, layers, mipmaps ? 0 : 1, 4.0)
+			+ MemoryTracker::textureBytes(w, h, layers, 1, sizeof(float));
+	}
+
 	const std::vector<RenderTargetRGBA32F::Ptr>& RGBDInputTextures::inputImagesRT() const
 	{
 		return _inputRGBARenderTextures;
@@ -87,7 +175,7 @@ namespace sibr {
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, rawInputImage->handle());
 
-				glDisable(GL_DEPTH_TEST);
+				GLState::disable(GL_DEPTH_TEST);
 				textureShader.begin();
 				RenderUtility::renderScreenQuad();
 				textureShader.end();
@@ -116,7 +204,7 @@ namespace sibr {
 		for (uint i = 0; i < cams->inputCameras().size(); i++) {
 			if (cams->inputCameras()[i]->isActive()) {
 				_inputRGBARenderTextures[i]->bind();
-				glEnable(GL_DEPTH_TEST);
+				GLState::enable(GL_DEPTH_TEST);
 				glClear(GL_DEPTH_BUFFER_BIT);
 				glDepthMask(GL_TRUE);
 				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
@@ -152,6 +240,66 @@ namespace sibr {
 			return;
 		}
 
+		const uint numCams = (uint)cams->inputCameras().size();
+		// Let the cached and streamed resources make room, the previous array is released first.
+		_inputDepthMapArrayPtr.reset();
+		GPUMemoryBudget::global().reserve(MemoryTracker::textureBytes(_width, _height, numCams, 1, sizeof(float)));
+		_inputDepthMapArrayPtr.reset(new Texture2DArrayLum32F(_width, _height, numCams, flags));
+
+		// Layered path: each draw renders a batch of cameras, the geometry shader sends every triangle
+		// to the layers of the cameras whose frustum it intersects. The batch of layers of the array is
+		// attached through a texture view.
+		if (GLEW_ARB_texture_view) {
+			const uint batchSize = 32; // MAX_LAYERS in depthonly_layered.gp.
+			GLShader layeredShader;
+			layeredShader.init("DepthOnlyLayered",
+				loadFile(Resources::Instance()->getResourceFilePathName("depthonly_layered.vp")),
+				loadFile(Resources::Instance()->getResourceFilePathName("depthonly.fp")),
+				loadFile(Resources::Instance()->getResourceFilePathName("depthonly_layered.gp")));
+			GLParameter viewprojs, layerCount;
+			viewprojs.init(layeredShader, "viewprojs");
+			layerCount.init(layeredShader, "layerCount");
+
+			GLuint depthBuffer = 0, framebuffer = 0;
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &depthBuffer);
+			glTextureStorage3D(depthBuffer, 1, GL_DEPTH_COMPONENT32F, _width, _height, batchSize);
+			glCreateFramebuffers(1, &framebuffer);
+			glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthBuffer, 0);
+			glNamedFramebufferDrawBuffer(framebuffer, GL_COLOR_ATTACHMENT0);
+
+			std::vector<float> matrices(16 * batchSize);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glViewport(0, 0, _width, _height);
+			for (uint first = 0; first < numCams; first += batchSize) {
+				const uint count = std::min(batchSize, numCams - first);
+				GLuint layers = 0;
+				glGenTextures(1, &layers);
+				glTextureView(layers, GL_TEXTURE_2D_ARRAY, _inputDepthMapArrayPtr->handle(), GL_R32F, 0, 1, first, count);
+				glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, layers, 0);
+
+				GLState::enable(GL_DEPTH_TEST);
+				glDepthMask(GL_TRUE);
+				glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+				for (uint i = 0; i < count; ++i) {
+					std::memcpy(&matrices[16 * i], cams->inputCameras()[first + i]->viewproj().data(), 16 * sizeof(float));
+				}
+				layeredShader.begin();
+				viewprojs.setMatrixArray(matrices.data(), int(count));
+				layerCount.set(int(count));
+				proxies->proxy().render(true, facecull);
+				layeredShader.end();
+
+				glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, 0, 0);
+				glDeleteTextures(1, &layers);
+			}
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+			GLState::deleteFramebuffers(1, &framebuffer);
+			glDeleteTextures(1, &depthBuffer);
+			CHECK_GL_ERROR;
+			return;
+		}
+
 		SIBR_LOG << "Depth vertex shader location: " << Resources::Instance()->getResourceFilePathName("depthonly.vp") << std::endl;
 		SIBR_LOG << "Depth fragment shader location: " << Resources::Instance()->getResourceFilePathName("depthonly.fp") << std::endl;
 
@@ -167,15 +315,11 @@ namespace sibr {
 		GLParameter proj;
 		proj.init(depthOnlyShader, "proj");
 
-
-		const uint numCams = (uint)cams->inputCameras().size();
-		_inputDepthMapArrayPtr.reset(new Texture2DArrayLum32F(_width, _height, numCams, flags));
-
 		for (uint i = 0; i < numCams; i++) {
 			glViewport(0, 0, _width, _height);
 
 			depthRT.bind();
-			glEnable(GL_DEPTH_TEST);
+			GLState::enable(GL_DEPTH_TEST);
 			glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 			glDepthMask(GL_TRUE);
 
@@ -200,14 +344,53 @@ namespace sibr {
 		return _inputDepthMapArrayPtr;
 	}
 
-	void RGBInputTextureArray::initRGBTextureArrays(IInputImages::Ptr imgs, int flags, bool force_aspect_ratio)
+	void RGBInputTextureArray::initRGBTextureArrays(IInputImages::Ptr imgs, int flags, bool force_aspect_ratio, uint compression, const std::string & cachePath)
 	{
 		if (!isInit()) {
 			std::cerr << "RGBInputTextureArray::initRGBTextureArrays NEW FORCE ASPECT " << force_aspect_ratio << std::endl;
 			initSize(imgs->inputImages()[_initActiveCam]->w(), imgs->inputImages()[_initActiveCam]->h(), force_aspect_ratio);
 		}
 
-		_inputRGBArrayPtr.reset(new Texture2DArrayRGB(imgs->inputImages(), _width, _height, flags));
+		_inputRGBCompression = compression;
+		_inputRGBArrayPtr.reset();
+		GPUMemoryBudget::global().reserve(MemoryTracker::textureBytes(_width, _height, uint(imgs->inputImages().size()), compression != 0 || (flags & SIBR_GPU_AUTOGEN_MIPMAP) ? 0 : 1,
+			compression == 0 ? 4.0 : MemoryTracker::texelBytes(GLenum(compression))));
+		if (compression == 0) {
+			_inputRGBArrayPtr.reset(new Texture2DArrayRGB(imgs->inputImages(), _width, _height, flags));
+			return;
+		}
+
+		const uint numImages = uint(imgs->inputImages().size());
+		_inputRGBArrayPtr.reset(new Texture2DArrayRGB(numImages, flags));
+		if (!cachePath.empty() && _inputRGBArrayPtr->loadCompressed(cachePath, _width, _height, numImages, flags)) {
+			SIBR_LOG << "Loaded the compressed input images from " << cachePath << "." << std::endl;
+			return;
+		}
+
+		// Compressed formats can't generate their mipmaps, they are downscaled here and encoded by the driver.
+		uint levels = 1;
+		while ((std::min(_width, _height) >> levels) > 0) {
+			++levels;
+		}
+		std::vector<std::vector<ImageRGB>> mips(levels);
+		for (auto & level : mips) {
+			level.resize(numImages);
+		}
+		#pragma omp parallel for
+		for (int i = 0; i < int(numImages); ++i) {
+			mips[0][i] = imgs->inputImages()[i]->resized(_width, _height, cv::INTER_AREA);
+			for (uint l = 1; l < levels; ++l) {
+				mips[l][i] = mips[l - 1][i].resized(std::max(_width >> l, 1u), std::max(_height >> l, 1u), cv::INTER_AREA);
+			}
+		}
+		_inputRGBArrayPtr->createCompressedFromImages(mips, _width, _height, compression, flags);
+
+		if (!cachePath.empty()) {
+			makeDirectory(parentDirectory(cachePath));
+			if (_inputRGBArrayPtr->saveCompressed(cachePath)) {
+				SIBR_LOG << "Saved the compressed input images to " << cachePath << "." << std::endl;
+			}
+		}
 	}
 
 	const Texture2DArrayRGB::Ptr & RGBInputTextureArray::getInputRGBTextureArrayPtr() const
@@ -215,6 +398,48 @@ namespace sibr {
 		return _inputRGBArrayPtr;
 	}
 
+	bool RGBInputTextureArray::updateInputRGBLayer(uint i, const ImageRGB & image)
+	{
+		if (!_inputRGBArrayPtr || _inputRGBCompression != 0 || i >= _inputRGBArrayPtr->depth()) {
+			return false;
+		}
+		// Only the updated slice is read, the others can stay empty.
+		std::vector<ImageRGB::Ptr> images(_inputRGBArrayPtr->depth());
+		images[i].reset(new ImageRGB(image.resized(_inputRGBArrayPtr->w(), _inputRGBArrayPtr->h(), cv::INTER_AREA)));
+		_inputRGBArrayPtr->updateSlices(images, { int(i) });
+		return true;
+	}
+
+	void RGBInputTextureArray::initSparseRGBTextureArray(IInputImages::Ptr imgs, size_t budget, int flags, bool force_aspect_ratio)
+	{
+		// The size is still used by the other arrays, the sparse one keeps the full resolution.
+		if (!isInit()) {
+			initSize(imgs->inputImages()[_initActiveCam]->w(), imgs->inputImages()[_initActiveCam]->h(), force_aspect_ratio);
+		}
+
+		_inputRGBSparseArrayPtr.reset(new SparseTextureArray(imgs->inputImages(), budget, flags));
+	}
+
+	const SparseTextureArray::Ptr & RGBInputTextureArray::getInputRGBSparseArrayPtr() const
+	{
+		return _inputRGBSparseArrayPtr;
+	}
+
+	void RGBInputTextureArray::initBindlessRGBTextures(IInputImages::Ptr imgs, size_t budget, int flags, bool force_aspect_ratio)
+	{
+		// The size is still used by the other arrays, each bindless texture keeps the resolution of its image.
+		if (!isInit()) {
+			initSize(imgs->inputImages()[_initActiveCam]->w(), imgs->inputImages()[_initActiveCam]->h(), force_aspect_ratio);
+		}
+
+		_inputRGBBindlessPtr.reset(new BindlessTextureSet(imgs->inputImages(), budget, flags));
+	}
+
+	const BindlessTextureSet::Ptr & RGBInputTextureArray::getInputRGBBindlessPtr() const
+	{
+		return _inputRGBBindlessPtr;
+	}
+
 	void RenderTargetTextures::initializeDefaultRenderTargets(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies)
 	{
 		if (!isInit()) {
@@ -225,6 +450,93 @@ namespace sibr {
 		initializeDepthRenderTargets(cams, proxies, true);
 	}
 
+	void RenderTargetTextures::initStreamedRGBTextureArray(ICalibratedCameras::Ptr cams, InputImages::Ptr imgs, const IParseData::Ptr & data, int textureFlags, bool keepImages, bool force_aspect_ratio, uint pixelBuffers)
+	{
+		if (!isInit()) {
+			initRenderTargetRes(cams);
+			initSize(cams->inputCameras()[_initActiveCam]->w(), cams->inputCameras()[_initActiveCam]->h(), force_aspect_ratio);
+		}
+		using Format = GLTexFormat<ImageRGB, uchar, 3>;
+		const uint numImages = uint(data->imgInfos().size());
+		_inputRGBArrayPtr.reset(new Texture2DArrayRGB(_width, _height, numImages, textureFlags));
+
+		// Each layer is copied to the staging ring, the texture update from it doesn't block.
+		const size_t layerBytes = size_t(_width) * size_t(_height) * 3;
+		TextureUploader uploader(layerBytes * std::max(pixelBuffers, 1u));
+
+		const bool flip = (textureFlags & SIBR_FLIP_TEXTURE) != 0;
+		imgs->loadFromData(data, [&](uint i, const ImageRGB::Ptr & img) {
+			// The layer buffer is released once copied to the staging ring.
+			PooledImage<uchar, 3> layer;
+			const ImageRGB & src = prepareLayer(*img, _width, _height, flip, layer);
+			uploader.upload(_inputRGBArrayPtr->handle(), 0, int(i), _width, _height, Format::format, Format::type, src.data(), layerBytes);
+
+			if (!keepImages) {
+				*img = ImageRGB();
+			}
+		}, std::max(pixelBuffers, 1u) * 2, keepImages ? Vector2u(0, 0) : Vector2u(_width, _height));
+
+		uploader.finish();
+		if (textureFlags & SIBR_GPU_AUTOGEN_MIPMAP) {
+			glGenerateTextureMipmap(_inputRGBArrayPtr->handle());
+		}
+		CHECK_GL_ERROR;
+	}
+
+	void RenderTargetTextures::initStreamedRGBTextureArrayInBackground(ICalibratedCameras::Ptr cams, InputImages::Ptr imgs, const IParseData::Ptr & data, int textureFlags, bool keepImages, const std::atomic<bool> & cancel, bool force_aspect_ratio)
+	{
+		using Format = GLTexFormat<ImageRGB, uchar, 3>;
+		const uint numImages = uint(data->imgInfos().size());
+		MainThreadQueue & mainThread = MainThreadQueue::shared();
+		mainThread.submit([&]() {
+			if (!isInit()) {
+				initRenderTargetRes(cams);
+				initSize(cams->inputCameras()[_initActiveCam]->w(), cams->inputCameras()[_initActiveCam]->h(), force_aspect_ratio);
+			}
+			_inputRGBArrayPtr.reset(new Texture2DArrayRGB(_width, _height, numImages, textureFlags));
+		}).wait();
+		const uint w = _width;
+		const uint h = _height;
+		const GLuint handle = _inputRGBArrayPtr->handle();
+		const bool flip = (textureFlags & SIBR_FLIP_TEXTURE) != 0;
+
+		// Uploads waiting for the main thread, bounded so that slow frames do not pile up decoded layers.
+		const size_t maxPendingUploads = 8;
+		std::deque<std::future<void>> uploads;
+		imgs->loadFromData(data, [&](uint i, const ImageRGB::Ptr & img) {
+			if (cancel) {
+				return;
+			}
+			const std::shared_ptr<PooledImage<uchar, 3>> layer = std::make_shared<PooledImage<uchar, 3>>();
+			const uchar * pixels = prepareLayer(*img, w, h, flip, *layer).data();
+			const ImageRGB::Ptr source = img;
+			uploads.push_back(mainThread.submit([=]() {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				glTextureSubImage3D(handle, 0, 0, 0, int(i), w, h, 1, Format::format, Format::type, pixels);
+				// The pixels live in the layer or in the source image until uploaded.
+				layer->reset();
+				if (!keepImages) {
+					*source = ImageRGB();
+				}
+			}));
+			while (uploads.size() > maxPendingUploads) {
+				uploads.front().wait();
+				uploads.pop_front();
+			}
+		}, uint(maxPendingUploads), keepImages ? Vector2u(0, 0) : Vector2u(w, h));
+
+		for (std::future<void> & upload : uploads) {
+			upload.wait();
+		}
+		mainThread.submit([&]() {
+			if (textureFlags & SIBR_GPU_AUTOGEN_MIPMAP) {
+				glGenerateTextureMipmap(handle);
+			}
+			CHECK_GL_ERROR;
+		}).wait();
+	}
+
 	void RenderTargetTextures::initRenderTargetRes(ICalibratedCameras::Ptr cams)
 	{
 		// Find the first active camera and use it's reolution to init Rendertargets
@@ -250,12 +562,40 @@ namespace sibr {
 		initDepthTextureArrays(cams, proxies, faceCull);
 	}
 
-	void RenderTargetTextures::initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, bool faceCull, bool force_aspect_ratio)
+	void RenderTargetTextures::initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, bool faceCull, bool force_aspect_ratio, uint compression, const std::string & cachePath)
+	{
+		if (!isInit()) {
+			initRenderTargetRes(cams);
+		}
+		initRGBTextureArrays(imgs, textureFlags, force_aspect_ratio, compression, cachePath);
+		initDepthTextureArrays(cams, proxies, faceCull);
+	}
+
+	void RenderTargetTextures::initSparseRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, size_t budget, bool faceCull, bool force_aspect_ratio)
+	{
+		if (!isInit()) {
+			initRenderTargetRes(cams);
+		}
+		initSparseRGBTextureArray(imgs, budget, textureFlags, force_aspect_ratio);
+		initDepthTextureArrays(cams, proxies, faceCull);
+	}
+
+	void RenderTargetTextures::initBindlessRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, size_t budget, bool faceCull, bool force_aspect_ratio)
 	{
 		if (!isInit()) {
 			initRenderTargetRes(cams);
 		}
-		initRGBTextureArrays(imgs, textureFlags, force_aspect_ratio);
+		initBindlessRGBTextures(imgs, budget, textureFlags, force_aspect_ratio);
 		initDepthTextureArrays(cams, proxies, faceCull);
 	}
+
+	void RenderTargetTextures::setTextureArrays(const Texture2DArrayRGB::Ptr & rgbs, const Texture2DArrayLum32F::Ptr & depths)
+	{
+		_width = rgbs->w();
+		_height = rgbs->h();
+		_isInit = true;
+		_inputRGBArrayPtr = rgbs;
+		_inputRGBSparseArrayPtr.reset();
+		_inputDepthMapArrayPtr = depths;
+	}
 }
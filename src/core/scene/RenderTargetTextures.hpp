@@ -13,13 +13,17 @@
 #pragma once
 
 #include "core/graphics/Texture.hpp"
+#include "core/graphics/SparseTextureArray.hpp"
+#include "core/graphics/BindlessTextureSet.hpp"
 #include "core/scene/ICalibratedCameras.hpp"
 #include "core/scene/IInputImages.hpp"
+#include "core/scene/InputImages.hpp"
 #include "core/scene/IProxyMesh.hpp"
 #include "core/assets/Resources.hpp"
 # include "core/graphics/Shader.hpp"
 #include "core/graphics/Utils.hpp"
 #include "core/scene/Config.hpp"
+#include <atomic>
 
 
 # define SIBR_SCENE_LINEAR_SAMPLING			4
@@ -39,11 +43,38 @@ namespace sibr{
 
 		bool isInit() const;
 
+		/** Limit the texture size so that the input RGB and depth arrays fit in a memory budget,
+		 * the size given at construction (or the native one) is reduced by initSize when it doesn't fit.
+		\param bytes the budget, 0 to disable it
+		\param layers the number of input images
+		\param mipmaps whether the RGB array has mipmaps
+		*/
+		void setMemoryBudget(size_t bytes, uint layers, bool mipmaps = false);
+
+		/** Budget for the input textures, to call with a GL context.
+		\param fraction the fraction of the video memory currently available
+		\param fallbackBytes the available memory assumed when the driver doesn't report it
+		\return the budget in bytes
+		*/
+		static size_t videoMemoryBudget(float fraction, size_t fallbackBytes = size_t(2048) << 20);
+
+		/** Size of the input RGB and depth arrays. The RGB texels are counted as 4 bytes, most drivers pad them.
+		\param w the texture width
+		\param h the texture height
+		\param layers the number of input images
+		\param mipmaps whether the RGB array has mipmaps
+		\return the size in bytes
+		*/
+		static size_t arraysBytes(uint w, uint h, uint layers, bool mipmaps);
+
 	protected:
 		uint		_width = 0; //constrained width provided by the command line args, defaults to 0
 		uint		_height = 0; //associated height, computed in initSize
 		bool		_isInit = false;
 		int			_initActiveCam = 0;
+		size_t		_memoryBudget = 0; ///< Budget of the arrays, 0 if unconstrained.
+		uint		_budgetLayers = 0; ///< Number of layers counted in the budget.
+		bool		_budgetMipmaps = false; ///< Whether mipmaps are counted in the budget.
 
 	};
 
@@ -84,11 +115,48 @@ namespace sibr{
 		SIBR_CLASS_PTR(RGBInputTextureArray)
 
 	public:
-		virtual void initRGBTextureArrays(IInputImages::Ptr imgs, int flags = 0, bool force_aspect_ratio=false);
+		/** Create the array of the input images, resized to the texture size.
+		\param imgs the input images
+		\param flags options
+		\param force_aspect_ratio passed to initSize if the size is not initialized yet
+		\param compression an optional GL_COMPRESSED format (BC7, BC1...), the images are then encoded with their mipmaps by the driver
+		\param cachePath an optional file where the compressed array is saved, and reloaded without encoding if it matches the images
+		*/
+		virtual void initRGBTextureArrays(IInputImages::Ptr imgs, int flags = 0, bool force_aspect_ratio=false, uint compression = 0, const std::string & cachePath = "");
 		const Texture2DArrayRGB::Ptr & getInputRGBTextureArrayPtr() const;
 
+		/** Replace one input image in the array, only this layer is uploaded.
+		\param i the image index
+		\param image the new image, resized to the array size
+		\return false if the images are not in an uncompressed array
+		*/
+		bool updateInputRGBLayer(uint i, const ImageRGB & image);
+
+		/** Create a sparse array of the input images at full resolution, whose tiles are paged in on demand.
+		\param imgs the input images
+		\param budget the memory budget of the paged tiles, in bytes
+		\param flags options
+		\param force_aspect_ratio passed to initSize if the size is not initialized yet
+		*/
+		virtual void initSparseRGBTextureArray(IInputImages::Ptr imgs, size_t budget, int flags = 0, bool force_aspect_ratio = false);
+		/** \return the sparse array of the input images, if any. */
+		const SparseTextureArray::Ptr & getInputRGBSparseArrayPtr() const;
+
+		/** Create one bindless texture per input image at its native size, made resident on demand.
+		\param imgs the input images
+		\param budget the memory budget of the resident textures, in bytes
+		\param flags options
+		\param force_aspect_ratio passed to initSize if the size is not initialized yet
+		*/
+		virtual void initBindlessRGBTextures(IInputImages::Ptr imgs, size_t budget, int flags = 0, bool force_aspect_ratio = false);
+		/** \return the bindless textures of the input images, if any. */
+		const BindlessTextureSet::Ptr & getInputRGBBindlessPtr() const;
+
 	protected:
 		Texture2DArrayRGB::Ptr _inputRGBArrayPtr;
+		SparseTextureArray::Ptr _inputRGBSparseArrayPtr;
+		BindlessTextureSet::Ptr _inputRGBBindlessPtr;
+		uint _inputRGBCompression = 0; ///< Compressed format of the array, 0 if uncompressed.
 
 	};
 
@@ -109,9 +177,45 @@ namespace sibr{
 		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, unsigned int w, unsigned int h, bool faceCull = true);
 		// TODO: remove this, not needed
 		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, int texture_width, bool faceCull = true, bool force_aspect_ratio = false);
-		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, bool faceCull = true, bool force_aspect_ratio=false);
+		virtual void initRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, bool faceCull = true, bool force_aspect_ratio=false, uint compression = 0, const std::string & cachePath = "");
+		/// Same as above, with a sparse RGB array under a memory budget (in bytes) instead of a resized one.
+		virtual void initSparseRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, size_t budget, bool faceCull = true, bool force_aspect_ratio = false);
+		/// Same as above, with bindless RGB textures at native size under a memory budget (in bytes) instead of a resized array.
+		virtual void initBindlessRGBandDepthTextureArrays(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies, int textureFlags, size_t budget, bool faceCull = true, bool force_aspect_ratio = false);
 		virtual void initializeDefaultRenderTargets(ICalibratedCameras::Ptr cams, IInputImages::Ptr imgs, IProxyMesh::Ptr proxies);
 
+		/** Decode the input images straight into the RGB array: worker threads decode the images while this thread
+		uploads each finished one to its layer through a staging ring (see TextureUploader). The size comes from the cameras, so
+		the array exists before the first image is decoded.
+		\param cams the calibrated cameras
+		\param imgs the images to load
+		\param data the dataset description
+		\param textureFlags options
+		\param keepImages keep the CPU copies at full size, otherwise JPEG images are decoded downscaled when the array is smaller and each image is left empty as soon as it is uploaded
+		\param force_aspect_ratio passed to initSize if the size is not initialized yet
+		\param pixelBuffers number of layers the staging ring can hold in flight
+		*/
+		virtual void initStreamedRGBTextureArray(ICalibratedCameras::Ptr cams, InputImages::Ptr imgs, const IParseData::Ptr & data, int textureFlags, bool keepImages = false, bool force_aspect_ratio = false, uint pixelBuffers = 4);
+
+		/** Same as initStreamedRGBTextureArray, to call from a background thread: the array creation and the layer uploads
+		are posted to the MainThreadQueue, so the layers appear while the main thread keeps rendering. Returns once all layers are uploaded.
+		\param cams the calibrated cameras
+		\param imgs the images to load, should not be accessed by other threads until this returns
+		\param data the dataset description
+		\param textureFlags options
+		\param keepImages see initStreamedRGBTextureArray
+		\param cancel when set, the remaining decoded images are not uploaded anymore
+		\param force_aspect_ratio passed to initSize if the size is not initialized yet
+		\note The main thread should keep running the MainThreadQueue (sibr::Window does it each frame) and not wait for this call.
+		*/
+		virtual void initStreamedRGBTextureArrayInBackground(ICalibratedCameras::Ptr cams, InputImages::Ptr imgs, const IParseData::Ptr & data, int textureFlags, bool keepImages, const std::atomic<bool> & cancel, bool force_aspect_ratio = false);
+
+		/** Use arrays created elsewhere (from a scene bundle for instance) instead of generating them.
+		\param rgbs the RGB array, its size becomes the texture size
+		\param depths the depth array, of the same size
+		*/
+		virtual void setTextureArrays(const Texture2DArrayRGB::Ptr & rgbs, const Texture2DArrayLum32F::Ptr & depths);
+
 	protected:
 		void initRenderTargetRes(ICalibratedCameras::Ptr cams);
 
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/SceneBundle.hpp"
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+
+namespace sibr {
+
+	namespace {
+
+		const char kMagic[8] = { 'S', 'I', 'B', 'R', 'S', 'C', 'N', '\0' };
+
+		// Sections are aligned in the file so that they can be used in place.
+		const uint64_t kAlignment = 64;
+
+		const int kMaxLevels = 16;
+
+		/// Raw buffers stored in the bundle, in file order.
+		enum Section { CAMERAS = 0, BASE_PATH, SOURCE_PATH, VERTICES, NORMALS, COLORS, UVS, TRIANGLES, SECTION_COUNT };
+
+		struct CameraRecord
+		{
+			int32_t id;
+			int32_t w, h;
+			int32_t active;
+			float focal, focalx, k1, k2;
+			float position[3];
+			float rotation[4]; // w, x, y, z
+			float fovy, aspect, znear, zfar;
+			float principalPoint[2];
+			char name[256];
+		};
+
+		struct ArrayRecord
+		{
+			uint32_t format;
+			uint32_t w, h, depth;
+			uint32_t levels;
+			uint64_t offsets[kMaxLevels];
+			uint64_t sizes[kMaxLevels];
+		};
+
+		struct BundleHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t cameraCount;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			uint64_t offsets[SECTION_COUNT];
+			uint64_t sizes[SECTION_COUNT];
+			ArrayRecord arrays[2]; // RGB, depths
+		};
+
+		uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + kAlignment - 1) / kAlignment * kAlignment;
+		}
+
+		bool sourceStamp(const std::string & path, uint64_t & size, int64_t & time)
+		{
+			boost::system::error_code ec;
+			if (path.empty() || !boost::filesystem::exists(path, ec)) {
+				return false;
+			}
+			size = uint64_t(boost::filesystem::file_size(path, ec));
+			if (ec) {
+				return false;
+			}
+			time = int64_t(boost::filesystem::last_write_time(path, ec));
+			return !ec;
+		}
+
+		const BundleHeader & header(const MappedFile & file)
+		{
+			return *reinterpret_cast<const BundleHeader*>(file.data());
+		}
+
+		template<typename Element>
+		std::vector<Element> readSection(const MappedFile & file, int section)
+		{
+			const Element * begin = reinterpret_cast<const Element*>(file.data() + header(file).offsets[section]);
+			return std::vector<Element>(begin, begin + header(file).sizes[section] / sizeof(Element));
+		}
+	}
+
+	bool SceneBundle::write(const std::string & path, const std::vector<InputCamera::Ptr> & cams, const Mesh & mesh,
+		const Texture2DArrayRGB & rgbs, const Texture2DArrayLum32F & depths,
+		const std::string & basePath, const std::string & sourcePath)
+	{
+		BundleHeader header;
+		std::memset(&header, 0, sizeof(BundleHeader));
+		std::memcpy(header.magic, kMagic, sizeof(kMagic));
+		header.version = version;
+		header.cameraCount = uint32_t(cams.size());
+		// A bundle whose source is unknown is never considered outdated.
+		if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+			header.sourceSize = 0;
+			header.sourceTime = 0;
+		}
+
+		std::vector<CameraRecord> records(cams.size());
+		std::memset(records.data(), 0, records.size() * sizeof(CameraRecord));
+		for (size_t cid = 0; cid < cams.size(); ++cid) {
+			const InputCamera & cam = *cams[cid];
+			CameraRecord & record = records[cid];
+			record.id = int32_t(cam.id());
+			record.w = int32_t(cam.w());
+			record.h = int32_t(cam.h());
+			record.active = cam.isActive() ? 1 : 0;
+			record.focal = cam.focal();
+			record.focalx = cam.focalx();
+			record.k1 = cam.k1();
+			record.k2 = cam.k2();
+			for (int c = 0; c < 3; ++c) {
+				record.position[c] = cam.position()[c];
+			}
+			const Quaternionf & q = cam.rotation();
+			record.rotation[0] = q.w();
+			record.rotation[1] = q.x();
+			record.rotation[2] = q.y();
+			record.rotation[3] = q.z();
+			record.fovy = cam.fovy();
+			record.aspect = cam.aspect();
+			record.znear = cam.znear();
+			record.zfar = cam.zfar();
+			record.principalPoint[0] = cam.principalPoint()[0];
+			record.principalPoint[1] = cam.principalPoint()[1];
+			std::strncpy(record.name, cam.name().c_str(), sizeof(record.name) - 1);
+		}
+
+		// Every buffer of the file, sections first then the array levels.
+		std::vector<std::pair<const char*, uint64_t>> blobs(SECTION_COUNT);
+		blobs[CAMERAS] = { reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CameraRecord) };
+		blobs[BASE_PATH] = { basePath.data(), basePath.size() };
+		blobs[SOURCE_PATH] = { sourcePath.data(), sourcePath.size() };
+		blobs[VERTICES] = { reinterpret_cast<const char*>(mesh.vertices().data()), mesh.vertices().size() * sizeof(Vector3f) };
+		blobs[NORMALS] = { reinterpret_cast<const char*>(mesh.normals().data()), mesh.normals().size() * sizeof(Vector3f) };
+		blobs[COLORS] = { reinterpret_cast<const char*>(mesh.colors().data()), mesh.colors().size() * sizeof(Vector3f) };
+		blobs[UVS] = { reinterpret_cast<const char*>(mesh.texCoords().data()), mesh.texCoords().size() * sizeof(Vector2f) };
+		blobs[TRIANGLES] = { reinterpret_cast<const char*>(mesh.triangles().data()), mesh.triangles().size() * sizeof(Vector3u) };
+
+		// The arrays are read back as they are stored on the GPU.
+		std::vector<std::vector<char>> levels[2];
+		header.arrays[0].format = rgbs.readLevels(levels[0]);
+		header.arrays[0].w = rgbs.w();
+		header.arrays[0].h = rgbs.h();
+		header.arrays[0].depth = rgbs.depth();
+		header.arrays[1].format = depths.readLevels(levels[1]);
+		header.arrays[1].w = depths.w();
+		header.arrays[1].h = depths.h();
+		header.arrays[1].depth = depths.depth();
+		for (int a = 0; a < 2; ++a) {
+			if (levels[a].size() > size_t(kMaxLevels)) {
+				levels[a].resize(kMaxLevels);
+			}
+			header.arrays[a].levels = uint32_t(levels[a].size());
+			for (const auto & level : levels[a]) {
+				blobs.emplace_back(level.data(), level.size());
+			}
+		}
+
+		std::vector<uint64_t> offsets(blobs.size());
+		uint64_t offset = alignOffset(sizeof(BundleHeader));
+		for (size_t b = 0; b < blobs.size(); ++b) {
+			offsets[b] = offset;
+			offset = alignOffset(offset + blobs[b].second);
+		}
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			header.offsets[s] = offsets[s];
+			header.sizes[s] = blobs[s].second;
+		}
+		size_t blob = SECTION_COUNT;
+		for (int a = 0; a < 2; ++a) {
+			for (uint32_t lid = 0; lid < header.arrays[a].levels; ++lid, ++blob) {
+				header.arrays[a].offsets[lid] = offsets[blob];
+				header.arrays[a].sizes[lid] = blobs[blob].second;
+			}
+		}
+
+		// Write to a temporary file first, so that an interrupted write never leaves a valid-looking bundle.
+		const std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream outfile(tmpPath, std::ios_base::binary);
+			if (!outfile.good()) {
+				SIBR_WRG << "Unable to write scene bundle " << path << std::endl;
+				return false;
+			}
+			const char padding[kAlignment] = { 0 };
+			outfile.write(reinterpret_cast<const char*>(&header), sizeof(BundleHeader));
+			uint64_t written = sizeof(BundleHeader);
+			for (size_t b = 0; b < blobs.size(); ++b) {
+				outfile.write(padding, std::streamsize(offsets[b] - written));
+				outfile.write(blobs[b].first, std::streamsize(blobs[b].second));
+				written = offsets[b] + blobs[b].second;
+			}
+			if (!outfile.good()) {
+				SIBR_WRG << "Unable to write scene bundle " << path << std::endl;
+				return false;
+			}
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmpPath, path, ec);
+		if (ec) {
+			SIBR_WRG << "Unable to write scene bundle " << path << ": " << ec.message() << std::endl;
+			boost::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+		SIBR_LOG << "Wrote scene bundle " << path << " (" << (offset >> 20) << " MB)" << std::endl;
+		return true;
+	}
+
+	bool SceneBundle::open(const std::string & path)
+	{
+		_file.close();
+		if (!_file.open(path)) {
+			return false;
+		}
+		if (_file.size() < sizeof(BundleHeader)) {
+			SIBR_WRG << "Ignoring invalid scene bundle " << path << std::endl;
+			_file.close();
+			return false;
+		}
+		const BundleHeader & bundle = header(_file);
+		if (std::memcmp(bundle.magic, kMagic, sizeof(kMagic)) != 0 || bundle.version != version) {
+			SIBR_LOG << "Scene bundle " << path << " has an unsupported version, it has to be baked again." << std::endl;
+			_file.close();
+			return false;
+		}
+
+		// Check that every buffer lies in the file.
+		bool valid = bundle.sizes[CAMERAS] == uint64_t(bundle.cameraCount) * sizeof(CameraRecord);
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			valid = valid && bundle.offsets[s] + bundle.sizes[s] <= _file.size();
+		}
+		for (int a = 0; a < 2; ++a) {
+			valid = valid && bundle.arrays[a].levels > 0 && bundle.arrays[a].levels <= uint32_t(kMaxLevels)
+				&& bundle.arrays[a].depth == bundle.cameraCount;
+			for (uint32_t lid = 0; valid && lid < bundle.arrays[a].levels; ++lid) {
+				valid = bundle.arrays[a].offsets[lid] + bundle.arrays[a].sizes[lid] <= _file.size();
+			}
+		}
+		if (!valid) {
+			SIBR_WRG << "Ignoring truncated scene bundle " << path << std::endl;
+			_file.close();
+			return false;
+		}
+
+		// The proxy file may be gone (bundle copied alone), only a modified one invalidates the bundle.
+		const std::vector<char> sourcePath = readSection<char>(_file, SOURCE_PATH);
+		uint64_t sourceSize = 0;
+		int64_t sourceTime = 0;
+		if (bundle.sourceSize != 0 && sourceStamp(std::string(sourcePath.begin(), sourcePath.end()), sourceSize, sourceTime)
+			&& (sourceSize != bundle.sourceSize || sourceTime != bundle.sourceTime)) {
+			SIBR_LOG << "Scene bundle " << path << " is outdated, it has to be baked again." << std::endl;
+			_file.close();
+			return false;
+		}
+		const std::vector<char> basePath = readSection<char>(_file, BASE_PATH);
+		_basePath = std::string(basePath.begin(), basePath.end());
+
+		_file.prefetch();
+		return true;
+	}
+
+	std::vector<InputCamera::Ptr> SceneBundle::cameras(void) const
+	{
+		const BundleHeader & bundle = header(_file);
+		const CameraRecord * records = reinterpret_cast<const CameraRecord*>(_file.data() + bundle.offsets[CAMERAS]);
+		std::vector<InputCamera::Ptr> cams(bundle.cameraCount);
+		for (uint32_t cid = 0; cid < bundle.cameraCount; ++cid) {
+			const CameraRecord & record = records[cid];
+			cams[cid].reset(new InputCamera(record.focal, record.focalx, record.k1, record.k2, record.w, record.h, record.id));
+			cams[cid]->position(Vector3f(record.position[0], record.position[1], record.position[2]));
+			cams[cid]->rotation(Quaternionf(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]));
+			cams[cid]->fovy(record.fovy);
+			cams[cid]->aspect(record.aspect);
+			cams[cid]->znear(record.znear);
+			cams[cid]->zfar(record.zfar);
+			cams[cid]->principalPoint(Vector2f(record.principalPoint[0], record.principalPoint[1]));
+			cams[cid]->name(std::string(record.name, strnlen(record.name, sizeof(record.name))));
+			cams[cid]->setActive(record.active != 0);
+		}
+		return cams;
+	}
+
+	Mesh::Ptr SceneBundle::mesh(void) const
+	{
+		const BundleHeader & bundle = header(_file);
+		Mesh::Ptr mesh(new Mesh());
+		mesh->vertices(readSection<Vector3f>(_file, VERTICES));
+		mesh->triangles(readSection<Vector3u>(_file, TRIANGLES));
+		if (bundle.sizes[NORMALS] != 0) {
+			mesh->normals(readSection<Vector3f>(_file, NORMALS));
+		}
+		if (bundle.sizes[COLORS] != 0) {
+			mesh->colors(readSection<Vector3f>(_file, COLORS));
+		}
+		if (bundle.sizes[UVS] != 0) {
+			mesh->texCoords(readSection<Vector2f>(_file, UVS));
+		}
+		return mesh;
+	}
+
+	template<typename TextureType>
+	void SceneBundle::createArray(int array, TextureType & texture, uint flags) const
+	{
+		const ArrayRecord & record = header(_file).arrays[array];
+		std::vector<std::pair<const char*, size_t>> levels(record.levels);
+		for (uint32_t lid = 0; lid < record.levels; ++lid) {
+			levels[lid] = { _file.data() + record.offsets[lid], size_t(record.sizes[lid]) };
+		}
+		texture.createFromLevels(record.w, record.h, record.depth, record.format, levels, flags);
+	}
+
+	Texture2DArrayRGB::Ptr SceneBundle::createRGBArray(uint flags) const
+	{
+		Texture2DArrayRGB::Ptr texture(new Texture2DArrayRGB());
+		createArray(0, *texture, flags);
+		return texture;
+	}
+
+	Texture2DArrayLum32F::Ptr SceneBundle::createDepthArray(uint flags) const
+	{
+		Texture2DArrayLum32F::Ptr texture(new Texture2DArrayLum32F());
+		createArray(1, *texture, flags);
+		return texture;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/assets/InputCamera.hpp"
+#include "core/graphics/Mesh.hpp"
+#include "core/graphics/Texture.hpp"
+#include "core/system/MappedFile.hpp"
+
+namespace sibr {
+
+	/**
+	 * Baked scene in a single file, mapped in memory at load time: the input cameras, the proxy
+	 * as raw vertex and index buffers, and the RGB and depth texture arrays exactly as they are
+	 * stored on the GPU (resized, flipped, with their mip levels, compressed or not). Loading
+	 * a bundle skips image decoding, resizing, mesh parsing and depth rendering altogether.
+	 *
+	 * A bundle is tied to the proxy file it has been baked from, when that file is still
+	 * around its size and last write time must match the ones recorded at bake time.
+	 * \ingroup sibr_scene
+	 */
+	class SIBR_SCENE_EXPORT SceneBundle
+	{
+		SIBR_CLASS_PTR(SceneBundle);
+		SIBR_DISALLOW_COPY(SceneBundle);
+
+	public:
+
+		/// Increment when the layout of the file changes.
+		static const uint32_t version = 1;
+
+		/// Constructor.
+		SceneBundle(void) = default;
+
+		/** Write a bundle file.
+		\param path the bundle file to create
+		\param cams the input cameras
+		\param mesh the proxy
+		\param rgbs the RGB array of the input images
+		\param depths the depth array of the input cameras
+		\param basePath the dataset directory, kept for the components loaded on the side (masks...)
+		\param sourcePath the proxy file the bundle depends on, can be empty
+		\return true if the file was written
+		*/
+		static bool write(const std::string & path, const std::vector<InputCamera::Ptr> & cams, const Mesh & mesh,
+			const Texture2DArrayRGB & rgbs, const Texture2DArrayLum32F & depths,
+			const std::string & basePath, const std::string & sourcePath);
+
+		/** Open and validate a bundle file.
+		\param path the bundle file
+		\return false if the bundle doesn't exist, is outdated or invalid
+		*/
+		bool open(const std::string & path);
+
+		/** \return the cameras stored in the bundle. */
+		std::vector<InputCamera::Ptr> cameras(void) const;
+
+		/** \return a new mesh holding the proxy stored in the bundle. */
+		Mesh::Ptr mesh(void) const;
+
+		/** Create the RGB array from the mapped data.
+		\param flags options, only the sampling ones are used, the data is already flipped
+		\return the texture array
+		*/
+		Texture2DArrayRGB::Ptr createRGBArray(uint flags) const;
+
+		/** Create the depth array from the mapped data.
+		\param flags options, only the sampling ones are used
+		\return the texture array
+		*/
+		Texture2DArrayLum32F::Ptr createDepthArray(uint flags) const;
+
+		/** \return the dataset directory recorded at bake time. */
+		const std::string & basePath(void) const { return _basePath; }
+
+	private:
+
+		/** Fill a texture array from one of the mapped array sections.
+		\param array the index of the array (0 for RGB, 1 for depths)
+		\param texture the texture to fill
+		\param flags options
+		*/
+		template<typename TextureType>
+		void createArray(int array, TextureType & texture, uint flags) const;
+
+		MappedFile _file; ///< The mapped bundle.
+		std::string _basePath; ///< Dataset directory.
+	};
+
+} /*namespace sibr*/
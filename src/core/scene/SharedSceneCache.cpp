@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/SharedSceneCache.hpp"
+#include "core/system/MappedFile.hpp"
+#include "core/system/Utils.hpp"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace sibr {
+
+	namespace {
+
+		const char kImagesMagic[8] = { 'S', 'I', 'B', 'R', 'S', 'I', 'M', 'G' };
+		const char kMeshMagic[8] = { 'S', 'I', 'B', 'R', 'S', 'M', 'S', 'H' };
+
+		// Buffers are aligned in the files so that they can be used in place.
+		const uint64_t kAlignment = 64;
+
+		struct ImagesHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t count;
+			uint64_t key;
+		};
+
+		/// Buffers stored in a mesh entry, in file order.
+		enum MeshSection { VERTICES = 0, NORMALS, COLORS, UVS, TRIANGLES, TEXTURE_NAME, SECTION_COUNT };
+
+		struct MeshHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t padding;
+			uint64_t key;
+			uint64_t offsets[SECTION_COUNT];
+			uint64_t sizes[SECTION_COUNT];
+		};
+
+		template<typename Element>
+		std::vector<Element> readSection(const MappedFile & file, const MeshHeader & header, int section)
+		{
+			const Element * begin = reinterpret_cast<const Element*>(file.data() + header.offsets[section]);
+			return std::vector<Element>(begin, begin + header.sizes[section] / sizeof(Element));
+		}
+
+		uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + kAlignment - 1) / kAlignment * kAlignment;
+		}
+
+		/// FNV-1a, good enough to tell datasets apart.
+		struct Hasher
+		{
+			uint64_t value = 0xcbf29ce484222325ull;
+
+			void add(const void * data, size_t size)
+			{
+				const unsigned char * bytes = static_cast<const unsigned char*>(data);
+				for (size_t b = 0; b < size; ++b) {
+					value = (value ^ bytes[b]) * 0x100000001b3ull;
+				}
+			}
+
+			template<typename T>
+			void add(const T & pod) { add(&pod, sizeof(T)); }
+
+			void add(const std::string & str) { add(str.data(), str.size()); add(uint64_t(str.size())); }
+
+			/** Add the size and modification time of a file.
+			\return false if the file doesn't exist
+			*/
+			bool addStamp(const std::string & path)
+			{
+				boost::system::error_code ec;
+				const uint64_t size = uint64_t(boost::filesystem::file_size(path, ec));
+				if (ec) {
+					return false;
+				}
+				const int64_t time = int64_t(boost::filesystem::last_write_time(path, ec));
+				add(size);
+				add(time);
+				return !ec;
+			}
+		};
+
+		std::string absolutePath(const std::string & path)
+		{
+			boost::system::error_code ec;
+			const boost::filesystem::path canonical = boost::filesystem::canonical(path, ec);
+			return ec ? boost::filesystem::absolute(path).string() : canonical.string();
+		}
+
+		/// Mark an entry as recently used, the oldest ones are removed first.
+		void touch(const std::string & path)
+		{
+			boost::system::error_code ec;
+			boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+		}
+
+		/** Move a complete temporary file to its entry path, other processes never see partial entries. */
+		bool publish(const std::string & tmpPath, const std::string & path)
+		{
+			boost::system::error_code ec;
+			boost::filesystem::rename(tmpPath, path, ec);
+			if (ec) {
+				boost::filesystem::remove(tmpPath, ec);
+				return false;
+			}
+			return true;
+		}
+
+		bool writePadding(std::ofstream & file, uint64_t & offset)
+		{
+			const char padding[kAlignment] = { 0 };
+			const uint64_t aligned = alignOffset(offset);
+			file.write(padding, std::streamsize(aligned - offset));
+			offset = aligned;
+			return file.good();
+		}
+	}
+
+	std::atomic<size_t> SharedSceneCache::_maxBytes(size_t(8) << 30);
+
+	std::string SharedSceneCache::directory(void)
+	{
+		const char * custom = std::getenv("SIBR_SHARED_CACHE");
+		if (custom && custom[0] != '\0') {
+			return custom;
+		}
+		boost::system::error_code ec;
+		// Files in /dev/shm are only held in memory.
+		if (boost::filesystem::is_directory("/dev/shm", ec)) {
+			return "/dev/shm/sibr_scene_cache";
+		}
+		return (boost::filesystem::temp_directory_path(ec) / "sibr_scene_cache").string();
+	}
+
+	size_t SharedSceneCache::maxBytes(void)
+	{
+		return _maxBytes;
+	}
+
+	void SharedSceneCache::setMaxBytes(size_t bytes)
+	{
+		_maxBytes = bytes;
+	}
+
+	std::string SharedSceneCache::entryPath(uint64_t key, const std::string & extension)
+	{
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+		return directory() + "/" + name + extension;
+	}
+
+	uint64_t SharedSceneCache::imagesKey(const IParseData & data, const Vector2u & minSize)
+	{
+		Hasher hasher;
+		hasher.add(std::string("images"));
+		hasher.add(uint32_t(version));
+		hasher.add(absolutePath(data.imgPath()));
+		hasher.add(minSize.x());
+		hasher.add(minSize.y());
+		const std::vector<ImageListFile::Infos> & infos = data.imgInfos();
+		for (size_t i = 0; i < infos.size(); ++i) {
+			const bool active = data.activeImages()[i];
+			hasher.add(infos[i].filename);
+			hasher.add(active);
+			if (active) {
+				hasher.addStamp(data.imgPath() + "/" + infos[i].filename);
+			}
+		}
+		return hasher.value;
+	}
+
+	uint64_t SharedSceneCache::meshKey(const std::string & meshPath)
+	{
+		Hasher hasher;
+		hasher.add(std::string("mesh"));
+		hasher.add(uint32_t(version));
+		hasher.add(absolutePath(meshPath));
+		return hasher.addStamp(meshPath) ? hasher.value : 0;
+	}
+
+	bool SharedSceneCache::attachImages(const IParseData & data, const Vector2u & minSize, std::vector<ImageRGB::Ptr> & images)
+	{
+		const uint64_t key = imagesKey(data, minSize);
+		const std::string path = entryPath(key, ".simg");
+		if (!sibr::fileExists(path)) {
+			return false;
+		}
+		// Copy-on-write: a process modifying an image gets its own copy of the pages.
+		const std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+		if (!file->open(path, true) || file->size() < sizeof(ImagesHeader)) {
+			return false;
+		}
+		const size_t count = data.imgInfos().size();
+		const ImagesHeader & header = *reinterpret_cast<const ImagesHeader*>(file->data());
+		if (std::memcmp(header.magic, kImagesMagic, sizeof(kImagesMagic)) != 0 || header.version != version
+			|| header.key != key || header.count != count || file->size() < sizeof(ImagesHeader) + count * sizeof(ImageRecord)) {
+			return false;
+		}
+		const ImageRecord * records = reinterpret_cast<const ImageRecord*>(file->data() + sizeof(ImagesHeader));
+		for (size_t i = 0; i < count; ++i) {
+			if (records[i].offset == 0 || records[i].offset + uint64_t(records[i].w) * records[i].h * 3 > file->size()) {
+				SIBR_WRG << "Ignoring truncated shared cache entry " << path << std::endl;
+				return false;
+			}
+		}
+
+		images.resize(count);
+		char * pixels = file->writableData();
+		for (size_t i = 0; i < count; ++i) {
+			// Each image keeps the mapping alive.
+			images[i] = ImageRGB::Ptr(new ImageRGB(), [file](ImageRGB * image) { delete image; });
+			images[i]->toOpenCVnonConst() = cv::Mat(int(records[i].h), int(records[i].w), CV_8UC3, pixels + records[i].offset);
+		}
+		touch(path);
+		SIBR_LOG << "Mapped " << count << " images from the shared cache " << path << std::endl;
+		return true;
+	}
+
+	SharedSceneCache::ImageWriter::ImageWriter(const IParseData & data, const Vector2u & minSize) :
+		_key(imagesKey(data, minSize)), _records(data.imgInfos().size(), ImageRecord{ 0, 0, 0 })
+	{
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(directory(), ec);
+		_path = entryPath(_key, ".simg");
+		_tmpPath = _path + "." + boost::filesystem::unique_path("%%%%%%%%").string() + ".tmp";
+		_file.open(_tmpPath, std::ios_base::binary);
+		if (!_file.is_open()) {
+			return;
+		}
+		// The header and the records are written once complete.
+		const ImagesHeader header = {};
+		_file.write(reinterpret_cast<const char*>(&header), sizeof(ImagesHeader));
+		_file.write(reinterpret_cast<const char*>(_records.data()), std::streamsize(_records.size() * sizeof(ImageRecord)));
+		_offset = sizeof(ImagesHeader) + _records.size() * sizeof(ImageRecord);
+		if (!writePadding(_file, _offset)) {
+			_file.close();
+		}
+	}
+
+	SharedSceneCache::ImageWriter::~ImageWriter(void)
+	{
+		if (_file.is_open()) {
+			_file.close();
+			boost::system::error_code ec;
+			boost::filesystem::remove(_tmpPath, ec);
+		}
+	}
+
+	void SharedSceneCache::ImageWriter::add(uint i, const ImageRGB & image)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_file.is_open() || i >= _records.size() || _records[i].offset != 0 || image.w() == 0 || image.h() == 0) {
+			return;
+		}
+		const cv::Mat & pixels = image.toOpenCV();
+		const size_t rowBytes = size_t(image.w()) * 3;
+		for (int y = 0; y < pixels.rows; ++y) {
+			_file.write(reinterpret_cast<const char*>(pixels.ptr(y)), std::streamsize(rowBytes));
+		}
+		_records[i] = { image.w(), image.h(), _offset };
+		_offset += rowBytes * image.h();
+		if (!writePadding(_file, _offset)) {
+			// Out of space, the entry is dropped.
+			_file.close();
+			boost::system::error_code ec;
+			boost::filesystem::remove(_tmpPath, ec);
+			return;
+		}
+		++_added;
+	}
+
+	bool SharedSceneCache::ImageWriter::finish(void)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_file.is_open() || _added != _records.size()) {
+			return false;
+		}
+		ImagesHeader header;
+		std::memcpy(header.magic, kImagesMagic, sizeof(kImagesMagic));
+		header.version = version;
+		header.count = uint32_t(_records.size());
+		header.key = _key;
+		_file.seekp(0);
+		_file.write(reinterpret_cast<const char*>(&header), sizeof(ImagesHeader));
+		_file.write(reinterpret_cast<const char*>(_records.data()), std::streamsize(_records.size() * sizeof(ImageRecord)));
+		const bool written = _file.good();
+		_file.close();
+		if (!written || !publish(_tmpPath, _path)) {
+			boost::system::error_code ec;
+			boost::filesystem::remove(_tmpPath, ec);
+			return false;
+		}
+		SIBR_LOG << "Added " << _records.size() << " images to the shared cache " << _path << " (" << (_offset >> 20) << " MB)" << std::endl;
+		trim(maxBytes());
+		return true;
+	}
+
+	Mesh::Ptr SharedSceneCache::attachMesh(const std::string & meshPath)
+	{
+		const uint64_t key = meshKey(meshPath);
+		const std::string path = entryPath(key, ".smsh");
+		if (key == 0 || !sibr::fileExists(path)) {
+			return nullptr;
+		}
+		MappedFile file;
+		if (!file.open(path) || file.size() < sizeof(MeshHeader)) {
+			return nullptr;
+		}
+		const MeshHeader & header = *reinterpret_cast<const MeshHeader*>(file.data());
+		bool valid = std::memcmp(header.magic, kMeshMagic, sizeof(kMeshMagic)) == 0 && header.version == version && header.key == key;
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			valid = valid && header.offsets[s] + header.sizes[s] <= file.size();
+		}
+		if (!valid) {
+			return nullptr;
+		}
+		Mesh::Ptr mesh(new Mesh());
+		mesh->vertices(readSection<Vector3f>(file, header, VERTICES));
+		mesh->triangles(readSection<Vector3u>(file, header, TRIANGLES));
+		if (header.sizes[NORMALS] != 0) {
+			mesh->normals(readSection<Vector3f>(file, header, NORMALS));
+		}
+		if (header.sizes[COLORS] != 0) {
+			mesh->colors(readSection<Vector3f>(file, header, COLORS));
+		}
+		if (header.sizes[UVS] != 0) {
+			mesh->texCoords(readSection<Vector2f>(file, header, UVS));
+		}
+		const std::vector<char> textureName = readSection<char>(file, header, TEXTURE_NAME);
+		mesh->setTextureImageFileName(std::string(textureName.begin(), textureName.end()));
+		touch(path);
+		SIBR_LOG << "Loaded the proxy from the shared cache " << path << std::endl;
+		return mesh;
+	}
+
+	bool SharedSceneCache::storeMesh(const std::string & meshPath, const Mesh & mesh)
+	{
+		const uint64_t key = meshKey(meshPath);
+		if (key == 0 || mesh.vertices().empty()) {
+			return false;
+		}
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(directory(), ec);
+		const std::string path = entryPath(key, ".smsh");
+		const std::string tmpPath = path + "." + boost::filesystem::unique_path("%%%%%%%%").string() + ".tmp";
+
+		const std::string textureName = mesh.getTextureImageFileName();
+		const std::pair<const char*, size_t> blobs[SECTION_COUNT] = {
+			{ reinterpret_cast<const char*>(mesh.vertices().data()), mesh.vertices().size() * sizeof(Vector3f) },
+			{ reinterpret_cast<const char*>(mesh.normals().data()), mesh.normals().size() * sizeof(Vector3f) },
+			{ reinterpret_cast<const char*>(mesh.colors().data()), mesh.colors().size() * sizeof(Vector3f) },
+			{ reinterpret_cast<const char*>(mesh.texCoords().data()), mesh.texCoords().size() * sizeof(Vector2f) },
+			{ reinterpret_cast<const char*>(mesh.triangles().data()), mesh.triangles().size() * sizeof(Vector3u) },
+			{ textureName.data(), textureName.size() }
+		};
+		MeshHeader header = {};
+		std::memcpy(header.magic, kMeshMagic, sizeof(kMeshMagic));
+		header.version = version;
+		header.key = key;
+		uint64_t offset = alignOffset(sizeof(MeshHeader));
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			header.offsets[s] = offset;
+			header.sizes[s] = blobs[s].second;
+			offset = alignOffset(offset + blobs[s].second);
+		}
+		{
+			std::ofstream file(tmpPath, std::ios_base::binary);
+			uint64_t written = sizeof(MeshHeader);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(MeshHeader));
+			for (int s = 0; s < SECTION_COUNT && file.good(); ++s) {
+				writePadding(file, written);
+				file.write(blobs[s].first, std::streamsize(blobs[s].second));
+				written += blobs[s].second;
+			}
+			if (!file.good()) {
+				file.close();
+				boost::filesystem::remove(tmpPath, ec);
+				return false;
+			}
+		}
+		if (!publish(tmpPath, path)) {
+			return false;
+		}
+		trim(maxBytes());
+		return true;
+	}
+
+	void SharedSceneCache::trim(size_t maxBytes)
+	{
+		struct Entry {
+			boost::filesystem::path	path;
+			std::time_t				time;
+			uint64_t				size;
+		};
+		std::vector<Entry> entries;
+		uint64_t total = 0;
+		boost::system::error_code ec;
+		for (boost::filesystem::directory_iterator it(directory(), ec), end; !ec && it != end; it.increment(ec)) {
+			const std::string extension = it->path().extension().string();
+			if (extension != ".simg" && extension != ".smsh") {
+				continue;
+			}
+			Entry entry = { it->path(), boost::filesystem::last_write_time(it->path(), ec), uint64_t(boost::filesystem::file_size(it->path(), ec)) };
+			if (!ec) {
+				entries.push_back(entry);
+				total += entry.size;
+			}
+			ec.clear();
+		}
+		std::sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) { return a.time < b.time; });
+		// Processes still mapping a removed entry keep their pages until they unmap it.
+		for (const Entry & entry : entries) {
+			if (total <= maxBytes) {
+				break;
+			}
+			boost::filesystem::remove(entry.path, ec);
+			total -= entry.size;
+		}
+	}
+
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+#include "core/scene/Config.hpp"
+#include "core/scene/IParseData.hpp"
+#include "core/graphics/Image.hpp"
+#include "core/graphics/Mesh.hpp"
+
+namespace sibr {
+
+	/**
+	 * Cache of decoded input images and proxies shared by the viewers opened on the same dataset.
+	 * The first process to load a dataset writes the decoded pixels and the mesh buffers to a file
+	 * in shared memory (/dev/shm on Linux, see directory); the next ones map it instead of decoding.
+	 * The images are used in place, copy-on-write: all processes share the same physical pages.
+	 * The mesh buffers are copied to the Mesh arrays, which skips parsing but not the copy.
+	 *
+	 * Entries are keyed by a hash of the source files paths, sizes and modification times, and of
+	 * the decoding parameters: modifying the dataset creates new entries, the oldest entries are
+	 * removed when the cache exceeds its budget.
+	 * \ingroup sibr_scene
+	 */
+	class SIBR_SCENE_EXPORT SharedSceneCache
+	{
+		/// Location of an image in a cache file.
+		struct ImageRecord {
+			uint32_t		w; ///< Width.
+			uint32_t		h; ///< Height.
+			uint64_t		offset; ///< Pixels offset, 0 if missing.
+		};
+
+	public:
+
+		/// Increment when the layout of the files changes.
+		static const uint32_t version = 1;
+
+		/** \return the cache directory: SIBR_SHARED_CACHE if set, else a directory in shared memory or in the temporary directory. */
+		static std::string		directory(void);
+
+		/** \return the size of the cache, beyond which the oldest entries are removed. */
+		static size_t			maxBytes(void);
+
+		/** Set the size of the cache, 8GB by default.
+		\param bytes the size
+		*/
+		static void				setMaxBytes(size_t bytes);
+
+		/** Map the cached images of a dataset.
+		\param data the dataset description
+		\param minSize the reduced decoding size, see InputImages::loadFromData
+		\param images will contain the images, valid as long as one of them is alive
+		\return false if the dataset is not in the cache
+		*/
+		static bool				attachImages(const IParseData & data, const Vector2u & minSize, std::vector<ImageRGB::Ptr> & images);
+
+		/** Read the cached buffers of a mesh.
+		\param meshPath the mesh file
+		\return the mesh, or null if it is not in the cache
+		*/
+		static Mesh::Ptr		attachMesh(const std::string & meshPath);
+
+		/** Add a mesh to the cache.
+		\param meshPath the mesh file it has been loaded from
+		\param mesh the mesh
+		\return true if the entry was written
+		*/
+		static bool				storeMesh(const std::string & meshPath, const Mesh & mesh);
+
+		/** Remove the oldest entries.
+		\param maxBytes the size to keep
+		*/
+		static void				trim(size_t maxBytes);
+
+		/**
+		 * Adds the images of a dataset to the cache as they are decoded, in any order and from any thread.
+		 * The entry is only visible to other processes once all images have been added.
+		 */
+		class SIBR_SCENE_EXPORT ImageWriter
+		{
+			SIBR_DISALLOW_COPY(ImageWriter);
+
+		public:
+
+			/** Constructor.
+			\param data the dataset description
+			\param minSize the reduced decoding size, see InputImages::loadFromData
+			*/
+			ImageWriter(const IParseData & data, const Vector2u & minSize);
+
+			/// Destructor, discards the entry if it is incomplete.
+			~ImageWriter(void);
+
+			/** Write an image. Thread safe.
+			\param i the image index
+			\param image the decoded image
+			*/
+			void				add(uint i, const ImageRGB & image);
+
+			/** Publish the entry.
+			\return true if all images were written
+			*/
+			bool				finish(void);
+
+		private:
+
+			std::mutex			_mutex; ///< Protects the file.
+			std::ofstream		_file; ///< Temporary file.
+			std::string			_path; ///< Entry file.
+			std::string			_tmpPath; ///< Temporary file path.
+			uint64_t			_key = 0; ///< Entry key.
+			std::vector<ImageRecord>	_records; ///< Images locations.
+			uint64_t			_offset = 0; ///< End of the written data.
+			size_t				_added = 0; ///< Number of images written.
+		};
+
+	private:
+
+		/** Key of the images of a dataset.
+		\param data the dataset description
+		\param minSize the reduced decoding size
+		\return the key
+		*/
+		static uint64_t			imagesKey(const IParseData & data, const Vector2u & minSize);
+
+		/** Key of a mesh.
+		\param meshPath the mesh file
+		\return the key, 0 if the file doesn't exist
+		*/
+		static uint64_t			meshKey(const std::string & meshPath);
+
+		/** Path of an entry.
+		\param key the entry key
+		\param extension the entry type
+		\return the path
+		*/
+		static std::string		entryPath(uint64_t key, const std::string & extension);
+
+		static std::atomic<size_t>	_maxBytes; ///< Size of the cache.
+	};
+
+}
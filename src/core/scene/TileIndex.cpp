@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/TileIndex.hpp"
+#include "core/system/Utils.hpp"
+#include "core/system/String.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace sibr {
+
+	const float TileIndex::defaultTileSize = 100.9f;
+
+	float TileIndex::Tile::distance(const Vector3f & position) const
+	{
+		const float dx = std::max(std::max(min.x() - position.x(), position.x() - max.x()), 0.0f);
+		const float dy = std::max(std::max(min.y() - position.y(), position.y() - max.y()), 0.0f);
+		return std::sqrt(dx * dx + dy * dy);
+	}
+
+	bool TileIndex::load(const std::string & root)
+	{
+		_root = root;
+		_tiles.clear();
+		_tileSize = defaultTileSize;
+		_origin = Vector2f(0.0f, 0.0f);
+		_margin = 0.0f;
+
+		const std::string indexPath = root + "/tiles.txt";
+		if (sibr::fileExists(indexPath)) {
+			std::ifstream file(indexPath);
+			std::string line;
+			while (sibr::safeGetline(file, line)) {
+				line = line.substr(0, line.find('#'));
+				std::istringstream ss(line);
+				std::string key;
+				if (!(ss >> key)) {
+					continue;
+				}
+				if (key == "tile_size") {
+					ss >> _tileSize;
+				}
+				else if (key == "origin") {
+					ss >> _origin.x() >> _origin.y();
+				}
+				else if (key == "margin") {
+					ss >> _margin;
+				}
+				else {
+					Tile tile;
+					std::string directory;
+					std::istringstream tileLine(line);
+					if (!(tileLine >> tile.x >> tile.y >> directory)) {
+						SIBR_WRG << "Ignoring invalid line in " << indexPath << ": " << line << std::endl;
+						continue;
+					}
+					tile.path = root + "/" + directory;
+					_tiles.push_back(tile);
+				}
+			}
+			if (_tileSize <= 0.0f) {
+				SIBR_WRG << "Invalid tile size in " << indexPath << ", using " << defaultTileSize << "." << std::endl;
+				_tileSize = defaultTileSize;
+			}
+		}
+		else {
+			scan(root, 2);
+		}
+
+		for (Tile & tile : _tiles) {
+			cellBounds(tile.x, tile.y, tile.min, tile.max);
+		}
+		return !_tiles.empty();
+	}
+
+	void TileIndex::scan(const std::string & directory, int depth)
+	{
+		if (depth == 0) {
+			return;
+		}
+		for (const std::string & name : sibr::listSubdirectories(directory)) {
+			const std::string path = directory + "/" + name;
+			Tile tile;
+			if (parseTileName(name, tile.x, tile.y) && sibr::fileExists(path + "/chunk.dat")) {
+				tile.path = path;
+				_tiles.push_back(tile);
+			}
+			else if (name != "cameras") {
+				scan(path, depth - 1);
+			}
+		}
+	}
+
+	void TileIndex::cellBounds(int x, int y, Vector2f & min, Vector2f & max) const
+	{
+		min = _origin + _tileSize * Vector2f(float(x), float(y));
+		max = min + Vector2f(_tileSize, _tileSize);
+	}
+
+	int TileIndex::find(int x, int y) const
+	{
+		for (size_t tid = 0; tid < _tiles.size(); ++tid) {
+			if (_tiles[tid].x == x && _tiles[tid].y == y) {
+				return int(tid);
+			}
+		}
+		return -1;
+	}
+
+	int TileIndex::find(const std::string & path) const
+	{
+		const std::string name = sibr::getFileName(path);
+		for (size_t tid = 0; tid < _tiles.size(); ++tid) {
+			if (sibr::getFileName(_tiles[tid].path) == name && sibr::parentDirectory(_tiles[tid].path) == sibr::parentDirectory(path)) {
+				return int(tid);
+			}
+		}
+		return -1;
+	}
+
+	bool TileIndex::parseTileName(const std::string & name, int & x, int & y)
+	{
+		const size_t separator = name.find('_');
+		if (separator == std::string::npos || separator == 0 || separator + 1 == name.size()) {
+			return false;
+		}
+		try {
+			size_t xEnd = 0, yEnd = 0;
+			x = std::stoi(name.substr(0, separator), &xEnd);
+			y = std::stoi(name.substr(separator + 1), &yEnd);
+			return xEnd == separator && yEnd == name.size() - separator - 1;
+		}
+		catch (const std::exception &) {
+			return false;
+		}
+	}
+
+}
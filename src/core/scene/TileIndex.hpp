@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/scene/Config.hpp"
+#include "core/system/Vector.hpp"
+
+namespace sibr {
+
+	/**
+	 * Layout of a dataset split into square tiles on the ground (XY) plane, for scenes too large to be
+	 * loaded at once. Each tile is a chunked dataset directory (containing a chunk.dat file, see
+	 * ParseData::getParsedChunkedData) named after its grid coordinates, "x_y". The cameras are shared
+	 * by all tiles in <root>/cameras, each tile keeps the ones above it and has its own mesh.ply.
+	 *
+	 * The index is read from <root>/tiles.txt when it exists:
+	 \verbatim
+	 # Comments start with #.
+	 tile_size 100.9      # side of the tiles, in scene units
+	 origin 0 0           # XY position of the corner of tile 0 0
+	 margin 10            # cameras up to this distance out of a tile are also loaded with it
+	 0 0 chunks/0_0       # one line per tile: grid coordinates, directory relative to the root
+	 0 1 chunks/0_1
+	 \endverbatim
+	 * Otherwise the tiles are the "x_y" directories containing a chunk.dat, one or two levels below the root.
+	 * \ingroup sibr_scene
+	 */
+	class SIBR_SCENE_EXPORT TileIndex
+	{
+	public:
+
+		/// Tile side used by the datasets without index.
+		static const float defaultTileSize;
+
+		/// A tile of the dataset.
+		struct Tile {
+			int			x = 0; ///< Grid column.
+			int			y = 0; ///< Grid row.
+			std::string	path; ///< Dataset directory of the tile.
+			Vector2f	min = Vector2f(0.0f, 0.0f); ///< Lower corner on the ground plane.
+			Vector2f	max = Vector2f(0.0f, 0.0f); ///< Upper corner on the ground plane.
+
+			/** Distance from a point to the tile on the ground plane.
+			\param position the point, only X and Y are used
+			\return 0 if the point is above the tile
+			*/
+			float		distance(const Vector3f & position) const;
+		};
+
+		/** Read the index of a tiled dataset.
+		\param root the dataset root, containing tiles.txt and the cameras directory
+		\return false if no tile was found
+		*/
+		bool load(const std::string & root);
+
+		/** \return the tiles. */
+		const std::vector<Tile> &	tiles(void) const { return _tiles; }
+
+		/** \return the dataset root. */
+		const std::string &			root(void) const { return _root; }
+
+		/** \return the side of the tiles. */
+		float						tileSize(void) const { return _tileSize; }
+
+		/** \return the distance out of a tile up to which its cameras are loaded. */
+		float						margin(void) const { return _margin; }
+
+		/** Bounds of a grid cell.
+		\param x grid column
+		\param y grid row
+		\param min will contain the lower corner
+		\param max will contain the upper corner
+		*/
+		void						cellBounds(int x, int y, Vector2f & min, Vector2f & max) const;
+
+		/** Find a tile.
+		\param x grid column
+		\param y grid row
+		\return the tile index, or -1
+		*/
+		int							find(int x, int y) const;
+
+		/** Find a tile.
+		\param path the dataset directory of the tile
+		\return the tile index, or -1
+		*/
+		int							find(const std::string & path) const;
+
+		/** Parse the grid coordinates from a tile directory name.
+		\param name the directory name, "x_y"
+		\param x will contain the grid column
+		\param y will contain the grid row
+		\return false if the name is not a tile name
+		*/
+		static bool					parseTileName(const std::string & name, int & x, int & y);
+
+	private:
+
+		/** List the tiles directories below the root, for the datasets without index.
+		\param directory the directory to scan
+		\param depth the number of levels left to scan
+		*/
+		void						scan(const std::string & directory, int depth);
+
+		std::string			_root; ///< Dataset root.
+		std::vector<Tile>	_tiles; ///< Tiles.
+		float				_tileSize = defaultTileSize; ///< Side of the tiles.
+		Vector2f			_origin = Vector2f(0.0f, 0.0f); ///< Corner of tile 0 0.
+		float				_margin = 0.0f; ///< Cameras loading margin around the tiles.
+	};
+
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/scene/TileManager.hpp"
+#include "core/system/ThreadPool.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace sibr {
+
+	namespace
+	{
+		/// Is a future done, without blocking.
+		template<typename Future>
+		bool isDone(const Future & future)
+		{
+			return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+	}
+
+	TileManager::TileManager(const TileIndex & index, const Budget & budget, const IIBRScene::SceneOptions & options, uint width) :
+		_index(index), _budget(budget), _options(options), _width(width), _slots(index.tiles().size())
+	{
+		if (_budget.loadRadius < 0.0f) {
+			_budget.loadRadius = 0.5f * _index.tileSize();
+		}
+		if (_budget.unloadRadius < _budget.loadRadius) {
+			_budget.unloadRadius = 2.0f * _budget.loadRadius;
+		}
+		_budget.maxTiles = std::max(_budget.maxTiles, size_t(1));
+		_budget.maxConcurrentLoads = std::max(_budget.maxConcurrentLoads, 1u);
+		// Tiles are loaded while rendering the others.
+		_options.background = true;
+	}
+
+	TileManager::~TileManager(void)
+	{
+		for (Slot & slot : _slots) {
+			if (slot.parsing.valid()) {
+				slot.parsing.wait();
+			}
+		}
+	}
+
+	BasicIBRScene::Ptr TileManager::load(int tile)
+	{
+		Slot & slot = _slots[tile];
+		if (slot.state == State::UNLOADED) {
+			ParseData::Ptr data(new ParseData());
+			data->getParsedChunkedData(_index.tiles()[tile].path);
+			createScene(tile, data);
+		}
+		else if (slot.state == State::PARSING) {
+			createScene(tile, slot.parsing.get());
+		}
+		return slot.scene;
+	}
+
+	void TileManager::createScene(int tile, const ParseData::Ptr & data)
+	{
+		Slot & slot = _slots[tile];
+		if (!data || data->cameras().empty()) {
+			SIBR_WRG << "Tile " << _index.tiles()[tile].path << " has no camera, skipping it." << std::endl;
+			slot.state = State::EMPTY;
+			return;
+		}
+		slot.scene.reset(new BasicIBRScene());
+		slot.scene->createFromCustomData(data, _width, _options);
+		slot.meshInstalled = false;
+		slot.state = State::LOADING;
+	}
+
+	void TileManager::unload(int tile)
+	{
+		Slot & slot = _slots[tile];
+		// Views still rendering the scene keep it alive until they switch.
+		slot.scene.reset();
+		slot.bytes = 0;
+		slot.state = State::UNLOADED;
+	}
+
+	void TileManager::update(const Vector3f & position)
+	{
+		// Install the tiles done parsing or loading.
+		uint loading = 0;
+		for (int tid = 0; tid < int(_slots.size()); ++tid) {
+			Slot & slot = _slots[tid];
+			if (slot.state == State::PARSING && isDone(slot.parsing)) {
+				createScene(tid, slot.parsing.get());
+			}
+			if (slot.state == State::LOADING) {
+				if (!slot.meshInstalled && isDone(slot.scene->meshReady())) {
+					if (_onMeshReady) {
+						_onMeshReady(slot.scene);
+					}
+					slot.meshInstalled = true;
+				}
+				if (slot.meshInstalled && slot.scene->isReady()) {
+					slot.bytes = tileBytes(*slot.scene);
+					slot.state = State::READY;
+				}
+			}
+			if (slot.state == State::PARSING || slot.state == State::LOADING) {
+				++loading;
+			}
+		}
+
+		// Tiles by distance to the viewer.
+		const std::vector<TileIndex::Tile> & tiles = _index.tiles();
+		std::vector<float> distances(tiles.size());
+		for (size_t tid = 0; tid < tiles.size(); ++tid) {
+			distances[tid] = tiles[tid].distance(position);
+		}
+		std::vector<int> order(tiles.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&distances](int a, int b) { return distances[a] < distances[b]; });
+
+		// Start loading the closest missing tiles, the one below the viewer even if out of budget.
+		size_t wanted = 0;
+		for (const int tid : order) {
+			if (wanted >= _budget.maxTiles || (wanted > 0 && distances[tid] > _budget.loadRadius)) {
+				break;
+			}
+			Slot & slot = _slots[tid];
+			if (slot.state == State::EMPTY) {
+				continue;
+			}
+			++wanted;
+			if (slot.state != State::UNLOADED || loading >= _budget.maxConcurrentLoads) {
+				continue;
+			}
+			const std::string path = tiles[tid].path;
+			slot.parsing = ThreadPool::shared().submit([path]() {
+				ParseData::Ptr data(new ParseData());
+				data->getParsedChunkedData(path);
+				return data;
+			}, -distances[tid]);
+			slot.state = State::PARSING;
+			++loading;
+		}
+
+		// Release the far tiles, then the furthest ones until the budgets are met.
+		// Tiles still loading are kept: releasing them would wait for their background tasks.
+		size_t count = 0;
+		size_t bytes = 0;
+		for (const int tid : order) {
+			const Slot & slot = _slots[tid];
+			if (slot.state == State::READY && count > 0 && distances[tid] > _budget.unloadRadius) {
+				unload(tid);
+				continue;
+			}
+			if (slot.state != State::UNLOADED && slot.state != State::EMPTY) {
+				++count;
+				bytes += slot.bytes;
+			}
+		}
+		for (auto it = order.rbegin(); it != order.rend() && (count > _budget.maxTiles || bytes > _budget.maxBytes); ++it) {
+			// Keep the closest tile whatever its size.
+			if (*it == order.front()) {
+				break;
+			}
+			if (_slots[*it].state == State::READY) {
+				--count;
+				bytes -= _slots[*it].bytes;
+				unload(*it);
+			}
+		}
+	}
+
+	BasicIBRScene::Ptr TileManager::nearestReadyScene(const Vector3f & position) const
+	{
+		BasicIBRScene::Ptr nearest;
+		float nearestDistance = std::numeric_limits<float>::max();
+		for (size_t tid = 0; tid < _slots.size(); ++tid) {
+			if (_slots[tid].state != State::READY) {
+				continue;
+			}
+			const float distance = _index.tiles()[tid].distance(position);
+			if (distance < nearestDistance) {
+				nearestDistance = distance;
+				nearest = _slots[tid].scene;
+			}
+		}
+		return nearest;
+	}
+
+	size_t TileManager::loadedTiles(void) const
+	{
+		return size_t(std::count_if(_slots.begin(), _slots.end(), [](const Slot & slot) {
+			return slot.state == State::PARSING || slot.state == State::LOADING || slot.state == State::READY;
+		}));
+	}
+
+	size_t TileManager::loadedBytes(void) const
+	{
+		size_t bytes = 0;
+		for (const Slot & slot : _slots) {
+			bytes += slot.bytes;
+		}
+		return bytes;
+	}
+
+	size_t TileManager::tileBytes(const BasicIBRScene & scene)
+	{
+		size_t bytes = 0;
+		const RenderTargetTextures::Ptr & targets = scene.renderTargets();
+		if (targets && targets->getInputRGBTextureArrayPtr()) {
+			const Texture2DArrayRGB & rgbs = *targets->getInputRGBTextureArrayPtr();
+			bytes += size_t(rgbs.w()) * rgbs.h() * rgbs.depth() * 3;
+		}
+		if (targets && targets->getInputDepthMapArrayPtr()) {
+			const Texture2DArrayLum32F & depths = *targets->getInputDepthMapArrayPtr();
+			bytes += size_t(depths.w()) * depths.h() * depths.depth() * sizeof(float);
+		}
+		if (scene.proxies() && scene.proxies()->hasProxy()) {
+			const Mesh & mesh = scene.proxies()->proxy();
+			bytes += mesh.vertices().size() * sizeof(Vector3f) + mesh.normals().size() * sizeof(Vector3f)
+				+ mesh.colors().size() * sizeof(Vector3f) + mesh.texCoords().size() * sizeof(Vector2f)
+				+ mesh.triangles().size() * sizeof(Vector3u);
+		}
+		return bytes;
+	}
+
+}
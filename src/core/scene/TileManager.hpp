@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <future>
+
+#include "core/scene/Config.hpp"
+#include "core/scene/BasicIBRScene.hpp"
+#include "core/scene/ParseData.hpp"
+#include "core/scene/TileIndex.hpp"
+
+namespace sibr {
+
+	/**
+	 * Keeps the tiles of a tiled dataset around the viewer loaded, under memory budgets.
+	 * Each tile is a separate BasicIBRScene: its cameras are parsed on the thread pool, nearest
+	 * tiles first, then its images and proxy are loaded in the background (SceneOptions::background
+	 * is forced). Tiles too far from the viewer, or the furthest ones when the budgets are exceeded,
+	 * are released once fully loaded. All functions should be called on the main thread.
+	 *
+	 * Code Example:
+	 \code
+	 sibr::TileIndex index;
+	 index.load(datasetPath);
+	 sibr::TileManager tiles(index, sibr::TileManager::Budget(), options);
+	 tiles.onMeshReady([](const sibr::BasicIBRScene::Ptr & tile) {
+		tile->renderTargets()->initDepthTextureArrays(tile->cameras(), tile->proxies(), true);
+	 });
+	 ...
+	 // Each frame:
+	 tiles.update(camera.position());
+	 const sibr::BasicIBRScene::Ptr nearest = tiles.nearestReadyScene(camera.position());
+	 \endcode
+	 * \ingroup sibr_scene
+	 */
+	class SIBR_SCENE_EXPORT TileManager
+	{
+		SIBR_CLASS_PTR(TileManager);
+		SIBR_DISALLOW_COPY(TileManager);
+
+	public:
+
+		/// Limits on the loaded tiles.
+		struct Budget {
+			size_t	maxTiles = 9; ///< Number of tiles loaded at once.
+			size_t	maxBytes = size_t(2048) << 20; ///< Estimated memory of the loaded tiles, see tileBytes.
+			float	loadRadius = -1.0f; ///< Tiles closer to the viewer are loaded, half a tile if negative.
+			float	unloadRadius = -1.0f; ///< Tiles further from the viewer are released, twice the load radius if negative.
+			uint	maxConcurrentLoads = 2; ///< Number of tiles parsed or loaded at the same time.
+		};
+
+		/// Called on the main thread with a tile scene.
+		typedef std::function<void(const BasicIBRScene::Ptr &)> TileCallback;
+
+		/** Constructor, nothing is loaded until update or load.
+		\param index the tiles
+		\param budget the limits on the loaded tiles
+		\param options the options of the tiles scenes
+		\param width the width of the tiles input images, 0 for the full resolution
+		*/
+		TileManager(const TileIndex & index, const Budget & budget, const IIBRScene::SceneOptions & options, uint width = 0);
+
+		/// Destructor, waits for the tiles being parsed.
+		~TileManager(void);
+
+		/** Set a function called once the proxy of a tile is loaded, before the tile is ready.
+		 * Typically used to render the input depth maps.
+		\param callback the function
+		*/
+		void						onMeshReady(const TileCallback & callback) { _onMeshReady = callback; }
+
+		/** Load and unload the tiles around the viewer, and install the tiles done loading.
+		\param position the viewer position
+		*/
+		void						update(const Vector3f & position);
+
+		/** Parse a tile now and create its scene, for instance to have a scene at startup.
+		 * The images and the proxy are still loaded in the background.
+		\param tile the tile index
+		\return the scene, or null if the tile has no camera
+		*/
+		BasicIBRScene::Ptr			load(int tile);
+
+		/** \return the closest tile to a position among the fully loaded ones, or null.
+		\param position the position
+		*/
+		BasicIBRScene::Ptr			nearestReadyScene(const Vector3f & position) const;
+
+		/** \return the scene of a tile, null if it is not parsed yet.
+		\param tile the tile index
+		*/
+		BasicIBRScene::Ptr			scene(int tile) const { return _slots[tile].scene; }
+
+		/** \return whether a tile is fully loaded.
+		\param tile the tile index
+		*/
+		bool						isReady(int tile) const { return _slots[tile].state == State::READY; }
+
+		/** \return the number of loaded or loading tiles. */
+		size_t						loadedTiles(void) const;
+
+		/** \return the estimated memory of the fully loaded tiles. */
+		size_t						loadedBytes(void) const;
+
+		/** \return the tiles. */
+		const TileIndex &			index(void) const { return _index; }
+
+		/** Estimate the memory used by a scene: its texture arrays and its proxy.
+		\param scene the scene
+		\return the size in bytes
+		*/
+		static size_t				tileBytes(const BasicIBRScene & scene);
+
+	private:
+
+		/// Loading state of a tile.
+		enum class State {
+			UNLOADED, ///< Nothing loaded.
+			PARSING, ///< Cameras being parsed.
+			LOADING, ///< Scene created, components loading in the background.
+			READY, ///< Fully loaded.
+			EMPTY ///< The tile has no camera, never loaded.
+		};
+
+		/// A tile and its scene.
+		struct Slot {
+			State						state = State::UNLOADED; ///< Loading state.
+			std::future<ParseData::Ptr>	parsing; ///< Cameras parsing, while PARSING.
+			BasicIBRScene::Ptr			scene; ///< Scene, once parsed.
+			bool						meshInstalled = false; ///< Whether the mesh callback has been called.
+			size_t						bytes = 0; ///< Estimated memory, once READY.
+		};
+
+		/** Create the scene of a parsed tile.
+		\param tile the tile index
+		\param data the parsed cameras
+		*/
+		void						createScene(int tile, const ParseData::Ptr & data);
+
+		/** Release a tile.
+		\param tile the tile index
+		*/
+		void						unload(int tile);
+
+		TileIndex					_index; ///< Tiles.
+		Budget						_budget; ///< Limits on the loaded tiles.
+		IIBRScene::SceneOptions		_options; ///< Options of the tiles scenes.
+		uint						_width; ///< Width of the input images.
+		std::vector<Slot>			_slots; ///< Per tile state.
+		TileCallback				_onMeshReady; ///< Mesh callback.
+	};
+
+}
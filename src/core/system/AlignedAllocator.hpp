@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <cstddef>
+# include <new>
+
+namespace sibr
+{
+	/** STL allocator returning blocks aligned on a given boundary, for containers processed with SIMD
+	 instructions or split between threads at cache line boundaries.
+
+	Code Example:
+
+		std::vector<float, sibr::AlignedAllocator<float>> values(1024);
+
+	 \ingroup sibr_system
+	*/
+	template<typename T, size_t Alignment = 64>
+	class AlignedAllocator
+	{
+		static_assert((Alignment & (Alignment - 1)) == 0, "The alignment should be a power of two.");
+
+	public:
+
+		typedef T value_type;
+
+		/// Rebinding to another element type, required by the STL containers.
+		template<typename U>
+		struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+		/// Constructor.
+		AlignedAllocator(void) noexcept {}
+
+		/// Conversion from an allocator of another element type.
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+		/** Allocate uninitialized storage.
+		 *\param count the number of elements
+		 *\return the storage
+		 */
+		T * allocate(size_t count) {
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+		}
+
+		/** Free storage.
+		 *\param ptr the storage, from allocate
+		 *\param count the number of elements
+		 */
+		void deallocate(T * ptr, size_t count) noexcept {
+			::operator delete(ptr, std::align_val_t(Alignment));
+		}
+
+		/// All instances are interchangeable.
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+
+		/// All instances are interchangeable.
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept { return false; }
+	};
+
+} // namespace sibr
@@ -13,7 +13,9 @@
 #pragma once
 
 # include <vector>
+# include <type_traits>
 #include <core/system/Vector.hpp>
+#include <core/system/ThreadPool.hpp>
 
 namespace sibr
 {
@@ -96,6 +98,23 @@ namespace sibr
 		void*					data( void ) const;
 		void*					data( void );
 
+		/// Return a pointer to the first element of a row, the
+		/// row elements being contiguous (for vectorized loops).
+		/// \note Not available for Array2d<bool>, whose storage is packed.
+		const T*				row( uint y ) const;
+		T*						row( uint y );
+
+		/// Call body(x, y, value) for each element, the rows being
+		/// processed in parallel on a thread pool.
+		/// \note Not available for Array2d<bool>, elements of different
+		/// rows can share the same memory word.
+		template <typename Body>
+		void					parallelForEach( const Body & body, ThreadPool & pool = ThreadPool::shared() );
+
+		/// Call body(y, row) for each row, in parallel on a thread pool.
+		/// \note Not available for Array2d<bool>.
+		template <typename Body>
+		void					parallelForRows( const Body & body, ThreadPool & pool = ThreadPool::shared() );
 
 
 		/// Return the element index for the given coordinates
@@ -203,6 +222,35 @@ namespace sibr
 		return vector().empty()? nullptr : &vector()[0];
 	}
 
+	template<typename T>
+	const T*				Array2d<T>::row( uint y ) const {
+		static_assert(!std::is_same<T, bool>::value, "Array2d<bool> rows are packed, use an integer type.");
+		return _data.data() + size_t(y) * _width;
+	}
+	template<typename T>
+	T*						Array2d<T>::row( uint y ) {
+		static_assert(!std::is_same<T, bool>::value, "Array2d<bool> rows are packed, use an integer type.");
+		return _data.data() + size_t(y) * _width;
+	}
+
+	template<typename T>
+	template <typename Body>
+	void					Array2d<T>::parallelForRows( const Body & body, ThreadPool & pool ) {
+		pool.parallelFor(0, int(_height), [&](int y) {
+			body(uint(y), row(uint(y)));
+		});
+	}
+
+	template<typename T>
+	template <typename Body>
+	void					Array2d<T>::parallelForEach( const Body & body, ThreadPool & pool ) {
+		parallelForRows([&](uint y, T * values) {
+			for (uint x = 0; x < _width; ++x) {
+				body(x, y, values[x]);
+			}
+		}, pool);
+	}
+
 	template<typename T>
 	bool	Array2d<T>::empty( void ) const {
 		return vector().empty();
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "core/system/BenchmarkReport.hpp"
+#include "core/system/Utils.hpp"
+
+#ifdef SIBR_OS_WINDOWS
+	#include <Windows.h>
+#else
+	#include <unistd.h>
+	#include <sys/utsname.h>
+#endif
+
+namespace sibr
+{
+	namespace
+	{
+		/// Quote a string for JSON.
+		std::string quoted(const std::string & str)
+		{
+			std::string out = "\"";
+			for (const char c : str) {
+				switch (c) {
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				case '\r': break;
+				default:
+					if (static_cast<unsigned char>(c) >= 0x20) {
+						out += c;
+					}
+				}
+			}
+			return out + "\"";
+		}
+
+		/// Write a string map as a JSON object.
+		void writeMap(std::ostream & out, const std::map<std::string, std::string> & map)
+		{
+			out << "{";
+			bool first = true;
+			for (const auto & item : map) {
+				out << (first ? " " : ", ") << quoted(item.first) << ": " << quoted(item.second);
+				first = false;
+			}
+			out << (map.empty() ? "}" : " }");
+		}
+	}
+
+	BenchmarkReport::BenchmarkReport(void) :
+		_environment(systemInfo())
+	{
+	}
+
+	BenchmarkReport::Stats BenchmarkReport::stats(std::vector<double> values)
+	{
+		Stats stats;
+		if (values.empty()) {
+			return stats;
+		}
+		std::sort(values.begin(), values.end());
+		const auto percentile = [&values](double p) {
+			const size_t rank = size_t(std::ceil(p * double(values.size())));
+			return values[std::min(std::max(rank, size_t(1)), values.size()) - 1];
+		};
+		for (const double v : values) {
+			stats.mean += v;
+		}
+		stats.count = values.size();
+		stats.mean /= double(values.size());
+		stats.min = values.front();
+		stats.max = values.back();
+		stats.p50 = percentile(0.50);
+		stats.p90 = percentile(0.90);
+		stats.p95 = percentile(0.95);
+		stats.p99 = percentile(0.99);
+		return stats;
+	}
+
+	std::vector<double> BenchmarkReport::measure(int repeats, const std::function<void()> & func)
+	{
+		std::vector<double> samples;
+		for (int r = 0; r < repeats; ++r) {
+			const auto start = std::chrono::steady_clock::now();
+			func();
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return samples;
+	}
+
+	std::map<std::string, std::string> BenchmarkReport::systemInfo(void)
+	{
+		std::map<std::string, std::string> info;
+		info["cpu_threads"] = std::to_string(std::thread::hardware_concurrency());
+
+#ifdef SIBR_OS_WINDOWS
+		if (const char * cpu = std::getenv("PROCESSOR_IDENTIFIER")) {
+			info["cpu"] = cpu;
+		}
+		MEMORYSTATUSEX memory;
+		memory.dwLength = sizeof(memory);
+		if (GlobalMemoryStatusEx(&memory)) {
+			info["memory_mb"] = std::to_string(memory.ullTotalPhys >> 20);
+		}
+		info["os"] = "Windows";
+#else
+		std::ifstream cpuinfo("/proc/cpuinfo");
+		std::string line;
+		while (sibr::safeGetline(cpuinfo, line)) {
+			if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos) {
+				const size_t start = line.find_first_not_of(" \t", line.find(':') + 1);
+				info["cpu"] = start == std::string::npos ? "" : line.substr(start);
+				break;
+			}
+		}
+		const long pages = sysconf(_SC_PHYS_PAGES);
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		if (pages > 0 && pageSize > 0) {
+			info["memory_mb"] = std::to_string((size_t(pages) * size_t(pageSize)) >> 20);
+		}
+		utsname name;
+		if (uname(&name) == 0) {
+			info["os"] = std::string(name.sysname) + " " + name.release;
+		}
+#endif
+
+#if defined(_MSC_VER)
+		info["compiler"] = "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__VERSION__)
+		info["compiler"] = __VERSION__;
+#endif
+#ifdef NDEBUG
+		info["build"] = "release";
+#else
+		info["build"] = "debug";
+#endif
+		const std::time_t now = std::time(nullptr);
+		char date[32];
+		if (std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now))) {
+			info["date"] = date;
+		}
+		return info;
+	}
+
+	void BenchmarkReport::add(const std::string & group, const std::string & name, const std::vector<double> & samples,
+		const std::map<std::string, std::string> & params)
+	{
+		_entries.push_back({ group, name, params, samples });
+	}
+
+	bool BenchmarkReport::write(const std::string & path) const
+	{
+		std::ofstream json(path);
+		if (!json.is_open()) {
+			SIBR_WRG << "Unable to write the benchmark report " << path << std::endl;
+			return false;
+		}
+		json << "{\n\t\"environment\": ";
+		writeMap(json, _environment);
+		json << ",\n\t\"benchmarks\": [\n";
+		for (size_t e = 0; e < _entries.size(); ++e) {
+			const Entry & entry = _entries[e];
+			const Stats s = stats(entry.samples);
+			json << "\t\t{\n\t\t\t\"group\": " << quoted(entry.group) << ",\n\t\t\t\"name\": " << quoted(entry.name) << ",\n\t\t\t\"params\": ";
+			writeMap(json, entry.params);
+			json << ",\n\t\t\t\"count\": " << s.count << ",\n\t\t\t\"ms\": { \"mean\": " << s.mean << ", \"min\": " << s.min << ", \"max\": " << s.max
+				<< ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << " },\n\t\t\t\"samples\": [";
+			for (size_t i = 0; i < entry.samples.size(); ++i) {
+				json << (i > 0 ? ", " : "") << entry.samples[i];
+			}
+			json << "]\n\t\t}" << (e + 1 < _entries.size() ? "," : "") << "\n";
+		}
+		json << "\t]\n}\n";
+		SIBR_LOG << "Wrote " << path << std::endl;
+		return true;
+	}
+
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <functional>
+# include <map>
+# include <string>
+# include <vector>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Collects the timings of a benchmark run and writes them as JSON, with percentiles and a
+	 description of the machine, so that runs on different builds or drivers can be compared by scripts.
+
+	Code Example:
+
+		sibr::BenchmarkReport report;
+		report.environment("gpu", glRenderer);
+		report.add("kernels", "mesh_load", sibr::BenchmarkReport::measure(5, [&]() { mesh.load(path); }));
+		report.write("benchmark.json");
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT BenchmarkReport
+	{
+	public:
+
+		/// Summary of a series of durations, in ms.
+		struct Stats {
+			size_t count = 0; ///< Number of samples.
+			double mean = 0.0, min = 0.0, max = 0.0, p50 = 0.0, p90 = 0.0, p95 = 0.0, p99 = 0.0; ///< Statistics, nearest rank percentiles.
+		};
+
+		/// A measured series.
+		struct Entry {
+			std::string group; ///< Category (renderers, kernels...).
+			std::string name; ///< Measured thing.
+			std::map<std::string, std::string> params; ///< Settings of the measure (dataset, resolution...).
+			std::vector<double> samples; ///< Durations, in ms.
+		};
+
+		/// Constructor, fills the environment with the description of the machine, see systemInfo.
+		BenchmarkReport(void);
+
+		/** Compute the statistics of a series.
+		 *\param values the durations
+		 *\return the statistics, zero if the series is empty
+		 */
+		static Stats stats(std::vector<double> values);
+
+		/** Run a function several times and time each run.
+		 *\param repeats the number of runs
+		 *\param func the function
+		 *\return the durations, in ms
+		 */
+		static std::vector<double> measure(int repeats, const std::function<void()> & func);
+
+		/** \return the CPU, thread count, memory, OS and compiler of the machine. */
+		static std::map<std::string, std::string> systemInfo(void);
+
+		/** Set a property of the run environment (GPU, driver...).
+		 *\param key the property name
+		 *\param value the property value
+		 */
+		void environment(const std::string & key, const std::string & value) { _environment[key] = value; }
+
+		/** Add a measured series.
+		 *\param group the category of the measure
+		 *\param name the measured thing
+		 *\param samples the durations, in ms
+		 *\param params the settings of the measure
+		 */
+		void add(const std::string & group, const std::string & name, const std::vector<double> & samples,
+			const std::map<std::string, std::string> & params = {});
+
+		/** \return the measured series. */
+		const std::vector<Entry> & entries(void) const { return _entries; }
+
+		/** Write the report, with the statistics and the raw samples of each series.
+		 *\param path the JSON file
+		 *\return false if the file can't be written
+		 */
+		bool write(const std::string & path) const;
+
+	private:
+
+		std::map<std::string, std::string> _environment; ///< Run environment.
+		std::vector<Entry> _entries; ///< Measured series.
+	};
+
+}
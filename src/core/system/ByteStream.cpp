@@ -20,29 +20,30 @@
 #endif
 
 #include "core/system/ByteStream.hpp"
+#include "core/system/MappedFile.hpp"
 
 
 namespace sibr
 {
 	void			ByteStream::memoryDump( void ) const 
 	{
-		const unsigned char* data = reinterpret_cast<const unsigned char*>(&_buffer[0]);
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(buffer());
 		std::cout << "Readable size: " << readableSize() << std::endl;
 		std::cout << "Real size: " << bufferSize() << std::endl;
 		std::cout << std::hex << std::setfill('0') << std::setw(2);
-		for (unsigned i = 0; i < _buffer.size(); ++i)
+		for (unsigned i = 0; i < bufferSize(); ++i)
 		{
 			const int blocksize = 2;
-			for (unsigned j = 0; i < _buffer.size() && j < blocksize; ++j, ++i)
+			for (unsigned j = 0; i < bufferSize() && j < blocksize; ++j, ++i)
 				std::cout << uint(data[i]);
 			std::cout << ' ';
-			for (unsigned j = 0; i < _buffer.size() && j < blocksize; ++j, ++i)
+			for (unsigned j = 0; i < bufferSize() && j < blocksize; ++j, ++i)
 				std::cout << uint(data[i]);
 			std::cout << ' ';
-			for (unsigned j = 0; i < _buffer.size() && j < blocksize; ++j, ++i)
+			for (unsigned j = 0; i < bufferSize() && j < blocksize; ++j, ++i)
 				std::cout << uint(data[i]);
 			std::cout << ' ';
-			for (unsigned j = 0; i < _buffer.size() && j < blocksize; ++j, ++i)
+			for (unsigned j = 0; i < bufferSize() && j < blocksize; ++j, ++i)
 				std::cout << uint(data[i]);
 			std::cout << ' ';
 			std::cout << std::endl;
@@ -55,7 +56,7 @@ namespace sibr
 		if (ByteStream::systemIsBigEndian())
 			return n;
 		// Else we are on a little endian system
-		uint32 out = 0;
+		uint64 out = 0;
 		out |= (n & 0xFF00000000000000) >> 56;
 		out |= (n & 0x00FF000000000000) >> 40;
 		out |= (n & 0x0000FF0000000000) >> 24;
@@ -93,6 +94,41 @@ namespace sibr
 		return out;
 	}
 
+	void ByteStream::hton( void* values, size_t count, size_t valueSize )
+	{
+		if (ByteStream::systemIsBigEndian() || valueSize == 1)
+			return;
+		// Plain loops over byte swaps, that compilers turn into vector shuffles.
+		if (valueSize == 2)
+		{
+			uint16* v = static_cast<uint16*>(values);
+			for (size_t i = 0; i < count; ++i)
+				v[i] = uint16((v[i] >> 8) | (v[i] << 8));
+		}
+		else if (valueSize == 4)
+		{
+			uint32* v = static_cast<uint32*>(values);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const uint32 n = v[i];
+				v[i] = (n >> 24) | ((n >> 8) & 0x0000FF00) | ((n << 8) & 0x00FF0000) | (n << 24);
+			}
+		}
+		else if (valueSize == 8)
+		{
+			uint64* v = static_cast<uint64*>(values);
+			for (size_t i = 0; i < count; ++i)
+			{
+				uint64 n = v[i];
+				n = ((n & 0x00FF00FF00FF00FFull) << 8) | ((n >> 8) & 0x00FF00FF00FF00FFull);
+				n = ((n & 0x0000FFFF0000FFFFull) << 16) | ((n >> 16) & 0x0000FFFF0000FFFFull);
+				v[i] = (n << 32) | (n >> 32);
+			}
+		}
+		else
+			SIBR_ERR << "ByteStream: cannot convert the byte order of " << valueSize << " bytes values." << std::endl;
+	}
+
 	bool ByteStream::systemIsBigEndian( void ) 
 	{
 		static int16 isBigEndian = -1;
@@ -117,10 +153,16 @@ namespace sibr
 			auto len = file.tellg();
 			file.seekg(0, file.beg);
 
-			_buffer.resize(len);
-			file.read(reinterpret_cast<char*>(&_buffer[0]), len);
+			_mapping.reset();
+			_view = nullptr;
+			_viewSize = 0;
+			_buffer.resize(size_t(len));
+			if (!_buffer.empty())
+				file.read(reinterpret_cast<char*>(_buffer.data()), len);
 
 			file.close();
+			_readPos = 0;
+			_valid = true;
 			return true;
 		}
 		else
@@ -128,6 +170,34 @@ namespace sibr
 		return false;
 	}
 
+	bool	ByteStream::map( const std::string& filename )
+	{
+		const auto mapping = std::make_shared<MappedFile>();
+		if (!mapping->open(filename))
+		{
+			SIBR_WRG << "cannot map ByteStream from file '" << filename << "'." << std::endl;
+			return false;
+		}
+		_buffer.clear();
+		_buffer.shrink_to_fit();
+		_view = reinterpret_cast<const uint8*>(mapping->data());
+		_viewSize = mapping->size();
+		_mapping = mapping;
+		_readPos = 0;
+		_valid = true;
+		return true;
+	}
+
+	void	ByteStream::detach( void )
+	{
+		if (!_mapping)
+			return;
+		_buffer.assign(_view, _view + _viewSize);
+		_mapping.reset();
+		_view = nullptr;
+		_viewSize = 0;
+	}
+
 	void	ByteStream::saveToFile( const std::string& filename ) 
 	{
 		if (bufferSize() == 0)
@@ -137,17 +207,18 @@ namespace sibr
 
 		if (file)
 		{
-			file.write((char*)&_buffer[0], _buffer.size() * sizeof(_buffer[0]));
+			file.write(reinterpret_cast<const char*>(buffer()), bufferSize());
 			file.close();
 		}
 		else
 			SIBR_LOG << "ERROR: cannot write to the file '" << filename << "'" << std::endl;
 	}
 
-	void ByteStream::push(const void* data, uint size) 
+	void ByteStream::push(const void* data, size_t size) 
 	{
 		assert(data != nullptr && size > 0);
 
+		detach();
 		size_t curpos = _buffer.size();
 		_buffer.resize(curpos + size);
 		memcpy(&_buffer[curpos], data, size);
@@ -14,6 +14,9 @@
 
 # include <vector>
 # include <iomanip>
+# include <cstring>
+# include <memory>
+# include <type_traits>
 # include "core/system/Config.hpp"
 
 
@@ -22,8 +25,12 @@ namespace sibr
 	/// Be sure to use STL objects from client's dll version by exporting this declaration (see warning C4251)
 	//template class SIBR_EXPORT std::vector<uint8>;
 
+	class MappedFile;
+
 	/**
 	 Used to manipulate stream of bytes.
+	 A stream can either own its bytes (load, writes) or read a memory mapped file without copying it (map),
+	 in which case the first write copies the mapped bytes to an owned buffer.
 	 \note This ByteStream stores integer using the network byte order (which is big endian).
 	 \ingroup sibr_system
 	*/
@@ -50,6 +57,15 @@ namespace sibr
 		* */ 
 		bool load( const std::string& filename );
 
+		/** Map a file in memory and read from it, without loading it; pages are read by the OS on access.
+		* \param filename the filename
+		* \return success boolean
+		* */
+		bool map( const std::string& filename );
+
+		/** \return true if the stream reads a memory mapped file. */
+		bool isMapped( void ) const { return _mapping != nullptr; }
+
 		/** Save all bytes to a file using the given filename
 		 *\param filename file apth
 		 **/
@@ -59,7 +75,31 @@ namespace sibr
 		 *\param data pointer to the data
 		 *\param size size in bytes
 		 **/
-		void push(const void* data, uint size);
+		void push(const void* data, size_t size);
+
+		/** Write an array of values to the stream, in network byte order.
+		 *\param values the values
+		 *\param count number of values
+		 *\return the stream (for chaining).
+		 **/
+		template<typename T>
+		ByteStream& write( const T* values, size_t count );
+
+		/** Read an array of values stored in network byte order, converted in bulk.
+		 *\param values destination, of at least count values
+		 *\param count number of values
+		 *\return the stream (for chaining).
+		 **/
+		template<typename T>
+		ByteStream& read( T* values, size_t count );
+
+		/** Access the next bytes of the stream without copying them, and skip them.
+		 *\param size number of bytes
+		 *\return a pointer to the bytes, as stored (values written with << are in network byte order),
+		 * or nullptr if the stream is too short (and set valid flag to false).
+		 *\note The pointer is invalidated by writes to the stream.
+		 **/
+		inline const uint8*	view( size_t size );
 
 		/** \return true if the stream is opened and valid. */
 		operator bool( void ) const { return _valid; }
@@ -215,7 +255,7 @@ namespace sibr
 		/** \return the total number of bytes in the buffer used by the stream*/
 		inline size_t	bufferSize( void ) const;
 		/** \return a pointer to the buffer */
-		inline const uint8*	buffer( void ) const { return &_buffer[0]; }
+		inline const uint8*	buffer( void ) const { return _mapping ? _view : _buffer.data(); }
 
 		// We don't want to include network-related libs (and all their stuffs), so we use a custom implementation of htonl/htons, ntohl/ntohs.
 
@@ -255,6 +295,20 @@ namespace sibr
 		 **/
 		inline static uint16	ntohs( uint16 n );
 
+		/** Convert an array of values from host to network byte order, in place.
+		 *\param values the values
+		 *\param count number of values
+		 *\param valueSize size of each value in bytes: 1, 2, 4 or 8
+		 **/
+		static void		hton( void* values, size_t count, size_t valueSize );
+
+		/** Convert an array of values from network to host byte order, in place.
+		 *\param values the values
+		 *\param count number of values
+		 *\param valueSize size of each value in bytes: 1, 2, 4 or 8
+		 **/
+		inline static void	ntoh( void* values, size_t count, size_t valueSize );
+
 		/** \return true if the current system runs using Big Endian **/
 		static bool systemIsBigEndian( void );
 
@@ -271,10 +325,19 @@ namespace sibr
 		 *\param n the number of bytes to check
 		 *\return false if it fails (and set valid flag to false).
 		 **/
-		inline bool		testSize( uint n );
+		inline bool		testSize( size_t n );
+
+		/** \return the next byte to read. */
+		inline const uint8*	cursor( void ) const { return buffer() + _readPos; }
+
+		/** Copy the mapped bytes to the buffer and release the mapping, before a write. */
+		void		detach( void );
 
 		bytes		_buffer;	///< the whole stream
-		uint32		_readPos;   ///< Current position in the buffer when reading.
+		std::shared_ptr<const MappedFile>	_mapping;	///< Mapped file read instead of the buffer, if any.
+		const uint8*	_view = nullptr;	///< Mapped bytes.
+		size_t		_viewSize = 0;	///< Number of mapped bytes.
+		size_t		_readPos;   ///< Current position in the buffer when reading.
 		bool		_valid;		///< tells if no error occured when reading
 		// Endianness	_endianness;
 
@@ -285,7 +348,7 @@ namespace sibr
 			return bufferSize() - _readPos;
 		}
 		size_t	ByteStream::bufferSize( void ) const {
-			return _buffer.size();
+			return _mapping ? _viewSize : _buffer.size();
 		}
 
 		uint64	ByteStream::ntohll(uint64 n) {
@@ -297,7 +360,10 @@ namespace sibr
 		uint16	ByteStream::ntohs( uint16 n ) {
 			return htons(n);
 		}
-		bool		ByteStream::testSize( uint n ) {
+		void	ByteStream::ntoh( void* values, size_t count, size_t valueSize ) {
+			hton(values, count, valueSize);
+		}
+		bool		ByteStream::testSize( size_t n ) {
 			return (_valid = (_valid && (readableSize() >= n)));
 		}
 
@@ -310,7 +376,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( int8& i ) {
 			if (testSize(sizeof(i)))
 			{
-				i = *reinterpret_cast<int8*>(&_buffer[_readPos]);
+				i = *reinterpret_cast<const int8*>(cursor());
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -318,7 +384,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( int16& i ) {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohs(*reinterpret_cast<int16*>(&_buffer[_readPos]));
+				i = ntohs(*reinterpret_cast<const int16*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -327,7 +393,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( int32& i )  {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohl(*reinterpret_cast<int32*>(&_buffer[_readPos]));
+				i = ntohl(*reinterpret_cast<const int32*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -335,7 +401,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>(int64& i) {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohll(*reinterpret_cast<int64*>(&_buffer[_readPos]));
+				i = ntohll(*reinterpret_cast<const int64*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -344,7 +410,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( uint8& i )  {
 			if (testSize(sizeof(i)))
 			{
-				i = *reinterpret_cast<uint8*>(&_buffer[_readPos]);
+				i = *reinterpret_cast<const uint8*>(cursor());
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -352,7 +418,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( uint16& i ) {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohs(*reinterpret_cast<uint16*>(&_buffer[_readPos]));
+				i = ntohs(*reinterpret_cast<const uint16*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -360,7 +426,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( uint32& i ) {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohl(*reinterpret_cast<uint32*>(&_buffer[_readPos]));
+				i = ntohl(*reinterpret_cast<const uint32*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -368,7 +434,7 @@ namespace sibr
 		ByteStream& ByteStream::operator >>(uint64& i) {
 			if (testSize(sizeof(i)))
 			{
-				i = ntohll(*reinterpret_cast<uint64*>(&_buffer[_readPos]));
+				i = ntohll(*reinterpret_cast<const uint64*>(cursor()));
 				_readPos += sizeof(i);
 			}
 			return *this;
@@ -376,13 +442,10 @@ namespace sibr
 		ByteStream& ByteStream::operator >>( std::string& str ) {
 			uint32 size;
 			operator >> (size);
-			str.resize(size);
 
 			if (testSize(sizeof(char)*size))
 			{
-				str.insert(str.begin(), 
-					reinterpret_cast<char*>(&_buffer[_readPos]), 
-					reinterpret_cast<char*>(&_buffer[_readPos + size]));
+				str.assign(reinterpret_cast<const char*>(cursor()), size);
 				_readPos += sizeof(char)*size;
 			}
 			return *this;
@@ -406,6 +469,39 @@ namespace sibr
 			return *this;
 		}
 
+		const uint8*	ByteStream::view( size_t size ) {
+			if (!testSize(size))
+				return nullptr;
+			const uint8* bytes = cursor();
+			_readPos += size;
+			return bytes;
+		}
+
+		template<typename T>
+		ByteStream&	ByteStream::write( const T* values, size_t count ) {
+			static_assert(std::is_arithmetic<T>::value, "ByteStream only converts arithmetic values.");
+			if (count == 0)
+				return *this;
+			detach();
+			const size_t curpos = _buffer.size();
+			_buffer.resize(curpos + count * sizeof(T));
+			std::memcpy(&_buffer[curpos], values, count * sizeof(T));
+			hton(&_buffer[curpos], count, sizeof(T));
+			return *this;
+		}
+
+		template<typename T>
+		ByteStream&	ByteStream::read( T* values, size_t count ) {
+			static_assert(std::is_arithmetic<T>::value, "ByteStream only converts arithmetic values.");
+			if (testSize(count * sizeof(T)) && count > 0)
+			{
+				std::memcpy(values, cursor(), count * sizeof(T));
+				ntoh(values, count, sizeof(T));
+				_readPos += count * sizeof(T);
+			}
+			return *this;
+		}
+
 		// Function used to test this class (might be still useful to test future improvement)
 		/*
 		static void unitTestByteStream( void )
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include "core/system/ByteStreamWriter.hpp"
+
+namespace sibr
+{
+	ByteStreamWriter::ByteStreamWriter( size_t bufferSize ) :
+		_buffer(std::max(bufferSize, size_t(64)))
+	{
+	}
+
+	ByteStreamWriter::~ByteStreamWriter( void )
+	{
+		close();
+	}
+
+	bool ByteStreamWriter::open( const std::string& filename )
+	{
+		close();
+		_file.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		_used = 0;
+		_written = 0;
+		_valid = _file.is_open();
+		if (!_valid)
+			SIBR_WRG << "cannot write to the file '" << filename << "'." << std::endl;
+		return _valid;
+	}
+
+	bool ByteStreamWriter::close( void )
+	{
+		if (!_file.is_open())
+			return _valid;
+		flush();
+		_file.close();
+		_valid = _valid && !_file.fail();
+		return _valid;
+	}
+
+	void ByteStreamWriter::flush( void )
+	{
+		if (_used == 0 || !_file.is_open())
+			return;
+		_file.write(reinterpret_cast<const char*>(_buffer.data()), _used);
+		_valid = _valid && bool(_file);
+		_written += _used;
+		_used = 0;
+	}
+
+	void ByteStreamWriter::push( const void* data, size_t size )
+	{
+		if (_used + size > _buffer.size())
+		{
+			flush();
+			// Large blocks go directly to the file.
+			if (size >= _buffer.size())
+			{
+				if (_file.is_open())
+				{
+					_file.write(reinterpret_cast<const char*>(data), size);
+					_valid = _valid && bool(_file);
+				}
+				_written += size;
+				return;
+			}
+		}
+		std::memcpy(&_buffer[_used], data, size);
+		_used += size;
+	}
+
+	ByteStreamWriter& ByteStreamWriter::operator <<( const std::string& str )
+	{
+		operator <<(uint32(str.size()));
+		push(str.data(), str.size());
+		return *this;
+	}
+
+} // namespace sibr
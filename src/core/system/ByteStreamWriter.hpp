@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <algorithm>
+# include <fstream>
+# include <string>
+# include <vector>
+# include "core/system/ByteStream.hpp"
+
+/// Size of the buffer of a ByteStreamWriter, written to the file at once when full.
+# define SIBR_BYTESTREAMWRITER_BUFFERSIZE (size_t(8) << 20)
+
+namespace sibr
+{
+	/**
+	 Write a stream of bytes to a file while it is produced, with the same encoding as ByteStream
+	 (network byte order), so that large payloads are neither held in memory nor written in small pieces.
+
+	Code Example:
+
+		sibr::ByteStreamWriter writer;
+		if (writer.open("points.bin")) {
+			writer << uint64(points.size());
+			writer.write(&points[0][0], points.size() * 3);
+			writer.close();
+		}
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT ByteStreamWriter
+	{
+		SIBR_DISALLOW_COPY(ByteStreamWriter);
+
+	public:
+
+		/** Constructor.
+		 *\param bufferSize number of bytes accumulated before writing them to the file
+		 */
+		explicit ByteStreamWriter( size_t bufferSize = SIBR_BYTESTREAMWRITER_BUFFERSIZE );
+
+		/// Destructor, flushes and closes the file.
+		~ByteStreamWriter( void );
+
+		/** Create the file, truncated if it exists, closing any previous one.
+		 *\param filename path to the file
+		 *\return true if the file was opened
+		 */
+		bool open( const std::string& filename );
+
+		/** Flush and close the file.
+		 *\return true if all bytes were written
+		 */
+		bool close( void );
+
+		/** \return true if a file is open and no write failed. */
+		operator bool( void ) const { return _file.is_open() && _valid; }
+
+		/** \return the number of bytes written since the file was opened, including the buffered ones. */
+		uint64 writtenSize( void ) const { return _written + _used; }
+
+		/** Write the buffered bytes to the file. */
+		void flush( void );
+
+		/** Append raw bytes, as is.
+		 *\param data pointer to the data
+		 *\param size size in bytes
+		 **/
+		void push( const void* data, size_t size );
+
+		/** Write an array of values, in network byte order. The values are converted in the buffer, by blocks.
+		 *\param values the values
+		 *\param count number of values
+		 *\return the writer (for chaining).
+		 **/
+		template<typename T>
+		ByteStreamWriter& write( const T* values, size_t count );
+
+		/** Write a value, in network byte order.
+		 *\param value input value
+		 *\return the writer (for chaining).
+		 **/
+		template<typename T>
+		ByteStreamWriter& operator <<( T value ) { return write(&value, 1); }
+
+		/** Write a bool, as an 8bits-unsigned-integer.
+		 *\param b input value
+		 *\return the writer (for chaining).
+		 **/
+		ByteStreamWriter& operator <<( bool b ) { return operator <<(uint8(b)); }
+
+		/** Write a string, preceded by its 32bits size.
+		 *\param str input value
+		 *\return the writer (for chaining).
+		 **/
+		ByteStreamWriter& operator <<( const std::string& str );
+
+	private:
+
+		std::ofstream		_file; ///< Output file.
+		std::vector<uint8>	_buffer; ///< Bytes not written to the file yet.
+		size_t				_used = 0; ///< Number of used bytes in the buffer.
+		uint64				_written = 0; ///< Number of bytes written to the file.
+		bool				_valid = true; ///< No write failed.
+	};
+
+	///// DEFINITIONS /////
+
+	template<typename T>
+	ByteStreamWriter& ByteStreamWriter::write( const T* values, size_t count ) {
+		static_assert(std::is_arithmetic<T>::value, "ByteStreamWriter only converts arithmetic values.");
+		while (count > 0) {
+			if (_buffer.size() - _used < sizeof(T)) {
+				flush();
+			}
+			const size_t block = std::min(count, (_buffer.size() - _used) / sizeof(T));
+			std::memcpy(&_buffer[_used], values, block * sizeof(T));
+			ByteStream::hton(&_buffer[_used], block, sizeof(T));
+			_used += block * sizeof(T);
+			values += block;
+			count -= block;
+		}
+		return *this;
+	}
+
+} // namespace sibr
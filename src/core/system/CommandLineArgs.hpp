@@ -368,11 +368,14 @@ namespace sibr
 		Arg<int> win_width = { "width", 720, "initial window width" };
 		Arg<int> win_height = { "height", 480, "initial window height" };
 		Arg<int> vsync = { "vsync", 1, "enable vertical sync" };
+		Arg<int> frames_in_flight = { "frames-in-flight", 0, "maximum number of frames queued on the GPU, 1 for the lowest latency, 0 to let the driver decide" };
 		Arg<bool> fullscreen = { "fullscreen", "set the window to fullscreen" };
 		Arg<bool> hdpi = { "hd", "rescale UI elements for high-density screens" };
 		Arg<bool> no_gui = { "nogui", "do not use ImGui" };
 		Arg<bool> gl_debug = { "gldebug", "enable OpenGL error callback" };
 		Arg<bool> offscreen = { "offscreen", "do not open window" };
+		Arg<bool> headless = { "headless", "render without a display, through an EGL device context (implies offscreen)" };
+		Arg<int> headless_device = { "headless-device", 0, "index of the EGL device used in headless mode" };
 	};
 
 	/// Combination of window and application arguments.
@@ -387,6 +390,7 @@ namespace sibr
 		Arg<std::string> scene_metadata_filename = { "scene", "scene_metadata.txt", "scene metadata file" };
 		Arg<Vector2i> rendering_size = { "rendering-size", { 0, 0 }, "size at which rendering is performed" };
 		Arg<int> texture_width = { "texture-width", 0 , "size of the input data in memory"};
+		Arg<float> texture_budget = { "texture-budget", 0.0f, "fraction of the available video memory for the input textures, their size is reduced to fit (0: disabled)" };
 		Arg<float> texture_ratio = { "texture-ratio", 1.0f };
 		Arg<int> rendering_mode = { "rendering-mode", RENDERMODE_MONO, "select mono (0) or stereo (1) rendering mode" };
 		Arg<sibr::Vector3f> focal_pt = { "focal-pt", {0.0f, 0.0f, 0.0f} };
@@ -399,6 +403,8 @@ namespace sibr
 	struct SIBR_SYSTEM_EXPORT BasicDatasetArgs {
 		RequiredArg<std::string> dataset_path = { "path", "path to the dataset root" };
 		Arg<std::string> dataset_type = { "dataset_type", "", "type of dataset" };
+		Arg<bool> shared_cache = { "shared-cache", "share the decoded images and the proxy with the other viewers opening the dataset" };
+		Arg<bool> watch = { "watch", "reload the dataset files when they change on disk" };
 	};
 
 	/// "Default" set of arguments.
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/FileWatcher.hpp"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace sibr
+{
+	FileWatcher & FileWatcher::shared(void)
+	{
+		static FileWatcher watcher;
+		return watcher;
+	}
+
+	bool FileWatcher::stamp(const std::string & path, int64_t & time, uint64_t & size)
+	{
+		boost::system::error_code ec;
+		const boost::uintmax_t fileSize = boost::filesystem::file_size(path, ec);
+		if (ec) {
+			return false;
+		}
+		const std::time_t fileTime = boost::filesystem::last_write_time(path, ec);
+		if (ec) {
+			return false;
+		}
+		time = int64_t(fileTime);
+		size = uint64_t(fileSize);
+		return true;
+	}
+
+	FileWatcher::Id FileWatcher::watch(const std::string & path, const Callback & callback)
+	{
+		Watch watch;
+		watch.path = path;
+		watch.callback = callback;
+		stamp(path, watch.time, watch.size);
+		std::lock_guard<std::mutex> lock(_mutex);
+		const Id id = _nextId++;
+		_watches.emplace(id, std::move(watch));
+		return id;
+	}
+
+	void FileWatcher::unwatch(Id id)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_watches.erase(id);
+	}
+
+	void FileWatcher::interval(double seconds)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	}
+
+	size_t FileWatcher::count(void) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _watches.size();
+	}
+
+	void FileWatcher::poll(void)
+	{
+		std::vector<std::pair<Id, Watch>> watches;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const auto now = std::chrono::steady_clock::now();
+			if (_watches.empty() || now - _lastCheck < _interval) {
+				return;
+			}
+			_lastCheck = now;
+			watches.assign(_watches.begin(), _watches.end());
+		}
+
+		// The files are checked without the lock, the callbacks may watch other files.
+		std::vector<std::pair<Id, Watch>> modified;
+		for (auto & item : watches) {
+			Watch & watch = item.second;
+			int64_t time = 0;
+			uint64_t size = 0;
+			if (!stamp(watch.path, time, size)) {
+				// Removed, or being replaced: wait for the new file.
+				continue;
+			}
+			if (time == watch.time && size == watch.size) {
+				watch.pending = false;
+			}
+			else if (watch.pending && time == watch.pendingTime && size == watch.pendingSize) {
+				watch.time = time;
+				watch.size = size;
+				watch.pending = false;
+				modified.push_back(item);
+			}
+			else {
+				watch.pending = true;
+				watch.pendingTime = time;
+				watch.pendingSize = size;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const auto & item : watches) {
+				const auto it = _watches.find(item.first);
+				if (it == _watches.end()) {
+					continue;
+				}
+				it->second.time = item.second.time;
+				it->second.size = item.second.size;
+				it->second.pending = item.second.pending;
+				it->second.pendingTime = item.second.pendingTime;
+				it->second.pendingSize = item.second.pendingSize;
+			}
+		}
+
+		for (const auto & item : modified) {
+			// Skip the watches removed by a previous callback.
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_watches.find(item.first) == _watches.end()) {
+					continue;
+				}
+			}
+			SIBR_LOG << "Reloading " << item.second.path << std::endl;
+			item.second.callback(item.second.path);
+		}
+	}
+
+}
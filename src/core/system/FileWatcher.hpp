@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <chrono>
+# include <functional>
+# include <map>
+# include <mutex>
+# include <string>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Calls a function when a file is modified, to reload assets without restarting an application.
+	 Files are polled (modification time and size), at most every interval: a change is only reported
+	 once the file has stayed the same for a whole interval, so that files still being written, for
+	 instance by a training process, are not read half-way. The shared watcher is polled by sibr::Window
+	 once per frame, in swapBuffer, so its callbacks run on the main thread with the OpenGL context.
+
+	Code Example:
+
+		const sibr::FileWatcher::Id id = sibr::FileWatcher::shared().watch(meshPath, [this](const std::string & path) {
+			reloadMesh(path);
+		});
+		...
+		sibr::FileWatcher::shared().unwatch(id);
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT FileWatcher
+	{
+		SIBR_DISALLOW_COPY(FileWatcher);
+
+	public:
+
+		/// Watch identifier.
+		typedef uint64_t Id;
+
+		/// Called with the path of the modified file.
+		typedef std::function<void(const std::string &)> Callback;
+
+		/// Constructor.
+		FileWatcher(void) {}
+
+		/** \return the watcher polled by the windows. */
+		static FileWatcher & shared(void);
+
+		/** Watch a file, that may not exist yet.
+		 *\param path the file
+		 *\param callback the function called after each modification
+		 *\return the watch identifier
+		 *\note Thread safe.
+		 */
+		Id watch(const std::string & path, const Callback & callback);
+
+		/** Stop watching a file, the callback won't be called anymore.
+		 *\param id the watch identifier
+		 *\note Thread safe, but not from a callback of another watch.
+		 */
+		void unwatch(Id id);
+
+		/** Check the files if the interval has elapsed since the last check, and call the callbacks of the
+		 * files modified and stable since. The callbacks are called on the calling thread.
+		 */
+		void poll(void);
+
+		/** Set the minimum time between two checks, 0.5s by default.
+		 *\param seconds the interval
+		 */
+		void interval(double seconds);
+
+		/** \return the number of watched files. */
+		size_t count(void) const;
+
+	private:
+
+		/// State of a watched file.
+		struct Watch {
+			std::string path; ///< Watched file.
+			Callback callback; ///< Modification callback.
+			int64_t time = 0; ///< Last reported modification time.
+			uint64_t size = 0; ///< Last reported size.
+			int64_t pendingTime = 0; ///< Modification time seen at the last check, not reported yet.
+			uint64_t pendingSize = 0; ///< Size seen at the last check, not reported yet.
+			bool pending = false; ///< Is a modification waiting to be stable.
+		};
+
+		/** Read the stamp of a file.
+		 *\param path the file
+		 *\param time will contain the modification time
+		 *\param size will contain the size
+		 *\return false if the file doesn't exist
+		 */
+		static bool stamp(const std::string & path, int64_t & time, uint64_t & size);
+
+		mutable std::mutex _mutex; ///< Protects the watches.
+		std::map<Id, Watch> _watches; ///< Watched files.
+		Id _nextId = 1; ///< Next watch identifier.
+		std::chrono::steady_clock::duration _interval = std::chrono::milliseconds(500); ///< Minimum time between checks.
+		std::chrono::steady_clock::time_point _lastCheck; ///< Last check.
+	};
+
+}
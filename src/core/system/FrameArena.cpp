@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include "core/system/FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace sibr
+{
+	FrameArena::FrameArena(size_t capacity)
+	{
+		grow(capacity);
+	}
+
+	FrameArena::~FrameArena(void)
+	{
+		for (const Chunk & chunk : _chunks) {
+			::operator delete(chunk.data);
+		}
+	}
+
+	FrameArena & FrameArena::frame(void)
+	{
+		static FrameArena arena;
+		return arena;
+	}
+
+	void FrameArena::reset(void)
+	{
+		if (_chunks.size() > 1) {
+			// Merge the chunks so that the next frames fit in one.
+			const size_t total = capacity();
+			for (const Chunk & chunk : _chunks) {
+				::operator delete(chunk.data);
+			}
+			_chunks.clear();
+			grow(total);
+		}
+#ifndef NDEBUG
+		// Make reads of stale frame memory visible.
+		std::memset(_chunks.back().data, 0xCD, std::min(_offset, _chunks.back().size));
+#endif
+		_offset = 0;
+		_used = 0;
+		_live = 0;
+	}
+
+	size_t FrameArena::capacity(void) const
+	{
+		size_t total = 0;
+		for (const Chunk & chunk : _chunks) {
+			total += chunk.size;
+		}
+		return total;
+	}
+
+	void FrameArena::grow(size_t size)
+	{
+		// Geometric growth, so that a large frame only needs a few chunks.
+		const size_t last = _chunks.empty() ? 0 : _chunks.back().size;
+		Chunk chunk;
+		chunk.size = std::max(std::max(size, size_t(4096)), 2 * last);
+		chunk.data = static_cast<char*>(::operator new(chunk.size));
+		_chunks.push_back(chunk);
+		_offset = 0;
+	}
+
+	void * FrameArena::do_allocate(size_t bytes, size_t alignment)
+	{
+		const Chunk * chunk = &_chunks.back();
+		uintptr_t start = (uintptr_t(chunk->data) + _offset + alignment - 1) & ~uintptr_t(alignment - 1);
+		if (start + bytes > uintptr_t(chunk->data) + chunk->size) {
+			grow(bytes + alignment);
+			chunk = &_chunks.back();
+			start = (uintptr_t(chunk->data) + alignment - 1) & ~uintptr_t(alignment - 1);
+		}
+		_offset = size_t(start + bytes - uintptr_t(chunk->data));
+		_used += bytes;
+		_peak = std::max(_peak, _used);
+		++_live;
+		return reinterpret_cast<void*>(start);
+	}
+
+	void FrameArena::do_deallocate(void * /*p*/, size_t /*bytes*/, size_t /*alignment*/)
+	{
+		// Memory is only recycled as a whole, early when nothing is allocated anymore.
+		if (_live > 0 && --_live == 0 && _chunks.size() == 1) {
+			_offset = 0;
+			_used = 0;
+		}
+	}
+
+} // namespace sibr
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <memory_resource>
+# include <vector>
+
+# include "core/system/Config.hpp"
+
+/// Initial capacity of the frame arena, in bytes.
+# define SIBR_FRAMEARENA_SIZE (size_t(1) << 20)
+
+namespace sibr
+{
+	/** Linear allocator for the temporaries of a frame, exposed as a std::pmr::memory_resource.
+	 Allocations bump a pointer in a chunk; nothing is freed individually, all the memory is recycled
+	 at once when the frame ends (MultiViewManager resets frame() after rendering) or as soon as all
+	 the allocations have been released. When a frame needed several chunks, they are merged into a
+	 single one for the next frames, so that a steady render loop doesn't call malloc at all.
+
+	 Memory from the arena must not outlive the frame. frame() is meant for the main thread,
+	 the arena itself is not thread-safe.
+
+	Code Example:
+
+		sibr::FrameVector<int> selected(count, 0, &sibr::FrameArena::frame());
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT FrameArena : public std::pmr::memory_resource
+	{
+		SIBR_DISALLOW_COPY(FrameArena);
+
+	public:
+
+		/** Constructor.
+		 *\param capacity size of the first chunk, in bytes
+		 */
+		explicit FrameArena(size_t capacity = SIBR_FRAMEARENA_SIZE);
+
+		/// Destructor, releases the chunks.
+		~FrameArena(void);
+
+		/** \return the arena of the main thread frames. */
+		static FrameArena & frame(void);
+
+		/** Recycle all the memory handed out since the last reset. */
+		void reset(void);
+
+		/** \return the number of bytes handed out since the last reset. */
+		size_t used(void) const { return _used; }
+
+		/** \return the largest number of bytes handed out between two resets. */
+		size_t peak(void) const { return _peak; }
+
+		/** \return the total size of the chunks. */
+		size_t capacity(void) const;
+
+	private:
+
+		/// A block of memory carved by the arena.
+		struct Chunk {
+			char * data; ///< Start of the chunk.
+			size_t size; ///< Size of the chunk in bytes.
+		};
+
+		/** Allocate a new current chunk.
+		 *\param size minimal size of the chunk
+		 */
+		void grow(size_t size);
+
+		/** \copydoc std::pmr::memory_resource::do_allocate */
+		void * do_allocate(size_t bytes, size_t alignment) override;
+
+		/** \copydoc std::pmr::memory_resource::do_deallocate */
+		void do_deallocate(void * p, size_t bytes, size_t alignment) override;
+
+		/** \copydoc std::pmr::memory_resource::do_is_equal */
+		bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override { return this == &other; }
+
+		std::vector<Chunk> _chunks; ///< Chunks, the last one is the current one.
+		size_t _offset = 0; ///< Used bytes in the current chunk.
+		size_t _used = 0; ///< Bytes handed out since the last reset.
+		size_t _peak = 0; ///< Largest number of bytes handed out between two resets.
+		size_t _live = 0; ///< Number of allocations not released yet.
+	};
+
+	/// Vector allocated from a memory resource, typically FrameArena::frame().
+	template<typename T>
+	using FrameVector = std::pmr::vector<T>;
+
+} // namespace sibr
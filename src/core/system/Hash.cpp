@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include "core/system/Hash.hpp"
+#include "core/system/MappedFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+# include <intrin.h>
+#endif
+
+namespace sibr
+{
+	namespace
+	{
+		const uint64_t kPrime32 = 0x9E3779B1ull;
+		const uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+		const uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+
+		/// Size of the blocks sampled by fileFingerprint.
+		const size_t kSampleSize = size_t(64) << 10;
+
+		uint64_t splitMix64(uint64_t & state)
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		/// Full 64x64 bits product, folded to 64 bits.
+		uint64_t mulFold(uint64_t a, uint64_t b)
+		{
+#if defined(__SIZEOF_INT128__)
+			const unsigned __int128 product = (unsigned __int128)a * b;
+			return uint64_t(product) ^ uint64_t(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			uint64_t high;
+			const uint64_t low = _umul128(a, b, &high);
+			return low ^ high;
+#else
+			const uint64_t mask = 0xFFFFFFFFull;
+			const uint64_t lowLow = (a & mask) * (b & mask);
+			const uint64_t highLow = (a >> 32) * (b & mask);
+			const uint64_t lowHigh = (a & mask) * (b >> 32);
+			const uint64_t highHigh = (a >> 32) * (b >> 32);
+			const uint64_t cross = (lowLow >> 32) + (highLow & mask) + lowHigh;
+			const uint64_t upper = (highLow >> 32) + (cross >> 32) + highHigh;
+			const uint64_t lower = (cross << 32) | (lowLow & mask);
+			return lower ^ upper;
+#endif
+		}
+
+		uint64_t avalanche(uint64_t h)
+		{
+			h ^= h >> 37;
+			h *= 0x165667919E3779F9ull;
+			return h ^ (h >> 32);
+		}
+	}
+
+	std::string Hash128::toString(void) const
+	{
+		std::stringstream str;
+		str << std::hex << std::setfill('0') << std::setw(16) << high << std::setw(16) << low;
+		return str.str();
+	}
+
+	Hasher::Hasher(uint64_t seed)
+	{
+		uint64_t state = seed;
+		for (uint64_t & key : _secret) {
+			key = splitMix64(state);
+		}
+		for (int i = 0; i < kLanes; ++i) {
+			_acc[i] = i % 2 == 0 ? kPrime64a : kPrime64b;
+		}
+	}
+
+	void Hasher::accumulate(uint64_t * acc, const uint8_t * stripe, int index) const
+	{
+		// Kept branch-free on independent lanes: this loop is what gets vectorized.
+		uint64_t data[kLanes];
+		std::memcpy(data, stripe, kStripeSize);
+		const uint64_t * keys = _secret + index;
+		for (int i = 0; i < kLanes; ++i) {
+			const uint64_t keyed = data[i] ^ keys[i];
+			acc[i ^ 1] += data[i];
+			acc[i] += (keyed & 0xFFFFFFFFull) * (keyed >> 32);
+		}
+	}
+
+	void Hasher::scramble(uint64_t * acc) const
+	{
+		const uint64_t * keys = _secret + kStripesPerBlock;
+		for (int i = 0; i < kLanes; ++i) {
+			acc[i] = (acc[i] ^ (acc[i] >> 47) ^ keys[i]) * kPrime32;
+		}
+	}
+
+	void Hasher::consume(const uint8_t * data, size_t count)
+	{
+		for (size_t s = 0; s < count; ++s) {
+			accumulate(_acc, data + s * kStripeSize, _stripe);
+			if (++_stripe == kStripesPerBlock) {
+				scramble(_acc);
+				_stripe = 0;
+			}
+		}
+	}
+
+	void Hasher::update(const void * data, size_t size)
+	{
+		const uint8_t * bytes = static_cast<const uint8_t*>(data);
+		_length += size;
+		if (_buffered > 0) {
+			const size_t fill = std::min(size, kStripeSize - _buffered);
+			std::memcpy(_buffer + _buffered, bytes, fill);
+			_buffered += fill;
+			bytes += fill;
+			size -= fill;
+			if (_buffered < kStripeSize) {
+				return;
+			}
+			consume(_buffer, 1);
+			_buffered = 0;
+		}
+		// Whole stripes are read in place, only the remainder is buffered.
+		const size_t stripes = size / kStripeSize;
+		consume(bytes, stripes);
+		bytes += stripes * kStripeSize;
+		size -= stripes * kStripeSize;
+		if (size > 0) {
+			std::memcpy(_buffer, bytes, size);
+			_buffered = size;
+		}
+	}
+
+	void Hasher::update(const std::string & str)
+	{
+		update(str.data(), str.size());
+		updateValue(uint64_t(str.size()));
+	}
+
+	void Hasher::finalAccumulators(uint64_t * acc) const
+	{
+		std::memcpy(acc, _acc, sizeof(_acc));
+		if (_buffered > 0) {
+			// The padding is told apart from real zeros by the length, mixed in the digests.
+			uint8_t last[kStripeSize] = { 0 };
+			std::memcpy(last, _buffer, _buffered);
+			accumulate(acc, last, _stripe);
+		}
+	}
+
+	uint64_t Hasher::digest64(void) const
+	{
+		uint64_t acc[kLanes];
+		finalAccumulators(acc);
+		const uint64_t * keys = _secret + kStripesPerBlock + kLanes;
+		uint64_t h = _length * kPrime64a;
+		for (int i = 0; i < kLanes; i += 2) {
+			h += mulFold(acc[i] ^ keys[i], acc[i + 1] ^ keys[i + 1]);
+		}
+		return avalanche(h);
+	}
+
+	Hash128 Hasher::digest128(void) const
+	{
+		uint64_t acc[kLanes];
+		finalAccumulators(acc);
+		const uint64_t * keys = _secret + kStripesPerBlock + kLanes;
+		uint64_t low = _length * kPrime64a;
+		uint64_t high = ~(_length * kPrime64b);
+		for (int i = 0; i < kLanes; i += 2) {
+			low += mulFold(acc[i] ^ keys[i], acc[i + 1] ^ keys[i + 1]);
+			high += mulFold(acc[i] ^ keys[i + 1], acc[i + 1] + keys[i]);
+		}
+		Hash128 hash;
+		hash.low = avalanche(low);
+		hash.high = avalanche(high);
+		return hash;
+	}
+
+	uint64_t hash64(const void * data, size_t size, uint64_t seed)
+	{
+		Hasher hasher(seed);
+		hasher.update(data, size);
+		return hasher.digest64();
+	}
+
+	Hash128 hash128(const void * data, size_t size, uint64_t seed)
+	{
+		Hasher hasher(seed);
+		hasher.update(data, size);
+		return hasher.digest128();
+	}
+
+	bool hashFile(const std::string & path, Hash128 & hash)
+	{
+		MappedFile file;
+		if (!file.open(path)) {
+			return false;
+		}
+		file.prefetch();
+		Hasher hasher;
+		hasher.update(file.data(), file.size());
+		hash = hasher.digest128();
+		return true;
+	}
+
+	bool fileFingerprint(const std::string & path, Hash128 & fingerprint)
+	{
+		boost::system::error_code ec;
+		const uint64_t size = uint64_t(boost::filesystem::file_size(path, ec));
+		if (ec) {
+			return false;
+		}
+		const int64_t time = int64_t(boost::filesystem::last_write_time(path, ec));
+		if (ec) {
+			return false;
+		}
+
+		Hasher hasher;
+		hasher.updateValue(size);
+		hasher.updateValue(time);
+		if (size > 0) {
+			MappedFile file;
+			if (!file.open(path) || file.size() != size) {
+				return false;
+			}
+			if (size <= 3 * kSampleSize) {
+				hasher.update(file.data(), file.size());
+			}
+			else {
+				hasher.update(file.data(), kSampleSize);
+				hasher.update(file.data() + (size / 2 - kSampleSize / 2), kSampleSize);
+				hasher.update(file.data() + (size - kSampleSize), kSampleSize);
+			}
+		}
+		fingerprint = hasher.digest128();
+		return true;
+	}
+
+} // namespace sibr
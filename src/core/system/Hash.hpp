@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <string>
+# include <cstdint>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** 128-bit content hash, see Hasher.
+	 \ingroup sibr_system
+	*/
+	struct SIBR_SYSTEM_EXPORT Hash128
+	{
+		uint64_t low = 0; ///< Low 64 bits.
+		uint64_t high = 0; ///< High 64 bits.
+
+		/** \return the hash as 32 hexadecimal digits, to name cache files. */
+		std::string toString(void) const;
+
+		/** \return true if both hashes are equal. \param other the other hash */
+		bool operator==(const Hash128 & other) const { return low == other.low && high == other.high; }
+
+		/** \return true if the hashes differ. \param other the other hash */
+		bool operator!=(const Hash128 & other) const { return !(*this == other); }
+
+		/** \return true if this hash comes first, to use hashes as map keys. \param other the other hash */
+		bool operator<(const Hash128 & other) const { return high < other.high || (high == other.high && low < other.low); }
+	};
+
+	/** Fast non-cryptographic hash of a stream of bytes, to build the keys of the on-disk caches.
+	 The data is consumed by 64 bytes stripes in 8 independent 64-bit lanes (the XXH3 scheme: 32x32 bits
+	 multiplications mixed with a sliding secret), a structure that compilers map to SIMD instructions,
+	 so that hashing runs at memory speed. Results do not depend on how the data is split between calls
+	 to update(), but they are not compatible with the reference xxHash and may depend on the host
+	 byte order: keys are meant for caches written and read on the same kind of machine.
+
+	Code Example:
+
+		sibr::Hasher hasher;
+		hasher.update(shaderSource);
+		hasher.update(&options, sizeof(options));
+		const std::string name = hasher.digest128().toString() + ".bin";
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT Hasher
+	{
+	public:
+
+		/** Constructor.
+		 *\param seed different seeds give unrelated hashes of the same data
+		 */
+		explicit Hasher(uint64_t seed = 0);
+
+		/** Add bytes to the hashed stream.
+		 *\param data pointer to the bytes
+		 *\param size number of bytes
+		 */
+		void update(const void * data, size_t size);
+
+		/** Add a string to the hashed stream, followed by its size so that consecutive strings can't be confused.
+		 *\param str the string
+		 */
+		void update(const std::string & str);
+
+		/** Add a trivially copyable value to the hashed stream.
+		 *\param value the value
+		 */
+		template<typename T>
+		void updateValue(const T & value) { update(&value, sizeof(T)); }
+
+		/** \return the 64-bit hash of the bytes added so far. */
+		uint64_t digest64(void) const;
+
+		/** \return the 128-bit hash of the bytes added so far. */
+		Hash128 digest128(void) const;
+
+	private:
+
+		/// Number of 64-bit lanes of a stripe.
+		static const int kLanes = 8;
+		/// Number of stripes between two scrambles of the accumulators.
+		static const int kStripesPerBlock = 16;
+		/// Size of a stripe in bytes.
+		static const size_t kStripeSize = kLanes * sizeof(uint64_t);
+
+		/** Accumulate a stripe.
+		 *\param acc the accumulators
+		 *\param stripe kStripeSize bytes
+		 *\param index index of the stripe in its block
+		 */
+		void accumulate(uint64_t * acc, const uint8_t * stripe, int index) const;
+
+		/** Mix the accumulators at the end of a block. \param acc the accumulators */
+		void scramble(uint64_t * acc) const;
+
+		/** Consume whole stripes. \param data the stripes \param count number of stripes */
+		void consume(const uint8_t * data, size_t count);
+
+		/** Copy the accumulators, with the buffered bytes added. \param acc destination */
+		void finalAccumulators(uint64_t * acc) const;
+
+		uint64_t _secret[kLanes + kStripesPerBlock + 8]; ///< Keys, derived from the seed.
+		uint64_t _acc[kLanes]; ///< Accumulators.
+		uint8_t _buffer[kStripeSize]; ///< Bytes of an incomplete stripe.
+		size_t _buffered = 0; ///< Number of bytes in the buffer.
+		int _stripe = 0; ///< Index of the next stripe in the current block.
+		uint64_t _length = 0; ///< Total number of bytes added.
+	};
+
+	/** Hash a buffer.
+	 *\param data pointer to the bytes
+	 *\param size number of bytes
+	 *\param seed hash seed
+	 *\return the 64-bit hash
+	 *\ingroup sibr_system
+	 */
+	SIBR_SYSTEM_EXPORT uint64_t hash64(const void * data, size_t size, uint64_t seed = 0);
+
+	/** Hash a buffer.
+	 *\param data pointer to the bytes
+	 *\param size number of bytes
+	 *\param seed hash seed
+	 *\return the 128-bit hash
+	 *\ingroup sibr_system
+	 */
+	SIBR_SYSTEM_EXPORT Hash128 hash128(const void * data, size_t size, uint64_t seed = 0);
+
+	/** Hash the whole content of a file, read through a memory mapping.
+	 *\param path the file
+	 *\param hash will contain the hash
+	 *\return false if the file can't be read
+	 *\ingroup sibr_system
+	 */
+	SIBR_SYSTEM_EXPORT bool hashFile(const std::string & path, Hash128 & hash);
+
+	/** Cheap identity of a file version, the standard key to check that a cache is up to date with its source:
+	 hashes the size, the last write time and a few sampled blocks (start, middle and end) of the content,
+	 so that it costs a few page reads even for multi-GB files. Use hashFile when edits that keep the size
+	 and the date have to be detected.
+	 *\param path the file
+	 *\param fingerprint will contain the key
+	 *\return false if the file doesn't exist or can't be read
+	 *\ingroup sibr_system
+	 */
+	SIBR_SYSTEM_EXPORT bool fileFingerprint(const std::string & path, Hash128 & fingerprint);
+
+} // namespace sibr
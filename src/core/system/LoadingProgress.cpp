@@ -12,44 +12,149 @@
 
 
 #include "core/system/LoadingProgress.hpp"
+#include <algorithm>
 
 namespace sibr
 {
+	namespace
+	{
+		/// Live progress bars, in creation order, for snapshots().
+		std::vector<LoadingProgress*> & registry( void )
+		{
+			static std::vector<LoadingProgress*> progresses;
+			return progresses;
+		}
+
+		std::mutex & registryMutex( void )
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+	}
 
 	LoadingProgress::LoadingProgress( size_t maxIteration,
 		const std::string& status, float interval )
-		: _currentStep(0), _maxProgress(maxIteration), _status(status), _interval(interval)
+		: LoadingProgress(nullptr, 0, maxIteration, status, interval)
 	{
-		_lastReport = clock::now();
 	}
 
-	void				LoadingProgress::walk( size_t step )
+	LoadingProgress::LoadingProgress( LoadingProgress& parent, size_t parentSteps,
+		size_t maxIteration, const std::string& status )
+		: LoadingProgress(&parent, parentSteps, maxIteration, status, parent.interval())
 	{
-		std::lock_guard<std::mutex> l(_mutex);
+	}
 
-		_currentStep += step;
-		if (std::chrono::duration<float>(clock::now()-_lastReport).count() >= _interval
-			|| _currentStep >= _maxProgress)
+	LoadingProgress::LoadingProgress( LoadingProgress* parent, size_t parentSteps,
+		size_t maxIteration, const std::string& status, float interval )
+		: _currentStep(0), _maxProgress(maxIteration), _status(status), _interval(interval),
+		_lastReport(clock::now().time_since_epoch().count()), _parent(parent), _parentSteps(parentSteps)
+	{
+		// Registered last, snapshots() reads the parent as soon as the task is listed.
+		std::lock_guard<std::mutex> l(registryMutex());
+		registry().push_back(this);
+	}
+
+	LoadingProgress::~LoadingProgress( void )
+	{
 		{
-			report();
-			_lastReport = clock::now();
+			std::lock_guard<std::mutex> l(registryMutex());
+			std::vector<LoadingProgress*> & progresses = registry();
+			progresses.erase(std::remove(progresses.begin(), progresses.end(), this), progresses.end());
+		}
+		// A sub-task stopped early still accounts for its whole share of the parent.
+		if (_parent) {
+			const size_t done = parentShare(_currentStep.load());
+			if (done < _parentSteps) {
+				_parent->walk(_parentSteps - done);
+			}
+		}
+	}
+
+	void				LoadingProgress::walk( size_t step )
+	{
+		const size_t previous = _currentStep.fetch_add(step, std::memory_order_relaxed);
+		const size_t now = previous + step;
+
+		if (_parent) {
+			// Each sub-task step range maps to a disjoint range of parent steps, nothing is counted twice.
+			const size_t share = parentShare(now) - parentShare(previous);
+			if (share > 0) {
+				_parent->walk(share);
+			}
+			return;
 		}
 
+		const clock::rep stamp = clock::now().time_since_epoch().count();
+		const clock::rep interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(_interval.load())).count();
+		clock::rep last = _lastReport.load(std::memory_order_relaxed);
+		const bool finished = previous < _maxProgress && now >= _maxProgress;
+		// Only the thread that moves the report time forward prints, the others go on.
+		if (finished || (stamp - last >= interval && _lastReport.compare_exchange_strong(last, stamp))) {
+			_lastReport = stamp;
+			report();
+		}
 	}
 
 	float				LoadingProgress::current( void ) const
 	{
 		if (_maxProgress <= 0)
 			return 1.f;
-		return (float)_currentStep/(float)_maxProgress;
+		return std::min(1.f, (float)_currentStep.load()/(float)_maxProgress);
+	}
+
+	std::string			LoadingProgress::status( void ) const
+	{
+		std::lock_guard<std::mutex> l(_statusMutex);
+		return _status;
+	}
+
+	void				LoadingProgress::status( const std::string& message )
+	{
+		std::lock_guard<std::mutex> l(_statusMutex);
+		_status = message;
+	}
+
+	std::vector<LoadingProgress::Snapshot>	LoadingProgress::snapshots( void )
+	{
+		std::lock_guard<std::mutex> l(registryMutex());
+		const std::vector<LoadingProgress*> & progresses = registry();
+		std::vector<Snapshot> result;
+		result.reserve(progresses.size());
+		// Depth first, so that sub-tasks follow their parent.
+		const std::function<void(const LoadingProgress*)> visit = [&](const LoadingProgress* parent) {
+			for (const LoadingProgress* progress : progresses) {
+				if (progress->_parent == parent) {
+					result.push_back({ progress->status(), progress->current(), progress->depth() });
+					visit(progress);
+				}
+			}
+		};
+		visit(nullptr);
+		return result;
 	}
 
 	void				LoadingProgress::report( void ) const
 	{
-		if (_status.empty())
+		const std::string message = status();
+		if (message.empty())
 			SIBR_LOG << "Progression [ "<< current()*100.f <<"% ]" << std::endl;
 		else
-			SIBR_LOG << "Progression [ "<< current()*100.f <<"% ] - " << _status << std::endl;
+			SIBR_LOG << "Progression [ "<< current()*100.f <<"% ] - " << message << std::endl;
+	}
+
+	size_t				LoadingProgress::parentShare( size_t steps ) const
+	{
+		if (_maxProgress == 0)
+			return _parentSteps;
+		return std::min(steps, _maxProgress) * _parentSteps / _maxProgress;
+	}
+
+	int					LoadingProgress::depth( void ) const
+	{
+		int d = 0;
+		for (const LoadingProgress* p = _parent; p; p = p->_parent)
+			++d;
+		return d;
 	}
 
 } // namespace sibr
@@ -12,9 +12,11 @@
 
 #pragma once
 
+# include <atomic>
 # include <functional>
 # include <chrono>
 # include <mutex>
+# include <vector>
 # include "core/system//Config.hpp"
 
 
@@ -29,15 +31,32 @@ namespace sibr
 	/// 1) Instantiate just before a loop (for or while), providing
 	/// the max number of iterations.
 	/// 2) Call walk() once in a the loop.
+	///
+	/// walk() can be called from any number of threads: it only
+	/// increments an atomic counter, and the thread crossing the
+	/// report interval prints the report, the others never wait.
+	/// A sub-task forwards its progress to its parent as a share
+	/// of the parent iterations and does not print by itself.
+	/// Live progress bars can be listed with snapshots(), for
+	/// instance to display them in the GUI (see sibr::showLoadingProgress).
 	/// \ingroup sibr_system
 	///
 	class SIBR_SYSTEM_EXPORT LoadingProgress
 	{
+		SIBR_DISALLOW_COPY(LoadingProgress);
+
 	public:
 		typedef std::chrono::steady_clock						clock;
 		typedef clock::time_point								time_point;
 		typedef std::function<void (float, const std::string&)>	ExternalCallback;
 
+		/// State of a live progress bar.
+		struct Snapshot {
+			std::string	status;		///< Status message.
+			float		progress;	///< Progress in [0.0, 1.0].
+			int			depth;		///< 0 for top level tasks, 1 for their sub-tasks...
+		};
+
 		/** Create a progress bar.
 		\param maxIteration total number of iterations
 		\param status a message that will be inserted in next reports
@@ -46,34 +65,69 @@ namespace sibr
 		LoadingProgress( size_t maxIteration,
 			const std::string& status="", float interval=1.f );
 
+		/** Create a sub-task of a progress bar.
+		\param parent the parent task, should outlive this one
+		\param parentSteps number of iterations of the parent covered by this sub-task
+		\param maxIteration total number of iterations of the sub-task
+		\param status a message describing the sub-task
+		*/
+		LoadingProgress( LoadingProgress& parent, size_t parentSteps,
+			size_t maxIteration, const std::string& status="" );
+
+		/// Destructor. A sub-task completes its share of the parent.
+		~LoadingProgress( void );
+
 		/// Make the loading progress by the given number of steps.
+		/// Thread safe and lock free.
 		/// \param step number of steps
 		void				walk( size_t step = 1);
 		///	\return the current progress in a range [0.0, 1.0]
 		float				current( void ) const;
 
+		/// \return the state of the live progress bars, parents before their sub-tasks
+		static std::vector<Snapshot>	snapshots( void );
+
 		/// \return the time interval used
 		inline float				interval( void ) const;
 		/// Change the frequency of each report
 		/// \param interval the new step interval to use
 		inline void					interval( float interval );
 
-		/// \return the status message used
-		inline const std::string&	status( void ) const;
+		/// \return a copy of the status message used
+		std::string					status( void ) const;
 		/// Insert a message in printed reports
 		/// \param message the message to insert
-		inline void					status( const std::string& message );
+		void						status( const std::string& message );
 
 	private:
+		/** Initialize a task, registered only once fully set up.
+		\param parent the parent task, null for top level tasks
+		\param parentSteps number of iterations of the parent covered by this task
+		\param maxIteration total number of iterations
+		\param status a message that will be inserted in next reports
+		\param interval an interval of time between each report
+		*/
+		LoadingProgress( LoadingProgress* parent, size_t parentSteps,
+			size_t maxIteration, const std::string& status, float interval );
+
 		/// Print a report
 		void				report( void ) const;
 
-		size_t		_currentStep;	///< current number of iterations
-		size_t		_maxProgress;	///< number of iterations before reaching 100%
-		std::string	_status;		///< inserted into a report (you can update it)
-		float		_interval;		///< time interval before next report (sec)
-		time_point	_lastReport;	///< time point saved during the last report
-		std::mutex	_mutex;			///< used ot thread-safe this class (not heavly tested!)
+		/// \return the number of parent iterations covered by a number of steps
+		/// \param steps number of steps of this task
+		size_t				parentShare( size_t steps ) const;
+
+		/// \return the nesting depth of this task
+		int					depth( void ) const;
+
+		std::atomic<size_t>	_currentStep;	///< current number of iterations
+		size_t				_maxProgress;	///< number of iterations before reaching 100%
+		std::string			_status;		///< inserted into a report (you can update it)
+		std::atomic<float>	_interval;		///< time interval before next report (sec)
+		std::atomic<clock::rep>	_lastReport;	///< time point saved during the last report, in clock ticks
+		LoadingProgress*	_parent = nullptr;	///< parent task, null for top level tasks
+		size_t				_parentSteps = 0;	///< parent iterations covered by this sub-task
+		mutable std::mutex	_statusMutex;	///< protects the status message, never taken by walk()
 	};
 
 	///// DEFINITIONS /////
@@ -86,12 +140,4 @@ namespace sibr
 	}
 
 
-	const std::string&	LoadingProgress::status( void ) const {
-		return _status;
-	}
-	void				LoadingProgress::status( const std::string& message ) {
-		_status = message;
-	}
-
-
 } // namespace sibr
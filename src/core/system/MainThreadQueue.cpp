@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/MainThreadQueue.hpp"
+#include <chrono>
+
+namespace sibr
+{
+
+	MainThreadQueue & MainThreadQueue::shared(void)
+	{
+		static MainThreadQueue queue;
+		return queue;
+	}
+
+	void MainThreadQueue::post(std::function<void()> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(std::move(task));
+	}
+
+	size_t MainThreadQueue::run(double budgetMs)
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+		size_t count = 0;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			count = _tasks.size();
+		}
+
+		size_t ran = 0;
+		for (; ran < count; ++ran) {
+			if (budgetMs >= 0.0 && ran > 0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > budgetMs) {
+				break;
+			}
+			std::function<void()> task;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				task = std::move(_tasks.front());
+				_tasks.pop_front();
+			}
+			task();
+		}
+		return ran;
+	}
+
+	size_t MainThreadQueue::pending(void) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _tasks.size();
+	}
+
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <deque>
+# include <functional>
+# include <future>
+# include <memory>
+# include <mutex>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Tasks posted from any thread and run on the main thread, for work that needs the OpenGL context
+	 (uploads, buffer creation...) produced by background tasks. The shared queue is drained by
+	 sibr::Window once per frame, in swapBuffer.
+
+	Code Example:
+
+		sibr::ThreadPool::shared().push([mesh]() {
+			mesh->computeNormals();
+			sibr::MainThreadQueue::shared().post([mesh]() { mesh->forceBufferGLUpdate(); });
+		});
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT MainThreadQueue
+	{
+		SIBR_DISALLOW_COPY(MainThreadQueue);
+
+	public:
+
+		/// Constructor.
+		MainThreadQueue(void) {}
+
+		/** \return the process-wide queue. */
+		static MainThreadQueue & shared(void);
+
+		/** Queue a task.
+		 *\param task the task, should not throw
+		 */
+		void post(std::function<void()> task);
+
+		/** Queue a task and get a future on its result.
+		 *\param task the task
+		 *\return a future on the task result, or on the exception it threw
+		 *\note Do not wait on the future from the main thread before the queue is run.
+		 */
+		template<typename Task>
+		std::future<typename std::result_of<Task()>::type> submit(Task && task);
+
+		/** Run the queued tasks, on the calling thread.
+		 *\param budgetMs stop once this time is spent, to keep frames smooth; negative to run everything
+		 *\return the number of tasks run
+		 *\note Tasks posted while running are kept for the next call.
+		 */
+		size_t run(double budgetMs = -1.0);
+
+		/** \return the number of queued tasks. */
+		size_t pending(void) const;
+
+	private:
+
+		std::deque<std::function<void()>> _tasks; ///< Queued tasks.
+		mutable std::mutex _mutex; ///< Protects the tasks.
+	};
+
+	///// DEFINITIONS /////
+
+	template<typename Task>
+	std::future<typename std::result_of<Task()>::type> MainThreadQueue::submit(Task && task)
+	{
+		typedef typename std::result_of<Task()>::type Result;
+		const auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> result = packaged->get_future();
+		post([packaged]() { (*packaged)(); });
+		return result;
+	}
+
+} // namespace sibr
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <utility>
+#include "core/system/MappedFile.hpp"
+
+#ifdef SIBR_OS_WINDOWS
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+namespace sibr
+{
+	MappedFile::MappedFile(void)
+	{
+	}
+
+	MappedFile::MappedFile(const std::string & filename)
+	{
+		open(filename);
+	}
+
+	MappedFile::MappedFile(MappedFile && other) noexcept
+	{
+		swap(other);
+	}
+
+	MappedFile & MappedFile::operator=(MappedFile && other) noexcept
+	{
+		if (this != &other) {
+			close();
+			swap(other);
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile(void)
+	{
+		close();
+	}
+
+	void MappedFile::swap(MappedFile & other)
+	{
+		std::swap(_data, other._data);
+		std::swap(_size, other._size);
+		std::swap(_opened, other._opened);
+		std::swap(_writable, other._writable);
+#ifdef SIBR_OS_WINDOWS
+		std::swap(_file, other._file);
+		std::swap(_mapping, other._mapping);
+#else
+		std::swap(_fd, other._fd);
+#endif
+	}
+
+#ifdef SIBR_OS_WINDOWS
+
+	bool MappedFile::open(const std::string & filename, bool copyOnWrite)
+	{
+		close();
+
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+		_file = file;
+		_size = size_t(fileSize.QuadPart);
+		_opened = true;
+
+		// Empty files can't be mapped, but are still valid.
+		if (_size == 0) {
+			return true;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		_mapping = mapping;
+		_data = static_cast<const char*>(MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+		if (_data == nullptr) {
+			close();
+			return false;
+		}
+		_writable = copyOnWrite;
+		return true;
+	}
+
+	bool MappedFile::create(const std::string & filename, size_t size, bool deleteOnClose)
+	{
+		close();
+
+		const DWORD flags = FILE_ATTRIBUTE_NORMAL | (deleteOnClose ? FILE_FLAG_DELETE_ON_CLOSE : 0);
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+			CREATE_ALWAYS, flags, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		_file = file;
+		_size = size;
+		_opened = true;
+		_writable = true;
+
+		if (_size == 0) {
+			return true;
+		}
+
+		// The mapping extends the file to the requested size.
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+			DWORD(uint64_t(size) >> 32), DWORD(uint64_t(size) & 0xFFFFFFFFu), NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		_mapping = mapping;
+		_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		if (_data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close(void)
+	{
+		if (_data) {
+			UnmapViewOfFile(_data);
+		}
+		if (_mapping) {
+			CloseHandle(static_cast<HANDLE>(_mapping));
+		}
+		if (_file) {
+			CloseHandle(static_cast<HANDLE>(_file));
+		}
+		_data = nullptr;
+		_mapping = nullptr;
+		_file = nullptr;
+		_size = 0;
+		_opened = false;
+		_writable = false;
+	}
+
+	void MappedFile::prefetch(void) const
+	{
+		// FILE_FLAG_SEQUENTIAL_SCAN is already passed at opening, which enables read-ahead.
+	}
+
+#else
+
+	bool MappedFile::open(const std::string & filename, bool copyOnWrite)
+	{
+		close();
+
+		const int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		_fd = fd;
+		_size = size_t(st.st_size);
+		_opened = true;
+
+		// Empty files can't be mapped, but are still valid.
+		if (_size == 0) {
+			return true;
+		}
+
+		void * ptr = mmap(nullptr, _size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) {
+			close();
+			return false;
+		}
+		_data = static_cast<const char*>(ptr);
+		_writable = copyOnWrite;
+		return true;
+	}
+
+	bool MappedFile::create(const std::string & filename, size_t size, bool deleteOnClose)
+	{
+		close();
+
+		const int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0) {
+			return false;
+		}
+		// The file stays accessible through the descriptor until it is closed.
+		if (deleteOnClose) {
+			::unlink(filename.c_str());
+		}
+		if (ftruncate(fd, off_t(size)) != 0) {
+			::close(fd);
+			return false;
+		}
+		_fd = fd;
+		_size = size;
+		_opened = true;
+		_writable = true;
+
+		if (_size == 0) {
+			return true;
+		}
+
+		void * ptr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED) {
+			close();
+			return false;
+		}
+		_data = static_cast<const char*>(ptr);
+		return true;
+	}
+
+	void MappedFile::close(void)
+	{
+		if (_data) {
+			munmap(const_cast<char*>(_data), _size);
+		}
+		if (_fd >= 0) {
+			::close(_fd);
+		}
+		_data = nullptr;
+		_fd = -1;
+		_size = 0;
+		_opened = false;
+		_writable = false;
+	}
+
+	void MappedFile::prefetch(void) const
+	{
+		if (_data) {
+			madvise(const_cast<char*>(_data), _size, MADV_WILLNEED);
+		}
+	}
+
+#endif
+
+} // namespace sibr
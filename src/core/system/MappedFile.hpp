@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <string>
+# include <cstdint>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Read-only memory mapping of a file on disk.
+	 The whole file is mapped at once; pages are brought in by the OS on access,
+	 which avoids the intermediate copy of a std::ifstream::read for large binary assets.
+	 The mapping is released on destruction.
+	 A writable mapping of a new file can be created instead, to hold data larger than the
+	 available memory: the OS writes pages back to the file and evicts them as needed.
+	 An existing file can also be mapped copy-on-write: its pages are shared with the other
+	 mappings of the file until modified, modifications are private and never written back.
+
+	Code Example:
+
+		sibr::MappedFile file;
+		if (file.open("model.ply")) {
+			const char * begin = file.data();
+			const size_t size = file.size();
+			...
+		}
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT MappedFile
+	{
+		SIBR_DISALLOW_COPY(MappedFile);
+
+	public:
+
+		/// Build an empty, unmapped file.
+		MappedFile(void);
+
+		/** Open and map the given file.
+		 *\param filename path to the file
+		 *\note Check isOpen() to know if the mapping succeeded.
+		 */
+		explicit MappedFile(const std::string & filename);
+
+		/** Move constructor.
+		 *\param other the mapping to take ownership of
+		 */
+		MappedFile(MappedFile && other) noexcept;
+
+		/** Move assignment.
+		 *\param other the mapping to take ownership of
+		 *\return a reference to the current object
+		 */
+		MappedFile & operator=(MappedFile && other) noexcept;
+
+		/// Destructor, unmaps the file.
+		~MappedFile(void);
+
+		/** Open and map the given file, closing any previous mapping.
+		 *\param filename path to the file
+		 *\param copyOnWrite map the file copy-on-write instead of read-only, see writableData
+		 *\return true if the file was successfully mapped
+		 */
+		bool open(const std::string & filename, bool copyOnWrite = false);
+
+		/** Create a file of the given size and map it for reading and writing, closing any previous mapping.
+		 *\param filename path to the file, truncated if it exists
+		 *\param size the size of the file, in bytes
+		 *\param deleteOnClose remove the file when the mapping is closed
+		 *\return true if the file was successfully mapped
+		 */
+		bool create(const std::string & filename, size_t size, bool deleteOnClose = false);
+
+		/** Unmap the file and release the underlying handles. */
+		void close(void);
+
+		/** \return true if a file is currently mapped. */
+		bool isOpen(void) const { return _opened; }
+
+		/** \return a pointer to the beginning of the mapped contents. */
+		const char * data(void) const { return _data; }
+
+		/** \return a pointer to the beginning of the mapped contents, nullptr if the mapping is read-only.
+		 * For a copy-on-write mapping, the modifications are not written to the file. */
+		char * writableData(void) { return _writable ? const_cast<char*>(_data) : nullptr; }
+
+		/** \return the size of the mapped file, in bytes. */
+		size_t size(void) const { return _size; }
+
+		/** Hint the OS that the whole mapping is going to be accessed soon, so pages can be read ahead. */
+		void prefetch(void) const;
+
+	private:
+
+		void swap(MappedFile & other);
+
+		const char * _data = nullptr; ///< Mapped contents.
+		size_t _size = 0; ///< Size of the file in bytes.
+		bool _opened = false; ///< Is a file currently opened (it can be empty).
+		bool _writable = false; ///< Was the file created as a writable mapping, or opened copy-on-write.
+#ifdef SIBR_OS_WINDOWS
+		void * _file = nullptr; ///< Win32 file handle.
+		void * _mapping = nullptr; ///< Win32 file mapping handle.
+#else
+		int _fd = -1; ///< POSIX file descriptor.
+#endif
+	};
+
+} // namespace sibr
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "core/system/ResourcePack.hpp"
+#include "core/system/Utils.hpp"
+
+namespace sibr
+{
+	namespace {
+
+		const char kMagic[8] = { 'S', 'I', 'B', 'R', 'P', 'A', 'C', 'K' };
+		const uint32_t kVersion = 1;
+
+		/// Header of an entry, followed by its name.
+		struct EntryHeader {
+			uint64_t offset;
+			uint64_t size;
+			uint32_t nameLength;
+		};
+		const size_t kEntryHeaderSize = 2 * sizeof(uint64_t) + sizeof(uint32_t);
+	}
+
+	ResourcePack & ResourcePack::global(void)
+	{
+		static ResourcePack pack;
+		static const bool opened = [] {
+			const std::string filename = getInstallDirectory() + "/sibr_resources.pack";
+			if (!fileExists(filename)) {
+				return false;
+			}
+			if (!pack.open(filename)) {
+				SIBR_WRG << "[ResourcePack] Can't read " << filename << ", using the files on disk." << std::endl;
+				return false;
+			}
+			SIBR_LOG << "[ResourcePack] Using " << pack._entries.size() << " files from " << filename << "." << std::endl;
+			return true;
+		}();
+		(void)opened;
+		return pack;
+	}
+
+	bool ResourcePack::open(const std::string & filename)
+	{
+		_entries.clear();
+		_directories.clear();
+		if (!_file.open(filename)) {
+			return false;
+		}
+
+		const char * data = _file.data();
+		const size_t size = _file.size();
+		uint32_t version = 0, count = 0;
+		if (size < sizeof(kMagic) + 2 * sizeof(uint32_t) || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+			_file.close();
+			return false;
+		}
+		std::memcpy(&version, data + sizeof(kMagic), sizeof(uint32_t));
+		std::memcpy(&count, data + sizeof(kMagic) + sizeof(uint32_t), sizeof(uint32_t));
+		if (version != kVersion) {
+			_file.close();
+			return false;
+		}
+
+		size_t cursor = sizeof(kMagic) + 2 * sizeof(uint32_t);
+		for (uint32_t i = 0; i < count; ++i) {
+			EntryHeader header;
+			if (cursor + kEntryHeaderSize > size) {
+				break;
+			}
+			std::memcpy(&header.offset, data + cursor, sizeof(uint64_t));
+			std::memcpy(&header.size, data + cursor + sizeof(uint64_t), sizeof(uint64_t));
+			std::memcpy(&header.nameLength, data + cursor + 2 * sizeof(uint64_t), sizeof(uint32_t));
+			cursor += kEntryHeaderSize;
+			if (cursor + header.nameLength > size || header.offset > size || header.size > size - header.offset) {
+				break;
+			}
+			const std::string name(data + cursor, header.nameLength);
+			cursor += header.nameLength;
+			_entries[name] = { size_t(header.offset), size_t(header.size) };
+			for (size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1)) {
+				_directories.insert(name.substr(0, slash));
+			}
+		}
+		if (_entries.size() != count) {
+			SIBR_WRG << "[ResourcePack] " << filename << " is truncated." << std::endl;
+			_entries.clear();
+			_directories.clear();
+			_file.close();
+			return false;
+		}
+		_installPrefix = normalize(getInstallDirectory()) + "/";
+		return true;
+	}
+
+	bool ResourcePack::find(const std::string & path, const char *& data, size_t & size) const
+	{
+		if (_entries.empty()) {
+			return false;
+		}
+		const auto entry = _entries.find(normalize(path));
+		if (entry == _entries.end()) {
+			return false;
+		}
+		data = _file.data() + entry->second.offset;
+		size = entry->second.size;
+		return true;
+	}
+
+	bool ResourcePack::contains(const std::string & path) const
+	{
+		return !_entries.empty() && _entries.count(normalize(path)) > 0;
+	}
+
+	bool ResourcePack::containsDirectory(const std::string & path) const
+	{
+		return !_directories.empty() && _directories.count(normalize(path)) > 0;
+	}
+
+	bool ResourcePack::findInstalled(const std::string & path, const char *& data, size_t & size) const
+	{
+		if (_entries.empty()) {
+			return false;
+		}
+		const std::string normalized = normalize(path);
+		if (normalized.compare(0, _installPrefix.size(), _installPrefix) != 0) {
+			return false;
+		}
+		return find(normalized.substr(_installPrefix.size()), data, size);
+	}
+
+	bool ResourcePack::write(const std::string & filename, const std::string & root, const std::vector<std::string> & directories)
+	{
+		namespace fs = boost::filesystem;
+
+		std::vector<std::string> names;
+		for (const std::string & directory : directories) {
+			const fs::path base = fs::path(root) / directory;
+			if (!fs::is_directory(base)) {
+				SIBR_WRG << "[ResourcePack] No directory " << base.string() << "." << std::endl;
+				continue;
+			}
+			for (fs::recursive_directory_iterator it(base), end; it != end; ++it) {
+				if (fs::is_regular_file(it->path())) {
+					names.push_back(normalize(directory + "/" + fs::relative(it->path(), base).generic_string()));
+				}
+			}
+		}
+		std::sort(names.begin(), names.end());
+
+		std::vector<std::string> contents(names.size());
+		for (size_t i = 0; i < names.size(); ++i) {
+			std::ifstream file(root + "/" + names[i], std::ios::binary);
+			if (!file) {
+				SIBR_WRG << "[ResourcePack] Can't read " << names[i] << "." << std::endl;
+				return false;
+			}
+			contents[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		size_t offset = sizeof(kMagic) + 2 * sizeof(uint32_t);
+		for (const std::string & name : names) {
+			offset += kEntryHeaderSize + name.size();
+		}
+
+		std::ofstream pack(filename, std::ios::binary | std::ios::trunc);
+		if (!pack) {
+			SIBR_WRG << "[ResourcePack] Can't write " << filename << "." << std::endl;
+			return false;
+		}
+		const uint32_t count = uint32_t(names.size());
+		pack.write(kMagic, sizeof(kMagic));
+		pack.write(reinterpret_cast<const char*>(&kVersion), sizeof(uint32_t));
+		pack.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+		for (size_t i = 0; i < names.size(); ++i) {
+			const uint64_t entryOffset = offset;
+			const uint64_t entrySize = contents[i].size();
+			const uint32_t nameLength = uint32_t(names[i].size());
+			pack.write(reinterpret_cast<const char*>(&entryOffset), sizeof(uint64_t));
+			pack.write(reinterpret_cast<const char*>(&entrySize), sizeof(uint64_t));
+			pack.write(reinterpret_cast<const char*>(&nameLength), sizeof(uint32_t));
+			pack.write(names[i].data(), nameLength);
+			offset += contents[i].size();
+		}
+		for (const std::string & content : contents) {
+			pack.write(content.data(), content.size());
+		}
+		SIBR_LOG << "[ResourcePack] Wrote " << names.size() << " files to " << filename << "." << std::endl;
+		return bool(pack);
+	}
+
+	std::string ResourcePack::normalize(const std::string & path)
+	{
+		std::string normalized;
+		normalized.reserve(path.size());
+		size_t begin = 0;
+		while (begin <= path.size()) {
+			size_t end = path.find_first_of("/\\", begin);
+			if (end == std::string::npos) {
+				end = path.size();
+			}
+			const size_t length = end - begin;
+			if (length > 0 && !(length == 1 && path[begin] == '.')) {
+				if (!normalized.empty()) {
+					normalized += '/';
+				}
+				normalized.append(path, begin, length);
+			}
+			begin = end + 1;
+		}
+		return normalized;
+	}
+
+} // namespace sibr
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <string>
+# include <unordered_map>
+# include <unordered_set>
+# include <vector>
+
+# include "core/system/Config.hpp"
+# include "core/system/MappedFile.hpp"
+
+namespace sibr
+{
+	/** Read-only archive of shaders and resources, memory mapped.
+	 Files are stored by their path relative to the install directory ("shaders/core/copy.frag"),
+	 so that an install can ship a single pack instead of many small files, which is much faster
+	 to open at startup on network mounted locations. The pack next to the executables,
+	 sibr_resources.pack in the install directory, is opened on first use by global(); loadFile,
+	 getInstallSubDirectory and Resources look into it before the filesystem.
+
+	 A pack is built from an install directory with write():
+
+		sibr::ResourcePack::write(sibr::getInstallDirectory() + "/sibr_resources.pack",
+			sibr::getInstallDirectory(), { "shaders", "resources" });
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT ResourcePack
+	{
+		SIBR_DISALLOW_COPY(ResourcePack);
+
+	public:
+
+		/// Build an empty pack.
+		ResourcePack(void) = default;
+
+		/** \return the pack of the install directory, empty if there is none. */
+		static ResourcePack & global(void);
+
+		/** Map and index a pack file, closing any previous one.
+		 *\param filename path to the pack
+		 *\return false if the file can't be mapped or is not a pack
+		 */
+		bool open(const std::string & filename);
+
+		/** \return true if a pack is mapped. */
+		bool isOpen(void) const { return _file.isOpen(); }
+
+		/** Find a file of the pack.
+		 *\param path the path relative to the install directory
+		 *\param data will point to the mapped contents
+		 *\param size will contain the size of the file, in bytes
+		 *\return true if the pack contains the file
+		 */
+		bool find(const std::string & path, const char *& data, size_t & size) const;
+
+		/** \return true if the pack contains the file, path relative to the install directory. */
+		bool contains(const std::string & path) const;
+
+		/** \return true if the pack contains files in the directory, path relative to the install directory. */
+		bool containsDirectory(const std::string & path) const;
+
+		/** Find a file of the pack from an absolute path in the install directory.
+		 *\param path the absolute path
+		 *\param data will point to the mapped contents
+		 *\param size will contain the size of the file, in bytes
+		 *\return true if the path is in the install directory and the pack contains the file
+		 */
+		bool findInstalled(const std::string & path, const char *& data, size_t & size) const;
+
+		/** Write a pack with all the files of some directories.
+		 *\param filename path to the pack
+		 *\param root the directory the stored paths are relative to, usually the install directory
+		 *\param directories the directories to store, relative to root
+		 *\return false if a file can't be read or the pack written
+		 */
+		static bool write(const std::string & filename, const std::string & root, const std::vector<std::string> & directories);
+
+		/** Normalize a relative path: forward slashes, no empty nor "." components.
+		 *\param path the path
+		 *\return the normalized path
+		 */
+		static std::string normalize(const std::string & path);
+
+	private:
+
+		/// Location of a file in the mapping.
+		struct Entry {
+			size_t offset; ///< Offset of the contents.
+			size_t size; ///< Size of the contents, in bytes.
+		};
+
+		MappedFile _file; ///< Mapped pack.
+		std::unordered_map<std::string, Entry> _entries; ///< Files, by normalized relative path.
+		std::unordered_set<std::string> _directories; ///< All the directories holding files.
+		std::string _installPrefix; ///< Normalized install directory, with a trailing slash.
+	};
+
+} // namespace sibr
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/TaskGraph.hpp"
+
+namespace sibr
+{
+
+	TaskGraph::TaskGraph(ThreadPool & pool) :
+		_pool(pool)
+	{
+	}
+
+	TaskGraph::~TaskGraph(void)
+	{
+		// Tasks of an unfinished run still reference the graph.
+		wait();
+	}
+
+	TaskGraph::Node TaskGraph::add(std::function<void()> task, const std::vector<Node> & dependencies)
+	{
+		const Node node = _nodes.size();
+		_nodes.emplace_back(new NodeData());
+		_nodes.back()->task = std::move(task);
+		for (const Node dependency : dependencies) {
+			if (dependency >= node) {
+				SIBR_ERR << "[TaskGraph] Dependencies should be added before the tasks depending on them." << std::endl;
+			}
+			_nodes[dependency]->dependents.push_back(node);
+			++_nodes.back()->dependencies;
+		}
+		return node;
+	}
+
+	void TaskGraph::run(void)
+	{
+		if (_nodes.empty()) {
+			return;
+		}
+		_running = true;
+		_done = 0;
+		for (const auto & node : _nodes) {
+			node->remaining = node->dependencies;
+		}
+		for (Node node = 0; node < _nodes.size(); ++node) {
+			if (_nodes[node]->dependencies == 0) {
+				_pool.spawn([this, node]() { execute(node); });
+			}
+		}
+	}
+
+	void TaskGraph::wait(void)
+	{
+		while (!isDone()) {
+			if (!_pool.runOne(false)) {
+				std::this_thread::yield();
+			}
+		}
+		_running = false;
+	}
+
+	void TaskGraph::execute(Node node)
+	{
+		NodeData & data = *_nodes[node];
+		data.task();
+		for (const Node dependent : data.dependents) {
+			if (--_nodes[dependent]->remaining == 0) {
+				_pool.spawn([this, dependent]() { execute(dependent); });
+			}
+		}
+		++_done;
+	}
+
+}
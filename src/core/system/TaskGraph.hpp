@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <atomic>
+# include <functional>
+# include <memory>
+# include <vector>
+
+# include "core/system/Config.hpp"
+# include "core/system/ThreadPool.hpp"
+
+namespace sibr
+{
+	/** Set of tasks with dependencies, run on a ThreadPool.
+	 A task starts once all the tasks it depends on are done; independent tasks run concurrently.
+	 The graph can be run again once finished.
+
+	Code Example:
+
+		sibr::TaskGraph graph;
+		const auto load = graph.add([&]() { ... });
+		const auto normals = graph.add([&]() { ... }, { load });
+		const auto bounds = graph.add([&]() { ... }, { load });
+		graph.add([&]() { ... }, { normals, bounds });
+		graph.run();
+		graph.wait();
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT TaskGraph
+	{
+		SIBR_DISALLOW_COPY(TaskGraph);
+
+	public:
+
+		/// Identifies a task of the graph.
+		typedef size_t Node;
+
+		/** Constructor.
+		 *\param pool the threads running the tasks
+		 */
+		explicit TaskGraph(ThreadPool & pool = ThreadPool::shared());
+
+		/// Destructor, waits for the graph if it is running.
+		~TaskGraph(void);
+
+		/** Add a task.
+		 *\param task the task, should not throw
+		 *\param dependencies tasks that have to be done before this one starts
+		 *\return the new task
+		 *\note The graph should not be running.
+		 */
+		Node add(std::function<void()> task, const std::vector<Node> & dependencies = {});
+
+		/** Start the tasks without dependencies, the others follow as their dependencies complete. */
+		void run(void);
+
+		/** Block until all tasks are done, running pending fine-grained pool tasks meanwhile. */
+		void wait(void);
+
+		/** \return true if the graph is not running or all its tasks are done. */
+		bool isDone(void) const { return !_running || _done == _nodes.size(); }
+
+		/** \return the number of tasks. */
+		size_t size(void) const { return _nodes.size(); }
+
+	private:
+
+		/// A task and its links.
+		struct NodeData {
+			std::function<void()> task; ///< The task.
+			std::vector<Node> dependents; ///< Tasks waiting for this one.
+			int dependencies = 0; ///< Number of tasks this one waits for.
+			std::atomic<int> remaining = { 0 }; ///< Dependencies not done yet in the current run.
+		};
+
+		/** Run a task then start its dependents that became ready.
+		 *\param node the task
+		 */
+		void execute(Node node);
+
+		ThreadPool & _pool; ///< Threads running the tasks.
+		std::vector<std::unique_ptr<NodeData>> _nodes; ///< Tasks.
+		std::atomic<size_t> _done = { 0 }; ///< Tasks done in the current run.
+		bool _running = false; ///< Has the graph been run and not waited for.
+	};
+
+} // namespace sibr
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "core/system/Config.hpp"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace sibr
+{
+	/** Lightweight reader of whitespace separated values in a text buffer, usually a MappedFile.
+	 The buffer is never copied: the scanner is a pair of pointers, so a file can be split in lines
+	 once and the lines parsed concurrently. Unlike std::istream, no allocation or locking happens
+	 per value.
+
+	Code Example:
+
+		sibr::MappedFile file("images.txt");
+		sibr::TextScanner scanner(file.data(), file.data() + file.size());
+		sibr::TextScanner line;
+		while (scanner.nextLine(line)) {
+			int id; float x;
+			if (line.read(id) && line.read(x)) { ... }
+		}
+
+	 \ingroup sibr_system
+	*/
+	class TextScanner
+	{
+	public:
+
+		/// Build an empty scanner.
+		TextScanner(void) {}
+
+		/** Build a scanner over a range of characters.
+		 *\param begin first character
+		 *\param end past the last character
+		 */
+		TextScanner(const char * begin, const char * end) : _pos(begin), _end(end) {}
+
+		/** \return true if all characters have been consumed. */
+		bool atEnd(void) const { return _pos >= _end; }
+
+		/** \return the current position in the buffer. */
+		const char * position(void) const { return _pos; }
+
+		/** \return past the last character of the buffer. */
+		const char * end(void) const { return _end; }
+
+		/** \return the remaining characters as a string. */
+		std::string str(void) const { return std::string(_pos, _end); }
+
+		/** \return true if the first non blank character is the given one.
+		 *\param c the character to test, for instance a comment marker
+		 */
+		bool startsWith(char c) {
+			skipBlanks();
+			return _pos < _end && *_pos == c;
+		}
+
+		/** \return true if the remaining characters are only blanks. */
+		bool isBlank(void) {
+			skipBlanks();
+			return atEnd();
+		}
+
+		/** Skip spaces, tabs and carriage returns, but not line feeds. */
+		void skipBlanks(void) {
+			while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r')) {
+				++_pos;
+			}
+		}
+
+		/** Skip all whitespace characters, including line feeds. */
+		void skipSpaces(void) {
+			while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r' || *_pos == '\n')) {
+				++_pos;
+			}
+		}
+
+		/** Extract the next line, without its terminator, and move to the following one.
+		 *\param line will contain the line
+		 *\return false if there is no line left
+		 */
+		bool nextLine(TextScanner & line) {
+			if (atEnd()) {
+				return false;
+			}
+			const char * eol = static_cast<const char*>(std::memchr(_pos, '\n', size_t(_end - _pos)));
+			const char * lineEnd = eol ? eol : _end;
+			line = TextScanner(_pos, (lineEnd > _pos && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd);
+			_pos = eol ? eol + 1 : _end;
+			return true;
+		}
+
+		/** Split the remaining characters in lines.
+		 *\return the lines, empty ones included
+		 */
+		std::vector<TextScanner> lines(void) {
+			std::vector<TextScanner> result;
+			TextScanner line;
+			while (nextLine(line)) {
+				result.push_back(line);
+			}
+			return result;
+		}
+
+		/** Read the next whitespace separated token.
+		 *\param token will contain the token
+		 *\return false if no token is left
+		 */
+		bool token(std::string & token) {
+			const char * begin = nullptr;
+			const char * tokenEnd = nullptr;
+			if (!nextToken(begin, tokenEnd)) {
+				return false;
+			}
+			token.assign(begin, tokenEnd);
+			return true;
+		}
+
+		/** Read a floating point value.
+		 *\param value will contain the value
+		 *\return false if the next token is not a number
+		 */
+		bool read(double & value) {
+			const char * begin = nullptr;
+			const char * tokenEnd = nullptr;
+			if (!nextToken(begin, tokenEnd)) {
+				return false;
+			}
+			// Parsed in place, from_chars doesn't accept an explicit plus sign.
+			if (*begin == '+' && tokenEnd - begin > 1 && begin[1] != '-') {
+				++begin;
+			}
+			const std::from_chars_result result = std::from_chars(begin, tokenEnd, value);
+			return result.ec == std::errc() && result.ptr == tokenEnd;
+		}
+
+		/** Read a floating point value.
+		 *\param value will contain the value
+		 *\return false if the next token is not a number
+		 */
+		bool read(float & value) {
+			double parsed = 0.0;
+			if (!read(parsed)) {
+				return false;
+			}
+			value = float(parsed);
+			return true;
+		}
+
+		/** Read a signed integer.
+		 *\param value will contain the value
+		 *\return false if the next token is not an integer
+		 */
+		bool read(int & value) {
+			int64_t parsed = 0;
+			if (!readInteger(parsed)) {
+				return false;
+			}
+			value = int(parsed);
+			return true;
+		}
+
+		/** Read an unsigned integer.
+		 *\param value will contain the value
+		 *\return false if the next token is not an integer
+		 */
+		bool read(size_t & value) {
+			int64_t parsed = 0;
+			if (!readInteger(parsed) || parsed < 0) {
+				return false;
+			}
+			value = size_t(parsed);
+			return true;
+		}
+
+	private:
+
+		/** Locate the next token and move past it. */
+		bool nextToken(const char *& begin, const char *& tokenEnd) {
+			skipSpaces();
+			if (atEnd()) {
+				return false;
+			}
+			begin = _pos;
+			while (_pos < _end && *_pos != ' ' && *_pos != '\t' && *_pos != '\r' && *_pos != '\n') {
+				++_pos;
+			}
+			tokenEnd = _pos;
+			return true;
+		}
+
+		/** Parse a decimal integer token. */
+		bool readInteger(int64_t & value) {
+			const char * begin = nullptr;
+			const char * tokenEnd = nullptr;
+			if (!nextToken(begin, tokenEnd)) {
+				return false;
+			}
+			bool negative = false;
+			if (*begin == '-' || *begin == '+') {
+				negative = *begin == '-';
+				++begin;
+			}
+			if (begin == tokenEnd) {
+				return false;
+			}
+			int64_t result = 0;
+			for (const char * c = begin; c < tokenEnd; ++c) {
+				if (*c < '0' || *c > '9') {
+					return false;
+				}
+				result = 10 * result + int64_t(*c - '0');
+			}
+			value = negative ? -result : result;
+			return true;
+		}
+
+		const char * _pos = nullptr; ///< Current position.
+		const char * _end = nullptr; ///< Past the last character.
+	};
+
+} // namespace sibr
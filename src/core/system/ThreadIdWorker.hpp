@@ -44,6 +44,7 @@ namespace sibr
 		if (t.joinable())
 		t.join();
 
+	 \deprecated Use sibr::ThreadPool::shared().parallelFor, which reuses the pool threads.
 	 \ingroup sibr_system
 	*/
 	class /*SIBR_SYSTEM_EXPORT*/ ThreadIdWorker : public std::thread
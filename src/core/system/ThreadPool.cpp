@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/ThreadPool.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace sibr
+{
+	namespace
+	{
+		thread_local const ThreadPool * currentPool = nullptr; ///< Pool of the calling worker thread.
+		thread_local int currentIndex = -1; ///< Index of the calling worker thread in its pool.
+	}
+
+	ThreadPool::ThreadPool(uint threads)
+	{
+		const uint count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+		// One queue per worker, and a last one shared by the threads outside of the pool.
+		for (uint t = 0; t <= count; ++t) {
+			_locals.emplace_back(new LocalQueue());
+		}
+		for (uint t = 0; t < count; ++t) {
+			_workers.emplace_back(&ThreadPool::workerLoop, this, int(t));
+		}
+	}
+
+	ThreadPool::~ThreadPool(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+			_jobs = std::priority_queue<Job>();
+		}
+		_jobReady.notify_all();
+		for (std::thread & thread : _workers) {
+			thread.join();
+		}
+	}
+
+	ThreadPool & ThreadPool::shared(void)
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	void ThreadPool::push(std::function<void()> task, float priority)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push({ priority, _submitted++, std::move(task) });
+			++_queued;
+		}
+		_jobReady.notify_one();
+	}
+
+	void ThreadPool::spawn(std::function<void()> task)
+	{
+		LocalQueue & local = *_locals[currentWorker()];
+		{
+			std::lock_guard<std::mutex> lock(local.mutex);
+			local.tasks.push_back(std::move(task));
+			++_queued;
+		}
+		// Synchronize with the sleeping workers, so that the wake up is not lost.
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+		}
+		_jobReady.notify_one();
+	}
+
+	bool ThreadPool::runOne(bool background)
+	{
+		std::function<void()> task;
+		if (!pop(currentWorker(), task, background)) {
+			return false;
+		}
+		task();
+		return true;
+	}
+
+	void ThreadPool::parallelForRange(int begin, int end, int grain, const std::function<void(int, int)> & body)
+	{
+		const int count = end - begin;
+		if (count <= 0) {
+			return;
+		}
+		if (grain <= 0) {
+			// A few chunks per thread, so that stealing can balance uneven chunks.
+			grain = std::max(1, count / (4 * int(threadCount() + 1)));
+		}
+		const int chunks = (count + grain - 1) / grain;
+		if (chunks == 1) {
+			body(begin, end);
+			return;
+		}
+
+		// Chunks are claimed from a shared counter: helpers started after the last chunk is claimed do nothing,
+		// and the calling thread can always finish the range by itself.
+		// The first exception is kept for the calling thread, the chunks claimed after it are skipped.
+		struct Progress {
+			std::atomic<int> next = { 0 };
+			std::atomic<int> done = { 0 };
+			std::atomic<bool> failed = { false };
+			std::exception_ptr error;
+			std::mutex errorMutex;
+		};
+		const auto progress = std::make_shared<Progress>();
+		const std::function<void(int, int)> * bodyPtr = &body;
+		const auto work = [progress, bodyPtr, begin, end, grain, chunks]() {
+			for (int c = progress->next++; c < chunks; c = progress->next++) {
+				if (!progress->failed) {
+					try {
+						(*bodyPtr)(begin + c * grain, std::min(end, begin + (c + 1) * grain));
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> lock(progress->errorMutex);
+						if (!progress->error) {
+							progress->error = std::current_exception();
+						}
+						progress->failed = true;
+					}
+				}
+				++progress->done;
+			}
+		};
+
+		const int helpers = std::min(chunks - 1, int(threadCount()));
+		for (int h = 0; h < helpers; ++h) {
+			spawn(work);
+		}
+		work();
+
+		// Wait for the chunks claimed by the helpers, running other fine-grained tasks meanwhile.
+		while (progress->done < chunks) {
+			if (!runOne(false)) {
+				std::this_thread::yield();
+			}
+		}
+		if (progress->error) {
+			std::rethrow_exception(progress->error);
+		}
+	}
+
+	bool ThreadPool::isWorkerThread(void) const
+	{
+		return currentPool == this;
+	}
+
+	int ThreadPool::currentWorker(void) const
+	{
+		return currentPool == this ? currentIndex : int(_workers.size());
+	}
+
+	bool ThreadPool::pop(int worker, std::function<void()> & task, bool background)
+	{
+		{
+			LocalQueue & local = *_locals[worker];
+			std::lock_guard<std::mutex> lock(local.mutex);
+			if (!local.tasks.empty()) {
+				task = std::move(local.tasks.back());
+				local.tasks.pop_back();
+				--_queued;
+				return true;
+			}
+		}
+		if (background) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_jobs.empty()) {
+				// The top of a priority queue is const, the task is copied out before popping.
+				task = _jobs.top().task;
+				_jobs.pop();
+				--_queued;
+				return true;
+			}
+		}
+		const size_t queues = _locals.size();
+		for (size_t k = 1; k < queues; ++k) {
+			LocalQueue & victim = *_locals[(size_t(worker) + k) % queues];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				--_queued;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::workerLoop(int worker)
+	{
+		currentPool = this;
+		currentIndex = worker;
+		while (true) {
+			std::function<void()> task;
+			if (pop(worker, task, true)) {
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobReady.wait(lock, [this]() { return _stop || _queued > 0; });
+			if (_stop) {
+				return;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <atomic>
+# include <condition_variable>
+# include <deque>
+# include <functional>
+# include <future>
+# include <memory>
+# include <mutex>
+# include <queue>
+# include <thread>
+# include <vector>
+
+# include "core/system/Config.hpp"
+
+namespace sibr
+{
+	/** Work-stealing pool of threads.
+	 Two kinds of tasks are supported:
+	 - background tasks (push, submit) are started by decreasing priority, tasks of equal priority
+	   in submission order. Use them for loaders and other coarse, independent work;
+	 - fine-grained tasks (spawn, parallelFor, TaskGraph) go to the queue of the worker that created
+	   them and are stolen by idle workers, so nested parallel loops do not oversubscribe the machine.
+	 Workers run their own tasks first, then background tasks, then steal from the others.
+	 A process-wide pool is available through shared(), so that the subsystems share the same threads.
+
+	Code Example:
+
+		std::future<int> result = sibr::ThreadPool::shared().submit([]() { return 42; }, 1.0f);
+
+		sibr::ThreadPool::shared().parallelFor(0, int(values.size()), [&](int i) {
+			values[i] = std::sqrt(values[i]);
+		});
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT ThreadPool
+	{
+		SIBR_DISALLOW_COPY(ThreadPool);
+
+	public:
+
+		/** Constructor, starts the threads.
+		 *\param threads number of threads, 0 to use the hardware concurrency
+		 */
+		explicit ThreadPool(uint threads = 0);
+
+		/// Destructor, waits for the running tasks and drops the queued ones (their futures report a broken promise).
+		~ThreadPool(void);
+
+		/** \return the process-wide pool, created on first use. */
+		static ThreadPool & shared(void);
+
+		/** Queue a background task.
+		 *\param task the task to run
+		 *\param priority tasks with a higher priority are started first
+		 *\note The task should not throw, use submit to get exceptions back.
+		 */
+		void push(std::function<void()> task, float priority = 0.0f);
+
+		/** Queue a background task and get a future on its result.
+		 *\param task the task to run
+		 *\param priority tasks with a higher priority are started first
+		 *\return a future on the task result, or on the exception it threw
+		 */
+		template<typename Task>
+		std::future<typename std::result_of<Task()>::type> submit(Task && task, float priority = 0.0f);
+
+		/** Queue a fine-grained task, on the queue of the current worker if called from one of the pool threads.
+		 *\param task the task to run, should not throw
+		 */
+		void spawn(std::function<void()> task);
+
+		/** Run one queued task on the calling thread, if any. Waiting threads use it to help instead of blocking.
+		 *\param background can a background task be run, they are usually much longer than fine-grained ones
+		 *\return true if a task was run
+		 */
+		bool runOne(bool background = true);
+
+		/** Run a function over a range of indices, split in chunks processed by the pool threads and the calling thread.
+		 * Returns once the whole range has been processed. Can be nested.
+		 * If the body throws, the chunks not started yet are skipped and the first exception is rethrown here.
+		 *\param begin first index
+		 *\param end past the last index
+		 *\param grain number of indices per chunk, 0 to pick one from the range size and the thread count
+		 *\param body the function, called with the bounds [b, e) of each chunk
+		 */
+		void parallelForRange(int begin, int end, int grain, const std::function<void(int, int)> & body);
+
+		/** Run a function for each index of a range, see parallelForRange.
+		 *\param begin first index
+		 *\param end past the last index
+		 *\param body the function, called with each index
+		 *\param grain number of indices per chunk, 0 to pick one from the range size and the thread count
+		 */
+		template<typename Body>
+		void parallelFor(int begin, int end, const Body & body, int grain = 0);
+
+		/** \return the number of threads. */
+		uint threadCount(void) const { return uint(_workers.size()); }
+
+		/** \return the number of tasks not started yet. */
+		size_t pending(void) const { return _queued; }
+
+		/** \return true if the calling thread is one of the pool threads. */
+		bool isWorkerThread(void) const;
+
+	private:
+
+		/// A queued background task.
+		struct Job {
+			float priority; ///< Start priority.
+			uint64_t order; ///< Submission index, to keep the order between equal priorities.
+			std::function<void()> task; ///< The task.
+
+			/** \return true if the other job should start before this one. */
+			bool operator<(const Job & other) const {
+				return priority < other.priority || (priority == other.priority && order > other.order);
+			}
+		};
+
+		/// Fine-grained tasks of a worker, popped at the back by their owner and stolen at the front.
+		struct LocalQueue {
+			std::deque<std::function<void()>> tasks; ///< Queued tasks.
+			std::mutex mutex; ///< Protects the tasks.
+		};
+
+		/** Pop a task: from the queue of the given worker, then the background tasks, then the other workers.
+		 *\param worker index of the calling worker, see currentWorker
+		 *\param task will contain the task
+		 *\param background can a background task be popped
+		 *\return false if all queues are empty
+		 */
+		bool pop(int worker, std::function<void()> & task, bool background);
+
+		/// Pop and run tasks until stopped.
+		void workerLoop(int worker);
+
+		/** \return index of the calling worker in this pool, threadCount() (the shared queue) if not a pool thread. */
+		int currentWorker(void) const;
+
+		std::priority_queue<Job> _jobs; ///< Background tasks not started yet.
+		uint64_t _submitted = 0; ///< Number of background tasks submitted.
+		std::vector<std::unique_ptr<LocalQueue>> _locals; ///< Fine-grained tasks of each worker, then of the other threads.
+		std::atomic<size_t> _queued = { 0 }; ///< Number of tasks in all queues.
+		bool _stop = false; ///< Ask the workers to exit.
+		mutable std::mutex _mutex; ///< Protects the background tasks and the sleeping state.
+		std::condition_variable _jobReady; ///< Signaled when a task is queued or on stop.
+		std::vector<std::thread> _workers; ///< Worker threads.
+	};
+
+	///// DEFINITIONS /////
+
+	template<typename Task>
+	std::future<typename std::result_of<Task()>::type> ThreadPool::submit(Task && task, float priority)
+	{
+		typedef typename std::result_of<Task()>::type Result;
+		// std::function needs a copyable callable, the packaged task is shared.
+		const auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> result = packaged->get_future();
+		push([packaged]() { (*packaged)(); }, priority);
+		return result;
+	}
+
+	template<typename Body>
+	void ThreadPool::parallelFor(int begin, int end, const Body & body, int grain)
+	{
+		parallelForRange(begin, end, grain, [&body](int b, int e) {
+			for (int i = b; i < e; ++i) {
+				body(i);
+			}
+		});
+	}
+
+} // namespace sibr
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <algorithm>
+# include <type_traits>
+# include <vector>
+
+# include "core/system/Config.hpp"
+# include "core/system/AlignedAllocator.hpp"
+# include "core/system/Array2d.hpp"
+# include "core/system/ThreadPool.hpp"
+
+namespace sibr
+{
+	/** Per-pixel storage in square tiles, for stencil algorithms (diffusion, dilation, MRF unaries...):
+	 the neighbors of a pixel are in the same few cache lines instead of rows apart, whatever the map width.
+	 Each tile of TileSize x TileSize elements is stored contiguously, row by row, and tiles are
+	 stored row by row in a cache line aligned buffer. The dimensions are padded to whole tiles.
+	 Use tileRow for vectorized loops over the contiguous rows of a tile, and forEachTile
+	 to process tiles in parallel.
+
+	Code Example:
+
+		sibr::TiledArray2d<float> smoothed(w, h);
+		smoothed.parallelForEach([&](uint x, uint y, float & value) {
+			value = 0.25f * (src.clamped(x - 1, y) + src.clamped(x + 1, y) + src.clamped(x, y - 1) + src.clamped(x, y + 1));
+		});
+
+	 \ingroup sibr_system
+	*/
+	template<typename T, uint TileLog2 = 3>
+	class TiledArray2d
+	{
+		static_assert(!std::is_same<T, bool>::value, "TiledArray2d<bool> would be packed, use an integer type.");
+
+	public:
+
+		static const uint tileSize = 1u << TileLog2; ///< Tile side, in elements.
+		static const uint tileArea = tileSize * tileSize; ///< Number of elements per tile.
+
+		/** Constructor.
+		 *\param width the width
+		 *\param height the height
+		 *\param defaultValue initial value of the elements
+		 */
+		TiledArray2d(uint width = 0, uint height = 0, const T & defaultValue = T());
+
+		/** Constructor from a row-major array.
+		 *\param other the array to copy
+		 */
+		explicit TiledArray2d(const Array2d<T> & other);
+
+		/** \return the width. */
+		uint		w(void) const { return _width; }
+
+		/** \return the height. */
+		uint		h(void) const { return _height; }
+
+		/** \return the number of tiles per row. */
+		uint		tilesX(void) const { return _tilesX; }
+
+		/** \return the number of tile rows. */
+		uint		tilesY(void) const { return _tilesY; }
+
+		/** \return true if the array is empty. */
+		bool		empty(void) const { return _width == 0 || _height == 0; }
+
+		/** \return true if the coordinates are in the array. */
+		bool		isInRange(int x, int y) const { return x >= 0 && y >= 0 && uint(x) < _width && uint(y) < _height; }
+
+		/** Element index in the storage.
+		 *\param x column
+		 *\param y row
+		 *\return the index
+		 */
+		size_t		index(uint x, uint y) const {
+			const size_t tile = size_t(y >> TileLog2) * _tilesX + (x >> TileLog2);
+			return (tile << (2 * TileLog2)) + ((y & (tileSize - 1)) << TileLog2) + (x & (tileSize - 1));
+		}
+
+		/** Element access, without bounds check.
+		 *\param x column
+		 *\param y row
+		 *\return the element
+		 */
+		const T &	operator()(uint x, uint y) const { return _data[index(x, y)]; }
+
+		/** Element access, without bounds check.
+		 *\param x column
+		 *\param y row
+		 *\return the element
+		 */
+		T &			operator()(uint x, uint y) { return _data[index(x, y)]; }
+
+		/** Element access with coordinates clamped to the array, for stencils at the borders.
+		 *\param x column, can be out of the array
+		 *\param y row, can be out of the array
+		 *\return the closest element
+		 */
+		const T &	clamped(int x, int y) const {
+			return (*this)(uint(std::min(std::max(x, 0), int(_width) - 1)), uint(std::min(std::max(y, 0), int(_height) - 1)));
+		}
+
+		/** Tile access.
+		 *\param tx tile column
+		 *\param ty tile row
+		 *\return the tileArea elements of the tile, row by row
+		 */
+		const T *	tile(uint tx, uint ty) const { return _data.data() + ((size_t(ty) * _tilesX + tx) << (2 * TileLog2)); }
+
+		/** Tile access.
+		 *\param tx tile column
+		 *\param ty tile row
+		 *\return the tileArea elements of the tile, row by row
+		 */
+		T *			tile(uint tx, uint ty) { return _data.data() + ((size_t(ty) * _tilesX + tx) << (2 * TileLog2)); }
+
+		/** Row of a tile.
+		 *\param tx tile column
+		 *\param ty tile row
+		 *\param row row in the tile
+		 *\return the tileSize contiguous elements of the row, including padding on the right border
+		 */
+		T *			tileRow(uint tx, uint ty, uint row) { return tile(tx, ty) + (row << TileLog2); }
+
+		/** \copydoc tileRow */
+		const T *	tileRow(uint tx, uint ty, uint row) const { return tile(tx, ty) + (row << TileLog2); }
+
+		/** Set all elements, padding included.
+		 *\param value the value
+		 */
+		void		fill(const T & value) { std::fill(_data.begin(), _data.end(), value); }
+
+		/** Call body(tx, ty) for each tile, in parallel on a thread pool.
+		 *\param body the function
+		 *\param pool the threads
+		 */
+		template<typename Body>
+		void		forEachTile(const Body & body, ThreadPool & pool = ThreadPool::shared()) const;
+
+		/** Call body(x, y, value) for each element, tile by tile, tiles being processed in parallel.
+		 * Padding elements are skipped.
+		 *\param body the function
+		 *\param pool the threads
+		 */
+		template<typename Body>
+		void		parallelForEach(const Body & body, ThreadPool & pool = ThreadPool::shared());
+
+		/** \return a row-major copy. */
+		Array2d<T>	toArray2d(void) const;
+
+		/** \return the storage, tile by tile, padding included. */
+		const std::vector<T, AlignedAllocator<T>> &	vector(void) const { return _data; }
+
+	private:
+
+		uint		_width = 0; ///< Width.
+		uint		_height = 0; ///< Height.
+		uint		_tilesX = 0; ///< Number of tiles per row.
+		uint		_tilesY = 0; ///< Number of tile rows.
+		std::vector<T, AlignedAllocator<T>>	_data; ///< Elements, tile by tile.
+	};
+
+	///// DEFINITIONS /////
+
+	template<typename T, uint TileLog2>
+	TiledArray2d<T, TileLog2>::TiledArray2d(uint width, uint height, const T & defaultValue) :
+		_width(width), _height(height),
+		_tilesX((width + tileSize - 1) >> TileLog2), _tilesY((height + tileSize - 1) >> TileLog2),
+		_data(size_t(_tilesX) * _tilesY * tileArea, defaultValue)
+	{
+	}
+
+	template<typename T, uint TileLog2>
+	TiledArray2d<T, TileLog2>::TiledArray2d(const Array2d<T> & other) :
+		TiledArray2d(other.w(), other.h())
+	{
+		parallelForEach([&other](uint x, uint y, T & value) {
+			value = other.vector()[size_t(y) * other.w() + x];
+		});
+	}
+
+	template<typename T, uint TileLog2>
+	template<typename Body>
+	void TiledArray2d<T, TileLog2>::forEachTile(const Body & body, ThreadPool & pool) const
+	{
+		const uint tilesX = _tilesX;
+		pool.parallelFor(0, int(_tilesX * _tilesY), [&body, tilesX](int t) {
+			body(uint(t) % tilesX, uint(t) / tilesX);
+		});
+	}
+
+	template<typename T, uint TileLog2>
+	template<typename Body>
+	void TiledArray2d<T, TileLog2>::parallelForEach(const Body & body, ThreadPool & pool)
+	{
+		forEachTile([&](uint tx, uint ty) {
+			const uint x0 = tx << TileLog2;
+			const uint y0 = ty << TileLog2;
+			const uint xEnd = std::min(tileSize, _width - x0);
+			const uint yEnd = std::min(tileSize, _height - y0);
+			T * values = tile(tx, ty);
+			for (uint ly = 0; ly < yEnd; ++ly) {
+				T * row = values + (ly << TileLog2);
+				for (uint lx = 0; lx < xEnd; ++lx) {
+					body(x0 + lx, y0 + ly, row[lx]);
+				}
+			}
+		}, pool);
+	}
+
+	template<typename T, uint TileLog2>
+	Array2d<T> TiledArray2d<T, TileLog2>::toArray2d(void) const
+	{
+		Array2d<T> result(_width, _height);
+		result.parallelForEach([this](uint x, uint y, T & value) {
+			value = (*this)(x, y);
+		});
+		return result;
+	}
+
+} // namespace sibr
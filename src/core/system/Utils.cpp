@@ -12,10 +12,15 @@
 
 
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <fstream>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include "core/system/Utils.hpp"
+#include "core/system/ResourcePack.hpp"
+#include "core/system/ThreadPool.hpp"
 
 #ifdef SIBR_OS_WINDOWS 
 	#include <nfd.h>
@@ -77,6 +82,13 @@ namespace sibr
 
 	std::string	loadFile(const std::string& fname)
 	{
+		// Shaders and resources of the install directory may come from the pack.
+		const char * packed = nullptr;
+		size_t packedSize = 0;
+		if (ResourcePack::global().findInstalled(fname, packed, packedSize)) {
+			return std::string(packed, packedSize);
+		}
+
 		std::ifstream file(fname.c_str(), std::ios::binary);
 		if (!file || !file.is_open()) {
 			SIBR_ERR << "File not found: " << fname << std::endl;
@@ -321,7 +333,8 @@ namespace sibr
 #endif
 	}
 
-	SIBR_SYSTEM_EXPORT std::string getInstallDirectory()
+	/// \return the install directory, from the executable path.
+	static std::string findInstallDirectory()
 	{
 		char exePath[4095];
 
@@ -353,6 +366,13 @@ namespace sibr
 		return installDirectory;
 	}
 
+	SIBR_SYSTEM_EXPORT std::string getInstallDirectory()
+	{
+		// The executable doesn't move, only look for it once.
+		static const std::string installDirectory = findInstallDirectory();
+		return installDirectory;
+	}
+
 	SIBR_SYSTEM_EXPORT std::string getBinDirectory()
 	{
 		return getInstallSubDirectory("bin");
@@ -409,10 +429,22 @@ namespace sibr
 
 	SIBR_SYSTEM_EXPORT std::string getInstallSubDirectory(const std::string & subfolder)
 	{
+		// Resolved once, shaders directories are asked for each time a shader is loaded.
+		static std::mutex lock;
+		static std::unordered_map<std::string, std::string> resolved;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			const auto known = resolved.find(subfolder);
+			if (known != resolved.end()) {
+				return known->second;
+			}
+		}
+
 		std::string installDirectory = getInstallDirectory();
 		std::string installSubDirectory = installDirectory + "/" + subfolder;
 
-		if(!directoryExists(installSubDirectory))
+		// The pack stands for the directories it contains.
+		if(!ResourcePack::global().containsDirectory(subfolder) && !directoryExists(installSubDirectory))
 		{
 			// try subdirs GD LINUX issue
 			installSubDirectory = installDirectory + "/install/" + subfolder;
@@ -420,6 +452,8 @@ namespace sibr
 				SIBR_ERR << "Can't find subfolder " << subfolder << " in " << installDirectory << ". Please specify correct app folder as command-line option using --appPath option!" << std::endl;
 		}
 
+		std::lock_guard<std::mutex> guard(lock);
+		resolved[subfolder] = installSubDirectory;
 		return installSubDirectory;
 	}
 
@@ -494,4 +528,22 @@ namespace sibr
 #endif
 	}
 
+	void writeRecords(std::ostream & stream, size_t count, const std::function<std::string(size_t)> & format, size_t batch)
+	{
+		batch = std::max(batch, size_t(1));
+		std::vector<std::string> records(std::min(batch, count));
+		std::string text;
+		for (size_t first = 0; first < count; first += batch) {
+			const size_t num = std::min(batch, count - first);
+			ThreadPool::shared().parallelFor(0, int(num), [&](int r) {
+				records[r] = format(first + size_t(r));
+			});
+			text.clear();
+			for (size_t r = 0; r < num; ++r) {
+				text += records[r];
+			}
+			stream.write(text.data(), std::streamsize(text.size()));
+		}
+	}
+
 } // namespace sirb
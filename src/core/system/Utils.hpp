@@ -12,6 +12,8 @@
 
 #pragma once
 
+# include <functional>
+# include <ostream>
 # include <vector>
 # include "core/system/Config.hpp"
 # include "core/system/String.hpp"
@@ -155,5 +157,14 @@ namespace sibr
 
 	SIBR_SYSTEM_EXPORT std::istream& safeGetline(std::istream& is, std::string& t);
 
+	/** Write a large number of text records, such as camera lines, in order. Records are formatted in parallel
+	 by batches and each batch is written at once, so the output is produced incrementally.
+	\param stream the output stream
+	\param count the number of records
+	\param format returns the text of a record from its index, called concurrently
+	\param batch the number of records formatted before being written
+	*/
+	SIBR_SYSTEM_EXPORT void writeRecords(std::ostream & stream, size_t count, const std::function<std::string(size_t)> & format, size_t batch = 4096);
+
 	/*** @} */
 } // namespace sibr
@@ -13,6 +13,7 @@
 #pragma once
 
 # include <vector>
+# include <array>
 # include "core/system/Config.hpp"
 #include <functional>
 
@@ -241,7 +242,7 @@ namespace sibr
 		 *\return a reference to the corresponding value.
 		 */
 		T & multiAt(const std::vector<int> & ids) {
-			return this.at(ids.at(ids.size() - N)).multiAt(ids);
+			return this->at(ids.at(ids.size() - N)).multiAt(ids);
 		}
 
 		/** Getter
@@ -249,7 +250,7 @@ namespace sibr
 		 *\return a const reference to the corresponding value.
 		 */
 		const T & multiAt(const std::vector<int> & ids) const {
-			return this.at(ids.at(ids.size() - N)).multiAt(ids);
+			return this->at(ids.at(ids.size() - N)).multiAt(ids);
 		}
 
 		/** Get the size along each dimension.
@@ -280,8 +281,8 @@ namespace sibr
 		 */
 		void dimsRecur(std::vector<int> & v) const
 		{
-			v.push_back((int)this.size());
-			this.at(0).dimsRecur(v);
+			v.push_back((int)this->size());
+			this->at(0).dimsRecur(v);
 		}
 	};
 
@@ -317,7 +318,7 @@ namespace sibr
 		 *\return a reference to the corresponding value.
 		 */
 		T & multiAt(const std::vector<int> & ids) {
-			return this.at(ids.at(ids.size() - 1));
+			return this->at(ids.at(ids.size() - 1));
 		}
 
 		/** Getter
@@ -325,13 +326,13 @@ namespace sibr
 		 *\return a const reference to the corresponding value.
 		 */
 		const T & multiAt(const std::vector<int> & ids) const {
-			return this.at(ids.at(ids.size() - 1));
+			return this->at(ids.at(ids.size() - 1));
 		}
 
 		/**Print the size along each dimension.
 		 */
 		void dimsDisplay() const {
-			std::cout << " [ " << this.size() << " ] " << std::endl;
+			std::cout << " [ " << this->size() << " ] " << std::endl;
 		}
 
 	protected:
@@ -341,10 +342,323 @@ namespace sibr
 		 */
 		void dimsRecur(std::vector<int> & v) const
 		{
-			v.push_back((int)this.size());
+			v.push_back((int)this->size());
 		}
 
 	};
 
+	/** Non owning view of the last M dimensions of a FlatMultiVector, returned by its subscript operator.
+	 * Use a const T for a read only view.
+	\ingroup sibr_system
+	*/
+	template<typename T, unsigned int M>
+	class MultiVectorSlice
+	{
+	public:
+
+		/** Constructor.
+		 *\param data first element of the slice
+		 *\param dims size along each of the M dimensions
+		 *\param strides elements between two consecutive indices along each dimension
+		 */
+		MultiVectorSlice(T * data, const int * dims, const size_t * strides)
+			: _data(data), _dims(dims), _strides(strides) { }
+
+		/** Subscript along the first dimension of the slice.
+		 *\param i the index
+		 *\return the slice of the last M-1 dimensions
+		 */
+		MultiVectorSlice<T, M - 1> operator[](int i) const {
+			return MultiVectorSlice<T, M - 1>(_data + size_t(i) * _strides[0], _dims + 1, _strides + 1);
+		}
+
+		/** \return the size along the first dimension of the slice. */
+		size_t size() const { return size_t(_dims[0]); }
+
+	private:
+		T * _data;
+		const int * _dims;
+		const size_t * _strides;
+	};
+
+	/** Last dimension of a FlatMultiVector, its elements are contiguous.
+	\ingroup sibr_system
+	*/
+	template<typename T>
+	class MultiVectorSlice<T, 1>
+	{
+	public:
+
+		/// Constructor, see MultiVectorSlice.
+		MultiVectorSlice(T * data, const int * dims, const size_t *)
+			: _data(data), _dims(dims) { }
+
+		/** Subscript.
+		 *\param i the index
+		 *\return a reference to the element
+		 */
+		T & operator[](int i) const { return _data[i]; }
+
+		/** \return the number of elements. */
+		size_t size() const { return size_t(_dims[0]); }
+
+		/** \return the first element. */
+		T * begin() const { return _data; }
+
+		/** \return past the last element. */
+		T * end() const { return _data + _dims[0]; }
+
+	private:
+		T * _data;
+		const int * _dims;
+	};
+
+	/**
+	 * Multi dimensional array with the same indexing as MultiVector, stored in a single contiguous
+	 * allocation in row-major order (the last index is contiguous). Iterating over all elements with
+	 * begin() and end() follows the memory order.
+	 *
+	 *		FlatMultiVector<float, 3> weights({ camCount, h, w }, 0.0f);
+	 *		weights[cam][y][x] = 1.0f; // or weights(cam, y, x)
+	 *
+	 * All rows along a dimension have the same size, a ragged MultiVector can't be converted.
+	* \ingroup sibr_system
+	*/
+	template< typename T, unsigned int N >
+	class FlatMultiVector
+	{
+		static_assert(N >= 1, " FlatMultiVector<N> : the number of dimensions N must be >= 1 ");
+
+	public:
+
+		/// Constructor, empty along all dimensions.
+		FlatMultiVector() {
+			_dims.fill(0);
+			updateStrides();
+		}
+
+		/** Constructor.
+		 *\param n number of elements on each axis
+		 *\param t default value
+		 */
+		FlatMultiVector(int n, const T & t = T()) {
+			_dims.fill(n);
+			updateStrides();
+			_data.assign(_strides[0] * size_t(_dims[0]), t);
+		}
+
+		/** Constructor.
+		 *\param dims number of elements on each axis (only the last N ones are considered)
+		 *\param t default value
+		 */
+		FlatMultiVector(const std::vector<int> & dims, const T & t = T()) {
+			resize(dims, t);
+		}
+
+		/** Conversion from a nested vector, copying its elements.
+		 *\param other the vector, with the same size for all the rows along a dimension
+		 */
+		explicit FlatMultiVector(const MultiVector<T, N> & other) {
+			const std::vector<int> dims = other.empty() ? std::vector<int>(N, 0) : other.dims();
+			for (unsigned int d = 0; d < N; ++d) {
+				_dims[d] = d < dims.size() ? dims[d] : 0;
+			}
+			updateStrides();
+			_data.reserve(_strides[0] * size_t(_dims[0]));
+			append(other);
+		}
+
+		/** Change the size, the content is reset.
+		 *\param dims number of elements on each axis (only the last N ones are considered)
+		 *\param t value of all elements
+		 */
+		void resize(const std::vector<int> & dims, const T & t = T()) {
+			for (unsigned int d = 0; d < N; ++d) {
+				_dims[d] = dims.at(dims.size() - N + d);
+			}
+			updateStrides();
+			_data.assign(_strides[0] * size_t(_dims[0]), t);
+		}
+
+		/** Subscript along the first dimension.
+		 *\param i the index
+		 *\return the slice of the last N-1 dimensions, or the element if N is 1
+		 */
+		decltype(auto) operator[](int i) {
+			return MultiVectorSlice<T, N>(_data.data(), _dims.data(), _strides.data())[i];
+		}
+
+		/** Subscript along the first dimension.
+		 *\param i the index
+		 *\return the read only slice of the last N-1 dimensions, or the element if N is 1
+		 */
+		decltype(auto) operator[](int i) const {
+			return MultiVectorSlice<const T, N>(_data.data(), _dims.data(), _strides.data())[i];
+		}
+
+		/** Getter, without bounds checking.
+		 *\param ids N coordinates
+		 *\return a reference to the corresponding value.
+		 */
+		template<typename... Ids>
+		T & operator()(Ids... ids) {
+			return _data[offset(ids...)];
+		}
+
+		/** Getter, without bounds checking.
+		 *\param ids N coordinates
+		 *\return a const reference to the corresponding value.
+		 */
+		template<typename... Ids>
+		const T & operator()(Ids... ids) const {
+			return _data[offset(ids...)];
+		}
+
+		/** Getter
+		 *\param  ids N-d coordinates (only the last N ones are considered)
+		 *\return a reference to the corresponding value.
+		 */
+		T & multiAt(const std::vector<int> & ids) {
+			return _data.at(checkedOffset(ids));
+		}
+
+		/** Getter
+		 *\param  ids N-d coordinates (only the last N ones are considered)
+		 *\return a const reference to the corresponding value.
+		 */
+		const T & multiAt(const std::vector<int> & ids) const {
+			return _data.at(checkedOffset(ids));
+		}
+
+		/** Get the size along each dimension.
+		 *\return the N-d size
+		 **/
+		std::vector<int> dims() const {
+			return std::vector<int>(_dims.begin(), _dims.end());
+		}
+
+		/** \return the size along a dimension.
+		 *\param d the dimension
+		 */
+		int dim(unsigned int d) const { return _dims[d]; }
+
+		/** \return the elements between two consecutive indices along a dimension.
+		 *\param d the dimension
+		 */
+		size_t stride(unsigned int d) const { return _strides[d]; }
+
+		/** \return the total number of elements. */
+		size_t size() const { return _data.size(); }
+
+		/** \return true if there are no elements. */
+		bool empty() const { return _data.empty(); }
+
+		/** Set all elements.
+		 *\param t the value
+		 */
+		void fill(const T & t) { std::fill(_data.begin(), _data.end(), t); }
+
+		/** \return the contiguous elements. */
+		T * data() { return _data.data(); }
+
+		/** \return the contiguous elements. */
+		const T * data() const { return _data.data(); }
+
+		/** \return an iterator on the first element, in memory order. */
+		typename std::vector<T>::iterator begin() { return _data.begin(); }
+
+		/** \return an iterator past the last element. */
+		typename std::vector<T>::iterator end() { return _data.end(); }
+
+		/** \return an iterator on the first element, in memory order. */
+		typename std::vector<T>::const_iterator begin() const { return _data.begin(); }
+
+		/** \return an iterator past the last element. */
+		typename std::vector<T>::const_iterator end() const { return _data.end(); }
+
+		/**Print the size along each dimension.
+		 */
+		void dimsDisplay() const {
+			std::cout << " [ ";
+			for (unsigned int i = 0; i < N; ++i) {
+				std::cout << _dims[i] << (i != N - 1 ? " x " : "");
+			}
+			std::cout << " ] " << std::endl;
+		}
+
+	private:
+
+		/** Compute the row-major strides from the dimensions. */
+		void updateStrides() {
+			size_t stride = 1;
+			for (int d = int(N) - 1; d >= 0; --d) {
+				_strides[d] = stride;
+				stride *= size_t(std::max(_dims[d], 0));
+			}
+		}
+
+		/** \return the position of an element in the storage.
+		 *\param ids N coordinates
+		 */
+		template<typename... Ids>
+		size_t offset(Ids... ids) const {
+			static_assert(sizeof...(Ids) == N, " FlatMultiVector<N> : N coordinates are expected ");
+			const size_t coords[N] = { size_t(ids)... };
+			size_t position = 0;
+			for (unsigned int d = 0; d < N; ++d) {
+				position += coords[d] * _strides[d];
+			}
+			return position;
+		}
+
+		/** \return the position of an element in the storage, past the end if a coordinate is out of bounds.
+		 *\param ids N-d coordinates (only the last N ones are considered)
+		 */
+		size_t checkedOffset(const std::vector<int> & ids) const {
+			size_t position = 0;
+			for (unsigned int d = 0; d < N; ++d) {
+				const int id = ids.at(ids.size() - N + d);
+				if (id < 0 || id >= _dims[d]) {
+					return _data.size();
+				}
+				position += size_t(id) * _strides[d];
+			}
+			return position;
+		}
+
+		/** Check that a row of a nested vector has the size of its dimension.
+		 *\param v the row, spanning the last M dimensions
+		 */
+		template<unsigned int M>
+		void checkRow(const MultiVector<T, M> & v) const {
+			if (v.size() != size_t(_dims[N - M])) {
+				SIBR_ERR << "FlatMultiVector: can't convert a MultiVector with rows of different sizes." << std::endl;
+			}
+		}
+
+		/** Copy the elements of a nested vector, in row-major order.
+		 *\param v the vector
+		 */
+		template<unsigned int M>
+		void append(const MultiVector<T, M> & v) {
+			checkRow(v);
+			for (const auto & sub : v) {
+				append(sub);
+			}
+		}
+
+		/** Copy the elements of the last dimension of a nested vector.
+		 *\param v the vector
+		 */
+		void append(const MultiVector<T, 1> & v) {
+			checkRow(v);
+			_data.insert(_data.end(), v.begin(), v.end());
+		}
+
+		std::vector<T> _data; ///< Elements, row-major.
+		std::array<int, N> _dims; ///< Size along each dimension.
+		std::array<size_t, N> _strides; ///< Elements between consecutive indices along each dimension.
+	};
+
 	
 } // namespace sibr
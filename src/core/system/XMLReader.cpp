@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/XMLReader.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace sibr
+{
+	namespace {
+
+		/** \return true for XML whitespace. \param c the character */
+		bool isSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+		}
+
+		/** \return true for characters ending a name. \param c the character */
+		bool endsName(char c)
+		{
+			return isSpace(c) || c == '/' || c == '>' || c == '=';
+		}
+
+		/** Find a sequence.
+		 *\param data the document
+		 *\param size the document size
+		 *\param from where to start
+		 *\param pattern the sequence to find
+		 *\return the offset of the sequence, or size if not found
+		 */
+		size_t find(const char * data, size_t size, size_t from, const char * pattern)
+		{
+			const size_t length = std::strlen(pattern);
+			while (from + length <= size) {
+				const void * found = std::memchr(data + from, pattern[0], size - from);
+				if (!found) {
+					break;
+				}
+				from = size_t(static_cast<const char*>(found) - data);
+				if (from + length <= size && std::memcmp(data + from, pattern, length) == 0) {
+					return from;
+				}
+				++from;
+			}
+			return size;
+		}
+
+		/** Check for a sequence.
+		 *\param data the document
+		 *\param size the document size
+		 *\param at the offset to check
+		 *\param pattern the sequence
+		 *\return true if the document has the sequence at the offset
+		 */
+		bool startsWith(const char * data, size_t size, size_t at, const char * pattern)
+		{
+			const size_t length = std::strlen(pattern);
+			return at + length <= size && std::memcmp(data + at, pattern, length) == 0;
+		}
+	}
+
+	std::string_view XMLReader::Element::attribute(std::string_view attributeName, std::string_view fallback) const
+	{
+		for (const Attribute & attribute : *attributes) {
+			if (attribute.name == attributeName) {
+				return attribute.value;
+			}
+		}
+		return fallback;
+	}
+
+	bool XMLReader::Element::hasAttribute(std::string_view attributeName) const
+	{
+		return std::any_of(attributes->begin(), attributes->end(), [&](const Attribute & attribute) {
+			return attribute.name == attributeName;
+		});
+	}
+
+	bool XMLReader::open(const std::string & path)
+	{
+		_path = path;
+		_error.clear();
+		if (!_file.open(path)) {
+			_error = "Can't open " + path + ".";
+			_data = nullptr;
+			_size = 0;
+			return false;
+		}
+		_file.prefetch();
+		_data = _file.data();
+		_size = _file.size();
+		return true;
+	}
+
+	void XMLReader::setData(const char * data, size_t size)
+	{
+		_file.close();
+		_path.clear();
+		_error.clear();
+		_data = data;
+		_size = size;
+	}
+
+	bool XMLReader::parse(Visitor & visitor)
+	{
+		const char * data = _data;
+		const size_t size = _size;
+		_open.clear();
+		_error.clear();
+
+		size_t pos = 0;
+		while (pos < size) {
+			const void * tag = std::memchr(data + pos, '<', size - pos);
+			if (!tag) {
+				break;
+			}
+			const size_t start = size_t(static_cast<const char*>(tag) - data);
+
+			// Declarations, comments and character data are skipped.
+			if (startsWith(data, size, start, "<?")) {
+				pos = find(data, size, start + 2, "?>");
+				if (pos == size) {
+					return fail("Unterminated processing instruction", start);
+				}
+				pos += 2;
+				continue;
+			}
+			if (startsWith(data, size, start, "<!--")) {
+				pos = find(data, size, start + 4, "-->");
+				if (pos == size) {
+					return fail("Unterminated comment", start);
+				}
+				pos += 3;
+				continue;
+			}
+			if (startsWith(data, size, start, "<![CDATA[")) {
+				pos = find(data, size, start + 9, "]]>");
+				if (pos == size) {
+					return fail("Unterminated CDATA section", start);
+				}
+				pos += 3;
+				continue;
+			}
+			if (startsWith(data, size, start, "<!")) {
+				// DOCTYPE, possibly with an internal subset.
+				int brackets = 0;
+				pos = start + 2;
+				while (pos < size && (data[pos] != '>' || brackets > 0)) {
+					brackets += data[pos] == '[' ? 1 : (data[pos] == ']' ? -1 : 0);
+					++pos;
+				}
+				if (pos == size) {
+					return fail("Unterminated declaration", start);
+				}
+				++pos;
+				continue;
+			}
+
+			if (startsWith(data, size, start, "</")) {
+				size_t end = start + 2;
+				while (end < size && !endsName(data[end])) {
+					++end;
+				}
+				const std::string_view name(data + start + 2, end - start - 2);
+				while (end < size && isSpace(data[end])) {
+					++end;
+				}
+				if (end == size || data[end] != '>') {
+					return fail("Malformed closing tag", start);
+				}
+				if (_open.empty() || _open.back() != name) {
+					return fail("Unexpected closing tag </" + std::string(name) + ">", start);
+				}
+				_open.pop_back();
+				visitor.end(name, int(_open.size()));
+				pos = end + 1;
+				continue;
+			}
+
+			// Opening tag.
+			size_t cursor = start + 1;
+			while (cursor < size && !endsName(data[cursor])) {
+				++cursor;
+			}
+			Element element;
+			element.name = std::string_view(data + start + 1, cursor - start - 1);
+			element.depth = int(_open.size());
+			element.attributes = &_attributes;
+			if (element.name.empty()) {
+				return fail("Malformed tag", start);
+			}
+			_attributes.clear();
+			bool empty = false;
+			while (true) {
+				while (cursor < size && isSpace(data[cursor])) {
+					++cursor;
+				}
+				if (cursor == size) {
+					return fail("Unterminated tag <" + std::string(element.name) + ">", start);
+				}
+				if (data[cursor] == '>') {
+					++cursor;
+					break;
+				}
+				if (data[cursor] == '/') {
+					if (cursor + 1 == size || data[cursor + 1] != '>') {
+						return fail("Malformed tag <" + std::string(element.name) + ">", cursor);
+					}
+					empty = true;
+					cursor += 2;
+					break;
+				}
+				const size_t nameStart = cursor;
+				while (cursor < size && !endsName(data[cursor])) {
+					++cursor;
+				}
+				Attribute attribute;
+				attribute.name = std::string_view(data + nameStart, cursor - nameStart);
+				while (cursor < size && isSpace(data[cursor])) {
+					++cursor;
+				}
+				if (attribute.name.empty() || cursor == size || data[cursor] != '=') {
+					return fail("Malformed attribute in <" + std::string(element.name) + ">", nameStart);
+				}
+				++cursor;
+				while (cursor < size && isSpace(data[cursor])) {
+					++cursor;
+				}
+				if (cursor == size || (data[cursor] != '"' && data[cursor] != '\'')) {
+					return fail("Unquoted attribute value in <" + std::string(element.name) + ">", cursor);
+				}
+				const char quote = data[cursor];
+				const void * closing = std::memchr(data + cursor + 1, quote, size - cursor - 1);
+				if (!closing) {
+					return fail("Unterminated attribute value in <" + std::string(element.name) + ">", cursor);
+				}
+				const size_t valueEnd = size_t(static_cast<const char*>(closing) - data);
+				attribute.value = std::string_view(data + cursor + 1, valueEnd - cursor - 1);
+				_attributes.push_back(attribute);
+				cursor = valueEnd + 1;
+			}
+
+			visitor.begin(element);
+			if (empty) {
+				visitor.end(element.name, element.depth);
+			}
+			else {
+				_open.push_back(element.name);
+			}
+			pos = cursor;
+		}
+
+		if (!_open.empty()) {
+			return fail("Unclosed element <" + std::string(_open.back()) + ">", size);
+		}
+		return true;
+	}
+
+	std::string XMLReader::decode(std::string_view text)
+	{
+		std::string decoded;
+		decoded.reserve(text.size());
+		size_t pos = 0;
+		while (pos < text.size()) {
+			const size_t amp = text.find('&', pos);
+			const size_t semicolon = amp == std::string_view::npos ? amp : text.find(';', amp);
+			if (semicolon == std::string_view::npos) {
+				decoded.append(text.substr(pos));
+				break;
+			}
+			decoded.append(text.substr(pos, amp - pos));
+			const std::string_view entity = text.substr(amp + 1, semicolon - amp - 1);
+			if (entity == "lt") {
+				decoded += '<';
+			}
+			else if (entity == "gt") {
+				decoded += '>';
+			}
+			else if (entity == "amp") {
+				decoded += '&';
+			}
+			else if (entity == "quot") {
+				decoded += '"';
+			}
+			else if (entity == "apos") {
+				decoded += '\'';
+			}
+			else if (entity.size() > 1 && entity[0] == '#') {
+				const std::string digits(entity.substr(entity[1] == 'x' ? 2 : 1));
+				unsigned long code = std::strtoul(digits.c_str(), nullptr, entity[1] == 'x' ? 16 : 10);
+				// UTF-8 encoding of the code point.
+				if (code < 0x80) {
+					decoded += char(code);
+				}
+				else if (code < 0x800) {
+					decoded += char(0xC0 | (code >> 6));
+					decoded += char(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000) {
+					decoded += char(0xE0 | (code >> 12));
+					decoded += char(0x80 | ((code >> 6) & 0x3F));
+					decoded += char(0x80 | (code & 0x3F));
+				}
+				else {
+					code = std::min(code, 0x10FFFFul);
+					decoded += char(0xF0 | (code >> 18));
+					decoded += char(0x80 | ((code >> 12) & 0x3F));
+					decoded += char(0x80 | ((code >> 6) & 0x3F));
+					decoded += char(0x80 | (code & 0x3F));
+				}
+			}
+			else {
+				// Unknown entity, kept as is.
+				decoded.append(text.substr(amp, semicolon - amp + 1));
+			}
+			pos = semicolon + 1;
+		}
+		return decoded;
+	}
+
+	bool XMLReader::fail(const std::string & message, size_t offset)
+	{
+		const size_t line = 1 + size_t(std::count(_data, _data + std::min(offset, _size), '\n'));
+		_error = "[XMLReader] " + message + " at line " + std::to_string(line) + (_path.empty() ? "" : " of " + _path) + ".";
+		return false;
+	}
+
+} // namespace sibr
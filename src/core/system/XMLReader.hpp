@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include <string>
+# include <string_view>
+# include <vector>
+
+# include "core/system/Config.hpp"
+# include "core/system/MappedFile.hpp"
+
+namespace sibr
+{
+	/** Streaming parser of XML files, for documents too large to be worth a DOM (see XMLTree).
+	 The file is mapped and scanned once; the visitor is called on each opening and closing tag with
+	 views on the mapped bytes, so that no string is copied nor node allocated. Processing can thus
+	 start on the first elements, for instance loading the assets they reference while the rest of
+	 the file is read.
+	 The parser does not validate: text content, comments, processing instructions and DOCTYPE are
+	 skipped, and entities are left in the attribute values, see decode().
+
+	Code Example:
+
+		struct Shapes : sibr::XMLReader::Visitor {
+			void begin(const sibr::XMLReader::Element & element) override {
+				if (element.name == "shape") {
+					load(std::string(element.attribute("filename")));
+				}
+			}
+		} shapes;
+		sibr::XMLReader reader;
+		if (reader.open("scene.xml") && !reader.parse(shapes)) {
+			SIBR_WRG << reader.error() << std::endl;
+		}
+
+	 \ingroup sibr_system
+	*/
+	class SIBR_SYSTEM_EXPORT XMLReader
+	{
+		SIBR_DISALLOW_COPY(XMLReader);
+
+	public:
+
+		/// An attribute, as views on the document.
+		struct Attribute {
+			std::string_view name; ///< Attribute name.
+			std::string_view value; ///< Raw value, without the quotes.
+		};
+
+		/// An opening tag, valid during the Visitor::begin call only.
+		struct Element {
+			std::string_view name; ///< Tag name.
+			int depth = 0; ///< Number of enclosing elements.
+			const std::vector<Attribute> * attributes = nullptr; ///< Attributes, in document order.
+
+			/** Get an attribute value.
+			 *\param attributeName the attribute name
+			 *\param fallback value returned when the attribute is missing
+			 *\return the raw value
+			 */
+			std::string_view attribute(std::string_view attributeName, std::string_view fallback = std::string_view()) const;
+
+			/** \return true if the element has the attribute. \param attributeName the attribute name */
+			bool hasAttribute(std::string_view attributeName) const;
+		};
+
+		/// Receives the tags of a document, in order.
+		class Visitor {
+		public:
+			/// Destructor.
+			virtual ~Visitor(void) = default;
+
+			/** Called on each opening tag.
+			 *\param element the element
+			 */
+			virtual void begin(const Element & element) { (void)element; }
+
+			/** Called on each closing tag, and right after begin for empty elements.
+			 *\param name the tag name
+			 *\param depth the depth of the element
+			 */
+			virtual void end(std::string_view name, int depth) { (void)name; (void)depth; }
+		};
+
+		/// Constructor, no document.
+		XMLReader(void) = default;
+
+		/** Map a file to parse.
+		 *\param path the file path
+		 *\return false if the file can't be mapped
+		 */
+		bool open(const std::string & path);
+
+		/** Parse a document held in memory instead, the buffer has to outlive the parsing.
+		 *\param data the document
+		 *\param size its size in bytes
+		 */
+		void setData(const char * data, size_t size);
+
+		/** Parse the whole document.
+		 *\param visitor called on each tag
+		 *\return false if the document is malformed, the visitor has then been called up to the error, see error()
+		 */
+		bool parse(Visitor & visitor);
+
+		/** \return a description of the last parsing error, with its line. */
+		const std::string & error(void) const { return _error; }
+
+		/** Replace the predefined and numeric entities of a raw value.
+		 *\param text the raw value
+		 *\return the decoded text
+		 */
+		static std::string decode(std::string_view text);
+
+	private:
+
+		/** Record an error.
+		 *\param message what is wrong
+		 *\param offset where it is, in bytes from the document start
+		 *\return false
+		 */
+		bool fail(const std::string & message, size_t offset);
+
+		MappedFile _file; ///< Mapping of the parsed file.
+		std::string _path; ///< Path of the parsed file, for error messages.
+		const char * _data = nullptr; ///< Document start.
+		size_t _size = 0; ///< Document size.
+		std::vector<Attribute> _attributes; ///< Attributes of the current element, reused between elements.
+		std::vector<std::string_view> _open; ///< Names of the enclosing elements.
+		std::string _error; ///< Last error.
+	};
+
+} // namespace sibr
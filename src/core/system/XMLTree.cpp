@@ -11,6 +11,7 @@
 
 
 #include "XMLTree.h"
+#include "MappedFile.hpp"
 #include "rapidxml/rapidxml_print.hpp"
 #include <iostream>
 #include <fstream>
@@ -21,12 +22,11 @@ namespace sibr {
 	XMLTree::XMLTree(const std::string &  path)
 	{
 		std::cout << "Parsing xml file < " << path << " > : ";
-		std::ifstream file(path.c_str());
-		if (file) {
-			std::stringstream buffer;
-			buffer << file.rdbuf();
+		// Parsing is in place, the mapped file is copied once in the string the nodes point to.
+		MappedFile file;
+		if (file.open(path)) {
+			xmlString.assign(file.data(), file.size());
 			file.close();
-			xmlString = std::move(std::string(buffer.str()));
 			this->parse<0>(&xmlString[0]);
 			std::cout << "success " << std::endl;
 		}
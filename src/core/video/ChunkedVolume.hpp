@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+#include "VideoUtils.hpp"
+
+#include <core/system/MappedFile.hpp>
+#include <boost/filesystem.hpp>
+#include <array>
+
+namespace sibr
+{
+	template<typename T, uint N = 3>
+	class ChunkedVolume;
+
+	using ChunkedVolume3f = ChunkedVolume<float, 3>;
+	using ChunkedVolume1f = ChunkedVolume<float, 1>;
+	using ChunkedVolume3u = ChunkedVolume<uchar, 3>;
+	using ChunkedVolume1u = ChunkedVolume<uchar, 1>;
+
+	/**
+	* \addtogroup sibr_video
+	* @{
+	*/
+
+	/** Out-of-core counterpart of VideoVolume, for clips that don't fit in memory.
+	* Frames are stored with the same layout (one row of w*h*N values per frame) in a file
+	* mapped in memory, created in a temporary directory and removed when the last copy of the
+	* volume is released. The OS brings pages in when accessed and writes them back when memory
+	* is needed, so operations stream over temporal chunks instead of touching the whole volume at once.
+	* Each chunk can be viewed as a regular VideoVolume, without copy.
+	* \note Like VideoVolume, copies share the same storage, use clone for a deep copy.
+	*/
+	template<typename T, uint N>
+	class ChunkedVolume {
+	public:
+		using Volume = VideoVolume<T, N>;
+		using CVpixel = typename Volume::CVpixel;
+
+		int w = 0, h = 0, l = 0; ///< Dimensions.
+
+		/// Empty volume.
+		ChunkedVolume() {}
+
+		/** Constructor, the content is undefined.
+		\param _l number of frames
+		\param _w frame width
+		\param _h frame height
+		\param chunkFrames number of frames per chunk processed at once
+		\param directory where to create the storage file, the system temporary directory if empty
+		*/
+		ChunkedVolume(int _l, int _w, int _h, int chunkFrames = 16, const std::string & directory = "") :
+			w(_w), h(_h), l(_l), _chunkFrames(std::max(chunkFrames, 1)), _directory(directory) {
+			const size_t bytes = size_t(l) * size_t(w) * size_t(h) * N * sizeof(T);
+			if (bytes == 0) {
+				return;
+			}
+			const Path dir = directory.empty() ? boost::filesystem::temp_directory_path() : Path(directory);
+			const Path file = dir / boost::filesystem::unique_path("sibr_volume_%%%%%%%%%%%%.raw");
+			_storage = std::make_shared<MappedFile>();
+			if (!_storage->create(file.string(), bytes, true)) {
+				SIBR_ERR << "[ChunkedVolume] Could not create storage file " << file.string() << std::endl;
+			}
+		}
+
+		/** Constructor, with all values set.
+		\param _l number of frames
+		\param _w frame width
+		\param _h frame height
+		\param value the initial value
+		\param chunkFrames number of frames per chunk processed at once
+		\param directory where to create the storage file, the system temporary directory if empty
+		*/
+		ChunkedVolume(int _l, int _w, int _h, double value, int chunkFrames = 16, const std::string & directory = "") :
+			ChunkedVolume(_l, _w, _h, chunkFrames, directory) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).mat.setTo(static_cast<T>(value));
+			}
+		}
+
+		/** Copy an in-memory volume.
+		\param volume the volume to copy
+		\param chunkFrames number of frames per chunk processed at once
+		\param directory where to create the storage file, the system temporary directory if empty
+		\return the out-of-core volume
+		*/
+		static ChunkedVolume fromVolume(const Volume & volume, int chunkFrames = 16, const std::string & directory = "") {
+			ChunkedVolume out(volume.l, volume.w, volume.h, chunkFrames, directory);
+			if (out.l > 0) {
+				cv::Mat dst = out.frames(0, out.l).mat;
+				volume.mat.copyTo(dst);
+			}
+			return out;
+		}
+
+		/** Decode a video frame by frame, without holding it in memory.
+		\param vid the video
+		\param chunkFrames number of frames per chunk processed at once
+		\param directory where to create the storage file, the system temporary directory if empty
+		\return the out-of-core volume
+		*/
+		static ChunkedVolume fromVideo(sibr::Video & vid, int chunkFrames = 16, const std::string & directory = "") {
+			static_assert(N == 3, "videos are decoded as 3 channels");
+			ChunkedVolume out(vid.getNumFrames(), vid.getResolution()[0], vid.getResolution()[1], chunkFrames, directory);
+			vid.setCurrentFrame(0);
+			for (int t = 0; t < out.l; ++t) {
+				const cv::Mat decoded = vid.next();
+				cv::Mat_<CVpixel> dst = out.frame(t);
+				if (decoded.empty()) {
+					SIBR_WRG << "[ChunkedVolume] Only " << t << " frames out of " << out.l << " could be decoded." << std::endl;
+					out.l = t;
+					break;
+				}
+				decoded.convertTo(dst, dst.type());
+			}
+			vid.setCurrentFrame(0);
+			return out;
+		}
+
+		/** \return a deep copy, in a new storage file. */
+		ChunkedVolume clone() const {
+			ChunkedVolume out(l, w, h, _chunkFrames, _directory);
+			for (int c = 0; c < numChunks(); ++c) {
+				cv::Mat dst = out.chunk(c).mat;
+				chunk(c).mat.copyTo(dst);
+			}
+			return out;
+		}
+
+		/** \return a copy of the whole volume in memory. */
+		Volume toVolume() const {
+			return l > 0 ? frames(0, l).clone() : Volume();
+		}
+
+		/** Convert to another type, chunk by chunk.
+		\return the converted volume
+		*/
+		template<typename U>
+		ChunkedVolume<U, N> convertTo() const {
+			ChunkedVolume<U, N> out(l, w, h, _chunkFrames, _directory);
+			for (int c = 0; c < numChunks(); ++c) {
+				cv::Mat dst = out.chunk(c).mat;
+				chunk(c).mat.convertTo(dst, dst.type());
+			}
+			return out;
+		}
+
+		/** \return the number of frames per chunk. */
+		int chunkFrames() const { return _chunkFrames; }
+
+		/** \return the directory the storage is created in, empty for the system temporary directory. */
+		const std::string & directory() const { return _directory; }
+
+		/** \return the number of chunks. */
+		int numChunks() const { return (l + _chunkFrames - 1) / _chunkFrames; }
+
+		/** View a range of frames as a regular volume, without copy.
+		\param t_start first frame
+		\param t_end frame after the last one
+		\return the view
+		*/
+		Volume frames(int t_start, int t_end) const {
+			T * base = reinterpret_cast<T*>(_storage->writableData()) + size_t(t_start) * frameSize();
+			return Volume(cv::Mat_<T>(t_end - t_start, int(frameSize()), base), w, h);
+		}
+
+		/** View a chunk as a regular volume, without copy.
+		\param c the chunk index
+		\return the view
+		*/
+		Volume chunk(int c) const {
+			return frames(c * _chunkFrames, std::min(l, (c + 1) * _chunkFrames));
+		}
+
+		/** View a frame as an image, without copy.
+		\param t the frame index
+		\return the view
+		*/
+		cv::Mat_<CVpixel> frame(int t) const {
+			return row(t).reshape(N, h);
+		}
+
+		void toggle(double d = 255) {
+			for (int c = 0; c < numChunks(); ++c) {
+				// Written in place, an assignment would reallocate the view.
+				cv::Mat view = chunk(c).mat;
+				cv::subtract(cv::Scalar::all(d), view, view);
+			}
+		}
+
+		void shift(double d) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).shift(d);
+			}
+		}
+
+		void scale(double d) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).scale(d);
+			}
+		}
+
+		template<typename U>
+		void add(const ChunkedVolume<U, N> & other) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).add(other.frames(chunkStart(c), chunkEnd(c)));
+			}
+		}
+
+		template<typename U>
+		void substract(const ChunkedVolume<U, N> & other) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).substract(other.frames(chunkStart(c), chunkEnd(c)));
+			}
+		}
+
+		template<typename U, uint M>
+		void multiply(const ChunkedVolume<U, M> & other) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).multiply(other.frames(chunkStart(c), chunkEnd(c)));
+			}
+		}
+
+		template<typename U, uint M>
+		void applyMaskInPlace(const ChunkedVolume<U, M> & mask) {
+			for (int c = 0; c < numChunks(); ++c) {
+				chunk(c).applyMaskInPlace(mask.frames(chunkStart(c), chunkEnd(c)));
+			}
+		}
+
+		/** Temporal [1 4 6 4 1]/16 blur, in place, same result as VideoVolume::temporalBlur.
+		Frames are processed in order, only the originals of the two previous frames are kept.
+		\param scaling factor applied to the kernel
+		*/
+		void temporalBlur(float scaling = 1.0f) {
+			const std::array<float, 5> kernel = temporalKernel(scaling);
+			// Originals of the frames t-2, t-1 and t, indexed by frame modulo 3.
+			std::array<cv::Mat, 3> originals;
+			cv::Mat1f acc, tmp;
+			for (int t = 0; t < l; ++t) {
+				cv::Mat_<T> current = row(t);
+				originals[t % 3] = current.clone();
+				acc = cv::Mat1f::zeros(1, int(frameSize()));
+				for (int dt = -2; dt <= 2; ++dt) {
+					// Frames up to t have been overwritten, the following ones not yet.
+					const int u = cv::borderInterpolate(t + dt, l, cv::BORDER_REFLECT_101);
+					const cv::Mat src = u <= t ? originals[u % 3] : cv::Mat(row(u));
+					src.convertTo(tmp, CV_32F, kernel[dt + 2]);
+					acc += tmp;
+				}
+				acc.convertTo(current, current.type());
+			}
+		}
+
+		/** Temporal blur and decimation, same result as VideoVolume::pyrDownTemporal.
+		\return the volume with half the frames
+		*/
+		ChunkedVolume pyrDownTemporal() const {
+			const std::array<float, 5> kernel = temporalKernel(1.0f);
+			ChunkedVolume out((l + 1) / 2, w, h, _chunkFrames, _directory);
+#pragma omp parallel for
+			for (int f = 0; f < out.l; ++f) {
+				cv::Mat1f acc = cv::Mat1f::zeros(1, int(frameSize())), tmp;
+				for (int dt = -2; dt <= 2; ++dt) {
+					const int u = cv::borderInterpolate(2 * f + dt, l, cv::BORDER_REFLECT_101);
+					row(u).convertTo(tmp, CV_32F, kernel[dt + 2]);
+					acc += tmp;
+				}
+				cv::Mat_<T> dst = out.row(f);
+				acc.convertTo(dst, dst.type());
+			}
+			return out;
+		}
+
+		/** Temporal linear upsampling and blur, same result as VideoVolume::pyrUpTemporal up to rounding.
+		\param _l the number of frames to upsample to
+		\return the upsampled volume
+		*/
+		ChunkedVolume pyrUpTemporal(int _l) const {
+			ChunkedVolume out(_l, w, h, _chunkFrames, _directory);
+			const double ratio = double(l) / double(_l);
+#pragma omp parallel for
+			for (int t = 0; t < _l; ++t) {
+				// Same sampling as cv::resize with INTER_LINEAR.
+				const double pos = std::max((t + 0.5) * ratio - 0.5, 0.0);
+				const int t0 = std::min(int(pos), l - 1);
+				const int t1 = std::min(t0 + 1, l - 1);
+				const double a = t0 == t1 ? 0.0 : pos - t0;
+				cv::Mat_<T> dst = out.row(t);
+				cv::addWeighted(row(t0), 1.0 - a, row(t1), a, 0.0, dst, dst.depth());
+			}
+			out.temporalBlur(1.0f);
+			return out;
+		}
+
+	private:
+
+		/** \return the number of values in a frame. */
+		size_t frameSize() const { return size_t(w) * size_t(h) * N; }
+
+		/** \return the first frame of a chunk. */
+		int chunkStart(int c) const { return c * _chunkFrames; }
+
+		/** \return the frame after the last one of a chunk. */
+		int chunkEnd(int c) const { return std::min(l, (c + 1) * _chunkFrames); }
+
+		/** View a frame as a row of values, without copy.
+		\param t the frame index
+		\return the view
+		*/
+		cv::Mat_<T> row(int t) const {
+			T * base = reinterpret_cast<T*>(_storage->writableData()) + size_t(t) * frameSize();
+			return cv::Mat_<T>(1, int(frameSize()), base);
+		}
+
+		/** \return the [1 4 6 4 1]/16 temporal kernel, scaled. */
+		static std::array<float, 5> temporalKernel(float scaling) {
+			const float s = scaling / 16.0f;
+			return { s, 4.0f * s, 6.0f * s, 4.0f * s, s };
+		}
+
+		template<typename U, uint M> friend class ChunkedVolume;
+
+		int _chunkFrames = 16; ///< Frames per chunk.
+		std::string _directory; ///< Where the storage is created.
+		std::shared_ptr<MappedFile> _storage; ///< Mapped storage, shared by copies.
+	};
+
+	/** Temporal laplacian pyramid of an out-of-core volume, see laplacianPyramidTemporal.
+	\param vid the volume
+	\param num_levels the number of levels, 0 to pick it from the volume length
+	\return the pyramid levels, from the finest
+	*/
+	template<typename U, typename T = U>
+	std::vector<ChunkedVolume<T, 3>> laplacianPyramidTemporal(const ChunkedVolume<U, 3> & vid, uint num_levels = 0)
+	{
+		if (num_levels == 0) {
+			num_levels = optimal_num_levels(vid.l);
+		}
+
+		std::vector<ChunkedVolume<T, 3>> out;
+		ChunkedVolume3f current_v = vid.template convertTo<float>();
+		for (int i = 0; i < (int)num_levels - 1; ++i) {
+			ChunkedVolume3f down = current_v.pyrDownTemporal();
+			const ChunkedVolume3f up = down.pyrUpTemporal(current_v.l);
+			current_v.substract(up);
+			current_v.shift(128);
+			out.push_back(current_v.template convertTo<T>());
+			std::swap(current_v, down);
+		}
+		out.push_back(current_v.template convertTo<T>());
+		return out;
+	}
+
+	/** Collapse a temporal laplacian pyramid of out-of-core volumes, see collapseLaplacianPyramidTemporal.
+	\param pyr the pyramid levels, from the finest
+	\param shift value added after each level
+	\return the collapsed volume
+	*/
+	template<typename T>
+	ChunkedVolume<T, 3> collapseLaplacianPyramidTemporal(const std::vector<ChunkedVolume<T, 3>> & pyr, double shift)
+	{
+		ChunkedVolume3f v = pyr.back().template convertTo<float>();
+		for (int i = (int)pyr.size() - 2; i >= 0; --i) {
+			v = v.pyrUpTemporal(pyr[i].l);
+			v.add(pyr[i]);
+			if (shift != 0) {
+				v.shift(shift);
+			}
+		}
+		return v.template convertTo<T>();
+	}
+
+	/** Temporal laplacian blending of out-of-core volumes, see laplacianBlendingTemporal.
+	Each level only lives on disk, memory use is bounded by the chunks being processed.
+	\param vA the first volume
+	\param vB the second volume
+	\param pyrM the mask pyramid, toggled in place
+	\return the blended volume
+	*/
+	template<typename T_V, typename T_M>
+	ChunkedVolume<T_V, 3> laplacianBlendingTemporal(
+		const ChunkedVolume<T_V, 3> & vA,
+		const ChunkedVolume<T_V, 3> & vB,
+		std::vector<ChunkedVolume<T_M, 1>> & pyrM)
+	{
+		const uint num_levels = (uint)pyrM.size();
+		auto pyrA = laplacianPyramidTemporal(vA, num_levels);
+		auto pyrB = laplacianPyramidTemporal(vB, num_levels);
+
+		for (int i = (int)pyrA.size() - 1; i >= 0; --i) {
+			pyrA[i].applyMaskInPlace(pyrM[i]);
+			pyrM[i].toggle();
+			pyrB[i].applyMaskInPlace(pyrM[i]);
+			pyrA[i].add(pyrB[i]);
+		}
+
+		return collapseLaplacianPyramidTemporal(pyrA, -128);
+	}
+
+	/** @} */
+
+} // namespace sibr
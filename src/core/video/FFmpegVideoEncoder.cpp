@@ -21,6 +21,8 @@ extern "C"
 }
 #endif
 
+#include <cstring>
+
 #define QQ(rat) (rat.num/(double)rat.den)
 
 // Disable ffmpeg deprecation warning.
@@ -28,6 +30,87 @@ extern "C"
 
 namespace sibr {
 
+	namespace {
+
+		const char * kYUVVertexSource = R"(#version 420
+			layout(location = 0) in vec2 in_vertex;
+			void main(){
+				gl_Position = vec4(in_vertex, 0.0, 1.0);
+			}
+		)";
+
+		const char * kYUVFragmentSource = R"(#version 420
+			layout(binding = 0) uniform sampler2D image;
+			uniform ivec2 size;
+			layout(location = 0) out vec4 out_color;
+
+			// Top-down pixel coordinates, as in the video.
+			vec3 rgbAt(vec2 pixel){
+				return texture(image, vec2(pixel.x, float(size.y) - pixel.y) / vec2(size)).rgb;
+			}
+
+			void main(){
+				// Output the I420 planes as laid out in memory, Y then U then V, one byte per texel.
+				// Rows are counted top-down, the read back flips them.
+				const int row = (3 * size.y) / 2 - 1 - int(gl_FragCoord.y);
+				const int col = int(gl_FragCoord.x);
+				// BT.601 limited range, as OpenCV.
+				if (row < size.y) {
+					const vec3 c = rgbAt(vec2(col, row) + 0.5);
+					out_color = vec4(dot(c, vec3(0.257, 0.504, 0.098)) + 16.0 / 255.0);
+					return;
+				}
+				const int chromaW = size.x / 2;
+				const int chromaCount = chromaW * (size.y / 2);
+				const int i = (row - size.y) * size.x + col;
+				const int plane = i / chromaCount;
+				const int j = i - plane * chromaCount;
+				// Sampling at the corner shared by the 2x2 block averages it.
+				const vec3 c = rgbAt(vec2(2 * (j % chromaW) + 1, 2 * (j / chromaW) + 1));
+				const vec3 coeffs = plane == 0 ? vec3(-0.148, -0.291, 0.439) : vec3(0.439, -0.368, -0.071);
+				out_color = vec4(dot(c, coeffs) + 128.0 / 255.0);
+			}
+		)";
+
+#ifndef HEADLESS
+		/** Name suffixes of the hardware encoders to try, in order. */
+		std::vector<std::string> hardwareSuffixes(FFVideoEncoder::Hardware hardware)
+		{
+			switch (hardware) {
+			case FFVideoEncoder::Hardware::AUTO:
+				return { "_nvenc", "_qsv", "_amf" };
+			case FFVideoEncoder::Hardware::NVENC:
+				return { "_nvenc" };
+			case FFVideoEncoder::Hardware::QSV:
+				return { "_qsv" };
+			case FFVideoEncoder::Hardware::AMF:
+				return { "_amf" };
+			default:
+				return {};
+			}
+		}
+
+		/** Pick the pixel format to feed an encoder with, from the ones we can produce. */
+		AVPixelFormat pickPixelFormat(const AVCodec * codec)
+		{
+			if (!codec->pix_fmts) {
+				return AV_PIX_FMT_YUV420P;
+			}
+			AVPixelFormat found = AV_PIX_FMT_NONE;
+			for (const AVPixelFormat * f = codec->pix_fmts; *f != AV_PIX_FMT_NONE; ++f) {
+				if (*f == AV_PIX_FMT_YUV420P) {
+					return *f;
+				}
+				if (*f == AV_PIX_FMT_NV12) {
+					found = *f;
+				}
+			}
+			return found;
+		}
+#endif
+
+	}
+
 	bool FFVideoEncoder::ffmpegInitDone = false;
 
 	FFVideoEncoder::FFVideoEncoder(
@@ -35,7 +118,17 @@ namespace sibr {
 		double _fps,
 		const sibr::Vector2i & size,
 		bool forceResize
-	) : filepath(_filepath), fps(_fps), _forceResize(forceResize)
+	) : FFVideoEncoder(_filepath, _fps, size, Options(), forceResize)
+	{
+	}
+
+	FFVideoEncoder::FFVideoEncoder(
+		const std::string & _filepath,
+		double _fps,
+		const sibr::Vector2i & size,
+		const Options & options,
+		bool forceResize
+	) : filepath(_filepath), fps(_fps), _forceResize(forceResize), _options(options)
 	{
 #ifndef HEADLESS
 		/** Init FFMPEG, registering available codec plugins. */
@@ -73,17 +166,43 @@ namespace sibr {
 
 	void FFVideoEncoder::close()
 	{
+		// Frames still being read back or queued are encoded first.
+		collectReads(true);
+		if (_worker.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(_queueMutex);
+				_stopWorker = true;
+			}
+			_queueNotEmpty.notify_all();
+			_worker.join();
+		}
+		_pendingReads.clear();
+		_readback.reset();
+		_yuvTarget.reset();
+		if (_yuvSampler) {
+			glDeleteSamplers(1, &_yuvSampler);
+			_yuvSampler = 0;
+		}
+		_yuvShader.terminate();
+
 #ifndef HEADLESS
+		if (!needFree) {
+			return;
+		}
+		// Flush the frames delayed by the encoder.
+		encode(nullptr);
+
 		if (av_write_trailer(pFormatCtx) < 0) {
 			SIBR_WRG << "[FFMPEG] Can not av_write_trailer " << std::endl;
 		}
 
-		if (video_st) {
-			avcodec_close(video_st->codec);
-			av_free(frameYUV);
-		}
+		avcodec_free_context(&pCodecCtx);
+		av_frame_free(&frameYUV);
+		av_packet_free(&pkt);
 		avio_close(pFormatCtx->pb);
 		avformat_free_context(pFormatCtx);
+		pFormatCtx = NULL;
+		video_st = NULL;
 
 		needFree = false;
 #endif
@@ -91,7 +210,7 @@ namespace sibr {
 
 	FFVideoEncoder::~FFVideoEncoder()
 	{
-		if (needFree) {
+		if (needFree || _worker.joinable()) {
 			close();
 		}
 
@@ -109,13 +228,20 @@ namespace sibr {
 		pFormatCtx = avformat_alloc_context();
 
 		fmt = av_guess_format(NULL, out_file, NULL);
+		if (!fmt) {
+			SIBR_WRG << "[FFMPEG] Could not infer the container of " << filepath << std::endl;
+			avformat_free_context(pFormatCtx);
+			pFormatCtx = NULL;
+			return;
+		}
 		pFormatCtx->oformat = fmt;
 
-		const bool isH264 = pFormatCtx->oformat->video_codec == AV_CODEC_ID_H264;
+		const AVCodecID codecId = pFormatCtx->oformat->video_codec;
+		const bool isH264 = codecId == AV_CODEC_ID_H264;
 		if(isH264){
 			SIBR_LOG << "[FFMPEG] Found H264 codec." << std::endl;
 		} else {
-			SIBR_LOG << "[FFMPEG] Found codec with ID " << pFormatCtx->oformat->video_codec << " (not H264)." << std::endl;
+			SIBR_LOG << "[FFMPEG] Found codec with ID " << codecId << " (not H264)." << std::endl;
 		}
 		
 		if (avio_open(&pFormatCtx->pb, out_file, AVIO_FLAG_READ_WRITE) < 0) {
@@ -123,48 +249,38 @@ namespace sibr {
 			return;
 		}
 
-		pCodec = avcodec_find_encoder(pFormatCtx->oformat->video_codec);
-		if (!pCodec) {
-			SIBR_WRG << "[FFMPEG] Could not find codec." << std::endl;
-			return;
+		// Hardware encoders are named after the codec, they are tried before the default one.
+		if (codecId == AV_CODEC_ID_H264 || codecId == AV_CODEC_ID_HEVC) {
+			const std::string prefix = isH264 ? "h264" : "hevc";
+			for (const std::string & suffix : hardwareSuffixes(_options.hardware)) {
+				AVCodec * codec = avcodec_find_encoder_by_name((prefix + suffix).c_str());
+				if (codec && openCodec(codec, true)) {
+					break;
+				}
+			}
+		}
+		if (!pCodecCtx) {
+			AVCodec * codec = avcodec_find_encoder(codecId);
+			if (!codec) {
+				SIBR_WRG << "[FFMPEG] Could not find codec." << std::endl;
+				return;
+			}
+			if (!openCodec(codec, false)) {
+				return;
+			}
 		}
 
-		video_st = avformat_new_stream(pFormatCtx, pCodec);
+		video_st = avformat_new_stream(pFormatCtx, NULL);
 
 		if (video_st == NULL) {
 			SIBR_WRG << "[FFMPEG] Could not create stream." << std::endl;
 			return;
 		}
-
-		pCodecCtx = video_st->codec;
-		pCodecCtx->codec_id = fmt->video_codec;
-		pCodecCtx->codec_type = AVMEDIA_TYPE_VIDEO;
-		pCodecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
-		pCodecCtx->width = w;
-		pCodecCtx->height = h;
-		pCodecCtx->gop_size = 10;
-		pCodecCtx->time_base.num = 1;
-		pCodecCtx->time_base.den = (int)std::round(fps);
-
-		// Required for the header to be well-formed and compatible with Powerpoint/MediaPlayer/...
-		if (pFormatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
-			pCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-		}
-
-		//H.264 specific options.
-		AVDictionary *param = 0;
-		if (pCodecCtx->codec_id == AV_CODEC_ID_H264) {
-			av_dict_set(&param, "preset", "slow", 0);
-			av_dict_set(&param, "tune", "zerolatency", 0);
-		}
+		avcodec_parameters_from_context(video_st->codecpar, pCodecCtx);
+		video_st->time_base = pCodecCtx->time_base;
 
 		av_dump_format(pFormatCtx, 0, out_file, 1);
 
-		int res = avcodec_open2(pCodecCtx, pCodec, &param);
-		if(res < 0){
-			SIBR_WRG << "[FFMPEG] Failed to open encoder, error: " << res << std::endl;
-			return;
-		}
 		// Write the file header.
 		avformat_write_header(pFormatCtx, NULL);
 
@@ -173,76 +289,331 @@ namespace sibr {
 		frameYUV->format = (int)pCodecCtx->pix_fmt;
 		frameYUV->width = w;
 		frameYUV->height = h;
-		frameYUV->linesize[0] = w;
-		frameYUV->linesize[1] = w / 2;
-		frameYUV->linesize[2] = w / 2;
+		if (pCodecCtx->pix_fmt == AV_PIX_FMT_NV12) {
+			// Interleaved chroma can't point to the OpenCV planes, use a buffer of our own.
+			if (av_frame_get_buffer(frameYUV, 32) < 0) {
+				SIBR_WRG << "[FFMPEG] Could not allocate frame." << std::endl;
+				return;
+			}
+		} else {
+			frameYUV->linesize[0] = w;
+			frameYUV->linesize[1] = w / 2;
+			frameYUV->linesize[2] = w / 2;
+		}
 
-		yuSize[0] = frameYUV->linesize[0] * h;
-		yuSize[1] = frameYUV->linesize[1] * h / 2;
+		yuSize[0] = w * h;
+		yuSize[1] = (w / 2) * h / 2;
 
 		pkt = av_packet_alloc();
 
 		initWasFine = true;
 		needFree = true;
+
+		if (_options.queueSize > 0) {
+			_worker = std::thread(&FFVideoEncoder::workerLoop, this);
+		}
 #endif
 	}
 
+#ifndef HEADLESS
+	bool FFVideoEncoder::openCodec(AVCodec * codec, bool hardware)
+	{
+		const AVPixelFormat pixFmt = pickPixelFormat(codec);
+		if (pixFmt == AV_PIX_FMT_NONE) {
+			SIBR_WRG << "[FFMPEG] Encoder " << codec->name << " doesn't support YUV420P or NV12 input." << std::endl;
+			return false;
+		}
+
+		AVCodecContext * ctx = avcodec_alloc_context3(codec);
+		ctx->codec_id = codec->id;
+		ctx->codec_type = AVMEDIA_TYPE_VIDEO;
+		ctx->pix_fmt = pixFmt;
+		ctx->width = w;
+		ctx->height = h;
+		ctx->gop_size = 10;
+		ctx->time_base.num = 1;
+		ctx->time_base.den = (int)std::round(fps);
+		ctx->framerate.num = ctx->time_base.den;
+		ctx->framerate.den = 1;
+
+		// Required for the header to be well-formed and compatible with Powerpoint/MediaPlayer/...
+		if (pFormatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+			ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+		}
+
+		AVDictionary *param = 0;
+		const std::string name = codec->name;
+		if (hardware) {
+			// Constant quality instead of the default low bitrate.
+			ctx->bit_rate = 0;
+			if (name.find("_nvenc") != std::string::npos) {
+				av_dict_set(&param, "preset", "slow", 0);
+				av_dict_set(&param, "rc", "vbr", 0);
+				av_dict_set(&param, "cq", "21", 0);
+			} else if (name.find("_qsv") != std::string::npos) {
+				av_dict_set(&param, "preset", "slow", 0);
+				ctx->global_quality = 21;
+			} else if (name.find("_amf") != std::string::npos) {
+				av_dict_set(&param, "quality", "quality", 0);
+				av_dict_set(&param, "rc", "cqp", 0);
+				av_dict_set(&param, "qp_i", "21", 0);
+				av_dict_set(&param, "qp_p", "21", 0);
+			}
+		} else if (ctx->codec_id == AV_CODEC_ID_H264) {
+			//H.264 specific options.
+			av_dict_set(&param, "preset", "slow", 0);
+			av_dict_set(&param, "tune", "zerolatency", 0);
+		}
+
+		const int res = avcodec_open2(ctx, codec, &param);
+		av_dict_free(&param);
+		if(res < 0){
+			SIBR_WRG << "[FFMPEG] Failed to open encoder " << name << ", error: " << res << std::endl;
+			avcodec_free_context(&ctx);
+			return false;
+		}
+		SIBR_LOG << "[FFMPEG] Using encoder " << name << "." << std::endl;
+		pCodecCtx = ctx;
+		pCodec = codec;
+		_encoderName = name;
+		return true;
+	}
+#endif
 
 	bool FFVideoEncoder::operator<<(cv::Mat frame)
 	{
 #ifndef HEADLESS
-		if (!video_st) {
+		if (!initWasFine) {
 			return false;
 		}
-		cv::Mat local;
-		if (frame.cols != w || frame.rows != h) {
-			if(_forceResize) {
-				cv::resize(frame, local, cv::Size(w,h));
-			} else {
-				SIBR_WRG << "[FFMPEG] Frame doesn't have the same dimensions as the video." << std::endl;
-				return false;
-			}
-		} else {
-			local = frame;
+		if ((frame.cols != w || frame.rows != h) && !_forceResize) {
+			SIBR_WRG << "[FFMPEG] Frame doesn't have the same dimensions as the video." << std::endl;
+			return false;
 		}
+		// Keep frames in order with the render targets being read back.
+		collectReads(true);
+
+		QueuedFrame queued;
+		// The caller might reuse the frame while it is queued.
+		queued.pixels = _options.queueSize > 0 ? frame.clone() : frame;
+		queued.index = frameCount++;
+		return queueFrame(std::move(queued));
+#else
+		SIBR_ERR << "Not supported in headless" << std::endl;
+		return false;
+#endif
+	}
+
+	bool FFVideoEncoder::operator<<(const sibr::ImageRGB & frame){
+		return (*this)<<(frame.toOpenCVBGR());
+	}
 
-		cv::cvtColor(local, cvFrameYUV, cv::COLOR_BGR2YUV_I420);
-		frameYUV->data[0] = cvFrameYUV.data;
-		frameYUV->data[1] = frameYUV->data[0] + yuSize[0];
-		frameYUV->data[2] = frameYUV->data[1] + yuSize[1];
+	bool FFVideoEncoder::operator<<(const IRenderTarget & frame)
+	{
+#ifndef HEADLESS
+		if (!initWasFine) {
+			return false;
+		}
+		if ((int(frame.w()) != w || int(frame.h()) != h) && !_forceResize) {
+			SIBR_WRG << "[FFMPEG] Frame doesn't have the same dimensions as the video." << std::endl;
+			return false;
+		}
 
-		//frameYUV->pts = (1.0 / std::round(fps)) *frameCount * 90;
-		frameYUV->pts = (int)(frameCount*(video_st->time_base.den) / ((video_st->time_base.num) * std::round(fps)));
-		++frameCount;
+		if (!_yuvTarget) {
+			_yuvShader.init("VideoYUVConversion", kYUVVertexSource, kYUVFragmentSource);
+			_yuvSize.init(_yuvShader, "size");
+			glGenSamplers(1, &_yuvSampler);
+			glSamplerParameteri(_yuvSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glSamplerParameteri(_yuvSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glSamplerParameteri(_yuvSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glSamplerParameteri(_yuvSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			_yuvTarget.reset(new RenderTargetLum(w, (3 * h) / 2));
+			_readback.reset(new PixelReadback());
+		}
 
-		return encode(frameYUV);
+		// The conversion also resizes, the frame is sampled at the video resolution.
+		_yuvTarget->bind();
+		glViewport(0, 0, _yuvTarget->w(), _yuvTarget->h());
+		GLState::disable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, frame.handle());
+		glBindSampler(0, _yuvSampler);
+		_yuvShader.begin();
+		_yuvSize.set(Vector2i(w, h));
+		RenderUtility::renderScreenQuad();
+		_yuvShader.end();
+		glBindSampler(0, 0);
+		_yuvTarget->unbind();
+
+		// Don't let a new read reuse the slot of a frame not queued yet.
+		if (_pendingReads.size() >= _readback->slots()) {
+			collectReads(true);
+		}
+		PendingRead pending;
+		pending.ticket = _yuvTarget->readBackAsync(*_readback);
+		pending.index = frameCount++;
+		_pendingReads.push_back(pending);
+		collectReads(false);
+		return !_failed;
 #else
 		SIBR_ERR << "Not supported in headless" << std::endl;
 		return false;
 #endif
 	}
 
-	bool FFVideoEncoder::operator<<(const sibr::ImageRGB & frame){
-		return (*this)<<(frame.toOpenCVBGR());
+	void FFVideoEncoder::collectReads(bool block)
+	{
+		while (!_pendingReads.empty()) {
+			const PendingRead & pending = _pendingReads.front();
+			ImageL8 planes;
+			if (!_readback->isPending(pending.ticket)) {
+				SIBR_WRG << "[FFMPEG] Frame " << pending.index << " was dropped before being read back." << std::endl;
+				++_droppedFrames;
+			}
+			else if (!_readback->fetch(pending.ticket, planes, block)) {
+				// Reads complete in order, the next ones are not ready either.
+				return;
+			}
+			QueuedFrame queued;
+			queued.pixels = planes.toOpenCV();
+			queued.yuv = true;
+			queued.index = pending.index;
+			_pendingReads.pop_front();
+			if (!queued.pixels.empty()) {
+				queueFrame(std::move(queued));
+			}
+		}
 	}
 
+	bool FFVideoEncoder::queueFrame(QueuedFrame && frame)
+	{
 #ifndef HEADLESS
-	bool FFVideoEncoder::encode(AVFrame * frame)
+		if (_failed) {
+			return false;
+		}
+		if (_options.queueSize == 0) {
+			if (!encodeFrame(frame)) {
+				_failed = true;
+				return false;
+			}
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(_queueMutex);
+		if (_queue.size() >= _options.queueSize) {
+			if (_options.policy == QueuePolicy::DROP_NEWEST) {
+				++_droppedFrames;
+				return false;
+			}
+			if (_options.policy == QueuePolicy::DROP_OLDEST) {
+				_queue.pop_front();
+				++_droppedFrames;
+			} else {
+				_queueNotFull.wait(lock, [this]() { return _queue.size() < _options.queueSize || _failed; });
+				if (_failed) {
+					return false;
+				}
+			}
+		}
+		_queue.push_back(std::move(frame));
+		lock.unlock();
+		_queueNotEmpty.notify_one();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void FFVideoEncoder::workerLoop()
 	{
-		int got_picture = 0;
+#ifndef HEADLESS
+		while (true) {
+			QueuedFrame frame;
+			{
+				std::unique_lock<std::mutex> lock(_queueMutex);
+				_queueNotEmpty.wait(lock, [this]() { return !_queue.empty() || _stopWorker; });
+				if (_queue.empty()) {
+					return;
+				}
+				frame = std::move(_queue.front());
+				_queue.pop_front();
+			}
+			_queueNotFull.notify_one();
+
+			if (!_failed && !encodeFrame(frame)) {
+				_failed = true;
+				_queueNotFull.notify_all();
+			}
+		}
+#endif
+	}
 
-		int ret = avcodec_encode_video2(pCodecCtx, pkt, frameYUV, &got_picture);
+#ifndef HEADLESS
+	bool FFVideoEncoder::encodeFrame(const QueuedFrame & frame)
+	{
+		cv::Mat yuv = frame.pixels;
+		if (!frame.yuv) {
+			cv::Mat local = frame.pixels;
+			if (local.cols != w || local.rows != h) {
+				cv::resize(frame.pixels, local, cv::Size(w, h));
+			}
+			cv::cvtColor(local, cvFrameYUV, cv::COLOR_BGR2YUV_I420);
+			yuv = cvFrameYUV;
+		}
+
+		const uchar * planeY = yuv.data;
+		const uchar * planeU = planeY + yuSize[0];
+		const uchar * planeV = planeU + yuSize[1];
+		if (pCodecCtx->pix_fmt == AV_PIX_FMT_NV12) {
+			// The encoder might still reference the previous frame buffer.
+			if (av_frame_make_writable(frameYUV) < 0) {
+				SIBR_WRG << "[FFMPEG] Could not write to frame." << std::endl;
+				return false;
+			}
+			for (int y = 0; y < h; ++y) {
+				std::memcpy(frameYUV->data[0] + y * frameYUV->linesize[0], planeY + y * w, w);
+			}
+			const int cw = w / 2;
+			for (int y = 0; y < h / 2; ++y) {
+				uint8_t * dst = frameYUV->data[1] + y * frameYUV->linesize[1];
+				const uchar * u = planeU + y * cw;
+				const uchar * v = planeV + y * cw;
+				for (int x = 0; x < cw; ++x) {
+					dst[2 * x] = u[x];
+					dst[2 * x + 1] = v[x];
+				}
+			}
+		} else {
+			frameYUV->data[0] = const_cast<uchar*>(planeY);
+			frameYUV->data[1] = const_cast<uchar*>(planeU);
+			frameYUV->data[2] = const_cast<uchar*>(planeV);
+		}
+
+		// Timestamps are in frames, dropped frames leave a gap.
+		frameYUV->pts = frame.index;
+		return encode(frameYUV);
+	}
+
+	bool FFVideoEncoder::encode(AVFrame * frame)
+	{
+		int ret = avcodec_send_frame(pCodecCtx, frame);
 		if (ret < 0) {
 			SIBR_WRG << "[FFMPEG] Failed to encode frame." << std::endl;
 			return false;
 		}
-		if (got_picture == 1) {
+		while ((ret = avcodec_receive_packet(pCodecCtx, pkt)) >= 0) {
+			av_packet_rescale_ts(pkt, pCodecCtx->time_base, video_st->time_base);
 			pkt->stream_index = video_st->index;
 			ret = av_write_frame(pFormatCtx, pkt);
 			av_packet_unref(pkt);
+			if (ret < 0) {
+				SIBR_WRG << "[FFMPEG] Failed to write frame." << std::endl;
+				return false;
+			}
 		}
 
-		return true;
+		return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
 	}
 #endif
 
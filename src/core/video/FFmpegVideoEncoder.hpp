@@ -14,7 +14,14 @@
 
 
 #include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <core/graphics/Image.hpp>
+#include <core/graphics/RenderTarget.hpp>
+#include <core/graphics/Shader.hpp>
 #include "Video.hpp"
 #include "Config.hpp"
 
@@ -31,6 +38,8 @@ namespace sibr {
 
 	
 	/** Video encoder using ffmpeg.
+	Frames can be encoded on the caller thread or queued for a worker thread, and
+	render targets can be converted to YUV on the GPU and read back asynchronously.
 	Adapted from https://github.com/leixiaohua1020/simplest_ffmpeg_video_encoder/blob/master/simplest_ffmpeg_video_encoder/simplest_ffmpeg_video_encoder.cpp
 	\ingroup sibr_video
 	*/
@@ -38,37 +47,91 @@ namespace sibr {
 
 	public:
 
+		/** Hardware encoders to try before the software one. */
+		enum class Hardware {
+			NONE, ///< Software encoder only.
+			AUTO, ///< First available of NVENC, QSV, AMF.
+			NVENC, ///< NVIDIA.
+			QSV, ///< Intel QuickSync.
+			AMF ///< AMD.
+		};
+
+		/** What to do with a new frame when the queue is full. */
+		enum class QueuePolicy {
+			BLOCK, ///< Wait for the worker to make room.
+			DROP_NEWEST, ///< Reject the new frame.
+			DROP_OLDEST ///< Discard the oldest queued frame.
+		};
+
+		/** Encoding options. */
+		struct Options {
+			Hardware hardware = Hardware::NONE; ///< Hardware encoders to try, falling back to software.
+			size_t queueSize = 0; ///< Frames waiting for the worker thread, 0 to encode on the caller thread.
+			QueuePolicy policy = QueuePolicy::BLOCK; ///< Behaviour when the queue is full.
+		};
+
+		/** Constructor.
+		\param _filepath destination file, the extension will be used to infer the container type.
+		\param fps target video framerate
+		\param size target video size, should be even else a resize will happen
+		\param forceResize resize frames that are not at the target dimensions instead of ignoring them
+		*/
+		FFVideoEncoder(
+			const std::string & _filepath,
+			double fps,
+			const sibr::Vector2i & size,
+			bool forceResize = false
+		);
+
 		/** Constructor.
 		\param _filepath destination file, the extension will be used to infer the container type.
 		\param fps target video framerate
 		\param size target video size, should be even else a resize will happen
+		\param options encoder selection and queueing
 		\param forceResize resize frames that are not at the target dimensions instead of ignoring them
 		*/
 		FFVideoEncoder(
 			const std::string & _filepath,
 			double fps,
 			const sibr::Vector2i & size,
+			const Options & options,
 			bool forceResize = false
 		);
 
 		/** \return true if the encoder was properly setup. */
 		bool isFine() const;
 
-		/** Close the file. */
+		/** Close the file, after encoding all queued frames.
+		\note Requires the OpenGL context if render targets were encoded.
+		*/
 		void close();
 
 		/** Encode a frame.
-		\param frame the frame to encode
-		\return a success flag 
+		\param frame the frame to encode, copied if it is queued
+		\return a success flag, false if the frame was dropped
 		*/
 		bool operator << (cv::Mat frame);
 
+		/** Encode the content of a render target. The frame is converted to YUV and read
+		back asynchronously, it is encoded once available on a later call or when closing.
+		\param frame the render target to encode, its first color attachment is used
+		\return a success flag, false if the frame was dropped
+		\note Requires the OpenGL context.
+		*/
+		bool operator << (const IRenderTarget & frame);
+
 		/** Encode a frame.
 		\param frame the frame to encode
 		\return a success flag 
 		*/
 		bool operator << (const sibr::ImageRGB & frame);
 
+		/** \return the name of the ffmpeg encoder in use, empty if none. */
+		const std::string & encoderName() const { return _encoderName; }
+
+		/** \return the number of frames dropped because the queue was full. */
+		size_t droppedFrames() const { return _droppedFrames; }
+
 		/// Destructor.
 		~FFVideoEncoder();
 
@@ -78,13 +141,53 @@ namespace sibr {
 		\param size the video target size, prfer using power of two.
 		*/
 		void init(const sibr::Vector2i & size);
-		
-		/** Encode a frame to the file.
+
+		/** A frame waiting to be encoded. */
+		struct QueuedFrame {
+			cv::Mat pixels; ///< BGR or I420 pixels.
+			bool yuv = false; ///< Are the pixels already in I420.
+			int64_t index = 0; ///< Frame index, used as timestamp.
+		};
+
+		/** A render target frame being read back. */
+		struct PendingRead {
+			PixelReadback::Ticket ticket = 0; ///< Readback ticket.
+			int64_t index = 0; ///< Frame index, used as timestamp.
+		};
+
+		/** Encode a frame or hand it to the worker, applying the queue policy.
 		\param frame the frame to encode
-		\return a success flag.
+		\return false if the frame was dropped or the encoding failed
 		*/
+		bool queueFrame(QueuedFrame && frame);
+
+		/** Queue the render target frames that have been read back.
+		\param block wait for all reads in flight
+		*/
+		void collectReads(bool block);
+
+		/** Worker thread loop, encodes queued frames until stopped. */
+		void workerLoop();
+
 //#define HEADLESS
 #ifndef HEADLESS
+		/** Try to open an encoder.
+		\param codec the encoder
+		\param hardware is it a hardware encoder
+		\return true if it was opened, the codec context is then ready
+		*/
+		bool openCodec(AVCodec * codec, bool hardware);
+
+		/** Convert and encode a frame.
+		\param frame the frame to encode
+		\return a success flag.
+		*/
+		bool encodeFrame(const QueuedFrame & frame);
+
+		/** Encode a frame to the file.
+		\param frame the frame to encode, nullptr to flush the encoder
+		\return a success flag.
+		*/
 		bool encode(AVFrame *frame);
 #endif 
 
@@ -95,6 +198,8 @@ namespace sibr {
 		int frameCount = 0; ///< Current frame.
 		double fps; ///< Framerate.
 		bool _forceResize = false; ///< Resize frames.
+		Options _options; ///< Encoding options.
+		std::string _encoderName; ///< Encoder in use.
 		
 #ifndef HEADLESS
 		AVFrame * frameYUV = NULL; ///< Working frame.
@@ -103,14 +208,29 @@ namespace sibr {
 		sibr::Vector2i yuSize; ///< Working size.
 
 #ifndef HEADLESS
-		AVFormatContext* pFormatCtx; ///< Format context.
-		AVOutputFormat* fmt; ///< Output format.
-		AVStream* video_st; ///< Output stream.
-		AVCodecContext* pCodecCtx; ///< Codec context.
-		AVCodec* pCodec; ///< Codec.
-		AVPacket * pkt; ///< Encoding packet.
+		AVFormatContext* pFormatCtx = NULL; ///< Format context.
+		AVOutputFormat* fmt = NULL; ///< Output format.
+		AVStream* video_st = NULL; ///< Output stream.
+		AVCodecContext* pCodecCtx = NULL; ///< Codec context.
+		AVCodec* pCodec = NULL; ///< Codec.
+		AVPacket * pkt = NULL; ///< Encoding packet.
 		
 #endif
+		std::deque<QueuedFrame> _queue; ///< Frames waiting for the worker.
+		std::mutex _queueMutex; ///< Queue lock.
+		std::condition_variable _queueNotEmpty; ///< Signaled when a frame is queued or the worker should stop.
+		std::condition_variable _queueNotFull; ///< Signaled when the worker takes a frame.
+		std::thread _worker; ///< Encoding thread, if queueing.
+		bool _stopWorker = false; ///< Ask the worker to stop once the queue is empty.
+		std::atomic<bool> _failed{ false }; ///< Did an encoding fail.
+		std::atomic<size_t> _droppedFrames{ 0 }; ///< Frames dropped by the queue policy.
+
+		GLShader _yuvShader; ///< RGB to I420 conversion shader.
+		GLParameter _yuvSize; ///< Video size uniform.
+		GLuint _yuvSampler = 0; ///< Bilinear sampler for the chroma subsampling.
+		RenderTargetLum::Ptr _yuvTarget; ///< I420 planes, stacked as in memory.
+		PixelReadback::Ptr _readback; ///< Asynchronous read back of the I420 planes.
+		std::deque<PendingRead> _pendingReads; ///< Reads in flight, oldest first.
 		static bool ffmpegInitDone; ///< FFMPEG initialization status.
 
 	};
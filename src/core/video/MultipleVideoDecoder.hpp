@@ -51,6 +51,8 @@ namespace sibr
 
 
 	/** Batch decoding of multiple videos at the same time, stored in a texture array.
+	* Decoding can happen ahead on worker threads (see prefetch), and uploads can go through
+	* a staging ring so that they don't wait for the GPU (see uploader).
 	* \ingroup sibr_video
 	*/
 	template<typename T, uint N>
@@ -58,6 +60,18 @@ namespace sibr
 		using TexArray = sibr::Texture2DArray<T,N>;
 		using TexArrayPtr = typename TexArray::Ptr;
 
+		/** Decode the frames of a set of video players ahead, each one on its own worker thread.
+		\param videos the video players
+		\param ringSize number of frames to decode ahead per video, 0 to disable
+		\param hardware use hardware decoding when available, applied when a video is (re)loaded
+		*/
+		static void prefetch(const std::vector<sibr::VideoPlayer::Ptr> & videos, size_t ringSize, bool hardware = false) {
+			for (const auto & video : videos) {
+				video->setHardwareDecoding(hardware);
+				video->setPrefetch(ringSize);
+			}
+		}
+
 		/** Update a set of video players to the next frame.
 		\param videos the video players to udpate
 		\note Internally calls both updateCPU and updateGPU.
@@ -103,7 +117,13 @@ namespace sibr
 				}			
 			}
 
-			if (getLoadingTexArray().get()) {
+			if (getLoadingTexArray().get() && uploader && getLoadingTexArray()->w() > 0) {
+				std::vector<int> slices(numVids);
+				for (size_t i = 0; i < numVids; ++i) {
+					slices[i] = int(i);
+				}
+				getLoadingTexArray()->updateSlicesAsync(frames, slices, *uploader);
+			} else if (getLoadingTexArray().get()) {
 				getLoadingTexArray()->updateFromImages(frames);
 			} else {
 				getLoadingTexArray() = TexArrayPtr(new TexArray(frames));
@@ -119,6 +139,7 @@ namespace sibr
 		bool first = true; ///< First frame.
 		int loadingTexArray = 1, displayTexArray = 1; ///< Texture indices.
 		TexArrayPtr ping, pong; ///< Textures.
+		TextureUploader::Ptr uploader; ///< If set, frames are uploaded through this staging ring.
 	};
 
 
@@ -184,7 +205,12 @@ namespace sibr
 			}
 
 			CHECK_GL_ERROR;
-			getLoadingTexArray()->updateSlices(frames, slices);
+			// The loading array is not displayed, its uploads can complete later.
+			if (uploader && getLoadingTexArray()->w() > 0) {
+				getLoadingTexArray()->updateSlicesAsync(frames, slices, *uploader);
+			} else {
+				getLoadingTexArray()->updateSlices(frames, slices);
+			}
 		}
 
 	};
@@ -11,14 +11,40 @@
 
 
 #include "Video.hpp"
+#include "VideoPrefetcher.hpp"
 #include <opencv2/videoio.hpp>
+#include <opencv2/core/version.hpp>
+
+// Hardware acceleration properties were added to the FFMPEG backend in OpenCV 4.5.2.
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+#define SIBR_VIDEO_HW_DECODING
+#endif
 // #include "VideoUtils.hpp"
 
 namespace sibr
 {
+	cv::VideoCapture Video::openCapture(const std::string & path, bool hardware)
+	{
+		if (hardware) {
+#ifdef SIBR_VIDEO_HW_DECODING
+			cv::VideoCapture hwCap(path, cv::CAP_FFMPEG, { cv::CAP_PROP_HW_ACCELERATION, cv::VIDEO_ACCELERATION_ANY });
+			if (hwCap.isOpened()) {
+				if ((int)hwCap.get(cv::CAP_PROP_HW_ACCELERATION) == cv::VIDEO_ACCELERATION_NONE) {
+					SIBR_LOG << "[Video] No hardware decoder for " << path << ", using software decoding." << std::endl;
+				}
+				return hwCap;
+			}
+#else
+			SIBR_WRG << "[Video] Hardware decoding requires OpenCV 4.5.2, using software decoding." << std::endl;
+#endif
+		}
+		return cv::VideoCapture(path);
+	}
+
 	bool Video::load(const std::string & path)
 	{
-		cap = cv::VideoCapture(path);
+		prefetcher.reset();
+		cap = openCapture(path, hardwareDecoding);
 		filepath = path;
 		loaded = cap.isOpened();
 		if (loaded) {
@@ -28,10 +54,28 @@ namespace sibr
 			resolution[1] = (int)cap.get(cv::VideoCaptureProperties::CAP_PROP_FRAME_HEIGHT);
 			codec = (int)cap.get(cv::VideoCaptureProperties::CAP_PROP_FOURCC);
 			SIBR_LOG << "[Video] " << path << " loaded." << std::endl;
+			if (prefetchSize > 0) {
+				prefetcher.reset(new VideoPrefetcher(path, prefetchSize, hardwareDecoding));
+			}
 		}
 		return loaded;
 	}
 
+	void Video::setPrefetch(size_t ringSize)
+	{
+		prefetchSize = ringSize;
+		if (!loaded) {
+			return;
+		}
+		const int start = prefetcher ? prefetcher->position() : (int)cap.get(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES);
+		prefetcher.reset();
+		if (ringSize > 0) {
+			prefetcher.reset(new VideoPrefetcher(filepath.string(), ringSize, hardwareDecoding, start));
+		} else {
+			cap.set(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES, start);
+		}
+	}
+
 	const sibr::Vector2i & Video::getResolution() { 
 		checkLoad();  
 		return resolution; 
@@ -44,11 +88,18 @@ namespace sibr
 
 	int Video::getCurrentFrameNumber() { 
 		checkLoad();  
+		if (prefetcher) {
+			return prefetcher->position();
+		}
 		return (int)cap.get(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES); 
 	}
 	
 	void Video::setCurrentFrame(int i){ 
 		checkLoad(); 
+		if (prefetcher) {
+			prefetcher->seek(i);
+			return;
+		}
 		cap.set(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES, i); 
 	}
 	
@@ -77,6 +128,7 @@ namespace sibr
 
 	void Video::release()
 	{
+		prefetcher.reset();
 		cap = cv::VideoCapture();
 		loaded = false;
 	}
@@ -100,13 +152,14 @@ namespace sibr
 		const int N = npixels * nc;
 		const int L = ending_frame - starting_frame + 1;
 
+		// Read from our own capture, a prefetching ring is left untouched.
 		cv::Mat volume(L, N, CV_8UC1);
-		setCurrentFrame(starting_frame);
+		cap.set(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES, starting_frame);
 		for (int i = 0; i < L; ++i) {
 			cv::Mat mat = volume.row(i).reshape(3, h);
 			cap >> mat;
 		}
-		setCurrentFrame(0);
+		cap.set(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES, 0);
 
 		return volume;
 	}
@@ -115,6 +168,10 @@ namespace sibr
 	{
 		checkLoad();
 		cv::Mat frame;
+		if (prefetcher) {
+			prefetcher->next(frame);
+			return frame;
+		}
 		cap >> frame;
 		return frame;
 	}
@@ -149,6 +206,8 @@ namespace sibr
 
 	bool VideoPlayer::load(const std::string & path) {
 		VideoPlayer other;
+		other.hardwareDecoding = hardwareDecoding;
+		other.prefetchSize = prefetchSize;
 		if (other.Video::load(path)) {
 			*this = other;
 			return true;
@@ -216,7 +275,9 @@ namespace sibr
 			sibr::Vector2f displayTexSize(getDisplayTex()->w(), getDisplayTex()->h());
 			sibr::Vector2i viewResolution = (ratio_display*displayTexSize).cast<int>();
 			
-			sibr::ImageWithCallback(getDisplayTex()->handle(), viewResolution, callBackData, zoomData.topLeft(), zoomData.bottomRight());
+			const sibr::Vector2i texSize = displayTexSize.cast<int>();
+			sibr::ImageWithCallback(getDisplayTex()->handle(), viewResolution, callBackData, zoomData.topLeft(), zoomData.bottomRight(), texSize, texUpdated[displayTex]);
+			texUpdated[displayTex] = false;
 
 			updateZoom(displayTexSize);
 		}
@@ -250,6 +311,7 @@ namespace sibr
 
 	void VideoPlayer::updateGPU()
 	{
+		texUpdated[loadingTex] = true;
 		if (getLoadingTex().get()) {
 			getLoadingTex()->update(tmpFrame);
 		} else {
@@ -24,8 +24,10 @@
 
 namespace sibr
 {
+	class VideoPrefetcher;
 
 	/** Video loaded from a file using OpenCV VideoCapture and FFMPEG.
+	* Frames can be decoded ahead of time on a worker thread, see setPrefetch.
 	* \ingroup sibr_video
 	*/
 	class SIBR_VIDEO_EXPORT Video
@@ -103,6 +105,27 @@ namespace sibr
 		/** \return true if the video exists on disk. */
 		bool exists() const;
 
+		/** Use hardware decoding (D3D11/VAAPI through the OpenCV FFMPEG backend) when available.
+		\param enable the new setting, applied at the next load
+		\note Requires OpenCV 4.5.2 or later, else software decoding is used.
+		*/
+		void setHardwareDecoding(bool enable) { hardwareDecoding = enable; }
+
+		/** Decode frames ahead on a worker thread, next() and setCurrentFrame then go through the ring.
+		\param ringSize number of frames to decode ahead, 0 to disable
+		*/
+		void setPrefetch(size_t ringSize);
+
+		/** \return the number of frames decoded ahead, 0 if not prefetching. */
+		size_t getPrefetch() const { return prefetchSize; }
+
+		/** Open a capture.
+		\param path the path to the video
+		\param hardware try hardware decoding first
+		\return the capture, check isOpened
+		*/
+		static cv::VideoCapture openCapture(const std::string & path, bool hardware);
+
 	protected:
 		
 		/** Check if the video is loaded. */
@@ -116,6 +139,9 @@ namespace sibr
 		double frameRate = 0.0; ///< Video frame rate.
 		int codec = 0; ///< Codec used to read the video.
 		bool loaded = false; ///< Video loading status.
+		bool hardwareDecoding = false; ///< Try hardware decoding.
+		size_t prefetchSize = 0; ///< Frames decoded ahead.
+		std::shared_ptr<VideoPrefetcher> prefetcher; ///< Worker decoding ahead, if prefetching.
 	};
 
 
@@ -197,6 +223,7 @@ namespace sibr
 		int displayTex = 1; ///< Index of the display texture.
 		int loadingTex = 1; ///< Index of the loading texture.
 		std::shared_ptr<sibr::Texture2DRGB> ping,pong; ///< Double buffer textures.
+		bool texUpdated[2] = { true, true }; ///< Was each texture updated since it was last displayed.
 		cv::Mat tmpFrame; ///< Scratch frame.
 		Transformation transformation; ///< Transformation to apply to each frame.
 		int current_frame_slider; ///< Slider position.
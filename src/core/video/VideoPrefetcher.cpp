@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "VideoPrefetcher.hpp"
+#include "Video.hpp"
+
+#include <algorithm>
+
+namespace sibr
+{
+	VideoPrefetcher::VideoPrefetcher(const std::string & path, size_t ringSize, bool hardware, int start) :
+		_ringSize(std::max(ringSize, size_t(1))), _position(start)
+	{
+		_cap = Video::openCapture(path, hardware);
+		_open = _cap.isOpened();
+		if (!_open) {
+			SIBR_WRG << "[Video] Could not open " << path << " for prefetching." << std::endl;
+			return;
+		}
+		_seekTo = start > 0 ? start : -1;
+		_worker = std::thread(&VideoPrefetcher::run, this);
+	}
+
+	VideoPrefetcher::~VideoPrefetcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_roomReady.notify_all();
+		_frameReady.notify_all();
+		if (_worker.joinable()) {
+			_worker.join();
+		}
+	}
+
+	bool VideoPrefetcher::next(cv::Mat & frame, bool block)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (block) {
+			_frameReady.wait(lock, [this]() { return !_ring.empty() || _end || _stop || !_open; });
+		}
+		if (_ring.empty()) {
+			return false;
+		}
+		frame = _ring.front();
+		_ring.pop_front();
+		++_position;
+		lock.unlock();
+		_roomReady.notify_one();
+		return true;
+	}
+
+	void VideoPrefetcher::seek(int frame)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_ring.clear();
+			_position = frame;
+			_seekTo = frame;
+			_end = false;
+			++_generation;
+		}
+		_roomReady.notify_one();
+	}
+
+	int VideoPrefetcher::position() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _position;
+	}
+
+	size_t VideoPrefetcher::available() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _ring.size();
+	}
+
+	void VideoPrefetcher::run()
+	{
+		while (true) {
+			int seekTo = -1;
+			uint64_t generation = 0;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_roomReady.wait(lock, [this]() { return _stop || _seekTo >= 0 || (!_end && _ring.size() < _ringSize); });
+				if (_stop) {
+					return;
+				}
+				seekTo = _seekTo;
+				_seekTo = -1;
+				generation = _generation;
+			}
+
+			// Decode without holding the lock.
+			if (seekTo >= 0) {
+				_cap.set(cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES, seekTo);
+			}
+			cv::Mat frame;
+			const bool decoded = _cap.read(frame) && !frame.empty();
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				// A seek happened while decoding, the frame is from the old position.
+				if (generation != _generation) {
+					continue;
+				}
+				if (decoded) {
+					_ring.push_back(frame);
+				} else {
+					_end = true;
+				}
+			}
+			_frameReady.notify_all();
+		}
+	}
+
+} // namespace sibr
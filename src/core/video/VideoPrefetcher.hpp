@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+
+#include <opencv2/videoio.hpp>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace sibr
+{
+
+	/** Decode the frames of a video ahead of time on a worker thread, in a bounded ring.
+	* The prefetcher uses its own capture, independent of the one of the video it serves.
+	* Seeking discards the ring and restarts decoding from the new position.
+	* \ingroup sibr_video
+	*/
+	class SIBR_VIDEO_EXPORT VideoPrefetcher
+	{
+		SIBR_CLASS_PTR(VideoPrefetcher);
+		SIBR_DISALLOW_COPY(VideoPrefetcher);
+
+	public:
+
+		/** Constructor, starts decoding.
+		\param path the path to the video file
+		\param ringSize maximum number of decoded frames kept ahead
+		\param hardware use hardware decoding if available
+		\param start index of the first frame to decode
+		*/
+		VideoPrefetcher(const std::string & path, size_t ringSize, bool hardware, int start = 0);
+
+		/// Destructor, stops the worker.
+		~VideoPrefetcher();
+
+		/** \return true if the video could be opened. */
+		bool isOpen() const { return _open; }
+
+		/** Get the next frame.
+		\param frame will contain the frame
+		\param block wait for the frame if it is not decoded yet
+		\return false at the end of the video, or if the frame is not ready when not blocking
+		*/
+		bool next(cv::Mat & frame, bool block = true);
+
+		/** Restart decoding at a given frame.
+		\param frame the index of the next frame to return
+		*/
+		void seek(int frame);
+
+		/** \return the index of the frame the next call to next() will return. */
+		int position() const;
+
+		/** \return the number of frames decoded and waiting. */
+		size_t available() const;
+
+	private:
+
+		/** Worker loop, decodes until the ring is full or the end is reached. */
+		void run();
+
+		cv::VideoCapture _cap; ///< Capture used by the worker only.
+		bool _open = false; ///< Was the video opened.
+		size_t _ringSize; ///< Maximum number of decoded frames.
+		std::deque<cv::Mat> _ring; ///< Decoded frames, oldest first.
+		int _position = 0; ///< Index of the oldest frame in the ring.
+		int _seekTo = -1; ///< Pending seek for the worker, -1 if none.
+		uint64_t _generation = 0; ///< Incremented on seek, frames of older generations are discarded.
+		bool _end = false; ///< Did the worker reach the end of the video.
+		bool _stop = false; ///< Ask the worker to stop.
+		mutable std::mutex _mutex; ///< State lock.
+		std::condition_variable _frameReady; ///< Signaled when a frame is decoded or the end is reached.
+		std::condition_variable _roomReady; ///< Signaled when a frame is taken, on seek and on stop.
+		std::thread _worker; ///< Decoding thread.
+	};
+
+} // namespace sibr
@@ -1445,18 +1445,193 @@ namespace sibr {
 	//		return out;
 	//	}
 
+	namespace {
+
+		/// Binomial taps shared by the temporal blur, the downscale and the upscale, to be divided by 16.
+		const float kTemporalKernel[5] = { 1.0f, 4.0f, 6.0f, 4.0f, 1.0f };
+
+		/// Number of floats accumulated at once by weightedRowSum, the accumulator stays in L1.
+		const size_t kRowBlock = 1024;
+
+		/** Compute dst = sum_k weights[k] * rows[k] in a single pass over the inputs, block by block.
+		 * The inner loops are kept trivial so that the compiler vectorizes them. dst can alias one of the rows.
+		 * \param rows input rows
+		 * \param weights one weight per row
+		 * \param count number of rows
+		 * \param dst output row
+		 * \param size number of floats per row
+		 */
+		void weightedRowSum(const float * const * rows, const float * weights, int count, float * dst, size_t size)
+		{
+			float acc[kRowBlock];
+			for (size_t start = 0; start < size; start += kRowBlock) {
+				const size_t n = std::min(kRowBlock, size - start);
+				const float * r0 = rows[0] + start;
+				const float w0 = weights[0];
+				for (size_t i = 0; i < n; ++i) {
+					acc[i] = w0 * r0[i];
+				}
+				for (int k = 1; k < count; ++k) {
+					const float * rk = rows[k] + start;
+					const float wk = weights[k];
+					for (size_t i = 0; i < n; ++i) {
+						acc[i] += wk * rk[i];
+					}
+				}
+				std::copy(acc, acc + n, dst + start);
+			}
+		}
+
+		/** Frames and weights of the 5-tap temporal blur around frame t, same border handling as cv::BORDER_DEFAULT.
+		 * \param t center frame
+		 * \param l number of frames
+		 * \param scaling kernel scaling
+		 * \param frames will contain the 5 frame indices
+		 * \param weights will contain the 5 weights
+		 */
+		void temporalTaps(int t, int l, float scaling, int * frames, float * weights)
+		{
+			for (int k = 0; k < 5; ++k) {
+				frames[k] = cv::borderInterpolate(t + k - 2, l, cv::BORDER_REFLECT_101);
+				weights[k] = kTemporalKernel[k] * scaling / 16.0f;
+			}
+		}
+
+		/** Frames of a downscaled layer contributing to frame t of the upscaled one, with their weights.
+		 * Upscaling puts the down frames on the even frames, zeros on the odd ones, and blurs with a scaling of 2;
+		 * by linearity this reduces to a weighted sum of at most 3 down frames.
+		 * \param t upscaled frame
+		 * \param upL number of upscaled frames
+		 * \param downL number of down frames
+		 * \param frames will contain the down frame indices
+		 * \param weights will contain the weights
+		 * \return the number of contributing frames
+		 */
+		int upscaleTaps(int t, int upL, int downL, int * frames, float * weights)
+		{
+			int count = 0;
+			for (int k = 0; k < 5; ++k) {
+				const int u = cv::borderInterpolate(t + k - 2, upL, cv::BORDER_REFLECT_101);
+				if (u % 2 != 0 || u / 2 >= downL) {
+					continue;
+				}
+				const float weight = kTemporalKernel[k] * 2.0f / 16.0f;
+				int j = 0;
+				while (j < count && frames[j] != u / 2) {
+					++j;
+				}
+				if (j == count) {
+					frames[count] = u / 2;
+					weights[count] = 0.0f;
+					++count;
+				}
+				weights[j] += weight;
+			}
+			return count;
+		}
+
+		/** Compute dst = base + sign * upscale(down) frame by frame, without building the intermediate volumes.
+		 * The temporal blur is applied first on the low resolution frames, then each frame is upsampled once.
+		 * \param down the low resolution layer
+		 * \param up the layer giving the output size
+		 * \param base optional volume added to the result, can be dst
+		 * \param sign scaling of the upscaled layer
+		 * \param dst output volume, already allocated
+		 * \param params the pyramid parameters
+		 */
+		void accumulateUpscaled(const PyramidLayer & down, const PyramidLayer & up, const cv::Mat * base, float sign, cv::Mat & dst, const PyramidParameters & params)
+		{
+			const size_t downSize = size_t(down.volume.cols);
+			const size_t upSize = size_t(dst.cols);
+
+#pragma omp parallel
+			{
+				cv::Mat combined(1, int(downSize), CV_32FC1);
+				cv::Mat upscaled(up.h, up.w, CV_32FC3);
+
+#pragma omp for
+				for (int t = 0; t < up.l; ++t) {
+					int frames[5];
+					float weights[5];
+					const float * rows[5];
+					const int count = upscaleTaps(t, up.l, down.l, frames, weights);
+					for (int k = 0; k < count; ++k) {
+						rows[k] = down.volume.ptr<float>(frames[k]);
+						weights[k] *= sign;
+					}
+
+					const float * upRow = nullptr;
+					if (count == 0) {
+						combined.setTo(0.0f);
+					} else {
+						weightedRowSum(rows, weights, count, combined.ptr<float>(), downSize);
+					}
+					if (params.splacialDS) {
+						cv::pyrUp(combined.reshape(3, down.h), upscaled, upscaled.size());
+						upRow = upscaled.ptr<float>();
+					} else {
+						upRow = combined.ptr<float>();
+					}
+
+					float * dstRow = dst.ptr<float>(t);
+					if (base) {
+						const float * baseRow = base->ptr<float>(t);
+						for (size_t i = 0; i < upSize; ++i) {
+							dstRow[i] = baseRow[i] + upRow[i];
+						}
+					} else {
+						std::copy(upRow, upRow + upSize, dstRow);
+					}
+				}
+			}
+		}
+
+		/** Blend two float volumes in place, A = A * m + B * (1 - m) with m = scale * M.
+		 * \param A first volume, receives the result
+		 * \param B second volume
+		 * \param M mask volume
+		 * \param scale mask scaling
+		 */
+		void blendInPlace(cv::Mat & A, const cv::Mat & B, const cv::Mat & M, float scale)
+		{
+			const int size = A.cols;
+#pragma omp parallel for
+			for (int t = 0; t < A.rows; ++t) {
+				float * a = A.ptr<float>(t);
+				const float * b = B.ptr<float>(t);
+				const float * m = M.ptr<float>(t);
+				for (int i = 0; i < size; ++i) {
+					const float w = scale * m[i];
+					a[i] = b[i] + w * (a[i] - b[i]);
+				}
+			}
+		}
+
+	}
+
 	PyramidLayer temporalBlur(const PyramidLayer & layer, const PyramidParameters &  params, float scaling)
 	{
-		const cv::Mat kernel = (scaling / 16.0f)*(cv::Mat_<float>(5, 1) << 1, 4, 6, 4, 1);
-		cv::Mat vol = layer.volume.clone();
-		cv::filter2D(vol, vol, -1, kernel, { -1,-1 }, 0.0, cv::BORDER_DEFAULT);
-		return PyramidLayer(vol, layer.w, layer.h);
+		PyramidLayer out(layer.w, layer.h, layer.l);
+		const size_t size = size_t(layer.volume.cols);
+
+#pragma omp parallel for
+		for (int t = 0; t < layer.l; ++t) {
+			int frames[5];
+			float weights[5];
+			const float * rows[5];
+			temporalTaps(t, layer.l, scaling, frames, weights);
+			for (int k = 0; k < 5; ++k) {
+				rows[k] = layer.volume.ptr<float>(frames[k]);
+			}
+			weightedRowSum(rows, weights, 5, out.volume.ptr<float>(t), size);
+		}
+		return out;
 	}
 
 	void temporalBlurInPlace(PyramidLayer & layer, const PyramidParameters & params, float scaling)
 	{
-		const cv::Mat kernel = (scaling / 16.0f)*(cv::Mat_<float>(5, 1) << 1, 4, 6, 4, 1);
-		cv::filter2D(layer.volume, layer.volume, -1, kernel, { -1,-1 }, 0.0, cv::BORDER_DEFAULT);
+		// Each output frame reads up to 5 input frames, write back into the existing buffer so that shared copies see the result.
+		temporalBlur(layer, params, scaling).volume.copyTo(layer.volume);
 	}
 
 	PyramidLayer decimate(const PyramidLayer & layer, const PyramidParameters &  params)
@@ -1480,42 +1655,13 @@ namespace sibr {
 
 	PyramidLayer upscale(const PyramidLayer & layerUp, const PyramidLayer & layerDown, const PyramidParameters &  params)
 	{
-		//std::cout << layerUp.w << " " << layerUp.h << " " << layerUp.l << std::endl;
-		//std::cout << layerDown.w << " " << layerDown.h << " " << layerDown.l << std::endl;
-
 		PyramidLayer out(layerUp.w, layerUp.h, layerUp.l);
-		//#pragma omp parallel for
-		for (int t = 0; t < layerDown.l; ++t) {
-			//if (2 * t + 1 >= layerUp.l) {
-			//	continue;
-			//}
-			//cv::Mat sliceUp = out.volume.row(2 * t + 1).reshape(3, layerUp.h);
-			cv::Mat sliceUp = out.volume.row(2 * t).reshape(3, layerUp.h);
-			cv::Mat sliceDown = layerDown.volume.row(t).reshape(3, layerDown.h);
-
-			if (params.splacialDS) {
-				cv::pyrUp(sliceDown, sliceUp, sliceUp.size());
-			} else {
-				sliceDown.copyTo(sliceUp);
-			}
-
-
-			//	if (2 * t + 1 < layerUp.l) {
-			//		sliceUp.copyTo(out.volume.row(2 * t + 1).reshape(3, layerUp.h));
-			//	}
-		}
-		temporalBlurInPlace(out, params, 2.0f);
+		accumulateUpscaled(layerDown, layerUp, nullptr, 1.0f, out.volume, params);
 		return out;
 	}
 
 	PyramidLayer downscale(const PyramidLayer & layer, const PyramidParameters &  params)
 	{
-
-		PyramidLayer blured = temporalBlur(layer, params);
-		//std::cout << " temporal blur " << std::endl;
-		//blured.show();
-		//std::cout << " temporal blur end" << std::endl;
-
 		PyramidLayer out;
 
 		if (params.splacialDS) {
@@ -1524,50 +1670,32 @@ namespace sibr {
 			out = PyramidLayer(layer.w, layer.h, (layer.l + 1) / 2);
 		}
 
-		//#pragma omp parallel for
-		for (int t = 0; t < out.l; ++t) {
-			//if (2 * t + 1 >= layer.l) {
-			//	continue;
-			//}
-			//cv::Mat sliceCurrent = blured.volume.row(2 * t + 1).reshape(3, layer.h);
-			cv::Mat sliceCurrent = blured.volume.row(2 * t).reshape(3, layer.h);
-			cv::Mat sliceDecimated = out.volume.row(t).reshape(3, out.h);
+		// Only the even frames of the temporal blur are needed, compute them directly.
+		const size_t size = size_t(layer.volume.cols);
+#pragma omp parallel
+		{
+			cv::Mat blured(1, int(size), CV_32FC1);
+
+#pragma omp for
+			for (int t = 0; t < out.l; ++t) {
+				int frames[5];
+				float weights[5];
+				const float * rows[5];
+				temporalTaps(2 * t, layer.l, 1.0f, frames, weights);
+				for (int k = 0; k < 5; ++k) {
+					rows[k] = layer.volume.ptr<float>(frames[k]);
+				}
 
-			if (params.splacialDS) {
-				cv::pyrDown(sliceCurrent, sliceDecimated);
-			} else {
-				sliceCurrent.copyTo(sliceDecimated);
+				if (params.splacialDS) {
+					weightedRowSum(rows, weights, 5, blured.ptr<float>(), size);
+					cv::Mat sliceDecimated = out.volume.row(t).reshape(3, out.h);
+					cv::pyrDown(blured.reshape(3, layer.h), sliceDecimated);
+				} else {
+					weightedRowSum(rows, weights, 5, out.volume.ptr<float>(t), size);
+				}
 			}
-
 		}
 
-		//PyramidLayer blur (layer.w, layer.h, (layer.l + 1) / 2);
-
-		//for (int i = 0; i < blur.volume.rows; ++i) {
-		//	cv::pyrDown(layer.volume.row(i), blur.volume.row(i), blur.volume.row(i).size());
-		//}
-
-		//PyramidLayer out;
-		//if (params.splacialDS) {
-		//	out = PyramidLayer((layer.w + 1) / 2, (layer.h + 1) / 2, blur.l);
-		//} else {
-		//	out = PyramidLayer(layer.w, layer.h, blur.l);
-		//}
-
-		//for (int t = 0; t < out.l; ++t) {
-		//	if (2 * t + 1 >= layer.l) {
-		//		continue;
-		//	}
-		//	cv::Mat sliceCurrent = blur.volume.row(2 * t + 1).reshape(3, layer.h);
-		//	cv::Mat sliceDecimated = out.volume.row(t).reshape(3, out.h);
-
-		//	if (params.splacialDS) {
-		//		cv::pyrDown(sliceCurrent, sliceDecimated);
-		//	} else {
-		//		sliceCurrent.copyTo(sliceDecimated);
-		//	}
-		//}
-
 		return out;
 	}
 
@@ -1595,8 +1723,10 @@ namespace sibr {
 	{
 		PyramidLayer out = layers.back();
 		for (int i = (int)layers.size() - 2; i >= 0; --i) {
-			PyramidLayer up = upscale(layers[i], out, params);
-			out = up + layers[i];
+			// layers[i] + upscale(out), without the intermediate upscaled layer.
+			PyramidLayer up(layers[i].w, layers[i].h, layers[i].l);
+			accumulateUpscaled(out, layers[i], &layers[i].volume, 1.0f, up.volume, params);
+			out = up;
 		}
 		return out;
 	}
@@ -1630,16 +1760,22 @@ namespace sibr {
 		VideoLaplacianPyramid out;
 		out.params = params;
 
-		PyramidLayer currentLayer = vid;
-		currentLayer.volume.convertTo(currentLayer.volume, CV_32FC1);
+		// Each level is turned into its Laplacian layer in place, so work on a copy of the input.
+		PyramidLayer currentLayer;
+		currentLayer.copySizeFrom(vid);
+		if (vid.volume.type() == CV_32FC1) {
+			currentLayer.volume = vid.volume.clone();
+		} else {
+			vid.volume.convertTo(currentLayer.volume, CV_32FC1);
+		}
 
 		for (int i = 0; i < nLevels - 1; ++i) {
 			PyramidLayer down = downscale(currentLayer, params);
-			PyramidLayer up = upscale(currentLayer, down, params);
+			accumulateUpscaled(down, currentLayer, &currentLayer.volume, -1.0f, currentLayer.volume, params);
 			if (show) {
-				up.show();
+				currentLayer.show();
 			}
-			out.layers.push_back(currentLayer - up);
+			out.layers.push_back(currentLayer);
 			currentLayer = down;
 		}
 
@@ -1693,17 +1829,9 @@ namespace sibr {
 
 		VideoLaplacianPyramid out;
 		for (int l = 0; l < num_lvls; ++l) {
-			sibr::PyramidLayer layer;
-			layer.w = pyrA.layers[l].w;
-			layer.h = pyrA.layers[l].h;
-			layer.l = pyrA.layers[l].l;
-
-			cv::Mat A_lvl = pyrA.layers[l].volume;
-			cv::Mat B_lvl = pyrB.layers[l].volume;
-			cv::Mat M_lvl = pyrM.layers[l].volume;
-
-			layer.volume = A_lvl.mul(M_lvl) + B_lvl.mul(1.0f - M_lvl);
-			out.layers.push_back(layer);
+			// The pyramids are local, blend directly into A.
+			blendInPlace(pyrA.layers[l].volume, pyrB.layers[l].volume, pyrM.layers[l].volume, 1.0f);
+			out.layers.push_back(pyrA.layers[l]);
 		}
 
 		return out.collapse();
@@ -1723,32 +1851,9 @@ namespace sibr {
 
 			std::cout << l << std::endl;
 
-			sibr::PyramidLayer layer;
-			layer.w = pyrA.layers[l].w;
-			layer.h = pyrA.layers[l].h;
-			layer.l = pyrA.layers[l].l;
-
-			cv::Mat A_lvl = pyrA.layers[l].volume;
-			cv::Mat B_lvl = pyrB.layers[l].volume;
-			cv::Mat M_lvl = pyrM.layers[l].volume;
-
-
-			cv::Mat rev_Mask = 255 - M_lvl;
-			sibr::PyramidLayer test(rev_Mask, pyrM.layers[l].w, pyrM.layers[l].h);
-
-			//pyrA.layers[l].show();
-			//pyrB.layers[l].show();
-			//pyrM.layers[l].show();
-
-			//test.show();
-
-			cv::Mat normalized_mask = (1 / 255.0)*M_lvl;
-			cv::Mat normalized_mask_r = (1 / 255.0)*test.volume;
-
-			layer.volume = A_lvl.mul(normalized_mask) + B_lvl.mul(normalized_mask_r);
-			//layer.show();
-
-			out.layers.push_back(layer);
+			// A * M / 255 + B * (255 - M) / 255, in place in the local pyramid.
+			blendInPlace(pyrA.layers[l].volume, pyrB.layers[l].volume, pyrM.layers[l].volume, 1.0f / 255.0f);
+			out.layers.push_back(pyrA.layers[l]);
 		}
 
 		return out.collapse();
@@ -14,6 +14,7 @@
 
 #include "Config.hpp"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
 #include <functional>
 #include "FFmpegVideoEncoder.hpp"
 
@@ -872,11 +873,92 @@ namespace sibr {
 			++bins[whatBin(value)];
 		}
 		void addValues(const std::vector<Value> & values) {
-			for (const Value & v : values) {
-				addValue(v);
+			if (!values.empty()) {
+				addValues(values[0].data(), values.size(), sizeof(Value) / sizeof(T));
 			}
 		}
 
+		/** Add values stored contiguously, with their N components next to each other.
+		 * The values are split in chunks counted in parallel: the bins of a chunk are computed as linear keys
+		 * in a branchless loop, sorted and counted by runs, so that the bins map is only updated once per
+		 * distinct bin and chunk.
+		 * \param data the first component of the first value
+		 * \param count the number of values
+		 * \param stride the distance between two values, in components
+		 */
+		void addValues(const T * data, size_t count, size_t stride = N) {
+			const size_t chunkSize = size_t(1) << 16;
+			const int chunks = int((count + chunkSize - 1) / chunkSize);
+			std::vector<std::vector<std::pair<uint64_t, uint>>> counts(chunks);
+			double scale[N], offset[N];
+			for (uint c = 0; c < N; ++c) {
+				scale[c] = scaling[c];
+				offset[c] = min[c];
+			}
+			const int lastBin = (int)numBins - 1;
+
+#pragma omp parallel for
+			for (int k = 0; k < chunks; ++k) {
+				const size_t begin = size_t(k) * chunkSize;
+				const size_t end = std::min(count, begin + chunkSize);
+				std::vector<uint64_t> keys(end - begin);
+				for (size_t i = begin; i < end; ++i) {
+					const T * value = data + i * stride;
+					uint64_t key = 0;
+					for (int c = int(N) - 1; c >= 0; --c) {
+						const int bin = std::min(std::max((int)(scale[c] * (value[c] - offset[c])), 0), lastBin);
+						key = key * numBins + uint64_t(bin);
+					}
+					keys[i - begin] = key;
+				}
+				std::sort(keys.begin(), keys.end());
+				for (size_t i = 0; i < keys.size();) {
+					size_t j = i + 1;
+					while (j < keys.size() && keys[j] == keys[i]) {
+						++j;
+					}
+					counts[k].emplace_back(keys[i], uint(j - i));
+					i = j;
+				}
+			}
+
+			for (const auto & chunk : counts) {
+				for (const auto & key_count : chunk) {
+					Indice bin;
+					uint64_t key = key_count.first;
+					for (uint c = 0; c < N; ++c) {
+						bin[c] = uint(key % numBins);
+						key /= numBins;
+					}
+					bins[bin] += key_count.second;
+				}
+			}
+		}
+
+		/** Add all the pixels of an image, or all the values of a volume matrix.
+		 * \param mat a matrix of T components, the components of each row are grouped by N
+		 */
+		void addValues(const cv::Mat & mat) {
+			const size_t rowComponents = size_t(mat.cols) * mat.channels();
+			if (mat.depth() != cv::DataType<T>::depth || rowComponents % N != 0) {
+				SIBR_ERR << "Histogram of " << N << " components can't read a matrix of type " << mat.type() << " and " << rowComponents << " components per row." << std::endl;
+			}
+			if (mat.isContinuous()) {
+				addValues(mat.ptr<T>(0), mat.total() * mat.channels() / N);
+				return;
+			}
+			for (int r = 0; r < mat.rows; ++r) {
+				addValues(mat.ptr<T>(r), rowComponents / N);
+			}
+		}
+
+		/** Add all the pixels of all the frames of a volume.
+		 * \param volume the video volume
+		 */
+		void addValues(const VideoVolume<T, N> & volume) {
+			addValues(volume.mat);
+		}
+
 		Indice getModeIndice() const {
 			Indice mode;
 			uint mode_size = 0;
@@ -930,9 +1012,63 @@ namespace sibr {
 		}
 
 		void addValues(const std::vector<T> & values) {
-			for (const T & v : values) {
-				addValue(v);
+			addValues(values.data(), values.size());
+		}
+
+		/** Add values stored contiguously, counted in parallel chunks merged at the end.
+		 * \param data the first value
+		 * \param count the number of values
+		 * \param stride the distance between two values
+		 */
+		void addValues(const T * data, size_t count, size_t stride = 1) {
+			const size_t chunkSize = size_t(1) << 16;
+			const int chunks = int((count + chunkSize - 1) / chunkSize);
+			std::vector<std::vector<uint>> counts(chunks);
+			const double scale = scaling, offset = min;
+			const int lastBin = (int)numBins - 1;
+
+#pragma omp parallel for
+			for (int k = 0; k < chunks; ++k) {
+				const size_t begin = size_t(k) * chunkSize;
+				const size_t end = std::min(count, begin + chunkSize);
+				// One extra bin receives the values out of the range, to keep the loop branchless.
+				std::vector<uint> & local = counts[k];
+				local.assign(numBins + 1, 0);
+				for (size_t i = begin; i < end; ++i) {
+					const int t = (int)(scale * (data[i * stride] - offset));
+					const int bin = (t >= 0 && t <= lastBin) ? t : lastBin + 1;
+					++local[bin];
+				}
+			}
+
+			for (const std::vector<uint> & local : counts) {
+				for (uint b = 0; b < numBins; ++b) {
+					bins[b] += local[b];
+				}
+			}
+		}
+
+		/** Add all the values of a single channel image, or of a volume matrix.
+		 * \param mat a matrix of T values
+		 */
+		void addValues(const cv::Mat & mat) {
+			if (mat.depth() != cv::DataType<T>::depth) {
+				SIBR_ERR << "Histogram can't read a matrix of type " << mat.type() << "." << std::endl;
 			}
+			if (mat.isContinuous()) {
+				addValues(mat.ptr<T>(0), mat.total() * mat.channels());
+				return;
+			}
+			for (int r = 0; r < mat.rows; ++r) {
+				addValues(mat.ptr<T>(r), size_t(mat.cols) * mat.channels());
+			}
+		}
+
+		/** Add all the values of all the frames of a volume.
+		 * \param volume the video volume
+		 */
+		void addValues(const VideoVolume<T, 1> & volume) {
+			addValues(volume.mat);
 		}
 
 		uint getModeIndice() const {
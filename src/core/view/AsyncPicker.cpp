@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "AsyncPicker.hpp"
+#include <limits>
+
+namespace sibr
+{
+
+	AsyncPicker::AsyncPicker(const Raycaster::Ptr & raycaster) :
+		_raycaster(raycaster)
+	{
+		_worker = std::thread(&AsyncPicker::workerLoop, this);
+	}
+
+	AsyncPicker::~AsyncPicker()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_rayReady.notify_all();
+		_worker.join();
+	}
+
+	void AsyncPicker::setRaycaster(const Raycaster::Ptr & raycaster)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_raycaster = raycaster;
+	}
+
+	AsyncPicker::Ticket AsyncPicker::pickRay(const Ray & ray)
+	{
+		Ticket ticket = 0;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_raycaster) {
+				return 0;
+			}
+			ticket = _rayTicket = _next++;
+			_ray = ray;
+			_rayRaycaster = _raycaster;
+			_rayQueued = true;
+		}
+		_rayReady.notify_one();
+		return ticket;
+	}
+
+	AsyncPicker::Ticket AsyncPicker::pickDepth(const IRenderTarget & rt, const Camera & cam, const Vector2i & pixel, uint radius)
+	{
+		const Vector2i size(int(rt.w()), int(rt.h()));
+		const Vector2i r(int(radius), int(radius));
+		const Vector2i minCorner = (pixel - r).cwiseMax(Vector2i(0, 0));
+		const Vector2i maxCorner = (pixel + r).cwiseMin(size - Vector2i(1, 1));
+		if ((maxCorner.array() < minCorner.array()).any()) {
+			return 0;
+		}
+		const Vector2i region = maxCorner - minCorner + Vector2i(1, 1);
+
+		DepthRequest & request = _depthRequest;
+		// GL rows are bottom to top.
+		request.readback = _readback.read(rt.fbo(), 0, minCorner.x(), size.y() - 1 - maxCorner.y(),
+			uint(region.x()), uint(region.y()), GL_DEPTH_COMPONENT, GL_FLOAT, sizeof(float));
+		request.ticket = _next++;
+		request.camera = cam;
+		request.origin = minCorner;
+		request.center = pixel;
+		request.size = size.cast<uint>();
+		return request.ticket;
+	}
+
+	bool AsyncPicker::result(Ticket ticket, Result & result)
+	{
+		if (ticket == 0) {
+			return false;
+		}
+
+		if (ticket == _depthRequest.ticket) {
+			DepthRequest & request = _depthRequest;
+			Image<float, 1> depths;
+			if (!_readback.fetch(request.readback, depths, false)) {
+				if (!_readback.isPending(request.readback)) {
+					request.ticket = 0;
+				}
+				return false;
+			}
+			request.ticket = 0;
+
+			// Nearest covered pixel to the requested one, the far plane means nothing was rendered.
+			result = Result();
+			int bestDist = std::numeric_limits<int>::max();
+			Vector2i bestPixel(0, 0);
+			float bestDepth = 1.0f;
+			for (uint y = 0; y < depths.h(); ++y) {
+				for (uint x = 0; x < depths.w(); ++x) {
+					const float depth = depths(x, y)[0];
+					const Vector2i pixel = request.origin + Vector2i(int(x), int(y));
+					const int dist = (pixel - request.center).squaredNorm();
+					if (depth < 1.0f && dist < bestDist) {
+						bestDist = dist;
+						bestPixel = pixel;
+						bestDepth = depth;
+					}
+				}
+			}
+			if (bestDist != std::numeric_limits<int>::max()) {
+				const Vector3f ndc(
+					2.0f * (float(bestPixel.x()) + 0.5f) / float(request.size.x()) - 1.0f,
+					1.0f - 2.0f * (float(bestPixel.y()) + 0.5f) / float(request.size.y()),
+					2.0f * bestDepth - 1.0f);
+				result.hit = true;
+				result.position = request.camera.unproject(ndc);
+				result.distance = (result.position - request.camera.position()).norm();
+			}
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (ticket == _rayDoneTicket) {
+			result = _rayDone;
+			_rayDoneTicket = 0;
+			return true;
+		}
+		return false;
+	}
+
+	bool AsyncPicker::isPending(Ticket ticket) const
+	{
+		if (ticket == 0) {
+			return false;
+		}
+		if (ticket == _depthRequest.ticket) {
+			return _readback.isPending(_depthRequest.readback);
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		return ticket == _rayTicket || ticket == _rayDoneTicket;
+	}
+
+	void AsyncPicker::workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true) {
+			_rayReady.wait(lock, [this]() { return _stop || _rayQueued; });
+			if (_stop) {
+				return;
+			}
+			const Ticket ticket = _rayTicket;
+			const Ray ray = _ray;
+			const Raycaster::Ptr raycaster = _rayRaycaster;
+			_rayQueued = false;
+			lock.unlock();
+
+			Result res;
+			const RayHit hit = raycaster->intersect(ray);
+			if (hit.hitSomething()) {
+				res.hit = true;
+				res.distance = hit.dist();
+				res.position = ray.orig() + hit.dist() * ray.dir().normalized();
+			}
+
+			lock.lock();
+			// Drop the result if a newer ray was requested meanwhile.
+			if (ticket == _rayTicket) {
+				_rayDone = res;
+				_rayDoneTicket = ticket;
+				_rayTicket = 0;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+#include <core/graphics/Camera.hpp>
+#include <core/graphics/PixelReadback.hpp>
+#include <core/graphics/RenderTarget.hpp>
+#include <core/raycaster/Raycaster.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace sibr
+{
+
+	/**
+	 * Resolve picking requests without blocking the main thread, so that camera interaction stays smooth
+	 * whatever the scene size. Two kinds of requests are supported:
+	 * - depth picks read a small region of a depth buffer through a pixel pack buffer, and are resolved
+	 *   once the transfer is done, usually on the next frame;
+	 * - ray picks are intersected on a worker thread sharing the scene raycaster.
+	 *
+	 *		const AsyncPicker::Ticket ticket = picker.pickRay(ray);
+	 *		// Later, on a following frame:
+	 *		AsyncPicker::Result result;
+	 *		if (picker.result(ticket, result) && result.hit) { ... }
+	 *
+	 * Only the last request of each kind is kept: a new request supersedes the previous one, which
+	 * will never complete (see isPending).
+	 * \note The raycaster is used concurrently with the main thread, it should not be rebuilt while in use.
+	 * \ingroup sibr_view
+	 */
+	class SIBR_VIEW_EXPORT AsyncPicker
+	{
+		SIBR_CLASS_PTR(AsyncPicker);
+		SIBR_DISALLOW_COPY(AsyncPicker);
+
+	public:
+
+		/// Identifies a request, 0 is never a valid ticket.
+		typedef uint64_t Ticket;
+
+		/// Result of a request.
+		struct Result {
+			bool hit = false; ///< Was a surface found.
+			Vector3f position = Vector3f(0, 0, 0); ///< World space position of the surface.
+			float distance = 0.0f; ///< Distance along the ray (ray picks) or from the camera (depth picks).
+		};
+
+		/** Constructor.
+		\param raycaster the raycaster used for ray picks, can be nullptr
+		*/
+		AsyncPicker(const Raycaster::Ptr & raycaster = nullptr);
+
+		/// Destructor, waits for the current ray pick.
+		~AsyncPicker();
+
+		/** Set the raycaster used for the next ray picks.
+		\param raycaster the raycaster, can be nullptr
+		*/
+		void setRaycaster(const Raycaster::Ptr & raycaster);
+
+		/** \return the raycaster used for ray picks */
+		const Raycaster::Ptr & raycaster() const { return _raycaster; }
+
+		/** Request the first intersection of a ray with the scene, resolved on the worker thread.
+		\param ray the ray
+		\return the request ticket, 0 if there is no raycaster
+		*/
+		Ticket pickRay(const Ray & ray);
+
+		/** Request the closest surface seen around a pixel, from the depth buffer of a render target.
+		\param rt the render target, with a depth attachment
+		\param cam the camera used to render the target
+		\param pixel the pixel, with the origin at the top left
+		\param radius the half size of the region read, the nearest valid depth to the center is used
+		\return the request ticket, 0 if the pixel is outside the target
+		\note Requires the OpenGL context. The target has to be rendered with cam over its whole size.
+		*/
+		Ticket pickDepth(const IRenderTarget & rt, const Camera & cam, const Vector2i & pixel, uint radius = 2);
+
+		/** Get the result of a request, without blocking.
+		\param ticket the request ticket
+		\param result will contain the result
+		\return true if the request is resolved, the result can only be fetched once
+		\note Requires the OpenGL context for depth picks.
+		*/
+		bool result(Ticket ticket, Result & result);
+
+		/** Check if a request can still complete.
+		\param ticket the request ticket
+		\return false if the ticket is unknown, already fetched or superseded by another request
+		*/
+		bool isPending(Ticket ticket) const;
+
+	private:
+
+		/// Loop resolving the ray picks.
+		void workerLoop();
+
+		/// Depth pick waiting for its readback.
+		struct DepthRequest {
+			Ticket ticket = 0; ///< Request ticket, 0 if none.
+			PixelReadback::Ticket readback = 0; ///< Readback ticket.
+			Camera camera; ///< Camera used to render the target.
+			Vector2i origin; ///< Top left pixel of the region read.
+			Vector2i center; ///< Requested pixel.
+			Vector2u size; ///< Size of the target.
+		};
+
+		Raycaster::Ptr _raycaster; ///< Raycaster for ray picks, shared with the worker.
+		PixelReadback _readback; ///< Depth regions transfers.
+		DepthRequest _depthRequest; ///< Current depth pick.
+
+		Ticket _next = 1; ///< Next ticket.
+		Ticket _rayTicket = 0; ///< Current ray pick, 0 if none.
+		Ray _ray; ///< Current ray pick.
+		Raycaster::Ptr _rayRaycaster; ///< Raycaster for the current ray pick.
+		bool _rayQueued = false; ///< The current ray pick has not been started.
+		Ticket _rayDoneTicket = 0; ///< Last resolved ray pick, 0 if none.
+		Result _rayDone; ///< Result of the last resolved ray pick.
+		bool _stop = false; ///< Ask the worker to exit.
+		mutable std::mutex _mutex; ///< Protects the ray pick state.
+		std::condition_variable _rayReady; ///< Signaled when a ray pick is queued or on stop.
+		std::thread _worker; ///< Worker thread.
+	};
+
+}
@@ -11,11 +11,103 @@
 
 
 #include "DatasetView.hpp"
+#include "core/raycaster/VisibilityQuery.hpp"
+#include "core/graphics/GLState.hpp"
+#include <cstring>
 
 namespace sibr {
-	
+
+	namespace {
+
+		const int kReproGroupSize = 64;
+
+		/// Per camera parameters, std430 layout.
+		struct ReproCamera {
+			float viewproj[16];
+			float position[4];
+			float params[4]; ///< Width, height, near and far planes.
+		};
+
+		// One invocation per camera, same frustum test and pixel convention as Camera::frustumTest and
+		// Camera::projectImgSpaceInvertY. The point is visible if it is not behind the input depth map.
+		const char * kReproShader = R"(
+			#version 430
+
+			layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+			struct Camera {
+				mat4 viewproj;
+				vec4 position;
+				vec4 params;
+			};
+
+			layout(std430, binding = 0) readonly buffer Cameras { Camera cameras[]; };
+			layout(std430, binding = 1) writeonly buffer Repros { vec4 repros[]; }; // Pixel, visible flag, unused.
+			layout(binding = 0) uniform sampler2DArray depths; // Window depths, one layer per camera.
+
+			layout(location = 0) uniform uint count;
+			layout(location = 1) uniform vec3 point;
+			layout(location = 2) uniform bool occlusionTest;
+			layout(location = 3) uniform float relativeEpsilon;
+
+			float linearDepth(float ndc, float n, float f) {
+				return 2.0 * n * f / ((f + n) - ndc * (f - n));
+			}
+
+			void main() {
+				uint c = gl_GlobalInvocationID.x;
+				if (c >= count) {
+					return;
+				}
+				Camera cam = cameras[c];
+				vec4 clip = cam.viewproj * vec4(point, 1.0);
+				vec3 ndc = clip.xyz / clip.w;
+				bool visible = clip.w > 0.0 && all(lessThan(abs(ndc.xy), vec2(1.0 - 1e-5)));
+				if (visible && occlusionTest) {
+					ivec2 size = textureSize(depths, 0).xy;
+					ivec2 texel = clamp(ivec2((0.5 * ndc.xy + 0.5) * vec2(size)), ivec2(0), size - 1);
+					float stored = 2.0 * texelFetch(depths, ivec3(texel, int(c)), 0).r - 1.0;
+					float occluder = linearDepth(stored, cam.params.z, cam.params.w);
+					visible = linearDepth(ndc.z, cam.params.z, cam.params.w) <= occluder * (1.0 + relativeEpsilon);
+				}
+				vec2 pixel = 0.5 * (vec2(ndc.x, -ndc.y) + 1.0) * cam.params.xy;
+				repros[c] = vec4(pixel, visible ? 1.0 : 0.0, 0.0);
+			}
+		)";
+
+		GLuint compileCompute(const char * source)
+		{
+			GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(shader, 1, &source, nullptr);
+			glCompileShader(shader);
+			GLint status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				SIBR_WRG << "[DatasetView] Compilation failed: " << log << std::endl;
+				glDeleteShader(shader);
+				return 0;
+			}
+			GLuint program = glCreateProgram();
+			glAttachShader(program, shader);
+			glLinkProgram(program);
+			glDeleteShader(shader);
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				SIBR_WRG << "[DatasetView] Link failed: " << log << std::endl;
+				glDeleteProgram(program);
+				return 0;
+			}
+			return program;
+		}
+	}
+
+
 	DatasetView::DatasetView(const BasicIBRScene & scene, const Vector2u & defaultRenderingRes, const Vector2i & defaultViewRes)
-		: MultiViewBase(defaultViewRes)
+		: MultiViewBase(defaultViewRes), _scene(&scene)
 	{
 		const auto & input_cams = scene.cameras()->inputCameras();
 		const auto & input_images = scene.images()->inputImages();
@@ -40,6 +132,17 @@ namespace sibr {
 		addSubView(gridSubViewStr, grid, defaultRenderingRes);
 	}
 
+	DatasetView::~DatasetView()
+	{
+		if (_reproProgram) {
+			GLState::deleteProgram(_reproProgram);
+		}
+		if (_reproCameras) {
+			glDeleteBuffers(1, &_reproCameras);
+			glDeleteBuffers(1, &_reproResults);
+		}
+	}
+
 	void DatasetView::onGui(Window & win)
 	{
 	}
@@ -85,8 +188,10 @@ namespace sibr {
 
 	void DatasetView::onRender(Window & win)
 	{
-		if (currentRepro) {
+		// The meshes and highlights are kept by the subviews, only update them for a new point.
+		if (currentRepro && reproDirty) {
 			displayRepro(currentRepro);
+			reproDirty = false;
 		}
 
 		MultiViewBase::onRender(win);
@@ -94,46 +199,127 @@ namespace sibr {
 
 	void DatasetView::repro(ReprojectionData & data)
 	{
+		reproDirty = true;
+		if (reproGPU(data)) {
+			return;
+		}
+
 		const Vector3f & pt = data.point3D;
+		VisibilitySet visible;
+		if (data.occlusionTest) {
+			VisibilityQuery visibility(*proxyData().raycaster, cams);
+			visibility.relativeEpsilon() = 0.01f;
+			visible = visibility.query({ pt });
+		}
+		std::vector<const InputCamera *> cameras(cams.size());
+		for (size_t im = 0; im < cams.size(); ++im) {
+			cameras[im] = &cams[im];
+		}
+		std::vector<float> us(cams.size()), vs(cams.size());
+		std::vector<uint8_t> inFrustum(cams.size());
+		InputCamera::projectImgSpaceInvertY(cameras, 1, &pt.x(), &pt.y(), &pt.z(), us.data(), vs.data(), nullptr, inFrustum.data());
 		for (int im = 0; im<(int)cams.size(); ++im) {
-			const auto & cam = cams[im];
-			if (!cam.frustumTest(pt)) {
+			if (!inFrustum[im]) {
 				continue;
 			}
-			Vector3f pt2d = cam.projectImgSpaceInvertY(pt);
-
-			if (data.occlusionTest) {
-				float dist = (cam.position() - pt).norm();
-				Ray ray = Ray(pt, (cam.position() - pt).normalized());
-				auto hit = proxyData().raycaster->intersect(ray, 0.01f);
-				if (hit.hitSomething() && std::abs(hit.dist() - dist) / dist > 0.01f) {
-					continue;
-				}
+			if (data.occlusionTest && !visible.visible(0, im)) {
+				continue;
+			}
+			data.repros.push_back(MVpixel(im, Vector2i(int(us[im]), int(vs[im]))));
+		}
+	}
+
+	bool DatasetView::reproGPU(ReprojectionData & data)
+	{
+		if (_reproFailed || cams.empty()) {
+			return false;
+		}
+		// The render targets may still be created in the background, the CPU path is used meanwhile.
+		const std::shared_future<void> & ready = _scene->renderTargetsReady();
+		const bool targetsReady = !ready.valid() || ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		const RenderTargetTextures::Ptr & targets = _scene->renderTargets();
+		if (data.occlusionTest && (!targetsReady || !targets || !targets->getInputDepthMapArrayPtr()
+			|| targets->getInputDepthMapArrayPtr()->depth() != cams.size())) {
+			return false;
+		}
+
+		if (!_reproProgram) {
+			_reproProgram = compileCompute(kReproShader);
+			if (!_reproProgram) {
+				_reproFailed = true;
+				return false;
+			}
+			// The cameras don't move, upload them once.
+			std::vector<ReproCamera> packed(cams.size());
+			for (size_t c = 0; c < cams.size(); ++c) {
+				const auto & cam = cams[c];
+				std::memcpy(packed[c].viewproj, cam.viewproj().data(), sizeof(packed[c].viewproj));
+				const Vector3f & position = cam.position();
+				packed[c].position[0] = position[0];
+				packed[c].position[1] = position[1];
+				packed[c].position[2] = position[2];
+				packed[c].position[3] = 1.0f;
+				packed[c].params[0] = float(cam.w());
+				packed[c].params[1] = float(cam.h());
+				packed[c].params[2] = cam.znear();
+				packed[c].params[3] = cam.zfar();
 			}
+			glGenBuffers(1, &_reproCameras);
+			glGenBuffers(1, &_reproResults);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _reproCameras);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, packed.size() * sizeof(ReproCamera), packed.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _reproResults);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, cams.size() * sizeof(Vector4f), nullptr, GL_STREAM_READ);
+		}
 
-			data.repros.push_back(MVpixel(im, pt2d.xy().cast<int>()));
+		const Vector3f & pt = data.point3D;
+		GLState::useProgram(_reproProgram);
+		glUniform1ui(0, GLuint(cams.size()));
+		glUniform3f(1, pt[0], pt[1], pt[2]);
+		glUniform1i(2, data.occlusionTest ? 1 : 0);
+		glUniform1f(3, 0.01f);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _reproCameras);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _reproResults);
+		if (data.occlusionTest) {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, targets->getInputDepthMapArrayPtr()->handle());
+		}
+		glDispatchCompute(GLuint((cams.size() + kReproGroupSize - 1) / kReproGroupSize), 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// Reading back waits for the dispatch, a single transfer for all the cameras.
+		std::vector<Vector4f> results(cams.size());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _reproResults);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, results.size() * sizeof(Vector4f), results.data());
+		for (int im = 0; im < (int)results.size(); ++im) {
+			if (results[im][2] > 0.5f) {
+				data.repros.push_back(MVpixel(im, results[im].head<2>().cast<int>()));
+			}
 		}
+		return true;
 	}
 
 	void DatasetView::displayRepro(const ReprojectionData & data)
 	{
 		getMMM()->addPoints("repro 3D point", { data.point3D });
 
-		Mesh::Ptr reproLines(new Mesh());
-		std::vector<MVpixel> pixs;
-		std::vector<int> repro_imgs;
+		// One segment per camera, built in a single pass.
+		Mesh::Vertices vertices;
+		Mesh::Triangles segments;
+		vertices.reserve(2 * data.repros.size());
+		segments.reserve(data.repros.size());
 		for (const auto & rep : data.repros) {
-			const auto & cam = cams[rep.im];
-			Mesh reproLine;
-			reproLine.vertices({ cam.position(), data.point3D });
-			reproLine.triangles({ 0,0,1 });
-			reproLines->merge(reproLine);
-			repro_imgs.push_back(rep.im);
+			const uint first = uint(vertices.size());
+			vertices.push_back(cams[rep.im].position());
+			vertices.push_back(data.point3D);
+			segments.push_back(Vector3u(first, first, first + 1));
 		}
+		Mesh::Ptr reproLines(new Mesh());
+		reproLines->vertices(vertices);
+		reproLines->triangles(segments);
 
 		getMMM()->addMeshAsLines("repro ines", reproLines).setColor({ 1,0,1 });
 		getGrid()->addPixelsToHighlight("repros", data.repros, { 0,0,1 }, 0.25f);
-		//getGrid()->addImagesToHighlight("reproImgs", repro_imgs, { 0,1,0 }, 0.1f);
 	}
 
 	MultiViewBase::BasicSubView & DatasetView::getMeshView()
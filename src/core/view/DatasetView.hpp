@@ -37,6 +37,9 @@ namespace sibr {
 		 */
 		DatasetView(const BasicIBRScene & scene, const Vector2u & defaultRenderingRes = { 0,0 }, const Vector2i & defaultViewRes = { 800, 600 });
 
+		/// Destructor.
+		virtual ~DatasetView();
+
 		/** Reprojection mode. */
 		enum ReprojectionMode { NONE, IMAGE_TO_IMAGE, MESH_TO_IMAGE };
 
@@ -73,6 +76,13 @@ namespace sibr {
 		\param data the info to populate
 		*/
 		void repro(ReprojectionData & data);
+
+		/** Populate reprojection information for all the cameras in one compute pass, the occlusion
+		test is done against the input depth maps of the scene.
+		\param data the info to populate
+		\return false if the depth maps or compute shaders are unavailable
+		*/
+		bool reproGPU(ReprojectionData & data);
 		
 		/** Visualize the reprojection information.
 		\param data the reprojection to display
@@ -97,6 +107,13 @@ namespace sibr {
 		std::vector<RaycastingCamera> cams; ///< Input cameras.
 		ReprojectionData currentRepro; ///< Current selected reprojection.
 		ReprojectionMode reproMode = MESH_TO_IMAGE; ///< Current reprojection mode.
+		bool reproDirty = false; ///< The displayed reprojection must be updated.
+
+		const BasicIBRScene * _scene; ///< Scene holding the input depth maps, created in the background and outliving the view.
+		GLuint _reproProgram = 0; ///< Batched reprojection compute shader.
+		bool _reproFailed = false; ///< The compute shader could not be built, the CPU path is used.
+		GLuint _reproCameras = 0; ///< Per camera view projection, position, size and planes.
+		GLuint _reproResults = 0; ///< Per camera reprojected pixel and visibility.
 
 		const std::string meshSubViewStr = "dataset view - mesh";
 		const std::string gridSubViewStr = "grid";
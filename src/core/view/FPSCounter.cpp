@@ -10,26 +10,137 @@
  */
 
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <memory>
+#include <sstream>
 
 #include "core/view/FPSCounter.hpp"
 #include "core/assets/Resources.hpp"
+#include "core/graphics/FrameProfiler.hpp"
 
 #include <imgui/imgui.h>
 #include "core/graphics/GUI.hpp"
 #include "imgui/imgui_internal.h"
 
 #define SIBR_FPS_SMOOTHING 60
+#define SIBR_FPS_HISTORY 512
+#define SIBR_FPS_HITCHES 16
 
 
 namespace sibr
 {
 
+	namespace {
+
+		/// Scopes reported as the cause of a hitch when they occur in the frame.
+		const char * const kMarkedScopes[] = { "Shader compile", "Texture upload" };
+
+		/// CPU and GPU time of a profiled scope in a frame, in milliseconds.
+		struct ScopeCost {
+			const char * name;
+			double cpu;
+			double gpu;
+		};
+
+		double durationMs(const FrameProfiler::Event & event)
+		{
+			return double(event.end - event.start) * 1e-6;
+		}
+
+		/// The most recent frame with its GPU timings resolved, they arrive a few frames late.
+		const FrameProfiler::Frame * lastGPUFrame(const std::deque<FrameProfiler::Frame> & frames)
+		{
+			for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+				for (const FrameProfiler::Event & event : frame->events) {
+					if (event.track == FrameProfiler::gpuTrack) {
+						return &(*frame);
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		/// GPU scopes at a given depth, with the CPU time of the scopes of the same name (SIBR_PROFILE_GPU opens both).
+		std::vector<ScopeCost> gatherScopes(const FrameProfiler::Frame & frame, uint depth)
+		{
+			std::vector<ScopeCost> scopes;
+			for (const FrameProfiler::Event & event : frame.events) {
+				if (event.track != FrameProfiler::gpuTrack || event.depth != depth) {
+					continue;
+				}
+				auto scope = std::find_if(scopes.begin(), scopes.end(), [&event](const ScopeCost & s) { return s.name == event.name; });
+				if (scope == scopes.end()) {
+					scopes.push_back({ event.name, 0.0, 0.0 });
+					scope = scopes.end() - 1;
+				}
+				scope->gpu += durationMs(event);
+			}
+			for (const FrameProfiler::Event & event : frame.events) {
+				if (event.track == FrameProfiler::gpuTrack) {
+					continue;
+				}
+				for (ScopeCost & scope : scopes) {
+					if (scope.name == event.name) {
+						scope.cpu += durationMs(event);
+					}
+				}
+			}
+			return scopes;
+		}
+
+		/// Marked scopes of a frame, or its longest CPU scope below the top level.
+		std::string hitchCause(const FrameProfiler::Frame & frame)
+		{
+			std::ostringstream cause;
+			cause << std::fixed << std::setprecision(1);
+			bool marked = false;
+			for (const char * marker : kMarkedScopes) {
+				int count = 0;
+				double time = 0.0;
+				for (const FrameProfiler::Event & event : frame.events) {
+					if (event.track != FrameProfiler::gpuTrack && std::strcmp(event.name, marker) == 0) {
+						++count;
+						time += durationMs(event);
+					}
+				}
+				if (count > 0) {
+					cause << (marked ? ", " : "") << marker << " x" << count << " (" << time << " ms)";
+					marked = true;
+				}
+			}
+			if (marked) {
+				return cause.str();
+			}
+
+			const FrameProfiler::Event * longest = nullptr;
+			for (const FrameProfiler::Event & event : frame.events) {
+				if (event.track == FrameProfiler::gpuTrack) {
+					continue;
+				}
+				// Nested scopes are more informative than the top level one.
+				if (!longest || (event.depth > 0 && longest->depth == 0) ||
+					((event.depth > 0) == (longest->depth > 0) && durationMs(event) > durationMs(*longest))) {
+					longest = &event;
+				}
+			}
+			if (!longest) {
+				return "no profiled scope";
+			}
+			cause << longest->name << " (" << durationMs(*longest) << " ms)";
+			return cause.str();
+		}
+	}
+
 	int FPSCounter::_count = 0;
 
 	FPSCounter::FPSCounter(const bool overlayed){
 		_frameTimes = std::vector<float>(SIBR_FPS_SMOOTHING, 0.0f);
+		_history = std::vector<float>(SIBR_FPS_HISTORY, 0.0f);
 		_frameIndex = 0;
 		_frameTimeSum = 0.0f;
 		_lastFrameTime = std::chrono::high_resolution_clock::now();
@@ -66,16 +177,131 @@ namespace sibr
 			const float frameTime = _frameTimeSum / float(SIBR_FPS_SMOOTHING);
 			ImGui::Text("%.2f (%.2f ms)", 1.0f/ frameTime, frameTime*1000.0f);
 			ImGui::SetWindowFontScale(1);
+			ImGui::Checkbox("Statistics", &_showStats);
+			if (_showStats) {
+				renderStatistics();
+			}
 		}
 
 		ImGui::End();
 	}
+
+	void FPSCounter::renderStatistics()
+	{
+		const size_t count = size_t(std::min<uint64_t>(_samples, _history.size()));
+		if (count == 0) {
+			return;
+		}
+		// Oldest first, in milliseconds.
+		const uint64_t first = _samples - count;
+		std::vector<float> times(count);
+		for (size_t i = 0; i < count; ++i) {
+			times[i] = 1000.0f * _history[(first + i) % _history.size()];
+		}
+		std::vector<float> sorted = times;
+		std::sort(sorted.begin(), sorted.end());
+		const auto percentile = [&sorted](float p) {
+			return sorted[std::min(sorted.size() - 1, size_t(p * float(sorted.size())))];
+		};
+		const float p50 = percentile(0.50f);
+		const float p99 = percentile(0.99f);
+		ImGui::Text("p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms", p50, percentile(0.95f), p99, sorted.back());
+
+		// Rolling frame times, with the hitches marked.
+		const float range = std::max(1.5f * p99, 1.0f);
+		ImGui::PlotLines("##FrameTimes", times.data(), int(count), 0, "Frame times", 0.0f, range, ImVec2(0, 60));
+		const ImVec2 plotMin = ImGui::GetItemRectMin();
+		const ImVec2 plotMax = ImGui::GetItemRectMax();
+		ImDrawList * drawList = ImGui::GetWindowDrawList();
+		for (const Hitch & hitch : _hitches) {
+			if (hitch.sample < first || hitch.sample >= _samples) {
+				continue;
+			}
+			const float x = plotMin.x + (plotMax.x - plotMin.x) * float(hitch.sample - first) / float(std::max<size_t>(count - 1, 1));
+			drawList->AddLine(ImVec2(x, plotMin.y), ImVec2(x, plotMax.y), IM_COL32(255, 64, 64, 255));
+		}
+
+		const int binCount = 32;
+		std::vector<float> bins(binCount, 0.0f);
+		for (const float time : times) {
+			bins[std::min(binCount - 1, int(float(binCount) * time / range))] += 1.0f;
+		}
+		const std::string histogramLabel = "Histogram, 0 to " + std::to_string(int(std::ceil(range))) + " ms";
+		ImGui::PlotHistogram("##FrameHistogram", bins.data(), binCount, 0, histogramLabel.c_str(), 0.0f, FLT_MAX, ImVec2(0, 60));
+
+		FrameProfiler & profiler = FrameProfiler::get();
+		if (!profiler.enabled()) {
+			ImGui::TextDisabled("Enable the profiler for the CPU/GPU split and the hitch causes.");
+			return;
+		}
+		detectHitches(0.001f * p50);
+
+		const FrameProfiler::Frame * frame = lastGPUFrame(profiler.frames());
+		if (frame) {
+			double cpu = 0.0;
+			double gpu = 0.0;
+			for (const ScopeCost & scope : gatherScopes(*frame, 0)) {
+				cpu += scope.cpu;
+				gpu += scope.gpu;
+			}
+			const double total = double(frame->end - frame->start) * 1e-6;
+			ImGui::Text("Frame %.2f ms: CPU %.2f ms, GPU %.2f ms (%s bound)", total, cpu, gpu, gpu > 0.8 * total ? "GPU" : "CPU");
+
+			// The subviews are the scopes right below MultiViewManager::onRender.
+			const std::vector<ScopeCost> views = gatherScopes(*frame, 1);
+			if (!views.empty() && ImGui::TreeNode("Subviews")) {
+				for (const ScopeCost & view : views) {
+					ImGui::Text("%s: CPU %.2f ms, GPU %.2f ms", view.name, view.cpu, view.gpu);
+				}
+				ImGui::TreePop();
+			}
+		}
+
+		if (ImGui::TreeNode("Hitches", "Hitches (%d)", int(_hitches.size()))) {
+			ImGui::SliderFloat("Threshold", &_hitchFactor, 1.5f, 5.0f, "x%.1f median");
+			for (auto hitch = _hitches.rbegin(); hitch != _hitches.rend(); ++hitch) {
+				ImGui::Text("%.1f ms: %s", 1000.0f * hitch->time, hitch->cause.c_str());
+			}
+			ImGui::TreePop();
+		}
+	}
+
+	void FPSCounter::detectHitches(float median)
+	{
+		const std::deque<FrameProfiler::Frame> & frames = FrameProfiler::get().frames();
+		if (frames.empty() || median <= 0.0f) {
+			return;
+		}
+		const uint64_t last = frames.back().index;
+		for (const FrameProfiler::Frame & frame : frames) {
+			if (frame.index <= _lastProfiledFrame) {
+				continue;
+			}
+			const float time = float(frame.end - frame.start) * 1e-9f;
+			if (time < _hitchFactor * median) {
+				continue;
+			}
+			// The last profiler frame ended at the previous buffer swap, it matches the last sample.
+			const uint64_t age = last - frame.index;
+			Hitch hitch;
+			hitch.sample = _samples > age ? _samples - 1 - age : 0;
+			hitch.time = time;
+			hitch.cause = hitchCause(frame);
+			_hitches.push_back(hitch);
+			if (_hitches.size() > SIBR_FPS_HITCHES) {
+				_hitches.pop_front();
+			}
+		}
+		_lastProfiledFrame = last;
+	}
 	
 	void FPSCounter::update(float deltaTime){
 		_frameTimeSum -= _frameTimes[_frameIndex];
 		_frameTimeSum += deltaTime;
 		_frameTimes[_frameIndex] = deltaTime;
 		_frameIndex = (_frameIndex + 1) % SIBR_FPS_SMOOTHING;
+		_history[_samples % SIBR_FPS_HISTORY] = deltaTime;
+		++_samples;
 	}
 	
 	void FPSCounter::update(bool doRender) {
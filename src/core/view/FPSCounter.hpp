@@ -17,11 +17,17 @@
 # include <core/system/Vector.hpp>
 
 # include <chrono>
+# include <deque>
 
 namespace sibr
 {
 
 	/** Provde a small GUI panel to display the current framerate, smoothed over multiple frames.
+	* The panel can also display frame time statistics over the last frames: a rolling plot, a histogram
+	* and percentiles, and, from the FrameProfiler, the CPU/GPU split, the cost of each subview and the
+	* hitches (frames much longer than the median) with their cause. Scopes named "Shader compile" and
+	* "Texture upload" are reported as causes when present, otherwise the longest scope of the frame.
+	* When hidden, only the frame times are recorded.
 	* \ingroup sibr_view
 	*/
 	class SIBR_VIEW_EXPORT FPSCounter
@@ -62,12 +68,51 @@ namespace sibr
 			return !_hidden;
 		}
 
+		/** \return true if the frame time statistics are displayed. */
+		bool showStatistics() const {
+			return _showStats;
+		}
+
+		/** Toggle the frame time statistics.
+		\param show the new state
+		*/
+		void showStatistics(bool show) {
+			_showStats = show;
+		}
+
+		/** \return the hitch threshold, as a multiple of the median frame time. */
+		float & hitchFactor() {
+			return _hitchFactor;
+		}
+
 	private:
+
+		/// A frame much longer than the median.
+		struct Hitch {
+			uint64_t sample; ///< Frame time sample it matches.
+			float time; ///< Frame duration in seconds.
+			std::string cause; ///< Marked scopes or longest scope of the frame.
+		};
+
+		/** Display the frame time statistics in the current ImGui window. */
+		void renderStatistics();
+
+		/** Record the hitches among the profiler frames completed since the last call.
+		\param median the median frame time in seconds
+		*/
+		void detectHitches(float median);
+
 		time_point							_lastFrameTime; ///< Last frame duration.
 		sibr::Vector2f						_position; ///< on screen position.
 		std::vector<float>					_frameTimes; ///< Last N frame times.
 		size_t								_frameIndex; ///< Current position in the time list.
 		float								_frameTimeSum; ///< Current running sum.
+		std::vector<float>					_history; ///< Longer frame time history, for the statistics.
+		uint64_t							_samples = 0; ///< Number of frame times recorded.
+		bool								_showStats = false; ///< Display the statistics.
+		float								_hitchFactor = 2.0f; ///< Hitch threshold, relative to the median.
+		uint64_t							_lastProfiledFrame = 0; ///< Last profiler frame checked for hitches.
+		std::deque<Hitch>					_hitches; ///< Most recent hitches, oldest first.
 		int									_flags; ///< Imgui display flags.
 		bool								_hidden; ///< Visibility status.
 		std::string							_name; ///< Panel name.
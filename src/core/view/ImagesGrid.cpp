@@ -22,12 +22,18 @@ namespace sibr
 	{
 		const Vector2f size = vp.finalSize();
 
-		if (current_level_tex) {
-			imSizePixels = { current_level_tex->w(), current_level_tex->h() };
-			imSizePixels = imSizePixels.cwiseQuotient(pow(2.0, current_lod)*Vector2f(1, 1)).unaryExpr([](float f) { return std::floor(f); });
+		if (!hasImages()) {
+			return;
+		}
 
+		if (current_layer->streamed_images) {
+			imSizePixels = current_layer->streamed_images->imageSize().cast<float>();
+			num_imgs = current_layer->streamed_images->count();
+		} else {
+			imSizePixels = { current_level_tex->w(), current_level_tex->h() };
 			num_imgs = (int)current_layer->imgs_texture_array->depth();
 		}
+		imSizePixels = imSizePixels.cwiseQuotient(pow(2.0, current_lod)*Vector2f(1, 1)).unaryExpr([](float f) { return std::max(std::floor(f), 1.0f); });
 
 		currentActivePix = pixFromScreenPos(input.mousePosition(), size);
 		_vp = vp;
@@ -70,11 +76,21 @@ namespace sibr
 
 		viewport.clear(Vector3f(0.7f, 0.7f, 0.7f));
 
-		if (!current_level_tex) {
+		if (!hasImages()) {
 			return;
 		}
 
-		draw_utils.image_grid(num_imgs, current_level_tex->handle(), grid_adjusted, viewRectangle.tl(), viewRectangle.br(), current_lod, current_layer->flip_texture);
+		if (current_layer->streamed_images) {
+			// Only request the visible images, and details once a cell is large on screen.
+			int first, last;
+			if (visibleImages(first, last)) {
+				const float cellPixels = viewport.finalWidth() / ((viewRectangle.br().x() - viewRectangle.tl().x()) * grid_adjusted.x());
+				current_layer->streamed_images->update(first, last, cellPixels);
+			}
+			draw_utils.streamed_image_grid(*current_layer->streamed_images, grid_adjusted, viewRectangle.tl(), viewRectangle.br(), current_layer->flip_texture);
+		} else {
+			draw_utils.image_grid(num_imgs, current_level_tex->handle(), grid_adjusted, viewRectangle.tl(), viewRectangle.br(), current_lod, current_layer->flip_texture);
+		}
 
 		for (const auto & ims_highlight : images_to_highlight) {
 			const auto & imgs = ims_highlight.second;
@@ -115,8 +131,10 @@ namespace sibr
 			if (currentActivePix) {
 				GUI_TEXT("current pix : " << currentActivePix.im << ", " << currentActivePix.pos.transpose());
 
-				Vector4f value = current_layer->imgs_texture_array->readBackPixel(currentActivePix.im, currentActivePix.pos[0], currentActivePix.pos[1], current_lod);
-				if (integer_pixel_values) {
+				Vector4f value;
+				if (!pixelValue(currentActivePix, value)) {
+					GUI_TEXT(" \t value : loading");
+				} else if (integer_pixel_values) {
 					Vector4i value_i = (255 * value).cast<int>();
 					GUI_TEXT(" \t value : " << value_i.transpose());
 				} else {
@@ -126,12 +144,14 @@ namespace sibr
 
 			}
 
-			std::stringstream s;
-			s << "active images : ";
-			for (int im : current_layer->image_selection.get()) {
-				s << im << ", ";
+			if (hasImages()) {
+				std::stringstream s;
+				s << "active images : ";
+				for (int im : current_layer->image_selection.get()) {
+					s << im << ", ";
+				}
+				ImGui::Text(s.str().c_str());
 			}
-			ImGui::Text(s.str().c_str());
 
 		}
 		ImGui::End();
@@ -181,8 +201,13 @@ namespace sibr
 
 				ImGui::NextColumn();
 
-				auto & tex_arr = imgs_it->imgs_texture_array;
-				GUI_TEXT(tex_arr->depth() << " x " << tex_arr->w() << " x " << tex_arr->h());
+				if (imgs_it->streamed_images) {
+					const auto & streamed = *imgs_it->streamed_images;
+					GUI_TEXT(streamed.count() << " x " << streamed.imageSize().x() << " x " << streamed.imageSize().y() << " (streamed)");
+				} else {
+					auto & tex_arr = imgs_it->imgs_texture_array;
+					GUI_TEXT(tex_arr->depth() << " x " << tex_arr->w() << " x " << tex_arr->h());
+				}
 				ImGui::NextColumn();
 
 				ImGui::Checkbox(("flip##" + imgs_it->name).c_str(), &imgs_it->flip_texture);
@@ -242,10 +267,74 @@ namespace sibr
 		}
 	}
 
+	bool ImagesGrid::hasImages() const
+	{
+		return !images_layers.empty() && (current_level_tex || current_layer->streamed_images);
+	}
+
+	bool ImagesGrid::pixelValue(const MVpixel & pix, Vector4f & value) const
+	{
+		const ImageGridLayer & layer = *current_layer;
+		if (layer.streamed_images) {
+			return layer.streamed_images->pixel(pix.im, pix.pos, current_lod, value);
+		}
+		if (pix.im < 0 || pix.im >= (int)layer.cpu_images.size() || layer.cpu_images[pix.im].empty()) {
+			value = layer.imgs_texture_array->readBackPixel(pix.im, pix.pos[0], pix.pos[1], current_lod);
+			return true;
+		}
+
+		// Same lookup as the texture, which resizes all images to the largest one.
+		const cv::Mat & img = layer.cpu_images[pix.im];
+		const float scale = float(1 << current_lod);
+		const int x = sibr::clamp(int((pix.pos[0] + 0.5f) * scale * img.cols / layer.imgs_texture_array->w()), 0, img.cols - 1);
+		int y = sibr::clamp(int((pix.pos[1] + 0.5f) * scale * img.rows / layer.imgs_texture_array->h()), 0, img.rows - 1);
+		if (layer.cpu_flipped) {
+			y = img.rows - 1 - y;
+		}
+
+		// Normalized like the texture content.
+		const double normalization = img.depth() == CV_8U ? 1.0 / 255.0 : (img.depth() == CV_16U ? 1.0 / 65535.0 : 1.0);
+		cv::Mat pixel;
+		img(cv::Rect(x, y, 1, 1)).convertTo(pixel, CV_32F, normalization);
+		const float * v = pixel.ptr<float>();
+		const int channels = pixel.channels();
+
+		// Images are in BGR order.
+		value = Vector4f(0, 0, 0, 0);
+		if (channels >= 3) {
+			value = Vector4f(v[2], v[1], v[0], channels == 4 ? v[3] : 0.0f);
+		} else {
+			for (int c = 0; c < channels; ++c) {
+				value[c] = v[c];
+			}
+		}
+		return true;
+	}
+
+	void ImagesGrid::addStreamedImageLayer(const std::string & layer_name, const std::vector<std::string> & paths)
+	{
+		addStreamedImageLayer(layer_name, paths, StreamedImageLayer::Options());
+	}
+
+	void ImagesGrid::addStreamedImageLayer(const std::string & layer_name, const std::vector<std::string> & paths, const StreamedImageLayer::Options & options)
+	{
+		if (paths.empty() || name_collision(layer_name)) {
+			return;
+		}
+
+		ImageGridLayer layer;
+		layer.name = layer_name;
+		layer.streamed_images = std::make_shared<StreamedImageLayer>(paths, options);
+		images_layers.push_back(layer);
+
+		setupFirstLayer();
+	}
+
 	DrawUtilities::DrawUtilities()
 	{
 		initBaseShader();
 		initGridShader();
+		initStreamedGridShader();
 	}
 
 	void DrawUtilities::baseRendering(const Mesh & mesh, Mesh::RenderMode mode, const Vector3f & color, 
@@ -393,6 +482,25 @@ namespace sibr
 		gridShader.end();
 	}
 
+	void DrawUtilities::streamed_image_grid(const StreamedImageLayer & layer, const Vector2f & grid, const Vector2f & tl, const Vector2f & br, bool flip_texture)
+	{
+		streamedGridShader.begin();
+
+		streamedNumImgsGL.set(layer.count());
+		streamedIndirectionWidthGL.set(layer.indirectionWidth());
+		streamedGridGL.set(grid);
+
+		streamedGridTopLeftGL.set(tl);
+		streamedGridBottomRightGL.set(br);
+
+		streamedFlip_textureGL.set(flip_texture);
+
+		layer.bind(0);
+		RenderUtility::renderScreenQuad();
+
+		streamedGridShader.end();
+	}
+
 	void DrawUtilities::initBaseShader()
 	{
 		const std::string translationScalingVertexShader =
@@ -470,6 +578,58 @@ namespace sibr
 		flip_textureGL.init(gridShader, "flip_texture");
 	}
 
+	void DrawUtilities::initStreamedGridShader()
+	{
+		const std::string gridVertexShader =
+			"#version 420										\n"
+			"layout(location = 0) in vec3 in_vertex;			\n"
+			"out vec2 uv_coord;									\n"
+			"uniform vec2 zoomTL;								\n"
+			"uniform vec2 zoomBR;								\n"
+			"void main(void) {									\n"
+			"	uv_coord = 0.5*in_vertex.xy + vec2(0.5);		\n"
+			"	uv_coord.y = 1.0 - uv_coord.y;					\n"
+			"	uv_coord = zoomTL + (zoomBR-zoomTL)*uv_coord;	\n"	
+			"	gl_Position = vec4(in_vertex.xy,0.0, 1.0);		\n"
+			"}													\n";
+
+		// Each image is looked up in the detailed images first, then in the thumbnails, grey while loading.
+		const std::string gridFragmentShader =
+			"#version 420														\n"
+			"layout(binding = 0) uniform sampler2DArray thumbnails;				\n"
+			"layout(binding = 1) uniform sampler2DArray details;				\n"
+			"layout(binding = 2) uniform isampler2D slots;						\n"
+			"uniform int numImgs;												\n"
+			"uniform int indirectionWidth;										\n"
+			"uniform vec2 grid;													\n"
+			"uniform bool flip_texture;											\n"
+			"in vec2 uv_coord;													\n"
+			"out vec4 out_color;												\n"
+			"void main(void) {													\n"
+			"	vec2 uvs = grid*uv_coord;										\n"
+			"	// Gradients of the continuous coordinates, to avoid seams at the cell borders.	\n"
+			"	vec2 dx = dFdx(uvs); vec2 dy = dFdy(uvs);						\n"
+			"	if( uvs.x < 0 || uvs.y < 0 ) { discard; } 						\n"
+			"	vec2 fracs = fract(uvs); 										\n"
+			"	vec2 mods = uvs - fracs; 										\n"
+			"	int n = int(mods.x + grid.x*mods.y); 							\n"
+			"	if ( n >= numImgs || mods.x >= grid.x ) { discard; }			\n"
+			"	ivec2 slot = texelFetch(slots, ivec2(n % indirectionWidth, n / indirectionWidth), 0).xy;	\n"
+			"	vec2 uv = vec2(fracs.x, flip_texture ? 1.0 - fracs.y : fracs.y);	\n"
+			"	if (slot.y >= 0) { out_color = textureGrad(details, vec3(uv, slot.y), dx, dy); }	\n"
+			"	else if (slot.x >= 0) { out_color = textureGrad(thumbnails, vec3(uv, slot.x), dx, dy); }	\n"
+			"	else { out_color = vec4(0.5, 0.5, 0.5, 1.0); }					\n"
+			"}																	\n";
+
+		streamedGridShader.init("InterfaceUtilitiesStreamedGridShader", gridVertexShader, gridFragmentShader);
+		streamedGridTopLeftGL.init(streamedGridShader, "zoomTL");
+		streamedGridBottomRightGL.init(streamedGridShader, "zoomBR");
+		streamedNumImgsGL.init(streamedGridShader, "numImgs");
+		streamedIndirectionWidthGL.init(streamedGridShader, "indirectionWidth");
+		streamedGridGL.init(streamedGridShader, "grid");
+		streamedFlip_textureGL.init(streamedGridShader, "flip_texture");
+	}
+
 	MVpixel GridMapping::pixFromScreenPos(const Vector2i & pos, const Vector2f & size)
 	{
 		Vector2f uvScreen = (pos.cast<float>() + 0.5*Vector2f(1, 1)).cwiseQuotient(size);
@@ -626,6 +786,25 @@ namespace sibr
 		draw_utils.rectangle(color, imTl, imBR, alpha != 0 , alpha, viewport);
 	}
 
+	bool GridMapping::visibleImages(int & first, int & last) const
+	{
+		// Same cell coordinates as the grid shader.
+		const Vector2f tl = viewRectangle.tl().cwiseProduct(grid_adjusted);
+		const Vector2f br = viewRectangle.br().cwiseProduct(grid_adjusted);
+		const int rows = (num_imgs + num_per_row - 1) / num_per_row;
+
+		const int x0 = std::max(0, (int)std::floor(tl.x()));
+		const int x1 = std::min(num_per_row - 1, (int)std::floor(br.x()));
+		const int y0 = std::max(0, (int)std::floor(tl.y()));
+		const int y1 = std::min(rows - 1, (int)std::floor(br.y()));
+		if (x0 > x1 || y0 > y1) {
+			return false;
+		}
+		first = x0 + num_per_row * y0;
+		last = std::min(num_imgs - 1, x1 + num_per_row * y1);
+		return first <= last;
+	}
+
 	void GridMapping::setupGrid(const Viewport & vp)
 	{
 		float ratio_img = imSizePixels.x() / imSizePixels.y();
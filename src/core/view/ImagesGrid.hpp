@@ -15,6 +15,7 @@
 #include <core/graphics/Shader.hpp>
 # include <core/graphics/Texture.hpp>
 #include <core/view/ViewBase.hpp>
+#include <core/view/StreamedImageLayer.hpp>
 #include <list>
 #include <map>
 
@@ -44,6 +45,15 @@ namespace sibr
 		GLuniform <int> numImgsGL; 
 		GLuniform<bool> flip_textureGL;
 
+		GLShader streamedGridShader;
+
+		GLuniform <Vector2f> streamedGridGL;
+		GLuniform <Vector2f> streamedGridTopLeftGL;
+		GLuniform <Vector2f> streamedGridBottomRightGL;
+		GLuniform <int> streamedNumImgsGL;
+		GLuniform <int> streamedIndirectionWidthGL;
+		GLuniform<bool> streamedFlip_textureGL;
+
 		void baseRendering(const Mesh & mesh, Mesh::RenderMode mode, const Vector3f & color, const Vector2f & translation, const Vector2f & scaling, float alpha, const Viewport & vp);
 
 		void rectangle(const Vector3f & color, const Vector2f & tl, const Vector2f & br, bool fill, float alpha, const Viewport & vp );
@@ -53,11 +63,13 @@ namespace sibr
 		void linePixels(const Vector3f & color, const Vector2f & ptA, const Vector2f & ptB, const Vector2f & winSize);
 		
 		void image_grid(int num_imgs, uint texture, const Vector2f & grid, const Vector2f & tl, const Vector2f & br, int lod, bool flip_texture);
+		void streamed_image_grid(const StreamedImageLayer & layer, const Vector2f & grid, const Vector2f & tl, const Vector2f & br, bool flip_texture);
 
 	private:
 
 		void initBaseShader();
 		void initGridShader();
+		void initStreamedGridShader();
 
 	};
 
@@ -117,6 +129,13 @@ namespace sibr
 		void highlightImage(int im, const sibr::Viewport & viewport, const sibr::Vector3f & color = { 0, 1, 0 }, float alpha = 0);
 		void setupGrid(const Viewport & vp);
 
+		/** Compute the images intersecting the view rectangle.
+		\param first will contain the first visible image
+		\param last will contain the last visible image
+		\return false if no image is visible
+		*/
+		bool visibleImages(int & first, int & last) const;
+
 		DrawUtilities draw_utils;
 		Viewport _vp;
 		QuadData viewRectangle;
@@ -155,6 +174,9 @@ namespace sibr
 
 	struct ImageGridLayer {	
 		ITexture2DArray::Ptr imgs_texture_array;
+		StreamedImageLayer::Ptr streamed_images; ///< Set instead of the texture array for layers loaded on demand.
+		std::vector<cv::Mat> cpu_images; ///< Source images if available, for pixel lookups without GPU readback.
+		bool cpu_flipped = false; ///< The texture array is flipped with respect to the source images.
 
 		ObjectSelection<MVpixel> pixel_selection;
 		ObjectSelection<int> image_selection;
@@ -188,6 +210,20 @@ namespace sibr
 		void addImagesToHighlight(const std::string & name, const std::vector<int> & imgs, const Vector3f & col, float alpha_fill = 0);
 		void addPixelsToHighlight(const std::string & name, const std::vector<MVpixel> & pixs, const Vector3f & col, float alpha_fill = 0);
 
+		/** Add a layer of images loaded from disk on demand, only the visible ones being resident on the GPU.
+		\param layer_name the layer name
+		\param paths the image files
+		\param options streaming options
+		\note Use this for datasets with thousands of images.
+		*/
+		void addStreamedImageLayer(const std::string & layer_name, const std::vector<std::string> & paths, const StreamedImageLayer::Options & options);
+
+		/** Add a layer of images loaded from disk on demand, with default streaming options.
+		\param layer_name the layer name
+		\param paths the image files
+		*/
+		void addStreamedImageLayer(const std::string & layer_name, const std::vector<std::string> & paths);
+
 
 		const MVpixel & getCurrentPixel();
 
@@ -198,6 +234,8 @@ namespace sibr
 
 		bool name_collision(const std::string & name) const;
 		void setupFirstLayer();
+		bool hasImages() const;
+		bool pixelValue(const MVpixel & pix, Vector4f & value) const;
 
 		std::list<ImageGridLayer> images_layers;
 		std::list<ImageGridLayer>::iterator current_layer;
@@ -274,6 +312,8 @@ namespace sibr
 			ImageGridLayer layer;
 			layer.name = layer_name;
 			layer.imgs_texture_array = std::make_shared<Texture2DArray<T, N>>(images, flags | SIBR_GPU_AUTOGEN_MIPMAP);
+			layer.cpu_images = images;
+			layer.cpu_flipped = (flags & SIBR_FLIP_TEXTURE) != 0;
 			images_layers.push_back(layer);
 
 			setupFirstLayer();
@@ -19,6 +19,7 @@
 #include "core/graphics/GUI.hpp"
 
 # define IBRVIEW_SMOOTHCAM_POWER	0.1f
+# define IBRVIEW_SMOOTHCAM_RATE		60.0f
 # define IBRVIEW_USESMOOTHCAM		true
 # define SIBR_INTERPOLATE_FRAMES    30
 
@@ -139,8 +140,7 @@ namespace sibr {
 	}
 
 	void InteractiveCameraHandler::setup(const std::shared_ptr<sibr::Mesh> mesh, const sibr::Viewport & viewport) {
-		_raycaster = std::make_shared<sibr::Raycaster>();
-		_raycaster->addMesh(*mesh);
+		_raycaster = sibr::Raycaster::shared(*mesh);
 		_viewport = viewport;
 		_trackball.fromBoundingBox(mesh->getBoundingBox(), viewport);
 		_radius = mesh->getBoundingBox().diagonal().norm();
@@ -494,7 +494,12 @@ namespace sibr {
 			}
 
 			if (_shouldSmooth && _currentMode != INTERPOLATION) {
-				const sibr::Camera newcam = sibr::Camera::interpolate(_previousCamera, _currentCamera, IBRVIEW_SMOOTHCAM_POWER);
+				// The smoothing power is given per frame at IBRVIEW_SMOOTHCAM_RATE, scale it to the actual
+				// frame duration so that the camera lag does not depend on the rendering framerate.
+				const float power = deltaTime > 0.0f
+					? 1.0f - std::pow(1.0f - IBRVIEW_SMOOTHCAM_POWER, deltaTime * IBRVIEW_SMOOTHCAM_RATE)
+					: IBRVIEW_SMOOTHCAM_POWER;
+				const sibr::Camera newcam = sibr::Camera::interpolate(_previousCamera, _currentCamera, power);
 				_currentCamera = sibr::InputCamera(newcam, _currentCamera.w(), _currentCamera.h());
 			}
 
@@ -674,6 +679,7 @@ namespace sibr {
 						if (!selectedFile.empty()) {
 							SIBR_LOG << "Saving" << std::endl;
 							_cameraRecorder.save(selectedFile + ".path");
+							_cameraRecorder.saveBinary(selectedFile + SIBR_CAMERARECORDER_BINARYEXTENSION);
 							_cameraRecorder.saveAsBundle(selectedFile + ".out", _currentCamera.h());
 							_cameraRecorder.saveAsColmap(selectedFile, _currentCamera.h(), _currentCamera.w());
 							_cameraRecorder.saveAsLookAt(selectedFile + ".lookat");
@@ -11,11 +11,101 @@
 
 
 #include "MultiMeshManager.hpp"
+#include "core/graphics/StreamingBuffer.hpp"
 
 #include <imgui/imgui.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 namespace sibr {
 
+	namespace {
+
+		template<typename T>
+		void hashCombine(size_t & seed, const T & value)
+		{
+			seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+
+		/// Objects sharing these options can be merged.
+		uint64_t batchKey(const MeshData & data)
+		{
+			uint32_t alphaBits = 0;
+			std::memcpy(&alphaBits, &data.alpha, sizeof(float));
+			uint64_t key = uint64_t(data.renderMode);
+			key |= uint64_t(data.depthTest) << 2;
+			key |= uint64_t(data.backFaceCulling) << 3;
+			key |= uint64_t(data.frontFaceCulling) << 4;
+			key |= uint64_t(data.invertDepthTest) << 5;
+			key |= uint64_t(data.phongShading) << 6;
+			key |= uint64_t(std::min(std::max(data.radius, 0), 0xFFFF)) << 8;
+			key |= uint64_t(alphaBits) << 32;
+			return key;
+		}
+
+		/// Hash of the state of a batched object that requires merging again when modified.
+		void hashBatchMember(size_t & seed, const MeshData & data)
+		{
+			hashCombine(seed, data.meshPtr.get());
+			hashCombine(seed, int(data.colorMode));
+			for (int c = 0; c < 3; ++c) {
+				hashCombine(seed, data.userColor[c]);
+			}
+			for (int i = 0; i < 16; ++i) {
+				hashCombine(seed, data.transformation.data()[i]);
+			}
+		}
+
+		/// Merge objects in a single mesh, baking their transformation and color.
+		Mesh::Ptr mergeBatch(const std::vector<const MeshData *> & members)
+		{
+			size_t vertexCount = 0, triangleCount = 0;
+			bool withNormals = true;
+			for (const MeshData * member : members) {
+				vertexCount += member->meshPtr->vertices().size();
+				triangleCount += member->meshPtr->triangles().size();
+				withNormals = withNormals && member->meshPtr->hasNormals();
+			}
+
+			Mesh::Vertices vertices;
+			Mesh::Colors colors;
+			Mesh::Normals normals;
+			Mesh::Triangles triangles;
+			vertices.reserve(vertexCount);
+			colors.reserve(vertexCount);
+			normals.reserve(withNormals ? vertexCount : 0);
+			triangles.reserve(triangleCount);
+
+			for (const MeshData * member : members) {
+				const Mesh & mesh = *member->meshPtr;
+				const uint offset = uint(vertices.size());
+				const Matrix4f & transfo = member->transformation;
+				const Matrix3f normalTransfo = transfo.block<3, 3>(0, 0).inverse().transpose();
+				const bool vertexColors = member->colorMode == MeshData::VERTEX && mesh.hasColors();
+				for (size_t v = 0; v < mesh.vertices().size(); ++v) {
+					vertices.push_back((transfo * mesh.vertices()[v].homogeneous()).head<3>());
+					colors.push_back(vertexColors ? mesh.colors()[v] : member->userColor);
+					if (withNormals) {
+						normals.push_back((normalTransfo * mesh.normals()[v]).normalized());
+					}
+				}
+				for (const Vector3u & tri : mesh.triangles()) {
+					triangles.push_back(tri + Vector3u(offset, offset, offset));
+				}
+			}
+
+			auto merged = std::make_shared<Mesh>();
+			merged->vertices(vertices);
+			merged->colors(colors);
+			if (withNormals) {
+				merged->normals(normals);
+			}
+			merged->triangles(triangles);
+			return merged;
+		}
+	}
+
 	MeshData MeshData::dummy = MeshData("dummy", Mesh::Ptr(), DUMMY, Mesh::FillRenderMode);
 
 	MeshData::MeshData(const std::string & _name, Mesh::Ptr mesh_ptr, MeshType mType, Mesh::RenderMode render_mode) :
@@ -37,6 +127,8 @@ namespace sibr {
 		MeshData data(name + "_normals", meshPtr, normalMode == PER_TRIANGLE ? TRIANGLES : POINTS);
 		data.setColor(normalsColor).setDepthTest(depthTest);
 		data.normalsLength = (normalsInverted ? -normalsLength : normalsLength);
+		// The normals shaders do not support instancing.
+		data.instances.reset();
 		return data;
 	}
 
@@ -51,7 +143,9 @@ namespace sibr {
 		if (!meshPtr) {
 			return;
 		}
-		if (renderMode == Mesh::PointRenderMode) {
+		if (instances) {
+			meshPtr->renderInstanced(instances->count(), depthTest, backFaceCulling, renderMode, frontFaceCulling, invertDepthTest);
+		} else if (renderMode == Mesh::PointRenderMode) {
 			meshPtr->render_points(depthTest);
 		} else {
 			meshPtr->render(depthTest, backFaceCulling, renderMode, frontFaceCulling, invertDepthTest);
@@ -103,6 +197,9 @@ namespace sibr {
 		}	
 		if (ImGui::BeginPopup(("##Options_popup_" + name).c_str())) {
 			ImGui::Checkbox(("Depth Test##" + name).c_str(), &depthTest);
+			if (!instances) {
+				ImGui::Checkbox(("Batched##" + name).c_str(), &batched);
+			}
 			if (meshType == TRIANGLES) {
 				ImGui::Checkbox(("Cull faces##" + name).c_str(), &backFaceCulling);
 				ImGui::Checkbox(("Swap back/front##" + name).c_str(), &frontFaceCulling);
@@ -161,6 +258,9 @@ namespace sibr {
 			"hasColors() : " << meshPtr->hasColors() << "\n" <<
 			"hasTexCoords() : " << meshPtr->hasTexCoords() << "\n"
 			;
+		if (instances) {
+			s << instances->count() << " instances \n";
+		}
 
 		return s.str();
 	}
@@ -223,6 +323,12 @@ namespace sibr {
 		return *this;
 	}
 
+	MeshData & MeshData::setBatched(bool batch)
+	{
+		batched = batch;
+		return *this;
+	}
+
 	void ShaderAlphaMVP::initShader(const std::string & name, const std::string & vert, const std::string & frag, const std::string & geom)
 	{
 		shader.init(name, vert, frag, geom);
@@ -238,12 +344,21 @@ namespace sibr {
 
 	void ShaderAlphaMVP::render(const Camera & eye, const MeshData & data)
 	{
-		shader.begin();
-
-		setUniforms(eye, data);
+		begin(eye, data);
 
 		data.renderGeometry();
 
+		end();
+	}
+
+	void ShaderAlphaMVP::begin(const Camera & eye, const MeshData & data)
+	{
+		shader.begin();
+		setUniforms(eye, data);
+	}
+
+	void ShaderAlphaMVP::end()
+	{
 		shader.end();
 	}
 
@@ -306,7 +421,77 @@ namespace sibr {
 		use_mesh_color.set(data.colorMode == MeshData::ColorMode::VERTEX);
 	}
 
-	MultiMeshManager::MultiMeshManager(const std::string & _name) : name(_name)
+	void InstancedMeshShader::initShader(const std::string & name, const std::string & vert, const std::string & frag, const std::string & geom)
+	{
+		MeshShadingShader::initShader(name, vert, frag, geom);
+		use_instance_color.init(shader, "use_instance_color");
+		radius.init(shader, "radius");
+	}
+
+	void InstancedMeshShader::setUniforms(const Camera & eye, const MeshData & data)
+	{
+		MeshShadingShader::setUniforms(eye, data);
+		const bool instanceColors = data.instances && data.instances->hasColors();
+		use_instance_color.set(instanceColors);
+		use_mesh_color.set(instanceColors || data.colorMode == MeshData::ColorMode::VERTEX);
+		radius.set(data.radius);
+	}
+
+	void InstancedMeshShader::render(const Camera & eye, const MeshData & data)
+	{
+		if (!data.instances) {
+			return;
+		}
+		data.instances->bind(0);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		MeshShadingShader::render(eye, data);
+		glDisable(GL_PROGRAM_POINT_SIZE);
+	}
+
+	MeshInstances::MeshInstances(const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors)
+	{
+		glCreateBuffers(1, &_buffer);
+		update(transforms, colors);
+	}
+
+	MeshInstances::~MeshInstances()
+	{
+		glDeleteBuffers(1, &_buffer);
+	}
+
+	void MeshInstances::update(const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors)
+	{
+		_hasColors = !colors.empty();
+		if (_hasColors && colors.size() != transforms.size()) {
+			SIBR_WRG << "[MeshInstances] Expected " << transforms.size() << " colors, got " << colors.size() << ", using the mesh color." << std::endl;
+			_hasColors = false;
+		}
+		_count = uint(transforms.size());
+
+		std::vector<Instance> instances(transforms.size());
+#pragma omp parallel for
+		for (int i = 0; i < int(transforms.size()); ++i) {
+			std::copy_n(transforms[i].data(), 16, instances[i].model);
+			const Vector3f color = _hasColors ? colors[i] : Vector3f(1, 1, 1);
+			std::copy_n(color.data(), 3, instances[i].color);
+			instances[i].color[3] = 1.0f;
+		}
+		if (_count > _capacity || _capacity == 0) {
+			_capacity = std::max(_count, 1u);
+			glNamedBufferData(_buffer, _capacity * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+		}
+		if (_count > 0) {
+			glNamedBufferSubData(_buffer, 0, _count * sizeof(Instance), instances.data());
+		}
+	}
+
+	void MeshInstances::bind(uint binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, _buffer);
+	}
+
+	MultiMeshManager::MultiMeshManager(const std::string & _name) : name(_name),
+		_primitivesOptions("primitives", Mesh::Ptr(), MeshData::POINTS, Mesh::PointRenderMode)
 	{
 		initShaders();
 
@@ -318,6 +503,12 @@ namespace sibr {
 		camera_handler.switchMode(InteractiveCameraHandler::InteractionMode::TRACKBALL);
 	}
 
+	MultiMeshManager::~MultiMeshManager()
+	{
+		glDeleteVertexArrays(1, &_primitivesVAO);
+		glDeleteBuffers(1, &_primitivesBuffer);
+	}
+
 	void MultiMeshManager::onUpdate(Input & input, const Viewport & vp)
 	{
 		if (!camera_handler.isSetup() && list_meshes.size() > 0) {
@@ -436,6 +627,10 @@ namespace sibr {
 			loadFile(folder + "alpha_colored_mesh.frag"),
 			loadFile(folder + "alpha_colored_per_triangle_normals.geom")
 		);
+		instanced_mesh_shader.initShader("instanced_mesh_shader",
+			loadFile(folder + "alpha_colored_mesh_instanced.vert"),
+			loadFile(folder + "alpha_colored_mesh.frag")
+		);
 	}
 
 	void MultiMeshManager::renderMeshes()
@@ -444,15 +639,15 @@ namespace sibr {
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		glBlendEquation(GL_FUNC_ADD);
 
+		renderBatches();
+
 		for (const auto & mesh_data : list_meshes) {
 			if (!mesh_data.active) {
 				continue;
 			}
 
-			if (mesh_data.renderMode == Mesh::PointRenderMode) {
-				points_shader.render(camera_handler.getCamera(), mesh_data);
-			} else {
-				colored_mesh_shader.render(camera_handler.getCamera(), mesh_data);
+			if (!mesh_data.batched || mesh_data.instances) {
+				renderMeshData(mesh_data);
 			}
 
 			if (mesh_data.showNormals) {
@@ -465,9 +660,136 @@ namespace sibr {
 			}
 		}
 
+		renderPrimitives();
+
 		glDisable(GL_BLEND);
 	}
 
+	void MultiMeshManager::renderMeshData(const MeshData & data)
+	{
+		if (data.instances) {
+			instanced_mesh_shader.render(camera_handler.getCamera(), data);
+		} else if (data.renderMode == Mesh::PointRenderMode) {
+			points_shader.render(camera_handler.getCamera(), data);
+		} else {
+			colored_mesh_shader.render(camera_handler.getCamera(), data);
+		}
+	}
+
+	void MultiMeshManager::renderBatches()
+	{
+		// Group the batched objects by display options, in list order.
+		std::unordered_map<uint64_t, std::vector<const MeshData *>> groups;
+		for (const auto & mesh_data : list_meshes) {
+			if (mesh_data.batched && mesh_data.active && mesh_data.meshPtr && !mesh_data.instances) {
+				groups[batchKey(mesh_data)].push_back(&mesh_data);
+			}
+		}
+		for (auto it = _batches.begin(); it != _batches.end();) {
+			if (groups.count(it->first) == 0) {
+				it = _batches.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		for (const auto & group : groups) {
+			size_t signature = group.second.size();
+			for (const MeshData * member : group.second) {
+				hashBatchMember(signature, *member);
+			}
+			Batch & batch = _batches[group.first];
+			if (_batchesDirty || !batch.data.meshPtr || batch.signature != signature) {
+				const MeshData & first = *group.second.front();
+				batch.data = MeshData(name + "_batch", mergeBatch(group.second), first.meshType, first.renderMode);
+				batch.data.colorMode = MeshData::VERTEX;
+				batch.data.depthTest = first.depthTest;
+				batch.data.backFaceCulling = first.backFaceCulling;
+				batch.data.frontFaceCulling = first.frontFaceCulling;
+				batch.data.invertDepthTest = first.invertDepthTest;
+				batch.data.phongShading = first.phongShading && batch.data.meshPtr->hasNormals();
+				batch.data.radius = first.radius;
+				batch.data.alpha = first.alpha;
+				batch.signature = signature;
+			}
+			renderMeshData(batch.data);
+		}
+		_batchesDirty = false;
+	}
+
+	void MultiMeshManager::renderPrimitives()
+	{
+		if (!_primitivesOptions.active || (_primitivePoints.empty() && _primitiveLines.empty())) {
+			return;
+		}
+
+		if (_primitivesVAO == 0) {
+			glCreateVertexArrays(1, &_primitivesVAO);
+			glCreateBuffers(1, &_primitivesBuffer);
+			glVertexArrayVertexBuffer(_primitivesVAO, 0, _primitivesBuffer, 0, sizeof(PrimitiveVertex));
+			glEnableVertexArrayAttrib(_primitivesVAO, MeshBufferGL::VertexAttribLocation);
+			glVertexArrayAttribFormat(_primitivesVAO, MeshBufferGL::VertexAttribLocation, 3, GL_FLOAT, GL_FALSE, offsetof(PrimitiveVertex, position));
+			glVertexArrayAttribBinding(_primitivesVAO, MeshBufferGL::VertexAttribLocation, 0);
+			glEnableVertexArrayAttrib(_primitivesVAO, MeshBufferGL::ColorAttribLocation);
+			glVertexArrayAttribFormat(_primitivesVAO, MeshBufferGL::ColorAttribLocation, 3, GL_FLOAT, GL_FALSE, offsetof(PrimitiveVertex, color));
+			glVertexArrayAttribBinding(_primitivesVAO, MeshBufferGL::ColorAttribLocation, 0);
+		}
+
+		const size_t pointCount = _primitivePoints.size();
+		const size_t lineCount = _primitiveLines.size();
+		if (_primitivesDirty) {
+			if (pointCount + lineCount > _primitivesCapacity) {
+				_primitivesCapacity = std::max(pointCount + lineCount, 2 * _primitivesCapacity);
+				glNamedBufferData(_primitivesBuffer, _primitivesCapacity * sizeof(PrimitiveVertex), nullptr, GL_DYNAMIC_DRAW);
+			}
+			// Staged and copied on the GPU, the previous frames may still draw from the buffer.
+			if (pointCount + lineCount > 0) {
+				const StreamingBuffer::Allocation staging = StreamingBuffer::global().allocate((pointCount + lineCount) * sizeof(PrimitiveVertex), StreamingBuffer::VERTEX);
+				PrimitiveVertex * vertices = static_cast<PrimitiveVertex*>(staging.data);
+				std::copy(_primitivePoints.begin(), _primitivePoints.end(), vertices);
+				std::copy(_primitiveLines.begin(), _primitiveLines.end(), vertices + pointCount);
+				glCopyNamedBufferSubData(staging.buffer, _primitivesBuffer, GLintptr(staging.offset), 0, GLsizeiptr(staging.size));
+			}
+			_primitivesDirty = false;
+		}
+
+		GLState::set(GL_DEPTH_TEST, _primitivesOptions.depthTest);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		points_shader.begin(camera_handler.getCamera(), _primitivesOptions);
+		glBindVertexArray(_primitivesVAO);
+		glDrawArrays(GL_POINTS, 0, GLsizei(pointCount));
+		glDrawArrays(GL_LINES, GLint(pointCount), GLsizei(lineCount));
+		glBindVertexArray(0);
+		points_shader.end();
+		glDisable(GL_PROGRAM_POINT_SIZE);
+		GLState::disable(GL_DEPTH_TEST);
+	}
+
+	void MultiMeshManager::drawPoint(const Vector3f & point, const Vector3f & color)
+	{
+		_primitivePoints.push_back({ { point[0], point[1], point[2] }, { color[0], color[1], color[2] } });
+		_primitivesDirty = true;
+	}
+
+	void MultiMeshManager::drawLine(const Vector3f & start, const Vector3f & end, const Vector3f & color)
+	{
+		_primitiveLines.push_back({ { start[0], start[1], start[2] }, { color[0], color[1], color[2] } });
+		_primitiveLines.push_back({ { end[0], end[1], end[2] }, { color[0], color[1], color[2] } });
+		_primitivesDirty = true;
+	}
+
+	void MultiMeshManager::clearPrimitives()
+	{
+		_primitivePoints.clear();
+		_primitiveLines.clear();
+		_primitivesDirty = true;
+	}
+
+	void MultiMeshManager::invalidateBatches()
+	{
+		_batchesDirty = true;
+	}
+
 	void MultiMeshManager::list_mesh_onGUI()
 	{
 		Iterator swap_it_src, swap_it_dst;
@@ -694,6 +1016,32 @@ namespace sibr {
 		return addMeshData(data).setColorMode(MeshData::USER_DEFINED);
 	}
 
+	MeshData & MultiMeshManager::addMeshInstances(const std::string & name, Mesh::Ptr mesh, const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors)
+	{
+		if (!mesh) {
+			SIBR_WRG << "no mesh ptr in " << name;
+			return MeshData::dummy;
+		}
+
+		MeshData & existing = getMeshData(name);
+		if (existing) {
+			existing.meshPtr = mesh;
+			if (existing.instances) {
+				existing.instances->update(transforms, colors);
+			} else {
+				existing.instances = std::make_shared<MeshInstances>(transforms, colors);
+			}
+			return existing;
+		}
+
+		MeshData data(name, mesh, MeshData::TRIANGLES, Mesh::FillRenderMode);
+		data.colorMode = mesh->hasColors() ? MeshData::ColorMode::VERTEX : MeshData::ColorMode::USER_DEFINED;
+		data.phongShading = mesh->hasNormals();
+		data.instances = std::make_shared<MeshInstances>(transforms, colors);
+
+		return addMeshData(data).setColorRandom();
+	}
+
 	MeshData & MultiMeshManager::getMeshData(const std::string & name)
 	{
 		for (auto & m : list_meshes) {
@@ -721,9 +1069,7 @@ namespace sibr {
 		} else {
 			Raycaster::Ptr raycaster;
 			if (create_raycaster) {
-				raycaster = std::make_shared<Raycaster>();
-				raycaster->init();
-				raycaster->addMesh(*data.meshPtr);
+				raycaster = Raycaster::shared(*data.meshPtr);
 			}
 			data.raycaster = raycaster;
 
@@ -19,6 +19,7 @@
 #include <core/raycaster/CameraRaycaster.hpp>
 
 #include <list>
+#include <unordered_map>
 
 namespace sibr {
 
@@ -54,6 +55,15 @@ namespace sibr {
 		 */
 		virtual void render(const Camera & eye, const MeshData & data);
 
+		/** Bind the shader and set the uniforms, to render custom geometry.
+		 * \param eye the current viewpoint
+		 * \param data the display options
+		 */
+		void begin(const Camera & eye, const MeshData & data);
+
+		/** Unbind the shader. */
+		void end();
+
 	protected:
 		GLShader				shader; ///< Base shader object.
 		GLuniform<Matrix4f>		mvp; ///< MVP matrix.
@@ -163,6 +173,88 @@ namespace sibr {
 		GLuniform<float> normals_size; ///< Normal line length.
 	};
 
+	/** Shader wrapper for rendering all instances of a mesh in one draw call, each with its own transformation 
+	 * and optionally its own color. \sa MeshShadingShader, MeshInstances
+	  \ingroup sibr_view
+	 */
+	class SIBR_VIEW_EXPORT InstancedMeshShader : public MeshShadingShader {
+	public:
+		/** Initialize the shader.
+		 *\param name the shader name
+		 *\param vert the vertex shader content
+		 *\param frag the fragment shader ocntent
+		 *\param geom the geometry shader content
+		 */
+		void initShader(const std::string & name, const std::string & vert, const std::string & frag, const std::string & geom = "") override;
+
+		/* Set uniforms based on the camera position and mesh options.
+		 * \param eye the current viewpoint
+		 * \param data the mesh display options
+		 */
+		virtual void setUniforms(const Camera & eye, const MeshData & data) override;
+
+		/** Render using the passed information.
+		 * \param eye the current viewpoint
+		 * \param data the mesh display options, with instances
+		 */
+		virtual void render(const Camera & eye, const MeshData & data) override;
+
+	protected:
+		GLuniform<bool>		use_instance_color; ///< Should the per-instance colors be used.
+		GLuniform<int>		radius; ///< Point screenspace radius.
+	};
+
+	/** Transformations and colors of the instances of a mesh, stored on the GPU in a shader storage buffer.
+	 * Used to display many copies of the same small mesh (markers, voxels, gizmos) in a single draw call.
+	  \ingroup sibr_view
+	 */
+	class SIBR_VIEW_EXPORT MeshInstances {
+		SIBR_CLASS_PTR(MeshInstances);
+		SIBR_DISALLOW_COPY(MeshInstances);
+
+	public:
+
+		/** Constructor.
+		 *\param transforms the model transformation of each instance
+		 *\param colors the color of each instance, can be empty to use the mesh options
+		 *\note Requires an OpenGL context setup
+		 */
+		MeshInstances(const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors = {});
+
+		/// Destructor.
+		~MeshInstances();
+
+		/** Replace the instances, the buffer is only reallocated if it grows.
+		 *\param transforms the model transformation of each instance
+		 *\param colors the color of each instance, can be empty to use the mesh options
+		 */
+		void update(const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors = {});
+
+		/** Bind the buffer for the shaders.
+		 *\param binding the shader storage binding point
+		 */
+		void bind(uint binding) const;
+
+		/** \return the number of instances */
+		uint count() const { return _count; }
+
+		/** \return true if each instance has its own color */
+		bool hasColors() const { return _hasColors; }
+
+	private:
+
+		/// Instance data, as read by the shader.
+		struct Instance {
+			float model[16]; ///< Column-major transformation.
+			float color[4]; ///< Color.
+		};
+
+		GLuint		_buffer = 0; ///< Shader storage buffer.
+		uint		_count = 0; ///< Number of instances.
+		uint		_capacity = 0; ///< Allocated number of instances.
+		bool		_hasColors = false; ///< Per-instance colors were given.
+	};
+
 
 	/** Helper class containing all information relative to how to render a mesh for debugging purpose in a MultiMeshManager.
 	 * You can chain setters to modify multiple properties sequentially (chaining).
@@ -246,6 +338,14 @@ namespace sibr {
 		 */
 		MeshData & setColorMode(ColorMode mode);
 
+		/** Merge the object with the other batched objects sharing the same display options, to render them in one draw call.
+		 *\param batch should the object be batched
+		 *\return the options object, for chaining.
+		 *\note The merged geometry is rebuilt when an object is added, removed, or changes color, transformation, 
+		 * geometry pointer or active state. Call MultiMeshManager::invalidateBatches after editing a mesh in place.
+		 */
+		MeshData & setBatched(bool batch);
+
 		/** Get the display options of the additional normals geometry.
 		 *\return the normals options.
 		 */
@@ -261,6 +361,9 @@ namespace sibr {
 
 		Raycaster::Ptr		raycaster; ///< Associated raycaster (optional)
 
+		MeshInstances::Ptr	instances; ///< If set, the mesh is rendered once per instance, with its own transformation (optional).
+		bool				batched = false; ///< Render merged with other batched objects sharing the same options.
+
 		bool				depthTest = true; ///< Perform depth test.
 		bool				backFaceCulling = true; ///< Perform culling.
 		bool				frontFaceCulling = false; ///< Swap front and back faces for culling.
@@ -305,6 +408,9 @@ namespace sibr {
 		\note Requires an OpenGL context setup
 		*/
 		MultiMeshManager(const std::string & _name = "MultiMeshManager");
+
+		/// Destructor.
+		virtual ~MultiMeshManager();
 	
 		/** Add a mesh to the visualization.
 		\param name name used for the object, if it already exist it will update the geometry and preserve display options
@@ -346,6 +452,39 @@ namespace sibr {
 		*/
 		MeshData & addPoints(const std::string & name, const std::vector<Vector3f> & points, const Vector3f & color = { 1,0,0 });
 
+		/** Add several instances of a mesh to the visualization, rendered in a single draw call.
+		\param name name used for the object, if it already exist it will update the geometry and instances and preserve display options
+		\param mesh the base mesh, shared by all instances
+		\param transforms the model transformation of each instance
+		\param colors the color of each instance, can be empty to use the object color
+		\return a reference to the object display options (for chained modifications).
+		\note The object transformation is applied after each instance one.
+		*/
+		MeshData & addMeshInstances(const std::string & name, Mesh::Ptr mesh, const std::vector<Matrix4f> & transforms, const std::vector<Vector3f> & colors = {});
+
+		/** Add a point primitive, kept until clearPrimitives is called. All primitives are rendered in one draw call 
+		 * per type, without creating a mesh, which is cheaper for many small debug elements.
+		\param point the point position
+		\param color the point color
+		*/
+		void		drawPoint(const Vector3f & point, const Vector3f & color = { 1,0,0 });
+
+		/** Add a line primitive, kept until clearPrimitives is called. \sa drawPoint
+		\param start the first endpoint
+		\param end the second endpoint
+		\param color the line color
+		*/
+		void		drawLine(const Vector3f & start, const Vector3f & end, const Vector3f & color = { 0,1,0 });
+
+		/** Remove all point and line primitives. */
+		void		clearPrimitives();
+
+		/** \return the display options shared by all primitives (depth test, alpha, point radius, active). */
+		MeshData &	primitivesOptions() { return _primitivesOptions; }
+
+		/** Force the batched objects to be merged again, needed if their geometry was modified in place. */
+		void		invalidateBatches();
+
 		/** Accessor to the options of a visualized object.
 			\param name the object name to look for
 			\return a reference to the object options if it exists, or to MeshData::dummy if no match was found.
@@ -403,6 +542,29 @@ namespace sibr {
 		/** Render all the registered meshes. */
 		void renderMeshes();
 
+		/** Render a mesh with the shader matching its options.
+		\param data the object to render
+		*/
+		void renderMeshData(const MeshData & data);
+
+		/** Merge the batched objects if needed and render the batches. */
+		void renderBatches();
+
+		/** Upload the primitives if needed and render them. */
+		void renderPrimitives();
+
+		/** Objects merged into one mesh. */
+		struct Batch {
+			MeshData data; ///< Merged mesh and shared options.
+			size_t signature = 0; ///< Hash of the merged objects state, to detect changes.
+		};
+
+		/** Vertex of a primitive, as uploaded. */
+		struct PrimitiveVertex {
+			float position[3]; ///< Position.
+			float color[3]; ///< Color.
+		};
+
 		/** Generate the list of objects in the GUI panel of the view. */
 		void list_mesh_onGUI();
 
@@ -419,6 +581,18 @@ namespace sibr {
 		PointShader							points_shader; ///< Shader for points.
 		MeshShadingShader					colored_mesh_shader; ///< Shader for meshes.
 		NormalRenderingShader				per_vertex_normals_shader, per_triangle_normals_shader; ///< Shaders for visualizing an object normals.
+		InstancedMeshShader					instanced_mesh_shader; ///< Shader for instanced meshes.
+
+		std::unordered_map<uint64_t, Batch>	_batches; ///< Merged objects, per display options.
+		bool								_batchesDirty = false; ///< Force the batches to be merged again.
+
+		std::vector<PrimitiveVertex>		_primitivePoints; ///< Point primitives.
+		std::vector<PrimitiveVertex>		_primitiveLines; ///< Line primitives endpoints.
+		MeshData							_primitivesOptions; ///< Shared primitives options.
+		GLuint								_primitivesVAO = 0; ///< Primitives vertex array.
+		GLuint								_primitivesBuffer = 0; ///< Primitives vertex buffer, points then lines.
+		size_t								_primitivesCapacity = 0; ///< Allocated vertices in the buffer.
+		bool								_primitivesDirty = false; ///< The primitives have to be uploaded.
 
 		Vector3f							backgroundColor = { 0.7f, 0.7f, 0.7f }; ///< Background clear color.
 	};
@@ -12,6 +12,10 @@
 
 
 # include "core/graphics/GUI.hpp"
+# include "core/graphics/FrameProfiler.hpp"
+# include "core/graphics/GPUTimerPool.hpp"
+# include "core/graphics/MemoryTracker.hpp"
+# include "core/system/FrameArena.hpp"
 # include "core/view/MultiViewManager.hpp"
 
 namespace sibr
@@ -29,6 +33,15 @@ namespace sibr
 		_exportPath = "./screenshots";
 	}
 
+	MultiViewBase::~MultiViewBase()
+	{
+		finishVideoCapture("");
+		// Pending reads are lost with the context, only wait for the images already read.
+		if (_imageWriter) {
+			_imageWriter->wait();
+		}
+	}
+
 	void MultiViewBase::onUpdate(Input& input)
 	{
 		if (input.key().isActivated(Key::LeftControl) && input.key().isPressed(Key::LeftAlt) && input.key().isPressed(Key::P)) {
@@ -42,17 +55,23 @@ namespace sibr
 		const auto timeNow = std::chrono::steady_clock::now();
 		_deltaTime = (float)(std::chrono::duration_cast<std::chrono::microseconds>(timeNow - _timeLastFrame).count())/1000000.0f;
 		_timeLastFrame = timeNow;
+		// After a stall (loading, window moved...), don't move the cameras by the whole elapsed time.
+		const float cameraDeltaTime = std::min(_deltaTime, _maxCameraDeltaTime);
 
 		for (auto & subview : _subViews) {
 			if (subview.second.view->active()) {
 				auto subInput = !subview.second.view->isFocused() ? Input() : Input::subInput(input, subview.second.viewport, false);
 
 				if (subview.second.handler) {
-					subview.second.handler->update(subInput, _deltaTime, subview.second.viewport);
+					subview.second.handler->update(subInput, cameraDeltaTime, subview.second.viewport);
 				}
 
 				subview.second.updateFunc(subview.second.view, subInput, subview.second.viewport, _deltaTime);
 
+				// The view content can depend on any input when focused.
+				if (subview.second.view->isFocused()) {
+					subview.second.dirty = true;
+				}
 			}
 		}
 
@@ -63,7 +82,7 @@ namespace sibr
 				auto subInput = !fView.view->isFocused() ? Input() : Input::subInput(input, fView.viewport, false);
 
 				if (fView.handler) {
-					fView.handler->update(subInput, _deltaTime, fView.viewport);
+					fView.handler->update(subInput, cameraDeltaTime, fView.viewport);
 				}
 
 				fView.cam = fView.updateFunc(fView.view, subInput, fView.viewport, _deltaTime);
@@ -74,6 +93,10 @@ namespace sibr
 					fView.cam = fView.handler->getCamera();
 				}
 
+				if (fView.view->isFocused() || fView.cam.viewproj() != fView.renderedViewProj) {
+					fView.dirty = true;
+				}
+
 			}
 		}
 
@@ -84,13 +107,18 @@ namespace sibr
 
 	void MultiViewBase::onRender(Window& win)
 	{
+		// Store the captures whose readback is done, even when paused.
+		collectFrames(false);
+
 		// Render all views.
 		for (auto & subview : _ibrSubViews) {
 			if (subview.second.view->active()) {
 
-				renderSubView(subview.second);
+				if (renderSubView(subview.second)) {
+					subview.second.renderedViewProj = subview.second.cam.viewproj();
+				}
 
-				if (_enableGUI && _showSubViewsGui) {
+				if (_enableGUI && _showSubViewsGui && !_skipSubViewsGui) {
 					subview.second.view->onGUI();
 					if (subview.second.handler) {
 						subview.second.handler->onGUI("Camera " + subview.first);
@@ -103,7 +131,7 @@ namespace sibr
 
 				renderSubView(subview.second);
 				
-				if (_enableGUI && _showSubViewsGui) {
+				if (_enableGUI && _showSubViewsGui && !_skipSubViewsGui) {
 					subview.second.view->onGUI();
 					if (subview.second.handler) {
 						subview.second.handler->onGUI("Camera " + subview.first);
@@ -211,10 +239,27 @@ namespace sibr
 		return _subViews.begin()->second.viewport;
 	}
 
-	void MultiViewBase::renderSubView(SubView & subview) 
+	double MultiViewBase::subViewGPUTime(const std::string & title) const
 	{
-		
-		if (!_onPause) {
+		if (_subViews.count(title) > 0) {
+			return GPUTimerPool::global().time(_subViews.at(title).profileName);
+		}
+		if (_ibrSubViews.count(title) > 0) {
+			return GPUTimerPool::global().time(_ibrSubViews.at(title).profileName);
+		}
+		return 0.0;
+	}
+
+	bool MultiViewBase::renderSubView(SubView & subview) 
+	{
+		const bool render = !_onPause && needsRendering(subview);
+		if (render) {
+			SIBR_PROFILE_GPU(subview.profileName);
+			// Resources sized while rendering are charged to the subview.
+			SIBR_MEMORY_SCOPE(subview.profileName);
+			subview.dirty = false;
+			subview.renderedRT = subview.rt.get();
+			subview.lastRender = std::chrono::steady_clock::now();
 
 			const Viewport renderViewport(0.0, 0.0, (float)subview.rt->w(), (float)subview.rt->h());
 			subview.render(_renderingMode, renderViewport);
@@ -222,16 +267,21 @@ namespace sibr
 			// Offline video dumping, continued. We ignore additional rendering as those often are GUI overlays.
 			if (subview.handler != NULL && (subview.handler->getCamera().needVideoSave() || subview.handler->getCamera().needSave())) {
 				
-				ImageRGB frame;
-
-				subview.rt->readBack(frame);
-				
-				if (subview.handler->getCamera().needSave()) {
-					frame.save(subview.handler->getCamera().savePath());
+				// The frame is stored once read back, on a later frame, to avoid stalling the rendering.
+				if (!_readback) {
+					_readback.reset(new PixelReadback());
 				}
-				_videoFrames.push_back(frame.toOpenCVBGR());
-				
+				// Don't let a new read reuse the slot of a frame not stored yet.
+				if (_pendingFrames.size() >= _readback->slots()) {
+					collectFrames(true);
+				}
+				PendingFrame pending;
+				pending.ticket = subview.rt->readBackAsync(*_readback);
+				pending.savePath = subview.handler->getCamera().needSave() ? subview.handler->getCamera().savePath() : "";
+				pending.video = true;
+				_pendingFrames.push_back(pending);
 			}
+			collectFrames(false);
 			
 			// Additional rendering.
 			subview.renderFunc(subview.view, renderViewport, std::static_pointer_cast<IRenderTarget>(subview.rt));
@@ -248,11 +298,81 @@ namespace sibr
 		if(_enableGUI)
 		{
 			ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
-			subview.view->setFocus(showImGuiWindow(subview.view->name(), *subview.rt, subview.flags, subview.viewport, false, subview.shouldUpdateLayout));
+			bool visible = true;
+			subview.view->setFocus(showImGuiWindow(subview.view->name(), *subview.rt, subview.flags, subview.viewport, false, subview.shouldUpdateLayout, 0, &visible, render));
+			// The last frame can be outdated when the view shows up again.
+			if (visible && !subview.visible) {
+				subview.dirty = true;
+			}
+			subview.visible = visible;
 			ImGui::PopStyleVar();
 		}
 		// If we have updated the layout, don't do it next frame.
 		subview.shouldUpdateLayout = false;
+		return render;
+	}
+
+	bool MultiViewBase::needsRendering(const SubView & subview) const
+	{
+		// Nothing to reuse yet, or the RT has been replaced.
+		if (subview.renderedRT != subview.rt.get()) {
+			return true;
+		}
+		// Saved frames have to be rendered each time.
+		if (subview.handler && (subview.handler->getCamera().needVideoSave() || subview.handler->getCamera().needSave())) {
+			return true;
+		}
+		if (_enableGUI && !subview.visible) {
+			return false;
+		}
+		if (subview.dirty) {
+			return true;
+		}
+		switch (subview.policy) {
+		case UpdatePolicy::FIXED_RATE:
+		{
+			const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - subview.lastRender).count();
+			return subview.rate <= 0.0f || elapsed * subview.rate >= 1.0f;
+		}
+		case UpdatePolicy::ON_CHANGE:
+			return false;
+		case UpdatePolicy::EVERY_FRAME:
+		default:
+			return true;
+		}
+	}
+
+	MultiViewBase::SubView * MultiViewBase::findSubView(const std::string & subviewName)
+	{
+		if (_subViews.count(subviewName) > 0) {
+			return &_subViews.at(subviewName);
+		}
+		if (_ibrSubViews.count(subviewName) > 0) {
+			return &_ibrSubViews.at(subviewName);
+		}
+		return nullptr;
+	}
+
+	void MultiViewBase::setUpdatePolicy(const std::string & subviewName, UpdatePolicy policy, float rate)
+	{
+		SubView * subview = findSubView(subviewName);
+		if (!subview) {
+			SIBR_WRG << "No view named <" << subviewName << "> found." << std::endl;
+			return;
+		}
+		subview->policy = policy;
+		subview->rate = rate;
+		subview->dirty = true;
+	}
+
+	void MultiViewBase::invalidateSubView(const std::string & subviewName)
+	{
+		SubView * subview = findSubView(subviewName);
+		if (!subview) {
+			SIBR_WRG << "No view named <" << subviewName << "> found." << std::endl;
+			return;
+		}
+		subview->dirty = true;
 	}
 
 	ViewBase::Ptr MultiViewBase::removeSubView(const std::string & title)
@@ -319,10 +439,10 @@ namespace sibr
 	void MultiViewBase::captureView(const std::string & subviewName, const std::string & path, const std::string & filename)
 	{
 		if (_subViews.count(subviewName)) {
-			captureView(_subViews[subviewName], path, filename);
+			queueCapture(_subViews[subviewName], path, filename);
 		}
 		else if (_ibrSubViews.count(subviewName)) {
-			captureView(_ibrSubViews[subviewName], path, filename);
+			queueCapture(_ibrSubViews[subviewName], path, filename);
 		}
 		else {
 			SIBR_WRG << "No View in the MultiViewManager with " << subviewName << " as a name!" << std::endl;
@@ -338,6 +458,66 @@ namespace sibr
 
 		view.rt->readBack(renderingImg);
 
+		makeDirectory(path);
+		renderingImg.save(capturePath(view, path, filename), true);
+	}
+
+	void MultiViewBase::captureAllViews(const std::string & path)
+	{
+		// All reads are issued in the same frame, they are written in the background.
+		for (auto & subview : _subViews) {
+			queueCapture(subview.second, path);
+		}
+		for (auto & subview : _ibrSubViews) {
+			queueCapture(subview.second, path);
+		}
+	}
+
+	void MultiViewBase::waitForCaptures()
+	{
+		collectFrames(true);
+		if (_imageWriter) {
+			_imageWriter->wait();
+		}
+	}
+
+	void MultiViewBase::renderPathInAllViews(CameraRecorder & recorder, const std::string & path, const CameraRecorder::OfflineOptions & options)
+	{
+		std::vector<CameraRecorder::OfflineView> views;
+		for (auto & subview : _ibrSubViews) {
+			if (subview.second.view->active()) {
+				CameraRecorder::OfflineView view;
+				view.view = subview.second.view;
+				view.prefix = subview.first;
+				views.push_back(view);
+			}
+		}
+		if (views.empty()) {
+			SIBR_WRG << "No active IBR view to render the path with." << std::endl;
+			return;
+		}
+		// Store the captures in flight before the path takes over the context.
+		waitForCaptures();
+		recorder.recordOfflinePath(path, views, options);
+	}
+
+	void MultiViewBase::queueCapture(const SubView & view, const std::string & path, const std::string & filename)
+	{
+		if (!_readback) {
+			_readback.reset(new PixelReadback());
+		}
+		if (_pendingFrames.size() >= _readback->slots()) {
+			collectFrames(true);
+		}
+		PendingFrame pending;
+		pending.ticket = view.rt->readBackAsync(*_readback);
+		pending.savePath = capturePath(view, path, filename);
+		pending.video = false;
+		_pendingFrames.push_back(pending);
+	}
+
+	std::string MultiViewBase::capturePath(const SubView & view, const std::string & path, const std::string & filename)
+	{
 		std::string finalPath = path + (!path.empty() ? "/" : "");
 		if (!filename.empty()) {
 			finalPath.append(filename);
@@ -346,9 +526,94 @@ namespace sibr
 			const std::string autoName = view.view->name() + "_" + sibr::timestamp();
 			finalPath.append(autoName + ".png");
 		}
+		return finalPath;
+	}
 
-		makeDirectory(path);
-		renderingImg.save(finalPath, true);
+	void MultiViewBase::collectFrames(bool block)
+	{
+		while (!_pendingFrames.empty()) {
+			const PendingFrame & pending = _pendingFrames.front();
+			ImageRGB frame;
+			if (!_readback->isPending(pending.ticket)) {
+				SIBR_WRG << "Frame " << pending.ticket << " was dropped before being read back." << std::endl;
+			}
+			else if (!_readback->fetch(pending.ticket, frame, block)) {
+				// Frames are stored in order, the next ones are not ready either.
+				return;
+			}
+			else {
+				if (pending.video) {
+					encodeVideoFrame(frame);
+				}
+				if (!pending.savePath.empty()) {
+					// Encode on the worker threads, the frame is not needed anymore.
+					if (!_imageWriter) {
+						_imageWriter.reset(new AsyncImageWriter());
+					}
+					_imageWriter->save(std::move(frame), pending.savePath);
+				}
+			}
+			_pendingFrames.pop_front();
+		}
+	}
+
+	void MultiViewBase::encodeVideoFrame(const ImageRGB & frame)
+	{
+		const Vector2i size(int(frame.w()), int(frame.h()));
+		if (!_videoEncoder) {
+			// The destination is only known at export, stream to a temporary file meanwhile.
+			const Path file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("sibr_capture_%%%%%%%%.mp4");
+			_videoTempPath = file.string();
+			_videoSize = size;
+			_videoFrameCount = 0;
+			// Convert and encode on a worker thread, with a hardware encoder if there is one.
+			// The queue blocks when full, so memory use stays bounded whatever the capture length.
+			FFVideoEncoder::Options options;
+			options.hardware = FFVideoEncoder::Hardware::AUTO;
+			options.queueSize = 8;
+			options.policy = FFVideoEncoder::QueuePolicy::BLOCK;
+			_videoEncoder.reset(new FFVideoEncoder(_videoTempPath, 30, size, options));
+			if (!_videoEncoder->isFine()) {
+				SIBR_WRG << "Unable to start the video capture in " << _videoTempPath << "." << std::endl;
+			}
+		}
+		if (size != _videoSize) {
+			SIBR_WRG << "Skipping a video frame of size " << size.transpose() << ", the capture is " << _videoSize.transpose() << "." << std::endl;
+			return;
+		}
+		if (_videoEncoder->isFine() && (*_videoEncoder << frame.toOpenCVBGR())) {
+			++_videoFrameCount;
+		}
+	}
+
+	bool MultiViewBase::finishVideoCapture(const std::string & outputVideo)
+	{
+		if (!_videoEncoder) {
+			return false;
+		}
+		_videoEncoder->close();
+		_videoEncoder.reset();
+
+		const Path tempFile(_videoTempPath);
+		bool written = false;
+		if (!outputVideo.empty() && _videoFrameCount > 0) {
+			boost::system::error_code ec;
+			boost::filesystem::rename(tempFile, outputVideo, ec);
+			if (ec) {
+				// The temporary directory can be on another drive.
+				boost::filesystem::copy_file(tempFile, outputVideo, boost::filesystem::copy_option::overwrite_if_exists, ec);
+			}
+			if (ec) {
+				SIBR_WRG << "Unable to write the video to " << outputVideo << ": " << ec.message() << "." << std::endl;
+			}
+			written = !ec;
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::remove(tempFile, ec);
+		_videoTempPath.clear();
+		_videoFrameCount = 0;
+		return written;
 	}
 
 	void MultiViewBase::mosaicLayout(const Viewport & vp)
@@ -406,7 +671,8 @@ namespace sibr
 	}
 
 	MultiViewBase::SubView::SubView(ViewBase::Ptr view_, RenderTargetRGB::Ptr rt_, const sibr::Viewport viewport_, const std::string& name_, const ImGuiWindowFlags flags_) :
-		view(view_), rt(rt_), handler(), viewport(viewport_), flags(flags_), shouldUpdateLayout(false) {
+		view(view_), rt(rt_), handler(), viewport(viewport_), flags(flags_), shouldUpdateLayout(false),
+		profileName(FrameProfiler::get().intern(name_)) {
 		renderFunc = [](ViewBase::Ptr&, const Viewport&, const IRenderTarget::Ptr&) {};
 		view->setName(name_);
 	}
@@ -468,6 +734,17 @@ namespace sibr
 
 	void MultiViewManager::onRender(Window & win)
 	{
+		SIBR_PROFILE_GPU("MultiViewManager::onRender");
+		_quality.beginFrame();
+		// Apply the quality levers for this frame.
+		if (_renderingMode) {
+			_renderingMode->resolutionScale() = _quality.resolutionScale();
+		}
+		for (auto & subview : _ibrSubViews) {
+			subview.second.view->setQualityLevel(_quality.detailLevel());
+		}
+		_skipSubViewsGui = _quality.skipGUI();
+
 		win.viewport().bind();
 		glClearColor(37.f / 255.f, 37.f / 255.f, 38.f / 255.f, 1.f);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -478,6 +755,33 @@ namespace sibr
 		MultiViewBase::onRender(win);
 
 		_fpsCounter.update(_enableGUI && _showGUI);
+		if (_enableGUI && _showGUI && _showProfiler) {
+			FrameProfiler::get().onGUI();
+		}
+		if (_enableGUI && _showGUI && _showMemory) {
+			MemoryTracker::get().onGUI();
+		}
+		if (_enableGUI && _showGUI && _showQuality) {
+			_quality.onGUI(win);
+			// Appended to the controller window: where the GPU time goes.
+			if (ImGui::Begin("Adaptive quality")) {
+				ImGui::Separator();
+				for (const auto & subview : _subViews) {
+					ImGui::Text("%s: %.2fms", subview.first.c_str(), GPUTimerPool::global().time(subview.second.profileName));
+				}
+				for (const auto & subview : _ibrSubViews) {
+					ImGui::Text("%s: %.2fms", subview.first.c_str(), GPUTimerPool::global().time(subview.second.profileName));
+				}
+			}
+			ImGui::End();
+		}
+		if (_enableGUI && _showGUI) {
+			// Background loaders report through LoadingProgress.
+			showLoadingProgress();
+		}
+		_quality.endFrame();
+		// The temporaries of the frame are not needed anymore.
+		FrameArena::frame().reset();
 	}
 
 	void MultiViewManager::onGui(Window & win)
@@ -562,6 +866,9 @@ namespace sibr
 				if (ImGui::MenuItem("Metrics", "", _fpsCounter.active())) {
 					_fpsCounter.toggleVisibility();
 				}
+				ImGui::MenuItem("Profiler", "", &_showProfiler);
+				ImGui::MenuItem("Memory", "", &_showMemory);
+				ImGui::MenuItem("Adaptive quality", "", &_showQuality);
 				if (ImGui::BeginMenu("Front when focus"))
 				{
 					for (auto & subview : _subViews) {
@@ -606,28 +913,29 @@ namespace sibr
 
 				for (auto & subview : _subViews) {
 					if (ImGui::MenuItem(subview.first.c_str())) {
-						captureView(subview.second, _exportPath);
+						queueCapture(subview.second, _exportPath);
 					}
 				}
 				for (auto & subview : _ibrSubViews) {
 					if (ImGui::MenuItem(subview.first.c_str())) {
-						captureView(subview.second, _exportPath);
+						queueCapture(subview.second, _exportPath);
 					}
 				}
+				if (ImGui::MenuItem("All views")) {
+					captureAllViews(_exportPath);
+				}
 
 				if (ImGui::MenuItem("Export Video")) {
 					std::string saveFile;
 					if (showFilePicker(saveFile, FilePickerMode::Save)) {
 						const std::string outputVideo = saveFile + ".mp4";
-						if(!_videoFrames.empty()) {
+						collectFrames(true);
+						if(_videoEncoder && _videoFrameCount > 0) {
 							SIBR_LOG << "Exporting video to : " << outputVideo << " ..." << std::flush;
-							FFVideoEncoder vdoEncoder(outputVideo, 30, Vector2i(_videoFrames[0].cols, _videoFrames[0].rows));
-							for (int i = 0; i < _videoFrames.size(); i++) {
-								vdoEncoder << _videoFrames[i];
+							// Frames were encoded while capturing, only the queued ones remain.
+							if (finishVideoCapture(outputVideo)) {
+								std::cout << " Done." << std::endl;
 							}
-							_videoFrames.clear();
-							std::cout << " Done." << std::endl;
-							
 						} else {
 							SIBR_WRG << "No frames to export!! Check save frames in camera options for the view you want to render and play the path and re-export!" << std::endl;
 						}
@@ -29,10 +29,13 @@
 # include "core/view/ViewBase.hpp"
 # include "core/graphics/Shader.hpp"
 # include "core/view/FPSCounter.hpp"
+# include "core/view/QualityController.hpp"
 #include "core/video/FFmpegVideoEncoder.hpp"
+#include "core/graphics/AsyncImageWriter.hpp"
 #include "InteractiveCameraHandler.hpp"
 #include <random>
 #include <map>
+#include <deque>
 
 
 namespace sibr
@@ -67,12 +70,22 @@ namespace sibr
 		/// Additional render callback for a subview.
 		typedef  std::function<void(sibr::ViewBase::Ptr &, const sibr::Viewport&, const IRenderTarget::Ptr& )> AdditionalRenderFunc;
 
+		/// When a subview should be rendered again, a subview that is not rendered displays its last frame.
+		enum class UpdatePolicy {
+			EVERY_FRAME, ///< Render each frame the subview is visible.
+			FIXED_RATE, ///< Render at a given frequency while visible.
+			ON_CHANGE ///< Render only when interacted with, when its camera moves or when invalidated.
+		};
+
 		/*
 		 * \brief Creates a MultiViewBase in a given OS window.
 		 * \param defaultViewRes the default resolution for each subview
 		 */
 		MultiViewBase(const Vector2i & defaultViewRes = { 800, 600 });
 
+		/// Destructor, discards a video capture that was not exported.
+		virtual ~MultiViewBase();
+
 		/**
 		 * \brief Update subviews and the MultiViewBase.
 		 * \param input The input state to use.
@@ -169,6 +182,13 @@ namespace sibr
 		*/
 		Viewport & getIBRSubViewport(const std::string &title);
 
+		/**
+		* \param title the title of the view
+		* \return the GPU time in milliseconds of the view in the last complete frame it was rendered in, 0 if unknown
+		* \note Each subview render is timed by the GPUTimerPool, this covers both basic and IBR subviews.
+		*/
+		double subViewGPUTime(const std::string & title) const;
+
 		/**
 		* \brief Unregister a subview.
 		* \param title the title of the view to remove.
@@ -201,6 +221,12 @@ namespace sibr
 		 */
 		const float & deltaTime() const { return _deltaTime; }
 
+		/**
+		 * \brief Limit the time step given to the camera handlers, so that a long frame doesn't make the cameras jump.
+		 * \param seconds the maximum step, 0.1s by default.
+		 */
+		void maxCameraDeltaTime(float seconds) { _maxCameraDeltaTime = seconds; }
+
 		/**
 		 * \brief Add a camera handler that will automatically be updated and used by the MultiViewManager for the given subview.
 		 * \param name the name of the subview to which the camera should be associated.
@@ -239,8 +265,46 @@ namespace sibr
 		* \param subviewName a string with the name of the subview.
 		* \param path the path to save the output.
 		* \param filename the name of the output file, needs to have an OpenCV compatible file type.
+		* \note The readback and encoding are asynchronous, use waitForCaptures to ensure the file has been written.
 		*/
 		void captureView(const std::string& subviewName, const std::string& path = "./screenshots", const std::string& filename = "");
+
+		/**
+		* \brief captures the content of all subviews at once, each in an image file named after the view.
+		* \param path the path to save the outputs.
+		* \note The readback and encoding are asynchronous, use waitForCaptures to ensure the files have been written.
+		*/
+		void captureAllViews(const std::string& path = "./screenshots");
+
+		/**
+		* \brief Wait until all requested captures have been written on disk.
+		* \note Requires the OpenGL context.
+		*/
+		void waitForCaptures();
+
+		/**
+		* \brief Render a camera path offline in all the active IBR subviews in one pass, each in a subdirectory named after the subview.
+		* Each camera of the path is rendered by every subview in turn, the readbacks and image encodings of all the subviews are pipelined.
+		* \param recorder the recorder holding the path and its output resolution.
+		* \param path the destination directory.
+		* \param options pipelining and output format, the frame sink is not used.
+		* \note Requires the OpenGL context.
+		*/
+		void renderPathInAllViews(CameraRecorder & recorder, const std::string & path, const CameraRecorder::OfflineOptions & options = CameraRecorder::OfflineOptions());
+
+		/**
+		* \brief Set how often a subview is rendered. Hidden subviews (collapsed or out of the screen) are never rendered.
+		* \param subviewName the name of the subview.
+		* \param policy the update policy.
+		* \param rate the rendering frequency in Hz, for UpdatePolicy::FIXED_RATE.
+		*/
+		void setUpdatePolicy(const std::string& subviewName, UpdatePolicy policy, float rate = 10.0f);
+
+		/**
+		* \brief Ask for a subview to be rendered at the next frame, whatever its update policy.
+		* \param subviewName the name of the subview.
+		*/
+		void invalidateSubView(const std::string& subviewName);
 	protected:
 
 		/** Internal representation of a subview.
@@ -254,6 +318,13 @@ namespace sibr
 			sibr::Viewport viewport; ///< Viewport in the global window.
 			ImGuiWindowFlags flags = 0; ///< ImGui flags.
 			bool shouldUpdateLayout = false; ///< Should the layout be updated at the next frame.
+			UpdatePolicy policy = UpdatePolicy::EVERY_FRAME; ///< When to render the subview.
+			float rate = 10.0f; ///< Rendering frequency for UpdatePolicy::FIXED_RATE.
+			bool visible = true; ///< Was the subview content visible on screen last frame.
+			bool dirty = true; ///< Should the subview be rendered at the next frame.
+			const IRenderTarget * renderedRT = nullptr; ///< RT holding the last rendered frame, null if none.
+			std::chrono::time_point<std::chrono::steady_clock> lastRender; ///< Time of the last rendering.
+			const char * profileName = "Subview"; ///< Name of the rendering scope in the FrameProfiler.
 
 			/// Default constructor.
 			SubView() = default;
@@ -310,6 +381,7 @@ namespace sibr
 		struct IBRSubView final : SubView {
 			IBRViewUpdateFunc updateFunc; ///< The update function.
 			sibr::InputCamera cam; ///< The current camera.
+			Matrix4f renderedViewProj = Matrix4f::Zero(); ///< Camera of the last rendering, to detect changes.
 			bool defaultUpdateFunc = true; ///< Was the default update function used.
 
 			/// Default constructor.
@@ -355,10 +427,23 @@ namespace sibr
 											const IBRViewUpdateFunc updateFunc, const Vector2u & res, 
 											const ImGuiWindowFlags flags, const bool defaultFuncUsed);
 
-		/** Perform rendering for a given subview.
+		/** Perform rendering for a given subview, if its content has to be updated, and display it.
 		 *\param subview the subview to render
+		 *\return true if the subview was rendered, false if its last frame was reused
+		 **/
+		bool renderSubView(SubView & subview);
+
+		/** Check if a subview has to be rendered this frame, according to its visibility and update policy.
+		 *\param subview the subview
+		 *\return true if the subview should be rendered
 		 **/
-		void renderSubView(SubView & subview);
+		bool needsRendering(const SubView & subview) const;
+
+		/** Find a subview by name.
+		 *\param subviewName the name of the subview
+		 *\return the subview, null if not found
+		 **/
+		SubView * findSubView(const std::string & subviewName);
 
 		/** Capture a view as an image on disk.
 		 *\param view the view to capture
@@ -367,6 +452,45 @@ namespace sibr
 		 *\note if the filename is empty, the name of the view is used, with a timestamp appended.
 		 **/
 		static void captureView(const SubView & view, const std::string & path = "./screenshots/", const std::string & filename = "");
+
+		/** Capture a view as an image on disk, without stalling: the readback is collected on a later frame and encoded on worker threads.
+		 *\param view the view to capture
+		 *\param path the destination direcotry path
+		 *\param filename an optional filename
+		 *\note if the filename is empty, the name of the view is used, with a timestamp appended.
+		 **/
+		void queueCapture(const SubView & view, const std::string & path, const std::string & filename = "");
+
+		/** Build the destination of a capture.
+		 *\param view the view to capture
+		 *\param path the destination direcotry path
+		 *\param filename an optional filename
+		 *\return the file path
+		 **/
+		static std::string capturePath(const SubView & view, const std::string & path, const std::string & filename);
+
+		/** Store the frames whose readback is done, saving them on disk and/or streaming them to the video encoder.
+		 *\param block wait for all frames in flight
+		 **/
+		void collectFrames(bool block);
+
+		/** Stream a frame to the video capture encoder, creating it on the first frame.
+		 *\param frame the frame to encode
+		 **/
+		void encodeVideoFrame(const ImageRGB & frame);
+
+		/** Finish the current video capture and move it to its final location.
+		 *\param outputVideo the destination file, the capture is discarded if empty
+		 *\return true if a video was written
+		 **/
+		bool finishVideoCapture(const std::string & outputVideo);
+
+		/// A subview frame being read back.
+		struct PendingFrame {
+			PixelReadback::Ticket ticket; ///< Readback ticket.
+			std::string savePath; ///< Path to save the frame to, empty if none.
+			bool video; ///< Should the frame be added to the video.
+		};
 		
 		IRenderingMode::Ptr _renderingMode = nullptr; ///< Rendering mode.
 		std::map<std::string, BasicSubView> _subViews; ///< Regular subviews.
@@ -376,11 +500,19 @@ namespace sibr
 		Vector2i _defaultViewResolution; ///< Default view resolution.
 
 		std::string _exportPath; ///< Capture output path.
-		std::vector<cv::Mat> _videoFrames; ///< Video frames.
+		std::unique_ptr<FFVideoEncoder> _videoEncoder; ///< Encoder of the current video capture, frames are streamed to a temporary file.
+		std::string _videoTempPath; ///< Temporary file of the current video capture.
+		Vector2i _videoSize; ///< Frame size of the current video capture.
+		size_t _videoFrameCount = 0; ///< Frames encoded in the current video capture.
+		PixelReadback::UPtr _readback; ///< Readback ring for saved frames, created on first use.
+		std::deque<PendingFrame> _pendingFrames; ///< Saved frames being read back, oldest first.
+		AsyncImageWriter::UPtr _imageWriter; ///< Encodes saved frames and captures on worker threads, created on first use.
 
 		std::chrono::time_point<std::chrono::steady_clock> _timeLastFrame; ///< Last frame time point.
 		float _deltaTime; ///< Elapsed time.
+		float _maxCameraDeltaTime = 0.1f; ///< Maximum time step of the camera handlers.
 		bool _showSubViewsGui = true; ///< Show the GUI of the subviews.
+		bool _skipSubViewsGui = false; ///< Skip the GUI of the subviews this frame, to save time.
 		bool _onPause = false; ///< Paused interaction and update.
 		bool _enableGUI = true; ///< Should the GUI be enabled.
 	};
@@ -425,6 +557,10 @@ namespace sibr
 		Window& _window; ///< The OS window.
 		FPSCounter _fpsCounter; ///< A FPS counter.
 		bool _showGUI = true; ///< Should the GUI be displayed.
+		bool _showProfiler = false; ///< Should the frame profiler be displayed.
+		bool _showMemory = false; ///< Should the memory usage be displayed.
+		QualityController _quality; ///< Adaptive quality controller.
+		bool _showQuality = false; ///< Should the adaptive quality settings be displayed.
 
 	};
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/view/QualityController.hpp"
+#include "core/graphics/Window.hpp"
+#include "core/graphics/FrameProfiler.hpp"
+#include "core/graphics/GPUTimerPool.hpp"
+#include "core/graphics/GUI.hpp"
+#include <algorithm>
+
+namespace sibr
+{
+	namespace {
+
+		const float kSmoothing = 0.1f; // Weight of the new frame in the smoothed frame time.
+		const float kHighWater = 0.95f; // Fraction of the budget above which the level drops.
+		const float kLowWater = 0.7f; // Fraction of the budget below which the level rises.
+		const int kFramesToDrop = 5; // Frames over budget before dropping.
+		const int kFramesToRise = 30; // Frames with headroom before rising.
+		const int kCooldownFrames = 10; // Frames for a change to show in the measurements.
+		const float kStep = 0.05f; // Level change.
+		const float kMinScale = 0.5f; // Lowest resolution scale.
+
+		/// Level below which the resolution is reduced.
+		float resolutionThreshold(const QualityController::Levers & levers)
+		{
+			return levers.detail ? 0.5f : 1.0f;
+		}
+	}
+
+	void QualityController::beginFrame()
+	{
+		_frameStart = std::chrono::steady_clock::now();
+	}
+
+	void QualityController::endFrame()
+	{
+		_cpuTime = float(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _frameStart).count());
+		_gpuTime = float(GPUTimerPool::global().frameTime());
+
+		const float frame = std::max(_cpuTime, _gpuTime);
+		_frameTime = _frameTime > 0.0f ? (1.0f - kSmoothing) * _frameTime + kSmoothing * frame : frame;
+		FrameProfiler::get().counter("Quality level", double(_level));
+
+		if (!_enabled) {
+			_level = 1.0f;
+			return;
+		}
+		if (_cooldown > 0) {
+			--_cooldown;
+			return;
+		}
+
+		const float budgetMs = budget();
+		if (_frameTime > kHighWater * budgetMs) {
+			_underBudget = 0;
+			if (++_overBudget >= kFramesToDrop) {
+				// Drop faster when far above the budget.
+				const float step = _frameTime > 1.5f * budgetMs ? 2.0f * kStep : kStep;
+				_level = std::max(minLevel(), _level - step);
+				_overBudget = 0;
+				_cooldown = kCooldownFrames;
+			}
+		}
+		else if (_frameTime < kLowWater * budgetMs) {
+			_overBudget = 0;
+			if (++_underBudget >= kFramesToRise) {
+				_level = std::min(1.0f, _level + kStep);
+				_underBudget = 0;
+				_cooldown = kCooldownFrames;
+			}
+		}
+		else {
+			_overBudget = _underBudget = 0;
+		}
+	}
+
+	void QualityController::reset()
+	{
+		_level = 1.0f;
+		_frameTime = 0.0f;
+		_overBudget = _underBudget = _cooldown = 0;
+	}
+
+	float QualityController::resolutionScale() const
+	{
+		const float threshold = resolutionThreshold(_levers);
+		if (!_levers.resolution || _level >= threshold) {
+			return 1.0f;
+		}
+		const float t = (_level - minLevel()) / (threshold - minLevel());
+		return kMinScale + (1.0f - kMinScale) * t;
+	}
+
+	float QualityController::detailLevel() const
+	{
+		if (!_levers.detail) {
+			return 1.0f;
+		}
+		// The detail covers the upper half of the levels when the resolution is also reduced.
+		const float low = _levers.resolution ? 0.5f : minLevel();
+		return std::min(1.0f, std::max(0.0f, (_level - low) / (1.0f - low)));
+	}
+
+	bool QualityController::skipGUI() const
+	{
+		return _enabled && _levers.gui && _level <= minLevel();
+	}
+
+	void QualityController::onGUI(Window & win, const std::string & windowName)
+	{
+		if (ImGui::Begin(windowName.c_str())) {
+			if (ImGui::Checkbox("Enabled", &_enabled) && !_enabled) {
+				reset();
+			}
+			if (ImGui::SliderFloat("Target (Hz)", &_targetFramerate, 15.0f, 240.0f, "%.0f")) {
+				_targetFramerate = std::max(_targetFramerate, 1.0f);
+				if (_pace) {
+					win.targetFramerate(_targetFramerate);
+				}
+			}
+			if (ImGui::Checkbox("Pace frames", &_pace)) {
+				win.targetFramerate(_pace ? _targetFramerate : 0.0f);
+			}
+			ImGui::Checkbox("Resolution", &_levers.resolution);
+			ImGui::SameLine();
+			ImGui::Checkbox("Detail", &_levers.detail);
+			ImGui::SameLine();
+			ImGui::Checkbox("Hide GUI", &_levers.gui);
+
+			ImGui::Separator();
+			ImGui::Text("CPU: %.2fms, GPU: %.2fms", _cpuTime, _gpuTime);
+			ImGui::Text("Frame: %.2fms / %.2fms", _frameTime, budget());
+			ImGui::ProgressBar(_level, ImVec2(-1.0f, 0.0f), "Quality");
+			ImGui::Text("Resolution: %.0f%%, detail: %.0f%%", 100.0f * resolutionScale(), 100.0f * detailLevel());
+		}
+		ImGui::End();
+	}
+
+} // namespace sibr
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+# include "core/view/Config.hpp"
+# include <chrono>
+# include <string>
+
+namespace sibr
+{
+	class Window;
+
+	/**
+	 * Frame time budget controller: measures the CPU and GPU time of each frame and derives a quality
+	 * level in [minLevel(), 1] so that the frame fits in the budget of the target framerate.
+	 * The level drops quickly when the budget is exceeded and recovers slowly when there is headroom,
+	 * with a cooldown after each change to avoid oscillations. It is mapped to the enabled levers:
+	 * the detail of the views (see ViewBase::setQualityLevel) is reduced first, then the render
+	 * resolution, and finally the subviews GUI can be hidden.
+	 *
+	 *		_quality.beginFrame();
+	 *		... render, using _quality.resolutionScale() and _quality.detailLevel() ...
+	 *		_quality.endFrame();
+	 *
+	 * The GPU time is the one of the top level scopes of the last frame resolved by the GPUTimerPool, a few
+	 * frames late, without stalling.
+	 * \ingroup sibr_view
+	 */
+	class SIBR_VIEW_EXPORT QualityController
+	{
+		SIBR_DISALLOW_COPY(QualityController);
+
+	public:
+
+		/// Quality levers the controller can act on.
+		struct Levers {
+			bool resolution = true; ///< Render the views at a lower resolution.
+			bool detail = true; ///< Lower the views detail, see ViewBase::setQualityLevel.
+			bool gui = false; ///< Hide the subviews GUI at the lowest level.
+		};
+
+		/// Constructor.
+		QualityController() = default;
+
+		/** Start timing a frame. */
+		void beginFrame();
+
+		/** Stop timing the frame and update the quality level. */
+		void endFrame();
+
+		/** Go back to full quality and forget the measurements. */
+		void reset();
+
+		/** \return the current quality level, 1 is full quality. */
+		float level() const { return _level; }
+
+		/** \return the scale to apply to the views render resolution, in [0.5, 1]. */
+		float resolutionScale() const;
+
+		/** \return the level to pass to the views, in [0, 1]. */
+		float detailLevel() const;
+
+		/** \return true if the subviews GUI should be skipped this frame. */
+		bool skipGUI() const;
+
+		/** \return the CPU time of the last frame in milliseconds. */
+		float cpuTime() const { return _cpuTime; }
+
+		/** \return the GPU time of the last resolved frame in milliseconds. */
+		float gpuTime() const { return _gpuTime; }
+
+		/** \return the smoothed frame time used by the controller in milliseconds. */
+		float frameTime() const { return _frameTime; }
+
+		/** \return the frame budget in milliseconds. */
+		float budget() const { return 1000.0f / _targetFramerate; }
+
+		/** \return true if the controller adjusts the quality. */
+		bool & enabled() { return _enabled; }
+
+		/** \return the target framerate. */
+		float & targetFramerate() { return _targetFramerate; }
+
+		/** \return the levers the controller can act on. */
+		Levers & levers() { return _levers; }
+
+		/** \return the lowest quality level. */
+		static float minLevel() { return 0.25f; }
+
+		/** Display the timings and settings.
+		\param win the window, to pace its frames to the target framerate
+		\param windowName the ImGui window name
+		*/
+		void onGUI(Window & win, const std::string & windowName = "Adaptive quality");
+
+	private:
+
+		std::chrono::steady_clock::time_point _frameStart; ///< CPU start of the current frame.
+
+		bool _enabled = false; ///< Adjust the quality.
+		bool _pace = false; ///< Pace the window frames to the target framerate.
+		float _targetFramerate = 60.0f; ///< Target framerate.
+		Levers _levers; ///< Enabled levers.
+		float _level = 1.0f; ///< Current quality level.
+		float _cpuTime = 0.0f; ///< Last CPU frame time.
+		float _gpuTime = 0.0f; ///< Last GPU frame time.
+		float _frameTime = 0.0f; ///< Smoothed frame time, 0 before the first measurement.
+		int _overBudget = 0; ///< Consecutive frames over budget.
+		int _underBudget = 0; ///< Consecutive frames with headroom.
+		int _cooldown = 0; ///< Frames to wait before the next change.
+	};
+
+} // namespace sibr
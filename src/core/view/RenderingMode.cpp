@@ -15,6 +15,8 @@
 #include "core/view/RenderingMode.hpp"
 #include "core/assets/Resources.hpp"
 #include "core/graphics/Image.hpp"
+#include "core/graphics/RenderTargetPool.hpp"
+#include "core/graphics/FrameProfiler.hpp"
 
 namespace sibr
 {
@@ -56,35 +58,56 @@ namespace sibr
 
 		if (!_destRT)// || _destRT->w() != w || _destRT->h() != h)
 			_destRT.reset( new RenderTarget(w, h, SIBR_GPU_LINEAR_SAMPLING) );
-		glViewport(0, 0, w, h);
-		_destRT->bind();
 
-		if( _clear ) {
-			viewport.clear();
-			// blend with previous
-			view.preRender(*_destRT);
-		}
-		else {
-			// can come from somewhere else
-			view.preRender(*_prevR);
+		// Render at a lower resolution in a pooled target, upscaled by the quad pass below.
+		RenderTarget * dst = _destRT.get();
+		RenderTargetRGB::Ptr scaledRT;
+		if (_resolutionScale < 1.0f) {
+			const uint sw = std::max(1u, uint(std::round(float(w) * _resolutionScale)));
+			const uint sh = std::max(1u, uint(std::round(float(h) * _resolutionScale)));
+			scaledRT = RenderTargetPool::global().acquire<unsigned char, 3>(sw, sh, SIBR_GPU_LINEAR_SAMPLING);
+			dst = scaledRT.get();
+			w = int(sw);
+			h = int(sh);
 		}
+		glViewport(0, 0, w, h);
+		dst->bind();
 
-		view.onRenderIBR(*_destRT, eye);
-		_destRT->unbind();
+		{
+			SIBR_PROFILE_GPU("Render view");
+			if( _clear ) {
+				if (scaledRT) {
+					Viewport(0.0f, 0.0f, float(w), float(h)).clear();
+				}
+				else {
+					viewport.clear();
+				}
+				// blend with previous
+				view.preRender(*dst);
+			}
+			else {
+				// can come from somewhere else
+				view.preRender(*_prevR);
+			}
+
+			view.onRenderIBR(*dst, eye);
+			dst->unbind();
+		}
 
 		//show(*_destRT, "before");
 
 		//glEnable (GL_BLEND);
 		//glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+		SIBR_PROFILE_GPU("Present");
 		glDisable (GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		//glDepthMask(GL_FALSE);
 
 		//glEnable (GL_BLEND);
 		//glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		_quadShader.begin();
-		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _destRT->texture());
+		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, dst->texture());
 
 		if (optDest) // Optionally you can render to another RenderTarget
 		{
@@ -138,40 +161,43 @@ std::cerr <<"End of render pass 1" << std::endl;
 		leye.size(w, h); reye.size(w, h);
 		leye.position(eye.position()-_eyeDist*eye.right());
 
-		// setup left eye
-		leye.setStereoCam(true, _focalDist, _eyeDist);
-		_leftRT->bind();
-		if( _clear )  {
-			viewport.clear();
-			view.preRender(*_leftRT);
-		}
-		else {
-			// can come from somewhere else
-			view.preRender(*_prevL);
-		}
-
-		view.onRenderIBR(*_leftRT, leye);
-		_leftRT->unbind();
-
-		// setup right eye
-		reye.position(eye.position()+_eyeDist*eye.right());
-		reye.setStereoCam(false, _focalDist, _eyeDist);
-
-		// render right eye
-		_rightRT->bind();
-		if( _clear ) {
-			viewport.clear();
-			view.preRender(*_rightRT);
-		}
-		else {
-			// can come from somewhere else
-			view.preRender(*_prevR);
+		{
+			SIBR_PROFILE_GPU("Render eyes");
+			// setup left eye
+			leye.setStereoCam(true, _focalDist, _eyeDist);
+			_leftRT->bind();
+			if( _clear )  {
+				viewport.clear();
+				view.preRender(*_leftRT);
+			}
+			else {
+				// can come from somewhere else
+				view.preRender(*_prevL);
+			}
+			_leftRT->unbind();
+
+			// setup right eye
+			reye.position(eye.position()+_eyeDist*eye.right());
+			reye.setStereoCam(false, _focalDist, _eyeDist);
+
+			_rightRT->bind();
+			if( _clear ) {
+				viewport.clear();
+				view.preRender(*_rightRT);
+			}
+			else {
+				// can come from somewhere else
+				view.preRender(*_prevR);
+			}
+			_rightRT->unbind();
+
+			// render both eyes, views can share work between them
+			view.onRenderIBRStereo(*_leftRT, *_rightRT, leye, reye);
 		}
-		view.onRenderIBR(*_rightRT, reye);
-		_rightRT->unbind();
 
+		SIBR_PROFILE_GPU("Anaglyph");
 		glDisable (GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 
 		_stereoShader.begin();
 		glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, _leftRT->texture());
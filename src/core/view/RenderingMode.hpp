@@ -72,6 +72,13 @@ namespace sibr
 		/** \return the right eye (or common) RT. */
 		virtual const std::unique_ptr<RenderTargetRGB>&	rRT() = 0;
 
+		/** \return the scale applied to the view render resolution, the result is upscaled to the destination.
+		 *\note Only supported by MonoRdrMode. */
+		float & resolutionScale() { return _resolutionScale; }
+
+	protected:
+		float _resolutionScale = 1.0f; ///< Render resolution scale.
+
 	};
 
 	/** Default rendering mode: monoview, passthrough.
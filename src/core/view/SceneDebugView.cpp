@@ -14,8 +14,11 @@
 # include "core/graphics/RenderUtility.hpp"
 # include "core/graphics/Input.hpp"
 # include "core/graphics/GUI.hpp"
+# include "core/graphics/Frustum.hpp"
+# include "core/graphics/StreamingBuffer.hpp"
 #include <core/raycaster/CameraRaycaster.hpp>
 
+#include <algorithm>
 #include <sstream>
 
 namespace sibr
@@ -189,12 +192,196 @@ namespace sibr
 		_shaderArray.end();
 	}
 
+	CameraInstancesViewer::~CameraInstancesViewer()
+	{
+		glDeleteBuffers(1, &_instanceBuffer);
+		glDeleteVertexArrays(1, &_emptyVAO);
+		glDeleteTextures(1, &_thumbnails);
+	}
+
+	void CameraInstancesViewer::initCameraInstancesShaders()
+	{
+		_frustaShader.init("cameraFrusta",
+			loadFile(Resources::Instance()->getResourceFilePathName("camera_frusta.vert")),
+			loadFile(Resources::Instance()->getResourceFilePathName("camera_frusta.frag")));
+		_frustaMVP.init(_frustaShader, "mvp");
+		_frustaScale.init(_frustaShader, "scale");
+
+		_planesShader.init("cameraPlanes",
+			loadFile(Resources::Instance()->getResourceFilePathName("camera_planes.vert")),
+			loadFile(Resources::Instance()->getResourceFilePathName("camera_planes.frag")));
+		_planesMVP.init(_planesShader, "mvp");
+		_planesScale.init(_planesShader, "scale");
+		_planesAlpha.init(_planesShader, "alpha");
+
+		glCreateBuffers(1, &_instanceBuffer);
+		glCreateVertexArrays(1, &_emptyVAO);
+	}
+
+	void CameraInstancesViewer::setupCameraInstances(const std::vector<InputCamera::Ptr> & cams)
+	{
+		_instances.resize(cams.size());
+		_instanceCenters.resize(cams.size());
+		_instanceRadii.resize(cams.size());
+		_visibleInstances.clear();
+
+#pragma omp parallel for
+		for (int i = 0; i < int(cams.size()); ++i) {
+			const InputCamera & cam = *cams[i];
+			CameraInstance & instance = _instances[i];
+			std::fill_n(instance.position, 4, 1.0f);
+			std::fill_n(instance.color, 4, 1.0f);
+			std::copy_n(cam.position().data(), 3, instance.position);
+
+			// Same corners as generateCamFrustum.
+			const auto corners = cam.getImageCorners();
+			Vector3f mean(0, 0, 0);
+			Vector3f dirs[4];
+			for (int k = 0; k < 4; ++k) {
+				dirs[k] = CameraRaycaster::computeRayDir(cam, corners[k].cast<float>() + 0.5f*Vector2f(1, 1));
+				std::copy_n(dirs[k].data(), 3, instance.corners[k]);
+				instance.corners[k][3] = 0.0f;
+				mean += 0.25f * dirs[k];
+			}
+			// Sphere containing the center and the corners.
+			const Vector3f center = 0.5f * mean;
+			float radius = center.norm();
+			for (int k = 0; k < 4; ++k) {
+				radius = std::max(radius, (dirs[k] - center).norm());
+			}
+			_instanceCenters[i] = center;
+			_instanceRadii[i] = radius;
+		}
+
+		glNamedBufferData(_instanceBuffer, std::max(size_t(1), _instances.size()) * sizeof(CameraInstance), nullptr, GL_DYNAMIC_DRAW);
+		if (!_instances.empty()) {
+			glNamedBufferSubData(_instanceBuffer, 0, _instances.size() * sizeof(CameraInstance), _instances.data());
+		}
+	}
+
+	void CameraInstancesViewer::setupCameraThumbnails(const std::vector<RenderTargetRGBA32F::Ptr> & rts, uint maxSide)
+	{
+		glDeleteTextures(1, &_thumbnails);
+		_thumbnails = 0;
+
+		const auto first = std::find_if(rts.begin(), rts.end(), [](const RenderTargetRGBA32F::Ptr & rt) { return bool(rt); });
+		if (first == rts.end()) {
+			return;
+		}
+		// All thumbnails have the aspect ratio of the first image, the planes are stretched anyway.
+		const float ratio = float((*first)->w()) / float(std::max(1u, (*first)->h()));
+		const GLsizei w = GLsizei(std::max(1.0f, ratio >= 1.0f ? float(maxSide) : float(maxSide) * ratio));
+		const GLsizei h = GLsizei(std::max(1.0f, ratio >= 1.0f ? float(maxSide) / ratio : float(maxSide)));
+		const GLsizei levels = GLsizei(std::floor(std::log2(float(std::max(w, h))))) + 1;
+
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &_thumbnails);
+		glTextureStorage3D(_thumbnails, levels, GL_RGBA8, w, h, GLsizei(rts.size()));
+		glTextureParameteri(_thumbnails, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(_thumbnails, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(_thumbnails, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(_thumbnails, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// Downscale each image on the GPU.
+		GLuint framebuffer = 0;
+		glCreateFramebuffers(1, &framebuffer);
+		for (int i = 0; i < int(rts.size()); ++i) {
+			if (!rts[i]) {
+				continue;
+			}
+			glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, _thumbnails, 0, i);
+			glBlitNamedFramebuffer(rts[i]->fbo(), framebuffer,
+				0, 0, rts[i]->w(), rts[i]->h(), 0, 0, w, h,
+				GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+		GLState::deleteFramebuffers(1, &framebuffer);
+		glGenerateTextureMipmap(_thumbnails);
+		SIBR_LOG << "[SceneDebugView] Built " << rts.size() << " thumbnails of " << w << "x" << h << "." << std::endl;
+	}
+
+	void CameraInstancesViewer::setCameraColors(const std::vector<Vector3f> & colors)
+	{
+		const size_t count = std::min(colors.size(), _instances.size());
+		size_t firstChanged = count, lastChanged = 0;
+		for (size_t i = 0; i < count; ++i) {
+			float * color = _instances[i].color;
+			if (color[0] != colors[i][0] || color[1] != colors[i][1] || color[2] != colors[i][2]) {
+				std::copy_n(colors[i].data(), 3, color);
+				firstChanged = std::min(firstChanged, i);
+				lastChanged = i;
+			}
+		}
+		if (firstChanged < count) {
+			glNamedBufferSubData(_instanceBuffer, firstChanged * sizeof(CameraInstance),
+				(lastChanged - firstChanged + 1) * sizeof(CameraInstance), &_instances[firstChanged]);
+		}
+	}
+
+	void CameraInstancesViewer::cullCameraInstances(const Camera & eye, float scale, const std::vector<bool> & active)
+	{
+		Frustum frustum(eye.viewproj());
+		_visibleInstances.clear();
+		for (int i = 0; i < int(_instances.size()); ++i) {
+			if (i < int(active.size()) && !active[i]) {
+				continue;
+			}
+			const float * position = _instances[i].position;
+			const Vector3f center = Vector3f(position[0], position[1], position[2]) + scale * _instanceCenters[i];
+			if (frustum.testSphere(center, scale * _instanceRadii[i]) != Frustum::OUTSIDE) {
+				_visibleInstances.push_back(uint(i));
+			}
+		}
+		// Culled each frame, streamed instead of updating a buffer the previous frame may still read.
+		if (!_visibleInstances.empty()) {
+			_visibleRange = StreamingBuffer::global().upload(_visibleInstances.data(), _visibleInstances.size() * sizeof(uint), StreamingBuffer::STORAGE);
+		}
+	}
+
+	void CameraInstancesViewer::renderFrusta(const Camera & eye, float scale)
+	{
+		if (_visibleInstances.empty()) {
+			return;
+		}
+		GLState::enable(GL_DEPTH_TEST);
+		_frustaShader.begin();
+		_frustaMVP.set(eye.viewproj());
+		_frustaScale.set(scale);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _instanceBuffer);
+		StreamingBuffer::bindRange(GL_SHADER_STORAGE_BUFFER, 1, _visibleRange);
+		glBindVertexArray(_emptyVAO);
+		// Eight lines per camera.
+		glDrawArraysInstanced(GL_LINES, 0, 16, GLsizei(_visibleInstances.size()));
+		glBindVertexArray(0);
+		_frustaShader.end();
+	}
+
+	void CameraInstancesViewer::renderImagePlanes(const Camera & eye, float scale, float alpha, uint tex2Darray_handle)
+	{
+		const GLuint texture = tex2Darray_handle != 0 ? tex2Darray_handle : _thumbnails;
+		if (_visibleInstances.empty() || texture == 0) {
+			return;
+		}
+		GLState::enable(GL_DEPTH_TEST);
+		_planesShader.begin();
+		_planesMVP.set(eye.viewproj());
+		_planesScale.set(scale);
+		_planesAlpha.set(alpha);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _instanceBuffer);
+		StreamingBuffer::bindRange(GL_SHADER_STORAGE_BUFFER, 1, _visibleRange);
+		glBindVertexArray(_emptyVAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, GLsizei(_visibleInstances.size()));
+		glBindVertexArray(0);
+		_planesShader.end();
+	}
+
 	SceneDebugView::SceneDebugView(const IIBRScene::Ptr & scene, 
 		const InteractiveCameraHandler::Ptr & camHandler, const BasicDatasetArgs & myArgs)
 	{
 
 		initImageCamShaders();
 		setupLabelsManagerShader();
+		initCameraInstancesShaders();
 
 		_scene = scene;
 		_userCurrentCam = camHandler;
@@ -289,32 +476,33 @@ namespace sibr
 			}
 		}	
 
-		auto used_cams = std::make_shared<Mesh>(), non_used_cams = std::make_shared<Mesh>();
-		for (const auto & camInfos : _cameras) {
-			if (!camInfos.cam.isActive()) { continue; }
-			(camInfos.highlight ? used_cams : non_used_cams)->merge(*generateCamFrustum(camInfos.cam, 0.0f, _cameraScaling));
-		}
+		renderMeshes();
 
-		addMeshAsLines("used cams", used_cams).setColor({ 0,1,0 });
-		addMeshAsLines("non used cams", non_used_cams).setColor({ 0,0,1 });
+		// All cameras are drawn with two instanced draws, used cameras in green, the one selected in the GUI in yellow.
+		if (_showFrusta || (_scene && _showImages)) {
+			std::vector<Vector3f> colors(_cameras.size());
+			std::vector<bool> active(_cameras.size());
+			for (int i = 0; i < int(_cameras.size()); ++i) {
+				colors[i] = i == _cameraIdInfoGUI ? Vector3f(1, 1, 0) : (_cameras[i].highlight ? Vector3f(0, 1, 0) : Vector3f(0, 0, 1));
+				active[i] = _cameras[i].cam.isActive();
+			}
+			setCameraColors(colors);
+			cullCameraInstances(camera_handler.getCamera(), _cameraScaling, active);
+		}
 
-		renderMeshes();
+		if (_showFrusta) {
+			renderFrusta(camera_handler.getCamera(), _cameraScaling);
+		}
 
 		if (_scene && _showImages) {
+			const auto & scene_rts = _scene->renderTargets();
+			const auto & textureArray = scene_rts->getInputRGBTextureArrayPtr();
+			if (!textureArray && !hasCameraThumbnails()) {
+				setupCameraThumbnails(scene_rts->inputImagesRT());
+			}
 			glEnable(GL_BLEND);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			int cam_id = 0;
-			for (const auto & camInfos : _cameras) {
-				if (camInfos.cam.isActive()) {
-					const auto & scene_rts = _scene->renderTargets();
-					if (scene_rts->getInputRGBTextureArrayPtr()) {
-						renderImage(camera_handler.getCamera(), camInfos.cam, scene_rts->getInputRGBTextureArrayPtr()->handle(), cam_id);
-					} else {
-						renderImage(camera_handler.getCamera(), camInfos.cam, scene_rts->inputImagesRT(), cam_id);
-					}
-				}
-				++cam_id;
-			}
+			renderImagePlanes(camera_handler.getCamera(), _cameraScaling, _alphaImage, textureArray ? textureArray->handle() : 0);
 			glDisable(GL_BLEND);
 		}
 
@@ -383,6 +571,8 @@ namespace sibr
 			ImGui::InputFloat("Camera scale", &_cameraScaling, 0.1f, 10.0f);
 			_cameraScaling = std::max(0.001f, _cameraScaling);
 
+			ImGui::Checkbox("Draw frusta ", &_showFrusta);
+
 			ImGui::Checkbox("Draw labels ", &_showLabels);
 			if (_showLabels) {
 				ImGui::SameLine();
@@ -479,6 +669,10 @@ namespace sibr
 	{
 		if (_scene) {
 			setupLabelsManagerMeshes(_scene->cameras()->inputCameras());
+			setupCameraInstances(_scene->cameras()->inputCameras());
+			// Thumbnails are rebuilt on the next render if needed.
+			glDeleteTextures(1, &_thumbnails);
+			_thumbnails = 0;
 			setupMeshes();
 
 			_cameras.clear();
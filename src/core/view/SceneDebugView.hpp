@@ -19,6 +19,7 @@
 # include "core/graphics/Camera.hpp"
 # include "core/graphics/Window.hpp"
 # include "core/graphics/Shader.hpp"
+# include "core/graphics/StreamingBuffer.hpp"
 # include "core/graphics/Mesh.hpp"
 # include "core/view/InteractiveCameraHandler.hpp"
 # include "core/view/ViewBase.hpp"
@@ -147,11 +148,90 @@ namespace sibr
 		float						_cameraScaling = 0.8f; ///< Camera scaling.
 	};
 
+	/** Helper used to render the frusta and image planes of all cameras at once, with one instanced draw each.
+	 * The camera centers and image corner directions are stored once in a shader storage buffer, 
+	 * and the cameras visible from the current viewpoint are selected on the CPU using their bounding spheres.
+	 * Image planes sample a texture array: the scene one if available, else thumbnails of the input images.
+	  \ingroup sibr_view
+	 */
+	struct SIBR_VIEW_EXPORT CameraInstancesViewer {
+
+	protected:
+
+		/// Destructor, releases the buffers and thumbnails.
+		~CameraInstancesViewer();
+
+		/** Initialize the shaders. */
+		void initCameraInstancesShaders();
+
+		/** Upload the cameras geometry, their colors are reset.
+		 *\param cams the cameras
+		 */
+		void setupCameraInstances(const std::vector<InputCamera::Ptr> & cams);
+
+		/** Build low resolution copies of separate input images in a texture array, used for the image planes.
+		 *\param rts the input images, one per camera
+		 *\param maxSide the largest side of the thumbnails
+		 */
+		void setupCameraThumbnails(const std::vector<RenderTargetRGBA32F::Ptr> & rts, uint maxSide = 256);
+
+		/** Update the camera colors, the buffer is only updated if a color changed.
+		 *\param colors the color of each camera
+		 */
+		void setCameraColors(const std::vector<Vector3f> & colors);
+
+		/** Select the cameras to draw, the next renders only process these.
+		 *\param eye the current viewpoint
+		 *\param scale the distance from the camera centers to the image planes
+		 *\param active which cameras can be displayed
+		 */
+		void cullCameraInstances(const Camera & eye, float scale, const std::vector<bool> & active);
+
+		/** Render the visible frusta as lines.
+		 *\param eye the current viewpoint
+		 *\param scale the distance from the camera centers to the image planes
+		 */
+		void renderFrusta(const Camera & eye, float scale);
+
+		/** Render the visible image planes.
+		 *\param eye the current viewpoint
+		 *\param scale the distance from the camera centers to the image planes
+		 *\param alpha the image opacity
+		 *\param tex2Darray_handle input images texture array, 0 to use the thumbnails
+		 */
+		void renderImagePlanes(const Camera & eye, float scale, float alpha, uint tex2Darray_handle = 0);
+
+		/** \return true if thumbnails have been built */
+		bool hasCameraThumbnails() const { return _thumbnails != 0; }
+
+		/// Camera data, as read by the shaders.
+		struct CameraInstance {
+			float position[4]; ///< Camera center.
+			float corners[4][4]; ///< Directions to the image corners, at unit distance.
+			float color[4]; ///< Display color.
+		};
+
+		GLShader							_frustaShader; ///< Shader for the frusta lines.
+		GLShader							_planesShader; ///< Shader for the image planes.
+		GLuniform<sibr::Matrix4f>			_frustaMVP, _planesMVP; ///< MVP matrix.
+		GLuniform<float>					_frustaScale = 1.0f, _planesScale = 1.0f; ///< Image planes distance.
+		GLuniform<float>					_planesAlpha = 1.0f; ///< Opacity.
+
+		std::vector<CameraInstance>			_instances; ///< CPU copy of the camera data.
+		std::vector<Vector3f>				_instanceCenters; ///< Bounding sphere centers offsets, at unit scale.
+		std::vector<float>					_instanceRadii; ///< Bounding sphere radii, at unit scale.
+		std::vector<uint>					_visibleInstances; ///< Cameras selected by the last culling.
+		GLuint								_instanceBuffer = 0; ///< Camera data buffer.
+		StreamingBuffer::Allocation			_visibleRange; ///< Visible cameras of the current frame, in the streaming buffer.
+		GLuint								_emptyVAO = 0; ///< Vertices are generated in the shaders.
+		GLuint								_thumbnails = 0; ///< Thumbnails texture array.
+	};
+
 	/** Scene viewer for IBR scenes with a proxy, cameras and input images. 
 	 * It adds camera visualization options (labels, frusta, image planes) on top of the MeshManager.
 	  \ingroup sibr_view
 	 */
-	class SIBR_VIEW_EXPORT SceneDebugView : public MultiMeshManager, public ImageCamViewer, public LabelsManager
+	class SIBR_VIEW_EXPORT SceneDebugView : public MultiMeshManager, public ImageCamViewer, public LabelsManager, public CameraInstancesViewer
 	{
 		SIBR_CLASS_PTR(SceneDebugView);
 
@@ -254,6 +334,7 @@ namespace sibr
 		int								_snapToImage = 0; ///< ID of the camera to snap to.
 		int								_cameraIdInfoGUI = 0; ///< ID of the camera to display info about.
 		bool							_showImages = true; ///< Show the image planes.
+		bool							_showFrusta = true; ///< Show the camera frusta.
 		bool							_showLabels = false; ///< Show camera labels.
 
 	};
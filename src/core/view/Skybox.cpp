@@ -13,10 +13,14 @@
 
 # include "core/assets/Resources.hpp"
 # include "core/view/Skybox.hpp"
+# include "core/system/ThreadPool.hpp"
 
 namespace sibr
 {
-	bool	Skybox::load(const std::string& skyFolder)
+	// Smallest size of the placeholder faces, decoded at 1/2, 1/4 or 1/8 of the full resolution.
+	static const uint kPreviewSize = 64;
+
+	bool	Skybox::load(const std::string& skyFolder, bool async, uint compression)
 	{
 		if (!sibr::directoryExists(skyFolder))
 			return false;
@@ -36,29 +40,96 @@ namespace sibr
 			"back.jpg"		
 		};
 
-		std::array<ImageRGB, filenames.size()>	images;
-
+		std::array<std::string, 6> files;
 		for (uint i = 0; i < filenames.size(); ++i)
 		{
-			std::string file = (skyFolder + "/") + filenames[i];
-			if (images[i].load(file) == false)
+			files[i] = (skyFolder + "/") + filenames[i];
+			if (!sibr::fileExists(files[i]))
+			{
+				SIBR_ERR << "cannot open " << files[i] << " (loading the skybox)" << std::endl;
+			}
+		}
+
+		_compression = compression;
+		_cubemap = nullptr;
+		if (!async)
+		{
+			const std::shared_ptr<Faces> faces = loadFaces(files, 0);
+			if (!faces)
 			{
-				SIBR_ERR << "cannot open " << file << " (loading the skybox)" << std::endl;
+				SIBR_ERR << "cannot read the faces of " << skyFolder << " (loading the skybox)" << std::endl;
 			}
+			const Faces & f = *faces;
+			_cubemap.reset(new TextureCubeMapRGB(f[0], f[1], f[2], f[3], f[4], f[5], SIBR_GPU_LINEAR_SAMPLING | SIBR_GPU_AUTOGEN_MIPMAP, _compression));
+			return true;
 		}
-		_cubemap.reset(new TextureCubeMapRGB(images[0], images[1], images[2], images[3], images[4], images[5]));
 
+		// The placeholder is decoded alongside, JPEG decoding at a reduced scale is much faster.
+		_preview = std::async(std::launch::async, [files]() { return loadFaces(files, kPreviewSize); });
+		_faces = std::async(std::launch::async, [files]() { return loadFaces(files, 0); });
 		return true;
 	}
 
+	bool	Skybox::ready(void) const
+	{
+		return _cubemap != nullptr && !_faces.valid();
+	}
+
+	std::shared_ptr<Skybox::Faces>	Skybox::loadFaces(const std::array<std::string, 6> & files, uint minSize)
+	{
+		const std::shared_ptr<Faces> faces = std::make_shared<Faces>();
+		std::array<bool, 6> loaded;
+		sibr::ThreadPool::shared().parallelFor(0, 6, [&](int i)
+		{
+			loaded[i] = minSize > 0
+				? (*faces)[i].loadReduced(files[i], minSize, minSize, false)
+				: (*faces)[i].load(files[i], false);
+		});
+		for (uint i = 0; i < files.size(); ++i)
+		{
+			if (!loaded[i])
+			{
+				SIBR_WRG << "cannot read " << files[i] << " (loading the skybox)" << std::endl;
+				return nullptr;
+			}
+		}
+		return faces;
+	}
+
+	void	Skybox::update(void)
+	{
+		if (_faces.valid() && _faces.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			const std::shared_ptr<Faces> faces = _faces.get();
+			if (faces)
+			{
+				const Faces & f = *faces;
+				_cubemap.reset(new TextureCubeMapRGB(f[0], f[1], f[2], f[3], f[4], f[5], SIBR_GPU_LINEAR_SAMPLING | SIBR_GPU_AUTOGEN_MIPMAP, _compression));
+			}
+			// The placeholder is not needed anymore.
+			if (_preview.valid())
+				_preview.get();
+		}
+		else if (_preview.valid() && _preview.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			const std::shared_ptr<Faces> faces = _preview.get();
+			if (faces)
+			{
+				const Faces & f = *faces;
+				_cubemap.reset(new TextureCubeMapRGB(f[0], f[1], f[2], f[3], f[4], f[5], SIBR_GPU_LINEAR_SAMPLING));
+			}
+		}
+	}
+
 
 	void	Skybox::render(const Camera& eye, const sibr::Vector2u& imgSize)
 	{
+		update();
 		if (_cubemap == nullptr)
 			return;
 
 
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 
 		CHECK_GL_ERROR;
 		_shader.begin();
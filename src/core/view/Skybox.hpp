@@ -16,10 +16,14 @@
 # include "core/graphics/Shader.hpp"
 # include "core/graphics/Texture.hpp"
 # include "core/graphics/Camera.hpp"
+# include <array>
+# include <future>
 
 namespace sibr
 {
 	/** A skybox object for rendering a cubemap texture.
+	* The faces can be decoded in the background: a placeholder decoded at a reduced resolution is
+	* rendered first, then the full resolution cubemap, compressed and with mipmaps.
 	* \ingroup sibr_view
 	*/
 	class SIBR_VIEW_EXPORT Skybox
@@ -30,9 +34,14 @@ namespace sibr
 
 		/** Load skybox faces from a directory. The files should be named: {right, left, top, bottom, forward, back}.jpg
 		\param skyFolder directory path
+		\param async decode the faces in the background, nothing is rendered before the placeholder is ready
+		\param compression the GL_COMPRESSED format of the full resolution cubemap, 0 for none
 		\return a success boolean 
 		*/
-		bool	load(const std::string& skyFolder);
+		bool	load(const std::string& skyFolder, bool async = true, uint compression = GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+
+		/** \return true when the full resolution cubemap is displayed. */
+		bool	ready(void) const;
 
 		/** Render in the current RT.
 		\param eye current viewpoint
@@ -42,11 +51,27 @@ namespace sibr
 
 	private:
 
+		/// Decoded faces, in the cubemap order.
+		typedef std::array<ImageRGB, 6> Faces;
+
+		/** Decode the faces.
+		\param files the face files
+		\param minSize decode at a reduced resolution of at least this size, 0 for the full resolution
+		\return the faces, nullptr if one of them can't be read
+		*/
+		static std::shared_ptr<Faces>	loadFaces(const std::array<std::string, 6> & files, uint minSize);
+
+		/** Install the faces decoded in the background, called before rendering. */
+		void	update(void);
+
 		GLShader		_shader; ///< Skybox shader.
 		GLParameter		_paramView; ///< VP parameter.
 		GLParameter		_paramAspect; ///< Aspect ratio parameter.
 
 		TextureCubeMapRGB::Ptr	_cubemap = nullptr; ///< Cubemap texture.
+		uint			_compression = 0; ///< Compressed format of the full resolution cubemap.
+		std::future<std::shared_ptr<Faces>>	_preview; ///< Faces of the placeholder, being decoded.
+		std::future<std::shared_ptr<Faces>>	_faces; ///< Full resolution faces, being decoded.
 
 	};
 
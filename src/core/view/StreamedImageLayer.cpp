@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "StreamedImageLayer.hpp"
+#include "core/graphics/Image.hpp"
+#include "core/system/Hash.hpp"
+#include "core/system/String.hpp"
+
+#include <iterator>
+#include <sstream>
+
+namespace sibr
+{
+	namespace {
+
+		/// Images uploaded per frame at most, to keep frame times steady while scrolling.
+		const size_t kUploadsPerFrame = 32;
+
+		/// Width of the indirection texture.
+		const int kIndirectionWidth = 4096;
+
+	}
+
+	StreamedImageLayer::StreamedImageLayer(const std::vector<std::string> & paths)
+		: StreamedImageLayer(paths, Options())
+	{
+	}
+
+	StreamedImageLayer::StreamedImageLayer(const std::vector<std::string> & paths, const Options & options)
+		: _paths(paths), _options(options)
+	{
+		// As with texture arrays, all images are displayed at the same resolution, given by the first one.
+		_size = Vector2u(1, 1);
+		for (const std::string & path : _paths) {
+			// The header gives the size without decoding. JPEG orientation tags can swap it, an 1/8 decode tells.
+			const sibr::Vector2i res = IImage::imageResolution(path);
+			if (res.x() > 0 && res.y() > 0) {
+				const std::string extension = sibr::to_lower(sibr::getExtension(path));
+				if (extension != "jpg" && extension != "jpeg") {
+					_size = Vector2u(res.x(), res.y());
+					break;
+				}
+				const cv::Mat small = cv::imread(path, cv::IMREAD_REDUCED_COLOR_8);
+				const int w8 = (res.x() + 7) / 8, h8 = (res.y() + 7) / 8;
+				if (!small.empty() && w8 != h8) {
+					_size = small.cols == w8 ? Vector2u(res.x(), res.y()) : Vector2u(res.y(), res.x());
+					break;
+				}
+			}
+			const cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+			if (!img.empty()) {
+				_size = Vector2u(img.cols, img.rows);
+				break;
+			}
+		}
+		if (!_paths.empty() && _size == Vector2u(1, 1)) {
+			SIBR_WRG << "[StreamedImageLayer] No readable image in the layer." << std::endl;
+		}
+
+		if (_options.cacheDirectory.empty() && !_paths.empty()) {
+			_options.cacheDirectory = (boost::filesystem::absolute(_paths[0]).parent_path() / "sibr_thumbnails").string();
+		}
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(_options.cacheDirectory, ec);
+		if (ec) {
+			SIBR_WRG << "[StreamedImageLayer] Unable to create the cache directory " << _options.cacheDirectory << ", resized images won't be cached." << std::endl;
+		}
+
+		createCache(_caches[THUMBNAIL], _options.thumbnailSize, _options.thumbnailSlots);
+		createCache(_caches[DETAIL], _options.detailSize, _options.detailSlots);
+		_detailIsFull = _caches[DETAIL].size == _size;
+
+		const int n = count();
+		_indirectionWidth = std::max(1, std::min(n, kIndirectionWidth));
+		const int rows = std::max(1, (n + _indirectionWidth - 1) / _indirectionWidth);
+		_indirectionData.assign(size_t(TIER_COUNT) * _indirectionWidth * rows, -1);
+		glGenTextures(1, &_indirection);
+		glBindTexture(GL_TEXTURE_2D, _indirection);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32I, _indirectionWidth, rows);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		CHECK_GL_ERROR;
+
+		for (int tier = 0; tier < TIER_COUNT; ++tier) {
+			_queued[tier].assign(n, 0);
+		}
+
+		uint threads = _options.threads;
+		if (threads == 0) {
+			// Decoding is mostly I/O bound, a few threads are enough.
+			threads = std::min(std::max(std::thread::hardware_concurrency(), 1u), 4u);
+		}
+		for (uint t = 0; t < threads; ++t) {
+			_workers.emplace_back(&StreamedImageLayer::workerLoop, this);
+		}
+	}
+
+	StreamedImageLayer::~StreamedImageLayer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_jobReady.notify_all();
+		for (std::thread & worker : _workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		_uploader.finish();
+		for (Cache & cache : _caches) {
+			glDeleteTextures(1, &cache.texture);
+		}
+		glDeleteTextures(1, &_indirection);
+	}
+
+	void StreamedImageLayer::update(int first, int last, float cellPixels)
+	{
+		++_frame;
+		const int n = count();
+		if (n == 0) {
+			return;
+		}
+		first = sibr::clamp(first, 0, n - 1);
+		last = sibr::clamp(last, first, n - 1);
+
+		// Visible images are not evicted to make room for the new ones.
+		for (Cache & cache : _caches) {
+			for (int im = first; im <= last; ++im) {
+				const int slot = cache.imageSlot[im];
+				if (slot >= 0) {
+					cache.slotUsed[slot] = _frame;
+				}
+			}
+		}
+
+		std::vector<Result> results;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const size_t take = std::min(_results.size(), kUploadsPerFrame);
+			results.assign(std::make_move_iterator(_results.begin()), std::make_move_iterator(_results.begin() + take));
+			_results.erase(_results.begin(), _results.begin() + take);
+		}
+		for (Result & result : results) {
+			_queued[result.tier][result.image] = 0;
+			if (!result.levels.empty()) {
+				store(result);
+			}
+		}
+
+		// Detailed images are only worth it once a cell is larger than the thumbnails.
+		const int visibleCount = last - first + 1;
+		const bool wantDetails = cellPixels > 1.5f * float(_caches[THUMBNAIL].size.x()) && visibleCount <= int(_caches[DETAIL].slotImage.size());
+
+		{
+			// Requests of the previous frames are replaced, so that scrolling away cancels them.
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const Job & job : _jobs) {
+				_queued[job.tier][job.image] = 0;
+			}
+			_jobs.clear();
+
+			for (int tier = 0; tier < TIER_COUNT; ++tier) {
+				if (tier == DETAIL && !wantDetails) {
+					continue;
+				}
+				const Cache & cache = _caches[tier];
+				// Don't request more images than can be resident at once.
+				const int maxCount = std::min(visibleCount, int(cache.slotImage.size()));
+				for (int im = first; im < first + maxCount; ++im) {
+					if (cache.imageSlot[im] < 0 && !_queued[tier][im]) {
+						_jobs.push_back({ im, tier });
+						_queued[tier][im] = 1;
+					}
+				}
+			}
+		}
+		_jobReady.notify_all();
+
+		if (_indirectionDirty) {
+			const int rows = int(_indirectionData.size()) / (TIER_COUNT * _indirectionWidth);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glBindTexture(GL_TEXTURE_2D, _indirection);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _indirectionWidth, rows, GL_RG_INTEGER, GL_INT, _indirectionData.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+			_indirectionDirty = false;
+			CHECK_GL_ERROR;
+		}
+	}
+
+	void StreamedImageLayer::bind(uint thumbnailsUnit) const
+	{
+		glActiveTexture(GL_TEXTURE0 + thumbnailsUnit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _caches[THUMBNAIL].texture);
+		glActiveTexture(GL_TEXTURE0 + thumbnailsUnit + 1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, _caches[DETAIL].texture);
+		glActiveTexture(GL_TEXTURE0 + thumbnailsUnit + 2);
+		glBindTexture(GL_TEXTURE_2D, _indirection);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	bool StreamedImageLayer::pixel(int im, const Vector2i & pos, int lod, Vector4f & value) const
+	{
+		if (im < 0 || im >= count()) {
+			return false;
+		}
+		// Prefer the detailed image, closer to the full resolution.
+		for (int tier = DETAIL; tier >= THUMBNAIL; --tier) {
+			const Cache & cache = _caches[tier];
+			const int slot = cache.imageSlot[im];
+			if (slot < 0) {
+				continue;
+			}
+			const cv::Mat & pixels = cache.slotPixels[slot];
+			const float scale = float(1 << lod);
+			const int x = sibr::clamp(int((float(pos.x()) + 0.5f) * scale * float(pixels.cols) / float(_size.x())), 0, pixels.cols - 1);
+			const int y = sibr::clamp(int((float(pos.y()) + 0.5f) * scale * float(pixels.rows) / float(_size.y())), 0, pixels.rows - 1);
+			const cv::Vec3b bgr = pixels.at<cv::Vec3b>(y, x);
+			value = Vector4f(bgr[2], bgr[1], bgr[0], 255.0f) / 255.0f;
+			return true;
+		}
+		return false;
+	}
+
+	void StreamedImageLayer::createCache(Cache & cache, uint maxSide, uint slots)
+	{
+		const uint largest = std::max(_size.x(), _size.y());
+		if (maxSide == 0 || maxSide >= largest) {
+			cache.size = _size;
+		}
+		else {
+			const float scale = float(maxSide) / float(largest);
+			cache.size = Vector2u(
+				std::max(1u, uint(std::round(scale * float(_size.x())))),
+				std::max(1u, uint(std::round(scale * float(_size.y())))));
+		}
+		cache.levels = 1 + int(std::floor(std::log2(float(std::max(cache.size.x(), cache.size.y())))));
+		slots = std::max(slots, 1u);
+
+		glGenTextures(1, &cache.texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, cache.texture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, cache.levels, GL_RGB8, cache.size.x(), cache.size.y(), slots);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		CHECK_GL_ERROR;
+
+		cache.slotImage.assign(slots, -1);
+		cache.slotUsed.assign(slots, 0);
+		cache.slotPixels.assign(slots, cv::Mat());
+		cache.imageSlot.assign(_paths.size(), -1);
+	}
+
+	std::vector<cv::Mat> StreamedImageLayer::load(const Job & job) const
+	{
+		const Cache & cache = _caches[job.tier];
+		const cv::Size size(int(cache.size.x()), int(cache.size.y()));
+		const bool useDiskCache = !(job.tier == DETAIL && _detailIsFull);
+
+		cv::Mat img;
+		std::string cached;
+		if (useDiskCache) {
+			cached = cacheFile(job.image, cache.size);
+			img = cv::imread(cached, cv::IMREAD_COLOR);
+			if (!img.empty() && img.size() != size) {
+				img.release();
+			}
+		}
+		if (img.empty()) {
+			// Thumbnails of JPEG files are decoded straight to a fraction of their size.
+			const cv::Mat full = opencv::imreadReduced(_paths[job.image], uint(size.width), uint(size.height), cv::IMREAD_COLOR);
+			if (full.empty()) {
+				SIBR_WRG << "[StreamedImageLayer] Unable to load " << _paths[job.image] << "." << std::endl;
+				return {};
+			}
+			if (full.size() != size) {
+				cv::resize(full, img, size, 0, 0, cv::INTER_AREA);
+			}
+			else {
+				img = full;
+			}
+			if (useDiskCache) {
+				// Best effort, the image is resized again next time if this fails.
+				cv::imwrite(cached, img, { cv::IMWRITE_JPEG_QUALITY, 90 });
+			}
+		}
+
+		std::vector<cv::Mat> levels(cache.levels);
+		levels[0] = img;
+		for (int l = 1; l < cache.levels; ++l) {
+			const cv::Size levelSize(std::max(1, size.width >> l), std::max(1, size.height >> l));
+			cv::resize(levels[l - 1], levels[l], levelSize, 0, 0, cv::INTER_AREA);
+		}
+		return levels;
+	}
+
+	std::string StreamedImageLayer::cacheFile(int image, const Vector2u & size) const
+	{
+		// The file fingerprint is part of the key, so that edited images are resized again.
+		const Path path = boost::filesystem::absolute(_paths[image]);
+		Hash128 fingerprint;
+		fileFingerprint(path.string(), fingerprint);
+		Hasher hasher;
+		hasher.update(path.string());
+		hasher.updateValue(fingerprint);
+
+		std::stringstream name;
+		name << hasher.digest128().toString() << "_" << size.x() << "x" << size.y() << ".jpg";
+		return (Path(_options.cacheDirectory) / name.str()).string();
+	}
+
+	bool StreamedImageLayer::store(Result & result)
+	{
+		Cache & cache = _caches[result.tier];
+		if (cache.imageSlot[result.image] >= 0) {
+			return true;
+		}
+
+		// A free slot, else the least recently visible one, never one visible this frame.
+		int slot = -1;
+		uint64_t oldest = _frame;
+		for (int s = 0; s < int(cache.slotImage.size()); ++s) {
+			if (cache.slotImage[s] < 0) {
+				slot = s;
+				break;
+			}
+			if (cache.slotUsed[s] < oldest) {
+				oldest = cache.slotUsed[s];
+				slot = s;
+			}
+		}
+		if (slot < 0) {
+			return false;
+		}
+
+		const int evicted = cache.slotImage[slot];
+		if (evicted >= 0) {
+			cache.imageSlot[evicted] = -1;
+			_indirectionData[TIER_COUNT * evicted + result.tier] = -1;
+		}
+
+		for (int l = 0; l < int(result.levels.size()); ++l) {
+			const cv::Mat & level = result.levels[l];
+			_uploader.upload(cache.texture, l, slot, uint(level.cols), uint(level.rows), GL_BGR, GL_UNSIGNED_BYTE, level.data, level.total() * level.elemSize());
+		}
+
+		cache.slotImage[slot] = result.image;
+		cache.slotUsed[slot] = _frame;
+		cache.slotPixels[slot] = result.levels[0];
+		cache.imageSlot[result.image] = slot;
+		_indirectionData[TIER_COUNT * result.image + result.tier] = slot;
+		_indirectionDirty = true;
+		return true;
+	}
+
+	void StreamedImageLayer::workerLoop()
+	{
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_jobReady.wait(lock, [this] { return _stop || !_jobs.empty(); });
+				if (_stop) {
+					return;
+				}
+				job = _jobs.front();
+				_jobs.pop_front();
+			}
+
+			Result result;
+			result.image = job.image;
+			result.tier = job.tier;
+			result.levels = load(job);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_results.push_back(std::move(result));
+		}
+	}
+
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#pragma once
+
+#include "Config.hpp"
+#include <core/graphics/TextureUploader.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace sibr
+{
+
+	/**
+	 * Images of a grid layer loaded on demand, for datasets too large to fit in a single texture array.
+	 * Only the visible images are resident on the GPU, in two texture arrays used as caches of fixed
+	 * size: thumbnails, and a few detailed versions streamed when zooming in. Images are decoded and
+	 * resized on worker threads, and the resized versions are stored in an on-disk cache so that
+	 * browsing the same dataset again only reads small files. Uploads go through a TextureUploader.
+	 * An indirection texture gives, for each image, its slot in each array (-1 if not resident).
+	 * \note The level 0 of resident images is kept on the CPU, for pixel lookups without GPU readback.
+	 * \ingroup sibr_view
+	 */
+	class SIBR_VIEW_EXPORT StreamedImageLayer
+	{
+		SIBR_CLASS_PTR(StreamedImageLayer);
+		SIBR_DISALLOW_COPY(StreamedImageLayer);
+
+	public:
+
+		/** Streaming options. */
+		struct Options {
+			std::string cacheDirectory = ""; ///< Where resized images are cached, defaults to a "thumbnails" directory next to the first image.
+			uint thumbnailSize = 128; ///< Largest side of the thumbnails.
+			uint detailSize = 1024; ///< Largest side of the detailed images, 0 for full resolution.
+			uint thumbnailSlots = 1024; ///< Number of thumbnails resident on the GPU.
+			uint detailSlots = 16; ///< Number of detailed images resident on the GPU.
+			uint threads = 0; ///< Decoding threads, 0 to use the hardware concurrency.
+		};
+
+		/** Constructor, reads the first image to know the layer resolution.
+		\param paths the image files
+		\param options streaming options
+		\note Requires the OpenGL context.
+		*/
+		StreamedImageLayer(const std::vector<std::string> & paths, const Options & options);
+
+		/** Constructor with default options.
+		\param paths the image files
+		\note Requires the OpenGL context.
+		*/
+		StreamedImageLayer(const std::vector<std::string> & paths);
+
+		/// Destructor.
+		~StreamedImageLayer();
+
+		/** Request the images displayed this frame and upload the ones that are ready.
+		\param first first visible image
+		\param last last visible image (included)
+		\param cellPixels on screen width of a grid cell, used to decide if detailed images are needed
+		\note Requires the OpenGL context.
+		*/
+		void update(int first, int last, float cellPixels);
+
+		/** Bind the thumbnails, the detailed images and the indirection texture.
+		\param thumbnailsUnit the texture unit of the thumbnails array, the details and indirection use the two next ones
+		*/
+		void bind(uint thumbnailsUnit = 0) const;
+
+		/** Get the value of a pixel from the CPU copy of the best resident level.
+		\param im the image index
+		\param pos the pixel position in the full resolution image, divided by 2^lod
+		\param lod the level the position is expressed at
+		\param value will contain the RGBA value, in [0,1]
+		\return false if the image is not resident
+		*/
+		bool pixel(int im, const Vector2i & pos, int lod, Vector4f & value) const;
+
+		/** \return the number of images */
+		int count() const { return int(_paths.size()); }
+
+		/** \return the resolution of the images */
+		const Vector2u & imageSize() const { return _size; }
+
+		/** \return the width of the indirection texture, image i is at (i % width, i / width). */
+		int indirectionWidth() const { return _indirectionWidth; }
+
+	private:
+
+		/// The two GPU caches.
+		enum Tier { THUMBNAIL = 0, DETAIL = 1, TIER_COUNT = 2 };
+
+		/// An image to load for a tier.
+		struct Job {
+			int image; ///< Image index.
+			int tier; ///< Destination tier.
+		};
+
+		/// A loaded image and its mip levels, waiting to be uploaded.
+		struct Result {
+			int image; ///< Image index.
+			int tier; ///< Destination tier.
+			std::vector<cv::Mat> levels; ///< Mip chain, empty if loading failed.
+		};
+
+		/// A GPU cache of images of the same size.
+		struct Cache {
+			GLuint texture = 0; ///< Texture array handle.
+			Vector2u size; ///< Size of a slot.
+			int levels = 1; ///< Number of mip levels.
+			std::vector<int> slotImage; ///< Image in each slot, -1 if free.
+			std::vector<uint64_t> slotUsed; ///< Last frame each slot was visible.
+			std::vector<cv::Mat> slotPixels; ///< CPU copy of the level 0 of each slot.
+			std::vector<int> imageSlot; ///< Slot of each image, -1 if not resident.
+		};
+
+		/** Create a GPU cache.
+		\param cache the cache to setup
+		\param maxSide the largest side of the slots, 0 for full resolution
+		\param slots the number of slots
+		*/
+		void createCache(Cache & cache, uint maxSide, uint slots);
+
+		/** Load an image at a tier resolution, from the disk cache if possible, and build its mips.
+		\param job the image and tier to load
+		\return the loaded levels
+		*/
+		std::vector<cv::Mat> load(const Job & job) const;
+
+		/** \return path of the on-disk cache file of an image at a given resolution
+		\param image the image index
+		\param size the resolution
+		*/
+		std::string cacheFile(int image, const Vector2u & size) const;
+
+		/** Upload a loaded image to a free or least recently visible slot.
+		\param result the loaded image
+		\return false if no slot could be freed
+		*/
+		bool store(Result & result);
+
+		/// Pop and load images until stopped.
+		void workerLoop();
+
+		std::vector<std::string> _paths; ///< Image files.
+		Options _options; ///< Streaming options.
+		Vector2u _size; ///< Full resolution.
+		Cache _caches[TIER_COUNT]; ///< Thumbnails and detailed images.
+		bool _detailIsFull = false; ///< The detailed images are at full resolution, so they are not cached on disk.
+
+		GLuint _indirection = 0; ///< RG32I texture of the slot of each image in each cache.
+		int _indirectionWidth = 1; ///< Width of the indirection texture.
+		std::vector<int> _indirectionData; ///< CPU copy of the indirection.
+		bool _indirectionDirty = true; ///< The indirection texture has to be updated.
+
+		TextureUploader _uploader; ///< Staged uploads.
+		uint64_t _frame = 0; ///< Frame counter, for the LRU.
+
+		std::vector<std::thread> _workers; ///< Decoding threads.
+		std::deque<Job> _jobs; ///< Images to load, most urgent first.
+		std::vector<char> _queued[TIER_COUNT]; ///< Images queued or being loaded, per tier.
+		std::vector<Result> _results; ///< Loaded images to upload.
+		bool _stop = false; ///< Ask the workers to exit.
+		mutable std::mutex _mutex; ///< Protects the jobs and results.
+		std::condition_variable _jobReady; ///< Signaled when jobs are added or on stop.
+	};
+
+}
@@ -15,6 +15,7 @@
 #include "core/graphics/Input.hpp"
 #include "core/graphics/Viewport.hpp"
 #include "core/raycaster/CameraRaycaster.hpp" 
+#include "core/view/AsyncPicker.hpp"
 #include "core/graphics/Window.hpp"
 #include "core/graphics/Mesh.hpp"
 
@@ -206,6 +207,8 @@ namespace sibr {
 
 		updateTrackBallStatus(input, viewport);
 
+		resolvePicks();
+
 		updateTrackBallCamera(input, viewport, raycaster);
 
 		updateFromKeyboard(input);
@@ -310,18 +313,53 @@ namespace sibr {
 			dir = CameraRaycaster::computeRayDir(fixedCamera, input.mousePosition().cast<float>()).normalized();
 			worldPos = fixedCamera.position();
 		}
-		RayHit hit = raycaster->intersect(Ray(worldPos, dir));
+		// The center is updated once the intersection is done, in resolvePicks.
+		centerPick = requestPick(raycaster, Ray(worldPos, dir));
+		centerPickOrigin = worldPos;
+	}
 
-		if (hit.hitSomething()) {
-			printMessage(" TrackBall::updateBallCenter : updating center from mesh ");
-			Vector3f intersection(worldPos + hit.dist()*dir.normalized());
-			fixedCenter = tempCenter = intersection;
-			fixedCamera.setLookAt(worldPos, fixedCenter, fixedCamera.up());
+	uint64_t TrackBall::requestPick(std::shared_ptr<Raycaster> raycaster, const Ray & ray)
+	{
+		if (!picker) {
+			picker = std::make_shared<AsyncPicker>(raycaster);
 		}
-		else {
-			printMessage(" TrackBall::updateBallCenter : could not intersect mesh ");
+		else if (picker->raycaster() != raycaster) {
+			picker->setRaycaster(raycaster);
 		}
+		return picker->pickRay(ray);
+	}
 
+	void TrackBall::resolvePicks()
+	{
+		if (!picker) {
+			return;
+		}
+		AsyncPicker::Result result;
+		if (centerPick != 0 && picker->result(centerPick, result)) {
+			centerPick = 0;
+			if (!result.hit) {
+				printMessage(" TrackBall::updateBallCenter : could not intersect mesh ");
+			}
+			else if (state == TrackBallState::IDLE) {
+				printMessage(" TrackBall::updateBallCenter : updating center from mesh ");
+				fixedCenter = tempCenter = result.position;
+				fixedCamera.setLookAt(centerPickOrigin, fixedCenter, fixedCamera.up());
+			}
+		}
+		if (planePick != 0 && picker->result(planePick, result)) {
+			planePick = 0;
+			// Only if the translation is still going on, the plane is reset on the next one.
+			if (result.hit && state == TrackBallState::TRANSLATION_PLANE) {
+				trackballPlane = Eigen::Hyperplane<float, 3>(trackballPlane.normal(), result.position);
+			}
+		}
+		// Superseded requests never complete.
+		if (centerPick != 0 && !picker->isPending(centerPick)) {
+			centerPick = 0;
+		}
+		if (planePick != 0 && !picker->isPending(planePick)) {
+			planePick = 0;
+		}
 	}
 
 	void TrackBall::updateRotationSphere(const Input & input, const Viewport & viewport)
@@ -383,14 +421,11 @@ namespace sibr {
 				worldPos = fixedCamera.position();
 			}
 
-			Vector3f pointOnPlane = fixedCenter;
+			// Start with the plane through the center, moved to the surface under the cursor once the pick is done.
+			trackballPlane = Eigen::Hyperplane<float, 3>(fixedCamera.dir().normalized(), fixedCenter);
 			if (raycaster.get() != nullptr) {
-				RayHit hit = raycaster->intersect(Ray(worldPos, dir));
-				if (hit.hitSomething()) {
-					pointOnPlane = worldPos + hit.dist()*dir;
-				}
+				planePick = requestPick(raycaster, Ray(worldPos, dir));
 			}
-			trackballPlane = Eigen::Hyperplane<float, 3>(fixedCamera.dir().normalized(), pointOnPlane);
 		}
 
 		Vector3f clicked3DPosition(mapTo3Dplane(lastPoint2D));
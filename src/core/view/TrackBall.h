@@ -26,6 +26,8 @@ namespace sibr {
 	class Mesh;
 	class Input;
 	class Raycaster;
+	class Ray;
+	class AsyncPicker;
 
 	
 	/** Provide a handler to interact using a trackball (based on mouse motions).
@@ -128,6 +130,16 @@ namespace sibr {
 		*/
 		void updateZnearZFar( const Input & input );
 
+		/** Request the intersection of a ray with the scene, resolved in a later update by resolvePicks.
+		\param raycaster the scene raycaster
+		\param ray the ray to cast
+		\return the pick ticket
+		*/
+		uint64_t requestPick(std::shared_ptr<Raycaster> raycaster, const Ray & ray);
+
+		/** Apply the results of the picks that completed since the last update. */
+		void resolvePicks();
+
 		/** update the trackball pivot center.
 		\param input user input
 		\param raycaster the scene raycaster
@@ -234,6 +246,11 @@ namespace sibr {
 
 		Eigen::Hyperplane<float,3>	trackballPlane; ///< Trackball translation plane.
 
+		std::shared_ptr<AsyncPicker> picker; ///< Background intersections, so that interaction never waits for the raycaster.
+		uint64_t					centerPick = 0; ///< Pending pick of the pivot center, 0 if none.
+		uint64_t					planePick = 0; ///< Pending pick of the translation plane, 0 if none.
+		Vector3f					centerPickOrigin; ///< Origin of the pivot center pick ray.
+
 		TrackBallState				state; ///< Current status.
 
 		bool						hasBeenInitialized; ///< Initialized or not.
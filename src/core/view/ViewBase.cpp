@@ -25,6 +25,17 @@ namespace sibr
 		onUpdate(input);
 	}
 
+	void	ViewBase::onRenderIBRStereo(IRenderTarget& left, IRenderTarget& right, const Camera& leftEye, const Camera& rightEye)
+	{
+		left.bind();
+		onRenderIBR(left, leftEye);
+		left.unbind();
+
+		right.bind();
+		onRenderIBR(right, rightEye);
+		right.unbind();
+	}
+
 	void				ViewBase::setResolution(const Vector2i& size)
 	{
 		_resolution = size;
@@ -61,9 +61,26 @@ namespace sibr
 		 */
 		virtual void	onRenderIBR(IRenderTarget& dst, const Camera& eye) {};
 
+		/** Render a stereo pair of viewpoints. By default, each eye is rendered with onRenderIBR;
+		 * views can override it to share work between the eyes.
+		 *\param left left eye destination RT, already cleared
+		 *\param right right eye destination RT, already cleared
+		 *\param leftEye left eye viewpoint
+		 *\param rightEye right eye viewpoint
+		 *\sa StereoAnaglyphRdrMode
+		 */
+		virtual void	onRenderIBRStereo(IRenderTarget& left, IRenderTarget& right, const Camera& leftEye, const Camera& rightEye);
+
 		/** Display GUI. */
 		virtual void	onGUI() { }
 
+		/** Adjust the rendering cost of the view, called each frame by the adaptive quality controller.
+		 *\param level the quality level in [0,1], 1 is the full quality
+		 *\return false if the view has no quality setting
+		 *\sa QualityController
+		 */
+		virtual bool	setQualityLevel(float level) { return false; }
+
 		/** Render content in the currently bound RT, using a specific viewport.
 		 * \param vpRender destination viewport
 		 * \note Used when the view is in a multi-view system.
@@ -332,9 +332,7 @@ void sibr::MeshViewer::setMainMesh(sibr::Window & win, const sibr::Mesh & mesh,
 	}
 
 	if (setupRaycaster) {
-		raycaster = std::make_shared<sibr::Raycaster>();
-		raycaster->init();
-		raycaster->addMesh(*meshGL);
+		raycaster = sibr::Raycaster::shared(*meshGL);
 	}
 
 	float radius;
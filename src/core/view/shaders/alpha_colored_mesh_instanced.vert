@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+layout(location = 0) in vec3 in_vertex;
+layout(location = 1) in vec3 in_color;
+layout(location = 3) in vec3 in_normal;
+
+// Per-instance model transformation and color.
+struct Instance {
+	mat4 model;
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Instances {
+	Instance instances[];
+};
+
+uniform mat4 mvp;
+uniform bool use_instance_color;
+uniform int radius;
+
+out vec3 color;
+out vec3 normal;
+out vec3 position;
+
+void main(void) {
+	const Instance instance = instances[gl_InstanceID];
+	const vec4 world = instance.model * vec4(in_vertex, 1.0);
+	gl_Position = mvp * world;
+	gl_PointSize = radius;
+	color = use_instance_color ? instance.color.rgb : in_color;
+	normal = mat3(instance.model) * in_normal;
+	position = world.xyz;
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+layout(location = 0) out vec4 out_color;
+
+in vec3 color_vert;
+
+void main() {
+	out_color = vec4(color_vert, 1.0);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+// One instance per visible camera, the vertices are generated from the camera corners.
+struct CameraInstance {
+	vec4 position; // Camera center.
+	vec4 corners[4]; // Directions to the image corners, at unit distance.
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Cameras {
+	CameraInstance cameras[];
+};
+
+layout(std430, binding = 1) readonly buffer Visible {
+	uint visible[];
+};
+
+uniform mat4 mvp;
+uniform float scale;
+
+out vec3 color_vert;
+
+// Line endpoints: the center (-1) to each corner, then the image plane border.
+const int endpoints[16] = int[](-1, 0, -1, 1, -1, 2, -1, 3, 0, 1, 1, 2, 2, 3, 3, 0);
+
+void main() {
+	const CameraInstance cam = cameras[visible[gl_InstanceID]];
+	const int corner = endpoints[gl_VertexID];
+	vec3 vertex = cam.position.xyz;
+	if (corner >= 0) {
+		vertex += scale * cam.corners[corner].xyz;
+	}
+	color_vert = cam.color.rgb;
+	gl_Position = mvp * vec4(vertex, 1.0);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+// Same layout as in camera_frusta.vert.
+struct CameraInstance {
+	vec4 position;
+	vec4 corners[4];
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Cameras {
+	CameraInstance cameras[];
+};
+
+layout(std430, binding = 1) readonly buffer Visible {
+	uint visible[];
+};
+
+uniform mat4 mvp;
+uniform float scale;
+
+out vec2 out_uv;
+flat out int out_slice;
+
+// Two triangles per image plane.
+const int quadCorners[6] = int[](0, 1, 2, 0, 2, 3);
+const vec2 quadUVs[4] = vec2[](vec2(0.0, 1.0), vec2(1.0, 1.0), vec2(1.0, 0.0), vec2(0.0, 0.0));
+
+void main() {
+	const uint id = visible[gl_InstanceID];
+	const int corner = quadCorners[gl_VertexID];
+	out_uv = quadUVs[corner];
+	out_slice = int(id);
+	gl_Position = mvp * vec4(cameras[id].position.xyz + scale * cameras[id].corners[corner].xyz, 1.0);
+}
@@ -71,9 +71,7 @@ int main( int ac, char** av )
 		PointBasedView::Ptr	pointbasedView(new PointBasedView(scene, sceneResWidth, sceneResHeight));
 
 		// Raycaster.
-		std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-		raycaster->init();
-		raycaster->addMesh(scene->proxies()->proxy());
+		std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 		// Camera handler for main view.
 		sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
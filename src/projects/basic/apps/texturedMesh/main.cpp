@@ -155,9 +155,7 @@ int main( int ac, char** av )
 
 
 		// Raycaster.
-		std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-		raycaster->init();
-		raycaster->addMesh(scene->proxies()->proxy());
+		std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 		// Camera handler for main view.
 		sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
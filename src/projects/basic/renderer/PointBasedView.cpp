@@ -12,6 +12,7 @@
 
 #include <projects/basic/renderer/PointBasedView.hpp>
 #include <core/graphics/GUI.hpp>
+#include <algorithm>
 
 sibr::PointBasedView::PointBasedView(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h) :
 	_scene(ibrScene),
@@ -30,6 +31,7 @@ void sibr::PointBasedView::setScene(const sibr::BasicIBRScene::Ptr & newScene) {
 	const uint h = getResolution().y();
 
 	_pointBasedRenderer.reset(new PointBasedRenderer());
+	_octree.reset();
 }
 
 void sibr::PointBasedView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Camera & eye)
@@ -37,7 +39,14 @@ void sibr::PointBasedView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Ca
 	// Perform ULR rendering, either directly to the destination RT, or to the intermediate RT when poisson blending is enabled.
 	glViewport(0, 0, dst.w(), dst.h());
 	dst.clear();
-	_pointBasedRenderer->process( _scene->proxies()->proxy(), eye, dst, false);
+	if (!_useOctree) {
+		_pointBasedRenderer->process(_scene->proxies()->proxy(), eye, dst, false);
+		return;
+	}
+	if (!_octree) {
+		_octree.reset(new PointOctree(_scene->proxies()->proxy()));
+	}
+	_pointBasedRenderer->process(*_octree, eye, dst, _pixelSpacing, size_t(_pointBudget) * 1000000);
 }
 
 void sibr::PointBasedView::onUpdate(Input & input)
@@ -51,6 +60,17 @@ void sibr::PointBasedView::onGUI()
 		// Poisson settings.
 		//ImGui::Checkbox("Poisson fix", &_poissonRenderer->enableFix());
 
+		ImGui::Checkbox("Level of detail", &_useOctree);
+		if (_useOctree) {
+			ImGui::Checkbox("Compute rasterizer", &_pointBasedRenderer->useCompute());
+			ImGui::SliderFloat("Point spacing (px)", &_pixelSpacing, 0.5f, 8.0f);
+			ImGui::SliderInt("Point size (px)", &_pointBasedRenderer->pointSize(), 1, 5);
+			ImGui::InputInt("Budget (M points)", &_pointBudget);
+			_pointBudget = std::max(_pointBudget, 0);
+			ImGui::Text("%.2fM points drawn%s", float(_pointBasedRenderer->drawnPoints()) * 1e-6f,
+				_pointBasedRenderer->computeSupported() ? "" : ", compute rasterizer not supported");
+		}
+
 	}
 	ImGui::End();
 }
@@ -75,6 +75,10 @@ namespace sibr {
 		
 		std::shared_ptr<sibr::BasicIBRScene> _scene;
 		PointBasedRenderer::Ptr			 _pointBasedRenderer;
+		PointOctree::Ptr				 _octree; ///< Hierarchy of the proxy points, built on first use.
+		bool							 _useOctree = true; ///< Render with culling and level of detail.
+		float							 _pixelSpacing = 2.0f; ///< Target distance between points on screen, in pixels.
+		int								 _pointBudget = 0; ///< Maximum number of rendered points, in millions, 0 for no limit.
 											 
 											 
 	};
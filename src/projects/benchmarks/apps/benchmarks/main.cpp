@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <core/graphics/Window.hpp>
+#include <core/graphics/GPUQuery.hpp>
+#include <core/assets/CameraRecorder.hpp>
+#include <core/raycaster/CameraRaycaster.hpp>
+#include <core/raycaster/Raycaster.hpp>
+#include <core/renderer/PoissonRenderer.hpp>
+#include <core/scene/BasicIBRScene.hpp>
+#include <core/system/BenchmarkReport.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <core/system/String.hpp>
+#include <core/system/Utils.hpp>
+
+#include <projects/basic/renderer/PointBasedView.hpp>
+#include <projects/basic/renderer/TexturedMeshView.hpp>
+#include <projects/ulr/renderer/ULRV3View.hpp>
+#ifdef SIBR_BENCHMARK_GAUSSIAN
+#include <projects/gaussianviewer/renderer/GaussianView.hpp>
+#endif
+
+#define PROGRAM_NAME "sibr_benchmarks_app"
+using namespace sibr;
+
+const char* usage = ""
+"Usage: " PROGRAM_NAME " -path <dataset-path> [--pathFile <camera-path>] [--gaussian <point_cloud.ply>] [--report <file>]"    	"\n"
+"   or: " PROGRAM_NAME " --suite <suite-file> [--report <file>]"    	"\n"
+;
+
+/// Arguments of the benchmarks.
+struct BenchmarksArgs : virtual BasicIBRAppArgs {
+	Arg<std::string> suite = { "suite", "", "file listing the benchmarked datasets, one '<dataset> [<camera-path>] [<gaussian-ply>]' per line" };
+	Arg<std::string> views = { "views", "ulr_v3,textured_mesh,point_based,gaussian,poisson", "comma separated list of the benchmarked renderers" };
+	Arg<std::string> resolutions = { "resolutions", "1280x720,1920x1080", "comma separated list of rendering resolutions" };
+	Arg<std::string> gaussian = { "gaussian", "", "Gaussian model (point_cloud.ply) of the dataset" };
+	Arg<int> sh_degree = { "sh-degree", 3, "spherical harmonics degree of the Gaussian model" };
+	Arg<int> warmup = { "warmup", 10, "number of frames rendered before measuring" };
+	Arg<int> frames = { "frames", 200, "number of measured frames per renderer, cycling along the camera path" };
+	Arg<int> repeats = { "repeats", 5, "number of runs of each preprocessing kernel" };
+	Arg<int> rays = { "rays", 1 << 20, "number of rays of the raycasting batches" };
+	Arg<int> decoded = { "decoded-images", 8, "number of input images decoded by the image kernel" };
+	ArgSwitch no_kernels = { "no-kernels", false, "skip the preprocessing kernels" };
+	Arg<std::string> report = { "report", "", "JSON report (default: benchmarks.json in the current directory)" };
+};
+
+/// A benchmarked dataset.
+struct SuiteEntry {
+	std::string dataset; ///< Dataset path.
+	std::string cameraPath; ///< Camera path, the input cameras if empty.
+	std::string gaussian; ///< Gaussian model, skipped if empty.
+};
+
+/** Read the benchmarked datasets, the dataset given on the command line if there is no suite file.
+\param args the arguments
+\return the datasets
+*/
+std::vector<SuiteEntry> loadSuite(const BenchmarksArgs & args) {
+	std::vector<SuiteEntry> entries;
+	if (args.suite.get().empty()) {
+		entries.push_back({ args.dataset_path.get(), args.pathFile.get(), args.gaussian.get() });
+		return entries;
+	}
+	std::ifstream file(args.suite.get());
+	if (!file.is_open()) {
+		SIBR_ERR << "Unable to open the suite file " << args.suite.get() << std::endl;
+	}
+	std::string line;
+	while (safeGetline(file, line)) {
+		std::istringstream ss(line.substr(0, line.find('#')));
+		SuiteEntry entry;
+		if (ss >> entry.dataset) {
+			ss >> entry.cameraPath >> entry.gaussian;
+			entries.push_back(entry);
+		}
+	}
+	return entries;
+}
+
+/** Parse the rendering resolutions.
+\param list the resolutions, as WxH separated by commas
+\return the valid resolutions
+*/
+std::vector<Vector2u> parseResolutions(const std::string & list) {
+	std::vector<Vector2u> resolutions;
+	for (const std::string & res : split(list, ',')) {
+		uint w = 0, h = 0;
+		char x = 0;
+		std::istringstream ss(res);
+		if (ss >> w >> x >> h && x == 'x' && w > 0 && h > 0) {
+			resolutions.emplace_back(w, h);
+		}
+		else if (!res.empty()) {
+			SIBR_WRG << "Ignoring invalid resolution " << res << std::endl;
+		}
+	}
+	return resolutions;
+}
+
+/** Load the cameras a renderer is benchmarked along.
+\param entry the dataset
+\param scene the dataset scene
+\param resolution the rendering resolution
+\return the cameras, the input cameras if the dataset has no camera path
+*/
+std::vector<Camera> loadCameras(const SuiteEntry & entry, const BasicIBRScene & scene, const Vector2u & resolution) {
+	CameraRecorder recorder;
+	if (!entry.cameraPath.empty() && recorder.loadPath(entry.cameraPath, resolution.x(), resolution.y()) && !recorder.cams().empty()) {
+		return recorder.cams();
+	}
+	if (!entry.cameraPath.empty()) {
+		SIBR_WRG << "Unable to load the camera path " << entry.cameraPath << ", using the input cameras." << std::endl;
+	}
+	std::vector<Camera> cameras;
+	for (const InputCamera::Ptr & cam : scene.cameras()->inputCameras()) {
+		if (cam->isActive()) {
+			Camera eye(*cam);
+			eye.aspect(float(resolution.x()) / float(resolution.y()));
+			cameras.push_back(eye);
+		}
+	}
+	return cameras;
+}
+
+/** Time the preprocessing kernels on a dataset.
+\param args the arguments
+\param scene the dataset scene
+\param params the dataset description in the report
+\param report the report
+*/
+void benchmarkKernels(const BenchmarksArgs & args, const BasicIBRScene & scene, const std::map<std::string, std::string> & params, BenchmarkReport & report) {
+	const int repeats = std::max(args.repeats.get(), 1);
+	const std::string & meshPath = scene.data()->meshPath();
+
+	Mesh mesh(false);
+	if (!meshPath.empty() && fileExists(meshPath)) {
+		std::map<std::string, std::string> meshParams = params;
+		meshParams["file"] = getFileName(meshPath);
+		report.add("kernels", "mesh_load", BenchmarkReport::measure(repeats, [&]() { mesh = Mesh(false); mesh.load(meshPath); }), meshParams);
+		meshParams["triangles"] = std::to_string(mesh.triangles().size());
+		report.add("kernels", "mesh_normals", BenchmarkReport::measure(repeats, [&]() { mesh.generateNormals(); }), meshParams);
+	}
+	else if (scene.proxies()->hasProxy()) {
+		mesh = scene.proxies()->proxy();
+	}
+
+	if (!mesh.triangles().empty()) {
+		std::map<std::string, std::string> rayParams = params;
+		rayParams["triangles"] = std::to_string(mesh.triangles().size());
+		Raycaster raycaster;
+		report.add("kernels", "raycast_build", BenchmarkReport::measure(repeats, [&]() {
+			raycaster.clearGeometry();
+			raycaster.addMesh(mesh);
+			raycaster.commit();
+		}), rayParams);
+
+		// Primary rays of the first input camera, on a grid with the requested number of rays.
+		const InputCamera & cam = *scene.cameras()->inputCameras()[0];
+		const float ratio = std::sqrt(float(std::max(args.rays.get(), 1)) / float(cam.w() * cam.h()));
+		const uint w = std::max(uint(float(cam.w()) * ratio), 1u);
+		const uint h = std::max(uint(float(cam.h()) * ratio), 1u);
+		Raycaster::RayBatch rays;
+		rays.resize(size_t(w) * h);
+		for (uint y = 0; y < h; ++y) {
+			for (uint x = 0; x < w; ++x) {
+				const Vector2f pixel((float(x) + 0.5f) / ratio, (float(y) + 0.5f) / ratio);
+				rays.set(size_t(y) * w + x, cam.position(), CameraRaycaster::computeRayDir(cam, pixel));
+			}
+		}
+		std::vector<float> dists(rays.size());
+		Raycaster::HitStream hits;
+		hits.dist = dists.data();
+		rayParams["rays"] = std::to_string(rays.size());
+		rayParams["backend"] = raycaster.usesGPU() ? "gpu" : "cpu";
+		report.add("kernels", "raycast_batch", BenchmarkReport::measure(repeats, [&]() {
+			raycaster.intersectStream(rays.stream(), hits, 0.0f, true);
+		}), rayParams);
+	}
+
+	// Each decode is a sample, the files are read once before to measure the decoding and not the disk.
+	const IParseData::Ptr & data = scene.data();
+	const size_t decoded = std::min(size_t(std::max(args.decoded.get(), 0)), data->imgInfos().size());
+	std::vector<double> decodeTimes;
+	for (size_t i = 0; i < decoded; ++i) {
+		const std::string path = data->imgPath() + "/" + data->imgInfos()[i].filename;
+		ImageRGB image;
+		if (!image.load(path, false, false)) {
+			continue;
+		}
+		const std::vector<double> times = BenchmarkReport::measure(repeats, [&]() { image.load(path, false, false); });
+		decodeTimes.insert(decodeTimes.end(), times.begin(), times.end());
+	}
+	if (!decodeTimes.empty()) {
+		std::map<std::string, std::string> imageParams = params;
+		imageParams["images"] = std::to_string(decoded);
+		report.add("kernels", "image_decode", decodeTimes, imageParams);
+	}
+}
+
+/// A renderer and its timings.
+struct TimedView {
+	ViewBase::Ptr view; ///< The view, null for the Poisson filling.
+	std::unique_ptr<PoissonRenderer> poisson; ///< The Poisson filling.
+	std::vector<double> gpu; ///< GPU durations, in ms.
+	std::vector<double> frame; ///< Frame durations, in ms.
+};
+
+/** Create a renderer.
+\param name the renderer name
+\param entry the dataset
+\param scene the dataset scene
+\param resolution the rendering resolution
+\param args the arguments
+\param timed will contain the renderer
+\return false if the renderer is not available for this dataset
+*/
+bool createView(const std::string & name, const SuiteEntry & entry, const BasicIBRScene::Ptr & scene, const Vector2u & resolution,
+	const BenchmarksArgs & args, TimedView & timed) {
+	if (name == "ulr_v3") {
+		timed.view.reset(new ULRV3View(scene, resolution.x(), resolution.y()));
+	}
+	else if (name == "textured_mesh") {
+		if (!scene->inputMeshTextures()) {
+			SIBR_WRG << "No mesh texture in " << entry.dataset << ", skipping " << name << "." << std::endl;
+			return false;
+		}
+		timed.view.reset(new TexturedMeshView(scene, resolution.x(), resolution.y()));
+	}
+	else if (name == "point_based") {
+		timed.view.reset(new PointBasedView(scene, resolution.x(), resolution.y()));
+	}
+	else if (name == "gaussian") {
+#ifdef SIBR_BENCHMARK_GAUSSIAN
+		if (entry.gaussian.empty()) {
+			SIBR_WRG << "No Gaussian model for " << entry.dataset << ", skipping " << name << "." << std::endl;
+			return false;
+		}
+		bool messageRead = true;
+		timed.view.reset(new GaussianView(scene, resolution.x(), resolution.y(), entry.gaussian.c_str(), &messageRead, args.sh_degree));
+#else
+		SIBR_WRG << "Built without the Gaussian viewer, skipping " << name << "." << std::endl;
+		return false;
+#endif
+	}
+	else if (name == "poisson") {
+		// Fills the holes of the ULR images, rendered before timing.
+		timed.view.reset(new ULRV3View(scene, resolution.x(), resolution.y()));
+		timed.poisson.reset(new PoissonRenderer(resolution.x(), resolution.y()));
+		timed.poisson->enableFix() = true;
+	}
+	else {
+		SIBR_WRG << "Unknown renderer " << name << ", skipping it." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int ac, char** av) {
+
+	// Parse Command-line Args
+	CommandLineArgs::parseMainArgs(ac, av);
+	BenchmarksArgs myArgs;
+	myArgs.displayHelpIfRequired();
+
+	const int warmup = std::max(myArgs.warmup.get(), 1);
+	const int frames = std::max(myArgs.frames.get(), 1);
+	const std::vector<Vector2u> resolutions = parseResolutions(myArgs.resolutions.get());
+	const std::vector<SuiteEntry> suite = loadSuite(myArgs);
+	if (resolutions.empty() || suite.empty()) {
+		SIBR_ERR << "Nothing to benchmark, check the datasets and the resolutions." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	sibr::Window window(PROGRAM_NAME, sibr::Vector2i(50, 50), myArgs);
+
+	BenchmarkReport report;
+	for (const GLenum property : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		static const std::map<GLenum, std::string> keys = { { GL_VENDOR, "gl_vendor" }, { GL_RENDERER, "gpu" }, { GL_VERSION, "gl_version" } };
+		const char * value = reinterpret_cast<const char*>(glGetString(property));
+		report.environment(keys.at(property), value ? value : "");
+	}
+
+	for (const SuiteEntry & entry : suite) {
+		SIBR_LOG << "Benchmarking " << entry.dataset << std::endl;
+		myArgs.dataset_path = entry.dataset;
+		BasicIBRScene::Ptr scene;
+		{
+			sibr::Timer timer(true);
+			scene.reset(new BasicIBRScene(myArgs));
+			report.add("loading", "scene", { timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3 }, { { "dataset", entry.dataset } });
+		}
+		const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
+		scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), scene->proxies(), flags, true, myArgs.force_aspect_ratio);
+
+		if (!myArgs.no_kernels) {
+			benchmarkKernels(myArgs, *scene, { { "dataset", entry.dataset } }, report);
+		}
+
+		for (const Vector2u & resolution : resolutions) {
+			const std::vector<Camera> cameras = loadCameras(entry, *scene, resolution);
+			if (cameras.empty()) {
+				SIBR_WRG << "No camera to render " << entry.dataset << " from." << std::endl;
+				break;
+			}
+			const std::string resName = std::to_string(resolution.x()) + "x" + std::to_string(resolution.y());
+			RenderTargetRGBA dst(resolution.x(), resolution.y());
+			RenderTargetRGBA::Ptr holes(new RenderTargetRGBA(resolution.x(), resolution.y()));
+			RenderTargetRGBA::Ptr filled(new RenderTargetRGBA(resolution.x(), resolution.y()));
+			GPUQuery gpuQuery(GL_TIME_ELAPSED);
+
+			for (const std::string & name : split(myArgs.views.get(), ',')) {
+				TimedView timed;
+				sibr::Timer setupTimer(true);
+				if (!createView(name, entry, scene, resolution, myArgs, timed)) {
+					continue;
+				}
+				const std::map<std::string, std::string> params = {
+					{ "dataset", entry.dataset }, { "resolution", resName }, { "cameras", std::to_string(cameras.size()) } };
+				report.add("setup", name, { setupTimer.deltaTimeFromLastTic<Timer::micro>() * 1e-3 }, params);
+
+				sibr::Timer timer;
+				for (int f = 0; f < warmup + frames; ++f) {
+					const Camera & eye = cameras[f % cameras.size()];
+					if (timed.poisson) {
+						timed.view->onRenderIBR(*holes, eye);
+						glFinish();
+					}
+					timer.tic();
+					// Time elapsed queries can't be nested, so the views are timed as a whole.
+					gpuQuery.begin();
+					if (timed.poisson) {
+						timed.poisson->process(holes, filled);
+					}
+					else {
+						timed.view->onRenderIBR(dst, eye);
+					}
+					gpuQuery.end();
+					glFinish();
+					const double frameTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+					CHECK_GL_ERROR;
+					if (f >= warmup) {
+						timed.frame.push_back(frameTime);
+						timed.gpu.push_back(double(gpuQuery.value()) * 1e-6);
+					}
+				}
+				report.add("gpu", name, timed.gpu, params);
+				report.add("frame", name, timed.frame, params);
+				const BenchmarkReport::Stats gpu = BenchmarkReport::stats(timed.gpu);
+				SIBR_LOG << name << " " << resName << ": GPU " << gpu.mean << " ms (p50 " << gpu.p50 << ", p95 " << gpu.p95 << ", p99 " << gpu.p99 << ")" << std::endl;
+			}
+		}
+	}
+
+	const std::string reportPath = myArgs.report.get().empty() ? "benchmarks.json" : myArgs.report.get();
+	return report.write(reportPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -17,6 +17,9 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/flann/flann.hpp>
 #include <core/renderer/DepthRenderer.hpp>
+#include <core/raycaster/KdTree.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <omp.h>
 #include <core/graphics/Window.hpp>
 #include <core/scene/BasicIBRScene.hpp>
 #include <core/scene/ParseData.hpp>
@@ -79,10 +82,12 @@ void irls(Eigen::MatrixX4f mX, Eigen::VectorXf vY, Eigen::Vector4f& mCoeffs, flo
 	Eigen::Vector4f vC = mX_.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(vY);
 	//Log(EInfo, "Finished solving for LS solution.");
 
-	// Form the leverage value matrix as H = X . ( X_T . X ) . X_T
-	// Form the leverage factor matrix as 1/sqrt(1 - diag(H))
-	Eigen::VectorXf mH = (mX_ * (((mX_.transpose() * mX_).inverse()) * mX_.transpose())).diagonal();
-	Eigen::MatrixXf mH_ = (Eigen::VectorXf::Constant(mH.rows(), 1, 1) - mH).cwiseSqrt().cwiseInverse().asDiagonal();
+	// Form the leverage values as diag(H) with H = X . ( X_T . X ) . X_T, row by row: diag(H)_i = x_i . ( X_T . X )^-1 . x_i_T
+	// Form the leverage factors as 1/sqrt(1 - diag(H))
+	// (the full H is N x N, too large for dense correspondences)
+	const Eigen::Matrix4f mXtXinv = (mX.transpose() * mX).inverse();
+	Eigen::VectorXf mH = (mX * mXtXinv).cwiseProduct(mX).rowwise().sum();
+	Eigen::VectorXf mH_ = (Eigen::VectorXf::Constant(mH.rows(), 1, 1) - mH).cwiseSqrt().cwiseInverse();
 
 	std::cout << vC << std::endl;
 	for (int i = 0; ; i++) {
@@ -94,7 +99,7 @@ void irls(Eigen::MatrixX4f mX, Eigen::VectorXf vY, Eigen::Vector4f& mCoeffs, flo
 		float mad = findMAD(resid.cwiseAbs());
 
 		// Calcualte Standardized Adjusted Residuals.
-		Eigen::VectorXf r = (mH_ * resid * 0.6745) / (mad * tune);
+		Eigen::VectorXf r = (mH_.cwiseProduct(resid) * 0.6745) / (mad * tune);
 
 		// Find the root weight of residuals.
 		Eigen::VectorXf wt = weight(r);
@@ -124,6 +129,126 @@ void irls(Eigen::MatrixX4f mX, Eigen::VectorXf vY, Eigen::Vector4f& mCoeffs, flo
 	std::cout << vC << std::endl;
 }
 
+// Sums over the ICP correspondences, padded to 4 components so that Eigen vectorizes the accumulation.
+struct ICPMoments {
+	Eigen::Vector4d sumP = Eigen::Vector4d::Zero();
+	Eigen::Vector4d sumQ = Eigen::Vector4d::Zero();
+	Eigen::Matrix4d sumQP = Eigen::Matrix4d::Zero();
+	double sumPP = 0.0;
+	double sumDistSq = 0.0;
+	size_t count = 0;
+};
+
+// Refine an alignment with point-to-point ICP, estimating a similarity at each iteration.
+// Points of the mesh to align are subsampled, coarse to fine, and matched to their closest point in the reference
+// using batched kd-tree queries; matches further than 3 times the median distance are rejected.
+Eigen::Matrix4f refineICP(const Mesh::Vertices& refPoints, const Mesh::Vertices& points, const Eigen::Matrix4f& init, int iterations) {
+	typedef sibr::KdTree<float> Tree;
+
+	sibr::Timer timer(true);
+	const Tree tree(refPoints, 10, size_t(omp_get_max_threads()));
+	SIBR_LOG << "ICP: kd-tree over " << refPoints.size() << " points built in " << timer.deltaTimeFromLastTic() << "ms" << std::endl;
+
+	// Sample counts of the levels, the last level uses all points.
+	const int levels = 4;
+	const size_t finestSamples = points.size();
+	const int iterationsPerLevel = std::max(1, (iterations + levels - 1) / levels);
+
+	Eigen::Matrix4f transform = init;
+	std::vector<Tree::Vector3X> moved;
+	std::vector<size_t> ids;
+	std::vector<float> distSqs, sortedDistSqs;
+	std::vector<ICPMoments> partials(omp_get_max_threads());
+	int iteration = 0;
+	// With few iterations, skip the coarsest levels so that the finest one is always reached.
+	for (int level = std::max(0, levels - iterations); level < levels && iteration < iterations; ++level) {
+		const size_t samples = std::max(size_t(1), finestSamples >> (2 * (levels - 1 - level)));
+		const size_t stride = std::max(size_t(1), points.size() / samples);
+		double previousRms = std::numeric_limits<double>::max();
+
+		for (int levelIteration = 0; levelIteration < iterationsPerLevel && iteration < iterations; ++levelIteration, ++iteration) {
+			timer.tic();
+			// Vary the samples between iterations.
+			const size_t offset = size_t(iteration) % stride;
+			const int64_t count = int64_t((points.size() - offset + stride - 1) / stride);
+			moved.resize(count);
+#pragma omp parallel for
+			for (int64_t i = 0; i < count; ++i) {
+				moved[i] = (transform * points[offset + i * stride].homogeneous()).head<3>();
+			}
+
+			tree.getClosest(moved, 1, ids, distSqs);
+
+			sortedDistSqs = distSqs;
+			std::nth_element(sortedDistSqs.begin(), sortedDistSqs.begin() + sortedDistSqs.size() / 2, sortedDistSqs.end());
+			const float maxDistSq = 9.0f * sortedDistSqs[sortedDistSqs.size() / 2];
+
+			for (ICPMoments& partial : partials) {
+				partial = ICPMoments();
+			}
+#pragma omp parallel
+			{
+				ICPMoments& partial = partials[omp_get_thread_num()];
+#pragma omp for
+				for (int64_t i = 0; i < count; ++i) {
+					if (ids[i] == Tree::kInvalidId || distSqs[i] > maxDistSq) {
+						continue;
+					}
+					const Eigen::Vector4d p(moved[i].x(), moved[i].y(), moved[i].z(), 0.0);
+					const sibr::Vector3f& ref = refPoints[ids[i]];
+					const Eigen::Vector4d q(ref.x(), ref.y(), ref.z(), 0.0);
+					partial.sumP += p;
+					partial.sumQ += q;
+					partial.sumQP.noalias() += q * p.transpose();
+					partial.sumPP += p.squaredNorm();
+					partial.sumDistSq += distSqs[i];
+					++partial.count;
+				}
+			}
+			ICPMoments total;
+			for (const ICPMoments& partial : partials) {
+				total.sumP += partial.sumP;
+				total.sumQ += partial.sumQ;
+				total.sumQP += partial.sumQP;
+				total.sumPP += partial.sumPP;
+				total.sumDistSq += partial.sumDistSq;
+				total.count += partial.count;
+			}
+			if (total.count < 3) {
+				SIBR_WRG << "ICP: not enough matches, stopping." << std::endl;
+				return transform;
+			}
+
+			// Closed form similarity from the moments (Umeyama).
+			const double n = double(total.count);
+			const Eigen::Vector3d meanP = total.sumP.head<3>() / n;
+			const Eigen::Vector3d meanQ = total.sumQ.head<3>() / n;
+			const Eigen::Matrix3d cov = total.sumQP.topLeftCorner<3, 3>() / n - meanQ * meanP.transpose();
+			const double varP = total.sumPP / n - meanP.squaredNorm();
+			Eigen::JacobiSVD<Eigen::Matrix3d> svd(cov, Eigen::ComputeFullU | Eigen::ComputeFullV);
+			Eigen::Vector3d signs = Eigen::Vector3d::Ones();
+			if (svd.matrixU().determinant() * svd.matrixV().determinant() < 0.0) {
+				signs.z() = -1.0;
+			}
+			const Eigen::Matrix3d rotation = svd.matrixU() * signs.asDiagonal() * svd.matrixV().transpose();
+			const double scale = svd.singularValues().dot(signs) / varP;
+			Eigen::Matrix4d delta = Eigen::Matrix4d::Identity();
+			delta.topLeftCorner<3, 3>() = scale * rotation;
+			delta.topRightCorner<3, 1>() = meanQ - scale * rotation * meanP;
+			transform = delta.cast<float>() * transform;
+
+			const double rms = std::sqrt(total.sumDistSq / n);
+			SIBR_LOG << "ICP: level " << level << " iteration " << iteration << ": " << count << " samples, " << total.count
+				<< " matches, RMS " << rms << ", " << timer.deltaTimeFromLastTic() << "ms" << std::endl;
+			if (std::abs(previousRms - rms) < 1e-4 * rms) {
+				break;
+			}
+			previousRms = rms;
+		}
+	}
+	return transform;
+}
+
 static bool isRawRC(std::string pathRC)
 {
 	// do we have bundle, mesh and list images ?
@@ -300,6 +425,7 @@ struct AlignMeshesArgs :
 	Arg<bool> forceLandscape = { "forceLandscape", "Option to force all images to be in landscape orientation before image assignation and correspondances computation" };
 	Arg<bool> saveScene = { "saveScene", "If true saves entire scene, else only save the transformed mesh and transform.txt file in out dir"
 	};
+	Arg<int> icpIterations = { "icp", 0, "Number of ICP iterations refining the alignment on the mesh vertices, 0 to disable" };
 };
 
 int main(int ac, char** av)
@@ -696,19 +822,21 @@ int main(int ac, char** av)
 		vCoeffs2.x(), vCoeffs2.y(), vCoeffs2.z(), vCoeffs2.w(),
 		0, 0, 0, 1;
 
+	if (myArgs.icpIterations > 0) {
+		mFinal = refineICP(meshRef.vertices(), mesh2Align.vertices(), mFinal, myArgs.icpIterations);
+	}
+
 	std::cout << "Matrix is:" << std::endl;
-	std::cout << vCoeffs0.x() << " " << vCoeffs0.y() << " " << vCoeffs0.z() << " " << vCoeffs0.w() << std::endl;
-	std::cout << vCoeffs1.x() << " " << vCoeffs1.y() << " " << vCoeffs1.z() << " " << vCoeffs1.w() << std::endl;
-	std::cout << vCoeffs2.x() << " " << vCoeffs2.y() << " " << vCoeffs2.z() << " " << vCoeffs2.w() << std::endl;
-	std::cout << 0 << " " << 0 << " " << 0 << " " << 1 << std::endl;
+	for (int r = 0; r < 4; r++) {
+		std::cout << mFinal(r, 0) << " " << mFinal(r, 1) << " " << mFinal(r, 2) << " " << mFinal(r, 3) << std::endl;
+	}
 	std::cout << medianScale << std::endl; // for xFormScene scale factor of 1
 
 	std::ofstream myfile;
 	myfile.open(outPath + "/transform.txt");
-	myfile << vCoeffs0.x() << " " << vCoeffs0.y() << " " << vCoeffs0.z() << " " << vCoeffs0.w() << std::endl;
-	myfile << vCoeffs1.x() << " " << vCoeffs1.y() << " " << vCoeffs1.z() << " " << vCoeffs1.w() << std::endl;
-	myfile << vCoeffs2.x() << " " << vCoeffs2.y() << " " << vCoeffs2.z() << " " << vCoeffs2.w() << std::endl;
-	myfile << 0 << " " << 0 << " " << 0 << " " << 1 << std::endl;
+	for (int r = 0; r < 4; r++) {
+		myfile << mFinal(r, 0) << " " << mFinal(r, 1) << " " << mFinal(r, 2) << " " << mFinal(r, 3) << std::endl;
+	}
 	myfile << 1 << std::endl; // for xFormScene scale factor of 1
 	myfile.close();
 
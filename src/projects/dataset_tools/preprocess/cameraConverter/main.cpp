@@ -12,6 +12,9 @@
 
 #include "core/system/CommandLineArgs.hpp"
 #include "core/assets/InputCamera.hpp"
+#include "core/system/ThreadPool.hpp"
+#include "core/system/Utils.hpp"
+#include <sstream>
 
 using namespace sibr;
 
@@ -101,26 +104,30 @@ void colmapSave(const std::string& filename, const std::vector<InputCamera::Ptr>
 		focalx = xformPath[0]->focal() * (focalx / focaly);
 		SIBR_WRG << "Focal x set to f / (fx/fy); f of first image :" << focalx<<std::endl;
 	}
-	for(int i=0; i<xformPath.size(); i++)  {
-		outputColmapPathCams << i+1 << " PINHOLE " << xformPath[0]->w()*scale << " " << xformPath[0]->h()*scale
+	sibr::writeRecords(outputColmapPathCams, xformPath.size(), [&xformPath, scale, focalx](size_t i) {
+		std::ostringstream line;
+		line << i+1 << " PINHOLE " << xformPath[0]->w()*scale << " " << xformPath[0]->h()*scale
 			<< " " << xformPath[0]->focal()*scale << " " << focalx*scale 
-			<< " " << xformPath[0]->w()*scale * 0.5 << " " << xformPath[0]->h()*scale * 0.5 << std::endl;
-	}
+			<< " " << xformPath[0]->w()*scale * 0.5 << " " << xformPath[0]->h()*scale * 0.5 << "\n";
+		return line.str();
+	});
 
 
 	outputColmapPath<< "# Image list with two lines of data per image:" << std::endl;
 	outputColmapPath<< "#   IMAGE_ID, QW, QX, QY, QZ, TX, TY, TZ, CAMERA_ID, NAME" << std::endl;
 	outputColmapPath<< "#   POINTS2D[] as (X, Y, POINT3D_ID)" << std::endl;
-	for(int i=0; i<xformPath.size(); i++)  {
+	sibr::writeRecords(outputColmapPath, xformPath.size(), [&xformPath, &converter](size_t i) {
 		sibr::Matrix3f tmp = xformPath[i]->rotation().toRotationMatrix() * converter;
 		sibr::Matrix3f Qinv = tmp.transpose();
 		sibr::Quaternionf q = quatFromMatrix(Qinv);
 		sibr::Vector3f t = -Qinv*xformPath[i]->position();
 
-		outputColmapPath << i << " " <<  q.w() << " " <<  -q.x() << " " <<  -q.y() << " " <<  -q.z() << " " <<  
-			t.x() << " " << t.y() << " " << t.z() << " " << 1 << " " << "pathImage"<<i << std::endl;
-		outputColmapPath << std::endl; // empty line, no points
-	}
+		std::ostringstream line;
+		line << i << " " <<  q.w() << " " <<  -q.x() << " " <<  -q.y() << " " <<  -q.z() << " " <<  
+			t.x() << " " << t.y() << " " << t.z() << " " << 1 << " " << "pathImage"<<i << "\n";
+		line << "\n"; // empty line, no points
+		return line.str();
+	});
 	outputColmapPath.close();
 	outputColmapPathCams.close();
 }
@@ -197,7 +204,8 @@ int main(int ac, char** av) {
 	// Apply transformation to each camera keypoints, if it's not identity.
 	if(!transf.isIdentity()) {
 		SIBR_LOG << "Applying transformation: " << std::endl << transf << std::endl;
-		for (auto & cam : cams) {
+		ThreadPool::shared().parallelFor(0, int(cams.size()), [&](int c) {
+			InputCamera::Ptr & cam = cams[c];
 			sibr::Vector3f pos = cam->position();
 			sibr::Vector3f center = cam->position() + cam->dir();
 			sibr::Vector3f up = cam->position() + cam->up();
@@ -205,8 +213,7 @@ int main(int ac, char** av) {
 			center = (transf * center.homogeneous()).xyz();
 			up = (transf * up.homogeneous()).xyz();
 			cam->setLookAt(pos, center, (up - pos).normalized());
-
-		}
+		});
 	}
 
 	// Save cameras.
@@ -214,23 +221,24 @@ int main(int ac, char** av) {
 	if (outExt == "path") {
 		save(args.output, cams);
 	} else if (outExt == "out") { // bundler
-		std::vector<InputCamera::Ptr> outCams;
-		for(const auto & cam : cams) {
+		std::vector<InputCamera::Ptr> outCams(cams.size());
+		ThreadPool::shared().parallelFor(0, int(cams.size()), [&](int c) {
+			const InputCamera::Ptr & cam = cams[c];
 			const int outH = int(args.outputRes.get()[1]);
 			const int outW = int(std::round(cam->aspect() * float(outH)));
 			InputCamera::Ptr oc;
-			outCams.push_back(oc=std::make_shared<InputCamera>(*cam, outW, outH));
+			outCams[c] = oc = std::make_shared<InputCamera>(*cam, outW, outH);
 			// reset focal
 			oc->setFocal(cam->focal());
-		}
+		});
 		sibr::InputCamera::saveAsBundle(outCams, args.output, args.bundleImageList, args.bundleImageFiles, false);
 	} else if (outExt == "lookat") {
-		std::vector<InputCamera::Ptr> outCams;
-		for (const auto& cam : cams) {
+		std::vector<InputCamera::Ptr> outCams(cams.size());
+		ThreadPool::shared().parallelFor(0, int(cams.size()), [&](int c) {
 			const int outH = int(args.outputRes.get()[1]);
-			const int outW = int(std::round(cam->aspect() * float(outH)));
-			outCams.push_back(std::make_shared<InputCamera>(*cam, outW, outH));
-		}
+			const int outW = int(std::round(cams[c]->aspect() * float(outH)));
+			outCams[c] = std::make_shared<InputCamera>(*cams[c], outW, outH);
+		});
 		sibr::InputCamera::saveAsLookat(outCams, args.output);
 	}
 	else if (getFileName(args.output) == "images.txt" ) { // colmap
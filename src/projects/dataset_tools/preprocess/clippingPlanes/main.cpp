@@ -15,12 +15,13 @@
 #include <core/system/CommandLineArgs.hpp>
 #include <core/raycaster/CameraRaycaster.hpp>
 #include <core/assets/ImageListFile.hpp>
+#include <core/graphics/Window.hpp>
 #include <core/system/Utils.hpp>
 
 /*
 generate clipping_planes.txt file
 */
-const char* USAGE						= "Usage: clippingPlanes <dataset-path> \n";
+const char* USAGE						= "Usage: clippingPlanes <dataset-path> [--gpu] [--exact]\n";
 const char* TAG							= "[clippingPlanes]";
 
 using namespace sibr;
@@ -42,6 +43,26 @@ int main(const int argc, const char** argv)
 		return 1;
 	}
 
+	bool gpu = false;
+	// Trace every pixel instead of a sparse grid, tighter but slower (fast with --gpu).
+	bool exact = false;
+	for (int a = 2; a < argc; ++a) {
+		gpu = gpu || std::string(argv[a]) == "--gpu";
+		exact = exact || std::string(argv[a]) == "--exact";
+	}
+
+	// The GPU raycaster needs a context, current on this thread.
+	std::unique_ptr<Window> window;
+	if (gpu) {
+		WindowArgs winArgs;
+		winArgs.offscreen = true;
+		// Nothing is displayed, so do not require a window system when EGL is available.
+		winArgs.headless = Window::supportsHeadless();
+		winArgs.no_gui = true;
+		window.reset(new Window(TAG, winArgs));
+		Raycaster::defaultBackend(Raycaster::Backend::GPU);
+	}
+
 	// load rest of the things
 	std::vector<InputCamera::Ptr>	inCams = InputCamera::load(datasetPath);
 	ImageListFile				imageListFile;
@@ -58,7 +79,7 @@ int main(const int argc, const char** argv)
 	if (!sibr::fileExists(clipping_planes_file_path)) {
 
 		std::vector<sibr::Vector2f> nearsFars;
-		CameraRaycaster::computeClippingPlanes(proxy, inCams, nearsFars);
+		CameraRaycaster::computeClippingPlanes(proxy, inCams, nearsFars, exact ? 1 : 15);
 
 		std::ofstream file(clipping_planes_file_path, std::ios::trunc | std::ios::out);
 		if (file) {
@@ -19,10 +19,9 @@
 Crop input images from center so they end up with resolution <crop_width> x <crop_height>
 if scale down factor is also passed, after the image has been cropped, it will be scaled down by that value
 */
-const char* USAGE = "Usage: cropFromCenter --inputFile <path_to_input_file> --outputPath <path_to_output_folder> --avgResolution <width x height> --cropResolution <width x height> [--scaleDownFactor <alpha> --targetResolution <width x height>] \n";
+const char* USAGE = "Usage: cropFromCenter --inputFile <path_to_input_file> --outputPath <path_to_output_folder> --avgResolution <width x height> --cropResolution <width x height> [--scaleDownFactor <alpha> --targetResolution <width x height> --quality <q> --force] \n";
 //const char* USAGE						= "Usage: cropFromCenter --inputFile <path_to_input_file> --outputPath <path_to_output_folder> --avgResolution <width x height> --cropResolution <widht x height> [--scaleDownFactor <alpha> --targetResolution <width x height>] \n";
 const char* TAG = "[cropFromCenter]";
-const unsigned PROCESSING_BATCH_SIZE = 150;
 const char* LOG_FILE_NAME = "cropFromCenter.log";
 const char* SCALED_DOWN_SUBFOLDER = "scaled";
 const char* SCALED_DOWN_FILENAME = "scale_factor.txt";
@@ -35,6 +34,8 @@ struct CropAppArgs :
 	sibr::Arg<sibr::Vector2i> cropResolutionArg = { "cropResolution",{ 0, 0 } };
 	sibr::Arg<float> scaleDownFactorArg = { "scaleDownFactor", 0.0f };
 	sibr::Arg<sibr::Vector2i> targetResolutionArg = { "targetResolution",{ 0, 0 } };
+	sibr::Arg<int> qualityArg = { "quality", 95, "output JPEG quality" };
+	sibr::Arg<bool> forceArg = { "force", "process images even if their outputs are up to date" };
 };
 
 void printUsage()
@@ -45,7 +46,8 @@ void printUsage()
 
 bool getParamas(int argc, const char ** argv,
 	std::string & inputFile, boost::filesystem::path & outputPath,
-	sibr::Vector2i & avgResolution, sibr::Vector2i & cropResolution, float & scaleDownFactor, sibr::Vector2i & targetResolution)
+	sibr::Vector2i & avgResolution, sibr::Vector2i & cropResolution, float & scaleDownFactor, sibr::Vector2i & targetResolution,
+	int & quality, bool & force)
 {
 
 	sibr::CommandLineArgs::parseMainArgs(argc, argv);
@@ -69,6 +71,9 @@ bool getParamas(int argc, const char ** argv,
 		targetResolution = myArgs.targetResolutionArg;
 	}
 
+	quality = myArgs.qualityArg;
+	force = myArgs.forceArg;
+
 
 	if (inputFile.empty() || outputFolder.empty() || avgResolution == sibr::Vector2i(0, 0) || cropResolution == sibr::Vector2i(0, 0)) {
 		return false;
@@ -88,10 +93,12 @@ int main(const int argc, const char** argv)
 	sibr::Vector2i				cropResolution;
 	float						scaleDownFactor = 0.f;
 	sibr::Vector2i				targetResolution;
+	int							quality = 95;
+	bool						force = false;
 
 	sibr::CropScaleImageUtility appUtility;
 
-	if (!getParamas(argc, argv, inputFileName, outputFolder, avgInitialResolution, cropResolution, scaleDownFactor, targetResolution)) {
+	if (!getParamas(argc, argv, inputFileName, outputFolder, avgInitialResolution, cropResolution, scaleDownFactor, targetResolution, quality, force)) {
 		std::cerr << TAG << " ERROR: wrong parameters.\n";
 		printUsage();
 		return -1;
@@ -118,54 +125,31 @@ int main(const int argc, const char** argv)
 	std::vector<sibr::CropScaleImageUtility::Image> listOfImages(pathToImgs.size());
 	std::vector<sibr::CropScaleImageUtility::Image> listOfImagesScaledDown(scaleDown ? pathToImgs.size() : 0);
 
-	// calculate nr batches
-	const int nrBatches = static_cast<int>(ceil((float)(pathToImgs.size()) / PROCESSING_BATCH_SIZE));
-
 	std::chrono::time_point <std::chrono::system_clock> start, end;
 	start = std::chrono::system_clock::now();
 
-	const int batchSize = int(PROCESSING_BATCH_SIZE);
-	// run batches sequentially
-	for (int batchId = 0; batchId < nrBatches; batchId++) {
-
-		const int nrItems = (batchId != nrBatches - 1) ? batchSize : ((nrBatches * batchSize != int(pathToImgs.size())) ? (int(pathToImgs.size()) - (batchSize * batchId)) : batchSize);
-
-		#pragma omp parallel for
-		for (int localImgIndex = 0; localImgIndex < nrItems; localImgIndex++) {
-
-			const int globalImgIndex = (batchId * batchSize) + localImgIndex;
-
-			// using next code will keep filename in output directory
-			boost::filesystem::path boostPath(pathToImgs[globalImgIndex]);
-			//std::string outputFileName = (outputFolder / boostPath.filename()).string();
-
-			std::stringstream ss;
-			ss << std::setfill('0') << std::setw(8) << globalImgIndex << boostPath.extension().string();
-			std::string outputFileName = (outputFolder / ss.str()).string();
-			std::string scaledDownOutputFileName = (scaledDownOutputFolder / ss.str()).string();
-
-			cv::Mat img = cv::imread(pathToImgs[globalImgIndex], 1);
-
-			cv::Rect areOfIntererst = cv::Rect((img.cols - cropResolution[0]) / 2, (img.rows - cropResolution[1]) / 2, cropResolution[0], cropResolution[1]);
-
-			cv::Mat croppedImg = img(areOfIntererst);
-
-			cv::imwrite(outputFileName, croppedImg);
-
-			listOfImages[globalImgIndex].filename = ss.str();
-			listOfImages[globalImgIndex].width = croppedImg.cols;
-			listOfImages[globalImgIndex].height = croppedImg.rows;
-
-			if (scaleDown) {
-				cv::Mat resizedImg;
-				cv::resize(croppedImg, resizedImg, resizedSize, 0, 0, cv::INTER_LINEAR);
-
-				cv::imwrite(scaledDownOutputFileName, resizedImg);
+	std::vector<sibr::CropScaleImageUtility::Task> tasks(pathToImgs.size());
+	for (size_t imgId = 0; imgId < pathToImgs.size(); imgId++) {
+		boost::filesystem::path boostPath(pathToImgs[imgId]);
+		std::stringstream ss;
+		ss << std::setfill('0') << std::setw(8) << imgId << boostPath.extension().string();
+
+		tasks[imgId].input = pathToImgs[imgId];
+		tasks[imgId].cropResolution = cropResolution;
+		tasks[imgId].outputs.push_back({ (outputFolder / ss.str()).string(), sibr::Vector2i(0, 0) });
+		if (scaleDown) {
+			tasks[imgId].outputs.push_back({ (scaledDownOutputFolder / ss.str()).string(), sibr::Vector2i(resizedSize.width, resizedSize.height) });
+		}
+	}
 
-				listOfImagesScaledDown[globalImgIndex].filename	= ss.str();
-				listOfImagesScaledDown[globalImgIndex].width	= resizedImg.cols;
-				listOfImagesScaledDown[globalImgIndex].height	= resizedImg.rows;
-			}
+	sibr::CropScaleImageUtility::BatchSettings settings;
+	settings.quality = quality;
+	settings.skipUpToDate = !force;
+	const auto outputs = appUtility.processBatch(tasks, settings);
+	for (size_t imgId = 0; imgId < outputs.size(); imgId++) {
+		listOfImages[imgId] = outputs[imgId][0];
+		if (scaleDown) {
+			listOfImagesScaledDown[imgId] = outputs[imgId][1];
 		}
 	}
 
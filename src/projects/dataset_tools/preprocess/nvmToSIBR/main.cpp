@@ -17,6 +17,7 @@
 #include <core/raycaster/CameraRaycaster.hpp>
 #include <core/assets/ImageListFile.hpp>
 #include <core/system/Utils.hpp>
+#include <core/system/ThreadPool.hpp>
 
 
 #define PROGRAM_NAME "sibr_nvm_to_sibr"
@@ -41,7 +42,13 @@ int main(const int argc, const char** argv)
 	std::vector<std::string> dirs = { "cameras", "images", "meshes"};
 
 	std::cout << "Generating SIBR scene." << std::endl;
-	BasicIBRScene scene(myArgs, true);
+	// Only the cameras and the dataset description are needed: images and mesh are copied as files.
+	BasicIBRScene::SceneOptions opts;
+	opts.images = false;
+	opts.mesh = false;
+	opts.renderTargets = false;
+	opts.texture = false;
+	BasicIBRScene scene(myArgs, opts);
 
 	// load the cams
 	std::vector<InputCamera::Ptr>	cams = scene.cameras()->inputCameras();
@@ -71,19 +78,33 @@ int main(const int argc, const char** argv)
 		return a->id() < b->id();
 	});
 
-	for (int c = minCam; c < maxCam; c++) {
-		InputCamera & camIm = *cams[c];
+	// Copy the images and format the camera records in parallel, then write the files in order.
+	std::vector<std::string> newFileNames(maxCam - minCam);
+	ThreadPool::shared().parallelFor(minCam, maxCam, [&](int c) {
+		const InputCamera & camIm = *cams[c];
 
 		std::string extensionFile = boost::filesystem::extension(camIm.name());
 		std::ostringstream ssZeroPad;
 		ssZeroPad << std::setw(8) << std::setfill('0') << camIm.id();
-		std::string newFileName = ssZeroPad.str() + extensionFile;
+		newFileNames[c - minCam] = ssZeroPad.str() + extensionFile;
 
-		boost::filesystem::copy_file(pathScene + "/nvm/" + camIm.name(), pathScene + "/images/" + newFileName, boost::filesystem::copy_option::overwrite_if_exists);
-		outputBundleCam << camIm.toBundleString();
-		outputListIm << newFileName << " " << camIm.w() << " " << camIm.h() << std::endl;
-		outputSceneMetadata << newFileName << " " << camIm.w() << " " << camIm.h() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
-	}
+		boost::filesystem::copy_file(pathScene + "/nvm/" + camIm.name(), pathScene + "/images/" + newFileNames[c - minCam], boost::filesystem::copy_option::overwrite_if_exists);
+	}, 1);
+
+	const size_t count = newFileNames.size();
+	writeRecords(outputBundleCam, count, [&](size_t c) {
+		return cams[minCam + c]->toBundleString();
+	});
+	writeRecords(outputListIm, count, [&](size_t c) {
+		const InputCamera & camIm = *cams[minCam + c];
+		return newFileNames[c] + " " + std::to_string(camIm.w()) + " " + std::to_string(camIm.h()) + "\n";
+	});
+	writeRecords(outputSceneMetadata, count, [&](size_t c) {
+		const InputCamera & camIm = *cams[minCam + c];
+		std::ostringstream line;
+		line << newFileNames[c] << " " << camIm.w() << " " << camIm.h() << " " << camIm.znear() << " " << camIm.zfar() << "\n";
+		return line.str();
+	});
 
 
 	outputSceneMetadata << "\n// Always specify active/exclude images after list images\n\n[exclude_images]\n<image1_idx> <image2_idx> ... <image3_idx>" << std::endl;
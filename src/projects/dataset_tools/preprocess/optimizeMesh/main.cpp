@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+
+#include <core/system/Config.hpp>
+#include <core/graphics/Mesh.hpp>
+#include <core/graphics/MeshLOD.hpp>
+#include <core/system/CommandLineArgs.hpp>
+
+
+using namespace sibr;
+
+/** Options for mesh optimization. */
+struct OptimizeMeshArgs : public AppArgs {
+	RequiredArg<std::string> path = { "path", "path to the mesh" };
+	Arg<std::string> output = { "output", "", "path to the output mesh" };
+	Arg<int> cacheSize = { "cache-size", 32, "size of the simulated vertex cache" };
+	Arg<bool> meshlets = { "meshlets", "also cluster the triangles and report the meshlets statistics" };
+	Arg<int> meshletVertices = { "meshlet-vertices", 64, "maximum vertex count of a meshlet" };
+	Arg<int> meshletTriangles = { "meshlet-triangles", 124, "maximum triangle count of a meshlet" };
+	Arg<int> lods = { "lods", 0, "also write this many simplified levels next to the output mesh" };
+	Arg<float> lodRatio = { "lod-ratio", 0.25f, "fraction of the triangles kept from one level to the next" };
+};
+
+int main(int ac, char ** av){
+
+	CommandLineArgs::parseMainArgs(ac, av);
+	OptimizeMeshArgs args;
+	std::string outputFile = args.output;
+	if(outputFile.empty()) {
+		outputFile = sibr::removeExtension(args.path.get()) + "_optimized." + sibr::getExtension(args.path.get());
+	}
+	sibr::makeDirectory(sibr::parentDirectory(outputFile));
+
+	Mesh::Ptr meshPtr(new Mesh(false));
+	Mesh & mesh = *meshPtr;
+	if (!mesh.load(args.path)) {
+		SIBR_ERR << "Unable to load mesh " << args.path.get() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const uint cacheSize = uint(std::max(args.cacheSize.get(), 4));
+	const float before = mesh.vertexCacheMissRatio(cacheSize);
+	mesh.optimizeVertexCache(cacheSize);
+	mesh.optimizeVertexFetch();
+	SIBR_LOG << "Vertex shader runs per triangle: " << before << " -> " << mesh.vertexCacheMissRatio(cacheSize) << std::endl;
+
+	if (args.meshlets) {
+		const Mesh::Meshlets meshlets = mesh.buildMeshlets(uint(args.meshletVertices.get()), uint(args.meshletTriangles.get()));
+		size_t cullable = 0;
+		float radius = 0.0f;
+		for (const Mesh::Meshlet & meshlet : meshlets.meshlets) {
+			cullable += meshlet.coneCutoff < 1.0f ? 1 : 0;
+			radius += meshlet.radius;
+		}
+		const size_t count = std::max<size_t>(meshlets.meshlets.size(), 1);
+		SIBR_LOG << meshlets.meshlets.size() << " meshlets, " << float(meshlets.vertices.size()) / float(count) << " vertices and "
+			<< float(meshlets.triangles.size() / 3) / float(count) << " triangles on average, mean radius " << radius / float(count)
+			<< ", " << cullable << " with a normal cone narrow enough for backface culling." << std::endl;
+	}
+
+	mesh.save(outputFile, true);
+
+	if (args.lods > 0) {
+		const MeshLOD lods(meshPtr, uint(args.lods.get()) + 1, args.lodRatio);
+		for (size_t l = 1; l < lods.levelCount(); ++l) {
+			Mesh & level = *lods.levelPtr(l);
+			level.optimizeForRendering();
+			const std::string levelFile = sibr::removeExtension(outputFile) + "_lod" + std::to_string(l) + "." + sibr::getExtension(outputFile);
+			level.save(levelFile, true);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -17,6 +17,8 @@
 #include <core/raycaster/CameraRaycaster.hpp>
 #include <core/assets/ImageListFile.hpp>
 #include <core/system/Utils.hpp>
+#include <core/imgproc/CropScaleImageUtility.hpp>
+#include <core/system/ThreadPool.hpp>
 
 
 #define PROGRAM_NAME "prepareColmap4Sibr"
@@ -30,6 +32,18 @@ struct ColmapPreprocessArgs : public BasicIBRAppArgs {
 	Arg<bool> fix_metadata = { "fix_metadata", "Fix scene_metadata after crop and distort " };
 };
 
+/** \return scene options loading the cameras and the dataset description only:
+ the images are copied as files and their sizes read from their headers, they never need to be decoded. */
+static BasicIBRScene::SceneOptions metadataOnly()
+{
+	BasicIBRScene::SceneOptions opts;
+	opts.images = false;
+	opts.mesh = false;
+	opts.renderTargets = false;
+	opts.texture = false;
+	return opts;
+}
+
 int main(const int argc, const char** argv)
 {
 
@@ -46,10 +60,24 @@ int main(const int argc, const char** argv)
 		std::string cm_path = myArgs.dataset_path.get() + "/sibr_cm";
 		myArgs.dataset_path = cm_path;
 
-		BasicIBRScene cm_scene(myArgs, true, true);
+		BasicIBRScene cm_scene(myArgs, metadataOnly());
 
 		std::vector<InputCamera::Ptr>	cams = cm_scene.cameras()->inputCameras();
 
+		// read the image sizes in parallel, from the header if possible
+		std::vector<sibr::Vector2i> imSizes(cams.size());
+		sibr::ThreadPool::shared().parallelFor(0, int(cams.size()), [&](int c) {
+			const std::string imgpath = cm_path + "/images/" + cams[c]->name();
+			sibr::Vector2i imSize = sibr::IImage::imageResolution(imgpath);
+			if (imSize.x() <= 0 || imSize.y() <= 0) {
+				sibr::ImageRGB im;
+				if (!im.load(imgpath, false))
+					SIBR_ERR << "Cant open image " << imgpath << std::endl;
+				imSize = im.size().cast<int>();
+			}
+			imSizes[c] = imSize;
+		}, 1);
+
 		std::string tmpFileName = cm_path +  "/scene_metadata_tmp.txt"; 
 		// done in a second pass, when everything has been created.
 		outputSceneMetadata.open(tmpFileName);
@@ -71,14 +99,10 @@ int main(const int argc, const char** argv)
 			std::ostringstream ssZeroPad;
 			ssZeroPad << std::setw(8) << std::setfill('0') << camIm.id();
 			std::string newFileName = ssZeroPad.str() + extensionFile;
-			// load image
-			std::string imgpath = cm_path + "/images/" + camIm.name();
-			sibr::ImageRGB im;
-			if (!im.load(imgpath, false))
-				SIBR_ERR << "Cant open image " << imgpath << std::endl;
-
-			std::cerr << newFileName << " " << im.w() << " " << im.h() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
-			outputSceneMetadata << newFileName << " " << im.w() << " " << im.h() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
+			const sibr::Vector2i & imSize = imSizes[c];
+
+			std::cerr << newFileName << " " << imSize.x() << " " << imSize.y() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
+			outputSceneMetadata << newFileName << " " << imSize.x() << " " << imSize.y() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
 		}
 
 		outputSceneMetadata << "\n// Always specify active/exclude images after list images\n\n[exclude_images]\n<image1_idx> <image2_idx> ... <image3_idx>" << std::endl;
@@ -99,7 +123,7 @@ int main(const int argc, const char** argv)
 		exit(0);
 	}
 	std::cout << "Creating bundle file for SIBR scene." << std::endl;
-	BasicIBRScene scene(myArgs, true, true);
+	BasicIBRScene scene(myArgs, metadataOnly());
 
 	// load the cams
 	std::vector<InputCamera::Ptr>	cams = scene.cameras()->inputCameras();
@@ -129,6 +153,8 @@ int main(const int argc, const char** argv)
 		return a->id() < b->id();
 	});
 
+	// images are copied as is by the batch pipeline, skipping the ones already up to date
+	std::vector<sibr::CropScaleImageUtility::Task> copyTasks;
 	for (int c = minCam; c < maxCam; c++) {
 		InputCamera & camIm = *cams[c];
 
@@ -137,13 +163,18 @@ int main(const int argc, const char** argv)
 		ssZeroPad << std::setw(8) << std::setfill('0') << camIm.id();
 		std::string newFileName = ssZeroPad.str() + extensionFile;
 
-		boost::filesystem::copy_file(pathScene + "/colmap/stereo/images/" + camIm.name(), pathScene + "/sfm_mvs_cm/" + newFileName, boost::filesystem::copy_option::overwrite_if_exists);
+		sibr::CropScaleImageUtility::Task task;
+		task.input = pathScene + "/colmap/stereo/images/" + camIm.name();
+		task.outputs.push_back({ pathScene + "/sfm_mvs_cm/" + newFileName, sibr::Vector2i(0, 0) });
+		copyTasks.push_back(task);
 		// keep focal
 		outputBundleCam << camIm.toBundleString(false, true);
 		outputListIm << newFileName << " " << camIm.w() << " " << camIm.h() << std::endl;
 		outputSceneMetadata << newFileName << " " << camIm.w() << " " << camIm.h() << " " << camIm.znear() << " " << camIm.zfar() << std::endl;
 	}
 
+	sibr::CropScaleImageUtility().processBatch(copyTasks);
+
 	outputSceneMetadata << "\n// Always specify active/exclude images after list images\n\n[exclude_images]\n<image1_idx> <image2_idx> ... <image3_idx>" << std::endl;
 
 	for (int i = 0; i < scene.data()->activeImages().size(); i++) {
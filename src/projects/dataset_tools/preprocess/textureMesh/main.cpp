@@ -14,6 +14,7 @@
 #include "core/assets/InputCamera.hpp"
 #include "core/graphics/Image.hpp"
 #include "core/graphics/Mesh.hpp"
+#include "core/graphics/Window.hpp"
 #include "core/imgproc/MeshTexturing.hpp"
 #include "core/scene/BasicIBRScene.hpp"
 
@@ -27,6 +28,10 @@ struct TexturingAppArgs : virtual BasicIBRAppArgs {
 	Arg<bool> flood_fill = { "flood", "perform flood fill" };
 	Arg<bool> poisson_fill = { "poisson", "perform Poisson filling (slow on large images)" };
 	Arg<float> samples = { "samples", 1.0, "%ge of total samples to be used for texturing" };
+	Arg<bool> gpu = { "gpu", "cast the visibility rays on the GPU" };
+	Arg<bool> gpu_blend = { "gpu_blend", "rasterize and blend the texture on the GPU, using depth maps for visibility" };
+	Arg<bool> gpu_seams = { "gpu_seams", "with --gpu_blend, take each texel from its best camera and level the seams on the GPU" };
+	Arg<int> seam_iterations = { "seam_iterations", 1000, "Jacobi iterations of the seam leveling, per tile" };
 };
 
 int main(int ac, char** av) {
@@ -40,7 +45,7 @@ int main(int ac, char** av) {
 	if(!args.dataset_path.isInit() || !args.output_path.isInit()) {
 		std::cout << "Usage: " << std::endl;
 		std::cout << "\tRequired: --path path/to/dataset --output path/to/output/file.png" << std::endl;
-		std::cout << "\tOptional: --size 8192 --flood (flood fill) --poisson (poisson fill)" << std::endl;
+		std::cout << "\tOptional: --size 8192 --flood (flood fill) --poisson (poisson fill) --gpu (GPU raycasting) --gpu_blend (GPU texturing) --gpu_seams (GPU best camera and seam leveling)" << std::endl;
 		return 0;
 	}
 
@@ -62,9 +67,34 @@ int main(int ac, char** av) {
 		scene.proxies()->replaceProxyPtr(customMesh);
 	}
 
+	// The GPU paths need a context, current on this thread.
+	std::unique_ptr<Window> window;
+	if (args.gpu || args.gpu_blend) {
+		WindowArgs winArgs;
+		winArgs.offscreen = true;
+		// Nothing is displayed, so do not require a window system when EGL is available.
+		winArgs.headless = Window::supportsHeadless();
+		winArgs.no_gui = true;
+		window.reset(new Window("textureMesh", winArgs));
+	}
+	if (args.gpu) {
+		Raycaster::defaultBackend(Raycaster::Backend::GPU);
+	}
+
 	MeshTexturing texturer(args.output_size);
 	texturer.setMesh(scene.proxies()->proxyPtr());
-	texturer.reproject(scene.cameras()->inputCameras(), scene.images()->inputImages(), args.samples);
+	if (args.gpu_blend) {
+		// Images and depth maps at full resolution, the whole mesh is visible from both sides.
+		const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
+		scene.renderTargets()->initRGBandDepthTextureArrays(scene.cameras(), scene.images(), scene.proxies(), flags, false);
+		texturer.reprojectGPU(scene.cameras()->inputCameras(), *scene.renderTargets()->getInputRGBTextureArrayPtr(),
+			*scene.renderTargets()->getInputDepthMapArrayPtr(), args.samples, args.gpu_seams);
+		if (args.gpu_seams) {
+			texturer.levelSeamsGPU(args.seam_iterations);
+		}
+	} else {
+		texturer.reproject(scene.cameras()->inputCameras(), scene.images()->inputImages(), args.samples);
+	}
 
 	// Export options.
 	// UVs start at the bottom of the image, we have to flip.
@@ -16,6 +16,12 @@
 #include "core/graphics/Mesh.hpp"
 #include "core/imgproc/MeshTexturing.hpp"
 #include "core/scene/BasicIBRScene.hpp"
+#include "core/system/ThreadPool.hpp"
+
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 using namespace sibr;
 
@@ -26,19 +32,27 @@ struct TonemapperAppArgs : virtual AppArgs {
 	Arg<std::string> outputExtension = { "ext", "png", "output files extension" };
 	Arg<float> exposure = { "exposure", 1.0f, "exposure value" };
 	Arg<float> gamma = { "gamma", 2.2f, "gamma value" };
+	Arg<int> inFlight = { "inflight", 0, "maximum number of images loaded at once, 0 for twice the number of threads" };
+	Arg<bool> force = { "force", "process all images, even those with an output more recent than the input" };
 };
 
 void tonemap(const sibr::ImageRGB32F& hdrImg, sibr::ImageRGB& ldrImg, float exposure, float gamma) {
 	const cv::Mat & tonemaped = hdrImg.toOpenCV();
-	const cv::Mat exposed = -exposure * tonemaped;
-	cv::Mat tonemaped2;
-	cv::exp(exposed, tonemaped2);
-	tonemaped2 = cv::Scalar(1.0f, 1.0f, 1.0f) - tonemaped2;
-	if (gamma > 0.0f) {
-		cv::pow(tonemaped2, 1.0f / gamma, tonemaped2);
+	cv::Mat tonemapedRGB(tonemaped.rows, tonemaped.cols, CV_8UC3);
+	// All the steps are applied to strips of rows that stay in cache, with the vectorized OpenCV kernels,
+	// instead of full image passes.
+	const int stripRows = std::max(1, (256 * 1024) / std::max(1, int(tonemaped.cols * 3 * sizeof(float))));
+	cv::Mat strip;
+	for (int y = 0; y < tonemaped.rows; y += stripRows) {
+		const cv::Range rows(y, std::min(y + stripRows, tonemaped.rows));
+		tonemaped.rowRange(rows).convertTo(strip, CV_32F, -exposure);
+		cv::exp(strip, strip);
+		cv::subtract(cv::Scalar(1.0f, 1.0f, 1.0f), strip, strip);
+		if (gamma > 0.0f) {
+			cv::pow(strip, 1.0f / gamma, strip);
+		}
+		strip.convertTo(tonemapedRGB.rowRange(rows), CV_8UC3, 255.0f);
 	}
-	cv::Mat tonemapedRGB;
-	tonemaped2.convertTo(tonemapedRGB, CV_8UC3, 255.0f);
 	ldrImg.fromOpenCV(tonemapedRGB);
 }
 
@@ -66,19 +80,55 @@ int main(int ac, char** av) {
 		sibr::makeDirectory(outputPath);
 	}
 
-	const auto files = sibr::listFiles(inputPath, false, false, { "exr" });
+	const auto files = sibr::listFiles(inputPath, false, false, { "exr", "hdr" });
+
+	// Images are processed in parallel, and the number of images in memory is bounded.
+	sibr::ThreadPool & pool = sibr::ThreadPool::shared();
+	const int maxInFlight = args.inFlight > 0 ? int(args.inFlight) : 2 * int(pool.threadCount());
+	std::mutex mutex;
+	std::condition_variable done;
+	int inFlight = 0;
+	std::atomic<int> processed = { 0 };
+	int skipped = 0;
 
 	for (const auto& file : files) {
 		const std::string src = inputPath + "/" + file;
 		const std::string dst = outputPath + "/" + sibr::removeExtension(file) + extension;
 
-		sibr::ImageRGB32F hdrImg;
-		sibr::ImageRGB ldrImg;
-		hdrImg.load(src);
-		tonemap(hdrImg, ldrImg, args.exposure, args.gamma);
-		ldrImg.save(dst);
+		// Skip outputs more recent than their input.
+		boost::system::error_code error;
+		if (!args.force && boost::filesystem::exists(dst, error)
+			&& boost::filesystem::last_write_time(dst, error) >= boost::filesystem::last_write_time(src, error) && !error) {
+			++skipped;
+			continue;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [&]() { return inFlight < maxInFlight; });
+			++inFlight;
+		}
+		pool.push([&, src, dst]() {
+			sibr::ImageRGB32F hdrImg;
+			sibr::ImageRGB ldrImg;
+			if (hdrImg.load(src, false)) {
+				tonemap(hdrImg, ldrImg, args.exposure, args.gamma);
+				ldrImg.save(dst, false);
+				++processed;
+			} else {
+				SIBR_WRG << "Unable to load " << src << ", skipping." << std::endl;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			--inFlight;
+			done.notify_all();
+		});
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&]() { return inFlight == 0; });
 	}
 
+	SIBR_LOG << "Tonemapped " << processed.load() << " images, " << skipped << " already up to date." << std::endl;
 	return 0;
 }
 
@@ -27,6 +27,9 @@ struct UVMapperArgs : public AppArgs {
 	Arg<int> size = { "size", 4096, "target UV map width (approx.)" };
 	Arg<bool> visu = { "visu", "save visualisation" };
 	Arg<std::string> textureName = { "texture-name", "TEXTURE_NAME_TO_PUT_IN_THE_FILE", "name of the texture to reference in the output mesh (Meshlab compatible)" };
+	Arg<std::string> preset = { "preset", "balanced", "charts and packing quality: fast, balanced or best" };
+	Arg<int> clusterSize = { "cluster-size", 250000, "max. number of triangles of the clusters unwrapped in parallel (0 for a single one)" };
+	Arg<bool> cache = { "cache", "reuse the result of a previous unwrapping of the same mesh with the same options" };
 };
 
 int main(int ac, char ** av){
@@ -47,7 +50,17 @@ int main(int ac, char ** av){
 		mesh.load(args.path);
 	}
 
-	UVUnwrapper unwrapper(mesh, uint32_t(args.size));
+	UVUnwrapper::Preset preset = UVUnwrapper::Preset::BALANCED;
+	if (args.preset.get() == "fast") {
+		preset = UVUnwrapper::Preset::FAST;
+	} else if (args.preset.get() == "best") {
+		preset = UVUnwrapper::Preset::BEST;
+	} else if (args.preset.get() != "balanced") {
+		SIBR_WRG << "Unknown preset " << args.preset.get() << ", using balanced." << std::endl;
+	}
+
+	UVUnwrapper unwrapper(mesh, uint32_t(args.size), preset, uint32_t(std::max(0, args.clusterSize.get())));
+	unwrapper.useCache() = args.cache;
 	auto finalMesh = unwrapper.unwrap();
 	finalMesh->save(outputFile, true, args.textureName);
 	
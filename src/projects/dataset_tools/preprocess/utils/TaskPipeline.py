@@ -15,15 +15,45 @@ import subprocess
 import os, sys
 import re
 import shutil
+import json
+import hashlib
+import threading
+from concurrent.futures import ThreadPoolExecutor, wait, FIRST_COMPLETED
 from importlib import import_module
 from utils.convert import updateStringFromDict
 from utils.commands import runCommand
 
+# Steps can declare the files or directories they read and write:
+#     "inputs": ["${path}/colmap/stereo/meshed-delaunay.ply"],
+#     "outputs": ["${path}/colmap/stereo/unix-meshed-delaunay.ply"],
+#     "resources": { "cpu": 1, "gpu": 0 }
+# Steps with declarations only wait for the earlier steps reading or writing the same paths, and run
+# concurrently with the others within the CPU/GPU budget (args "cpu_budget" and "gpu_budget", defaulting
+# to the core count and "numGPUs"). Steps without declarations keep the sequential behavior: they wait for
+# all earlier steps, and all later steps wait for them.
+# A declared step is skipped when its command and the content of its inputs did not change since its last
+# successful run and its outputs exist. Signatures are stored in the "pipeline_cache" file of the args,
+# ${path}/.pipeline_cache.json by default; set "force_rerun" in the args to run everything.
+
+def pathsOverlap(a, b):
+    a = os.path.normcase(os.path.abspath(a))
+    b = os.path.normcase(os.path.abspath(b))
+    return a == b or a.startswith(b + os.sep) or b.startswith(a + os.sep)
+
 class TaskPipeline:
     def __init__(self, args, steps, programs):
         self.args = args
         self.steps = steps
         self.programs = programs
+        self.lock = threading.Lock()
+        self.cachePath = args.get("pipeline_cache", os.path.join(args["path"], ".pipeline_cache.json") if "path" in args else None)
+        self.cache = { "steps": {}, "files": {} }
+        if self.cachePath and os.path.isfile(self.cachePath):
+            try:
+                with open(self.cachePath, "r") as cacheFile:
+                    self.cache = json.load(cacheFile)
+            except (ValueError, OSError):
+                print("Ignoring unreadable pipeline cache %s." % self.cachePath)
 
     def isExpressionValid(self, expression):
         if not re.match(r"^((?:not|and|or|is|in|\$\{\w+\})+\s*)+$", expression):
@@ -31,71 +61,207 @@ class TaskPipeline:
 
         return eval(updateStringFromDict(expression, self.args))
 
-    def runProcessSteps(self):
-        for step in self.steps:
-#            print("RUN STEP ", step)
-            if "if" in step and not self.isExpressionValid(step["if"]):
-                print("Nothing to do on step %s. Skipping." % (step["name"]))
-                continue
+    def isDeclared(self, step):
+        return "inputs" in step or "outputs" in step
+
+    def declaredPaths(self, step, key):
+        return [updateStringFromDict(path, self.args) for path in step.get(key, [])]
+
+    def fileHash(self, path):
+        # Hashes are cached by size and modification time, so unchanged inputs are not read again.
+        stat = os.stat(path)
+        with self.lock:
+            known = self.cache["files"].get(path)
+        if known and known[0] == stat.st_size and known[1] == stat.st_mtime_ns:
+            return known[2]
+        digest = hashlib.sha1()
+        with open(path, "rb") as file:
+            for block in iter(lambda: file.read(1 << 20), b""):
+                digest.update(block)
+        with self.lock:
+            self.cache["files"][path] = [stat.st_size, stat.st_mtime_ns, digest.hexdigest()]
+        return digest.hexdigest()
+
+    def pathHash(self, path):
+        if os.path.isfile(path):
+            return self.fileHash(path)
+        if os.path.isdir(path):
+            digest = hashlib.sha1()
+            for root, dirs, files in os.walk(path):
+                dirs.sort()
+                for name in sorted(files):
+                    filePath = os.path.join(root, name)
+                    digest.update(os.path.relpath(filePath, path).encode("utf-8"))
+                    digest.update(self.fileHash(filePath).encode("utf-8"))
+            return digest.hexdigest()
+        return "missing"
 
-            print("Running step %s..." % step["name"])
+    def stepCommand(self, step):
+        if "app" in step:
             command_args = []
             for i in range(5):
-                if "app" in step and "optional_arg"+str(i) in step and self.isExpressionValid(step["optional_arg"+str(i)][0]):
+                if "optional_arg"+str(i) in step and self.isExpressionValid(step["optional_arg"+str(i)][0]):
                     optional_arg = []
                     for optional_arg in step["optional_arg"+str(i)][1:]:
 #                        print("Parsing... ", optional_arg, " ", updateStringFromDict(optional_arg, self.args))
                         command_args.append(updateStringFromDict(optional_arg, self.args))
 
-            if "app" in step:
-#                print("Parsing command args...")
-                for command_arg in step["command_args"]:
+#            print("Parsing command args...")
+            for command_arg in step["command_args"]:
+#                print("Parsing... ", command_arg, " ", updateStringFromDict(command_arg, self.args))
+                command_args.append(updateStringFromDict(command_arg, self.args))
+
+            # for optionally quitting
+            if "optional_final_arg" in step and self.isExpressionValid(step["optional_final_arg"][0]):
+                for command_arg in step["optional_final_arg"][1:]:
 #                    print("Parsing... ", command_arg, " ", updateStringFromDict(command_arg, self.args))
                     command_args.append(updateStringFromDict(command_arg, self.args))
+            return command_args
+
+        return { key: ([updateStringFromDict(item, self.args) for item in val]
+                        if type(val) is list else
+                        updateStringFromDict(val, self.args))
+                            for key, val in step["function_args"].items() }
+
+    def stepSignature(self, step, command):
+        inputs = [[path, self.pathHash(path)] for path in self.declaredPaths(step, "inputs")]
+        program = self.programs[step["app"]]["path"] if "app" in step else step["function"]
+        return hashlib.sha1(json.dumps([program, command, inputs], sort_keys=True).encode("utf-8")).hexdigest()
+
+    def isUpToDate(self, step, signature):
+        if self.args.get("force_rerun") or not self.cachePath or not self.isDeclared(step):
+            return False
+        with self.lock:
+            known = self.cache["steps"].get(step["name"])
+        return known is not None and known["signature"] == signature and all(os.path.exists(path) for path in self.declaredPaths(step, "outputs"))
+
+    def saveCache(self):
+        if not self.cachePath or self.args["dry_run"]:
+            return
+        with self.lock:
+            with open(self.cachePath, "w") as cacheFile:
+                json.dump(self.cache, cacheFile)
+
+    def runStep(self, step):
+#        print("RUN STEP ", step)
+        if "if" in step and not self.isExpressionValid(step["if"]):
+            print("Nothing to do on step %s. Skipping." % (step["name"]))
+            return True
+
+        if not "app" in step and not "function" in step:
+            print("Nothing to do on step %s. Skipping." % (step["name"]))
+            return True
 
-                # for optionally quitting
-                if "app" in step and "optional_final_arg" in step and self.isExpressionValid(step["optional_final_arg"][0]):
-                    for command_arg in step["optional_final_arg"][1:]:
-#                        print("Parsing... ", command_arg, " ", updateStringFromDict(command_arg, self.args))
-                        command_args.append(updateStringFromDict(command_arg, self.args))
-
-                if self.args["dry_run"]:
-                    success = True
-                else:
-                    completedProcess = runCommand(self.programs[step["app"]]["path"], command_args)
-                    success = completedProcess.returncode == 0
-
-            elif "function" in step:
-                if '.' in step["function"]:
-                    currentModuleName, currentFunctionName = step["function"].rsplit('.', 1)
-                    currentFunction = getattr(import_module(currentModuleName), currentFunctionName)
-                else:
-                    print("Missing module name for function %s. Aborting." % (step["function"]))
-                    sys.exit(1)
-
-                if self.args["dry_run"]:
-                    print('function : %s(%s)' % (step["function"], ', '.join([ "%s=%s" % (key, ([updateStringFromDict(item, self.args) for item in val]
-                                                                                                 if type(val) is list else
-                                                                                                 updateStringFromDict(val, self.args)))
-                                                                                                    for key, val in step["function_args"].items()])))
-                else:
-                    ret = currentFunction(**{ key: ([updateStringFromDict(item, self.args) for item in val]
-                                                if type(val) is list else
-                                                updateStringFromDict(val, self.args))
-                                                    for key, val in step["function_args"].items() })
-                    if ret != None:
-                        self.args[ret[0]] = ret[1]
-                        print ("After step {}: Setting args[{}]={}".format( step["function"], ret[0] , ret[1], ret[0], self.args[ret[0]]))
+        command = self.stepCommand(step)
+        signature = self.stepSignature(step, command) if self.isDeclared(step) else None
+        if signature and self.isUpToDate(step, signature):
+            print("Step %s is up to date. Skipping." % (step["name"]))
+            known = self.cache["steps"][step["name"]]
+            if known.get("ret") != None:
+                self.args[known["ret"][0]] = known["ret"][1]
+            return True
 
+        print("Running step %s..." % step["name"])
+        ret = None
+        if "app" in step:
+            if self.args["dry_run"]:
                 success = True
             else:
-                print("Nothing to do on step %s. Skipping." % (step["name"]))
-                continue
+                completedProcess = runCommand(self.programs[step["app"]]["path"], command)
+                success = completedProcess.returncode == 0
 
-            if success:
-                print("Step %s successful." % (step["name"]))
+        else:
+            if '.' in step["function"]:
+                currentModuleName, currentFunctionName = step["function"].rsplit('.', 1)
+                currentFunction = getattr(import_module(currentModuleName), currentFunctionName)
             else:
-                sys.stdout.flush()
-                sys.stderr.flush()
-                print("Error on step %s. Aborting." % (step["name"]))
+                print("Missing module name for function %s. Aborting." % (step["function"]))
                 sys.exit(1)
+
+            if self.args["dry_run"]:
+                print('function : %s(%s)' % (step["function"], ', '.join([ "%s=%s" % (key, val) for key, val in command.items()])))
+            else:
+                ret = currentFunction(**command)
+                if ret != None:
+                    self.args[ret[0]] = ret[1]
+                    print ("After step {}: Setting args[{}]={}".format( step["function"], ret[0] , ret[1], ret[0], self.args[ret[0]]))
+
+            success = True
+
+        if success:
+            print("Step %s successful." % (step["name"]))
+            if signature:
+                with self.lock:
+                    self.cache["steps"][step["name"]] = { "signature": signature, "ret": ret }
+                self.saveCache()
+        return success
+
+    def stepDependencies(self):
+        # A step waits for the earlier steps touching the same paths (read after write, write after read
+        # and write after write), and for the undeclared steps around it.
+        dependencies = []
+        for i, step in enumerate(self.steps):
+            if not self.isDeclared(step):
+                dependencies.append(set(range(i)))
+                continue
+            inputs = self.declaredPaths(step, "inputs")
+            outputs = self.declaredPaths(step, "outputs")
+            deps = set()
+            for j in range(i):
+                other = self.steps[j]
+                if not self.isDeclared(other):
+                    deps.add(j)
+                    continue
+                otherInputs = self.declaredPaths(other, "inputs")
+                otherOutputs = self.declaredPaths(other, "outputs")
+                if any(pathsOverlap(a, b) for a in inputs + outputs for b in otherOutputs) or \
+                   any(pathsOverlap(a, b) for a in outputs for b in otherInputs):
+                    deps.add(j)
+            dependencies.append(deps)
+        return dependencies
+
+    def runProcessSteps(self):
+        dependencies = self.stepDependencies()
+        cpuBudget = int(self.args.get("cpu_budget", os.cpu_count() or 1))
+        gpuBudget = int(self.args.get("gpu_budget", self.args.get("numGPUs", 1)))
+
+        def cost(step):
+            resources = step.get("resources", {})
+            # A step asking for more than the budget runs alone.
+            return min(int(resources.get("cpu", 1)), cpuBudget), min(int(resources.get("gpu", 0)), gpuBudget)
+
+        pending = list(range(len(self.steps)))
+        done = set()
+        running = {}
+        usedCpu, usedGpu = 0, 0
+        failed = None
+        with ThreadPoolExecutor(max_workers=max(1, len(self.steps))) as executor:
+            while (pending and failed is None) or running:
+                if failed is None:
+                    for i in list(pending):
+                        if not dependencies[i] <= done:
+                            continue
+                        cpu, gpu = cost(self.steps[i])
+                        if running and (usedCpu + cpu > cpuBudget or usedGpu + gpu > gpuBudget):
+                            continue
+                        pending.remove(i)
+                        usedCpu, usedGpu = usedCpu + cpu, usedGpu + gpu
+                        running[executor.submit(self.runStep, self.steps[i])] = i
+
+                finished, _ = wait(list(running.keys()), return_when=FIRST_COMPLETED)
+                for future in finished:
+                    i = running.pop(future)
+                    cpu, gpu = cost(self.steps[i])
+                    usedCpu, usedGpu = usedCpu - cpu, usedGpu - gpu
+                    if future.exception() is not None:
+                        print("Step %s raised: %s" % (self.steps[i]["name"], future.exception()))
+                    if future.exception() is None and future.result():
+                        done.add(i)
+                    elif failed is None:
+                        failed = i
+
+        if failed is not None:
+            sys.stdout.flush()
+            sys.stderr.flush()
+            print("Error on step %s. Aborting." % (self.steps[failed]["name"]))
+            sys.exit(1)
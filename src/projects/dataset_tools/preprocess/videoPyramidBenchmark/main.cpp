@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include "core/system/CommandLineArgs.hpp"
+#include "core/system/SimpleTimer.hpp"
+#include "core/video/VideoUtils.hpp"
+
+#include <functional>
+
+using namespace sibr;
+
+
+struct VideoPyramidBenchmarkArgs : virtual AppArgs {
+	Arg<std::string> video = { "video", "", "input video, a random volume is used if empty" };
+	Arg<int> width = { "width", 640, "width of the random volume" };
+	Arg<int> height = { "height", 360, "height of the random volume" };
+	Arg<int> frames = { "frames", 120, "number of frames of the random volume" };
+	Arg<int> levels = { "levels", 5, "number of pyramid levels" };
+	Arg<int> repeats = { "repeats", 3, "number of runs per measure" };
+	Arg<bool> noSpatial = { "no-spatial", "only downsample in time" };
+};
+
+namespace {
+
+	// Previous implementation, kept as the reference: whole volume blur, then decimation or zero insertion.
+
+	PyramidLayer referenceTemporalBlur(const PyramidLayer & layer, float scaling)
+	{
+		const cv::Mat kernel = (scaling / 16.0f)*(cv::Mat_<float>(5, 1) << 1, 4, 6, 4, 1);
+		cv::Mat vol = layer.volume.clone();
+		cv::filter2D(vol, vol, -1, kernel, { -1,-1 }, 0.0, cv::BORDER_DEFAULT);
+		return PyramidLayer(vol, layer.w, layer.h);
+	}
+
+	PyramidLayer referenceDownscale(const PyramidLayer & layer, const PyramidParameters & params)
+	{
+		const PyramidLayer blured = referenceTemporalBlur(layer, 1.0f);
+		PyramidLayer out = params.splacialDS ?
+			PyramidLayer((layer.w + 1) / 2, (layer.h + 1) / 2, (layer.l + 1) / 2) :
+			PyramidLayer(layer.w, layer.h, (layer.l + 1) / 2);
+
+		for (int t = 0; t < out.l; ++t) {
+			cv::Mat sliceCurrent = blured.volume.row(2 * t).reshape(3, layer.h);
+			cv::Mat sliceDecimated = out.volume.row(t).reshape(3, out.h);
+			if (params.splacialDS) {
+				cv::pyrDown(sliceCurrent, sliceDecimated);
+			} else {
+				sliceCurrent.copyTo(sliceDecimated);
+			}
+		}
+		return out;
+	}
+
+	PyramidLayer referenceUpscale(const PyramidLayer & layerUp, const PyramidLayer & layerDown, const PyramidParameters & params)
+	{
+		PyramidLayer out(layerUp.w, layerUp.h, layerUp.l);
+		out.volume.setTo(0.0f);
+		for (int t = 0; t < layerDown.l; ++t) {
+			cv::Mat sliceUp = out.volume.row(2 * t).reshape(3, layerUp.h);
+			cv::Mat sliceDown = layerDown.volume.row(t).reshape(3, layerDown.h);
+			if (params.splacialDS) {
+				cv::pyrUp(sliceDown, sliceUp, sliceUp.size());
+			} else {
+				sliceDown.copyTo(sliceUp);
+			}
+		}
+		return referenceTemporalBlur(out, 2.0f);
+	}
+
+	VideoLaplacianPyramid referenceLaplacianPyramid(const PyramidLayer & vid, int nLevels, const PyramidParameters & params)
+	{
+		VideoLaplacianPyramid out;
+		out.params = params;
+		PyramidLayer currentLayer = vid.clone();
+		for (int i = 0; i < nLevels - 1; ++i) {
+			PyramidLayer down = referenceDownscale(currentLayer, params);
+			PyramidLayer up = referenceUpscale(currentLayer, down, params);
+			out.layers.push_back(currentLayer - up);
+			currentLayer = down;
+		}
+		out.layers.push_back(currentLayer);
+		return out;
+	}
+
+	double maxDifference(const PyramidLayer & a, const PyramidLayer & b)
+	{
+		if (a.volume.size() != b.volume.size()) {
+			return std::numeric_limits<double>::max();
+		}
+		return cv::norm(a.volume, b.volume, cv::NORM_INF);
+	}
+
+	double maxDifference(const std::vector<PyramidLayer> & a, const std::vector<PyramidLayer> & b)
+	{
+		if (a.size() != b.size()) {
+			return std::numeric_limits<double>::max();
+		}
+		double diff = 0.0;
+		for (size_t i = 0; i < a.size(); ++i) {
+			diff = std::max(diff, maxDifference(a[i], b[i]));
+		}
+		return diff;
+	}
+
+	/// Best time over a few runs, in milliseconds.
+	double measure(const std::function<void()> & task, int repeats)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (int r = 0; r < std::max(repeats, 1); ++r) {
+			sibr::Timer timer(true);
+			task();
+			best = std::min(best, timer.deltaTimeFromLastTic<Timer::micro>() / 1000.0);
+		}
+		return best;
+	}
+
+	void report(const std::string & name, double reference, double current, double diff)
+	{
+		SIBR_LOG << name << ": reference " << reference << "ms, current " << current << "ms (x"
+			<< (current > 0.0 ? reference / current : 0.0) << "), max abs diff " << diff << std::endl;
+	}
+}
+
+int main(int ac, char** av) {
+
+	// Parse Command-line Args
+	sibr::CommandLineArgs::parseMainArgs(ac, av);
+
+	VideoPyramidBenchmarkArgs args;
+
+	PyramidLayer input;
+	const std::string videoPath = args.video;
+	if (!videoPath.empty()) {
+		sibr::Video video(videoPath);
+		input = PyramidLayer(video.getVolume(), video.getResolution()[0], video.getResolution()[1]);
+	} else {
+		// Random values in [0,255], like a decoded video.
+		input = PyramidLayer(args.width, args.height, args.frames);
+		cv::randu(input.volume, 0.0f, 255.0f);
+	}
+	SIBR_LOG << "Volume: " << input.w << "x" << input.h << ", " << input.l << " frames, " << int(args.levels) << " levels." << std::endl;
+
+	PyramidParameters params;
+	params.num_levels = args.levels;
+	params.splacialDS = !args.noSpatial;
+	const int repeats = args.repeats;
+
+	PyramidLayer refBlur, curBlur;
+	const double refBlurTime = measure([&]() { refBlur = referenceTemporalBlur(input, 1.0f); }, repeats);
+	const double curBlurTime = measure([&]() { curBlur = temporalBlur(input, params); }, repeats);
+	report("Temporal blur", refBlurTime, curBlurTime, maxDifference(refBlur, curBlur));
+
+	PyramidLayer refDown, curDown;
+	const double refDownTime = measure([&]() { refDown = referenceDownscale(input, params); }, repeats);
+	const double curDownTime = measure([&]() { curDown = downscale(input, params); }, repeats);
+	report("Downscale", refDownTime, curDownTime, maxDifference(refDown, curDown));
+
+	PyramidLayer refUp, curUp;
+	const double refUpTime = measure([&]() { refUp = referenceUpscale(input, refDown, params); }, repeats);
+	const double curUpTime = measure([&]() { curUp = upscale(input, refDown, params); }, repeats);
+	report("Upscale", refUpTime, curUpTime, maxDifference(refUp, curUp));
+
+	VideoLaplacianPyramid refPyr, curPyr;
+	const double refPyrTime = measure([&]() { refPyr = referenceLaplacianPyramid(input, params.num_levels, params); }, repeats);
+	const double curPyrTime = measure([&]() { curPyr = buildVideoLaplacianPyramid(input, params.num_levels, params); }, repeats);
+	report("Laplacian pyramid", refPyrTime, curPyrTime, maxDifference(refPyr.layers, curPyr.layers));
+
+	PyramidLayer collapsed;
+	const double collapseTime = measure([&]() { collapsed = curPyr.collapse(); }, repeats);
+	SIBR_LOG << "Collapse: " << collapseTime << "ms, reconstruction max abs error " << maxDifference(collapsed, input) << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -19,6 +19,7 @@
 #include <core/renderer/DepthRenderer.hpp>
 #include <core/raycaster/Raycaster.hpp>
 #include <core/view/SceneDebugView.hpp>
+#include <core/video/FFmpegVideoEncoder.hpp>
 #include <algorithm>
 #include <boost/filesystem.hpp>
 #include <regex>
@@ -122,16 +123,19 @@ int main(int ac, char** av)
 	// Window setup
 	sibr::Window		window(PROGRAM_NAME, sibr::Vector2i(50, 50), myArgs, getResourcesDirectory() + "/gaussians/" + PROGRAM_NAME + ".ini");
 
+	// No ImGui context for offscreen or headless batch renders.
 	bool messageRead = false;
-	ImGuiSettingsHandler ini_handler;
-	ini_handler.TypeName = "UserData";
-	ini_handler.UserData = &messageRead;
-	ini_handler.TypeHash = ImHash("UserData", 0, 0);
-	ini_handler.ReadOpenFn = User_ReadOpen;
-	ini_handler.ReadLineFn = User_ReadLine;
-	ini_handler.WriteAllFn = User_WriteAll;
-	ImGui::GetCurrentContext()->SettingsHandlers.push_back(ini_handler);
-	window.loadSettings();
+	if (window.isGUIEnabled()) {
+		ImGuiSettingsHandler ini_handler;
+		ini_handler.TypeName = "UserData";
+		ini_handler.UserData = &messageRead;
+		ini_handler.TypeHash = ImHash("UserData", 0, 0);
+		ini_handler.ReadOpenFn = User_ReadOpen;
+		ini_handler.ReadLineFn = User_ReadLine;
+		ini_handler.WriteAllFn = User_WriteAll;
+		ImGui::GetCurrentContext()->SettingsHandlers.push_back(ini_handler);
+		window.loadSettings();
+	}
 
 	std::string cfgLine;
 	std::ifstream cfgFile(myArgs.modelPath.get() + "/cfg_args");
@@ -185,6 +189,13 @@ int main(int ac, char** av)
 		plyfile += "/iteration_" + myArgs.iteration.get() + "/point_cloud.ply";
 	}
 
+	std::vector<std::string> compared;
+	for (const std::string & path : sibr::split(myArgs.compare.get(), ','))
+	{
+		if (!path.empty())
+			compared.push_back(path);
+	}
+
 	// Setup the scene: load the proxy, create the texture arrays.
 	const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
 
@@ -212,12 +223,32 @@ int main(int ac, char** av)
 	const unsigned int sceneResHeight = usedResolution.y();
 
 	// Create the ULR view.
-	GaussianView::Ptr	gaussianView(new GaussianView(scene, sceneResWidth, sceneResHeight, plyfile.c_str(), &messageRead, sh_degree, white_background, !myArgs.noInterop, device));
+	GaussianView::Ptr	gaussianView(new GaussianView(scene, sceneResWidth, sceneResHeight, plyfile.c_str(), &messageRead, sh_degree, white_background, !myArgs.noInterop, device, !myArgs.noCache,
+		GaussianSHBuffer::storageFromName(myArgs.shStorage), myArgs.shCodebook, myArgs.lod, myArgs.vramBudget, myArgs.fallbackRGBA8, myArgs.splitFrame,
+		myArgs.pruneOpacity, myArgs.pruneBudget, compared));
+	if (myArgs.watch) {
+		// The training may overwrite the model, the scene watches the dataset files.
+		gaussianView->watchModel(true);
+	}
+	if (!myArgs.compositeMesh.get().empty()) {
+		sibr::Mesh::Ptr mesh(new sibr::Mesh(true));
+		if (mesh->load(myArgs.compositeMesh)) {
+			// The texture is stored next to the mesh, otherwise vertex colors are used.
+			sibr::Texture2DRGB::Ptr texture;
+			const std::string texturePath = sibr::parentDirectory(myArgs.compositeMesh) + "/" + mesh->getTextureImageFileName();
+			sibr::ImageRGB image;
+			if (!mesh->getTextureImageFileName().empty() && mesh->hasTexCoords() && sibr::fileExists(texturePath) && image.load(texturePath, false)) {
+				texture.reset(new sibr::Texture2DRGB(image, SIBR_GPU_LINEAR_SAMPLING));
+			}
+			else if (!mesh->hasColors()) {
+				mesh->colors(sibr::Mesh::Colors(mesh->vertices().size(), sibr::Vector3f(0.7f, 0.7f, 0.7f)));
+			}
+			gaussianView->compositeMesh(mesh, texture);
+		}
+	}
 
 	// Raycaster.
-	std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-	raycaster->init();
-	raycaster->addMesh(scene->proxies()->proxy());
+	std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 	// Camera handler for main view.
 	sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
@@ -243,7 +274,30 @@ int main(int ac, char** av)
 	if (myArgs.pathFile.get() !=  "" ) 
 	{
 		generalCamera->getCameraRecorder().loadPath(myArgs.pathFile.get(), usedResolution.x(), usedResolution.y());
-		generalCamera->getCameraRecorder().recordOfflinePath(myArgs.outPath, multiViewManager.getIBRSubView("Point view"), "");
+		CameraRecorder::OfflineOptions options;
+		options.framesInFlight = myArgs.framesInFlight;
+		options.extension = myArgs.pathFormat;
+		options.saveImages = !(myArgs.pathVideoOnly && !myArgs.pathVideo.get().empty());
+		// Frames go straight from the render targets to the encoder, converted and read back on the GPU side.
+		std::unique_ptr<FFVideoEncoder> encoder;
+		if (!myArgs.pathVideo.get().empty()) {
+			FFVideoEncoder::Options encoderOptions;
+			encoderOptions.hardware = FFVideoEncoder::Hardware::AUTO;
+			encoderOptions.queueSize = 8;
+			encoderOptions.policy = FFVideoEncoder::QueuePolicy::BLOCK;
+			encoder.reset(new FFVideoEncoder(myArgs.pathVideo, 30, usedResolution.cast<int>(), encoderOptions));
+			if (encoder->isFine()) {
+				options.frameSink = [&encoder](const IRenderTarget & frame) { *encoder << frame; };
+			}
+			else {
+				SIBR_WRG << "Unable to encode " << myArgs.pathVideo.get() << ", saving images instead." << std::endl;
+				options.saveImages = true;
+			}
+		}
+		generalCamera->getCameraRecorder().recordOfflinePath(myArgs.outPath, multiViewManager.getIBRSubView("Point view"), "", options);
+		if (encoder) {
+			encoder->close();
+		}
 		if( !myArgs.noExit )
 			exit(0);
 	}
@@ -49,6 +49,21 @@ namespace sibr {
 		Arg<int> device = {"device", 0, "CUDA device index"};
 		Arg<bool> loadImages = { "load_images", "Whether or not to load images for scene overview."};
 		Arg<bool> noInterop = { "no_interop", "Don't try to use interop (may be required for unconventional OpenGL setups, like WSL)" };
+		Arg<bool> fallbackRGBA8 = { "fallback_rgba8", "Without interop, transfer 8-bit RGBA images instead of float RGB (3x less data)" };
+		Arg<bool> noCache = { "no_cache", "Don't read or write the preprocessed model cache (point_cloud.sibrgs)" };
+		Arg<std::string> shStorage = { "sh_storage", "float", "GPU storage of SH coefficients: float, half, or vq (half DC band and codebook for higher bands)" };
+		Arg<int> shCodebook = { "sh_codebook", 4096, "Number of codewords for vq SH storage (at most 65536)" };
+		Arg<int> vramBudget = { "vram_budget", 0, "GPU memory budget for the Gaussians in MB, larger models are streamed by chunks from the model cache (0 for no limit)" };
+		Arg<int> splitFrame = { "split_frame", 1, "Number of GPUs rendering horizontal bands of each frame, starting at --device" };
+		Arg<int> framesInFlight = { "frames_in_flight", 4, "Frames of --pathFile rendered ahead of their readback and encoding (1 to render them one at a time)" };
+		Arg<std::string> pathVideo = { "path_video", "", "Also encode the --pathFile frames to this video file" };
+		Arg<bool> pathVideoOnly = { "path_video_only", "Only encode the --pathFile video, do not save the frames as images" };
+		Arg<std::string> pathFormat = { "path_format", ".png", "Image format of the --pathFile frames, .exr keeps the float values" };
+		Arg<float> pruneOpacity = { "prune_opacity", 0.0f, "Drop the Gaussians less opaque than this at load time" };
+		Arg<int> pruneBudget = { "prune_budget", 0, "Keep at most this many Gaussians at load time, those contributing most to the input cameras (0 for no limit)" };
+		Arg<std::string> compare = { "compare", "", "Comma separated PLY files of other models of the scene, loaded in the same view to toggle (Tab) or blend with" };
+		Arg<bool> lod = { "lod", "Build a level-of-detail hierarchy to render large scenes with fewer Gaussians when seen from afar" };
+		Arg<std::string> compositeMesh = { "composite_mesh", "", "Opaque mesh rendered inside the Gaussians, composited with depth (requires interop)" };
 	};
 
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianBand.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <cub/cub.cuh>
+#include <algorithm>
+
+#define BLOCK_SIZE 256
+
+// Tile size of the rasterizer, footprints are rounded to whole tiles.
+#define TILE_SIZE 16
+
+struct BandCamera
+{
+	float view[16]; ///< Column major.
+	float proj[16]; ///< Column major, full view-projection.
+	float focal; ///< Largest focal length, in pixels.
+	float limx, limy; ///< Clamping of the Jacobian, as in the rasterizer.
+	int height;
+	float rowBegin, rowEnd;
+	float scaleModifier;
+};
+
+__global__ void overlapBandCUDA(int n, const float* pos, const float* scale, BandCamera cam, char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float x = pos[3 * idx + 0];
+	const float y = pos[3 * idx + 1];
+	const float z = pos[3 * idx + 2];
+	const float* V = cam.view;
+	const float* P = cam.proj;
+	const float tx = V[0] * x + V[4] * y + V[8] * z + V[12];
+	const float ty = V[1] * x + V[5] * y + V[9] * z + V[13];
+	const float tz = V[2] * x + V[6] * y + V[10] * z + V[14];
+
+	// Same near plane as the rasterizer.
+	if (tz <= 0.2f)
+	{
+		flags[idx] = 0;
+		return;
+	}
+
+	const float hy = P[1] * x + P[5] * y + P[9] * z + P[13];
+	const float hw = P[3] * x + P[7] * y + P[11] * z + P[15];
+	const float ndcY = hy / (hw + 0.0000001f);
+	const float pixY = ((ndcY + 1.0f) * cam.height - 1.0f) * 0.5f;
+
+	// The 2D covariance is J W S S^T W^T J^T: its largest standard deviation is bounded
+	// by the largest scale times the Frobenius norm of J, plus the low-pass dilation.
+	const float sx = scale[3 * idx + 0], sy = scale[3 * idx + 1], sz = scale[3 * idx + 2];
+	const float smax = fmaxf(sx, fmaxf(sy, sz)) * cam.scaleModifier;
+	const float cx = fminf(cam.limx, fmaxf(-cam.limx, tx / tz));
+	const float cy = fminf(cam.limy, fmaxf(-cam.limy, ty / tz));
+	const float jnorm = cam.focal / tz * sqrtf(2.0f + cx * cx + cy * cy);
+	const float radius = ceilf(3.0f * sqrtf(smax * smax * jnorm * jnorm + 0.3f)) + TILE_SIZE;
+
+	flags[idx] = pixY + radius >= cam.rowBegin && pixY - radius < cam.rowEnd;
+}
+
+__global__ void gatherBandCUDA(int n, const int* list, const float* pos, const float* rot, const float* scale, const float* opacity,
+	float* outPos, float* outRot, float* outScale, float* outOpacity)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const int src = list[idx];
+	for (int k = 0; k < 3; k++)
+	{
+		outPos[3 * idx + k] = pos[3 * src + k];
+		outScale[3 * idx + k] = scale[3 * src + k];
+	}
+	for (int k = 0; k < 4; k++)
+		outRot[4 * idx + k] = rot[4 * src + k];
+	outOpacity[idx] = opacity[src];
+}
+
+__global__ void clearBandCUDA(int n, int pixels, int offset, const float* background, float* image)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	for (int c = 0; c < 3; c++)
+		image[c * pixels + offset + idx] = background[c];
+}
+
+namespace {
+
+	int blocks(int n)
+	{
+		return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+}
+
+namespace sibr {
+
+	GaussianBand::GaussianBand(void)
+	{
+	}
+
+	GaussianBand::~GaussianBand(void)
+	{
+		release();
+	}
+
+	void GaussianBand::release(void)
+	{
+		for (void* ptr : { (void*)_flags, (void*)_selected, (void*)_numSelected, _scanTemp,
+			(void*)_bandPos, (void*)_bandRot, (void*)_bandScale, (void*)_bandOpacity, (void*)_bandColors })
+			cudaFree(ptr);
+		_flags = nullptr;
+		_selected = _numSelected = nullptr;
+		_scanTemp = nullptr;
+		_scanTempBytes = 0;
+		_bandPos = _bandRot = _bandScale = _bandOpacity = _bandColors = nullptr;
+		_capacity = 0;
+		_count = 0;
+		_active = 0;
+	}
+
+	int GaussianBand::update(int count, const float * params, int width, int height, float tanFovx, float tanFovy, float scaleModifier,
+		int rowBegin, int rowEnd, const float * pos, const float * rot, const float * scale, const float * opacity)
+	{
+		if (count != _count)
+		{
+			release();
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_flags, count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_selected, sizeof(int) * count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_numSelected, sizeof(int)));
+			cub::DeviceSelect::Flagged(nullptr, _scanTempBytes, cub::CountingInputIterator<int>(0), _flags, _selected, _numSelected, count);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_scanTemp, _scanTempBytes));
+			_count = count;
+		}
+
+		BandCamera cam;
+		std::copy(params, params + 16, cam.view);
+		std::copy(params + 16, params + 32, cam.proj);
+		cam.focal = std::max(width / (2.0f * tanFovx), height / (2.0f * tanFovy));
+		cam.limx = 1.3f * tanFovx;
+		cam.limy = 1.3f * tanFovy;
+		cam.height = height;
+		cam.rowBegin = float(rowBegin);
+		cam.rowEnd = float(rowEnd);
+		cam.scaleModifier = scaleModifier;
+
+		overlapBandCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos, scale, cam, _flags);
+		CUDA_SAFE_CALL(cub::DeviceSelect::Flagged(_scanTemp, _scanTempBytes, cub::CountingInputIterator<int>(0),
+			_flags, _selected, _numSelected, count));
+		CUDA_SAFE_CALL(cudaMemcpy(&_active, _numSelected, sizeof(int), cudaMemcpyDeviceToHost));
+
+		const int n = _active;
+		if (n > _capacity)
+		{
+			// Grow with some slack, the footprint of a band changes with every camera move.
+			const int capacity = std::min(count, n + n / 4);
+			for (void* ptr : { (void*)_bandPos, (void*)_bandRot, (void*)_bandScale, (void*)_bandOpacity, (void*)_bandColors })
+				cudaFree(ptr);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_bandPos, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_bandRot, sizeof(float) * 4 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_bandScale, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_bandOpacity, sizeof(float) * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_bandColors, sizeof(float) * 3 * capacity));
+			_capacity = capacity;
+		}
+		if (n > 0)
+		{
+			gatherBandCUDA << <blocks(n), BLOCK_SIZE >> > (n, _selected, pos, rot, scale, opacity,
+				_bandPos, _bandRot, _bandScale, _bandOpacity);
+		}
+		return n;
+	}
+
+	void GaussianBand::clear(float * image, int width, int height, int rowBegin, int rowEnd, const float * background)
+	{
+		const int n = width * (rowEnd - rowBegin);
+		if (n > 0)
+			clearBandCUDA << <blocks(n), BLOCK_SIZE >> > (n, width * height, width * rowBegin, background, image);
+	}
+
+	void GaussianBand::computeColors(int degree, const float * pos, const GaussianSHBuffer & shs, const float * campos)
+	{
+		if (_active > 0)
+			shs.computeColors(degree, pos, campos, _bandColors, _active, _selected);
+	}
+
+} /*namespace sibr*/
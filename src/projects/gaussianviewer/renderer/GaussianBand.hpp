@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "GaussianSHBuffer.hpp"
+
+namespace sibr {
+
+	/**
+	 * \class GaussianBand
+	 * \brief Gaussians whose screen footprint may overlap a band of image rows.
+	 * The footprint is bounded conservatively from the largest scale and the norm
+	 * of the projection Jacobian, so that every Gaussian the rasterizer would
+	 * blend in the band is kept. The selection is compacted and gathered on the
+	 * current device every frame, colors are evaluated for the selection only.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianBand
+	{
+	public:
+
+		/// Constructor.
+		GaussianBand(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianBand(void);
+
+		GaussianBand(const GaussianBand &) = delete;
+		GaussianBand & operator=(const GaussianBand &) = delete;
+
+		/** Select and gather the Gaussians overlapping a band.
+		 * \param count number of Gaussians of the model
+		 * \param params host view (16 floats), projection (16 floats) and position (3 floats), as given to the rasterizer
+		 * \param width image width
+		 * \param height image height
+		 * \param tanFovx tangent of the half horizontal field of view
+		 * \param tanFovy tangent of the half vertical field of view
+		 * \param scaleModifier scale multiplier used by the rasterizer
+		 * \param rowBegin first row of the band
+		 * \param rowEnd row after the last one of the band
+		 * \param pos device positions
+		 * \param rot device rotations
+		 * \param scale device scales
+		 * \param opacity device opacities
+		 * \return the number of selected Gaussians
+		 */
+		int update(int count, const float * params, int width, int height, float tanFovx, float tanFovy, float scaleModifier,
+			int rowBegin, int rowEnd, const float * pos, const float * rot, const float * scale, const float * opacity);
+
+		/** Evaluate the view dependent colors of the selected Gaussians.
+		 * \param degree the SH degree to evaluate
+		 * \param pos device positions of the model
+		 * \param shs the model SH coefficients
+		 * \param campos device camera position
+		 */
+		void computeColors(int degree, const float * pos, const GaussianSHBuffer & shs, const float * campos);
+
+		/** Fill the band of an image with the background, when no Gaussian overlaps it.
+		 * \param image device planar float RGB image
+		 * \param width image width
+		 * \param height image height
+		 * \param rowBegin first row of the band
+		 * \param rowEnd row after the last one of the band
+		 * \param background device background color
+		 */
+		static void clear(float * image, int width, int height, int rowBegin, int rowEnd, const float * background);
+
+		/** \return the number of Gaussians selected by the last update. */
+		int active(void) const { return _active; }
+
+		/** \name Gathered attributes of the selected Gaussians (device pointers).
+		 * @{ */
+		const float * positions(void) const { return _bandPos; }
+		const float * rotations(void) const { return _bandRot; }
+		const float * scales(void) const { return _bandScale; }
+		const float * opacities(void) const { return _bandOpacity; }
+		const float * colors(void) const { return _bandColors; }
+		/** @} */
+
+	private:
+
+		void release(void);
+
+		int _count = 0; ///< Number of Gaussians the selection buffers are sized for.
+		int _active = 0; ///< Number of selected Gaussians.
+
+		char * _flags = nullptr; ///< Overlap flag of each Gaussian.
+		int * _selected = nullptr; ///< Indices of the selected Gaussians.
+		int * _numSelected = nullptr; ///< Device selection counter.
+		void * _scanTemp = nullptr; ///< Temporary storage for stream compaction.
+		size_t _scanTempBytes = 0; ///< Size of the temporary storage.
+
+		int _capacity = 0; ///< Capacity of the gathered buffers.
+		float * _bandPos = nullptr;
+		float * _bandRot = nullptr;
+		float * _bandScale = nullptr;
+		float * _bandOpacity = nullptr;
+		float * _bandColors = nullptr;
+	};
+
+} /*namespace sibr*/
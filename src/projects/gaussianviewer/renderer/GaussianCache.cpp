@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianCache.hpp"
+#include <core/system/Hash.hpp>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+
+namespace sibr {
+
+	namespace {
+
+		const char kMagic[8] = { 'S', 'I', 'B', 'R', 'G', 'S', '\0', '\0' };
+
+		// Arrays are aligned in the file so that they can be used in place.
+		const uint64_t kAlignment = 64;
+
+		struct CacheHeader
+		{
+			char magic[8];
+			uint32_t version;
+			int32_t shDegree;
+			uint64_t count;
+			Hash128 source; // fileFingerprint of the PLY file.
+			float minn[3];
+			float maxx[3];
+			uint64_t offsets[GaussianCache::ATTRIBUTE_COUNT];
+			uint64_t strides[GaussianCache::ATTRIBUTE_COUNT];
+		};
+
+		uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + kAlignment - 1) / kAlignment * kAlignment;
+		}
+	}
+
+	std::string GaussianCache::pathFor(const std::string & plyPath)
+	{
+		return boost::filesystem::path(plyPath).replace_extension(".sibrgs").string();
+	}
+
+	bool GaussianCache::open(const std::string & cachePath, const std::string & plyPath, int shDegree)
+	{
+		Hash128 source;
+		if (!fileFingerprint(plyPath, source) || !_file.open(cachePath)) {
+			return false;
+		}
+
+		CacheHeader header;
+		if (_file.size() < sizeof(CacheHeader)) {
+			SIBR_WRG << "Ignoring invalid Gaussian cache " << cachePath << std::endl;
+			_file.close();
+			return false;
+		}
+		std::memcpy(&header, _file.data(), sizeof(CacheHeader));
+
+		if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != version) {
+			SIBR_LOG << "Gaussian cache " << cachePath << " has an unsupported version, it will be regenerated." << std::endl;
+			_file.close();
+			return false;
+		}
+		if (header.source != source || header.shDegree != shDegree) {
+			SIBR_LOG << "Gaussian cache " << cachePath << " is outdated, it will be regenerated." << std::endl;
+			_file.close();
+			return false;
+		}
+
+		for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+			const uint64_t end = header.offsets[a] + header.strides[a] * header.count;
+			if (end > _file.size()) {
+				SIBR_WRG << "Ignoring truncated Gaussian cache " << cachePath << std::endl;
+				_file.close();
+				return false;
+			}
+			_arrays[a] = _file.data() + header.offsets[a];
+			_strides[a] = size_t(header.strides[a]);
+		}
+		_count = int(header.count);
+		_min = Vector3f(header.minn[0], header.minn[1], header.minn[2]);
+		_max = Vector3f(header.maxx[0], header.maxx[1], header.maxx[2]);
+
+		_file.prefetch();
+		return true;
+	}
+
+	bool GaussianCache::write(const std::string & cachePath, const std::string & plyPath,
+		int shDegree, int count, const Vector3f & minn, const Vector3f & maxx,
+		const std::array<const void*, ATTRIBUTE_COUNT> & arrays,
+		const std::array<size_t, ATTRIBUTE_COUNT> & strides)
+	{
+		CacheHeader header;
+		std::memset(&header, 0, sizeof(CacheHeader));
+		std::memcpy(header.magic, kMagic, sizeof(kMagic));
+		header.version = version;
+		header.shDegree = shDegree;
+		header.count = uint64_t(count);
+		if (!fileFingerprint(plyPath, header.source)) {
+			return false;
+		}
+		for (int c = 0; c < 3; ++c) {
+			header.minn[c] = minn[c];
+			header.maxx[c] = maxx[c];
+		}
+		uint64_t offset = alignOffset(sizeof(CacheHeader));
+		for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+			header.offsets[a] = offset;
+			header.strides[a] = uint64_t(strides[a]);
+			offset = alignOffset(offset + header.strides[a] * header.count);
+		}
+
+		// Write to a temporary file first, so that an interrupted write never leaves a valid-looking cache.
+		const std::string tmpPath = cachePath + ".tmp";
+		{
+			std::ofstream outfile(tmpPath, std::ios_base::binary);
+			if (!outfile.good()) {
+				SIBR_WRG << "Unable to write Gaussian cache " << cachePath << std::endl;
+				return false;
+			}
+			const char padding[kAlignment] = { 0 };
+			outfile.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+			uint64_t written = sizeof(CacheHeader);
+			for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+				outfile.write(padding, std::streamsize(header.offsets[a] - written));
+				outfile.write(static_cast<const char*>(arrays[a]), std::streamsize(header.strides[a] * header.count));
+				written = header.offsets[a] + header.strides[a] * header.count;
+			}
+			if (!outfile.good()) {
+				SIBR_WRG << "Unable to write Gaussian cache " << cachePath << std::endl;
+				return false;
+			}
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmpPath, cachePath, ec);
+		if (ec) {
+			SIBR_WRG << "Unable to write Gaussian cache " << cachePath << ": " << ec.message() << std::endl;
+			boost::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+		SIBR_LOG << "Wrote Gaussian cache " << cachePath << std::endl;
+		return true;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include <core/system/MappedFile.hpp>
+# include <core/system/Vector.hpp>
+# include <array>
+# include <string>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianCache
+	 * \brief Preprocessed sidecar file for a trained Gaussian model (point_cloud.sibrgs).
+	 * It stores the SoA arrays exactly as they are uploaded to the GPU (Morton ordered
+	 * and activated), so that loading is a single mapping followed by one copy per array.
+	 * The cache is only valid for the source PLY file whose fingerprint (see sibr::fileFingerprint)
+	 * is recorded in its header.
+	 */
+	class GaussianCache
+	{
+	public:
+
+		/// Arrays stored in the cache, in file order.
+		enum Attribute { POSITION = 0, ROTATION, SCALE, OPACITY, SH, ATTRIBUTE_COUNT };
+
+		/// Increment when the layout of the file changes.
+		static const uint32_t version = 2;
+
+		/** \return the cache path associated to a model PLY path (same name, .sibrgs extension).
+		 * \param plyPath the source PLY path
+		 */
+		static std::string pathFor(const std::string & plyPath);
+
+		/** Open a cache file and check that it matches the source model.
+		 * \param cachePath the cache file
+		 * \param plyPath the source PLY the cache has been generated from
+		 * \param shDegree the expected SH degree
+		 * \return false if the cache doesn't exist, is outdated or invalid
+		 */
+		bool open(const std::string & cachePath, const std::string & plyPath, int shDegree);
+
+		/** Write a cache file for a given model.
+		 * \param cachePath the cache file to create
+		 * \param plyPath the source PLY the arrays have been loaded from
+		 * \param shDegree the model SH degree
+		 * \param count number of Gaussians
+		 * \param minn the model bounding box minimum
+		 * \param maxx the model bounding box maximum
+		 * \param arrays pointer to the host data of each attribute
+		 * \param strides size in bytes of one element of each attribute
+		 * \return true if the file was written
+		 */
+		static bool write(const std::string & cachePath, const std::string & plyPath,
+			int shDegree, int count, const Vector3f & minn, const Vector3f & maxx,
+			const std::array<const void*, ATTRIBUTE_COUNT> & arrays,
+			const std::array<size_t, ATTRIBUTE_COUNT> & strides);
+
+		/** \return the number of Gaussians in the opened cache. */
+		int count() const { return _count; }
+
+		/** \return the model bounding box minimum. */
+		const Vector3f & minimum() const { return _min; }
+
+		/** \return the model bounding box maximum. */
+		const Vector3f & maximum() const { return _max; }
+
+		/** \return a pointer to the mapped data of an attribute.
+		 * \param attribute the attribute to query
+		 */
+		const void * data(Attribute attribute) const { return _arrays[attribute]; }
+
+		/** \return the size in bytes of one element of an attribute.
+		 * \param attribute the attribute to query
+		 */
+		size_t stride(Attribute attribute) const { return _strides[attribute]; }
+
+	private:
+
+		MappedFile _file; ///< The mapped cache.
+		int _count = 0; ///< Number of Gaussians.
+		Vector3f _min, _max; ///< Model bounds.
+		std::array<const void*, ATTRIBUTE_COUNT> _arrays = {}; ///< Mapped arrays.
+		std::array<size_t, ATTRIBUTE_COUNT> _strides = {}; ///< Per-element sizes.
+	};
+
+} /*namespace sibr*/
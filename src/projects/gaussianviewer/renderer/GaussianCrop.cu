@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianCrop.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <cub/cub.cuh>
+#include <algorithm>
+
+#define BLOCK_SIZE 256
+
+// Same test as the export: centers on the box faces are kept.
+__global__ void insideBoxCUDA(int n, const float* pos, float3 boxmin, float3 boxmax, char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float x = pos[3 * idx + 0];
+	const float y = pos[3 * idx + 1];
+	const float z = pos[3 * idx + 2];
+	flags[idx] = x >= boxmin.x && y >= boxmin.y && z >= boxmin.z
+		&& x <= boxmax.x && y <= boxmax.y && z <= boxmax.z;
+}
+
+__global__ void gatherBoxCUDA(int n, const int* list, const float* pos, const float* rot, const float* scale, const float* opacity,
+	float* outPos, float* outRot, float* outScale, float* outOpacity)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const int src = list[idx];
+	for (int k = 0; k < 3; k++)
+	{
+		outPos[3 * idx + k] = pos[3 * src + k];
+		outScale[3 * idx + k] = scale[3 * src + k];
+	}
+	for (int k = 0; k < 4; k++)
+		outRot[4 * idx + k] = rot[4 * src + k];
+	outOpacity[idx] = opacity[src];
+}
+
+namespace {
+
+	int blocks(int n)
+	{
+		return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+}
+
+namespace sibr {
+
+	GaussianCrop::GaussianCrop(void)
+	{
+	}
+
+	GaussianCrop::~GaussianCrop(void)
+	{
+		clear();
+	}
+
+	void GaussianCrop::clear(void)
+	{
+		for (void* ptr : { (void*)_flags, (void*)_selected, (void*)_numSelected, _scanTemp,
+			(void*)_cropPos, (void*)_cropRot, (void*)_cropScale, (void*)_cropOpacity, (void*)_cropColors })
+			cudaFree(ptr);
+		_flags = nullptr;
+		_selected = _numSelected = nullptr;
+		_scanTemp = nullptr;
+		_scanTempBytes = 0;
+		_cropPos = _cropRot = _cropScale = _cropOpacity = _cropColors = nullptr;
+		_capacity = 0;
+		_count = 0;
+		_active = 0;
+		_lastBox[3] = _lastBox[4] = _lastBox[5] = -1.0f;
+		_lastBox[0] = _lastBox[1] = _lastBox[2] = 0.0f;
+	}
+
+	int GaussianCrop::update(int count, const float * boxmin, const float * boxmax,
+		const float * pos, const float * rot, const float * scale, const float * opacity)
+	{
+		const float box[6] = { boxmin[0], boxmin[1], boxmin[2], boxmax[0], boxmax[1], boxmax[2] };
+		if (count == _count && std::equal(box, box + 6, _lastBox))
+			return _active;
+
+		if (count != _count)
+		{
+			clear();
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_flags, count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_selected, sizeof(int) * count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_numSelected, sizeof(int)));
+			cub::DeviceSelect::Flagged(nullptr, _scanTempBytes, cub::CountingInputIterator<int>(0), _flags, _selected, _numSelected, count);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_scanTemp, _scanTempBytes));
+			_count = count;
+		}
+		std::copy(box, box + 6, _lastBox);
+
+		// The box is edited interactively: only sync for the selected count.
+		insideBoxCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos,
+			make_float3(box[0], box[1], box[2]), make_float3(box[3], box[4], box[5]), _flags);
+		cub::DeviceSelect::Flagged(_scanTemp, _scanTempBytes, cub::CountingInputIterator<int>(0),
+			_flags, _selected, _numSelected, count);
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(&_active, _numSelected, sizeof(int), cudaMemcpyDeviceToHost));
+
+		const int n = _active;
+		if (n > _capacity)
+		{
+			// Grow with some slack, the box is usually enlarged progressively.
+			const int capacity = std::min(count, n + n / 4);
+			for (void* ptr : { (void*)_cropPos, (void*)_cropRot, (void*)_cropScale, (void*)_cropOpacity, (void*)_cropColors })
+				cudaFree(ptr);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cropPos, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cropRot, sizeof(float) * 4 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cropScale, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cropOpacity, sizeof(float) * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cropColors, sizeof(float) * 3 * capacity));
+			_capacity = capacity;
+		}
+		if (n > 0)
+		{
+			gatherBoxCUDA << <blocks(n), BLOCK_SIZE >> > (n, _selected, pos, rot, scale, opacity,
+				_cropPos, _cropRot, _cropScale, _cropOpacity);
+		}
+		return n;
+	}
+
+	void GaussianCrop::computeColors(int degree, const float * pos, const GaussianSHBuffer & shs, const float * campos)
+	{
+		if (_active > 0)
+			shs.computeColors(degree, pos, campos, _cropColors, _active, _selected);
+	}
+
+	size_t GaussianCrop::gpuBytes(void) const
+	{
+		return (sizeof(int) + sizeof(char)) * size_t(_count) + _scanTempBytes + sizeof(float) * 14 * size_t(_capacity);
+	}
+
+} /*namespace sibr*/
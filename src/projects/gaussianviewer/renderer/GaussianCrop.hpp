@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "GaussianSHBuffer.hpp"
+
+namespace sibr {
+
+	/**
+	 * \class GaussianCrop
+	 * \brief Gaussians of a model whose center lies inside a crop box.
+	 * When the box changes, the Gaussians inside are flagged and compacted on the GPU,
+	 * and their attributes gathered in contiguous buffers, so that the rasterizer only
+	 * processes the cropped part of the model. Colors are evaluated every frame for the
+	 * selected Gaussians only.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianCrop
+	{
+	public:
+
+		/// Constructor.
+		GaussianCrop(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianCrop(void);
+
+		GaussianCrop(const GaussianCrop &) = delete;
+		GaussianCrop & operator=(const GaussianCrop &) = delete;
+
+		/** Select the Gaussians inside a box and gather them in contiguous buffers.
+		 * Does nothing if the box and count didn't change since the last call.
+		 * \param count number of Gaussians of the model
+		 * \param boxmin host box minimum corner
+		 * \param boxmax host box maximum corner
+		 * \param pos device positions
+		 * \param rot device rotations
+		 * \param scale device scales
+		 * \param opacity device opacities
+		 * \return the number of selected Gaussians
+		 */
+		int update(int count, const float * boxmin, const float * boxmax,
+			const float * pos, const float * rot, const float * scale, const float * opacity);
+
+		/** Evaluate the view dependent colors of the selected Gaussians.
+		 * \param degree the SH degree to evaluate
+		 * \param pos device positions of the model
+		 * \param shs the model SH coefficients
+		 * \param campos device camera position
+		 */
+		void computeColors(int degree, const float * pos, const GaussianSHBuffer & shs, const float * campos);
+
+		/** Release the device memory, the next update() selects again. */
+		void clear(void);
+
+		/** \return the number of Gaussians selected by the last update. */
+		int active(void) const { return _active; }
+
+		/** \return the device memory used, in bytes. */
+		size_t gpuBytes(void) const;
+
+		/** \name Gathered attributes of the selected Gaussians (device pointers).
+		 * @{ */
+		const float * positions(void) const { return _cropPos; }
+		const float * rotations(void) const { return _cropRot; }
+		const float * scales(void) const { return _cropScale; }
+		const float * opacities(void) const { return _cropOpacity; }
+		const float * colors(void) const { return _cropColors; }
+		/** @} */
+
+	private:
+
+		int _count = 0; ///< Number of Gaussians the selection buffers are sized for.
+		int _active = 0; ///< Number of selected Gaussians.
+		float _lastBox[6] = { 0.0f, 0.0f, 0.0f, -1.0f, -1.0f, -1.0f }; ///< Box of the last selection.
+
+		char * _flags = nullptr; ///< Inside flag of each Gaussian.
+		int * _selected = nullptr; ///< Indices of the selected Gaussians.
+		int * _numSelected = nullptr; ///< Device selection counter.
+		void * _scanTemp = nullptr; ///< Temporary storage for stream compaction.
+		size_t _scanTempBytes = 0; ///< Size of the temporary storage.
+
+		int _capacity = 0; ///< Capacity of the gathered buffers.
+		float * _cropPos = nullptr;
+		float * _cropRot = nullptr;
+		float * _cropScale = nullptr;
+		float * _cropOpacity = nullptr;
+		float * _cropColors = nullptr;
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <cuda_runtime.h>
+# include <iostream>
+# include <stdexcept>
+
+// Error checks of the CUDA calls of the renderer. They only depend on the CUDA runtime so that
+// the .cu files can use them; errors are reported as SIBR_ERR does, logged then thrown.
+
+# define CUDA_REPORT_ERROR() \
+{ \
+	std::cerr << "[SIBR] ##  ERROR  ##:\tFILE " << __FILE__ << "\n\t\t\tLINE " << __LINE__ << "\n\t\t\t" << cudaGetErrorString(cudaGetLastError()) << std::endl; \
+	throw std::runtime_error("See log for message errors"); \
+}
+
+// Wait for the device and check for errors.
+# define CUDA_SAFE_CALL_ALWAYS(A) \
+A; \
+cudaDeviceSynchronize(); \
+if (cudaPeekAtLastError() != cudaSuccess) \
+CUDA_REPORT_ERROR()
+
+// Check for errors without waiting for the device.
+# define CUDA_SAFE_CALL_NOSYNC(A) \
+A; \
+if (cudaPeekAtLastError() != cudaSuccess) \
+CUDA_REPORT_ERROR()
+
+// Per-frame calls only synchronize in debug builds.
+#if DEBUG || _DEBUG
+# define CUDA_SAFE_CALL(A) CUDA_SAFE_CALL_ALWAYS(A)
+#else
+# define CUDA_SAFE_CALL(A) A
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianDirectOutput.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+
+// Planar float RGB to an 8-bit RGBA surface, one thread per pixel.
+__global__ void writeSurfaceCUDA(int width, int height, bool flip, const float* image, cudaSurfaceObject_t surface)
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+	if (x >= width || y >= height)
+		return;
+
+	const int pixels = width * height;
+	const int idx = y * width + x;
+	uchar4 value;
+	value.x = (unsigned char)(fminf(fmaxf(image[idx], 0.0f), 1.0f) * 255.0f + 0.5f);
+	value.y = (unsigned char)(fminf(fmaxf(image[pixels + idx], 0.0f), 1.0f) * 255.0f + 0.5f);
+	value.z = (unsigned char)(fminf(fmaxf(image[2 * pixels + idx], 0.0f), 1.0f) * 255.0f + 0.5f);
+	value.w = 255;
+	// Surface x coordinates are in bytes.
+	surf2Dwrite(value, surface, x * int(sizeof(uchar4)), flip ? height - 1 - y : y);
+}
+
+namespace sibr {
+
+	GaussianDirectOutput::GaussianDirectOutput(void)
+	{
+	}
+
+	GaussianDirectOutput::~GaussianDirectOutput(void)
+	{
+		release();
+	}
+
+	void GaussianDirectOutput::attach(void * resource, int width, int height)
+	{
+		release();
+		_resource = resource;
+		_width = width;
+		_height = height;
+	}
+
+	void GaussianDirectOutput::release(void)
+	{
+		if (_resource)
+			cudaGraphicsUnregisterResource(static_cast<cudaGraphicsResource_t>(_resource));
+		_resource = nullptr;
+		_width = _height = 0;
+	}
+
+	void GaussianDirectOutput::write(const float * image, int width, int height, bool flip)
+	{
+		if (!_resource || width > _width || height > _height)
+			return;
+
+		cudaGraphicsResource_t resource = static_cast<cudaGraphicsResource_t>(_resource);
+		cudaArray_t array = nullptr;
+		CUDA_SAFE_CALL_NOSYNC(cudaGraphicsMapResources(1, &resource));
+		CUDA_SAFE_CALL_NOSYNC(cudaGraphicsSubResourceGetMappedArray(&array, resource, 0, 0));
+
+		cudaResourceDesc desc = {};
+		desc.resType = cudaResourceTypeArray;
+		desc.res.array.array = array;
+		cudaSurfaceObject_t surface = 0;
+		CUDA_SAFE_CALL_NOSYNC(cudaCreateSurfaceObject(&surface, &desc));
+
+		const dim3 block(16, 16);
+		const dim3 grid((width + block.x - 1) / block.x, (height + block.y - 1) / block.y);
+		writeSurfaceCUDA << <grid, block >> > (width, height, flip, image, surface);
+
+		CUDA_SAFE_CALL_NOSYNC(cudaDestroySurfaceObject(surface));
+		CUDA_SAFE_CALL_NOSYNC(cudaGraphicsUnmapResources(1, &resource));
+	}
+
+} /*namespace sibr*/
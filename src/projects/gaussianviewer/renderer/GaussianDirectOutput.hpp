@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+namespace sibr {
+
+	/**
+	 * \class GaussianDirectOutput
+	 * \brief Writes the planar float RGB image of the rasterizer to an 8-bit RGBA GL texture,
+	 * registered with CUDA for surface stores. The texture is written once per rasterized frame
+	 * and can then be blitted to any render target, instead of running a shader pass that reads
+	 * the float image buffer each displayed frame.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianDirectOutput
+	{
+	public:
+
+		/// Constructor.
+		GaussianDirectOutput(void);
+
+		/// Destructor, unregisters the texture.
+		~GaussianDirectOutput(void);
+
+		GaussianDirectOutput(const GaussianDirectOutput &) = delete;
+		GaussianDirectOutput & operator=(const GaussianDirectOutput &) = delete;
+
+		/** Take ownership of a registered texture.
+		 * \param resource the cudaGraphicsResource_t of a GL_RGBA8 texture, registered with cudaGraphicsRegisterFlagsSurfaceLoadStore
+		 * \param width texture width
+		 * \param height texture height
+		 */
+		void attach(void * resource, int width, int height);
+
+		/** Unregister the texture. */
+		void release(void);
+
+		/** Convert an image to the texture, in its lower left corner.
+		 * \param image planar float RGB device image
+		 * \param width image width, at most the texture one
+		 * \param height image height, at most the texture one
+		 * \param flip write the first image row at the top of the texture
+		 */
+		void write(const float * image, int width, int height, bool flip);
+
+		/** \return true if a texture is attached. */
+		bool attached(void) const { return _resource != nullptr; }
+
+	private:
+
+		void * _resource = nullptr; ///< Registered texture.
+		int _width = 0; ///< Texture width.
+		int _height = 0; ///< Texture height.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianLOD.hpp"
+#include <core/system/Config.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <Eigen/Eigenvalues>
+
+namespace sibr {
+
+	namespace {
+
+		// Read-only view on a Gaussian, either a leaf or an already built node.
+		struct GaussianRef
+		{
+			const float* pos;
+			const float* rot;
+			const float* scale;
+			float opacity;
+			const float* shs;
+			const float* sphere;
+		};
+
+		Eigen::Matrix3f covariance(const float* rot, const float* scale)
+		{
+			const Eigen::Quaternionf q(rot[0], rot[1], rot[2], rot[3]);
+			const Eigen::Matrix3f R = q.toRotationMatrix();
+			const Eigen::Vector3f s2(scale[0] * scale[0], scale[1] * scale[1], scale[2] * scale[2]);
+			return R * s2.asDiagonal() * R.transpose();
+		}
+
+		// Surface proxy of an ellipsoid, used to weight children when merging.
+		float area(const float* s)
+		{
+			return s[0] * s[1] + s[1] * s[2] + s[0] * s[2];
+		}
+	}
+
+	void GaussianLOD::build(int count, int coeffs, const float * pos, const float * rot, const float * scale,
+		const float * opacity, const float * shs, GaussianSHBuffer::Storage storage, int fanout)
+	{
+		sibr::Timer timer(true);
+		_leaves = count;
+		_fanout = std::max(2, fanout);
+		const int shStride = coeffs * 3;
+
+		// Levels sizes and offsets in the global index space (leaves first).
+		std::vector<int> levelSize(1, count);
+		std::vector<int> levelBase(1, 0);
+		while (levelSize.back() > 1)
+		{
+			levelBase.push_back(levelBase.back() + levelSize.back());
+			levelSize.push_back((levelSize.back() + _fanout - 1) / _fanout);
+		}
+		const int total = levelBase.back() + levelSize.back();
+		const int nodes = total - count;
+		if (nodes <= 0)
+		{
+			SIBR_WRG << "Not enough Gaussians to build a level-of-detail hierarchy." << std::endl;
+			return;
+		}
+
+		std::vector<float> nodePos(size_t(nodes) * 3), nodeRot(size_t(nodes) * 4), nodeScale(size_t(nodes) * 3);
+		std::vector<float> nodeOpacity(nodes), nodeSHs(size_t(nodes) * shStride);
+		std::vector<float> spheres(size_t(total) * 4);
+		std::vector<int> parents(total, -1);
+
+		auto get = [&](int g) {
+			if (g < count)
+				return GaussianRef{ pos + size_t(g) * 3, rot + size_t(g) * 4, scale + size_t(g) * 3, opacity[g], shs + size_t(g) * shStride, &spheres[size_t(g) * 4] };
+			const size_t n = size_t(g - count);
+			return GaussianRef{ &nodePos[n * 3], &nodeRot[n * 4], &nodeScale[n * 3], nodeOpacity[n], &nodeSHs[n * shStride], &spheres[size_t(g) * 4] };
+		};
+
+		// Leaves are bounded by their 3 sigma extent.
+#pragma omp parallel for
+		for (int i = 0; i < count; i++)
+		{
+			const float* s = scale + size_t(i) * 3;
+			spheres[size_t(i) * 4 + 0] = pos[size_t(i) * 3 + 0];
+			spheres[size_t(i) * 4 + 1] = pos[size_t(i) * 3 + 1];
+			spheres[size_t(i) * 4 + 2] = pos[size_t(i) * 3 + 2];
+			spheres[size_t(i) * 4 + 3] = 3.0f * std::max(s[0], std::max(s[1], s[2]));
+		}
+
+		for (int l = 1; l < int(levelSize.size()); l++)
+		{
+			const int childBase = levelBase[l - 1];
+			const int childCount = levelSize[l - 1];
+#pragma omp parallel for
+			for (int j = 0; j < levelSize[l]; j++)
+			{
+				const int g = levelBase[l] + j;
+				const size_t n = size_t(g - count);
+				const int first = j * _fanout;
+				const int last = std::min(first + _fanout, childCount);
+
+				// Moment matching of the children, weighted by opacity and surface.
+				float weightSum = 0.0f;
+				float transmittance = 1.0f;
+				Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+				std::vector<float> weights(last - first);
+				for (int c = first; c < last; c++)
+				{
+					const GaussianRef child = get(childBase + c);
+					const float w = child.opacity * area(child.scale) + 1e-12f;
+					weights[c - first] = w;
+					weightSum += w;
+					transmittance *= 1.0f - child.opacity;
+					mean += w * Eigen::Vector3f(child.pos[0], child.pos[1], child.pos[2]);
+					parents[childBase + c] = g;
+				}
+				mean /= weightSum;
+
+				Eigen::Matrix3f cov = Eigen::Matrix3f::Zero();
+				float* sh = &nodeSHs[n * shStride];
+				for (int c = first; c < last; c++)
+				{
+					const GaussianRef child = get(childBase + c);
+					const float w = weights[c - first];
+					const Eigen::Vector3f d = Eigen::Vector3f(child.pos[0], child.pos[1], child.pos[2]) - mean;
+					cov += w * (covariance(child.rot, child.scale) + d * d.transpose());
+					for (int k = 0; k < shStride; k++)
+						sh[k] += w * child.shs[k];
+				}
+				cov /= weightSum;
+				for (int k = 0; k < shStride; k++)
+					sh[k] /= weightSum;
+
+				// Back to scale and rotation.
+				Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(cov);
+				Eigen::Matrix3f axes = solver.eigenvectors();
+				if (axes.determinant() < 0.0f)
+					axes.col(0) *= -1.0f;
+				const Eigen::Quaternionf q = Eigen::Quaternionf(axes).normalized();
+				for (int k = 0; k < 3; k++)
+				{
+					nodePos[n * 3 + k] = mean[k];
+					nodeScale[n * 3 + k] = std::sqrt(std::max(solver.eigenvalues()[k], 1e-12f));
+				}
+				nodeRot[n * 4 + 0] = q.w();
+				nodeRot[n * 4 + 1] = q.x();
+				nodeRot[n * 4 + 2] = q.y();
+				nodeRot[n * 4 + 3] = q.z();
+				// Preserve the total opacity-weighted surface of the children, without
+				// exceeding the opacity of all children stacked on top of each other.
+				const float stacked = std::min(0.999f, 1.0f - transmittance);
+				nodeOpacity[n] = std::min(stacked, weightSum / std::max(area(&nodeScale[n * 3]), 1e-12f));
+
+				// Conservative sphere containing the children spheres.
+				float radius = 0.0f;
+				for (int c = first; c < last; c++)
+				{
+					const float* cs = &spheres[size_t(childBase + c) * 4];
+					radius = std::max(radius, (Eigen::Vector3f(cs[0], cs[1], cs[2]) - mean).norm() + cs[3]);
+				}
+				float* sphere = &spheres[size_t(g) * 4];
+				sphere[0] = mean[0];
+				sphere[1] = mean[1];
+				sphere[2] = mean[2];
+				sphere[3] = radius;
+			}
+		}
+
+		upload(nodePos, nodeRot, nodeScale, nodeOpacity, nodeSHs, spheres, parents, coeffs, storage);
+		SIBR_LOG << "Built level-of-detail hierarchy: " << nodes << " nodes over " << levelSize.size() << " levels in "
+			<< timer.deltaTimeFromLastTic() << "ms" << std::endl;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "GaussianSHBuffer.hpp"
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianLOD
+	 * \brief Level-of-detail hierarchy over a Morton ordered Gaussian model.
+	 * Consecutive Gaussians (close in 3D thanks to the Morton order) are merged
+	 * by groups of fanout() into interior nodes, level after level, up to a single
+	 * root. Each node is a Gaussian obtained by moment matching its children.
+	 * Every frame, a cut is selected independently for each node: a node is
+	 * rendered when its screen-space error is below the threshold while its
+	 * parent's is not. Node bounding spheres contain their children's, which
+	 * makes the error monotonic and guarantees that the cut covers each leaf once.
+	 * Leaves keep living in the view buffers; node attributes are owned here.
+	 * Global node indices are: leaves in [0, leaves()), interior nodes after.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianLOD
+	{
+	public:
+
+		/// Constructor.
+		GaussianLOD(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianLOD(void);
+
+		GaussianLOD(const GaussianLOD &) = delete;
+		GaussianLOD & operator=(const GaussianLOD &) = delete;
+
+		/** Build the hierarchy on the CPU and upload the interior nodes.
+		 * \param count number of leaf Gaussians
+		 * \param coeffs number of SH coefficients per Gaussian
+		 * \param pos host leaf positions (3 floats)
+		 * \param rot host leaf normalized quaternions (4 floats, real part first)
+		 * \param scale host leaf activated scales (3 floats)
+		 * \param opacity host leaf activated opacities
+		 * \param shs host leaf SH coefficients (coeffs*3 floats)
+		 * \param storage the storage to use for the nodes SH coefficients
+		 * \param fanout number of children per node
+		 */
+		void build(int count, int coeffs, const float * pos, const float * rot, const float * scale,
+			const float * opacity, const float * shs, GaussianSHBuffer::Storage storage, int fanout = 8);
+
+		/** Select the cut for a viewpoint and gather the selected Gaussians in contiguous buffers.
+		 * Does nothing if the viewpoint and threshold didn't change since the last call.
+		 * \param campos host camera position
+		 * \param focal focal length in pixels
+		 * \param threshold maximum screen-space error, in pixels
+		 * \param leafPos device leaf positions
+		 * \param leafRot device leaf rotations
+		 * \param leafScale device leaf scales
+		 * \param leafOpacity device leaf opacities
+		 * \return the number of selected Gaussians
+		 */
+		int update(const float * campos, float focal, float threshold,
+			const float * leafPos, const float * leafRot, const float * leafScale, const float * leafOpacity);
+
+		/** Evaluate the view dependent colors of the selected Gaussians.
+		 * \param degree the SH degree to evaluate
+		 * \param leafPos device leaf positions
+		 * \param leafSHs the leaves SH coefficients
+		 * \param campos device camera position
+		 */
+		void computeColors(int degree, const float * leafPos, const GaussianSHBuffer & leafSHs, const float * campos);
+
+		/** \return true if the hierarchy has been built. */
+		bool built(void) const { return _nodes > 0; }
+
+		/** \return the number of leaf Gaussians. */
+		int leaves(void) const { return _leaves; }
+
+		/** \return the number of interior nodes. */
+		int nodes(void) const { return _nodes; }
+
+		/** \return the number of children per node. */
+		int fanout(void) const { return _fanout; }
+
+		/** \return the number of Gaussians selected by the last cut. */
+		int active(void) const { return _activeLeaves + _activeNodes; }
+
+		/** \return the device memory used by the hierarchy, in bytes. */
+		size_t gpuBytes(void) const;
+
+		/** \name Gathered attributes of the selected Gaussians (device pointers).
+		 * @{ */
+		const float * positions(void) const { return _cutPos; }
+		const float * rotations(void) const { return _cutRot; }
+		const float * scales(void) const { return _cutScale; }
+		const float * opacities(void) const { return _cutOpacity; }
+		const float * colors(void) const { return _cutColors; }
+		/** @} */
+
+		/** Release the hierarchy, built() is then false until the next build. */
+		void release(void);
+
+	private:
+
+		/** Upload the nodes and the traversal data. */
+		void upload(const std::vector<float> & pos, const std::vector<float> & rot, const std::vector<float> & scale,
+			const std::vector<float> & opacity, const std::vector<float> & shs, const std::vector<float> & spheres,
+			const std::vector<int> & parents, int coeffs, GaussianSHBuffer::Storage storage);
+
+		int _leaves = 0; ///< Number of leaves.
+		int _nodes = 0; ///< Number of interior nodes.
+		int _fanout = 8; ///< Children per node.
+
+		float * _nodePos = nullptr; ///< Interior nodes positions.
+		float * _nodeRot = nullptr; ///< Interior nodes rotations.
+		float * _nodeScale = nullptr; ///< Interior nodes scales.
+		float * _nodeOpacity = nullptr; ///< Interior nodes opacities.
+		GaussianSHBuffer _nodeSHs; ///< Interior nodes SH coefficients.
+
+		float * _spheres = nullptr; ///< Bounding sphere (center, radius) of all nodes.
+		int * _parents = nullptr; ///< Parent of all nodes, -1 for the root.
+		char * _flags = nullptr; ///< Selection flag of all nodes.
+		int * _selected = nullptr; ///< Selected leaves followed by selected interior nodes.
+		int * _numSelected = nullptr; ///< Device selection counters.
+		void * _scanTemp = nullptr; ///< Temporary storage for stream compaction.
+		size_t _scanTempBytes = 0; ///< Size of the temporary storage.
+
+		int _capacity = 0; ///< Capacity of the gathered buffers.
+		float * _cutPos = nullptr;
+		float * _cutRot = nullptr;
+		float * _cutScale = nullptr;
+		float * _cutOpacity = nullptr;
+		float * _cutColors = nullptr;
+
+		int _activeLeaves = 0; ///< Selected leaves in the last cut.
+		int _activeNodes = 0; ///< Selected interior nodes in the last cut.
+		float _lastCut[5] = { 0.0f, 0.0f, 0.0f, 0.0f, -1.0f }; ///< Position, focal and threshold of the last cut.
+	};
+
+} /*namespace sibr*/
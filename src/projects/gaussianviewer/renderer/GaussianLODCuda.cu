@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianLOD.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <cub/cub.cuh>
+#include <algorithm>
+#include <cfloat>
+
+#define BLOCK_SIZE 256
+
+// Projected size of a bounding sphere, in pixels. Infinite when the camera is inside.
+__device__ float screenError(const float4 sphere, const float3 campos, float focal)
+{
+	const float dx = sphere.x - campos.x;
+	const float dy = sphere.y - campos.y;
+	const float dz = sphere.z - campos.z;
+	const float distance = sqrtf(dx * dx + dy * dy + dz * dz) - sphere.w;
+	if (distance <= 0.0f)
+		return FLT_MAX;
+	return focal * sphere.w / fmaxf(distance, 1e-4f);
+}
+
+// A node is in the cut when it is precise enough but its parent is not.
+__global__ void selectCutCUDA(int total, int leaves, const float4* spheres, const int* parents,
+	float3 campos, float focal, float threshold, char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= total)
+		return;
+
+	const bool precise = idx < leaves || screenError(spheres[idx], campos, focal) < threshold;
+	const int parent = parents[idx];
+	const bool coarse = parent < 0 || screenError(spheres[parent], campos, focal) >= threshold;
+	flags[idx] = precise && coarse;
+}
+
+__global__ void gatherCUDA(int n, const int* list, const float* pos, const float* rot, const float* scale, const float* opacity,
+	float* outPos, float* outRot, float* outScale, float* outOpacity)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const int src = list[idx];
+	for (int k = 0; k < 3; k++)
+	{
+		outPos[3 * idx + k] = pos[3 * src + k];
+		outScale[3 * idx + k] = scale[3 * src + k];
+	}
+	for (int k = 0; k < 4; k++)
+		outRot[4 * idx + k] = rot[4 * src + k];
+	outOpacity[idx] = opacity[src];
+}
+
+namespace {
+
+	int blocks(int n)
+	{
+		return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+}
+
+namespace sibr {
+
+	GaussianLOD::GaussianLOD(void)
+	{
+	}
+
+	GaussianLOD::~GaussianLOD(void)
+	{
+		release();
+	}
+
+	void GaussianLOD::release(void)
+	{
+		for (void* ptr : { (void*)_nodePos, (void*)_nodeRot, (void*)_nodeScale, (void*)_nodeOpacity,
+			(void*)_spheres, (void*)_parents, (void*)_flags, (void*)_selected, (void*)_numSelected, _scanTemp,
+			(void*)_cutPos, (void*)_cutRot, (void*)_cutScale, (void*)_cutOpacity, (void*)_cutColors })
+			cudaFree(ptr);
+		_nodePos = _nodeRot = _nodeScale = _nodeOpacity = nullptr;
+		_spheres = nullptr;
+		_parents = _selected = _numSelected = nullptr;
+		_flags = nullptr;
+		_scanTemp = nullptr;
+		_scanTempBytes = 0;
+		_cutPos = _cutRot = _cutScale = _cutOpacity = _cutColors = nullptr;
+		_capacity = 0;
+		_nodes = 0;
+		_activeLeaves = _activeNodes = 0;
+		_lastCut[4] = -1.0f;
+	}
+
+	void GaussianLOD::upload(const std::vector<float> & pos, const std::vector<float> & rot, const std::vector<float> & scale,
+		const std::vector<float> & opacity, const std::vector<float> & shs, const std::vector<float> & spheres,
+		const std::vector<int> & parents, int coeffs, GaussianSHBuffer::Storage storage)
+	{
+		release();
+		_nodes = int(opacity.size());
+		const int total = _leaves + _nodes;
+
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_nodePos, sizeof(float) * pos.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_nodePos, pos.data(), sizeof(float) * pos.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_nodeRot, sizeof(float) * rot.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_nodeRot, rot.data(), sizeof(float) * rot.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_nodeScale, sizeof(float) * scale.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_nodeScale, scale.data(), sizeof(float) * scale.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_nodeOpacity, sizeof(float) * opacity.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_nodeOpacity, opacity.data(), sizeof(float) * opacity.size(), cudaMemcpyHostToDevice));
+		_nodeSHs.upload(shs.data(), _nodes, coeffs, storage);
+
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_spheres, sizeof(float) * spheres.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_spheres, spheres.data(), sizeof(float) * spheres.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_parents, sizeof(int) * parents.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_parents, parents.data(), sizeof(int) * parents.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_flags, total));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_selected, sizeof(int) * total));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_numSelected, sizeof(int) * 2));
+
+		// The leaves range is the largest one, its temporary storage fits both compactions.
+		cub::DeviceSelect::Flagged(nullptr, _scanTempBytes, cub::CountingInputIterator<int>(0), _flags, _selected, _numSelected, std::max(_leaves, _nodes));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_scanTemp, _scanTempBytes));
+	}
+
+	int GaussianLOD::update(const float * campos, float focal, float threshold,
+		const float * leafPos, const float * leafRot, const float * leafScale, const float * leafOpacity)
+	{
+		if (!built())
+			return 0;
+
+		const float cut[5] = { campos[0], campos[1], campos[2], focal, threshold };
+		if (std::equal(cut, cut + 5, _lastCut))
+			return active();
+		std::copy(cut, cut + 5, _lastCut);
+
+		const int total = _leaves + _nodes;
+		selectCutCUDA << <blocks(total), BLOCK_SIZE >> > (total, _leaves, (const float4*)_spheres, _parents,
+			make_float3(campos[0], campos[1], campos[2]), focal, threshold, _flags);
+
+		// Selected leaves are listed first, selected nodes after, both as local indices.
+		CUDA_SAFE_CALL(cub::DeviceSelect::Flagged(_scanTemp, _scanTempBytes, cub::CountingInputIterator<int>(0),
+			_flags, _selected, _numSelected, _leaves));
+		CUDA_SAFE_CALL(cub::DeviceSelect::Flagged(_scanTemp, _scanTempBytes, cub::CountingInputIterator<int>(0),
+			_flags + _leaves, _selected + _leaves, _numSelected + 1, _nodes));
+		int counts[2];
+		CUDA_SAFE_CALL(cudaMemcpy(counts, _numSelected, sizeof(int) * 2, cudaMemcpyDeviceToHost));
+		_activeLeaves = counts[0];
+		_activeNodes = counts[1];
+
+		const int n = active();
+		if (n > _capacity)
+		{
+			// Grow with some slack to avoid reallocating every time the camera moves closer.
+			const int capacity = std::min(total, n + n / 4);
+			for (void* ptr : { (void*)_cutPos, (void*)_cutRot, (void*)_cutScale, (void*)_cutOpacity, (void*)_cutColors })
+				cudaFree(ptr);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cutPos, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cutRot, sizeof(float) * 4 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cutScale, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cutOpacity, sizeof(float) * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_cutColors, sizeof(float) * 3 * capacity));
+			_capacity = capacity;
+		}
+
+		const int nL = _activeLeaves;
+		const int nN = _activeNodes;
+		if (nL > 0)
+		{
+			gatherCUDA << <blocks(nL), BLOCK_SIZE >> > (nL, _selected, leafPos, leafRot, leafScale, leafOpacity,
+				_cutPos, _cutRot, _cutScale, _cutOpacity);
+		}
+		if (nN > 0)
+		{
+			gatherCUDA << <blocks(nN), BLOCK_SIZE >> > (nN, _selected + _leaves, _nodePos, _nodeRot, _nodeScale, _nodeOpacity,
+				_cutPos + 3 * nL, _cutRot + 4 * nL, _cutScale + 3 * nL, _cutOpacity + nL);
+		}
+		return n;
+	}
+
+	void GaussianLOD::computeColors(int degree, const float * leafPos, const GaussianSHBuffer & leafSHs, const float * campos)
+	{
+		if (_activeLeaves > 0)
+			leafSHs.computeColors(degree, leafPos, campos, _cutColors, _activeLeaves, _selected);
+		if (_activeNodes > 0)
+			_nodeSHs.computeColors(degree, _nodePos, campos, _cutColors + 3 * _activeLeaves, _activeNodes, _selected + _leaves);
+	}
+
+	size_t GaussianLOD::gpuBytes(void) const
+	{
+		const size_t total = size_t(_leaves + _nodes);
+		size_t bytes = sizeof(float) * 11 * _nodes + _nodeSHs.gpuBytes();
+		bytes += (sizeof(float) * 4 + sizeof(int) * 2 + sizeof(char)) * total + _scanTempBytes;
+		bytes += sizeof(float) * 14 * _capacity;
+		return bytes;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianModel.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+
+#define BLOCK_SIZE 256
+
+__global__ void blendImagesCUDA(int n, float* image, const float* other, float weight)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+	image[idx] += weight * (other[idx] - image[idx]);
+}
+
+namespace sibr {
+
+	GaussianModel::GaussianModel(void)
+	{
+	}
+
+	GaussianModel::~GaussianModel(void)
+	{
+		release();
+	}
+
+	void GaussianModel::release(void)
+	{
+		cudaFree(_pos);
+		cudaFree(_rot);
+		cudaFree(_scale);
+		cudaFree(_opacity);
+		_pos = _rot = _scale = _opacity = nullptr;
+		_count = 0;
+	}
+
+	void GaussianModel::upload(const std::string & name, int count, int coeffs, const float * pos, const float * rot, const float * scale,
+		const float * opacity, const float * shs, GaussianSHBuffer::Storage storage, int codebookSize)
+	{
+		release();
+		_name = name;
+		_count = count;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_pos, 3 * sizeof(float) * count));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_rot, 4 * sizeof(float) * count));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_scale, 3 * sizeof(float) * count));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_opacity, sizeof(float) * count));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_pos, pos, 3 * sizeof(float) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_rot, rot, 4 * sizeof(float) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_scale, scale, 3 * sizeof(float) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_opacity, opacity, sizeof(float) * count, cudaMemcpyHostToDevice));
+		_shs.upload(shs, count, coeffs, storage, codebookSize);
+	}
+
+	void GaussianModel::blend(float * image, const float * other, int values, float weight)
+	{
+		if (values <= 0)
+			return;
+		blendImagesCUDA << <(values + BLOCK_SIZE - 1) / BLOCK_SIZE, BLOCK_SIZE >> > (values, image, other, weight);
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "GaussianSHBuffer.hpp"
+# include <string>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianModel
+	 * \brief Device copy of an additional Gaussian model rendered by a view.
+	 * Only the model attributes are owned here: the rasterizer scratch, the
+	 * frame parameters and the images are those of the view, shared by all
+	 * its models.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianModel
+	{
+	public:
+
+		/// Constructor.
+		GaussianModel(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianModel(void);
+
+		GaussianModel(const GaussianModel &) = delete;
+		GaussianModel & operator=(const GaussianModel &) = delete;
+
+		/** Upload a model to the GPU.
+		 * \param name display name of the model
+		 * \param count number of Gaussians
+		 * \param coeffs number of SH coefficients per Gaussian
+		 * \param pos host positions (3 floats)
+		 * \param rot host normalized quaternions (4 floats)
+		 * \param scale host activated scales (3 floats)
+		 * \param opacity host activated opacities
+		 * \param shs host SH coefficients (coeffs*3 floats)
+		 * \param storage SH storage mode
+		 * \param codebookSize number of codewords for quantized storage
+		 */
+		void upload(const std::string & name, int count, int coeffs, const float * pos, const float * rot, const float * scale,
+			const float * opacity, const float * shs, GaussianSHBuffer::Storage storage, int codebookSize);
+
+		/** Blend an image into another one, both planar float RGB of the same size.
+		 * \param image device image, replaced by image*(1-weight) + other*weight
+		 * \param other device image blended in
+		 * \param values number of floats of each image
+		 * \param weight weight of the other image
+		 */
+		static void blend(float * image, const float * other, int values, float weight);
+
+		/** \return the display name. */
+		const std::string & name(void) const { return _name; }
+
+		/** \return the number of Gaussians. */
+		int count(void) const { return _count; }
+
+		/** \return the device positions. */
+		const float * positions(void) const { return _pos; }
+
+		/** \return the device rotations. */
+		const float * rotations(void) const { return _rot; }
+
+		/** \return the device scales. */
+		const float * scales(void) const { return _scale; }
+
+		/** \return the device opacities. */
+		const float * opacities(void) const { return _opacity; }
+
+		/** \return the SH coefficients. */
+		const GaussianSHBuffer & shs(void) const { return _shs; }
+
+		/** \return the device memory used by the model, in bytes. */
+		size_t gpuBytes(void) const { return size_t(_count) * 11 * sizeof(float) + _shs.gpuBytes(); }
+
+	private:
+
+		void release(void);
+
+		std::string _name; ///< Display name.
+		int _count = 0; ///< Number of Gaussians.
+		float * _pos = nullptr; ///< Device positions.
+		float * _rot = nullptr; ///< Device rotations.
+		float * _scale = nullptr; ///< Device scales.
+		float * _opacity = nullptr; ///< Device opacities.
+		GaussianSHBuffer _shs; ///< SH coefficients.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianOcclusion.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <cub/cub.cuh>
+#include <algorithm>
+
+#define BLOCK_SIZE 256
+#define TILE_SIZE 16 // Tiles of the rasterizer, BLOCK_X and BLOCK_Y.
+#define MAX_TESTED_TILES 64 // Larger Gaussians are kept without testing.
+#define NEAR_PLANE 0.2f // Gaussians closer than this are culled by the rasterizer.
+
+// One block per tile: the farthest mesh depth, infinite if a pixel of the tile has no mesh.
+__global__ void tileDepthCUDA(const float* depth, int width, int height, float znear, float zfar, float* tileDepth)
+{
+	__shared__ float farthest[TILE_SIZE * TILE_SIZE];
+	const int x = blockIdx.x * TILE_SIZE + threadIdx.x;
+	const int y = blockIdx.y * TILE_SIZE + threadIdx.y;
+	const int t = threadIdx.y * TILE_SIZE + threadIdx.x;
+
+	float z = 0.0f;
+	if (x < width && y < height)
+	{
+		// The rasterizer rows go from top to bottom.
+		const float ndc = depth[(height - 1 - y) * width + x];
+		z = ndc >= 1.0f ? INFINITY : 2.0f * znear * zfar / ((zfar + znear) - ndc * (zfar - znear));
+	}
+	farthest[t] = z;
+	__syncthreads();
+	for (int stride = TILE_SIZE * TILE_SIZE / 2; stride > 0; stride /= 2)
+	{
+		if (t < stride)
+			farthest[t] = fmaxf(farthest[t], farthest[t + stride]);
+		__syncthreads();
+	}
+	if (t == 0)
+		tileDepth[blockIdx.y * gridDim.x + blockIdx.x] = farthest[0];
+}
+
+// Conservative: the Gaussian extent is bounded by a sphere of three times its largest scale.
+__global__ void visibleCUDA(int n, const float* pos, const float* scale, const float* view, const float* proj, float focal, float modifier,
+	int width, int height, const float* tileDepth, char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float3 p = make_float3(pos[3 * idx + 0], pos[3 * idx + 1], pos[3 * idx + 2]);
+	const float z = view[2] * p.x + view[6] * p.y + view[10] * p.z + view[14];
+	const float extent = 3.0f * modifier * fmaxf(scale[3 * idx + 0], fmaxf(scale[3 * idx + 1], scale[3 * idx + 2]));
+	const float nearest = z - extent;
+
+	char visible = 1;
+	if (nearest > NEAR_PLANE)
+	{
+		const float hx = proj[0] * p.x + proj[4] * p.y + proj[8] * p.z + proj[12];
+		const float hy = proj[1] * p.x + proj[5] * p.y + proj[9] * p.z + proj[13];
+		const float hw = proj[3] * p.x + proj[7] * p.y + proj[11] * p.z + proj[15];
+		const float w = 1.0f / (hw + 0.0000001f);
+		const float px = ((hx * w + 1.0f) * width - 1.0f) * 0.5f;
+		const float py = ((hy * w + 1.0f) * height - 1.0f) * 0.5f;
+		const float radius = extent * focal / nearest;
+
+		const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		const int x0 = max(0, int(floorf((px - radius) / TILE_SIZE)));
+		const int y0 = max(0, int(floorf((py - radius) / TILE_SIZE)));
+		const int x1 = min(tilesX, int(floorf((px + radius) / TILE_SIZE)) + 1);
+		const int y1 = min(tilesY, int(floorf((py + radius) / TILE_SIZE)) + 1);
+		// Outside of the image, the rasterizer culls it.
+		if (x0 < x1 && y0 < y1 && (x1 - x0) * (y1 - y0) <= MAX_TESTED_TILES)
+		{
+			float farthest = 0.0f;
+			for (int ty = y0; ty < y1; ty++)
+				for (int tx = x0; tx < x1; tx++)
+					farthest = fmaxf(farthest, tileDepth[ty * tilesX + tx]);
+			visible = nearest <= farthest;
+		}
+	}
+	flags[idx] = visible;
+}
+
+__global__ void gatherVisibleCUDA(int n, const int* list, const float* pos, const float* rot, const float* scale, const float* opacity, const float* colors,
+	float* outPos, float* outRot, float* outScale, float* outOpacity, float* outColors)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const int src = list[idx];
+	for (int k = 0; k < 3; k++)
+	{
+		outPos[3 * idx + k] = pos[3 * src + k];
+		outScale[3 * idx + k] = scale[3 * src + k];
+		outColors[3 * idx + k] = colors[3 * src + k];
+	}
+	for (int k = 0; k < 4; k++)
+		outRot[4 * idx + k] = rot[4 * src + k];
+	outOpacity[idx] = opacity[src];
+}
+
+__global__ void depthColorsCUDA(int n, const float* pos, const float* view, float* colors)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float3 p = make_float3(pos[3 * idx + 0], pos[3 * idx + 1], pos[3 * idx + 2]);
+	colors[3 * idx + 0] = view[2] * p.x + view[6] * p.y + view[10] * p.z + view[14];
+	colors[3 * idx + 1] = 1.0f;
+	colors[3 * idx + 2] = 0.0f;
+}
+
+namespace {
+
+	int blocks(int n)
+	{
+		return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+}
+
+namespace sibr {
+
+	GaussianOcclusion::GaussianOcclusion(void)
+	{
+	}
+
+	GaussianOcclusion::~GaussianOcclusion(void)
+	{
+		clear();
+	}
+
+	void GaussianOcclusion::clear(void)
+	{
+		for (void* ptr : { (void*)_tileDepth, (void*)_flags, (void*)_selected, (void*)_numSelected, _scanTemp,
+			(void*)_pos, (void*)_rot, (void*)_scale, (void*)_opacity, (void*)_colors, (void*)_depthColors })
+			cudaFree(ptr);
+		_tileDepth = nullptr;
+		_tiles = 0;
+		_flags = nullptr;
+		_selected = _numSelected = nullptr;
+		_scanTemp = nullptr;
+		_scanTempBytes = 0;
+		_pos = _rot = _scale = _opacity = _colors = _depthColors = nullptr;
+		_capacity = 0;
+		_count = 0;
+		_active = 0;
+	}
+
+	void GaussianOcclusion::setDepth(const float * depth, int width, int height, float znear, float zfar)
+	{
+		const dim3 grid((width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE);
+		const int tiles = int(grid.x * grid.y);
+		if (tiles > _tiles)
+		{
+			cudaFree(_tileDepth);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_tileDepth, sizeof(float) * tiles));
+			_tiles = tiles;
+		}
+		_width = width;
+		_height = height;
+		tileDepthCUDA << <grid, dim3(TILE_SIZE, TILE_SIZE) >> > (depth, width, height, znear, zfar, _tileDepth);
+	}
+
+	int GaussianOcclusion::update(int count, const float * pos, const float * rot, const float * scale, const float * opacity, const float * colors,
+		const float * viewmatrix, const float * projmatrix, float focal, float scaleModifier)
+	{
+		// The LOD cut changes the count with the viewpoint, only grow.
+		if (count > _count)
+		{
+			for (void* ptr : { (void*)_flags, (void*)_selected, (void*)_numSelected, _scanTemp })
+				cudaFree(ptr);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_flags, std::max(count, 1)));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_selected, sizeof(int) * std::max(count, 1)));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_numSelected, sizeof(int)));
+			_scanTempBytes = 0;
+			cub::DeviceSelect::Flagged(nullptr, _scanTempBytes, cub::CountingInputIterator<int>(0), _flags, _selected, _numSelected, count);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_scanTemp, _scanTempBytes));
+			_count = count;
+		}
+		if (count == 0 || _tiles == 0)
+		{
+			_active = 0;
+			return 0;
+		}
+
+		visibleCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos, scale, viewmatrix, projmatrix, focal, scaleModifier,
+			_width, _height, _tileDepth, _flags);
+		cub::DeviceSelect::Flagged(_scanTemp, _scanTempBytes, cub::CountingInputIterator<int>(0),
+			_flags, _selected, _numSelected, count);
+		// The rasterizer needs the count on the host anyway.
+		cudaMemcpy(&_active, _numSelected, sizeof(int), cudaMemcpyDeviceToHost);
+
+		const int n = _active;
+		if (n > _capacity)
+		{
+			// Grow with some slack, the hidden part changes with the viewpoint.
+			const int capacity = std::min(count, n + n / 4);
+			for (void* ptr : { (void*)_pos, (void*)_rot, (void*)_scale, (void*)_opacity, (void*)_colors, (void*)_depthColors })
+				cudaFree(ptr);
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_pos, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_rot, sizeof(float) * 4 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_scale, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_opacity, sizeof(float) * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_colors, sizeof(float) * 3 * capacity));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_depthColors, sizeof(float) * 3 * capacity));
+			_capacity = capacity;
+		}
+		if (n > 0)
+		{
+			gatherVisibleCUDA << <blocks(n), BLOCK_SIZE >> > (n, _selected, pos, rot, scale, opacity, colors,
+				_pos, _rot, _scale, _opacity, _colors);
+		}
+		return n;
+	}
+
+	void GaussianOcclusion::computeDepthColors(const float * viewmatrix)
+	{
+		if (_active > 0)
+			depthColorsCUDA << <blocks(_active), BLOCK_SIZE >> > (_active, _pos, viewmatrix, _depthColors);
+	}
+
+	size_t GaussianOcclusion::gpuBytes(void) const
+	{
+		return sizeof(float) * size_t(_tiles) + (sizeof(int) + sizeof(char)) * size_t(_count) + _scanTempBytes
+			+ sizeof(float) * 17 * size_t(_capacity);
+	}
+
+} /*namespace sibr*/
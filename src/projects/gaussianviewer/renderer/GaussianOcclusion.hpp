@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <cstddef>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianOcclusion
+	 * \brief Gaussians not hidden by an opaque mesh, for the depth compositing of meshes in a Gaussian scene.
+	 * The mesh depth is reduced to the farthest depth of each 16x16 tile of the rasterizer; a Gaussian
+	 * whose nearest point (center minus three standard deviations) is behind that depth in all the tiles
+	 * it touches can't contribute to the image and is dropped. The others are gathered in contiguous
+	 * buffers, so that the rasterizer doesn't bin nor blend the hidden ones.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianOcclusion
+	{
+	public:
+
+		/// Constructor.
+		GaussianOcclusion(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianOcclusion(void);
+
+		GaussianOcclusion(const GaussianOcclusion &) = delete;
+		GaussianOcclusion & operator=(const GaussianOcclusion &) = delete;
+
+		/** Compute the farthest mesh depth of each tile.
+		 * \param depth device normalized device depths of the mesh, in [-1,1], 1 where there is no mesh, rows bottom to top
+		 * \param width the image width
+		 * \param height the image height
+		 * \param znear the near plane of the camera
+		 * \param zfar the far plane of the camera
+		 */
+		void setDepth(const float * depth, int width, int height, float znear, float zfar);
+
+		/** Select the Gaussians that are not hidden by the mesh, and gather them with their colors.
+		 * \param count number of Gaussians
+		 * \param pos device positions
+		 * \param rot device rotations
+		 * \param scale device scales
+		 * \param opacity device opacities
+		 * \param colors device colors, 3 floats per Gaussian
+		 * \param viewmatrix device view matrix, in the rasterizer convention
+		 * \param projmatrix device view projection matrix, in the rasterizer convention
+		 * \param focal the focal length, in pixels
+		 * \param scaleModifier the scale factor applied by the rasterizer
+		 * \return the number of selected Gaussians
+		 */
+		int update(int count, const float * pos, const float * rot, const float * scale, const float * opacity, const float * colors,
+			const float * viewmatrix, const float * projmatrix, float focal, float scaleModifier);
+
+		/** Write the view depth of the selected Gaussians as colors (depth, 1, 0). Rasterized over a black
+		 * background, they give the alpha of the Gaussians and their depth weighted by alpha.
+		 * \param viewmatrix device view matrix, in the rasterizer convention
+		 */
+		void computeDepthColors(const float * viewmatrix);
+
+		/** Release the device memory. */
+		void clear(void);
+
+		/** \return the number of Gaussians selected by the last update. */
+		int active(void) const { return _active; }
+
+		/** \return the device memory used, in bytes. */
+		size_t gpuBytes(void) const;
+
+		/** \name Gathered attributes of the selected Gaussians (device pointers).
+		 * @{ */
+		const float * positions(void) const { return _pos; }
+		const float * rotations(void) const { return _rot; }
+		const float * scales(void) const { return _scale; }
+		const float * opacities(void) const { return _opacity; }
+		const float * colors(void) const { return _colors; }
+		const float * depthColors(void) const { return _depthColors; }
+		/** @} */
+
+	private:
+
+		int _width = 0; ///< Image width.
+		int _height = 0; ///< Image height.
+		int _tiles = 0; ///< Number of tiles the depth buffer is sized for.
+		float * _tileDepth = nullptr; ///< Farthest mesh view depth of each tile, infinite where the mesh doesn't cover the tile.
+
+		int _count = 0; ///< Number of Gaussians the selection buffers are sized for.
+		int _active = 0; ///< Number of selected Gaussians.
+		char * _flags = nullptr; ///< Visible flag of each Gaussian.
+		int * _selected = nullptr; ///< Indices of the selected Gaussians.
+		int * _numSelected = nullptr; ///< Device selection counter.
+		void * _scanTemp = nullptr; ///< Temporary storage for stream compaction.
+		size_t _scanTempBytes = 0; ///< Size of the temporary storage.
+
+		int _capacity = 0; ///< Capacity of the gathered buffers.
+		float * _pos = nullptr;
+		float * _rot = nullptr;
+		float * _scale = nullptr;
+		float * _opacity = nullptr;
+		float * _colors = nullptr;
+		float * _depthColors = nullptr;
+	};
+
+} /*namespace sibr*/
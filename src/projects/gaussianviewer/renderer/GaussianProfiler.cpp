@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianProfiler.hpp"
+#include <fstream>
+
+namespace sibr {
+
+	const char * GaussianProfiler::name(Stage stage)
+	{
+		static const char * names[STAGE_COUNT] = { "Upload", "Colors", "Rasterize", "Copy", "Ellipsoids" };
+		return names[stage];
+	}
+
+	GaussianProfiler::GaussianProfiler(void)
+	{
+	}
+
+	GaussianProfiler::~GaussianProfiler(void)
+	{
+		if (!_initialized)
+			return;
+		for (int p = 0; p < 2; p++)
+		{
+			for (int s = 0; s < STAGE_COUNT; s++)
+			{
+				cudaEventDestroy(_start[p][s]);
+				cudaEventDestroy(_stop[p][s]);
+			}
+		}
+	}
+
+	void GaussianProfiler::init(void)
+	{
+		for (int p = 0; p < 2; p++)
+		{
+			for (int s = 0; s < STAGE_COUNT; s++)
+			{
+				cudaEventCreate(&_start[p][s]);
+				cudaEventCreate(&_stop[p][s]);
+			}
+		}
+		for (int s = 0; s < STAGE_COUNT; s++)
+		{
+			if (isGL(Stage(s)))
+				_queries[s].reset(new GPUQuery(GL_TIME_ELAPSED));
+		}
+		_samples.reserve(history);
+		_initialized = true;
+	}
+
+	void GaussianProfiler::begin(Stage stage)
+	{
+		if (isGL(stage))
+			_queries[stage]->begin();
+		else
+			cudaEventRecord(_start[_parity][stage], 0);
+	}
+
+	void GaussianProfiler::end(Stage stage)
+	{
+		if (isGL(stage))
+			_queries[stage]->end();
+		else
+			cudaEventRecord(_stop[_parity][stage], 0);
+		_ran[_parity][stage] = true;
+	}
+
+	void GaussianProfiler::frame(void)
+	{
+		// Read the frame before last, which is most likely complete on the GPU.
+		// GL queries are buffered the same way: value() returns the query before last.
+		const int previous = 1 - _parity;
+		std::array<float, STAGE_COUNT> sample;
+		bool any = false;
+		for (int s = 0; s < STAGE_COUNT; s++)
+		{
+			sample[s] = -1.0f;
+			if (!_ran[previous][s])
+				continue;
+			if (isGL(Stage(s)))
+			{
+				if (_ran[_parity][s])
+					sample[s] = float(_queries[s]->value()) * 1e-6f;
+			}
+			else if (cudaEventQuery(_stop[previous][s]) == cudaSuccess)
+			{
+				cudaEventElapsedTime(&sample[s], _start[previous][s], _stop[previous][s]);
+			}
+			any |= sample[s] >= 0.0f;
+		}
+
+		if (any)
+		{
+			if (_samples.size() < size_t(history))
+				_samples.push_back(sample);
+			else
+				_samples[_frames % history] = sample;
+			_frames++;
+		}
+
+		// The events of the frame before last are reused for the next frame.
+		for (int s = 0; s < STAGE_COUNT; s++)
+			_ran[previous][s] = false;
+		_parity = previous;
+	}
+
+	float GaussianProfiler::average(Stage stage) const
+	{
+		float sum = 0.0f;
+		int n = 0;
+		for (const auto & sample : _samples)
+		{
+			if (sample[stage] >= 0.0f)
+			{
+				sum += sample[stage];
+				n++;
+			}
+		}
+		return n > 0 ? sum / float(n) : 0.0f;
+	}
+
+	bool GaussianProfiler::exportCSV(const std::string & path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			SIBR_WRG << "Unable to write timings to " << path << std::endl;
+			return false;
+		}
+
+		file << "frame";
+		for (int s = 0; s < STAGE_COUNT; s++)
+			file << "," << name(Stage(s));
+		file << "\n";
+
+		// Oldest frame first.
+		const size_t count = _samples.size();
+		const size_t first = _frames - count;
+		for (size_t f = first; f < _frames; f++)
+		{
+			const auto & sample = _samples[f % history];
+			file << f;
+			for (int s = 0; s < STAGE_COUNT; s++)
+			{
+				file << ",";
+				if (sample[s] >= 0.0f)
+					file << sample[s];
+			}
+			file << "\n";
+		}
+		SIBR_LOG << "Wrote " << count << " frames of timings to " << path << std::endl;
+		return true;
+	}
+
+} /*namespace sibr*/
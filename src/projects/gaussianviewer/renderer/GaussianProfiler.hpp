@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include <core/graphics/GPUQuery.hpp>
+# include <cuda_runtime.h>
+# include <array>
+# include <memory>
+# include <string>
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianProfiler
+	 * \brief GPU timings of the stages of a Gaussian frame.
+	 * CUDA stages are measured with events on the default stream and GL stages with
+	 * timer queries. Results are read one frame late to avoid stalling, and kept over
+	 * a rolling window that can be averaged or exported as CSV.
+	 */
+	class SIBR_EXP_ULR_EXPORT GaussianProfiler
+	{
+		SIBR_DISALLOW_COPY(GaussianProfiler);
+	public:
+
+		/// Measured stages.
+		enum Stage { UPLOAD = 0, COLORS, RASTERIZE, COPY, ELLIPSOIDS, STAGE_COUNT };
+
+		/// Number of frames kept.
+		static const int history = 240;
+
+		/** \return the display name of a stage.
+		 * \param stage the stage
+		 */
+		static const char * name(Stage stage);
+
+		/// Constructor.
+		GaussianProfiler(void);
+
+		/// Destructor.
+		~GaussianProfiler(void);
+
+		/** Create the events and queries, on the current CUDA device and GL context. */
+		void init(void);
+
+		/** Start measuring a stage.
+		 * \param stage the stage
+		 */
+		void begin(Stage stage);
+
+		/** Stop measuring a stage.
+		 * \param stage the stage
+		 */
+		void end(Stage stage);
+
+		/** Collect the timings of the previous frame, to call once per frame. */
+		void frame(void);
+
+		/** \return the average time of a stage over the kept frames where it ran, in ms.
+		 * \param stage the stage
+		 */
+		float average(Stage stage) const;
+
+		/** Write the kept frames as CSV, one line per frame and one column per stage (ms, empty if it didn't run).
+		 * \param path the destination file
+		 * \return true if the file was written
+		 */
+		bool exportCSV(const std::string & path) const;
+
+	private:
+
+		/** \return true for stages timed with GL queries. */
+		static bool isGL(Stage stage) { return stage == COPY || stage == ELLIPSOIDS; }
+
+		cudaEvent_t _start[2][STAGE_COUNT]; ///< CUDA start events, per frame parity.
+		cudaEvent_t _stop[2][STAGE_COUNT]; ///< CUDA stop events, per frame parity.
+		std::array<std::unique_ptr<GPUQuery>, STAGE_COUNT> _queries; ///< GL timers.
+		bool _ran[2][STAGE_COUNT] = {}; ///< Stages measured in each frame parity.
+		bool _initialized = false; ///< Events and queries have been created.
+		int _parity = 0; ///< Parity of the frame being measured.
+		size_t _frames = 0; ///< Number of collected frames.
+		std::vector<std::array<float, STAGE_COUNT>> _samples; ///< Ring of timings, negative if a stage didn't run.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianPrune.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace sibr {
+
+	float GaussianPrune::contribution(const float * pos, const float * scale, float opacity, const std::vector<Camera> & cameras)
+	{
+		// Footprint of the 3 sigma extent of the largest axis.
+		const float radius = 3.0f * std::max(scale[0], std::max(scale[1], scale[2]));
+		float sum = 0.0f;
+		for (const Camera & camera : cameras)
+		{
+			const float* m = camera.viewproj;
+			const float w = m[3] * pos[0] + m[7] * pos[1] + m[11] * pos[2] + m[15];
+			if (w <= 0.2f)
+				continue;
+			const float x = (m[0] * pos[0] + m[4] * pos[1] + m[8] * pos[2] + m[12]) / w;
+			const float y = (m[1] * pos[0] + m[5] * pos[1] + m[9] * pos[2] + m[13]) / w;
+			if (std::abs(x) > 1.3f || std::abs(y) > 1.3f)
+				continue;
+			const float pixels = camera.focal * radius / w;
+			const float area = std::min(3.14159265f * pixels * pixels, float(camera.width) * float(camera.height));
+			sum += opacity * area;
+		}
+		return sum;
+	}
+
+	std::vector<int> GaussianPrune::select(int count, const float * pos, const float * scale, const float * opacity,
+		const std::vector<Camera> & cameras, float minOpacity, int budget)
+	{
+		std::vector<int> kept;
+		kept.reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			if (opacity[i] >= minOpacity)
+				kept.push_back(i);
+		}
+		if (budget <= 0 || int(kept.size()) <= budget)
+			return kept;
+
+		const int candidates = int(kept.size());
+		std::vector<float> contributions(candidates);
+		#pragma omp parallel for
+		for (int k = 0; k < candidates; k++)
+		{
+			const int i = kept[k];
+			contributions[k] = cameras.empty() ? opacity[i] : contribution(pos + 3 * i, scale + 3 * i, opacity[i], cameras);
+		}
+
+		// Partition the candidates by decreasing contribution, then restore the model order.
+		std::vector<int> order(candidates);
+		for (int k = 0; k < candidates; k++)
+			order[k] = k;
+		std::nth_element(order.begin(), order.begin() + budget, order.end(),
+			[&contributions](int a, int b) { return contributions[a] > contributions[b]; });
+		order.resize(budget);
+		std::sort(order.begin(), order.end());
+		for (int k = 0; k < budget; k++)
+			order[k] = kept[order[k]];
+		return order;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianPrune
+	 * \brief Load-time selection of the Gaussians worth rendering.
+	 * Gaussians below an opacity threshold are dropped. When a budget is given, the
+	 * remaining ones are ranked by their contribution to the input cameras: the sum,
+	 * over the cameras seeing their center, of their opacity times their projected
+	 * area in pixels (clamped to the image). Only the best ranked are kept.
+	 * Selected indices keep the model order, which preserves its spatial coherence.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianPrune
+	{
+	public:
+
+		/// A camera the contributions are estimated against.
+		struct Camera
+		{
+			float viewproj[16]; ///< Column major view-projection matrix, OpenGL conventions.
+			float focal; ///< Vertical focal length, in pixels.
+			int width, height; ///< Image size.
+		};
+
+		/** Select the kept Gaussians.
+		 * \param count number of Gaussians
+		 * \param pos host positions (3 floats)
+		 * \param scale host activated scales (3 floats)
+		 * \param opacity host activated opacities
+		 * \param cameras cameras to estimate the contributions against, only used with a budget
+		 * \param minOpacity Gaussians with a lower opacity are dropped
+		 * \param budget maximum number of kept Gaussians, 0 for no limit
+		 * \return the kept indices, in increasing order
+		 */
+		static std::vector<int> select(int count, const float * pos, const float * scale, const float * opacity,
+			const std::vector<Camera> & cameras, float minOpacity, int budget);
+
+		/** \return the contribution of a Gaussian to a set of cameras, see the class description.
+		 * \param pos position (3 floats)
+		 * \param scale activated scale (3 floats)
+		 * \param opacity activated opacity
+		 * \param cameras the cameras
+		 */
+		static float contribution(const float * pos, const float * scale, float opacity, const std::vector<Camera> & cameras);
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianQuery.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+
+#define BLOCK_SIZE 256
+
+// Extent of the picked ellipsoids, in standard deviations.
+#define PICK_SIGMAS 2.0f
+
+__device__ unsigned char combineFlag(unsigned char selected, bool inside, int mode)
+{
+	if (mode == sibr::GaussianQuery::ADD)
+		return selected | inside;
+	if (mode == sibr::GaussianQuery::SUBTRACT)
+		return selected & !inside;
+	return inside;
+}
+
+// Hits are packed as (distance bits, index): positive floats order like their bits.
+__global__ void pickCUDA(int n, const float* pos, const float* rot, const float* scale, const float* opacity,
+	float3 origin, float3 dir, float minOpacity, unsigned long long* best)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n || opacity[idx] < minOpacity)
+		return;
+
+	// Rotation of the ellipsoid, same convention as the ellipsoids shader.
+	const float r = rot[4 * idx + 0], x = rot[4 * idx + 1], y = rot[4 * idx + 2], z = rot[4 * idx + 3];
+	const float R[3][3] = {
+		{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - r * z), 2.0f * (x * z + r * y) },
+		{ 2.0f * (x * y + r * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - r * x) },
+		{ 2.0f * (x * z - r * y), 2.0f * (y * z + r * x), 1.0f - 2.0f * (x * x + y * y) }
+	};
+	const float o[3] = { origin.x - pos[3 * idx + 0], origin.y - pos[3 * idx + 1], origin.z - pos[3 * idx + 2] };
+	const float d[3] = { dir.x, dir.y, dir.z };
+
+	// Ray in the frame where the ellipsoid is the unit sphere.
+	float lo[3], ld[3];
+	for (int j = 0; j < 3; j++)
+	{
+		const float s = PICK_SIGMAS * scale[3 * idx + j];
+		lo[j] = (R[0][j] * o[0] + R[1][j] * o[1] + R[2][j] * o[2]) / s;
+		ld[j] = (R[0][j] * d[0] + R[1][j] * d[1] + R[2][j] * d[2]) / s;
+	}
+	const float a = ld[0] * ld[0] + ld[1] * ld[1] + ld[2] * ld[2];
+	const float b = lo[0] * ld[0] + lo[1] * ld[1] + lo[2] * ld[2];
+	const float c = lo[0] * lo[0] + lo[1] * lo[1] + lo[2] * lo[2] - 1.0f;
+	const float disc = b * b - a * c;
+	if (disc < 0.0f || a <= 0.0f)
+		return;
+	float t = (-b - sqrtf(disc)) / a;
+	if (t < 0.0f)
+		t = (-b + sqrtf(disc)) / a;
+	if (t < 0.0f)
+		return;
+	atomicMin(best, ((unsigned long long)__float_as_uint(t) << 32) | (unsigned int)idx);
+}
+
+__global__ void selectBoxCUDA(int n, const float* pos, float3 boxmin, float3 boxmax, int mode, unsigned char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float x = pos[3 * idx + 0];
+	const float y = pos[3 * idx + 1];
+	const float z = pos[3 * idx + 2];
+	const bool inside = x >= boxmin.x && y >= boxmin.y && z >= boxmin.z
+		&& x <= boxmax.x && y <= boxmax.y && z <= boxmax.z;
+	flags[idx] = combineFlag(flags[idx], inside, mode);
+}
+
+struct LassoCamera
+{
+	float m[16];
+};
+
+__global__ void selectLassoCUDA(int n, const float* pos, LassoCamera camera, const float* polygon, int vertices, int mode, unsigned char* flags)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= n)
+		return;
+
+	const float* m = camera.m;
+	const float px = pos[3 * idx + 0], py = pos[3 * idx + 1], pz = pos[3 * idx + 2];
+	const float w = m[3] * px + m[7] * py + m[11] * pz + m[15];
+	bool inside = false;
+	if (w > 0.0f)
+	{
+		// Even-odd crossing test.
+		const float x = (m[0] * px + m[4] * py + m[8] * pz + m[12]) / w;
+		const float y = (m[1] * px + m[5] * py + m[9] * pz + m[13]) / w;
+		for (int i = 0, j = vertices - 1; i < vertices; j = i++)
+		{
+			const float xi = polygon[2 * i], yi = polygon[2 * i + 1];
+			const float xj = polygon[2 * j], yj = polygon[2 * j + 1];
+			if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi)
+				inside = !inside;
+		}
+	}
+	flags[idx] = combineFlag(flags[idx], inside, mode);
+}
+
+__global__ void countFlagsCUDA(int n, const unsigned char* flags, int* count)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	const int inBlock = __syncthreads_count(idx < n && flags[idx]);
+	if (threadIdx.x == 0 && inBlock > 0)
+		atomicAdd(count, inBlock);
+}
+
+__global__ void maskCUDA(int n, const unsigned char* flags, float value, float* opacity)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx < n && flags[idx])
+		opacity[idx] = value;
+}
+
+namespace {
+
+	int blocks(int n)
+	{
+		return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+}
+
+namespace sibr {
+
+	GaussianQuery::GaussianQuery(void)
+	{
+	}
+
+	GaussianQuery::~GaussianQuery(void)
+	{
+		cudaFree(_flags);
+		cudaFree(_backup);
+		cudaFree(_polygon);
+		cudaFree(_result);
+	}
+
+	void GaussianQuery::reserve(int count)
+	{
+		if (_flags && count == _count)
+			return;
+		cudaFree(_flags);
+		_flags = nullptr;
+		_count = count;
+		_selected = 0;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_flags, count > 0 ? count : 1));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemset(_flags, 0, count > 0 ? count : 1));
+		if (!_result)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_result, sizeof(unsigned long long)));
+		}
+	}
+
+	int GaussianQuery::countSelected(int count)
+	{
+		int* result = static_cast<int*>(_result);
+		CUDA_SAFE_CALL_ALWAYS(cudaMemset(result, 0, sizeof(int)));
+		CUDA_SAFE_CALL_ALWAYS(countFlagsCUDA << <blocks(count), BLOCK_SIZE >> > (count, _flags, result));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(&_selected, result, sizeof(int), cudaMemcpyDeviceToHost));
+		return _selected;
+	}
+
+	int GaussianQuery::pick(int count, const float * pos, const float * rot, const float * scale, const float * opacity,
+		const float * origin, const float * dir, float minOpacity)
+	{
+		reserve(count);
+		if (count <= 0)
+			return -1;
+		unsigned long long* best = static_cast<unsigned long long*>(_result);
+		CUDA_SAFE_CALL_ALWAYS(cudaMemset(best, 0xff, sizeof(unsigned long long)));
+		CUDA_SAFE_CALL_ALWAYS(pickCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos, rot, scale, opacity,
+			make_float3(origin[0], origin[1], origin[2]), make_float3(dir[0], dir[1], dir[2]), minOpacity, best));
+		unsigned long long hit = 0;
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(&hit, best, sizeof(unsigned long long), cudaMemcpyDeviceToHost));
+		return hit == ~0ull ? -1 : int(hit & 0xffffffffu);
+	}
+
+	int GaussianQuery::selectIndex(int count, int index, Mode mode)
+	{
+		reserve(count);
+		if (mode == REPLACE)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemset(_flags, 0, count > 0 ? count : 1));
+		}
+		if (index >= 0 && index < count)
+		{
+			const unsigned char flag = mode == SUBTRACT ? 0 : 1;
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_flags + index, &flag, 1, cudaMemcpyHostToDevice));
+		}
+		return countSelected(count);
+	}
+
+	int GaussianQuery::selectBox(int count, const float * pos, const float * boxmin, const float * boxmax, Mode mode)
+	{
+		reserve(count);
+		if (count <= 0)
+			return 0;
+		CUDA_SAFE_CALL_ALWAYS(selectBoxCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos,
+			make_float3(boxmin[0], boxmin[1], boxmin[2]), make_float3(boxmax[0], boxmax[1], boxmax[2]), mode, _flags));
+		return countSelected(count);
+	}
+
+	int GaussianQuery::selectLasso(int count, const float * pos, const float * viewproj, const std::vector<float> & polygon, Mode mode)
+	{
+		reserve(count);
+		const int vertices = int(polygon.size() / 2);
+		if (count <= 0 || (vertices < 3 && mode != REPLACE))
+			return _selected;
+		if (polygon.size() > _polygonSize)
+		{
+			cudaFree(_polygon);
+			_polygonSize = polygon.size();
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_polygon, sizeof(float) * _polygonSize));
+		}
+		if (vertices > 0)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_polygon, polygon.data(), sizeof(float) * 2 * vertices, cudaMemcpyHostToDevice));
+		}
+		LassoCamera camera;
+		for (int i = 0; i < 16; i++)
+			camera.m[i] = viewproj[i];
+		CUDA_SAFE_CALL_ALWAYS(selectLassoCUDA << <blocks(count), BLOCK_SIZE >> > (count, pos, camera, _polygon, vertices < 3 ? 0 : vertices, mode, _flags));
+		return countSelected(count);
+	}
+
+	void GaussianQuery::clear(void)
+	{
+		if (_flags && _count > 0)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemset(_flags, 0, _count));
+		}
+		_selected = 0;
+	}
+
+	void GaussianQuery::mask(int count, float * opacity, float value)
+	{
+		reserve(count);
+		if (count <= 0)
+			return;
+		if (!_backup)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_backup, sizeof(float) * count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_backup, opacity, sizeof(float) * count, cudaMemcpyDeviceToDevice));
+		}
+		CUDA_SAFE_CALL_ALWAYS(maskCUDA << <blocks(count), BLOCK_SIZE >> > (count, _flags, value, opacity));
+	}
+
+	void GaussianQuery::restore(int count, float * opacity)
+	{
+		if (!_backup)
+			return;
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity, _backup, sizeof(float) * count, cudaMemcpyDeviceToDevice));
+		cudaFree(_backup);
+		_backup = nullptr;
+	}
+
+} /*namespace sibr*/
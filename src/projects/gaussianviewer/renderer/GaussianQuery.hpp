@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <cstddef>
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianQuery
+	 * \brief Picking and selection queries on the device buffers of a Gaussian model.
+	 * The selection is a device flag per Gaussian, combined with each query result
+	 * according to a mode. Selected Gaussians can be hidden by writing their opacity
+	 * in place, the original opacities being kept on the device to be restored.
+	 * Queries synchronize to return their result count.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianQuery
+	{
+	public:
+
+		/// How a query result is combined with the current selection.
+		enum Mode { REPLACE = 0, ADD, SUBTRACT };
+
+		/// Constructor.
+		GaussianQuery(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianQuery(void);
+
+		GaussianQuery(const GaussianQuery &) = delete;
+		GaussianQuery & operator=(const GaussianQuery &) = delete;
+
+		/** Find the nearest Gaussian whose 2 sigma ellipsoid (as drawn by the ellipsoids mode) is hit by a ray.
+		 * \param count number of Gaussians
+		 * \param pos device positions (3 floats)
+		 * \param rot device normalized quaternions (4 floats, real part first)
+		 * \param scale device activated scales (3 floats)
+		 * \param opacity device activated opacities
+		 * \param origin host ray origin
+		 * \param dir host normalized ray direction
+		 * \param minOpacity Gaussians less opaque than this are ignored
+		 * \return the index of the Gaussian, -1 if none is hit
+		 */
+		int pick(int count, const float * pos, const float * rot, const float * scale, const float * opacity,
+			const float * origin, const float * dir, float minOpacity);
+
+		/** Select a single Gaussian.
+		 * \param count number of Gaussians
+		 * \param index the Gaussian, nothing is selected if negative
+		 * \param mode how it is combined with the selection
+		 * \return the number of selected Gaussians
+		 */
+		int selectIndex(int count, int index, Mode mode);
+
+		/** Select the Gaussians whose center is in a box.
+		 * \param count number of Gaussians
+		 * \param pos device positions
+		 * \param boxmin host box minimum
+		 * \param boxmax host box maximum
+		 * \param mode how the result is combined with the selection
+		 * \return the number of selected Gaussians
+		 */
+		int selectBox(int count, const float * pos, const float * boxmin, const float * boxmax, Mode mode);
+
+		/** Select the Gaussians whose center projects inside a closed polygon.
+		 * \param count number of Gaussians
+		 * \param pos device positions
+		 * \param viewproj host column major view-projection matrix, OpenGL conventions
+		 * \param polygon host polygon vertices in normalized device coordinates, as x,y pairs
+		 * \param mode how the result is combined with the selection
+		 * \return the number of selected Gaussians
+		 */
+		int selectLasso(int count, const float * pos, const float * viewproj, const std::vector<float> & polygon, Mode mode);
+
+		/** Deselect everything. */
+		void clear(void);
+
+		/** Write an opacity to the selected Gaussians, the first write keeps a copy of the original opacities.
+		 * \param count number of Gaussians
+		 * \param opacity device opacities, modified in place
+		 * \param value the opacity written
+		 */
+		void mask(int count, float * opacity, float value);
+
+		/** Restore the opacities saved by the first mask() call.
+		 * \param count number of Gaussians
+		 * \param opacity device opacities, modified in place
+		 */
+		void restore(int count, float * opacity);
+
+		/** \return the number of selected Gaussians. */
+		int selected(void) const { return _selected; }
+
+		/** \return true if opacities have been masked since the last restore. */
+		bool masked(void) const { return _backup != nullptr; }
+
+		/** \return the device selection flags, nullptr if nothing was ever selected. */
+		const unsigned char * flags(void) const { return _flags; }
+
+	private:
+
+		/** Allocate the flags for a model size, the selection is lost if it changes. */
+		void reserve(int count);
+
+		/** \return the number of set flags. */
+		int countSelected(int count);
+
+		int _count = 0; ///< Gaussians covered by the flags.
+		int _selected = 0; ///< Number of set flags.
+		unsigned char * _flags = nullptr; ///< Device selection flags.
+		float * _backup = nullptr; ///< Device opacities before the first mask.
+		float * _polygon = nullptr; ///< Device lasso vertices.
+		size_t _polygonSize = 0; ///< Allocated lasso floats.
+		void * _result = nullptr; ///< Device query result.
+	};
+
+} /*namespace sibr*/
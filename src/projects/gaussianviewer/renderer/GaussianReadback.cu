@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianReadback.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <algorithm>
+
+#define BLOCK_SIZE 256
+
+// Planar float RGB to interleaved 8-bit RGBA, in the layout of GLSL unpackUnorm4x8.
+__global__ void packRGBA8CUDA(int pixels, const float* image, unsigned int* packed)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= pixels)
+		return;
+
+	unsigned int value = 255u << 24;
+	for (int c = 0; c < 3; c++)
+	{
+		const float v = fminf(fmaxf(image[c * pixels + idx], 0.0f), 1.0f);
+		value |= (unsigned int)(v * 255.0f + 0.5f) << (8 * c);
+	}
+	packed[idx] = value;
+}
+
+namespace sibr {
+
+	GaussianReadback::GaussianReadback(void)
+	{
+	}
+
+	GaussianReadback::~GaussianReadback(void)
+	{
+		release();
+	}
+
+	void GaussianReadback::release(void)
+	{
+		if (_stream)
+		{
+			cudaStreamSynchronize(static_cast<cudaStream_t>(_stream));
+			cudaStreamDestroy(static_cast<cudaStream_t>(_stream));
+			_stream = nullptr;
+		}
+		cudaFree(_image);
+		_image = nullptr;
+		for (int i = 0; i < 2; i++)
+		{
+			cudaFree(_device[i]);
+			cudaFreeHost(_host[i]);
+			if (_rendered[i])
+				cudaEventDestroy(static_cast<cudaEvent_t>(_rendered[i]));
+			if (_copied[i])
+				cudaEventDestroy(static_cast<cudaEvent_t>(_copied[i]));
+			_device[i] = _host[i] = _rendered[i] = _copied[i] = nullptr;
+			_pending[i] = false;
+		}
+		_bytes = 0;
+	}
+
+	void GaussianReadback::resize(int width, int height, bool packed)
+	{
+		release();
+		_width = width;
+		_height = height;
+		_packed = packed;
+		_current = 0;
+		const size_t pixels = size_t(width) * height;
+		_bytes = packed ? sizeof(unsigned int) * pixels : 3 * sizeof(float) * pixels;
+
+		cudaStream_t stream;
+		CUDA_SAFE_CALL_ALWAYS(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+		_stream = stream;
+		if (packed)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&_image, 3 * sizeof(float) * pixels));
+		}
+		for (int i = 0; i < 2; i++)
+		{
+			cudaEvent_t rendered, copied;
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_device[i], _bytes));
+			CUDA_SAFE_CALL_ALWAYS(cudaMallocHost(&_host[i], _bytes));
+			CUDA_SAFE_CALL_ALWAYS(cudaEventCreateWithFlags(&rendered, cudaEventDisableTiming));
+			CUDA_SAFE_CALL_ALWAYS(cudaEventCreateWithFlags(&copied, cudaEventDisableTiming));
+			_rendered[i] = rendered;
+			_copied[i] = copied;
+		}
+	}
+
+	float * GaussianReadback::begin(void)
+	{
+		// The buffer may still be read by the copy queued two frames ago.
+		cudaStreamWaitEvent(0, static_cast<cudaEvent_t>(_copied[_current]), 0);
+		return _packed ? _image : static_cast<float*>(_device[_current]);
+	}
+
+	void GaussianReadback::end(int width, int height)
+	{
+		// Reduced resolution frames only pack and transfer their own pixels.
+		const int pixels = std::min(width * height, _width * _height);
+		const size_t bytes = _packed ? sizeof(unsigned int) * pixels : 3 * sizeof(float) * pixels;
+		if (_packed && pixels > 0)
+		{
+			packRGBA8CUDA << <(pixels + BLOCK_SIZE - 1) / BLOCK_SIZE, BLOCK_SIZE >> > (pixels, _image, static_cast<unsigned int*>(_device[_current]));
+		}
+
+		// The copy waits for the rendering, but not the other way around.
+		cudaStream_t stream = static_cast<cudaStream_t>(_stream);
+		cudaEventRecord(static_cast<cudaEvent_t>(_rendered[_current]), 0);
+		cudaStreamWaitEvent(stream, static_cast<cudaEvent_t>(_rendered[_current]), 0);
+		cudaMemcpyAsync(_host[_current], _device[_current], bytes, cudaMemcpyDeviceToHost, stream);
+		cudaEventRecord(static_cast<cudaEvent_t>(_copied[_current]), stream);
+		_pending[_current] = true;
+		_current = 1 - _current;
+	}
+
+	const void * GaussianReadback::previous(void)
+	{
+		// After end(), the current buffer holds the frame before the one just queued.
+		if (!_pending[_current])
+			return nullptr;
+		cudaEventSynchronize(static_cast<cudaEvent_t>(_copied[_current]));
+		return _host[_current];
+	}
+
+	const void * GaussianReadback::latest(void)
+	{
+		const int last = 1 - _current;
+		cudaEventSynchronize(static_cast<cudaEvent_t>(_copied[last]));
+		return _host[last];
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <cstddef>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianReadback
+	 * \brief Double buffered image readback, used when CUDA/GL interop is unavailable.
+	 * Each frame is copied asynchronously to pinned host memory on a dedicated stream,
+	 * while the previous frame (whose copy overlapped the current rasterization) is
+	 * handed to GL. Images can optionally be packed to 8-bit RGBA on the device first,
+	 * which divides the transferred bytes by 3. This adds one frame of latency.
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianReadback
+	{
+	public:
+
+		/// Constructor.
+		GaussianReadback(void);
+
+		/// Destructor, releases the device and pinned memory.
+		~GaussianReadback(void);
+
+		GaussianReadback(const GaussianReadback &) = delete;
+		GaussianReadback & operator=(const GaussianReadback &) = delete;
+
+		/** Allocate the buffers for a resolution.
+		 * \param width image width
+		 * \param height image height
+		 * \param packed transfer 8-bit RGBA pixels instead of planar float RGB
+		 */
+		void resize(int width, int height, bool packed);
+
+		/** Start a frame.
+		 * \return the planar float RGB device image to rasterize into
+		 */
+		float * begin(void);
+
+		/** Queue the readback of the image rendered since begin().
+		 * \param width width of the rendered image, at most the allocated one
+		 * \param height height of the rendered image, at most the allocated one
+		 */
+		void end(int width, int height);
+
+		/** Wait for the readback queued by the previous end() call.
+		 * \return the host image of the previous frame, or nullptr if there is none yet
+		 */
+		const void * previous(void);
+
+		/** Wait for the readback queued by the last end() call.
+		 * \return the host image of the last frame
+		 */
+		const void * latest(void);
+
+		/** \return the size of a transferred image, in bytes. */
+		size_t bytes(void) const { return _bytes; }
+
+		/** \return true if images are transferred as 8-bit RGBA. */
+		bool packed(void) const { return _packed; }
+
+	private:
+
+		void release(void);
+
+		int _width = 0; ///< Image width.
+		int _height = 0; ///< Image height.
+		bool _packed = false; ///< Transfer 8-bit RGBA.
+		size_t _bytes = 0; ///< Transferred bytes per frame.
+		int _current = 0; ///< Buffer used by the frame being rendered.
+		float * _image = nullptr; ///< Float image rasterized into when packing.
+		void * _device[2] = { nullptr, nullptr }; ///< Device images read back, float or packed.
+		void * _host[2] = { nullptr, nullptr }; ///< Pinned destinations.
+		bool _pending[2] = { false, false }; ///< A readback has been queued in each buffer.
+		void * _stream = nullptr; ///< Copy stream.
+		void * _rendered[2] = { nullptr, nullptr }; ///< Recorded on the render stream at end().
+		void * _copied[2] = { nullptr, nullptr }; ///< Recorded on the copy stream after each readback.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianSHBuffer.hpp"
+#include "GaussianCuda.hpp"
+#include <cuda_runtime.h>
+#include <cuda_fp16.h>
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#define SH_MAX_COEFFS 16
+#define SH_MAX_REST ((SH_MAX_COEFFS - 1) * 3)
+#define CODEBOOK_TILE 64
+#define BLOCK_SIZE 256
+
+// Host data is converted by batches, to bound the temporary device memory.
+#define UPLOAD_BATCH (1 << 20)
+#define TRAINING_SAMPLES (1 << 18)
+#define KMEANS_ITERATIONS 8
+
+// Same constants and evaluation as the rasterizer forward pass.
+__device__ const float SH_C0 = 0.28209479177387814f;
+__device__ const float SH_C1 = 0.4886025119029199f;
+__device__ const float SH_C2[] = {
+	1.0925484305920792f,
+	-1.0925484305920792f,
+	0.31539156525252005f,
+	-1.0925484305920792f,
+	0.5462742152960396f
+};
+__device__ const float SH_C3[] = {
+	-0.5900435899266435f,
+	2.890611442640554f,
+	-0.4570457994644658f,
+	0.3731763325901154f,
+	-0.4570457994644658f,
+	1.445305721320277f,
+	-0.5900435899266435f
+};
+
+__device__ float3 operator*(float a, float3 b) { return make_float3(a * b.x, a * b.y, a * b.z); }
+__device__ float3 operator+(float3 a, float3 b) { return make_float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+__device__ float3 operator-(float3 a, float3 b) { return make_float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+
+// Specialized per degree, so that the bands above it cost nothing.
+template<int DEG>
+__device__ float3 evaluateSH(const float3* sh, float3 dir)
+{
+	float3 result = SH_C0 * sh[0];
+	if (DEG > 0)
+	{
+		float x = dir.x;
+		float y = dir.y;
+		float z = dir.z;
+		result = result - SH_C1 * y * sh[1] + SH_C1 * z * sh[2] - SH_C1 * x * sh[3];
+
+		if (DEG > 1)
+		{
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, yz = y * z, xz = x * z;
+			result = result +
+				SH_C2[0] * xy * sh[4] +
+				SH_C2[1] * yz * sh[5] +
+				SH_C2[2] * (2.0f * zz - xx - yy) * sh[6] +
+				SH_C2[3] * xz * sh[7] +
+				SH_C2[4] * (xx - yy) * sh[8];
+
+			if (DEG > 2)
+			{
+				result = result +
+					SH_C3[0] * y * (3.0f * xx - yy) * sh[9] +
+					SH_C3[1] * xy * z * sh[10] +
+					SH_C3[2] * y * (4.0f * zz - xx - yy) * sh[11] +
+					SH_C3[3] * z * (2.0f * zz - 3.0f * xx - 3.0f * yy) * sh[12] +
+					SH_C3[4] * x * (4.0f * zz - xx - yy) * sh[13] +
+					SH_C3[5] * z * (xx - yy) * sh[14] +
+					SH_C3[6] * x * (xx - 3.0f * yy) * sh[15];
+			}
+		}
+	}
+	result = result + make_float3(0.5f, 0.5f, 0.5f);
+	return make_float3(fmaxf(result.x, 0.0f), fmaxf(result.y, 0.0f), fmaxf(result.z, 0.0f));
+}
+
+// Gather the coefficients of Gaussian idx, as floats, whatever the storage.
+template<int STORAGE>
+__device__ void loadSH(int idx, int coeffs, int count, const void* data, const uint16_t* indices, const float* codebook, float3* sh)
+{
+	if (STORAGE == sibr::GaussianSHBuffer::FLOAT_STORAGE)
+	{
+		const float* src = static_cast<const float*>(data) + size_t(idx) * coeffs * 3;
+#pragma unroll
+		for (int j = 0; j < count; j++)
+			sh[j] = make_float3(src[3 * j + 0], src[3 * j + 1], src[3 * j + 2]);
+	}
+	else if (STORAGE == sibr::GaussianSHBuffer::HALF_STORAGE)
+	{
+		const __half* src = static_cast<const __half*>(data) + size_t(idx) * coeffs * 3;
+#pragma unroll
+		for (int j = 0; j < count; j++)
+			sh[j] = make_float3(__half2float(src[3 * j + 0]), __half2float(src[3 * j + 1]), __half2float(src[3 * j + 2]));
+	}
+	else
+	{
+		const __half* dc = static_cast<const __half*>(data) + size_t(idx) * 3;
+		sh[0] = make_float3(__half2float(dc[0]), __half2float(dc[1]), __half2float(dc[2]));
+		const float* rest = codebook + size_t(indices[idx]) * (coeffs - 1) * 3;
+#pragma unroll
+		for (int j = 1; j < count; j++)
+			sh[j] = make_float3(rest[3 * (j - 1) + 0], rest[3 * (j - 1) + 1], rest[3 * (j - 1) + 2]);
+	}
+}
+
+// One instance per storage and degree: only the evaluated coefficients are loaded, with unrolled loops.
+template<int STORAGE, int DEG>
+__global__ void computeColorsCUDA(int P, int coeffs, const void* data, const uint16_t* indices, const float* codebook,
+	const float* means, const float* campos, const int* list, float* colors)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= P)
+		return;
+	const int src = list ? list[idx] : idx;
+
+	constexpr int used = (DEG + 1) * (DEG + 1);
+	float3 sh[used];
+	loadSH<STORAGE>(src, coeffs, used, data, indices, codebook, sh);
+
+	float3 dir = make_float3(means[3 * src + 0] - campos[0], means[3 * src + 1] - campos[1], means[3 * src + 2] - campos[2]);
+	const float invLength = rsqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+	dir = invLength * dir;
+
+	const float3 rgb = evaluateSH<DEG>(sh, dir);
+	colors[3 * idx + 0] = rgb.x;
+	colors[3 * idx + 1] = rgb.y;
+	colors[3 * idx + 2] = rgb.z;
+}
+
+template<int STORAGE>
+__global__ void decodeCUDA(int P, int coeffs, const void* data, const uint16_t* indices, const float* codebook, float* out)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= P)
+		return;
+
+	float3 sh[SH_MAX_COEFFS];
+	loadSH<STORAGE>(idx, coeffs, coeffs, data, indices, codebook, sh);
+	for (int j = 0; j < coeffs; j++)
+	{
+		out[(size_t(idx) * coeffs + j) * 3 + 0] = sh[j].x;
+		out[(size_t(idx) * coeffs + j) * 3 + 1] = sh[j].y;
+		out[(size_t(idx) * coeffs + j) * 3 + 2] = sh[j].z;
+	}
+}
+
+// Convert the first n floats of each Gaussian (stored with the given stride) to halves.
+__global__ void packHalfCUDA(int P, int n, int stride, const float* src, __half* dst)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= P)
+		return;
+	for (int i = 0; i < n; i++)
+		dst[size_t(idx) * n + i] = __float2half(src[size_t(idx) * stride + i]);
+}
+
+// Find the closest codeword to the higher-order bands of each Gaussian. When
+// accumulators are given, also sum the vectors per codeword (k-means update).
+__global__ void assignCodewordsCUDA(int N, int dim, int stride, const float* src, int K, const float* codebook,
+	uint16_t* indices, float* accum, int* counts)
+{
+	extern __shared__ float tile[];
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+	float v[SH_MAX_REST];
+	if (idx < N)
+		for (int d = 0; d < dim; d++)
+			v[d] = src[size_t(idx) * stride + 3 + d];
+
+	float bestDist = FLT_MAX;
+	int best = 0;
+	for (int base = 0; base < K; base += CODEBOOK_TILE)
+	{
+		const int tileSize = min(CODEBOOK_TILE, K - base);
+		for (int i = threadIdx.x; i < tileSize * dim; i += blockDim.x)
+			tile[i] = codebook[size_t(base) * dim + i];
+		__syncthreads();
+
+		if (idx < N)
+		{
+			for (int k = 0; k < tileSize; k++)
+			{
+				float dist = 0.0f;
+				for (int d = 0; d < dim; d++)
+				{
+					const float diff = v[d] - tile[k * dim + d];
+					dist += diff * diff;
+				}
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					best = base + k;
+				}
+			}
+		}
+		__syncthreads();
+	}
+
+	if (idx >= N)
+		return;
+	if (indices)
+		indices[idx] = uint16_t(best);
+	if (accum)
+	{
+		for (int d = 0; d < dim; d++)
+			atomicAdd(&accum[size_t(best) * dim + d], v[d]);
+		atomicAdd(&counts[best], 1);
+	}
+}
+
+__global__ void updateCodebookCUDA(int K, int dim, const float* accum, const int* counts, float* codebook)
+{
+	const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+	if (idx >= K * dim)
+		return;
+	const int k = idx / dim;
+	if (counts[k] > 0)
+		codebook[idx] = accum[idx] / float(counts[k]);
+}
+
+static int blocks(int n)
+{
+	return (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+typedef void(*ColorKernel)(int, int, const void*, const uint16_t*, const float*, const float*, const float*, const int*, float*);
+
+// Color kernels by storage and degree.
+static const ColorKernel colorKernels[3][4] = {
+	{ computeColorsCUDA<sibr::GaussianSHBuffer::FLOAT_STORAGE, 0>, computeColorsCUDA<sibr::GaussianSHBuffer::FLOAT_STORAGE, 1>,
+	  computeColorsCUDA<sibr::GaussianSHBuffer::FLOAT_STORAGE, 2>, computeColorsCUDA<sibr::GaussianSHBuffer::FLOAT_STORAGE, 3> },
+	{ computeColorsCUDA<sibr::GaussianSHBuffer::HALF_STORAGE, 0>, computeColorsCUDA<sibr::GaussianSHBuffer::HALF_STORAGE, 1>,
+	  computeColorsCUDA<sibr::GaussianSHBuffer::HALF_STORAGE, 2>, computeColorsCUDA<sibr::GaussianSHBuffer::HALF_STORAGE, 3> },
+	{ computeColorsCUDA<sibr::GaussianSHBuffer::QUANTIZED_STORAGE, 0>, computeColorsCUDA<sibr::GaussianSHBuffer::QUANTIZED_STORAGE, 1>,
+	  computeColorsCUDA<sibr::GaussianSHBuffer::QUANTIZED_STORAGE, 2>, computeColorsCUDA<sibr::GaussianSHBuffer::QUANTIZED_STORAGE, 3> }
+};
+
+// Highest degree whose bands all fit in coeffs coefficients.
+static int storedDegree(int coeffs)
+{
+	int degree = 0;
+	while (degree < 3 && (degree + 2) * (degree + 2) <= coeffs)
+		degree++;
+	return degree;
+}
+
+namespace sibr {
+
+	GaussianSHBuffer::Storage GaussianSHBuffer::storageFromName(const std::string & name)
+	{
+		if (name == "half" || name == "fp16")
+			return HALF_STORAGE;
+		if (name == "vq" || name == "quantized")
+			return QUANTIZED_STORAGE;
+		return FLOAT_STORAGE;
+	}
+
+	GaussianSHBuffer::GaussianSHBuffer(void)
+	{
+	}
+
+	GaussianSHBuffer::~GaussianSHBuffer(void)
+	{
+		release();
+	}
+
+	void GaussianSHBuffer::release(void)
+	{
+		if (_owned)
+			cudaFree(_data);
+		_owned = true;
+		cudaFree(_indices);
+		cudaFree(_codebook);
+		_data = nullptr;
+		_indices = nullptr;
+		_codebook = nullptr;
+		_bytes = 0;
+	}
+
+	void GaussianSHBuffer::upload(const float * shs, int count, int coeffs, Storage storage, int codebookSize)
+	{
+		release();
+		_count = count;
+		_coeffs = coeffs;
+		_degree = storedDegree(coeffs);
+		_storage = storage;
+		const int stride = coeffs * 3;
+
+		if (_storage == QUANTIZED_STORAGE && (_coeffs == 1 || count == 0))
+			_storage = HALF_STORAGE;
+
+		if (_storage == FLOAT_STORAGE)
+		{
+			_bytes = sizeof(float) * stride * count;
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_data, _bytes));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_data, shs, _bytes, cudaMemcpyHostToDevice));
+			return;
+		}
+
+		// Half floats for all coefficients, or for the DC band only.
+		const int packed = _storage == HALF_STORAGE ? stride : 3;
+		_bytes = sizeof(__half) * packed * count;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_data, _bytes));
+
+		float* staging = nullptr;
+		const int batch = std::min(count, UPLOAD_BATCH);
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&staging, sizeof(float) * stride * std::max(batch, 1)));
+		for (int start = 0; start < count; start += batch)
+		{
+			const int n = std::min(batch, count - start);
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(staging, shs + size_t(start) * stride, sizeof(float) * stride * n, cudaMemcpyHostToDevice));
+			packHalfCUDA << <blocks(n), BLOCK_SIZE >> > (n, packed, stride, staging, static_cast<__half*>(_data) + size_t(start) * packed);
+		}
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(staging));
+
+		if (_storage == QUANTIZED_STORAGE)
+			quantize(shs, codebookSize);
+	}
+
+	void GaussianSHBuffer::allocate(int count, int coeffs)
+	{
+		release();
+		_count = count;
+		_coeffs = coeffs;
+		_degree = storedDegree(coeffs);
+		_storage = FLOAT_STORAGE;
+		_bytes = sizeof(float) * coeffs * 3 * count;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_data, _bytes));
+	}
+
+	void GaussianSHBuffer::wrap(float * shs, int count, int coeffs)
+	{
+		release();
+		_count = count;
+		_coeffs = coeffs;
+		_degree = storedDegree(coeffs);
+		_storage = FLOAT_STORAGE;
+		_bytes = sizeof(float) * coeffs * 3 * count;
+		_data = shs;
+		_owned = false;
+	}
+
+	void GaussianSHBuffer::quantize(const float * shs, int codebookSize)
+	{
+		const int stride = _coeffs * 3;
+		const int dim = (_coeffs - 1) * 3;
+
+		// Train on a regular subsample of the model: Gaussians are Morton ordered,
+		// so this covers the whole scene.
+		const int samples = std::min(_count, TRAINING_SAMPLES);
+		std::vector<float> training(size_t(samples) * stride);
+		for (int s = 0; s < samples; s++)
+		{
+			const size_t src = size_t((int64_t(s) * _count) / samples);
+			std::copy(shs + src * stride, shs + (src + 1) * stride, training.begin() + size_t(s) * stride);
+		}
+		_codebookSize = std::max(1, std::min({ codebookSize, samples, 65536 }));
+
+		// Initial codewords are spread over the training samples.
+		std::vector<float> codebook(size_t(_codebookSize) * dim);
+		for (int k = 0; k < _codebookSize; k++)
+		{
+			const size_t src = size_t((int64_t(k) * samples) / _codebookSize);
+			std::copy(training.begin() + src * stride + 3, training.begin() + (src + 1) * stride, codebook.begin() + size_t(k) * dim);
+		}
+
+		float* trainingCuda = nullptr;
+		float* accumCuda = nullptr;
+		int* countsCuda = nullptr;
+		const size_t shared = sizeof(float) * CODEBOOK_TILE * dim;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_codebook, sizeof(float) * codebook.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(_codebook, codebook.data(), sizeof(float) * codebook.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&trainingCuda, sizeof(float) * training.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(trainingCuda, training.data(), sizeof(float) * training.size(), cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&accumCuda, sizeof(float) * codebook.size()));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&countsCuda, sizeof(int) * _codebookSize));
+
+		for (int it = 0; it < KMEANS_ITERATIONS; it++)
+		{
+			cudaMemset(accumCuda, 0, sizeof(float) * codebook.size());
+			cudaMemset(countsCuda, 0, sizeof(int) * _codebookSize);
+			assignCodewordsCUDA << <blocks(samples), BLOCK_SIZE, shared >> > (samples, dim, stride, trainingCuda, _codebookSize, _codebook, nullptr, accumCuda, countsCuda);
+			updateCodebookCUDA << <blocks(_codebookSize * dim), BLOCK_SIZE >> > (_codebookSize, dim, accumCuda, countsCuda, _codebook);
+		}
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(trainingCuda));
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(accumCuda));
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(countsCuda));
+
+		// Assign the final codewords to all Gaussians.
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&_indices, sizeof(uint16_t) * _count));
+		float* staging = nullptr;
+		const int batch = std::min(_count, UPLOAD_BATCH);
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&staging, sizeof(float) * stride * batch));
+		for (int start = 0; start < _count; start += batch)
+		{
+			const int n = std::min(batch, _count - start);
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(staging, shs + size_t(start) * stride, sizeof(float) * stride * n, cudaMemcpyHostToDevice));
+			assignCodewordsCUDA << <blocks(n), BLOCK_SIZE, shared >> > (n, dim, stride, staging, _codebookSize, _codebook, _indices + start, nullptr, nullptr);
+		}
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(staging));
+
+		_bytes += sizeof(uint16_t) * _count + sizeof(float) * codebook.size();
+	}
+
+	void GaussianSHBuffer::computeColors(int degree, const float * means, const float * campos, float * colors, int count, const int * indices) const
+	{
+		const int n = count < 0 ? _count : count;
+		if (n == 0)
+			return;
+
+		// Never evaluate more bands than what is stored.
+		const ColorKernel kernel = colorKernels[_storage][std::max(0, std::min(degree, _degree))];
+		kernel << <blocks(n), BLOCK_SIZE >> > (n, _coeffs, _data, _indices, _codebook, means, campos, indices, colors);
+	}
+
+	void GaussianSHBuffer::download(float * shs) const
+	{
+		if (_count == 0)
+			return;
+		if (_storage == FLOAT_STORAGE)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(shs, _data, _bytes, cudaMemcpyDeviceToHost));
+			return;
+		}
+
+		float* decoded = nullptr;
+		const size_t bytes = sizeof(float) * _coeffs * 3 * _count;
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc(&decoded, bytes));
+		if (_storage == HALF_STORAGE)
+			decodeCUDA<HALF_STORAGE> << <blocks(_count), BLOCK_SIZE >> > (_count, _coeffs, _data, _indices, _codebook, decoded);
+		else
+			decodeCUDA<QUANTIZED_STORAGE> << <blocks(_count), BLOCK_SIZE >> > (_count, _coeffs, _data, _indices, _codebook, decoded);
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(shs, decoded, bytes, cudaMemcpyDeviceToHost));
+		CUDA_SAFE_CALL_ALWAYS(cudaFree(decoded));
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include <cstddef>
+# include <cstdint>
+# include <string>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianSHBuffer
+	 * \brief GPU storage of the SH coefficients of a Gaussian model.
+	 * Coefficients can be kept as floats (as expected by the rasterizer), as
+	 * half floats, or quantized: the DC band is stored as half floats and the
+	 * higher-order bands are replaced by an index in a codebook trained with
+	 * k-means on the GPU. For compact storages, the view dependent colors have
+	 * to be evaluated with computeColors() and given to the rasterizer as
+	 * precomputed colors.
+	 * Host-side coefficients are interleaved per Gaussian as [coeff][rgb].
+	 * \note This header is shared with CUDA code and only depends on the standard library.
+	 */
+	class GaussianSHBuffer
+	{
+	public:
+
+		/// Available storage modes.
+		enum Storage { FLOAT_STORAGE = 0, HALF_STORAGE, QUANTIZED_STORAGE };
+
+		/** Parse a storage mode from its command line name (float, half or vq).
+		 * \param name the storage name
+		 * \return the corresponding storage, float if unknown
+		 */
+		static Storage storageFromName(const std::string & name);
+
+		/// Constructor.
+		GaussianSHBuffer(void);
+
+		/// Destructor, releases the device memory.
+		~GaussianSHBuffer(void);
+
+		GaussianSHBuffer(const GaussianSHBuffer &) = delete;
+		GaussianSHBuffer & operator=(const GaussianSHBuffer &) = delete;
+
+		/** Upload coefficients to the GPU using a given storage.
+		 * \param shs host coefficients, coeffs*3 floats per Gaussian
+		 * \param count number of Gaussians
+		 * \param coeffs number of SH coefficients per Gaussian
+		 * \param storage the storage mode
+		 * \param codebookSize number of codewords used for quantized storage (at most 65536)
+		 */
+		void upload(const float * shs, int count, int coeffs, Storage storage, int codebookSize = 4096);
+
+		/** Allocate float coefficients without initializing them, for data written later on the device.
+		 * \param count number of Gaussians
+		 * \param coeffs number of SH coefficients per Gaussian
+		 */
+		void allocate(int count, int coeffs);
+
+		/** Use float coefficients owned by someone else, such as a GL buffer mapped for CUDA.
+		 * The memory is not released by the buffer.
+		 * \param shs device coefficients, coeffs*3 floats per Gaussian
+		 * \param count number of Gaussians
+		 * \param coeffs number of SH coefficients per Gaussian
+		 */
+		void wrap(float * shs, int count, int coeffs);
+
+		/** \return the current storage mode. */
+		Storage storage(void) const { return _storage; }
+
+		/** \return the number of codewords of the quantized storage. */
+		int codebookSize(void) const { return _codebookSize; }
+
+		/** \return true if colors have to be precomputed with computeColors(). */
+		bool compact(void) const { return _storage != FLOAT_STORAGE; }
+
+		/** \return the float coefficients that can be given to the rasterizer, or nullptr for compact storages. */
+		const float * floatSHs(void) const { return _storage == FLOAT_STORAGE ? static_cast<const float*>(_data) : nullptr; }
+
+		/** \return the writable float coefficients, or nullptr for compact storages. */
+		float * floatSHs(void) { return _storage == FLOAT_STORAGE ? static_cast<float*>(_data) : nullptr; }
+
+		/** \return the number of Gaussians. */
+		int count(void) const { return _count; }
+
+		/** \return the number of SH coefficients per Gaussian. */
+		int coeffs(void) const { return _coeffs; }
+
+		/** \return the highest SH degree stored, computeColors() evaluates at most this one. */
+		int degree(void) const { return _degree; }
+
+		/** Evaluate the view dependent color of Gaussians, with a kernel specialized for the storage and degree.
+		 * \param degree the SH degree to evaluate
+		 * \param means device positions, 3 floats per Gaussian
+		 * \param campos device camera position
+		 * \param colors device output, 3 floats per evaluated Gaussian
+		 * \param count number of Gaussians to evaluate, all of them if negative
+		 * \param indices optional device list of the Gaussians to evaluate, colors are written in list order
+		 */
+		void computeColors(int degree, const float * means, const float * campos, float * colors, int count = -1, const int * indices = nullptr) const;
+
+		/** Decode the coefficients back to floats on the host.
+		 * \param shs host destination, coeffs*3 floats per Gaussian
+		 */
+		void download(float * shs) const;
+
+		/** \return the device memory used by the coefficients, in bytes. */
+		size_t gpuBytes(void) const { return _bytes; }
+
+	private:
+
+		/** Train the codebook and assign a codeword to each Gaussian. */
+		void quantize(const float * shs, int codebookSize);
+
+		void release(void);
+
+		Storage _storage = FLOAT_STORAGE; ///< Current storage.
+		int _count = 0; ///< Number of Gaussians.
+		int _coeffs = 16; ///< SH coefficients per Gaussian.
+		int _degree = 3; ///< Highest degree stored in the coefficients.
+		int _codebookSize = 0; ///< Number of codewords.
+		void * _data = nullptr; ///< Float, half or DC band coefficients.
+		uint16_t * _indices = nullptr; ///< Codeword index per Gaussian.
+		float * _codebook = nullptr; ///< Codewords for the higher-order bands.
+		size_t _bytes = 0; ///< Device memory used.
+		bool _owned = true; ///< _data is released with the buffer.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianScratch.hpp"
+#include "GaussianCuda.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace sibr {
+
+	GaussianScratch::GaussianScratch(void)
+	{
+	}
+
+	GaussianScratch::~GaussianScratch(void)
+	{
+		for (char* ptr : _ptrs)
+		{
+			if (!ptr)
+				continue;
+			if (_pool)
+				cudaFreeAsync(ptr, 0);
+			else
+				cudaFree(ptr);
+		}
+		if (_pool)
+		{
+			cudaStreamSynchronize(0);
+			cudaMemPoolDestroy(_pool);
+		}
+	}
+
+	void GaussianScratch::init(int device)
+	{
+		int supported = 0;
+		cudaDeviceGetAttribute(&supported, cudaDevAttrMemoryPoolsSupported, device);
+		if (!supported)
+		{
+			SIBR_WRG << "Memory pools are not supported, rasterizer buffers use cudaMalloc." << std::endl;
+			return;
+		}
+
+		cudaMemPoolProps props = {};
+		props.allocType = cudaMemAllocationTypePinned;
+		props.location.type = cudaMemLocationTypeDevice;
+		props.location.id = device;
+		CUDA_SAFE_CALL_ALWAYS(cudaMemPoolCreate(&_pool, &props));
+
+		// Never give the memory back to the driver, freed blocks are reused by the next growth.
+		uint64_t threshold = UINT64_MAX;
+		CUDA_SAFE_CALL_ALWAYS(cudaMemPoolSetAttribute(_pool, cudaMemPoolAttrReleaseThreshold, &threshold));
+	}
+
+	void GaussianScratch::grow(Buffer buffer, size_t bytes)
+	{
+		char*& ptr = _ptrs[buffer];
+		if (_pool)
+		{
+			// Stream ordered: the old buffer is released once the work using it is done.
+			if (ptr)
+				CUDA_SAFE_CALL(cudaFreeAsync(ptr, 0));
+			CUDA_SAFE_CALL(cudaMallocFromPoolAsync((void**)&ptr, bytes, _pool, 0));
+		}
+		else
+		{
+			if (ptr)
+				CUDA_SAFE_CALL(cudaFree(ptr));
+			CUDA_SAFE_CALL(cudaMalloc((void**)&ptr, bytes));
+		}
+		_allocated[buffer] = bytes;
+	}
+
+	std::function<char* (size_t N)> GaussianScratch::functional(Buffer buffer)
+	{
+		return [this, buffer](size_t N) {
+			_current[buffer] = N;
+			_peak[buffer] = std::max(_peak[buffer], N);
+			if (N > _allocated[buffer])
+				grow(buffer, 2 * N);
+			return _ptrs[buffer];
+		};
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include <cuda_runtime.h>
+# include <array>
+# include <functional>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianScratch
+	 * \brief Scratch memory of the rasterizer, allocated from a stream-ordered memory pool.
+	 * Buffers only grow. When they do, the previous allocation is returned to a pool
+	 * that keeps its memory, so zooming in and out doesn't go back to the driver and
+	 * never synchronizes the device. Requested sizes are tracked to report high-water
+	 * marks; a warm-up pass is enough to pre-size the buffers.
+	 * Falls back to plain cudaMalloc on devices without memory pools.
+	 */
+	class SIBR_EXP_ULR_EXPORT GaussianScratch
+	{
+		SIBR_DISALLOW_COPY(GaussianScratch);
+	public:
+
+		/// Scratch buffers used by the rasterizer.
+		enum Buffer { GEOMETRY = 0, BINNING, IMAGE, BUFFER_COUNT };
+
+		/// Constructor.
+		GaussianScratch(void);
+
+		/// Destructor, releases the buffers and the pool.
+		~GaussianScratch(void);
+
+		/** Create the memory pool.
+		 * \param device the CUDA device
+		 */
+		void init(int device);
+
+		/** \return the resize callback expected by the rasterizer for a buffer.
+		 * \param buffer the buffer
+		 */
+		std::function<char* (size_t N)> functional(Buffer buffer);
+
+		/** \return the size requested by the last rasterization, in bytes.
+		 * \param buffer the buffer
+		 */
+		size_t current(Buffer buffer) const { return _current[buffer]; }
+
+		/** \return the largest size requested so far, in bytes.
+		 * \param buffer the buffer
+		 */
+		size_t peak(Buffer buffer) const { return _peak[buffer]; }
+
+		/** \return the allocated size, in bytes.
+		 * \param buffer the buffer
+		 */
+		size_t allocated(Buffer buffer) const { return _allocated[buffer]; }
+
+		/** \return true if buffers come from a stream-ordered pool. */
+		bool pooled(void) const { return _pool != nullptr; }
+
+	private:
+
+		/** Grow a buffer to a given size. */
+		void grow(Buffer buffer, size_t bytes);
+
+		cudaMemPool_t _pool = nullptr; ///< Pool keeping the freed memory.
+		std::array<char*, BUFFER_COUNT> _ptrs = {}; ///< Buffers.
+		std::array<size_t, BUFFER_COUNT> _current = {}; ///< Last requested sizes.
+		std::array<size_t, BUFFER_COUNT> _peak = {}; ///< High-water marks.
+		std::array<size_t, BUFFER_COUNT> _allocated = {}; ///< Allocated sizes.
+	};
+
+} /*namespace sibr*/
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianSplitFrame.hpp"
+#include "GaussianCuda.hpp"
+#include "GaussianBand.hpp"
+#include "GaussianScratch.hpp"
+#include <cuda_runtime.h>
+#include <rasterizer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// Tile size of the rasterizer, bands are made of whole tile rows.
+static const int kTileRows = 16;
+
+namespace sibr {
+
+	struct GaussianSplitFrame::Device
+	{
+		int id = 0; ///< CUDA device.
+		int rowBegin = 0, rowEnd = 0; ///< Band of the current frame.
+		int active = 0; ///< Gaussians rasterized in the last frame.
+		float ms = 0.0f; ///< Time of the last frame.
+
+		float* pos = nullptr; ///< Replica, nullptr on the primary device.
+		float* rot = nullptr;
+		float* scale = nullptr;
+		float* opacity = nullptr;
+		GaussianSHBuffer shs;
+
+		float* params = nullptr; ///< Device frame parameters.
+		float* paramsHost = nullptr; ///< Pinned staging of the frame parameters.
+		float* background = nullptr;
+		int* rects = nullptr;
+		float* image = nullptr; ///< Full size image rasterized into.
+
+		GaussianScratch scratch;
+		std::function<char* (size_t N)> geomBufferFunc, binningBufferFunc, imgBufferFunc;
+		GaussianBand band;
+		std::thread thread;
+
+		~Device(void)
+		{
+			// Members are released on their own device.
+			cudaSetDevice(id);
+			cudaDeviceSynchronize();
+			for (void* ptr : { (void*)pos, (void*)rot, (void*)scale, (void*)opacity, (void*)params, (void*)background, (void*)rects, (void*)image })
+				cudaFree(ptr);
+			cudaFreeHost(paramsHost);
+		}
+	};
+
+	GaussianSplitFrame::GaussianSplitFrame(void)
+	{
+	}
+
+	GaussianSplitFrame::~GaussianSplitFrame(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_start.notify_all();
+		for (auto & device : _devices)
+		{
+			if (device->thread.joinable())
+				device->thread.join();
+		}
+		const int primary = _devices.empty() ? 0 : _devices[0]->id;
+		_devices.clear();
+		cudaSetDevice(primary);
+	}
+
+	void GaussianSplitFrame::init(const std::vector<int> & devices, int count, int coeffs, const float * pos, const float * rot,
+		const float * scale, const float * opacity, const float * shs, const float * background, int width, int height)
+	{
+		if (devices.size() < 2)
+			return;
+
+		_count = count;
+		_coeffs = coeffs;
+		const int primary = devices[0];
+		for (size_t d = 0; d < devices.size(); d++)
+		{
+			std::unique_ptr<Device> device(new Device());
+			device->id = devices[d];
+			CUDA_SAFE_CALL_ALWAYS(cudaSetDevice(device->id));
+			if (d > 0)
+			{
+				// Bands are copied by the secondary devices straight into the primary image.
+				int canAccess = 0;
+				cudaDeviceCanAccessPeer(&canAccess, device->id, primary);
+				if (canAccess)
+					cudaDeviceEnablePeerAccess(primary, 0);
+				else
+					SIBR_WRG << "No peer access from device " << device->id << " to " << primary << ", bands are copied through the host." << std::endl;
+				cudaGetLastError();
+
+				CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->pos, sizeof(float) * 3 * count));
+				CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->rot, sizeof(float) * 4 * count));
+				CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->scale, sizeof(float) * 3 * count));
+				CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->opacity, sizeof(float) * count));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(device->pos, pos, sizeof(float) * 3 * count, cudaMemcpyHostToDevice));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(device->rot, rot, sizeof(float) * 4 * count, cudaMemcpyHostToDevice));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(device->scale, scale, sizeof(float) * 3 * count, cudaMemcpyHostToDevice));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(device->opacity, opacity, sizeof(float) * count, cudaMemcpyHostToDevice));
+				device->shs.upload(shs, count, coeffs, GaussianSHBuffer::FLOAT_STORAGE);
+			}
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->params, sizeof(float) * paramsCount));
+			CUDA_SAFE_CALL_ALWAYS(cudaMallocHost((void**)&device->paramsHost, sizeof(float) * paramsCount));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->background, sizeof(float) * 3));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(device->background, background, sizeof(float) * 3, cudaMemcpyHostToDevice));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->rects, sizeof(int) * 2 * count));
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&device->image, sizeof(float) * 3 * width * height));
+
+			device->scratch.init(device->id);
+			device->geomBufferFunc = device->scratch.functional(GaussianScratch::GEOMETRY);
+			device->binningBufferFunc = device->scratch.functional(GaussianScratch::BINNING);
+			device->imgBufferFunc = device->scratch.functional(GaussianScratch::IMAGE);
+
+			SIBR_LOG << "Split-frame rendering on device " << device->id << std::endl;
+			_devices.push_back(std::move(device));
+		}
+		CUDA_SAFE_CALL_ALWAYS(cudaSetDevice(primary));
+
+		_share.assign(_devices.size(), 1.0f / float(_devices.size()));
+		for (auto & device : _devices)
+		{
+			Device* target = device.get();
+			device->thread = std::thread([this, target]() { work(*target); });
+		}
+	}
+
+	void GaussianSplitFrame::balance(int height)
+	{
+		// Devices that took longer per row get fewer rows, with some smoothing to avoid oscillations.
+		const int n = int(_devices.size());
+		if (_devices[0]->ms > 0.0f)
+		{
+			std::vector<float> speed(n);
+			float total = 0.0f;
+			for (int d = 0; d < n; d++)
+			{
+				const Device & device = *_devices[d];
+				speed[d] = float(std::max(1, device.rowEnd - device.rowBegin)) / std::max(device.ms, 0.01f);
+				total += speed[d];
+			}
+			for (int d = 0; d < n; d++)
+				_share[d] = 0.8f * _share[d] + 0.2f * speed[d] / total;
+		}
+
+		// Whole tile rows, at least one per device when there are enough.
+		const int tiles = (height + kTileRows - 1) / kTileRows;
+		float cumulated = 0.0f;
+		int begin = 0;
+		for (int d = 0; d < n; d++)
+		{
+			cumulated += _share[d];
+			int end = d == n - 1 ? tiles : int(cumulated * tiles + 0.5f);
+			if (tiles >= n)
+				end = std::max(begin + 1, std::min(end, tiles - (n - 1 - d)));
+			else
+				end = std::max(begin, std::min(end, tiles));
+			_devices[d]->rowBegin = std::min(height, begin * kTileRows);
+			_devices[d]->rowEnd = std::min(height, end * kTileRows);
+			begin = end;
+		}
+	}
+
+	void GaussianSplitFrame::updateOpacities(const float * opacity)
+	{
+		if (!enabled())
+			return;
+		const int primary = _devices[0]->id;
+		for (size_t d = 1; d < _devices.size(); d++)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpyPeer(_devices[d]->opacity, _devices[d]->id, opacity, primary, sizeof(float) * _count));
+		}
+	}
+
+	void GaussianSplitFrame::render(const Frame & frame, float * image)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		balance(frame.height);
+		_current = frame;
+		_image = image;
+		_finished = 0;
+		_frame++;
+		_start.notify_all();
+		_done.wait(lock, [this]() { return _finished == int(_devices.size()); });
+	}
+
+	void GaussianSplitFrame::work(Device & device)
+	{
+		cudaSetDevice(device.id);
+		int frame = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_start.wait(lock, [this, frame]() { return _quit || _frame != frame; });
+				if (_quit)
+					return;
+				frame = _frame;
+			}
+
+			renderBand(device);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_finished++;
+			}
+			_done.notify_one();
+		}
+	}
+
+	void GaussianSplitFrame::renderBand(Device & device)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const Frame & f = _current;
+		const bool primary = &device == _devices[0].get();
+		const float* pos = primary ? f.pos : device.pos;
+		const float* rot = primary ? f.rot : device.rot;
+		const float* scale = primary ? f.scale : device.scale;
+		const float* opacity = primary ? f.opacity : device.opacity;
+		const GaussianSHBuffer & shs = primary ? *f.shs : device.shs;
+		const int rows = device.rowEnd - device.rowBegin;
+
+		// The staging is only reused once the previous frame is complete.
+		std::memcpy(device.paramsHost, f.params, sizeof(float) * paramsCount);
+		CUDA_SAFE_CALL(cudaMemcpyAsync(device.params, device.paramsHost, sizeof(float) * paramsCount, cudaMemcpyHostToDevice, 0));
+
+		device.active = rows > 0 ? device.band.update(_count, f.params, f.width, f.height, f.tanFovx, f.tanFovy, f.scaleModifier,
+			device.rowBegin, device.rowEnd, pos, rot, scale, opacity) : 0;
+		if (device.active > 0)
+		{
+			device.band.computeColors(f.degree, pos, shs, device.params + 32);
+			CudaRasterizer::Rasterizer::forward(
+				device.geomBufferFunc,
+				device.binningBufferFunc,
+				device.imgBufferFunc,
+				device.active, f.degree, _coeffs,
+				device.background,
+				f.width, f.height,
+				device.band.positions(),
+				nullptr,
+				device.band.colors(),
+				device.band.opacities(),
+				device.band.scales(),
+				f.scaleModifier,
+				device.band.rotations(),
+				nullptr,
+				device.params,
+				device.params + 16,
+				device.params + 32,
+				f.tanFovx,
+				f.tanFovy,
+				false,
+				device.image,
+				nullptr,
+				f.fastCulling ? device.rects : nullptr,
+				(float*)f.boxmin,
+				(float*)f.boxmax
+			);
+		}
+		else
+		{
+			GaussianBand::clear(device.image, f.width, f.height, device.rowBegin, device.rowEnd, device.background);
+		}
+
+		// Planar image: the band is contiguous in each channel.
+		if (rows > 0)
+		{
+			const size_t pixels = size_t(f.width) * f.height;
+			const size_t offset = size_t(f.width) * device.rowBegin;
+			const size_t bytes = sizeof(float) * f.width * rows;
+			for (int c = 0; c < 3; c++)
+			{
+				float* dst = _image + c * pixels + offset;
+				const float* src = device.image + c * pixels + offset;
+				if (primary)
+				{
+					CUDA_SAFE_CALL(cudaMemcpyAsync(dst, src, bytes, cudaMemcpyDeviceToDevice, 0));
+				}
+				else
+				{
+					CUDA_SAFE_CALL(cudaMemcpyPeerAsync(dst, _devices[0]->id, src, device.id, bytes, 0));
+				}
+			}
+		}
+		CUDA_SAFE_CALL(cudaStreamSynchronize(0));
+		device.ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	int GaussianSplitFrame::device(int d) const
+	{
+		return _devices[d]->id;
+	}
+
+	int GaussianSplitFrame::rows(int d) const
+	{
+		return _devices[d]->rowEnd - _devices[d]->rowBegin;
+	}
+
+	int GaussianSplitFrame::active(int d) const
+	{
+		return _devices[d]->active;
+	}
+
+	float GaussianSplitFrame::time(int d) const
+	{
+		return _devices[d]->ms;
+	}
+
+} /*namespace sibr*/
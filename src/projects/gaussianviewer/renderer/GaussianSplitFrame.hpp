@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include "GaussianSHBuffer.hpp"
+# include <condition_variable>
+# include <memory>
+# include <mutex>
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianSplitFrame
+	 * \brief Split-frame rendering of a Gaussian model over several GPUs.
+	 * Every device holds a replica of the model (the primary one uses the view buffers)
+	 * and renders a horizontal band of tile rows: only the Gaussians overlapping its band
+	 * are selected and rasterized, then the band rows are copied into the destination
+	 * image on the primary device. One worker thread drives each device. Band heights
+	 * follow the measured time of each device, so that they finish together.
+	 */
+	class SIBR_EXP_ULR_EXPORT GaussianSplitFrame
+	{
+		SIBR_DISALLOW_COPY(GaussianSplitFrame);
+	public:
+
+		/// Number of floats of the frame parameters: view, projection and camera position.
+		static const int paramsCount = 16 + 16 + 3;
+
+		/// Inputs of a frame, shared by all devices.
+		struct Frame
+		{
+			const float* params; ///< Host view, projection and position, as given to the rasterizer.
+			int width, height; ///< Image size, at most the one given to init().
+			float tanFovx, tanFovy;
+			int degree; ///< SH degree to evaluate.
+			float scaleModifier;
+			bool fastCulling;
+			const float* boxmin; ///< Host crop box, or nullptr.
+			const float* boxmax;
+			const float* pos; ///< Model on the primary device.
+			const float* rot;
+			const float* scale;
+			const float* opacity;
+			const GaussianSHBuffer* shs;
+		};
+
+		/// Constructor.
+		GaussianSplitFrame(void);
+
+		/// Destructor, stops the workers and releases the replicas.
+		~GaussianSplitFrame(void);
+
+		/** Replicate the model on the secondary devices and start the workers.
+		 * The primary device is current again when the function returns.
+		 * \param devices CUDA devices, the first one is the primary holding the model and the destination image
+		 * \param count number of Gaussians
+		 * \param coeffs SH coefficients per Gaussian
+		 * \param pos host positions
+		 * \param rot host rotations
+		 * \param scale host scales
+		 * \param opacity host opacities
+		 * \param shs host SH coefficients, coeffs*3 floats per Gaussian
+		 * \param background host background color
+		 * \param width largest image width
+		 * \param height largest image height
+		 */
+		void init(const std::vector<int> & devices, int count, int coeffs, const float * pos, const float * rot,
+			const float * scale, const float * opacity, const float * shs, const float * background, int width, int height);
+
+		/** \return true if frames are split over several devices. */
+		bool enabled(void) const { return _devices.size() > 1; }
+
+		/** Render a frame, returns when the image is complete.
+		 * \param frame the frame inputs
+		 * \param image destination planar float RGB image, on the primary device
+		 */
+		void render(const Frame & frame, float * image);
+
+		/** Copy edited opacities of the primary device to the replicas, between frames.
+		 * \param opacity device opacities on the primary device
+		 */
+		void updateOpacities(const float * opacity);
+
+		/** \return the number of devices. */
+		int devices(void) const { return int(_devices.size()); }
+
+		/** \return the CUDA index of a device.
+		 * \param d the device
+		 */
+		int device(int d) const;
+
+		/** \return the rows rendered by a device in the last frame.
+		 * \param d the device
+		 */
+		int rows(int d) const;
+
+		/** \return the Gaussians rasterized by a device in the last frame.
+		 * \param d the device
+		 */
+		int active(int d) const;
+
+		/** \return the time taken by a device in the last frame, in ms.
+		 * \param d the device
+		 */
+		float time(int d) const;
+
+	private:
+
+		struct Device;
+
+		/** Worker loop of a device. */
+		void work(Device & device);
+
+		/** Render the band of a device. */
+		void renderBand(Device & device);
+
+		/** Update the bands from the last timings. */
+		void balance(int height);
+
+		std::vector<std::unique_ptr<Device>> _devices; ///< Primary device first.
+		std::vector<float> _share; ///< Fraction of the rows given to each device.
+		int _count = 0; ///< Number of Gaussians.
+		int _coeffs = 16; ///< SH coefficients per Gaussian.
+
+		std::mutex _mutex;
+		std::condition_variable _start; ///< Signals a new frame to the workers.
+		std::condition_variable _done; ///< Signals a finished band.
+		int _frame = 0; ///< Index of the last submitted frame.
+		int _finished = 0; ///< Bands finished for the current frame.
+		bool _quit = false; ///< Stops the workers.
+		Frame _current = {}; ///< Inputs of the current frame.
+		float * _image = nullptr; ///< Destination of the current frame.
+	};
+
+} /*namespace sibr*/
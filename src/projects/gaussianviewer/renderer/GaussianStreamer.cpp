@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "GaussianStreamer.hpp"
+#include "GaussianCuda.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Number of chunks that can be read or uploaded at the same time.
+static const int kTransfers = 4;
+
+// Upload order of the attributes: opacities last, so that a slot only becomes
+// visible to a concurrent rasterization once its other attributes are complete.
+static const sibr::GaussianCache::Attribute kUploadOrder[] = {
+	sibr::GaussianCache::POSITION, sibr::GaussianCache::ROTATION, sibr::GaussianCache::SCALE,
+	sibr::GaussianCache::SH, sibr::GaussianCache::OPACITY
+};
+
+namespace sibr {
+
+	GaussianStreamer::GaussianStreamer(void)
+	{
+	}
+
+	GaussianStreamer::~GaussianStreamer(void)
+	{
+		release();
+	}
+
+	void GaussianStreamer::release(void)
+	{
+		if (_worker)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_condition.notify_all();
+			_worker->join();
+			_worker.reset();
+		}
+		if (_stream)
+		{
+			cudaStreamSynchronize(_stream);
+			cudaStreamDestroy(_stream);
+			_stream = nullptr;
+		}
+		for (Transfer & transfer : _transfers)
+		{
+			cudaFreeHost(transfer.staging);
+			cudaEventDestroy(transfer.evicted);
+			cudaEventDestroy(transfer.done);
+		}
+		_transfers.clear();
+		_queue.clear();
+		_slots.clear();
+		_chunks.clear();
+		_resident = 0;
+		_stop = false;
+	}
+
+	bool GaussianStreamer::open(const std::string & cachePath, const std::string & plyPath, int shDegree, size_t budget)
+	{
+		release();
+		if (!_source.open(cachePath, plyPath, shDegree))
+		{
+			SIBR_WRG << "Streaming needs a valid model cache, " << cachePath << " can't be used." << std::endl;
+			return false;
+		}
+
+		size_t bytesPerGaussian = 0;
+		for (int a = 0; a < GaussianCache::ATTRIBUTE_COUNT; a++)
+		{
+			_strides[a] = _source.stride(GaussianCache::Attribute(a));
+			bytesPerGaussian += _strides[a];
+		}
+		const int count = _source.count();
+		const int numChunks = (count + chunkSize - 1) / chunkSize;
+		const int numSlots = int(std::min<size_t>(budget / (bytesPerGaussian * chunkSize), size_t(numChunks)));
+		if (numSlots >= numChunks)
+		{
+			SIBR_LOG << "The model fits in the GPU memory budget, streaming is not needed." << std::endl;
+			return false;
+		}
+		if (numSlots < 1)
+		{
+			SIBR_WRG << "The GPU memory budget is smaller than one chunk (" << (bytesPerGaussian * chunkSize) / (1024 * 1024) << "MB)." << std::endl;
+			return false;
+		}
+
+		// Chunk bounds, from the Morton ordered mapped positions.
+		_chunks.resize(numChunks);
+		const Vector3f * positions = static_cast<const Vector3f*>(_source.data(GaussianCache::POSITION));
+#pragma omp parallel for
+		for (int c = 0; c < numChunks; c++)
+		{
+			Chunk & chunk = _chunks[c];
+			chunk.begin = c * chunkSize;
+			chunk.count = std::min(chunkSize, count - chunk.begin);
+			chunk.min = chunk.max = positions[chunk.begin];
+			for (int i = chunk.begin + 1; i < chunk.begin + chunk.count; i++)
+			{
+				chunk.min = chunk.min.cwiseMin(positions[i]);
+				chunk.max = chunk.max.cwiseMax(positions[i]);
+			}
+		}
+		_slots.assign(numSlots, -1);
+		_order.resize(numChunks);
+
+		CUDA_SAFE_CALL_ALWAYS(cudaStreamCreateWithFlags(&_stream, cudaStreamNonBlocking));
+		_transfers.resize(kTransfers);
+		for (Transfer & transfer : _transfers)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMallocHost((void**)&transfer.staging, bytesPerGaussian * chunkSize));
+			CUDA_SAFE_CALL_ALWAYS(cudaEventCreateWithFlags(&transfer.evicted, cudaEventDisableTiming));
+			CUDA_SAFE_CALL_ALWAYS(cudaEventCreateWithFlags(&transfer.done, cudaEventDisableTiming));
+		}
+		_worker.reset(new std::thread(&GaussianStreamer::readChunks, this));
+
+		SIBR_LOG << "Streaming " << count << " Gaussians in " << numChunks << " chunks, " << numSlots << " resident at most ("
+			<< (bytesPerGaussian * chunkSize * numSlots) / (1024 * 1024) << "MB)" << std::endl;
+		return true;
+	}
+
+	void GaussianStreamer::bind(float * pos, float * rot, float * scale, float * opacity, float * shs)
+	{
+		_pool[GaussianCache::POSITION] = reinterpret_cast<char*>(pos);
+		_pool[GaussianCache::ROTATION] = reinterpret_cast<char*>(rot);
+		_pool[GaussianCache::SCALE] = reinterpret_cast<char*>(scale);
+		_pool[GaussianCache::OPACITY] = reinterpret_cast<char*>(opacity);
+		_pool[GaussianCache::SH] = reinterpret_cast<char*>(shs);
+		CUDA_SAFE_CALL_ALWAYS(cudaMemset(opacity, 0, _strides[GaussianCache::OPACITY] * capacity()));
+
+		std::fill(_slots.begin(), _slots.end(), -1);
+		for (Chunk & chunk : _chunks)
+		{
+			chunk.slot = -1;
+			chunk.ready = false;
+		}
+		_resident = 0;
+	}
+
+	void GaussianStreamer::readChunks(void)
+	{
+		while (true)
+		{
+			int t;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this] { return _stop || !_queue.empty(); });
+				if (_stop)
+					return;
+				t = _queue.front();
+				_queue.pop_front();
+			}
+
+			// Chunks are contiguous in each array of the cache, the page faults happen here.
+			const Chunk & chunk = _chunks[_transfers[t].chunk];
+			char * staging = _transfers[t].staging;
+			for (int a = 0; a < GaussianCache::ATTRIBUTE_COUNT; a++)
+			{
+				const char * src = static_cast<const char*>(_source.data(GaussianCache::Attribute(a)));
+				std::memcpy(staging, src + _strides[a] * chunk.begin, _strides[a] * chunk.count);
+				staging += _strides[a] * chunkSize;
+			}
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_transfers[t].state = STAGED;
+		}
+	}
+
+	int GaussianStreamer::loading(void) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return int(std::count_if(_transfers.begin(), _transfers.end(), [](const Transfer & t) { return t.state != FREE; }));
+	}
+
+	int GaussianStreamer::update(const sibr::Camera & eye)
+	{
+		if (!enabled())
+			return 0;
+
+		// Advance the transfers: upload staged chunks, publish the completed ones.
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (Transfer & transfer : _transfers)
+			{
+				if (transfer.state == STAGED)
+				{
+					const Chunk & chunk = _chunks[transfer.chunk];
+					CUDA_SAFE_CALL(cudaStreamWaitEvent(_stream, transfer.evicted, 0));
+					for (GaussianCache::Attribute a : kUploadOrder)
+					{
+						size_t offset = 0;
+						for (int b = 0; b < a; b++)
+							offset += _strides[b] * chunkSize;
+						CUDA_SAFE_CALL(cudaMemcpyAsync(_pool[a] + _strides[a] * chunkSize * chunk.slot, transfer.staging + offset,
+							_strides[a] * chunk.count, cudaMemcpyHostToDevice, _stream));
+					}
+					CUDA_SAFE_CALL(cudaEventRecord(transfer.done, _stream));
+					transfer.state = UPLOADING;
+				}
+				else if (transfer.state == UPLOADING && cudaEventQuery(transfer.done) == cudaSuccess)
+				{
+					_chunks[transfer.chunk].ready = true;
+					_resident++;
+					transfer.state = FREE;
+				}
+			}
+		}
+
+		// Rank the chunks: visible ones first, then by distance to the camera.
+		const Vector3f & campos = eye.position();
+		const Matrix4f & viewproj = eye.viewproj();
+		std::vector<std::pair<float, int>> ranking(_chunks.size());
+#pragma omp parallel for
+		for (int c = 0; c < int(_chunks.size()); c++)
+		{
+			const Chunk & chunk = _chunks[c];
+			bool visible = true;
+			Vector4f corners[8];
+			for (int k = 0; k < 8; k++)
+			{
+				const Vector3f corner((k & 1) ? chunk.max.x() : chunk.min.x(), (k & 2) ? chunk.max.y() : chunk.min.y(), (k & 4) ? chunk.max.z() : chunk.min.z());
+				corners[k] = viewproj * corner.homogeneous();
+			}
+			// Outside if all corners are on the wrong side of one clipping plane.
+			for (int plane = 0; plane < 6 && visible; plane++)
+			{
+				const int axis = plane / 2;
+				const float sign = (plane % 2) ? 1.0f : -1.0f;
+				bool outside = true;
+				for (int k = 0; k < 8 && outside; k++)
+					outside = sign * corners[k][axis] > corners[k].w();
+				visible = !outside;
+			}
+			const float distance = (campos - campos.cwiseMax(chunk.min).cwiseMin(chunk.max)).norm();
+			ranking[c] = std::make_pair(visible ? distance : std::numeric_limits<float>::max() / 2.0f + distance, c);
+		}
+		std::sort(ranking.begin(), ranking.end());
+		for (size_t i = 0; i < ranking.size(); i++)
+			_order[i] = ranking[i].second;
+
+		// The first chunks fill the pool. Schedule the missing ones, closest first.
+		const int wanted = int(_slots.size());
+		std::vector<bool> desired(_chunks.size(), false);
+		for (int i = 0; i < wanted; i++)
+			desired[_order[i]] = true;
+
+		for (int i = 0; i < wanted; i++)
+		{
+			const int c = _order[i];
+			if (_chunks[c].slot >= 0)
+				continue;
+
+			int t = -1;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (int k = 0; k < kTransfers && t < 0; k++)
+					if (_transfers[k].state == FREE)
+						t = k;
+			}
+			if (t < 0)
+				break;
+
+			// Use a free slot, or evict the farthest resident chunk that isn't wanted anymore.
+			int slot = int(std::find(_slots.begin(), _slots.end(), -1) - _slots.begin());
+			if (slot == int(_slots.size()))
+			{
+				slot = -1;
+				for (int j = int(_order.size()) - 1; j >= wanted && slot < 0; j--)
+				{
+					Chunk & victim = _chunks[_order[j]];
+					if (victim.slot >= 0 && victim.ready && !desired[_order[j]])
+					{
+						slot = victim.slot;
+						victim.slot = -1;
+						victim.ready = false;
+						_resident--;
+					}
+				}
+				if (slot < 0)
+					break;
+			}
+
+			// Hide the slot on the render stream before the load stream overwrites it.
+			CUDA_SAFE_CALL(cudaMemsetAsync(_pool[GaussianCache::OPACITY] + _strides[GaussianCache::OPACITY] * chunkSize * slot, 0,
+				_strides[GaussianCache::OPACITY] * chunkSize, 0));
+			CUDA_SAFE_CALL(cudaEventRecord(_transfers[t].evicted, 0));
+			_slots[slot] = c;
+			_chunks[c].slot = slot;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_transfers[t].chunk = c;
+				_transfers[t].state = READING;
+				_queue.push_back(t);
+			}
+			_condition.notify_one();
+		}
+
+		// Rasterize up to the last occupied slot, empty slots have a null opacity.
+		int used = int(_slots.size());
+		while (used > 0 && _slots[used - 1] < 0)
+			used--;
+		return used * chunkSize;
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include "GaussianCache.hpp"
+# include <core/graphics/Camera.hpp>
+# include <cuda_runtime.h>
+# include <array>
+# include <condition_variable>
+# include <deque>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class GaussianStreamer
+	 * \brief Out-of-core residency of a Gaussian model under a GPU memory budget.
+	 * The model cache is Morton ordered, so consecutive ranges of chunkSize Gaussians
+	 * form compact spatial chunks that can be read directly from the mapped file.
+	 * The device buffers of the view are used as a pool of fixed-size slots. Every
+	 * frame, chunks are ranked by visibility and distance to the camera, the closest
+	 * ones are made resident and the others evicted when their slot is needed.
+	 * A worker thread copies chunks from the mapping to pinned staging memory, which
+	 * is then uploaded on a dedicated non-blocking stream, so rendering never waits
+	 * for the disk or the transfers. Free and loading slots have a null opacity and
+	 * are skipped by the rasterizer.
+	 */
+	class SIBR_EXP_ULR_EXPORT GaussianStreamer
+	{
+		SIBR_DISALLOW_COPY(GaussianStreamer);
+	public:
+
+		/// Number of Gaussians per chunk.
+		static const int chunkSize = 1 << 16;
+
+		/// Constructor.
+		GaussianStreamer(void);
+
+		/// Destructor, stops the worker and releases the transfer resources.
+		~GaussianStreamer(void);
+
+		/** Open the model cache and size the slot pool for a budget.
+		 * \param cachePath the model cache to stream from
+		 * \param plyPath the source PLY of the cache
+		 * \param shDegree the model SH degree
+		 * \param budget GPU memory available for the Gaussians, in bytes
+		 * \return false if the cache can't be used or the whole model fits in the budget
+		 */
+		bool open(const std::string & cachePath, const std::string & plyPath, int shDegree, size_t budget);
+
+		/** \return true if the model is streamed. */
+		bool enabled(void) const { return !_slots.empty(); }
+
+		/** \return the number of Gaussians the device buffers must hold. */
+		int capacity(void) const { return int(_slots.size()) * chunkSize; }
+
+		/** Give the device buffers used as slot pool, of capacity() elements each. Clears all slots.
+		 * \param pos device positions
+		 * \param rot device rotations
+		 * \param scale device scales
+		 * \param opacity device opacities
+		 * \param shs device float SH coefficients
+		 */
+		void bind(float * pos, float * rot, float * scale, float * opacity, float * shs);
+
+		/** Update the resident set for a viewpoint and schedule the missing chunks.
+		 * \param eye the current viewpoint
+		 * \return the number of Gaussians to rasterize from the start of the pool
+		 */
+		int update(const sibr::Camera & eye);
+
+		/** \return the mapped model cache. */
+		const GaussianCache & source(void) const { return _source; }
+
+		/** \return the number of chunks of the model. */
+		int chunks(void) const { return int(_chunks.size()); }
+
+		/** \return the number of resident chunks. */
+		int resident(void) const { return _resident; }
+
+		/** \return the number of chunks being loaded. */
+		int loading(void) const;
+
+	private:
+
+		/// A Morton range of the model.
+		struct Chunk
+		{
+			Vector3f min, max; ///< Bounds of the Gaussians centers.
+			int begin = 0; ///< First Gaussian.
+			int count = 0; ///< Number of Gaussians.
+			int slot = -1; ///< Slot in the pool, -1 if not resident.
+			bool ready = false; ///< True once the slot content is complete.
+		};
+
+		/// State of a staging buffer.
+		enum TransferState { FREE = 0, READING, STAGED, UPLOADING };
+
+		/// Pinned staging buffer for one chunk.
+		struct Transfer
+		{
+			TransferState state = FREE;
+			int chunk = -1;
+			char * staging = nullptr;
+			cudaEvent_t evicted = nullptr; ///< Recorded on the render stream after the slot has been cleared.
+			cudaEvent_t done = nullptr; ///< Recorded on the load stream after the upload.
+		};
+
+		/** Worker loop copying chunks from the mapping to pinned memory. */
+		void readChunks(void);
+
+		void release(void);
+
+		GaussianCache _source; ///< Mapped model.
+		std::array<size_t, GaussianCache::ATTRIBUTE_COUNT> _strides = {}; ///< Bytes per Gaussian of each attribute.
+		std::array<char*, GaussianCache::ATTRIBUTE_COUNT> _pool = {}; ///< Device slot pool of each attribute.
+		std::vector<Chunk> _chunks; ///< All chunks, in Morton order.
+		std::vector<int> _slots; ///< Chunk occupying each slot, -1 if free.
+		std::vector<int> _order; ///< Chunks sorted by priority.
+		int _resident = 0; ///< Number of ready chunks.
+
+		cudaStream_t _stream = nullptr; ///< Dedicated load stream.
+		std::vector<Transfer> _transfers; ///< Staging buffers.
+		std::deque<int> _queue; ///< Transfers waiting for the worker.
+		mutable std::mutex _mutex; ///< Protects the queue and the transfer states.
+		std::condition_variable _condition; ///< Wakes the worker.
+		bool _stop = false; ///< Asks the worker to exit.
+		std::unique_ptr<std::thread> _worker; ///< Disk reads.
+	};
+
+} /*namespace sibr*/
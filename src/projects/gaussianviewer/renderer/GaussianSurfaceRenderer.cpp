@@ -16,9 +16,10 @@
 
 namespace sibr { 
 
-	GaussianData::GaussianData(int num_gaussians, float* mean_data, float* rot_data, float* scale_data, float* alpha_data, float* color_data)
+	GaussianData::GaussianData(int num_gaussians, const float* mean_data, const float* rot_data, const float* scale_data, const float* alpha_data, const float* color_data, int color_coeffs)
 	{
 		_num_gaussians = num_gaussians;
+		_color_coeffs = color_coeffs;
 		glCreateBuffers(1, &meanBuffer);
 		glCreateBuffers(1, &rotBuffer);
 		glCreateBuffers(1, &scaleBuffer);
@@ -28,17 +29,54 @@ namespace sibr {
 		glNamedBufferStorage(rotBuffer, num_gaussians * 4 * sizeof(float), rot_data, 0);
 		glNamedBufferStorage(scaleBuffer, num_gaussians * 3 * sizeof(float), scale_data, 0);
 		glNamedBufferStorage(alphaBuffer, num_gaussians * sizeof(float), alpha_data, 0);
-		glNamedBufferStorage(colorBuffer, num_gaussians * sizeof(float) * 48, color_data, 0);
+		glNamedBufferStorage(colorBuffer, num_gaussians * sizeof(float) * colorStride(), color_data, 0);
+
+		glCreateBuffers(1, &visibleBuffer);
+		glCreateBuffers(1, &drawBuffer);
+		glNamedBufferStorage(visibleBuffer, 2 * num_gaussians * sizeof(GLuint), nullptr, 0);
+		glNamedBufferStorage(drawBuffer, 2 * 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	void GaussianData::update(const float* mean_data, const float* rot_data, const float* scale_data, const float* alpha_data, const float* color_data)
+	{
+		// The buffers are immutable without client writes, fill them from temporary buffers.
+		const GLuint buffers[5] = { meanBuffer, rotBuffer, scaleBuffer, alphaBuffer, colorBuffer };
+		const float* data[5] = { mean_data, rot_data, scale_data, alpha_data, color_data };
+		const int floats[5] = { 3, 4, 3, 1, colorStride() };
+		for (int i = 0; i < 5; i++)
+		{
+			const GLsizeiptr size = GLsizeiptr(_num_gaussians) * floats[i] * sizeof(float);
+			GLuint staging;
+			glCreateBuffers(1, &staging);
+			glNamedBufferStorage(staging, size, data[i], 0);
+			glCopyNamedBufferSubData(staging, buffers[i], 0, 0, size);
+			glDeleteBuffers(1, &staging);
+		}
 	}
 
-	void GaussianData::render(int G) const
+	void GaussianData::bind() const
 	{
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meanBuffer);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rotBuffer);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scaleBuffer);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, alphaBuffer);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, colorBuffer);
-		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, G);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, visibleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, drawBuffer);
+	}
+
+	void GaussianData::resetDraws() const
+	{
+		// DrawArraysIndirectCommand: count, instanceCount, first, baseInstance.
+		const GLuint draws[8] = { 36, 0, 0, 0, 36, 0, 0, 0 };
+		glNamedBufferSubData(drawBuffer, 0, sizeof(draws), draws);
+	}
+
+	void GaussianData::render(int list) const
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawBuffer);
+		glDrawArraysIndirect(GL_TRIANGLES, (const void*)(list * 4 * sizeof(GLuint)));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	}
 
 	GaussianSurfaceRenderer::GaussianSurfaceRenderer( void )
@@ -51,6 +89,8 @@ namespace sibr {
 		_paramMVP.init(_shader,"MVP");
 		_paramLimit.init(_shader, "alpha_limit");
 		_paramStage.init(_shader, "stage");
+		_paramColorStride.init(_shader, "color_stride");
+		_paramListOffset.init(_shader, "list_offset");
 
 		glCreateTextures(GL_TEXTURE_2D, 1, &idTexture);
 		glTextureParameteri(idTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -86,6 +126,82 @@ namespace sibr {
 		glShaderSource(clearShader, 1, &clearShaderSrc, nullptr);
 		glAttachShader(clearProg, clearShader);
 		glLinkProgram(clearProg);
+
+		// Each workgroup reserves its slots with one atomic per list.
+		cullProg = glCreateProgram();
+		const char* cullShaderSrc = R"(
+			#version 430
+
+			layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+			layout(std430, binding = 0) buffer BoxCenters {
+				float centers[];
+			};
+			layout(std430, binding = 2) buffer Scales {
+				float scales[];
+			};
+			layout(std430, binding = 3) buffer Alphas {
+				float alphas[];
+			};
+			layout(std430, binding = 5) buffer Visible {
+				uint visible[];
+			};
+			struct Draw {
+				uint count;
+				uint instanceCount;
+				uint first;
+				uint baseInstance;
+			};
+			layout(std430, binding = 6) buffer Draws {
+				Draw draws[2];
+			};
+
+			layout(location = 0) uniform int size;
+			layout(location = 1) uniform float alpha_limit;
+			layout(location = 2) uniform vec4 planes[6];
+
+			shared uint localCount[2];
+			shared uint localBase[2];
+
+			void main() {
+				uint index = gl_GlobalInvocationID.x;
+				uint local = gl_LocalInvocationIndex;
+				if (local < 2) {
+					localCount[local] = 0;
+				}
+				barrier();
+
+				int list = -1;
+				uint slot = 0;
+				if (index < size) {
+					// Bounding sphere of the box drawn around the ellipsoid.
+					vec3 center = vec3(centers[3 * index + 0], centers[3 * index + 1], centers[3 * index + 2]);
+					float radius = 2.0 * length(vec3(scales[3 * index + 0], scales[3 * index + 1], scales[3 * index + 2]));
+					bool inside = true;
+					for (int p = 0; p < 6; p++) {
+						inside = inside && dot(planes[p].xyz, center) + planes[p].w >= -radius;
+					}
+					if (inside) {
+						list = alphas[index] >= alpha_limit ? 0 : 1;
+						slot = atomicAdd(localCount[list], 1);
+					}
+				}
+				barrier();
+
+				if (local < 2) {
+					localBase[local] = atomicAdd(draws[local].instanceCount, localCount[local]);
+				}
+				barrier();
+
+				if (list >= 0) {
+					visible[list * size + localBase[list] + slot] = index;
+				}
+			}
+			)";
+		cullShader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(cullShader, 1, &cullShaderSrc, nullptr);
+		glAttachShader(cullProg, cullShader);
+		glLinkProgram(cullProg);
 	}
 
 	void GaussianSurfaceRenderer::makeFBO(int w, int h)
@@ -102,7 +218,7 @@ namespace sibr {
 
 		glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT, resX, resY);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, idTexture, 0);
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
@@ -110,7 +226,7 @@ namespace sibr {
 
 	int	GaussianSurfaceRenderer::process(int G, const GaussianData& mesh, const Camera& eye, IRenderTarget& target, float limit, sibr::Mesh::RenderMode mode, bool backFaceCulling)
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
@@ -119,20 +235,46 @@ namespace sibr {
 			makeFBO(target.w(), target.h());
 		}
 
+		// Cull the instances against the frustum and split them around the alpha limit.
+		// Planes are extracted from the rows of the view-projection matrix.
+		const Matrix4f & vp = eye.viewproj();
+		float planes[6][4];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				const Vector4f plane = s == 0 ? Vector4f((vp.row(3) + vp.row(i)).transpose()) : Vector4f((vp.row(3) - vp.row(i)).transpose());
+				const float norm = plane.head<3>().norm();
+				for (int c = 0; c < 4; c++)
+					planes[2 * i + s][c] = plane[c] / norm;
+			}
+		}
+		mesh.resetDraws();
+		mesh.bind();
+		GLState::useProgram(cullProg);
+		glUniform1i(0, G);
+		glUniform1f(1, limit);
+		glUniform4fv(2, 6, &planes[0][0]);
+		glDispatchCompute((G + 255) / 256, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+		GLState::useProgram(0);
+
 		// Solid pass
 		GLuint drawBuffers[2];
 		drawBuffers[0] = GL_COLOR_ATTACHMENT0;
 		drawBuffers[1] = GL_COLOR_ATTACHMENT1;
 		glDrawBuffers(2, drawBuffers);
 
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST);
 		glDisable(GL_BLEND);
 		_shader.begin();
 		_paramMVP.set(eye.viewproj());
 		_paramCamPos.set(eye.position());
 		_paramLimit.set(limit);
 		_paramStage.set(0);
-		mesh.render(G);
+		_paramColorStride.set(mesh.colorStride());
+		_paramListOffset.set(0);
+		mesh.render(0);
 
 		// Simple additive blendnig (no order)
 		glDrawBuffers(1, drawBuffers);
@@ -141,7 +283,8 @@ namespace sibr {
 		glBlendEquation(GL_FUNC_ADD);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 		_paramStage.set(1);
-		mesh.render(G);
+		_paramListOffset.set(G);
+		mesh.render(1);
 
 		glDepthMask(GL_TRUE);
 		glDisable(GL_BLEND);
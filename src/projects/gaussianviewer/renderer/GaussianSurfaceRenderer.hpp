@@ -28,19 +28,60 @@ namespace sibr {
 
 	public:
 
-		/// Constructor.
-		GaussianData(int num_gaussians, float* mean_data, float* rot_data, float* scale_data, float* alpha_data, float* color_data);
+		/** Constructor.
+		 * \param color_data SH coefficients, color_coeffs RGB coefficients per Gaussian
+		 * \param color_coeffs number of SH coefficients per Gaussian
+		 */
+		GaussianData(int num_gaussians, const float* mean_data, const float* rot_data, const float* scale_data, const float* alpha_data, const float* color_data, int color_coeffs = 16);
+
+		/** Replace the attributes of the Gaussians, their number is unchanged.
+		 * \param color_data SH coefficients, colorStride() floats per Gaussian
+		 */
+		void update(const float* mean_data, const float* rot_data, const float* scale_data, const float* alpha_data, const float* color_data);
+
+		/** \return the number of Gaussians. */
+		int count() const { return _num_gaussians; }
+
+		/** Bind the Gaussian, visibility and indirect draw buffers to their storage bindings. */
+		void bind() const;
+
+		/** Reset the instance counts of the indirect draws, before culling. */
+		void resetDraws() const;
+
+		/** Draw the instances of a visibility list filled by the culling pass, bind() must have been called.
+		 * \param list 0 for the Gaussians above the alpha limit, 1 for the others
+		 */
+		void render(int list) const;
+
+		/** \return the number of floats per Gaussian in the color buffer. */
+		int colorStride() const { return 3 * _color_coeffs; }
+
+		/** \return the GL buffer of the positions, 3 floats per Gaussian. */
+		GLuint means() const { return meanBuffer; }
+
+		/** \return the GL buffer of the rotations, 4 floats per Gaussian. */
+		GLuint rotations() const { return rotBuffer; }
+
+		/** \return the GL buffer of the scales, 3 floats per Gaussian. */
+		GLuint scales() const { return scaleBuffer; }
+
+		/** \return the GL buffer of the opacities, 1 float per Gaussian. */
+		GLuint alphas() const { return alphaBuffer; }
 
-		void render(int G) const;
+		/** \return the GL buffer of the SH coefficients, colorStride() floats per Gaussian. */
+		GLuint colors() const { return colorBuffer; }
 
 	private:
 
 		int _num_gaussians;
+		int _color_coeffs;
 		GLuint meanBuffer;
 		GLuint rotBuffer;
 		GLuint scaleBuffer;
 		GLuint alphaBuffer;
 		GLuint colorBuffer;
+		GLuint visibleBuffer; ///< Indices of the visible Gaussians, one list of num_gaussians per stage.
+		GLuint drawBuffer; ///< Indirect draw commands, one per stage.
 	};
 
 	/** Render a mesh colored using the per-vertex color attribute.
@@ -87,8 +128,12 @@ namespace sibr {
 		GLParameter			_paramCamPos;
 		GLParameter			_paramLimit;
 		GLParameter			_paramStage;
+		GLParameter			_paramColorStride;
+		GLParameter			_paramListOffset;
 		GLuint clearProg;
 		GLuint clearShader;
+		GLuint cullProg; ///< Frustum culling and alpha split of the instances.
+		GLuint cullShader;
 	};
 
 } /*namespace sibr*/ 
@@ -10,8 +10,17 @@
  */
 
 #include <projects/gaussianviewer/renderer/GaussianView.hpp>
+#include <projects/gaussianviewer/renderer/GaussianCuda.hpp>
+#include <projects/gaussianviewer/renderer/GaussianPrune.hpp>
 #include <core/graphics/GUI.hpp>
+#include <core/graphics/FrameProfiler.hpp>
+#include <core/system/MappedFile.hpp>
+#include <core/system/ThreadPool.hpp>
+#include <core/system/FileWatcher.hpp>
+#include <core/graphics/GPUMemoryBudget.hpp>
 #include <thread>
+#include <algorithm>
+#include <cstring>
 #include <boost/asio.hpp>
 #include <rasterizer.h>
 #include <imgui_internal.h>
@@ -53,194 +62,338 @@ float inverse_sigmoid(const float m1)
 	return log(m1 / (1.0f - m1));
 }
 
-# define CUDA_SAFE_CALL_ALWAYS(A) \
-A; \
-cudaDeviceSynchronize(); \
-if (cudaPeekAtLastError() != cudaSuccess) \
-SIBR_ERR << cudaGetErrorString(cudaGetLastError());
+// Contiguous chunks used to split the loading work between OpenMP threads.
+// Working per chunk avoids relying on reductions not available in OpenMP 2.0.
+static const int kLoadChunks = 256;
 
-#if DEBUG || _DEBUG
-# define CUDA_SAFE_CALL(A) CUDA_SAFE_CALL_ALWAYS(A)
-#else
-# define CUDA_SAFE_CALL(A) A
-#endif
+// View matrix, projection matrix and camera position, contiguous on the device.
+static const int kFrameParams = sibr::GaussianSplitFrame::paramsCount;
 
-// Load the Gaussians from the given file.
+// Copy the elements of the kept indices, in order.
+template<typename T>
+static std::vector<T> gatherKept(const std::vector<int>& kept, const void* data)
+{
+	const T* src = (const T*)data;
+	std::vector<T> dst(kept.size());
+	#pragma omp parallel for
+	for (int i = 0; i < int(kept.size()); i++)
+		dst[i] = src[kept[i]];
+	return dst;
+}
+
+static int chunkBound(int chunk, int count)
+{
+	return int((int64_t(count) * chunk) / kLoadChunks);
+}
+
+// Sort Morton codes (and the associated Gaussian indices) with a LSD radix
+// sort, 8 bits per pass. Histograms and scattering are computed per chunk in
+// parallel, passes where all keys share the same digit are skipped.
+static void radixSortMorton(std::vector<uint64_t>& keys, std::vector<int>& ids, int keyBits)
+{
+	const int count = int(keys.size());
+	std::vector<uint64_t> keysTmp(count);
+	std::vector<int> idsTmp(count);
+	std::vector<size_t> offsets(kLoadChunks * 256);
+
+	for (int shift = 0; shift < keyBits; shift += 8)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+		sibr::ThreadPool::shared().parallelFor(0, kLoadChunks, [&](int c)
+		{
+			size_t* hist = &offsets[c * 256];
+			for (int i = chunkBound(c, count); i < chunkBound(c + 1, count); i++)
+				hist[(keys[i] >> shift) & 0xFF]++;
+		});
+
+		// Exclusive prefix sum, digit-major so that the sort stays stable.
+		size_t sum = 0;
+		bool trivial = false;
+		for (int d = 0; d < 256; d++)
+		{
+			const size_t digitStart = sum;
+			for (int c = 0; c < kLoadChunks; c++)
+			{
+				const size_t n = offsets[c * 256 + d];
+				offsets[c * 256 + d] = sum;
+				sum += n;
+			}
+			trivial |= (sum - digitStart) == size_t(count);
+		}
+		if (trivial)
+			continue;
+
+		sibr::ThreadPool::shared().parallelFor(0, kLoadChunks, [&](int c)
+		{
+			size_t* dst = &offsets[c * 256];
+			for (int i = chunkBound(c, count); i < chunkBound(c + 1, count); i++)
+			{
+				const size_t to = dst[(keys[i] >> shift) & 0xFF]++;
+				keysTmp[to] = keys[i];
+				idsTmp[to] = ids[i];
+			}
+		});
+		keys.swap(keysTmp);
+		ids.swap(idsTmp);
+	}
+}
+
+// Load the Gaussians from the given file. SH coefficients are stored with
+// (D+1)^2 RGB coefficients per Gaussian, interleaved as [coeff][rgb].
 template<int D>
 int loadPly(const char* filename,
 	std::vector<Pos>& pos,
-	std::vector<SHs<3>>& shs,
+	std::vector<float>& shs,
 	std::vector<float>& opacities,
 	std::vector<Scale>& scales,
 	std::vector<Rot>& rot,
 	sibr::Vector3f& minn,
 	sibr::Vector3f& maxx)
 {
-	std::ifstream infile(filename, std::ios_base::binary);
+	sibr::Timer timer(true);
+	sibr::Timer stageTimer(true);
 
-	if (!infile.good())
+	sibr::MappedFile file;
+	if (!file.open(filename))
 		SIBR_ERR << "Unable to find model's PLY file, attempted:\n" << filename << std::endl;
+	file.prefetch();
 
 	// "Parse" header (it has to be a specific format anyway)
+	const std::string endHeader = "end_header";
+	const char* fileStart = file.data();
+	const char* fileEnd = fileStart + file.size();
+	const char* headerEnd = std::search(fileStart, fileEnd, endHeader.begin(), endHeader.end());
+	if (headerEnd == fileEnd)
+		SIBR_ERR << "Could not find the end of the PLY header in " << filename << std::endl;
+
+	int count = 0;
 	std::string buff;
-	std::getline(infile, buff);
-	std::getline(infile, buff);
+	std::stringstream header(std::string(fileStart, headerEnd));
+	while (std::getline(header, buff))
+	{
+		std::stringstream ss(buff);
+		std::string element, name;
+		ss >> element >> name;
+		if (element == "element" && name == "vertex")
+			ss >> count;
+	}
 
-	std::string dummy;
-	std::getline(infile, buff);
-	std::stringstream ss(buff);
-	int count;
-	ss >> dummy >> dummy >> count;
+	// Skip the end of the last header line (handles \n and \r\n).
+	const char* body = headerEnd + endHeader.size();
+	while (body < fileEnd && *body != '\n')
+		++body;
+	++body;
 
 	// Output number of Gaussians contained
 	SIBR_LOG << "Loading " << count << " Gaussian splats" << std::endl;
 
-	while (std::getline(infile, buff))
-		if (buff.compare("end_header") == 0)
-			break;
+	if (body > fileEnd || size_t(fileEnd - body) < size_t(count) * sizeof(RichPoint<D>))
+		SIBR_ERR << "PLY file " << filename << " is truncated, expected " << count << " Gaussians." << std::endl;
 
-	// Read all Gaussians at once (AoS)
-	std::vector<RichPoint<D>> points(count);
-	infile.read((char*)points.data(), count * sizeof(RichPoint<D>));
+	// Gaussians are read in place from the mapped file (AoS). The data is not
+	// guaranteed to be aligned, so each point is copied before being used.
+	auto readPoint = [body](int i, RichPoint<D>& point) {
+		std::memcpy(&point, body + size_t(i) * sizeof(RichPoint<D>), sizeof(RichPoint<D>));
+	};
+	auto readPos = [body](int i, Pos& p) {
+		std::memcpy(p.data(), body + size_t(i) * sizeof(RichPoint<D>), sizeof(Pos));
+	};
 
 	// Resize our SoA data
+	const int SH_N = (D + 1) * (D + 1);
 	pos.resize(count);
-	shs.resize(count);
+	shs.resize(size_t(count) * SH_N * 3);
 	scales.resize(count);
 	rot.resize(count);
 	opacities.resize(count);
 
+	SIBR_LOG << "[loadPly] Mapping and header: " << stageTimer.deltaTimeFromLastTic() << "ms" << std::endl;
+	stageTimer.tic();
+
 	// Gaussians are done training, they won't move anymore. Arrange
 	// them according to 3D Morton order. This means better cache
 	// behavior for reading Gaussians that end up in the same tile 
 	// (close in 3D --> close in 2D).
+	std::vector<sibr::Vector3f> chunkMins(kLoadChunks, sibr::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX));
+	std::vector<sibr::Vector3f> chunkMaxs(kLoadChunks, sibr::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	sibr::ThreadPool::shared().parallelFor(0, kLoadChunks, [&](int c)
+	{
+		Pos p;
+		for (int i = chunkBound(c, count); i < chunkBound(c + 1, count); i++)
+		{
+			readPos(i, p);
+			chunkMaxs[c] = chunkMaxs[c].cwiseMax(p);
+			chunkMins[c] = chunkMins[c].cwiseMin(p);
+		}
+	});
 	minn = sibr::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
 	maxx = -minn;
-	for (int i = 0; i < count; i++)
+	for (int c = 0; c < kLoadChunks; c++)
 	{
-		maxx = maxx.cwiseMax(points[i].pos);
-		minn = minn.cwiseMin(points[i].pos);
+		maxx = maxx.cwiseMax(chunkMaxs[c]);
+		minn = minn.cwiseMin(chunkMins[c]);
 	}
-	std::vector<std::pair<uint64_t, int>> mapp(count);
-	for (int i = 0; i < count; i++)
+
+	std::vector<uint64_t> codes(count);
+	std::vector<int> order(count);
+	sibr::ThreadPool::shared().parallelFor(0, count, [&](int i)
 	{
-		sibr::Vector3f rel = (points[i].pos - minn).array() / (maxx - minn).array();
+		Pos p;
+		readPos(i, p);
+		sibr::Vector3f rel = (p - minn).array() / (maxx - minn).array();
 		sibr::Vector3f scaled = ((float((1 << 21) - 1)) * rel);
 		sibr::Vector3i xyz = scaled.cast<int>();
 
 		uint64_t code = 0;
-		for (int i = 0; i < 21; i++) {
-			code |= ((uint64_t(xyz.x() & (1 << i))) << (2 * i + 0));
-			code |= ((uint64_t(xyz.y() & (1 << i))) << (2 * i + 1));
-			code |= ((uint64_t(xyz.z() & (1 << i))) << (2 * i + 2));
+		for (int b = 0; b < 21; b++) {
+			code |= ((uint64_t(xyz.x() & (1 << b))) << (2 * b + 0));
+			code |= ((uint64_t(xyz.y() & (1 << b))) << (2 * b + 1));
+			code |= ((uint64_t(xyz.z() & (1 << b))) << (2 * b + 2));
 		}
 
-		mapp[i].first = code;
-		mapp[i].second = i;
-	}
-	auto sorter = [](const std::pair < uint64_t, int>& a, const std::pair < uint64_t, int>& b) {
-		return a.first < b.first;
-	};
-	std::sort(mapp.begin(), mapp.end(), sorter);
+		codes[i] = code;
+		order[i] = i;
+	});
+
+	SIBR_LOG << "[loadPly] Bounds and Morton codes: " << stageTimer.deltaTimeFromLastTic() << "ms" << std::endl;
+	stageTimer.tic();
+
+	radixSortMorton(codes, order, 63);
+
+	SIBR_LOG << "[loadPly] Morton sort: " << stageTimer.deltaTimeFromLastTic() << "ms" << std::endl;
+	stageTimer.tic();
 
 	// Move data from AoS to SoA
-	int SH_N = (D + 1) * (D + 1);
-	for (int k = 0; k < count; k++)
+	sibr::ThreadPool::shared().parallelFor(0, count, [&](int k)
 	{
-		int i = mapp[k].second;
-		pos[k] = points[i].pos;
+		RichPoint<D> point;
+		readPoint(order[k], point);
+		pos[k] = point.pos;
 
 		// Normalize quaternion
 		float length2 = 0;
 		for (int j = 0; j < 4; j++)
-			length2 += points[i].rot.rot[j] * points[i].rot.rot[j];
+			length2 += point.rot.rot[j] * point.rot.rot[j];
 		float length = sqrt(length2);
 		for (int j = 0; j < 4; j++)
-			rot[k].rot[j] = points[i].rot.rot[j] / length;
+			rot[k].rot[j] = point.rot.rot[j] / length;
 
 		// Exponentiate scale
 		for(int j = 0; j < 3; j++)
-			scales[k].scale[j] = exp(points[i].scale.scale[j]);
+			scales[k].scale[j] = exp(point.scale.scale[j]);
 
 		// Activate alpha
-		opacities[k] = sigmoid(points[i].opacity);
+		opacities[k] = sigmoid(point.opacity);
 
-		shs[k].shs[0] = points[i].shs.shs[0];
-		shs[k].shs[1] = points[i].shs.shs[1];
-		shs[k].shs[2] = points[i].shs.shs[2];
+		float* dst = &shs[size_t(k) * SH_N * 3];
+		dst[0] = point.shs.shs[0];
+		dst[1] = point.shs.shs[1];
+		dst[2] = point.shs.shs[2];
 		for (int j = 1; j < SH_N; j++)
 		{
-			shs[k].shs[j * 3 + 0] = points[i].shs.shs[(j - 1) + 3];
-			shs[k].shs[j * 3 + 1] = points[i].shs.shs[(j - 1) + SH_N + 2];
-			shs[k].shs[j * 3 + 2] = points[i].shs.shs[(j - 1) + 2 * SH_N + 1];
+			dst[j * 3 + 0] = point.shs.shs[(j - 1) + 3];
+			dst[j * 3 + 1] = point.shs.shs[(j - 1) + SH_N + 2];
+			dst[j * 3 + 2] = point.shs.shs[(j - 1) + 2 * SH_N + 1];
 		}
-	}
+	});
+
+	SIBR_LOG << "[loadPly] Activation and transposition: " << stageTimer.deltaTimeFromLastTic() << "ms" << std::endl;
+	SIBR_LOG << "[loadPly] Total: " << timer.deltaTimeFromLastTic() << "ms" << std::endl;
 	return count;
 }
 
+// Save the Gaussians inside the given box, shs holds (D+1)^2 coefficients per Gaussian.
+template<int D>
 void savePly(const char* filename,
 	const std::vector<Pos>& pos,
-	const std::vector<SHs<3>>& shs,
+	const std::vector<float>& shs,
 	const std::vector<float>& opacities,
 	const std::vector<Scale>& scales,
 	const std::vector<Rot>& rot,
 	const sibr::Vector3f& minn,
 	const sibr::Vector3f& maxx)
 {
-	// Read all Gaussians at once (AoS)
-	int count = 0;
-	for (int i = 0; i < pos.size(); i++)
+	sibr::Timer timer(true);
+
+	// Deleted Gaussians have a null opacity.
+	auto inside = [&](int i) {
+		return opacities[i] > 0.0f && !(pos[i].x() < minn.x() || pos[i].y() < minn.y() || pos[i].z() < minn.z() ||
+			pos[i].x() > maxx.x() || pos[i].y() > maxx.y() || pos[i].z() > maxx.z());
+	};
+
+	// Parallel compaction: count the Gaussians inside the box per block,
+	// scan the counts, then let each block fill its own output range.
+	const int total = int(pos.size());
+	const int blockSize = 65536;
+	const int numBlocks = (total + blockSize - 1) / blockSize;
+	std::vector<int> offsets(numBlocks + 1, 0);
+#pragma omp parallel for
+	for (int b = 0; b < numBlocks; b++)
 	{
-		if (pos[i].x() < minn.x() || pos[i].y() < minn.y() || pos[i].z() < minn.z() ||
-			pos[i].x() > maxx.x() || pos[i].y() > maxx.y() || pos[i].z() > maxx.z())
-			continue;
-		count++;
+		const int end = std::min(total, (b + 1) * blockSize);
+		int inBlock = 0;
+		for (int i = b * blockSize; i < end; i++)
+			inBlock += inside(i);
+		offsets[b + 1] = inBlock;
 	}
-	std::vector<RichPoint<3>> points(count);
+	for (int b = 0; b < numBlocks; b++)
+		offsets[b + 1] += offsets[b];
+	const int count = offsets[numBlocks];
+
+	std::vector<RichPoint<D>> points(count);
+	const int SH_N = (D + 1) * (D + 1);
 
 	// Output number of Gaussians contained
 	SIBR_LOG << "Saving " << count << " Gaussian splats" << std::endl;
 
-	std::ofstream outfile(filename, std::ios_base::binary);
-
-	outfile << "ply\nformat binary_little_endian 1.0\nelement vertex " << count << "\n";
-
-	std::string props1[] = { "x", "y", "z", "nx", "ny", "nz", "f_dc_0", "f_dc_1", "f_dc_2"};
-	std::string props2[] = { "opacity", "scale_0", "scale_1", "scale_2", "rot_0", "rot_1", "rot_2", "rot_3" };
-
-	for (auto s : props1)
-		outfile << "property float " << s << std::endl;
-	for (int i = 0; i < 45; i++)
-		outfile << "property float f_rest_" << i << std::endl;
-	for (auto s : props2)
-		outfile << "property float " << s << std::endl;
-	outfile << "end_header" << std::endl;
-
-	count = 0;
-	for (int i = 0; i < pos.size(); i++)
+#pragma omp parallel for
+	for (int b = 0; b < numBlocks; b++)
 	{
-		if (pos[i].x() < minn.x() || pos[i].y() < minn.y() || pos[i].z() < minn.z() ||
-			pos[i].x() > maxx.x() || pos[i].y() > maxx.y() || pos[i].z() > maxx.z())
-			continue;
-		points[count].pos = pos[i];
-		points[count].rot = rot[i];
-		// Exponentiate scale
-		for (int j = 0; j < 3; j++)
-			points[count].scale.scale[j] = log(scales[i].scale[j]);
-		// Activate alpha
-		points[count].opacity = inverse_sigmoid(opacities[i]);
-		points[count].shs.shs[0] = shs[i].shs[0];
-		points[count].shs.shs[1] = shs[i].shs[1];
-		points[count].shs.shs[2] = shs[i].shs[2];
-		for (int j = 1; j < 16; j++)
+		const int end = std::min(total, (b + 1) * blockSize);
+		int k = offsets[b];
+		for (int i = b * blockSize; i < end; i++)
 		{
-			points[count].shs.shs[(j - 1) + 3] = shs[i].shs[j * 3 + 0];
-			points[count].shs.shs[(j - 1) + 18] = shs[i].shs[j * 3 + 1];
-			points[count].shs.shs[(j - 1) + 33] = shs[i].shs[j * 3 + 2];
+			if (!inside(i))
+				continue;
+			RichPoint<D>& point = points[k++];
+			point.pos = pos[i];
+			point.rot = rot[i];
+			// Exponentiate scale
+			for (int j = 0; j < 3; j++)
+				point.scale.scale[j] = log(scales[i].scale[j]);
+			// Activate alpha
+			point.opacity = inverse_sigmoid(opacities[i]);
+			const float* src = &shs[size_t(i) * SH_N * 3];
+			point.shs.shs[0] = src[0];
+			point.shs.shs[1] = src[1];
+			point.shs.shs[2] = src[2];
+			for (int j = 1; j < SH_N; j++)
+			{
+				point.shs.shs[(j - 1) + 3] = src[j * 3 + 0];
+				point.shs.shs[(j - 1) + SH_N + 2] = src[j * 3 + 1];
+				point.shs.shs[(j - 1) + 2 * SH_N + 1] = src[j * 3 + 2];
+			}
 		}
-		count++;
 	}
-	outfile.write((char*)points.data(), sizeof(RichPoint<3>) * points.size());
+
+	std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(count) + "\n";
+	const char* props1[] = { "x", "y", "z", "nx", "ny", "nz", "f_dc_0", "f_dc_1", "f_dc_2" };
+	const char* props2[] = { "opacity", "scale_0", "scale_1", "scale_2", "rot_0", "rot_1", "rot_2", "rot_3" };
+	for (auto s : props1)
+		header += std::string("property float ") + s + "\n";
+	for (int i = 0; i < (SH_N - 1) * 3; i++)
+		header += "property float f_rest_" + std::to_string(i) + "\n";
+	for (auto s : props2)
+		header += std::string("property float ") + s + "\n";
+	header += "end_header\n";
+
+	// The header and the packed points are written at once, without per-line flushes.
+	std::ofstream outfile(filename, std::ios_base::binary);
+	outfile.write(header.data(), header.size());
+	outfile.write((char*)points.data(), sizeof(RichPoint<D>) * points.size());
+	if (!outfile)
+		SIBR_WRG << "Unable to write " << filename << std::endl;
+	SIBR_LOG << "[savePly] Total: " << timer.deltaTimeFromLastTic() << "ms" << std::endl;
 }
 
 namespace sibr
@@ -262,24 +415,27 @@ namespace sibr
 			_flip.init(_shader, "flip");
 			_width.init(_shader, "width");
 			_height.init(_shader, "height");
+			_packed.init(_shader, "packed");
 		}
 
 		void process(uint bufferID, IRenderTarget& dst, int width, int height, bool disableTest = true)
 		{
 			if (disableTest)
-				glDisable(GL_DEPTH_TEST);
+				GLState::disable(GL_DEPTH_TEST);
 			else
-				glEnable(GL_DEPTH_TEST);
+				GLState::enable(GL_DEPTH_TEST);
 
 			_shader.begin();
 			_flip.send();
 			_width.send();
 			_height.send();
+			_packed.send();
 
 			dst.clear();
 			dst.bind();
 
 			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bufferID);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bufferID);
 
 			sibr::RenderUtility::renderScreenQuad();
 
@@ -291,6 +447,8 @@ namespace sibr
 		bool& flip() { return _flip.get(); }
 		int& width() { return _width.get(); }
 		int& height() { return _height.get(); }
+		/** \return option to read 8-bit RGBA pixels instead of planar float RGB. */
+		bool& packed() { return _packed.get(); }
 
 	private:
 
@@ -298,29 +456,203 @@ namespace sibr
 		GLuniform<bool>		_flip = false; ///< Flip the texture when copying.
 		GLuniform<int>		_width = 1000;
 		GLuniform<int>		_height = 800;
+		GLuniform<bool>		_packed = false; ///< The buffer contains 8-bit RGBA pixels.
 	};
-}
 
-std::function<char* (size_t N)> resizeFunctional(void** ptr, size_t& S) {
-	auto lambda = [ptr, &S](size_t N) {
-		if (N > S)
+	// Composite the Gaussians rasterized over the background with an opaque mesh, using the
+	// depth and alpha of the Gaussians and the depth of the mesh.
+	class BufferCompositeRenderer
+	{
+
+	public:
+
+		BufferCompositeRenderer()
 		{
-			if (*ptr)
-				CUDA_SAFE_CALL(cudaFree(*ptr));
-			CUDA_SAFE_CALL(cudaMalloc(ptr, 2 * N));
-			S = 2 * N;
+			_shader.init("CompositeShader",
+				sibr::loadFile(sibr::getShadersDirectory("gaussian") + "/copy.vert"),
+				sibr::loadFile(sibr::getShadersDirectory("gaussian") + "/composite.frag"));
+
+			_flip.init(_shader, "flip");
+			_width.init(_shader, "width");
+			_height.init(_shader, "height");
+			_background.init(_shader, "background");
+			_znear.init(_shader, "znear");
+			_zfar.init(_shader, "zfar");
 		}
-		return reinterpret_cast<char*>(*ptr);
+
+		void process(uint colorBuffer, uint depthBuffer, uint meshColor, uint meshDepth, IRenderTarget& dst, int width, int height)
+		{
+			GLState::disable(GL_DEPTH_TEST);
+
+			_shader.begin();
+			_flip.send();
+			_width.send();
+			_height.send();
+			_background.send();
+			_znear.send();
+			_zfar.send();
+
+			dst.clear();
+			dst.bind();
+
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, colorBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, depthBuffer);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, meshColor);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, meshDepth);
+
+			sibr::RenderUtility::renderScreenQuad();
+
+			glActiveTexture(GL_TEXTURE0);
+			dst.unbind();
+			_shader.end();
+		}
+
+		/** \return option to flip the buffers when copying. */
+		bool& flip() { return _flip.get(); }
+		int& width() { return _width.get(); }
+		int& height() { return _height.get(); }
+		/** \return the background the Gaussians were rasterized over. */
+		sibr::Vector3f& background() { return _background.get(); }
+		float& znear() { return _znear.get(); }
+		float& zfar() { return _zfar.get(); }
+
+	private:
+
+		GLShader			_shader;
+		GLuniform<bool>		_flip = false; ///< Flip the buffers when copying.
+		GLuniform<int>		_width = 1000;
+		GLuniform<int>		_height = 800;
+		GLuniform<sibr::Vector3f>	_background = sibr::Vector3f::Zero(); ///< Background of the Gaussians image.
+		GLuniform<float>	_znear = 0.01f; ///< Near plane of the mesh depth.
+		GLuniform<float>	_zfar = 1000.0f; ///< Far plane of the mesh depth.
+	};
+}
+
+namespace
+{
+	// A model on the host. When a valid preprocessed cache exists, the arrays
+	// are used directly from the mapped file, otherwise they are loaded from the PLY.
+	struct HostModel
+	{
+		sibr::GaussianCache cache;
+		std::vector<Pos> pos;
+		std::vector<Rot> rot;
+		std::vector<Scale> scale;
+		std::vector<float> opacity;
+		std::vector<float> shs;
+		const void* posData = nullptr, * rotData = nullptr, * scaleData = nullptr, * opacityData = nullptr, * shsData = nullptr;
+		int count = 0;
+		sibr::Vector3f minimum, maximum;
 	};
-	return lambda;
 }
 
-sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h, const char* file, bool* messageRead, int sh_degree, bool white_bg, bool useInterop, int device) :
+// Load the PLY data (AoS) in SoA arrays, from the cache when possible, and write the cache otherwise.
+static void loadModel(const char* file, int sh_degree, int coeffs, bool useCache, HostModel& model)
+{
+	const std::string cachePath = sibr::GaussianCache::pathFor(file);
+	sibr::GaussianCache& cache = model.cache;
+	if (useCache && cache.open(cachePath, file, sh_degree)
+		&& cache.stride(sibr::GaussianCache::SH) == sizeof(float) * 3 * coeffs)
+	{
+		SIBR_LOG << "Loading " << cache.count() << " Gaussian splats from cache " << cachePath << std::endl;
+		model.count = cache.count();
+		model.minimum = cache.minimum();
+		model.maximum = cache.maximum();
+		model.posData = cache.data(sibr::GaussianCache::POSITION);
+		model.rotData = cache.data(sibr::GaussianCache::ROTATION);
+		model.scaleData = cache.data(sibr::GaussianCache::SCALE);
+		model.opacityData = cache.data(sibr::GaussianCache::OPACITY);
+		model.shsData = cache.data(sibr::GaussianCache::SH);
+		return;
+	}
+
+	if (sh_degree == 0)
+	{
+		model.count = loadPly<0>(file, model.pos, model.shs, model.opacity, model.scale, model.rot, model.minimum, model.maximum);
+	}
+	else if (sh_degree == 1)
+	{
+		model.count = loadPly<1>(file, model.pos, model.shs, model.opacity, model.scale, model.rot, model.minimum, model.maximum);
+	}
+	else if (sh_degree == 2)
+	{
+		model.count = loadPly<2>(file, model.pos, model.shs, model.opacity, model.scale, model.rot, model.minimum, model.maximum);
+	}
+	else if (sh_degree == 3)
+	{
+		model.count = loadPly<3>(file, model.pos, model.shs, model.opacity, model.scale, model.rot, model.minimum, model.maximum);
+	}
+	model.posData = model.pos.data();
+	model.rotData = model.rot.data();
+	model.scaleData = model.scale.data();
+	model.opacityData = model.opacity.data();
+	model.shsData = model.shs.data();
+
+	if (useCache)
+	{
+		sibr::GaussianCache::write(cachePath, file, sh_degree, model.count, model.minimum, model.maximum,
+			{ model.posData, model.rotData, model.scaleData, model.opacityData, model.shsData },
+			{ sizeof(Pos), sizeof(Rot), sizeof(Scale), sizeof(float), sizeof(float) * 3 * coeffs });
+	}
+}
+
+// The active input cameras, to rank the Gaussians when pruning.
+static std::vector<sibr::GaussianPrune::Camera> pruneCameras(const sibr::BasicIBRScene & scene)
+{
+	std::vector<sibr::GaussianPrune::Camera> cameras;
+	for (const auto& input : scene.cameras()->inputCameras())
+	{
+		if (!input->isActive())
+			continue;
+		sibr::GaussianPrune::Camera camera;
+		std::memcpy(camera.viewproj, input->viewproj().data(), sizeof(camera.viewproj));
+		camera.focal = 0.5f * float(input->h()) / tan(0.5f * input->fovy());
+		camera.width = int(input->w());
+		camera.height = int(input->h());
+		cameras.push_back(camera);
+	}
+	return cameras;
+}
+
+// Only keep the selected Gaussians of a model, in host arrays.
+static void pruneModel(HostModel& model, int coeffs, const std::vector<sibr::GaussianPrune::Camera>& cameras, float pruneOpacity, int pruneBudget)
+{
+	const std::vector<int> kept = sibr::GaussianPrune::select(model.count, (const float*)model.posData, (const float*)model.scaleData,
+		(const float*)model.opacityData, cameras, pruneOpacity, pruneBudget);
+	SIBR_LOG << "Pruning kept " << kept.size() << " of " << model.count << " Gaussians" << std::endl;
+	if (int(kept.size()) == model.count)
+		return;
+
+	model.pos = gatherKept<Pos>(kept, model.posData);
+	model.rot = gatherKept<Rot>(kept, model.rotData);
+	model.scale = gatherKept<Scale>(kept, model.scaleData);
+	model.opacity = gatherKept<float>(kept, model.opacityData);
+	std::vector<float> keptSHs(kept.size() * 3 * coeffs);
+	#pragma omp parallel for
+	for (int i = 0; i < int(kept.size()); i++)
+	{
+		std::memcpy(keptSHs.data() + size_t(i) * 3 * coeffs, (const float*)model.shsData + size_t(kept[i]) * 3 * coeffs,
+			sizeof(float) * 3 * coeffs);
+	}
+	model.shs.swap(keptSHs);
+	model.posData = model.pos.data();
+	model.rotData = model.rot.data();
+	model.scaleData = model.scale.data();
+	model.opacityData = model.opacity.data();
+	model.shsData = model.shs.data();
+	model.count = int(kept.size());
+}
+
+sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h, const char* file, bool* messageRead, int sh_degree, bool white_bg, bool useInterop, int device, bool useCache, GaussianSHBuffer::Storage shStorage, int codebookSize, bool buildLOD, int vramBudget, bool fallbackRGBA8, int splitFrame, float pruneOpacity, int pruneBudget,
+	const std::vector<std::string> & models) :
 	_scene(ibrScene),
 	_dontshow(messageRead),
 	_sh_degree(sh_degree),
 	sibr::ViewBase(render_w, render_h)
 {
+	SIBR_MEMORY_SCOPE("Gaussians");
 	int num_devices;
 	CUDA_SAFE_CALL_ALWAYS(cudaGetDeviceCount(&num_devices));
 	_device = device;
@@ -344,6 +676,7 @@ sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint
 	_copyRenderer->flip() = true;
 	_copyRenderer->width() = render_w;
 	_copyRenderer->height() = render_h;
+	_imageSize = sibr::Vector2i(render_w, render_h);
 
 	std::vector<uint> imgs_ulr;
 	const auto & cams = ibrScene->cameras()->inputCameras();
@@ -354,62 +687,185 @@ sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint
 	}
 	_scene->cameras()->debugFlagCameraAsUsed(imgs_ulr);
 
-	// Load the PLY data (AoS) to the GPU (SoA)
-	std::vector<Pos> pos;
-	std::vector<Rot> rot;
-	std::vector<Scale> scale;
-	std::vector<float> opacity;
-	std::vector<SHs<3>> shs;
-	if (sh_degree == 0)
+	// Only the coefficients of the model degree are stored and uploaded.
+	_sh_degree = std::max(0, std::min(sh_degree, 3));
+	_render_sh_degree = _sh_degree;
+	_sh_coeffs = (_sh_degree + 1) * (_sh_degree + 1);
+
+	const std::string cachePath = GaussianCache::pathFor(file);
+	if (vramBudget > 0 && !useCache)
 	{
-		count = loadPly<0>(file, pos, shs, opacity, scale, rot, _scenemin, _scenemax);
+		SIBR_WRG << "Streaming reads the model from its cache, --no_cache is ignored." << std::endl;
+		useCache = true;
 	}
-	else if (sh_degree == 1)
+	_useCache = useCache;
+	HostModel model;
+	loadModel(file, sh_degree, _sh_coeffs, useCache, model);
+	count = model.count;
+	_scenemin = model.minimum;
+	_scenemax = model.maximum;
+
+	_boxmin = _scenemin;
+	_boxmax = _scenemax;
+
+	// Models larger than the budget are streamed: the device buffers are only a pool of chunks.
+	const bool streaming = vramBudget > 0 && _streamer.open(cachePath, file, sh_degree, size_t(vramBudget) * 1024 * 1024);
+	if (streaming && (shStorage != GaussianSHBuffer::FLOAT_STORAGE || buildLOD))
 	{
-		count = loadPly<1>(file, pos, shs, opacity, scale, rot, _scenemin, _scenemax);
+		SIBR_WRG << "Streamed models use float SH storage and no level-of-detail." << std::endl;
+		shStorage = GaussianSHBuffer::FLOAT_STORAGE;
+		buildLOD = false;
 	}
-	else if (sh_degree == 2)
+	if (streaming && splitFrame > 1)
 	{
-		count = loadPly<2>(file, pos, shs, opacity, scale, rot, _scenemin, _scenemax);
+		SIBR_WRG << "Streamed models are rendered on a single GPU." << std::endl;
+		splitFrame = 1;
 	}
-	else if (sh_degree == 3)
+	splitFrame = std::min(splitFrame, num_devices);
+	if (splitFrame > 1 && shStorage != GaussianSHBuffer::FLOAT_STORAGE)
 	{
-		count = loadPly<3>(file, pos, shs, opacity, scale, rot, _scenemin, _scenemax);
+		SIBR_WRG << "Split-frame rendering uses float SH storage." << std::endl;
+		shStorage = GaussianSHBuffer::FLOAT_STORAGE;
 	}
 
-	_boxmin = _scenemin;
-	_boxmax = _scenemax;
+	if (streaming && (pruneOpacity > 0.0f || pruneBudget > 0))
+	{
+		SIBR_WRG << "Streamed models are not pruned." << std::endl;
+	}
+	else if (pruneOpacity > 0.0f || pruneBudget > 0)
+	{
+		// The cache keeps the full model.
+		pruneModel(model, _sh_coeffs, pruneCameras(*_scene), pruneOpacity, pruneBudget);
+		count = model.count;
+		_pruned = true;
+	}
+	const void* posData = model.posData, * rotData = model.rotData, * scaleData = model.scaleData,
+		* opacityData = model.opacityData, * shsData = model.shsData;
+
+	int P = streaming ? _streamer.capacity() : count;
+
+	// The ellipsoids renderer needs the whole model in GL buffers, not available when streaming.
+	if (!streaming)
+	{
+		gData = new GaussianData(P,
+			(const float*)posData,
+			(const float*)rotData,
+			(const float*)scaleData,
+			(const float*)opacityData,
+			(const float*)shsData,
+			_sh_coeffs);
+
+		// Map the GL buffers into CUDA instead of keeping a second copy of the model.
+		// Compact SHs can't be shared, the GL buffer always holds floats.
+		if (useInterop)
+		{
+			const GLuint buffers[5] = { gData->means(), gData->rotations(), gData->scales(), gData->alphas(), gData->colors() };
+			const int shared = shStorage == GaussianSHBuffer::FLOAT_STORAGE ? 5 : 4;
+			while (_sharedCount < shared
+				&& cudaGraphicsGLRegisterBuffer(&_sharedCuda[_sharedCount], buffers[_sharedCount],
+					_sharedCount == 3 ? cudaGraphicsRegisterFlagsNone : cudaGraphicsRegisterFlagsReadOnly) == cudaSuccess)
+			{
+				_sharedCount++;
+			}
+			if (_sharedCount < shared)
+			{
+				cudaGetLastError();
+				SIBR_WRG << "Unable to share the model buffers between GL and CUDA, they are duplicated." << std::endl;
+				for (int i = 0; i < _sharedCount; i++)
+					cudaGraphicsUnregisterResource(_sharedCuda[i]);
+				_sharedCount = 0;
+			}
+		}
+	}
 
-	int P = count;
-
-	// Allocate and fill the GPU data
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&pos_cuda, sizeof(Pos) * P));
-	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(pos_cuda, pos.data(), sizeof(Pos) * P, cudaMemcpyHostToDevice));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&rot_cuda, sizeof(Rot) * P));
-	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(rot_cuda, rot.data(), sizeof(Rot) * P, cudaMemcpyHostToDevice));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&shs_cuda, sizeof(SHs<3>) * P));
-	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(shs_cuda, shs.data(), sizeof(SHs<3>) * P, cudaMemcpyHostToDevice));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&opacity_cuda, sizeof(float) * P));
-	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity_cuda, opacity.data(), sizeof(float) * P, cudaMemcpyHostToDevice));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&scale_cuda, sizeof(Scale) * P));
-	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(scale_cuda, scale.data(), sizeof(Scale) * P, cudaMemcpyHostToDevice));
-
-	// Create space for view parameters
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&view_cuda, sizeof(sibr::Matrix4f)));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&proj_cuda, sizeof(sibr::Matrix4f)));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&cam_pos_cuda, 3 * sizeof(float)));
+	if (_sharedCount > 0)
+	{
+		SIBR_LOG << "Model buffers are shared between GL and CUDA" << std::endl;
+		mapShared(true);
+		if (_sharedCount < 5)
+			shs_buffer.upload((const float*)shsData, P, _sh_coeffs, shStorage, codebookSize);
+	}
+	else
+	{
+		// Allocate and fill the GPU data
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&pos_cuda, sizeof(Pos) * P));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&rot_cuda, sizeof(Rot) * P));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&opacity_cuda, sizeof(float) * P));
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&scale_cuda, sizeof(Scale) * P));
+		if (streaming)
+		{
+			shs_buffer.allocate(P, _sh_coeffs);
+			_streamer.bind(pos_cuda, rot_cuda, scale_cuda, opacity_cuda, shs_buffer.floatSHs());
+		}
+		else
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(pos_cuda, posData, sizeof(Pos) * P, cudaMemcpyHostToDevice));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(rot_cuda, rotData, sizeof(Rot) * P, cudaMemcpyHostToDevice));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity_cuda, opacityData, sizeof(float) * P, cudaMemcpyHostToDevice));
+			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(scale_cuda, scaleData, sizeof(Scale) * P, cudaMemcpyHostToDevice));
+			shs_buffer.upload((const float*)shsData, P, _sh_coeffs, shStorage, codebookSize);
+		}
+	}
+	if (shs_buffer.compact())
+	{
+		// Compact SHs are decoded to per-Gaussian colors before each rasterization.
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&colors_cuda, 3 * sizeof(float) * _maxCount));
+	}
+	SIBR_LOG << "SH coefficients use " << shs_buffer.gpuBytes() / (1024 * 1024) << "MB of GPU memory" << std::endl;
+
+	// Other models only own their attributes, the rasterizer state and images are shared.
+	_modelName = file;
+	_maxCount = P;
+	for (const std::string & path : models)
+	{
+		HostModel other;
+		loadModel(path.c_str(), sh_degree, _sh_coeffs, useCache, other);
+		if (pruneOpacity > 0.0f || pruneBudget > 0)
+			pruneModel(other, _sh_coeffs, pruneCameras(*_scene), pruneOpacity, pruneBudget);
+		_models.emplace_back(new GaussianModel());
+		_models.back()->upload(path, other.count, _sh_coeffs, (const float*)other.posData, (const float*)other.rotData,
+			(const float*)other.scaleData, (const float*)other.opacityData, (const float*)other.shsData, shStorage, codebookSize);
+		_maxCount = std::max(_maxCount, other.count);
+		SIBR_LOG << "Loaded " << other.count << " Gaussians of " << path << " (" << _models.back()->gpuBytes() / (1024 * 1024) << "MB)" << std::endl;
+	}
+	if (!_models.empty())
+	{
+		CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&blend_cuda, 3 * sizeof(float) * render_w * render_h));
+	}
+
+	if (buildLOD)
+	{
+		// Interior nodes use the same SH storage as the leaves.
+		_lod.build(P, _sh_coeffs, (const float*)posData, (const float*)rotData, (const float*)scaleData,
+			(const float*)opacityData, (const float*)shsData, shStorage);
+		_useLOD = _lod.built();
+	}
+
+	// Create space for view parameters, in one block uploaded at once from pinned memory
+	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&view_cuda, sizeof(float) * kFrameParams));
+	proj_cuda = view_cuda + 16;
+	cam_pos_cuda = view_cuda + 32;
+	CUDA_SAFE_CALL_ALWAYS(cudaMallocHost((void**)&frame_params_host, kParamSlots * sizeof(float) * kFrameParams));
+	for (int i = 0; i < kParamSlots; i++)
+	{
+		CUDA_SAFE_CALL_ALWAYS(cudaEventCreateWithFlags(&frame_params_uploaded[i], cudaEventDisableTiming));
+	}
 	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&background_cuda, 3 * sizeof(float)));
-	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&rect_cuda, 2 * P * sizeof(int)));
+	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&rect_cuda, 2 * _maxCount * sizeof(int)));
 
 	float bg[3] = { white_bg ? 1.f : 0.f, white_bg ? 1.f : 0.f, white_bg ? 1.f : 0.f };
 	CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(background_cuda, bg, 3 * sizeof(float), cudaMemcpyHostToDevice));
+	_background = sibr::Vector3f(bg[0], bg[1], bg[2]);
 
-	gData = new GaussianData(P, 
-		(float*)pos.data(),
-		(float*)rot.data(),
-		(float*)scale.data(),
-		opacity.data(),
-		(float*)shs.data());
+	if (splitFrame > 1)
+	{
+		// Replicate the model on the next devices, each one renders a band of the frame.
+		std::vector<int> devices;
+		for (int d = 0; d < splitFrame; d++)
+			devices.push_back((device + d) % num_devices);
+		_splitFrame.init(devices, P, _sh_coeffs, (const float*)posData, (const float*)rotData, (const float*)scaleData,
+			(const float*)opacityData, (const float*)shsData, bg, render_w, render_h);
+	}
 
 	_gaussianRenderer = new GaussianSurfaceRenderer();
 
@@ -426,21 +882,83 @@ sibr::GaussianView::GaussianView(const sibr::BasicIBRScene::Ptr & ibrScene, uint
 		cudaGraphicsGLRegisterBuffer(&imageBufferCuda, imageBuffer, cudaGraphicsRegisterFlagsWriteDiscard);
 		useInterop &= (cudaGetLastError() == cudaSuccess);
 	}
+	if (useInterop)
+	{
+		// Rasterized images are converted once to a texture, displayed by a blit.
+		glCreateTextures(GL_TEXTURE_2D, 1, &_outputTexture);
+		glTextureStorage2D(_outputTexture, 1, GL_RGBA8, render_w, render_h);
+		glCreateFramebuffers(1, &_outputFramebuffer);
+		glNamedFramebufferTexture(_outputFramebuffer, GL_COLOR_ATTACHMENT0, _outputTexture, 0);
+		cudaGraphicsResource_t outputCuda = nullptr;
+		if (cudaGraphicsGLRegisterImage(&outputCuda, _outputTexture, GL_TEXTURE_2D, cudaGraphicsRegisterFlagsSurfaceLoadStore) == cudaSuccess)
+		{
+			_output.attach(outputCuda, render_w, render_h);
+			_outputMemory.set(sibr::MemoryTracker::textureBytes(render_w, render_h, 1, 1, 4.0));
+		}
+		else
+		{
+			cudaGetLastError();
+			SIBR_WRG << "Unable to register the output texture with CUDA, using the copy pass." << std::endl;
+		}
+	}
 	if (!useInterop)
 	{
-		fallback_bytes.resize(render_w * render_h * 3 * sizeof(float));
-		cudaMalloc(&fallbackBufferCuda, fallback_bytes.size());
+		_readback.resize(render_w, render_h, fallbackRGBA8);
+		_copyRenderer->packed() = _readback.packed();
 		_interop_failed = true;
 	}
 
-	geomBufferFunc = resizeFunctional(&geomPtr, allocdGeom);
-	binningBufferFunc = resizeFunctional(&binningPtr, allocdBinning);
-	imgBufferFunc = resizeFunctional(&imgPtr, allocdImg);
+	_scratch.init(device);
+	_profiler.init();
+	geomBufferFunc = _scratch.functional(GaussianScratch::GEOMETRY);
+	binningBufferFunc = _scratch.functional(GaussianScratch::BINNING);
+	imgBufferFunc = _scratch.functional(GaussianScratch::IMAGE);
+
+	// Buffers shared with GL are accounted for as GL buffers.
+	size_t modelBytes = shs_buffer.gpuBytes() + _lod.gpuBytes() + 2 * sizeof(int) * size_t(_maxCount);
+	if (_sharedCount == 0)
+		modelBytes += 11 * sizeof(float) * size_t(P);
+	if (colors_cuda)
+		modelBytes += 3 * sizeof(float) * size_t(_maxCount);
+	if (blend_cuda)
+		modelBytes += 3 * sizeof(float) * size_t(render_w) * size_t(render_h);
+	for (const auto & model : _models)
+		modelBytes += model->gpuBytes();
+	_modelMemory.set(modelBytes);
+
+	// CUDA allocations are not seen by the GL memory info extensions.
+	sibr::GPUMemoryBudget::global().query([device](size_t & total, size_t & available) {
+		int current = 0;
+		cudaGetDevice(&current);
+		cudaSetDevice(device);
+		const bool known = cudaMemGetInfo(&available, &total) == cudaSuccess;
+		cudaSetDevice(current);
+		return known;
+	});
+	// Without the hierarchy, all the leaves are rasterized: slower, but the same image.
+	if (_lod.built())
+	{
+		_budgetId = sibr::GPUMemoryBudget::global().add("Gaussian LOD", sibr::GPUMemoryBudget::QUALITY, [this](size_t) {
+			if (!_lod.built())
+				return size_t(0);
+			const size_t before = _lod.gpuBytes();
+			CUDA_SAFE_CALL(cudaDeviceSynchronize());
+			_lod.release();
+			const size_t bytes = before - _lod.gpuBytes();
+			_useLOD = false;
+			_modelMemory.set(_modelMemory.bytes() - std::min(bytes, _modelMemory.bytes()));
+			return bytes;
+		});
+	}
+
+	if (!streaming)
+		warmUp();
 }
 
 void sibr::GaussianView::setScene(const sibr::BasicIBRScene::Ptr & newScene)
 {
 	_scene = newScene;
+	_initialPoints.reset();
 
 	// Tell the scene we are a priori using all active cameras.
 	std::vector<uint> imgs_ulr;
@@ -453,91 +971,479 @@ void sibr::GaussianView::setScene(const sibr::BasicIBRScene::Ptr & newScene)
 	_scene->cameras()->debugFlagCameraAsUsed(imgs_ulr);
 }
 
+void sibr::GaussianView::mapShared(bool map)
+{
+	if (_sharedCount == 0 || map == _sharedMapped)
+		return;
+	if (!map)
+	{
+		CUDA_SAFE_CALL(cudaGraphicsUnmapResources(_sharedCount, _sharedCuda));
+		_sharedMapped = false;
+		return;
+	}
+
+	// Mapped addresses are only valid until the next unmap.
+	CUDA_SAFE_CALL(cudaGraphicsMapResources(_sharedCount, _sharedCuda));
+	float** ptrs[4] = { &pos_cuda, &rot_cuda, &scale_cuda, &opacity_cuda };
+	size_t bytes;
+	for (int i = 0; i < 4; i++)
+	{
+		CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)ptrs[i], &bytes, _sharedCuda[i]));
+	}
+	if (_sharedCount == 5)
+	{
+		float* shs;
+		CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&shs, &bytes, _sharedCuda[4]));
+		shs_buffer.wrap(shs, count, _sh_coeffs);
+	}
+	_sharedMapped = true;
+}
+
+sibr::Vector2f sibr::GaussianView::tanFov(const sibr::Camera & eye) const
+{
+	const float tan_fovy = tan(eye.fovy() * 0.5f);
+	sibr::Vector2f tans(tan_fovy * eye.aspect(), tan_fovy);
+	// The focal length in pixels is the one of the whole image.
+	if (_region.active)
+		tans = tans.cwiseProduct(_region.size.cast<float>().cwiseQuotient(_region.image.cast<float>()));
+	return tans;
+}
+
+void sibr::GaussianView::frameParams(const sibr::Camera & eye, float * params) const
+{
+	// Convert view and projection to target coordinate system
+	sibr::Matrix4f view_mat = eye.view();
+	sibr::Matrix4f proj_mat = eye.viewproj();
+	view_mat.row(1) *= -1;
+	view_mat.row(2) *= -1;
+	proj_mat.row(1) *= -1;
+
+	if (_region.active)
+	{
+		// Map the region to the whole rasterized image, rows from the top as the rasterizer.
+		const sibr::Vector2f image = _region.image.cast<float>();
+		const sibr::Vector2f origin = _region.origin.cast<float>();
+		const sibr::Vector2f size = _region.size.cast<float>();
+		const sibr::Vector2f scale = image.cwiseQuotient(size);
+		const sibr::Vector2f offset = (image - 2.0f * origin - size).cwiseQuotient(size);
+		const sibr::Matrix4f projected = proj_mat;
+		proj_mat.row(0) = scale.x() * projected.row(0) + offset.x() * projected.row(3);
+		proj_mat.row(1) = scale.y() * projected.row(1) + offset.y() * projected.row(3);
+
+		// The rasterizer clamps the footprint Jacobian around the optical axis, for a centered frustum. Shearing
+		// the view space towards the region center gives the same projected footprints, with the axis in the region.
+		const float tan_fovy = tan(eye.fovy() * 0.5f);
+		const sibr::Vector2f tans(tan_fovy * eye.aspect(), tan_fovy);
+		const sibr::Vector2f center = (2.0f * origin + size).cwiseQuotient(image) - sibr::Vector2f(1.0f, 1.0f);
+		const sibr::Matrix4f viewed = view_mat;
+		view_mat.row(0) = viewed.row(0) - center.x() * tans.x() * viewed.row(2);
+		view_mat.row(1) = viewed.row(1) - center.y() * tans.y() * viewed.row(2);
+	}
+
+	std::memcpy(params, view_mat.data(), sizeof(sibr::Matrix4f));
+	std::memcpy(params + 16, proj_mat.data(), sizeof(sibr::Matrix4f));
+	std::memcpy(params + 32, eye.position().data(), sizeof(float) * 3);
+}
+
+void sibr::GaussianView::uploadFrameParams(const sibr::Camera & eye)
+{
+	// Copy frame-dependent data to GPU
+	// The copy is asynchronous, only wait for the upload that last used this slot of the pinned buffer.
+	float* params = frame_params_host + kFrameParams * _frameSlot;
+	CUDA_SAFE_CALL(cudaEventSynchronize(frame_params_uploaded[_frameSlot]));
+	frameParams(eye, params);
+	CUDA_SAFE_CALL(cudaMemcpyAsync(view_cuda, params, sizeof(float) * kFrameParams, cudaMemcpyHostToDevice, 0));
+	CUDA_SAFE_CALL(cudaEventRecord(frame_params_uploaded[_frameSlot], 0));
+	_frameSlot = (_frameSlot + 1) % kParamSlots;
+}
+
+sibr::GaussianView::Splats sibr::GaussianView::selectSplats(const sibr::Camera & eye, int P, int height, bool precomputeColors, int model)
+{
+	if (model > 0)
+	{
+		const GaussianModel & other = *_models[model - 1];
+		Splats splats = { other.count(), other.positions(), other.shs().floatSHs(), nullptr, other.opacities(), other.scales(), other.rotations() };
+		if (other.shs().compact() || precomputeColors)
+		{
+			if (!colors_cuda)
+			{
+				CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&colors_cuda, 3 * sizeof(float) * _maxCount));
+			}
+			other.shs().computeColors(_render_sh_degree, other.positions(), cam_pos_cuda, colors_cuda);
+			splats.shs = nullptr;
+			splats.colors = colors_cuda;
+		}
+		return splats;
+	}
+
+	// Colors left in colors_cuda by another frame must not be used with float SHs.
+	Splats splats = { P, pos_cuda, shs_buffer.floatSHs(), nullptr, opacity_cuda, scale_cuda, rot_cuda };
+	if (_useLOD)
+	{
+		// Select the cut for this viewpoint and rasterize the gathered Gaussians instead.
+		const float focal = height / (2.0f * tanFov(eye).y());
+		splats.P = _lod.update(eye.position().data(), focal, _lodThreshold * _lodQualityScale, pos_cuda, rot_cuda, scale_cuda, opacity_cuda);
+		_lod.computeColors(_render_sh_degree, pos_cuda, shs_buffer, cam_pos_cuda);
+		splats = { splats.P, _lod.positions(), nullptr, _lod.colors(), _lod.opacities(), _lod.scales(), _lod.rotations() };
+	}
+	else if (_cropping && !_streamer.enabled())
+	{
+		// Only rasterize the Gaussians inside the crop box, gathered again when the box changes.
+		splats.P = _crop.update(P, _boxmin.data(), _boxmax.data(), pos_cuda, rot_cuda, scale_cuda, opacity_cuda);
+		_crop.computeColors(_render_sh_degree, pos_cuda, shs_buffer, cam_pos_cuda);
+		splats = { splats.P, _crop.positions(), nullptr, _crop.colors(), _crop.opacities(), _crop.scales(), _crop.rotations() };
+	}
+	else if (shs_buffer.compact() || precomputeColors)
+	{
+		// Decode the SH coefficients to view dependent colors
+		if (!colors_cuda)
+		{
+			CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&colors_cuda, 3 * sizeof(float) * _maxCount));
+		}
+		shs_buffer.computeColors(_render_sh_degree, pos_cuda, cam_pos_cuda, colors_cuda);
+		splats.shs = nullptr;
+		splats.colors = colors_cuda;
+	}
+	return splats;
+}
+
+void sibr::GaussianView::forward(const sibr::Camera & eye, const Splats & splats, float * image_cuda, int width, int height, const float * background)
+{
+	// Compute additional view parameters
+	const sibr::Vector2f tans = tanFov(eye);
+	const float tan_fovx = tans.x();
+	const float tan_fovy = tans.y();
+
+	int* rects = _fastCulling ? rect_cuda : nullptr;
+	float* boxmin = _cropping ? (float*)&_boxmin : nullptr;
+	float* boxmax = _cropping ? (float*)&_boxmax : nullptr;
+	CudaRasterizer::Rasterizer::forward(
+		geomBufferFunc,
+		binningBufferFunc,
+		imgBufferFunc,
+		splats.P, _render_sh_degree, _sh_coeffs,
+		background ? background : background_cuda,
+		width, height,
+		splats.means,
+		splats.shs,
+		splats.colors,
+		splats.opacities,
+		splats.scales,
+		_scalingModifier,
+		splats.rotations,
+		nullptr,
+		view_cuda,
+		proj_cuda,
+		cam_pos_cuda,
+		tan_fovx,
+		tan_fovy,
+		false,
+		image_cuda,
+		nullptr,
+		rects,
+		boxmin,
+		boxmax
+	);
+}
+
+void sibr::GaussianView::rasterize(const sibr::Camera & eye, float * image_cuda, int width, int height)
+{
+	SIBR_MEMORY_SCOPE("Gaussians");
+	mapShared(true);
+
+	if (_splitFrame.enabled() && !_useLOD && _activeModel == 0 && _blendModel < 0)
+	{
+		// Each GPU selects and rasterizes the Gaussians of its band, the crop box is tested by the rasterizer.
+		float params[kFrameParams];
+		frameParams(eye, params);
+		const sibr::Vector2f tans = tanFov(eye);
+		GaussianSplitFrame::Frame frame = { params, width, height, tans.x(), tans.y(),
+			_render_sh_degree, _scalingModifier, _fastCulling,
+			_cropping ? _boxmin.data() : nullptr, _cropping ? _boxmax.data() : nullptr,
+			pos_cuda, rot_cuda, scale_cuda, opacity_cuda, &shs_buffer };
+		_profiler.begin(GaussianProfiler::RASTERIZE);
+		_splitFrame.render(frame, image_cuda);
+		_profiler.end(GaussianProfiler::RASTERIZE);
+		return;
+	}
+
+	_profiler.begin(GaussianProfiler::UPLOAD);
+	uploadFrameParams(eye);
+	const int P = _streamer.enabled() ? _streamer.update(eye) : count;
+	_profiler.end(GaussianProfiler::UPLOAD);
+
+	// The colors are gathered with the Gaussians in front of the composited mesh.
+	const bool composite = _gaussianDepth_cuda != nullptr;
+	_profiler.begin(GaussianProfiler::COLORS);
+	Splats splats = selectSplats(eye, P, height, composite, _activeModel);
+	if (composite)
+	{
+		const float focal = height / (2.0f * tanFov(eye).y());
+		const int visible = _occlusion.update(splats.P, splats.means, splats.rotations, splats.scales, splats.opacities, splats.colors,
+			view_cuda, proj_cuda, focal, _scalingModifier);
+		splats = { visible, _occlusion.positions(), nullptr, _occlusion.colors(), _occlusion.opacities(), _occlusion.scales(), _occlusion.rotations() };
+	}
+	_profiler.end(GaussianProfiler::COLORS);
+
+	// Rasterize
+	_profiler.begin(GaussianProfiler::RASTERIZE);
+	forward(eye, splats, image_cuda, width, height);
+	if (composite)
+	{
+		// The view depths rasterized as colors over black give the depth weighted by alpha, and alpha.
+		_occlusion.computeDepthColors(view_cuda);
+		Splats depths = splats;
+		depths.colors = _occlusion.depthColors();
+		forward(eye, depths, _gaussianDepth_cuda, width, height, black_cuda);
+	}
+	else if (_blendModel >= 0 && _blendModel != _activeModel)
+	{
+		// The colors of the first model have been consumed, colors_cuda can be reused.
+		const Splats blended = selectSplats(eye, P, height, false, _blendModel);
+		forward(eye, blended, blend_cuda, width, height);
+		GaussianModel::blend(image_cuda, blend_cuda, 3 * width * height, _blend);
+	}
+	_profiler.end(GaussianProfiler::RASTERIZE);
+	_scratchMemory.set(_scratch.allocated(GaussianScratch::GEOMETRY) + _scratch.allocated(GaussianScratch::BINNING)
+		+ _scratch.allocated(GaussianScratch::IMAGE));
+}
+
+void sibr::GaussianView::onRenderIBRStereo(sibr::IRenderTarget & left, sibr::IRenderTarget & right, const sibr::Camera & leftEye, const sibr::Camera & rightEye)
+{
+	// The readback path and the other modes render each eye on its own.
+	if (currMode != "Splats" || _interop_failed)
+	{
+		ViewBase::onRenderIBRStereo(left, right, leftEye, rightEye);
+		return;
+	}
+
+	_profiler.frame();
+	mapShared(true);
+
+	// Streaming residency, LOD cut, crop selection and colors are computed once for the pair,
+	// from the point between the eyes. Only projection, sorting and blending happen per eye.
+	sibr::Camera center(leftEye);
+	center.position(0.5f * (leftEye.position() + rightEye.position()));
+	const int height = std::min(_resolution.y(), int(left.h()));
+	const int width = std::min(_resolution.x(), int(left.w()));
+
+	_profiler.begin(GaussianProfiler::UPLOAD);
+	uploadFrameParams(center);
+	const int P = _streamer.enabled() ? _streamer.update(center) : count;
+	_profiler.end(GaussianProfiler::UPLOAD);
+
+	_profiler.begin(GaussianProfiler::COLORS);
+	const Splats splats = selectSplats(center, P, height, true, _activeModel);
+	_profiler.end(GaussianProfiler::COLORS);
+
+	_profiler.begin(GaussianProfiler::RASTERIZE);
+	const sibr::Camera* eyes[2] = { &leftEye, &rightEye };
+	sibr::IRenderTarget* dsts[2] = { &left, &right };
+	for (int e = 0; e < 2; e++)
+	{
+		float* image_cuda = nullptr;
+		size_t bytes;
+		CUDA_SAFE_CALL(cudaGraphicsMapResources(1, &imageBufferCuda));
+		CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&image_cuda, &bytes, imageBufferCuda));
+		uploadFrameParams(*eyes[e]);
+		forward(*eyes[e], splats, image_cuda, width, height);
+		CUDA_SAFE_CALL(cudaGraphicsUnmapResources(1, &imageBufferCuda));
+
+		_copyRenderer->width() = width;
+		_copyRenderer->height() = height;
+		_copyRenderer->process(imageBuffer, *dsts[e], width, height);
+	}
+	_profiler.end(GaussianProfiler::RASTERIZE);
+
+	// imageBuffer now holds the right eye.
+	_lastState = FrameState();
+	_outputValid = false;
+	_imageSize = sibr::Vector2i(width, height);
+}
+
+void sibr::GaussianView::warmUp()
+{
+	// Render from a few input viewpoints, so that the rasterizer buffers reach
+	// their working size before the first frame.
+	const auto & cams = _scene->cameras()->inputCameras();
+	const size_t views = std::min<size_t>(cams.size(), 4);
+	if (views == 0)
+		return;
+
+	sibr::Timer timer(true);
+	float* image_cuda = nullptr;
+	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&image_cuda, 3 * sizeof(float) * _resolution.x() * _resolution.y()));
+	for (size_t v = 0; v < views; v++)
+		rasterize(*cams[v * cams.size() / views], image_cuda, _resolution.x(), _resolution.y());
+	CUDA_SAFE_CALL_ALWAYS(cudaFree(image_cuda));
+	SIBR_LOG << "Rasterizer warm-up: " << (_scratch.allocated(GaussianScratch::GEOMETRY) + _scratch.allocated(GaussianScratch::BINNING)
+		+ _scratch.allocated(GaussianScratch::IMAGE)) / (1024 * 1024) << "MB of scratch memory in " << timer.deltaTimeFromLastTic() << "ms" << std::endl;
+}
+
+bool sibr::GaussianView::FrameState::operator==(const FrameState & other) const
+{
+	return viewproj == other.viewproj && position == other.position && scaling == other.scaling
+		&& shDegree == other.shDegree && cropping == other.cropping && boxmin == other.boxmin && boxmax == other.boxmax
+		&& lod == other.lod && lodThreshold == other.lodThreshold && resident == other.resident
+		&& model == other.model && blendModel == other.blendModel && blend == other.blend && edits == other.edits
+		&& composite == other.composite && region == other.region && regionImage == other.regionImage;
+}
+
+sibr::GaussianView::FrameState sibr::GaussianView::frameState(const sibr::Camera & eye) const
+{
+	FrameState state;
+	state.viewproj = eye.viewproj();
+	state.position = eye.position();
+	state.scaling = _scalingModifier;
+	state.shDegree = _render_sh_degree;
+	state.cropping = _cropping;
+	state.boxmin = _boxmin;
+	state.boxmax = _boxmax;
+	state.lod = _useLOD;
+	state.lodThreshold = _lodThreshold;
+	state.resident = _streamer.resident();
+	state.model = _activeModel;
+	state.blendModel = _blendModel;
+	state.blend = _blend;
+	state.edits = _edits;
+	// The mesh is rendered with the projection of the whole image.
+	state.composite = compositing() && !_region.active;
+	if (_region.active)
+	{
+		state.region = sibr::Vector4i(_region.origin.x(), _region.origin.y(), _region.size.x(), _region.size.y());
+		state.regionImage = _region.image;
+	}
+	return state;
+}
+
 void sibr::GaussianView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Camera & eye)
 {
+	SIBR_PROFILE_GPU("GaussianView");
+	_profiler.frame();
+
 	if (currMode == "Ellipsoids")
 	{
+		mapShared(false);
+		_profiler.begin(GaussianProfiler::ELLIPSOIDS);
 		_gaussianRenderer->process(count, *gData, eye, dst, 0.2f);
+		_profiler.end(GaussianProfiler::ELLIPSOIDS);
 	}
 	else if (currMode == "Initial Points")
 	{
-		_pointbasedrenderer->process(_scene->proxies()->proxy(), eye, dst);
+		// SfM and LiDAR clouds are too large to be drawn at once.
+		if (!_initialPoints)
+			_initialPoints.reset(new PointOctree(_scene->proxies()->proxy()));
+		_pointbasedrenderer->process(*_initialPoints, eye, dst);
 	}
 	else
 	{
-		// Convert view and projection to target coordinate system
-		auto view_mat = eye.view();
-		auto proj_mat = eye.viewproj();
-		view_mat.row(1) *= -1;
-		view_mat.row(2) *= -1;
-		proj_mat.row(1) *= -1;
-
-		// Compute additional view parameters
-		float tan_fovy = tan(eye.fovy() * 0.5f);
-		float tan_fovx = tan_fovy * eye.aspect();
-
-		// Copy frame-dependent data to GPU
-		CUDA_SAFE_CALL(cudaMemcpy(view_cuda, view_mat.data(), sizeof(sibr::Matrix4f), cudaMemcpyHostToDevice));
-		CUDA_SAFE_CALL(cudaMemcpy(proj_cuda, proj_mat.data(), sizeof(sibr::Matrix4f), cudaMemcpyHostToDevice));
-		CUDA_SAFE_CALL(cudaMemcpy(cam_pos_cuda, &eye.position(), sizeof(float) * 3, cudaMemcpyHostToDevice));
+		// Only rasterize when an input of the image changed, or to refine a reduced resolution frame.
+		const FrameState state = frameState(eye);
+		const bool moved = !state.viewproj.isApprox(_lastState.viewproj) || !state.position.isApprox(_lastState.position);
+		const int scale = _progressive && moved && !_region.active ? std::max(1, _motionScale) : 1;
+		const bool dirty = !_renderOnDemand || !(state == _lastState) || scale != _lastScale
+			|| (_streamer.enabled() && _streamer.loading() > 0);
+		if (dirty)
+		{
+			const sibr::Vector2i size = _region.active ? _region.size
+				: sibr::Vector2i(std::max(1, _resolution.x() / scale), std::max(1, _resolution.y() / scale));
+			if (state.composite)
+			{
+				renderCompositeMesh(eye, size.x(), size.y());
+			}
+			float* image_cuda = nullptr;
+			if (!_interop_failed)
+			{
+				// Map OpenGL buffer resource for use with CUDA
+				size_t bytes;
+				CUDA_SAFE_CALL(cudaGraphicsMapResources(1, &imageBufferCuda));
+				CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&image_cuda, &bytes, imageBufferCuda));
+				if (state.composite)
+				{
+					cudaGraphicsResource_t resources[2] = { _meshDepthCuda, _gaussianDepthCuda };
+					float* meshDepth_cuda = nullptr;
+					CUDA_SAFE_CALL(cudaGraphicsMapResources(2, resources));
+					CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&meshDepth_cuda, &bytes, _meshDepthCuda));
+					CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&_gaussianDepth_cuda, &bytes, _gaussianDepthCuda));
+					_occlusion.setDepth(meshDepth_cuda, size.x(), size.y(), eye.znear(), eye.zfar());
+				}
+			}
+			else
+			{
+				image_cuda = _readback.begin();
+			}
+
+			rasterize(eye, image_cuda, size.x(), size.y());
+
+			if (!_interop_failed)
+			{
+				_outputValid = _directOutput && _output.attached() && !state.composite;
+				if (_outputValid)
+					_output.write(image_cuda, size.x(), size.y(), true);
+				// Unmap OpenGL resource for use with OpenGL
+				if (state.composite)
+				{
+					cudaGraphicsResource_t resources[2] = { _meshDepthCuda, _gaussianDepthCuda };
+					CUDA_SAFE_CALL(cudaGraphicsUnmapResources(2, resources));
+					_gaussianDepth_cuda = nullptr;
+				}
+				CUDA_SAFE_CALL(cudaGraphicsUnmapResources(1, &imageBufferCuda));
+				_imageSize = size;
+			}
+			else
+			{
+				// Display the previous frame, whose readback overlapped this rasterization
+				_readback.end(size.x(), size.y());
+				const void* previous = _readback.previous();
+				if (previous)
+				{
+					glNamedBufferSubData(imageBuffer, 0, _readback.bytes(), previous);
+					_imageSize = _queuedSize;
+				}
+				_queuedSize = size;
+				_queuedShown = false;
+			}
+			_lastState = state;
+			_lastScale = scale;
+		}
+		else if (_interop_failed && !_queuedShown)
+		{
+			// The last rasterized frame hasn't been displayed yet.
+			glNamedBufferSubData(imageBuffer, 0, _readback.bytes(), _readback.latest());
+			_imageSize = _queuedSize;
+			_queuedShown = true;
+		}
 
-		float* image_cuda = nullptr;
-		if (!_interop_failed)
+		// Copy image contents to framebuffer
+		_profiler.begin(GaussianProfiler::COPY);
+		if (_lastState.composite)
 		{
-			// Map OpenGL buffer resource for use with CUDA
-			size_t bytes;
-			CUDA_SAFE_CALL(cudaGraphicsMapResources(1, &imageBufferCuda));
-			CUDA_SAFE_CALL(cudaGraphicsResourceGetMappedPointer((void**)&image_cuda, &bytes, imageBufferCuda));
+			_compositeRenderer->width() = _imageSize.x();
+			_compositeRenderer->height() = _imageSize.y();
+			_compositeRenderer->znear() = eye.znear();
+			_compositeRenderer->zfar() = eye.zfar();
+			_compositeRenderer->process(imageBuffer, _gaussianDepthBuffer, _meshColorRT->texture(), _meshDepthRenderer->_depth_RT->texture(),
+				dst, _imageSize.x(), _imageSize.y());
 		}
-		else
+		else if (_directOutput && _outputValid)
 		{
-			image_cuda = fallbackBufferCuda;
-		}
-
-		// Rasterize
-		int* rects = _fastCulling ? rect_cuda : nullptr;
-		float* boxmin = _cropping ? (float*)&_boxmin : nullptr;
-		float* boxmax = _cropping ? (float*)&_boxmax : nullptr;
-		CudaRasterizer::Rasterizer::forward(
-			geomBufferFunc,
-			binningBufferFunc,
-			imgBufferFunc,
-			count, _sh_degree, 16,
-			background_cuda,
-			_resolution.x(), _resolution.y(),
-			pos_cuda,
-			shs_cuda,
-			nullptr,
-			opacity_cuda,
-			scale_cuda,
-			_scalingModifier,
-			rot_cuda,
-			nullptr,
-			view_cuda,
-			proj_cuda,
-			cam_pos_cuda,
-			tan_fovx,
-			tan_fovy,
-			false,
-			image_cuda,
-			nullptr,
-			rects,
-			boxmin,
-			boxmax
-		);
-
-		if (!_interop_failed)
-		{
-			// Unmap OpenGL resource for use with OpenGL
-			CUDA_SAFE_CALL(cudaGraphicsUnmapResources(1, &imageBufferCuda));
+			// Same result as the copy pass, which disables the depth test and clears the destination.
+			const float depth = 1.0f;
+			const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+			glDisable(GL_SCISSOR_TEST);
+			glClearNamedFramebufferfv(dst.fbo(), GL_DEPTH, 0, &depth);
+			glBlitNamedFramebuffer(_outputFramebuffer, dst.fbo(), 0, 0, _imageSize.x(), _imageSize.y(),
+				0, 0, dst.w(), dst.h(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			if (scissor)
+				glEnable(GL_SCISSOR_TEST);
 		}
 		else
 		{
-			CUDA_SAFE_CALL(cudaMemcpy(fallback_bytes.data(), fallbackBufferCuda, fallback_bytes.size(), cudaMemcpyDeviceToHost));
-			glNamedBufferSubData(imageBuffer, 0, fallback_bytes.size(), fallback_bytes.data());
+			_copyRenderer->width() = _imageSize.x();
+			_copyRenderer->height() = _imageSize.y();
+			_copyRenderer->process(imageBuffer, dst, _imageSize.x(), _imageSize.y());
 		}
-		// Copy image contents to framebuffer
-		_copyRenderer->process(imageBuffer, dst, _resolution.x(), _resolution.y());
+		_profiler.end(GaussianProfiler::COPY);
 	}
 
 	if (cudaPeekAtLastError() != cudaSuccess)
@@ -546,8 +1452,227 @@ void sibr::GaussianView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Came
 	}
 }
 
+void sibr::GaussianView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Camera & eye, const sibr::Vector2i & imageSize, const sibr::Vector2i & origin, const sibr::Vector2i & size)
+{
+	// The rasterizer buffers are sized for the rendering resolution.
+	_region.size = size.cwiseMin(_resolution).cwiseMax(sibr::Vector2i(1, 1));
+	_region.image = imageSize.cwiseMax(_region.size);
+	_region.origin = origin;
+	_region.active = _region.size != _region.image || origin != sibr::Vector2i::Zero();
+	onRenderIBR(dst, eye);
+	_region.active = false;
+}
+
+void sibr::GaussianView::renderTiled(const sibr::Camera & eye, const sibr::Vector2i & imageSize, sibr::ImageRGB & image)
+{
+	image = sibr::ImageRGB(imageSize.x(), imageSize.y());
+	sibr::RenderTargetRGB::Ptr tile;
+	sibr::ImageRGB tileImage;
+	for (int y = 0; y < imageSize.y(); y += _resolution.y())
+	{
+		for (int x = 0; x < imageSize.x(); x += _resolution.x())
+		{
+			const sibr::Vector2i size(std::min(_resolution.x(), imageSize.x() - x), std::min(_resolution.y(), imageSize.y() - y));
+			// Only the last column and row of tiles can be smaller.
+			if (!tile || int(tile->w()) != size.x() || int(tile->h()) != size.y())
+				tile.reset(new sibr::RenderTargetRGB(size.x(), size.y()));
+			tile->clear();
+			onRenderIBR(*tile, eye, imageSize, sibr::Vector2i(x, y), size);
+			tile->readBack(tileImage);
+			tileImage.toOpenCV().copyTo(image.toOpenCVnonConst()(cv::Rect(x, y, size.x(), size.y())));
+		}
+	}
+}
+
 void sibr::GaussianView::onUpdate(Input & input)
 {
+	if (!_models.empty() && input.key().isReleased(sibr::Key::Tab))
+	{
+		_activeModel = (_activeModel + 1) % int(_models.size() + 1);
+		if (_blendModel == _activeModel)
+			_blendModel = -1;
+	}
+}
+
+void sibr::GaussianView::onUpdate(Input & input, const Viewport & vp)
+{
+	onUpdate(input);
+	// Queries run on the main model, which is only partially on the GPU when streaming.
+	if (_streamer.enabled() || _activeModel != 0 || !_lastState.position.allFinite() || _lastState.scaling < 0.0f)
+		return;
+
+	const bool ctrl = input.key().isActivated(sibr::Key::LeftControl);
+	const sibr::Vector2f ndc(2.0f * (float(input.mousePosition().x()) + 0.5f) / vp.finalWidth() - 1.0f,
+		1.0f - 2.0f * (float(input.mousePosition().y()) + 0.5f) / vp.finalHeight());
+	if (ctrl && input.mouseButton().isPressed(sibr::Mouse::Left))
+		_lasso.clear();
+	if (ctrl && input.mouseButton().isActivated(sibr::Mouse::Left))
+	{
+		const size_t n = _lasso.size();
+		if (n == 0 || (sibr::Vector2f(_lasso[n - 2], _lasso[n - 1]) - ndc).norm() > 0.01f)
+		{
+			_lasso.push_back(ndc.x());
+			_lasso.push_back(ndc.y());
+		}
+	}
+	if (!input.mouseButton().isReleased(sibr::Mouse::Left) || _lasso.empty())
+		return;
+
+	const GaussianQuery::Mode mode = input.key().isActivated(sibr::Key::LeftShift) ? GaussianQuery::ADD
+		: input.key().isActivated(sibr::Key::LeftAlt) ? GaussianQuery::SUBTRACT : GaussianQuery::REPLACE;
+	mapShared(true);
+	if (_lasso.size() >= 6)
+	{
+		_query.selectLasso(count, pos_cuda, _lastState.viewproj.data(), _lasso, mode);
+	}
+	else
+	{
+		// A click: cast the ray through the pixel from the last rasterized viewpoint.
+		const sibr::Matrix4f inverse = _lastState.viewproj.inverse();
+		const sibr::Vector4f nearPoint = inverse * sibr::Vector4f(_lasso[0], _lasso[1], -1.0f, 1.0f);
+		const sibr::Vector4f farPoint = inverse * sibr::Vector4f(_lasso[0], _lasso[1], 1.0f, 1.0f);
+		const sibr::Vector3f origin = nearPoint.head<3>() / nearPoint.w();
+		const sibr::Vector3f dir = (farPoint.head<3>() / farPoint.w() - origin).normalized();
+		const int picked = _query.pick(count, pos_cuda, rot_cuda, scale_cuda, opacity_cuda, origin.data(), dir.data(), 0.05f);
+		_query.selectIndex(count, picked, mode);
+	}
+	_lasso.clear();
+}
+
+bool sibr::GaussianView::reloadModel()
+{
+	if (_streamer.enabled() || _lod.built() || _splitFrame.enabled() || _pruned)
+	{
+		SIBR_WRG << "Streamed, pruned, split-frame and level-of-detail models can't be reloaded, restart the viewer." << std::endl;
+		return false;
+	}
+	HostModel model;
+	loadModel(_modelName.c_str(), _sh_degree, _sh_coeffs, _useCache, model);
+	if (model.count != count)
+	{
+		SIBR_WRG << "The model now has " << model.count << " Gaussians instead of " << count << ", restart the viewer to load it." << std::endl;
+		return false;
+	}
+
+	// The rasterization and the chunk uploads may still read the buffers.
+	CUDA_SAFE_CALL_ALWAYS(cudaDeviceSynchronize());
+	if (gData)
+	{
+		mapShared(false);
+		gData->update((const float*)model.posData, (const float*)model.rotData, (const float*)model.scaleData,
+			(const float*)model.opacityData, (const float*)model.shsData);
+		mapShared(true);
+	}
+	if (_sharedCount == 0)
+	{
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(pos_cuda, model.posData, sizeof(Pos) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(rot_cuda, model.rotData, sizeof(Rot) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity_cuda, model.opacityData, sizeof(float) * count, cudaMemcpyHostToDevice));
+		CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(scale_cuda, model.scaleData, sizeof(Scale) * count, cudaMemcpyHostToDevice));
+	}
+	if (_sharedCount < 5)
+	{
+		shs_buffer.upload((const float*)model.shsData, count, _sh_coeffs, shs_buffer.storage(), shs_buffer.codebookSize());
+	}
+	_scenemin = model.minimum;
+	_scenemax = model.maximum;
+	opacitiesEdited();
+	SIBR_LOG << "Reloaded " << count << " Gaussians from " << _modelName << std::endl;
+	return true;
+}
+
+void sibr::GaussianView::watchModel(bool enable)
+{
+	if (_modelWatch != 0)
+	{
+		sibr::FileWatcher::shared().unwatch(_modelWatch);
+		_modelWatch = 0;
+	}
+	if (enable)
+	{
+		_modelWatch = sibr::FileWatcher::shared().watch(_modelName, [this](const std::string &) { reloadModel(); });
+	}
+}
+
+void sibr::GaussianView::compositeMesh(const sibr::Mesh::Ptr & mesh, const sibr::Texture2DRGB::Ptr & texture)
+{
+	_compositeMesh = mesh;
+	_compositeTexture = texture;
+	_compositing = mesh != nullptr;
+	_lastState = FrameState();
+	if (!mesh)
+	{
+		_occlusion.clear();
+		return;
+	}
+	if (_interop_failed)
+	{
+		SIBR_WRG << "Meshes can only be composited with CUDA/GL interop." << std::endl;
+		return;
+	}
+	if (_compositeRenderer)
+		return;
+
+	// Depth buffers shared with CUDA, for the largest image.
+	const size_t pixels = size_t(_resolution.x()) * size_t(_resolution.y());
+	glCreateBuffers(1, &_meshDepthBuffer);
+	glNamedBufferStorage(_meshDepthBuffer, pixels * sizeof(float), nullptr, 0);
+	glCreateBuffers(1, &_gaussianDepthBuffer);
+	glNamedBufferStorage(_gaussianDepthBuffer, pixels * 3 * sizeof(float), nullptr, 0);
+	CUDA_SAFE_CALL_ALWAYS(cudaGraphicsGLRegisterBuffer(&_meshDepthCuda, _meshDepthBuffer, cudaGraphicsRegisterFlagsReadOnly));
+	CUDA_SAFE_CALL_ALWAYS(cudaGraphicsGLRegisterBuffer(&_gaussianDepthCuda, _gaussianDepthBuffer, cudaGraphicsRegisterFlagsWriteDiscard));
+	CUDA_SAFE_CALL_ALWAYS(cudaMalloc((void**)&black_cuda, 3 * sizeof(float)));
+	CUDA_SAFE_CALL_ALWAYS(cudaMemset(black_cuda, 0, 3 * sizeof(float)));
+
+	_texturedMeshRenderer.reset(new sibr::TexturedMeshRenderer());
+	_coloredMeshRenderer.reset(new sibr::ColoredMeshRenderer());
+	_compositeRenderer = new BufferCompositeRenderer();
+	_compositeRenderer->flip() = true;
+	_compositeRenderer->background() = _background;
+}
+
+bool sibr::GaussianView::compositing() const
+{
+	// The split-frame GPUs rasterize their own selection.
+	return _compositing && _compositeMesh && _compositeRenderer && !_splitFrame.enabled();
+}
+
+void sibr::GaussianView::renderCompositeMesh(const sibr::Camera & eye, int width, int height)
+{
+	if (!_meshColorRT || int(_meshColorRT->w()) != width || int(_meshColorRT->h()) != height)
+	{
+		_meshColorRT.reset(new sibr::RenderTargetRGBA(width, height));
+		_meshDepthRenderer.reset(new sibr::DepthRenderer(width, height));
+	}
+
+	_meshColorRT->clear();
+	glViewport(0, 0, width, height);
+	if (_compositeTexture)
+		_texturedMeshRenderer->process(*_compositeMesh, eye, _compositeTexture->handle(), *_meshColorRT, false);
+	else
+		_coloredMeshRenderer->process(*_compositeMesh, eye, *_meshColorRT, sibr::Mesh::FillRenderMode, false);
+	_meshDepthRenderer->render(sibr::InputCamera(eye, width, height), *_compositeMesh);
+	_meshDepthRenderer->_depth_RT->unbind();
+
+	// Copy the depths on the GPU, rows are tightly packed.
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, _meshDepthBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glGetTextureImage(_meshDepthRenderer->_depth_RT->texture(), 0, GL_RED, GL_FLOAT, GLsizei(sizeof(float) * width * height), nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void sibr::GaussianView::opacitiesEdited()
+{
+	// Crop selections hold their own copy of the opacities; LOD interior nodes are not updated.
+	_crop.clear();
+	_splitFrame.updateOpacities(opacity_cuda);
+	_edits++;
+}
+
+bool sibr::GaussianView::setQualityLevel(float level)
+{
+	_lodQualityScale = 1.0f / std::max(level, 0.125f);
+	return _useLOD;
 }
 
 void sibr::GaussianView::onGUI()
@@ -562,7 +1687,7 @@ void sibr::GaussianView::onGUI()
 				currMode = "Splats";
 			if (ImGui::Selectable("Initial Points"))
 				currMode = "Initial Points";
-			if (ImGui::Selectable("Ellipsoids"))
+			if (gData && ImGui::Selectable("Ellipsoids"))
 				currMode = "Ellipsoids";
 			ImGui::EndCombo();
 		}
@@ -570,12 +1695,136 @@ void sibr::GaussianView::onGUI()
 	if (currMode == "Splats")
 	{
 		ImGui::SliderFloat("Scaling Modifier", &_scalingModifier, 0.001f, 1.0f);
+		ImGui::SliderInt("SH Degree", &_render_sh_degree, 0, _sh_degree);
+		ImGui::Checkbox("Render on demand", &_renderOnDemand);
+		ImGui::SameLine();
+		ImGui::Checkbox("Progressive", &_progressive);
+		if (_output.attached())
+		{
+			ImGui::SameLine();
+			ImGui::Checkbox("Direct output", &_directOutput);
+		}
+		if (_progressive)
+			ImGui::SliderInt("Motion downscale", &_motionScale, 1, 8);
+		ImGui::Text("SH storage: %.1f MB", shs_buffer.gpuBytes() / (1024.0f * 1024.0f));
+		const float MB = 1024.0f * 1024.0f;
+		ImGui::Text("Geometry buffer: %.1f MB (peak %.1f, allocated %.1f)", _scratch.current(GaussianScratch::GEOMETRY) / MB,
+			_scratch.peak(GaussianScratch::GEOMETRY) / MB, _scratch.allocated(GaussianScratch::GEOMETRY) / MB);
+		ImGui::Text("Binning buffer: %.1f MB (peak %.1f, allocated %.1f)", _scratch.current(GaussianScratch::BINNING) / MB,
+			_scratch.peak(GaussianScratch::BINNING) / MB, _scratch.allocated(GaussianScratch::BINNING) / MB);
+		ImGui::Text("Image buffer: %.1f MB (peak %.1f, allocated %.1f)", _scratch.current(GaussianScratch::IMAGE) / MB,
+			_scratch.peak(GaussianScratch::IMAGE) / MB, _scratch.allocated(GaussianScratch::IMAGE) / MB);
+		if (_streamer.enabled())
+		{
+			ImGui::Text("Resident chunks: %d / %d (%d loading)", _streamer.resident(), _streamer.chunks(), _streamer.loading());
+		}
+		if (_splitFrame.enabled())
+		{
+			for (int d = 0; d < _splitFrame.devices(); d++)
+			{
+				ImGui::Text("GPU %d: %d rows, %d Gaussians, %.2f ms", _splitFrame.device(d), _splitFrame.rows(d),
+					_splitFrame.active(d), _splitFrame.time(d));
+			}
+		}
+		if (!_models.empty())
+		{
+			// The main model is index 0, the blended model is offset by one to make room for "None".
+			const auto modelName = [this](int m) { return m == 0 ? _modelName.c_str() : _models[m - 1]->name().c_str(); };
+			if (ImGui::BeginCombo("Model", modelName(_activeModel)))
+			{
+				for (int m = 0; m <= int(_models.size()); m++)
+				{
+					if (ImGui::Selectable(modelName(m), m == _activeModel))
+					{
+						_activeModel = m;
+						if (_blendModel == _activeModel)
+							_blendModel = -1;
+					}
+				}
+				ImGui::EndCombo();
+			}
+			if (ImGui::BeginCombo("Blend with", _blendModel < 0 ? "None" : modelName(_blendModel)))
+			{
+				if (ImGui::Selectable("None", _blendModel < 0))
+					_blendModel = -1;
+				for (int m = 0; m <= int(_models.size()); m++)
+				{
+					if (m != _activeModel && ImGui::Selectable(modelName(m), m == _blendModel))
+						_blendModel = m;
+				}
+				ImGui::EndCombo();
+			}
+			if (_blendModel >= 0)
+				ImGui::SliderFloat("Blend", &_blend, 0.0f, 1.0f);
+			ImGui::Text("Tab: next model");
+		}
+		if (_lod.built())
+		{
+			ImGui::Checkbox("LOD", &_useLOD);
+			if (_useLOD)
+			{
+				ImGui::SliderFloat("LOD error (px)", &_lodThreshold, 0.1f, 32.0f);
+				ImGui::Text("Active Gaussians: %d / %d", _lod.active(), count);
+			}
+		}
+		if (!_streamer.enabled() && ImGui::CollapsingHeader("Selection"))
+		{
+			ImGui::Text("Selected: %d Gaussians", _query.selected());
+			ImGui::Text("Ctrl+click: pick, Ctrl+drag: lasso (Shift: add, Alt: remove)");
+			if (ImGui::Button("Select crop box"))
+			{
+				mapShared(true);
+				_query.selectBox(count, pos_cuda, _boxmin.data(), _boxmax.data(), GaussianQuery::REPLACE);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Clear selection"))
+				_query.clear();
+			if (_query.selected() > 0 && ImGui::Button("Delete selected"))
+			{
+				mapShared(true);
+				_query.mask(count, opacity_cuda, 0.0f);
+				opacitiesEdited();
+			}
+			if (_query.masked())
+			{
+				ImGui::SameLine();
+				if (ImGui::Button("Restore deleted"))
+				{
+					mapShared(true);
+					_query.restore(count, opacity_cuda);
+					opacitiesEdited();
+				}
+			}
+		}
+		if (ImGui::CollapsingHeader("GPU timings"))
+		{
+			float total = 0.0f;
+			for (int s = 0; s < GaussianProfiler::STAGE_COUNT; s++)
+			{
+				const float ms = _profiler.average(GaussianProfiler::Stage(s));
+				ImGui::Text("%s: %.3f ms", GaussianProfiler::name(GaussianProfiler::Stage(s)), ms);
+				total += ms;
+			}
+			ImGui::Text("Total: %.3f ms (average over %d frames)", total, GaussianProfiler::history);
+			ImGui::InputText("CSV", _timingsPath, 512);
+			if (ImGui::Button("Export timings"))
+				_profiler.exportCSV(_timingsPath);
+		}
 	}
 	ImGui::Checkbox("Fast culling", &_fastCulling);
+	if (_compositeRenderer && _compositeMesh)
+	{
+		ImGui::Checkbox("Composite mesh", &_compositing);
+		if (compositing())
+			ImGui::Text("Gaussians in front of the mesh: %d", _occlusion.active());
+	}
 
-	ImGui::Checkbox("Crop Box", &_cropping);
+	if (ImGui::Checkbox("Crop Box", &_cropping) && !_cropping)
+		_crop.clear();
 	if (_cropping)
 	{
+		if (!_useLOD && !_streamer.enabled())
+			ImGui::Text("Cropped Gaussians: %d / %d", _crop.active(), count);
 		ImGui::SliderFloat("Box Min X", &_boxmin.x(), _scenemin.x(), _scenemax.x());
 		ImGui::SliderFloat("Box Min Y", &_boxmin.y(), _scenemin.y(), _scenemax.y());
 		ImGui::SliderFloat("Box Min Z", &_boxmin.z(), _scenemin.z(), _scenemax.z());
@@ -588,14 +1837,35 @@ void sibr::GaussianView::onGUI()
 			std::vector<Pos> pos(count);
 			std::vector<Rot> rot(count);
 			std::vector<float> opacity(count);
-			std::vector<SHs<3>> shs(count);
+			std::vector<float> shs(size_t(count) * _sh_coeffs * 3);
 			std::vector<Scale> scale(count);
-			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(pos.data(), pos_cuda, sizeof(Pos) * count, cudaMemcpyDeviceToHost));
-			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(rot.data(), rot_cuda, sizeof(Rot) * count, cudaMemcpyDeviceToHost));
-			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity.data(), opacity_cuda, sizeof(float) * count, cudaMemcpyDeviceToHost));
-			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(shs.data(), shs_cuda, sizeof(SHs<3>) * count, cudaMemcpyDeviceToHost));
-			CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(scale.data(), scale_cuda, sizeof(Scale) * count, cudaMemcpyDeviceToHost));
-			savePly(_buff, pos, shs, opacity, scale, rot, _boxmin, _boxmax);
+			if (_streamer.enabled())
+			{
+				// Only a part of the model is on the GPU, export from the mapped cache.
+				const GaussianCache & source = _streamer.source();
+				std::memcpy(pos.data(), source.data(GaussianCache::POSITION), sizeof(Pos) * count);
+				std::memcpy(rot.data(), source.data(GaussianCache::ROTATION), sizeof(Rot) * count);
+				std::memcpy(opacity.data(), source.data(GaussianCache::OPACITY), sizeof(float) * count);
+				std::memcpy(shs.data(), source.data(GaussianCache::SH), sizeof(float) * shs.size());
+				std::memcpy(scale.data(), source.data(GaussianCache::SCALE), sizeof(Scale) * count);
+			}
+			else
+			{
+				mapShared(true);
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(pos.data(), pos_cuda, sizeof(Pos) * count, cudaMemcpyDeviceToHost));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(rot.data(), rot_cuda, sizeof(Rot) * count, cudaMemcpyDeviceToHost));
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(opacity.data(), opacity_cuda, sizeof(float) * count, cudaMemcpyDeviceToHost));
+				shs_buffer.download(shs.data());
+				CUDA_SAFE_CALL_ALWAYS(cudaMemcpy(scale.data(), scale_cuda, sizeof(Scale) * count, cudaMemcpyDeviceToHost));
+			}
+			if (_sh_degree == 0)
+				savePly<0>(_buff, pos, shs, opacity, scale, rot, _boxmin, _boxmax);
+			else if (_sh_degree == 1)
+				savePly<1>(_buff, pos, shs, opacity, scale, rot, _boxmin, _boxmax);
+			else if (_sh_degree == 2)
+				savePly<2>(_buff, pos, shs, opacity, scale, rot, _boxmin, _boxmax);
+			else
+				savePly<3>(_buff, pos, shs, opacity, scale, rot, _boxmin, _boxmax);
 		}
 	}
 
@@ -631,16 +1901,34 @@ void sibr::GaussianView::onGUI()
 
 sibr::GaussianView::~GaussianView()
 {
+	watchModel(false);
+	sibr::GPUMemoryBudget::global().remove(_budgetId);
+	sibr::GPUMemoryBudget::global().query({});
+
+	// Wait for the chunk uploads still writing to the buffers
+	cudaDeviceSynchronize();
+
 	// Cleanup
-	cudaFree(pos_cuda);
-	cudaFree(rot_cuda);
-	cudaFree(scale_cuda);
-	cudaFree(opacity_cuda);
-	cudaFree(shs_cuda);
+	if (_sharedCount > 0)
+	{
+		mapShared(false);
+		for (int i = 0; i < _sharedCount; i++)
+			cudaGraphicsUnregisterResource(_sharedCuda[i]);
+	}
+	else
+	{
+		cudaFree(pos_cuda);
+		cudaFree(rot_cuda);
+		cudaFree(scale_cuda);
+		cudaFree(opacity_cuda);
+	}
+	cudaFree(colors_cuda);
+	cudaFree(blend_cuda);
 
 	cudaFree(view_cuda);
-	cudaFree(proj_cuda);
-	cudaFree(cam_pos_cuda);
+	cudaFreeHost(frame_params_host);
+	for (int i = 0; i < kParamSlots; i++)
+		cudaEventDestroy(frame_params_uploaded[i]);
 	cudaFree(background_cuda);
 	cudaFree(rect_cuda);
 
@@ -648,18 +1936,23 @@ sibr::GaussianView::~GaussianView()
 	{
 		cudaGraphicsUnregisterResource(imageBufferCuda);
 	}
-	else
+	glDeleteBuffers(1, &imageBuffer);
+	_output.release();
+	if (_outputFramebuffer)
+		glDeleteFramebuffers(1, &_outputFramebuffer);
+	if (_outputTexture)
+		glDeleteTextures(1, &_outputTexture);
+	if (_compositeRenderer)
 	{
-		cudaFree(fallbackBufferCuda);
+		cudaGraphicsUnregisterResource(_meshDepthCuda);
+		cudaGraphicsUnregisterResource(_gaussianDepthCuda);
+		glDeleteBuffers(1, &_meshDepthBuffer);
+		glDeleteBuffers(1, &_gaussianDepthBuffer);
+		cudaFree(black_cuda);
 	}
-	glDeleteBuffers(1, &imageBuffer);
+	_occlusion.clear();
 
-	if (geomPtr)
-		cudaFree(geomPtr);
-	if (binningPtr)
-		cudaFree(binningPtr);
-	if (imgPtr)
-		cudaFree(imgPtr);
 
 	delete _copyRenderer;
+	delete _compositeRenderer;
 }
@@ -19,12 +19,29 @@
 # include <core/view/ViewBase.hpp>
 # include <core/renderer/CopyRenderer.hpp>
 # include <core/renderer/PointBasedRenderer.hpp>
+# include <core/renderer/TexturedMeshRenderer.hpp>
+# include <core/renderer/ColoredMeshRenderer.hpp>
+# include <core/renderer/DepthRenderer.hpp>
 # include <memory>
 # include <core/graphics/Texture.hpp>
+# include <core/graphics/MemoryTracker.hpp>
 #include <cuda_runtime.h>
 #include <cuda_gl_interop.h>
 #include <functional>
 # include "GaussianSurfaceRenderer.hpp"
+# include "GaussianCache.hpp"
+# include "GaussianSHBuffer.hpp"
+# include "GaussianLOD.hpp"
+# include "GaussianCrop.hpp"
+# include "GaussianStreamer.hpp"
+# include "GaussianReadback.hpp"
+# include "GaussianDirectOutput.hpp"
+# include "GaussianScratch.hpp"
+# include "GaussianProfiler.hpp"
+# include "GaussianSplitFrame.hpp"
+# include "GaussianModel.hpp"
+# include "GaussianQuery.hpp"
+# include "GaussianOcclusion.hpp"
 
 namespace CudaRasterizer
 {
@@ -35,6 +52,7 @@ namespace sibr {
 
 	class BufferCopyRenderer;
 	class BufferCopyRenderer2;
+	class BufferCompositeRenderer;
 
 	/**
 	 * \class RemotePointView
@@ -51,8 +69,20 @@ namespace sibr {
 		 * \param ibrScene The scene to use for rendering.
 		 * \param render_w rendering width
 		 * \param render_h rendering height
+		 * \param useCache read and write the preprocessed model cache next to the PLY file
+		 * \param shStorage GPU storage of the SH coefficients
+		 * \param codebookSize number of codewords for quantized SH storage
+		 * \param buildLOD build a level-of-detail hierarchy over the model
+		 * \param vramBudget GPU memory budget for the Gaussians in MB, larger models are streamed (0 for no limit)
+		 * \param fallbackRGBA8 transfer 8-bit RGBA images when interop is unavailable
+		 * \param splitFrame number of GPUs rendering bands of each frame, starting at device
+		 * \param pruneOpacity Gaussians less opaque than this are dropped at load time
+		 * \param pruneBudget maximum number of Gaussians kept at load time, ranked by contribution to the input cameras (0 for no limit)
+		 * \param models PLY files of other models of the scene, with the same SH degree, to toggle or blend with
 		 */
-		GaussianView(const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, uint render_h, const char* file, bool* message_read, int sh_degree, bool white_bg = false, bool useInterop = true, int device = 0);
+		GaussianView(const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, uint render_h, const char* file, bool* message_read, int sh_degree, bool white_bg = false, bool useInterop = true, int device = 0, bool useCache = true,
+			GaussianSHBuffer::Storage shStorage = GaussianSHBuffer::FLOAT_STORAGE, int codebookSize = 4096, bool buildLOD = false, int vramBudget = 0, bool fallbackRGBA8 = false, int splitFrame = 1, float pruneOpacity = 0.0f, int pruneBudget = 0,
+			const std::vector<std::string> & models = {});
 
 		/** Replace the current scene.
 		 *\param newScene the new scene to render */
@@ -66,16 +96,78 @@ namespace sibr {
 		void onRenderIBR(sibr::IRenderTarget& dst, const sibr::Camera& eye) override;
 
 		/**
-		 * Update inputs (do nothing).
+		 * Render a region of the image of a viewpoint, for insets and for images larger than the rendering
+		 * resolution, rendered tile by tile. Only the region is rasterized, with the projection and the footprint
+		 * of the Gaussians of the whole image. The other modes and mesh compositing render the whole image.
+		 * \param dst The destination rendertarget, the region is displayed in the whole target.
+		 * \param eye The novel viewpoint.
+		 * \param imageSize The size of the whole image.
+		 * \param origin The top left corner of the region in the image, rows from the top.
+		 * \param size The size of the region, at most the rendering resolution.
+		 */
+		void onRenderIBR(sibr::IRenderTarget& dst, const sibr::Camera& eye, const sibr::Vector2i& imageSize, const sibr::Vector2i& origin, const sibr::Vector2i& size);
+
+		/**
+		 * Render an image of any size tile by tile, each tile at most the rendering resolution.
+		 * \param eye The viewpoint.
+		 * \param imageSize The size of the image.
+		 * \param image Will contain the image.
+		 */
+		void renderTiled(const sibr::Camera& eye, const sibr::Vector2i& imageSize, sibr::ImageRGB& image);
+
+		/**
+		 * Render a stereo pair, sharing the selection and color evaluation of the Gaussians between eyes.
+		 * \param left The left eye rendertarget.
+		 * \param right The right eye rendertarget.
+		 * \param leftEye The left eye viewpoint.
+		 * \param rightEye The right eye viewpoint.
+		 */
+		void onRenderIBRStereo(sibr::IRenderTarget& left, sibr::IRenderTarget& right, const sibr::Camera& leftEye, const sibr::Camera& rightEye) override;
+
+		/**
+		 * Update inputs: Tab cycles through the models.
 		 * \param input The inputs state.
 		 */
 		void onUpdate(Input& input) override;
 
+		/**
+		 * Update inputs, and select Gaussians in the viewport: Ctrl+click picks one, Ctrl+drag draws a lasso.
+		 * Shift adds to the selection and Alt removes from it.
+		 * \param input The inputs state, relative to the viewport.
+		 * \param vp The viewport of the view.
+		 */
+		void onUpdate(Input& input, const Viewport& vp) override;
+
 		/**
 		 * Update the GUI.
 		 */
 		void onGUI() override;
 
+		/**
+		 * Raise the LOD error threshold when the quality is lowered, up to 8 times.
+		 * \param level The quality level, 1 uses the threshold set in the GUI.
+		 * \return true if the LOD cut is used
+		 */
+		bool setQualityLevel(float level) override;
+
+		/** Reload the main model from its file, keeping the view settings. Only models with the same number of
+		 * Gaussians are reloaded, and not when streamed, pruned, split between GPUs or with a level-of-detail hierarchy.
+		 * \return false if the model was not reloaded
+		 */
+		bool reloadModel();
+
+		/** Reload the main model when its file is modified, see sibr::FileWatcher.
+		 * \param enable start or stop watching
+		 */
+		void watchModel(bool enable);
+
+		/** Render an opaque mesh inside the Gaussians, composited with depth. The Gaussians hidden by the mesh
+		 * are culled before rasterization. Only with interop, in the Splats mode and for a single view.
+		 * \param mesh the mesh, with vertex colors if there is no texture, nullptr to stop compositing
+		 * \param texture optional texture of the mesh
+		 */
+		void compositeMesh(const sibr::Mesh::Ptr & mesh, const sibr::Texture2DRGB::Ptr & texture = nullptr);
+
 		/** \return a reference to the scene */
 		const std::shared_ptr<sibr::BasicIBRScene> & getScene() const { return _scene; }
 
@@ -85,48 +177,229 @@ namespace sibr {
 
 	protected:
 
+		/// Inputs that change the rasterized image.
+		struct FrameState
+		{
+			sibr::Matrix4f viewproj = sibr::Matrix4f::Zero();
+			sibr::Vector3f position = sibr::Vector3f::Zero();
+			float scaling = -1.0f;
+			int shDegree = -1;
+			bool cropping = false;
+			sibr::Vector3f boxmin = sibr::Vector3f::Zero(), boxmax = sibr::Vector3f::Zero();
+			bool lod = false;
+			float lodThreshold = -1.0f;
+			int resident = -1;
+			int model = -1, blendModel = -1;
+			float blend = -1.0f;
+			int edits = -1;
+			bool composite = false;
+			sibr::Vector4i region = sibr::Vector4i::Zero(); ///< Rasterized region, zero for the whole image.
+			sibr::Vector2i regionImage = sibr::Vector2i::Zero();
+
+			bool operator==(const FrameState & other) const;
+		};
+
+		/// Region of the image rasterized instead of the whole image, see onRenderIBR.
+		struct Region
+		{
+			bool active = false;
+			sibr::Vector2i image = sibr::Vector2i::Zero(); ///< Size of the whole image.
+			sibr::Vector2i origin = sibr::Vector2i::Zero(); ///< Top left corner, rows from the top.
+			sibr::Vector2i size = sibr::Vector2i::Zero(); ///< Size of the region.
+		};
+
+		/** Fill the view, projection and position of a viewpoint, in the conventions of the rasterizer and for the current region.
+		 * \param eye the viewpoint
+		 * \param params will contain the parameters, GaussianSplitFrame::paramsCount floats
+		 */
+		void frameParams(const sibr::Camera & eye, float * params) const;
+
+		/** \return the tangents of the half field of view of the rasterized image, horizontal then vertical.
+		 * \param eye the viewpoint
+		 */
+		sibr::Vector2f tanFov(const sibr::Camera & eye) const;
+
+		/** \return the current inputs of the image.
+		 * \param eye the viewpoint
+		 */
+		FrameState frameState(const sibr::Camera & eye) const;
+
+		/// Gaussians given to the rasterizer, as device pointers.
+		struct Splats
+		{
+			int P;
+			const float* means;
+			const float* shs; ///< nullptr when colors are precomputed.
+			const float* colors;
+			const float* opacities;
+			const float* scales;
+			const float* rotations;
+		};
+
+		/** Upload the view, projection and position of a viewpoint to the device parameters block.
+		 * \param eye the viewpoint
+		 */
+		void uploadFrameParams(const sibr::Camera & eye);
+
+		/** Select the Gaussians to rasterize (LOD cut, crop box) and evaluate their colors if needed.
+		 * Colors are evaluated for the position uploaded last.
+		 * \param eye the viewpoint
+		 * \param P number of Gaussians in the view buffers
+		 * \param height the image height, for the LOD screen-space error
+		 * \param precomputeColors evaluate the colors even for float SH storage
+		 * \param model 0 for the main model, k for the k-th of _models, which are rasterized whole
+		 * \return the rasterizer inputs
+		 */
+		Splats selectSplats(const sibr::Camera & eye, int P, int height, bool precomputeColors, int model);
+
+		/** Rasterize selected Gaussians with the parameters uploaded last.
+		 * \param eye the viewpoint
+		 * \param splats the rasterizer inputs
+		 * \param image_cuda the device planar float RGB destination
+		 * \param width the image width
+		 * \param height the image height
+		 * \param background the device background color, nullptr for the view background
+		 */
+		void forward(const sibr::Camera & eye, const Splats & splats, float * image_cuda, int width, int height, const float * background = nullptr);
+
+		/** Rasterize the Gaussians from a viewpoint.
+		 * \param eye the viewpoint
+		 * \param image_cuda the device planar float RGB destination
+		 * \param width the image width
+		 * \param height the image height
+		 */
+		void rasterize(const sibr::Camera & eye, float * image_cuda, int width, int height);
+
+		/** Rasterize a few input views to size the scratch buffers before the first frame. */
+		void warmUp();
+
+		/** Propagate an edit of the main model opacities to the copies made from them. */
+		void opacitiesEdited();
+
+		/** Map or unmap the model GL buffers shared with CUDA. Mapping updates the device pointers.
+		 * \param map true to map the buffers for CUDA, false to give them back to GL
+		 */
+		void mapShared(bool map);
+
+		/** \return true if the composited mesh is rendered this frame. */
+		bool compositing() const;
+
+		/** Render the color and depth of the composited mesh, and copy the depth to the buffer shared with CUDA.
+		 * \param eye the viewpoint
+		 * \param width the image width
+		 * \param height the image height
+		 */
+		void renderCompositeMesh(const sibr::Camera & eye, int width, int height);
+
+
 		std::string currMode = "Splats";
 
 		bool _cropping = false;
+		GaussianCrop _crop; ///< Gaussians inside the crop box, rasterized instead of the whole model.
 		sibr::Vector3f _boxmin, _boxmax, _scenemin, _scenemax;
 		char _buff[512] = "cropped.ply";
 
 		bool _fastCulling = true;
 		int _device = 0;
-		int _sh_degree = 3;
+		int _sh_degree = 3; ///< Degree of the loaded model.
+		int _render_sh_degree = 3; ///< Degree used for rendering, at most _sh_degree.
+		int _sh_coeffs = 16; ///< Stored SH coefficients per Gaussian.
 
 		int count;
 		float* pos_cuda;
 		float* rot_cuda;
 		float* scale_cuda;
 		float* opacity_cuda;
-		float* shs_cuda;
+		GaussianSHBuffer shs_buffer;
+		float* colors_cuda = nullptr;
+		int _maxCount = 0; ///< Gaussians in the largest model, sizes the buffers shared by the models.
+		std::string _modelName; ///< Display name of the main model.
+		bool _useCache = true; ///< Read and write the preprocessed model caches.
+		bool _pruned = false; ///< The main model was pruned at load time.
+		uint64_t _modelWatch = 0; ///< Watch of the main model file, 0 if none.
+		uint64_t _budgetId = 0; ///< Registration of the LOD hierarchy in the sibr::GPUMemoryBudget.
+		std::vector<std::unique_ptr<GaussianModel>> _models; ///< Other models, sharing the scratch, parameters and images.
+		int _activeModel = 0; ///< Rendered model, 0 for the main one, k for _models[k - 1].
+		int _blendModel = -1; ///< Model blended over the rendered one, -1 for none.
+		float _blend = 0.5f; ///< Weight of the blended model.
+		float* blend_cuda = nullptr; ///< Image of the blended model.
+		GaussianQuery _query; ///< Selection of Gaussians of the main model.
+		std::vector<float> _lasso; ///< Lasso being drawn, in normalized device coordinates.
+		int _edits = 0; ///< Number of edits of the main model opacities.
+		GaussianLOD _lod; ///< Level-of-detail hierarchy, empty if not requested.
+		bool _useLOD = false; ///< Render the level-of-detail cut instead of all leaves.
+		float _lodThreshold = 1.0f; ///< Maximum screen-space error of the cut, in pixels.
+		float _lodQualityScale = 1.0f; ///< Factor applied to the threshold by the adaptive quality.
+		GaussianStreamer _streamer; ///< Chunk residency when the model exceeds the GPU memory budget.
+		GaussianSplitFrame _splitFrame; ///< Bands of the frame rendered by other GPUs.
 		int* rect_cuda;
 
 		GLuint imageBuffer;
 		cudaGraphicsResource_t imageBufferCuda;
 
-		size_t allocdGeom = 0, allocdBinning = 0, allocdImg = 0;
-		void* geomPtr = nullptr, * binningPtr = nullptr, * imgPtr = nullptr;
+		sibr::Mesh::Ptr _compositeMesh; ///< Opaque mesh composited with the Gaussians, nullptr for none.
+		sibr::Texture2DRGB::Ptr _compositeTexture; ///< Texture of the composited mesh, nullptr for vertex colors.
+		bool _compositing = false; ///< Render the composited mesh.
+		GaussianOcclusion _occlusion; ///< Gaussians not hidden by the composited mesh.
+		std::unique_ptr<sibr::TexturedMeshRenderer> _texturedMeshRenderer;
+		std::unique_ptr<sibr::ColoredMeshRenderer> _coloredMeshRenderer;
+		sibr::DepthRenderer::Ptr _meshDepthRenderer; ///< Depth of the composited mesh.
+		sibr::RenderTargetRGBA::Ptr _meshColorRT; ///< Color of the composited mesh.
+		GLuint _meshDepthBuffer = 0; ///< Depth of the composited mesh, read by CUDA.
+		cudaGraphicsResource_t _meshDepthCuda = nullptr;
+		GLuint _gaussianDepthBuffer = 0; ///< Planar depth weighted by alpha and alpha of the Gaussians.
+		cudaGraphicsResource_t _gaussianDepthCuda = nullptr;
+		float* _gaussianDepth_cuda = nullptr; ///< Mapped _gaussianDepthBuffer while compositing, nullptr otherwise.
+		float* black_cuda = nullptr; ///< Black background of the depth pass.
+
+		GaussianScratch _scratch; ///< Rasterizer scratch buffers.
+		sibr::TrackedMemory _modelMemory = sibr::TrackedMemory(sibr::MemoryTracker::CUDA); ///< Device memory of the models and per-Gaussian buffers.
+		sibr::TrackedMemory _scratchMemory = sibr::TrackedMemory(sibr::MemoryTracker::CUDA); ///< Device memory of the rasterizer scratch buffers.
+		GaussianProfiler _profiler; ///< GPU timings of the frame stages.
+		char _timingsPath[512] = "timings.csv"; ///< Destination of the exported timings.
 		std::function<char* (size_t N)> geomBufferFunc, binningBufferFunc, imgBufferFunc;
 
 		float* view_cuda;
 		float* proj_cuda;
 		float* cam_pos_cuda;
+		static const int kParamSlots = 6; ///< Slots of frame_params_host, a stereo frame uploads three times.
+		float* frame_params_host = nullptr; ///< Pinned view, projection and position, one block per slot.
+		cudaEvent_t frame_params_uploaded[kParamSlots] = {}; ///< Upload of each slot of frame_params_host.
+		int _frameSlot = 0; ///< Slot of frame_params_host used for the next upload.
 		float* background_cuda;
+		sibr::Vector3f _background = sibr::Vector3f::Zero(); ///< Background color, in background_cuda.
 
 		float _scalingModifier = 1.0f;
-		GaussianData* gData;
+		GaussianData* gData = nullptr;
+		cudaGraphicsResource_t _sharedCuda[5] = {}; ///< Model GL buffers registered with CUDA: positions, rotations, scales, opacities and SHs.
+		int _sharedCount = 0; ///< Number of registered buffers, 0 if CUDA has its own copy of the model.
+		bool _sharedMapped = false; ///< The registered buffers are mapped for CUDA.
 
 		bool _interop_failed = false;
-		std::vector<char> fallback_bytes;
-		float* fallbackBufferCuda = nullptr;
+		GaussianReadback _readback; ///< Image transfers when interop is unavailable.
+		GaussianDirectOutput _output; ///< Writes the rasterized images to _outputTexture.
+		GLuint _outputTexture = 0; ///< 8-bit RGBA image, blitted to the destination instead of the copy pass.
+		GLuint _outputFramebuffer = 0; ///< Framebuffer of _outputTexture, blit source.
+		sibr::TrackedMemory _outputMemory = sibr::TrackedMemory(sibr::MemoryTracker::TEXTURE); ///< GPU memory of _outputTexture.
+		bool _directOutput = true; ///< Display _outputTexture when it is up to date.
+		bool _outputValid = false; ///< _outputTexture holds the last rasterized image.
+		FrameState _lastState; ///< Inputs of the last rasterized image.
+		bool _renderOnDemand = true; ///< Only rasterize when the image inputs change.
+		bool _progressive = false; ///< Rasterize at a reduced resolution while the camera moves.
+		int _motionScale = 2; ///< Resolution divider during motion.
+		int _lastScale = 1; ///< Resolution divider of the last rasterized image.
+		Region _region; ///< Region rasterized by the current frame.
+		sibr::Vector2i _imageSize = sibr::Vector2i::Zero(); ///< Resolution of the image in imageBuffer.
+		sibr::Vector2i _queuedSize = sibr::Vector2i::Zero(); ///< Resolution of the last queued readback.
+		bool _queuedShown = true; ///< The last queued readback has been displayed.
 		bool accepted = false;
 
 
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< The current scene.
 		PointBasedRenderer::Ptr _pointbasedrenderer;
+		PointOctree::Ptr _initialPoints; ///< Hierarchy of the initial points, built on first display.
 		BufferCopyRenderer* _copyRenderer;
+		BufferCompositeRenderer* _compositeRenderer = nullptr;
 		GaussianSurfaceRenderer* _gaussianRenderer;
 	};
 
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 450
+
+layout(location = 0) out vec4 out_color;
+
+// Planar RGB of the Gaussians, blended over the background.
+layout(std430, binding = 0) buffer colorLayout
+{
+    float data[];
+} source;
+
+// Planar depth weighted by alpha, alpha and an unused channel, blended over black.
+layout(std430, binding = 1) buffer depthLayout
+{
+    float data[];
+} depthSource;
+
+layout(binding = 0) uniform sampler2D meshColor;
+layout(binding = 1) uniform sampler2D meshDepth; // Normalized device depth in [-1,1], 1 where there is no mesh.
+
+uniform bool flip = false;
+uniform int width = 1000;
+uniform int height = 800;
+uniform vec3 background = vec3(0.0);
+uniform float znear = 0.01;
+uniform float zfar = 1000.0;
+
+in vec4 texcoord;
+
+void main(void)
+{
+	int x = int(texcoord.x * width);
+	int y;
+
+	if(flip)
+		y = height - 1 - int(texcoord.y * height);
+	else
+		y = int(texcoord.y * height);
+
+	int pixel = y * width + x;
+	int plane = width * height;
+	vec3 gaussians = vec3(source.data[pixel], source.data[plane + pixel], source.data[2 * plane + pixel]);
+
+	float ndc = texture(meshDepth, texcoord.xy).r;
+	if(ndc >= 1.0)
+	{
+		out_color = vec4(gaussians, 1.0);
+		return;
+	}
+
+	// The Gaussians hidden by the mesh have been culled, those in front are blended over it.
+	float alpha = clamp(depthSource.data[plane + pixel], 0.0, 1.0);
+	float depth = alpha > 0.0 ? depthSource.data[pixel] / alpha : zfar;
+	float meshZ = 2.0 * znear * zfar / ((zfar + znear) - ndc * (zfar - znear));
+	vec3 mesh = texture(meshColor, texcoord.xy).rgb;
+	vec3 front = gaussians - (1.0 - alpha) * background;
+	out_color = vec4(depth <= meshZ ? front + (1.0 - alpha) * mesh : mesh, 1.0);
+}
@@ -19,9 +19,15 @@ layout(std430, binding = 0) buffer colorLayout
     float data[];
 } source;
 
+layout(std430, binding = 1) buffer packedLayout
+{
+    uint data[];
+} packedSource;
+
 uniform bool flip = false;
 uniform int width = 1000;
 uniform int height = 800;
+uniform bool packed = false;
 
 in vec4 texcoord;
 
@@ -35,6 +41,12 @@ void main(void)
 	else
 		y = int(texcoord.y * height);
 	
+	if(packed)
+	{
+		out_color = vec4(unpackUnorm4x8(packedSource.data[y * width + x]).rgb, 1);
+		return;
+	}
+
 	float r = source.data[0 * width * height + (y * width + x)];
 	float g = source.data[1 * width * height + (y * width + x)];
 	float b = source.data[2 * width * height + (y * width + x)];
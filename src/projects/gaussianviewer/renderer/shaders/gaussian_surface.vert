@@ -15,6 +15,8 @@
 uniform mat4 MVP;
 uniform float alpha_limit;
 uniform int stage;
+uniform int color_stride;
+uniform int list_offset;
 
 layout (std430, binding = 0) buffer BoxCenters {
     float centers[];
@@ -31,6 +33,9 @@ layout (std430, binding = 3) buffer Alphas {
 layout (std430, binding = 4) buffer Colors {
     float colors[];
 };
+layout (std430, binding = 5) buffer Visible {
+    uint visible[];
+};
 
 mat3 quatToMat3(vec4 q) {
   float qx = q.y;
@@ -84,7 +89,8 @@ out float alphaVert;
 out flat int boxID;
 
 void main() {
-	boxID = gl_InstanceID;
+	// Instances are the Gaussians kept by the culling pass for this stage.
+	boxID = int(visible[list_offset + gl_InstanceID]);
     ellipsoidCenter = vec3(centers[3 * boxID + 0], centers[3 * boxID + 1], centers[3 * boxID + 2]);
     float a = alphas[boxID];
 	alphaVert = a;
@@ -98,14 +104,11 @@ void main() {
     worldPos = ellipsoidRotation * (ellipsoidScale * boxVertices[vertexIndex]);
     worldPos += ellipsoidCenter;
 
-	float r = colors[boxID * 48 + 0] * 0.2 + 0.5;
-	float g = colors[boxID * 48 + 1] * 0.2 + 0.5;
-	float b = colors[boxID * 48 + 2] * 0.2 + 0.5;
+	float r = colors[boxID * color_stride + 0] * 0.2 + 0.5;
+	float g = colors[boxID * color_stride + 1] * 0.2 + 0.5;
+	float b = colors[boxID * color_stride + 2] * 0.2 + 0.5;
 
 	colorVert = vec3(r, g, b);
 	
-	if((stage == 0 && a < alpha_limit) || (stage == 1 && a >= alpha_limit))
-	 	gl_Position = vec4(0,0,0,0);
-	else
-    	gl_Position = MVP * vec4(worldPos, 1);
+	gl_Position = MVP * vec4(worldPos, 1);
 }
\ No newline at end of file
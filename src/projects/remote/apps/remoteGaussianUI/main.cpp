@@ -23,18 +23,24 @@
 #define PROGRAM_NAME "SIBR Remote Gaussian Viewer"
 using namespace sibr;
 
+std::string pointViewName(size_t i)
+{
+	return i == 0 ? "Point view" : "Point view " + std::to_string(i + 1);
+}
+
 void resetScene(RemoteAppArgs myArgs,
 	int rendering_width,
 	int rendering_height,
 	BasicIBRScene::Ptr& scene,
-	RemotePointView::Ptr&	pointBasedView,
+	const std::vector<RemotePointView::Ptr>& pointBasedViews,
 	std::shared_ptr<sibr::SceneDebugView>& topView,
 	MultiViewManager& multiViewManager
 	)
 {
 	if (multiViewManager.numSubViews() > 0)
 	{
-		multiViewManager.removeSubView("Point view");
+		for (size_t i = 0; i < pointBasedViews.size(); i++)
+			multiViewManager.removeSubView(pointViewName(i));
 		multiViewManager.removeSubView("Top view");
 	}
 
@@ -84,13 +90,14 @@ void resetScene(RemoteAppArgs myArgs,
 	const unsigned int sceneResWidth = usedResolution.x();
 	const unsigned int sceneResHeight = usedResolution.y();
 
-	pointBasedView->setScene(scene);
-	pointBasedView->setResolution({ sceneResWidth, sceneResHeight });
+	for (const RemotePointView::Ptr& pointBasedView : pointBasedViews)
+	{
+		pointBasedView->setScene(scene);
+		pointBasedView->setResolution({ sceneResWidth, sceneResHeight });
+	}
 
 	// Raycaster.
-	std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-	raycaster->init();
-	raycaster->addMesh(scene->proxies()->proxy());
+	std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 	// Camera handler for main view.
 	sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
@@ -101,13 +108,21 @@ void resetScene(RemoteAppArgs myArgs,
 	multiViewManager.addSubView("Top view", topView, usedResolution);
 	topView->active(false);
 
-	multiViewManager.addIBRSubView("Point view", pointBasedView, { sceneResWidth, sceneResHeight }, ImGuiWindowFlags_NoBringToFrontOnFocus);
+	multiViewManager.addIBRSubView("Point view", pointBasedViews[0], { sceneResWidth, sceneResHeight }, ImGuiWindowFlags_NoBringToFrontOnFocus);
 	multiViewManager.addCameraForView("Point view", generalCamera);
 
+	// The other training processes follow the camera of the first one.
+	for (size_t i = 1; i < pointBasedViews.size(); i++)
+	{
+		multiViewManager.addIBRSubView(pointViewName(i), pointBasedViews[i],
+			[generalCamera](ViewBase::Ptr&, Input&, const Viewport&, const float) { return generalCamera->getCamera(); },
+			{ sceneResWidth, sceneResHeight }, ImGuiWindowFlags_NoBringToFrontOnFocus);
+	}
+
 	CHECK_GL_ERROR;
 
 	// save images
-	generalCamera->getCameraRecorder().setViewPath(pointBasedView, myArgs.dataset_path.get());
+	generalCamera->getCameraRecorder().setViewPath(pointBasedViews[0], myArgs.dataset_path.get());
 	if (myArgs.pathFile.get() != "") {
 		generalCamera->getCameraRecorder().loadPath(myArgs.pathFile.get(), usedResolution.x(), usedResolution.y());
 		generalCamera->getCameraRecorder().recordOfflinePath(myArgs.outPath, multiViewManager.getIBRSubView("Point view"), "");
@@ -141,7 +156,28 @@ int main(int ac, char** av) {
 	// Add views to mvm.
 	MultiViewManager        multiViewManager(window, false);
 	BasicIBRScene::Ptr		scene;
-	RemotePointView::Ptr	remoteView(new RemotePointView(myArgs.ip, myArgs.port));
+	// One view per training process, each with its own connection. The first one drives the scene.
+	std::vector<std::pair<std::string, uint>> servers = { { myArgs.ip, myArgs.port } };
+	for (const std::string& server : sibr::split(myArgs.servers.get(), ','))
+	{
+		if (server.empty())
+			continue;
+		const size_t colon = server.rfind(':');
+		if (colon == std::string::npos)
+			servers.emplace_back(server, myArgs.port);
+		else
+			servers.emplace_back(server.substr(0, colon), uint(std::stoul(server.substr(colon + 1))));
+	}
+	std::vector<RemotePointView::Ptr> remoteViews;
+	for (size_t i = 0; i < servers.size(); i++)
+	{
+		remoteViews.emplace_back(new RemotePointView(servers[i].first, servers[i].second, myArgs.encoding, myArgs.quality, myArgs.inFlight,
+			myArgs.jsonRequests, myArgs.targetFps, !myArgs.noSharedMemory));
+		// Each connection logs to its own file.
+		if (!myArgs.latencyLog.get().empty())
+			remoteViews[i]->latency().log(i == 0 ? myArgs.latencyLog.get() : myArgs.latencyLog.get() + "." + std::to_string(i + 1));
+	}
+	RemotePointView::Ptr	remoteView = remoteViews[0];
 	std::shared_ptr<sibr::SceneDebugView> topView;
 	
 	std::string currentName;
@@ -149,7 +185,7 @@ int main(int ac, char** av) {
 	bool pathOverride = myArgs.dataset_path.isInit();
 	if (pathOverride)
 	{
-		resetScene(myArgs, rendering_width, rendering_height, scene, remoteView, topView, multiViewManager);
+		resetScene(myArgs, rendering_width, rendering_height, scene, remoteViews, topView, multiViewManager);
 	}
 
 	// Main looooooop.
@@ -159,7 +195,7 @@ int main(int ac, char** av) {
 		{
 			currentName = remoteView->sceneName();
 			myArgs.dataset_path = currentName;
-			resetScene(myArgs, rendering_width, rendering_height, scene, remoteView, topView, multiViewManager);
+			resetScene(myArgs, rendering_width, rendering_height, scene, remoteViews, topView, multiViewManager);
 		}
 
 		sibr::Input::poll();
@@ -46,6 +46,14 @@ namespace sibr {
 		Arg<bool> loadImages = { "load_images", "Whether or not to load images for scene overview" };
 		Arg<std::string> ip = { "ip", "127.0.0.1", "Target IP to connect to (default localhost)"};
 		Arg<uint> port = { "port", 6009, "Port to use for connection" };
+		Arg<std::string> servers = { "servers", "", "Other training processes to watch with the same camera, as comma separated ip[:port]" };
+		Arg<std::string> encoding = { "encoding", "raw", "Image transport requested from the training side: raw, jpeg, webp or png (lossless)" };
+		Arg<int> quality = { "quality", 85, "Quality of jpeg and webp images (1-100)" };
+		Arg<int> inFlight = { "in_flight", 2, "Camera requests sent ahead of the received images (1 for lockstep)" };
+		Arg<bool> jsonRequests = { "json_requests", "Always send camera requests as JSON, even if the training side accepts binary ones" };
+		Arg<float> targetFps = { "target_fps", 0.0f, "Frame rate to reach by lowering the resolution while moving (0 to always request full resolution)" };
+		Arg<bool> noSharedMemory = { "no_shared_memory", "Always receive images through the socket, even from a training process on the same host" };
+		Arg<std::string> latencyLog = { "latency_log", "", "CSV file receiving the latency breakdown of each displayed frame" };
 	};
 
 }
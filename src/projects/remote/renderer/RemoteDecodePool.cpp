@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "RemoteDecodePool.hpp"
+
+namespace sibr {
+
+	RemoteDecodePool & RemoteDecodePool::shared(void)
+	{
+		static RemoteDecodePool pool(ThreadPool::shared());
+		return pool;
+	}
+
+	RemoteDecodePool::RemoteDecodePool(ThreadPool & pool) :
+		_pool(pool)
+	{
+	}
+
+	void RemoteDecodePool::submit(std::function<void()> task)
+	{
+		// A decoded image is displayed at once, it goes before the background loads.
+		_pool.push(std::move(task), 1.0f);
+	}
+
+} /*namespace sibr*/
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include "core/system/ThreadPool.hpp"
+# include <functional>
+
+namespace sibr {
+
+	/**
+	 * \class RemoteDecodePool
+	 * \brief Decodes the compressed images of all the remote views of a process on a thread pool,
+	 * so that watching several training processes doesn't start one decoder per connection and
+	 * the network threads can read the next reply while the previous one is decoded.
+	 */
+	class SIBR_EXP_ULR_EXPORT RemoteDecodePool
+	{
+		SIBR_DISALLOW_COPY(RemoteDecodePool);
+	public:
+
+		/** \return the pool shared by the remote views, running on sibr::ThreadPool::shared(). */
+		static RemoteDecodePool & shared(void);
+
+		/** Constructor.
+		 * \param pool the threads decoding the images
+		 */
+		RemoteDecodePool(ThreadPool & pool);
+
+		/** Queue a task.
+		 * \param task the task, run on a pool thread
+		 */
+		void submit(std::function<void()> task);
+
+	private:
+
+		ThreadPool & _pool; ///< Threads running the tasks.
+	};
+
+} /*namespace sibr*/
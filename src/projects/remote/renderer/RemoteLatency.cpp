@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#include "RemoteLatency.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace sibr {
+
+	const char * RemoteLatency::name(Stage stage)
+	{
+		static const char * names[STAGE_COUNT] = { "Serialize", "Send", "Wait", "Transfer", "Decode", "Upload", "Total" };
+		return names[stage];
+	}
+
+	RemoteLatency::RemoteLatency(void)
+	{
+		_samples.reserve(history);
+	}
+
+	bool RemoteLatency::log(const std::string & path)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_log.close();
+		if (path.empty())
+			return true;
+
+		_log.open(path);
+		if (!_log)
+		{
+			SIBR_WRG << "Unable to write latencies to " << path << std::endl;
+			return false;
+		}
+		_log << "frame";
+		for (int s = 0; s < STAGE_COUNT; s++)
+			_log << "," << name(Stage(s));
+		_log << "\n";
+		SIBR_LOG << "Logging remote latencies to " << path << std::endl;
+		return true;
+	}
+
+	void RemoteLatency::record(const Sample & sample)
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		if (_samples.size() < size_t(history))
+			_samples.push_back(sample);
+		else
+			_samples[_frames % history] = sample;
+
+		if (_log.is_open())
+		{
+			_log << _frames;
+			for (int s = 0; s < STAGE_COUNT; s++)
+				_log << "," << sample[s];
+			_log << "\n";
+		}
+		_frames++;
+	}
+
+	float RemoteLatency::percentile(Stage stage, float p) const
+	{
+		std::vector<float> values;
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			values.reserve(_samples.size());
+			for (const Sample & sample : _samples)
+				values.push_back(sample[stage]);
+		}
+		if (values.empty())
+			return 0.0f;
+
+		const size_t rank = std::min(values.size() - 1, size_t(std::round(p * float(values.size() - 1))));
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+
+	size_t RemoteLatency::count(void) const
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		return _samples.size();
+	}
+
+} /*namespace sibr*/
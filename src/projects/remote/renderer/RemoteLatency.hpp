@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+#pragma once
+
+# include "Config.hpp"
+# include <array>
+# include <fstream>
+# include <mutex>
+# include <string>
+# include <vector>
+
+namespace sibr {
+
+	/**
+	 * \class RemoteLatency
+	 * \brief Breakdown of the latency of remote frames, from the camera request to the texture upload.
+	 * Frames are recorded by the network and render threads, kept over a rolling window for
+	 * percentiles, and optionally appended to a CSV log as they complete.
+	 */
+	class SIBR_EXP_ULR_EXPORT RemoteLatency
+	{
+		SIBR_DISALLOW_COPY(RemoteLatency);
+	public:
+
+		/// Measured stages, TOTAL spans from the request to the end of the upload.
+		enum Stage { SERIALIZE = 0, SEND, WAIT, TRANSFER, DECODE, UPLOAD, TOTAL, STAGE_COUNT };
+
+		/// Timings of a frame, in ms.
+		typedef std::array<float, STAGE_COUNT> Sample;
+
+		/// Number of frames kept.
+		static const int history = 240;
+
+		/** \return the display name of a stage.
+		 * \param stage the stage
+		 */
+		static const char * name(Stage stage);
+
+		/// Constructor.
+		RemoteLatency(void);
+
+		/** Append each completed frame to a CSV file.
+		 * \param path the destination file, empty to stop logging
+		 * \return true if the file could be opened
+		 */
+		bool log(const std::string & path);
+
+		/** Record a completed frame, from any thread.
+		 * \param sample the frame timings
+		 */
+		void record(const Sample & sample);
+
+		/** \return a percentile of a stage over the kept frames, in ms.
+		 * \param stage the stage
+		 * \param p the percentile, in [0,1]
+		 */
+		float percentile(Stage stage, float p) const;
+
+		/** \return the number of kept frames. */
+		size_t count(void) const;
+
+	private:
+
+		mutable std::mutex _mutex; ///< Guards the samples and the log.
+		std::vector<Sample> _samples; ///< Ring of timings.
+		size_t _frames = 0; ///< Number of recorded frames.
+		std::ofstream _log; ///< CSV log, if open.
+	};
+
+} /*namespace sibr*/
@@ -13,6 +13,15 @@
 #include <core/graphics/GUI.hpp>
 #include <thread>
 #include <boost/asio.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
 
 constexpr char* jResX = "resolution_x";
 constexpr char* jResY = "resolution_y";
@@ -28,9 +37,223 @@ constexpr char* jFrame = "frame";
 constexpr char* jSHsPython = "shs_python";
 constexpr char* jRotScalePython = "rot_scale_python";
 constexpr char* jKeepAlive = "keep_alive";
+constexpr char* jImageEncoding = "image_encoding";
+constexpr char* jImageQuality = "image_quality";
+constexpr char* jRequestId = "request_id";
+constexpr char* jBinaryRequest = "binary_request";
+constexpr char* jSharedMemory = "shared_memory";
+constexpr char* jSharedOffset = "shared_memory_offset";
+constexpr char* jSharedSize = "shared_memory_size";
+
+// Compressed images are framed: magic, format (0 raw, 1 encoded), payload length, payload.
+// Raw requests are answered with the bare pixels, as before the encodings existed.
+static const uint32_t kImageMagic = 0x31474d49; // "IMG1"
+
+static const char* kEncodings[] = { "raw", "jpeg", "webp", "png" };
+
+// Binary requests replace the length of a JSON message by this magic, followed by a BinaryRequest.
+// They are only sent once the training side has acknowledged them, by setting kBinaryAck in the
+// length of the scene name that follows each image.
+static const uint32_t kRequestMagic = 0x31514552; // "REQ1"
+static const uint32_t kRequestVersion = 1;
+static const uint32_t kRequestSharedVersion = 2;
+static const uint32_t kBinaryAck = 0x80000000u;
+
+/// Flags of a binary request.
+enum RequestFlags : uint32_t
+{
+	REQUEST_TRAIN = 1 << 0,
+	REQUEST_SHS_PYTHON = 1 << 1,
+	REQUEST_ROT_SCALE_PYTHON = 1 << 2,
+	REQUEST_KEEP_ALIVE = 1 << 3
+};
+
+/// Fixed layout camera request, little endian, matrices in the same order as the JSON arrays.
+struct BinaryRequest
+{
+	uint32_t magic; ///< kRequestMagic.
+	uint32_t version; ///< kRequestVersion.
+	uint32_t size; ///< sizeof(BinaryRequest), later versions may only append fields.
+	uint32_t requestId; ///< Sequence number of the request.
+	int32_t resolution[2]; ///< Image width and height.
+	float fovY, fovX, zFar, zNear; ///< Projection parameters.
+	float view[16]; ///< View matrix.
+	float viewProj[16]; ///< View projection matrix.
+	float scalingModifier; ///< Scale of the Gaussians.
+	int32_t frame; ///< Requested frame.
+	uint32_t flags; ///< RequestFlags.
+	uint32_t encoding; ///< Index in kEncodings.
+	int32_t quality; ///< Quality of lossy encodings.
+};
+static_assert(sizeof(BinaryRequest) == 188, "BinaryRequest must not be padded");
+
+/// Appended to a BinaryRequest of version 2, once the training side wrote an image to shared memory.
+struct BinarySharedBlock
+{
+	uint32_t offset; ///< Where to write the image in the segment.
+	uint32_t size; ///< Bytes available at offset.
+	char name[56]; ///< Name of the segment, null terminated.
+};
+static_assert(sizeof(BinarySharedBlock) == 64, "BinarySharedBlock must not be padded");
+
+// Framed replies of format 2 carry no pixels: they were written to the shared memory region of the request.
+static const uint32_t kFormatShared = 2;
+
+// Regions of a shared segment, one per request in flight. The region of a request is only reused
+// once its reply has been read, since at most kSharedRegions requests are outstanding.
+static const uint32_t kSharedRegions = 8;
+
+namespace bip = boost::interprocess;
+
+/// Shared memory segment receiving the images of a training process on the same host.
+struct SharedSegment
+{
+	/** Create a segment.
+	 * \param name unique name of the segment
+	 * \param regionBytes size of each region
+	 */
+	SharedSegment(const std::string & name, size_t regionBytes) : name(name), regionBytes(regionBytes)
+	{
+		bip::shared_memory_object object(bip::create_only, name.c_str(), bip::read_write);
+		object.truncate(bip::offset_t(regionBytes * kSharedRegions));
+		region = bip::mapped_region(object, bip::read_write);
+	}
+
+	~SharedSegment()
+	{
+		bip::shared_memory_object::remove(name.c_str());
+	}
+
+	/** \return the region of a request. */
+	const unsigned char * image(uint32_t requestId) const
+	{
+		return static_cast<const unsigned char*>(region.get_address()) + offset(requestId);
+	}
+
+	/** \return the offset of the region of a request. */
+	size_t offset(uint32_t requestId) const { return size_t(requestId % kSharedRegions) * regionBytes; }
+
+	std::string name; ///< Segment name.
+	size_t regionBytes; ///< Bytes per region.
+	bip::mapped_region region; ///< Mapping of the whole segment.
+};
+
+// Receive the image of a frame. Raw pixels, read from the socket or the shared region, are written to image,
+// compressed ones are left in payload.
+// Returns the number of bytes received, or 0 if the payload is invalid.
+static size_t receiveImage(boost::asio::ip::tcp::socket & sock, bool framed, bool & supportsFraming,
+	unsigned char * image, std::vector<unsigned char> & payload, uint32_t rawBytes, const unsigned char * shared, bool & fromShared)
+{
+	payload.clear();
+	fromShared = false;
+	if (!framed)
+	{
+		boost::asio::read(sock, boost::asio::buffer(image, rawBytes));
+		return rawBytes;
+	}
+
+	uint32_t header[3];
+	boost::asio::read(sock, boost::asio::buffer(header, sizeof(header)));
+	if (header[0] != kImageMagic)
+	{
+		// The training side ignored the encoding request: these were the first pixels.
+		supportsFraming = false;
+		std::memcpy(image, header, std::min<size_t>(sizeof(header), rawBytes));
+		if (rawBytes > sizeof(header))
+			boost::asio::read(sock, boost::asio::buffer(image + sizeof(header), rawBytes - sizeof(header)));
+		return rawBytes;
+	}
+
+	if (header[1] == kFormatShared)
+	{
+		// The pixels never went through the socket.
+		if (!shared || header[2] != rawBytes)
+			return 0;
+		std::memcpy(image, shared, rawBytes);
+		fromShared = true;
+		return rawBytes + sizeof(header);
+	}
+	if (header[1] == 0 && header[2] == rawBytes)
+	{
+		boost::asio::read(sock, boost::asio::buffer(image, rawBytes));
+		return rawBytes + sizeof(header);
+	}
+	payload.resize(header[2]);
+	boost::asio::read(sock, boost::asio::buffer(payload.data(), payload.size()));
+	return header[1] == 0 ? 0 : payload.size() + sizeof(header);
+}
+
+// Decode a compressed image on the calling thread, returns false if it doesn't match the expected size.
+static bool decodeImage(const std::vector<unsigned char> & payload, unsigned char * image, size_t rawBytes, float & decodeMs)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const cv::Mat decoded = cv::imdecode(cv::Mat(1, int(payload.size()), CV_8UC1, const_cast<unsigned char*>(payload.data())), cv::IMREAD_COLOR);
+	if (decoded.empty() || size_t(decoded.total()) * 3 != rawBytes)
+		return false;
+	cv::Mat rgb(decoded.rows, decoded.cols, CV_8UC3, image);
+	cv::cvtColor(decoded, rgb, cv::COLOR_BGR2RGB);
+	decodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void sibr::RemotePointView::releaseSlot(int slot)
+{
+	std::lock_guard<std::mutex> ilg(_imageDataMutex);
+	_slots[slot].state = ImageSlot::FREE;
+}
+
+void sibr::RemotePointView::publish(const ReceivedImage & image)
+{
+	std::lock_guard<std::mutex> ilg(_imageDataMutex);
+	ImageSlot & slot = _slots[image.slot];
+
+	// Decoding finishes out of order: an image older than the displayed one is discarded.
+	if (image.id + 1 <= _publishedId)
+	{
+		slot.state = ImageSlot::FREE;
+		_dropped++;
+		return;
+	}
+	_publishedId = image.id + 1;
+
+	// Only the latest image is kept for the render thread.
+	for (ImageSlot & other : _slots)
+	{
+		if (other.state == ImageSlot::READY)
+			other.state = ImageSlot::FREE;
+	}
+	slot.state = ImageSlot::READY;
+	slot.resolution = image.resolution;
+	slot.created = image.created;
+	slot.published = std::chrono::steady_clock::now();
+	slot.timings = image.timings;
+	_received = float(image.received);
+	_ratio = float(image.bytes) / float(image.received);
+	_decodeMs = image.timings[RemoteLatency::DECODE];
+	{
+		std::lock_guard<std::mutex> lg(_renderDataMutex);
+		_timestampReceived = image.timestamp;
+	}
+}
+
+int sibr::RemotePointView::acquireSlot(size_t bytes)
+{
+	std::lock_guard<std::mutex> ilg(_imageDataMutex);
+	for (int i = 0; i < int(_slots.size()); i++)
+	{
+		if (_slots[i].state == ImageSlot::FREE && _slots[i].capacity >= bytes)
+		{
+			_slots[i].state = ImageSlot::WRITING;
+			return i;
+		}
+	}
+	return -1;
+}
 
 void sibr::RemotePointView::send_receive()
 {
+	// Ids keep increasing across connections, images are published in their order.
+	uint32_t requestId = 0;
 	while (keep_running)
 	{
 		SIBR_LOG << "Trying to connect..." << std::endl;
@@ -49,64 +272,315 @@ void sibr::RemotePointView::send_receive()
 			} while (keep_running && ec.failed());
 
 			SIBR_LOG << "Connected!" << std::endl;
+			_framed = true;
+			_binary = false;
+			std::vector<unsigned char> scratch, payload;
+
+			// Offer shared memory to a training process on the same host, until it answers without it.
+			bool offerShared = _sharedMemory && addr.is_loopback();
+			std::shared_ptr<SharedSegment> segment;
+			int segments = 0;
+			_shared = false;
+
+			// Requests are answered in order: the server renders the next ones while an image is on the wire.
+			struct PendingRequest
+			{
+				uint32_t timestamp; ///< Camera state of the request.
+				uint32_t bytes; ///< Size of the uncompressed image.
+				Vector2i resolution; ///< Requested resolution.
+				std::string encoding; ///< Requested encoding.
+				std::chrono::steady_clock::time_point sent; ///< Time the request was written.
+				bool moving; ///< The camera was moving, the resolution may be reduced.
+				uint32_t id; ///< Request id.
+				std::shared_ptr<SharedSegment> segment; ///< Segment offered for the image, kept alive until the reply.
+				std::chrono::steady_clock::time_point created; ///< Time the request was built.
+				float serializeMs; ///< Time to build the message.
+				float sendMs; ///< Time to write it to the socket.
+			};
+			std::deque<PendingRequest> pending;
+			bool dropped = false;
+			// Smoothed measurements of the replies received while the camera moves.
+			float intervalMs = 0.0f, latencyMs = 0.0f, throughput = 0.0f;
+			auto lastReply = std::chrono::steady_clock::now();
 			while (keep_running)
 			{
+				while (int(pending.size()) < std::max(1, std::min(int(_inFlight), int(kSharedRegions))))
 				{
 					std::lock_guard<std::mutex> lg(_renderDataMutex);
+					PendingRequest request;
+					request.created = std::chrono::steady_clock::now();
+					request.timestamp = _timestampRequested;
+					request.bytes = _remoteInfo.imgResolution.x() * _remoteInfo.imgResolution.y() * 3;
+					request.resolution = _remoteInfo.imgResolution;
+					request.moving = _moving;
+					request.encoding = _framed ? _encoding : "raw";
+					request.id = requestId++;
+					if (offerShared && (!segment || segment->regionBytes < request.bytes))
+					{
+						// A larger segment for a larger view, the previous one lives until its replies are read.
+						try
+						{
+							const std::string name = "sibr_remote_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "_" + std::to_string(segments++);
+							segment = std::make_shared<SharedSegment>(name, request.bytes);
+						}
+						catch (const bip::interprocess_exception & e)
+						{
+							SIBR_WRG << "Unable to create a shared memory segment (" << e.what() << "), using the socket" << std::endl;
+							offerShared = false;
+							segment.reset();
+						}
+					}
+					if (offerShared)
+						request.segment = segment;
+
+					auto serialized = request.created;
+					if (_binary)
+					{
+						// Fixed layout, nothing to allocate or parse on either side.
+						BinaryRequest binary;
+						// The shared memory block is only appended for a training side that already used it.
+						const bool shared = request.segment && _shared;
+						binary.magic = kRequestMagic;
+						binary.version = shared ? kRequestSharedVersion : kRequestVersion;
+						binary.size = sizeof(BinaryRequest) + (shared ? sizeof(BinarySharedBlock) : 0);
+						binary.requestId = request.id;
+						binary.resolution[0] = _remoteInfo.imgResolution.x();
+						binary.resolution[1] = _remoteInfo.imgResolution.y();
+						binary.fovY = _remoteInfo.fovy;
+						binary.fovX = _remoteInfo.fovx;
+						binary.zFar = _remoteInfo.zfar;
+						binary.zNear = _remoteInfo.znear;
+						std::memcpy(binary.view, _remoteInfo.view.data(), sizeof(binary.view));
+						std::memcpy(binary.viewProj, _remoteInfo.viewProj.data(), sizeof(binary.viewProj));
+						binary.scalingModifier = _scalingModifier;
+						binary.frame = _frame;
+						binary.flags = (_doTrainingBool ? REQUEST_TRAIN : 0) | (_doSHsPython ? REQUEST_SHS_PYTHON : 0)
+							| (_doRotScalePython ? REQUEST_ROT_SCALE_PYTHON : 0) | (_keepAlive ? REQUEST_KEEP_ALIVE : 0);
+						binary.encoding = uint32_t(std::find(std::begin(kEncodings), std::end(kEncodings), request.encoding) - std::begin(kEncodings));
+						binary.quality = _quality;
+						BinarySharedBlock block = {};
+						if (shared)
+						{
+							block.offset = uint32_t(request.segment->offset(request.id));
+							block.size = uint32_t(request.segment->regionBytes);
+							std::strncpy(block.name, request.segment->name.c_str(), sizeof(block.name) - 1);
+						}
+						serialized = std::chrono::steady_clock::now();
+						boost::asio::write(sock, boost::asio::buffer(&binary, sizeof(BinaryRequest)));
+						if (shared)
+							boost::asio::write(sock, boost::asio::buffer(&block, sizeof(BinarySharedBlock)));
+					}
+					else
+					{
+						// Serialize our arbitrary data to something simple, yet convenient for both sides
+						json sendData;
+						sendData[jTrain] = _doTrainingBool ? 1 : 0;
+						sendData[jSHsPython] = _doSHsPython ? 1 : 0;
+						sendData[jRotScalePython] = _doRotScalePython ? 1 : 0;
+						sendData[jScalingModifier] = _scalingModifier;
+						sendData[jFrame] = _frame;
+						sendData[jResX] = _remoteInfo.imgResolution.x();
+						sendData[jResY] = _remoteInfo.imgResolution.y();
+						sendData[jFovY] = _remoteInfo.fovy;
+						sendData[jFovX] = _remoteInfo.fovx;
+						sendData[jZFar] = _remoteInfo.zfar;
+						sendData[jZNear] = _remoteInfo.znear;
+						sendData[jKeepAlive] = _keepAlive ? 1 : 0;
+						sendData[jViewMat] = std::vector<float>((float*)&_remoteInfo.view, ((float*)&_remoteInfo.view) + 16);
+						sendData[jViewProjMat] = std::vector<float>((float*)&_remoteInfo.viewProj, ((float*)&_remoteInfo.viewProj) + 16);
+						sendData[jImageEncoding] = request.encoding;
+						sendData[jImageQuality] = _quality;
+						sendData[jRequestId] = request.id;
+						if (request.segment)
+						{
+							sendData[jSharedMemory] = request.segment->name;
+							sendData[jSharedOffset] = request.segment->offset(request.id);
+							sendData[jSharedSize] = request.segment->regionBytes;
+						}
+						if (!_jsonRequests)
+							sendData[jBinaryRequest] = kRequestVersion;
 
-					// Serialize our arbitrary data to something simple, yet convenient for both sides
-					json sendData;
-					sendData[jTrain] = _doTrainingBool ? 1 : 0;
-					sendData[jSHsPython] = _doSHsPython ? 1 : 0;
-					sendData[jRotScalePython] = _doRotScalePython ? 1 : 0;
-					sendData[jScalingModifier] = _scalingModifier;
-					sendData[jFrame] = _frame;
-					sendData[jResX] = _remoteInfo.imgResolution.x();
-					sendData[jResY] = _remoteInfo.imgResolution.y();
-					sendData[jFovY] = _remoteInfo.fovy;
-					sendData[jFovX] = _remoteInfo.fovx;
-					sendData[jZFar] = _remoteInfo.zfar;
-					sendData[jZNear] = _remoteInfo.znear;
-					sendData[jKeepAlive] = _keepAlive ? 1 : 0;
-					sendData[jViewMat] = std::vector<float>((float*)&_remoteInfo.view, ((float*)&_remoteInfo.view) + 16);
-					sendData[jViewProjMat] = std::vector<float>((float*)&_remoteInfo.viewProj, ((float*)&_remoteInfo.viewProj) + 16);
-
-					std::string message = sendData.dump();
-					uint32_t messageLength = message.size();
-					boost::asio::write(sock, boost::asio::buffer(&messageLength, sizeof(uint32_t)));
-					boost::asio::write(sock, boost::asio::buffer(message.c_str(), messageLength));
+						std::string message = sendData.dump();
+						uint32_t messageLength = message.size();
+						serialized = std::chrono::steady_clock::now();
+						boost::asio::write(sock, boost::asio::buffer(&messageLength, sizeof(uint32_t)));
+						boost::asio::write(sock, boost::asio::buffer(message.c_str(), messageLength));
+					}
+					request.sent = std::chrono::steady_clock::now();
+					request.serializeMs = std::chrono::duration<float, std::milli>(serialized - request.created).count();
+					request.sendMs = std::chrono::duration<float, std::milli>(request.sent - serialized).count();
+					pending.push_back(request);
 				}
 
-				uint32_t bytes_to_receive = _remoteInfo.imgResolution.x() * _remoteInfo.imgResolution.y() * 3;
-				if (bytes_to_receive > 0)
+				const PendingRequest request = pending.front();
+				pending.pop_front();
+				bool supportsFraming = true;
+				size_t received = 0;
+				float waitMs = 0.0f, transferMs = 0.0f;
+				// Receive straight into a mapped pixel buffer, the scratch image only catches frames when the ring is busy.
+				const int slot = request.bytes > 0 ? acquireSlot(request.bytes) : -1;
+				unsigned char * target = slot >= 0 ? _slots[slot].data : nullptr;
+				if (request.bytes > 0)
 				{
-					std::lock_guard<std::mutex> ilg(_imageDataMutex);
-					_imageData.resize(bytes_to_receive);
-					boost::asio::read(sock, boost::asio::buffer(_imageData.data(), _imageData.size()));
+					if (!target)
+					{
+						scratch.resize(request.bytes);
+						target = scratch.data();
+					}
+					// Waiting for the first bytes covers the rendering on the training side, and its queue in flight.
+					const auto waitStart = std::chrono::steady_clock::now();
+					sock.wait(boost::asio::ip::tcp::socket::wait_read);
+					const auto firstBytes = std::chrono::steady_clock::now();
+
+					// Shared memory replies are framed, whatever the encoding.
+					bool fromShared = false;
+					received = receiveImage(sock, request.encoding != "raw" || request.segment, supportsFraming, target, payload, request.bytes,
+						request.segment ? request.segment->image(request.id) : nullptr, fromShared);
+					waitMs = std::chrono::duration<float, std::milli>(firstBytes - waitStart).count();
+					transferMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - firstBytes).count();
+					if (request.segment && !fromShared && offerShared)
 					{
-						std::lock_guard<std::mutex> lg(_renderDataMutex);
-						_timestampReceived = _timestampRequested;
+						SIBR_LOG << "The training side doesn't use shared memory, images go through the socket" << std::endl;
+						offerShared = false;
+						segment.reset();
+					}
+					_shared = fromShared;
+					if (!supportsFraming && _framed && request.encoding != "raw")
+					{
+						SIBR_WRG << "The training side doesn't support " << request.encoding << " images, falling back to raw" << std::endl;
+						_framed = false;
 					}
-					_imageDirty = true;
 				}
 				uint32_t sceneLength;
 				boost::asio::read(sock, boost::asio::buffer(&sceneLength, sizeof(uint32_t)));
+				if (sceneLength & kBinaryAck)
+				{
+					if (!_binary && !_jsonRequests)
+						SIBR_LOG << "The training side accepts binary requests" << std::endl;
+					_binary = !_jsonRequests;
+					sceneLength &= ~kBinaryAck;
+				}
 				std::vector<char> sceneName(sceneLength);
 				boost::asio::read(sock, boost::asio::buffer(sceneName.data(), sceneLength));
 				sceneName.push_back(0);
 				current_scene = std::string(sceneName.data());
+
+				if (request.bytes == 0)
+					continue;
+
+				const auto now = std::chrono::steady_clock::now();
+				if (request.moving && received > 0)
+				{
+					// Requests wait behind the ones sent before them: remove that queueing from the round trip.
+					const float rttMs = std::chrono::duration<float, std::milli>(now - request.sent).count();
+					const float replyMs = std::chrono::duration<float, std::milli>(now - lastReply).count();
+					const float alpha = intervalMs > 0.0f ? 0.2f : 1.0f;
+					intervalMs += alpha * (replyMs - intervalMs);
+					latencyMs += alpha * (std::max(rttMs - float(pending.size()) * intervalMs, intervalMs) - latencyMs);
+					throughput += alpha * (float(received) / (1e-3f * std::max(replyMs, 1e-3f)) - throughput);
+					adapt(intervalMs, latencyMs);
+				}
+				lastReply = now;
+				_rttMs = latencyMs;
+				_throughput = throughput;
+
+				// The answer to a later request is already arriving: this image is stale, skip its decoding.
+				// Never twice in a row, so that a server answering faster than we decode still updates the view.
+				const bool stale = !dropped && !pending.empty() && sock.available() > 0;
+				dropped = stale;
+
+				if (stale || slot < 0 || received == 0)
+				{
+					if (slot >= 0)
+						releaseSlot(slot);
+					if (stale || slot < 0)
+						_dropped++;
+					else
+						SIBR_WRG << "Unable to decode a " << request.encoding << " image" << std::endl;
+					continue;
+				}
+
+				ReceivedImage result;
+				result.slot = slot;
+				result.id = request.id;
+				result.timestamp = request.timestamp;
+				result.bytes = request.bytes;
+				result.received = received;
+				result.resolution = request.resolution;
+				result.created = request.created;
+				result.timings[RemoteLatency::SERIALIZE] = request.serializeMs;
+				result.timings[RemoteLatency::SEND] = request.sendMs;
+				result.timings[RemoteLatency::WAIT] = waitMs;
+				result.timings[RemoteLatency::TRANSFER] = transferMs;
+				result.timings[RemoteLatency::DECODE] = 0.0f;
+				if (payload.empty())
+				{
+					publish(result);
+					continue;
+				}
+
+				// Compressed images are decoded by the shared pool while this thread reads the next reply.
+				{
+					std::lock_guard<std::mutex> ilg(_imageDataMutex);
+					_slots[slot].state = ImageSlot::DECODING;
+				}
+				auto data = std::make_shared<std::vector<unsigned char>>();
+				data->swap(payload);
+				const std::string encoding = request.encoding;
+				_decoding++;
+				RemoteDecodePool::shared().submit([this, data, target, result, encoding]() mutable {
+					if (decodeImage(*data, target, result.bytes, result.timings[RemoteLatency::DECODE]))
+					{
+						publish(result);
+					}
+					else
+					{
+						SIBR_WRG << "Unable to decode a " << encoding << " image" << std::endl;
+						releaseSlot(result.slot);
+					}
+					_decoding--;
+				});
 			}
 		}
 		catch (...)
 		{
 			SIBR_LOG << "Connection dropped" << std::endl;
+			std::lock_guard<std::mutex> ilg(_imageDataMutex);
+			for (ImageSlot & slot : _slots)
+			{
+				if (slot.state == ImageSlot::WRITING)
+					slot.state = ImageSlot::FREE;
+			}
 		}
 	}
 }
 
-sibr::RemotePointView::RemotePointView(std::string ip, uint port) : sibr::ViewBase(0, 0),
-_ip(ip), _port(port)
+void sibr::RemotePointView::adapt(float intervalMs, float latencyMs)
+{
+	if (_targetFps <= 0.0f || intervalMs <= 0.0f)
+		return;
+
+	// The cost of a frame is mostly proportional to its pixels, hence the square root.
+	// The correction is damped to avoid oscillating with the noise of the measurements.
+	const float targetMs = 1000.0f / _targetFps;
+	const float correction = std::sqrt(targetMs / intervalMs);
+	const float scale = _scale * std::max(0.8f, std::min(std::pow(correction, 0.5f), 1.1f));
+	_scale = std::max(_minScale, std::min(scale, 1.0f));
+
+	// Enough requests to cover the round trip at the target rate.
+	const int inFlight = int(std::ceil(latencyMs / targetMs));
+	_inFlight = std::max(1, std::min(inFlight, 4));
+}
+
+sibr::RemotePointView::RemotePointView(std::string ip, uint port, const std::string & encoding, int quality, int inFlight, bool jsonRequests, float targetFps, bool sharedMemory) : sibr::ViewBase(0, 0),
+_ip(ip), _port(port), _encoding(encoding), _quality(std::max(1, std::min(quality, 100))), _inFlight(std::max(1, inFlight)), _jsonRequests(jsonRequests), _targetFps(targetFps), _sharedMemory(sharedMemory)
 {
+	if (std::find(std::begin(kEncodings), std::end(kEncodings), _encoding) == std::end(kEncodings))
+	{
+		SIBR_WRG << "Unknown image encoding " << _encoding << ", using raw images" << std::endl;
+		_encoding = "raw";
+	}
+
 	_pointbasedrenderer.reset(new PointBasedRenderer());
 	_copyRenderer.reset(new CopyRenderer());
 	_copyRenderer->flip() = true;
@@ -115,7 +589,7 @@ _ip(ip), _port(port)
 	glTextureParameteri(_imageTexture, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
 	glTextureParameteri(_imageTexture, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
 	glTextureParameteri(_imageTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(_imageTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(_imageTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	_networkThread = std::make_unique<std::thread>(&RemotePointView::send_receive, this);
 }
@@ -151,38 +625,98 @@ void sibr::RemotePointView::onRenderIBR(sibr::IRenderTarget & dst, const sibr::C
 			_remoteInfo.znear = eye.znear();
 			_remoteInfo.zfar = eye.zfar();
 			_timestampRequested++;
+			_lastMotion = std::chrono::steady_clock::now();
 		}
-		if (_resolution != _remoteInfo.imgResolution)
+
+		// Reduced resolution while moving, upscaled when displayed. Full resolution again once the camera stops.
+		_moving = _targetFps > 0.0f && std::chrono::steady_clock::now() - _lastMotion < std::chrono::milliseconds(250);
+		// Steps of 5% avoid reallocating the texture for every reply.
+		const float scale = _moving ? std::round(20.0f * _scale) / 20.0f : 1.0f;
+		const Vector2i resolution = (_resolution.cast<float>() * scale).cast<int>().cwiseMax(1);
+		if (resolution != _remoteInfo.imgResolution)
 		{
-			_remoteInfo.imgResolution = _resolution;
-			_imageResize = true;
+			_remoteInfo.imgResolution = resolution;
 			_timestampRequested++;
 		}
 		preview = _timestampReceived != _timestampRequested;
 	}
 
+	recycleSlots();
+
 	if (_showSfM || _timestampReceived == 0 || (preview && _renderSfMInMotion))
 	{
 		_pointbasedrenderer->process(_scene->proxies()->proxy(), eye, dst);
 	}
 	else
 	{
+		uploadSlot();
+		_copyRenderer->process(_imageTexture, dst);
+	}
+}
+
+void sibr::RemotePointView::recycleSlots(void)
+{
+	std::lock_guard<std::mutex> ilg(_imageDataMutex);
+	const size_t bytes = 3 * size_t(_resolution.x()) * size_t(_resolution.y());
+	for (ImageSlot & slot : _slots)
+	{
+		// Buffers are free again once the upload reading them is done.
+		if (slot.state == ImageSlot::UPLOADING)
 		{
-			std::lock_guard<std::mutex> ilg(_imageDataMutex);
-			if (_imageResize)
-			{
-				glBindTexture(GL_TEXTURE_2D, _imageTexture);
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _resolution.x(), _resolution.y(), 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-				glBindTexture(GL_TEXTURE_2D, 0);
-				_imageResize = false;
-			}
-			if (_imageDirty && _imageData.size() == 3 * _resolution.x() * _resolution.y())
+			const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			slot.state = ImageSlot::FREE;
+
+			// The upload spans the hand-off to the render thread and the GPU copy.
+			const auto now = std::chrono::steady_clock::now();
+			slot.timings[RemoteLatency::UPLOAD] = std::chrono::duration<float, std::milli>(now - slot.published).count();
+			slot.timings[RemoteLatency::TOTAL] = std::chrono::duration<float, std::milli>(now - slot.created).count();
+			_latency.record(slot.timings);
+		}
+
+		// Free buffers grow with the view, the network thread never sees them while they are reallocated.
+		if (slot.state == ImageSlot::FREE && slot.capacity < bytes)
+		{
+			if (slot.buffer)
 			{
-				glTextureSubImage2D(_imageTexture, 0, 0, 0, _resolution.x(), _resolution.y(), GL_RGB, GL_UNSIGNED_BYTE, _imageData.data());
-				_imageDirty = false;
+				glUnmapNamedBuffer(slot.buffer);
+				glDeleteBuffers(1, &slot.buffer);
 			}
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glCreateBuffers(1, &slot.buffer);
+			glNamedBufferStorage(slot.buffer, bytes, nullptr, flags);
+			slot.data = static_cast<unsigned char*>(glMapNamedBufferRange(slot.buffer, 0, bytes, flags));
+			slot.capacity = slot.data ? bytes : 0;
 		}
-		_copyRenderer->process(_imageTexture, dst);
+	}
+}
+
+void sibr::RemotePointView::uploadSlot(void)
+{
+	std::lock_guard<std::mutex> ilg(_imageDataMutex);
+	for (ImageSlot & slot : _slots)
+	{
+		if (slot.state != ImageSlot::READY)
+			continue;
+
+		// The texture follows the resolution of the received images, not the one of the view.
+		if (slot.resolution != _textureResolution)
+		{
+			glBindTexture(GL_TEXTURE_2D, _imageTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, slot.resolution.x(), slot.resolution.y(), 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			_textureResolution = slot.resolution;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		glTextureSubImage2D(_imageTexture, 0, 0, 0, slot.resolution.x(), slot.resolution.y(), GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.state = ImageSlot::UPLOADING;
 	}
 }
 
@@ -199,6 +733,62 @@ void sibr::RemotePointView::onGUI()
 		ImGui::Checkbox("Keep model alive (after training)", &_keepAlive);
 		ImGui::SliderFloat("Scaling Modifier", &_scalingModifier, 0.001f, 1.0f);
 		ImGui::SliderInt("Frame", &_frame, 0, 100);
+		float targetFps = _targetFps;
+		if (ImGui::SliderFloat("Target FPS while moving", &targetFps, 0.0f, 60.0f, targetFps > 0.0f ? "%.0f" : "off"))
+			_targetFps = targetFps;
+		if (_targetFps > 0.0f)
+		{
+			ImGui::Text("Resolution %.0f%%, %d requests in flight", 100.0f * _scale, int(_inFlight));
+		}
+		else
+		{
+			int inFlight = _inFlight;
+			if (ImGui::SliderInt("Requests in flight", &inFlight, 1, 8))
+				_inFlight = inFlight;
+		}
+		{
+			std::lock_guard<std::mutex> lg(_renderDataMutex);
+			if (ImGui::BeginCombo("Transport", _encoding.c_str()))
+			{
+				for (const char* encoding : kEncodings)
+				{
+					if (ImGui::Selectable(encoding, _encoding == encoding))
+					{
+						_encoding = encoding;
+						_framed = true;
+					}
+				}
+				ImGui::EndCombo();
+			}
+			if (_encoding == "jpeg" || _encoding == "webp")
+				ImGui::SliderInt("Quality", &_quality, 1, 100);
+		}
+		{
+			std::lock_guard<std::mutex> ilg(_imageDataMutex);
+			ImGui::Text("Last frame: %.2f MB (%.1fx), decoded in %.2f ms%s", _received / (1024.0f * 1024.0f), _ratio, _decodeMs,
+				_framed ? "" : " (raw fallback)");
+			ImGui::Text("Stale frames dropped: %d, %s requests%s", int(_dropped), _binary ? "binary" : "JSON", _shared ? ", shared memory" : "");
+			ImGui::Text("Link: %.1f MB/s, %.0f ms latency", _throughput / (1024.0f * 1024.0f), float(_rttMs));
+		}
+		if (ImGui::CollapsingHeader("Latency") && _latency.count() > 0)
+		{
+			ImGui::Text("Over the last %d frames, in ms", int(_latency.count()));
+			ImGui::Columns(4, "latency");
+			ImGui::Text("Stage"); ImGui::NextColumn();
+			ImGui::Text("p50"); ImGui::NextColumn();
+			ImGui::Text("p90"); ImGui::NextColumn();
+			ImGui::Text("p99"); ImGui::NextColumn();
+			ImGui::Separator();
+			for (int s = 0; s < RemoteLatency::STAGE_COUNT; s++)
+			{
+				const RemoteLatency::Stage stage = RemoteLatency::Stage(s);
+				ImGui::Text("%s", RemoteLatency::name(stage)); ImGui::NextColumn();
+				ImGui::Text("%.2f", _latency.percentile(stage, 0.5f)); ImGui::NextColumn();
+				ImGui::Text("%.2f", _latency.percentile(stage, 0.9f)); ImGui::NextColumn();
+				ImGui::Text("%.2f", _latency.percentile(stage, 0.99f)); ImGui::NextColumn();
+			}
+			ImGui::Columns(1);
+		}
 	}
 	ImGui::End();
 }
@@ -207,4 +797,16 @@ sibr::RemotePointView::~RemotePointView()
 {
 	keep_running = false;
 	_networkThread->join();
+	while (_decoding > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	for (ImageSlot & slot : _slots)
+	{
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		if (slot.buffer)
+		{
+			glUnmapNamedBuffer(slot.buffer);
+			glDeleteBuffers(1, &slot.buffer);
+		}
+	}
 }
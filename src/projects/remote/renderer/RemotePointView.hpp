@@ -11,6 +11,8 @@
 #pragma once
 
 # include "Config.hpp"
+# include "RemoteDecodePool.hpp"
+# include "RemoteLatency.hpp"
 # include <core/renderer/RenderMaskHolder.hpp>
 # include <core/scene/BasicIBRScene.hpp>
 # include <core/system/SimpleTimer.hpp>
@@ -19,7 +21,9 @@
 # include <core/view/ViewBase.hpp>
 # include <core/renderer/CopyRenderer.hpp>
 # include <core/renderer/PointBasedRenderer.hpp>
+# include <array>
 # include <atomic>
+# include <chrono>
 # include <mutex>
 # include <memory>
 # include <core/graphics/Texture.hpp>
@@ -39,7 +43,18 @@ namespace sibr {
 
 	public:
 
-		RemotePointView(std::string ip, uint port);
+		/** Constructor, starts the network thread.
+		 * \param ip address of the training process
+		 * \param port port of the training process
+		 * \param encoding image transport requested: raw, jpeg, webp or png
+		 * \param quality quality of jpeg and webp images
+		 * \param inFlight number of camera requests sent ahead of the received images
+		 * \param jsonRequests never switch to binary requests, even if the training side accepts them
+		 * \param targetFps frame rate to reach by reducing the resolution while moving, 0 to disable
+		 * \param sharedMemory offer shared memory images to a training process on the same host
+		 */
+		RemotePointView(std::string ip, uint port, const std::string & encoding = "raw", int quality = 85, int inFlight = 2, bool jsonRequests = false,
+			float targetFps = 0.0f, bool sharedMemory = true);
 
 		/** Replace the current scene.
 		 *\param newScene the new scene to render */
@@ -60,6 +75,9 @@ namespace sibr {
 		/** \return a reference to the scene */
 		const std::shared_ptr<sibr::BasicIBRScene> & getScene() const { return _scene; }
 
+		/** \return the latency breakdown of the displayed frames */
+		RemoteLatency & latency() { return _latency; }
+
 		virtual ~RemotePointView() override;
 
 		std::string sceneName()
@@ -100,12 +118,91 @@ namespace sibr {
 
 		void send_receive();
 
+		/** Update the resolution scale and the requests in flight from the link measurements.
+		 * \param intervalMs smoothed time between two replies
+		 * \param latencyMs smoothed round trip of a request, without its queueing
+		 */
+		void adapt(float intervalMs, float latencyMs);
+
+		/// Persistently mapped pixel buffer receiving an image from the network thread.
+		struct ImageSlot
+		{
+			enum State { FREE, WRITING, DECODING, READY, UPLOADING };
+			State state = FREE; ///< Owner of the buffer: network thread when WRITING, decode pool when DECODING, GL while UPLOADING.
+			GLuint buffer = 0; ///< Pixel unpack buffer.
+			unsigned char * data = nullptr; ///< Persistent coherent mapping.
+			size_t capacity = 0; ///< Size of the buffer, in bytes.
+			Vector2i resolution = Vector2i(0, 0); ///< Resolution of the image, when READY.
+			GLsync fence = 0; ///< Signaled once the texture upload is done.
+			std::chrono::steady_clock::time_point created; ///< Time the request of the image was built.
+			std::chrono::steady_clock::time_point published; ///< Time the image was handed to the render thread.
+			RemoteLatency::Sample timings; ///< Latencies measured by the network thread.
+		};
+
+		/** Reserve a free slot for the network thread.
+		 * \param bytes size of the image to receive
+		 * \return the slot index, or -1 if none is free and large enough
+		 */
+		int acquireSlot(size_t bytes);
+
+		/** Give a slot back without publishing it.
+		 * \param slot the slot index
+		 */
+		void releaseSlot(int slot);
+
+		/// Image received in a slot, waiting to be published.
+		struct ReceivedImage
+		{
+			int slot; ///< Slot holding the pixels.
+			uint32_t id; ///< Request id.
+			uint32_t timestamp; ///< Camera state of the request.
+			uint32_t bytes; ///< Size of the uncompressed image.
+			size_t received; ///< Bytes on the wire.
+			Vector2i resolution; ///< Image resolution.
+			std::chrono::steady_clock::time_point created; ///< Time the request was built.
+			RemoteLatency::Sample timings; ///< Latencies measured so far.
+		};
+
+		/** Hand an image to the render thread, unless a more recent one was already published.
+		 * \param image the received image
+		 */
+		void publish(const ReceivedImage & image);
+
+		/** Release the slots whose upload is done and grow the free ones to the view resolution, on the render thread. */
+		void recycleSlots(void);
+
+		/** Upload the latest received image to the texture, on the render thread. */
+		void uploadSlot(void);
+
+		std::string _encoding = "raw"; ///< Requested image transport.
+		int _quality = 85; ///< Quality of lossy encodings.
+		std::atomic<bool> _framed = true; ///< The training side answered compressed requests with framed images.
+		float _received = 0.0f; ///< Bytes of the last frame on the wire.
+		float _ratio = 1.0f; ///< Compression ratio of the last frame.
+		float _decodeMs = 0.0f; ///< Decoding time of the last frame.
+		std::atomic<int> _inFlight = 2; ///< Requests sent ahead of the received images, 1 for the lockstep protocol.
+		std::atomic<int> _dropped = 0; ///< Images superseded before being decoded.
+		bool _jsonRequests = false; ///< Keep sending JSON requests.
+		std::atomic<bool> _binary = false; ///< The training side acknowledged binary requests.
+		std::atomic<float> _targetFps = 0.0f; ///< Frame rate targeted while moving, 0 to always request full resolution.
+		std::atomic<float> _scale = 1.0f; ///< Resolution scale used while moving.
+		float _minScale = 0.25f; ///< Lowest resolution scale.
+		std::atomic<bool> _moving = false; ///< The camera moved recently.
+		std::chrono::steady_clock::time_point _lastMotion; ///< Last camera change.
+		std::atomic<float> _rttMs = 0.0f; ///< Smoothed round trip, without queueing.
+		std::atomic<float> _throughput = 0.0f; ///< Smoothed received bytes per second.
+		bool _sharedMemory = true; ///< Offer shared memory when the training side is local.
+		std::atomic<bool> _shared = false; ///< The last image was received through shared memory.
+		RemoteLatency _latency; ///< Latency breakdown of the displayed frames.
+
 		GLuint _imageTexture;
 
 		bool _renderSfMInMotion = false;
 
-		bool _imageResize = true;
-		bool _imageDirty = true;
+		Vector2i _textureResolution = Vector2i(0, 0); ///< Resolution of the image texture.
+		std::array<ImageSlot, 4> _slots; ///< Ring of received images, guarded by _imageDataMutex.
+		uint32_t _publishedId = 0; ///< One past the id of the last published image.
+		std::atomic<int> _decoding = 0; ///< Images queued in the decode pool.
 		uint32_t _timestampRequested = 1;
 		uint32_t _timestampReceived = 0;
 
@@ -113,7 +210,6 @@ namespace sibr {
 		std::mutex _imageDataMutex;
 
 		std::unique_ptr <std::thread> _networkThread;
-		std::vector<unsigned char> _imageData;
 
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< The current scene.
 		PointBasedRenderer::Ptr _pointbasedrenderer;
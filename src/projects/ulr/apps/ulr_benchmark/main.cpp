@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <core/graphics/Window.hpp>
+#include <core/graphics/GPUQuery.hpp>
+#include <core/assets/CameraRecorder.hpp>
+#include <core/system/BenchmarkReport.hpp>
+#include <core/system/SimpleTimer.hpp>
+#include <core/system/String.hpp>
+#include <core/system/Utils.hpp>
+
+#include <projects/ulr/renderer/ULRView.hpp>
+#include <projects/ulr/renderer/ULRV2View.hpp>
+#include <projects/ulr/renderer/ULRV3Renderer.hpp>
+
+#define PROGRAM_NAME "sibr_ulr_benchmark_app"
+using namespace sibr;
+
+const char* usage = ""
+"Usage: " PROGRAM_NAME " -path <dataset-path> --pathFile <camera-path> [--variants ulr_v3,ulr_v3_fast] [--warmup N] [--frames M] [--report <file-prefix>]"    	"\n"
+;
+
+/// Arguments of the benchmark.
+struct ULRBenchmarkArgs : public ULRAppArgs {
+	Arg<std::string> variants = { "variants", "ulr_v1,ulr_v2,ulr_v3,ulr_v3_fast,ulr_v3_alt", "comma separated list of the renderers to compare" };
+	Arg<int> warmup = { "warmup", 10, "number of frames rendered before measuring" };
+	Arg<int> frames = { "frames", 100, "number of measured frames, cycling along the path" };
+	Arg<std::string> report = { "report", "", "prefix of the .json and .csv reports (default: <dataset>/benchmark/ulr_benchmark)" };
+};
+
+/// ULRV3 renderer timing its depth and blending passes on the GPU.
+class TimedULRV3Renderer : public ULRV3Renderer {
+	SIBR_CLASS_PTR(TimedULRV3Renderer);
+
+public:
+
+	TimedULRV3Renderer(const std::vector<InputCamera::Ptr> & cameras, const uint w, const uint h, const std::string & fShader) :
+		ULRV3Renderer(cameras, w, h, fShader), _depthQuery(GL_TIME_ELAPSED), _blendQuery(GL_TIME_ELAPSED) {
+	}
+
+	void renderProxyDepth(const sibr::Mesh & mesh, const sibr::Camera & eye) override {
+		_depthQuery.begin();
+		ULRV3Renderer::renderProxyDepth(mesh, eye);
+		_depthQuery.end();
+	}
+
+	void renderBlending(const sibr::Camera & eye, IRenderTarget & dst, uint inputRGBHandle,
+		const sibr::Texture2DArrayLum32F::Ptr & inputDepths, bool passthroughDepth) override {
+		_blendQuery.begin();
+		ULRV3Renderer::renderBlending(eye, dst, inputRGBHandle, inputDepths, passthroughDepth);
+		_blendQuery.end();
+	}
+
+	/// \return the depth pass duration of the previous frame, in ms.
+	double depthTime() { return double(_depthQuery.value()) * 1e-6; }
+
+	/// \return the blending pass duration of the previous frame, in ms.
+	double blendTime() { return double(_blendQuery.value()) * 1e-6; }
+
+private:
+	GPUQuery _depthQuery;
+	GPUQuery _blendQuery;
+};
+
+/// Measured durations of a variant, in ms, one entry per frame.
+struct BenchmarkResult {
+	std::string name;
+	std::vector<double> depth;
+	std::vector<double> blend;
+	std::vector<double> gpu;
+	std::vector<double> frame;
+};
+
+typedef BenchmarkReport::Stats Stats;
+
+/** Write the per variant statistics and the raw frame durations.
+\param results the measured variants
+\param prefix the report files prefix
+\param dataset the dataset path
+\param renderer the GL renderer string
+\param resolution the rendering resolution
+*/
+void writeReports(const std::vector<BenchmarkResult> & results, const std::string & prefix,
+	const std::string & dataset, const std::string & renderer, const Vector2u & resolution) {
+	const std::vector<std::string> passes = { "depth", "blend", "gpu", "frame" };
+
+	std::ofstream json(prefix + ".json");
+	json << "{\n\t\"dataset\": \"" << dataset << "\",\n\t\"gpu\": \"" << renderer << "\",\n";
+	json << "\t\"resolution\": [" << resolution.x() << ", " << resolution.y() << "],\n\t\"variants\": [\n";
+	for (size_t r = 0; r < results.size(); ++r) {
+		const BenchmarkResult & res = results[r];
+		const std::vector<const std::vector<double>*> series = { &res.depth, &res.blend, &res.gpu, &res.frame };
+		json << "\t\t{\n\t\t\t\"name\": \"" << res.name << "\",\n\t\t\t\"frames\": " << res.frame.size();
+		for (size_t p = 0; p < passes.size(); ++p) {
+			if (series[p]->empty()) {
+				continue;
+			}
+			const Stats s = BenchmarkReport::stats(*series[p]);
+			json << ",\n\t\t\t\"" << passes[p] << "_ms\": { \"mean\": " << s.mean << ", \"min\": " << s.min << ", \"max\": " << s.max
+				<< ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << " }";
+		}
+		json << "\n\t\t}" << (r + 1 < results.size() ? "," : "") << "\n";
+	}
+	json << "\t]\n}\n";
+
+	// One line per measured frame, empty cells for the passes a variant does not split.
+	std::ofstream csv(prefix + ".csv");
+	csv << "variant,frame,depth_ms,blend_ms,gpu_ms,frame_ms\n";
+	for (const BenchmarkResult & res : results) {
+		for (size_t f = 0; f < res.frame.size(); ++f) {
+			csv << res.name << "," << f;
+			for (const auto * series : { &res.depth, &res.blend, &res.gpu, &res.frame }) {
+				csv << ",";
+				if (f < series->size()) {
+					csv << (*series)[f];
+				}
+			}
+			csv << "\n";
+		}
+	}
+	SIBR_LOG << "Wrote " << prefix << ".json and " << prefix << ".csv" << std::endl;
+}
+
+int main(int ac, char** av) {
+
+	// Parse Command-line Args
+	CommandLineArgs::parseMainArgs(ac, av);
+	ULRBenchmarkArgs myArgs;
+	myArgs.displayHelpIfRequired();
+
+	if (myArgs.pathFile.get().empty()) {
+		SIBR_ERR << "A camera path is required (--pathFile)." << std::endl;
+		return EXIT_FAILURE;
+	}
+	// The first frame after warm-up only provides the timings queried at the next one.
+	const int warmup = std::max(myArgs.warmup.get(), 1);
+	const int frames = std::max(myArgs.frames.get(), 1);
+
+	sibr::Window window(PROGRAM_NAME, sibr::Vector2i(50, 50), myArgs);
+
+	// Rendertargets for ULR v1 and v2, texture arrays for ULR v3.
+	BasicIBRScene::Ptr scene(new BasicIBRScene(myArgs));
+	const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
+	scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), scene->proxies(), flags, true, myArgs.force_aspect_ratio);
+
+	uint rendering_width = myArgs.rendering_size.get()[0];
+	uint rendering_height = myArgs.rendering_size.get()[1];
+	rendering_width = (rendering_width <= 0) ? scene->cameras()->inputCameras()[0]->w() : rendering_width;
+	rendering_height = (rendering_height <= 0) ? scene->cameras()->inputCameras()[0]->h() : rendering_height;
+	const Vector2u usedResolution(rendering_width, rendering_height);
+
+	sibr::CameraRecorder recorder;
+	if (!recorder.loadPath(myArgs.pathFile.get(), usedResolution.x(), usedResolution.y()) || recorder.cams().empty()) {
+		SIBR_ERR << "Unable to load the camera path " << myArgs.pathFile.get() << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::vector<Camera> & path = recorder.cams();
+	SIBR_LOG << "Benchmarking " << path.size() << " path cameras at " << usedResolution.x() << "x" << usedResolution.y()
+		<< ", " << warmup << " warm-up and " << frames << " measured frames per variant." << std::endl;
+
+	RenderTargetRGBA dst(usedResolution.x(), usedResolution.y());
+	GPUQuery gpuQuery(GL_TIME_ELAPSED);
+	std::vector<BenchmarkResult> results;
+
+	for (const std::string & name : sibr::split(myArgs.variants.get(), ',')) {
+		ViewBase::Ptr view;
+		TimedULRV3Renderer::Ptr ulr;
+		if (name == "ulr_v1") {
+			ULRView::Ptr ulrView(new ULRView(scene, usedResolution.x(), usedResolution.y()));
+			ulrView->setNumBlend(50, 50);
+			view = ulrView;
+		}
+		else if (name == "ulr_v2") {
+			ULRV2View::Ptr ulrView(new ULRV2View(scene, usedResolution.x(), usedResolution.y()));
+			ulrView->setNumBlend(40, 40);
+			ulrView->noPoissonBlend(true);
+			view = ulrView;
+		}
+		else if (name == "ulr_v3" || name == "ulr_v3_fast" || name == "ulr_v3_alt") {
+			ulr.reset(new TimedULRV3Renderer(scene->cameras()->inputCameras(), usedResolution.x(), usedResolution.y(), "ulr/" + name));
+		}
+		else {
+			SIBR_WRG << "Unknown variant " << name << ", skipping it." << std::endl;
+			continue;
+		}
+
+		BenchmarkResult result;
+		result.name = name;
+		sibr::Timer timer;
+		for (int f = 0; f < warmup + frames; ++f) {
+			const Camera & eye = path[f % path.size()];
+			timer.tic();
+			if (ulr) {
+				ulr->process(scene->proxies()->proxy(), eye, dst,
+					scene->renderTargets()->getInputRGBTextureArrayPtr(), scene->renderTargets()->getInputDepthMapArrayPtr());
+			}
+			else {
+				// Time elapsed queries can't be nested, so only the views are timed as a whole.
+				gpuQuery.begin();
+				view->onRenderIBR(dst, eye);
+				gpuQuery.end();
+			}
+			glFinish();
+			const double frameTime = timer.deltaTimeFromLastTic<Timer::micro>() * 1e-3;
+			CHECK_GL_ERROR;
+
+			// GPU queries return the previous frame durations, available since we waited.
+			if (f < warmup) {
+				continue;
+			}
+			result.frame.push_back(frameTime);
+			if (ulr) {
+				result.depth.push_back(ulr->depthTime());
+				result.blend.push_back(ulr->blendTime());
+				result.gpu.push_back(result.depth.back() + result.blend.back());
+			}
+			else {
+				result.gpu.push_back(double(gpuQuery.value()) * 1e-6);
+			}
+		}
+		const Stats gpu = BenchmarkReport::stats(result.gpu);
+		SIBR_LOG << name << ": GPU " << gpu.mean << " ms (p50 " << gpu.p50 << ", p95 " << gpu.p95 << ", p99 " << gpu.p99 << ")" << std::endl;
+		results.push_back(result);
+	}
+
+	if (results.empty()) {
+		SIBR_ERR << "No valid variant in " << myArgs.variants.get() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string prefix = myArgs.report.get();
+	if (prefix.empty()) {
+		makeDirectory(myArgs.dataset_path.get() + "/benchmark");
+		prefix = myArgs.dataset_path.get() + "/benchmark/ulr_benchmark";
+	}
+	const char * glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	writeReports(results, prefix, myArgs.dataset_path.get(), glRenderer ? glRenderer : "", usedResolution);
+
+	return EXIT_SUCCESS;
+}
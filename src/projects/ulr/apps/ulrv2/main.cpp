@@ -15,12 +15,16 @@
 #include <core/graphics/Window.hpp>
 #include <core/view/MultiViewManager.hpp>
 #include <core/system/String.hpp>
+#include <core/system/MainThreadQueue.hpp>
 
 #include "projects/ulr/renderer/ULRView.hpp"
 #include <projects/ulr/renderer/ULRV2View.hpp>
 #include <projects/ulr/renderer/ULRV3View.hpp>
 
 #include <core/renderer/DepthRenderer.hpp>
+#include <core/graphics/MeshLOD.hpp>
+#include <core/scene/ProxyMesh.hpp>
+#include <core/scene/TileManager.hpp>
 #include <core/raycaster/Raycaster.hpp>
 #include <core/view/SceneDebugView.hpp>
 
@@ -63,10 +67,105 @@ int main(int ac, char** av) {
 	// Window setup
 	sibr::Window		window(PROGRAM_NAME, sibr::Vector2i(50, 50), myArgs, getResourcesDirectory() + "/ulr/" + PROGRAM_NAME + ".ini");
 
-	BasicIBRScene::Ptr		scene(new BasicIBRScene(myArgs, true));
+	// Decode the images straight into the RGB texture array, unless another layout needs the CPU copies.
+	BasicIBRScene::SceneOptions sceneOptions;
+	sceneOptions.renderTargets = false;
+	sceneOptions.streamImages = myArgs.sparseBudget <= 0 && myArgs.bindlessBudget <= 0 && myArgs.textureCompression.get().empty() && !myArgs.force_aspect_ratio;
+	sceneOptions.keepImages = false;
+	sceneOptions.optimizeProxy = myArgs.optimizeProxy;
+	const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
+
+	// A baked bundle replaces the whole dataset loading.
+	const std::string & bundlePath = myArgs.bundle.get();
+
+	// Tiled datasets: the tiles around the viewer are loaded in the background, the closest one is rendered.
+	TileIndex tileIndex;
+	TileManager::Ptr tileManager;
+	if (myArgs.tiles) {
+		if (!tileIndex.load(myArgs.dataset_path)) {
+			SIBR_ERR << "No tile found in " << myArgs.dataset_path.get() << "." << std::endl;
+		}
+		if (!sceneOptions.streamImages || !bundlePath.empty() || myArgs.proxyLods > 0 || myArgs.masks) {
+			SIBR_ERR << "Tiles require streamed images, and no bundle, proxy levels or masks." << std::endl;
+		}
+		TileManager::Budget budget;
+		budget.maxBytes = size_t(std::max(myArgs.tileBudget.get(), 1)) << 20;
+		tileManager.reset(new TileManager(tileIndex, budget, sceneOptions, myArgs.texture_width));
+		const bool compactProxy = myArgs.compactProxy;
+		tileManager->onMeshReady([compactProxy](const BasicIBRScene::Ptr & tile) {
+			if (compactProxy && tile->proxies()->hasProxy()) {
+				tile->proxies()->proxyPtr()->vertexFormat(MeshBufferGL::VertexFormat::COMPACT);
+			}
+			tile->renderTargets()->initDepthTextureArrays(tile->cameras(), tile->proxies(), true);
+		});
+		sceneOptions.background = true;
+	}
+	// Background loading, for the streamed layout when nothing else needs the proxy or the images at startup.
+	else if (myArgs.backgroundLoad) {
+		sceneOptions.background = sceneOptions.streamImages && bundlePath.empty() && myArgs.proxyLods <= 0 && !myArgs.masks
+			&& !myArgs.offscreen && myArgs.pathFile.get().empty();
+		if (!sceneOptions.background) {
+			SIBR_WRG << "Background loading requires streamed images, and no bundle, proxy levels, masks or offline path; loading in the foreground." << std::endl;
+		}
+	}
+	BasicIBRScene::Ptr		scene(new BasicIBRScene());
+	const bool fromBundle = !bundlePath.empty() && scene->createFromBundle(bundlePath, flags);
+	if (tileManager) {
+		// Start with the first tile having cameras, the view switches to the closest tile once loaded.
+		scene.reset();
+		for (int tid = 0; tid < int(tileIndex.tiles().size()) && !scene; ++tid) {
+			scene = tileManager->load(tid);
+		}
+		if (!scene) {
+			SIBR_ERR << "No tile has cameras in " << myArgs.dataset_path.get() << "." << std::endl;
+		}
+	}
+	else if (!fromBundle) {
+		scene.reset(new BasicIBRScene(myArgs, sceneOptions));
+	}
+	if (myArgs.compactProxy && scene->proxies()->hasProxy()) {
+		scene->proxies()->proxyPtr()->vertexFormat(MeshBufferGL::VertexFormat::COMPACT);
+	}
+	// The depth maps need the proxy, they are rendered on the main thread once it is loaded.
+	std::future<void> backgroundDepthMaps;
+	if (sceneOptions.background && !tileManager) {
+		const bool compactProxy = myArgs.compactProxy;
+		backgroundDepthMaps = std::async(std::launch::async, [scene, compactProxy]() {
+			if (scene->meshReady().valid()) {
+				scene->meshReady().wait();
+			}
+			MainThreadQueue::shared().post([scene, compactProxy]() {
+				if (compactProxy && scene->proxies()->hasProxy()) {
+					scene->proxies()->proxyPtr()->vertexFormat(MeshBufferGL::VertexFormat::COMPACT);
+				}
+				scene->renderTargets()->initDepthTextureArrays(scene->cameras(), scene->proxies(), true);
+			});
+		});
+	}
+
+	// Simplified proxies, for the novel views and optionally for the input depth maps.
+	MeshLOD::Ptr proxyLODs;
+	IProxyMesh::Ptr depthProxies = scene->proxies();
+	if (myArgs.proxyLods > 0 && scene->proxies()->hasProxy()) {
+		const std::string lodPath = myArgs.dataset_path.get() + "/cache/proxy_lods_" + std::to_string(myArgs.proxyLods.get()) + ".slod";
+		proxyLODs = MeshLOD::createCached(scene->proxies()->proxyPtr(), lodPath, scene->data()->meshPath(), uint(myArgs.proxyLods.get()) + 1);
+		if (myArgs.compactProxy) {
+			for (size_t l = 1; l < proxyLODs->levelCount(); ++l) {
+				proxyLODs->levelPtr(l)->vertexFormat(MeshBufferGL::VertexFormat::COMPACT);
+			}
+		}
+		const size_t depthLevel = std::min(size_t(std::max(myArgs.depthLod.get(), 0)), proxyLODs->levelCount() - 1);
+		if (depthLevel > 0) {
+			ProxyMesh::Ptr depthProxy(new ProxyMesh());
+			depthProxy->replaceProxyPtr(proxyLODs->levelPtr(depthLevel));
+			depthProxies = depthProxy;
+			if (fromBundle) {
+				SIBR_WRG << "The input depth maps come from the bundle, depth-lod is ignored." << std::endl;
+			}
+		}
+	}
 
 	// Setup the scene: load the proxy, create the texture arrays.
-	const uint flags = SIBR_GPU_LINEAR_SAMPLING | SIBR_FLIP_TEXTURE;
 
 	// Fix rendering aspect ratio if user provided rendering size
 	uint scene_width = scene->cameras()->inputCameras()[0]->w();
@@ -97,10 +196,57 @@ int main(int ac, char** av) {
 	const unsigned int sceneResHeight = usedResolution.y();
 
 	
-	scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), scene->proxies(), flags, true, myArgs.force_aspect_ratio);
+	if (fromBundle) {
+		// The arrays come from the bundle.
+	}
+	else if (sceneOptions.background) {
+		// Rendered once the proxy is loaded, see above.
+	}
+	else if (sceneOptions.streamImages) {
+		scene->renderTargets()->initDepthTextureArrays(scene->cameras(), depthProxies, true);
+	}
+	else if (myArgs.bindlessBudget > 0 && BindlessTextureSet::isSupported()) {
+		const size_t budget = size_t(myArgs.bindlessBudget.get()) << 20;
+		scene->renderTargets()->initBindlessRGBandDepthTextureArrays(scene->cameras(), scene->images(), depthProxies, flags, budget, true, myArgs.force_aspect_ratio);
+	}
+	else if (myArgs.sparseBudget > 0 && SparseTextureArray::isSupported()) {
+		const size_t budget = size_t(myArgs.sparseBudget.get()) << 20;
+		scene->renderTargets()->initSparseRGBandDepthTextureArrays(scene->cameras(), scene->images(), depthProxies, flags, budget, true, myArgs.force_aspect_ratio);
+	}
+	else {
+		if (myArgs.sparseBudget > 0) {
+			SIBR_WRG << "Sparse textures are not supported, using resized texture arrays." << std::endl;
+		}
+		if (myArgs.bindlessBudget > 0) {
+			SIBR_WRG << "Bindless textures are not supported, using resized texture arrays." << std::endl;
+		}
+		// Block compressed input images, cached next to the dataset.
+		uint compression = 0;
+		std::string cachePath;
+		const std::string & format = myArgs.textureCompression.get();
+		if (format == "bc7") {
+			compression = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		else if (format == "bc1") {
+			compression = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		}
+		else if (!format.empty()) {
+			SIBR_WRG << "Unknown texture compression " << format << ", expected bc7 or bc1." << std::endl;
+		}
+		if (compression != 0) {
+			cachePath = myArgs.dataset_path.get() + "/cache/input_rgbs_" + format + ".sctx";
+		}
+		scene->renderTargets()->initRGBandDepthTextureArrays(scene->cameras(), scene->images(), depthProxies, flags, true, myArgs.force_aspect_ratio, compression, cachePath);
+	}
+	if (!bundlePath.empty() && !fromBundle) {
+		scene->saveBundle(bundlePath);
+	}
 
 	// Create the ULR view.
 	ULRV3View::Ptr	ulrView(new ULRV3View(scene, sceneResWidth, sceneResHeight));
+	if (proxyLODs) {
+		ulrView->setProxyLODs(proxyLODs, myArgs.lodPixelError);
+	}
 
 	// Check if masks are provided and enabled.
 	if (myArgs.masks) {
@@ -118,10 +264,8 @@ int main(int ac, char** av) {
 		ulrView->getULRrenderer()->useMasks() = true;
 	}
 
-	// Raycaster.
-	std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-	raycaster->init();
-	raycaster->addMesh(scene->proxies()->proxy());
+	// Raycaster, not available for the picking until a proxy loaded in the background is ready.
+	std::shared_ptr<sibr::Raycaster> raycaster = sceneOptions.background ? nullptr : sibr::Raycaster::shared(scene->proxies()->proxy());
 
 	// Camera handler for main view.
 	sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
@@ -156,6 +300,16 @@ int main(int ac, char** av) {
 			window.close();
 		}
 
+		if (tileManager) {
+			const Vector3f position = generalCamera->getCamera().position();
+			tileManager->update(position);
+			const BasicIBRScene::Ptr nearest = tileManager->nearestReadyScene(position);
+			if (nearest && nearest != scene) {
+				scene = nearest;
+				ulrView->setScene(scene);
+			}
+		}
+
 		multiViewManager.onUpdate(sibr::Input::global());
 		multiViewManager.onRender(window);
 
@@ -198,9 +352,7 @@ int legacyV2main(ULRAppArgs & myArgs)
 		ulrView->setNumBlend(40, 40);
 
 		// Raycaster.
-		std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-		raycaster->init();
-		raycaster->addMesh(scene->proxies()->proxy());
+		std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 		// Camera handler for main view.
 		sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
@@ -367,9 +519,7 @@ int legacyV1main(ULRAppArgs & myArgs)
 		ulrView->setNumBlend(50, 50);
 
 		// Raycaster.
-		std::shared_ptr<sibr::Raycaster> raycaster = std::make_shared<sibr::Raycaster>();
-		raycaster->init();
-		raycaster->addMesh(scene->proxies()->proxy());
+		std::shared_ptr<sibr::Raycaster> raycaster = sibr::Raycaster::shared(scene->proxies()->proxy());
 
 		// Camera handler for main view.
 		sibr::InteractiveCameraHandler::Ptr generalCamera(new InteractiveCameraHandler());
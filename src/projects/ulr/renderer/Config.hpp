@@ -50,6 +50,18 @@ namespace sibr {
 		Arg<bool> invert = { "invert", "invert the masks" };
 		Arg<bool> alphas = { "alphas", "" };
 		Arg<bool> poisson = { "poisson-blend", "apply Poisson-filling to the ULR result" };
+		Arg<std::string> textureCompression = { "texture-compression", "", "encode the input images once, bc7 or bc1 (previews), and cache them in the dataset folder" };
+		Arg<int> sparseBudget = { "sparse-textures", 0, "page the full resolution input images in on demand, under this VRAM budget in MB (0: disabled)" };
+		Arg<int> bindlessBudget = { "bindless-textures", 0, "keep each input image at its native size in a bindless texture, under this VRAM budget in MB (0: disabled)" };
+		ArgSwitch compactProxy = { "compact-proxy", false, "store the proxy vertices with unorm8 colors, half float UVs and packed normals" };
+		ArgSwitch optimizeProxy = { "optimize-proxy", false, "reorder the proxy triangles and vertices for the GPU vertex cache after loading" };
+		Arg<int> proxyLods = { "proxy-lods", 0, "number of simplified proxy levels picked by projected size, cached in the dataset folder (0: disabled)" };
+		Arg<int> depthLod = { "depth-lod", 0, "proxy level used to render the input depth maps, requires proxy-lods" };
+		Arg<float> lodPixelError = { "lod-pixel-error", 1.0f, "maximum on-screen error of the selected proxy level, in pixels" };
+		Arg<std::string> bundle = { "bundle", "", "baked scene file, loaded instead of the dataset when valid, written after a regular load otherwise" };
+		ArgSwitch backgroundLoad = { "background-load", false, "open the window once the cameras are parsed, load the proxy and stream the images in the background" };
+		ArgSwitch tiles = { "tiles", false, "the dataset is split in tiles (see sibr::TileIndex), load the ones around the viewer and render the closest" };
+		Arg<int> tileBudget = { "tile-budget", 2048, "estimated memory of the loaded tiles, in MB" };
 	};
 
 }
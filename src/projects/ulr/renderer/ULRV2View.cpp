@@ -43,6 +43,7 @@ ULRV2View::ULRV2View( const sibr::BasicIBRScene::Ptr& ibrScene, uint render_w, u
 	_poisson.reset(new PoissonRenderer(w,h));
 	_poisson->enableFix() = true;
 	_inputRTs = ibrScene->renderTargets()->inputImagesRT();
+	_cameraIndex.reset(new CameraIndex(ibrScene->cameras()->inputCameras()));
 
 	testAltlULRShader = false;
 }
@@ -225,35 +226,14 @@ std::vector<uint> ULRV2View::chosen_cameras_angdist(const sibr::Camera & eye)
 	const auto & cams = _scene->cameras()->inputCameras();
 	std::vector<uint> out;
 
-	// sort angle / dist combined
-	struct camAng
-	{
-		camAng() {}
-		camAng(float a, float d, int i) : ang(a), dist(d), id(i) {}
-		float ang, dist;
-		int id;
-		static bool compare(const camAng & a, const camAng & b) { return a.ang / a.dist > b.ang / b.dist;  }
-	};
-
 	int total_size = _numAnglUlr + _numDistUlr;
 
-	std::vector<camAng> allAng;
-	for (int id = 0; id < (int)cams.size(); ++id) {
-		const auto & cam = *cams[id];
-        float angle = sibr::dot(cam.dir(),eye.dir());
-		// reject back facing 
-		if( angle > 0.001 && cam.isActive()) {
-			float dist =  (cam.position() - eye.position()).norm();
-			allAng.push_back(camAng(angle, dist, id));		
-		}
-	}
+	// sort angle / dist combined, only the cameras close enough to compete are visited.
+	out = _cameraIndex->selectAngleDistance(eye, std::max(total_size, 0));
 
 	std::vector<bool> wasChosen(cams.size(), false);
-
-	std::sort(allAng.begin(), allAng.end(), camAng::compare);
-	for (int id = 0; id < std::min((int)allAng.size(), total_size); ++id) {
-		out.push_back(allAng[id].id);
-		wasChosen[allAng[id].id] = true;
+	for (const uint id : out) {
+		wasChosen[id] = true;
 	}
 
 	for (int id = 0; id < (int)cams.size(); ++id) {
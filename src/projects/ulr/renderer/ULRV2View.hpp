@@ -20,6 +20,7 @@
 # include <core/renderer/CopyRenderer.hpp>
 # include <projects/ulr/renderer/ULRV2Renderer.hpp>
 # include <core/renderer/PoissonRenderer.hpp>
+# include <core/raycaster/CameraIndex.hpp>
 
 namespace sibr { 
 
@@ -158,6 +159,7 @@ namespace sibr {
 		std::shared_ptr<sibr::BasicIBRScene> _scene; ///< the current scene.
 		std::shared_ptr<sibr::Mesh>	_altMesh; ///< For the cases when using a different mesh than the scene
 		int _numDistUlr, _numAnglUlr; ///< Number of cameras to select for each criterion.
+		CameraIndex::Ptr _cameraIndex; ///< Spatial index of the input cameras, for the selection.
 
 		std::vector<std::shared_ptr<RenderTargetRGBA32F> > _inputRTs; ///< input RTs -- usually RGB but can be alpha or other
 
@@ -11,6 +11,150 @@
 
 
 #include <projects/ulr/renderer/ULRV3Renderer.hpp>
+#include <core/graphics/RenderTargetPool.hpp>
+#include <core/graphics/FrameProfiler.hpp>
+#include <core/graphics/StreamingBuffer.hpp>
+#include <cstring>
+#include <algorithm>
+
+// Per tile selection of the candidate cameras: the proxy points of the tile are reduced to their
+// centroid and bounding box, every camera seeing the box is scored with the ULR penalty at the
+// centroid, and the TILE_CAMS best ones are kept. Occlusions are still resolved per pixel.
+static const char* tileSelectionSrc = R"(
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+#define THREADS (TILE_SIZE * TILE_SIZE)
+#define INFTY_W 100000.0
+#define BETA 	1e-1  	/* Relative importance of resolution penalty */
+
+layout(binding = 0) uniform sampler2D proxy;
+
+struct CameraInfos
+{
+  mat4 vp;
+  vec3 pos;
+  int selected;
+  vec3 dir;
+};
+layout(std430, binding = 4) readonly buffer InputCameras
+{
+  CameraInfos cameras[];
+};
+
+layout(r32i, binding = 0) uniform writeonly iimage2D tile_cams;
+
+uniform int camsCount;
+uniform vec3 ncam_pos;
+
+shared vec4 sums[THREADS];
+shared vec3 mins[THREADS];
+shared vec3 maxs[THREADS];
+shared float bestScores[THREADS];
+shared int bestCams[THREADS];
+shared uint bestThreads[THREADS];
+
+bool sees(int i, vec3 p) {
+  vec4 p1 = cameras[i].vp * vec4(p, 1.0);
+  vec2 ndc = p1.xy / p1.w;
+  return p1.w > 0.0 && all(lessThanEqual(abs(ndc), vec2(1.0)));
+}
+
+void main() {
+  const uint tid = gl_LocalInvocationIndex;
+  const ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  const ivec2 size = textureSize(proxy, 0);
+
+  vec4 point = vec4(0.0, 0.0, 0.0, 1.0);
+  if (all(lessThan(pixel, size))) {
+    point = texelFetch(proxy, pixel, 0);
+  }
+  const bool valid = point.w < 1.0;
+  sums[tid] = valid ? vec4(point.xyz, 1.0) : vec4(0.0);
+  mins[tid] = valid ? point.xyz : vec3(INFTY_W);
+  maxs[tid] = valid ? point.xyz : vec3(-INFTY_W);
+  barrier();
+  for (uint stride = THREADS / 2; stride > 0; stride /= 2) {
+    if (tid < stride) {
+      sums[tid] += sums[tid + stride];
+      mins[tid] = min(mins[tid], mins[tid + stride]);
+      maxs[tid] = max(maxs[tid], maxs[tid + stride]);
+    }
+    barrier();
+  }
+
+  const ivec2 tile = ivec2(gl_WorkGroupID.xy);
+  if (sums[0].w == 0.0) {
+    // Nothing to shade in this tile.
+    if (tid < TILE_CAMS) {
+      imageStore(tile_cams, ivec2(tile.x * TILE_CAMS + int(tid), tile.y), ivec4(-1));
+    }
+    return;
+  }
+
+  const vec3 center = sums[0].xyz / sums[0].w;
+  const vec3 boxMin = mins[0];
+  const vec3 boxMax = maxs[0];
+
+  // Each thread keeps the best candidates among its cameras, sorted by score.
+  float localScores[TILE_CAMS];
+  int localCams[TILE_CAMS];
+  for (int k = 0; k < TILE_CAMS; k++) {
+    localScores[k] = INFTY_W;
+    localCams[k] = -1;
+  }
+  for (int i = int(tid); i < camsCount; i += THREADS) {
+    if (cameras[i].selected == 0) {
+      continue;
+    }
+    bool visible = sees(i, center);
+    for (int c = 0; c < 8 && !visible; c++) {
+      visible = sees(i, mix(boxMin, boxMax, vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1)));
+    }
+    if (!visible) {
+      continue;
+    }
+    vec3 v1 = center - cameras[i].pos;
+    vec3 v2 = center - ncam_pos;
+    float dist_i2p = length(v1);
+    float dist_n2p = length(v2);
+    float penalty_ang = max(0.0001, acos(clamp(dot(v1, v2) / (dist_i2p * dist_n2p), -1.0, 1.0)));
+    float penalty_res = max(0.0001, (dist_i2p - dist_n2p) / dist_i2p);
+    float score = penalty_ang + BETA * penalty_res;
+    for (int k = TILE_CAMS - 1; k >= 0 && score < localScores[k]; k--) {
+      if (k + 1 < TILE_CAMS) {
+        localScores[k + 1] = localScores[k];
+        localCams[k + 1] = localCams[k];
+      }
+      localScores[k] = score;
+      localCams[k] = i;
+    }
+  }
+
+  // Merge the sorted lists of the threads, one arg min reduction per kept camera.
+  int head = 0;
+  for (int k = 0; k < TILE_CAMS; k++) {
+    bestScores[tid] = head < TILE_CAMS ? localScores[head] : INFTY_W;
+    bestCams[tid] = head < TILE_CAMS ? localCams[head] : -1;
+    bestThreads[tid] = tid;
+    barrier();
+    for (uint stride = THREADS / 2; stride > 0; stride /= 2) {
+      if (tid < stride && bestScores[tid + stride] < bestScores[tid]) {
+        bestScores[tid] = bestScores[tid + stride];
+        bestCams[tid] = bestCams[tid + stride];
+        bestThreads[tid] = bestThreads[tid + stride];
+      }
+      barrier();
+    }
+    if (tid == 0) {
+      imageStore(tile_cams, ivec2(tile.x * TILE_CAMS + k, tile.y), ivec4(bestCams[0]));
+    }
+    if (tid == bestThreads[0] && bestCams[0] >= 0) {
+      head++;
+    }
+    barrier();
+  }
+}
+)";
 
 
 
@@ -19,62 +163,114 @@ sibr::ULRV3Renderer::ULRV3Renderer(const std::vector<InputCamera::Ptr> & cameras
 	_backFaceCulling = facecull;
 	fragString = fShader;
 	vertexString = vShader;
-	_maxNumCams = cameras.size();
-	_camsCount = int(_maxNumCams);
-
-	// Populate the cameraInfos array (will be uploaded to the GPU).
-	_cameraInfos.clear();
-	_cameraInfos.resize(_maxNumCams);
-	for (size_t i = 0; i < _maxNumCams; ++i) {
-		const auto & cam = *cameras[i];
-		_cameraInfos[i].vp = cam.viewproj();
-		_cameraInfos[i].pos = cam.position();
-		_cameraInfos[i].dir = cam.dir();
-		_cameraInfos[i].selected = cam.isActive();
-	}
 
 	// Compute the max number of cameras allowed.
 	GLint maxBlockSize = 0, maxSlicesSize = 0;
-	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+	glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
 	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxSlicesSize);
-	// For each camera we store a matrix, 2 vecs3, 2 floats (including padding).
-	const unsigned int bytesPerCamera = 4 * (16 + 2 * 3 + 2);
-	const unsigned int maxCamerasAllowed = std::min((unsigned int)maxSlicesSize, (unsigned int)(maxBlockSize / bytesPerCamera));
-	std::cout << "[ULRV3Renderer] " << "MAX_UNIFORM_BLOCK_SIZE: " << maxBlockSize << ", MAX_ARRAY_TEXTURE_LAYERS: " << maxSlicesSize << ", meaning at most " << maxCamerasAllowed << " cameras." << std::endl;
-
-	// Create UBO.
-	_uboIndex = 0;
-	glGenBuffers(1, &_uboIndex);
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUBOInfos)*_maxNumCams, &_cameraInfos[0], GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	const unsigned int maxCamerasAllowed = std::min((unsigned int)maxSlicesSize, (unsigned int)(maxBlockSize / sizeof(CameraUBOInfos)));
+	std::cout << "[ULRV3Renderer] " << "MAX_SHADER_STORAGE_BLOCK_SIZE: " << maxBlockSize << ", MAX_ARRAY_TEXTURE_LAYERS: " << maxSlicesSize << ", meaning at most " << maxCamerasAllowed << " cameras." << std::endl;
+
+	// Upload the cameras to the storage buffer.
+	setCameras(cameras);
 
 	// Setup shaders and uniforms.
 	setupShaders(fragString, vertexString);
 
 	// Create the intermediate rendertarget.
-	_depthRT.reset(new sibr::RenderTargetRGBA32F(w, h));
+	_depthRT = RenderTargetPool::global().acquire<float, 4>(w, h);
 
 	CHECK_GL_ERROR;
 }
 
 
+sibr::ULRV3Renderer::~ULRV3Renderer()
+{
+	if (_camerasBuffer) {
+		glDeleteBuffers(1, &_camerasBuffer);
+	}
+	if (_tilesProgram)
+		GLState::deleteProgram(_tilesProgram);
+	if (_tilesTexture)
+		glDeleteTextures(1, &_tilesTexture);
+	if (_edgesTexture)
+		glDeleteTextures(1, &_edgesTexture);
+}
+
 void sibr::ULRV3Renderer::setupShaders(const std::string & fShader, const std::string & vShader)
 {
-	// Create shaders.
-	std::cout << "[ULRV3Renderer] Setting up shaders for " << _maxNumCams << " cameras." << std::endl;
+	fragString = fShader;
+	vertexString = vShader;
+
+	// Create shaders, they don't depend on the number of cameras.
+	std::cout << "[ULRV3Renderer] Setting up shaders." << std::endl;
 	GLShader::Define::List defines;
-	defines.emplace_back("NUM_CAMS", _maxNumCams);
 	defines.emplace_back("ULR_STREAMING", 0);
-
-	_ulrShader.init("ULRV3",
+	defines.emplace_back("ULR_TILES", _tileCams > 0 ? 1 : 0);
+	defines.emplace_back("TILE_CAMS", std::max(_tileCams, 1));
+	defines.emplace_back("ULR_VIRTUAL", _sparseTextures ? 1 : 0);
+	defines.emplace_back("ULR_BINDLESS", _bindlessTextures ? 1 : 0);
+	defines.emplace_back("ULR_TEMPORAL", _temporal ? 1 : 0);
+
+	// Both programs compile in the background, uniforms are bound once they are linked.
+	_ulrShader.initDeferred("ULRV3",
 		sibr::loadFile(sibr::getShadersDirectory("") + "/" + vShader + ".vert"),
 		sibr::loadFile(sibr::getShadersDirectory("") + "/" + fShader + ".frag", defines));
-	_depthShader.init("ULRV3Depth",
+	_depthShader.initDeferred("ULRV3Depth",
 		sibr::loadFile(sibr::getShadersDirectory("ulr") + "/ulr_intersect.vert"),
 		sibr::loadFile(sibr::getShadersDirectory("ulr") + "/ulr_intersect.frag", defines));
+	_uniformsPending = true;
+	_historyValid = false;
 
-	// Setup uniforms.
+	// Tile selection pre-pass.
+	if (_tilesProgram) {
+		GLState::deleteProgram(_tilesProgram);
+		_tilesProgram = 0;
+	}
+	if (_tileCams > 0) {
+		const std::string source = "#version 430\n#define TILE_CAMS " + std::to_string(_tileCams) + "\n#define TILE_SIZE " + std::to_string(tileSize) + "\n" + tileSelectionSrc;
+		const char* sourcePtr = source.c_str();
+		GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shader, 1, &sourcePtr, nullptr);
+		glCompileShader(shader);
+		GLint compiled = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+		if (!compiled) {
+			char log[4096];
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			SIBR_WRG << "[ULRV3Renderer] Unable to compile the tile selection, using all cameras: " << log << std::endl;
+			glDeleteShader(shader);
+			_tileCams = 0;
+			setupShaders(fShader, vShader);
+			return;
+		}
+		_tilesProgram = glCreateProgram();
+		glAttachShader(_tilesProgram, shader);
+		glLinkProgram(_tilesProgram);
+		glDeleteShader(shader);
+	}
+
+	CHECK_GL_ERROR;
+}
+
+bool sibr::ULRV3Renderer::shadersReady()
+{
+	if (!_uniformsPending) {
+		return true;
+	}
+	// Poll both programs, so that neither blocks while the other is still compiling.
+	const bool ulrLinked = _ulrShader.isLinked();
+	const bool depthLinked = _depthShader.isLinked();
+	if (!ulrLinked || !depthLinked) {
+		return false;
+	}
+	setupUniforms();
+	return true;
+}
+
+void sibr::ULRV3Renderer::setupUniforms()
+{
+	_uniformsPending = false;
 	_nCamProj.init(_depthShader, "proj");
 	_nCamPos.init(_ulrShader, "ncam_pos");
 	_occTest.init(_ulrShader, "occ_test");
@@ -88,8 +284,165 @@ void sibr::ULRV3Renderer::setupShaders(const std::string & fShader, const std::s
 	_winnerTakesAll.init(_ulrShader, "winner_takes_all");
 	_camsCount.init(_ulrShader, "camsCount");
 	_gammaCorrection.init(_ulrShader, "gammaCorrection");
+	_useHistory.init(_ulrShader, "useHistory");
+	_historyViewProj.init(_ulrShader, "historyViewProj");
+	_historyFrame.init(_ulrShader, "historyFrame");
+	_historyRefresh.init(_ulrShader, "historyRefresh");
+	_historyThreshold.init(_ulrShader, "historyThreshold");
+	_refineEdges.init(_ulrShader, "refineEdges");
+}
 
-	CHECK_GL_ERROR;
+void sibr::ULRV3Renderer::tiledSelection(int cams)
+{
+	cams = std::max(cams, 0);
+	if (cams == _tileCams) {
+		return;
+	}
+	_tileCams = cams;
+	setupShaders(fragString, vertexString);
+}
+
+void sibr::ULRV3Renderer::reducedBlending(int factor)
+{
+	_blendScale = factor <= 1 ? 1 : (factor < 4 ? 2 : 4);
+	if (_blendScale == 1) {
+		_reducedRT.reset();
+	}
+}
+
+void sibr::ULRV3Renderer::temporal(bool enable)
+{
+	if (enable == _temporal) {
+		return;
+	}
+	_temporal = enable;
+	if (!_temporal) {
+		_historyColor.reset();
+		_historyPositions.reset();
+	}
+	setupShaders(fragString, vertexString);
+}
+
+void sibr::ULRV3Renderer::updateHistory(const sibr::Camera & eye, IRenderTarget & dst)
+{
+	if (!_historyColor || _historyColor->w() != dst.w() || _historyColor->h() != dst.h()) {
+		_historyColor = RenderTargetPool::global().acquire<unsigned char, 4>(dst.w(), dst.h());
+	}
+	if (!_historyPositions || _historyPositions->w() != _depthRT->w() || _historyPositions->h() != _depthRT->h()) {
+		_historyPositions = RenderTargetPool::global().acquire<float, 4>(_depthRT->w(), _depthRT->h());
+	}
+	glBlitNamedFramebuffer(dst.fbo(), _historyColor->fbo(),
+		0, 0, dst.w(), dst.h(),
+		0, 0, dst.w(), dst.h(),
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBlitNamedFramebuffer(_depthRT->fbo(), _historyPositions->fbo(),
+		0, 0, _depthRT->w(), _depthRT->h(),
+		0, 0, _depthRT->w(), _depthRT->h(),
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	_historyViewProj.get() = eye.viewproj();
+	_historyFrame.get() = (_historyFrame.get() + 1) % 1024;
+	_historyValid = true;
+}
+
+void sibr::ULRV3Renderer::sparseTextures(const SparseTextureArray::Ptr & textures)
+{
+	const bool recompile = bool(textures) != bool(_sparseTextures);
+	_sparseTextures = textures;
+	if (recompile) {
+		setupShaders(fragString, vertexString);
+	}
+}
+
+void sibr::ULRV3Renderer::bindlessTextures(const BindlessTextureSet::Ptr & textures)
+{
+	const bool recompile = bool(textures) != bool(_bindlessTextures);
+	_bindlessTextures = textures;
+	if (recompile) {
+		setupShaders(fragString, vertexString);
+	}
+}
+
+void sibr::ULRV3Renderer::updateBindlessResidency(const sibr::Camera & eye)
+{
+	// Cameras close to the novel view and looking the same way get the highest weights.
+	// Per-frame temporaries live in the frame arena.
+	FrameVector<int> selected(std::min(_cameraInfos.size(), _bindlessTextures->size()), 0, &FrameArena::frame());
+	for (size_t i = 0; i < selected.size(); ++i) {
+		selected[i] = _cameraInfos[i].selected;
+	}
+	const FrameVector<uint> ranked = rankCameras(eye, selected.data(), selected.size());
+	_bindlessTextures->update(ranked.data(), ranked.size());
+}
+
+sibr::FrameVector<uint> sibr::ULRV3Renderer::rankCameras(const sibr::Camera & eye, const int * selected, size_t count) const
+{
+	const Vector3f eyePos = eye.position();
+	const Vector3f eyeDir = eye.dir();
+	FrameVector<std::pair<float, uint>> ranked(&FrameArena::frame());
+	ranked.reserve(count);
+	for (size_t i = 0; i < count && i < _cameraInfos.size(); ++i) {
+		if (selected[i] == 0) {
+			continue;
+		}
+		const float distance = (_cameraInfos[i].pos - eyePos).norm();
+		ranked.emplace_back(distance * (2.0f - _cameraInfos[i].dir.dot(eyeDir)), uint(i));
+	}
+	std::sort(ranked.begin(), ranked.end());
+	FrameVector<uint> ids(ranked.size(), 0, &FrameArena::frame());
+	for (size_t i = 0; i < ranked.size(); ++i) {
+		ids[i] = ranked[i].second;
+	}
+	return ids;
+}
+
+void sibr::ULRV3Renderer::applyCameraBudget(const sibr::Camera & eye)
+{
+	if (_requested.size() != _cameraInfos.size()) {
+		return;
+	}
+	const size_t requestedCount = size_t(std::count(_requested.begin(), _requested.end(), 1));
+	if (_cameraBudget <= 0 || requestedCount <= size_t(_cameraBudget)) {
+		writeSelection(_requested.data());
+		return;
+	}
+	const FrameVector<uint> ranked = rankCameras(eye, _requested.data(), _requested.size());
+	FrameVector<int> selected(_cameraInfos.size(), 0, &FrameArena::frame());
+	for (size_t i = 0; i < size_t(_cameraBudget); ++i) {
+		selected[ranked[i]] = 1;
+	}
+	writeSelection(selected.data());
+}
+
+void sibr::ULRV3Renderer::renderTileSelection(const sibr::Camera & eye)
+{
+	// One texel per candidate, TILE_CAMS consecutive texels per tile.
+	const int tilesX = (int(_depthRT->w()) + tileSize - 1) / tileSize;
+	const int tilesY = (int(_depthRT->h()) + tileSize - 1) / tileSize;
+	if (!_tilesTexture || tilesX * _tileCams != _tilesSize.x() || tilesY != _tilesSize.y()) {
+		if (_tilesTexture) {
+			glDeleteTextures(1, &_tilesTexture);
+		}
+		glCreateTextures(GL_TEXTURE_2D, 1, &_tilesTexture);
+		glTextureStorage2D(_tilesTexture, 1, GL_R32I, tilesX * _tileCams, tilesY);
+		glTextureParameteri(_tilesTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(_tilesTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		_tilesSize = Vector2i(tilesX * _tileCams, tilesY);
+	}
+
+	GLState::useProgram(_tilesProgram);
+	glUniform1i(glGetUniformLocation(_tilesProgram, "camsCount"), _camsCount.get());
+	const Vector3f eyePos = eye.position();
+	glUniform3f(glGetUniformLocation(_tilesProgram, "ncam_pos"), eyePos.x(), eyePos.y(), eyePos.z());
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, _depthRT->handle());
+	uploadCameras();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _camerasBuffer);
+	glBindImageTexture(0, _tilesTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32I);
+
+	glDispatchCompute(tilesX, tilesY, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	GLState::useProgram(0);
 }
 
 void sibr::ULRV3Renderer::process(
@@ -112,11 +465,35 @@ void sibr::ULRV3Renderer::process(
 	const sibr::Texture2DArrayLum32F::Ptr & inputDepths,
 	bool passthroughDepth
 ) {
+	SIBR_PROFILE_GPU("ULRV3Renderer");
+	// Callers that did not poll shadersReady() wait for the compilation here.
+	if (_uniformsPending) {
+		_ulrShader.finish();
+		_depthShader.finish();
+		setupUniforms();
+	}
+	applyCameraBudget(eye);
 	if (_profiling) {
 		_depthPassTimer.tic();
 	}
-	// Render the proxy positions in world space.
-	renderProxyDepth(mesh, eye);
+	// Render the proxy positions in world space, unless they are still valid.
+	_depthCached = _cacheDepth && proxyDepthUpToDate(mesh, eye);
+	if (_depthCached) {
+		++_depthHits;
+	}
+	else {
+		renderProxyDepth(mesh, eye);
+		_depthValid = true;
+		_depthMesh = &mesh;
+		_depthVertices = mesh.vertices().data();
+		_depthVertexCount = mesh.vertices().size();
+		_depthTriangleCount = mesh.triangles().size();
+		_depthViewProj = eye.viewproj();
+		_depthCulling = _backFaceCulling;
+	}
+	if (_tileCams > 0) {
+		renderTileSelection(eye);
+	}
 	if (_profiling) {
 		glFinish();
 		//std::cout << "\nDepth Pass: " << _depthPassTimer.deltaTimeFromLastTic() << " ms" << std::endl;
@@ -134,20 +511,81 @@ void sibr::ULRV3Renderer::process(
 	}
 }
 
-void sibr::ULRV3Renderer::updateCameras(const std::vector<uint> & camIds) {
-	// Reset all cameras.
-	for(auto & caminfos : _cameraInfos) {
-		caminfos.selected = 0;
+bool sibr::ULRV3Renderer::proxyDepthUpToDate(const sibr::Mesh & mesh, const sibr::Camera & eye) const {
+	// Edits keeping the same storage and counts are not detected, see invalidateProxyDepth.
+	return _depthValid && _depthMesh == &mesh
+		&& _depthVertices == mesh.vertices().data()
+		&& _depthVertexCount == mesh.vertices().size()
+		&& _depthTriangleCount == mesh.triangles().size()
+		&& _depthCulling == _backFaceCulling
+		&& _depthViewProj == eye.viewproj();
+}
+
+void sibr::ULRV3Renderer::setCameras(const std::vector<InputCamera::Ptr> & cameras) {
+	// Populate the cameraInfos array.
+	_cameraInfos.clear();
+	_cameraInfos.resize(cameras.size());
+	_requested.resize(cameras.size());
+	for (size_t i = 0; i < cameras.size(); ++i) {
+		const auto & cam = *cameras[i];
+		_cameraInfos[i].vp = cam.viewproj();
+		_cameraInfos[i].pos = cam.position();
+		_cameraInfos[i].dir = cam.dir();
+		_cameraInfos[i].selected = cam.isActive();
+		_requested[i] = _cameraInfos[i].selected;
+	}
+	_camsCount = int(cameras.size());
+
+	// The buffer only grows, a smaller scene reuses it. It is only written by GPU copies.
+	if (cameras.size() > _maxNumCams || !_camerasBuffer) {
+		if (_camerasBuffer) {
+			glDeleteBuffers(1, &_camerasBuffer);
+		}
+		_maxNumCams = std::max(cameras.size(), size_t(1));
+		glCreateBuffers(1, &_camerasBuffer);
+		glNamedBufferStorage(_camerasBuffer, GLsizeiptr(sizeof(CameraUBOInfos) * _maxNumCams), nullptr, 0);
 	}
-	// Enabled the ones passed as indices.
+	_dirtyBegin = 0;
+	_dirtyEnd = _cameraInfos.size();
+	if (!_cameraInfos.empty()) {
+		_historyValid = false;
+	}
+}
+
+void sibr::ULRV3Renderer::updateCameras(const std::vector<uint> & camIds) {
+	std::vector<int> selected(_cameraInfos.size(), 0);
 	for (const auto & camId : camIds) {
-		_cameraInfos[camId].selected = 1;
+		selected[camId] = 1;
 	}
+	_requested = selected;
+	// The camera budget is applied on top of it when rendering.
+	writeSelection(selected.data());
+}
 
-	// Update the content of the UBO.
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUBOInfos)*_maxNumCams, &_cameraInfos[0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+void sibr::ULRV3Renderer::writeSelection(const int * selected) {
+	// Only upload the range of flags that changed.
+	for (size_t i = 0; i < _cameraInfos.size(); ++i) {
+		if (_cameraInfos[i].selected == selected[i]) {
+			continue;
+		}
+		_cameraInfos[i].selected = selected[i];
+		_dirtyBegin = std::min(_dirtyBegin, i);
+		_dirtyEnd = std::max(_dirtyEnd, i + 1);
+		_historyValid = false;
+	}
+}
+
+void sibr::ULRV3Renderer::uploadCameras() {
+	if (_dirtyBegin >= _dirtyEnd) {
+		return;
+	}
+	// Staged in the streaming ring and copied on the GPU, after the draws reading the previous content:
+	// the previous frames don't have to be finished.
+	const size_t bytes = sizeof(CameraUBOInfos) * (_dirtyEnd - _dirtyBegin);
+	const StreamingBuffer::Allocation staging = StreamingBuffer::global().upload(&_cameraInfos[_dirtyBegin], bytes, StreamingBuffer::VERTEX);
+	glCopyNamedBufferSubData(staging.buffer, _camerasBuffer, GLintptr(staging.offset), GLintptr(sizeof(CameraUBOInfos) * _dirtyBegin), GLsizeiptr(bytes));
+	_dirtyBegin = _cameraInfos.size();
+	_dirtyEnd = 0;
 }
 
 void sibr::ULRV3Renderer::stopProfile()
@@ -187,6 +625,7 @@ void sibr::ULRV3Renderer::stopProfile()
 
 void sibr::ULRV3Renderer::renderProxyDepth(const sibr::Mesh & mesh, const sibr::Camera & eye)
 {
+	SIBR_PROFILE_GPU("Proxy depth");
 	// Bind and clear RT.
 	_depthRT->bind();
 	glViewport(0, 0, _depthRT->w(), _depthRT->h());
@@ -198,7 +637,7 @@ void sibr::ULRV3Renderer::renderProxyDepth(const sibr::Mesh & mesh, const sibr::
 	_depthShader.begin();
 	_nCamProj.set(eye.viewproj());
 
-	mesh.render(true, _backFaceCulling);
+	mesh.renderCulled(eye.viewproj(), true, _backFaceCulling);
 	
 	_depthShader.end();
 	_depthRT->unbind();
@@ -211,12 +650,34 @@ void sibr::ULRV3Renderer::renderBlending(
 	const sibr::Texture2DArrayLum32F::Ptr & inputDepths,
 	bool passthroughDepth
 ) {
+	SIBR_PROFILE_GPU("Blending");
+	if (_bindlessTextures) {
+		updateBindlessResidency(eye);
+	}
+
+	// With a reduced resolution, blend to an intermediate target first, cleared to a null alpha
+	// so that the upsampling knows where nothing was blended.
+	const bool reduced = _blendScale > 1 && fragString == "ulr/ulr_v3";
+	IRenderTarget * target = &dst;
+	if (reduced) {
+		const uint w = std::max((dst.w() + _blendScale - 1) / _blendScale, 1u);
+		const uint h = std::max((dst.h() + _blendScale - 1) / _blendScale, 1u);
+		if (!_reducedRT || _reducedRT->w() != w || _reducedRT->h() != h) {
+			_reducedRT = RenderTargetPool::global().acquire<unsigned char, 4>(w, h);
+		}
+		target = _reducedRT.get();
+	}
+
 	// Bind and clear destination rendertarget.
-	glViewport(0, 0, dst.w(), dst.h());
-	if (_clearDst) {
+	glViewport(0, 0, target->w(), target->h());
+	if (reduced) {
+		const GLfloat transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearNamedFramebufferfv(target->fbo(), GL_COLOR, 0, transparent);
+	}
+	else if (_clearDst) {
 		dst.clear();
 	}
-	dst.bind();
+	target->bind();
 
 	_ulrShader.begin();
 
@@ -233,6 +694,15 @@ void sibr::ULRV3Renderer::renderBlending(
 	_camsCount.send();
 	_winnerTakesAll.send();
 	_gammaCorrection.send();
+	_refineEdges.set(false);
+	if (_temporal) {
+		_historyRefresh.get() = std::max(_historyRefresh.get(), 1);
+		_useHistory.set(!reduced && _historyValid && _historyColor && _historyColor->w() == dst.w() && _historyColor->h() == dst.h());
+		_historyViewProj.send();
+		_historyFrame.send();
+		_historyRefresh.send();
+		_historyThreshold.send();
+	}
 
 	// Textures.
 	glActiveTexture(GL_TEXTURE0);
@@ -250,25 +720,120 @@ void sibr::ULRV3Renderer::renderBlending(
 		glBindTexture(GL_TEXTURE_2D_ARRAY, _masks->handle());
 	}
 
-	// Bind UBO to shader, after all possible textures.
-	glBindBuffer(GL_UNIFORM_BUFFER, _uboIndex);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 4, _uboIndex);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// Candidate cameras of each tile.
+	if (_tileCams > 0) {
+		glActiveTexture(GL_TEXTURE5);
+		glBindTexture(GL_TEXTURE_2D, _tilesTexture);
+	}
 
-	if (passthroughDepth) {
-		glEnable(GL_DEPTH_TEST);
+	// Previous result.
+	if (_temporal && _historyColor) {
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, _historyColor->handle());
+		glActiveTexture(GL_TEXTURE7);
+		glBindTexture(GL_TEXTURE_2D, _historyPositions->handle());
+	}
+
+	// Bind the cameras to the shader, after all possible textures.
+	uploadCameras();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _camerasBuffer);
+	if (_sparseTextures) {
+		_sparseTextures->bind(_ulrShader.shader(), 6, 7);
+	}
+	if (_bindlessTextures) {
+		_bindlessTextures->bind(8);
+	}
+
+	if (passthroughDepth && !reduced) {
+		GLState::enable(GL_DEPTH_TEST);
 	} else {
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 	}
 
 	// Perform ULR rendering.
 	RenderUtility::renderScreenQuad();
-	glDisable(GL_DEPTH_TEST);
+	GLState::disable(GL_DEPTH_TEST);
+
+	_ulrShader.end();
+	target->unbind();
+
+	if (reduced) {
+		upsampleBlending(eye, dst, passthroughDepth);
+	}
+
+	// Page the tiles requested by the previous frames.
+	if (_sparseTextures) {
+		_sparseTextures->update();
+	}
+
+	if (_temporal) {
+		updateHistory(eye, dst);
+	}
+}
+
+void sibr::ULRV3Renderer::upsampleBlending(const sibr::Camera & eye, IRenderTarget & dst, bool passthroughDepth)
+{
+	SIBR_PROFILE_GPU("Upsampling");
+	if (!_upsampleShader.isReady()) {
+		_upsampleShader.init("ULRV3Upsample",
+			sibr::loadFile(sibr::getShadersDirectory("ulr") + "/ulr_v3.vert"),
+			sibr::loadFile(sibr::getShadersDirectory("ulr") + "/ulr_upsample.frag"));
+		_upsampleEyePos.init(_upsampleShader, "ncam_pos");
+		_upsampleSigma.init(_upsampleShader, "depthSigma");
+		_upsampleEdge.init(_upsampleShader, "edgeThreshold");
+	}
+	if (!_edgesTexture || _edgesSize != Vector2i(dst.w(), dst.h())) {
+		if (_edgesTexture) {
+			glDeleteTextures(1, &_edgesTexture);
+		}
+		glCreateTextures(GL_TEXTURE_2D, 1, &_edgesTexture);
+		glTextureStorage2D(_edgesTexture, 1, GL_R8, GLsizei(dst.w()), GLsizei(dst.h()));
+		glTextureParameteri(_edgesTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(_edgesTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		_edgesSize = Vector2i(dst.w(), dst.h());
+	}
+
+	glViewport(0, 0, dst.w(), dst.h());
+	if (_clearDst) {
+		dst.clear();
+	}
+	dst.bind();
+	if (passthroughDepth) {
+		GLState::enable(GL_DEPTH_TEST);
+	} else {
+		GLState::disable(GL_DEPTH_TEST);
+	}
+
+	// Smooth pixels are interpolated, the others are flagged.
+	_upsampleShader.begin();
+	_upsampleEyePos.set(eye.position());
+	_upsampleSigma.send();
+	_upsampleEdge.send();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, _depthRT->handle());
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_2D, _reducedRT->handle());
+	glBindImageTexture(0, _edgesTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+	RenderUtility::renderScreenQuad();
+	_upsampleShader.end();
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
 
+	// Blend the flagged pixels at full resolution, the other inputs are still bound.
+	_ulrShader.begin();
+	_refineEdges.set(true);
+	glActiveTexture(GL_TEXTURE9);
+	glBindTexture(GL_TEXTURE_2D, _edgesTexture);
+	RenderUtility::renderScreenQuad();
+	_refineEdges.set(false);
 	_ulrShader.end();
+
+	GLState::disable(GL_DEPTH_TEST);
 	dst.unbind();
 }
 
 void sibr::ULRV3Renderer::resize(const unsigned w, const unsigned h) {
-	_depthRT.reset(new sibr::RenderTargetRGBA32F(w, h));
+	// The previous target goes back to the pool, and is reused if the size comes back.
+	_depthRT = RenderTargetPool::global().acquire<float, 4>(w, h);
+	_depthValid = false;
+	_historyValid = false;
 }
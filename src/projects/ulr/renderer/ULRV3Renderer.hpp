@@ -15,11 +15,14 @@
 # include "Config.hpp"
 # include <core/system/Config.hpp>
 # include <core/graphics/Texture.hpp>
+# include <core/graphics/SparseTextureArray.hpp>
+# include <core/graphics/BindlessTextureSet.hpp>
 # include <core/graphics/Shader.hpp>
 # include <core/graphics/Mesh.hpp>
 # include <core/renderer/RenderMaskHolder.hpp>
 # include <core/scene/BasicIBRScene.hpp>
 # include <core/system/SimpleTimer.hpp>
+# include <core/system/FrameArena.hpp>
 
 namespace sibr { 
 	
@@ -50,6 +53,9 @@ namespace sibr {
 			const bool facecull = true
 		);
 
+		/// Destructor.
+		~ULRV3Renderer();
+
 		/**
 		 * Change the shaders used by the ULR renderer.
 		 * \param fShader The name of the fragment shader to use.
@@ -98,10 +104,17 @@ namespace sibr {
 
 		/** 
 		 *  Update which cameras should be used for rendering, based on the indices passed.
+		 *  Only the flags that changed are written to the camera buffer.
 		 *  \param camIds The indices to enable.
 		 **/
 		void updateCameras(const std::vector<uint> & camIds);
 
+		/**
+		 * Replace the input cameras, for instance when the scene changes. The shaders are not recompiled.
+		 * \param cameras The new input cameras.
+		 */
+		void setCameras(const std::vector<InputCamera::Ptr> & cameras);
+
 		/// Set the epsilon occlusion threshold.
 		float & epsilonOcclusion() { return _epsilonOcclusion.get(); }
 
@@ -132,12 +145,100 @@ namespace sibr {
 		 **/
 		void resize(const unsigned int w, const unsigned int h);
 
+		/** Restrict the blending of each screen tile to its best candidate cameras, selected by a compute pre-pass.
+		 * The cost per pixel then depends on the number of candidates instead of the number of input cameras.
+		 * \param cams number of candidates per tile, 0 to blend all cameras
+		 * \note Only the default ulr_v3 shader supports it, the others ignore the selection.
+		 */
+		void tiledSelection(int cams);
+
+		/// \return the number of candidate cameras per tile, 0 if disabled.
+		int tiledSelection() const { return _tileCams; }
+
+		/** Sample the input images from a sparse array paged in on demand, driven by the tiles the blending samples.
+		 * The handle of the array should then be passed as the input RGBs.
+		 * \param textures the sparse array, or nullptr to go back to regular texture arrays
+		 */
+		void sparseTextures(const SparseTextureArray::Ptr & textures);
+
+		/// \return the sparse array of the input images, if any.
+		const SparseTextureArray::Ptr & sparseTextures() const { return _sparseTextures; }
+
+		/** Sample the input images from bindless textures at their native size. Each frame, the images
+		 * of the selected cameras closest to the novel view are made resident first, within the budget of the set;
+		 * cameras whose image is not resident are skipped by the blending.
+		 * \param textures the bindless textures, or nullptr to go back to regular texture arrays
+		 */
+		void bindlessTextures(const BindlessTextureSet::Ptr & textures);
+
+		/// \return the bindless textures of the input images, if any.
+		const BindlessTextureSet::Ptr & bindlessTextures() const { return _bindlessTextures; }
+
 		/// Should the final RT be cleared or not.
 		bool & clearDst() { return _clearDst; }
 
 		/// \return The ID of the first pass position map texture.
 		uint depthHandle() const { return _depthRT->texture(); }
 
+		/// Reuse the proxy positions of the previous frame when the camera, mesh and resolution didn't change.
+		bool & cacheProxyDepth() { return _cacheDepth; }
+
+		/// Force the next frame to render the proxy positions, for instance after editing the mesh in place.
+		void invalidateProxyDepth() { _depthValid = false; }
+
+		/// \return true if the last frame reused the cached proxy positions.
+		bool proxyDepthCached() const { return _depthCached; }
+
+		/// \return the number of frames that reused the cached proxy positions.
+		uint64 proxyDepthHits() const { return _depthHits; }
+
+		/** Reuse the previous result where the reprojected proxy still sees the same surface.
+		 * Disoccluded pixels and a rotating subset of the others are blended again.
+		 * \param enable the new state
+		 * \note Only the default ulr_v3 shader supports it, the others ignore it.
+		 */
+		void temporal(bool enable);
+
+		/// \return true if the previous result is reused.
+		bool temporal() const { return _temporal; }
+
+		/** Maximum number of cameras blended, 0 for all the selected ones. When the selection is larger,
+		 * only the cameras closest to the novel view and looking the same way are kept, each frame.
+		 */
+		int & cameraBudget() { return _cameraBudget; }
+
+		/// Every pixel is blended again at least once every temporalRefresh() frames, 1 blends all of them.
+		int & temporalRefresh() { return _historyRefresh.get(); }
+
+		/// Maximum distance between a point and its reprojection, relative to its distance to the camera.
+		float & temporalThreshold() { return _historyThreshold.get(); }
+
+		/** Check if the shaders submitted by setupShaders are compiled, without blocking.
+		 * process() can be called at any time, but waits for the compilation.
+		 * \return true once rendering won't stall on shader compilation
+		 */
+		bool shadersReady();
+
+		/// Discard the previous result, to call when the inputs or settings change.
+		void invalidateHistory() { _historyValid = false; }
+
+		/** Blend at a reduced resolution, then upsample with a joint bilateral filter guided by the full
+		 * resolution proxy positions. Pixels next to a depth edge are blended again at full resolution.
+		 * \param factor resolution divider, 1 for full resolution, 2 or 4
+		 * \note Only the default ulr_v3 shader supports it, the others blend at full resolution.
+		 * Temporal reuse is disabled while the resolution is reduced.
+		 */
+		void reducedBlending(int factor);
+
+		/// \return the blending resolution divider, 1 for full resolution.
+		int reducedBlending() const { return _blendScale; }
+
+		/// Range of the upsampling position weights, relative to the distance to the novel view.
+		float & upsampleDepthSigma() { return _upsampleSigma.get(); }
+
+		/// Position weight under which a reduced sample is considered to see another surface, and the pixel is blended again.
+		float & upsampleEdgeThreshold() { return _upsampleEdge.get(); }
+
 		void startProfile() { 
 			_profiling = true; 
 			_depthCost.clear();
@@ -153,6 +254,12 @@ namespace sibr {
 		 */
 		virtual void renderProxyDepth(const sibr::Mesh & mesh, const sibr::Camera& eye);
 
+		/**
+		 * Select the candidate cameras of each tile from the proxy positions.
+		 * \param eye The novel viewpoint.
+		 */
+		void renderTileSelection(const sibr::Camera& eye);
+
 		/**
 		* Perform ULR blending.
 		* \param eye The novel viewpoint.
@@ -171,6 +278,41 @@ namespace sibr {
 
 
 	protected:
+
+		/** Bind the uniforms to the linked shaders. */
+		void setupUniforms();
+
+		/** Upsample the reduced blending to the destination, then blend the flagged edge pixels at full resolution.
+		 * The ULR shader inputs are expected to be bound by renderBlending.
+		 * \param eye The novel viewpoint.
+		 * \param dst The destination rendertarget.
+		 * \param passthroughDepth If true, depth from the position map will be output to the depth buffer for ulterior passes.
+		 */
+		void upsampleBlending(const sibr::Camera & eye, IRenderTarget & dst, bool passthroughDepth);
+
+		/** Request the bindless textures of the selected cameras, closest to the novel view first.
+		 * \param eye The novel viewpoint.
+		 */
+		void updateBindlessResidency(const sibr::Camera & eye);
+
+		/** Sort cameras by relevance for a novel view: close to it and looking the same way first.
+		 * \param eye The novel viewpoint.
+		 * \param selected The flags of the cameras to rank.
+		 * \param count The number of flags.
+		 * \return the indices of the flagged cameras, most relevant first, allocated for the current frame.
+		 */
+		FrameVector<uint> rankCameras(const sibr::Camera & eye, const int * selected, size_t count) const;
+
+		/** Restrict the requested cameras to the camera budget.
+		 * \param eye The novel viewpoint.
+		 */
+		void applyCameraBudget(const sibr::Camera & eye);
+
+		/** Write the selection flags that changed to the camera buffer.
+		 * \param selected The flag of each camera, one per camera info.
+		 */
+		void writeSelection(const int * selected);
+
 		/// Shader names.
 		std::string fragString, vertexString;
 
@@ -178,6 +320,14 @@ namespace sibr {
 		sibr::GLShader _depthShader;
 
 		sibr::RenderTargetRGBA32F::Ptr		_depthRT;
+
+		static const int					tileSize = 16; ///< Side of a screen tile, in pixels.
+		int									_tileCams = 0; ///< Candidate cameras per tile, 0 to blend all.
+		GLuint								_tilesProgram = 0; ///< Tile selection compute program.
+		GLuint								_tilesTexture = 0; ///< Candidates of each tile.
+		Vector2i							_tilesSize = Vector2i(0, 0); ///< Size of the candidates texture.
+		SparseTextureArray::Ptr				_sparseTextures; ///< Paged input images, if enabled.
+		BindlessTextureSet::Ptr				_bindlessTextures; ///< Native size input images, if enabled.
 		GLuniform<Matrix4f>					_nCamProj;
 		GLuniform<Vector3f>					_nCamPos;
 
@@ -192,7 +342,7 @@ namespace sibr {
 			_winnerTakesAll = false,
 			_gammaCorrection = false;
 
-		size_t _maxNumCams = 0;
+		size_t _maxNumCams = 0; ///< Capacity of the camera buffer.
 		GLuniform<int> _camsCount = 0;
 
 		GLuniform<float>					_epsilonOcclusion = 0.01f;
@@ -200,7 +350,7 @@ namespace sibr {
 		bool								_clearDst = true;
 
 		/** Camera infos data structure shared between the CPU and GPU.
-			We have to be careful about alignment if we want to send those struct directly into the UBO. */
+			We have to be careful about alignment if we want to send those struct directly into the std430 storage buffer. */
 		struct CameraUBOInfos {	 
 			Matrix4f vp; ///< Matrix viewproj.
 			Vector3f pos; ///< Camera position.
@@ -209,8 +359,56 @@ namespace sibr {
 			float dummy = 0.0f; ///< Padding to a multiple of 16 bytes for alignment on the GPU.
 		};
 
-		std::vector<CameraUBOInfos> _cameraInfos;
-		GLuint _uboIndex;
+		/// Copy the cameras changed since the last rendering to the camera buffer.
+		void uploadCameras();
+
+		std::vector<CameraUBOInfos> _cameraInfos; ///< CPU copy of the cameras.
+		std::vector<int> _requested; ///< Selection requested by the user, before the camera budget.
+		int _cameraBudget = 0; ///< Maximum number of cameras blended, 0 for no limit.
+		GLuint _camerasBuffer = 0; ///< Storage buffer, _maxNumCams entries, updated by copies from the streaming buffer.
+		size_t _dirtyBegin = 0; ///< First camera to upload.
+		size_t _dirtyEnd = 0; ///< End of the cameras to upload.
+
+		/** \return true if the position map was rendered with this mesh and camera. */
+		bool proxyDepthUpToDate(const sibr::Mesh & mesh, const sibr::Camera & eye) const;
+
+		bool _cacheDepth = true; ///< Skip the depth pass when nothing changed.
+		bool _depthValid = false; ///< The position map matches the state below.
+		bool _depthCached = false; ///< The last frame skipped the depth pass.
+		uint64 _depthHits = 0; ///< Number of skipped depth passes.
+		const sibr::Mesh * _depthMesh = nullptr; ///< Mesh of the position map.
+		const void * _depthVertices = nullptr; ///< Vertex storage of that mesh.
+		size_t _depthVertexCount = 0; ///< Vertex count of that mesh.
+		size_t _depthTriangleCount = 0; ///< Triangle count of that mesh.
+		Matrix4f _depthViewProj = Matrix4f::Zero(); ///< Camera of the position map.
+		bool _depthCulling = true; ///< Culling mode of the position map.
+
+		/** Keep the result and positions of the frame for the next one.
+		 * \param eye The novel viewpoint.
+		 * \param dst The destination rendertarget.
+		 */
+		void updateHistory(const sibr::Camera & eye, IRenderTarget & dst);
+
+		bool _temporal = false; ///< Reuse the previous result.
+		bool _historyValid = false; ///< The history matches the current inputs.
+		bool _uniformsPending = false; ///< The shaders are still compiling, uniforms are not bound yet.
+		sibr::RenderTargetRGBA::Ptr _historyColor; ///< Previous result.
+		sibr::RenderTargetRGBA32F::Ptr _historyPositions; ///< Previous proxy positions.
+		GLuniform<bool> _useHistory = false;
+		GLuniform<Matrix4f> _historyViewProj;
+		GLuniform<int> _historyFrame = 0;
+		GLuniform<int> _historyRefresh = 4;
+		GLuniform<float> _historyThreshold = 0.01f;
+
+		int _blendScale = 1; ///< Blending resolution divider.
+		sibr::GLShader _upsampleShader; ///< Joint bilateral upsampling, created on first use.
+		sibr::RenderTargetRGBA::Ptr _reducedRT; ///< Reduced resolution blending.
+		GLuint _edgesTexture = 0; ///< Pixels to blend again at full resolution.
+		Vector2i _edgesSize = Vector2i(0, 0); ///< Size of the edges texture.
+		GLuniform<Vector3f> _upsampleEyePos;
+		GLuniform<float> _upsampleSigma = 0.01f;
+		GLuniform<float> _upsampleEdge = 0.1f;
+		GLuniform<bool> _refineEdges = false;
 
 		bool		_profiling = false;
 		sibr::Timer	_depthPassTimer;
@@ -12,16 +12,20 @@
 
 #include <projects/ulr/renderer/ULRV3View.hpp>
 #include <core/graphics/GUI.hpp>
+#include <core/graphics/MemoryTracker.hpp>
 
 sibr::ULRV3View::ULRV3View(const sibr::BasicIBRScene::Ptr & ibrScene, uint render_w, uint render_h) :
 	_scene(ibrScene),
 	sibr::ViewBase(render_w, render_h)
 {
+	SIBR_MEMORY_SCOPE("ULR");
 	const uint w = render_w;
 	const uint h = render_h;
 
 	//  Renderers.
 	_ulrRenderer.reset(new ULRV3Renderer(ibrScene->cameras()->inputCameras(), w, h));
+	_ulrRenderer->sparseTextures(ibrScene->renderTargets()->getInputRGBSparseArrayPtr());
+	_ulrRenderer->bindlessTextures(ibrScene->renderTargets()->getInputRGBBindlessPtr());
 	_poissonRenderer.reset(new PoissonRenderer(w, h));
 	_poissonRenderer->enableFix() = true;
 
@@ -42,18 +46,17 @@ sibr::ULRV3View::ULRV3View(const sibr::BasicIBRScene::Ptr & ibrScene, uint rende
 
 void sibr::ULRV3View::setScene(const sibr::BasicIBRScene::Ptr & newScene) {
 	_scene = newScene;
+	// The levels were built for the previous proxy.
+	_proxyLODs.reset();
+	_lodLevel = 0;
 	const uint w = getResolution().x();
 	const uint h = getResolution().y();
 
-	std::string shaderName = "ulr_v3";
-	if (_weightsMode == VARIANCE_BASED_W) {
-		shaderName = "ulr_v3_alt";
-	}
-	else if (_weightsMode == ULR_FAST) {
-		shaderName = "ulr_v3_fast";
-	}
-
-	_ulrRenderer.reset(new ULRV3Renderer(newScene->cameras()->inputCameras(), w, h, shaderName));
+	// The shaders don't depend on the number of cameras, only the camera buffer is replaced.
+	_ulrRenderer->setCameras(newScene->cameras()->inputCameras());
+	_ulrRenderer->sparseTextures(newScene->renderTargets()->getInputRGBSparseArrayPtr());
+	_ulrRenderer->bindlessTextures(newScene->renderTargets()->getInputRGBBindlessPtr());
+	_ulrRenderer->resize(w, h);
 
 	// Tell the scene we are a priori using all active cameras.
 	std::vector<uint> imgs_ulr;
@@ -79,22 +82,55 @@ void sibr::ULRV3View::setMode(const WeightsMode mode) {
 	}
 }
 
+void sibr::ULRV3View::setProxyLODs(const MeshLOD::Ptr & lods, float pixelError) {
+	_proxyLODs = lods;
+	_lodPixelError = pixelError;
+	_lodLevel = 0;
+}
+
 void sibr::ULRV3View::onRenderIBR(sibr::IRenderTarget & dst, const sibr::Camera & eye)
 {
+	// Keep the application responsive while the shaders compile, with an empty frame as placeholder.
+	if (!_ulrRenderer->shadersReady()) {
+		dst.clear();
+		return;
+	}
+	// Same while a scene loaded in the background has no proxy or depth maps yet.
+	if (!_scene->proxies()->hasProxy() || !_scene->renderTargets()->getInputDepthMapArrayPtr()) {
+		dst.clear();
+		return;
+	}
+
+	// Coarser proxies for small on-screen footprints.
+	_lodLevel = _proxyLODs ? _proxyLODs->select(eye, float(dst.h()), _lodPixelError) : 0;
+	const sibr::Mesh & proxy = _proxyLODs ? _proxyLODs->level(_lodLevel) : _scene->proxies()->proxy();
+
 	// Perform ULR rendering, either directly to the destination RT, or to the intermediate RT when poisson blending is enabled.
+	// Bindless textures don't go through the array binding.
+	const auto & sparseRGBs = _scene->renderTargets()->getInputRGBSparseArrayPtr();
+	const auto & arrayRGBs = _scene->renderTargets()->getInputRGBTextureArrayPtr();
 	_ulrRenderer->process(
-			_scene->proxies()->proxy(),
+			proxy,
 			eye, 
 			_poissonBlend ? *_blendRT : dst,
-			_scene->renderTargets()->getInputRGBTextureArrayPtr(),
+			sparseRGBs ? sparseRGBs->handle() : (arrayRGBs ? arrayRGBs->handle() : 0),
 		_scene->renderTargets()->getInputDepthMapArrayPtr()
 		);
 
 	// Perform Poisson blending if enabled and copy to the destination RT.
 	if (_poissonBlend) {
-		_poissonRenderer->process(_blendRT, _poissonRT);
+		// Small view changes converge quickly from the previous solution.
+		const float maxAngleCos = 0.9998f;
+		const float maxTranslation = 0.002f * eye.zfar();
+		const bool warmStart = _poissonWarmStart && _poissonValid
+			&& eye.dir().dot(_poissonEyeDir) > maxAngleCos
+			&& (eye.position() - _poissonEyePos).norm() < maxTranslation;
+		_poissonRenderer->process(_blendRT, _poissonRT, warmStart);
+		_poissonEyePos = eye.position();
+		_poissonEyeDir = eye.dir();
 		blit(*_poissonRT, dst);
 	}
+	_poissonValid = _poissonBlend;
 
 }
 
@@ -102,6 +138,18 @@ void sibr::ULRV3View::onUpdate(Input & input)
 {
 }
 
+bool sibr::ULRV3View::setQualityLevel(float level)
+{
+	// Keep a few cameras, the blending needs them to cover the view.
+	const int minCams = 4;
+	const int count = int(_scene->cameras()->inputCameras().size());
+	_ulrRenderer->cameraBudget() = level >= 1.0f ? 0 : std::max(minCams, int(std::ceil(level * float(count))));
+	// Smooth regions are then upsampled, edges are still blended at full resolution.
+	_qualityBlendScale = level >= 0.75f ? 1 : (level >= 0.4f ? 2 : 4);
+	_ulrRenderer->reducedBlending(std::max(_blendScale, _qualityBlendScale));
+	return true;
+}
+
 void sibr::ULRV3View::onGUI()
 {
 	const std::string guiName = "ULRV3 Settings (" + name() + ")";
@@ -109,7 +157,8 @@ void sibr::ULRV3View::onGUI()
 
 		// Poisson settings.
 		ImGui::Checkbox("Poisson ", &_poissonBlend); ImGui::SameLine();
-		ImGui::Checkbox("Poisson fix", &_poissonRenderer->enableFix());
+		ImGui::Checkbox("Poisson fix", &_poissonRenderer->enableFix()); ImGui::SameLine();
+		ImGui::Checkbox("Poisson warm start", &_poissonWarmStart);
 
 		// Other settings.
 		ImGui::Checkbox("Flip RGB ", &getULRrenderer()->flipRGBs());
@@ -144,6 +193,50 @@ void sibr::ULRV3View::onGUI()
 			setMode(_weightsMode);
 		}
 		
+		int blendResolution = _blendScale >= 4 ? 2 : (_blendScale >= 2 ? 1 : 0);
+		if (ImGui::Combo("Blending resolution", &blendResolution, "Full\0Half\0Quarter\0\0")) {
+			_blendScale = 1 << blendResolution;
+			_ulrRenderer->reducedBlending(std::max(_blendScale, _qualityBlendScale));
+		}
+		if (_ulrRenderer->reducedBlending() > 1) {
+			ImGui::SliderFloat("Upsampling depth range", &_ulrRenderer->upsampleDepthSigma(), 0.001f, 0.1f, "%.3f");
+			ImGui::SliderFloat("Edge threshold", &_ulrRenderer->upsampleEdgeThreshold(), 0.0f, 1.0f);
+		}
+
+		int tileCams = _ulrRenderer->tiledSelection();
+		if (ImGui::InputInt("Cameras per tile (0: all)", &tileCams, 1, 4)) {
+			_ulrRenderer->tiledSelection(tileCams);
+		}
+		if (const auto & sparse = _ulrRenderer->sparseTextures()) {
+			ImGui::Text("Paged images: %zu / %zu MB, %zu missing tiles", sparse->residentBytes() >> 20, sparse->budget() >> 20, sparse->missingTiles());
+			ImGui::InputInt("Tile uploads per frame", &sparse->uploadsPerFrame(), 1, 8);
+			sparse->uploadsPerFrame() = std::max(sparse->uploadsPerFrame(), 1);
+		}
+		if (const auto & bindless = _ulrRenderer->bindlessTextures()) {
+			ImGui::Text("Resident images: %zu / %zu MB, %zu missing", bindless->residentBytes() >> 20, bindless->budget() >> 20, bindless->missingImages());
+			ImGui::InputInt("Image uploads per frame", &bindless->uploadsPerFrame(), 1, 4);
+			bindless->uploadsPerFrame() = std::max(bindless->uploadsPerFrame(), 1);
+		}
+		ImGui::Checkbox("Cache proxy depth", &_ulrRenderer->cacheProxyDepth());
+		if (_ulrRenderer->cacheProxyDepth()) {
+			ImGui::SameLine();
+			ImGui::TextColored(_ulrRenderer->proxyDepthCached() ? ImVec4(0.2f, 1.0f, 0.2f, 1.0f) : ImVec4(1.0f, 0.6f, 0.2f, 1.0f),
+				"%s (%llu hits)", _ulrRenderer->proxyDepthCached() ? "hit" : "miss", (unsigned long long)_ulrRenderer->proxyDepthHits());
+		}
+		bool temporal = _ulrRenderer->temporal();
+		if (ImGui::Checkbox("Temporal reuse", &temporal)) {
+			_ulrRenderer->temporal(temporal);
+		}
+		if (_ulrRenderer->temporal()) {
+			// Longer periods reuse more pixels, trading quality for speed.
+			ImGui::SliderInt("Refresh period", &_ulrRenderer->temporalRefresh(), 1, 16);
+			ImGui::SliderFloat("Reprojection threshold", &_ulrRenderer->temporalThreshold(), 0.0f, 0.05f, "%.4f");
+		}
+		if (_proxyLODs) {
+			ImGui::SliderFloat("LOD pixel error", &_lodPixelError, 0.25f, 16.0f, "%.2f");
+			ImGui::SameLine();
+			ImGui::Text("level %zu (%zu triangles)", _lodLevel, _proxyLODs->level(_lodLevel).triangles().size());
+		}
 		ImGui::Checkbox("Occlusion Testing", &_ulrRenderer->occTest());
 		ImGui::Checkbox("Debug weights", &_ulrRenderer->showWeights());
 		ImGui::Checkbox("Gamma correction", &_ulrRenderer->gammaCorrection());
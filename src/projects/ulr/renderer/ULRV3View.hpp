@@ -15,6 +15,7 @@
 # include "Config.hpp"
 # include <core/system/Config.hpp>
 # include <core/graphics/Mesh.hpp>
+# include <core/graphics/MeshLOD.hpp>
 # include <core/view/ViewBase.hpp>
 # include <core/renderer/CopyRenderer.hpp>
 # include <projects/ulr/renderer/ULRV3Renderer.hpp>
@@ -68,6 +69,14 @@ namespace sibr {
 		 */
 		void onGUI() override;
 
+		/**
+		 * Limit the number of blended cameras, see ULRV3Renderer::cameraBudget, and reduce the blending
+		 * resolution at low levels, see ULRV3Renderer::reducedBlending.
+		 * \param level The quality level, 1 blends all the selected cameras at full resolution.
+		 * \return true
+		 */
+		bool setQualityLevel(float level) override;
+
 		/** \return a reference to the renderer. */
 		const ULRV3Renderer::Ptr & getULRrenderer() const { return _ulrRenderer; }
 
@@ -80,6 +89,12 @@ namespace sibr {
 		/** \return a reference to the scene */
 		const std::shared_ptr<sibr::BasicIBRScene> & getScene() const { return _scene; }
 
+		/** Render simplified versions of the proxy when they are small enough on screen.
+		 *\param lods the proxy levels, level 0 should be the scene proxy, or null to always use the proxy
+		 *\param pixelError the maximum on-screen error of the selected level, in pixels
+		 **/
+		void setProxyLODs(const MeshLOD::Ptr & lods, float pixelError = 1.0f);
+
 	protected:
 
 		/**
@@ -96,11 +111,22 @@ namespace sibr {
 		RenderTargetRGBA::Ptr	_poissonRT; ///< Poisson filling destination RT.
 
 		bool					_poissonBlend = false; ///< Should Poisson filling be applied.
+		bool					_poissonWarmStart = true; ///< Reuse the previous Poisson solution for small view changes.
+		bool					_poissonValid = false; ///< Does _poissonRT contain the previous frame solution.
+		Vector3f				_poissonEyePos = Vector3f::Zero(); ///< Position of the previous Poisson frame.
+		Vector3f				_poissonEyeDir = Vector3f::Zero(); ///< Direction of the previous Poisson frame.
 
 		RenderMode				_renderMode = ALL_CAMS; ///< Current rendering mode.
 		WeightsMode				_weightsMode = ULR_W; ///< Current blend weights mode.
 		int						_singleCamId = 0; ///< Selected camera for the single view mode.
 		int						_everyNCamStep = 1; ///< Camera step size for the every other N mode.
+
+		MeshLOD::Ptr			_proxyLODs; ///< Simplified proxies, if any.
+		float					_lodPixelError = 1.0f; ///< Maximum on-screen error of the selected level.
+		size_t					_lodLevel = 0; ///< Level used for the last frame.
+
+		int						_blendScale = 1; ///< Blending resolution divider chosen in the GUI.
+		int						_qualityBlendScale = 1; ///< Blending resolution divider required by the quality level.
 	};
 
 } /*namespace sibr*/ 
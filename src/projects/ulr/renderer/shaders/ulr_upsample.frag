@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use 
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact sibr@inria.fr and/or George.Drettakis@inria.fr
+ */
+
+
+#version 430
+
+// Joint bilateral upsampling of a reduced resolution ULR blending, guided by the full resolution
+// proxy positions. Each pixel blends the four closest reduced samples, weighted by their distance
+// to the pixel and by the distance between the surface points they blended and its own.
+// Pixels where a sample sees another surface are flagged, to be blended again at full resolution.
+
+in vec2 vertex_coord;
+layout(location = 0) out vec4 out_color;
+
+// Full resolution proxy positions, depth in w.
+layout(binding=0) uniform sampler2D proxy;
+// Reduced blending, alpha is zero where nothing was blended.
+layout(binding=4) uniform sampler2D blended;
+// Edge flags, 1 for the pixels to blend again.
+layout(r8, binding=0) uniform writeonly image2D edges;
+
+uniform vec3 ncam_pos;
+// Range of the position weights, relative to the distance to the novel view.
+uniform float depthSigma = 0.01;
+// Samples whose position weight is below are considered to see another surface.
+uniform float edgeThreshold = 0.1;
+
+void main(void){
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  vec4 point = texelFetch(proxy, pixel, 0);
+  if (point.w >= 1.0) {
+	imageStore(edges, pixel, vec4(0.0));
+	discard;
+  }
+
+  vec2 size = vec2(textureSize(blended, 0));
+  vec2 coord = vertex_coord * size - 0.5;
+  ivec2 base = ivec2(floor(coord));
+  vec2 f = coord - vec2(base);
+  float range = depthSigma * distance(point.xyz, ncam_pos);
+
+  vec4 sum = vec4(0.0);
+  float minWeight = 1.0;
+  for (int j = 0; j < 2; ++j) {
+	for (int i = 0; i < 2; ++i) {
+	  ivec2 q = clamp(base + ivec2(i, j), ivec2(0), ivec2(size) - 1);
+	  vec4 color = texelFetch(blended, q, 0);
+	  // Same lookup as the reduced blending of that sample.
+	  vec4 sampled = texture(proxy, (vec2(q) + 0.5) / size);
+	  float d = distance(sampled.xyz, point.xyz) / max(range, 1e-6);
+	  float w = (color.a > 0.0 && sampled.w < 1.0) ? exp(-d * d) : 0.0;
+	  minWeight = min(minWeight, w);
+	  float spatial = (i == 0 ? 1.0 - f.x : f.x) * (j == 0 ? 1.0 - f.y : f.y);
+	  sum += vec4(color.rgb, 1.0) * w * (spatial + 1e-3);
+	}
+  }
+
+  if (minWeight < edgeThreshold || sum.w <= 0.0) {
+	imageStore(edges, pixel, vec4(1.0));
+	discard;
+  }
+  imageStore(edges, pixel, vec4(0.0));
+  out_color = vec4(sum.rgb / sum.w, 1.0);
+  gl_FragDepth = point.w;
+}
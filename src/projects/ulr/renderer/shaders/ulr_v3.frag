@@ -10,10 +10,19 @@
  */
 
 
-#version 420
+#version 430
 
 #define NUM_CAMS (12)
 #define ULR_STREAMING (0)
+#define ULR_VIRTUAL (0)
+#define ULR_BINDLESS (0)
+#define ULR_TILES (0)
+#define ULR_TEMPORAL (0)
+#define TILE_CAMS (8)
+
+#if ULR_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 
 in vec2 vertex_coord;
 layout(location = 0) out vec4 out_color;
@@ -29,10 +38,10 @@ struct CameraInfos
   int selected;
   vec3 dir;
 };
-// They are stored in a contiguous buffer (UBO), lifting most limitations on the number of uniforms.
-layout(std140, binding=4) uniform InputCameras
+// They are stored in a storage buffer sized at runtime, camsCount gives the number of valid entries.
+layout(std430, binding=4) readonly buffer InputCameras
 {
-  CameraInfos cameras[NUM_CAMS];
+  CameraInfos cameras[];
 };
 
 // Uniforms.
@@ -57,6 +66,23 @@ uniform vec2 rtResolution = vec2(1.0);
 #define INFTY_W 100000.0
 #define BETA 	1e-1  	/* Relative importance of resolution penalty */
 
+// The input images are bindless textures at their native size (see BindlessTextureSet), the handle
+// of an image that is not resident is zero and its camera is skipped.
+#if ULR_BINDLESS
+layout(std430, binding=8) readonly buffer BindlessImages
+{
+  uvec2 imageHandles[];
+};
+
+bool hasImage(int i){
+	return imageHandles[i] != uvec2(0);
+}
+#else
+bool hasImage(int i){
+	return true;
+}
+#endif
+
 // Textures.
 // To support both the regular version (using texture arrays) and the streaming version (using 2D RTs),
 // we wrap the texture accesses in two helpers that hide the difference.
@@ -87,11 +113,52 @@ layout(binding=1) uniform sampler2DArray input_rgbs;
 layout(binding=2) uniform sampler2DArray input_depths;
 layout(binding=3) uniform sampler2DArray input_masks;
 
+#if ULR_VIRTUAL
+// The input images are a sparse array, paged in on demand from the tiles reported here (see SparseTextureArray).
+layout(std430, binding=6) buffer VirtualFeedback
+{
+  uint vtFeedback[];
+};
+layout(std430, binding=7) readonly buffer VirtualResidency
+{
+  uint vtResidency[];
+};
+uniform uint vtFrame;
+uniform int vtTailLevel;
+uniform int vtTilesPerLayer;
+uniform vec2 vtLevelScales[16];
+uniform ivec3 vtLevelTiles[16];
+
+vec3 sampleRGB(vec3 xy_camid){
+	const int layer = int(xy_camid.z);
+	float lod = textureQueryLod(input_rgbs, xy_camid.xy).x;
+	const int level = int(lod);
+	if(level < vtTailLevel){
+		// Request the tile, and clamp to the finest level resident around it.
+		const ivec3 tiles = vtLevelTiles[level];
+		const ivec2 tile = clamp(ivec2(xy_camid.xy * vtLevelScales[level]), ivec2(0), tiles.xy - 1);
+		vtFeedback[layer * vtTilesPerLayer + tiles.z + tile.y * tiles.x + tile.x] = vtFrame;
+		const ivec3 cells = vtLevelTiles[0];
+		const ivec2 cell = clamp(ivec2(xy_camid.xy * vtLevelScales[0]), ivec2(0), cells.xy - 1);
+		lod = max(lod, float(vtResidency[layer * cells.x * cells.y + cell.y * cells.x + cell.x]));
+	}
+	return textureLod(input_rgbs, xy_camid, lod).rgb;
+}
+#elif ULR_BINDLESS
+vec3 sampleRGB(vec3 xy_camid){
+	return texture(sampler2D(imageHandles[int(xy_camid.z)]), xy_camid.xy).rgb;
+}
+#else
+vec3 sampleRGB(vec3 xy_camid){
+	return texture(input_rgbs, xy_camid).rgb;
+}
+#endif
+
 vec4 getRGBD(vec3 xy_camid){
 	if(flipRGBs){
 		xy_camid.y = 1.0 - xy_camid.y;
 	}
-	vec3 rgb = texture(input_rgbs, xy_camid).rgb;
+	vec3 rgb = sampleRGB(xy_camid);
 	if(flipRGBs){
 		xy_camid.y = 1.0 - xy_camid.y;
 	}
@@ -105,6 +172,27 @@ float getMask(vec3 xy_camid){
 
 #endif
 
+#if ULR_TILES
+// Candidate cameras of each screen tile, TILE_CAMS consecutive texels per tile, -1 after the last one.
+layout(binding=5) uniform isampler2D tile_cams;
+uniform int tileSize = 16;
+#endif
+
+#if ULR_TEMPORAL
+// Result and proxy positions of the previous frame, reused where they are still valid.
+layout(binding=6) uniform sampler2D history_color;
+layout(binding=7) uniform sampler2D history_positions;
+uniform bool useHistory = false;
+uniform mat4 historyViewProj;
+uniform int historyFrame = 0;
+uniform int historyRefresh = 4;
+uniform float historyThreshold = 0.01;
+#endif
+
+// Pixels near a depth edge of a reduced resolution blending, the others are upsampled (see ulr_upsample.frag).
+layout(binding=9) uniform sampler2D refine_edges;
+uniform bool refineEdges = false;
+
 // Helpers.
 
 vec3 project(vec3 point, mat4 proj) {
@@ -123,12 +211,35 @@ vec3 getRandomColor(int x);
 
 void main(void){
   		
+  if (refineEdges && texelFetch(refine_edges, ivec2(gl_FragCoord.xy), 0).r < 0.5) {
+	discard;
+  }
+
   vec4 point = texture(proxy, vertex_coord);
   // discard if there was no intersection with the proxy
   if ( point.w >= 1.0) {
 	discard;
   }
 
+#if ULR_TEMPORAL
+  // Reproject the point in the previous frame. A rotating subset of the pixels is always
+  // blended again, the others reuse the previous result if they see the same surface.
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  if(useHistory && (pixel.x + 3 * pixel.y + historyFrame) % historyRefresh != 0){
+	vec3 prev = project(point.xyz, historyViewProj);
+	if(all(greaterThanEqual(prev.xy, vec2(0.0))) && all(lessThan(prev.xy, vec2(1.0)))){
+		ivec2 prevPixel = ivec2(prev.xy * vec2(textureSize(history_positions, 0)));
+		vec4 prevPoint = texelFetch(history_positions, prevPixel, 0);
+		if(prevPoint.w < 1.0 && distance(prevPoint.xyz, point.xyz) < historyThreshold * distance(point.xyz, ncam_pos)){
+			ivec2 colorPixel = ivec2(prev.xy * vec2(textureSize(history_color, 0)));
+			out_color = vec4(texelFetch(history_color, colorPixel, 0).rgb, 1.0);
+			gl_FragDepth = point.w;
+			return;
+		}
+	}
+  }
+#endif
+
   vec4  color0 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4  color1 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4  color2 = vec4(0.0,0.0,0.0,INFTY_W);
@@ -136,13 +247,20 @@ void main(void){
 
   bool atLeastOneValid = false;
   
-  for(int i = 0; i < NUM_CAMS; i++){
-	if(i>=camsCount){
-		continue;
+#if ULR_TILES
+  // Only iterate over the cameras selected for the tile of the fragment.
+  ivec2 tile = ivec2(vertex_coord * vec2(textureSize(proxy, 0))) / tileSize;
+  for(int k = 0; k < TILE_CAMS; k++){
+	int i = texelFetch(tile_cams, ivec2(tile.x * TILE_CAMS + k, tile.y), 0).r;
+	if(i < 0){
+		break;
 	}
+#else
+  for(int i = 0; i < camsCount; i++){
 	if(cameras[i].selected == 0){
 		continue;
 	}
+#endif
 
 	vec3 uvd = project(point.xyz, cameras[i].vp);
 	vec2 ndc = abs(2.0*uvd.xy-1.0);
@@ -151,7 +269,7 @@ void main(void){
 	vec2 uv_ddy = dFdy(uvd.xy * rtResolution);
 
 
-	if (frustumTest(point.xyz, ndc, i)){
+	if (frustumTest(point.xyz, ndc, i) && hasImage(i)){
 		vec3 xy_camid = vec3(uvd.xy,i);
 		
 		
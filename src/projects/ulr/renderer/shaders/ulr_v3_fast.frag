@@ -10,10 +10,16 @@
  */
 
 
-#version 420
+#version 430
 
 #define NUM_CAMS (12)
 #define ULR_STREAMING (0)
+#define ULR_VIRTUAL (0)
+#define ULR_BINDLESS (0)
+
+#if ULR_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 
 in vec2 vertex_coord;
 layout(location = 0) out vec4 out_color;
@@ -29,10 +35,10 @@ struct CameraInfos
   int selected;
   vec3 dir;
 };
-// They are stored in a contiguous buffer (UBO), lifting most limitations on the number of uniforms.
-layout(std140, binding=4) uniform InputCameras
+// They are stored in a storage buffer sized at runtime, camsCount gives the number of valid entries.
+layout(std430, binding=4) readonly buffer InputCameras
 {
-  CameraInfos cameras[NUM_CAMS];
+  CameraInfos cameras[];
 };
 
 // Uniforms.
@@ -55,6 +61,23 @@ uniform float epsilonOcclusion = 1e-2;
 /* Relative importance of edges penalty */
 #define BETA_UV 0.0
 
+// The input images are bindless textures at their native size (see BindlessTextureSet), the handle
+// of an image that is not resident is zero and its camera is skipped.
+#if ULR_BINDLESS
+layout(std430, binding=8) readonly buffer BindlessImages
+{
+  uvec2 imageHandles[];
+};
+
+bool hasImage(int i){
+	return imageHandles[i] != uvec2(0);
+}
+#else
+bool hasImage(int i){
+	return true;
+}
+#endif
+
 // Textures.
 // To support both the regular version (using texture arrays) and the streaming version (using 2D RTs),
 // we wrap the texture accesses in two helpers that hide the difference.
@@ -63,6 +86,47 @@ layout(binding=1) uniform sampler2DArray input_rgbs;
 layout(binding=2) uniform sampler2DArray input_depths;
 layout(binding=3) uniform sampler2DArray input_masks;
 
+#if ULR_VIRTUAL
+// The input images are a sparse array, paged in on demand from the tiles reported here (see SparseTextureArray).
+layout(std430, binding=6) buffer VirtualFeedback
+{
+  uint vtFeedback[];
+};
+layout(std430, binding=7) readonly buffer VirtualResidency
+{
+  uint vtResidency[];
+};
+uniform uint vtFrame;
+uniform int vtTailLevel;
+uniform int vtTilesPerLayer;
+uniform vec2 vtLevelScales[16];
+uniform ivec3 vtLevelTiles[16];
+
+vec3 sampleRGB(vec3 xy_camid){
+	const int layer = int(xy_camid.z);
+	float lod = textureQueryLod(input_rgbs, xy_camid.xy).x;
+	const int level = int(lod);
+	if(level < vtTailLevel){
+		// Request the tile, and clamp to the finest level resident around it.
+		const ivec3 tiles = vtLevelTiles[level];
+		const ivec2 tile = clamp(ivec2(xy_camid.xy * vtLevelScales[level]), ivec2(0), tiles.xy - 1);
+		vtFeedback[layer * vtTilesPerLayer + tiles.z + tile.y * tiles.x + tile.x] = vtFrame;
+		const ivec3 cells = vtLevelTiles[0];
+		const ivec2 cell = clamp(ivec2(xy_camid.xy * vtLevelScales[0]), ivec2(0), cells.xy - 1);
+		lod = max(lod, float(vtResidency[layer * cells.x * cells.y + cell.y * cells.x + cell.x]));
+	}
+	return textureLod(input_rgbs, xy_camid, lod).rgb;
+}
+#elif ULR_BINDLESS
+vec3 sampleRGB(vec3 xy_camid){
+	return texture(sampler2D(imageHandles[int(xy_camid.z)]), xy_camid.xy).rgb;
+}
+#else
+vec3 sampleRGB(vec3 xy_camid){
+	return texture(input_rgbs, xy_camid).rgb;
+}
+#endif
+
 
 float getMask(vec3 xy_camid){
 	return texture(input_masks, xy_camid).r;
@@ -98,10 +162,7 @@ void main(void){
   vec4  color2 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4  color3 = vec4(0.0,0.0,0.0,INFTY_W);
   vec4 masks = vec4(1.0);
-  for(int i = 0; i < NUM_CAMS; i++){
-	if(i>=camsCount){
-		continue;
-	}
+  for(int i = 0; i < camsCount; i++){
 	if(cameras[i].selected == 0){
 		continue;
 	}
@@ -109,7 +170,7 @@ void main(void){
 	vec3 uvd = project(point.xyz, cameras[i].vp);
 	vec2 ndc = abs(2.0*uvd.xy-1.0);
 
-	if (frustumTest(point.xyz, ndc, i)){
+	if (frustumTest(point.xyz, ndc, i) && hasImage(i)){
 		vec3 xy_camid = vec3(uvd.xy,i);
 		
 		float inputDepth = texture(input_depths, xy_camid).r;
@@ -215,10 +276,10 @@ void main(void){
 		color3.rgb = getRandomColor(int(color3.z));
 	} else {
 		// Read from textures and apply masking.
-		color0.rgb = masks.x*texture(input_rgbs, color0.rgb).rgb;
-		color1.rgb = masks.y*texture(input_rgbs, color1.rgb).rgb;
-		color2.rgb = masks.z*texture(input_rgbs, color2.rgb).rgb;
-		color3.rgb = masks.w*texture(input_rgbs, color3.rgb).rgb;
+		color0.rgb = masks.x*sampleRGB(color0.rgb);
+		color1.rgb = masks.y*sampleRGB(color1.rgb);
+		color2.rgb = masks.z*sampleRGB(color2.rgb);
+		color3.rgb = masks.w*sampleRGB(color3.rgb);
 	}
 
     // blending